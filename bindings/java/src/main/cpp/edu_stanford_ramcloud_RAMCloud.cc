@@ -307,6 +307,66 @@ JNICALL Java_edu_stanford_ramcloud_RAMCloud_cppRead(
     buffer.copy(0, buffer.size(), byteBuffer.getVoidPointer());
 }
 
+/**
+ * Read the current contents of an object into a direct ByteBuffer provided
+ * by the caller (so the value is copied only once, straight from the RPC
+ * response).
+ *
+ * \param env
+ *      The current JNI environment.
+ * \param jRamCloud
+ *      The calling class.
+ * \param byteBufferPointer
+ *      A pointer to the ByteBuffer through which Java and C++ will communicate.
+ *      The format for the input buffer is:
+ *          8 bytes for a pointer to a C++ RamCloud object
+ *          8 bytes for the ID of the table to read from
+ *          4 bytes for the length of the key to find
+ *          byte array for the key to find
+ *          12 bytes representing the RejectRules
+ *      The format for the output buffer is:
+ *          4 bytes for the status code of the read operation
+ *          8 bytes for the version of the read object
+ *          4 bytes for the size of the object's value
+ * \param jValue
+ *      The direct ByteBuffer to read the value into.
+ * \param offset
+ *      Offset in jValue at which to store the value.
+ * \param maxLength
+ *      The most bytes of the value to store.
+ */
+JNIEXPORT void
+JNICALL Java_edu_stanford_ramcloud_RAMCloud_cppReadDirect(
+        JNIEnv *env,
+        jclass jRamCloud,
+        jlong byteBufferPointer,
+        jobject jValue,
+        jint offset,
+        jint maxLength) {
+    ByteBuffer byteBuffer(byteBufferPointer);
+    RamCloud* ramcloud = byteBuffer.readPointer<RamCloud>();
+    uint64_t tableId = byteBuffer.read<uint64_t>();
+    uint32_t keyLength = byteBuffer.read<uint32_t>();
+    void* key = byteBuffer.getVoidPointer(keyLength);
+    RejectRules rejectRules = byteBuffer.read<RejectRules>();
+    char* value = static_cast<char*>(env->GetDirectBufferAddress(jValue));
+    uint32_t actualLength;
+    uint64_t version;
+    byteBuffer.rewind();
+    try {
+        ramcloud->read(tableId,
+                       key,
+                       keyLength,
+                       value + offset,
+                       static_cast<uint32_t>(maxLength),
+                       &actualLength,
+                       &rejectRules,
+                       &version);
+    } EXCEPTION_CATCHER(byteBuffer);
+    byteBuffer.write(version);
+    byteBuffer.write(actualLength);
+}
+
 /**
  * Delete an object from a table. If the object does not currently exist
  * then the operation succeeds without doing anything (unless rejectRules
@@ -404,3 +464,55 @@ JNICALL Java_edu_stanford_ramcloud_RAMCloud_cppWrite(JNIEnv *env,
     buffer.write(version);
 }
 
+/**
+ * Replace the value of a given object, or create a new object if none
+ * previously existed, taking the value from a direct ByteBuffer provided by
+ * the caller rather than from the shared ByteBuffer.
+ *
+ * \param env
+ *      The current JNI environment.
+ * \param jRamCloud
+ *      The calling class.
+ * \param byteBufferPointer
+ *      A pointer to the ByteBuffer through which Java and C++ will communicate.
+ *      The format for the input buffer is:
+ *          8 bytes for a pointer to a C++ RamCloud object
+ *          8 bytes for the ID of the table to write to
+ *          4 bytes for the length of the key to write
+ *          byte array for the key to write
+ *          12 bytes representing the RejectRules
+ *      The format for the output buffer is:
+ *          4 bytes for the status code of the write operation
+ *          8 bytes for the version of the object written
+ * \param jValue
+ *      The direct ByteBuffer holding the new value.
+ * \param offset
+ *      Offset of the value in jValue.
+ * \param length
+ *      Length of the value.
+ */
+JNIEXPORT void
+JNICALL Java_edu_stanford_ramcloud_RAMCloud_cppWriteDirect(JNIEnv *env,
+        jclass jRamCloud,
+        jlong byteBufferPointer,
+        jobject jValue,
+        jint offset,
+        jint length) {
+    ByteBuffer buffer(byteBufferPointer);
+    RamCloud* ramcloud = buffer.readPointer<RamCloud>();
+    uint64_t tableId = buffer.read<uint64_t>();
+    uint32_t keyLength = buffer.read<uint32_t>();
+    void* key = buffer.getVoidPointer(keyLength);
+    RejectRules rules = buffer.read<RejectRules>();
+    char* value = static_cast<char*>(env->GetDirectBufferAddress(jValue));
+    uint64_t version;
+    buffer.rewind();
+    try {
+        ramcloud->write(tableId,
+                        key, keyLength,
+                        value + offset, static_cast<uint32_t>(length),
+                        &rules,
+                        &version);
+    } EXCEPTION_CATCHER(buffer);
+    buffer.write(version);
+}
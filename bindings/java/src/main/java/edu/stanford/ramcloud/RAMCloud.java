@@ -237,6 +237,51 @@ public class RAMCloud {
         return new RAMCloudObject(key, value, version);
     }
 
+    /**
+     * Read the current contents of an object straight into a direct
+     * ByteBuffer. Unlike the other read methods, this doesn't create any
+     * Java objects or copy the value more than once, so it is the fastest
+     * way to read values into memory that the application reuses.
+     *
+     * @param tableId
+     *            The table containing the desired object (return value from a
+     *            previous call to getTableId).
+     * @param key
+     *            Variable length key that uniquely identifies the object within
+     *            tableId.
+     * @param value
+     *            A direct ByteBuffer. The value is stored starting at its
+     *            position, and the position is advanced past it; at most
+     *            value.remaining() bytes are stored.
+     * @param rules
+     *            If non-NULL, specifies conditions under which the read should
+     *            be aborted with an error.
+     * @return The length of the object's value. If this is more than
+     *         value.remaining() was, the value was truncated.
+     */
+    public int read(long tableId, byte[] key, ByteBuffer value,
+                    RejectRules rules) {
+        if (!value.isDirect()) {
+            throw new IllegalArgumentException("value must be a direct "
+                                               + "ByteBuffer");
+        }
+        byteBuffer.rewind();
+        byteBuffer.putLong(ramcloudClusterHandle)
+                .putLong(tableId)
+                .putInt(key.length)
+                .put(key)
+                .put(getRejectRulesBytes(rules));
+        cppReadDirect(byteBufferPointer, value, value.position(),
+                      value.remaining());
+        byteBuffer.rewind();
+        ClientException.checkStatus(byteBuffer.getInt());
+        byteBuffer.getLong();
+        int valueLength = byteBuffer.getInt();
+        value.position(value.position()
+                       + Math.min(valueLength, value.remaining()));
+        return valueLength;
+    }
+
     /**
      * Delete an object from a table.
      *
@@ -371,6 +416,49 @@ public class RAMCloud {
         return version;
     }
 
+    /**
+     * Replace the value of a given object, or create a new object if none
+     * previously existed, taking the value straight from a direct
+     * ByteBuffer rather than copying it through a byte array.
+     *
+     * @param tableId
+     *            The table containing the desired object (return value from a
+     *            previous call to getTableId).
+     * @param key
+     *            Variable length key that uniquely identifies the object within
+     *            tableId.
+     * @param value
+     *            A direct ByteBuffer; the new value is the bytes between its
+     *            position and its limit. The position is advanced to the
+     *            limit.
+     * @param rules
+     *            If non-NULL, specifies conditions under which the write should
+     *            be aborted with an error.
+     * @return The version number of the object is returned. If the operation
+     *         was successful this will be the new version for the object. If
+     *         the operation failed then the version number returned is the
+     *         current version of the object, or 0 if the object does not exist.
+     */
+    public long write(long tableId, byte[] key, ByteBuffer value,
+                      RejectRules rules) {
+        if (!value.isDirect()) {
+            throw new IllegalArgumentException("value must be a direct "
+                                               + "ByteBuffer");
+        }
+        byteBuffer.rewind();
+        byteBuffer.putLong(ramcloudClusterHandle)
+                .putLong(tableId)
+                .putInt(key.length)
+                .put(key)
+                .put(getRejectRulesBytes(rules));
+        cppWriteDirect(byteBufferPointer, value, value.position(),
+                       value.remaining());
+        byteBuffer.rewind();
+        checkStatus(byteBuffer.getInt());
+        value.position(value.limit());
+        return byteBuffer.getLong();
+    }
+
     /**
      * Create a new table, if it doesn't already exist.
      *
@@ -535,10 +623,20 @@ public class RAMCloud {
 
     private static native void cppRead(long byteBufferPointer);
 
+    private static native void cppReadDirect(long byteBufferPointer,
+                                             ByteBuffer value,
+                                             int offset,
+                                             int maxLength);
+
     private static native void cppRemove(long byteBufferPointer);
 
     private static native void cppWrite(long byteBufferPointer);
 
+    private static native void cppWriteDirect(long byteBufferPointer,
+                                              ByteBuffer value,
+                                              int offset,
+                                              int length);
+
     private static native void cppMultiRemove(long ramcloudClusterHandle,
                                               long[] tableIds,
                                               byte[][] objects,
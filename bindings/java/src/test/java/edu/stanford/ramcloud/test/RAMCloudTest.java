@@ -16,6 +16,7 @@
 package edu.stanford.ramcloud.test;
 
 import java.lang.reflect.Method;
+import java.nio.ByteBuffer;
 
 import static edu.stanford.ramcloud.ClientException.*;
 import edu.stanford.ramcloud.*;
@@ -134,6 +135,25 @@ public class RAMCloudTest {
         }
     }
 
+    @Test
+    public void read_directByteBuffer() {
+        ramcloud.write(tableId, key, "testValue");
+        ByteBuffer value = ByteBuffer.allocateDirect(20);
+        value.position(2);
+        assertEquals(9, ramcloud.read(tableId, key.getBytes(), value, null));
+        assertEquals(11, value.position());
+        byte[] bytes = new byte[9];
+        value.position(2);
+        value.get(bytes);
+        assertEquals("testValue", new String(bytes));
+
+        // The value is truncated to fit.
+        value.clear();
+        value.limit(4);
+        assertEquals(9, ramcloud.read(tableId, key.getBytes(), value, null));
+        assertEquals(4, value.position());
+    }
+
     @Test
     (
         expectedExceptions = ObjectDoesntExistException.class
@@ -274,6 +294,19 @@ public class RAMCloudTest {
         }
     }
 
+    @Test
+    public void write_directByteBuffer() {
+        ByteBuffer value = ByteBuffer.allocateDirect(20);
+        value.put("xxtestValue".getBytes());
+        value.flip();
+        value.position(2);
+        long version = ramcloud.write(tableId, key.getBytes(), value, null);
+        assertEquals(11, value.position());
+        RAMCloudObject obj = ramcloud.read(tableId, key);
+        assertEquals("testValue", obj.getValue());
+        assertEquals(version, obj.getVersion());
+    }
+
     @Test
     (
         expectedExceptions = TableDoesntExistException.class
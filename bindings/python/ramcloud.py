@@ -113,6 +113,7 @@ def load_so():
     nanoseconds         = ctypes.c_uint64
     nonce               = ctypes.c_uint64
     rejectRules         = POINTER(RejectRules)
+    rpc                 = ctypes.c_void_p
     serviceLocator      = ctypes.c_char_p
     status              = ctypes.c_int
     table               = ctypes.c_uint64
@@ -141,6 +142,13 @@ def load_so():
                            buf, len, POINTER(len)]
     so.rc_read.restype  = status
 
+    so.rc_readAsync.argtypes = [client, table, key, keyLength, rejectRules,
+                                POINTER(rpc)]
+    so.rc_readAsync.restype  = status
+
+    so.rc_readWait.argtypes = [rpc, POINTER(version), buf, len, POINTER(len)]
+    so.rc_readWait.restype  = status
+
     so.rc_remove.argtypes = [client, table, key, keyLength, rejectRules,
                              POINTER(version)]
     so.rc_remove.restype  = status
@@ -149,6 +157,16 @@ def load_so():
                             POINTER(version)]
     so.rc_write.restype  = status
 
+    so.rc_writeAsync.argtypes = [client, table, key, keyLength, buf, len,
+                                 rejectRules, POINTER(rpc)]
+    so.rc_writeAsync.restype  = status
+
+    so.rc_writeWait.argtypes = [rpc, POINTER(version)]
+    so.rc_writeWait.restype  = status
+
+    so.rc_isReady.argtypes = [client, rpc]
+    so.rc_isReady.restype  = ctypes.c_int
+
     so.rc_testing_kill.argtypes = [client, table, key, keyLength]
     so.rc_testing_kill.restype  = status
 
@@ -212,6 +230,85 @@ class VersionError(Exception):
         self.want_version = want_version
         self.got_version = got_version
 
+class AsyncRead(object):
+    """A read started by RAMCloud.read_async.
+
+    The read proceeds while the caller does other things (including
+    starting more reads and writes); call wait() to get its result.
+    ctypes releases the GIL during each call into the library, so other
+    Python threads run while this one waits.
+    """
+
+    max_length = 1024 * 1024 * 2
+
+    def __init__(self, ramcloud, table_id, id, reject_rules):
+        self.ramcloud = ramcloud
+        # The library refers to these until the read has finished.
+        self.key = get_key(id)
+        self.reject_rules = reject_rules
+        self.rpc = ctypes.c_void_p()
+        s = so.rc_readAsync(ramcloud.client, table_id, self.key,
+                            get_keyLength(id), ctypes.byref(reject_rules),
+                            ctypes.byref(self.rpc))
+        ramcloud.handle_error(s)
+
+    def is_ready(self):
+        return so.rc_isReady(self.ramcloud.client, self.rpc) != 0
+
+    def wait(self):
+        """Return (value, version), like RAMCloud.read."""
+        buf = ctypes.create_string_buffer(self.max_length)
+        actual_length = ctypes.c_uint32()
+        got_version = ctypes.c_uint64()
+        s = so.rc_readWait(self.rpc, ctypes.byref(got_version),
+                           ctypes.byref(buf), self.max_length,
+                           ctypes.byref(actual_length))
+        self.ramcloud.handle_error(s, got_version.value)
+        return (buf.raw[0:actual_length.value], got_version.value)
+
+class AsyncWrite(object):
+    """A write started by RAMCloud.write_async; see AsyncRead."""
+
+    def __init__(self, ramcloud, table_id, id, data, reject_rules):
+        self.ramcloud = ramcloud
+        # The library refers to these until the write has finished.
+        self.key = get_key(id)
+        self.data = data
+        self.reject_rules = reject_rules
+        self.rpc = ctypes.c_void_p()
+        s = so.rc_writeAsync(ramcloud.client, table_id, self.key,
+                             get_keyLength(id), data, len(data),
+                             ctypes.byref(reject_rules),
+                             ctypes.byref(self.rpc))
+        ramcloud.handle_error(s)
+
+    def is_ready(self):
+        return so.rc_isReady(self.ramcloud.client, self.rpc) != 0
+
+    def wait(self):
+        """Return the object's new version, like RAMCloud.write."""
+        got_version = ctypes.c_uint64()
+        s = so.rc_writeWait(self.rpc, ctypes.byref(got_version))
+        self.ramcloud.handle_error(s, got_version.value)
+        return got_version.value
+
+def wait_all(operations):
+    """Wait for each of a list of AsyncReads or AsyncWrites, and return
+    their results in order. Every operation is waited for (so none is
+    left outstanding) even if some fail; then the first failure, if any,
+    is raised."""
+    results = []
+    error = None
+    for operation in operations:
+        try:
+            results.append(operation.wait())
+        except Exception, e:
+            if error is None:
+                error = e
+    if error is not None:
+        raise error
+    return results
+
 class RAMCloud(object):
     def __init__(self):
         self.client = ctypes.c_void_p()
@@ -299,6 +396,19 @@ class RAMCloud(object):
         self.handle_error(s, got_version.value)
         return (buf.raw[0:actual_length.value], got_version.value)
 
+    def read_async(self, table_id, id):
+        """Start reading an object; returns an AsyncRead."""
+        self.hook()
+        return AsyncRead(self, table_id, id,
+                         RejectRules(object_doesnt_exist=True))
+
+    def read_many(self, table_id, ids):
+        """Read several objects, with all of the reads outstanding at once.
+
+        Returns a list of (value, version) in the same order as ids.
+        """
+        return wait_all([self.read_async(table_id, id) for id in ids])
+
     def update(self, table_id, id, data, want_version=None):
         if want_version:
             reject_rules = RejectRules.exactly(want_version)
@@ -323,6 +433,20 @@ class RAMCloud(object):
         self.handle_error(s, got_version.value)
         return got_version.value
 
+    def write_async(self, table_id, id, data):
+        """Start writing an object; returns an AsyncWrite."""
+        self.hook()
+        return AsyncWrite(self, table_id, id, data, RejectRules())
+
+    def write_many(self, table_id, items):
+        """Write several objects, with all of the writes outstanding at once.
+
+        items is a list of (id, data) pairs; returns a list of the new
+        versions in the same order.
+        """
+        return wait_all([self.write_async(table_id, id, data)
+                         for id, data in items])
+
     def testing_kill(self, table_id, id):
         s = so.rc_testing_kill(self.client, table_id,
                                get_key(id), get_keyLength(id))
@@ -213,12 +213,24 @@ def run_test(
         client_args['--targetOps'] = options.targetOps
     if options.txSpan != None:
         client_args['--txSpan'] = options.txSpan
+    if options.numThreads != None:
+        client_args['--numThreads'] = options.numThreads
     if options.numIndexlet != None:
         client_args['--numIndexlet'] = options.numIndexlet
     if options.numIndexes != None:
         client_args['--numIndexes'] = options.numIndexes
     if options.numVClients != None:
         client_args['--numVClients'] = options.numVClients
+    if options.maxRate != None:
+        client_args['--maxRate'] = options.maxRate
+    if options.rateSteps != None:
+        client_args['--rateSteps'] = options.rateSteps
+    if options.stepSeconds != None:
+        client_args['--stepSeconds'] = options.stepSeconds
+    if options.trace != None:
+        client_args['--trace'] = options.trace
+    if options.traceSpeed != None:
+        client_args['--traceSpeed'] = options.traceSpeed
     test.function(test.name, options, cluster_args, client_args)
 
 #-------------------------------------------------------------------
@@ -346,6 +358,21 @@ def indexScalability(name, options, cluster_args, client_args):
             (obj_path, flatten_args(client_args), name), **cluster_args)
     print(get_client_log(), end='')
 
+def indexConcurrentReaders(name, options, cluster_args, client_args):
+    if 'master_args' not in cluster_args:
+        cluster_args['master_args'] = '--maxCores 8'
+    if cluster_args['timeout'] < 200:
+        cluster_args['timeout'] = 200
+    # Largest number of concurrent lookups to measure
+    if '--count' not in client_args:
+        client_args['--count'] = 32
+    # Number of entries in the index
+    if '--numObjects' not in client_args:
+        client_args['--numObjects'] = 10000
+    cluster.run(client='%s/ClusterPerf %s %s' %
+            (obj_path, flatten_args(client_args), name), **cluster_args)
+    print(get_client_log(), end='')
+
 def indexWriteDist(name, options, cluster_args, client_args):
     if 'master_args' not in cluster_args:
         cluster_args['master_args'] = '--maxCores 2 --totalMasterMemory 1500'
@@ -608,6 +635,37 @@ def workloadDist(name, options, cluster_args, client_args):
     else:
         print_cdf_from_log()
 
+def workloadOpenLoop(name, options, cluster_args, client_args):
+    if 'master_args' not in cluster_args:
+        cluster_args['master_args'] = '-t 2000'
+    if 'num_clients' not in cluster_args:
+        cluster_args['num_clients'] = 4
+    # Allow time to load the workload's objects and to offer every rate.
+    steps = options.rateSteps if options.rateSteps != None else 10
+    seconds = options.stepSeconds if options.stepSeconds != None else 2.0
+    if cluster_args['timeout'] < 120 + steps * (seconds + 5):
+        cluster_args['timeout'] = int(120 + steps * (seconds + 5))
+    cluster.run(client='%s/ClusterPerf %s %s' %
+            (obj_path, flatten_args(client_args), name), **cluster_args)
+    print(get_client_log(), end='')
+
+def traceReplay(name, options, cluster_args, client_args):
+    if options.trace == None:
+        sys.stderr.write('traceReplay needs a trace (--trace); see '
+                         'scripts/mkreplaytrace.py\n')
+        sys.exit(1)
+    if 'master_args' not in cluster_args:
+        cluster_args['master_args'] = '-t 2000'
+    if 'num_clients' not in cluster_args:
+        cluster_args['num_clients'] = 4
+    # Every client reads the trace, so it must be on a shared file system.
+    client_args['--trace'] = os.path.abspath(options.trace)
+    if cluster_args['timeout'] < 600:
+        cluster_args['timeout'] = 600
+    cluster.run(client='%s/ClusterPerf %s %s' %
+            (obj_path, flatten_args(client_args), name), **cluster_args)
+    print(get_client_log(), end='')
+
 #-------------------------------------------------------------------
 #  End of driver functions.
 #-------------------------------------------------------------------
@@ -634,6 +692,8 @@ graph_tests = [
     Test("indexScalability", indexScalability),
     Test("indexReadDist", indexReadDist),
     Test("indexWriteDist", indexWriteDist),
+    Test("indexConcurrentReaders", indexConcurrentReaders),
+    Test("memoryEfficiency", default),
     Test("multiRead_general", multiOp),
     Test("multiRead_generalRandom", multiOp),
     Test("multiRead_oneMaster", multiOp),
@@ -645,8 +705,10 @@ graph_tests = [
     Test("readDistWorkload", workloadDist),
     Test("readLoaded", readLoaded),
     Test("readRandom", readRandom),
+    Test("readThreads", default),
     Test("readThroughput", readThroughput),
     Test("readVaryingKeyLength", default),
+    Test("traceReplay", traceReplay),
     Test("transaction_collision", txCollision),
     Test("transaction_oneMaster", multiOp),
     Test("transactionContention", transactionThroughput),
@@ -657,6 +719,7 @@ graph_tests = [
     Test("writeDist", writeDist),
     Test("writeDistRandom", writeDist),
     Test("writeDistWorkload", workloadDist),
+    Test("workloadOpenLoop", workloadOpenLoop),
     Test("writeThroughput", readThroughput),
     Test("workloadThroughput", readThroughput),
 ]
@@ -730,6 +793,9 @@ if __name__ == '__main__':
             'will try to achieve')
     parser.add_option('--txSpan', type=int,
                     help='Number servers a transaction should span.')
+    parser.add_option('--numThreads', type=int,
+            help='Largest number of threads to issue requests from '
+                 'a single client')
     parser.add_option('-i', '--numIndexlet', type=int,
             help='Number of indexlets for measuring index scalability ')
     parser.add_option('-k', '--numIndexes', type=int,
@@ -738,6 +804,21 @@ if __name__ == '__main__':
             metavar='N', dest='numVClients',
             help='Number of virtual clients each client instance should '
                  'simulate')
+    parser.add_option('--maxRate', type=int,
+            help='Highest total operations per second offered by open-loop '
+                 'tests such as workloadOpenLoop')
+    parser.add_option('--rateSteps', type=int,
+            help='Number of evenly spaced rates, up to maxRate, at which '
+                 'open-loop tests measure latency')
+    parser.add_option('--stepSeconds', type=float,
+            help='Seconds for which open-loop tests offer each rate')
+    parser.add_option('--trace', metavar='FILE',
+            help='Request trace replayed by traceReplay (created by '
+                 'scripts/mkreplaytrace.py); must be visible to every '
+                 'client')
+    parser.add_option('--traceSpeed', type=float,
+            help='Replay the trace this many times faster than it was '
+                 'recorded')
     parser.add_option('--rcdf', action='store_true', default=False,
             dest='rcdf',
             help='Output reverse CDF data instead.')
@@ -42,11 +42,18 @@ import sys
 # the Opcode enum in WireFormat.h.
 
 callees = {
+    "APPEND":                ["BACKUP_WRITE"],
+    "BACKUP_WRITE":          ["BACKUP_RELAYED_WRITE"],
+    "BUILD_INDEX":           ["INSERT_INDEX_ENTRY", "MODIFY_INDEX_ENTRIES"],
+    "BULK_LOAD":             ["BACKUP_WRITE"],
+    "COMMIT_WRITE":          ["BACKUP_WRITE", "INSERT_INDEX_ENTRY",
+                              "REMOVE_INDEX_ENTRY"],
+    "CONDITIONAL_UPDATE":    ["BACKUP_WRITE"],
     "COORD_SPLIT_AND_MIGRATE_INDEXLET":
                              ["SPLIT_AND_MIGRATE_INDEXLET",
                               "TAKE_TABLET_OWNERSHIP",
                               "TAKE_INDEXLET_OWNERSHIP"],
-    "CREATE_INDEX":          ["TAKE_INDEXLET_OWNERSHIP",
+    "CREATE_INDEX":          ["BUILD_INDEX", "TAKE_INDEXLET_OWNERSHIP",
                               "TAKE_TABLET_OWNERSHIP"],
     "CREATE_TABLE":          ["TAKE_TABLET_OWNERSHIP"],
     "DROP_INDEX":            ["DROP_TABLET_OWNERSHIP"],
@@ -58,8 +65,9 @@ callees = {
     "INSERT_INDEX_ENTRY":    ["BACKUP_WRITE"],
     "MIGRATE_TABLET":        ["RECEIVE_MIGRATION_DATA",
                               "REASSIGN_TABLET_OWNERSHIP"],
+    "MODIFY_INDEX_ENTRIES":  ["BACKUP_WRITE"],
     "MULTI_OP":              ["BACKUP_WRITE", "INSERT_INDEX_ENTRY",
-                              "REMOVE_INDEX_ENTRY"],
+                              "MODIFY_INDEX_ENTRIES", "REMOVE_INDEX_ENTRY"],
     "RECEIVE_MIGRATION_DATA":["BACKUP_WRITE"],
     "RECOVER":               ["BACKUP_GETRECOVERYDATA", "BACKUP_WRITE"],
     "REMOVE":                ["BACKUP_WRITE", "REMOVE_INDEX_ENTRY"],
@@ -72,6 +80,7 @@ callees = {
     "TX_HINT_FAILED":        ["BACKUP_WRITE"],
     "TX_PREPARE":            ["BACKUP_WRITE"],
     "TX_REQUEST_ABORT":      ["BACKUP_WRITE"],
+    "UPDATE_SERVER_LIST":    ["RELAYED_UPDATE_SERVER_LIST"],
     "WRITE":                 ["BACKUP_WRITE", "INSERT_INDEX_ENTRY",
                               "REMOVE_INDEX_ENTRY"],
 }
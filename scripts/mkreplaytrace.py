@@ -0,0 +1,96 @@
+#!/usr/bin/env python
+
+# Copyright (c) 2016 Stanford University
+#
+# Permission to use, copy, modify, and distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+# ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+# WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+# ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+# OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+"""
+This program converts a request log, such as one exported from a production
+key-value store, into the binary trace replayed by ClusterPerf's traceReplay
+test (see ReplayRecord in src/ClusterPerf.cc).
+
+Each line of the input describes one request, with comma-separated fields:
+    time, client, op, table, key[, size]
+time is in microseconds from any origin; client identifies the connection
+or process that issued the request (any string); op is read, write, or
+remove; table is any string; key is any string; size is the length of the
+value written (writes only). Blank lines and lines starting with '#' are
+ignored. Tables, clients, and keys are numbered in order of appearance.
+
+Usage:
+    mkreplaytrace.py INPUT OUTPUT
+"""
+
+from __future__ import division, print_function
+import struct
+import sys
+
+# These must match ClusterPerf.cc.
+MAGIC = 0x54524352
+VERSION = 1
+HEADER = struct.Struct('<IIQ')
+RECORD = struct.Struct('<QQIHBB')
+OPS = {'read': 0, 'write': 1, 'remove': 2}
+
+def number(names, name, limit, what):
+    """
+    Return the number assigned to a name, assigning the next one if the name
+    is new.
+    """
+    if name not in names:
+        if len(names) >= limit:
+            raise ValueError('too many %s (at most %d)' % (what, limit))
+        names[name] = len(names)
+    return names[name]
+
+def convert(input_name, output_name):
+    requests = []
+    tables = {}
+    clients = {}
+    keys = {}
+    with open(input_name) as f:
+        for line_number, line in enumerate(f, 1):
+            line = line.strip()
+            if not line or line.startswith('#'):
+                continue
+            fields = [field.strip() for field in line.split(',')]
+            try:
+                if len(fields) not in (5, 6):
+                    raise ValueError('expected 5 or 6 fields')
+                if fields[2] not in OPS:
+                    raise ValueError('unknown operation "%s"' % fields[2])
+                time = int(float(fields[0]) * 1000)
+                client = number(clients, fields[1], 1 << 16, 'clients')
+                table = number(tables, fields[3], 256, 'tables')
+                key = number(keys, (table, fields[4]), 1 << 64, 'keys')
+                size = int(fields[5]) if len(fields) == 6 else 0
+            except ValueError as e:
+                sys.stderr.write('%s:%d: %s\n' % (input_name, line_number, e))
+                sys.exit(1)
+            requests.append((time, key, size, client, OPS[fields[2]], table))
+
+    requests.sort(key=lambda request: request[0])
+    start = requests[0][0] if requests else 0
+    with open(output_name, 'wb') as f:
+        f.write(HEADER.pack(MAGIC, VERSION, len(requests)))
+        for request in requests:
+            f.write(RECORD.pack(request[0] - start, *request[1:]))
+    print('%d requests from %d clients to %d tables (%d objects) over '
+          '%.1f s' % (len(requests), len(clients), len(tables), len(keys),
+          (requests[-1][0] - start) / 1e09 if requests else 0))
+
+if __name__ == '__main__':
+    if len(sys.argv) != 3:
+        sys.stderr.write(__doc__)
+        sys.exit(1)
+    convert(sys.argv[1], sys.argv[2])
@@ -187,6 +187,11 @@ master.metric('verifyChecksumTicks',
     'time verifying checksums on objects from backups')
 master.metric('recoverSegmentTicks',
     'spent in MasterService::recoverSegment')
+master.metric('replayTicks',
+    'elapsed time replaying recovery segments, however many threads '
+    'replay each one')
+master.metric('replayThreadCount',
+    'number of threads replaying recovery segments, summed over recoveries')
 master.metric('backupInRecoverTicks',
     'time spent in ReplicaManager::proceed '
     'called from MasterService::recoverSegment')
@@ -239,6 +244,10 @@ master.metric('replicaRecoveries',
     'number of replicas which have started replica recreation')
 master.metric('openReplicaRecoveries',
     'of replicaRecoveries how many were for replicas which were open')
+master.metric('replicaRecoveriesCompleted',
+    'of replicaRecoveries how many have been fully re-created and closed')
+master.metric('replicaRecoveryBytes',
+    'bytes sent to backups to re-create lost replicas')
 master.metric('replicationTasks',
     'max number of outstanding tasks in ReplicaManager')
 master.metric('replicationTransmitCopyTicks',
@@ -259,6 +268,8 @@ master.metric('recoverSegmentPostingWriteRpcTicks',
     'time spent during recoverSegment starting write rpcs in transport')
 master.metric('logSyncPostingWriteRpcTicks',
     'time spent during recovery final log sync starting write rpcs in transport')
+master.metric('writesShed',
+    'write requests turned away because the log was nearly full')
 
 backup = Group('Backup', 'metrics for backups')
 backup.metric('recoveryCount',
@@ -284,6 +295,10 @@ backup.metric('primaryLoadCount', 'number of primary segments requested')
 backup.metric('secondaryLoadCount', 'number of secondary segments requested')
 backup.metric('storageType', '1 = in-memory, 2 = on-disk')
 backup.metric('uncommittedFramesFreed', 'number of segment frames freed before being fully flushed to disk')
+backup.metric('oldReplicasFreed',
+    'number of replicas found on storage at startup and then freed')
+backup.metric('downServerReplicasFreed',
+    'number of replicas freed because their master left the cluster')
 
 # This class records basic statistics for RPCs (count & execution time).
 # The order here must match WireFormat.h. In the old days we did it manually,
@@ -364,6 +379,46 @@ transport.metric('retrySessionOpenCount',
 transport.metric('clientRpcsActiveTicks',
     'time with a client RPC active on the network')
 
+failureDetector = Group('FailureDetector',
+    'metrics for the failure detector')
+failureDetector.metric('probeCount', 'number of direct pings sent')
+failureDetector.metric('suspicionCount',
+    'number of direct pings that timed out')
+failureDetector.metric('indirectProbeCount',
+    'number of proxy pings sent to check on a suspected server')
+failureDetector.metric('falseSuspicionCount',
+    'number of suspected servers that an indirect probe reached')
+failureDetector.metric('crashHintCount',
+    'number of possible crashes reported to the coordinator')
+failureDetector.metric('detectionTicks',
+    'time between the last response from a server and reporting it to '
+    'the coordinator, summed over all reports')
+
+hedge = Group('Hedge', 'metrics for hedged client RPCs')
+hedge.metric('sentCount',
+    'number of RPCs duplicated to a second server because the first was slow')
+hedge.metric('wonCount',
+    'number of hedged RPCs that the second server answered first')
+hedge.metric('canceledCount',
+    'number of duplicates canceled because the first server answered first')
+hedge.metric('failedCount',
+    'number of duplicates that failed or returned an error')
+
+changeStream = Group('ChangeStream',
+    'metrics for streaming changes to another cluster')
+changeStream.metric('recordCount',
+    'number of objects and tombstones recorded in the change stream')
+changeStream.metric('recordBytes',
+    'total bytes recorded in the change stream, including headers')
+changeStream.metric('sentBytes',
+    'total bytes of changes returned by READ_CHANGES requests')
+changeStream.metric('sentCompressedBytes',
+    'bytes of changes actually sent, after compression')
+changeStream.metric('lostCount',
+    'number of reads whose changes had already left the stream')
+changeStream.metric('lagMicros',
+    'age of the oldest change not yet read, as of the latest read')
+
 temp = Group('Temp', 'metrics for temporary use')
 for i in range(10):
     temp.metric('ticks{0:}'.format(i),'amount of time for some undefined activity')
@@ -375,6 +430,9 @@ definitions.group(master);
 definitions.group(backup);
 definitions.group(rpc);
 definitions.group(transport);
+definitions.group(failureDetector);
+definitions.group(hedge);
+definitions.group(changeStream);
 definitions.group(temp);
 definitions.metric('serverId', 'server id assigned by coordinator')
 definitions.metric('pid', 'process ID on machine')
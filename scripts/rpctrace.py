@@ -0,0 +1,160 @@
+#!/usr/bin/env python
+
+# Copyright (c) 2016 Stanford University
+#
+# Permission to use, copy, modify, and distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+# ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+# WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+# ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+# OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+"""
+This program correlates the RPC traces (see src/RpcTrace.h) recorded by a
+collection of clients and servers, and prints where the time went for each
+traced operation: how long the client waited for each RPC it sent, and how
+long each server spent executing the requests it received on the
+operation's behalf (including the RPCs it sent in turn, such as backup
+writes). Clocks on different machines aren't synchronized, so only the
+durations within each input are meaningful.
+
+Each input is either a log file containing time traces printed by
+TimeTrace::printToLog or a file written by TraceStreamer (a server's
+--traceStream output); the first is recognized by its contents.
+"""
+
+from __future__ import division, print_function
+from optparse import OptionParser
+import os
+import re
+import struct
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import timetrace2chrome
+
+# Matches an RPC trace event in a time trace printed to a log.
+LOG_EVENT = re.compile(r' ([0-9.]+) ns \(\+ *[0-9.]+ ns\): rpctrace '
+                       r'([0-9a-f]{16}) (client|server) (send|start|done) '
+                       r'(\d+)')
+
+# Matches an RPC trace format string in the output of TraceStreamer.
+STREAM_FORMAT = re.compile(r'rpctrace %08x%08x (client|server) '
+                           r'(send|start|done) %u')
+
+def read_opcode_names(header):
+    """
+    Return a dictionary mapping RPC opcodes to their names, from the Opcode
+    enum in WireFormat.h.
+    """
+    names = {}
+    try:
+        with open(header) as f:
+            text = f.read()
+    except IOError:
+        return names
+    enum = re.search(r'enum Opcode {(.*?)}', text, re.S)
+    if enum:
+        for name, value in re.findall(r'(\w+)\s*=\s*(\d+)', enum.group(1)):
+            names[int(value)] = name
+    return names
+
+def read_events(file_name):
+    """
+    Generate (time in ns, trace id, role, step, opcode) for each RPC trace
+    event in a file.
+    """
+    with open(file_name, 'rb') as f:
+        data = f.read()
+    if data[:4] == struct.pack('<I', timetrace2chrome.HEADER):
+        cycles_per_second = 1e09
+        formats = {}
+        for record_type, fields in timetrace2chrome.read_records(data):
+            if record_type == timetrace2chrome.HEADER:
+                cycles_per_second = fields[2]
+                formats = {}
+            elif record_type == timetrace2chrome.FORMAT:
+                formats[fields[1]] = STREAM_FORMAT.match(fields[3])
+            elif record_type == timetrace2chrome.EVENT:
+                match = formats.get(fields[3])
+                if match:
+                    yield (fields[2] * 1e09 / cycles_per_second,
+                           (fields[4] << 32) | fields[5], match.group(1),
+                           match.group(2), fields[6])
+    else:
+        for line in data.decode('utf-8', 'replace').splitlines():
+            match = LOG_EVENT.search(line)
+            if match:
+                yield (float(match.group(1)), int(match.group(2), 16),
+                       match.group(3), match.group(4), int(match.group(5)))
+
+def collect(file_names):
+    """
+    Return a dictionary mapping each trace id to a list of spans
+    (input, role, opcode, start time, duration in ns), one for each RPC
+    sent or executed on the operation's behalf.
+    """
+    traces = {}
+    for file_name in file_names:
+        # Requests of a given kind may overlap (a master replicates to
+        # several backups at once); pair them in FIFO order.
+        pending = {}
+        for time, trace_id, role, step, opcode in read_events(file_name):
+            key = (trace_id, role, opcode)
+            if step != 'done':
+                pending.setdefault(key, []).append(time)
+            elif pending.get(key):
+                start = pending[key].pop(0)
+                traces.setdefault(trace_id, []).append(
+                        (file_name, role, opcode, start, time - start))
+    return traces
+
+def percentile(values, fraction):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(fraction * len(values)))]
+
+def main():
+    parser = OptionParser(usage='%prog [options] file...',
+                          description=__doc__.strip())
+    parser.add_option('--summary', action='store_true', default=False,
+                      help='print statistics for each kind of span instead '
+                      'of listing every operation')
+    parser.add_option('--wireformat', default=os.path.join(
+                      os.path.dirname(os.path.abspath(__file__)), '..', 'src',
+                      'WireFormat.h'),
+                      help='header file from which to read opcode names')
+    (options, args) = parser.parse_args()
+    if not args:
+        parser.error('no input files')
+    names = read_opcode_names(options.wireformat)
+    traces = collect(args)
+
+    if options.summary:
+        durations = {}
+        for spans in traces.values():
+            for file_name, role, opcode, start, duration in spans:
+                durations.setdefault((role, opcode), []).append(duration)
+        print('%-8s %-28s %8s %10s %10s %10s' % ('Role', 'Opcode', 'Count',
+              'Avg (us)', 'P50 (us)', 'P99 (us)'))
+        for (role, opcode), values in sorted(durations.items()):
+            print('%-8s %-28s %8d %10.2f %10.2f %10.2f' % (role,
+                  names.get(opcode, opcode), len(values),
+                  sum(values) / len(values) / 1e03,
+                  percentile(values, 0.5) / 1e03,
+                  percentile(values, 0.99) / 1e03))
+        return
+
+    for trace_id in sorted(traces):
+        print('Trace %016x' % trace_id)
+        for file_name, role, opcode, start, duration in sorted(
+                traces[trace_id], key=lambda s: (s[0], s[3])):
+            print('    %-30s %-7s %-28s %10.2f us' % (file_name, role,
+                  names.get(opcode, opcode), duration / 1e03))
+
+if __name__ == '__main__':
+    main()
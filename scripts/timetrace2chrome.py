@@ -0,0 +1,153 @@
+#!/usr/bin/env python
+
+"""
+Converts the time trace output of TraceStreamer (a server's --traceStream
+file, or datagrams saved by a collector) to the Chrome trace event format, so
+it can be viewed with chrome://tracing.
+
+Usage:
+    timetrace2chrome.py TRACE_FILE... > trace.json
+        Convert one or more trace files; events from the Nth file are shown
+        as process N.
+    timetrace2chrome.py --collect PORT TRACE_FILE
+        Act as a UDP collector: append every datagram received on PORT to
+        TRACE_FILE (each datagram is self-contained, so the result can be
+        converted like any other trace file). Stop with control-C.
+"""
+
+from __future__ import division, print_function
+import json
+import re
+import socket
+import struct
+import sys
+
+# Record types and layouts; these must match TraceStreamer.h.
+HEADER = 0x54544352
+FORMAT = 1
+EVENT = 2
+LOST = 3
+HEADER_RECORD = struct.Struct('<IId')
+FORMAT_RECORD = struct.Struct('<III')
+EVENT_RECORD = struct.Struct('<IIQI4I')
+LOST_RECORD = struct.Struct('<IIQ')
+
+# Matches one printf conversion, with any length modifier in group 1.
+CONVERSION = re.compile(r'%%|%[-+ #0]*\d*(?:\.\d+)?(hh|h|ll|l|z|j|t)?'
+                        r'([diouxXc])')
+
+def format_message(fmt, args):
+    """
+    Expand a printf-style format string from the C++ code with the
+    arguments of an event.
+    """
+    count = [0]
+    def strip_modifier(match):
+        if match.group(0) == '%%':
+            return '%%'
+        count[0] += 1
+        text = match.group(0)
+        if match.group(1):
+            text = text.replace(match.group(1), '', 1)
+        return text.replace('u', 'd')
+    python_fmt = CONVERSION.sub(strip_modifier, fmt)
+    try:
+        return python_fmt % tuple(args[:count[0]])
+    except (TypeError, ValueError):
+        return '%s %s' % (fmt, args)
+
+def read_records(data):
+    """
+    Generate (type, fields) for each record in the output of TraceStreamer.
+    """
+    offset = 0
+    while offset + 4 <= len(data):
+        (record_type,) = struct.unpack_from('<I', data, offset)
+        if record_type == HEADER:
+            fields = HEADER_RECORD.unpack_from(data, offset)
+            offset += HEADER_RECORD.size
+        elif record_type == FORMAT:
+            fields = FORMAT_RECORD.unpack_from(data, offset)
+            offset += FORMAT_RECORD.size
+            length = fields[2]
+            text = data[offset:offset + length].decode('utf-8', 'replace')
+            fields = fields + (text,)
+            offset += length
+        elif record_type == EVENT:
+            fields = EVENT_RECORD.unpack_from(data, offset)
+            offset += EVENT_RECORD.size
+        elif record_type == LOST:
+            fields = LOST_RECORD.unpack_from(data, offset)
+            offset += LOST_RECORD.size
+        else:
+            sys.stderr.write('bad record type %d at offset %d; ignoring '
+                             'the rest of the file\n' % (record_type, offset))
+            return
+        yield record_type, fields
+
+def convert(file_names):
+    """
+    Return a Chrome trace (as a dictionary) containing the events from
+    the given trace files.
+    """
+    events = []
+    for pid, file_name in enumerate(file_names):
+        with open(file_name, 'rb') as f:
+            data = f.read()
+        cycles_per_second = 1e09
+        formats = {}
+        for record_type, fields in read_records(data):
+            if record_type == HEADER:
+                cycles_per_second = fields[2]
+                formats = {}
+            elif record_type == FORMAT:
+                formats[fields[1]] = fields[3]
+            elif record_type == EVENT:
+                fmt = formats.get(fields[3], '(unknown format %d)' % fields[3])
+                events.append({
+                    'name': format_message(fmt, fields[4:8]),
+                    'ph': 'i', 's': 't', 'pid': pid, 'tid': fields[1],
+                    'ts': fields[2] * 1e06 / cycles_per_second})
+            elif record_type == LOST:
+                events.append({
+                    'name': 'lost %d events' % fields[2],
+                    'ph': 'i', 's': 't', 'pid': pid, 'tid': fields[1],
+                    'ts': None})
+
+    # Times are shown relative to the first event; lost-event markers take
+    # the time of the event recorded just before them on the same thread.
+    timed = [e['ts'] for e in events if e['ts'] is not None]
+    start = min(timed) if timed else 0
+    last = {}
+    for event in events:
+        key = (event['pid'], event['tid'])
+        if event['ts'] is None:
+            event['ts'] = last.get(key, start)
+        last[key] = event['ts']
+        event['ts'] -= start
+    events.sort(key=lambda e: e['ts'])
+    return {'traceEvents': events, 'displayTimeUnit': 'ns'}
+
+def collect(port, file_name):
+    """
+    Append every datagram received on a UDP port to a file.
+    """
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(('', port))
+    with open(file_name, 'ab') as f:
+        try:
+            while True:
+                data = sock.recv(65536)
+                f.write(data)
+                f.flush()
+        except KeyboardInterrupt:
+            pass
+
+if __name__ == '__main__':
+    if len(sys.argv) == 4 and sys.argv[1] == '--collect':
+        collect(int(sys.argv[2]), sys.argv[3])
+    elif len(sys.argv) >= 2 and not sys.argv[1].startswith('-'):
+        json.dump(convert(sys.argv[1:]), sys.stdout)
+    else:
+        sys.stderr.write(__doc__)
+        sys.exit(1)
@@ -68,5 +68,7 @@ if __name__ == '__main__':
 
     print('Running', options.transport, 'with',
           options.numObjects, options.objectSize, 'byte objects')
-    transportBench(options.numObjects, options.objectSize,
-                   options.transport, not options.cached)
+    stats = transportBench(options.numObjects, options.objectSize,
+                           options.transport, not options.cached)
+    if 'readsPerSecond' in stats:
+        print('%.1f kreads/s' % (stats['readsPerSecond'] / 1000))
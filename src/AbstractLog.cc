@@ -16,6 +16,7 @@
 #include <assert.h>
 #include <stdint.h>
 
+#include "ChangeStream.h"
 #include "Log.h"
 #include "LogCleaner.h"
 #include "PerfStats.h"
@@ -52,7 +53,8 @@ AbstractLog::AbstractLog(LogEntryHandlers* entryHandlers,
       appendLock("AbstractLog::appendLock"),
       totalLiveBytes(0),
       maxLiveBytes(0),
-      metrics()
+      metrics(),
+      changeStream(NULL)
 {
     // This is a placeholder value; the real value will get computed
     // shortly by allocNewWritableHead.
@@ -82,13 +84,15 @@ bool
 AbstractLog::append(AppendVector* appends, uint32_t numAppends)
 {
     CycleCounter<uint64_t> _(&metrics.totalAppendTicks);
-    SpinLock::Guard lock(appendLock);
-    metrics.totalAppendCalls++;
 
     uint32_t lengths[numAppends];
     for (uint32_t i = 0; i < numAppends; i++)
         lengths[i] = appends[i].buffer.size();
 
+    lockForAppend();
+    SpinLock::Guard lock(appendLock, std::adopt_lock);
+    metrics.totalAppendCalls++;
+
     if (head == NULL || !head->hasSpaceFor(lengths, numAppends)) {
         if (!allocNewWritableHead())
             return false;
@@ -132,7 +136,8 @@ AbstractLog::append(Buffer *logBuffer, Reference *references,
                     uint32_t numEntries)
 {
     CycleCounter<uint64_t> _(&metrics.totalAppendTicks);
-    SpinLock::Guard lock(appendLock);
+    lockForAppend();
+    SpinLock::Guard lock(appendLock, std::adopt_lock);
     metrics.totalAppendCalls++;
 
     if (head == NULL || !head->hasSpaceFor(logBuffer->size())) {
@@ -199,8 +204,11 @@ AbstractLog::free(Reference reference)
     if (type == LOG_ENTRY_TYPE_OBJ ||
         type == LOG_ENTRY_TYPE_RPCRESULT ||
         type == LOG_ENTRY_TYPE_PREP ||
-        type == LOG_ENTRY_TYPE_TXPLIST)
+        type == LOG_ENTRY_TYPE_TXPLIST) {
         totalLiveBytes -= lengthWithMetadata;
+        if (segment->onFlash)
+            segmentManager->adjustFlashLiveBytes(-int64_t(lengthWithMetadata));
+    }
 }
 
 /**
@@ -221,6 +229,7 @@ AbstractLog::getMetrics(ProtoBuf::LogMetrics& m)
 
     segmentManager->getMetrics(*m.mutable_segment_metrics());
     segmentManager->getAllocator().getMetrics(*m.mutable_seglet_metrics());
+    segmentManager->getSegletMetrics(*m.mutable_seglet_metrics());
 }
 
 /**
@@ -276,7 +285,10 @@ AbstractLog::getSegmentId(Reference reference)
  */
 bool
 AbstractLog::hasSpaceFor(uint64_t objectSize) {
-    if ((totalLiveBytes + objectSize) <= maxLiveBytes) {
+    // Live data on the flash tier doesn't take up any memory.
+    uint64_t liveBytesInMemory =
+            totalLiveBytes - segmentManager->getFlashLiveBytes();
+    if ((liveBytesInMemory + objectSize) <= maxLiveBytes) {
         return true;
     }
     RAMCLOUD_CLOG(WARNING, "Memory capacity exceeded; must delete objects "
@@ -391,6 +403,8 @@ AbstractLog::append(const SpinLock::Guard& lock,
         type == LOG_ENTRY_TYPE_PREP ||
         type == LOG_ENTRY_TYPE_TXPLIST)
         totalLiveBytes += lengthWithMetadata;
+    if (changeStream != NULL && changeStream->isEnabled())
+        recordChange(type, reference);
     //TODO(seojin): handle RpcResult and PreparedOp.
 
     PerfStats::threadStats.logBytesAppended += lengthWithMetadata;
@@ -479,6 +493,8 @@ AbstractLog::append(const SpinLock::Guard& lock,
         type == LOG_ENTRY_TYPE_PREP ||
         type == LOG_ENTRY_TYPE_TXPLIST)
         totalLiveBytes += lengthWithMetadata;
+    if (changeStream != NULL && changeStream->isEnabled())
+        recordChange(type, reference);
     //TODO(seojin): handle RpcResult and PreparedOp.
 
     PerfStats::threadStats.logBytesAppended += lengthWithMetadata;
@@ -519,12 +535,86 @@ AbstractLog::append(const SpinLock::Guard& lock,
             Reference* outReference,
             uint64_t* outTickCounter)
 {
-    return append(lock,
-                  type,
-                  buffer.getRange(0, buffer.size()),
-                  buffer.size(),
-                  outReference,
-                  outTickCounter);
+    CycleCounter<uint64_t> _(outTickCounter);
+
+    // This is only possible once after construction.
+    if (head == NULL) {
+        if (!allocNewWritableHead())
+            throw FatalError(HERE, "Could not allocate initial head segment");
+    }
+
+    // The buffer is copied into the segment chunk by chunk, so multi-chunk
+    // entries (e.g. objects whose values still live in an RPC request) are
+    // copied only once while the append lock is held.
+    Reference reference;
+    uint32_t bytesUsedBefore = head->getAppendedLength();
+    bool enoughSpace = head->append(type, buffer, &reference);
+    if (!enoughSpace) {
+        if (!allocNewWritableHead())
+            return false;
+
+        bytesUsedBefore = head->getAppendedLength();
+        if (!head->append(type, buffer, &reference)) {
+            LOG(ERROR, "Entry too big to append to log: %u bytes of type %d",
+                buffer.size(), static_cast<int>(type));
+            throw FatalError(HERE, "Entry too big to append to log");
+        }
+    }
+
+    if (outReference != NULL)
+        *outReference = reference;
+
+    uint32_t lengthWithMetadata = head->getAppendedLength() - bytesUsedBefore;
+
+    // Update log statistics so that the cleaner can make intelligent decisions
+    // when trying to reclaim memory.
+    head->trackNewEntry(type, lengthWithMetadata);
+    if (type == LOG_ENTRY_TYPE_OBJ ||
+        type == LOG_ENTRY_TYPE_RPCRESULT ||
+        type == LOG_ENTRY_TYPE_PREP ||
+        type == LOG_ENTRY_TYPE_TXPLIST)
+        totalLiveBytes += lengthWithMetadata;
+    if (changeStream != NULL && changeStream->isEnabled())
+        recordChange(type, reference);
+
+    PerfStats::threadStats.logBytesAppended += lengthWithMetadata;
+
+    return true;
+}
+
+/**
+ * Copy an entry that was just appended into #changeStream, if it is an
+ * object or tombstone. The caller must hold #appendLock, so that changes
+ * are recorded in the order they were appended.
+ *
+ * \param type
+ *      Type of the entry.
+ * \param reference
+ *      Reference to the entry.
+ */
+void
+AbstractLog::recordChange(LogEntryType type, Reference reference)
+{
+    if (type != LOG_ENTRY_TYPE_OBJ && type != LOG_ENTRY_TYPE_OBJTOMB)
+        return;
+    Buffer entry;
+    getEntry(reference, entry);
+    changeStream->record(type, entry);
+}
+
+/**
+ * Acquire #appendLock. If another thread holds it, the time spent waiting is
+ * charged to PerfStats::logAppendLockCycles, which shows how much appends
+ * are being serialized. The caller is responsible for releasing the lock
+ * (typically by adopting it in a SpinLock::Guard).
+ */
+void
+AbstractLog::lockForAppend()
+{
+    if (!appendLock.try_lock()) {
+        CycleCounter<uint64_t> _(&PerfStats::threadStats.logAppendLockCycles);
+        appendLock.lock();
+    }
 }
 
 /**
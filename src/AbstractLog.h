@@ -31,6 +31,9 @@
 
 namespace RAMCloud {
 
+/// ChangeStream needs LogEntryTypes and Buffer only, but is used via pointer.
+class ChangeStream;
+
 /// LogEntryHandlers needs the AbstractLog::Reference definition.
 class LogEntryHandlers;
 
@@ -114,6 +117,20 @@ class AbstractLog {
     bool hasSpaceFor(uint64_t objectSize);
     bool segmentExists(uint64_t segmentId);
 
+    /**
+     * Record every object and tombstone subsequently appended to this log
+     * in a ChangeStream, in the order they are appended.
+     *
+     * \param stream
+     *      The stream, which must outlive this log; NULL stops recording.
+     */
+    void
+    setChangeStream(ChangeStream* stream)
+    {
+        SpinLock::Guard _(appendLock);
+        changeStream = stream;
+    }
+
     /*
      * The following overloaded append() methods are for convenience. Fast path
      * code (like the heart of segment replay during recovery) use a single
@@ -135,7 +152,8 @@ class AbstractLog {
            uint32_t length,
            Reference* outReference = NULL)
     {
-        SpinLock::Guard lock(appendLock);
+        lockForAppend();
+        SpinLock::Guard lock(appendLock, std::adopt_lock);
         metrics.totalAppendCalls++;
         return append(lock,
                       type,
@@ -153,12 +171,12 @@ class AbstractLog {
            Buffer& buffer,
            Reference* outReference = NULL)
     {
-        SpinLock::Guard lock(appendLock);
+        lockForAppend();
+        SpinLock::Guard lock(appendLock, std::adopt_lock);
         metrics.totalAppendCalls++;
         return append(lock,
                       type,
-                      buffer.getRange(0, buffer.size()),
-                      buffer.size(),
+                      buffer,
                       outReference,
                       &metrics.totalAppendTicks);
     }
@@ -206,6 +224,8 @@ class AbstractLog {
                 Reference* outReference = NULL,
                 uint64_t* outTickCounter = NULL);
     bool allocNewWritableHead();
+    void lockForAppend();
+    void recordChange(LogEntryType type, Reference reference);
 
     /// Various handlers for entries appended to this log. Used to obtain
     /// timestamps and to relocate entries during cleaning.
@@ -316,6 +336,10 @@ class AbstractLog {
         uint64_t totalMetadataBytesAppended;
     } metrics;
 
+    /// If non-NULL, every object and tombstone appended to this log is also
+    /// recorded here (see setChangeStream). Only a master's main Log has one.
+    ChangeStream* changeStream;
+
     DISALLOW_COPY_AND_ASSIGN(AbstractLog);
 };
 
@@ -20,6 +20,7 @@
 #include "Log.h"
 #include "LogEntryTypes.h"
 #include "Memory.h"
+#include "PerfStats.h"
 #include "ServerConfig.h"
 #include "StringUtil.h"
 #include "TestLog.h"
@@ -184,6 +185,28 @@ TEST_F(AbstractLogTest, append_multipleLogEntries) {
     delete[] data;
 }
 
+TEST_F(AbstractLogTest, append_multiChunkBuffer) {
+    Buffer sourceBuffer;
+    sourceBuffer.appendExternal("hello, ", 7);
+    sourceBuffer.appendExternal("world", 6);
+
+    Log::Reference ref;
+    EXPECT_TRUE(l.append(LOG_ENTRY_TYPE_OBJ, sourceBuffer, &ref));
+    Buffer buffer;
+    EXPECT_EQ(LOG_ENTRY_TYPE_OBJ, l.getEntry(ref, buffer));
+    EXPECT_EQ("hello, world", string(buffer.getStart<char>()));
+}
+
+TEST_F(AbstractLogTest, lockForAppend) {
+    uint64_t before = PerfStats::threadStats.logAppendLockCycles;
+    l.lockForAppend();
+    EXPECT_FALSE(l.appendLock.try_lock());
+    l.appendLock.unlock();
+
+    // No contention, so no time should have been charged for waiting.
+    EXPECT_EQ(before, PerfStats::threadStats.logAppendLockCycles);
+}
+
 TEST_F(AbstractLogTest, free) {
     uint64_t data = 0x123456789ABCDEF0UL;
     Buffer sourceBuffer;
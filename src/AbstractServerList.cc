@@ -36,6 +36,7 @@ AbstractServerList::AbstractServerList(Context* context)
     , version(0)
     , trackers()
     , mutex()
+    , sessionCache()
 {
     context->serverList = this;
 }
@@ -130,6 +131,12 @@ AbstractServerList::isUp(ServerId id) {
 Transport::SessionRef
 AbstractServerList::getSession(ServerId id)
 {
+    // Fast path: the session is almost always cached, and this lookup
+    // takes no locks.
+    Transport::SessionRef cached = sessionCache.find(id);
+    if (cached != NULL)
+        return cached;
+
     // This method is a bit tricky because we don't want to hold the
     // lock while opening a new session. This means it's possible that
     // two different threads might each discover that there is no cached
@@ -142,8 +149,11 @@ AbstractServerList::getSession(ServerId id)
         ServerDetails* details = iget(id);
         if ((details == NULL) || (details->status != ServerStatus::UP))
             return FailSession::get();
-        if (details->session != NULL)
+        if (details->session != NULL) {
+            // Another server may have taken this server's cache slot.
+            sessionCache.insert(id, details->session);
             return details->session;
+        }
         locator = details->serviceLocator;
     }
 
@@ -194,8 +204,11 @@ AbstractServerList::getSession(ServerId id)
         ServerDetails* details = iget(id);
         if (details == NULL)
             return FailSession::get();
-        if (details->session == NULL)
+        if (details->session == NULL) {
             details->session = session;
+            if (details->status == ServerStatus::UP)
+                sessionCache.insert(id, session);
+        }
         return details->session;
     }
 }
@@ -211,6 +224,7 @@ void
 AbstractServerList::flushSession(ServerId id)
 {
     Lock _(mutex);
+    sessionCache.erase(id);
     ServerDetails* details = iget(id);
     if (details != NULL) {
         details->session = NULL;
@@ -22,6 +22,7 @@
 #include "ServiceMask.h"
 #include "ServerId.h"
 #include "ServerList.pb.h"
+#include "SessionCache.h"
 #include "Transport.h"
 #include "Tub.h"
 
@@ -317,6 +318,11 @@ class AbstractServerList {
 
     typedef std::unique_lock<std::mutex> Lock;
 
+    /// Sessions returned by getSession, readable without #mutex. Subclasses
+    /// must erase a server's entry whenever its status leaves UP, since
+    /// getSession doesn't check the status of cached servers.
+    SessionCache sessionCache;
+
     /**
      * The following variable is set to true during unit tests to skip
      * the server id check in getSession.
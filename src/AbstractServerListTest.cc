@@ -184,6 +184,24 @@ TEST_F(AbstractServerListTest, getSession_basics) {
     EXPECT_EQ("mock:id=2", session2->getServiceLocator());
     Transport::SessionRef session3 = sl.getSession(id1);
     EXPECT_EQ(session1, session3);
+    EXPECT_EQ(session1, sl.sessionCache.find(id1));
+}
+TEST_F(AbstractServerListTest, getSession_cached) {
+    MockTransport transport(&context);
+    context.transportManager->registerMock(&transport);
+
+    ServerId id1 = sl.add("mock:id=1", ServerStatus::UP);
+    Transport::SessionRef session1 = sl.getSession(id1);
+
+    // Cached sessions are returned without consulting the server's entry.
+    sl.iget(id1)->session = NULL;
+    EXPECT_EQ(session1, sl.getSession(id1));
+
+    // A session that lost its cache slot is cached again.
+    sl.sessionCache.clear();
+    sl.iget(id1)->session = session1;
+    EXPECT_EQ(session1, sl.getSession(id1));
+    EXPECT_EQ(session1, sl.sessionCache.find(id1));
 }
 TEST_F(AbstractServerListTest, getSession_bogusId) {
     EXPECT_EQ("fail:", sl.getSession({9999, 22})->getServiceLocator());
@@ -252,6 +270,7 @@ TEST_F(AbstractServerListTest, flushSession) {
     EXPECT_EQ("mock:id=1", session1->getServiceLocator());
     sl.flushSession({999, 999});
     sl.flushSession(id);
+    EXPECT_TRUE(sl.sessionCache.find(id) == NULL);
     Transport::SessionRef session2 = sl.getSession(id);
     EXPECT_EQ("mock:id=1", session2->getServiceLocator());
     EXPECT_NE(session1, session2);
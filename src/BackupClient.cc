@@ -17,6 +17,8 @@
 #include "Buffer.h"
 #include "ClientException.h"
 #include "CycleCounter.h"
+#include "Lz4.h"
+#include "PerfStats.h"
 #include "RawMetrics.h"
 #include "Segment.h"
 #include "ShortMacros.h"
@@ -160,6 +162,9 @@ GetRecoveryDataRpc::GetRecoveryDataRpc(Context* context,
  * Wait for a getRecoveryData RPC to complete, and throw exceptions for
  * any errors.
  *
+ * \param[out] entriesVerified
+ *      If not NULL, set to true if the backup checked the checksums of all
+ *      of the entries in the recovery segment, otherwise false.
  * \return
  *      Certificate for the recovery segment which was populated
  *      into the response Buffer given at the start of this rpc call.
@@ -170,12 +175,14 @@ GetRecoveryDataRpc::GetRecoveryDataRpc(Context* context,
  *      if it ever existed, it has since crashed.
  */
 SegmentCertificate
-GetRecoveryDataRpc::wait()
+GetRecoveryDataRpc::wait(bool* entriesVerified)
 {
     waitAndCheckErrors();
     const WireFormat::BackupGetRecoveryData::Response* respHdr(
             getResponseHeader<WireFormat::BackupGetRecoveryData>());
     SegmentCertificate certificate = respHdr->certificate;
+    if (entriesVerified)
+        *entriesVerified = respHdr->entriesVerified;
 
     // respHdr off limits.
     response->truncateFront(sizeof(
@@ -227,6 +234,21 @@ RecoveryCompleteRpc::RecoveryCompleteRpc(Context* context, ServerId backupId,
     send();
 }
 
+/**
+ * Wait for a recoveryComplete RPC to complete.
+ *
+ * \param[out] times
+ *      If non-NULL, filled in with the backup's response, which describes
+ *      how long the backup took to prepare the crashed master's data.
+ */
+void
+RecoveryCompleteRpc::wait(WireFormat::BackupRecoveryComplete::Response* times)
+{
+    waitAndCheckErrors();
+    if (times != NULL)
+        *times = *getResponseHeader<WireFormat::BackupRecoveryComplete>();
+}
+
 /**
  * This RPC is invoked at the beginning of recovering from a crashed master;
  * it asks a particular backup to begin reading from disk the segment replicas
@@ -602,6 +624,17 @@ BackupClient::writeSegment(Context* context,
  *      Whether this particular replica should be loaded and filtered at the
  *      start of master recovery (as opposed to having it loaded and filtered
  *      on demand. May be reset on each subsequent write.
+ * \param relayTo
+ *      Backups that hold the other replicas of the segment; the backup
+ *      receiving this rpc relays the write to each of them (as a
+ *      non-primary replica) before responding, so the master only has to
+ *      send the data once. See wait() for which relays succeeded.
+ * \param relayCount
+ *      Number of entries in \a relayTo; at most
+ *      WireFormat::BackupWrite::MAX_RELAYS.
+ * \param compress
+ *      If true, the data is sent Lz4 compressed (unless that doesn't make
+ *      it smaller); the backup decompresses it before storing it.
  */
 WriteSegmentRpc::WriteSegmentRpc(Context* context,
                                  ServerId backupId,
@@ -614,7 +647,10 @@ WriteSegmentRpc::WriteSegmentRpc(Context* context,
                                  const SegmentCertificate* certificate,
                                  bool open,
                                  bool close,
-                                 bool primary)
+                                 bool primary,
+                                 const ServerId* relayTo,
+                                 uint32_t relayCount,
+                                 bool compress)
     : ServerIdRpcWrapper(context, backupId,
                          sizeof(WireFormat::BackupWrite::Response))
 {
@@ -633,23 +669,117 @@ WriteSegmentRpc::WriteSegmentRpc(Context* context,
     reqHdr->open = open;
     reqHdr->close = close;
     reqHdr->primary = primary;
-    if (segment)
+    assert(relayCount <= WireFormat::BackupWrite::MAX_RELAYS);
+    reqHdr->relayCount = downCast<uint8_t>(relayCount);
+    for (uint32_t i = 0; i < relayCount; i++)
+        request.emplaceAppend<uint64_t>(relayTo[i].getId());
+    if (segment && compress && length > 0) {
+        CycleCounter<uint64_t> _(
+                &PerfStats::threadStats.replicationCompressionCycles);
+        Buffer source;
+        segment->appendToBuffer(source, offset, length);
+        uint32_t headerLength = request.size();
+        // Only worth sending compressed if it saves a useful amount.
+        uint32_t capacity = length - length / 8;
+        void* compressed = request.alloc(capacity);
+        uint32_t compressedLength = Lz4::compress(source.getRange(0, length),
+                                                  length, compressed,
+                                                  capacity);
+        PerfStats::threadStats.replicationCompressionInputBytes += length;
+        if (compressedLength != 0) {
+            request.truncate(headerLength + compressedLength);
+            reqHdr->compressedLength = compressedLength;
+            PerfStats::threadStats.replicationCompressionOutputBytes +=
+                compressedLength;
+        } else {
+            request.truncate(headerLength);
+            segment->appendToBuffer(request, offset, length);
+            PerfStats::threadStats.replicationCompressionOutputBytes += length;
+        }
+    } else if (segment) {
         segment->appendToBuffer(request, offset, length);
+    }
     CycleCounter<RawMetric> _(&metrics->master.replicationPostingWriteRpcTicks);
     send();
 }
 
+/**
+ * Constructor used by a backup to relay a write it received from a master
+ * to another backup (see the relayTo argument of the other constructor).
+ * The relayed write is identical except that it isn't for a primary
+ * replica and isn't relayed any further.
+ *
+ * \param context
+ *      Overall information about this RAMCloud server.
+ * \param backupId
+ *      Backup that will store the relayed copy of the data.
+ * \param relayedRequest
+ *      Header of the write received from the master.
+ * \param data
+ *      Buffer holding the data to write.
+ * \param dataOffset
+ *      Offset in \a data where the data to write starts (it is
+ *      relayedRequest->compressedLength bytes if that is nonzero, else
+ *      relayedRequest->length bytes; compressed data is relayed as is).
+ *      The bytes are not copied, so they must remain valid until the rpc
+ *      completes.
+ */
+WriteSegmentRpc::WriteSegmentRpc(Context* context,
+                                 ServerId backupId,
+                                 const WireFormat::BackupWrite::Request*
+                                                            relayedRequest,
+                                 Buffer* data,
+                                 uint32_t dataOffset)
+    : ServerIdRpcWrapper(context, backupId,
+                         sizeof(WireFormat::BackupRelayedWrite::Response))
+{
+    WireFormat::BackupWrite::Request* reqHdr(
+            allocHeader<WireFormat::BackupRelayedWrite>(backupId));
+    reqHdr->masterId = relayedRequest->masterId;
+    reqHdr->segmentId = relayedRequest->segmentId;
+    reqHdr->segmentEpoch = relayedRequest->segmentEpoch;
+    reqHdr->offset = relayedRequest->offset;
+    reqHdr->length = relayedRequest->length;
+    reqHdr->certificateIncluded = relayedRequest->certificateIncluded;
+    reqHdr->certificate = relayedRequest->certificate;
+    reqHdr->open = relayedRequest->open;
+    reqHdr->close = relayedRequest->close;
+    reqHdr->primary = false;
+    reqHdr->relayCount = 0;
+    reqHdr->compressedLength = relayedRequest->compressedLength;
+    request.appendExternal(data, dataOffset,
+                           reqHdr->compressedLength != 0
+                                ? reqHdr->compressedLength
+                                : relayedRequest->length);
+    send();
+}
+
 /**
  * Wait for a writeSegment RPC to complete.
  *
+ * \param[out] writeBuffersInUse
+ *      If not NULL, the number of replicas the backup reported having
+ *      buffered waiting to be written to storage is returned here (see
+ *      BackupStorage::getWriteBuffersInUse()).
+ * \return
+ *      A bit mask with bit i set if the write was durably relayed to
+ *      the i-th backup in the relayTo list passed to the constructor.
+ *      Relays that failed must be retried by sending the write to those
+ *      backups directly.
+ *
  * \throw ServerNotUpException
  *      The intended server for this RPC is not part of the cluster;
  *      if it ever existed, it has since crashed.
  */
-void
-WriteSegmentRpc::wait()
+uint32_t
+WriteSegmentRpc::wait(uint32_t* writeBuffersInUse)
 {
     waitAndCheckErrors();
+    const WireFormat::BackupWrite::Response* respHdr(
+            getResponseHeader<WireFormat::BackupWrite>());
+    if (writeBuffersInUse != NULL)
+        *writeBuffersInUse = respHdr->writeBuffersInUse;
+    return respHdr->relayedMask;
 }
 
 } // namespace RAMCloud
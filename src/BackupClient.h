@@ -59,7 +59,7 @@ class GetRecoveryDataRpc : public ServerIdRpcWrapper {
                        uint64_t partitionId,
                        Buffer* responseBuffer);
     ~GetRecoveryDataRpc() {}
-    SegmentCertificate wait();
+    SegmentCertificate wait(bool* entriesVerified = NULL);
 
   PRIVATE:
     DISALLOW_COPY_AND_ASSIGN(GetRecoveryDataRpc);
@@ -74,8 +74,7 @@ class RecoveryCompleteRpc : public ServerIdRpcWrapper {
     RecoveryCompleteRpc(Context* context, ServerId backupId,
             ServerId masterId);
     ~RecoveryCompleteRpc() {}
-    /// \copydoc ServerIdRpcWrapper::waitAndCheckErrors
-    void wait() {waitAndCheckErrors();}
+    void wait(WireFormat::BackupRecoveryComplete::Response* times = NULL);
 
   PRIVATE:
     DISALLOW_COPY_AND_ASSIGN(RecoveryCompleteRpc);
@@ -191,9 +190,14 @@ class WriteSegmentRpc : public ServerIdRpcWrapper {
                     uint64_t segmentId, uint64_t segmentEpoch,
                     const Segment* segment, uint32_t offset, uint32_t length,
                     const SegmentCertificate* certificate,
-                    bool open, bool close, bool primary);
+                    bool open, bool close, bool primary,
+                    const ServerId* relayTo = NULL, uint32_t relayCount = 0,
+                    bool compress = false);
+    WriteSegmentRpc(Context* context, ServerId backupId,
+                    const WireFormat::BackupWrite::Request* relayedRequest,
+                    Buffer* data, uint32_t dataOffset);
     ~WriteSegmentRpc() {}
-    void wait();
+    uint32_t wait(uint32_t* writeBuffersInUse = NULL);
 
   PRIVATE:
     DISALLOW_COPY_AND_ASSIGN(WriteSegmentRpc);
@@ -50,11 +50,22 @@ enum { DISABLE_BACKGROUND_BUILDING = false };
  * \param segmentSize
  *      Size of the replicas on storage. Needed for bounds-checking on the
  *      SegmentIterators which walk the stored replicas.
+ * \param builderThreadCount
+ *      Number of threads to filter primary replicas with in parallel once
+ *      partitions arrive; each partitions a different replica straight from
+ *      its loaded frame. If 0, primaries are filtered one at a time on the
+ *      task queue thread.
+ * \param verifyChecksums
+ *      If true, check the checksums of the entries in each recovery segment
+ *      once it's built; a replica with a corrupt entry fails to recover, so
+ *      recovery masters get the segment from another replica instead.
  */
 BackupMasterRecovery::BackupMasterRecovery(TaskQueue& taskQueue,
                                            uint64_t recoveryId,
                                            ServerId crashedMasterId,
-                                           uint32_t segmentSize)
+                                           uint32_t segmentSize,
+                                           uint32_t builderThreadCount,
+                                           bool verifyChecksums)
     : Task(taskQueue)
     , recoveryId(recoveryId)
     , crashedMasterId(crashedMasterId)
@@ -63,6 +74,7 @@ BackupMasterRecovery::BackupMasterRecovery(TaskQueue& taskQueue,
     , numPartitions()
     , replicas()
     , nextToBuild()
+    , urgentPrimaries()
     , firstSecondaryReplica()
     , numPrimaries(0)
     , segmentIdToReplica()
@@ -75,11 +87,28 @@ BackupMasterRecovery::BackupMasterRecovery(TaskQueue& taskQueue,
     , recoveryTicks()
     , readingDataTicks()
     , buildingStartTicks()
+    , startTicks()
+    , filterDoneTicks()
+    , filterTicks(0)
+    , builderThreadCount(builderThreadCount)
+    , verifyChecksums(verifyChecksums)
+    , builders()
+    , buildMutex()
+    , primariesBuilt(0)
+    , stopBuilding(false)
     , testingExtractDigest()
     , testingSkipBuild()
 {
 }
 
+/**
+ * Wait for any builder threads to finish the replicas they are filtering.
+ */
+BackupMasterRecovery::~BackupMasterRecovery()
+{
+    stopBuilders();
+}
+
 /**
  * Extract the details of all the replicas stored for the crashed master,
  * returning them for the coordinator to perform an inventory of the log,
@@ -116,6 +145,7 @@ BackupMasterRecovery::start(const std::vector<BackupStorage::FrameRef>& frames,
 
     recoveryTicks.construct(&metrics->backup.recoveryTicks);
     metrics->backup.recoveryCount++;
+    startTicks = Cycles::rdtsc();
 
     vector<BackupStorage::FrameRef> primaries;
     vector<BackupStorage::FrameRef> secondaries;
@@ -240,6 +270,16 @@ BackupMasterRecovery::setPartitionsAndSchedule(
     LOG(DEBUG, "Kicked off building recovery segments");
     nextToBuild = replicas.begin();
     buildingStartTicks = Cycles::rdtsc();
+    if (!DISABLE_BACKGROUND_BUILDING) {
+        uint32_t threads = downCast<uint32_t>(
+                std::min<size_t>(builderThreadCount, numPrimaries));
+        for (uint32_t i = 0; i < threads; i++)
+            builders.emplace_back(&BackupMasterRecovery::builderMain, this);
+        if (threads > 0) {
+            LOG(NOTICE, "Filtering %lu primary replicas with %u threads",
+                numPrimaries, threads);
+        }
+    }
     schedule();
 }
 
@@ -273,6 +313,9 @@ BackupMasterRecovery::setPartitionsAndSchedule(
  *      recovery masters to check the integrity of the metadata of the
  *      returned recovery segment and to iterate over it. May be null for
  *      testing.
+ * \param[out] entriesVerified
+ *      If not NULL, set to true if the checksums of all of the entries in
+ *      the returned recovery segment have been checked, otherwise false.
  * \return
  *      Status code: STATUS_OK if the recovery segment was appended,
  *      STATUS_RETRY if the caller should try again later.
@@ -289,7 +332,8 @@ BackupMasterRecovery::getRecoverySegment(uint64_t recoveryId,
                                          uint64_t segmentId,
                                          int partitionId,
                                          Buffer* buffer,
-                                         SegmentCertificate* certificate)
+                                         SegmentCertificate* certificate,
+                                         bool* entriesVerified)
 {
     if (this->recoveryId != recoveryId) {
         LOG(ERROR, "Requested recovery segment from recovery %lu, but current "
@@ -317,6 +361,14 @@ BackupMasterRecovery::getRecoverySegment(uint64_t recoveryId,
     if (!replica->built) {
         LOG(DEBUG, "Deferring because <%s,%lu> not yet filtered",
             crashedMasterId.toString().c_str(), segmentId);
+        // A recovery master is blocked on this replica, so load and filter
+        // it before the replicas nobody has asked for yet.
+        std::lock_guard<std::mutex> _(buildMutex);
+        if (!replica->claimed && !replica->urgent) {
+            replica->urgent = true;
+            urgentPrimaries.push_back(replica);
+            replica->frame->startLoadingUrgently();
+        }
         throw RetryException(HERE, 5000, 10000,
                 "desired segment not yet filtered");
     }
@@ -344,6 +396,8 @@ BackupMasterRecovery::getRecoverySegment(uint64_t recoveryId,
         replica->recoverySegments[partitionId].appendToBuffer(*buffer);
     if (certificate)
         replica->recoverySegments[partitionId].getAppendedLength(certificate);
+    if (entriesVerified)
+        *entriesVerified = verifyChecksums && !testingSkipBuild;
 
     return STATUS_OK;
 }
@@ -379,13 +433,37 @@ BackupMasterRecovery::getRecoveryId()
     return recoveryId;
 }
 
+/**
+ * Describe how long this backup has taken to prepare the crashed master's
+ * data, for the coordinator's report on the recovery (see RecoveryTimeline).
+ *
+ * \param[out] times
+ *      The timing fields of this response are filled in.
+ */
+void
+BackupMasterRecovery::getTimes(
+        WireFormat::BackupRecoveryComplete::Response* times)
+{
+    times->primaryReplicas = downCast<uint32_t>(numPrimaries);
+    if (buildingStartTicks != 0) {
+        times->partitionWaitMicros =
+                Cycles::toMicroseconds(buildingStartTicks - startTicks);
+    }
+    if (filterDoneTicks != 0) {
+        times->filterDoneMicros =
+                Cycles::toMicroseconds(filterDoneTicks - buildingStartTicks);
+    }
+    times->filterMicros = Cycles::toMicroseconds(filterTicks);
+}
+
 /**
  * Check to see if a primary replica is finished loading from disk and, if so,
  * build the recovery segments. Invoked by a task queue in a separate thread
  * from the backup worker thread so building recovery segments for primary
  * replicas is done in the background. Works down #replicas in order starting
  * at the beginning (which #nextToBuild is initially set to in start()) until
- * the end of #replicas or a secondary replica is encountered.
+ * the end of #replicas or a secondary replica is encountered, except that
+ * replicas recovery masters are waiting for go first (see claimPrimary()).
  */
 void
 BackupMasterRecovery::performTask()
@@ -403,10 +481,21 @@ BackupMasterRecovery::performTask()
     if (DISABLE_BACKGROUND_BUILDING)
         return;
 
-    if (nextToBuild == firstSecondaryReplica) {
+    if (!builders.empty()) {
+        // The builders do the filtering; just wait for them to finish.
+        if (primariesBuilt < numPrimaries) {
+            schedule();
+            return;
+        }
+        stopBuilders();
+    }
+
+    Replica* replica = claimPrimary(true);
+    if (replica == NULL && nextToBuild == firstSecondaryReplica) {
         readingDataTicks.destroy();
+        filterDoneTicks = Cycles::rdtsc();
         uint64_t ns =
-            Cycles::toNanoseconds(Cycles::rdtsc() - buildingStartTicks);
+            Cycles::toNanoseconds(filterDoneTicks - buildingStartTicks);
         LOG(NOTICE, "Took %lu ms to filter %lu primary replicas",
             ns / 1000 / 1000, numPrimaries);
         return;
@@ -414,17 +503,16 @@ BackupMasterRecovery::performTask()
 
     schedule();
 
-    if (!nextToBuild->frame->isLoaded()) {
+    if (replica == NULL) {
         // Can't afford to log here at any level; generates tons of logging.
         return;
     }
     LOG(DEBUG, "Starting to build recovery segments for (<%s,%lu>)",
-        crashedMasterId.toString().c_str(), nextToBuild->metadata->segmentId);
-    buildRecoverySegments(*nextToBuild);
+        crashedMasterId.toString().c_str(), replica->metadata->segmentId);
+    buildRecoverySegments(*replica);
     LOG(DEBUG, "Done building recovery segments for (<%s,%lu>)",
-        crashedMasterId.toString().c_str(), nextToBuild->metadata->segmentId);
-    nextToBuild->frame->unload();
-    ++nextToBuild;
+        crashedMasterId.toString().c_str(), replica->metadata->segmentId);
+    replica->frame->unload();
 }
 
 // - private -
@@ -541,6 +629,10 @@ BackupMasterRecovery::buildRecoverySegments(Replica& replica)
                                           numPartitions,
                                           *partitions,
                                           recoverySegments.get());
+            if (verifyChecksums) {
+                RecoverySegmentBuilder::verifyEntries(recoverySegments.get(),
+                                                      numPartitions);
+            }
         }
     } catch (const Exception& e) {
         // Can throw SegmentIteratorException or SegmentRecoveryFailedException.
@@ -556,15 +648,94 @@ BackupMasterRecovery::buildRecoverySegments(Replica& replica)
         return;
     }
 
+    uint64_t ticks = Cycles::rdtsc() - start;
+    filterTicks += ticks;
     LOG(DEBUG, "<%s,%lu> recovery segments took %lu ms to construct, "
                "notifying other threads",
         crashedMasterId.toString().c_str(), replica.metadata->segmentId,
-        Cycles::toNanoseconds(Cycles::rdtsc() - start) / 1000 / 1000);
+        Cycles::toNanoseconds(ticks) / 1000 / 1000);
     replica.recoverySegments = std::move(recoverySegments);
     Fence::sfence();
     replica.built = true;
 }
 
+/**
+ * Main loop for each of the #builders: repeatedly claim the next primary
+ * replica that no other thread has claimed, wait for it to be loaded, and
+ * filter it. Returns once all primaries have been claimed or
+ * stopBuilders() is called.
+ */
+void
+BackupMasterRecovery::builderMain()
+{
+    while (!stopBuilding) {
+        Replica* replica = claimPrimary(false);
+        if (replica == NULL)
+            return;
+        LOG(DEBUG, "Starting to build recovery segments for (<%s,%lu>)",
+            crashedMasterId.toString().c_str(), replica->metadata->segmentId);
+        buildRecoverySegments(*replica);
+        replica->frame->unload();
+        ++primariesBuilt;
+    }
+}
+
+/**
+ * Choose the next primary replica to filter, and mark it as claimed so no
+ * one else filters it. Replicas that recovery masters are waiting for come
+ * first (see #urgentPrimaries); the others are taken in the order of
+ * #replicas.
+ *
+ * \param loadedOnly
+ *      If true, only choose a replica that has finished loading, so that
+ *      filtering it won't block.
+ * \return
+ *      The claimed replica, or NULL if none is left (or, if \a loadedOnly,
+ *      none of the candidates is loaded yet).
+ */
+BackupMasterRecovery::Replica*
+BackupMasterRecovery::claimPrimary(bool loadedOnly)
+{
+    std::lock_guard<std::mutex> _(buildMutex);
+    Replica* replica = NULL;
+    auto it = urgentPrimaries.begin();
+    while (it != urgentPrimaries.end()) {
+        if ((*it)->claimed) {
+            it = urgentPrimaries.erase(it);
+        } else if (!loadedOnly || (*it)->frame->isLoaded()) {
+            replica = *it;
+            urgentPrimaries.erase(it);
+            break;
+        } else {
+            ++it;
+        }
+    }
+    if (replica == NULL && nextToBuild != firstSecondaryReplica &&
+            (!loadedOnly || nextToBuild->frame->isLoaded())) {
+        replica = &*nextToBuild;
+    }
+    if (replica != NULL)
+        replica->claimed = true;
+
+    // Skip replicas that were claimed out of order.
+    while (nextToBuild != firstSecondaryReplica && nextToBuild->claimed)
+        ++nextToBuild;
+    return replica;
+}
+
+/**
+ * Ask the #builders to exit once they finish their current replica, and
+ * wait for them to do so.
+ */
+void
+BackupMasterRecovery::stopBuilders()
+{
+    stopBuilding = true;
+    foreach (auto& builder, builders)
+        builder.join();
+    builders.clear();
+}
+
 // -- BackupMasterRecovery --
 
 BackupMasterRecovery::Replica::Replica(const BackupStorage::FrameRef& frame)
@@ -573,6 +744,8 @@ BackupMasterRecovery::Replica::Replica(const BackupStorage::FrameRef& frame)
     , recoverySegments()
     , recoveryException()
     , built()
+    , claimed(false)
+    , urgent(false)
 {
 }
 
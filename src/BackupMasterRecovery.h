@@ -16,6 +16,9 @@
 #ifndef RAMCLOUD_BACKUPMASTERRECOVERY_H
 #define RAMCLOUD_BACKUPMASTERRECOVERY_H
 
+#include <atomic>
+#include <thread>
+
 #include "Common.h"
 #include "BackupStorage.h"
 #include "Log.h"
@@ -58,7 +61,10 @@ class BackupReplicaMetadata;
  * 2) Calls to performTask() are serialized.
  * 3) FrameRefs delivered to start() remain valid until destruction.
  *
- * Primary replicas are ONLY filtered by the task queue thread serially.
+ * Primary replicas are ONLY filtered by the task queue thread serially,
+ * unless builder threads were requested at construction, in which case
+ * they are ONLY filtered by those threads, each of which claims the next
+ * unfiltered primary (under #buildMutex) and filters it alone.
  * Secondary replicas are ONLY filtered by the sole backup worked thread
  * (and, hence, serially, as well).
  * The only miniscule synchronization it to ensure that all built
@@ -76,7 +82,10 @@ class BackupMasterRecovery : public Task {
     BackupMasterRecovery(TaskQueue& taskQueue,
                          uint64_t recoveryId,
                          ServerId crashedMasterId,
-                         uint32_t segmentSize);
+                         uint32_t segmentSize,
+                         uint32_t builderThreadCount = 0,
+                         bool verifyChecksums = false);
+    ~BackupMasterRecovery();
     void start(const std::vector<BackupStorage::FrameRef>& frames,
                Buffer* buffer,
                StartResponse* response);
@@ -85,9 +94,11 @@ class BackupMasterRecovery : public Task {
                               uint64_t segmentId,
                               int partitionId,
                               Buffer* buffer,
-                              SegmentCertificate* certificate);
+                              SegmentCertificate* certificate,
+                              bool* entriesVerified = NULL);
     void free();
     uint64_t getRecoveryId();
+    void getTimes(WireFormat::BackupRecoveryComplete::Response* times);
     void performTask();
 
   PRIVATE:
@@ -95,6 +106,9 @@ class BackupMasterRecovery : public Task {
                                StartResponse* response);
     struct Replica;
     void buildRecoverySegments(Replica& replica);
+    void builderMain();
+    Replica* claimPrimary(bool loadedOnly);
+    void stopBuilders();
     bool getLogDigest(Replica& replica, Buffer* digestBuffer);
 
     /**
@@ -204,6 +218,20 @@ class BackupMasterRecovery : public Task {
          */
         bool built;
 
+        /**
+         * Set once performTask() or one of the #builders has taken on
+         * filtering this primary replica. Primaries aren't always filtered
+         * in order (see #urgentPrimaries), so this keeps any of them from
+         * being filtered twice. Protected by #buildMutex.
+         */
+        bool claimed;
+
+        /**
+         * Set once this primary replica has been added to
+         * #urgentPrimaries. Protected by #buildMutex.
+         */
+        bool urgent;
+
         DISALLOW_COPY_AND_ASSIGN(Replica);
     };
 
@@ -224,10 +252,20 @@ class BackupMasterRecovery : public Task {
     /**
      * Tracks which primary replica is the next to be filtered in the
      * background. Set initially in start() when replicas is constructed,
-     * and used/incremented in performTask() as replicas are filtered.
+     * and used/incremented in performTask() as replicas are filtered
+     * (or in builderMain(), under #buildMutex, if there are #builders).
      */
     std::deque<Replica>::iterator nextToBuild;
 
+    /**
+     * Primary replicas that a recovery master asked for before they were
+     * filtered (and was told to retry), in the order they were asked for.
+     * These are what the recovery masters are blocked on, so they are
+     * loaded with high priority and filtered ahead of the others
+     * (see claimPrimary()). Protected by #buildMutex.
+     */
+    std::deque<Replica*> urgentPrimaries;
+
     /**
      * Points to the first secondary replica in #replicas. Lets background
      * filtering know where it should stop when pre-loading/filtering replicas.
@@ -310,6 +348,44 @@ class BackupMasterRecovery : public Task {
      */
     uint64_t buildingStartTicks;
 
+    /// Cycles::rdtsc time when start() was first invoked.
+    uint64_t startTicks;
+
+    /// Cycles::rdtsc time when all of the primary replicas had been
+    /// filtered, or 0 if they haven't been yet.
+    uint64_t filterDoneTicks;
+
+    /// Total time (in Cycles::rdtsc ticks) spent filtering replicas by all
+    /// threads.
+    std::atomic<uint64_t> filterTicks;
+
+    /**
+     * Number of threads to filter primary replicas in parallel, started
+     * when partitions arrive. If 0 then primaries are filtered one at a
+     * time by performTask() instead.
+     */
+    const uint32_t builderThreadCount;
+
+    /**
+     * If true, the checksum of every entry in each recovery segment is
+     * checked after the segment is built, and recovery masters are told
+     * that they needn't check the entries again (see
+     * RecoverySegmentBuilder::verifyEntries).
+     */
+    const bool verifyChecksums;
+
+    /// Threads running builderMain(); empty until partitions arrive.
+    std::vector<std::thread> builders;
+
+    /// Serializes the #builders' claims on #nextToBuild.
+    std::mutex buildMutex;
+
+    /// Number of primary replicas the #builders have finished filtering.
+    std::atomic<size_t> primariesBuilt;
+
+    /// Set to ask the #builders to exit after their current replica.
+    std::atomic<bool> stopBuilding;
+
     /**
      * If set call this function instead of
      * RecoverySegmentBuilder::extractDigest() during start().
@@ -276,11 +276,49 @@ TEST_F(BackupMasterRecoveryTest, getRecoverySegment) {
     buffer.reset();
     SegmentCertificate certificate;
     memset(&certificate, 0xff, sizeof(certificate));
-    status = recovery->getRecoverySegment(456, 88, 0, &buffer, &certificate);
+    bool entriesVerified = true;
+    status = recovery->getRecoverySegment(456, 88, 0, &buffer, &certificate,
+                                          &entriesVerified);
     EXPECT_EQ(STATUS_OK, status);
     EXPECT_EQ(12lu, certificate.segmentLength);
     EXPECT_STREQ("important",
                  buffer.getOffset<char>(buffer.size() - 10));
+    EXPECT_FALSE(entriesVerified);
+}
+
+TEST_F(BackupMasterRecoveryTest, getRecoverySegment_waitingForPrimary) {
+    mockMetadata(88, true, true);
+    mockMetadata(89, true, true);
+    recovery->testingSkipBuild = true;
+    recovery->start(frames, NULL, NULL);
+    recovery->setPartitionsAndSchedule(partitions);
+    // Primaries are filtered newest first, so 88 would normally be last.
+    EXPECT_EQ(89lu, recovery->nextToBuild->metadata->segmentId);
+
+    EXPECT_THROW(recovery->getRecoverySegment(456, 88, 0, NULL, NULL),
+                 RetryException);
+    EXPECT_THROW(recovery->getRecoverySegment(456, 88, 1, NULL, NULL),
+                 RetryException);
+    EXPECT_EQ(1u, recovery->urgentPrimaries.size());
+
+    TestLog::Enable _("performTask");
+    taskQueue.performTask();
+    EXPECT_EQ("performTask: Starting to build recovery segments for "
+              "(<99.0,88>) | "
+              "performTask: Done building recovery segments for (<99.0,88>)",
+              TestLog::get());
+    EXPECT_EQ(STATUS_OK,
+              recovery->getRecoverySegment(456, 88, 0, NULL, NULL));
+    EXPECT_EQ(89lu, recovery->nextToBuild->metadata->segmentId);
+
+    TestLog::reset();
+    taskQueue.performTask();
+    taskQueue.performTask();
+    EXPECT_EQ("performTask: Starting to build recovery segments for "
+              "(<99.0,89>) | "
+              "performTask: Done building recovery segments for (<99.0,89>) | "
+              "performTask: Took 0 ms to filter 2 primary replicas",
+              TestLog::get());
 }
 
 TEST_F(BackupMasterRecoveryTest, getRecoverySegment_exceptionDuringBuild) {
@@ -343,6 +381,41 @@ TEST_F(BackupMasterRecoveryTest, performTask) {
         TestLog::get());
 }
 
+TEST_F(BackupMasterRecoveryTest, performTask_builderThreads) {
+    recovery.construct(taskQueue, 456lu, ServerId{99, 0}, segmentSize, 2);
+    mockMetadata(88, true, true);
+    mockMetadata(89, true, true);
+    mockMetadata(90, true, true);
+    mockMetadata(91, true, false);
+    recovery->testingSkipBuild = true;
+    recovery->start(frames, NULL, NULL);
+    recovery->setPartitionsAndSchedule(partitions);
+    EXPECT_EQ(2U, recovery->builders.size());
+    while (!recovery->builders.empty())
+        taskQueue.performTask();
+    EXPECT_EQ(3U, recovery->primariesBuilt);
+    foreach (auto& replica, recovery->replicas) {
+        EXPECT_EQ(replica.metadata->primary, replica.built)
+            << replica.metadata->segmentId;
+    }
+    TestLog::Enable _;
+    taskQueue.performTask();
+    EXPECT_EQ("performTask: Took 0 ms to filter 3 primary replicas",
+        TestLog::get());
+}
+
+TEST_F(BackupMasterRecoveryTest, destructor_joinsBuilders) {
+    recovery.construct(taskQueue, 456lu, ServerId{99, 0}, segmentSize, 4);
+    mockMetadata(88, true, true);
+    recovery->testingSkipBuild = true;
+    recovery->start(frames, NULL, NULL);
+    recovery->setPartitionsAndSchedule(partitions);
+    // Only as many threads as primaries.
+    EXPECT_EQ(1U, recovery->builders.size());
+    // Destruction waits for the builder.
+    recovery.destroy();
+}
+
 namespace {
 bool buildRecoverySegmentsFilter(string s) {
     return s == "buildRecoverySegments";
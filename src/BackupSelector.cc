@@ -155,6 +155,41 @@ BackupSelector::signalFreedPrimary(const ServerId backupId)
     --stats->primaryReplicaCount;
 }
 
+/**
+ * Inform the BackupSelector that a write rpc to a backup has completed, so
+ * that it can track how loaded each backup is (see
+ * LoadAwareBackupSelector).
+ * \param backupId
+ *      The ServerId of the backup the write went to.
+ * \param latencyCycles
+ *      How long the write rpc took, in cycles.
+ * \param writeBuffersInUse
+ *      Number of replicas the backup reported having buffered waiting to be
+ *      written to storage.
+ */
+void
+BackupSelector::signalWriteCompleted(const ServerId backupId,
+                                     uint64_t latencyCycles,
+                                     uint32_t writeBuffersInUse)
+{
+    BackupStats* stats;
+    try {
+        stats = tracker[backupId];
+    } catch (const Exception&) {
+        // The backup has been removed from the cluster since the rpc was
+        // sent.
+        return;
+    }
+    if (stats == NULL)
+        return;
+    if (stats->writeLatencyCycles == 0)
+        stats->writeLatencyCycles = latencyCycles;
+    else
+        stats->writeLatencyCycles =
+            (stats->writeLatencyCycles * 7 + latencyCycles) / 8;
+    stats->writeBuffersInUse = writeBuffersInUse;
+}
+
 // - private -
 
 /**
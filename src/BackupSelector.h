@@ -33,6 +33,8 @@ struct BackupStats {
         : primaryReplicaCount(0)
         , expectedReadMBytesPerSec(0)
         , replicationId(0)
+        , writeLatencyCycles(0)
+        , writeBuffersInUse(0)
     {}
 
     uint32_t getExpectedReadMs();
@@ -45,6 +47,14 @@ struct BackupStats {
 
     /// Replication group Id of the backup.
     uint64_t replicationId;
+
+    /// Moving average of the time (in cycles) this master's write rpcs to
+    /// the backup have taken recently; 0 until the first one completes.
+    uint64_t writeLatencyCycles;
+
+    /// Number of replicas the backup had buffered waiting to be written to
+    /// storage, as of its most recent write rpc response.
+    uint32_t writeBuffersInUse;
 };
 
 /// Tracks BackupStats; a ReplicaManager processes ServerListChanges.
@@ -60,6 +70,9 @@ class BaseBackupSelector {
     virtual ServerId selectSecondary(uint32_t numBackups,
                                      const ServerId backupIds[]) = 0;
     virtual void signalFreedPrimary(const ServerId backupId) = 0;
+    virtual void signalWriteCompleted(const ServerId backupId,
+                                      uint64_t latencyCycles,
+                                      uint32_t writeBuffersInUse) {}
     virtual ~BaseBackupSelector() {}
 };
 
@@ -77,6 +90,9 @@ class BackupSelector : public BaseBackupSelector {
     virtual ServerId selectSecondary(uint32_t numBackups,
                                      const ServerId backupIds[]);
     void signalFreedPrimary(const ServerId backupId);
+    void signalWriteCompleted(const ServerId backupId,
+                              uint64_t latencyCycles,
+                              uint32_t writeBuffersInUse);
 
   PROTECTED:
     void applyTrackerChanges();
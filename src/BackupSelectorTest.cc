@@ -250,6 +250,23 @@ TEST_F(BackupSelectorTest, signalFreedPrimary) {
     EXPECT_EQ(9u, stats->primaryReplicaCount);
 }
 
+TEST_F(BackupSelectorTest, signalWriteCompleted) {
+    MockRandom _(1);
+    std::vector<ServerId> ids;
+    addEqualHosts(ids);
+    ServerId backup = selector->selectSecondary(0, NULL);
+    BackupStats *stats = selector->tracker[backup];
+    selector->signalWriteCompleted(backup, 800, 2);
+    EXPECT_EQ(800u, stats->writeLatencyCycles);
+    EXPECT_EQ(2u, stats->writeBuffersInUse);
+    selector->signalWriteCompleted(backup, 1600, 0);
+    EXPECT_EQ(900u, stats->writeLatencyCycles);
+    EXPECT_EQ(0u, stats->writeBuffersInUse);
+
+    // Unknown backups are ignored.
+    selector->signalWriteCompleted(ServerId(99, 0), 800, 2);
+}
+
 #if 0
 // This test should run forever, hence why it is commented out.
 // Occasionally, when self-doubt mounts, it is worth running, though.
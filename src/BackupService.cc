@@ -18,11 +18,15 @@
 #include "ClientException.h"
 #include "Cycles.h"
 #include "InMemoryStorage.h"
+#include "Lz4.h"
 #include "PerfStats.h"
+#include "PmemStorage.h"
 #include "ServerConfig.h"
 #include "ShortMacros.h"
 #include "SingleFileStorage.h"
 #include "Status.h"
+#include "StringUtil.h"
+#include "StripedStorage.h"
 
 namespace RAMCloud {
 
@@ -63,6 +67,11 @@ BackupService::BackupService(Context* context,
         storage.reset(new InMemoryStorage(config->segmentSize,
                                           config->backup.numSegmentFrames,
                                           config->backup.writeRateLimit));
+    } else if (config->backup.persistentMemory) {
+        storage.reset(new PmemStorage(config->segmentSize,
+                                      config->backup.numSegmentFrames,
+                                      config->backup.writeRateLimit,
+                                      config->backup.file.c_str()));
     } else {
         size_t maxWriteBuffers = config->backup.maxNonVolatileBuffers;
         if (maxWriteBuffers == 0) {
@@ -73,12 +82,28 @@ BackupService::BackupService(Context* context,
             maxWriteBuffers = config->backup.numSegmentFrames;
         }
 
-        storage.reset(new SingleFileStorage(config->segmentSize,
-                                            config->backup.numSegmentFrames,
-                                            config->backup.writeRateLimit,
-                                            maxWriteBuffers,
-                                            config->backup.file.c_str(),
-                                            O_DIRECT | O_SYNC));
+        // A comma-separated list of files means one file per device,
+        // with replicas striped across them.
+        std::vector<string> files = StringUtil::split(config->backup.file,
+                                                      ',');
+        if (files.size() > 1) {
+            storage.reset(new StripedStorage(config->segmentSize,
+                                             config->backup.numSegmentFrames,
+                                             config->backup.writeRateLimit,
+                                             maxWriteBuffers,
+                                             files,
+                                             O_DIRECT | O_SYNC,
+                                             config->backup.mapReplicaLoads));
+        } else {
+            storage.reset(new SingleFileStorage(
+                    config->segmentSize,
+                    config->backup.numSegmentFrames,
+                    config->backup.writeRateLimit,
+                    maxWriteBuffers,
+                    config->backup.file.c_str(),
+                    O_DIRECT | O_SYNC,
+                    config->backup.mapReplicaLoads));
+        }
     }
     if (storage->getMetadataSize() < sizeof(BackupReplicaMetadata))
         DIE("Storage metadata block too small to hold BackupReplicaMetadata");
@@ -215,6 +240,10 @@ BackupService::dispatch(WireFormat::Opcode opcode, Rpc* rpc)
             callHandler<WireFormat::BackupWrite, BackupService,
                         &BackupService::writeSegment>(rpc);
             break;
+        case WireFormat::BackupRelayedWrite::opcode:
+            callHandler<WireFormat::BackupRelayedWrite, BackupService,
+                        &BackupService::writeSegment>(rpc);
+            break;
         default:
             throw UnimplementedRequestError(HERE);
     }
@@ -292,13 +321,16 @@ BackupService::getRecoveryData(
         throw BackupBadSegmentIdException(HERE);
     }
 
+    bool entriesVerified = false;
     Status status =
         recoveryIt->second->getRecoverySegment(reqHdr->recoveryId,
                                                reqHdr->segmentId,
                                                downCast<int>(
                                                    reqHdr->partitionId),
                                                rpc->replyPayload,
-                                               &respHdr->certificate);
+                                               &respHdr->certificate,
+                                               &entriesVerified);
+    respHdr->entriesVerified = entriesVerified;
     if (status != STATUS_OK) {
         respHdr->common.status = status;
         return;
@@ -364,6 +396,7 @@ BackupService::recoveryComplete(
     if (recoveryIt != recoveries.end()) {
         BackupMasterRecovery* recovery = recoveryIt->second;
         recoveries.erase(recoveryIt);
+        recovery->getTimes(respHdr);
         recovery->free();
     }
     rpc->sendReply();
@@ -477,7 +510,11 @@ BackupService::startReadingData(
         recovery = new BackupMasterRecovery(taskQueue,
                                             reqHdr->recoveryId,
                                             crashedMasterId,
-                                            segmentSize);
+                                            segmentSize,
+                                            config->backup.
+                                                recoveryBuilderThreads,
+                                            config->backup.
+                                                verifyRecoveryChecksums);
         recoveries[crashedMasterId] = recovery;
     }
     recovery = recoveries[crashedMasterId];
@@ -547,14 +584,17 @@ BackupService::startPartitioningReplicas(
  * segment will be considered closed and immutable and the Backup will
  * use this as a hint to move the segment to appropriate storage.
  *
+ * If the request lists backups to relay to, the write is then relayed to
+ * each of them (see relayWrite()).
+ *
  * \param reqHdr
  *      Header of the Rpc request which contains the Rpc arguments except
  *      the data to be written.
  * \param respHdr
  *      Header for the Rpc response.
  * \param rpc
- *      The Rpc being serviced, used for access to the opaque bytes to
- *      be written which follow reqHdr.
+ *      The Rpc being serviced, used for access to the relay list and
+ *      opaque bytes to be written which follow reqHdr.
  *
  * \throw BackupSegmentOverflowException
  *      If the write request is beyond the end of the segment.
@@ -578,6 +618,14 @@ BackupService::writeSegment(const WireFormat::BackupWrite::Request* reqHdr,
             context->serverList->toString().c_str());
         throw CallerNotInClusterException(HERE);
     }
+    if (reqHdr->relayCount > WireFormat::BackupWrite::MAX_RELAYS)
+        throw RequestFormatError(HERE);
+    uint32_t dataOffset = downCast<uint32_t>(sizeof(*reqHdr) +
+                                             reqHdr->relayCount *
+                                             sizeof(uint64_t));
+    respHdr->writeBuffersInUse =
+        downCast<uint32_t>(storage->getWriteBuffersInUse());
+
     auto frameIt = frames.find({masterId, segmentId});
     BackupStorage::FrameRef frame;
     if (frameIt != frames.end())
@@ -627,6 +675,7 @@ BackupService::writeSegment(const WireFormat::BackupWrite::Request* reqHdr,
             LOG(NOTICE, "Write requested for closed replica <%s,%lu>; "
                 "treating the request as noop",
                 masterId.toString().c_str(), segmentId);
+            relayWrite(reqHdr, respHdr, rpc);
             return;
         }
         CycleCounter<RawMetric> __(&metrics->backup.writeCopyTicks);
@@ -638,7 +687,25 @@ BackupService::writeSegment(const WireFormat::BackupWrite::Request* reqHdr,
                                reqHdr->segmentEpoch,
                                reqHdr->close, reqHdr->primary);
         }
-        frame->append(*rpc->requestPayload, sizeof(*reqHdr),
+        Buffer* source = rpc->requestPayload;
+        uint32_t sourceOffset = dataOffset;
+        Buffer decompressed;
+        if (reqHdr->compressedLength != 0) {
+            const void* compressed = rpc->requestPayload->getRange(
+                    dataOffset, reqHdr->compressedLength);
+            if (compressed == NULL)
+                throw MessageTooShortError(HERE);
+            if (!Lz4::decompress(compressed, reqHdr->compressedLength,
+                                 decompressed.alloc(reqHdr->length),
+                                 reqHdr->length)) {
+                LOG(WARNING, "Compressed write to <%s,%lu> is corrupt",
+                    masterId.toString().c_str(), segmentId);
+                throw RequestFormatError(HERE);
+            }
+            source = &decompressed;
+            sourceOffset = 0;
+        }
+        frame->append(*source, sourceOffset,
                       reqHdr->length, reqHdr->offset,
                       metadata.get(), sizeof(*metadata));
         metrics->backup.writeCopyBytes += reqHdr->length;
@@ -651,6 +718,66 @@ BackupService::writeSegment(const WireFormat::BackupWrite::Request* reqHdr,
         LOG(DEBUG, "Closing <%s,%lu>", masterId.toString().c_str(), segmentId);
         frame->close();
     }
+
+    relayWrite(reqHdr, respHdr, rpc);
+}
+
+/**
+ * Relay a write that has been applied locally to the backups listed in
+ * the request, so that the master only has to send the data for a segment
+ * once rather than once per replica. The relays are sent in parallel and
+ * this returns once all of them have completed (or failed); respHdr's
+ * relayedMask tells the master which backups now have the data, and it
+ * writes to the others itself.
+ *
+ * \param reqHdr
+ *      Header of the write request; reqHdr->relayCount backup ids follow
+ *      it, and then the data.
+ * \param respHdr
+ *      Header for the write's response; relayedMask is filled in.
+ * \param rpc
+ *      The write being serviced.
+ */
+void
+BackupService::relayWrite(const WireFormat::BackupWrite::Request* reqHdr,
+                          WireFormat::BackupWrite::Response* respHdr,
+                          Rpc* rpc)
+{
+    uint32_t relayCount = reqHdr->relayCount;
+    if (relayCount == 0)
+        return;
+    uint32_t relayListOffset = downCast<uint32_t>(sizeof(*reqHdr));
+    uint32_t relayListLength =
+        relayCount * downCast<uint32_t>(sizeof(uint64_t));
+    const uint64_t* relayTo = static_cast<const uint64_t*>(
+        rpc->requestPayload->getRange(relayListOffset, relayListLength));
+    if (relayTo == NULL)
+        throw MessageTooShortError(HERE);
+
+    Tub<WriteSegmentRpc> relays[WireFormat::BackupWrite::MAX_RELAYS];
+    for (uint32_t i = 0; i < relayCount; i++) {
+        relays[i].construct(context, ServerId(relayTo[i]), reqHdr,
+                            rpc->requestPayload,
+                            relayListOffset + relayListLength);
+    }
+
+    // dispatch() holds #mutex, but the backups being relayed to may
+    // themselves be waiting on relays to this backup; release it while
+    // waiting so that can't deadlock. Nothing below touches backup state.
+    mutex.unlock();
+    for (uint32_t i = 0; i < relayCount; i++) {
+        try {
+            relays[i]->wait();
+            respHdr->relayedMask |= 1u << i;
+        } catch (const ClientException& e) {
+            RAMCLOUD_CLOG(NOTICE, "Couldn't relay write of <%s,%lu> to "
+                "backup %s: %s; master will write to it directly",
+                ServerId(reqHdr->masterId).toString().c_str(),
+                reqHdr->segmentId, ServerId(relayTo[i]).toString().c_str(),
+                e.toSymbol());
+        }
+    }
+    mutex.lock();
 }
 
 /**
@@ -698,19 +825,19 @@ BackupService::trackerChangesEnqueued()
 // --- BackupService::GarbageCollectReplicasFoundOnStorageTask ---
 
 /**
- * Try to garbage collect a replica found on disk until it is finally
- * removed. Usually replicas are freed explicitly by masters, but this
- * doesn't work for cases where the replica was found on disk as part
- * of an old master.
+ * Try to garbage collect the replicas of a master found on disk until they
+ * are finally removed. Usually replicas are freed explicitly by masters,
+ * but this doesn't work for cases where the replica was found on disk as
+ * part of an old master.
  *
  * This task may generate RPCs to the master to determine the
- * status of the replica which survived on-storage across backup
+ * status of the replicas which survived on-storage across backup
  * failures.
  *
  * \param service
- *      Backup which is trying to garbage collect the replica.
+ *      Backup which is trying to garbage collect the replicas.
  * \param masterId
- *      Id of the master which originally created the replica.
+ *      Id of the master which originally created the replicas.
  */
 BackupService::
     GarbageCollectReplicasFoundOnStorageTask::
@@ -721,6 +848,7 @@ BackupService::
     , masterId(masterId)
     , segmentIds()
     , rpc()
+    , probing()
 {
 }
 
@@ -745,8 +873,8 @@ BackupService::GarbageCollectReplicasFoundOnStorageTask::
 
 /**
  * Try to make progress in garbage collecting replicas without blocking.
- * Attempts one replica at a time in order to prevent flooding the
- * master this task is associated with.
+ * Only one rpc to the master this task is associated with is outstanding
+ * at a time, in order to prevent flooding it.
  */
 void
 BackupService::GarbageCollectReplicasFoundOnStorageTask::performTask()
@@ -755,41 +883,20 @@ BackupService::GarbageCollectReplicasFoundOnStorageTask::performTask()
         delete this;
         return;
     }
-    uint64_t segmentId = segmentIds.front();
-    bool done = tryToFreeReplica(segmentId);
-    if (done) {
-        segmentIds.pop_front();
-        service.oldReplicas--;
-    }
+    tryToFreeReplicas();
     schedule();
 }
 
 /**
- * Only used internally; try to make progress in garbage collecting one replica
- * without blocking.
- *
- * \param segmentId
- *      Id of the segment of the replica which is on the chopping block. Once
- *      a value is passed as \a segmentId that value must be passed on all
- *      subsequent calls until true is returned.
- * \return
- *      True if no additional work is need to free the segment from storage,
- *      false otherwise. See important notes on \a segmentId.
+ * Only used internally; try to make progress in garbage collecting the
+ * replicas in #segmentIds without blocking. Replicas are removed from
+ * #segmentIds once no additional work is needed to free them from storage;
+ * those the master still needs are moved to the end, to be asked about
+ * again later.
  */
-bool
-BackupService::GarbageCollectReplicasFoundOnStorageTask::
-    tryToFreeReplica(uint64_t segmentId)
+void
+BackupService::GarbageCollectReplicasFoundOnStorageTask::tryToFreeReplicas()
 {
-    // First, see if this replica still needs to be freed.
-    {
-        BackupService::Lock _(service.mutex);
-        auto frameIt = service.frames.find({masterId, segmentId});
-        if (frameIt == service.frames.end()) {
-            // Frame no longer exists; no need to free.
-            return true;
-        }
-    }
-
     // Due to RAM-447 it is a bit tricky to decipher when a server is in
     // crashed status. It is done here outside the context of the
     // ServerNotUpException because of that bug.
@@ -798,58 +905,95 @@ BackupService::GarbageCollectReplicasFoundOnStorageTask::
     {
         // In the server list but not up implies crashed.
         // Since server has crashed just let
-        // GarbageCollectDownServerTask free it. It will get
+        // GarbageCollectDownServerTask free them. It will get
         // scheduled when master recovery finishes for masterId.
         LOG(DEBUG, "Server %s marked crashed; waiting for cluster "
-            "to recover from its failure before freeing <%s,%lu>",
-            masterId.toString().c_str(), masterId.toString().c_str(),
-            segmentId);
-        return true;
-    }
-
-    if (rpc) {
-        if (rpc->isReady()) {
-            bool needed = true;
-            try {
-                needed = rpc->wait();
-            } catch (const ServerNotUpException& e) {
-                needed = false;
-                LOG(DEBUG, "Server %s marked down; cluster has recovered "
-                    "from its failure", masterId.toString().c_str());
-            }
-            rpc.destroy();
-            if (!needed) {
-                LOG(NOTICE, "Server has recovered from lost replica; "
-                    "freeing replica for <%s,%lu> (%d more old replicas left)",
-                    masterId.toString().c_str(), segmentId,
-                    service.oldReplicas-1);
-                deleteReplica(segmentId);
-                return true;
-            } else {
-                LOG(DEBUG, "Server has not recovered from lost "
-                    "replica; retaining replica for <%s,%lu>; will "
-                    "probe replica status again later",
-                    masterId.toString().c_str(), segmentId);
+            "to recover from its failure before freeing %lu replicas",
+            masterId.toString().c_str(), segmentIds.size());
+        rpc.destroy();
+        service.oldReplicas -= downCast<int>(segmentIds.size());
+        segmentIds.clear();
+        return;
+    }
+
+    if (!rpc) {
+        // First, drop the replicas that no longer need to be freed, then
+        // ask about the next batch of the rest.
+        BackupService::Lock _(service.mutex);
+        probing.clear();
+        for (auto it = segmentIds.begin(); it != segmentIds.end(); ) {
+            if (service.frames.find({masterId, *it}) == service.frames.end()) {
+                // Frame no longer exists; no need to free.
+                it = segmentIds.erase(it);
+                service.oldReplicas--;
+                continue;
             }
+            if (probing.size() == MAX_SEGMENT_IDS_PER_RPC)
+                break;
+            probing.push_back(*it);
+            ++it;
         }
-    } else {
-        rpc.construct(service.context, masterId, service.serverId, segmentId);
+        if (!probing.empty()) {
+            rpc.construct(service.context, masterId, service.serverId,
+                    &probing[0], downCast<uint32_t>(probing.size()));
+        }
+        return;
+    }
+
+    if (!rpc->isReady())
+        return;
+    bool needed[MAX_SEGMENT_IDS_PER_RPC];
+    try {
+        rpc->wait(needed);
+    } catch (const ServerNotUpException& e) {
+        std::fill(needed, needed + probing.size(), false);
+        LOG(DEBUG, "Server %s marked down; cluster has recovered "
+            "from its failure", masterId.toString().c_str());
+    }
+    rpc.destroy();
+
+    // The replicas asked about are the first ones in segmentIds.
+    uint32_t freed = 0;
+    uint32_t retained = 0;
+    for (size_t i = 0; i < probing.size(); i++) {
+        segmentIds.pop_front();
+        if (needed[i]) {
+            segmentIds.push_back(probing[i]);
+            retained++;
+            continue;
+        }
+        service.oldReplicas--;
+        if (deleteReplica(probing[i]))
+            freed++;
+    }
+    metrics->backup.oldReplicasFreed += freed;
+    if (freed > 0) {
+        LOG(NOTICE, "Server has recovered from lost replicas; freed %u "
+            "replicas for %s (%d more old replicas left)", freed,
+            masterId.toString().c_str(), service.oldReplicas);
+    }
+    if (retained > 0) {
+        LOG(DEBUG, "Server has not recovered from lost replicas; "
+            "retaining %u replicas for %s; will probe replica status "
+            "again later", retained, masterId.toString().c_str());
     }
-    return false;
 }
 
 /**
  * Only used internally; safely frees a replica and removes metadata about
  * it from the backup's frame map.
+ *
+ * \return
+ *      True if the replica was freed.
  */
-void
+bool
 BackupService::GarbageCollectReplicasFoundOnStorageTask::
     deleteReplica(uint64_t segmentId)
 {
     BackupService::Lock _(service.mutex);
     auto frameIt = service.frames.find({masterId, segmentId});
     if (frameIt == service.frames.end())
-        return;
+        return false;
     if (frameIt->second->wasAppendedToByCurrentProcess()) {
         // This frame has been called back into active service (e.g.
         // its master decided to rereplicate that frame on this
@@ -860,9 +1004,10 @@ BackupService::GarbageCollectReplicasFoundOnStorageTask::
                 "old replicas left)",
                 masterId.toString().c_str(), segmentId,
                 service.oldReplicas-1);
-        return;
+        return false;
     }
     service.frames.erase(frameIt);
+    return true;
 }
 
 // --- BackupService::GarbageCollectDownServerTask ---
@@ -913,12 +1058,19 @@ BackupService::GarbageCollectDownServerTask::performTask()
     }
     auto key = MasterSegmentIdPair(masterId, 0lu);
     auto it = service.frames.upper_bound(key);
-    if (it != service.frames.end() && it->first.masterId == masterId) {
+    uint32_t freed = 0;
+    while (it != service.frames.end() && it->first.masterId == masterId &&
+            freed < MAX_FREES_PER_TASK) {
+        it = service.frames.erase(it);
+        freed++;
+    }
+    if (freed > 0) {
+        metrics->backup.downServerReplicasFreed += freed;
         LOG(DEBUG, "Server %s marked down; cluster has recovered "
-                "from its failure; freeing replica <%s,%lu>",
-            masterId.toString().c_str(), masterId.toString().c_str(),
-            it->first.segmentId);
-        service.frames.erase(it->first);
+                "from its failure; freed %u of its replicas",
+            masterId.toString().c_str(), freed);
+    }
+    if (it != service.frames.end() && it->first.masterId == masterId) {
         schedule();
     } else {
         delete this;
@@ -72,6 +72,9 @@ class BackupService : public Service
     void writeSegment(const WireFormat::BackupWrite::Request* req,
                       WireFormat::BackupWrite::Response* resp,
                       Rpc* rpc);
+    void relayWrite(const WireFormat::BackupWrite::Request* reqHdr,
+                    WireFormat::BackupWrite::Response* respHdr,
+                    Rpc* rpc);
     void gcMain();
     void initOnceEnlisted();
     void trackerChangesEnqueued();
@@ -194,7 +197,8 @@ class BackupService : public Service
      * disk as part of an old master.
      *
      * This task may generate RPCs to the master to determine the status of the
-     * replica which survived on-storage across backup failures.
+     * replicas which survived on-storage across backup failures; each RPC
+     * asks about a batch of up to MAX_SEGMENT_IDS_PER_RPC replicas.
      */
     class GarbageCollectReplicasFoundOnStorageTask : public Task {
       PUBLIC:
@@ -203,9 +207,13 @@ class BackupService : public Service
         void addSegmentId(uint64_t segmentId);
         void performTask();
 
+        /// Largest number of replicas asked about in a single RPC to the
+        /// master.
+        static const uint32_t MAX_SEGMENT_IDS_PER_RPC = 1000;
+
       PRIVATE:
-        bool tryToFreeReplica(uint64_t segmentId);
-        void deleteReplica(uint64_t segmentId);
+        void tryToFreeReplicas();
+        bool deleteReplica(uint64_t segmentId);
 
         /// Backup which is trying to garbage collect the replica.
         BackupService& service;
@@ -218,9 +226,13 @@ class BackupService : public Service
 
         /**
          * Space for a rpc to the master to ask it explicitly if it would
-         * like this replica to be retain as it makes more replica elsewhere.
+         * like these replicas to be retained as it makes more replicas
+         * elsewhere.
          */
-        Tub<IsReplicaNeededRpc> rpc;
+        Tub<AreReplicasNeededRpc> rpc;
+
+        /// The segment ids #rpc asks about: the first ones in #segmentIds.
+        std::vector<uint64_t> probing;
 
         DISALLOW_COPY_AND_ASSIGN(GarbageCollectReplicasFoundOnStorageTask);
     };
@@ -239,6 +251,10 @@ class BackupService : public Service
         GarbageCollectDownServerTask(BackupService& service, ServerId masterId);
         void performTask();
 
+        /// Largest number of replicas freed in one call to performTask
+        /// (which holds the backup's mutex while it frees them).
+        static const uint32_t MAX_FREES_PER_TASK = 100;
+
       PRIVATE:
         /// Backup trying to garbage collect replicas from some removed master.
         BackupService& service;
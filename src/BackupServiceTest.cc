@@ -20,6 +20,7 @@
 #include "InMemoryStorage.h"
 #include "LogDigest.h"
 #include "MockCluster.h"
+#include "PerfStats.h"
 #include "SegmentIterator.h"
 #include "Server.h"
 #include "Key.h"
@@ -551,6 +552,80 @@ TEST_F(BackupServiceTest, writeSegment_openSegment) {
     EXPECT_EQ(0, *replicaData);
 }
 
+TEST_F(BackupServiceTest, writeSegment_relay) {
+    Server* server2 = cluster->addServer(config);
+    server2->backup->testingSkipCallerIdCheck = true;
+    ServerId backup2Id = server2->serverId;
+    openSegment({99, 0}, 88);
+    Segment segment;
+    SegmentCertificate certificate;
+    uint32_t length = segment.getAppendedLength(&certificate);
+    BackupClient::writeSegment(&context, backup2Id, {99, 0}, 88, 0,
+                               &segment, 0, length, &certificate,
+                               true, false, false);
+
+    // The second relay goes to a server that doesn't exist.
+    segment.copyIn(10, "test", 5);
+    ServerId relayTo[] = {backup2Id, ServerId(50, 0)};
+    WriteSegmentRpc rpc(&context, backupId, {99, 0}, 88, 0, &segment, 10, 5,
+                        &certificate, false, false, true, relayTo, 2);
+    EXPECT_EQ(1u, rpc.wait());
+    auto frameIt = backup->frames.find({{99, 0}, 88});
+    EXPECT_STREQ("test", static_cast<char*>(frameIt->second->load()) + 10);
+    frameIt = server2->backup->frames.find({{99, 0}, 88});
+    EXPECT_STREQ("test", static_cast<char*>(frameIt->second->load()) + 10);
+    EXPECT_FALSE(toMetadata(frameIt->second->getMetadata())->primary);
+}
+
+TEST_F(BackupServiceTest, writeSegment_compressed) {
+    Server* server2 = cluster->addServer(config);
+    server2->backup->testingSkipCallerIdCheck = true;
+    ServerId backup2Id = server2->serverId;
+    openSegment({99, 0}, 88);
+    Segment segment;
+    SegmentCertificate certificate;
+    uint32_t length = segment.getAppendedLength(&certificate);
+    BackupClient::writeSegment(&context, backup2Id, {99, 0}, 88, 0,
+                               &segment, 0, length, &certificate,
+                               true, false, false);
+
+    string data(1000, 'a');
+    segment.copyIn(10, data.c_str(), 1001);
+    PerfStats::threadStats.replicationCompressionInputBytes = 0;
+    PerfStats::threadStats.replicationCompressionOutputBytes = 0;
+    WriteSegmentRpc rpc(&context, backupId, {99, 0}, 88, 0, &segment, 10,
+                        1001, &certificate, false, false, true,
+                        &backup2Id, 1, true);
+    EXPECT_EQ(1u, rpc.wait());
+    EXPECT_EQ(1001U,
+              PerfStats::threadStats.replicationCompressionInputBytes);
+    EXPECT_GT(100U,
+              PerfStats::threadStats.replicationCompressionOutputBytes);
+
+    // Both the backup and the one it relayed to stored the original data.
+    auto frameIt = backup->frames.find({{99, 0}, 88});
+    EXPECT_EQ(data,
+              string(static_cast<char*>(frameIt->second->load()) + 10));
+    frameIt = server2->backup->frames.find({{99, 0}, 88});
+    EXPECT_EQ(data,
+              string(static_cast<char*>(frameIt->second->load()) + 10));
+}
+
+TEST_F(BackupServiceTest, writeSegment_compressedNoGain) {
+    openSegment({99, 0}, 88);
+    Segment segment;
+    segment.copyIn(10, "test", 5);
+    SegmentCertificate certificate;
+    PerfStats::threadStats.replicationCompressionOutputBytes = 0;
+    WriteSegmentRpc rpc(&context, backupId, {99, 0}, 88, 0, &segment, 10, 5,
+                        &certificate, false, false, true, NULL, 0, true);
+    rpc.wait();
+    // Sent uncompressed.
+    EXPECT_EQ(5U, PerfStats::threadStats.replicationCompressionOutputBytes);
+    auto frameIt = backup->frames.find({{99, 0}, 88});
+    EXPECT_STREQ("test", static_cast<char*>(frameIt->second->load()) + 10);
+}
+
 TEST_F(BackupServiceTest, writeSegment_openSegmentSecondary) {
     openSegment(ServerId(99, 0), 88, false);
     auto frameIt = backup->frames.find({{99, 0}, 88});
@@ -592,11 +667,16 @@ TEST_F(BackupServiceTest, GarbageCollectDownServerTask) {
     task->schedule();
     const_cast<ServerConfig*>(backup->config)->backup.gc = true;
 
+    uint64_t freed = metrics->backup.downServerReplicasFreed;
     backup->taskQueue.performTask();
+    // All of the master's replicas are freed in one pass, after which the
+    // task is done and deletes itself.
     EXPECT_EQ(backup->recoveries.end(), backup->recoveries.find({99, 0}));
     EXPECT_EQ(backup->frames.end(), backup->frames.find({{99, 0}, 88}));
-    EXPECT_NE(backup->frames.end(), backup->frames.find({{99, 0}, 89}));
+    EXPECT_EQ(backup->frames.end(), backup->frames.find({{99, 0}, 89}));
     EXPECT_NE(backup->frames.end(), backup->frames.find({{99, 1}, 88}));
+    EXPECT_EQ(2u, metrics->backup.downServerReplicasFreed - freed);
+    task.release();
 
     TestLog::Enable _;
     // Runs the now scheduled BackupMasterRecovery to free it up.
@@ -604,18 +684,27 @@ TEST_F(BackupServiceTest, GarbageCollectDownServerTask) {
     EXPECT_EQ("performTask: Freeing recovery state on backup for crashed "
               "master 99.0 (recovery 456), including 0 filtered replicas",
               TestLog::get());
+    EXPECT_EQ(0lu, backup->taskQueue.outstandingTasks());
+}
 
-    backup->taskQueue.performTask();
-    EXPECT_EQ(backup->frames.end(), backup->frames.find({{99, 0}, 88}));
-    EXPECT_EQ(backup->frames.end(), backup->frames.find({{99, 0}, 89}));
-    EXPECT_NE(backup->frames.end(), backup->frames.find({{99, 1}, 88}));
+TEST_F(BackupServiceTest, GarbageCollectDownServerTask_manyReplicas) {
+    // The entries can share a frame: it is freed once the last is erased.
+    typedef BackupService::GarbageCollectDownServerTask Task;
+    BackupStorage::FrameRef frame = backup->storage->open(false);
+    for (uint64_t segmentId = 1; segmentId <= Task::MAX_FREES_PER_TASK + 1;
+            segmentId++) {
+        backup->frames[{{99, 0}, segmentId}] = frame;
+    }
+    frame.reset();
+    (new Task(*backup, {99, 0}))->schedule();
+    const_cast<ServerConfig*>(backup->config)->backup.gc = true;
 
     backup->taskQueue.performTask();
-    EXPECT_EQ(backup->frames.end(), backup->frames.find({{99, 0}, 88}));
-    EXPECT_EQ(backup->frames.end(), backup->frames.find({{99, 0}, 89}));
-    EXPECT_NE(backup->frames.end(), backup->frames.find({{99, 1}, 88}));
-
-    task.release();
+    EXPECT_EQ(1lu, backup->frames.size());
+    EXPECT_EQ(1lu, backup->taskQueue.outstandingTasks());
+    backup->taskQueue.performTask();
+    EXPECT_EQ(0lu, backup->frames.size());
+    EXPECT_EQ(0lu, backup->taskQueue.outstandingTasks());
 }
 
 namespace {
@@ -633,15 +722,22 @@ class GcMockMasterService : public Service {
             break;
         case MASTER_SERVICE:
             switch (hdr->opcode) {
-            case Opcode::IS_REPLICA_NEEDED:
+            case Opcode::ARE_REPLICAS_NEEDED:
             {
-                const IsReplicaNeeded::Request* req =
+                const AreReplicasNeeded::Request* req =
                     rpc->requestPayload->getStart<
-                    IsReplicaNeeded::Request>();
+                    AreReplicasNeeded::Request>();
+                const uint64_t* segmentIds =
+                    static_cast<const uint64_t*>(
+                    rpc->requestPayload->getRange(sizeof32(*req),
+                    req->segmentIdCount * sizeof32(uint64_t)));
                 auto* resp = rpc->replyPayload->emplaceAppend<
-                        IsReplicaNeeded::Response>();
-                resp->needed = req->segmentId % 2;
+                        AreReplicasNeeded::Response>();
                 resp->common.status = STATUS_OK;
+                for (uint32_t i = 0; i < req->segmentIdCount; i++) {
+                    rpc->replyPayload->emplaceAppend<uint8_t>(
+                        downCast<uint8_t>(segmentIds[i] % 2));
+                }
                 break;
             }
             default:
@@ -658,7 +754,7 @@ class GcMockMasterService : public Service {
 };
 
 TEST_F(BackupServiceTest, GarbageCollectReplicaFoundOnStorageTask) {
-    TestLog::Enable _("tryToFreeReplica");
+    TestLog::Enable _("tryToFreeReplicas");
     GcMockMasterService master;
     context.services[MASTER_SERVICE] = &master;
     context.services[MEMBERSHIP_SERVICE] = &master;
@@ -686,61 +782,79 @@ TEST_F(BackupServiceTest, GarbageCollectReplicaFoundOnStorageTask) {
     EXPECT_EQ(3, backup->oldReplicas);
     task->schedule();
     const_cast<ServerConfig*>(backup->config)->backup.gc = true;
+    uint64_t freed = metrics->backup.oldReplicasFreed;
 
     EXPECT_FALSE(task->rpc);
-    backup->taskQueue.performTask(); // send rpc to probe 10
+    backup->taskQueue.performTask(); // send one rpc to probe all three
     ASSERT_TRUE(task->rpc);
+    EXPECT_EQ(3u, task->probing.size());
 
-    backup->taskQueue.performTask(); // get response - false for 10
+    backup->taskQueue.performTask(); // get response - only 11 is needed
     EXPECT_FALSE(task->rpc);
-    EXPECT_EQ("tryToFreeReplica: Server has recovered from lost replica; "
-        "freeing replica for <13.0,10> (2 more old replicas left)",
+    EXPECT_EQ("tryToFreeReplicas: Server has recovered from lost replicas; "
+            "freed 2 replicas for 13.0 (1 more old replicas left) | "
+        "tryToFreeReplicas: Server has not recovered from lost replicas; "
+            "retaining 1 replicas for 13.0; will probe replica status "
+            "again later",
         TestLog::get());
     EXPECT_EQ(1lu, backup->taskQueue.outstandingTasks());
     EXPECT_EQ(backup->frames.end(), backup->frames.find({{13, 0}, 10}));
     EXPECT_NE(backup->frames.end(), backup->frames.find({{13, 0}, 11}));
-    EXPECT_NE(backup->frames.end(), backup->frames.find({{13, 0}, 12}));
-    EXPECT_EQ(2, backup->oldReplicas);
+    EXPECT_EQ(backup->frames.end(), backup->frames.find({{13, 0}, 12}));
+    EXPECT_EQ(1, backup->oldReplicas);
+    EXPECT_EQ(2u, metrics->backup.oldReplicasFreed - freed);
 
-    EXPECT_FALSE(task->rpc);
-    backup->taskQueue.performTask(); // send rpc to probe 11
-    ASSERT_TRUE(task->rpc);
+    backupServerList->testingRemove({13, 0});
 
     TestLog::reset();
-    backup->taskQueue.performTask(); // get response - true for 11
-    EXPECT_EQ("tryToFreeReplica: Server has not recovered from lost replica; "
-        "retaining replica for <13.0,11>; "
-        "will probe replica status again later",
+    backup->taskQueue.performTask(); // send rpc to probe 11 again
+    ASSERT_TRUE(task->rpc);
+    EXPECT_EQ(1u, task->probing.size());
+    backup->taskQueue.performTask(); // get response - server doesn't exist
+    EXPECT_EQ("tryToFreeReplicas: Server 13.0 marked down; cluster has "
+            "recovered from its failure | "
+        "tryToFreeReplicas: Server has recovered from lost replicas; "
+            "freed 1 replicas for 13.0 (0 more old replicas left)",
         TestLog::get());
+    EXPECT_EQ(backup->frames.end(), backup->frames.find({{13, 0}, 11}));
     EXPECT_EQ(1lu, backup->taskQueue.outstandingTasks());
+    EXPECT_EQ(0, backup->oldReplicas);
+
+    // Final perform finds no segments to free and just cleans up
+    backup->taskQueue.performTask();
+    EXPECT_EQ(0lu, backup->taskQueue.outstandingTasks());
+}
 
+TEST_F(BackupServiceTest, GarbageCollectReplicaTask_tryToFreeReplicas_crashed) {
+    ServerList* backupServerList = static_cast<ServerList*>(
+        backup->context->serverList);
+    backupServerList->testingAdd({{13, 0}, "mock:host=m", {}, 100,
+                                  ServerStatus::UP});
     backupServerList->testingCrashed({13, 0});
+    openSegment({13, 0}, 10);
+    closeSegment({13, 0}, 10);
+    openSegment({13, 0}, 11);
+    closeSegment({13, 0}, 11);
 
-    TestLog::reset();
-    EXPECT_FALSE(task->rpc);
-    backup->taskQueue.performTask(); // find out server crashed
-    EXPECT_EQ("tryToFreeReplica: Server 13.0 marked crashed; "
+    typedef BackupService::GarbageCollectReplicasFoundOnStorageTask Task;
+    Task* task = new Task(*backup, {13, 0});  // freed by performTask below
+    task->addSegmentId(10);
+    task->addSegmentId(11);
+    task->schedule();
+    const_cast<ServerConfig*>(backup->config)->backup.gc = true;
+
+    TestLog::Enable _("tryToFreeReplicas");
+    backup->taskQueue.performTask();
+    EXPECT_EQ("tryToFreeReplicas: Server 13.0 marked crashed; "
         "waiting for cluster to recover from its failure "
-        "before freeing <13.0,11>",
+        "before freeing 2 replicas",
         TestLog::get());
-    EXPECT_EQ(1lu, backup->taskQueue.outstandingTasks());
-
-    backupServerList->testingRemove({13, 0});
-
-    TestLog::reset();
     EXPECT_FALSE(task->rpc);
-    backup->taskQueue.performTask(); // send rpc
-    EXPECT_TRUE(task->rpc);
-    backup->taskQueue.performTask(); // get response - server doesn't exist
-    EXPECT_EQ("tryToFreeReplica: Server 13.0 marked down; cluster has "
-            "recovered from its failure | "
-        "tryToFreeReplica: Server has recovered from lost replica; "
-            "freeing replica for <13.0,12> (0 more old replicas left)",
-        TestLog::get());
-    EXPECT_EQ(1lu, backup->taskQueue.outstandingTasks());
     EXPECT_EQ(0, backup->oldReplicas);
 
-    // Final perform finds no segments to free and just cleans up
+    // The replicas are left for GarbageCollectDownServerTask.
+    EXPECT_NE(backup->frames.end(), backup->frames.find({{13, 0}, 10}));
+    EXPECT_NE(backup->frames.end(), backup->frames.find({{13, 0}, 11}));
     backup->taskQueue.performTask();
     EXPECT_EQ(0lu, backup->taskQueue.outstandingTasks());
 }
@@ -752,7 +866,7 @@ taskScheduleFilter(string s)
 }
 
 TEST_F(BackupServiceTest,
-        GarbageCollectReplicaTask_tryToFreeReplica_freedFirst) {
+        GarbageCollectReplicaTask_tryToFreeReplicas_freedFirst) {
     typedef BackupService::GarbageCollectReplicasFoundOnStorageTask Task;
     Task* task = new Task(*backup, {99, 0});  // freed by performTask below
     task->addSegmentId(88);
@@ -196,6 +196,14 @@ class BackupStorage {
          */
         virtual void startLoading() = 0;
 
+        /**
+         * Like startLoading(), but also asks for this frame's load to be
+         * done ahead of others that were requested earlier; used during
+         * recovery for replicas that a recovery master is waiting for.
+         * Storage that doesn't queue loads can ignore the distinction.
+         */
+        virtual void startLoadingUrgently() { startLoading(); }
+
         /**
          * Returns true if calling load() would not block. Always returns
          * false if startLoading() or load() hasn't been called.
@@ -357,6 +365,15 @@ class BackupStorage {
      */
     virtual size_t getMetadataSize() = 0;
 
+    /**
+     * Return the number of replicas whose data is buffered in memory while
+     * being written to storage (or waiting to be); a measure of how far
+     * storage is behind on writes. Reported to masters with each write so
+     * they can steer new replicas away from backlogged backups. Storage
+     * that doesn't buffer writes always returns 0.
+     */
+    virtual size_t getWriteBuffersInUse() { return 0; }
+
     /**
      * Marks ALL storage frames as allocated and blows away any in-memory
      * copies of metadata. This should only be performed at backup startup. The
@@ -437,7 +454,7 @@ class BackupStorage {
     virtual void fry() = 0;
 
     /// See #storageType.
-    enum class Type { UNKNOWN = 0, MEMORY = 1, DISK = 2 };
+    enum class Type { UNKNOWN = 0, MEMORY = 1, DISK = 2, PMEM = 3 };
 
   PROTECTED:
     /**
@@ -49,6 +49,8 @@ BasicTransport::BasicTransport(Context* context, const ServiceLocator* locator,
     , serverTimerList()
     , roundTripBytes(getRoundTripBytes(locator))
     , grantIncrement(5*maxDataPerPacket)
+    , messagesNeedingGrants()
+    , maxGrantedMessages(2)
     , timer(this, context->dispatch)
     , timerInterval(0)
     , timeoutIntervals(100)
@@ -64,10 +66,10 @@ BasicTransport::BasicTransport(Context* context, const ServiceLocator* locator,
     timer.start(Cycles::rdtsc() + timerInterval);
 
     LOG(NOTICE, "BasicTransport parameters: maxDataPerPacket %u, "
-            "roundTripBytes %u, grantIncrement %u, pingIntervals %d, "
-            "timeoutIntervals %d, timerInterval %.2f ms",
+            "roundTripBytes %u, grantIncrement %u, maxGrantedMessages %u, "
+            "pingIntervals %d, timeoutIntervals %d, timerInterval %.2f ms",
             maxDataPerPacket, roundTripBytes,
-            grantIncrement, pingIntervals, timeoutIntervals,
+            grantIncrement, maxGrantedMessages, pingIntervals, timeoutIntervals,
             Cycles::toSeconds(timerInterval)*1e3);
 }
 
@@ -259,6 +261,35 @@ BasicTransport::sendBytes(const Driver::Address* address, RpcId rpcId,
     }
 }
 
+/**
+ * Issue GRANTs to the incoming messages at the front of
+ * messagesNeedingGrants (those with the fewest bytes left to receive),
+ * keeping at least a round-trip's worth of each authorized beyond what
+ * has arrived. Messages further back get no new GRANTs until enough of
+ * the ones ahead of them complete. This is invoked whenever the contents
+ * or order of the list may have changed.
+ */
+void
+BasicTransport::scheduleGrants()
+{
+    uint32_t granted = 0;
+    for (GrantList::iterator it = messagesNeedingGrants.begin();
+            (it != messagesNeedingGrants.end()) &&
+            (granted < maxGrantedMessages); it++, granted++) {
+        MessageAccumulator& message = *it;
+        message.grantsWithheld = false;
+        uint32_t received = message.buffer->size();
+        if ((message.grantOffset < (received + message.roundTripBytes)) &&
+                (message.grantOffset < message.totalLength)) {
+            message.grantOffset = received + message.roundTripBytes
+                    + grantIncrement;
+            GrantHeader grant(message.rpcId, message.grantOffset,
+                    message.whoFrom);
+            driver->sendPacket(message.sender, &grant, NULL);
+        }
+    }
+}
+
 /**
  * Given a pointer to a BasicTransport packet, return a humanreturn-readable
  * string describing the information in its header.
@@ -525,30 +556,23 @@ BasicTransport::IncomingPacketHandler::handlePacket(Driver::Received* received)
                 if (header == NULL)
                     goto packetLengthError;
                 if (!clientRpc->accumulator) {
-                    clientRpc->accumulator.construct(t, clientRpc->response);
+                    clientRpc->accumulator.construct(t, clientRpc->response,
+                            clientRpc->session->serverAddress,
+                            header->common.rpcId, clientRpc->grantOffset,
+                            clientRpc->session->roundTripBytes, FROM_CLIENT);
                 }
                 clientRpc->accumulator->addPacket(received, header);
                 if (clientRpc->response->size() >= header->totalLength) {
-                    // Response complete.
+                    // Response complete. Destroying the accumulator takes
+                    // it out of messagesNeedingGrants, which may free up a
+                    // slot for another message.
                     t->outgoingRpcs.erase(header->common.rpcId.sequence);
                     clientRpc->notifier->completed();
                     t->clientRpcPool.destroy(clientRpc);
                 } else {
-                    // See if we need to output a GRANT.
-                    if ((header->common.flags & NEED_GRANT) &&
-                            (clientRpc->grantOffset <
-                            (clientRpc->response->size() +
-                            clientRpc->session->roundTripBytes)) &&
-                            (clientRpc->grantOffset < header->totalLength)) {
-                        clientRpc->grantOffset = clientRpc->response->size()
-                                + clientRpc->session->roundTripBytes
-                                + t->grantIncrement;
-                        GrantHeader grant(header->common.rpcId,
-                                clientRpc->grantOffset, FROM_CLIENT);
-                        t->driver->sendPacket(clientRpc->session->serverAddress,
-                                &grant, NULL);
-                    }
+                    clientRpc->accumulator->updateGrantOrder(header);
                 }
+                t->scheduleGrants();
                 if ((header->offset < clientRpc->resendLimit) &&
                         !(header->common.flags & RETRANSMISSION)) {
                     LOG(NOTICE, "Original data arrived from server %s after "
@@ -643,6 +667,7 @@ BasicTransport::IncomingPacketHandler::handlePacket(Driver::Received* received)
                 }
                 serverRpc = t->serverRpcPool.construct(t, received->sender,
                         header->common.rpcId);
+                serverRpc->firstPacketTime = received->arrivalTime;
                 t->incomingRpcs[header->common.rpcId] = serverRpc;
                 uint32_t length;
                 char *payload = received->steal(&length);
@@ -662,9 +687,12 @@ BasicTransport::IncomingPacketHandler::handlePacket(Driver::Received* received)
                 if (serverRpc == NULL) {
                     serverRpc = t->serverRpcPool.construct(t,
                             received->sender, header->common.rpcId);
+                    serverRpc->firstPacketTime = received->arrivalTime;
                     t->incomingRpcs[header->common.rpcId] = serverRpc;
                     serverRpc->accumulator.construct(t,
-                            &serverRpc->requestPayload);
+                            &serverRpc->requestPayload, received->sender,
+                            header->common.rpcId, serverRpc->grantOffset,
+                            t->roundTripBytes, FROM_SERVER);
                     t->serverTimerList.push_back(*serverRpc);
                 } else if (serverRpc->requestComplete) {
                     // We've already received the full message, so
@@ -676,24 +704,16 @@ BasicTransport::IncomingPacketHandler::handlePacket(Driver::Received* received)
                 if ((serverRpc->requestPayload.size() >= header->totalLength)) {
                     // Message complete; start servicing the RPC.
                     erase(t->serverTimerList, *serverRpc);
+                    if (serverRpc->accumulator->grantLinks.is_linked()) {
+                        erase(t->messagesNeedingGrants,
+                                *serverRpc->accumulator);
+                    }
                     serverRpc->requestComplete = true;
                     t->context->workerManager->handleRpc(serverRpc);
                 } else {
-                    // See if we need to output a GRANT.
-                    if ((header->common.flags & NEED_GRANT) &&
-                            (serverRpc->grantOffset <
-                            (serverRpc->requestPayload.size()
-                            + t->roundTripBytes)) &&
-                            (serverRpc->grantOffset < header->totalLength)) {
-                        serverRpc->grantOffset =
-                                serverRpc->requestPayload.size()
-                                + t->roundTripBytes + t->grantIncrement;
-                        GrantHeader grant(header->common.rpcId,
-                                serverRpc->grantOffset, FROM_SERVER);
-                        t->driver->sendPacket(serverRpc->clientAddress,
-                                &grant, NULL);
-                    }
+                    serverRpc->accumulator->updateGrantOrder(header);
                 }
+                t->scheduleGrants();
                 serverDataDone:
                 if ((header->offset < serverRpc->resendLimit) &&
                         !(header->common.flags & RETRANSMISSION)) {
@@ -890,13 +910,34 @@ BasicTransport::ServerRpc::sendReply()
  *      The complete message will be assembled here; caller should ensure
  *      that this is initially empty. The caller owns the storage for this
  *      and must ensure that it persists as long as this object persists.
+ * \param sender
+ *      Where the message is coming from (GRANTs are sent here).
+ * \param rpcId
+ *      Unique identifier for the RPC the message belongs to.
+ * \param grantOffset
+ *      The grantOffset field of the ClientRpc or ServerRpc that owns this
+ *      object; GRANTs issued by scheduleGrants update it.
+ * \param roundTripBytes
+ *      Number of bytes that can be transmitted during the time it takes
+ *      for a round-trip latency.
+ * \param whoFrom
+ *      Must be either FROM_CLIENT, indicating that we are the client, or
+ *      FROM_SERVER, indicating that we are the server.
  */
 BasicTransport::MessageAccumulator::MessageAccumulator(BasicTransport* t,
-        Buffer* buffer)
+        Buffer* buffer, const Driver::Address* sender, RpcId rpcId,
+        uint32_t& grantOffset, uint32_t roundTripBytes, uint8_t whoFrom)
     : t(t)
     , buffer(buffer)
     , fragments()
-    , grantOffset(0)
+    , sender(sender)
+    , rpcId(rpcId)
+    , grantOffset(grantOffset)
+    , roundTripBytes(roundTripBytes)
+    , whoFrom(whoFrom)
+    , totalLength(0)
+    , grantsWithheld(false)
+    , grantLinks()
 { }
 
 /**
@@ -905,13 +946,22 @@ BasicTransport::MessageAccumulator::MessageAccumulator(BasicTransport* t,
 BasicTransport::MessageAccumulator::~MessageAccumulator()
 {
     // If there are any unassembled fragments, then we must release
-    // them back to the driver.
-    for (FragmentMap::iterator it = fragments.begin();
-            it != fragments.end(); it++) {
-        MessageFragment fragment = it->second;
-        t->driver->release(fragment.payload);
+    // them back to the driver (all at once, which is cheaper for drivers
+    // that must synchronize with the dispatch thread).
+    if (!fragments.empty()) {
+        std::vector<char*> payloads;
+        payloads.reserve(fragments.size());
+        for (FragmentMap::iterator it = fragments.begin();
+                it != fragments.end(); it++) {
+            payloads.push_back(it->second.payload);
+        }
+        t->driver->releaseBatch(&payloads[0],
+                downCast<uint32_t>(payloads.size()));
     }
     fragments.clear();
+
+    if (grantLinks.is_linked())
+        erase(t->messagesNeedingGrants, *this);
 }
 
 /**
@@ -990,6 +1040,46 @@ BasicTransport::MessageAccumulator::appendFragment(char* payload,
             length - bytesToSkip, t->driver, payload);
 }
 
+/**
+ * This method is invoked after each DATA packet is added to an incomplete
+ * message. It enters the message into t->messagesNeedingGrants the first
+ * time its sender asks for a GRANT, and otherwise moves the message toward
+ * the front of that list as its remaining byte count shrinks, so the list
+ * stays sorted by bytes remaining.
+ *
+ * \param header
+ *      Header from the DATA packet that just arrived.
+ */
+void
+BasicTransport::MessageAccumulator::updateGrantOrder(DataHeader* header)
+{
+    GrantList& list = t->messagesNeedingGrants;
+    GrantList::iterator position;
+    if (grantLinks.is_linked()) {
+        position = list.iterator_to(*this);
+    } else if (header->common.flags & NEED_GRANT) {
+        totalLength = header->totalLength;
+        position = list.end();
+    } else {
+        return;
+    }
+
+    GrantList::iterator insertBefore = position;
+    while (insertBefore != list.begin()) {
+        GrantList::iterator previous = insertBefore;
+        previous--;
+        if (previous->getBytesRemaining() <= getBytesRemaining())
+            break;
+        insertBefore = previous;
+    }
+    if (position == list.end()) {
+        list.insert(insertBefore, *this);
+    } else if (insertBefore != position) {
+        list.erase(position);
+        list.insert(insertBefore, *this);
+    }
+}
+
 /**
  * This method is invoked to issue a RESEND packet when it appears that
  * packets have been lost. It is used by both servers and clients.
@@ -1079,6 +1169,17 @@ BasicTransport::Timer::handleTimerEvent()
     // First, restart the timer.
     start(Cycles::rdtsc() + t->timerInterval);
 
+    // Note which incoming messages are idle because we are withholding
+    // GRANTs from them, so they aren't mistaken for lost packets below.
+    // Also hand out any grant slots freed by RPCs that were aborted or
+    // cancelled since the last packet arrived.
+    uint32_t position = 0;
+    for (GrantList::iterator it = t->messagesNeedingGrants.begin();
+            it != t->messagesNeedingGrants.end(); it++, position++) {
+        it->grantsWithheld = (position >= t->maxGrantedMessages);
+    }
+    t->scheduleGrants();
+
     // Scan all of the ClientRpc objects.
     for (ClientRpcMap::iterator it = t->outgoingRpcs.begin();
             it != t->outgoingRpcs.end(); ) {
@@ -1090,6 +1191,12 @@ BasicTransport::Timer::handleTimerEvent()
         // we delete the ClientRpc below.
         it++;
 
+        if (clientRpc->accumulator && clientRpc->accumulator->grantsWithheld) {
+            // The server is waiting for a GRANT from us.
+            clientRpc->silentIntervals = 0;
+            continue;
+        }
+
         assert(t->timeoutIntervals > 2*t->pingIntervals);
         if (clientRpc->silentIntervals >= t->timeoutIntervals) {
             // A long time has elapsed with no communication whatsoever
@@ -1152,6 +1259,13 @@ BasicTransport::Timer::handleTimerEvent()
         // delete the ServerRpc below.
         it++;
 
+        if (!serverRpc->requestComplete &&
+                serverRpc->accumulator->grantsWithheld) {
+            // The client is waiting for a GRANT from us.
+            serverRpc->silentIntervals = 0;
+            continue;
+        }
+
         // If a long time has elapsed with no communication whatsoever
         // from the client, then abort the RPC. Note: this code should
         // only be executed when we're waiting to transmit or receive
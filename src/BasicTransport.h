@@ -145,13 +145,25 @@ class BasicTransport : public Transport {
      */
     class MessageAccumulator {
       public:
-        MessageAccumulator(BasicTransport* t, Buffer* buffer);
+        MessageAccumulator(BasicTransport* t, Buffer* buffer,
+                const Driver::Address* sender, RpcId rpcId,
+                uint32_t& grantOffset, uint32_t roundTripBytes,
+                uint8_t whoFrom);
         ~MessageAccumulator();
         void addPacket(Driver::Received* received, DataHeader *header);
         void appendFragment(char* payload, uint32_t offset, uint32_t length);
         uint32_t requestRetransmission(BasicTransport *t,
                 const Driver::Address* address, RpcId grantOffset,
                 uint32_t limit, uint32_t roundTripBytes, uint8_t whoFrom);
+        void updateGrantOrder(DataHeader* header);
+
+        /// Number of bytes of the message that have not yet been
+        /// assembled into buffer. Only meaningful once totalLength is known.
+        uint32_t
+        getBytesRemaining() const
+        {
+            return totalLength - buffer->size();
+        }
 
         /// Transport that is managing this object.
         BasicTransport* t;
@@ -186,10 +198,39 @@ class BasicTransport : public Transport {
         typedef std::map<uint32_t, MessageFragment>FragmentMap;
         FragmentMap fragments;
 
-        /// Offset into the message of the most recent GRANT packet
-        /// we have sent (i.e., we've already authorized the sender to
-        /// transmit bytes up to this point in the message).
-        uint32_t grantOffset;
+        /// Where GRANT packets for this message should be sent.
+        const Driver::Address* sender;
+
+        /// The RPC this message belongs to.
+        RpcId rpcId;
+
+        /// The grantOffset field of the ClientRpc or ServerRpc that owns
+        /// this object: offset into the message of the most recent GRANT
+        /// packet we have sent (i.e., we've already authorized the sender
+        /// to transmit bytes up to this point in the message).
+        uint32_t& grantOffset;
+
+        /// Number of bytes the sender may have in flight; GRANTs try to
+        /// keep at least this much of the message authorized beyond what
+        /// has been received.
+        uint32_t roundTripBytes;
+
+        /// FROM_CLIENT if we are the client (this is a response), or
+        /// FROM_SERVER if we are the server (this is a request).
+        uint8_t whoFrom;
+
+        /// Total length of the message, taken from its DATA headers. Set
+        /// once the sender asks for GRANTs.
+        uint32_t totalLength;
+
+        /// True means the most recent timer pass found this message
+        /// beyond the first t->maxGrantedMessages entries of
+        /// t->messagesNeedingGrants, so its sender is idle because we
+        /// chose not to GRANT it, not because packets were lost.
+        bool grantsWithheld;
+
+        /// Used to link this object into t->messagesNeedingGrants.
+        IntrusiveListHook grantLinks;
 
       PRIVATE:
         DISALLOW_COPY_AND_ASSIGN(MessageAccumulator);
@@ -504,6 +545,7 @@ class BasicTransport : public Transport {
     uint32_t getRoundTripBytes(const ServiceLocator* locator);
     static string headerToString(const void* header, uint32_t headerLength);
     static string opcodeSymbol(uint8_t opcode);
+    void scheduleGrants();
     void sendBytes(const Driver::Address* address, RpcId rpcId,
             Buffer* message, int offset, int length, uint8_t flags);
 
@@ -569,6 +611,22 @@ class BasicTransport : public Transport {
     /// GRANTS, but it can result in additional buffering in the network.
     uint32_t grantIncrement;
 
+    /// Incoming multi-packet messages (requests if we are the server,
+    /// responses if we are the client) whose senders have asked for
+    /// GRANTs and that are not yet complete, sorted by increasing
+    /// number of bytes remaining.
+    INTRUSIVE_LIST_TYPEDEF(MessageAccumulator, grantLinks) GrantList;
+    GrantList messagesNeedingGrants;
+
+    /// Only the first this many entries of messagesNeedingGrants receive
+    /// GRANTs; the rest wait, having sent only their first roundTripBytes,
+    /// until one of these completes. Granting the messages with the
+    /// fewest bytes left first (SRPT) keeps a few large transfers from
+    /// filling the network queues that short messages must wait behind,
+    /// while granting more than one hides the gaps when a sender is
+    /// briefly slow to respond to a GRANT.
+    uint32_t maxGrantedMessages;
+
     /// Used to implement functionality triggered by time, such as retries
     /// when packets are lost.
     Timer timer;
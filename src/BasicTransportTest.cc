@@ -1048,6 +1048,92 @@ TEST_F(BasicTransportTest, requestRetransmission) {
             driver->outputLog);
 }
 
+TEST_F(BasicTransportTest, updateGrantOrder) {
+    transport.roundTripBytes = 10;
+    transport.grantIncrement = 5;
+
+    // No NEED_GRANT: message isn't scheduled.
+    driver->receivePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 101), 100,
+            0, BasicTransport::FROM_CLIENT), "abcde");
+    EXPECT_EQ(0u, transport.messagesNeedingGrants.size());
+
+    driver->receivePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 101), 100,
+            5, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "fghij");
+    driver->receivePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 102), 50,
+            0, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "abcde");
+    driver->receivePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 103), 80,
+            0, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "abcde");
+    string order;
+    foreach (BasicTransport::MessageAccumulator& message,
+            transport.messagesNeedingGrants) {
+        order += format("%lu:%u ", message.rpcId.sequence,
+                message.getBytesRemaining());
+    }
+    EXPECT_EQ("102:45 103:75 101:90 ", order);
+
+    // Progress on a message moves it forward.
+    driver->receivePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 101), 100,
+            10, BasicTransport::FROM_CLIENT), "0123456789abcdefghij");
+    order.clear();
+    foreach (BasicTransport::MessageAccumulator& message,
+            transport.messagesNeedingGrants) {
+        order += format("%lu:%u ", message.rpcId.sequence,
+                message.getBytesRemaining());
+    }
+    EXPECT_EQ("102:45 101:70 103:75 ", order);
+
+    // Deleting an RPC removes its message.
+    transport.deleteServerRpc(
+            transport.incomingRpcs[BasicTransport::RpcId(100, 102)]);
+    EXPECT_EQ(2u, transport.messagesNeedingGrants.size());
+}
+
+TEST_F(BasicTransportTest, scheduleGrants_shortestRemainingFirst) {
+    transport.roundTripBytes = 10;
+    transport.grantIncrement = 5;
+    transport.maxGrantedMessages = 1;
+
+    driver->receivePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 101), 100,
+            0, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "abcde");
+    EXPECT_EQ("GRANT FROM_SERVER, rpcId 100.101, offset 20",
+            driver->outputLog);
+
+    // A shorter message takes over the grant slot.
+    driver->outputLog.clear();
+    driver->receivePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 102), 20,
+            0, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "abcde");
+    EXPECT_EQ("GRANT FROM_SERVER, rpcId 100.102, offset 20",
+            driver->outputLog);
+
+    // The longer message needs more grants, but has to wait.
+    driver->outputLog.clear();
+    driver->receivePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 101), 100,
+            5, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "fghijklmno");
+    EXPECT_EQ("", driver->outputLog);
+
+    // Once the shorter message completes, the longer one resumes.
+    driver->receivePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 102), 20,
+            5, BasicTransport::FROM_CLIENT), "fghijklmnopqrst");
+    EXPECT_EQ("GRANT FROM_SERVER, rpcId 100.101, offset 30",
+            driver->outputLog);
+    EXPECT_EQ(1u, transport.messagesNeedingGrants.size());
+}
+
 TEST_F(BasicTransportTest, handleTimerEvent_clientPingAndAbort) {
     MockWrapper wrapper(NULL);
     WireFormat::RequestCommon* header =
@@ -1142,6 +1228,46 @@ TEST_F(BasicTransportTest, handleTimerEvent_sendResendFromClient) {
     EXPECT_EQ("RESEND FROM_CLIENT, rpcId 666.1, offset 8, length 147",
             driver->outputLog);
 }
+TEST_F(BasicTransportTest, handleTimerEvent_grantsWithheld) {
+    transport.roundTripBytes = 10;
+    transport.grantIncrement = 5;
+    transport.maxGrantedMessages = 1;
+    transport.timeoutIntervals = 3;
+    driver->receivePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 101), 20,
+            0, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "abcde");
+    driver->receivePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 102), 100,
+            0, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "abcde");
+    BasicTransport::ServerRpc* waiting =
+            transport.incomingRpcs[BasicTransport::RpcId(100, 102)];
+    driver->outputLog.clear();
+    TestLog::reset();
+
+    // The waiting request is neither asked to retransmit nor aborted,
+    // while the granted one is.
+    transport.timer.handleTimerEvent();
+    transport.timer.handleTimerEvent();
+    EXPECT_TRUE(waiting->accumulator->grantsWithheld);
+    EXPECT_EQ(0u, waiting->silentIntervals);
+    EXPECT_EQ("RESEND FROM_SERVER, rpcId 100.101, offset 5, length 15",
+            driver->outputLog);
+    driver->outputLog.clear();
+    transport.timer.handleTimerEvent();
+    EXPECT_EQ(0u, transport.incomingRpcs.count(
+            BasicTransport::RpcId(100, 101)));
+    EXPECT_EQ(0u, waiting->silentIntervals);
+    EXPECT_EQ("", driver->outputLog);
+
+    // The slot freed by the aborted request goes to the waiting one.
+    transport.timer.handleTimerEvent();
+    EXPECT_FALSE(waiting->accumulator->grantsWithheld);
+    EXPECT_EQ("GRANT FROM_SERVER, rpcId 100.102, offset 20",
+            driver->outputLog);
+}
+
 TEST_F(BasicTransportTest, handleTimerEvent_serverAbortsRequest) {
     transport.timeoutIntervals = 2;
     driver->receivePacket("mock:client=1",
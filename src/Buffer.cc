@@ -13,6 +13,8 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <emmintrin.h>
+
 #include "Buffer.h"
 #include "Memory.h"
 #include "Syscall.h"
@@ -20,6 +22,90 @@
 namespace RAMCloud {
 
 uint32_t Buffer::allocationLogThreshold = 4000;
+__thread Buffer::Allocation* Buffer::freeAllocations[NUM_SIZE_CLASSES];
+__thread uint32_t Buffer::numFreeAllocations[NUM_SIZE_CLASSES];
+
+/**
+ * Copies of at least this many bytes bypass the cache (see copyBytes).
+ * This is well beyond the size of an RPC, so it only affects bulk copies
+ * such as recovery segments, whose data won't be touched again soon.
+ */
+static const uint32_t NON_TEMPORAL_COPY_BYTES = 256*1024;
+
+/**
+ * Copy bytes from one place to another; used for all of the copies
+ * in Buffer::copy. Most copies out of a Buffer are small (headers and
+ * keys), and a call to memcpy costs more than the copy itself for
+ * these, so they are done here with a couple of word-sized moves. Very
+ * large copies are done with non-temporal stores, so that they don't
+ * flush the rest of the cache.
+ *
+ * \param dest
+ *      Where to copy the bytes to.
+ * \param src
+ *      Where to copy the bytes from; must not overlap \a dest.
+ * \param length
+ *      How many bytes to copy.
+ */
+static inline void
+copyBytes(char* dest, const char* src, uint32_t length)
+{
+    // Sizes up to 16 bytes: copy the first and last words (possibly
+    // overlapping). The fixed-size memcpys compile to single moves.
+    if (length <= 16) {
+        if (length >= 8) {
+            uint64_t first, last;
+            memcpy(&first, src, 8);
+            memcpy(&last, src + length - 8, 8);
+            memcpy(dest, &first, 8);
+            memcpy(dest + length - 8, &last, 8);
+        } else if (length >= 4) {
+            uint32_t first, last;
+            memcpy(&first, src, 4);
+            memcpy(&last, src + length - 4, 4);
+            memcpy(dest, &first, 4);
+            memcpy(dest + length - 4, &last, 4);
+        } else {
+            for (uint32_t i = 0; i < length; i++) {
+                dest[i] = src[i];
+            }
+        }
+        return;
+    }
+    if (length < NON_TEMPORAL_COPY_BYTES) {
+        memcpy(dest, src, length);
+        return;
+    }
+
+    // Large copies: align the destination for the streaming stores, then
+    // move 64 bytes (a cache line) at a time.
+    uint32_t head = downCast<uint32_t>(
+            (16 - (reinterpret_cast<uintptr_t>(dest) & 15)) & 15);
+    memcpy(dest, src, head);
+    dest += head;
+    src += head;
+    length -= head;
+    __m128i* out = reinterpret_cast<__m128i*>(dest);
+    const __m128i* in = reinterpret_cast<const __m128i*>(src);
+    uint32_t lines = length / 64;
+    for (uint32_t i = 0; i < lines; i++) {
+        __m128i a = _mm_loadu_si128(in);
+        __m128i b = _mm_loadu_si128(in + 1);
+        __m128i c = _mm_loadu_si128(in + 2);
+        __m128i d = _mm_loadu_si128(in + 3);
+        _mm_stream_si128(out, a);
+        _mm_stream_si128(out + 1, b);
+        _mm_stream_si128(out + 2, c);
+        _mm_stream_si128(out + 3, d);
+        in += 4;
+        out += 4;
+    }
+
+    // Make the streamed data visible to other cores before returning,
+    // just as if memcpy had been used.
+    _mm_sfence();
+    memcpy(out, in, length - lines * 64);
+}
 
 /**
  * Default object used to make system calls.
@@ -43,7 +129,7 @@ Buffer::Buffer()
     , cursorChunk(NULL)
     , cursorOffset(~0)
     , extraAppendBytes(0)
-    , allocations()
+    , allocations(NULL)
     , availableLength(sizeof32(internalAllocation) - PREPEND_SPACE)
     , firstAvailable(reinterpret_cast<char*>(internalAllocation)
             + PREPEND_SPACE)
@@ -352,7 +438,7 @@ Buffer::copy(uint32_t offset, uint32_t length, void* dest)
         if (bytesThisChunk > bytesLeft) {
             bytesThisChunk = bytesLeft;
         }
-        memcpy(out, chunkData, bytesThisChunk);
+        copyBytes(out, chunkData, bytesThisChunk);
         out += bytesThisChunk;
         bytesLeft -= bytesThisChunk;
         if (bytesLeft == 0) {
@@ -446,6 +532,28 @@ Buffer::fillFromString(const char* s) {
     }
 }
 
+/**
+ * Release a block of extra storage allocated by getNewAllocation: return it
+ * to this thread's pool for its size, or free it if it isn't pooled or the
+ * pool is full.
+ *
+ * \param allocation
+ *      The block to release.
+ */
+void
+Buffer::freeAllocation(Allocation* allocation)
+{
+    int sizeClass = allocation->sizeClass;
+    if ((sizeClass < 0) ||
+            (numFreeAllocations[sizeClass] >= MAX_POOLED_ALLOCATIONS)) {
+        free(allocation);
+        return;
+    }
+    allocation->next = freeAllocations[sizeClass];
+    freeAllocations[sizeClass] = allocation;
+    numFreeAllocations[sizeClass]++;
+}
+
 /**
  * Allocate another chunk of memory for the internal use of this
  * buffer.  This method is for internal use only by the Buffer
@@ -472,8 +580,28 @@ Buffer::getNewAllocation(uint32_t bytesNeeded, uint32_t* bytesAllocated)
     // allocated for the buffer.
     bytesNeeded += sizeof32(internalAllocation) + totalAllocatedBytes;
     bytesNeeded = (bytesNeeded+7) & ~0x7;
-    char* newAllocation = static_cast<char*>(Memory::xmalloc(HERE,
-            bytesNeeded));
+
+    // Use the smallest pooled block that is big enough, if there is one.
+    uint32_t blockBytes = bytesNeeded + sizeof32(Allocation);
+    int sizeClass = 0;
+    while ((sizeClass < NUM_SIZE_CLASSES) &&
+            ((MIN_POOLED_BYTES << sizeClass) < blockBytes)) {
+        sizeClass++;
+    }
+    Allocation* allocation;
+    if (sizeClass == NUM_SIZE_CLASSES) {
+        allocation = static_cast<Allocation*>(Memory::xmalloc(HERE,
+                blockBytes));
+        sizeClass = -1;
+    } else if (freeAllocations[sizeClass] != NULL) {
+        allocation = freeAllocations[sizeClass];
+        freeAllocations[sizeClass] = allocation->next;
+        numFreeAllocations[sizeClass]--;
+    } else {
+        allocation = static_cast<Allocation*>(Memory::xmalloc(HERE,
+                MIN_POOLED_BYTES << sizeClass));
+    }
+    allocation->sizeClass = sizeClass;
     totalAllocatedBytes += bytesNeeded;
     if (totalAllocatedBytes >= Buffer::allocationLogThreshold) {
         RAMCLOUD_LOG(NOTICE, "buffer has consumed %u bytes of extra storage, "
@@ -481,12 +609,10 @@ Buffer::getNewAllocation(uint32_t bytesNeeded, uint32_t* bytesAllocated)
                 totalAllocatedBytes, bytesNeeded);
         Buffer::allocationLogThreshold = 2*totalAllocatedBytes;
     }
-    if (!allocations) {
-        allocations.construct();
-    }
-    allocations->push_back(newAllocation);
+    allocation->next = allocations;
+    allocations = allocation;
     *bytesAllocated = bytesNeeded;
-    return newAllocation;
+    return reinterpret_cast<char*>(allocation + 1);
 }
 
 /**
@@ -278,6 +278,19 @@ class Buffer {
     uint32_t write(uint32_t offset, uint32_t length, FILE* f);
 
   PRIVATE:
+    /// Header at the start of each block of extra storage; the storage
+    /// the Buffer uses follows it.
+    struct Allocation {
+        /// Next block allocated for the same Buffer (or, while the block
+        /// is in a pool, the next block in the same pool), or NULL.
+        Allocation* next;
+
+        /// Index in #freeAllocations of the pool the block came from and
+        /// is returned to, or -1 if it isn't pooled.
+        int sizeClass;
+    };
+
+    static void freeAllocation(Allocation* allocation);
     char* getNewAllocation(uint32_t bytesNeeded, uint32_t* bytesAllocated);
 
     /**
@@ -301,14 +314,12 @@ class Buffer {
             current = next;
         }
 
-        // Free any malloc-ed memory.
-        if (allocations) {
-            for (uint32_t i = 0; i < allocations->size(); i++) {
-                free((*allocations)[i]);
-            }
-            if (isReset) {
-                allocations->clear();
-            }
+        // Free any extra storage.
+        Allocation* allocation = allocations;
+        while (allocation != NULL) {
+            Allocation* next = allocation->next;
+            freeAllocation(allocation);
+            allocation = next;
         }
 
         // Reset state.
@@ -317,6 +328,7 @@ class Buffer {
             firstChunk = lastChunk = cursorChunk = NULL;
             cursorOffset = ~0;
             extraAppendBytes = 0;
+            allocations = NULL;
             availableLength = sizeof32(internalAllocation) - PREPEND_SPACE;
             firstAvailable = reinterpret_cast<char*>(internalAllocation)
                     + PREPEND_SPACE;
@@ -355,10 +367,10 @@ class Buffer {
     /// part of the buffer, e.g. to service alloc and allocAux requests.
 
     /// If we must dynamically allocate space, this variable keeps
-    /// track of all the allocations so they can be freed by reset. This is
-    /// a Tub so that we don't have to construct and destroy the vector
-    /// unless it is actually used (which is fairly rare).
-    Tub<std::vector<void*>> allocations;
+    /// track of all the allocations so they can be freed by reset: it
+    /// is the most recent one, and the others are linked from it. NULL
+    /// means there are none (which is the common case).
+    Allocation* allocations;
 
     /// In some situations we have extra storage space available that
     /// isn't part of a Chunk. When this happens, the variables below
@@ -391,6 +403,24 @@ class Buffer {
     /// of the array.
     char* internalAllocation[1000/sizeof(char*)]; // NOLINT
 
+    /// Blocks of extra storage are recycled through per-thread pools, since
+    /// malloc and free are expensive enough to show up in the cost of
+    /// RPCs that overflow internalAllocation (such as large multi-reads).
+    /// Pool i holds blocks of MIN_POOLED_BYTES << i bytes (including the
+    /// Allocation header); larger blocks aren't pooled. A block may be
+    /// returned to the pool of a different thread than the one that
+    /// allocated it.
+    static const int NUM_SIZE_CLASSES = 7;
+    static const uint32_t MIN_POOLED_BYTES = 1024;
+
+    /// The most blocks kept in each pool; further blocks are freed.
+    static const uint32_t MAX_POOLED_ALLOCATIONS = 4;
+
+    /// For each size class, this thread's pool of free blocks (linked
+    /// through Allocation::next), and the number of blocks in it.
+    static __thread Allocation* freeAllocations[NUM_SIZE_CLASSES];
+    static __thread uint32_t numFreeAllocations[NUM_SIZE_CLASSES];
+
     /// How much space to reserve for prepending. This should be
     /// at least large enough for Ethernet, IP, and UDP headers.
     static const int PREPEND_SPACE  = 100;
@@ -77,6 +77,18 @@ class BufferTest: public ::testing::Test {
         return bigData;
     }
 
+    // Return the number of blocks of extra storage a buffer has.
+    uint32_t
+    countAllocations(Buffer* buffer)
+    {
+        uint32_t count = 0;
+        for (Buffer::Allocation* allocation = buffer->allocations;
+                allocation != NULL; allocation = allocation->next) {
+            count++;
+        }
+        return count;
+    }
+
     void openFile() {
         strncpy(fileName, "/tmp/ramcloud-buffer-test-delete-this-XXXXXX",
                 sizeof(fileName));
@@ -200,8 +212,7 @@ TEST_F(BufferTest, alloc_allocateNewSpace) {
     buffer.availableLength = 200;
     buffer.alloc(400 - sizeof32(Buffer::Chunk));
     EXPECT_EQ(1000u, buffer.extraAppendBytes);
-    EXPECT_TRUE(buffer.allocations);
-    EXPECT_EQ(1u, buffer.allocations->size());
+    EXPECT_EQ(1u, countAllocations(&buffer));
 }
 TEST_F(BufferTest, alloc_checkChunkLinks) {
     // Allocate three chunks: 1st and 3rd with new, 2nd with appendChunk.
@@ -449,6 +460,38 @@ TEST_F(BufferTest, copy_entireBuffer) {
     uint32_t length = buffer.copy(0, 16, copy);
     EXPECT_EQ("abcde01234567ABC", string(copy, length));
 }
+TEST_F(BufferTest, copy_allSizes) {
+    // Exercise each of the size-specific copy paths, with every alignment
+    // of the destination up to 16 bytes.
+    Buffer buffer;
+    const char* data = getBigData();
+    buffer.appendExternal(data, 1000);
+    char copy[1100];
+    for (uint32_t length = 0; length <= 40; length++) {
+        for (uint32_t align = 0; align < 16; align++) {
+            memset(copy, 'x', sizeof(copy));
+            EXPECT_EQ(length, buffer.copy(3, length, copy + align));
+            EXPECT_EQ(0, memcmp(data + 3, copy + align, length));
+            EXPECT_EQ('x', copy[align + length]);
+        }
+    }
+}
+TEST_F(BufferTest, copy_large) {
+    // Large enough for non-temporal stores, with a length that isn't a
+    // multiple of the cache line size and an unaligned destination.
+    uint32_t length = 300*1000 + 13;
+    std::vector<char> data(length);
+    for (uint32_t i = 0; i < length; i++) {
+        data[i] = downCast<char>(i % 251);
+    }
+    Buffer buffer;
+    buffer.appendExternal(&data[0], 1000);
+    buffer.appendExternal(&data[1000], length - 1000);
+    std::vector<char> copy(length + 1, 'x');
+    EXPECT_EQ(length - 1, buffer.copy(1, length - 1, &copy[1]));
+    EXPECT_EQ(0, memcmp(&data[1], &copy[1], length - 1));
+    EXPECT_EQ('x', copy[0]);
+}
 
 TEST_F(BufferTest, fillFromString) {
     Buffer b;
@@ -478,8 +521,7 @@ TEST_F(BufferTest, getNewAllocation) {
     EXPECT_TRUE(result != NULL);
     EXPECT_EQ(1200u, actualLength);
     EXPECT_EQ(1200u, buffer.totalAllocatedBytes);
-    EXPECT_TRUE(buffer.allocations);
-    EXPECT_EQ(1u, buffer.allocations->size());
+    EXPECT_EQ(1u, countAllocations(&buffer));
     EXPECT_EQ("", TestLog::get());
 
     // Second allocation: check for log message about threshold.
@@ -487,13 +529,40 @@ TEST_F(BufferTest, getNewAllocation) {
     EXPECT_TRUE(result != NULL);
     EXPECT_EQ(2800u, actualLength);
     EXPECT_EQ(4000u, buffer.totalAllocatedBytes);
-    EXPECT_EQ(2u, buffer.allocations->size());
+    EXPECT_EQ(2u, countAllocations(&buffer));
     EXPECT_EQ("getNewAllocation: buffer has consumed 4000 bytes of "
             "extra storage, current allocation: 2800 bytes",
             TestLog::get());
     EXPECT_EQ(8000u, Buffer::allocationLogThreshold);
 }
 
+TEST_F(BufferTest, getNewAllocation_pooled) {
+    // Empty this thread's pool for 2KB blocks.
+    while (Buffer::freeAllocations[1] != NULL) {
+        Buffer::Allocation* allocation = Buffer::freeAllocations[1];
+        Buffer::freeAllocations[1] = allocation->next;
+        free(allocation);
+    }
+    Buffer::numFreeAllocations[1] = 0;
+
+    // The block is returned to the pool by reset and reused.
+    Buffer buffer;
+    uint32_t actualLength;
+    char* result = buffer.getNewAllocation(193, &actualLength);
+    EXPECT_EQ(1200u, actualLength);
+    EXPECT_EQ(1, buffer.allocations->sizeClass);
+    buffer.reset();
+    EXPECT_EQ(1u, Buffer::numFreeAllocations[1]);
+    EXPECT_EQ(result, buffer.getNewAllocation(193, &actualLength));
+    EXPECT_EQ(0u, Buffer::numFreeAllocations[1]);
+
+    // Blocks too big for any pool are freed.
+    buffer.getNewAllocation(100000, &actualLength);
+    EXPECT_EQ(-1, buffer.allocations->sizeClass);
+    buffer.reset();
+    EXPECT_EQ(1u, Buffer::numFreeAllocations[1]);
+}
+
 TEST_F(BufferTest, getNumberChunks) {
     Buffer buffer;
     EXPECT_EQ(0u, buffer.getNumberChunks());
@@ -983,7 +1052,7 @@ TEST_F(BufferTest, resetInternal_partial) {
     buffer->alloc(1500);
     buffer->alloc(3000);
     buffer->appendChunk(&chunk2);
-    EXPECT_EQ(2u, buffer->allocations->size());
+    EXPECT_EQ(2u, countAllocations(buffer));
     buffer->cursorChunk = buffer->firstChunk;
     buffer->cursorOffset = 6;
     TestLog::reset();
@@ -992,7 +1061,7 @@ TEST_F(BufferTest, resetInternal_partial) {
             "~TestChunk: Destroyed chunk containing '0123'",
             TestLog::get());
     EXPECT_EQ(4510u, buffer->totalLength);
-    EXPECT_EQ(2u, buffer->allocations->size());
+    EXPECT_TRUE(buffer->allocations != NULL);
 }
 
 TEST_F(BufferTest, resetInternal_full) {
@@ -1003,7 +1072,7 @@ TEST_F(BufferTest, resetInternal_full) {
     buffer.alloc(1500);
     buffer.alloc(3000);
     buffer.appendChunk(&chunk2);
-    EXPECT_EQ(2u, buffer.allocations->size());
+    EXPECT_EQ(2u, countAllocations(&buffer));
     buffer.cursorChunk = buffer.firstChunk;
     buffer.cursorOffset = 6;
     TestLog::reset();
@@ -1018,7 +1087,7 @@ TEST_F(BufferTest, resetInternal_full) {
     EXPECT_EQ(nullChunk, buffer.cursorChunk);
     EXPECT_EQ(~0u, buffer.cursorOffset);
     EXPECT_EQ(0u, buffer.extraAppendBytes);
-    EXPECT_EQ(0u, buffer.allocations->size());
+    EXPECT_EQ(0u, countAllocations(&buffer));
     EXPECT_EQ(900u, buffer.availableLength);
     EXPECT_EQ(100u, buffer.firstAvailable - INTERNAL_ALLOC);
     EXPECT_EQ(0u, buffer.totalAllocatedBytes);
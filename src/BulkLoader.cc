@@ -0,0 +1,284 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "BulkLoader.h"
+#include "ClientException.h"
+#include "ObjectFinder.h"
+#include "SegmentIterator.h"
+
+namespace RAMCloud {
+
+/**
+ * Constructor for BulkLoadRpc: initiates an RPC in the same way as
+ * #BulkLoader does, but returns once the RPC has been initiated, without
+ * waiting for it to complete.
+ *
+ * \param ramcloud
+ *      The RAMCloud object that governs this RPC.
+ * \param tableId
+ *      The table the objects in the segment belong to.
+ * \param keyHash
+ *      Key hash in the tablet that all of the objects in the segment belong
+ *      to; it selects the master the segment is sent to.
+ * \param segment
+ *      The objects to load. Must not change or be freed until the RPC has
+ *      completed.
+ */
+BulkLoadRpc::BulkLoadRpc(RamCloud* ramcloud, uint64_t tableId,
+        uint64_t keyHash, Segment* segment)
+    : ObjectRpcWrapper(ramcloud->clientContext, tableId, keyHash,
+            sizeof(WireFormat::BulkLoad::Response))
+{
+    WireFormat::BulkLoad::Request* reqHdr(
+            allocHeader<WireFormat::BulkLoad>());
+    reqHdr->tableId = tableId;
+    segment->getAppendedLength(&reqHdr->certificate);
+    reqHdr->segmentBytes = segment->appendToBuffer(request);
+    send();
+}
+
+/**
+ * A master that doesn't own all of the objects in the segment refuses it,
+ * and retrying won't help: the segment has to be split up. So unlike other
+ * object RPCs, this one completes when that happens.
+ */
+bool
+BulkLoadRpc::checkStatus()
+{
+    if (responseHeader->status == STATUS_UNKNOWN_TABLET)
+        return true;
+    return ObjectRpcWrapper::checkStatus();
+}
+
+/**
+ * Wait for a bulk load RPC to complete.
+ *
+ * \param[out] objects
+ *      If non-NULL, the number of objects loaded is returned here.
+ * \return
+ *      True if the objects were loaded; false if the master didn't own all
+ *      of them, in which case none were loaded.
+ * \throw ClientException
+ *      The master rejected the segment for some other reason.
+ */
+bool
+BulkLoadRpc::wait(uint32_t* objects)
+{
+    waitInternal(context->dispatch);
+    const WireFormat::BulkLoad::Response* respHdr(
+            getResponseHeader<WireFormat::BulkLoad>());
+    if (respHdr->common.status == STATUS_UNKNOWN_TABLET)
+        return false;
+    if (respHdr->common.status != STATUS_OK)
+        ClientException::throwException(HERE, respHdr->common.status);
+    if (objects != NULL)
+        *objects = respHdr->objects;
+    return true;
+}
+
+/**
+ * Construct a BulkLoader.
+ *
+ * \param ramcloud
+ *      The cluster to load objects into.
+ * \param tableId
+ *      The table to load objects into.
+ * \param batchBytes
+ *      Objects are sent to a tablet's master once about this many bytes of
+ *      them have been added for the tablet. Larger batches cost fewer RPCs
+ *      and backup writes but use more memory here; each tablet being loaded
+ *      may have up to two batches in memory. The limit is the size of a
+ *      segment.
+ */
+BulkLoader::BulkLoader(RamCloud& ramcloud, uint64_t tableId,
+        uint32_t batchBytes)
+    : ramcloud(ramcloud)
+    , tableId(tableId)
+    , batchBytes(std::min(batchBytes,
+            static_cast<uint32_t>(Segment::DEFAULT_SEGMENT_SIZE)))
+    , batches()
+    , rejected()
+    , objectsLoaded(0)
+{
+}
+
+/**
+ * Destructor for BulkLoader. Objects that haven't been loaded yet (because
+ * #flush hasn't been called since they were added) are discarded.
+ */
+BulkLoader::~BulkLoader()
+{
+}
+
+/**
+ * Add an object to the table. It may not be loaded until #flush is called.
+ *
+ * \param key
+ *      Variable length key that uniquely identifies the object within the
+ *      table. It does not necessarily have to be null terminated.
+ * \param keyLength
+ *      Size in bytes of the key.
+ * \param value
+ *      The object's value.
+ * \param valueLength
+ *      Size in bytes of the value.
+ * \throw RequestTooLargeException
+ *      The object is bigger than a segment.
+ */
+void
+BulkLoader::add(const void* key, KeyLength keyLength, const void* value,
+        uint32_t valueLength)
+{
+    Key objectKey(tableId, key, keyLength);
+    Buffer objectBuffer;
+    Object object(objectKey, value, valueLength, 0, 0, objectBuffer);
+    Buffer entry;
+    object.assembleForLog(entry);
+    appendEntry(entry, objectKey.getHash());
+    resortRejected();
+}
+
+/**
+ * Send all of the objects that haven't been sent yet, and wait until all
+ * of the objects added so far have been loaded.
+ */
+void
+BulkLoader::flush()
+{
+    while (true) {
+        foreach (auto& batch, batches) {
+            if (batch.second->filling)
+                send(batch.second.get());
+        }
+        foreach (auto& batch, batches)
+            finish(batch.second.get());
+        if (rejected.empty())
+            break;
+        resortRejected();
+    }
+}
+
+/**
+ * Add a serialized object to the batch of its tablet, and send the batch if
+ * it's full.
+ *
+ * \param entry
+ *      The object, as assembled for the log.
+ * \param keyHash
+ *      Hash of the object's primary key.
+ */
+void
+BulkLoader::appendEntry(Buffer& entry, KeyHash keyHash)
+{
+    Batch* batch = findBatch(keyHash);
+    if (batch->filling && (batch->filling->getAppendedLength() +
+            entry.size() > batchBytes)) {
+        send(batch);
+    }
+    if (!batch->filling)
+        batch->filling.reset(new Segment());
+    if (!batch->filling->append(LOG_ENTRY_TYPE_OBJ, entry))
+        throw RequestTooLargeException(HERE);
+}
+
+/**
+ * Return the batch of the tablet that holds a key hash, creating it if
+ * there isn't one yet.
+ */
+BulkLoader::Batch*
+BulkLoader::findBatch(KeyHash keyHash)
+{
+    auto it = batches.upper_bound(keyHash);
+    if (it != batches.begin()) {
+        --it;
+        if (keyHash <= it->second->endKeyHash)
+            return it->second.get();
+    }
+    const Tablet& tablet = ramcloud.clientContext->objectFinder->lookupTablet(
+            tableId, keyHash)->tablet;
+    Batch* batch = new Batch(tablet.startKeyHash, tablet.endKeyHash);
+    batches[tablet.startKeyHash].reset(batch);
+    return batch;
+}
+
+/**
+ * Wait for a batch's outstanding RPC, if it has one, to complete. If the
+ * master refused the segment, it's added to #rejected.
+ */
+void
+BulkLoader::finish(Batch* batch)
+{
+    if (!batch->rpc)
+        return;
+    uint32_t objects = 0;
+    bool loaded = batch->rpc->wait(&objects);
+    batch->rpc.destroy();
+    if (loaded) {
+        objectsLoaded += objects;
+        batch->sending.reset();
+    } else {
+        rejected.push_back(std::move(batch->sending));
+    }
+}
+
+/**
+ * If masters have refused any segments, the tablet configuration this
+ * loader has been using is out of date. Fetch it again, and sort the objects
+ * of the refused segments, along with those of every batch, into new
+ * batches.
+ */
+void
+BulkLoader::resortRejected()
+{
+    if (rejected.empty())
+        return;
+    ramcloud.clientContext->objectFinder->flush(tableId);
+    foreach (auto& batch, batches) {
+        finish(batch.second.get());
+        if (batch.second->filling)
+            rejected.push_back(std::move(batch.second->filling));
+    }
+    batches.clear();
+
+    // Adding the objects again may send batches, any of which could be
+    // refused too.
+    while (!rejected.empty()) {
+        std::unique_ptr<Segment> segment(std::move(rejected.back()));
+        rejected.pop_back();
+        for (SegmentIterator it(*segment); !it.isDone(); it.next()) {
+            Buffer entry;
+            it.appendToBuffer(entry);
+            Object object(entry);
+            KeyLength keyLength = 0;
+            const void* key = object.getKey(0, &keyLength);
+            appendEntry(entry, Key::getHash(tableId, key, keyLength));
+        }
+    }
+}
+
+/**
+ * Start loading the objects that have been added to a batch but not sent,
+ * once the batch's last RPC has completed.
+ */
+void
+BulkLoader::send(Batch* batch)
+{
+    finish(batch);
+    batch->sending = std::move(batch->filling);
+    batch->rpc.construct(&ramcloud, tableId, batch->startKeyHash,
+            batch->sending.get());
+}
+
+} // namespace RAMCloud
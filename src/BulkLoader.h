@@ -0,0 +1,135 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_BULKLOADER_H
+#define RAMCLOUD_BULKLOADER_H
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "ObjectRpcWrapper.h"
+#include "RamCloud.h"
+#include "Segment.h"
+
+namespace RAMCloud {
+
+/**
+ * Encapsulates the state of one BULK_LOAD request, which asks the master
+ * that owns a tablet to add a segment of objects to it.
+ */
+class BulkLoadRpc : public ObjectRpcWrapper {
+  PUBLIC:
+    BulkLoadRpc(RamCloud* ramcloud, uint64_t tableId, uint64_t keyHash,
+            Segment* segment);
+    ~BulkLoadRpc() {}
+    bool wait(uint32_t* objects = NULL);
+
+  PROTECTED:
+    bool checkStatus();
+
+  PRIVATE:
+    DISALLOW_COPY_AND_ASSIGN(BulkLoadRpc);
+};
+
+/**
+ * Loads a large number of new objects into a table much faster than writing
+ * them one at a time. The objects are sorted by tablet and serialized into
+ * segments here on the client, in the same format masters keep in their
+ * logs; when a tablet's segment is full it is sent to the tablet's master in
+ * a single BULK_LOAD RPC, and the master adds the whole segment to its log
+ * the way it adds recovered data (see ObjectManager::bulkLoad). Segments for
+ * different tablets are sent in parallel, and the next segment for a tablet
+ * is filled while the last one is being loaded.
+ *
+ * Each segment is loaded atomically, but objects aren't loaded in the order
+ * they were added, and an object may not be loaded until #flush is called.
+ * Loaded objects replace existing objects with the same keys. Index entries
+ * aren't created for loaded objects, so indexes should be created once the
+ * table has been loaded; if the table has indexes already, use ordinary
+ * writes instead.
+ */
+class BulkLoader {
+  PUBLIC:
+    BulkLoader(RamCloud& ramcloud, uint64_t tableId,
+            uint32_t batchBytes = 1024 * 1024);
+    ~BulkLoader();
+    void add(const void* key, KeyLength keyLength, const void* value,
+            uint32_t valueLength);
+    void flush();
+
+    /// Return the number of objects that masters have loaded so far.
+    uint64_t getObjectsLoaded() const { return objectsLoaded; }
+
+  PRIVATE:
+    /// The objects added for one tablet.
+    struct Batch {
+        Batch(uint64_t startKeyHash, uint64_t endKeyHash)
+            : startKeyHash(startKeyHash)
+            , endKeyHash(endKeyHash)
+            , filling()
+            , sending()
+            , rpc()
+        {}
+
+        /// The range of key hashes of the tablet.
+        uint64_t startKeyHash;
+        uint64_t endKeyHash;
+
+        /// Objects that haven't been sent yet, or NULL if there are none.
+        std::unique_ptr<Segment> filling;
+
+        /// The objects #rpc is loading, or NULL if there is no RPC.
+        std::unique_ptr<Segment> sending;
+
+        /// Outstanding request to load #sending.
+        Tub<BulkLoadRpc> rpc;
+
+        DISALLOW_COPY_AND_ASSIGN(Batch);
+    };
+
+    void appendEntry(Buffer& entry, KeyHash keyHash);
+    Batch* findBatch(KeyHash keyHash);
+    void finish(Batch* batch);
+    void resortRejected();
+    void send(Batch* batch);
+
+    /// Used to find and talk to the masters.
+    RamCloud& ramcloud;
+
+    /// The table being loaded.
+    uint64_t tableId;
+
+    /// Send a tablet's objects once it has about this many bytes of them.
+    uint32_t batchBytes;
+
+    /// The batch of each tablet that objects have been added for, by the
+    /// tablet's first key hash.
+    std::map<uint64_t, std::unique_ptr<Batch>> batches;
+
+    /// Segments that masters refused because they hold objects of tablets
+    /// the masters no longer own (the tablet was split or moved after the
+    /// batch was started). None of the objects in them were loaded.
+    std::vector<std::unique_ptr<Segment>> rejected;
+
+    /// See getObjectsLoaded.
+    uint64_t objectsLoaded;
+
+    DISALLOW_COPY_AND_ASSIGN(BulkLoader);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_BULKLOADER_H
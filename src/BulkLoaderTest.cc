@@ -0,0 +1,139 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "BulkLoader.h"
+#include "MockCluster.h"
+#include "ObjectFinder.h"
+
+namespace RAMCloud {
+
+class BulkLoaderTest : public ::testing::Test {
+  public:
+    TestLog::Enable logEnabler;
+    Context context;
+    MockCluster cluster;
+    RamCloud ramcloud;
+    Server* master1;
+    Server* master2;
+    uint64_t tableId;
+
+  public:
+    BulkLoaderTest()
+        : logEnabler()
+        , context()
+        , cluster(&context)
+        , ramcloud(&context, "mock:host=coordinator")
+        , master1()
+        , master2()
+        , tableId(-1)
+    {
+        Logger::get().setLogLevels(RAMCloud::SILENT_LOG_LEVEL);
+
+        ServerConfig config = ServerConfig::forTesting();
+        config.services = {WireFormat::MASTER_SERVICE,
+                           WireFormat::PING_SERVICE};
+        config.master.numReplicas = 0;
+        config.localLocator = "mock:host=master1";
+        master1 = cluster.addServer(config);
+        config.localLocator = "mock:host=master2";
+        master2 = cluster.addServer(config);
+    }
+
+    void
+    add(BulkLoader* loader, int first, int count)
+    {
+        for (int i = first; i < first + count; i++) {
+            string key = format("key%d", i);
+            string value = format("value%d", i);
+            loader->add(key.c_str(), downCast<KeyLength>(key.size()),
+                    value.c_str(), downCast<uint32_t>(value.size()));
+        }
+    }
+
+    string
+    read(const char* key)
+    {
+        Buffer value;
+        ramcloud.read(tableId, key, downCast<uint16_t>(strlen(key)), &value);
+        return TestUtil::toString(&value);
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(BulkLoaderTest);
+};
+
+TEST_F(BulkLoaderTest, addAndFlush) {
+    tableId = ramcloud.createTable("table1", 2);
+    uint64_t version;
+    ramcloud.write(tableId, "key3", 4, "old", 3, NULL, &version);
+
+    BulkLoader loader(ramcloud, tableId);
+    add(&loader, 0, 10);
+    EXPECT_EQ(0u, loader.getObjectsLoaded());
+    loader.flush();
+    EXPECT_EQ(10u, loader.getObjectsLoaded());
+
+    EXPECT_EQ("value0", read("key0"));
+    EXPECT_EQ("value9", read("key9"));
+    Buffer value;
+    uint64_t newVersion;
+    ramcloud.read(tableId, "key3", 4, &value, NULL, &newVersion);
+    EXPECT_EQ("value3", TestUtil::toString(&value));
+    EXPECT_GT(newVersion, version);
+
+    // Nothing is left to send.
+    loader.flush();
+    EXPECT_EQ(10u, loader.getObjectsLoaded());
+}
+
+TEST_F(BulkLoaderTest, add_sendsFullBatches) {
+    tableId = ramcloud.createTable("table1");
+    BulkLoader loader(ramcloud, tableId, 100);
+    add(&loader, 0, 10);
+    EXPECT_LT(0u, loader.getObjectsLoaded());
+    loader.flush();
+    EXPECT_EQ(10u, loader.getObjectsLoaded());
+    EXPECT_EQ("value5", read("key5"));
+}
+
+TEST_F(BulkLoaderTest, add_objectTooLarge) {
+    tableId = ramcloud.createTable("table1");
+    BulkLoader loader(ramcloud, tableId);
+    string value(Segment::DEFAULT_SEGMENT_SIZE, 'x');
+    EXPECT_THROW(loader.add("big", 3, value.c_str(),
+            downCast<uint32_t>(value.size())), RequestTooLargeException);
+}
+
+TEST_F(BulkLoaderTest, resortRejected) {
+    tableId = ramcloud.createTable("table1");
+    BulkLoader loader(ramcloud, tableId);
+    add(&loader, 0, 5);
+
+    // Move the tablet after the loader has looked it up, so the first
+    // segment goes to the wrong master.
+    ServerId owner = ramcloud.clientContext->objectFinder->lookupTablet(
+            tableId, 0)->tablet.serverId;
+    Server* other = (owner == master1->serverId) ? master2 : master1;
+    ramcloud.migrateTablet(tableId, 0, ~0UL, other->serverId);
+
+    loader.flush();
+    EXPECT_EQ(5u, loader.getObjectsLoaded());
+    EXPECT_EQ("value0", read("key0"));
+    EXPECT_EQ("value4", read("key4"));
+    EXPECT_EQ(other->serverId, ramcloud.clientContext->objectFinder->
+            lookupTablet(tableId, 0)->tablet.serverId);
+}
+
+} // namespace RAMCloud
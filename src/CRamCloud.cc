@@ -21,6 +21,7 @@
 #include "RamCloud.h"
 #include "CRamCloud.h"
 #include "ClientException.h"
+#include "ClientReadCache.h"
 #include "Logger.h"
 #include "TableEnumerator.h"
 
@@ -52,6 +53,23 @@ struct rc_multiReadHelper {
     DISALLOW_COPY_AND_ASSIGN(rc_multiReadHelper);
 };
 
+/**
+ * The state of an asynchronous read or write started by rc_readAsync or
+ * rc_writeAsync; C callers only see pointers to it.
+ */
+struct rc_rpc {
+    rc_rpc()
+        : value()
+        , read()
+        , write()
+        {}
+    Buffer value;          ///< Holds the object's value, for a read.
+    Tub<ReadRpc> read;     ///< The RPC, if this is a read.
+    Tub<WriteRpc> write;   ///< The RPC, if this is a write.
+
+    DISALLOW_COPY_AND_ASSIGN(rc_rpc);
+};
+
 /**
  * Create a new client connection to a RAMCloud cluster.
  *
@@ -404,16 +422,9 @@ rc_read(struct rc_client* client, uint64_t tableId,
         const struct RejectRules* rejectRules, uint64_t* version,
         void* buf, uint32_t maxLength, uint32_t* actualLength)
 {
-    Buffer result;
     try {
-        client->client->read(tableId, key, keyLength, &result, rejectRules,
-                version);
-        *actualLength = result.size();
-        uint32_t bytesToCopy = *actualLength;
-        if (bytesToCopy > maxLength) {
-            bytesToCopy = maxLength;
-        }
-        result.copy(0, bytesToCopy, buf);
+        client->client->read(tableId, key, keyLength, buf, maxLength,
+                actualLength, rejectRules, version);
     } catch (ClientException& e) {
         *actualLength = 0;
         return e.status;
@@ -477,6 +488,198 @@ rc_write(struct rc_client* client, uint64_t tableId,
     return STATUS_OK;
 }
 
+// Asynchronous reads and writes take two calls: rc_readAsync or
+// rc_writeAsync starts the operation and returns a handle for it, and then
+// rc_readWait or rc_writeWait waits for it to finish, returns its results,
+// and frees the handle. Any number of operations can be outstanding at
+// once, so a single thread can keep many servers busy; rc_isReady lets the
+// caller find out whether an operation has finished without waiting.
+
+/**
+ * Start reading an object, like rc_read, but return without waiting for
+ * the read to complete.
+ *
+ * \param client
+ *      Handle for the RAMCloud connection.
+ * \param tableId
+ *      The table containing the desired object (return value from
+ *      a previous call to getTableId).
+ * \param key
+ *      Variable length key that uniquely identifies the object within tableId.
+ *      It does not necessarily have to be null terminated like a string.
+ *      The caller must not modify or free it until rc_readWait returns.
+ * \param keyLength
+ *      Size in bytes of the key.
+ * \param rejectRules
+ *      If non-NULL, specifies conditions under which the read
+ *      should be aborted with an error.
+ * \param[out] rpc
+ *      A handle for the read is returned here; it must be passed to
+ *      rc_readWait, which frees it.
+ *
+ * \return
+ *      0 means the read was started, anything else indicates an error.
+ */
+Status
+rc_readAsync(struct rc_client* client, uint64_t tableId,
+        const void* key, uint16_t keyLength,
+        const struct RejectRules* rejectRules, struct rc_rpc** rpc)
+{
+    *rpc = new rc_rpc;
+    try {
+        (*rpc)->read.construct(client->client, tableId, key, keyLength,
+                &(*rpc)->value, rejectRules);
+    } catch (ClientException& e) {
+        delete *rpc;
+        *rpc = NULL;
+        return e.status;
+    }
+    return STATUS_OK;
+}
+
+/**
+ * Wait for a read started by rc_readAsync to complete, and return its
+ * results in the same way as rc_read. The handle is freed.
+ *
+ * \param rpc
+ *      The handle returned by rc_readAsync.
+ * \param[out] version
+ *      If non-NULL, the version number of the object is returned
+ *      here.
+ * \param[out] buf
+ *      The contents of the desired object are copied to this location.
+ * \param maxLength
+ *      Number of bytes of space available at buf: if the object is
+ *      larger than this that only this many bytes will be copied to
+ *      buf.
+ * \param[out] actualLength
+ *      The total size of the object is stored here; this may be
+ *      larger than maxLength.
+ *
+ * \return
+ *      0 means success, anything else indicates an error.
+ */
+Status
+rc_readWait(struct rc_rpc* rpc, uint64_t* version, void* buf,
+        uint32_t maxLength, uint32_t* actualLength)
+{
+    Status status = STATUS_OK;
+    *actualLength = 0;
+    try {
+        rpc->read->wait(version);
+        *actualLength = rpc->value.size();
+        rpc->value.copy(0, std::min(maxLength, *actualLength), buf);
+    } catch (ClientException& e) {
+        status = e.status;
+    } catch (std::exception& e) {
+        RAMCLOUD_LOG(ERROR, "An unhandled C++ Exception occurred: %s",
+                e.what());
+        status = STATUS_INTERNAL_ERROR;
+    }
+    delete rpc;
+    return status;
+}
+
+/**
+ * Start writing an object, like rc_write, but return without waiting for
+ * the write to complete.
+ *
+ * \param client
+ *      Handle for the RAMCloud connection.
+ * \param tableId
+ *      The table containing the desired object (return value from
+ *      a previous call to getTableId).
+ * \param key
+ *      Variable length key that uniquely identifies the object within tableId.
+ *      It does not necessarily have to be null terminated like a string.
+ *      The caller must not modify or free it until rc_writeWait returns.
+ * \param keyLength
+ *      Size in bytes of the key.
+ * \param buf
+ *      Address of the first byte of the new contents for the object;
+ *      the caller must not modify or free it until rc_writeWait returns.
+ * \param length
+ *      Size in bytes of the new contents for the object.
+ * \param rejectRules
+ *      If non-NULL, specifies conditions under which the write
+ *      should be aborted with an error.
+ * \param[out] rpc
+ *      A handle for the write is returned here; it must be passed to
+ *      rc_writeWait, which frees it.
+ *
+ * \return
+ *      0 means the write was started, anything else indicates an error.
+ */
+Status
+rc_writeAsync(struct rc_client* client, uint64_t tableId,
+        const void* key, uint16_t keyLength, const void* buf, uint32_t length,
+        const struct RejectRules* rejectRules, struct rc_rpc** rpc)
+{
+    if (client->client->readCache != NULL)
+        client->client->readCache->invalidate(tableId, key, keyLength);
+    *rpc = new rc_rpc;
+    try {
+        (*rpc)->write.construct(client->client, tableId, key, keyLength,
+                buf, length, rejectRules);
+    } catch (ClientException& e) {
+        delete *rpc;
+        *rpc = NULL;
+        return e.status;
+    }
+    return STATUS_OK;
+}
+
+/**
+ * Wait for a write started by rc_writeAsync to complete, and return its
+ * results in the same way as rc_write. The handle is freed.
+ *
+ * \param rpc
+ *      The handle returned by rc_writeAsync.
+ * \param[out] version
+ *      If non-NULL, the version number of the new object is returned here.
+ *
+ * \return
+ *      0 means success, anything else indicates an error.
+ */
+Status
+rc_writeWait(struct rc_rpc* rpc, uint64_t* version)
+{
+    Status status = STATUS_OK;
+    try {
+        rpc->write->wait(version);
+    } catch (ClientException& e) {
+        status = e.status;
+    } catch (std::exception& e) {
+        RAMCLOUD_LOG(ERROR, "An unhandled C++ Exception occurred: %s",
+                e.what());
+        status = STATUS_INTERNAL_ERROR;
+    }
+    delete rpc;
+    return status;
+}
+
+/**
+ * Find out whether an operation started by rc_readAsync or rc_writeAsync
+ * has finished (so that waiting for it won't block). This also lets the
+ * client make progress on all of its outstanding operations.
+ *
+ * \param client
+ *      Handle for the RAMCloud connection that started the operation.
+ * \param rpc
+ *      The handle for the operation.
+ *
+ * \return
+ *      Nonzero means the operation has finished.
+ */
+int
+rc_isReady(struct rc_client* client, struct rc_rpc* rpc)
+{
+    client->client->poll();
+    if (rpc->read)
+        return rpc->read->isReady();
+    return rpc->write->isReady();
+}
+
 // Multi-op calls require three steps from the C user.  A first bunch of calls
 // constructs the C++ Multi{Read,Write,Remove}Object objects, the second
 // step issues the multi-op RPC, and in a last step a bunch of calls destructs
@@ -34,6 +34,7 @@ using namespace RAMCloud;
 struct RamCloud;
 struct rc_client;
 #endif
+struct rc_rpc;
 
 typedef enum MultiOp {
   MULTI_OP_INCREMENT = 0,
@@ -95,6 +96,21 @@ Status    rc_write(struct rc_client* client, uint64_t tableId,
                              const struct RejectRules* rejectRules,
                              uint64_t* version);
 
+Status    rc_readAsync(struct rc_client* client, uint64_t tableId,
+                            const void* key, uint16_t keyLength,
+                            const struct RejectRules* rejectRules,
+                            struct rc_rpc** rpc);
+Status    rc_readWait(struct rc_rpc* rpc, uint64_t* version,
+                            void* buf, uint32_t maxLength,
+                            uint32_t* actualLength);
+Status    rc_writeAsync(struct rc_client* client, uint64_t tableId,
+                             const void* key, uint16_t keyLength,
+                             const void* buf, uint32_t length,
+                             const struct RejectRules* rejectRules,
+                             struct rc_rpc** rpc);
+Status    rc_writeWait(struct rc_rpc* rpc, uint64_t* version);
+int       rc_isReady(struct rc_client* client, struct rc_rpc* rpc);
+
 void      rc_multiIncrementCreate(uint64_t tableId,
                                   const void *key, uint16_t keyLength,
                                   int64_t incrementInt64,
@@ -365,6 +365,41 @@ TEST_F(CRamCloudTest, rc_read_short) {
     EXPECT_EQ(buf, value[0]);
 }
 
+TEST_F(CRamCloudTest, rc_readAsyncAndWriteAsync) {
+    // Several writes outstanding at once.
+    rc_rpc* writes[3];
+    const char* keys[3] = {"k0", "k1", "k2"};
+    for (int i = 0; i < 3; i++) {
+        status = rc_writeAsync(client, tableId1, keys[i], 2,
+                               value.data(), valueLength, NULL, &writes[i]);
+        EXPECT_EQ(status, STATUS_OK);
+    }
+    EXPECT_TRUE(rc_isReady(client, writes[0]));
+    uint64_t version = 0;
+    for (int i = 0; i < 3; i++) {
+        status = rc_writeWait(writes[i], &version);
+        EXPECT_EQ(status, STATUS_OK);
+        EXPECT_GT(version, uint64_t(0));
+    }
+
+    rc_rpc* read;
+    status = rc_readAsync(client, tableId1, "k1", 2, NULL, &read);
+    EXPECT_EQ(status, STATUS_OK);
+    char buf[10];
+    uint32_t actualLength = 0;
+    status = rc_readWait(read, &version, buf, sizeof(buf), &actualLength);
+    EXPECT_EQ(status, STATUS_OK);
+    EXPECT_EQ(actualLength, valueLength);
+    EXPECT_EQ(std::string(buf, actualLength), value);
+
+    // Errors come back from the wait.
+    status = rc_readAsync(client, tableId1, "missing", 7, NULL, &read);
+    EXPECT_EQ(status, STATUS_OK);
+    status = rc_readWait(read, NULL, buf, sizeof(buf), &actualLength);
+    EXPECT_EQ(status, STATUS_OBJECT_DOESNT_EXIST);
+    EXPECT_EQ(0U, actualLength);
+}
+
 TEST_F(CRamCloudTest, rc_read_TableDoesntExist) {
     char buf;
     uint32_t actualLength;
@@ -0,0 +1,257 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "ChangeStream.h"
+#include "Cycles.h"
+#include "Key.h"
+#include "RawMetrics.h"
+#include "WireFormat.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct a ChangeStream; initially no table is streamed.
+ *
+ * \param capacity
+ *      Number of bytes of changes the stream keeps; this must be larger
+ *      than the largest object.
+ */
+ChangeStream::ChangeStream(uint32_t capacity)
+    : mutex("ChangeStream::mutex")
+    , capacity(capacity)
+    , ring()
+    , head(0)
+    , tail(0)
+    , tables()
+    , nextIdleCheck(0)
+    , enabled(false)
+{
+}
+
+/**
+ * Read the changes to one tablet from the stream, in the order they were
+ * made.
+ *
+ * \param tableId
+ *      The table containing the tablet.
+ * \param firstKeyHash
+ *      Smallest key hash in the tablet.
+ * \param lastKeyHash
+ *      Largest key hash in the tablet.
+ * \param position
+ *      Position in the stream of the first change to read: returned by
+ *      #subscribe or by an earlier read.
+ * \param maxBytes
+ *      Stop once about this many bytes of changes have been read.
+ * \param[out] changes
+ *      The changes are appended here, each a WireFormat::ReadChanges::Change
+ *      followed by its log entry.
+ * \param[out] nextPosition
+ *      Where the next read should start.
+ * \param[out] lagMicros
+ *      How long ago the change at \a nextPosition was made, in microseconds;
+ *      0 means there are no more changes yet.
+ * \return
+ *      True means the changes were read. False means the changes at
+ *      \a position are no longer in the stream (or the table isn't
+ *      streamed, or \a position isn't one this stream returned), so the
+ *      reader has missed some and must start over.
+ */
+bool
+ChangeStream::read(uint64_t tableId, uint64_t firstKeyHash,
+        uint64_t lastKeyHash, uint64_t position, uint32_t maxBytes,
+        Buffer* changes, uint64_t* nextPosition, uint32_t* lagMicros)
+{
+    SpinLock::Guard _(mutex);
+    auto it = tables.find(tableId);
+    if ((it == tables.end()) || (position < tail) || (position > head))
+        return false;
+    uint64_t now = Cycles::rdtsc();
+    it->second = now;
+
+    uint64_t end = std::min(head, position + MAX_SCAN_BYTES);
+    uint32_t bytes = 0;
+    while ((position < end) && (bytes < maxBytes)) {
+        Record record;
+        copyOut(position, &record, sizeof32(record));
+        if (position + sizeof32(record) + record.length > head) {
+            // A malformed position, which doesn't start a change.
+            return false;
+        }
+        if ((record.tableId == tableId) && (record.keyHash >= firstKeyHash)
+                && (record.keyHash <= lastKeyHash)) {
+            WireFormat::ReadChanges::Change* change =
+                    changes->emplaceAppend<WireFormat::ReadChanges::Change>();
+            change->type = record.type;
+            change->length = record.length;
+            copyOut(position + sizeof32(record),
+                    changes->alloc(record.length), record.length);
+            bytes += sizeof32(*change) + record.length;
+        }
+        position += sizeof32(record) + record.length;
+    }
+
+    *nextPosition = position;
+    *lagMicros = 0;
+    if (position < head) {
+        Record record;
+        copyOut(position, &record, sizeof32(record));
+        *lagMicros = downCast<uint32_t>(std::min<uint64_t>(~0u,
+                Cycles::toMicroseconds(now - record.appendTime)));
+    }
+    metrics->changeStream.lagMicros = *lagMicros;
+    return true;
+}
+
+/**
+ * This method is invoked by the log for each object and tombstone it
+ * appends (see AbstractLog::setChangeStream). If the entry belongs to a
+ * streamed table it becomes the stream's newest change, discarding the
+ * oldest changes if there isn't room.
+ *
+ * \param type
+ *      Type of the entry.
+ * \param entry
+ *      The entry, as appended to the log.
+ */
+void
+ChangeStream::record(LogEntryType type, Buffer& entry)
+{
+    SpinLock::Guard _(mutex);
+    uint64_t now = Cycles::rdtsc();
+    if (now > nextIdleCheck)
+        dropIdleTables(now);
+
+    if (type != LOG_ENTRY_TYPE_OBJ && type != LOG_ENTRY_TYPE_OBJTOMB)
+        return;
+    Key key(type, entry);
+    uint64_t tableId = key.getTableId();
+    if (tables.find(tableId) == tables.end())
+        return;
+
+    uint32_t length = entry.size();
+    uint64_t needed = sizeof32(Record) + length;
+    metrics->changeStream.recordCount++;
+    metrics->changeStream.recordBytes += needed;
+    if (needed > capacity) {
+        // The change can't be kept, so every reader has missed it.
+        head += needed;
+        tail = head;
+        return;
+    }
+    while (head + needed - tail > capacity) {
+        Record oldest;
+        copyOut(tail, &oldest, sizeof32(oldest));
+        tail += sizeof32(oldest) + oldest.length;
+    }
+
+    Record record = {tableId, key.getHash(), now, length,
+            downCast<uint8_t>(type)};
+    copyIn(head, &record, sizeof32(record));
+    uint64_t position = head + sizeof32(record);
+    for (Buffer::Iterator it(&entry); !it.isDone(); it.next()) {
+        copyIn(position, it.getData(), it.getLength());
+        position += it.getLength();
+    }
+    head = position;
+}
+
+/**
+ * Start streaming a table's changes, if they aren't already.
+ *
+ * \param tableId
+ *      The table to stream.
+ * \return
+ *      The stream's current position: every change to the table from now
+ *      on will be read by a reader starting here.
+ */
+uint64_t
+ChangeStream::subscribe(uint64_t tableId)
+{
+    SpinLock::Guard _(mutex);
+    if (ring.empty())
+        ring.resize(capacity);
+    tables[tableId] = Cycles::rdtsc();
+    enabled.store(true, std::memory_order_relaxed);
+    return head;
+}
+
+/**
+ * Copy data into the ring, wrapping around its end if necessary. The
+ * caller must hold mutex.
+ *
+ * \param position
+ *      Stream position of the first byte.
+ * \param data
+ *      The bytes to copy.
+ * \param length
+ *      Number of bytes to copy; at most #capacity.
+ */
+void
+ChangeStream::copyIn(uint64_t position, const void* data, uint32_t length)
+{
+    uint32_t offset = downCast<uint32_t>(position % capacity);
+    uint32_t first = std::min(length, capacity - offset);
+    memcpy(&ring[offset], data, first);
+    memcpy(&ring[0], static_cast<const uint8_t*>(data) + first,
+            length - first);
+}
+
+/**
+ * Copy data out of the ring, wrapping around its end if necessary. The
+ * caller must hold mutex.
+ *
+ * \param position
+ *      Stream position of the first byte.
+ * \param[out] data
+ *      The bytes are copied here.
+ * \param length
+ *      Number of bytes to copy; at most #capacity.
+ */
+void
+ChangeStream::copyOut(uint64_t position, void* data, uint32_t length)
+{
+    uint32_t offset = downCast<uint32_t>(position % capacity);
+    uint32_t first = std::min(length, capacity - offset);
+    memcpy(data, &ring[offset], first);
+    memcpy(static_cast<uint8_t*>(data) + first, &ring[0], length - first);
+}
+
+/**
+ * Stop streaming the tables that no one has read for IDLE_SECONDS. The
+ * caller must hold mutex.
+ *
+ * \param now
+ *      Cycles::rdtsc() time.
+ */
+void
+ChangeStream::dropIdleTables(uint64_t now)
+{
+    uint64_t idleCycles = Cycles::fromSeconds(IDLE_SECONDS);
+    for (auto it = tables.begin(); it != tables.end(); ) {
+        if (now - it->second > idleCycles) {
+            RAMCLOUD_LOG(NOTICE, "No longer streaming changes to tableId %lu: "
+                    "no one has read them for %u seconds", it->first,
+                    IDLE_SECONDS);
+            it = tables.erase(it);
+        } else {
+            it++;
+        }
+    }
+    enabled.store(!tables.empty(), std::memory_order_relaxed);
+    nextIdleCheck = now + Cycles::fromSeconds(1);
+}
+
+} // namespace RAMCloud
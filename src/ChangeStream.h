@@ -0,0 +1,133 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_CHANGESTREAM_H
+#define RAMCLOUD_CHANGESTREAM_H
+
+#include <atomic>
+#include <unordered_map>
+
+#include "Buffer.h"
+#include "LogEntryTypes.h"
+#include "SpinLock.h"
+
+namespace RAMCloud {
+
+/**
+ * A master's ordered stream of changes to selected tables, which lets a
+ * ChangeStreamReceiver keep a copy of the tables in another cluster (a
+ * warm standby in another datacenter, for example). Every object and
+ * tombstone that the master's Log appends for a streamed table is copied
+ * into the stream as it is appended, so the stream holds the changes in
+ * exactly the order they were made; entries the cleaner relocates aren't
+ * changes and aren't streamed.
+ *
+ * The stream keeps only its newest changes, in a ring of a fixed number of
+ * bytes; a position in the stream is the number of bytes recorded before
+ * it. A reader that falls so far behind that its position has been
+ * overwritten must start over (see WireFormat::ReadChanges), so the ring's
+ * size bounds how far behind a reader may fall.
+ *
+ * A table stops being streamed once no one has read its changes for
+ * IDLE_SECONDS, and the ring isn't allocated until a table is first
+ * streamed. This class is thread-safe.
+ */
+class ChangeStream {
+  PUBLIC:
+    /// Largest number of bytes of the ring that one read examines, so that
+    /// appends, which record their changes under the same lock, aren't held
+    /// up for long.
+    static const uint32_t MAX_SCAN_BYTES = 1 << 20;
+
+    /// A table whose changes haven't been read for this many seconds is no
+    /// longer streamed.
+    static const uint32_t IDLE_SECONDS = 600;
+
+    explicit ChangeStream(uint32_t capacity);
+    bool read(uint64_t tableId, uint64_t firstKeyHash, uint64_t lastKeyHash,
+            uint64_t position, uint32_t maxBytes, Buffer* changes,
+            uint64_t* nextPosition, uint32_t* lagMicros);
+    void record(LogEntryType type, Buffer& entry);
+    uint64_t subscribe(uint64_t tableId);
+
+    /**
+     * Return true if any table is streamed; lets the log skip all other
+     * work when streaming isn't in use.
+     */
+    bool
+    isEnabled()
+    {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+  PRIVATE:
+    /**
+     * Each change in the ring starts with one of these, and is followed by
+     * the log entry.
+     */
+    struct Record {
+        /// The table the entry belongs to.
+        uint64_t tableId;
+
+        /// Key hash of the entry's object.
+        uint64_t keyHash;
+
+        /// Cycles::rdtsc() time when the entry was appended.
+        uint64_t appendTime;
+
+        /// Length of the entry, in bytes.
+        uint32_t length;
+
+        /// Type of the entry: LOG_ENTRY_TYPE_OBJ or LOG_ENTRY_TYPE_OBJTOMB.
+        uint8_t type;
+    } __attribute__((packed));
+
+    void copyIn(uint64_t position, const void* data, uint32_t length);
+    void copyOut(uint64_t position, void* data, uint32_t length);
+    void dropIdleTables(uint64_t now);
+
+    /// Monitor-style lock for the members below.
+    SpinLock mutex;
+
+    /// Size of #ring, in bytes.
+    uint32_t capacity;
+
+    /// Holds the stream's newest changes; the byte at position p is at
+    /// index p % capacity. Empty until a table is streamed.
+    vector<uint8_t> ring;
+
+    /// Position just past the newest change.
+    uint64_t head;
+
+    /// Position of the oldest change still in #ring.
+    uint64_t tail;
+
+    /// Tables whose changes are streamed, and the Cycles::rdtsc() time
+    /// when each one's changes were last read.
+    std::unordered_map<uint64_t, uint64_t> tables;
+
+    /// Cycles::rdtsc() time after which #record should next look for idle
+    /// tables.
+    uint64_t nextIdleCheck;
+
+    /// True when #tables isn't empty; readable without mutex.
+    std::atomic<bool> enabled;
+
+    DISALLOW_COPY_AND_ASSIGN(ChangeStream);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_CHANGESTREAM_H
@@ -0,0 +1,328 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <unordered_map>
+
+#include "ChangeStreamReceiver.h"
+#include "ClientException.h"
+#include "Object.h"
+#include "ObjectFinder.h"
+#include "ShortMacros.h"
+#include "TableEnumerator.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct a ChangeStreamReceiver. No changes are read until the first
+ * call to #poll.
+ *
+ * \param source
+ *      The cluster whose table is replicated.
+ * \param sourceTableId
+ *      The table to replicate.
+ * \param target
+ *      The cluster to hold the copy; may be the same as \a source.
+ * \param targetTableId
+ *      The table to hold the copy, which must already exist. Its other
+ *      objects are left alone.
+ * \param maxBytes
+ *      Largest number of bytes of changes to read from a tablet at once.
+ */
+ChangeStreamReceiver::ChangeStreamReceiver(RamCloud* source,
+        uint64_t sourceTableId, RamCloud* target, uint64_t targetTableId,
+        uint32_t maxBytes)
+    : source(source)
+    , sourceTableId(sourceTableId)
+    , target(target)
+    , targetTableId(targetTableId)
+    , maxBytes(maxBytes)
+    , streams()
+    , needResync(true)
+{
+}
+
+/**
+ * Destructor for ChangeStreamReceiver; any outstanding reads are canceled.
+ */
+ChangeStreamReceiver::~ChangeStreamReceiver()
+{
+}
+
+/**
+ * Return how far the copy is behind the source table: the age, as of the
+ * latest reads, of the oldest change not yet applied, in microseconds.
+ * 0 means the copy had caught up.
+ */
+uint32_t
+ChangeStreamReceiver::getLagMicros()
+{
+    uint32_t lag = 0;
+    foreach (Stream& stream, streams) {
+        lag = std::max(lag, stream.lagMicros);
+    }
+    return lag;
+}
+
+/**
+ * Apply to the target table the changes that have been made to the source
+ * table since the last call (the first call copies the whole table). Each
+ * call waits for one read from each tablet.
+ *
+ * \return
+ *      The number of changes applied.
+ */
+uint64_t
+ChangeStreamReceiver::poll()
+{
+    if (needResync)
+        resync();
+    if (needResync)
+        return 0;
+
+    foreach (Stream& stream, streams) {
+        if (!stream.rpc)
+            read(&stream);
+    }
+
+    uint64_t applied = 0;
+    foreach (Stream& stream, streams) {
+        uint64_t streamId, nextPosition;
+        uint32_t lagMicros;
+        bool ok;
+        try {
+            ok = stream.rpc->wait(&streamId, &nextPosition, &lagMicros);
+        } catch (UnknownTabletException& e) {
+            LOG(NOTICE, "Tablet [0x%lx,0x%lx] of tableId %lu moved; "
+                    "copying the table again", stream.firstKeyHash,
+                    stream.lastKeyHash, sourceTableId);
+            needResync = true;
+            break;
+        }
+        stream.rpc.destroy();
+        if (!ok || streamId != stream.streamId) {
+            LOG(NOTICE, "Changes to tablet [0x%lx,0x%lx] of tableId %lu "
+                    "were lost; copying the table again",
+                    stream.firstKeyHash, stream.lastKeyHash, sourceTableId);
+            needResync = true;
+            break;
+        }
+        stream.position = nextPosition;
+        stream.lagMicros = lagMicros;
+
+        // Start the next read before applying these changes, so that its
+        // round trip to the source overlaps the writes to the target.
+        Buffer* changes = &stream.responses[stream.current];
+        stream.current ^= 1;
+        read(&stream);
+        applied += apply(changes);
+    }
+    return applied;
+}
+
+/**
+ * Apply a batch of changes to the target table. Only the last change to
+ * each object matters, so the others are skipped, and the rest are applied
+ * with one multi-write and one multi-remove.
+ *
+ * \param changes
+ *      The changes, as returned by ReadChangesRpc.
+ * \return
+ *      The number of changes in the batch.
+ */
+uint64_t
+ChangeStreamReceiver::apply(Buffer* changes)
+{
+    struct Latest {
+        uint8_t type;
+        uint32_t offset;
+        uint32_t length;
+    };
+    std::unordered_map<string, Latest> latest;
+
+    uint64_t count = 0;
+    uint32_t offset = 0;
+    while (offset < changes->size()) {
+        const WireFormat::ReadChanges::Change* change =
+                changes->getOffset<WireFormat::ReadChanges::Change>(offset);
+        if (change == NULL)
+            throw ResponseFormatError(HERE);
+        offset += sizeof32(*change);
+        const void* key;
+        KeyLength keyLength;
+        if (change->type == LOG_ENTRY_TYPE_OBJ) {
+            Object object(*changes, offset, change->length);
+            key = object.getKey(0, &keyLength);
+        } else {
+            ObjectTombstone tombstone(*changes, offset, change->length);
+            key = tombstone.getKey();
+            keyLength = tombstone.getKeyLength();
+        }
+        latest[string(static_cast<const char*>(key), keyLength)] =
+                {change->type, offset, change->length};
+        offset += change->length;
+        count++;
+    }
+
+    // The keys and values refer to the strings in latest and the data in
+    // changes, both of which stay put until they have been applied.
+    std::vector<MultiWriteObject> writes;
+    std::vector<MultiRemoveObject> removes;
+    writes.reserve(latest.size());
+    removes.reserve(latest.size());
+    for (auto& it : latest) {
+        const string& key = it.first;
+        uint16_t keyLength = downCast<uint16_t>(key.size());
+        if (it.second.type == LOG_ENTRY_TYPE_OBJ) {
+            Object object(*changes, it.second.offset, it.second.length);
+            uint32_t valueLength;
+            const void* value = object.getValue(&valueLength);
+            writes.emplace_back(targetTableId, key.data(), keyLength, value,
+                    valueLength);
+        } else {
+            removes.emplace_back(targetTableId, key.data(), keyLength);
+        }
+    }
+
+    std::vector<MultiWriteObject*> writePointers;
+    foreach (MultiWriteObject& write, writes) {
+        writePointers.push_back(&write);
+    }
+    std::vector<MultiRemoveObject*> removePointers;
+    foreach (MultiRemoveObject& remove, removes) {
+        removePointers.push_back(&remove);
+    }
+    if (!writePointers.empty()) {
+        target->multiWrite(&writePointers[0],
+                downCast<uint32_t>(writePointers.size()));
+    }
+    if (!removePointers.empty()) {
+        target->multiRemove(&removePointers[0],
+                downCast<uint32_t>(removePointers.size()));
+    }
+    foreach (MultiWriteObject& write, writes) {
+        if (write.status != STATUS_OK) {
+            LOG(WARNING, "Couldn't apply a change to tableId %lu: %s",
+                    targetTableId, statusToString(write.status));
+        }
+    }
+    foreach (MultiRemoveObject& remove, removes) {
+        if (remove.status != STATUS_OK) {
+            LOG(WARNING, "Couldn't apply a change to tableId %lu: %s",
+                    targetTableId, statusToString(remove.status));
+        }
+    }
+    return count;
+}
+
+/**
+ * Copy every object in the source table to the target table.
+ */
+void
+ChangeStreamReceiver::copyTable()
+{
+    // Objects are written in batches of about this many bytes.
+    static const uint32_t BATCH_BYTES = 1 << 20;
+
+    TableEnumerator enumerator(*source, sourceTableId, false);
+    uint64_t copied = 0;
+    while (enumerator.hasNext()) {
+        // The enumerator's objects don't stay put, so each batch is copied.
+        Buffer batch;
+        std::vector<MultiWriteObject> writes;
+        while (enumerator.hasNext() && batch.size() < BATCH_BYTES) {
+            uint32_t keyLength, valueLength;
+            const void* key;
+            const void* value;
+            enumerator.nextKeyAndData(&keyLength, &key, &valueLength,
+                    &value);
+            void* keyCopy = batch.alloc(keyLength);
+            memcpy(keyCopy, key, keyLength);
+            void* valueCopy = batch.alloc(valueLength);
+            memcpy(valueCopy, value, valueLength);
+            writes.emplace_back(targetTableId, keyCopy,
+                    downCast<uint16_t>(keyLength), valueCopy, valueLength);
+        }
+        std::vector<MultiWriteObject*> writePointers;
+        foreach (MultiWriteObject& write, writes) {
+            writePointers.push_back(&write);
+        }
+        if (!writePointers.empty()) {
+            target->multiWrite(&writePointers[0],
+                    downCast<uint32_t>(writePointers.size()));
+        }
+        copied += writes.size();
+    }
+    LOG(NOTICE, "Copied %lu objects from tableId %lu to tableId %lu",
+            copied, sourceTableId, targetTableId);
+}
+
+/**
+ * Start reading a tablet's next changes.
+ *
+ * \param stream
+ *      The tablet to read.
+ */
+void
+ChangeStreamReceiver::read(Stream* stream)
+{
+    stream->rpc.construct(source, sourceTableId, stream->firstKeyHash,
+            stream->lastKeyHash, stream->position, maxBytes,
+            &stream->responses[stream->current]);
+}
+
+/**
+ * Find the source table's tablets, subscribe to each one's changes, and
+ * then copy the table, so that applying each tablet's changes from where
+ * its subscription started brings the copy up to date. If a tablet can't
+ * be found where expected (it is moving, for example), #needResync is left
+ * set so that the next #poll tries again.
+ */
+void
+ChangeStreamReceiver::resync()
+{
+    streams.clear();
+    ObjectFinder* objectFinder = source->clientContext->objectFinder;
+    uint64_t keyHash = 0;
+    while (true) {
+        TabletWithLocator* tablet = objectFinder->lookupTablet(sourceTableId,
+                keyHash);
+        streams.emplace_back(tablet->tablet.startKeyHash,
+                tablet->tablet.endKeyHash);
+        if (tablet->tablet.endKeyHash == ~0UL)
+            break;
+        keyHash = tablet->tablet.endKeyHash + 1;
+    }
+
+    // Subscribe to all of the tablets in parallel.
+    foreach (Stream& stream, streams) {
+        stream.position = WireFormat::ReadChanges::Request::SUBSCRIBE;
+        read(&stream);
+    }
+    try {
+        foreach (Stream& stream, streams) {
+            stream.rpc->wait(&stream.streamId, &stream.position,
+                    &stream.lagMicros);
+            stream.rpc.destroy();
+        }
+    } catch (UnknownTabletException& e) {
+        streams.clear();
+        return;
+    }
+
+    copyTable();
+    needResync = false;
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,134 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_CHANGESTREAMRECEIVER_H
+#define RAMCLOUD_CHANGESTREAMRECEIVER_H
+
+#include <list>
+
+#include "RamCloud.h"
+
+namespace RAMCloud {
+
+/**
+ * Keeps a table in one cluster (the target, for example a warm standby in
+ * another datacenter) up to date with a table in another (the source), by
+ * applying the changes streamed from the masters of the source table's
+ * tablets (see ChangeStream). Replication is asynchronous: the target lags
+ * the source by about one poll, and #getLagMicros says by how much.
+ *
+ * The receiver starts by subscribing to each tablet's stream and then
+ * copying the whole table; once it has caught up, each call to #poll
+ * applies the changes made since the last one. Reads of different tablets
+ * proceed in parallel, and each tablet's next read is issued before the
+ * changes from its last one are applied, so the round trip to the source
+ * overlaps applying changes to the target.
+ *
+ * If a tablet's changes are lost (the receiver fell too far behind, the
+ * tablet moved or split, or its master restarted) the receiver copies the
+ * table again. Only objects' primary keys and values are replicated, and a
+ * copy doesn't remove objects that were deleted while changes were lost.
+ *
+ * This class is not thread-safe.
+ */
+class ChangeStreamReceiver {
+  PUBLIC:
+    /// Default for the maxBytes constructor argument.
+    static const uint32_t DEFAULT_MAX_BYTES = 1 << 20;
+
+    ChangeStreamReceiver(RamCloud* source, uint64_t sourceTableId,
+            RamCloud* target, uint64_t targetTableId,
+            uint32_t maxBytes = DEFAULT_MAX_BYTES);
+    ~ChangeStreamReceiver();
+    uint32_t getLagMicros();
+    uint64_t poll();
+
+  PRIVATE:
+    /**
+     * The receiver's state for one tablet of the source table.
+     */
+    struct Stream {
+        Stream(uint64_t firstKeyHash, uint64_t lastKeyHash)
+            : firstKeyHash(firstKeyHash)
+            , lastKeyHash(lastKeyHash)
+            , streamId(0)
+            , position(0)
+            , lagMicros(0)
+            , rpc()
+            , responses()
+            , current(0)
+        {}
+
+        /// Key hash range of the tablet.
+        uint64_t firstKeyHash;
+        uint64_t lastKeyHash;
+
+        /// Identifies the tablet's master's stream, as returned by
+        /// subscribing. If a read returns a different one, the master
+        /// changed and #position means nothing to it.
+        uint64_t streamId;
+
+        /// Where the next read of the tablet's changes starts.
+        uint64_t position;
+
+        /// Staleness reported by the tablet's latest read.
+        uint32_t lagMicros;
+
+        /// The outstanding read, if any.
+        Tub<ReadChangesRpc> rpc;
+
+        /// Responses alternate between these, so that the next read can be
+        /// issued while the previous one's changes are still being applied.
+        Buffer responses[2];
+
+        /// Index in #responses of the one #rpc reads into.
+        int current;
+
+        DISALLOW_COPY_AND_ASSIGN(Stream);
+    };
+
+    uint64_t apply(Buffer* changes);
+    void copyTable();
+    void read(Stream* stream);
+    void resync();
+
+    /// The cluster whose table is replicated.
+    RamCloud* source;
+
+    /// The table that is replicated.
+    uint64_t sourceTableId;
+
+    /// The cluster that holds the copy.
+    RamCloud* target;
+
+    /// The table that holds the copy.
+    uint64_t targetTableId;
+
+    /// Largest number of bytes of changes each read asks for.
+    uint32_t maxBytes;
+
+    /// One entry for each tablet of the source table.
+    std::list<Stream> streams;
+
+    /// True means changes have been lost and the table must be copied
+    /// again before any more are applied.
+    bool needResync;
+
+    DISALLOW_COPY_AND_ASSIGN(ChangeStreamReceiver);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_CHANGESTREAMRECEIVER_H
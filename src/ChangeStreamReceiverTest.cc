@@ -0,0 +1,139 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "ChangeStreamReceiver.h"
+#include "MockCluster.h"
+
+namespace RAMCloud {
+
+class ChangeStreamReceiverTest : public ::testing::Test {
+  public:
+    TestLog::Enable logEnabler;
+    Context context;
+    MockCluster cluster;
+    RamCloud ramcloud;
+    uint64_t sourceTableId;
+    uint64_t targetTableId;
+    Tub<ChangeStreamReceiver> receiver;
+
+    ChangeStreamReceiverTest()
+        : logEnabler()
+        , context()
+        , cluster(&context)
+        , ramcloud(&context, "mock:host=coordinator")
+        , sourceTableId()
+        , targetTableId()
+        , receiver()
+    {
+        Logger::get().setLogLevels(RAMCloud::SILENT_LOG_LEVEL);
+
+        ServerConfig config = ServerConfig::forTesting();
+        config.services = {WireFormat::MASTER_SERVICE,
+                           WireFormat::PING_SERVICE};
+        config.master.changeStreamBytes = 100000;
+        config.localLocator = "mock:host=master1";
+        cluster.addServer(config);
+        config.localLocator = "mock:host=master2";
+        cluster.addServer(config);
+
+        sourceTableId = ramcloud.createTable("source", 2);
+        targetTableId = ramcloud.createTable("target");
+        receiver.construct(&ramcloud, sourceTableId, &ramcloud,
+                targetTableId);
+    }
+
+    /// Return the value of an object in the target table, or "-" if it
+    /// doesn't exist.
+    string
+    readTarget(const char* key)
+    {
+        Buffer value;
+        try {
+            ramcloud.read(targetTableId, key, 1, &value);
+        } catch (ObjectDoesntExistException& e) {
+            return "-";
+        }
+        return TestUtil::toString(&value);
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(ChangeStreamReceiverTest);
+};
+
+TEST_F(ChangeStreamReceiverTest, poll_copiesTable) {
+    ramcloud.write(sourceTableId, "0", 1, "abc", 3);
+    ramcloud.write(sourceTableId, "1", 1, "def", 3);
+    EXPECT_EQ(0U, receiver->poll());
+    EXPECT_EQ(2U, receiver->streams.size());
+    EXPECT_FALSE(receiver->needResync);
+    EXPECT_EQ("abc", readTarget("0"));
+    EXPECT_EQ("def", readTarget("1"));
+}
+
+TEST_F(ChangeStreamReceiverTest, poll_appliesChanges) {
+    ramcloud.write(sourceTableId, "0", 1, "abc", 3);
+    ramcloud.write(sourceTableId, "1", 1, "def", 3);
+    receiver->poll();
+
+    ramcloud.write(sourceTableId, "2", 1, "ghi", 3);
+    ramcloud.write(sourceTableId, "0", 1, "jkl", 3);
+    ramcloud.write(sourceTableId, "0", 1, "mno", 3);
+    ramcloud.remove(sourceTableId, "1", 1);
+
+    // Each poll applies the changes read by the previous one's pipelined
+    // reads, which in the mock cluster complete as soon as they're issued.
+    EXPECT_EQ(0U, receiver->poll());
+    EXPECT_EQ(4U, receiver->poll());
+    EXPECT_EQ("mno", readTarget("0"));
+    EXPECT_EQ("-", readTarget("1"));
+    EXPECT_EQ("ghi", readTarget("2"));
+    EXPECT_EQ(0U, receiver->getLagMicros());
+}
+
+TEST_F(ChangeStreamReceiverTest, poll_streamLost) {
+    receiver->poll();
+    receiver->streams.front().streamId++;
+    TestLog::Enable _("poll");
+    EXPECT_EQ(0U, receiver->poll());
+    EXPECT_EQ("poll: Changes to tablet [0x0,0x7fffffffffffffff] of tableId 1 "
+            "were lost; copying the table again", TestLog::get());
+    EXPECT_TRUE(receiver->needResync);
+
+    // The table is copied again, including changes made while the stream
+    // was broken.
+    ramcloud.write(sourceTableId, "0", 1, "abc", 3);
+    receiver->poll();
+    EXPECT_FALSE(receiver->needResync);
+    EXPECT_EQ("abc", readTarget("0"));
+}
+
+TEST_F(ChangeStreamReceiverTest, poll_tabletMoved) {
+    receiver->poll();
+
+    // The tablet's master no longer has exactly this tablet. The read
+    // already in flight completed before the split; the next one fails.
+    foreach (Server* server, cluster.servers) {
+        server->master->tabletManager.splitTablet(sourceTableId, 0x1000);
+    }
+    TestLog::Enable _("poll");
+    receiver->poll();
+    EXPECT_EQ("", TestLog::get());
+    receiver->poll();
+    EXPECT_EQ("poll: Tablet [0x0,0x7fffffffffffffff] of tableId 1 moved; "
+            "copying the table again", TestLog::get());
+    EXPECT_TRUE(receiver->needResync);
+}
+
+}  // namespace RAMCloud
@@ -0,0 +1,233 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "ChangeStream.h"
+#include "Cycles.h"
+#include "Object.h"
+#include "RawMetrics.h"
+#include "WireFormat.h"
+
+namespace RAMCloud {
+
+class ChangeStreamTest : public ::testing::Test {
+  public:
+    TestLog::Enable logEnabler;
+    ChangeStream stream;
+    Buffer changes;
+    uint64_t nextPosition;
+    uint32_t lagMicros;
+
+    ChangeStreamTest()
+        : logEnabler()
+        , stream(1000)
+        , changes()
+        , nextPosition(0)
+        , lagMicros(0)
+    {
+        Cycles::mockCyclesPerSec = 1e09;
+        Cycles::mockTscValue = 1000;
+    }
+
+    ~ChangeStreamTest()
+    {
+        Cycles::mockTscValue = 0;
+        Cycles::mockCyclesPerSec = 0;
+    }
+
+    /// Record a write of an object with 1-character key and a value.
+    void
+    write(uint64_t tableId, const char* key, const char* value)
+    {
+        Key objectKey(tableId, key, 1);
+        Buffer dataBuffer;
+        Object object(objectKey, value, downCast<uint32_t>(strlen(value)),
+                0, 0, dataBuffer);
+        Buffer entry;
+        object.assembleForLog(entry);
+        stream.record(LOG_ENTRY_TYPE_OBJ, entry);
+    }
+
+    /// Record a removal of an object with a 1-character key.
+    void
+    remove(uint64_t tableId, const char* key)
+    {
+        Key objectKey(tableId, key, 1);
+        Buffer dataBuffer;
+        Object object(objectKey, NULL, 0, 0, 0, dataBuffer);
+        ObjectTombstone tombstone(object, 5, 0);
+        Buffer entry;
+        tombstone.assembleForLog(entry);
+        stream.record(LOG_ENTRY_TYPE_OBJTOMB, entry);
+    }
+
+    /// Return a description of the changes in #changes.
+    string
+    describe()
+    {
+        string result;
+        uint32_t offset = 0;
+        while (offset < changes.size()) {
+            const WireFormat::ReadChanges::Change* change =
+                    changes.getOffset<WireFormat::ReadChanges::Change>(offset);
+            offset += sizeof32(*change);
+            if (!result.empty())
+                result += " | ";
+            if (change->type == LOG_ENTRY_TYPE_OBJ) {
+                Object object(changes, offset, change->length);
+                uint32_t valueLength;
+                const char* value = static_cast<const char*>(
+                        object.getValue(&valueLength));
+                result += format("write %.*s=%.*s",
+                        object.getKeyLength(),
+                        static_cast<const char*>(object.getKey()),
+                        valueLength, value);
+            } else {
+                ObjectTombstone tombstone(changes, offset, change->length);
+                result += format("remove %.*s", tombstone.getKeyLength(),
+                        static_cast<const char*>(tombstone.getKey()));
+            }
+            offset += change->length;
+        }
+        return result;
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(ChangeStreamTest);
+};
+
+TEST_F(ChangeStreamTest, read_basics) {
+    EXPECT_FALSE(stream.isEnabled());
+    EXPECT_EQ(0U, stream.subscribe(1));
+    EXPECT_TRUE(stream.isEnabled());
+    write(1, "a", "first");
+    write(2, "b", "other");
+    remove(1, "a");
+    EXPECT_TRUE(stream.read(1, 0, ~0UL, 0, 1000, &changes, &nextPosition,
+            &lagMicros));
+    EXPECT_EQ("write a=first | remove a", describe());
+    EXPECT_EQ(stream.head, nextPosition);
+    EXPECT_EQ(0U, lagMicros);
+
+    // Nothing more yet.
+    changes.reset();
+    EXPECT_TRUE(stream.read(1, 0, ~0UL, nextPosition, 1000, &changes,
+            &nextPosition, &lagMicros));
+    EXPECT_EQ("", describe());
+}
+
+TEST_F(ChangeStreamTest, read_keyHashRange) {
+    stream.subscribe(1);
+    write(1, "a", "1");
+    write(1, "b", "2");
+    Key a(1, "a", 1);
+    EXPECT_TRUE(stream.read(1, a.getHash(), a.getHash(), 0, 1000, &changes,
+            &nextPosition, &lagMicros));
+    EXPECT_EQ("write a=1", describe());
+    EXPECT_EQ(stream.head, nextPosition);
+}
+
+TEST_F(ChangeStreamTest, read_maxBytes) {
+    stream.subscribe(1);
+    write(1, "a", "1");
+    uint64_t second = stream.head;
+    Cycles::mockTscValue += 5000;
+    write(1, "b", "2");
+    Cycles::mockTscValue += 2000;
+    EXPECT_TRUE(stream.read(1, 0, ~0UL, 0, 1, &changes, &nextPosition,
+            &lagMicros));
+    EXPECT_EQ("write a=1", describe());
+    EXPECT_EQ(second, nextPosition);
+    EXPECT_EQ(2U, lagMicros);
+    EXPECT_EQ(2U, metrics->changeStream.lagMicros);
+}
+
+TEST_F(ChangeStreamTest, read_notSubscribed) {
+    stream.subscribe(1);
+    write(1, "a", "1");
+    EXPECT_FALSE(stream.read(2, 0, ~0UL, 0, 1000, &changes, &nextPosition,
+            &lagMicros));
+}
+
+TEST_F(ChangeStreamTest, read_positionLost) {
+    stream.subscribe(1);
+    while (stream.tail == 0)
+        write(1, "a", "0123456789");
+    EXPECT_FALSE(stream.read(1, 0, ~0UL, 0, 1000, &changes, &nextPosition,
+            &lagMicros));
+    EXPECT_FALSE(stream.read(1, 0, ~0UL, stream.head + 1, 1000, &changes,
+            &nextPosition, &lagMicros));
+    EXPECT_TRUE(stream.read(1, 0, ~0UL, stream.tail, 1000, &changes,
+            &nextPosition, &lagMicros));
+}
+
+TEST_F(ChangeStreamTest, record_notStreamed) {
+    write(1, "a", "1");
+    EXPECT_EQ(0U, stream.head);
+    stream.subscribe(2);
+    write(1, "a", "1");
+    EXPECT_EQ(0U, stream.head);
+}
+
+TEST_F(ChangeStreamTest, record_wrapAround) {
+    stream.subscribe(1);
+    uint64_t position = 0;
+    for (int i = 0; i < 100; i++) {
+        changes.reset();
+        write(1, "a", format("value%d", i).c_str());
+        EXPECT_TRUE(stream.read(1, 0, ~0UL, position, 1000, &changes,
+                &position, &lagMicros));
+        EXPECT_EQ(format("write a=value%d", i), describe());
+    }
+    EXPECT_GT(stream.head, 1000U);
+    EXPECT_LE(stream.head - stream.tail, 1000U);
+}
+
+TEST_F(ChangeStreamTest, record_tooBig) {
+    stream.subscribe(1);
+    write(1, "a", "1");
+    string big(1000, 'x');
+    write(1, "b", big.c_str());
+    EXPECT_EQ(stream.head, stream.tail);
+    EXPECT_FALSE(stream.read(1, 0, ~0UL, 0, 1000, &changes, &nextPosition,
+            &lagMicros));
+}
+
+TEST_F(ChangeStreamTest, dropIdleTables) {
+    stream.subscribe(1);
+    Cycles::mockTscValue += Cycles::fromSeconds(ChangeStream::IDLE_SECONDS);
+    stream.subscribe(2);
+    Cycles::mockTscValue += 10;
+    write(2, "a", "1");
+    EXPECT_EQ("dropIdleTables: No longer streaming changes to tableId 1: "
+            "no one has read them for 600 seconds", TestLog::get());
+    EXPECT_TRUE(stream.isEnabled());
+    EXPECT_FALSE(stream.read(1, 0, ~0UL, 0, 1000, &changes, &nextPosition,
+            &lagMicros));
+
+    // Reads keep a table streamed.
+    TestLog::reset();
+    Cycles::mockTscValue += Cycles::fromSeconds(ChangeStream::IDLE_SECONDS);
+    EXPECT_TRUE(stream.read(2, 0, ~0UL, 0, 1000, &changes, &nextPosition,
+            &lagMicros));
+    Cycles::mockTscValue += 10;
+    write(2, "a", "1");
+    EXPECT_EQ("", TestLog::get());
+
+    Cycles::mockTscValue += Cycles::fromSeconds(ChangeStream::IDLE_SECONDS);
+    write(2, "a", "1");
+    EXPECT_FALSE(stream.isEnabled());
+}
+
+}  // namespace RAMCloud
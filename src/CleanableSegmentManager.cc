@@ -40,6 +40,9 @@ CleanableSegmentManager::CleanableSegmentManager(
     , undeadTombstoneBytes(0)
     , segmentsToCleaner(0)
     , tombstoneScans(0)
+    , coldSegments(0)
+    , coldSegmentBytes(0)
+    , coldLiveObjectBytes(0)
     , costBenefitCandidates()
     , compactionCandidates()
     , tombstoneScanCandidates()
@@ -139,6 +142,21 @@ CleanableSegmentManager::getSegmentsToClean(LogSegmentVector& outSegsToClean)
         outSegsToClean.size(), totalSeglets);
 }
 
+/**
+ * Fill in the cold segment counters of the given protocol buffer. These
+ * describe how much memory is held by cleanable segments whose data has not
+ * been written in COLD_SEGMENT_AGE_SECONDS.
+ */
+void
+CleanableSegmentManager::getMetrics(ProtoBuf::LogMetrics_CleanerMetrics& m)
+{
+    SpinLock::Guard guard(lock);
+    m.set_cold_segment_age_seconds(COLD_SEGMENT_AGE_SECONDS);
+    m.set_cold_segments(coldSegments);
+    m.set_cold_segment_memory_bytes(coldSegmentBytes);
+    m.set_cold_live_object_bytes(coldLiveObjectBytes);
+}
+
 uint64_t
 CleanableSegmentManager::computeCompactionCostBenefitScore(LogSegment* segment)
 {
@@ -186,6 +204,10 @@ CleanableSegmentManager::update(const SpinLock::Guard& guard)
     lastUpdateTimestamp = now;
     liveObjectBytes = 0;
     undeadTombstoneBytes = 0;
+    coldSegments = 0;
+    coldSegmentBytes = 0;
+    coldLiveObjectBytes = 0;
+    uint32_t nowSeconds = WallTime::secondsTimestamp();
 
     // Update cost-benefit and scan scores, and update our aggregate statistics
     // for old segments.
@@ -228,14 +250,23 @@ CleanableSegmentManager::update(const SpinLock::Guard& guard)
         const LogEntryType tombType = LOG_ENTRY_TYPE_OBJTOMB;
         undeadTombstoneBytes += segment.entryLengths[tombType] -
                                 segment.deadEntryLengths[tombType];
+
+        countIfCold(&segment, nowSeconds);
     }
 
     // Get new candidates from the SegmentManager and insert them into the
-    // trees. Update our aggregate statistics as we go.
+    // trees. Update our aggregate statistics as we go. Segments on the flash
+    // tier hold cold data and don't use memory, so they are never cleaned or
+    // compacted, or scanned for tombstones. This means dead space on flash
+    // isn't reclaimed; once the flash tier fills up, cold survivors simply
+    // stay in memory (see LogCleaner::relocateLiveEntries).
 
     LogSegmentVector newCandidates;
     segmentManager.cleanableSegments(newCandidates);
     foreach (LogSegment* segment, newCandidates) {
+        if (segment->onFlash)
+            continue;
+
         segment->cachedCleaningCostBenefitScore =
             computeCleaningCostBenefitScore(segment);
         segment->cachedCompactionCostBenefitScore =
@@ -247,11 +278,36 @@ CleanableSegmentManager::update(const SpinLock::Guard& guard)
         liveObjectBytes += segment->entryLengths[LOG_ENTRY_TYPE_OBJ] -
                            segment->deadEntryLengths[LOG_ENTRY_TYPE_OBJ];
         undeadTombstoneBytes += segment->entryLengths[LOG_ENTRY_TYPE_OBJTOMB];
+
+        countIfCold(segment, nowSeconds);
     }
 
     assert(costBenefitCandidates.size() == compactionCandidates.size());
 }
 
+/**
+ * Add the given segment to the cold segment counters if its data is at least
+ * COLD_SEGMENT_AGE_SECONDS old. Called from update() for every segment being
+ * tracked.
+ *
+ * \param segment
+ *      Segment to consider.
+ * \param now
+ *      Current WallTime::secondsTimestamp().
+ */
+void
+CleanableSegmentManager::countIfCold(LogSegment* segment, uint32_t now)
+{
+    if (segment->creationTimestamp > now ||
+        now - segment->creationTimestamp < COLD_SEGMENT_AGE_SECONDS)
+        return;
+
+    coldSegments++;
+    coldSegmentBytes += segment->getSegletsAllocated() * segletSize;
+    coldLiveObjectBytes += segment->entryLengths[LOG_ENTRY_TYPE_OBJ] -
+                           segment->deadEntryLengths[LOG_ENTRY_TYPE_OBJ];
+}
+
 /**
  * Scan the best candidate in tombstoneScanCandidates for dead tombstones and
  * update the segment's statistics. This lets the getSegmentsToClean() and
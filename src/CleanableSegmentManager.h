@@ -78,6 +78,7 @@ class CleanableSegmentManager {
     int getUndeadTombstoneUtilization();
     LogSegment* getSegmentToCompact();
     void getSegmentsToClean(LogSegmentVector& outSegsToClean);
+    void getMetrics(ProtoBuf::LogMetrics_CleanerMetrics& m);
 
   PRIVATE:
     void update(const SpinLock::Guard& guard);
@@ -86,6 +87,7 @@ class CleanableSegmentManager {
     uint64_t computeCompactionCostBenefitScore(LogSegment* s);
     uint64_t computeTombstoneScanScore(LogSegment* s);
     uint32_t computeFreeableSeglets(LogSegment* s);
+    void countIfCold(LogSegment* s, uint32_t now);
     void insertInAll(LogSegment* s, const SpinLock::Guard& guard);
     void eraseFromAll(LogSegment* s, const SpinLock::Guard& guard);
     string toString();
@@ -115,6 +117,13 @@ class CleanableSegmentManager {
     /// performance in a number of benchmarks, and relatively low overhead).
     enum { SCAN_TOMBSTONES_EVERY_N_SEGMENTS = 5 };
 
+    /// Segments whose data is at least this many seconds old are counted as
+    /// cold in getMetrics(). Survivors inherit the age of the data they hold
+    /// (see LogCleaner::setSurvivorAge), so this tracks how much of memory is
+    /// occupied by data that has not been rewritten in a long time and would
+    /// be the first candidate for a denser in-memory representation.
+    enum { COLD_SEGMENT_AGE_SECONDS = 600 };
+
     /// This context is used for reaching into the hash table to query the
     /// liveness of tombstones, because tombstones that are still referenced by
     /// the hash table cannot be safely cleaned.
@@ -148,6 +157,17 @@ class CleanableSegmentManager {
     /// Count of the number of segments scanned for dead tombstones.
     uint64_t tombstoneScans;
 
+    /// Number of tracked segments older than COLD_SEGMENT_AGE_SECONDS as of
+    /// the last update().
+    uint64_t coldSegments;
+
+    /// Bytes of seglet memory allocated to the segments counted in
+    /// coldSegments.
+    uint64_t coldSegmentBytes;
+
+    /// Live object bytes contained in the segments counted in coldSegments.
+    uint64_t coldLiveObjectBytes;
+
     /**
      * Compare two segment's cached cost-benefit ratios for cleaning.
      */
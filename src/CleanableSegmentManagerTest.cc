@@ -26,6 +26,7 @@
 #include "LogCleaner.h"
 #include "ReplicaManager.h"
 #include "MasterTableMetadata.h"
+#include "WallTime.h"
 
 namespace RAMCloud {
 
@@ -152,4 +153,28 @@ TEST_F(CleanableSegmentManagerTest, update) {
               csm.toString());
 }
 
+TEST_F(CleanableSegmentManagerTest, update_coldSegments) {
+    CleanableSegmentManager& csm = cleaner.cleanableSegments;
+    SpinLock::Guard guard(csm.lock);
+
+    WallTime::mockWallTimeValue = 1000;
+    segmentManager.allocHeadSegment();
+    segmentManager.allocHeadSegment();
+    WallTime::mockWallTimeValue = 1500;
+    segmentManager.allocHeadSegment();
+    segmentManager.allocHeadSegment();
+
+    WallTime::mockWallTimeValue = 1000 +
+        CleanableSegmentManager::COLD_SEGMENT_AGE_SECONDS;
+    csm.update(guard);
+    WallTime::mockWallTimeValue = 0;
+
+    // Segments 1 and 2 are old enough; segment 3 is too young and segment 4
+    // is the head, which isn't cleanable.
+    EXPECT_EQ(2U, csm.coldSegments);
+    EXPECT_EQ(2U * csm.segletsPerSegment * csm.segletSize,
+        csm.coldSegmentBytes);
+    EXPECT_EQ(0U, csm.coldLiveObjectBytes);
+}
+
 }  // namespace RAMCloud
@@ -0,0 +1,512 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * This program replays a trace of object writes against a master's real
+ * log, with its real cleaner: the CleanableSegmentManager's cost-benefit
+ * segment selection, the memory compactor, and whichever Balancer is chosen
+ * with --balancer. Unlike misc/lfs_sim, which models an idealized LFS, the
+ * write costs it reports are the ones a master with the same configuration
+ * would see, so it can be used to tune the segment size, the balancer, and
+ * --writeCostThreshold for a given memory utilization before deploying.
+ *
+ * Nothing is replicated: the cleaner runs synchronously in this thread
+ * whenever its balancer asks for work (or an append fails), and "disk" write
+ * costs are those the cleaner would have caused on backups.
+ *
+ * A trace is a text file with one write per line:
+ *
+ *     keyHash size time
+ *
+ * where keyHash identifies the object (decimal, or hexadecimal with a 0x
+ * prefix), size is the length of the value in bytes, and time is in seconds
+ * since any fixed point, nondecreasing. Trace time drives the timestamps
+ * used by cost-benefit selection (segment and object ages); the rate-based
+ * "adaptive" balancer sees the replay's own speed instead. Without --trace,
+ * a synthetic trace of uniformly random overwrites is generated that keeps
+ * the log at --utilization.
+ */
+
+#include <boost/program_options.hpp>
+#include <iostream>
+namespace po = boost::program_options;
+
+#include "Cycles.h"
+#include "Logger.h"
+#include "LogCleaner.h"
+#include "ObjectManager.h"
+#include "Seglet.h"
+#include "TabletManager.h"
+#include "MasterTableMetadata.h"
+#include "WallTime.h"
+
+namespace RAMCloud {
+
+/**
+ * One write from a trace.
+ */
+struct TraceWrite {
+    TraceWrite()
+        : keyHash(0)
+        , size(0)
+        , seconds(0)
+    {
+    }
+
+    /// Identifies the object written.
+    uint64_t keyHash;
+
+    /// Length of the object's value, in bytes.
+    uint32_t size;
+
+    /// When the write happened, in seconds.
+    double seconds;
+};
+
+/**
+ * Parses a trace file (see the top of this file), or generates a synthetic
+ * trace if no file is given.
+ */
+class TraceReader {
+  public:
+    TraceReader(const string& path, uint64_t numObjects, uint32_t objectSize,
+            uint64_t numWrites)
+        : file(NULL)
+        , path(path)
+        , lineNumber(0)
+        , numObjects(numObjects)
+        , objectSize(objectSize)
+        , numWrites(numWrites)
+        , writesGenerated(0)
+    {
+        if (path.empty())
+            return;
+        file = fopen(path.c_str(), "r");
+        if (file == NULL) {
+            fprintf(stderr, "Couldn't open trace file %s: %s\n",
+                    path.c_str(), strerror(errno));
+            exit(1);
+        }
+    }
+
+    ~TraceReader()
+    {
+        if (file != NULL)
+            fclose(file);
+    }
+
+    /**
+     * Return the next write in the trace.
+     *
+     * \param[out] write
+     *      Filled in with the next write.
+     * \return
+     *      False if the trace has ended.
+     */
+    bool
+    next(TraceWrite* write)
+    {
+        if (file == NULL) {
+            // Synthetic trace: first write every object once, then overwrite
+            // them at random, one write per microsecond.
+            if (writesGenerated >= numWrites)
+                return false;
+            write->keyHash = writesGenerated < numObjects ? writesGenerated :
+                    generateRandom() % numObjects;
+            write->size = objectSize;
+            write->seconds = static_cast<double>(writesGenerated) / 1e6;
+            writesGenerated++;
+            return true;
+        }
+
+        char line[256];
+        while (fgets(line, sizeof(line), file) != NULL) {
+            lineNumber++;
+            char* p = line;
+            while (isspace(*p))
+                p++;
+            if (*p == '\0' || *p == '#')
+                continue;
+            char* end;
+            write->keyHash = strtoull(p, &end, 0);
+            if (end == p)
+                badLine();
+            p = end;
+            write->size = downCast<uint32_t>(strtoul(p, &end, 0));
+            if (end == p)
+                badLine();
+            p = end;
+            write->seconds = strtod(p, &end);
+            if (end == p)
+                badLine();
+            return true;
+        }
+        return false;
+    }
+
+  PRIVATE:
+    void
+    badLine()
+    {
+        fprintf(stderr, "%s:%lu: expected \"keyHash size time\"\n",
+                path.c_str(), lineNumber);
+        exit(1);
+    }
+
+    /// The trace file being read, or NULL if the trace is synthetic.
+    FILE* file;
+
+    /// Name of the trace file (empty if the trace is synthetic).
+    string path;
+
+    /// Number of lines read from #file so far.
+    uint64_t lineNumber;
+
+    /// Synthetic trace only: number of distinct objects, the size of each,
+    /// and the total number of writes to generate.
+    uint64_t numObjects;
+    uint32_t objectSize;
+    uint64_t numWrites;
+
+    /// Synthetic trace only: number of writes returned so far.
+    uint64_t writesGenerated;
+
+    DISALLOW_COPY_AND_ASSIGN(TraceReader);
+};
+
+class CleanerTraceSimulator {
+  public:
+    Context context;
+    ClusterClock clusterClock;
+    ClientLeaseValidator clientLeaseValidator;
+    ServerConfig config;
+    ServerList serverList;
+    TabletManager tabletManager;
+    MasterTableMetadata masterTableMetadata;
+    UnackedRpcResults unackedRpcResults;
+    PreparedOps preparedOps;
+    TxRecoveryManager txRecoveryManager;
+    ServerId serverId;
+    ObjectManager* objectManager;
+    LogCleaner* cleaner;
+    LogCleaner::CleanerThreadState cleanerState;
+
+    /// Number of writes replayed so far, and the bytes of values they wrote.
+    uint64_t writes;
+    uint64_t bytesWritten;
+
+    /// Number of times an append failed for lack of memory and had to wait
+    /// for the cleaner (a master would have returned STATUS_RETRY).
+    uint64_t appendStalls;
+
+    CleanerTraceSimulator(string logSize, string hashTableSize,
+            uint32_t segmentSize, uint32_t writeCostThreshold,
+            string balancer)
+        : context()
+        , clusterClock()
+        , clientLeaseValidator(&context, &clusterClock)
+        , config(ServerConfig::forTesting())
+        , serverList(&context)
+        , tabletManager()
+        , masterTableMetadata()
+        , unackedRpcResults(&context, NULL, &clientLeaseValidator)
+        , preparedOps(&context)
+        , txRecoveryManager(&context)
+        , serverId(1, 1)
+        , objectManager(NULL)
+        , cleaner(NULL)
+        , cleanerState()
+        , writes(0)
+        , bytesWritten(0)
+        , appendStalls(0)
+    {
+        Logger::get().setLogLevels(WARNING);
+        config.localLocator = "bogus";
+        config.coordinatorLocator = "bogus";
+        config.setLogAndHashTableSize(logSize, hashTableSize);
+        config.services = {};
+        config.master.numReplicas = 0;
+        config.master.disableLogCleaner = true;
+        config.master.cleanerWriteCostThreshold = writeCostThreshold;
+        config.master.cleanerBalancer = balancer;
+        config.segmentSize = segmentSize;
+        config.segletSize = std::min(segmentSize,
+                uint32_t(Seglet::DEFAULT_SEGLET_SIZE));
+        config.maxObjectDataSize = segmentSize / 8;
+        objectManager = new ObjectManager(&context,
+                                          &serverId,
+                                          &config,
+                                          &tabletManager,
+                                          &masterTableMetadata,
+                                          &unackedRpcResults,
+                                          &preparedOps,
+                                          &txRecoveryManager);
+        unackedRpcResults.resetFreer(objectManager);
+        tabletManager.addTablet(0, 0, ~0UL, TabletManager::NORMAL);
+
+        // The cleaner turns compaction off when nothing is replicated, since
+        // a master without backups gains nothing from it; here we want to
+        // see what a replicated master would do.
+        cleaner = objectManager->log.cleaner;
+        cleaner->disableInMemoryCleaning = (writeCostThreshold == 0);
+    }
+
+    /// Most cleaning passes run by one invocation of clean().
+    enum { MAX_PASSES = 100 };
+
+    ~CleanerTraceSimulator()
+    {
+        delete objectManager;
+    }
+
+    /**
+     * Return the number of bytes of memory in the log.
+     */
+    uint64_t
+    getLogBytes()
+    {
+        return objectManager->segmentManager.getAllocator().getTotalBytes();
+    }
+
+    /**
+     * Run the cleaner until its balancer has nothing more for it to do
+     * (or for at most MAX_PASSES passes, in case cleaning can't free
+     * anything).
+     *
+     * \param force
+     *      If true, clean at least once even if the balancer would sleep
+     *      (an append has just failed).
+     */
+    void
+    clean(bool force)
+    {
+        for (int pass = 0; pass < MAX_PASSES; pass++) {
+            switch (cleaner->balancer->requestTask(&cleanerState)) {
+            case LogCleaner::Balancer::CLEAN_DISK:
+                cleaner->doDiskCleaning();
+                break;
+            case LogCleaner::Balancer::COMPACT_MEMORY:
+                cleaner->doMemoryCleaning();
+                break;
+            case LogCleaner::Balancer::SLEEP:
+                if (!force)
+                    return;
+                cleaner->doDiskCleaning();
+                return;
+            }
+            force = false;
+        }
+    }
+
+    /**
+     * Replay one write from a trace, cleaning as needed to make room.
+     */
+    void
+    replay(const TraceWrite& write)
+    {
+        WallTime::mockWallTimeValue = 1 + downCast<uint32_t>(
+                static_cast<uint64_t>(write.seconds));
+
+        if (write.size > config.maxObjectDataSize) {
+            fprintf(stderr, "Write of %u bytes for keyHash 0x%lx is larger "
+                    "than the maximum object size (%u bytes)\n",
+                    write.size, write.keyHash, config.maxObjectDataSize);
+            exit(1);
+        }
+        char data[write.size];
+        Key key(0, &write.keyHash, sizeof(write.keyHash));
+        for (int attempt = 0; ; attempt++) {
+            Buffer dataBuffer;
+            Object object(key, data, write.size, 0,
+                    WallTime::secondsTimestamp(), dataBuffer);
+            Status status = objectManager->writeObject(object, NULL, NULL);
+            if (status == STATUS_OK)
+                break;
+            if (status != STATUS_RETRY || attempt == 10) {
+                fprintf(stderr, "Couldn't write %u bytes for keyHash 0x%lx "
+                        "(%s); is the log too small for the live data?\n",
+                        write.size, write.keyHash, statusToString(status));
+                exit(1);
+            }
+            appendStalls++;
+            clean(true);
+        }
+        writes++;
+        bytesWritten += write.size;
+        clean(false);
+    }
+
+    /**
+     * Print the write costs the cleaner has incurred so far.
+     */
+    void
+    report(FILE* out, double seconds)
+    {
+        LogCleanerMetrics::InMemory<>* memory = &cleaner->inMemoryMetrics;
+        LogCleanerMetrics::OnDisk<>* disk = &cleaner->onDiskMetrics;
+
+        // Write cost: bytes written to memory (or disk) for each byte of new
+        // data, counting both the new data and the cleaner's survivors.
+        uint64_t memoryFreed = memory->totalBytesFreed +
+                disk->totalMemoryBytesFreed;
+        uint64_t memoryWrote = memory->totalBytesAppendedToSurvivors +
+                disk->totalBytesAppendedToSurvivors;
+        uint64_t diskFreed = disk->totalDiskBytesFreed;
+        uint64_t diskWrote = disk->totalBytesAppendedToSurvivors;
+        double memoryWriteCost = memoryFreed == 0 ? 1.0 :
+                static_cast<double>(memoryFreed + memoryWrote) /
+                static_cast<double>(memoryFreed);
+        double diskWriteCost = diskFreed == 0 ? 1.0 :
+                static_cast<double>(diskFreed + diskWrote) /
+                static_cast<double>(diskFreed);
+
+        fprintf(out, "%10.1f s %12lu writes %10.1f MB  mem %3d%% "
+                "(live %3d%%)  disk %3d%%  memWC %6.3f  diskWC %6.3f  "
+                "compactions %lu  diskCleanings %lu  stalls %lu\n",
+                seconds, writes,
+                static_cast<double>(bytesWritten) / 1024 / 1024,
+                objectManager->segmentManager.getMemoryUtilization(),
+                cleaner->cleanableSegments.getLiveObjectUtilization(),
+                objectManager->segmentManager.getSegmentUtilization(),
+                memoryWriteCost, diskWriteCost,
+                uint64_t(memory->totalSegmentsCompacted),
+                uint64_t(disk->totalRuns), appendStalls);
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(CleanerTraceSimulator);
+};
+
+}  // namespace RAMCloud
+
+using namespace RAMCloud;
+
+int
+main(int argc, char* argv[])
+try
+{
+    string tracePath;
+    string logSize;
+    string hashTableSize;
+    uint32_t segmentSize;
+    uint32_t writeCostThreshold;
+    string balancer;
+    int utilization;
+    uint32_t objectSize;
+    uint64_t numWrites;
+    double reportInterval;
+
+    po::options_description desc(
+            "Usage: CleanerTraceSimulator [options]\n\n"
+            "Replays a trace of writes against a master's log and cleaner\n"
+            "(without replication) and reports the resulting write costs.\n\n"
+            "Allowed options:");
+    desc.add_options()
+        ("trace,t", po::value<string>(&tracePath),
+                "File with one \"keyHash size time\" line per write; if "
+                "omitted, a synthetic trace of uniform random overwrites is "
+                "used")
+        ("logSize,l", po::value<string>(&logSize)->default_value("1024"),
+                "Log memory, in megabytes (or a percentage of system memory, "
+                "as for a master's --totalMasterMemory)")
+        ("hashTableSize", po::value<string>(&hashTableSize)->
+                default_value("10%"),
+                "Hash table memory, in megabytes or as a percentage of the "
+                "log memory")
+        ("segmentSize,s", po::value<uint32_t>(&segmentSize)->
+                default_value(Segment::DEFAULT_SEGMENT_SIZE),
+                "Size of each log segment, in bytes")
+        ("writeCostThreshold,w", po::value<uint32_t>(&writeCostThreshold)->
+                default_value(8),
+                "The cleaner's write cost threshold (as for a master's "
+                "--writeCostThreshold), which limits how much memory "
+                "compaction is done before the disk cleaner runs; 0 disables "
+                "compaction")
+        ("balancer,b", po::value<string>(&balancer)->
+                default_value("tombstoneRatio:0.40"),
+                "The cleaner's balancer (as for a master's --cleanerBalancer)")
+        ("utilization,u", po::value<int>(&utilization)->default_value(80),
+                "Synthetic trace only: percentage of the log memory occupied "
+                "by live objects")
+        ("objectSize", po::value<uint32_t>(&objectSize)->default_value(1000),
+                "Synthetic trace only: size of each object's value, in bytes")
+        ("writes,n", po::value<uint64_t>(&numWrites)->
+                default_value(10000000),
+                "Synthetic trace only: number of writes to replay")
+        ("reportInterval,r", po::value<double>(&reportInterval)->
+                default_value(60),
+                "Print write costs after this many seconds of trace time")
+        ("help,h", "Print this help message");
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+    if (vm.count("help")) {
+        std::cout << desc << std::endl;
+        exit(0);
+    }
+    if (utilization < 1 || utilization > 99) {
+        fprintf(stderr, "ERROR: Utilization must be between 1 and 99, "
+                "inclusive\n");
+        exit(1);
+    }
+
+    if (segmentSize > Seglet::DEFAULT_SEGLET_SIZE &&
+            segmentSize % Seglet::DEFAULT_SEGLET_SIZE != 0) {
+        fprintf(stderr, "ERROR: Segment size must be a multiple of the "
+                "seglet size (%u bytes)\n", Seglet::DEFAULT_SEGLET_SIZE);
+        exit(1);
+    }
+
+    CleanerTraceSimulator simulator(logSize, hashTableSize, segmentSize,
+            writeCostThreshold, balancer);
+
+    uint64_t numObjects = 0;
+    if (tracePath.empty()) {
+        // Count each object's key and headers too (about 40 bytes), so
+        // that the live data really fills --utilization of the log.
+        uint64_t bytesPerObject = objectSize + 40;
+        numObjects = simulator.getLogBytes() * utilization / 100 /
+                bytesPerObject;
+        if (numObjects == 0 || numObjects > numWrites) {
+            fprintf(stderr, "ERROR: --writes must be at least the %lu "
+                    "objects that fill the log to %d%%\n",
+                    numObjects, utilization);
+            exit(1);
+        }
+    }
+    TraceReader trace(tracePath, numObjects, objectSize, numWrites);
+
+    TraceWrite write;
+    double nextReport = -1;
+    double lastSeconds = 0;
+    uint64_t start = Cycles::rdtsc();
+    while (trace.next(&write)) {
+        if (nextReport < 0)
+            nextReport = write.seconds + reportInterval;
+        while (write.seconds >= nextReport) {
+            simulator.report(stdout, nextReport);
+            nextReport += reportInterval;
+        }
+        simulator.replay(write);
+        lastSeconds = write.seconds;
+    }
+    simulator.report(stdout, lastSeconds);
+    printf("Replayed %lu writes in %.1f s\n", simulator.writes,
+            Cycles::toSeconds(Cycles::rdtsc() - start));
+    return 0;
+}
+catch (std::exception& e) {
+    fprintf(stderr, "%s\n", e.what());
+    exit(1);
+}
@@ -0,0 +1,70 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "ClientDispatchThread.h"
+#include "Dispatch.h"
+#include "Fence.h"
+
+namespace RAMCloud {
+
+/**
+ * Start a thread polling a client's dispatcher; returns once the thread
+ * owns the dispatcher.
+ *
+ * \param context
+ *      The client whose dispatcher is to be polled. No other thread may be
+ *      using the dispatcher during this call.
+ */
+ClientDispatchThread::ClientDispatchThread(Context* context)
+    : context(context)
+    , started(false)
+    , threadShouldExit(false)
+    , thread()
+{
+    thread.construct(main, this);
+    while (!started) {
+        // Wait for the thread to take over the dispatcher.
+    }
+}
+
+/**
+ * Stop the thread; afterwards the client's dispatcher has no dispatch
+ * thread again.
+ */
+ClientDispatchThread::~ClientDispatchThread()
+{
+    threadShouldExit = true;
+    Fence::sfence();
+    thread->join();
+}
+
+/**
+ * The thread's main loop.
+ *
+ * \param dispatchThread
+ *      The object that started the thread.
+ */
+void
+ClientDispatchThread::main(ClientDispatchThread* dispatchThread)
+{
+    Dispatch* dispatch = dispatchThread->context->dispatch;
+    dispatch->setDedicatedThread(true);
+    dispatchThread->started = true;
+    while (!dispatchThread->threadShouldExit)
+        dispatch->poll();
+    dispatch->setDedicatedThread(false);
+}
+
+} // namespace RAMCloud
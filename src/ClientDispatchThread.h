@@ -0,0 +1,58 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_CLIENTDISPATCHTHREAD_H
+#define RAMCLOUD_CLIENTDISPATCHTHREAD_H
+
+#include <thread>
+
+#include "Common.h"
+#include "Tub.h"
+
+namespace RAMCloud {
+
+/**
+ * A thread that polls a client's dispatcher continuously, so that several
+ * application threads can issue RPCs through the same transports at once
+ * (see RamCloud::enableMultiThreading). While this object exists, the
+ * thread is the client's dispatch thread: other threads send requests
+ * through WorkerSessions and wait for them without polling.
+ */
+class ClientDispatchThread {
+  public:
+    explicit ClientDispatchThread(Context* context);
+    ~ClientDispatchThread();
+
+  PRIVATE:
+    static void main(ClientDispatchThread* dispatchThread);
+
+    /// The client whose dispatcher is polled.
+    Context* context;
+
+    /// Set by the thread once it owns the dispatcher.
+    volatile bool started;
+
+    /// Set by the destructor to ask the thread to exit.
+    volatile bool threadShouldExit;
+
+    /// The thread that polls.
+    Tub<std::thread> thread;
+
+    DISALLOW_COPY_AND_ASSIGN(ClientDispatchThread);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_CLIENTDISPATCHTHREAD_H
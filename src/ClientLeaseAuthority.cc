@@ -13,6 +13,7 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <algorithm>
 #include <string>
 
 #include "ClientLeaseAuthority.h"
@@ -35,6 +36,11 @@ const uint64_t RESERVATION_LIMIT = 1000;
 /// small enough such that the reservation agent is constantly being run.
 const uint64_t RESERVATIONS_LOW = 250;
 
+/// Defines the most leaseIds the reservation agent reserves with a single
+/// ExternalStorage::setMulti call.  Larger batches mean fewer round trips to
+/// external storage, but hold the mutex (and so delay lease requests) longer.
+const uint64_t RESERVATION_BATCH = 100;
+
 /// Defines the prefix for objects stored in external storage by this module.
 const std::string STORAGE_PREFIX = "clientLeaseAuthority";
 
@@ -189,9 +195,16 @@ void
 ClientLeaseAuthority::LeaseReservationAgent::handleTimerEvent()
 {
     SpinLock::Guard lock(leaseAuthority->mutex);
-    leaseAuthority->reserveNextLease(lock);
     uint64_t reservationCount = leaseAuthority->maxReservedLeaseId -
                                 leaseAuthority->lastIssuedLeaseId;
+    if (reservationCount < RESERVATION_LIMIT) {
+        leaseAuthority->reserveLeases(
+                std::min(RESERVATION_BATCH,
+                         RESERVATION_LIMIT - reservationCount),
+                lock);
+    }
+    reservationCount = leaseAuthority->maxReservedLeaseId -
+                       leaseAuthority->lastIssuedLeaseId;
     if (reservationCount < RESERVATION_LIMIT) {
             this->start(0);
     }
@@ -291,15 +304,14 @@ ClientLeaseAuthority::renewLeaseInternal(uint64_t leaseId,
         clientLease.leaseId = ++lastIssuedLeaseId;
 
         // The maxReservedLeaseId needs to always stay ahead of any issued
-        // leaseId.  If it is not, more leases need to be reserved. This should
-        // only ever execute once if at all.
-        while (maxReservedLeaseId <= lastIssuedLeaseId) {
+        // leaseId.  If it is not, more leases need to be reserved.
+        if (maxReservedLeaseId <= lastIssuedLeaseId) {
             // Instead of waiting for the reservation agent to run and catch up,
-            // we reserve an additional leaseId manually.
+            // we reserve the missing leaseIds manually.
             RAMCLOUD_LOG(WARNING,
                          "Lease reservations are not keeping up; "
                          "maxReservedLeaseId = %lu", maxReservedLeaseId);
-            reserveNextLease(lock);
+            reserveLeases(lastIssuedLeaseId - maxReservedLeaseId + 1, lock);
         }
     }
 
@@ -314,19 +326,26 @@ ClientLeaseAuthority::renewLeaseInternal(uint64_t leaseId,
 }
 
 /**
- * Persist the next available leaseId to external storage.
+ * Persist the next available leaseIds to external storage.  Each leaseId
+ * still gets its own object (so that recovery and cleaning are unaffected),
+ * but all of the objects are written with a single setMulti call.
  *
+ * \param count
+ *      Number of leaseIds to reserve.
  * \param lock
  *      Ensures that caller has acquired mutex; not actually used here.
  */
 void
-ClientLeaseAuthority::reserveNextLease(const SpinLock::Guard& lock)
+ClientLeaseAuthority::reserveLeases(uint64_t count, const SpinLock::Guard& lock)
 {
-    uint64_t nextLeaseId = maxReservedLeaseId + 1;
-    context->externalStorage->set(ExternalStorage::Hint::CREATE,
-                                  getLeaseObjName(nextLeaseId).c_str(),
-                                  "", 0);
-    maxReservedLeaseId = nextLeaseId;
+    vector<ExternalStorage::Write> writes;
+    writes.reserve(count);
+    for (uint64_t i = 1; i <= count; i++) {
+        writes.emplace_back(ExternalStorage::Hint::CREATE,
+                            getLeaseObjName(maxReservedLeaseId + i), "");
+    }
+    context->externalStorage->setMulti(writes);
+    maxReservedLeaseId += count;
 }
 
 } // namespace RAMCloud
@@ -142,7 +142,7 @@ class ClientLeaseAuthority {
     std::string getLeaseObjName(uint64_t leaseId);
     WireFormat::ClientLease renewLeaseInternal(uint64_t leaseId,
                                                const SpinLock::Guard& lock);
-    void reserveNextLease(const SpinLock::Guard& lock);
+    void reserveLeases(uint64_t count, const SpinLock::Guard& lock);
 
     DISALLOW_COPY_AND_ASSIGN(ClientLeaseAuthority);
 };
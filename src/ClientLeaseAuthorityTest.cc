@@ -124,10 +124,13 @@ TEST_F(ClientLeaseAuthorityTest, renewLease) {
 TEST_F(ClientLeaseAuthorityTest, leaseReservationAgent_handleTimerEvent) {
     EXPECT_EQ(0U, leaseAuthority->lastIssuedLeaseId);
     EXPECT_EQ(0U, leaseAuthority->maxReservedLeaseId);
+    storage.log.clear();
     leaseAuthority->reservationAgent.handleTimerEvent();
     EXPECT_EQ(0U, leaseAuthority->lastIssuedLeaseId);
-    EXPECT_EQ(1U, leaseAuthority->maxReservedLeaseId);
+    EXPECT_EQ(100U, leaseAuthority->maxReservedLeaseId);
     EXPECT_TRUE(leaseAuthority->reservationAgent.isRunning());
+    EXPECT_EQ(0U, storage.log.find("set(CREATE, clientLeaseAuthority/1); "
+                                   "set(CREATE, clientLeaseAuthority/2); "));
     leaseAuthority->reservationAgent.stop();
     leaseAuthority->maxReservedLeaseId = 1000 - 1;
     leaseAuthority->reservationAgent.handleTimerEvent();
@@ -285,9 +288,7 @@ TEST_F(ClientLeaseAuthorityTest, renewLeaseInternal_new) {
     EXPECT_EQ(2U, leaseAuthority->lastIssuedLeaseId);
     EXPECT_EQ(3U, leaseAuthority->maxReservedLeaseId);
 
-    leaseAuthority->reserveNextLease(lock);
-    leaseAuthority->reserveNextLease(lock);
-    leaseAuthority->reserveNextLease(lock);
+    leaseAuthority->reserveLeases(3, lock);
 
     EXPECT_EQ(6U, leaseAuthority->maxReservedLeaseId);
 
@@ -326,14 +327,20 @@ TEST_F(ClientLeaseAuthorityTest, renewLeaseInternal_reservationsNotKeepingUp) {
               TestLog::get());
 }
 
-TEST_F(ClientLeaseAuthorityTest, reserveNextLease) {
+TEST_F(ClientLeaseAuthorityTest, reserveLeases) {
     SpinLock::Guard lock(leaseAuthority->mutex);
     storage.log.clear();
     leaseAuthority->maxReservedLeaseId = 4294967296;
     EXPECT_EQ(4294967296U, leaseAuthority->maxReservedLeaseId);
-    leaseAuthority->reserveNextLease(lock);
+    leaseAuthority->reserveLeases(1, lock);
     EXPECT_EQ("set(CREATE, clientLeaseAuthority/4294967297)", storage.log);
     EXPECT_EQ(4294967297U, leaseAuthority->maxReservedLeaseId);
+
+    storage.log.clear();
+    leaseAuthority->reserveLeases(2, lock);
+    EXPECT_EQ("set(CREATE, clientLeaseAuthority/4294967298); "
+              "set(CREATE, clientLeaseAuthority/4294967299)", storage.log);
+    EXPECT_EQ(4294967299U, leaseAuthority->maxReservedLeaseId);
 }
 
 }  // namespace RAMCloud
@@ -58,6 +58,7 @@ class ClientLeaseValidator {
     bool needsValidation(ClientLease clientLease) {
         ClusterTime expirationTime(clientLease.leaseExpiration);
         clusterClock->updateClock(ClusterTime(clientLease.timestamp));
+        clusterClock->raiseSafeLimit(expirationTime);
 
         if (expirationTime < clusterClock->getTime()) {
             return true;
@@ -87,6 +88,7 @@ class ClientLeaseValidator {
             WireFormat::ClientLease lease =
                 CoordinatorClient::getLeaseInfo(context, clientId);
             clusterClock->updateClock(ClusterTime(lease.timestamp));
+            clusterClock->raiseSafeLimit(ClusterTime(lease.leaseExpiration));
             if (lease.leaseId == 0) {
                 return false;
             } else if (leaseInfo) {
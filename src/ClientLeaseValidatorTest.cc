@@ -47,6 +47,7 @@ TEST_F(ClientLeaseValidatorTest, needsValidation) {
 
     EXPECT_FALSE(validator.needsValidation(lease));
     EXPECT_EQ(ClusterTime(50U), clusterClock.getTime());
+    EXPECT_EQ(ClusterTime(100U), clusterClock.safeLimit);
 
     clusterClock.updateClock(ClusterTime(99U));
 
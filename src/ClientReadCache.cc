@@ -0,0 +1,219 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "ClientReadCache.h"
+#include "ClientException.h"
+#include "Cycles.h"
+#include "RamCloud.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct an empty ClientReadCache.
+ *
+ * \param ramcloud
+ *      The client whose reads are cached.
+ * \param maxBytes
+ *      The most bytes of keys and values to cache.
+ * \param leaseMicros
+ *      How long (in microseconds) a value read from a master may be
+ *      returned from the cache before checking whether it has changed.
+ */
+ClientReadCache::ClientReadCache(RamCloud* ramcloud, uint64_t maxBytes,
+        uint32_t leaseMicros)
+    : hits(0)
+    , misses(0)
+    , renewals(0)
+    , ramcloud(ramcloud)
+    , maxBytes(maxBytes)
+    , leaseCycles(Cycles::fromMicroseconds(leaseMicros))
+    , bytes(0)
+    , lru()
+    , entries()
+{
+}
+
+/**
+ * Forget an object, if it's cached; invoked when the client modifies it.
+ *
+ * \param tableId
+ *      The table containing the object.
+ * \param key
+ *      The object's primary key.
+ * \param keyLength
+ *      Size in bytes of the key.
+ */
+void
+ClientReadCache::invalidate(uint64_t tableId, const void* key,
+        uint16_t keyLength)
+{
+    auto it = entries.find(makeId(tableId, key, keyLength));
+    if (it == entries.end())
+        return;
+    bytes -= it->second->id.size() + it->second->value.size();
+    lru.erase(it->second);
+    entries.erase(it);
+}
+
+/**
+ * Forget an object, if it's cached; invoked when the client modifies it.
+ *
+ * \param tableId
+ *      The table containing the object.
+ * \param keyInfo
+ *      The object's keys, as passed to RamCloud::write; the first is the
+ *      primary key.
+ */
+void
+ClientReadCache::invalidate(uint64_t tableId, KeyInfo* keyInfo)
+{
+    // As in WriteRpc, a length of 0 means the key is NULL-terminated.
+    uint16_t keyLength = keyInfo[0].keyLength;
+    if (keyLength == 0) {
+        keyLength = downCast<uint16_t>(strlen(
+                static_cast<const char*>(keyInfo[0].key)));
+    }
+    invalidate(tableId, keyInfo[0].key, keyLength);
+}
+
+/**
+ * Read an object, from the cache if possible; otherwise the same as
+ * RamCloud::read (with no reject rules).
+ *
+ * \param tableId
+ *      The table containing the desired object.
+ * \param key
+ *      Variable length key that uniquely identifies the object within
+ *      tableId.
+ * \param keyLength
+ *      Size in bytes of the key.
+ * \param[out] value
+ *      After a successful return, this Buffer will hold the contents of
+ *      the desired object (only the value portion of the object).
+ * \param[out] version
+ *      If non-NULL, the version number of the object is returned here.
+ */
+void
+ClientReadCache::read(uint64_t tableId, const void* key, uint16_t keyLength,
+        Buffer* value, uint64_t* version)
+{
+    string id = makeId(tableId, key, keyLength);
+    auto it = entries.find(id);
+    if (it == entries.end()) {
+        misses++;
+        uint64_t readVersion;
+        ReadRpc rpc(ramcloud, tableId, key, keyLength, value);
+        rpc.wait(&readVersion);
+        store(id, value, readVersion);
+        if (version != NULL)
+            *version = readVersion;
+        return;
+    }
+
+    Entry* entry = &*it->second;
+    uint64_t now = Cycles::rdtsc();
+    if (now >= entry->leaseExpiration) {
+        // Only fetch the object if it has been written since it was cached.
+        renewals++;
+        RejectRules rules;
+        memset(&rules, 0, sizeof(rules));
+        rules.givenVersion = entry->version;
+        rules.versionLeGiven = 1;
+        ReadRpc rpc(ramcloud, tableId, key, keyLength, value, &rules);
+        try {
+            uint64_t readVersion;
+            rpc.wait(&readVersion);
+            store(id, value, readVersion);
+            if (version != NULL)
+                *version = readVersion;
+            return;
+        } catch (WrongVersionException& e) {
+            // Unchanged.
+            entry->leaseExpiration = now + leaseCycles;
+        } catch (ClientException& e) {
+            invalidate(tableId, key, keyLength);
+            throw;
+        }
+    } else {
+        hits++;
+    }
+    lru.splice(lru.begin(), lru, it->second);
+    value->reset();
+    value->appendCopy(entry->value.data(),
+            downCast<uint32_t>(entry->value.size()));
+    if (version != NULL)
+        *version = entry->version;
+}
+
+/**
+ * Drop the least recently used objects until the cache is within its
+ * limit.
+ */
+void
+ClientReadCache::evict()
+{
+    while (bytes > maxBytes) {
+        Entry& victim = lru.back();
+        bytes -= victim.id.size() + victim.value.size();
+        entries.erase(victim.id);
+        lru.pop_back();
+    }
+}
+
+/**
+ * Return the key under which an object is cached: its table id followed
+ * by its primary key.
+ */
+string
+ClientReadCache::makeId(uint64_t tableId, const void* key, uint16_t keyLength)
+{
+    string id(reinterpret_cast<const char*>(&tableId), sizeof(tableId));
+    id.append(static_cast<const char*>(key), keyLength);
+    return id;
+}
+
+/**
+ * Cache an object just read from its master, replacing any older copy,
+ * and give it a new lease.
+ *
+ * \param id
+ *      The object's table id and key (see #makeId).
+ * \param value
+ *      The object's value.
+ * \param version
+ *      The object's version.
+ */
+void
+ClientReadCache::store(const string& id, Buffer* value, uint64_t version)
+{
+    auto it = entries.find(id);
+    if (it != entries.end()) {
+        bytes -= it->second->id.size() + it->second->value.size();
+        lru.erase(it->second);
+        entries.erase(it);
+    }
+    if (id.size() + value->size() > maxBytes)
+        return;
+
+    lru.emplace_front(id, version, Cycles::rdtsc() + leaseCycles);
+    Entry& entry = lru.front();
+    entry.value.resize(value->size());
+    value->copy(0, value->size(), &entry.value[0]);
+    entries[id] = lru.begin();
+    bytes += id.size() + entry.value.size();
+    evict();
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,119 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_CLIENTREADCACHE_H
+#define RAMCLOUD_CLIENTREADCACHE_H
+
+#include <list>
+#include <unordered_map>
+
+#include "Common.h"
+#include "Buffer.h"
+
+namespace RAMCloud {
+
+class RamCloud;
+struct KeyInfo;
+
+/**
+ * A cache of recently read objects kept by a client, so that reads of hot
+ * objects needn't go to their masters every time (see
+ * RamCloud::enableReadCache). Each cached object has a lease: until it
+ * runs out, reads return the cached value without contacting the master.
+ * After that, the next read asks the master for the object only if its
+ * version has changed (versions only grow), which costs an RPC but not the
+ * transfer of the value, and renews the lease if it hasn't.
+ *
+ * Reads of cached objects may therefore return values up to a lease old;
+ * writes made through the same RamCloud object invalidate its cache, so a
+ * client always sees its own writes. Objects are evicted in LRU order once
+ * the cache holds more than its limit. Not thread-safe: each RamCloud
+ * object has its own cache.
+ */
+class ClientReadCache {
+  public:
+    ClientReadCache(RamCloud* ramcloud, uint64_t maxBytes,
+            uint32_t leaseMicros);
+    void invalidate(uint64_t tableId, const void* key, uint16_t keyLength);
+    void invalidate(uint64_t tableId, KeyInfo* keyInfo);
+    void read(uint64_t tableId, const void* key, uint16_t keyLength,
+            Buffer* value, uint64_t* version);
+
+    /// Reads returned from the cache without contacting a master.
+    uint64_t hits;
+
+    /// Reads of objects that weren't cached.
+    uint64_t misses;
+
+    /// Reads of objects whose leases had run out; the master was asked
+    /// whether they had changed.
+    uint64_t renewals;
+
+  PRIVATE:
+    /// One cached object.
+    struct Entry {
+        Entry(const string& id, uint64_t version, uint64_t leaseExpiration)
+            : id(id)
+            , value()
+            , version(version)
+            , leaseExpiration(leaseExpiration)
+        {}
+
+        /// The object's key in #entries.
+        string id;
+
+        /// The object's value.
+        string value;
+
+        /// The object's version.
+        uint64_t version;
+
+        /// Cycles::rdtsc() time when the lease runs out.
+        uint64_t leaseExpiration;
+    };
+
+    /// Cached objects, most recently used first.
+    typedef std::list<Entry> LruList;
+
+    void evict();
+    static string makeId(uint64_t tableId, const void* key,
+            uint16_t keyLength);
+    void store(const string& id, Buffer* value, uint64_t version);
+
+    /// Used to issue reads.
+    RamCloud* ramcloud;
+
+    /// The most bytes (of keys and values) to cache.
+    uint64_t maxBytes;
+
+    /// How long a read from a master may be returned without checking
+    /// whether the object has changed, in cycles.
+    uint64_t leaseCycles;
+
+    /// The bytes of keys and values currently cached.
+    uint64_t bytes;
+
+    /// Holds the cached objects.
+    LruList lru;
+
+    /// Maps an object's table id and key (see #makeId) to its entry in #lru.
+    std::unordered_map<string, LruList::iterator> entries;
+
+    DISALLOW_COPY_AND_ASSIGN(ClientReadCache);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_CLIENTREADCACHE_H
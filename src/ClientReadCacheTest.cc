@@ -0,0 +1,173 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "ClientReadCache.h"
+#include "MockCluster.h"
+#include "RamCloud.h"
+
+namespace RAMCloud {
+
+class ClientReadCacheTest : public ::testing::Test {
+  public:
+    TestLog::Enable logEnabler;
+    Context context;
+    MockCluster cluster;
+    Tub<RamCloud> ramcloud;
+    Tub<RamCloud> other;
+    ClientReadCache* cache;
+    uint64_t tableId;
+
+    ClientReadCacheTest()
+        : logEnabler()
+        , context()
+        , cluster(&context)
+        , ramcloud()
+        , other()
+        , cache(NULL)
+        , tableId(-1)
+    {
+        Logger::get().setLogLevels(RAMCloud::SILENT_LOG_LEVEL);
+
+        ServerConfig config = ServerConfig::forTesting();
+        config.services = {WireFormat::MASTER_SERVICE,
+                           WireFormat::PING_SERVICE};
+        config.localLocator = "mock:host=master";
+        cluster.addServer(config);
+
+        ramcloud.construct(&context, "mock:host=coordinator");
+        other.construct(&context, "mock:host=coordinator");
+        tableId = ramcloud->createTable("table");
+        ramcloud->enableReadCache(1000, 1000000);
+        cache = ramcloud->readCache;
+    }
+
+    /// Return the value of an object, read through #ramcloud.
+    string
+    read(const char* key, uint64_t* version = NULL)
+    {
+        Buffer value;
+        ramcloud->read(tableId, key, downCast<uint16_t>(strlen(key)), &value,
+                NULL, version);
+        return TestUtil::toString(&value);
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(ClientReadCacheTest);
+};
+
+TEST_F(ClientReadCacheTest, invalidate) {
+    ramcloud->write(tableId, "a", 1, "one");
+    EXPECT_EQ("one", read("a"));
+    EXPECT_EQ(1U, cache->entries.size());
+
+    // A write through the same client invalidates its cache.
+    ramcloud->write(tableId, "a", 1, "two");
+    EXPECT_EQ(0U, cache->entries.size());
+    EXPECT_EQ(0U, cache->bytes);
+    EXPECT_EQ("two", read("a"));
+    ramcloud->remove(tableId, "a", 1);
+    EXPECT_THROW(read("a"), ObjectDoesntExistException);
+    EXPECT_EQ(3U, cache->misses);
+}
+
+TEST_F(ClientReadCacheTest, invalidate_keyInfo) {
+    ramcloud->write(tableId, "abc", 3, "one");
+    EXPECT_EQ("one", read("abc"));
+    KeyInfo keyList[1];
+    keyList[0].key = "abc";
+    keyList[0].keyLength = 0;
+    ramcloud->write(tableId, 1, keyList, "two");
+    EXPECT_EQ(0U, cache->entries.size());
+    EXPECT_EQ("two", read("abc"));
+}
+
+TEST_F(ClientReadCacheTest, read_hit) {
+    uint64_t version, cachedVersion;
+    ramcloud->write(tableId, "a", 1, "one", NULL, &version);
+    EXPECT_EQ("one", read("a"));
+    EXPECT_EQ(1U, cache->misses);
+
+    // Writes by other clients aren't seen until the lease runs out.
+    other->write(tableId, "a", 1, "two");
+    EXPECT_EQ("one", read("a", &cachedVersion));
+    EXPECT_EQ(version, cachedVersion);
+    EXPECT_EQ(1U, cache->hits);
+
+    // Reads with reject rules bypass the cache.
+    RejectRules rules;
+    memset(&rules, 0, sizeof(rules));
+    Buffer value;
+    ramcloud->read(tableId, "a", 1, &value, &rules);
+    EXPECT_EQ("two", TestUtil::toString(&value));
+}
+
+TEST_F(ClientReadCacheTest, read_renewal) {
+    uint64_t leaseCycles = cache->leaseCycles;
+    ramcloud->write(tableId, "a", 1, "one");
+    EXPECT_EQ("one", read("a"));
+
+    // Unchanged: the lease is renewed.
+    cache->leaseCycles = 0;
+    cache->lru.front().leaseExpiration = 0;
+    EXPECT_EQ("one", read("a"));
+    EXPECT_EQ(1U, cache->renewals);
+    EXPECT_EQ(1U, cache->misses);
+
+    // Changed: the new value is cached.
+    other->write(tableId, "a", 1, "two");
+    EXPECT_EQ("two", read("a"));
+    EXPECT_EQ(2U, cache->renewals);
+    EXPECT_EQ(1U, cache->misses);
+
+    // Renewing restarts the lease.
+    cache->leaseCycles = leaseCycles;
+    EXPECT_EQ("two", read("a"));
+    EXPECT_EQ(3U, cache->renewals);
+    other->write(tableId, "a", 1, "three");
+    EXPECT_EQ("two", read("a"));
+    EXPECT_EQ(1U, cache->hits);
+
+    // Removed: the entry is dropped.
+    other->remove(tableId, "a", 1);
+    cache->lru.front().leaseExpiration = 0;
+    EXPECT_THROW(read("a"), ObjectDoesntExistException);
+    EXPECT_EQ(0U, cache->entries.size());
+    EXPECT_EQ(0U, cache->bytes);
+}
+
+TEST_F(ClientReadCacheTest, store_evict) {
+    string value(400, 'x');
+    ramcloud->write(tableId, "a", 1, value.c_str());
+    ramcloud->write(tableId, "b", 1, value.c_str());
+    ramcloud->write(tableId, "c", 1, value.c_str());
+    read("a");
+    read("b");
+    read("a");
+    EXPECT_EQ(818U, cache->bytes);
+
+    // "b" is the least recently used.
+    read("c");
+    EXPECT_EQ(2U, cache->entries.size());
+    EXPECT_EQ(818U, cache->bytes);
+    EXPECT_EQ(0U, cache->entries.count(ClientReadCache::makeId(tableId,
+            "b", 1)));
+
+    // Objects larger than the cache aren't cached.
+    ramcloud->write(tableId, "d", 1, string(1000, 'y').c_str());
+    read("d");
+    EXPECT_EQ(2U, cache->entries.size());
+}
+
+}  // namespace RAMCloud
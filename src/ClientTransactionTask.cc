@@ -126,7 +126,10 @@ ClientTransactionTask::performTask()
             state = PREPARE;
         }
         if (state == PREPARE) {
-            sendPrepareRpc();
+            while (nextCacheEntry != commitCache.end()
+                    && prepareRpcs.size() < MAX_OUTSTANDING_RPCS) {
+                sendPrepareRpc();
+            }
             processPrepareRpcResults();
             if (prepareRpcs.empty() && nextCacheEntry == commitCache.end()) {
                 switch (decision) {
@@ -159,7 +162,12 @@ ClientTransactionTask::performTask()
             }
         }
         if (state == DECISION) {
-            sendDecisionRpc();
+            // The decisions are sent as soon as the last vote is in, in this
+            // same pass; the client's commit returns once they're all sent.
+            while (nextCacheEntry != commitCache.end()
+                    && decisionRpcs.size() < MAX_OUTSTANDING_RPCS) {
+                sendDecisionRpc();
+            }
             processDecisionRpcResults();
             if (decisionRpcs.empty() && nextCacheEntry == commitCache.end()) {
                 ramcloud->rpcTracker->rpcFinished(txId);
@@ -240,10 +248,11 @@ ClientTransactionTask::processDecisionRpcResults()
 {
     // Process outstanding RPCs.
     std::list<DecisionRpc>::iterator it = decisionRpcs.begin();
-    for (; it != decisionRpcs.end(); it++) {
+    while (it != decisionRpcs.end()) {
         DecisionRpc* rpc = &(*it);
 
         if (!rpc->isReady()) {
+            it++;
             continue;
         }
 
@@ -277,10 +286,11 @@ ClientTransactionTask::processPrepareRpcResults()
 {
     // Process outstanding RPCs.
     std::list<PrepareRpc>::iterator it = prepareRpcs.begin();
-    for (; it != prepareRpcs.end(); it++) {
+    while (it != prepareRpcs.end()) {
         PrepareRpc* rpc = &(*it);
 
         if (!rpc->isReady()) {
+            it++;
             continue;
         }
 
@@ -507,7 +517,7 @@ void
 ClientTransactionTask::ClientTransactionRpcWrapper::send()
 {
     state = IN_PROGRESS;
-    session->sendRequest(&request, response, this);
+    sendRequest();
 }
 
 /**
@@ -122,6 +122,14 @@ class ClientTransactionTask : public RpcTracker::TrackedRpc {
     /// be completed once the transaction is complete.
     uint64_t txId;
 
+    /// The most rpcs of each kind (prepare or decision) that this task keeps
+    /// "in flight" at once; the participants on different masters are
+    /// contacted in parallel, up to this limit.
+#ifdef TESTING
+    static const uint32_t MAX_OUTSTANDING_RPCS = 2;
+#else
+    static const uint32_t MAX_OUTSTANDING_RPCS = 20;
+#endif
     /// List of "in flight" Prepare Rpcs.
     std::list<PrepareRpc> prepareRpcs;
     /// List of "in flight" Decision Rpcs.
@@ -482,21 +482,14 @@ TEST_F(ClientTransactionTaskTest, performTask_basic) {
 
     insertWrite(tableId3, "test1", 5, "hello", 5);
 
+    // Up to MAX_OUTSTANDING_RPCS (2) are sent in each call.
     EXPECT_EQ(ClientTransactionTask::INIT, transactionTask->state);
-    transactionTask->performTask();             // RPC 1 Sent, RPC 1 Processed
-    EXPECT_EQ(ClientTransactionTask::PREPARE, transactionTask->state);
-    transactionTask->performTask();             // RPC 2 Sent, RPC 2 Processed
-    EXPECT_EQ(ClientTransactionTask::PREPARE, transactionTask->state);
-    transactionTask->performTask();             // RPC 3 Sent, RPC 3 Processed
+    transactionTask->performTask();             // RPC 1-2 Sent, Processed
     EXPECT_EQ(ClientTransactionTask::PREPARE, transactionTask->state);
-    transactionTask->performTask();             // RPC 4 Sent, RPC 4 Processed
-                                                // RPC 1 Sent, RPC 1 Processed
-    EXPECT_EQ(ClientTransactionTask::DECISION, transactionTask->state);
-    transactionTask->performTask();             // RPC 2 Sent, RPC 2 Processed
-    EXPECT_EQ(ClientTransactionTask::DECISION, transactionTask->state);
-    transactionTask->performTask();             // RPC 3 Sent, RPC 3 Processed
+    transactionTask->performTask();             // RPC 3-4 Sent, Processed
+                                                // RPC 1-2 Sent, Processed
     EXPECT_EQ(ClientTransactionTask::DECISION, transactionTask->state);
-    transactionTask->performTask();             // RPC 4 Sent, RPC 4 Processed
+    transactionTask->performTask();             // RPC 3-4 Sent, Processed
     EXPECT_EQ(ClientTransactionTask::DONE, transactionTask->state);
     transactionTask->performTask();
     EXPECT_EQ(ClientTransactionTask::DONE, transactionTask->state);
@@ -680,6 +673,25 @@ TEST_F(ClientTransactionTaskTest, processPrepareRpcResults_basic) {
     EXPECT_EQ(WireFormat::TxDecision::UNDECIDED, transactionTask->decision);
 }
 
+TEST_F(ClientTransactionTaskTest, processPrepareRpcResults_multiple) {
+    insertWrite(tableId1, "test", 4, "hello", 5);
+    insertWrite(tableId2, "test", 4, "goodbye", 7);
+    insertWrite(tableId3, "test", 4, "goodbye", 7);
+    transactionTask->initTask();
+    transactionTask->nextCacheEntry = transactionTask->commitCache.begin();
+    transactionTask->sendPrepareRpc();
+    transactionTask->sendPrepareRpc();
+    transactionTask->sendPrepareRpc();
+
+    EXPECT_EQ(3U, transactionTask->prepareRpcs.size());
+    TestLog::reset();
+    transactionTask->processPrepareRpcResults();
+    EXPECT_EQ("processPrepareRpcResults: PREPARED | "
+              "processPrepareRpcResults: PREPARED | "
+              "processPrepareRpcResults: PREPARED", TestLog::get());
+    EXPECT_EQ(0U, transactionTask->prepareRpcs.size());
+}
+
 TEST_F(ClientTransactionTaskTest, processPrepareRpcResults_abort) {
     insertWrite(tableId1, "test", 4, "hello", 5);
     // Set reject rules to cause abort.
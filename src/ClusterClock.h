@@ -26,6 +26,14 @@ namespace RAMCloud {
  * cluster-time.  A master's observed "current" cluster-time is defined as the
  * largest cluster-time observed by the master.  The "current" cluster-time is
  * used to logically serialize lease expiration with lease information removal.
+ *
+ * Masters also exchange their cluster-times with each other, piggybacked on
+ * the rpcs they send each other anyway (see updateFromPeer), so that the
+ * time advances across the cluster without extra rpcs to the coordinator,
+ * in the style of a hybrid logical clock. Times learned from peers are
+ * bounded by the lease expirations that the coordinator has issued (see
+ * raiseSafeLimit), so that one master with a wild clock can't drag the
+ * others past the leases of live clients.
  */
 class ClusterClock {
   PUBLIC:
@@ -34,6 +42,7 @@ class ClusterClock {
      */
     ClusterClock()
         : clusterTime()
+        , safeLimit()
     {}
 
     /**
@@ -63,10 +72,48 @@ class ClusterClock {
         }
     }
 
+    /**
+     * Provide a cluster-time from another master. This is the same as
+     * updateClock, except that the time is first capped at the latest
+     * lease expiration passed to raiseSafeLimit; times from peers are
+     * ignored until a lease has been seen.
+     *
+     * \param peerTime
+     *      The other master's "current" cluster-time.
+     */
+    void updateFromPeer(ClusterTime peerTime) {
+        ClusterTime limit = safeLimit;
+        if (limit < peerTime)
+            peerTime = limit;
+        updateClock(peerTime);
+    }
+
+    /**
+     * Record a lease expiration issued by the coordinator. A lease expires
+     * one lease term after the coordinator's cluster-time when it was
+     * issued, so a peer's time beyond the latest expiration seen is ahead
+     * of anything the coordinator has vouched for and isn't trusted (see
+     * updateFromPeer).
+     *
+     * \param leaseExpiration
+     *      Expiration time of a lease issued by the coordinator.
+     */
+    void raiseSafeLimit(ClusterTime leaseExpiration) {
+        ClusterTime currentLimit = safeLimit;
+        while (currentLimit < leaseExpiration) {
+            currentLimit = safeLimit.compareExchange(currentLimit,
+                                                     leaseExpiration);
+        }
+    }
+
   PRIVATE:
     /// The largest cluster-time observed by this module.
     ClusterTime clusterTime;
 
+    /// The latest lease expiration seen; times from peers are capped at
+    /// this.
+    ClusterTime safeLimit;
+
     DISALLOW_COPY_AND_ASSIGN(ClusterClock);
 };
 
@@ -46,4 +46,31 @@ TEST(ClusterClock, updateClock) {
     EXPECT_EQ(ClusterTime(64), clock.getTime());
 }
 
+TEST(ClusterClock, updateFromPeer) {
+    ClusterClock clock;
+
+    // No lease seen yet, so peers can't move the clock.
+    clock.updateFromPeer(ClusterTime(42));
+    EXPECT_EQ(ClusterTime(0), clock.getTime());
+
+    clock.raiseSafeLimit(ClusterTime(100));
+    clock.updateFromPeer(ClusterTime(42));
+    EXPECT_EQ(ClusterTime(42), clock.getTime());
+    clock.updateFromPeer(ClusterTime(500));
+    EXPECT_EQ(ClusterTime(100), clock.getTime());
+    clock.updateFromPeer(ClusterTime(8));
+    EXPECT_EQ(ClusterTime(100), clock.getTime());
+}
+
+TEST(ClusterClock, raiseSafeLimit) {
+    ClusterClock clock;
+    clock.raiseSafeLimit(ClusterTime(64));
+    EXPECT_EQ(ClusterTime(64), clock.safeLimit);
+    clock.raiseSafeLimit(ClusterTime(8));
+    EXPECT_EQ(ClusterTime(64), clock.safeLimit);
+
+    // The limit doesn't move the clock itself.
+    EXPECT_EQ(ClusterTime(0), clock.getTime());
+}
+
 }  // namespace RAMCloud
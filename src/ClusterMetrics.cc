@@ -17,6 +17,7 @@
 #include "Buffer.h"
 #include "ClusterMetrics.h"
 #include "Logger.h"
+#include "RpcLatency.h"
 #include "ShortMacros.h"
 
 namespace RAMCloud {
@@ -67,6 +68,36 @@ ClusterMetrics::load(RamCloud* cluster)
     }
 }
 
+/**
+ * Retrieve the RPC latency histograms (see RpcLatency) from all of the
+ * masters in a cluster and add them up, giving the distribution of each
+ * stage of each kind of RPC over the whole cluster.
+ *
+ * \param cluster
+ *      Identifies the RAMCloud cluster from which to retrieve histograms.
+ * \param[out] merged
+ *      The histograms are added to the rpc_latency entries of this.
+ */
+void
+ClusterMetrics::loadRpcLatency(RamCloud* cluster,
+        ProtoBuf::ServerStatistics* merged)
+{
+    ProtoBuf::ServerList serverList;
+    CoordinatorClient::getServerList(cluster->clientContext, &serverList);
+    for (int i = 0; i < serverList.server_size(); i++) {
+        const ProtoBuf::ServerList_Entry& server = serverList.server(i);
+        if ((server.status() != uint32_t(ServerStatus::UP)) ||
+                !ServiceMask::deserialize(server.services()).has(
+                WireFormat::MASTER_SERVICE)) {
+            continue;
+        }
+        ProtoBuf::ServerStatistics serverStats;
+        cluster->getServerStatistics(server.service_locator().c_str(),
+                serverStats);
+        RpcLatency::merge(serverStats, merged);
+    }
+}
+
 /**
  * Given another ClusterMetrics object, compute the difference between
  * this object and the other one.
@@ -20,6 +20,7 @@
 #include "Common.h"
 #include "RamCloud.h"
 #include "ServerMetrics.h"
+#include "ServerStatistics.pb.h"
 
 namespace RAMCloud {
 
@@ -43,6 +44,8 @@ class ClusterMetrics {
     ~ClusterMetrics() { }
     void load(RamCloud* cluster);
     ClusterMetrics difference(ClusterMetrics& other);
+    static void loadRpcLatency(RamCloud* cluster,
+            ProtoBuf::ServerStatistics* merged);
 
     // The following methods all delegate directly to the corresponding
     // methods in unordered_map.
@@ -20,6 +20,7 @@
 #include "MockCluster.h"
 #include "PingService.h"
 #include "RamCloud.h"
+#include "RpcLatency.h"
 #include "ServerList.h"
 
 namespace RAMCloud {
@@ -63,6 +64,42 @@ TEST_F(ClusterMetricsTest, load) {
     EXPECT_EQ(30303U, clusterMetrics["mock:host=ping1"]["temp.count3"]);
 }
 
+TEST_F(ClusterMetricsTest, loadRpcLatency) {
+    Context context;
+    MockCluster cluster(&context);
+    RamCloud ramcloud(&context, "mock:host=coordinator");
+
+    ServerConfig config = ServerConfig::forTesting();
+    config.services = {WireFormat::MASTER_SERVICE, WireFormat::PING_SERVICE};
+    config.localLocator = "mock:host=master1";
+    cluster.addServer(config);
+    config.localLocator = "mock:host=master2";
+    cluster.addServer(config);
+    config.services = {WireFormat::BACKUP_SERVICE, WireFormat::PING_SERVICE};
+    config.localLocator = "mock:host=backup1";
+    cluster.addServer(config);
+
+    // All of the servers are in this process, so each master reports the
+    // same histograms.
+    RpcLatency::reset();
+    RpcLatency::record(WireFormat::READ, RpcLatency::EXECUTING, 3);
+    ProtoBuf::ServerStatistics merged;
+    ClusterMetrics::loadRpcLatency(&ramcloud, &merged);
+    bool found = false;
+    foreach (const ProtoBuf::ServerStatistics_RpcLatency& latency,
+            merged.rpc_latency()) {
+        if ((latency.opcode() != WireFormat::READ) ||
+                (latency.stage() != RpcLatency::EXECUTING)) {
+            continue;
+        }
+        found = true;
+        ASSERT_EQ(1, latency.bucket_size());
+        EXPECT_EQ(3U, latency.bucket(0));
+        EXPECT_EQ(2U, latency.count(0));
+    }
+    EXPECT_TRUE(found);
+}
+
 TEST_F(ClusterMetricsTest, difference) {
     ClusterMetrics first;
     ClusterMetrics second;
@@ -39,9 +39,11 @@
 //  4. Add code for this test to clusterperf.py, following the instructions
 //     in that file.
 
+#include <thread>
 #include <boost/program_options.hpp>
 #include <boost/version.hpp>
 #include <iostream>
+#include <queue>
 #include <unordered_set>
 namespace po = boost::program_options;
 
@@ -50,9 +52,11 @@ namespace po = boost::program_options;
 #include "ClientLeaseAgent.h"
 #include "CycleCounter.h"
 #include "Cycles.h"
+#include "Histogram.h"
 #include "PerfStats.h"
 #include "IndexLookup.h"
 #include "RamCloud.h"
+#include "RpcTrace.h"
 #include "Util.h"
 #include "TimeTrace.h"
 #include "Transaction.h"
@@ -121,6 +125,25 @@ static int targetOps;
 // the server span of a transaction.
 static int txSpan;
 
+// Value of the "--numThreads" command-line option: used by some tests
+// to specify the largest number of threads to issue requests from a
+// single client.
+static int numThreads;
+
+// Values of the "--maxRate", "--rateSteps", and "--stepSeconds" command-line
+// options: used by open-loop tests, which offer load at rateSteps evenly
+// spaced rates up to maxRate operations per second (across all clients),
+// for stepSeconds at each rate.
+static int maxRate;
+static int rateSteps;
+static double stepSeconds;
+
+// Values of the "--trace" and "--traceSpeed" command-line options: used by
+// the traceReplay test to name the trace to replay, and to speed it up
+// (values > 1) or slow it down.
+static string traceFile;     // NOLINT
+static double traceSpeed;
+
 // Identifier for table that is used for test-specific data.
 uint64_t dataTable = -1;
 
@@ -1697,6 +1720,53 @@ getMetrics(ClientMetrics& metrics, int clientCount)
     }
 }
 
+/**
+ * Slaves invoke this method to return a distribution of measurements (such
+ * as latencies) to the master, which retrieves it with mergeHistogram.
+ *
+ * \param name
+ *      Identifies the distribution, for tests that return several.
+ * \param histogram
+ *      The measurements.
+ */
+void
+sendHistogram(const char* name, const Histogram& histogram)
+{
+    ProtoBuf::Histogram protoBuf;
+    histogram.serialize(protoBuf);
+    string serialized;
+    protoBuf.SerializeToString(&serialized);
+    string key = keyVal(clientIndex, name);
+    cluster->write(controlTable, key.c_str(), downCast<uint16_t>(key.length()),
+            serialized.data(), downCast<uint32_t>(serialized.size()));
+}
+
+/**
+ * Masters invoke this method to add a distribution returned by a slave
+ * (with sendHistogram) to their own. This method waits for the slave to
+ * return it, if it hasn't already.
+ *
+ * \param client
+ *      Index of the slave.
+ * \param name
+ *      Identifies the distribution; the same as passed to sendHistogram.
+ * \param histogram
+ *      The slave's measurements are merged into this histogram, which must
+ *      have the same shape.
+ */
+void
+mergeHistogram(int client, const char* name, Histogram* histogram)
+{
+    Buffer buffer;
+    string key = keyVal(client, name);
+    waitForObject(controlTable, key.c_str(), downCast<uint16_t>(key.length()),
+            NULL, buffer);
+    ProtoBuf::Histogram protoBuf;
+    protoBuf.ParseFromArray(buffer.getRange(0, buffer.size()),
+            buffer.size());
+    histogram->merge(Histogram(protoBuf));
+}
+
 /**
  * Return the largest element in a vector.
  *
@@ -2908,6 +2978,99 @@ indexReadDist()
     cluster->dropIndex(dataTable, indexId);
 }
 
+// This benchmark measures how lookup throughput on a single indexlet scales
+// with the number of lookups outstanding at once. A single client keeps a
+// fixed number of LOOKUP_INDEX_KEYS RPCs in flight, each for a randomly
+// chosen secondary key, and the measurement is repeated for 1, 2, 4, ...
+// concurrent readers, up to --count. The index server needs several worker
+// cores (--maxCores) for the readers to overlap.
+void
+indexConcurrentReaders()
+{
+    if (clientIndex != 0)
+        return;
+
+    const uint16_t keyLength = 30;
+    const int valLen = objectSize;
+    const uint8_t indexId = 1;
+    const uint8_t numKeys = 2;
+    const uint32_t indexSize = (numObjects > 1000) ? numObjects : 1000;
+    cluster->createIndex(dataTable, indexId, 0 /*index type*/, 1);
+
+    KeyInfo keyList[numKeys];
+    char primaryKey[keyLength], secondaryKey[keyLength];
+    keyList[0].key = primaryKey;
+    keyList[1].key = secondaryKey;
+
+    // Fill up the table and the index.
+    Buffer val;
+    for (uint32_t i = 0; i < indexSize; i++) {
+        generateIndexKeyList(keyList, i, keyLength, numKeys);
+        fillBuffer(val, valLen, dataTable, primaryKey, keyLength);
+        cluster->write(dataTable, numKeys, keyList,
+                val.getRange(0, valLen), valLen);
+    }
+
+    printf("# RAMCloud index lookup throughput for a single indexlet as the\n"
+           "# number of concurrent lookups grows. Each lookup returns the\n"
+           "# primary key hash for one of %u %d-byte secondary keys.\n"
+           "# Generated by 'clusterperf.py indexConcurrentReaders'\n"
+           "#\n"
+           "# readers  throughput(klookups/sec)\n"
+           "#-------------------------------------\n", indexSize, keyLength);
+    fflush(stdout);
+
+    uint64_t runCycles = Cycles::fromSeconds(1.0);
+    for (int concurrent = 1; concurrent <= count; concurrent *= 2) {
+        Buffer responses[concurrent];
+        char keys[concurrent][keyLength];
+        Tub<LookupIndexKeysRpc> rpcs[concurrent];
+        uint32_t numHashes;
+        uint16_t nextKeyLength;
+        uint64_t nextKeyHash;
+        uint64_t lookups = 0;
+
+        // Start a lookup in each slot, then restart each slot's lookup as
+        // soon as the previous one completes, until time runs out.
+        uint64_t start = Cycles::rdtsc();
+        int active = concurrent;
+        for (int i = 0; i < concurrent; i++) {
+            generateIndexSecondaryKey(keys[i], 1,
+                    downCast<uint32_t>(randomNumberGenerator(indexSize)),
+                    keyLength);
+            rpcs[i].construct(cluster, dataTable, indexId, keys[i],
+                    keyLength, 0, keys[i], keyLength, 1000, &responses[i]);
+        }
+        while (active > 0) {
+            cluster->poll();
+            for (int i = 0; i < concurrent; i++) {
+                if (!rpcs[i] || !rpcs[i]->isReady())
+                    continue;
+                rpcs[i]->wait(&numHashes, &nextKeyLength, &nextKeyHash);
+                assert(numHashes == 1);
+                lookups++;
+                if (Cycles::rdtsc() - start >= runCycles) {
+                    rpcs[i].destroy();
+                    active--;
+                    continue;
+                }
+                generateIndexSecondaryKey(keys[i], 1,
+                        downCast<uint32_t>(randomNumberGenerator(indexSize)),
+                        keyLength);
+                rpcs[i].construct(cluster, dataTable, indexId, keys[i],
+                        keyLength, 0, keys[i], keyLength, 1000,
+                        &responses[i]);
+            }
+        }
+        double elapsed = Cycles::toSeconds(Cycles::rdtsc() - start);
+        printf("%5d         %8.1f\n", concurrent,
+                static_cast<double>(lookups)/elapsed/1e03);
+        fflush(stdout);
+    }
+
+    cluster->dropIndex(dataTable, indexId);
+}
+
 void
 indexRange() {
     if (clientIndex != 0)
@@ -5555,6 +5718,86 @@ readThroughput()
     }
 }
 
+/**
+ * Runs in each thread of the readThreads benchmark: issues random reads
+ * through a RamCloud object of its own, between two given times.
+ *
+ * \param numObjects
+ *      Number of objects in dataTable.
+ * \param keyLength
+ *      Size of keys, in bytes.
+ * \param startTime
+ *      Cycles::rdtsc() time at which to start reading.
+ * \param stopTime
+ *      Cycles::rdtsc() time at which to stop reading.
+ * \param[out] objectsRead
+ *      The number of reads completed is returned here.
+ */
+static void
+readThreadsWorker(int numObjects, uint16_t keyLength, uint64_t startTime,
+        uint64_t stopTime, uint64_t* objectsRead)
+{
+    RamCloud ramcloud(cluster);
+    std::vector<char> key(keyLength);
+    uint64_t reads = 0;
+    while (Cycles::rdtsc() < startTime) {
+        // Wait for the other threads.
+    }
+    do {
+        Buffer value;
+        makeKey(downCast<int>(generateRandom() % numObjects), keyLength,
+                key.data());
+        ramcloud.read(dataTable, key.data(), keyLength, &value);
+        reads++;
+    } while (Cycles::rdtsc() < stopTime);
+    *objectsRead = reads;
+}
+
+// This benchmark measures the throughput of a single client issuing
+// individual random reads from a varying number of threads, which share
+// the client's sessions and dispatch thread (see
+// RamCloud::enableMultiThreading).
+void
+readThreads()
+{
+    if (clientIndex != 0)
+        return;
+    const uint16_t keyLength = 30;
+    int size = objectSize;
+    if (size < 0)
+        size = 100;
+    const int numObjects = 1000000;
+    fillTable(dataTable, numObjects, keyLength, size);
+    cluster->enableMultiThreading();
+
+    printf("# RAMCloud read throughput of a single client issuing individual\n"
+            "# reads from a varying number of threads on randomly chosen\n"
+            "# %d-byte objects with %d-byte keys\n", size, keyLength);
+    printf("# Generated by 'clusterperf.py readThreads'\n");
+    printf("#\n");
+    printf("# numThreads   throughput(kreads/sec)\n");
+    printf("#-------------------------------------\n");
+    for (int threads = 1; threads <= numThreads; threads *= 2) {
+        std::vector<uint64_t> objectsRead(threads, 0);
+        std::vector<std::thread> workers;
+        uint64_t startTime = Cycles::rdtsc() + Cycles::fromSeconds(0.1);
+        uint64_t stopTime = startTime + Cycles::fromSeconds(1.0);
+        for (int i = 0; i < threads; i++) {
+            workers.emplace_back(readThreadsWorker, numObjects, keyLength,
+                    startTime, stopTime, &objectsRead[i]);
+        }
+        uint64_t total = 0;
+        for (int i = 0; i < threads; i++) {
+            workers[i].join();
+            total += objectsRead[i];
+        }
+        printf("%5d         %8.0f\n", threads,
+                static_cast<double>(total)/Cycles::toSeconds(
+                stopTime - startTime)/1e03);
+        fflush(stdout);
+    }
+}
+
 // Read times for objects with string keys of different lengths.
 void
 readVaryingKeyLength()
@@ -5775,11 +6018,13 @@ writeThroughputMaster(int numObjects, int size, uint16_t keyLength)
     // throughput while gradually increasing the number of workers.
     printf("#\n");
     printf("# clients   throughput   worker   cleaner  compactor  "
-            "cleaner  dispatch  netOut    netIn   replic    sync\n");
+            "cleaner  dispatch  netOut    netIn   replic    sync   append\n");
     printf("#           (kops/sec)   cores     cores    free %%    "
-            "free %%   utiliz.   (MB/s)    (MB/s)   eff.     frac\n");
+            "free %%   utiliz.   (MB/s)    (MB/s)   eff.     frac  "
+            "lock wait\n");
     printf("#------------------------------------------------------"
-            "------------------------------------------------------\n");
+            "------------------------------------------------------"
+            "---------\n");
     fillTable(dataTable, numObjects, keyLength, size);
     Cycles::sleep(2000000);
     string stats[5];
@@ -5852,11 +6097,15 @@ writeThroughputMaster(int numObjects, int size, uint16_t keyLength)
                 finishStats.replicationRpcs - startStats.replicationRpcs);
         double syncFraction = static_cast<double>(finishStats.logSyncCycles -
                 startStats.logSyncCycles) / elapsedCycles;
+        double appendLockWait = static_cast<double>(
+                finishStats.logAppendLockCycles -
+                startStats.logAppendLockCycles) / elapsedCycles;
         printf("%5d       %8.2f   %8.3f %8.3f %8.1f  %8.1f  %8.3f "
-                "%8.2f  %8.2f %7.2f  %7.2f\n",
+                "%8.2f  %8.2f %7.2f  %7.2f  %7.3f\n",
                 numSlaves, rate/1e03, utilization, cleanerUtilization,
                 compactorFreePct, cleanerFreePct, dispatchUtilization,
-                netOutRate/1e06, netInRate/1e06, repEfficiency, syncFraction);
+                netOutRate/1e06, netInRate/1e06, repEfficiency, syncFraction,
+                appendLockWait);
     }
     sendCommand("done", "done", 1, numClients-1);
 #if 0
@@ -5940,6 +6189,654 @@ writeThroughput()
     }
 }
 
+// Latencies recorded by open-loop tests are kept in histograms with this many
+// buckets of OPEN_LOOP_BUCKET_NS each (so latencies up to 100 ms are
+// distinguished).
+#define OPEN_LOOP_BUCKETS 50000
+#define OPEN_LOOP_BUCKET_NS 2000
+
+// Largest number of requests that an open-loop client has outstanding at
+// once; arrivals beyond this wait (and their waiting time is counted).
+#define OPEN_LOOP_MAX_OUTSTANDING 64
+
+/**
+ * Offer load from this client to the workload's table with Poisson
+ * arrivals: unlike the other tests, the time at which each request is sent
+ * doesn't depend on when earlier ones finished. Latencies are measured from
+ * the time at which each request was supposed to be sent, so requests that
+ * are delayed because the client has too many outstanding are charged for
+ * the delay (otherwise the measurements would omit exactly the periods when
+ * the system is overloaded).
+ *
+ * \param generator
+ *      Determines the keys, object sizes, and mix of reads and writes.
+ * \param rate
+ *      Average number of requests to send per second.
+ * \param seconds
+ *      Stop sending new requests after this long; the call returns once
+ *      the outstanding ones have completed.
+ * \param latencies
+ *      The latency of each request, in nanoseconds, is added to this.
+ * \param[out] elapsed
+ *      Set to the number of seconds from the start until the last request
+ *      completed.
+ * \param[out] delayed
+ *      Set to the number of requests that were sent more than 10 us after
+ *      their arrival times.
+ */
+void
+runOpenLoop(WorkloadGenerator* generator, double rate, double seconds,
+        Histogram* latencies, double* elapsed, uint64_t* delayed)
+{
+    struct Request {
+        Request() : read(), write(), value(), arrival(0) {}
+        Tub<ReadRpc> read;
+        Tub<WriteRpc> write;
+        Buffer value;
+        uint64_t arrival;
+    };
+    Request requests[OPEN_LOOP_MAX_OUTSTANDING];
+    const uint16_t keyLength = 30;
+    char key[keyLength];
+    // Outstanding writes may refer to the value, so it is the same for all.
+    std::vector<char> value(generator->recordSizeB);
+    Util::genRandomString(&value[0], generator->recordSizeB);
+    uint64_t readThreshold = (~0UL / 100) * generator->readPercent;
+    double cyclesPerArrival = Cycles::perSecond() / rate;
+    uint64_t lateThreshold = Cycles::fromNanoseconds(10000);
+
+    uint64_t start = Cycles::rdtsc();
+    uint64_t end = start + Cycles::fromSeconds(seconds);
+    uint64_t lastCompletion = start;
+    double nextArrival = static_cast<double>(start);
+    int outstanding = 0;
+    *delayed = 0;
+    while (true) {
+        // Send the requests whose arrival times have passed, as long as
+        // there is room for them.
+        uint64_t now = Cycles::rdtsc();
+        while ((nextArrival <= static_cast<double>(now)) &&
+                (nextArrival < static_cast<double>(end)) &&
+                (outstanding < OPEN_LOOP_MAX_OUTSTANDING)) {
+            Request* request = NULL;
+            for (int i = 0; i < OPEN_LOOP_MAX_OUTSTANDING; i++) {
+                if (!requests[i].read && !requests[i].write) {
+                    request = &requests[i];
+                    break;
+                }
+            }
+            request->arrival = static_cast<uint64_t>(nextArrival);
+            if (now - request->arrival > lateThreshold)
+                (*delayed)++;
+            memset(key, 0, keyLength);
+            string("workload").copy(key, 8);
+            *reinterpret_cast<uint64_t*>(key + 8) =
+                    generator->generator->nextNumber();
+            if (generateRandom() <= readThreshold) {
+                request->read.construct(cluster, dataTable, key, keyLength,
+                        &request->value);
+            } else {
+                request->write.construct(cluster, dataTable, key, keyLength,
+                        &value[0], downCast<uint32_t>(generator->recordSizeB));
+            }
+            outstanding++;
+
+            // Exponentially distributed gaps give Poisson arrivals; the
+            // random value is in (0, 1].
+            double uniform = static_cast<double>((generateRandom() >> 11) + 1)
+                    / static_cast<double>(1UL << 53);
+            nextArrival += -log(uniform) * cyclesPerArrival;
+        }
+        if ((outstanding == 0) && (nextArrival >= static_cast<double>(end)))
+            break;
+
+        cluster->poll();
+        for (int i = 0; i < OPEN_LOOP_MAX_OUTSTANDING; i++) {
+            Request* request = &requests[i];
+            if (request->read && request->read->isReady()) {
+                request->read->wait();
+                request->read.destroy();
+            } else if (request->write && request->write->isReady()) {
+                request->write->wait();
+                request->write.destroy();
+            } else {
+                continue;
+            }
+            lastCompletion = Cycles::rdtsc();
+            latencies->storeSample(Cycles::toNanoseconds(
+                    lastCompletion - request->arrival));
+            outstanding--;
+        }
+    }
+    *elapsed = Cycles::toSeconds(lastCompletion - start);
+}
+
+// This benchmark measures latency under load: clients offer the workload at
+// increasing rates with Poisson arrivals (open loop), and the median and
+// tail latencies at each rate are reported along with the throughput the
+// cluster actually achieved.
+void
+workloadOpenLoop()
+{
+    WorkloadGenerator generator(workload);
+    if (clientIndex > 0) {
+        // Slaves offer their share of each rate when told to, then report
+        // their latencies and throughput.
+        while (true) {
+            char command[20];
+            getCommand(command, sizeof(command));
+            if (strncmp(command, "run ", 4) == 0) {
+                int step = downCast<int>(strtol(command + 4, NULL, 10));
+                setSlaveState("running");
+                Histogram latencies(OPEN_LOOP_BUCKETS, OPEN_LOOP_BUCKET_NS);
+                double elapsed;
+                uint64_t delayed;
+                runOpenLoop(&generator, static_cast<double>(maxRate) * step /
+                        rateSteps / numClients, stepSeconds, &latencies,
+                        &elapsed, &delayed);
+                sendHistogram("latencies", latencies);
+                sendMetrics(static_cast<double>(
+                        latencies.getTotalSamples()) / elapsed,
+                        static_cast<double>(delayed));
+                setSlaveState("idle");
+            } else if (strcmp(command, "done") == 0) {
+                setSlaveState("done");
+                return;
+            } else {
+                RAMCLOUD_LOG(ERROR, "unknown command %s", command);
+                return;
+            }
+        }
+    }
+
+    printf("# RAMCloud latency of the %s workload (%d-byte objects) with\n"
+            "# requests arriving at increasing rates (Poisson arrivals from\n"
+            "# %d clients, open loop). Latencies are measured from the time\n"
+            "# each request should have been sent; those over %d ms are\n"
+            "# reported as the maximum.\n", workload.c_str(), objectSize,
+            numClients, OPEN_LOOP_BUCKETS * OPEN_LOOP_BUCKET_NS / 1000000);
+    printf("# Generated by 'clusterperf.py workloadOpenLoop'\n");
+    printf("#\n");
+    printf("# Offered   Achieved    p50       p99       p999      Delayed\n");
+    printf("# (kops)    (kops)      (us)      (us)      (us)      sends\n");
+    printf("#-------------------------------------------------------------\n");
+    generator.setup();
+    for (int step = 1; step <= rateSteps; step++) {
+        sendCommand(format("run %d", step).c_str(), "running", 1,
+                numClients - 1);
+        double offered = static_cast<double>(maxRate) * step / rateSteps;
+        Histogram latencies(OPEN_LOOP_BUCKETS, OPEN_LOOP_BUCKET_NS);
+        double elapsed;
+        uint64_t delayed;
+        runOpenLoop(&generator, offered / numClients, stepSeconds, &latencies,
+                &elapsed, &delayed);
+        sendMetrics(static_cast<double>(latencies.getTotalSamples()) /
+                elapsed, static_cast<double>(delayed));
+
+        // Wait for the slaves to finish, then merge in their results.
+        for (int slave = 1; slave < numClients; slave++) {
+            waitSlave(slave, "idle", stepSeconds + 10.0);
+            mergeHistogram(slave, "latencies", &latencies);
+        }
+        ClientMetrics metrics;
+        getMetrics(metrics, numClients);
+        printf("%8.1f  %8.1f  %8.1f  %8.1f  %8.1f  %8.0f\n", offered / 1e03,
+                sum(metrics[0]) / 1e03,
+                static_cast<double>(latencies.getPercentile(0.5)) / 1e03,
+                static_cast<double>(latencies.getPercentile(0.99)) / 1e03,
+                static_cast<double>(latencies.getPercentile(0.999)) / 1e03,
+                sum(metrics[1]));
+        fflush(stdout);
+    }
+    sendCommand("done", "done", 1, numClients - 1);
+}
+
+// The traceReplay test replays a file containing a ReplayHeader followed by
+// ReplayHeader::count ReplayRecords, in order of time; all values are little
+// endian. scripts/mkreplaytrace.py creates these files from text.
+#define REPLAY_MAGIC 0x54524352     // "RCRT"
+#define REPLAY_VERSION 1
+
+struct ReplayHeader {
+    uint32_t magic;                 // Always REPLAY_MAGIC.
+    uint32_t version;               // Always REPLAY_VERSION.
+    uint64_t count;                 // Number of records that follow.
+} __attribute__((packed));
+
+// Operations that can appear in a trace.
+enum ReplayOp { REPLAY_READ, REPLAY_WRITE, REPLAY_REMOVE, REPLAY_OPS };
+static const char* replayOpNames[] = {"read", "write", "remove"};
+
+struct ReplayRecord {
+    uint64_t time;                  // Nanoseconds from the start of the
+                                    // trace until the request was issued.
+    uint64_t key;                   // Identifies the object within its table.
+    uint32_t valueLength;           // Size of the value written (writes
+                                    // only).
+    uint16_t client;                // Client that issued the request; each
+                                    // client's requests are replayed one at
+                                    // a time, in order.
+    uint8_t op;                     // A ReplayOp.
+    uint8_t table;                  // Index of the table holding the object.
+} __attribute__((packed));
+
+/**
+ * Read a request trace for traceReplay.
+ *
+ * \param fileName
+ *      Name of the file containing the trace.
+ * \param[out] records
+ *      Filled in with the records of the trace.
+ *
+ * \throw Exception
+ *      The file couldn't be read or isn't a valid trace.
+ */
+void
+readReplayTrace(const string& fileName, std::vector<ReplayRecord>* records)
+{
+    FILE* f = fopen(fileName.c_str(), "r");
+    if (f == NULL) {
+        throw Exception(HERE, format("couldn't open trace %s: %s",
+                fileName.c_str(), strerror(errno)));
+    }
+    ReplayHeader header;
+    if ((fread(&header, sizeof(header), 1, f) != 1) ||
+            (header.magic != REPLAY_MAGIC) ||
+            (header.version != REPLAY_VERSION)) {
+        fclose(f);
+        throw Exception(HERE, format("%s isn't a request trace",
+                fileName.c_str()));
+    }
+    records->resize(header.count);
+    size_t count = fread(records->data(), sizeof(ReplayRecord), header.count,
+            f);
+    fclose(f);
+    if (count != header.count) {
+        throw Exception(HERE, format("trace %s is truncated (%lu of %lu "
+                "records)", fileName.c_str(), count, header.count));
+    }
+    foreach (ReplayRecord& record, *records) {
+        if (record.op >= REPLAY_OPS) {
+            throw Exception(HERE, format("trace %s contains unknown "
+                    "operation %d", fileName.c_str(), record.op));
+        }
+    }
+}
+
+/**
+ * Generate the key of an object named in a request trace.
+ *
+ * \param record
+ *      A request from the trace.
+ * \param key
+ *      Filled in with the key; must hold REPLAY_KEY_LENGTH bytes.
+ */
+#define REPLAY_KEY_LENGTH 30
+void
+makeReplayKey(const ReplayRecord& record, char* key)
+{
+    memset(key, 0, REPLAY_KEY_LENGTH);
+    string("replay").copy(key, 6);
+    memcpy(key + 8, &record.key, sizeof(record.key));
+}
+
+/**
+ * Create the tables named in a request trace and write every object that
+ * the trace accesses, so that reads find data. Each object is given the
+ * size written by the first request in the trace that accesses it (or
+ * --size, if that request isn't a write).
+ *
+ * \param records
+ *      The trace.
+ * \param tableIds
+ *      Filled in with the identifiers of the tables, indexed by
+ *      ReplayRecord::table.
+ */
+void
+setupReplay(const std::vector<ReplayRecord>& records,
+        std::vector<uint64_t>* tableIds)
+{
+    int numTables = 0;
+    foreach (const ReplayRecord& record, records)
+        numTables = std::max(numTables, record.table + 1);
+    for (int i = 0; i < numTables; i++) {
+        string name = format("replay%d", i);
+        cluster->createTable(name.c_str(), downCast<uint32_t>(numClients));
+        tableIds->push_back(cluster->getTableId(name.c_str()));
+    }
+
+    std::unordered_map<uint64_t, uint32_t> sizes[256];
+    foreach (const ReplayRecord& record, records) {
+        uint32_t size = (record.op == REPLAY_WRITE) ? record.valueLength
+                : downCast<uint32_t>(objectSize);
+        sizes[record.table].insert({record.key, size});
+    }
+
+    const int batchSize = 100;
+    std::vector<char> value(1000000);
+    Util::genRandomString(&value[0], downCast<int>(value.size()));
+    char keys[batchSize][REPLAY_KEY_LENGTH];
+    Tub<MultiWriteObject> objects[batchSize];
+    MultiWriteObject* requests[batchSize];
+    int count = 0;
+    for (int table = 0; table < numTables; table++) {
+        foreach (auto& entry, sizes[table]) {
+            ReplayRecord record;
+            record.key = entry.first;
+            makeReplayKey(record, keys[count]);
+            objects[count].construct((*tableIds)[table], keys[count],
+                    downCast<uint16_t>(REPLAY_KEY_LENGTH), &value[0],
+                    std::min(entry.second,
+                    downCast<uint32_t>(value.size())));
+            requests[count] = objects[count].get();
+            count++;
+            if (count == batchSize) {
+                cluster->multiWrite(requests, count);
+                count = 0;
+            }
+        }
+    }
+    if (count > 0)
+        cluster->multiWrite(requests, count);
+}
+
+/**
+ * Replay the requests of a trace that belong to this client, at the times
+ * at which they were issued. Each of the trace's clients has one request
+ * outstanding at a time, so the concurrency of the original workload is
+ * preserved too. Latencies are measured from the time at which each request
+ * should have been sent, even if it had to wait for the previous request
+ * from its client (as in runOpenLoop).
+ *
+ * \param records
+ *      The trace.
+ * \param tableIds
+ *      Identifiers of the trace's tables (see setupReplay).
+ * \param latencies
+ *      Latencies, in nanoseconds, are added to the histogram for each
+ *      request's ReplayOp.
+ * \param[out] elapsed
+ *      Set to the number of seconds from the start until the last request
+ *      completed.
+ * \param[out] delayed
+ *      Set to the number of requests that were sent more than 10 us after
+ *      their scheduled times.
+ */
+void
+runReplay(const std::vector<ReplayRecord>& records,
+        const std::vector<uint64_t>& tableIds, Histogram* latencies[],
+        double* elapsed, uint64_t* delayed)
+{
+    // All of the requests for each of the trace's clients that were
+    // assigned to this one, in order.
+    struct TraceClient {
+        TraceClient()
+            : requests(), next(0), read(), write(), remove(), value()
+        {}
+        std::vector<const ReplayRecord*> requests;
+        size_t next;
+        Tub<ReadRpc> read;
+        Tub<WriteRpc> write;
+        Tub<RemoveRpc> remove;
+        Buffer value;
+    };
+    std::unordered_map<uint16_t, TraceClient> clients;
+    uint32_t maxValueLength = 0;
+    foreach (const ReplayRecord& record, records) {
+        if (record.client % numClients != clientIndex)
+            continue;
+        clients[record.client].requests.push_back(&record);
+        maxValueLength = std::max(maxValueLength, record.valueLength);
+    }
+
+    // Outstanding writes may refer to the value, so it is the same for all.
+    std::vector<char> value(maxValueLength + 1);
+    Util::genRandomString(&value[0], downCast<int>(value.size()));
+    char key[REPLAY_KEY_LENGTH];
+    uint64_t lateThreshold = Cycles::fromNanoseconds(10000);
+
+    // Clients that are idle, ordered by the time of their next request.
+    typedef std::pair<uint64_t, TraceClient*> Ready;
+    std::priority_queue<Ready, std::vector<Ready>, std::greater<Ready>> ready;
+    uint64_t start = Cycles::rdtsc();
+    auto scheduledTime = [&](const ReplayRecord* record) {
+        return start + Cycles::fromNanoseconds(static_cast<uint64_t>(
+                static_cast<double>(record->time) / traceSpeed));
+    };
+    for (auto& entry : clients)
+        ready.push(Ready(scheduledTime(entry.second.requests[0]),
+                &entry.second));
+
+    std::vector<TraceClient*> active;
+    uint64_t lastCompletion = start;
+    *delayed = 0;
+    while (!ready.empty() || !active.empty()) {
+        uint64_t now = Cycles::rdtsc();
+        while (!ready.empty() && (ready.top().first <= now)) {
+            TraceClient* client = ready.top().second;
+            ready.pop();
+            const ReplayRecord* record = client->requests[client->next];
+            if (now - scheduledTime(record) > lateThreshold)
+                (*delayed)++;
+            makeReplayKey(*record, key);
+            uint64_t tableId = tableIds[record->table];
+            if (record->op == REPLAY_READ) {
+                client->read.construct(cluster, tableId, key,
+                        downCast<uint16_t>(REPLAY_KEY_LENGTH),
+                        &client->value);
+            } else if (record->op == REPLAY_WRITE) {
+                client->write.construct(cluster, tableId, key,
+                        downCast<uint16_t>(REPLAY_KEY_LENGTH), &value[0],
+                        record->valueLength);
+            } else {
+                client->remove.construct(cluster, tableId, key,
+                        downCast<uint16_t>(REPLAY_KEY_LENGTH));
+            }
+            active.push_back(client);
+        }
+
+        cluster->poll();
+        for (size_t i = 0; i < active.size(); ) {
+            TraceClient* client = active[i];
+            const ReplayRecord* record = client->requests[client->next];
+            try {
+                if (client->read && client->read->isReady()) {
+                    client->read->wait();
+                } else if (client->write && client->write->isReady()) {
+                    client->write->wait();
+                } else if (client->remove && client->remove->isReady()) {
+                    client->remove->wait();
+                } else {
+                    i++;
+                    continue;
+                }
+            } catch (ObjectDoesntExistException& e) {
+                // The trace may read objects that it removed earlier.
+            }
+            client->read.destroy();
+            client->write.destroy();
+            client->remove.destroy();
+            lastCompletion = Cycles::rdtsc();
+            latencies[record->op]->storeSample(Cycles::toNanoseconds(
+                    lastCompletion - scheduledTime(record)));
+
+            active[i] = active.back();
+            active.pop_back();
+            client->next++;
+            if (client->next < client->requests.size()) {
+                ready.push(Ready(scheduledTime(
+                        client->requests[client->next]), client));
+            }
+        }
+    }
+    *elapsed = Cycles::toSeconds(lastCompletion - start);
+}
+
+// This benchmark replays a trace of requests recorded in production (given
+// by --trace) with its original timing and concurrency, spreading the
+// trace's clients across all of the ClusterPerf clients, and reports the
+// latency of each kind of operation.
+void
+traceReplay()
+{
+    if (traceFile.empty()) {
+        RAMCLOUD_LOG(ERROR, "traceReplay needs a trace (--trace)");
+        exit(1);
+    }
+    std::vector<ReplayRecord> records;
+    readReplayTrace(traceFile, &records);
+    std::vector<uint64_t> tableIds;
+    Tub<Histogram> latencies[REPLAY_OPS];
+    Histogram* histograms[REPLAY_OPS];
+    for (int op = 0; op < REPLAY_OPS; op++) {
+        latencies[op].construct(OPEN_LOOP_BUCKETS, OPEN_LOOP_BUCKET_NS);
+        histograms[op] = latencies[op].get();
+    }
+    double elapsed;
+    uint64_t delayed;
+
+    if (clientIndex > 0) {
+        while (true) {
+            char command[20];
+            getCommand(command, sizeof(command));
+            if (strcmp(command, "run") == 0) {
+                int numTables = 0;
+                foreach (const ReplayRecord& record, records)
+                    numTables = std::max(numTables, record.table + 1);
+                for (int i = 0; i < numTables; i++) {
+                    tableIds.push_back(cluster->getTableId(
+                            format("replay%d", i).c_str()));
+                }
+                setSlaveState("running");
+                runReplay(records, tableIds, histograms, &elapsed, &delayed);
+                for (int op = 0; op < REPLAY_OPS; op++)
+                    sendHistogram(replayOpNames[op], *latencies[op]);
+                sendMetrics(elapsed, static_cast<double>(delayed));
+                setSlaveState("idle");
+            } else if (strcmp(command, "done") == 0) {
+                setSlaveState("done");
+                return;
+            } else {
+                RAMCLOUD_LOG(ERROR, "unknown command %s", command);
+                return;
+            }
+        }
+    }
+
+    setupReplay(records, &tableIds);
+    double traceSeconds = records.empty() ? 0.0 :
+            static_cast<double>(records.back().time) / 1e09 / traceSpeed;
+    sendCommand("run", "running", 1, numClients - 1);
+    runReplay(records, tableIds, histograms, &elapsed, &delayed);
+    sendMetrics(elapsed, static_cast<double>(delayed));
+    for (int slave = 1; slave < numClients; slave++) {
+        waitSlave(slave, "idle", traceSeconds + 60.0);
+        for (int op = 0; op < REPLAY_OPS; op++)
+            mergeHistogram(slave, replayOpNames[op], latencies[op].get());
+    }
+    ClientMetrics metrics;
+    getMetrics(metrics, numClients);
+    sendCommand("done", "done", 1, numClients - 1);
+
+    printf("# Replay of %s (%lu requests over %.1f s at %.1fx speed) from "
+            "%d clients;\n", traceFile.c_str(), records.size(), traceSeconds,
+            traceSpeed, numClients);
+    printf("# took %.1f s, %.0f requests were sent more than 10 us late.\n"
+            "# Latencies are measured from the time each request should have\n"
+            "# been sent; those over %d ms are reported as the maximum.\n",
+            max(metrics[0]), sum(metrics[1]),
+            OPEN_LOOP_BUCKETS * OPEN_LOOP_BUCKET_NS / 1000000);
+    printf("# Generated by 'clusterperf.py traceReplay'\n");
+    printf("#\n");
+    printf("# Op          Count   Rate (kops)  p50 (us)  p99 (us)  "
+            "p999 (us)\n");
+    printf("#--------------------------------------------------------------\n");
+    for (int op = 0; op < REPLAY_OPS; op++) {
+        Histogram* h = latencies[op].get();
+        if (h->getTotalSamples() == 0)
+            continue;
+        printf("%-8s %10lu  %10.1f  %8.1f  %8.1f  %8.1f\n", replayOpNames[op],
+                h->getTotalSamples(),
+                static_cast<double>(h->getTotalSamples()) /
+                max(metrics[0]) / 1e03,
+                static_cast<double>(h->getPercentile(0.5)) / 1e03,
+                static_cast<double>(h->getPercentile(0.99)) / 1e03,
+                static_cast<double>(h->getPercentile(0.999)) / 1e03);
+    }
+    fflush(stdout);
+}
+
+// This benchmark measures how much master memory each object costs, for a
+// range of object sizes: it fills a table with objects of each size and then
+// asks the master to account for its memory (see MemoryAccounting), which
+// splits the use of the log into keys and values, metadata (object and
+// entry headers and hash table entries), tombstones, and dead entries.
+void
+memoryEfficiency()
+{
+    if (clientIndex != 0)
+        return;
+
+    const uint16_t keyLength = 30;
+    const int sizes[] = {16, 32, 64, 100, 128, 256, 512, 1000, 2000, 4000,
+            8000, 16000, 64000};
+    const int maxBytesPerSize = 100 * 1024 * 1024;
+    std::vector<char> value(64000);
+    Util::genRandomString(&value[0], downCast<int>(value.size()));
+
+    printf("# Master memory used per object by objects of different sizes\n"
+            "# (%d-byte keys; at most %d objects or %d MB of each size).\n",
+            keyLength, count, maxBytesPerSize / (1024 * 1024));
+    printf("# Generated by 'clusterperf.py memoryEfficiency'\n");
+    printf("#\n");
+    printf("#   Size   Objects  Bytes/Object  Metadata/Object  Overhead\n");
+    printf("#----------------------------------------------------------\n");
+    foreach (int size, sizes) {
+        string name = format("memoryEfficiency%d", size);
+        uint64_t tableId = cluster->createTable(name.c_str());
+        int numObjects = std::min(count, maxBytesPerSize /
+                (size + keyLength));
+        const int maxBatch = 100;
+        int batchSize = std::max(1, std::min(maxBatch, (1024 * 1024) / size));
+        char keys[maxBatch][keyLength];
+        Tub<MultiWriteObject> objects[maxBatch];
+        MultiWriteObject* requests[maxBatch];
+        for (int written = 0; written < numObjects; ) {
+            int batch = std::min(batchSize, numObjects - written);
+            for (int i = 0; i < batch; i++) {
+                makeKey(written + i, keyLength, keys[i]);
+                objects[i].construct(tableId, keys[i], keyLength, &value[0],
+                        size);
+                requests[i] = objects[i].get();
+            }
+            cluster->multiWrite(requests, batch);
+            written += batch;
+        }
+
+        Buffer buffer;
+        cluster->objectServerControl(tableId, keys[0], keyLength,
+                WireFormat::GET_MEMORY_USAGE, NULL, 0, &buffer);
+        ProtoBuf::MemoryUsage usage;
+        usage.ParseFromArray(buffer.getRange(0, buffer.size()),
+                buffer.size());
+        foreach (const ProtoBuf::MemoryUsage::Table& table, usage.table()) {
+            if (table.table_id() != tableId)
+                continue;
+            double total = static_cast<double>(table.live_bytes() +
+                    table.dead_bytes() + table.tombstone_bytes() +
+                    table.metadata_bytes());
+            double objectCount = static_cast<double>(table.live_objects());
+            printf("%8d %9lu  %12.1f  %15.1f  %7.1f%%\n", size,
+                    table.live_objects(), total / objectCount,
+                    static_cast<double>(table.metadata_bytes()) / objectCount,
+                    100.0 * (total - static_cast<double>(table.live_bytes())) /
+                    total);
+        }
+        cluster->dropTable(name.c_str());
+    }
+    fflush(stdout);
+}
+
 // This benchmark measures total throughput of a single server (in operations
 // per second) under a specified workload.
 void
@@ -6046,6 +6943,7 @@ TestInfo tests[] = {
     {"indexScalability", indexScalability},
     {"indexWriteDist", indexWriteDist},
     {"indexReadDist", indexReadDist},
+    {"indexConcurrentReaders", indexConcurrentReaders},
     {"transaction_oneMaster", transaction_oneMaster},
     {"transaction_collision", transaction_collision},
     {"transactionContention", transactionContention},
@@ -6057,6 +6955,7 @@ TestInfo tests[] = {
     {"multiRead_general", multiRead_general},
     {"multiRead_generalRandom", multiRead_generalRandom},
     {"multiReadThroughput", multiReadThroughput},
+    {"memoryEfficiency", memoryEfficiency},
     {"netBandwidth", netBandwidth},
     {"readAllToAll", readAllToAll},
     {"readDist", readDist},
@@ -6065,13 +6964,16 @@ TestInfo tests[] = {
     {"readLoaded", readLoaded},
     {"readNotFound", readNotFound},
     {"readRandom", readRandom},
+    {"readThreads", readThreads},
     {"readThroughput", readThroughput},
     {"readVaryingKeyLength", readVaryingKeyLength},
+    {"traceReplay", traceReplay},
     {"writeVaryingKeyLength", writeVaryingKeyLength},
     {"writeAsyncSync", writeAsyncSync},
     {"writeDistRandom", writeDistRandom},
     {"writeDistWorkload", writeDistWorkload},
     {"writeThroughput", writeThroughput},
+    {"workloadOpenLoop", workloadOpenLoop},
     {"workloadThroughput", workloadThroughput},
 };
 
@@ -6083,6 +6985,7 @@ try
     vector<string> testNames;
     string coordinatorLocator, logFile;
     string logLevel("NOTICE");
+    uint32_t rpcTraceSampling;
     po::options_description desc(
             "Usage: ClusterPerf [options] testName testName ...\n\n"
             "Runs one or more benchmarks on a RAMCloud cluster and outputs\n"
@@ -6125,10 +7028,31 @@ try
                 "will try to achieve (0 means run as fast as possible)")
         ("txSpan", po::value<int>(&txSpan)->default_value(1),
                 "Number of servers that each transaction should span")
+        ("numThreads", po::value<int>(&numThreads)->default_value(8),
+                "Largest number of threads to issue requests from a client")
         ("numIndexlet", po::value<int>(&numIndexlet)->default_value(1),
                 "number of Indexlets")
         ("numIndexes", po::value<int>(&numIndexes)->default_value(1),
-                "number of secondary keys per object");
+                "number of secondary keys per object")
+        ("maxRate", po::value<int>(&maxRate)->default_value(100000),
+                "Highest total rate (operations per second, across all "
+                "clients) offered by open-loop tests")
+        ("rateSteps", po::value<int>(&rateSteps)->default_value(10),
+                "Number of evenly spaced rates, up to maxRate, at which "
+                "open-loop tests measure latency")
+        ("stepSeconds", po::value<double>(&stepSeconds)->default_value(2.0),
+                "Seconds for which open-loop tests offer each rate")
+        ("trace", po::value<string>(&traceFile),
+                "Request trace replayed by the traceReplay test (see "
+                "scripts/mkreplaytrace.py)")
+        ("traceSpeed", po::value<double>(&traceSpeed)->default_value(1.0),
+                "Replay requests this many times faster than they were "
+                "recorded")
+        ("rpcTraceSampling",
+                po::value<uint32_t>(&rpcTraceSampling)->default_value(0),
+                "Trace one in this many of the RPCs sent by this client, "
+                "across all of the servers involved (0 means none; see "
+                "RpcTrace and scripts/rpctrace.py)");
     po::positional_options_description desc2;
     desc2.add("testName", -1);
     po::variables_map vm;
@@ -6156,6 +7080,7 @@ try
         exit(1);
     }
 
+    RpcTrace::setSampling(rpcTraceSampling);
     Context realContext;
     context = &realContext;
     RamCloud r(&realContext, coordinatorLocator.c_str());
@@ -0,0 +1,92 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "ColumnScanner.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct a ColumnScanner; the table isn't read until the first call to
+ * nextBatch.
+ *
+ * \param ramcloud
+ *      Overall information about the RAMCloud cluster to use.
+ * \param tableId
+ *      Identifier for the table to scan.
+ * \param schema
+ *      Describes the records in the table's values. It is copied, so it
+ *      needn't outlive this call.
+ * \param batchRows
+ *      The most records nextBatch returns at a time.
+ * \param filter
+ *      If non-NULL, only the objects that match this filter are returned
+ *      (see ParallelTableEnumerator). It must not project the values, since
+ *      the scanner needs whole records.
+ *
+ * \throw TableDoesntExistException
+ *      The coordinator has no record of the table.
+ */
+ColumnScanner::ColumnScanner(RamCloud& ramcloud, uint64_t tableId,
+        const PackedSchema& schema, uint32_t batchRows,
+        const ObjectFilter* filter)
+    : schema(schema)
+    , batchRows(batchRows)
+    , enumerator(ramcloud, tableId, false, 8, filter)
+    , columns(schema.getFieldCount())
+    , rowCount(0)
+    , skippedObjects(0)
+{
+    assert(batchRows > 0);
+    for (uint32_t i = 0; i < schema.getFieldCount(); i++) {
+        uint64_t bytes = uint64_t(schema.getFieldWidth(i)) * batchRows;
+        columns[i].resize((bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    }
+}
+
+/**
+ * Read the next batch of records from the table and split them into
+ * columns, which getColumn returns until the next call.
+ *
+ * \return
+ *      The number of records in the batch; 0 means the scan is over.
+ */
+uint32_t
+ColumnScanner::nextBatch()
+{
+    rowCount = 0;
+    uint32_t recordLength = schema.getRecordLength();
+    uint32_t fieldCount = schema.getFieldCount();
+    while (rowCount < batchRows && enumerator.hasNext()) {
+        uint32_t keyLength, dataLength;
+        const void* key;
+        const void* data;
+        enumerator.nextKeyAndData(&keyLength, &key, &dataLength, &data);
+        if (dataLength != recordLength) {
+            skippedObjects++;
+            continue;
+        }
+        const char* record = static_cast<const char*>(data);
+        for (uint32_t i = 0; i < fieldCount; i++) {
+            uint32_t width = schema.getFieldWidth(i);
+            memcpy(reinterpret_cast<char*>(columns[i].data()) +
+                    uint64_t(width) * rowCount,
+                    record + schema.getFieldOffset(i), width);
+        }
+        rowCount++;
+    }
+    return rowCount;
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,93 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_COLUMNSCANNER_H
+#define RAMCLOUD_COLUMNSCANNER_H
+
+#include <vector>
+
+#include "PackedSchema.h"
+#include "ParallelTableEnumerator.h"
+
+namespace RAMCloud {
+
+/**
+ * Enumerates a table whose values are records packed with a PackedSchema,
+ * and returns them in batches of columns: each call to nextBatch fills one
+ * array per field with that field of up to a batch's worth of records, so
+ * that aggregations can loop over contiguous values of a single type (which
+ * compilers can vectorize) instead of decoding objects one at a time.
+ *
+ * The table is enumerated with a ParallelTableEnumerator, so the records
+ * come in no particular order. Objects whose values aren't exactly one
+ * record long are skipped (see getSkippedObjects).
+ */
+class ColumnScanner {
+  PUBLIC:
+    ColumnScanner(RamCloud& ramcloud, uint64_t tableId,
+            const PackedSchema& schema, uint32_t batchRows = 1024,
+            const ObjectFilter* filter = NULL);
+    uint32_t nextBatch();
+
+    /**
+     * Return one field of the records in the last batch, as an array of
+     * #getRowCount values.
+     *
+     * \tparam T
+     *      Type of the field; its size must be the field's width.
+     * \param field
+     *      Index of the field (returned by PackedSchema::addField).
+     */
+    template<typename T>
+    const T* getColumn(uint32_t field) const
+    {
+        assert(sizeof(T) == schema.getFieldWidth(field));
+        return reinterpret_cast<const T*>(columns[field].data());
+    }
+
+    /// Return the number of records in the last batch.
+    uint32_t getRowCount() const { return rowCount; }
+
+    /// Return the number of objects skipped so far because their values
+    /// weren't packed records.
+    uint64_t getSkippedObjects() const { return skippedObjects; }
+
+  PRIVATE:
+    /// Copy of the schema the constructor was given.
+    PackedSchema schema;
+
+    /// Most records in a batch.
+    uint32_t batchRows;
+
+    /// Provides the records.
+    ParallelTableEnumerator enumerator;
+
+    /// Column of each field for the current batch, each with room for
+    /// #batchRows values. uint64_t elements keep the columns aligned for
+    /// any field type.
+    std::vector<std::vector<uint64_t>> columns;
+
+    /// See getRowCount.
+    uint32_t rowCount;
+
+    /// See getSkippedObjects.
+    uint64_t skippedObjects;
+
+    DISALLOW_COPY_AND_ASSIGN(ColumnScanner);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_COLUMNSCANNER_H
@@ -0,0 +1,106 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "ColumnScanner.h"
+#include "MockCluster.h"
+
+namespace RAMCloud {
+
+class ColumnScannerTest : public ::testing::Test {
+  public:
+    TestLog::Enable logEnabler;
+    Context context;
+    MockCluster cluster;
+    RamCloud ramcloud;
+    uint64_t tableId;
+    PackedSchema schema;
+
+  public:
+    ColumnScannerTest()
+        : logEnabler()
+        , context()
+        , cluster(&context)
+        , ramcloud(&context, "mock:host=coordinator")
+        , tableId(-1)
+        , schema()
+    {
+        Logger::get().setLogLevels(RAMCloud::SILENT_LOG_LEVEL);
+
+        ServerConfig config = ServerConfig::forTesting();
+        config.services = {WireFormat::MASTER_SERVICE,
+                           WireFormat::PING_SERVICE};
+        config.localLocator = "mock:host=master1";
+        cluster.addServer(config);
+        config.localLocator = "mock:host=master2";
+        cluster.addServer(config);
+
+        tableId = ramcloud.createTable("table1", 2);
+
+        // Records are a uint32_t id followed by a uint16_t count.
+        schema.addField(4, 0);
+        schema.addField(2, 4);
+    }
+
+    void
+    writeRecord(uint32_t id, uint16_t count)
+    {
+        char record[6];
+        memcpy(record, &id, sizeof(id));
+        memcpy(record + 4, &count, sizeof(count));
+        string key = format("%u", id);
+        ramcloud.write(tableId, key.c_str(), downCast<uint16_t>(key.size()),
+                record, sizeof(record));
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(ColumnScannerTest);
+};
+
+TEST_F(ColumnScannerTest, nextBatch) {
+    for (uint32_t id = 0; id < 5; id++)
+        writeRecord(id, downCast<uint16_t>(10 * id));
+    ramcloud.write(tableId, "bad", 3, "not a record", 12);
+
+    ColumnScanner scanner(ramcloud, tableId, schema, 3);
+    uint32_t rows = 0;
+    uint32_t idSum = 0;
+    uint32_t countSum = 0;
+    uint32_t batches = 0;
+    while (scanner.nextBatch() > 0) {
+        batches++;
+        EXPECT_LE(scanner.getRowCount(), 3u);
+        const uint32_t* ids = scanner.getColumn<uint32_t>(0);
+        const uint16_t* counts = scanner.getColumn<uint16_t>(1);
+        for (uint32_t i = 0; i < scanner.getRowCount(); i++) {
+            EXPECT_EQ(10 * ids[i], counts[i]);
+            idSum += ids[i];
+            countSum += counts[i];
+        }
+        rows += scanner.getRowCount();
+    }
+    EXPECT_EQ(5u, rows);
+    EXPECT_EQ(10u, idSum);
+    EXPECT_EQ(100u, countSum);
+    EXPECT_LE(2u, batches);
+    EXPECT_EQ(1u, scanner.getSkippedObjects());
+    EXPECT_EQ(0u, scanner.getRowCount());
+}
+
+TEST_F(ColumnScannerTest, nextBatch_emptyTable) {
+    ColumnScanner scanner(ramcloud, tableId, schema);
+    EXPECT_EQ(0u, scanner.nextBatch());
+}
+
+}  // namespace RAMCloud
@@ -15,6 +15,7 @@
 
 #include "CoordinatorClient.h"
 #include "CoordinatorSession.h"
+#include "FlatTableConfig.h"
 #include "ShortMacros.h"
 #include "ProtoBuf.h"
 
@@ -44,16 +45,20 @@ namespace RAMCloud {
  * \param readSpeed
  *      Read speed of the backup in MB/s if serviceMask includes BACKUP,
  *      otherwise ignored.
+ * \param fromSnapshot
+ *      True means this server is a master that has a snapshot of the log of
+ *      \a replacesId (see MasterSnapshot), so the coordinator should use it
+ *      to recover that server's data.
  * \return
  *      A ServerId guaranteed never to have been used before.
  */
 ServerId
 CoordinatorClient::enlistServer(Context* context, uint32_t preferredIndex,
         ServerId replacesId, ServiceMask serviceMask,
-        string localServiceLocator, uint32_t readSpeed)
+        string localServiceLocator, uint32_t readSpeed, bool fromSnapshot)
 {
     EnlistServerRpc rpc(context, preferredIndex, replacesId,
-            serviceMask, localServiceLocator, readSpeed);
+            serviceMask, localServiceLocator, readSpeed, fromSnapshot);
     return rpc.wait();
 }
 
@@ -82,12 +87,16 @@ CoordinatorClient::enlistServer(Context* context, uint32_t preferredIndex,
  * \param readSpeed
  *      Read speed of the backup in MB/s if serviceMask includes BACKUP,
  *      otherwise ignored.
+ * \param fromSnapshot
+ *      True means this server is a master that has a snapshot of the log of
+ *      \a replacesId (see MasterSnapshot), so the coordinator should use it
+ *      to recover that server's data.
  * \return
  *      A ServerId guaranteed never to have been used before.
  */
 EnlistServerRpc::EnlistServerRpc(Context* context, uint32_t preferredIndex,
         ServerId replacesId, ServiceMask serviceMask,
-        string localServiceLocator, uint32_t readSpeed)
+        string localServiceLocator, uint32_t readSpeed, bool fromSnapshot)
     : CoordinatorRpcWrapper(context,
             sizeof(WireFormat::EnlistServer::Response))
 {
@@ -97,6 +106,7 @@ EnlistServerRpc::EnlistServerRpc(Context* context, uint32_t preferredIndex,
     reqHdr->replacesId = replacesId.getId();
     reqHdr->serviceMask = serviceMask.serialize();
     reqHdr->readSpeed = readSpeed;
+    reqHdr->fromSnapshot = fromSnapshot;
     reqHdr->serviceLocatorLength =
         downCast<uint32_t>(localServiceLocator.length() + 1);
     request.append(localServiceLocator.c_str(),
@@ -387,12 +397,19 @@ GetServerListRpc::wait(ProtoBuf::ServerList* serverList)
  *      Will be filled in with location of every tablet and index in
  *      the table. If the table does not exist, then the result
  *      will contain no tablets and indexes.
+ * \param startKeyHash
+ *      If this and endKeyHash don't cover all key hashes, then only
+ *      the tablets overlapping startKeyHash..endKeyHash (inclusive) are
+ *      returned, and no indexes.
+ * \param endKeyHash
+ *      See startKeyHash.
  */
 void
 CoordinatorClient::getTableConfig(Context* context,
-        uint64_t tableId, ProtoBuf::TableConfig* tableConfig)
+        uint64_t tableId, ProtoBuf::TableConfig* tableConfig,
+        uint64_t startKeyHash, uint64_t endKeyHash)
 {
-    GetTableConfigRpc rpc(context, tableId);
+    GetTableConfigRpc rpc(context, tableId, startKeyHash, endKeyHash);
     rpc.wait(tableConfig);
 }
 
@@ -405,14 +422,23 @@ CoordinatorClient::getTableConfig(Context* context,
  *      Overall information about this RAMCloud server or client.
  * \param tableId
  *      The id of a table whose tablet configuration is to be fetched.
- */
-GetTableConfigRpc::GetTableConfigRpc(Context* context, uint64_t tableId)
+ * \param startKeyHash
+ *      If this and endKeyHash don't cover all key hashes, then only
+ *      the tablets overlapping startKeyHash..endKeyHash (inclusive) are
+ *      returned, and no indexes.
+ * \param endKeyHash
+ *      See startKeyHash.
+ */
+GetTableConfigRpc::GetTableConfigRpc(Context* context, uint64_t tableId,
+        uint64_t startKeyHash, uint64_t endKeyHash)
     : CoordinatorRpcWrapper(context,
-            sizeof(WireFormat::GetTableConfig::Response))
+            sizeof(WireFormat::GetTableConfig::Response), NULL, true)
 {
     WireFormat::GetTableConfig::Request* reqHdr(
             allocHeader<WireFormat::GetTableConfig>());
     reqHdr->tableId = tableId;
+    reqHdr->startKeyHash = startKeyHash;
+    reqHdr->endKeyHash = endKeyHash;
     send();
 }
 
@@ -428,14 +454,31 @@ GetTableConfigRpc::GetTableConfigRpc(Context* context, uint64_t tableId)
  */
 void
 GetTableConfigRpc::wait(ProtoBuf::TableConfig* tableConfig)
+{
+    FlatTableConfig config;
+    wait(&config);
+    config.toProtoBuf(tableConfig);
+}
+
+/**
+ * Wait for a getTableConfig RPC to complete, and make a FlatTableConfig
+ * refer to the result in place (this avoids copying the configuration).
+ *
+ * \param[out] tableConfig
+ *      Will refer to the location of every tablet and index in the table
+ *      given by tableId argument passed to the constructor. It is valid
+ *      only as long as this RPC object.
+ */
+void
+GetTableConfigRpc::wait(FlatTableConfig* tableConfig)
 {
     waitInternal(context->dispatch);
     const WireFormat::GetTableConfig::Response* respHdr(
             getResponseHeader<WireFormat::GetTableConfig>());
     if (respHdr->common.status != STATUS_OK)
         ClientException::throwException(HERE, respHdr->common.status);
-    ProtoBuf::parseFromResponse(response, sizeof(*respHdr),
-                                respHdr->tableConfigLength, tableConfig);
+    tableConfig->parse(response, sizeof(*respHdr),
+            respHdr->tableConfigLength);
 }
 
 /**
@@ -576,6 +619,12 @@ ReassignTabletOwnershipRpc::ReassignTabletOwnershipRpc(Context* context,
  *      in recovering its partition of the crashed master. If false the
  *      coordinator will not assign ownership to this master and this master
  *      can clean up any state resulting attempting recovery.
+ * \param partial
+ *      If true, \a recoveryPartition holds only some of the tablets of this
+ *      master's partition, which it has finished recovering and would like
+ *      to start serving while it recovers the rest; a final call without
+ *      \a partial will follow for the remaining tablets. Requires
+ *      \a successful.
  * \return
  *      True if the recovery master should begin servicing requests. False
  *      if the recovery master should abort recovery and discard replayed
@@ -585,10 +634,10 @@ bool
 CoordinatorClient::recoveryMasterFinished(Context* context, uint64_t recoveryId,
         ServerId recoveryMasterId,
         const ProtoBuf::RecoveryPartition* recoveryPartition,
-        bool successful)
+        bool successful, bool partial)
 {
     RecoveryMasterFinishedRpc rpc(context, recoveryId, recoveryMasterId,
-            recoveryPartition, successful);
+            recoveryPartition, successful, partial);
     return rpc.wait();
 }
 
@@ -612,10 +661,17 @@ CoordinatorClient::recoveryMasterFinished(Context* context, uint64_t recoveryId,
  *      in recovering its partition of the crashed master. If false the
  *      coordinator will not assign ownership to this master and this master
  *      can clean up any state resulting attempting recovery.
+ * \param partial
+ *      If true, \a recoveryPartition holds only some of the tablets of this
+ *      master's partition, which it has finished recovering and would like
+ *      to start serving while it recovers the rest; a final call without
+ *      \a partial will follow for the remaining tablets. Requires
+ *      \a successful.
  */
 RecoveryMasterFinishedRpc::RecoveryMasterFinishedRpc(Context* context,
         uint64_t recoveryId, ServerId recoveryMasterId,
-        const ProtoBuf::RecoveryPartition* recoveryPartition, bool successful)
+        const ProtoBuf::RecoveryPartition* recoveryPartition, bool successful,
+        bool partial)
     : CoordinatorRpcWrapper(context,
             sizeof(WireFormat::RecoveryMasterFinished::Response))
 {
@@ -625,6 +681,7 @@ RecoveryMasterFinishedRpc::RecoveryMasterFinishedRpc(Context* context,
     reqHdr->recoveryMasterId = recoveryMasterId.getId();
     reqHdr->tabletsLength = serializeToRequest(&request, recoveryPartition);
     reqHdr->successful = successful;
+    reqHdr->partial = partial;
     send();
 }
 
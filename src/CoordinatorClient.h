@@ -29,6 +29,8 @@
 
 namespace RAMCloud {
 
+class FlatTableConfig;
+
 /**
  * This class implements RPC requests that are sent to the cluster
  * coordinator but are not implemented in the RamCloud class. The class
@@ -39,7 +41,8 @@ class CoordinatorClient {
   public:
     static ServerId enlistServer(Context* context, uint32_t preferredIndex,
             ServerId replacesId, ServiceMask serviceMask,
-            string localServiceLocator, uint32_t readSpeed);
+            string localServiceLocator, uint32_t readSpeed,
+            bool fromSnapshot = false);
     static void getBackupConfig(Context* context,
             ProtoBuf::ServerConfig_Backup& config);
     static void getBackupList(Context* context,
@@ -53,7 +56,8 @@ class CoordinatorClient {
     static void getServerList(Context* context,
             ProtoBuf::ServerList* serverList);
     static void getTableConfig(Context* context,
-            uint64_t tableId, ProtoBuf::TableConfig* tableConfig);
+            uint64_t tableId, ProtoBuf::TableConfig* tableConfig,
+            uint64_t startKeyHash = 0, uint64_t endKeyHash = ~0lu);
     static void hintServerCrashed(Context* context, ServerId serverId);
     static void reassignTabletOwnership(Context* context, uint64_t tableId,
             uint64_t firstKey, uint64_t lastKey, ServerId newOwnerId,
@@ -61,7 +65,7 @@ class CoordinatorClient {
     static bool recoveryMasterFinished(Context* context, uint64_t recoveryId,
             ServerId recoveryMasterId,
             const ProtoBuf::RecoveryPartition* recoveryPartition,
-            bool successful);
+            bool successful, bool partial = false);
     static WireFormat::ClientLease renewLease(Context* context,
             uint64_t leaseId);
     static void sendServerList(Context* context, ServerId destination);
@@ -82,7 +86,8 @@ class EnlistServerRpc : public CoordinatorRpcWrapper {
     public:
     EnlistServerRpc(Context* context, uint32_t preferredIndex,
             ServerId replacesId, ServiceMask serviceMask,
-            string localServiceLocator, uint32_t readSpeed);
+            string localServiceLocator, uint32_t readSpeed,
+            bool fromSnapshot = false);
     ~EnlistServerRpc() {}
     ServerId wait();
 
@@ -152,9 +157,11 @@ class GetServerListRpc : public CoordinatorRpcWrapper {
  */
 class GetTableConfigRpc : public CoordinatorRpcWrapper {
     public:
-    explicit GetTableConfigRpc(Context* context, uint64_t tableId);
+    explicit GetTableConfigRpc(Context* context, uint64_t tableId,
+            uint64_t startKeyHash = 0, uint64_t endKeyHash = ~0lu);
     ~GetTableConfigRpc() {}
     void wait(ProtoBuf::TableConfig* tableConfig);
+    void wait(FlatTableConfig* tableConfig);
 
     PRIVATE:
     DISALLOW_COPY_AND_ASSIGN(GetTableConfigRpc);
@@ -201,7 +208,7 @@ class RecoveryMasterFinishedRpc : public CoordinatorRpcWrapper {
     RecoveryMasterFinishedRpc(Context* context, uint64_t recoveryId,
             ServerId recoveryMasterId,
             const ProtoBuf::RecoveryPartition* recoveryPartition,
-            bool successful);
+            bool successful, bool partial = false);
     ~RecoveryMasterFinishedRpc() {}
     bool wait();
 
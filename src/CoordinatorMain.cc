@@ -16,6 +16,7 @@
 #include "Common.h"
 #include "ShortMacros.h"
 #include "CoordinatorService.h"
+#include "CoordinatorReplicaService.h"
 #include "ExternalStorage.h"
 #include "MemoryMonitor.h"
 #include "MockExternalStorage.h"
@@ -23,6 +24,7 @@
 #include "PingService.h"
 #include "PortAlarm.h"
 #include "ServerId.h"
+#include "SnapshotStorage.h"
 #include "TableManager.h"
 #include "TransportManager.h"
 #include "WorkerManager.h"
@@ -54,6 +56,10 @@ main(int argc, char *argv[])
     uint32_t maxCores;
     bool reset;
     bool neverKill;
+    bool readReplica;
+    uint32_t replicaRefreshMs;
+    bool snapshots;
+    uint32_t standbyRefreshMs;
     Context context(true);
     CoordinatorServerList serverList(&context);
     try {
@@ -80,11 +86,34 @@ main(int argc, char *argv[])
              ProgramOptions::bool_switch(&neverKill),
              "If specified, the coordinator will never attempt to kill any "
              "master or remove it from the server list.")
+            ("readReplica",
+             ProgramOptions::bool_switch(&readReplica),
+             "If specified, run as a read replica of the coordinator rather "
+             "than as a coordinator: follow the table metadata on external "
+             "storage and serve clients' requests for table configurations, "
+             "to take load off of the coordinator.")
+            ("replicaRefreshMs",
+             ProgramOptions::value<uint32_t>(&replicaRefreshMs)->
+                default_value(100),
+             "When running as a read replica, how often (in milliseconds) "
+             "to reread table metadata from external storage.")
             ("reset",
              ProgramOptions::bool_switch(&reset),
              "If specified, the coordinator will not attempt to recover "
              "any existing cluster state; it will start a new cluster "
-             "from scratch.");
+             "from scratch.")
+            ("snapshots",
+             ProgramOptions::bool_switch(&snapshots),
+             "If specified, keep compact snapshots of the table and server "
+             "metadata on external storage, and keep a copy of them in "
+             "memory while waiting to become leader, so that this "
+             "coordinator can take over quickly after the leader crashes.")
+            ("standbyRefreshMs",
+             ProgramOptions::value<uint32_t>(&standbyRefreshMs)->
+                default_value(100),
+             "With --snapshots, how often (in milliseconds) to reread the "
+             "snapshot from external storage while waiting to become "
+             "leader.");
 
         OptionParser optionParser(coordinatorOptions, argc, argv);
 
@@ -126,6 +155,9 @@ main(int argc, char *argv[])
             // save any information to allow recovery if we crash).
             context.externalStorage = new MockExternalStorage(false);
         }
+        if (reset && readReplica) {
+            throw FatalError(HERE, "--reset can't be used with --readReplica");
+        }
         string workspace("/ramcloud/");
 
         string clusterName = optionParser.options.getClusterName();
@@ -139,6 +171,19 @@ main(int argc, char *argv[])
         LOG(NOTICE, "Cluster name is '%s', external storage workspace is '%s'",
                 clusterName.c_str(), workspace.c_str());
         context.externalStorage->setWorkspace(workspace.c_str());
+        if (readReplica) {
+            CoordinatorReplicaService replicaService(&context,
+                    replicaRefreshMs);
+            PingService pingService(&context);
+            while (true) {
+                context.dispatch->poll();
+            }
+        }
+        if (snapshots) {
+            context.externalStorage = new SnapshotStorage(
+                    context.externalStorage, {"tables", "servers"},
+                    standbyRefreshMs);
+        }
         context.externalStorage->becomeLeader("coordinator", localLocator);
 
         MemoryMonitor monitor(context.dispatch, 1.0, 10);
@@ -0,0 +1,196 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#include "CoordinatorReplicaService.h"
+#include "CoordinatorSession.h"
+#include "Cycles.h"
+#include "ExternalStorage.h"
+#include "ProtoBuf.h"
+#include "ShortMacros.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct a CoordinatorReplicaService. The replica reads the current
+ * table metadata from external storage before returning.
+ *
+ * \param context
+ *      Overall information about the RAMCloud server. The new service
+ *      will be registered in this context as the coordinator service; its
+ *      externalStorage must refer to the same workspace as the
+ *      coordinator's.
+ * \param refreshIntervalMs
+ *      How often to reread table metadata from external storage, in
+ *      milliseconds; this bounds how far the replica lags the coordinator.
+ * \param unitTesting
+ *      True means don't refresh in the background or advertise the replica
+ *      on external storage; used only during unit tests.
+ */
+CoordinatorReplicaService::CoordinatorReplicaService(Context* context,
+        uint32_t refreshIntervalMs, bool unitTesting)
+    : context(context)
+    , mutex()
+    , tableManager(context, NULL)
+    , indexedTables()
+    , refresher()
+{
+    context->services[WireFormat::COORDINATOR_SERVICE] = this;
+    refresh();
+    if (unitTesting)
+        return;
+
+    // Advertise ourselves, so that clients will start sending reads here.
+    string locator = context->transportManager->getListeningLocatorsString();
+    string name(locator);
+    std::replace(name.begin(), name.end(), '/', '_');
+    name = format("%s/%s", CoordinatorSession::REPLICAS_NODE, name.c_str());
+    context->externalStorage->set(ExternalStorage::UPDATE, name.c_str(),
+            locator.c_str());
+    LOG(NOTICE, "Coordinator read replica listening on %s",
+            locator.c_str());
+    refresher.construct(this, refreshIntervalMs);
+    refresher->start(0);
+}
+
+CoordinatorReplicaService::~CoordinatorReplicaService()
+{
+    refresher.destroy();
+    context->services[WireFormat::COORDINATOR_SERVICE] = NULL;
+}
+
+/**
+ * Dispatch an RPC to the right handler based on its opcode. Only
+ * GET_TABLE_CONFIG is handled; everything else must go to the coordinator.
+ */
+void
+CoordinatorReplicaService::dispatch(WireFormat::Opcode opcode, Rpc* rpc)
+{
+    switch (opcode) {
+        case WireFormat::GetTableConfig::opcode:
+            callHandler<WireFormat::GetTableConfig, CoordinatorReplicaService,
+                        &CoordinatorReplicaService::getTableConfig>(rpc);
+            break;
+        default:
+            throw UnimplementedRequestError(HERE);
+    }
+}
+
+/**
+ * Handle the GET_TABLE_CONFIG RPC; the response is the same as the
+ * coordinator's, except that requests the replica can't answer correctly
+ * are rejected with STATUS_UNIMPLEMENTED_REQUEST.
+ * \copydetails Service::ping
+ */
+void
+CoordinatorReplicaService::getTableConfig(
+        const WireFormat::GetTableConfig::Request* reqHdr,
+        WireFormat::GetTableConfig::Response* respHdr,
+        Rpc* rpc)
+{
+    Lock lock(mutex);
+
+    // Requests covering the whole table also return its indexes, which
+    // only the coordinator knows about.
+    bool wholeTable = (reqHdr->startKeyHash == 0)
+            && (reqHdr->endKeyHash == ~0lu);
+    if (wholeTable && indexedTables.count(reqHdr->tableId) != 0) {
+        respHdr->common.status = STATUS_UNIMPLEMENTED_REQUEST;
+        return;
+    }
+
+    // A table we don't know about may have been created since our last
+    // refresh; only the coordinator can tell for sure.
+    FlatTableConfig::Builder builder;
+    tableManager.serializeTableConfig(&builder, reqHdr->tableId,
+            reqHdr->startKeyHash, reqHdr->endKeyHash);
+    if (builder.getTabletCount() == 0) {
+        respHdr->common.status = STATUS_UNIMPLEMENTED_REQUEST;
+        return;
+    }
+    respHdr->tableConfigLength = builder.serialize(rpc->replyPayload);
+}
+
+/**
+ * Replace our copy of the table metadata with the current contents of
+ * external storage.
+ */
+void
+CoordinatorReplicaService::refresh()
+{
+    vector<ExternalStorage::Object> objects;
+    context->externalStorage->getChildren("tables", &objects);
+
+    vector<ProtoBuf::Table> tables;
+    std::set<uint64_t> indexed;
+    foreach (ExternalStorage::Object& object, objects) {
+        if (object.value == NULL)
+            continue;
+        tables.emplace_back();
+        ProtoBuf::Table& info = tables.back();
+        string str(object.value, object.length);
+        if (!info.ParseFromString(str)) {
+            // The coordinator may be in the middle of rewriting the object;
+            // we'll pick up the table on the next refresh.
+            LOG(WARNING, "Couldn't parse protocol buffer in /tables/%s",
+                    object.name);
+            tables.pop_back();
+            continue;
+        }
+
+        // Each indexlet is stored in a backing table whose name identifies
+        // the indexed table (see TableManager::createIndex).
+        const char* prefix = "__backingTable:";
+        const string& name = info.name();
+        if (!info.has_deleted() && name.compare(0, strlen(prefix), prefix) == 0)
+            indexed.insert(strtoul(name.c_str() + strlen(prefix), NULL, 10));
+    }
+
+    Lock lock(mutex);
+    tableManager.reload(&tables);
+    indexedTables.swap(indexed);
+}
+
+/**
+ * Constructor for Refresher.
+ *
+ * \param service
+ *      Replica whose metadata will be refreshed.
+ * \param refreshIntervalMs
+ *      How often to refresh, in milliseconds.
+ */
+CoordinatorReplicaService::Refresher::Refresher(
+        CoordinatorReplicaService* service, uint32_t refreshIntervalMs)
+    : WorkerTimer(service->context->dispatch)
+    , service(service)
+    , intervalTicks(Cycles::fromNanoseconds(refreshIntervalMs * 1000000lu))
+{
+}
+
+/**
+ * This method is invoked by the WorkerTimer mechanism; it refreshes the
+ * replica's metadata and reschedules itself.
+ */
+void
+CoordinatorReplicaService::Refresher::handleTimerEvent()
+{
+    service->refresh();
+    start(Cycles::rdtsc() + intervalTicks);
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,107 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_COORDINATORREPLICASERVICE_H
+#define RAMCLOUD_COORDINATORREPLICASERVICE_H
+
+#include <mutex>
+#include <set>
+
+#include "Common.h"
+#include "Service.h"
+#include "TableManager.h"
+#include "Tub.h"
+#include "WorkerTimer.h"
+
+namespace RAMCloud {
+
+/**
+ * A read replica of the coordinator. Replicas take load off of the
+ * coordinator by answering GET_TABLE_CONFIG requests, which clients issue
+ * every time they start up and every time they find that their tablet map
+ * is out of date. A replica never modifies any cluster state: it follows
+ * the table metadata that the coordinator keeps on external storage,
+ * rereading it at regular intervals, and it advertises itself on external
+ * storage so that clients can find it (see
+ * CoordinatorSession::getReadSession).
+ *
+ * Because a replica's information may lag the coordinator's, replicas
+ * only answer requests that they know they can answer correctly; anything
+ * else (unknown tables, index configurations, which aren't kept on
+ * external storage, and all other coordinator RPCs) is rejected with
+ * STATUS_UNIMPLEMENTED_REQUEST, which causes clients to send the request
+ * to the coordinator instead. Clients already cope with out-of-date tablet
+ * information (masters reject requests for tablets they don't own), so
+ * the lag only costs a few extra retries after tablets move.
+ */
+class CoordinatorReplicaService : public Service {
+  public:
+    CoordinatorReplicaService(Context* context, uint32_t refreshIntervalMs,
+            bool unitTesting = false);
+    ~CoordinatorReplicaService();
+    void dispatch(WireFormat::Opcode opcode, Rpc* rpc);
+
+  PRIVATE:
+    /**
+     * Rereads table metadata from external storage at regular intervals.
+     */
+    class Refresher : public WorkerTimer {
+      public:
+        Refresher(CoordinatorReplicaService* service,
+                uint32_t refreshIntervalMs);
+        ~Refresher() {}
+        void handleTimerEvent();
+
+        /// The replica whose metadata is refreshed.
+        CoordinatorReplicaService* service;
+
+        /// How often to refresh, in rdtsc ticks.
+        uint64_t intervalTicks;
+
+      PRIVATE:
+        DISALLOW_COPY_AND_ASSIGN(Refresher);
+    };
+
+    void getTableConfig(const WireFormat::GetTableConfig::Request* reqHdr,
+            WireFormat::GetTableConfig::Response* respHdr,
+            Rpc* rpc);
+    void refresh();
+
+    /// Shared RAMCloud information.
+    Context* context;
+
+    /// Serializes refreshes with each other and with requests, so that
+    /// #indexedTables always describes the tables in #tableManager.
+    std::mutex mutex;
+    typedef std::unique_lock<std::mutex> Lock;
+
+    /// Copy of the coordinator's table metadata, as of the most recent
+    /// refresh.
+    TableManager tableManager;
+
+    /// Identifiers of tables that have at least one index. Indexes aren't
+    /// recorded on external storage, so requests for the complete
+    /// configuration of these tables must go to the coordinator.
+    std::set<uint64_t> indexedTables;
+
+    /// Triggers refreshes; empty during unit tests.
+    Tub<Refresher> refresher;
+
+    DISALLOW_COPY_AND_ASSIGN(CoordinatorReplicaService);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_COORDINATORREPLICASERVICE_H
@@ -0,0 +1,149 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "BindTransport.h"
+#include "CoordinatorClient.h"
+#include "CoordinatorReplicaService.h"
+#include "CoordinatorSession.h"
+#include "MockExternalStorage.h"
+
+namespace RAMCloud {
+
+class CoordinatorReplicaServiceTest : public ::testing::Test {
+  public:
+    TestLog::Enable logEnabler;
+    Context context;
+    MockExternalStorage storage;
+    BindTransport transport;
+    TransportManager::MockRegistrar mockRegistrar;
+    Tub<CoordinatorReplicaService> replica;
+
+    CoordinatorReplicaServiceTest()
+        : logEnabler()
+        , context()
+        , storage(false)
+        , transport(&context)
+        , mockRegistrar(&context, transport)
+        , replica()
+    {
+        context.externalStorage = &storage;
+        context.coordinatorSession->setLocation("mock:host=replica");
+    }
+
+    /**
+     * Queue up the metadata for a table, with a single tablet, to be
+     * returned by the replica's next read from external storage.
+     */
+    void
+    addTable(const char* name, uint64_t id, uint64_t serverId,
+            bool deleted = false)
+    {
+        ProtoBuf::Table info;
+        info.set_name(name);
+        info.set_id(id);
+        info.set_sequence_number(1);
+        if (deleted)
+            info.set_deleted(true);
+        ProtoBuf::Table::Tablet* tablet = info.add_tablet();
+        tablet->set_start_key_hash(0);
+        tablet->set_end_key_hash(~0lu);
+        tablet->set_state(ProtoBuf::Table::Tablet::NORMAL);
+        tablet->set_server_id(serverId);
+        tablet->set_ctime_log_head_id(0);
+        tablet->set_ctime_log_head_offset(0);
+        string str;
+        info.SerializeToString(&str);
+        storage.getChildrenNames.push(name);
+        storage.getChildrenValues.push(str);
+    }
+
+    void
+    startReplica()
+    {
+        replica.construct(&context, 100, true);
+        transport.registerServer(&context, "mock:host=replica");
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(CoordinatorReplicaServiceTest);
+};
+
+TEST_F(CoordinatorReplicaServiceTest, getTableConfig) {
+    addTable("foo", 1, 3);
+    startReplica();
+    ProtoBuf::TableConfig config;
+    CoordinatorClient::getTableConfig(&context, 1, &config);
+    ASSERT_EQ(1, config.tablet_size());
+    EXPECT_EQ(3u, config.tablet(0).server_id());
+    EXPECT_EQ(0, config.index_size());
+}
+
+TEST_F(CoordinatorReplicaServiceTest, getTableConfig_unknownTable) {
+    addTable("foo", 1, 3);
+    startReplica();
+    ProtoBuf::TableConfig config;
+    // There's no coordinator behind the replica in this test, so the
+    // rejection comes back to the caller.
+    EXPECT_THROW(CoordinatorClient::getTableConfig(&context, 2, &config),
+            UnimplementedRequestError);
+}
+
+TEST_F(CoordinatorReplicaServiceTest, getTableConfig_indexedTable) {
+    addTable("foo", 1, 3);
+    addTable("__backingTable:1:1:0", 2, 4);
+    startReplica();
+    ProtoBuf::TableConfig config;
+    EXPECT_THROW(CoordinatorClient::getTableConfig(&context, 1, &config),
+            UnimplementedRequestError);
+
+    // Requests for part of the table don't involve indexes.
+    CoordinatorClient::getTableConfig(&context, 1, &config, 0, 100);
+    ASSERT_EQ(1, config.tablet_size());
+    EXPECT_EQ(3u, config.tablet(0).server_id());
+}
+
+TEST_F(CoordinatorReplicaServiceTest, dispatch_otherRequests) {
+    startReplica();
+    ProtoBuf::ServerList serverList;
+    EXPECT_THROW(CoordinatorClient::getServerList(&context, &serverList),
+            UnimplementedRequestError);
+}
+
+TEST_F(CoordinatorReplicaServiceTest, refresh) {
+    addTable("foo", 1, 3);
+    addTable("__backingTable:1:1:0", 2, 4);
+    startReplica();
+    EXPECT_EQ(1u, replica->indexedTables.count(1));
+
+    addTable("foo", 1, 5);
+    addTable("__backingTable:1:1:0", 2, 4, true);
+    addTable("bar", 3, 4);
+    replica->refresh();
+    EXPECT_EQ(0u, replica->indexedTables.size());
+    EXPECT_EQ("{ foo(id 1): { 0x0-0xffffffffffffffff on 5.0 } } "
+            "{ bar(id 3): { 0x0-0xffffffffffffffff on 4.0 } }",
+            replica->tableManager.debugString(true));
+}
+
+TEST_F(CoordinatorReplicaServiceTest, refresh_badProtoBuf) {
+    TestLog::Enable _("refresh");
+    storage.getChildrenNames.push("foo");
+    storage.getChildrenValues.push("garbage");
+    startReplica();
+    EXPECT_EQ("refresh: Couldn't parse protocol buffer in /tables/foo",
+            TestLog::get());
+}
+
+}  // namespace RAMCloud
@@ -34,20 +34,48 @@ namespace RAMCloud {
  *      Optional client-supplied buffer to use for the RPC's response;
  *      if NULL then we use a built-in buffer. Any existing contents
  *      of this buffer will be cleared automatically by the transport.
+ * \param readOnly
+ *      True means the request doesn't modify any coordinator state and
+ *      coordinator read replicas know how to handle it, so it may be sent
+ *      to a replica instead of the coordinator.
  */
 CoordinatorRpcWrapper::CoordinatorRpcWrapper(Context* context,
-        uint32_t responseHeaderLength, Buffer* response)
+        uint32_t responseHeaderLength, Buffer* response, bool readOnly)
     : RpcWrapper(responseHeaderLength, response)
     , context(context)
+    , useReadReplica(readOnly)
 {
 }
 
+// See RpcWrapper for documentation.
+bool
+CoordinatorRpcWrapper::checkStatus()
+{
+    if (useReadReplica
+            && responseHeader->status == STATUS_UNIMPLEMENTED_REQUEST) {
+        // The read replica couldn't handle the request (e.g., its
+        // information is out of date); only the coordinator can.
+        useReadReplica = false;
+        send();
+        return false;
+    }
+    return true;
+}
+
 // See RpcWrapper for documentation.
 bool
 CoordinatorRpcWrapper::handleTransportError()
 {
     // There was a transport-level failure. The transport should already
-    // have logged this. All we have to do is retry.
+    // have logged this. All we have to do is retry. If the request was
+    // sent to a read replica, send the retry to the coordinator: the
+    // replica may be gone, and the coordinator is always an option.
+    // (The read session may also have been the coordinator session, so
+    // flush both.)
+    if (useReadReplica) {
+        context->coordinatorSession->flushReadSession();
+        useReadReplica = false;
+    }
     context->coordinatorSession->flush();
     send();
     return false;
@@ -57,9 +85,13 @@ CoordinatorRpcWrapper::handleTransportError()
 void
 CoordinatorRpcWrapper::send()
 {
-    session = context->coordinatorSession->getSession();
+    if (useReadReplica) {
+        session = context->coordinatorSession->getReadSession();
+    } else {
+        session = context->coordinatorSession->getSession();
+    }
     state = IN_PROGRESS;
-    session->sendRequest(&request, response, this);
+    sendRequest();
 }
 
 } // namespace RAMCloud
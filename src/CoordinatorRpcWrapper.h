@@ -31,7 +31,7 @@ class CoordinatorRpcWrapper : public RpcWrapper {
   public:
     explicit CoordinatorRpcWrapper(Context* context,
             uint32_t responseHeaderLength,
-            Buffer* response = NULL);
+            Buffer* response = NULL, bool readOnly = false);
 
     /**
      * Destructor for CoordinatorRpcWrapper.
@@ -39,12 +39,19 @@ class CoordinatorRpcWrapper : public RpcWrapper {
     virtual ~CoordinatorRpcWrapper() {}
 
   PROTECTED:
+    virtual bool checkStatus();
     virtual bool handleTransportError();
     virtual void send();
 
     /// Shared RAMCloud information.
     Context* context;
 
+    /// True means the request is being sent to a coordinator read replica
+    /// (if there are any; see CoordinatorSession::getReadSession). This
+    /// becomes false if the replica can't handle the request, and the
+    /// request is then sent to the coordinator.
+    bool useReadReplica;
+
     DISALLOW_COPY_AND_ASSIGN(CoordinatorRpcWrapper);
 };
 
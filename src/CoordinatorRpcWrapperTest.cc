@@ -41,6 +41,36 @@ class CoordinatorRpcWrapperTest : public ::testing::Test {
     DISALLOW_COPY_AND_ASSIGN(CoordinatorRpcWrapperTest);
 };
 
+TEST_F(CoordinatorRpcWrapperTest, checkStatus_readReplicaCantHandle) {
+    CoordinatorRpcWrapper wrapper(&context, 4, NULL, true);
+    wrapper.request.fillFromString("100");
+    wrapper.send();
+    wrapper.response->fillFromString("8");
+    wrapper.completed();
+    EXPECT_FALSE(wrapper.isReady());
+    EXPECT_FALSE(wrapper.useReadReplica);
+    EXPECT_STREQ("IN_PROGRESS", wrapper.stateString());
+
+    // The coordinator's response is final.
+    wrapper.response->reset();
+    wrapper.response->fillFromString("8");
+    wrapper.completed();
+    EXPECT_TRUE(wrapper.isReady());
+    EXPECT_EQ(STATUS_UNIMPLEMENTED_REQUEST, wrapper.responseHeader->status);
+}
+
+TEST_F(CoordinatorRpcWrapperTest, handleTransportError_readReplica) {
+    TestLog::Enable _("flush", "flushReadSession", NULL);
+    CoordinatorRpcWrapper wrapper(&context, 4, NULL, true);
+    wrapper.request.fillFromString("100");
+    wrapper.send();
+    wrapper.state = RpcWrapper::RpcState::FAILED;
+    EXPECT_FALSE(wrapper.isReady());
+    EXPECT_FALSE(wrapper.useReadReplica);
+    EXPECT_EQ("flushReadSession: flushing read session | "
+            "flush: flushing session", TestLog::get());
+}
+
 TEST_F(CoordinatorRpcWrapperTest, handleTransportError) {
     TestLog::Enable _("flush");
     CoordinatorRpcWrapper wrapper(&context, 4);
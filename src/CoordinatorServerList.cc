@@ -249,6 +249,10 @@ CoordinatorServerList::recover(uint64_t lastCompletedUpdate)
     vector<ExternalStorage::Object> objects;
     context->externalStorage->getChildren("servers", &objects);
 
+    // Entries that must be rewritten to external storage; they are
+    // written together once all of the entries have been processed.
+    vector<ExternalStorage::Write> writes;
+
     // Each iteration through the following loop processes information
     // for one entry in the server list.
     foreach (ExternalStorage::Object& object, objects) {
@@ -363,9 +367,11 @@ CoordinatorServerList::recover(uint64_t lastCompletedUpdate)
             // of the new sequence numbers for updates (otherwise, another
             // coordinator crash before the updates are completed could
             // cause the updates never to be finished).
-            entry->sync(context->externalStorage);
+            writes.push_back(entry->getExternalWrite());
         }
     }
+    if (!writes.empty())
+        context->externalStorage->setMulti(writes);
 
     // Repair inconsistencies in the replication groups.
     repairReplicationGroups(lock);
@@ -430,6 +436,7 @@ CoordinatorServerList::recoveryCompleted(ServerId serverId)
     LOG(NOTICE, "Removing server %s from cluster/coordinator server list",
         serverId.toString().c_str());
     entry->status = ServerStatus::REMOVE;
+    sessionCache.erase(serverId);
     persistAndPropagate(lock, entry, ServerChangeEvent::SERVER_REMOVED);
 }
 
@@ -486,6 +493,7 @@ CoordinatorServerList::serverCrashed(ServerId serverId)
     if (entry->isBackup())
         numberOfBackups--;
     entry->status = ServerStatus::CRASHED;
+    sessionCache.erase(serverId);
 
     // Be sure to update replication groups before marking server crashed;
     // otherwise, the replication group updates could get lost if we crash
@@ -655,28 +663,60 @@ void
 CoordinatorServerList::persistAndPropagate(const Lock& lock, Entry* entry,
         ServerChangeEvent event)
 {
-    TEST_LOG("Persisting %s", entry->serverId.toString().c_str());
+    persistAndPropagate(lock, vector<Entry*>{entry}, event);
+}
 
-    // Add a new update to the list of those in progress for this entry,
-    // then write the entire entry to external storage to ensure that cluster
-    // notification completes eventually, even in the presence of
+/**
+ * Same as the method above, except that it handles several entries that
+ * changed together. The entries are written to external storage with a
+ * single ExternalStorage::setMulti call, which is much faster than
+ * writing them one at a time when the storage system supports
+ * multi-object transactions.
+ *
+ * \param lock
+ *      Make sure caller has acquired CoordinatorServerList lock.
+ *      Not explicitly used.
+ * \param entries
+ *      The entries that were just created or modified. Each will be
+ *      given its own server list version, in order.
+ * \param event
+ *      Indicates the nature of these changes; used when notifying
+ *      ServerTrackers.
+ */
+void
+CoordinatorServerList::persistAndPropagate(const Lock& lock,
+        const vector<Entry*>& entries, ServerChangeEvent event)
+{
+    // Add a new update to the list of those in progress for each entry,
+    // then write the entire entries to external storage to ensure that
+    // cluster notification completes eventually, even in the presence of
     // coordinator crashes.
-    entry->pendingUpdates.emplace_back();
-    ProtoBuf::ServerListEntry_Update* update = &entry->pendingUpdates.back();
-    update->set_status(uint32_t(entry->status));
-    update->set_version(version + 1);
-    update->set_sequence_number(context->getCoordinatorService()
-            ->updateManager.nextSequenceNumber());
-    entry->sync(context->externalStorage);
-
-    // Notify local ServerTrackers about the change.
-    foreach (ServerTrackerInterface* tracker, trackers)
-        tracker->enqueueChange(*entry, event);
+    vector<ExternalStorage::Write> writes;
+    uint64_t nextVersion = version;
+    foreach (Entry* entry, entries) {
+        TEST_LOG("Persisting %s", entry->serverId.toString().c_str());
+        entry->pendingUpdates.emplace_back();
+        ProtoBuf::ServerListEntry_Update* update =
+                &entry->pendingUpdates.back();
+        update->set_status(uint32_t(entry->status));
+        update->set_version(++nextVersion);
+        update->set_sequence_number(context->getCoordinatorService()
+                ->updateManager.nextSequenceNumber());
+        writes.push_back(entry->getExternalWrite());
+    }
+    context->externalStorage->setMulti(writes);
+
+    // Notify local ServerTrackers about the changes.
+    foreach (Entry* entry, entries) {
+        foreach (ServerTrackerInterface* tracker, trackers)
+            tracker->enqueueChange(*entry, event);
+    }
     foreach (ServerTrackerInterface* tracker, trackers)
         tracker->fireCallback();
 
     // Begin the process of notifying all the servers in the cluster.
-    pushUpdate(lock, entry);
+    foreach (Entry* entry, entries)
+        pushUpdate(lock, entry);
 }
 
 /**
@@ -761,16 +801,19 @@ CoordinatorServerList::createReplicationGroups(const Lock& lock)
     }
 
     // Use the list of available backups to create new replication groups.
+    // The members of each group are persisted together.
     while (freeBackups.size() >= replicationGroupSize) {
         maxReplicationId++;
+        vector<Entry*> group;
         for (uint32_t i = 0; i < replicationGroupSize; i++) {
             Entry* e = getEntry(freeBackups.back());
             freeBackups.pop_back();
             e->replicationId = maxReplicationId;
-            persistAndPropagate(lock, e, ServerChangeEvent::SERVER_ADDED);
+            group.push_back(e);
             LOG(NOTICE, "Server %s is now in replication group %lu",
                     e->serverId.toString().c_str(), e->replicationId);
         }
+        persistAndPropagate(lock, group, ServerChangeEvent::SERVER_ADDED);
     }
 }
 
@@ -791,6 +834,7 @@ CoordinatorServerList::removeReplicationGroup(const Lock& lock,
     if (groupId == 0) {
         return;
     }
+    vector<Entry*> group;
     for (size_t i = 0; i < isize(); i++) {
         if (serverList[i].entry &&
                 serverList[i].entry->isBackup() &&
@@ -799,9 +843,11 @@ CoordinatorServerList::removeReplicationGroup(const Lock& lock,
             LOG(NOTICE, "Removed server %s from replication group %lu",
                     e->serverId.toString().c_str(), e->replicationId);
             e->replicationId = 0;
-            persistAndPropagate(lock, e, ServerChangeEvent::SERVER_ADDED);
+            group.push_back(e);
         }
     }
+    if (!group.empty())
+        persistAndPropagate(lock, group, ServerChangeEvent::SERVER_ADDED);
 }
 
 /**
@@ -1156,8 +1202,17 @@ CoordinatorServerList::checkUpdates()
             rpc->wait();
             workSuccess(rpc->id, rpc->getResponseHeader<
                     WireFormat::UpdateServerList>()->currentVersion);
+            for (size_t i = 0; i < rpc->relays.size(); i++) {
+                uint64_t relayedVersion = rpc->getRelayedVersion(i);
+                if (relayedVersion != 0)
+                    workSuccess(rpc->relays[i], relayedVersion);
+                else
+                    workFailed(rpc->relays[i]);
+            }
         } catch (const ServerNotUpException& e) {
             workFailed(rpc->id);
+            foreach (ServerId relayId, rpc->relays)
+                workFailed(relayId);
         }
         (*it)->destroy();
         spareRpcs.push_back(*it);
@@ -1191,7 +1246,14 @@ CoordinatorServerList::checkUpdates()
  * This call MUST eventually be followed by a workSuccuss or workFailed call
  * with the serverId contained within the RPC at some point in
  * the future to ensure that internal metadata is reset for the server
- * to whom the RPC is intended.
+ * to whom the RPC is intended (and for each server it relays to).
+ *
+ * Servers getting incremental updates that are at the same version as the
+ * server chosen are added to its RPC as relays, up to
+ * WireFormat::UpdateServerList::MAX_RELAYS of them: it forwards the same
+ * updates to them (see MembershipService::relayUpdate()), so a membership
+ * change costs the coordinator one RPC per batch of servers rather than
+ * one per server.
  *
  * \param rpc
  *      If there is work to do, an outgoing UpdateServerList RPC will
@@ -1272,6 +1334,31 @@ CoordinatorServerList::getWork(Tub<UpdateServerListRpc>* rpc) {
                             break;
                         }
                     }
+
+                    // Find other servers that need exactly these updates.
+                    vector<ServerId> relays;
+                    for (size_t j = 1; j < serverList.size() &&
+                            relays.size() <
+                                WireFormat::UpdateServerList::MAX_RELAYS;
+                            j++) {
+                        size_t index = (i + j) % serverList.size();
+                        Entry* other = serverList[index].entry.get();
+                        if (other && other->status == ServerStatus::UP &&
+                                other->services.has(
+                                    WireFormat::MEMBERSHIP_SERVICE) &&
+                                other->verifiedVersion ==
+                                    server->verifiedVersion &&
+                                other->updateVersion ==
+                                    other->verifiedVersion) {
+                            other->updateVersion = server->updateVersion;
+                            relays.push_back(other->serverId);
+                        }
+                    }
+                    if (!relays.empty()) {
+                        (*rpc)->appendRelays(relays);
+                        numUpdatingServers +=
+                                downCast<uint32_t>(relays.size());
+                    }
                 }
 
                 numUpdatingServers++;
@@ -1445,6 +1532,7 @@ CoordinatorServerList::UpdateServerListRpc::UpdateServerListRpc(
             const ProtoBuf::ServerList* list)
     : ServerIdRpcWrapper(context, serverId,
             sizeof(WireFormat::UpdateServerList::Response))
+    , relays()
 {
     allocHeader<WireFormat::UpdateServerList>(serverId);
 
@@ -1490,6 +1578,51 @@ CoordinatorServerList::UpdateServerListRpc::appendServerList(
     return true;
 }
 
+/**
+ * Asks the recipient of this rpc to relay the updates in it to other
+ * servers once it has applied them (see MembershipService::relayUpdate()).
+ * Must be invoked after the last appendServerList() and before send().
+ *
+ * \param relayIds
+ *      Servers to relay the updates to; at most
+ *      WireFormat::UpdateServerList::MAX_RELAYS. Each must be at the same
+ *      server list version as the recipient.
+ */
+void
+CoordinatorServerList::UpdateServerListRpc::appendRelays(
+                                        const vector<ServerId>& relayIds)
+{
+    assert(this->getState() == NOT_STARTED);
+    assert(relayIds.size() <= WireFormat::UpdateServerList::MAX_RELAYS);
+    request.getStart<WireFormat::UpdateServerList::Request>()->relayCount =
+            downCast<uint32_t>(relayIds.size());
+    foreach (ServerId relayId, relayIds)
+        request.emplaceAppend<uint64_t>(relayId.getId());
+    relays = relayIds;
+}
+
+/**
+ * After the rpc has completed, return the server list version reported by
+ * one of the servers the update was relayed to.
+ *
+ * \param index
+ *      Index of the server in #relays.
+ * \return
+ *      The server's version after processing the update, or 0 if the
+ *      recipient couldn't relay the update to it.
+ */
+uint64_t
+CoordinatorServerList::UpdateServerListRpc::getRelayedVersion(size_t index)
+{
+    typedef WireFormat::UpdateServerList::Response::RelayResult RelayResult;
+    const RelayResult* result = response->getOffset<RelayResult>(
+            downCast<uint32_t>(sizeof(WireFormat::UpdateServerList::Response) +
+                               index * sizeof(RelayResult)));
+    if (result == NULL || result->serverId != relays[index].getId())
+        return 0;
+    return result->currentVersion;
+}
+
 
 //////////////////////////////////////////////////////////////////////
 // CoordinatorServerList::Entry Methods
@@ -1563,6 +1696,19 @@ CoordinatorServerList::Entry::serialize(ProtoBuf::ServerList_Entry* dest) const
  */
 void
 CoordinatorServerList::Entry::sync(ExternalStorage* externalStorage)
+{
+    ExternalStorage::Write write = getExternalWrite();
+    externalStorage->set(write.flavor, write.name.c_str(),
+            write.value.data(), downCast<int>(write.value.size()));
+}
+
+/**
+ * Return a description of the write that #sync would perform for this
+ * entry, so that several entries can be persisted with a single call to
+ * ExternalStorage::setMulti.
+ */
+ExternalStorage::Write
+CoordinatorServerList::Entry::getExternalWrite()
 {
     ProtoBuf::ServerListEntry externalInfo;
     externalInfo.set_services(services.serialize());
@@ -1588,7 +1734,6 @@ CoordinatorServerList::Entry::sync(ExternalStorage* externalStorage)
 
     string str;
     externalInfo.SerializeToString(&str);
-    externalStorage->set(ExternalStorage::UPDATE, objectName, str.c_str(),
-            downCast<int>(str.length()));
+    return ExternalStorage::Write(ExternalStorage::UPDATE, objectName, str);
 }
 } // namespace RAMCloud
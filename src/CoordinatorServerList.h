@@ -49,7 +49,10 @@ namespace RAMCloud {
  * Add/Crashed/Removes statuses are buffered into an internally managed
  * Protobuf until pushUpdate() is called, which will finalize the update.
  * The updates are done asynchronously from the CoordinatorServerList call
- * thread. sync() can be called to force a synchronization point.
+ * thread. sync() can be called to force a synchronization point. Servers
+ * that need the same incremental updates are updated together: one of them
+ * gets the updates and relays them to the others (see getWork()), so the
+ * coordinator sends a fraction of the rpcs on each membership change.
  *
  * CoordinatorServerList is thread-safe and supports ServerTrackers.
  *
@@ -87,6 +90,7 @@ class CoordinatorServerList : public AbstractServerList{
         Entry& operator=(const Entry& other) = default;
         void serialize(ProtoBuf::ServerList_Entry* dest) const;
         void sync(ExternalStorage* externalStorage);
+        ExternalStorage::Write getExternalWrite();
 
         bool isMaster() const {
             return (status == ServerStatus::UP) &&
@@ -221,6 +225,13 @@ class CoordinatorServerList : public AbstractServerList{
 
       PRIVATE:
         bool appendServerList(const ProtoBuf::ServerList* list);
+        void appendRelays(const vector<ServerId>& relayIds);
+        uint64_t getRelayedVersion(size_t index);
+
+        /// Servers the recipient is asked to relay the update to; see
+        /// appendRelays().
+        vector<ServerId> relays;
+
         DISALLOW_COPY_AND_ASSIGN(UpdateServerListRpc);
     };
 
@@ -311,6 +322,8 @@ class CoordinatorServerList : public AbstractServerList{
     CoordinatorServerList::Entry* getEntry(size_t index) const;
     void persistAndPropagate(const Lock& lock, Entry* entry,
                              ServerChangeEvent event);
+    void persistAndPropagate(const Lock& lock, const vector<Entry*>& entries,
+                             ServerChangeEvent event);
     void recoveryCompleted(const Lock& lock, ServerId serverId);
     void serialize(const Lock& lock, ProtoBuf::ServerList* protoBuf) const;
     void serialize(const Lock& lock, ProtoBuf::ServerList* protoBuf,
@@ -227,6 +227,9 @@ class CoordinatorServerListTest : public ::testing::Test {
         }
         result.append(format("opcode: %s", WireFormat::opcodeSymbol(
                 request->common.opcode)));
+        uint32_t relaysOffset =
+                totalLength - request->relayCount * sizeof32(uint64_t);
+        totalLength = relaysOffset;
         uint32_t offset = sizeof32(*request);
         while (offset <totalLength) {
             const WireFormat::UpdateServerList::Request::Part* part =
@@ -251,6 +254,11 @@ class CoordinatorServerListTest : public ::testing::Test {
                     pb.ShortDebugString().c_str()));
             offset += part->serverListLength;
         }
+        for (uint32_t i = 0; i < request->relayCount; i++) {
+            result.append(i == 0 ? ", relays: " : " ");
+            result.append(ServerId(*buffer->getOffset<uint64_t>(
+                    relaysOffset + i * sizeof32(uint64_t))).toString());
+        }
         return result;
     }
 
@@ -771,8 +779,10 @@ TEST_F(CoordinatorServerListTest, serverCrashed_success) {
     ServerId id2 = sl->enlistServer(
             {WireFormat::BACKUP_SERVICE, WireFormat::MASTER_SERVICE},
             0, 0, "mock:host=node2");
+    sl->sessionCache.insert(id1, new Transport::Session());
     TestLog::reset();
     sl->serverCrashed(id1);
+    EXPECT_TRUE(sl->sessionCache.find(id1) == NULL);
     EXPECT_EQ(1U, sl->masterCount());
     EXPECT_EQ(1U, sl->backupCount());
     EXPECT_EQ(ServerStatus::CRASHED, sl->getEntry(id1)->status);
@@ -917,6 +927,37 @@ TEST_F(CoordinatorServerListTest, persistAndPropagate) {
     EXPECT_EQ("version 51, id 2.3", updateInfo(sl));
 }
 
+TEST_F(CoordinatorServerListTest, persistAndPropagate_multipleEntries) {
+    sl->serverList.resize(4);
+    initServer(ServerId(2, 3), "server1", {WireFormat::BACKUP_SERVICE},
+            200, ServerStatus::UP);
+    initServer(ServerId(3, 1), "server2", {WireFormat::BACKUP_SERVICE},
+            200, ServerStatus::UP);
+    CoordinatorServerList::Entry* entry1 = sl->getEntry({2, 3});
+    CoordinatorServerList::Entry* entry2 = sl->getEntry({3, 1});
+    TestLog::reset();
+    cluster.externalStorage.log.clear();
+    cluster.coordinatorContext.getCoordinatorService()
+            ->updateManager.lastAssigned = 10;
+    sl->version = 50U;
+    sl->persistAndPropagate(lock, {entry1, entry2},
+            ServerChangeEvent::SERVER_ADDED);
+    EXPECT_EQ("status: 0 version: 51 sequence_number: 11",
+                entry1->pendingUpdates.back().ShortDebugString());
+    EXPECT_EQ("status: 0 version: 52 sequence_number: 12",
+                entry2->pendingUpdates.back().ShortDebugString());
+    EXPECT_EQ("set(UPDATE, servers/2); set(UPDATE, servers/3)",
+            cluster.externalStorage.log);
+    // Both entries are persisted before anyone is told about either.
+    EXPECT_TRUE(TestUtil::contains(TestLog::get(),
+            "persistAndPropagate: Persisting 2.3 | "
+            "persistAndPropagate: Persisting 3.1 | "
+            "enqueueChange: pushing SERVER_ADDED event for 2.3 | "
+            "enqueueChange: pushing SERVER_ADDED event for 3.1"));
+    EXPECT_EQ(52U, sl->version);
+    EXPECT_EQ("version 51, id 2.3 | version 52, id 3.1", updateInfo(sl));
+}
+
 TEST_F(CoordinatorServerListTest, serializeWithLock_serializeAll) {
     sl->serverList.resize(4);
     sl->serverList[1].entry.construct(ServerId(1, 0), "server1",
@@ -1445,6 +1486,43 @@ TEST_F(CoordinatorServerListTest, checkUpdates_ServerNotUpException) {
     EXPECT_EQ(0UL, sl->updates.size());
 }
 
+TEST_F(CoordinatorServerListTest, checkUpdates_relays) {
+    sl->enlistServer({WireFormat::MEMBERSHIP_SERVICE}, 0, 100,
+            "mock:host=server1");
+    sl->enlistServer({WireFormat::MEMBERSHIP_SERVICE}, 0, 100,
+            "mock:host=server2");
+    sl->enlistServer({WireFormat::MEMBERSHIP_SERVICE}, 0, 100,
+            "mock:host=server3");
+    ServerId id4 = sl->enlistServer({WireFormat::MASTER_SERVICE}, 0, 100,
+            "mock:host=server4");
+    while (sl->getWork(&rpc)) {
+        sl->workSuccess(rpc->id, ~0lu);
+    }
+    rpc.destroy();
+
+    sl->serverCrashed(id4);
+    sl->checkUpdates();
+    ASSERT_EQ(1UL, sl->activeRpcs.size());
+    CoordinatorServerList::UpdateServerListRpc* active =
+            sl->activeRpcs.front()->get();
+    ASSERT_EQ(2UL, active->relays.size());
+    ServerId relayed = active->relays[0];
+    ServerId notRelayed = active->relays[1];
+
+    // The first relay succeeded; the recipient didn't report on the second.
+    finishRpc(active, format("0 5 0 %u %u 5 0",
+            relayed.indexNumber(), relayed.generationNumber()).c_str());
+    sl->checkUpdates();
+    EXPECT_EQ(5lu, sl->getEntry(relayed)->verifiedVersion);
+    EXPECT_EQ(4lu, sl->getEntry(notRelayed)->verifiedVersion);
+    EXPECT_EQ(4lu, sl->getEntry(notRelayed)->updateVersion);
+
+    // The server that missed the update gets it in a new rpc.
+    ASSERT_EQ(1UL, sl->activeRpcs.size());
+    EXPECT_EQ(notRelayed, sl->activeRpcs.front()->get()->id);
+    EXPECT_EQ(0UL, sl->activeRpcs.front()->get()->relays.size());
+}
+
 TEST_F(CoordinatorServerListTest, getWork_emptyServerList) {
     EXPECT_FALSE(sl->getWork(&rpc));
 }
@@ -1561,6 +1639,30 @@ TEST_F(CoordinatorServerListTest, getWork_skipEntriesAlreadySeen) {
     EXPECT_EQ(4lu, e->updateVersion);
 }
 
+TEST_F(CoordinatorServerListTest, getWork_relays) {
+    ServerId id1 = sl->enlistServer({WireFormat::MEMBERSHIP_SERVICE}, 0, 0,
+            "mock:host=server1");
+    ServerId id2 = sl->enlistServer({WireFormat::MEMBERSHIP_SERVICE}, 0, 0,
+            "mock:host=server2");
+    ServerId id3 = sl->enlistServer({WireFormat::MASTER_SERVICE}, 0, 0,
+            "mock:host=server3");
+    while (sl->getWork(&rpc)) {
+        sl->workSuccess(rpc->id, ~0lu);
+    }
+
+    // Both servers need the same update, so one relays it to the other.
+    sl->serverCrashed(id3);
+    EXPECT_TRUE(sl->getWork(&rpc));
+    ServerId relayId = rpc->id == id1 ? id2 : id1;
+    EXPECT_EQ((vector<ServerId>{relayId}), rpc->relays);
+    EXPECT_TRUE(TestUtil::contains(parseUpdateRequest(&rpc->request),
+            "version_number: 4 type: UPDATE, relays: " +
+            relayId.toString()));
+    EXPECT_EQ(4lu, sl->getEntry(relayId)->updateVersion);
+    EXPECT_EQ(2lu, sl->numUpdatingServers);
+    EXPECT_FALSE(sl->getWork(&rpc));
+}
+
 TEST_F(CoordinatorServerListTest, getWork_updateStatsAndPrune) {
     // Create two servers.
     ServerId id1 = sl->enlistServer(
@@ -1772,6 +1874,10 @@ TEST_F(CoordinatorServerListTest, appendServerList) {
             "expected_read_mbytes_per_sec: 0 status: 0 replication_id: 0 } "
             "version_number: 2 type: UPDATE",
             parseUpdateRequest(&rpc.request));
+
+    rpc.appendRelays({ServerId(3, 0), ServerId(4, 1)});
+    EXPECT_TRUE(TestUtil::contains(parseUpdateRequest(&rpc.request),
+            "version_number: 2 type: UPDATE, relays: 3.0 4.1"));
 }
 
 TEST_F(CoordinatorServerListTest, Entry_constructor) {
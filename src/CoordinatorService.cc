@@ -54,6 +54,7 @@ CoordinatorService::CoordinatorService(Context* context,
     , leaseAuthority(context)
     , runtimeOptions()
     , recoveryManager(context, tableManager, &runtimeOptions)
+    , tabletBalancer(context, &tableManager, &runtimeOptions)
     , activeVerifications()
     , mutex("CoordinatorService::mutex")
     , forceServerDownForTesting(false)
@@ -124,6 +125,7 @@ CoordinatorService::init(CoordinatorService* service,
             // it will need accurate information about which tables are stored
             // on a crashed server).
             service->recoveryManager.start();
+            service->tabletBalancer.start();
         }
 
 
@@ -371,6 +373,12 @@ CoordinatorService::enlistServer(
                                                     reqHdr->preferredIndex,
                                                     readSpeed,
                                                     serviceLocator);
+    if (reqHdr->fromSnapshot && replacesId.isValid() &&
+            serviceMask.has(WireFormat::MASTER_SERVICE)) {
+        LOG(NOTICE, "Server %s has a snapshot of the log of master %s",
+            newServerId.toString().c_str(), replacesId.toString().c_str());
+        recoveryManager.replacementEnlisted(replacesId, newServerId);
+    }
     respHdr->serverId = newServerId.getId();
 }
 
@@ -472,10 +480,10 @@ CoordinatorService::getTableConfig(
         WireFormat::GetTableConfig::Response* respHdr,
         Rpc* rpc)
 {
-    ProtoBuf::TableConfig tableConfig;
-    tableManager.serializeTableConfig(&tableConfig, reqHdr->tableId);
-    respHdr->tableConfigLength = serializeToResponse(rpc->replyPayload,
-                                                     &tableConfig);
+    FlatTableConfig::Builder builder;
+    tableManager.serializeTableConfig(&builder, reqHdr->tableId,
+            reqHdr->startKeyHash, reqHdr->endKeyHash);
+    respHdr->tableConfigLength = builder.serialize(rpc->replyPayload);
 }
 
 /**
@@ -589,7 +597,8 @@ CoordinatorService::recoveryMasterFinished(
         recoveryManager.recoveryMasterFinished(reqHdr->recoveryId,
                                                serverId,
                                                recoveryPartition,
-                                               reqHdr->successful);
+                                               reqHdr->successful,
+                                               reqHdr->partial);
 }
 
 /**
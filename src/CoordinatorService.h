@@ -34,6 +34,7 @@
 #include "RuntimeOptions.h"
 #include "Service.h"
 #include "TableManager.h"
+#include "TabletBalancer.h"
 #include "TransportManager.h"
 #include "ServerConfig.h"
 
@@ -200,6 +201,12 @@ class CoordinatorService : public Service {
      */
     MasterRecoveryManager recoveryManager;
 
+    /**
+     * Moves tablets off of overloaded masters; configured through
+     * #runtimeOptions.
+     */
+    TabletBalancer tabletBalancer;
+
     /**
      * Keeps track of the servers that we are currently checking to see if
      * they have failed,so we don't start multiple simultaneous checks
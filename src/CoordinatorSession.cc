@@ -13,13 +13,18 @@
  * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <string.h>
+
 #include "CoordinatorSession.h"
+#include "Cycles.h"
 #include "ExternalStorage.h"
 #include "FailSession.h"
 #include "ShortMacros.h"
 
 namespace RAMCloud {
 
+const char* CoordinatorSession::REPLICAS_NODE = "coordinatorReplicas";
+
 /**
  * Constructor for CoordinatorSession.
  */
@@ -30,6 +35,8 @@ CoordinatorSession::CoordinatorSession(Context* context)
     , clusterName()
     , storage(NULL)
     , session(NULL)
+    , readSession(NULL)
+    , nextReplicaCheck(0)
 {}
 
 /**
@@ -48,10 +55,23 @@ void
 CoordinatorSession::flush()
 {
     TEST_LOG("flushing session");
-    std::lock_guard<SpinLock> lock(mutex);
+    Lock lock(mutex);
     session = NULL;
 }
 
+/**
+ * Close any existing read session, so that the next call to
+ * #getReadSession will pick a read replica afresh.
+ */
+void
+CoordinatorSession::flushReadSession()
+{
+    TEST_LOG("flushing read session");
+    Lock lock(mutex);
+    readSession = NULL;
+    nextReplicaCheck = 0;
+}
+
 /**
  * Returns the location string currently being used to open coordinator
  * sessions (the #location argument to the most recent call to setLocation).
@@ -60,10 +80,50 @@ CoordinatorSession::flush()
 string&
 CoordinatorSession::getLocation()
 {
-    std::lock_guard<SpinLock> lock(mutex);
+    Lock lock(mutex);
     return coordinatorLocator;
 }
 
+/**
+ * Returns a session that can be used for read-only requests that
+ * coordinator read replicas know how to handle. If read replicas are
+ * advertised on external storage, the session is opened to one of them,
+ * chosen at random so that clients spread their load across all of the
+ * replicas; otherwise the session is the same as the one returned by
+ * #getSession.
+ */
+Transport::SessionRef
+CoordinatorSession::getReadSession()
+{
+    Lock lock(mutex);
+    if (readSession != NULL)
+        return readSession;
+    if (storage == NULL || Cycles::rdtsc() < nextReplicaCheck)
+        return getSession(lock);
+
+    vector<ExternalStorage::Object> replicas;
+    storage->getChildren(REPLICAS_NODE, &replicas);
+    vector<string> locators;
+    foreach (ExternalStorage::Object& replica, replicas) {
+        if (replica.value != NULL) {
+            locators.emplace_back(replica.value,
+                    strnlen(replica.value, replica.length));
+        }
+    }
+    if (locators.empty()) {
+        nextReplicaCheck = Cycles::rdtsc() + Cycles::fromNanoseconds(
+                REPLICA_CHECK_INTERVAL_MS * 1000000lu);
+        return getSession(lock);
+    }
+    const string& locator = locators[generateRandom() % locators.size()];
+    readSession = context->transportManager->openSession(locator);
+    if (readSession->getServiceLocator() != "fail:") {
+        LOG(NOTICE, "Opened session with coordinator read replica at %s",
+                locator.c_str());
+    }
+    return readSession;
+}
+
 /**
  * Returns a session that can be used to communicate with the coordinator.
  * If there is not currently a session open, then a new session is opened.
@@ -74,7 +134,20 @@ CoordinatorSession::getLocation()
 Transport::SessionRef
 CoordinatorSession::getSession()
 {
-    std::lock_guard<SpinLock> lock(mutex);
+    Lock lock(mutex);
+    return getSession(lock);
+}
+
+/**
+ * Does the work of the public getSession method; the caller must hold
+ * the monitor lock.
+ *
+ * \param lock
+ *      Ensures that the caller holds the monitor lock; not actually used.
+ */
+Transport::SessionRef
+CoordinatorSession::getSession(Lock& lock)
+{
     if (session != NULL)
         return session;
 
@@ -120,7 +193,7 @@ CoordinatorSession::getSession()
 void
 CoordinatorSession::setLocation(const char* location, const char* clusterName)
 {
-    std::lock_guard<SpinLock> lock(mutex);
+    Lock lock(mutex);
     coordinatorLocator = location;
     this->clusterName = clusterName;
 
@@ -135,6 +208,8 @@ CoordinatorSession::setLocation(const char* location, const char* clusterName)
         storage->setWorkspace(workspace.c_str());
     }
     session = NULL;
+    readSession = NULL;
+    nextReplicaCheck = 0;
 }
 
 } // namespace RAMCloud
@@ -24,7 +24,9 @@ namespace RAMCloud {
  * CoordinatorSession manages the session used to communicate with the
  * coordinator.  Its main job is to locate the coordinator, given a
  * description of which coordinator to use, and to locate a new coordinator
- * if the existing one crashes.
+ * if the existing one crashes. It also manages a second session for
+ * read-only requests, which is opened to one of the coordinator's read
+ * replicas (see CoordinatorReplicaService) if there are any.
  */
 class CoordinatorSession {
   public:
@@ -32,11 +34,21 @@ class CoordinatorSession {
     ~CoordinatorSession();
 
     void flush();
+    void flushReadSession();
     string& getLocation();
+    Transport::SessionRef getReadSession();
     Transport::SessionRef getSession();
     void setLocation(const char* location, const char* clusterName = "main");
 
+    /// Name of the external storage node under which coordinator read
+    /// replicas advertise their service locators (one child object per
+    /// replica, whose value is the replica's locator).
+    static const char* REPLICAS_NODE;
+
   PROTECTED:
+    typedef std::lock_guard<SpinLock> Lock;
+    Transport::SessionRef getSession(Lock& lock);
+
     /// Used in a monitor-style fashion for mutual exclusion.
     SpinLock mutex;
 
@@ -60,6 +72,20 @@ class CoordinatorSession {
     /// errors.
     Transport::SessionRef session;
 
+    /// Used for read-only requests that a coordinator read replica can
+    /// handle. NULL means a session hasn't been opened yet, or it was
+    /// flushed because of communication errors.
+    Transport::SessionRef readSession;
+
+    /// If there are no read replicas, #getReadSession doesn't look for them
+    /// again until Cycles::rdtsc() reaches this value, so that reads
+    /// don't turn into external storage lookups.
+    uint64_t nextReplicaCheck;
+
+    /// How often (in milliseconds) to check for new read replicas when
+    /// there aren't any.
+    static const uint32_t REPLICA_CHECK_INTERVAL_MS = 5000;
+
     DISALLOW_COPY_AND_ASSIGN(CoordinatorSession);
 };
 
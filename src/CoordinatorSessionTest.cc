@@ -53,6 +53,52 @@ TEST_F(CoordinatorSessionTest, basics) {
     EXPECT_EQ("mock:", cs.getLocation());
 }
 
+TEST_F(CoordinatorSessionTest, getReadSession_replica) {
+    TestLog::Enable _("getReadSession", "flushReadSession", NULL);
+    CoordinatorSession cs(&context);
+    MockExternalStorage* storage = new MockExternalStorage(true);
+    cs.coordinatorLocator = "bogus:type=old";
+    cs.storage = storage;
+    storage->getChildrenNames.push("mock:host=replica");
+    storage->getChildrenValues.push("mock:host=replica");
+    Transport::SessionRef session = cs.getReadSession();
+    EXPECT_EQ("mock:host=replica", session->getServiceLocator());
+    EXPECT_EQ("getReadSession: Opened session with coordinator read "
+            "replica at mock:host=replica", TestLog::get());
+    EXPECT_EQ("getChildren(coordinatorReplicas)", storage->log);
+
+    // The session is reused until it is flushed.
+    EXPECT_EQ(session, cs.getReadSession());
+    EXPECT_EQ("getChildren(coordinatorReplicas)", storage->log);
+    cs.flushReadSession();
+    EXPECT_TRUE(cs.readSession == NULL);
+}
+
+TEST_F(CoordinatorSessionTest, getReadSession_noReplicas) {
+    CoordinatorSession cs(&context);
+    MockExternalStorage* storage = new MockExternalStorage(true);
+    cs.coordinatorLocator = "bogus:type=old";
+    cs.storage = storage;
+    storage->getResults.push("mock:host=1");
+    Transport::SessionRef session = cs.getReadSession();
+    EXPECT_EQ("mock:host=1", session->getServiceLocator());
+    EXPECT_EQ("getChildren(coordinatorReplicas); get(coordinator)",
+            storage->log);
+    EXPECT_NE(0u, cs.nextReplicaCheck);
+
+    // Don't look for replicas again right away.
+    EXPECT_EQ(session, cs.getReadSession());
+    EXPECT_EQ("getChildren(coordinatorReplicas); get(coordinator)",
+            storage->log);
+}
+
+TEST_F(CoordinatorSessionTest, getReadSession_noExternalStorage) {
+    CoordinatorSession cs(&context);
+    cs.setLocation("mock:host=2", "main");
+    EXPECT_EQ("mock:host=2", cs.getReadSession()->getServiceLocator());
+    EXPECT_TRUE(cs.readSession == NULL);
+}
+
 TEST_F(CoordinatorSessionTest, getSession_noLocator) {
     CoordinatorSession cs(&context);
     string message = "no exception";
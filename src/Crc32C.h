@@ -35,6 +35,93 @@ namespace Crc32CSlicingBy8 {
 
 namespace RAMCloud {
 
+/**
+ * Multiply two polynomials over GF(2) modulo the CRC32C (Castagnoli)
+ * polynomial. Both operands and the result use the bit-reflected
+ * representation of the crc32 instruction, so x^0 is 0x80000000.
+ *
+ * This is the building block for advancing a CRC past a run of bytes
+ * without touching them; see #crc32CShift().
+ */
+static inline uint32_t
+crc32CMultiplyModP(uint32_t a, uint32_t b)
+{
+    uint32_t m = 1U << 31;
+    uint32_t product = 0;
+    while (true) {
+        if (a & m) {
+            product ^= b;
+            if ((a & (m - 1)) == 0)
+                break;
+        }
+        m >>= 1;
+        b = (b & 1) ? (b >> 1) ^ 0x82f63b78U : b >> 1;
+    }
+    return product;
+}
+
+/**
+ * Return x^(8 * bytes) modulo the CRC32C polynomial, i.e. the factor that
+ * an unconditioned CRC must be multiplied by to account for appending
+ * 'bytes' zero bytes to the data it covers. Runs in O(log bytes).
+ */
+static inline uint32_t
+crc32CShift(uint64_t bytes)
+{
+    uint32_t result = 1U << 31;             // x^0
+    uint32_t power = 1U << (31 - 8);        // x^8, i.e. one byte
+    while (bytes != 0) {
+        if (bytes & 1)
+            result = crc32CMultiplyModP(power, result);
+        bytes >>= 1;
+        power = crc32CMultiplyModP(power, power);
+    }
+    return result;
+}
+
+#if __SSE4_2__
+/**
+ * Checksum 'chunks' consecutive runs of 3 * blockBytes bytes, running the
+ * crc32 instruction over three independent blocks at once and stitching the
+ * three partial results together afterwards. The crc32 instruction has a
+ * latency of 3 cycles but a throughput of 1 per cycle, so a single dependent
+ * chain only reaches a third of what the hardware can do on large buffers.
+ *
+ * \param crc
+ *      Unconditioned CRC of the data preceding 'p64'.
+ * \param p64
+ *      Data to checksum. Updated to point just past the bytes consumed.
+ * \param chunks
+ *      Number of 3 * blockBytes runs to consume.
+ * \param blockBytes
+ *      Size of each of the three blocks. Must be a multiple of 8.
+ * \param shift
+ *      crc32CShift(blockBytes), precomputed since it's a constant for each
+ *      block size used.
+ */
+static inline uint32_t
+intelCrc32CThreeWay(uint32_t crc, const uint64_t*& p64, uint64_t chunks,
+                    uint64_t blockBytes, uint32_t shift)
+{
+    const uint64_t words = blockBytes / 8;
+    while (chunks-- > 0) {
+        uint64_t a = crc;
+        uint64_t b = 0;
+        uint64_t c = 0;
+        for (uint64_t i = 0; i < words; i++) {
+            a = __builtin_ia32_crc32di(a, p64[i]);
+            b = __builtin_ia32_crc32di(b, p64[words + i]);
+            c = __builtin_ia32_crc32di(c, p64[2 * words + i]);
+        }
+        crc = crc32CMultiplyModP(shift, crc32CMultiplyModP(shift,
+                downCast<uint32_t>(a)) ^ downCast<uint32_t>(b)) ^
+              downCast<uint32_t>(c);
+        p64 += 3 * words;
+    }
+    return crc;
+}
+#endif /* __SSE4_2__ */
+
 /// See #Crc32C().
 static inline uint32_t
 intelCrc32C(uint32_t crc, const void* buffer, uint64_t bytes)
@@ -49,6 +136,19 @@ intelCrc32C(uint32_t crc, const void* buffer, uint64_t bytes)
     uint64_t chunk32 = 0;
     uint64_t chunk8 = 0;
 
+    // Checksum large buffers three blocks at a time to keep the crc32 unit
+    // busy. The block sizes were picked by measuring throughput on buffers
+    // from 1KB to 1MB; the shifts are crc32CShift(4096) and
+    // crc32CShift(1024) (checked in Crc32CTest).
+    if (remainder >= 3 * 1024) {
+        uint64_t chunks = remainder / (3 * 4096);
+        crc = intelCrc32CThreeWay(crc, p64, chunks, 4096, 0x35d73a62U);
+        remainder -= chunks * 3 * 4096;
+        chunks = remainder / (3 * 1024);
+        crc = intelCrc32CThreeWay(crc, p64, chunks, 1024, 0xe4172b16U);
+        remainder -= chunks * 3 * 1024;
+    }
+
     // Do unrolled 32-byte chunks first, 8-bytes at a time.
     chunk32 = remainder >> 5;
     remainder &= 31;
@@ -248,6 +348,28 @@ class Crc32C {
         return ~result;
     }
 
+    /**
+     * Compute the checksum of the concatenation of two pieces of data from
+     * the checksums of the pieces, without looking at the data again. This
+     * is much cheaper than rehashing when the checksums are already known
+     * (for example, those stored in log entries).
+     *
+     * \param crcA
+     *      #getResult() of a Crc32C that covered the first piece.
+     * \param crcB
+     *      #getResult() of a Crc32C that covered the second piece.
+     * \param lengthB
+     *      Length of the second piece in bytes.
+     * \return
+     *      What #getResult() would return after checksumming the first piece
+     *      followed by the second.
+     */
+    static ResultType
+    combine(ResultType crcA, ResultType crcB, uint64_t lengthB)
+    {
+        return crc32CMultiplyModP(crc32CShift(lengthB), crcA) ^ crcB;
+    }
+
   PRIVATE:
     /// Whether this machine has Intel's CRC32C instruction.
     static bool haveHardware;
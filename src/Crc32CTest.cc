@@ -126,6 +126,44 @@ TEST_P(Crc32CTest, updateFromBuffer) {
     EXPECT_EQ(c.result, d.result);
 }
 
+TEST_P(Crc32CTest, update_largeBuffers) {
+    // Lengths chosen to straddle the three-way block sizes used by the
+    // hardware implementation; the software version serves as the oracle.
+    static char buf[3 * 4096 * 2 + 3 * 1024 + 100];
+    for (uint32_t i = 0; i < sizeof(buf); i++)
+        buf[i] = static_cast<char>(i * 7 + (i >> 8));
+
+    uint32_t lengths[] = { 3 * 1024 - 1, 3 * 1024, 3 * 1024 + 9, 3 * 4096,
+                           3 * 4096 + 3 * 1024 + 5, sizeof32(buf) };
+    foreach (uint32_t length, lengths) {
+        EXPECT_EQ(Crc32C(true).update(buf, length).getResult(),
+                  Crc32C(forceSoftware).update(buf, length).getResult());
+        EXPECT_EQ(Crc32C(true).update(&buf[1], length - 1).getResult(),
+                  Crc32C(forceSoftware).update(&buf[1], length - 1)
+                  .getResult());
+    }
+}
+
+TEST_P(Crc32CTest, combine) {
+    for (uint32_t i = 0; i <= sizeof(input); i++) {
+        Crc32C a(forceSoftware);
+        Crc32C b(forceSoftware);
+        a.update(input, i);
+        b.update(&input[i], sizeof32(input) - i);
+        EXPECT_EQ(crcByLength[sizeof(input)],
+                  Crc32C::combine(a.getResult(), b.getResult(),
+                                  sizeof(input) - i));
+    }
+}
+
+TEST_P(Crc32CTest, crc32CShift) {
+    EXPECT_EQ(1U << 31, crc32CShift(0));
+    EXPECT_EQ(1U << 23, crc32CShift(1));
+    // Constants baked into intelCrc32C.
+    EXPECT_EQ(0x35d73a62U, crc32CShift(4096));
+    EXPECT_EQ(0xe4172b16U, crc32CShift(1024));
+}
+
 TEST_P(Crc32CTest, assignmentOperator) {
     Crc32C a;
     a.update(&a, sizeof(a));
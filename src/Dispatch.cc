@@ -19,20 +19,15 @@
 
 #include "ShortMacros.h"
 #include "Common.h"
-#include "CycleCounter.h"
 #include "Cycles.h"
 #include "Dispatch.h"
 #include "Fence.h"
 #include "NoOp.h"
 #include "RawMetrics.h"
+#include "PerfEvents.h"
 #include "PerfStats.h"
 #include "Unlock.h"
 
-// Uncomment to print out a human readable name for any poller that takes longer
-// than slowPollerCycles to complete. Useful for determining which poller is
-// responsible for "Long gap" messages.
-// #define DEBUG_SLOW_POLLERS 1
-
 namespace RAMCloud {
 
 /**
@@ -77,7 +72,11 @@ Dispatch::Dispatch(bool hasDedicatedThread)
     , mutex("Dispatch::mutex")
     , lockNeeded(0)
     , locked(0)
+    , sleeping(0)
+    , idleSleepCycles(0)
     , hasDedicatedThread(hasDedicatedThread)
+    , attached(NULL)
+    , statsIndex(0)
     , slowPollerCycles(Cycles::fromSeconds(.05))
     , profilerFlag(false)
     , totalElements(0)
@@ -123,8 +122,8 @@ Dispatch::~Dispatch()
     readyFd = -1;
     {
         std::lock_guard<SpinLock> lock(timerMutex);
-        while (timers.size() > 0) {
-            Timer* t = timers.back();
+        while (!timers.empty()) {
+            Timer* t = timers.any();
             t->stopInternal(lock);
             t->owner = NULL;
         }
@@ -132,6 +131,49 @@ Dispatch::~Dispatch()
     cleanProfiler();
 }
 
+/**
+ * Attach another dispatcher to this one: from now on, a Lock on this
+ * dispatcher that is created outside its dispatch thread also locks the
+ * other dispatcher. This is used by servers whose transports are spread
+ * over several dispatch threads (see DispatchThread), so that code which
+ * must exclude all of the server's transports (e.g. scans of outstanding
+ * RPCs by LogProtector) can continue to lock just the main dispatcher.
+ *
+ * \param other
+ *      Dispatcher to attach; it must already be polled by its own dispatch
+ *      thread, and must remain valid until it is detached.
+ */
+void
+Dispatch::attach(Dispatch* other)
+{
+    Lock _(this);
+    Dispatch** link = &attached;
+    while (*link != NULL)
+        link = &(*link)->attached;
+    *link = other;
+    other->attached = NULL;
+}
+
+/**
+ * Undo the effect of an earlier call to #attach.
+ *
+ * \param other
+ *      Dispatcher to detach; nothing happens if it isn't attached.
+ */
+void
+Dispatch::detach(Dispatch* other)
+{
+    Lock _(this);
+    for (Dispatch** link = &attached; *link != NULL;
+            link = &(*link)->attached) {
+        if (*link == other) {
+            *link = other->attached;
+            other->attached = NULL;
+            return;
+        }
+    }
+}
+
 /**
  * Check to see if any events need handling.
  *
@@ -176,20 +218,26 @@ Dispatch::poll()
         }
         currentTime = newCurrent;
     }
+    uint64_t pollerStart = currentTime;
     for (uint32_t i = 0; i < pollers.size(); i++) {
-#if DEBUG_SLOW_POLLERS
-        uint64_t ticks = 0;
-        CycleCounter<> counter(&ticks);
-#endif
-        result += pollers[i]->poll();
-#if DEBUG_SLOW_POLLERS
-        counter.stop();
-        if (ticks > slowPollerCycles) {
-            double ms = Cycles::toSeconds(ticks) * 1000;
-            LOG(NOTICE, "Poller %s (%u) took awhile: %.1f ms",
-                pollers[i]->pollerName.c_str(), i, ms);
+        Poller* poller = pollers[i];
+        int pollerResult = poller->poll();
+        result += pollerResult;
+        uint64_t pollerEnd = Cycles::rdtsc();
+
+        // The poller may have deleted itself; if so, its slot now holds
+        // a different poller (or nothing), and the statistics are dropped.
+        if ((i < pollers.size()) && (pollers[i] == poller)) {
+            uint64_t cycles = pollerEnd - pollerStart;
+            poller->recordInvocation(cycles, pollerResult);
+            if (cycles > slowPollerCycles) {
+                poller->slowInvocations++;
+                LOG(WARNING, "Poller %s took %.1f ms",
+                        poller->pollerName.c_str(),
+                        Cycles::toSeconds(cycles)*1e03);
+            }
         }
-#endif
+        pollerStart = pollerEnd;
     }
     if (readyFd >= 0) {
         int fd = readyFd;
@@ -232,8 +280,8 @@ Dispatch::poll()
     }
     if (currentTime >= earliestTriggerTime) {
         std::lock_guard<SpinLock> lock(timerMutex);
-        // Looks like a timer may have triggered. Check all the timers and
-        // invoke any that have triggered.
+        // Looks like a timer may have triggered. Collect all the timers
+        // that have triggered and invoke them.
         //
         // There are two goals here:
         // * Invoke every timer that has triggered.
@@ -241,44 +289,23 @@ Dispatch::poll()
         //   handler for a timer reschedules the timer in the past, don't
         //   run it a second time; otherwise an infinite loop could result).
         //
-        // The goals are (mostly) met by processing the Timers in reverse
-        // order (highest array element first). If the handler for one
-        // timer A stops another timer B, this could cause a timer C that
-        // was already processed to move into B's slot in the timers
-        // vector, which could cause it to be invoked multiple times.
-        // However, we can't get stuck: i drops by 1 in each iteration
-        // through the loop.
-        for (int i = downCast<int>(timers.size()) - 1 ; i >= 0; --i) {
-            Timer* timer = timers[i];
-            if (timer->triggerTime <= currentTime) {
-                timer->stopInternal(lock);
-                {
-                    // Release the lock while the handler is running,
-                    // to avoid deadlocks.
-                    Unlock<SpinLock> unlock(timerMutex);
-                    timer->handleTimerEvent();
-                }
-                result++;
-                if (i >= downCast<int>(timers.size())) {
-                    // A whole bunch of timers got deleted while this
-                    // handler was running; make sure we keep i inside
-                    // the bounds of the array.
-                    i = downCast<int>(timers.size());
-                }
-            }
-        }
-
-        // Compute a new value for earliestTriggerTime. Can't do this
-        // in the loop above, because one timer handler could delete
-        // another, which can rearrange the list and cause us to miss
-        // a trigger time.
-        earliestTriggerTime = ~(0ull);
-        for (uint32_t i = 0; i < timers.size(); i++) {
-            Timer* timer = timers[i];
-            if (timer->triggerTime < earliestTriggerTime) {
-                earliestTriggerTime = timer->triggerTime;
+        // The wheel meets both: popExpired only returns the timers found
+        // by this call to advance, and a timer restarted in the past by a
+        // handler waits for the next call. A handler may also stop or
+        // delete other timers, including ones that haven't been invoked
+        // yet; they are simply removed from the wheel.
+        timers.advance(currentTime);
+        Timer* timer;
+        while ((timer = timers.popExpired()) != NULL) {
+            {
+                // Release the lock while the handler is running,
+                // to avoid deadlocks.
+                Unlock<SpinLock> unlock(timerMutex);
+                timer->handleTimerEvent();
             }
+            result++;
         }
+        earliestTriggerTime = timers.earliest();
     }
     return result;
 }
@@ -290,18 +317,178 @@ Dispatch::poll()
  */
 void
 Dispatch::run()
+{
+    // runUntil never returns when there's no stop flag; the loop just
+    // tells the compiler so.
+    while (true)
+        runUntil(NULL);
+}
+
+/**
+ * Same as #run, except that this method returns once a given flag becomes
+ * nonzero. It is used by dispatch threads that must be stopped, such as
+ * the additional dispatch threads of a server (see DispatchThread).
+ *
+ * \param stop
+ *      Returns soon after this becomes nonzero (after the next poll; use
+ *      #wakeup in case the dispatcher is sleeping). NULL means never
+ *      return.
+ */
+void
+Dispatch::runUntil(const Atomic<int>* stop)
 {
     PerfStats::registerStats(&PerfStats::threadStats);
     uint64_t prev;
-    while (true) {
+    uint64_t lastWork = Cycles::rdtsc();
+    while ((stop == NULL) || (stop->load() == 0)) {
         prev = currentTime;
+        PerfStats::HardwareCounts hardwareStart = {};
+        PerfEvents::start(&hardwareStart);
         if (poll() > 0) {
             PerfStats::threadStats.dispatchActiveCycles +=
                     currentTime - prev;
+            if (statsIndex < uint32_t(PerfStats::MAX_DISPATCH_THREADS)) {
+                PerfStats::threadStats.dispatchThreadActiveCycles[
+                        statsIndex] += currentTime - prev;
+            }
+            PerfEvents::stop(hardwareStart,
+                    &PerfStats::threadStats.dispatchHardware);
+            lastWork = currentTime;
+        } else if ((idleSleepCycles != 0) &&
+                ((currentTime - lastWork) > idleSleepCycles)) {
+            // We've been idle for a while; stop burning a core. Any work
+            // found by the next poll resets lastWork, which switches us
+            // back to spinning.
+            sleepUntilWork();
         }
     }
 }
 
+/**
+ * Change whether a thread owns this dispatcher. Clients normally have no
+ * dispatch thread: whichever thread is waiting for an RPC polls. A
+ * multi-threaded client instead dedicates one thread to polling, which
+ * invokes this method when it starts; other threads must then lock the
+ * dispatcher (or use DispatchExec) to touch transports.
+ *
+ * \param dedicated
+ *      True means the calling thread becomes the dispatch thread; false
+ *      means there is no longer a dispatch thread. The caller must make
+ *      sure no other thread is using the dispatcher at the time.
+ */
+void
+Dispatch::setDedicatedThread(bool dedicated)
+{
+    if (dedicated)
+        ownerId = ThreadId::get();
+    hasDedicatedThread = dedicated;
+}
+
+/**
+ * Configure #run to stop spinning when the server is idle: once no poll
+ * has found any work for the given time, the dispatch thread alternates
+ * between polling and short sleeps, until some poll finds work again.
+ * The sleep ends early when a file becomes ready, when another thread
+ * wants to lock the dispatcher, or when #wakeup is invoked.
+ *
+ * \param micros
+ *      Idle time (in microseconds) after which to start sleeping; 0
+ *      means never sleep (the default).
+ */
+void
+Dispatch::setIdleSleepMicros(uint32_t micros)
+{
+    idleSleepCycles = Cycles::fromMicroseconds(micros);
+}
+
+/**
+ * Choose the entry of PerfStats::dispatchThreadActiveCycles that #run
+ * updates, so that the load of each of a server's dispatch threads can be
+ * seen separately. The default is 0 (the server's main dispatch thread).
+ *
+ * \param index
+ *      Index of this dispatcher among those of the server; indexes of
+ *      PerfStats::MAX_DISPATCH_THREADS or more are only counted in the
+ *      total.
+ */
+void
+Dispatch::setStatsIndex(uint32_t index)
+{
+    statsIndex = index;
+}
+
+/**
+ * Add an entry to a ServerStatistics for each poller currently registered
+ * with this dispatcher, describing how much CPU time it has consumed.
+ * May be invoked from any thread.
+ *
+ * \param stats
+ *      Protocol buffer to which the entries are added.
+ */
+void
+Dispatch::getPollerStatistics(ProtoBuf::ServerStatistics* stats)
+{
+    Lock lock(this);
+    stats->set_cycles_per_second(Cycles::perSecond());
+    foreach (Poller* poller, pollers) {
+        ProtoBuf::ServerStatistics::PollerStats* entry =
+                stats->add_poller_stats();
+        entry->set_name(poller->pollerName);
+        entry->set_invocations(poller->invocations);
+        entry->set_active_invocations(poller->activeInvocations);
+        entry->set_cycles(poller->totalCycles);
+        entry->set_max_cycles(poller->maxCycles);
+        entry->set_slow_invocations(poller->slowInvocations);
+        for (int i = 0; i < Poller::HISTOGRAM_BUCKETS; i++) {
+            entry->add_cycle_histogram(poller->cycleHistogram[i]);
+        }
+    }
+}
+
+/**
+ * Block the dispatch thread until it is woken by #wakeup or until
+ * MAX_SLEEP_MICROS (or the next timer) elapses. Time spent here is
+ * recorded in PerfStats::dispatchSleepCycles.
+ */
+void
+Dispatch::sleepUntilWork()
+{
+    uint64_t start = Cycles::rdtsc();
+    if (earliestTriggerTime <= start)
+        return;
+    uint64_t sleepCycles = std::min(earliestTriggerTime - start,
+            Cycles::fromMicroseconds(MAX_SLEEP_MICROS));
+
+    // Announce that we're going to sleep before the final check for
+    // work, so that anyone producing work after this check will see
+    // #sleeping and wake us (exchange is a full memory barrier).
+    sleeping.exchange(1);
+    if ((readyFd >= 0) || (lockNeeded.load() != 0)) {
+        sleeping.store(0);
+        return;
+    }
+    struct timespec timeout;
+    timeout.tv_sec = 0;
+    timeout.tv_nsec = static_cast<decltype(timeout.tv_nsec)>(
+            Cycles::toNanoseconds(sleepCycles));
+    sys->futexWaitTimeout(reinterpret_cast<int*>(&sleeping), 1, &timeout);
+    sleeping.store(0);
+    PerfStats::threadStats.dispatchSleepCycles += Cycles::rdtsc() - start;
+}
+
+/**
+ * If the dispatch thread is sleeping because it was idle, wake it up
+ * so that it resumes polling. May be invoked from any thread; it is
+ * cheap if the dispatch thread isn't sleeping.
+ */
+void
+Dispatch::wakeup()
+{
+    if ((sleeping.load() != 0) && (sleeping.exchange(0) != 0)) {
+        sys->futexWake(reinterpret_cast<int*>(&sleeping), 1);
+    }
+}
+
 /**
  * Starts execution time profiling of Dispatch::poll() method. 
  *
@@ -406,11 +593,43 @@ Dispatch::Poller::Poller(Dispatch* dispatch, const string& pollerName)
     : owner(dispatch)
     , pollerName(pollerName)
     , slot(downCast<int>(owner->pollers.size()))
+    , invocations(0)
+    , activeInvocations(0)
+    , totalCycles(0)
+    , maxCycles(0)
+    , slowInvocations(0)
+    , cycleHistogram()
 {
     CHECK_LOCK;
     owner->pollers.push_back(this);
 }
 
+/**
+ * Update this poller's statistics after an invocation of #poll.
+ *
+ * \param cycles
+ *      Time spent in the invocation.
+ * \param result
+ *      Value returned by the invocation.
+ */
+void
+Dispatch::Poller::recordInvocation(uint64_t cycles, int result)
+{
+    invocations++;
+    if (result != 0) {
+        activeInvocations++;
+    }
+    totalCycles += cycles;
+    if (cycles > maxCycles) {
+        maxCycles = cycles;
+    }
+    int bucket = (cycles == 0) ? 0 : 63 - __builtin_clzll(cycles);
+    if (bucket >= HISTOGRAM_BUCKETS) {
+        bucket = HISTOGRAM_BUCKETS - 1;
+    }
+    cycleHistogram[bucket]++;
+}
+
 /**
  * Destroy a Poller.
  */
@@ -631,6 +850,7 @@ try {
             // modification of readyFd.
             Fence::sfence();
             owner->readyFd = events[i].data.fd;
+            owner->wakeup();
         }
     }
 } catch (const std::exception& e) {
@@ -668,7 +888,7 @@ Dispatch::fdIsReady(int fd)
  *      Dispatch object that will manage this timer.
  */
 Dispatch::Timer::Timer(Dispatch* dispatch)
-    : owner(dispatch), triggerTime(0), slot(-1)
+    : owner(dispatch), triggerTime(0), slot(-1), links()
 {
 }
 
@@ -682,7 +902,7 @@ Dispatch::Timer::Timer(Dispatch* dispatch)
  *      returned by #Cycles::rdtsc).
  */
 Dispatch::Timer::Timer(Dispatch* dispatch, uint64_t cycles)
-        : owner(dispatch), triggerTime(0), slot(-1)
+        : owner(dispatch), triggerTime(0), slot(-1), links()
 {
     start(cycles);
 }
@@ -731,11 +951,7 @@ Dispatch::Timer::start(uint64_t rdtscTime)
     }
     std::lock_guard<SpinLock> lock(owner->timerMutex);
 
-    triggerTime = rdtscTime;
-    if (slot < 0) {
-        slot = downCast<unsigned>(owner->timers.size());
-        owner->timers.push_back(this);
-    }
+    owner->timers.insert(this, rdtscTime);
     if (triggerTime < owner->earliestTriggerTime) {
         owner->earliestTriggerTime = triggerTime;
     }
@@ -751,19 +967,10 @@ Dispatch::Timer::start(uint64_t rdtscTime)
 void
 Dispatch::Timer::stopInternal(std::lock_guard<SpinLock>& lock)
 {
-    // Remove this Timer from the timers vector by overwriting its slot
-    // with the timer that used to be the last one in the vector.
-    //
-    // Note: this approach using a vector is reentrant.  It is safe
-    // to delete a Timer while executing a timer callback, which means
-    // that Dispatch::poll is in the middle of scanning the list of all
-    // Timers; the worst that will happen is that the Timer that got
-    // moved may be invoked twice in the current scan (but only if it
-    // ran, rescheduled itself, and its new trigger time has passed).
-    owner->timers[slot] = owner->timers.back();
-    owner->timers[slot]->slot = slot;
-    owner->timers.pop_back();
-    slot = -1;
+    // This is safe even while Dispatch::poll is invoking timer handlers:
+    // if this Timer has triggered but hasn't been invoked yet, it just
+    // won't be invoked.
+    owner->timers.remove(this);
 }
 
 /**
@@ -792,6 +999,35 @@ Dispatch::Timer::stop()
  */
 static __thread bool thisThreadHasDispatchLock = false;
 
+/**
+ * Bring the dispatch thread to a halt: wait until it notices #lockNeeded
+ * and stops polling. The caller must hold #mutex; clearing #lockNeeded
+ * lets the dispatch thread resume. This method is invoked by Lock.
+ */
+void
+Dispatch::parkDispatchThread()
+{
+    // It's possible that when we arrive here the dispatch thread hasn't
+    // finished unlocking itself after the previous lock-unlock cycle.
+    // We need to make sure for this to complete; otherwise we could
+    // get confused below and return before the dispatch thread has
+    // re-locked itself.
+    while (locked.load() != 0) {
+        // Empty loop.
+    }
+
+    // The following statements ensure that the preceding load completes
+    // before the following store (reordering could cause deadlock).
+    Fence::sfence();
+    Fence::lfence();
+    lockNeeded.store(1);
+    wakeup();
+    while (locked.load() == 0) {
+        // Empty loop: spin-wait for the dispatch thread to lock itself.
+    }
+    Fence::enter();
+}
+
 /**
  * Construct a Lock object, which means we must lock the dispatch
  * thread unless we are currently executing in the dispatch thread.
@@ -810,25 +1046,17 @@ Dispatch::Lock::Lock(Dispatch* dispatch)
 
     thisThreadHasDispatchLock = true;
     lock.construct(dispatch->mutex);
+    dispatch->parkDispatchThread();
 
-    // It's possible that when we arrive here the dispatch thread hasn't
-    // finished unlocking itself after the previous lock-unlock cycle.
-    // We need to make sure for this to complete; otherwise we could
-    // get confused below and return before the dispatch thread has
-    // re-locked itself.
-    while (dispatch->locked.load() != 0) {
-        // Empty loop.
-    }
-
-    // The following statements ensure that the preceding load completes
-    // before the following store (reordering could cause deadlock).
-    Fence::sfence();
-    Fence::lfence();
-    dispatch->lockNeeded.store(1);
-    while (dispatch->locked.load() == 0) {
-        // Empty loop: spin-wait for the dispatch thread to lock itself.
+    // The list of attached dispatchers can't change while this dispatcher
+    // is locked, and holding dispatch->mutex ensures that no other Lock is
+    // working its way through them (so two Locks can't each wait for a
+    // dispatcher the other has stopped).
+    for (Dispatch* other = dispatch->attached; other != NULL;
+            other = other->attached) {
+        other->mutex.lock();
+        other->parkDispatchThread();
     }
-    Fence::enter();
 }
 
 /**
@@ -846,6 +1074,11 @@ Dispatch::Lock::~Lock()
     assert(thisThreadHasDispatchLock);
 
     Fence::leave();
+    for (Dispatch* other = dispatch->attached; other != NULL;
+            other = other->attached) {
+        other->lockNeeded.store(0);
+        other->mutex.unlock();
+    }
     dispatch->lockNeeded.store(0);
     thisThreadHasDispatchLock = false;
 }
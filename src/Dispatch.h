@@ -27,8 +27,10 @@
 #include "Atomic.h"
 #include "ThreadId.h"
 #include "Tub.h"
+#include "ServerStatistics.pb.h"
 #include "SpinLock.h"
 #include "Syscall.h"
+#include "TimerWheel.h"
 
 namespace RAMCloud {
 
@@ -64,8 +66,16 @@ class Dispatch {
         return (!hasDedicatedThread || ownerId == ThreadId::get());
     }
 
+    void attach(Dispatch* other);
+    void detach(Dispatch* other);
     int poll();
     void run() __attribute__ ((noreturn));
+    void runUntil(const Atomic<int>* stop);
+    void setDedicatedThread(bool dedicated);
+    void setIdleSleepMicros(uint32_t micros);
+    void setStatsIndex(uint32_t index);
+    void getPollerStatistics(ProtoBuf::ServerStatistics* stats);
+    void wakeup();
 
     /// The return value from rdtsc at the beginning of the last call to
     /// #poll.  May be read from multiple threads, so must be volatile.
@@ -112,11 +122,36 @@ class Dispatch {
         string pollerName;
 
       PRIVATE:
+        /// Number of entries in #cycleHistogram.
+        static const int HISTOGRAM_BUCKETS = 32;
+
         /// Index of this Poller in Dispatch::pollers.  Allows deletion
         /// without having to scan all the entries in pollers. -1 means
         /// this poller isn't currently in Dispatch::pollers (happens
         /// after Dispatch::reset).
         int slot;
+
+        // The following statistics are maintained by Dispatch::poll on
+        // every invocation of this poller; see Dispatch::getPollerStatistics.
+
+        /// Number of times #poll has been invoked.
+        uint64_t invocations;
+
+        /// Number of invocations of #poll that returned nonzero.
+        uint64_t activeInvocations;
+
+        /// Total and maximum cycles spent in a single invocation of #poll.
+        uint64_t totalCycles;
+        uint64_t maxCycles;
+
+        /// Number of invocations longer than Dispatch::slowPollerCycles.
+        uint64_t slowInvocations;
+
+        /// Entry i counts invocations that took [2^i, 2^(i+1)) cycles; the
+        /// last entry also counts anything longer.
+        uint64_t cycleHistogram[HISTOGRAM_BUCKETS];
+
+        void recordInvocation(uint64_t cycles, int result);
         friend class Dispatch;
         DISALLOW_COPY_AND_ASSIGN(Poller);
     };
@@ -209,14 +244,18 @@ class Dispatch {
         /// valid if slot >= 0.
         uint64_t triggerTime;
 
-        /// If >= 0 this timer is running, and the value contains the
-        /// index of this Timer in Dispatch::timers. <0 means this
-        /// timer is not currently running, and isn't in Dispatch::timers.
-        /// Among other things, this value allows a timer to be deleted
-        /// without having to scan all the entries in timers.
+        /// If >= 0 this timer is running, and the value identifies the
+        /// list in Dispatch::timers that holds it (managed by TimerWheel).
+        /// <0 means this timer is not currently running, and isn't in
+        /// Dispatch::timers.
         int slot;
 
+        /// Used to link this Timer into one of the lists in
+        /// Dispatch::timers.
+        IntrusiveListHook links;
+
         friend class Dispatch;
+        friend class TimerWheel<Timer>;
         DISALLOW_COPY_AND_ASSIGN(Timer);
     };
 
@@ -230,6 +269,12 @@ class Dispatch {
      * used in the dispatch hread (e.g., if you can't tell which thread will
      * run a particular piece of code). Locks may not be used recursively: a
      * single thread can only create a single Lock object at a time.
+     *
+     * A Lock created in a non-dispatch thread also locks any dispatchers
+     * attached to this one (see Dispatch::attach), so that it excludes all
+     * of the transports of a server with several dispatch threads. Such
+     * Locks must not be created in the dispatch threads of attached
+     * dispatchers.
      */
     class Lock {
       public:
@@ -251,6 +296,13 @@ class Dispatch {
     static void epollThreadMain(Dispatch* owner);
     static bool fdIsReady(int fd);
     void cleanProfiler();
+    void parkDispatchThread();
+    void sleepUntilWork();
+
+    /// Longest time #run will sleep at once when idle. Events that can't
+    /// wake the dispatch thread (e.g. packets arriving on a kernel-bypass
+    /// NIC, or timers started by other threads) may be delayed this long.
+    static const uint32_t MAX_SLEEP_MICROS = 100;
 
     // Keeps track of all of the pollers currently defined.  We don't
     // use an intrusive list here because it isn't reentrant: we need
@@ -295,10 +347,10 @@ class Dispatch {
     // earliestTriggerTime.
     SpinLock timerMutex;
 
-    // Keeps track of all of the timers that are currently active.  We
-    // don't use an intrusive list here because it isn't reentrant: we need
-    // to add/remove elements while the dispatcher is traversing the list.
-    std::vector<Timer*> timers;
+    // Keeps track of all of the timers that are currently active, so
+    // that starting and stopping a timer take constant time and #poll only
+    // has to look at the timers that have actually triggered.
+    TimerWheel<Timer> timers;
 
     // Optimization for timers: no timer will trigger sooner than this time
     // (measured in cycles).
@@ -324,6 +376,16 @@ class Dispatch {
     // Nonzero means the dispatch thread is locked.
     Atomic<int> locked;
 
+    // Nonzero means the dispatch thread is (about to be) blocked in
+    // sleepUntilWork; the thread waits on this word with a futex, so
+    // clearing it and waking the futex (see #wakeup) resumes polling.
+    Atomic<int> sleeping;
+
+    // If #run finds no work for this many cycles, it starts sleeping
+    // between polls instead of spinning (see sleepUntilWork). 0 means
+    // always spin.
+    uint64_t idleSleepCycles;
+
     /**
      * True if there is a thread which owns this dispatch (this is
      * true on RAMCloud servers).
@@ -334,6 +396,17 @@ class Dispatch {
      */
     bool hasDedicatedThread;
 
+    // The first dispatcher attached to this one (see #attach), or NULL. In
+    // an attached dispatcher, this is the next one attached to the same
+    // dispatcher instead. The list is only modified while the dispatcher
+    // it is attached to is locked (or by that dispatcher's thread).
+    Dispatch* attached;
+
+    // Identifies this dispatcher among those of a server (0 for the main
+    // one); selects the entry of PerfStats::dispatchThreadActiveCycles
+    // that #run updates.
+    uint32_t statsIndex;
+
     /**
      * Threshold (in cycles) used to print warnings when the poller loop is taking
      * an unusually long time.
@@ -16,6 +16,7 @@
 #include "TestUtil.h"
 #include "Cycles.h"
 #include "Dispatch.h"
+#include "PerfStats.h"
 #include "MockSyscall.h"
 #include "TransportManager.h"
 #include "WorkerManager.h"
@@ -299,6 +300,24 @@ TEST_F(DispatchTest, destructor) {
     delete f1;
 }
 
+TEST_F(DispatchTest, attachAndDetach) {
+    Dispatch other1(false);
+    Dispatch other2(false);
+    dispatch.attach(&other1);
+    dispatch.attach(&other2);
+    EXPECT_EQ(&other1, dispatch.attached);
+    EXPECT_EQ(&other2, other1.attached);
+    EXPECT_TRUE(other2.attached == NULL);
+
+    dispatch.detach(&other1);
+    EXPECT_EQ(&other2, dispatch.attached);
+    EXPECT_TRUE(other1.attached == NULL);
+    dispatch.detach(&other1);
+    EXPECT_EQ(&other2, dispatch.attached);
+    dispatch.detach(&other2);
+    EXPECT_TRUE(dispatch.attached == NULL);
+}
+
 // Helper function that runs in a separate thread for the following test.
 static void lockTestThread(Dispatch* dispatch, volatile int* flag,
         CountPoller** poller) {
@@ -353,6 +372,47 @@ TEST_F(DispatchTest, poll_locking) {
     thread.join();
 }
 
+TEST_F(DispatchTest, Lock_attachedDispatcher) {
+    Dispatch other(false);
+    CountPoller* counter = NULL;
+    CountPoller* otherCounter = NULL;
+    volatile int flag = 0;
+    volatile int otherFlag = 0;
+    std::thread thread(lockTestThread, &dispatch, &flag, &counter);
+    std::thread otherThread(lockTestThread, &other, &otherFlag,
+            &otherCounter);
+    for (int i = 0; i < 1000; i++) {
+        if ((counter != NULL) && (counter->count >= 10) &&
+                (otherCounter != NULL) && (otherCounter->count >= 10))
+            break;
+        usleep(100);
+    }
+    EXPECT_EQ(1, flag);
+    EXPECT_EQ(1, otherFlag);
+    dispatch.attach(&other);
+
+    // Locking the main dispatcher stops the attached one too.
+    Tub<Dispatch::Lock> lock;
+    lock.construct(&dispatch);
+    EXPECT_EQ(1, other.locked.load());
+    int oldCount = otherCounter->count;
+    usleep(1000);
+    EXPECT_EQ(0, otherCounter->count - oldCount);
+
+    lock.destroy();
+    for (int i = 0; (otherCounter->count == oldCount) && (i < 1000); i++) {
+        usleep(100);
+    }
+    EXPECT_EQ(0, other.lockNeeded.load());
+    EXPECT_GT(otherCounter->count, oldCount);
+
+    dispatch.detach(&other);
+    flag = 0;
+    otherFlag = 0;
+    thread.join();
+    otherThread.join();
+}
+
 TEST_F(DispatchTest, poll_fileHandling) {
     DummyFile *f = new DummyFile("f1", true, pipeFds[0],
             Dispatch::FileEvent::READABLE, &dispatch);
@@ -421,9 +481,10 @@ TEST_F(DispatchTest, poll_triggerTimers) {
     t4.start(170);
     Cycles::mockTscValue = 175;
     EXPECT_EQ(3, dispatch.poll());
-    EXPECT_EQ("timer t4 invoked; timer t2 invoked; "
-                "timer t1 invoked", *localLog);
+    EXPECT_EQ("timer t1 invoked; timer t2 invoked; "
+                "timer t4 invoked", *localLog);
     EXPECT_EQ(180UL, dispatch.earliestTriggerTime);
+    EXPECT_EQ(1U, dispatch.timers.size());
 }
 
 TEST_F(DispatchTest, poll_callEachTimerOnlyOnce) {
@@ -453,22 +514,23 @@ TEST_F(DispatchTest, poll_callEachTimerOnlyOnce) {
 
     // t2 had better be invoked only once, even though it rescheduled
     // itself and is actually runnable.
-    EXPECT_EQ("timer t2 invoked; timer t1 invoked", *localLog);
+    EXPECT_EQ("timer t1 invoked; timer t2 invoked", *localLog);
     localLog->clear();
     dispatch.poll();
     EXPECT_EQ("timer t2 invoked", *localLog);
 }
 
 TEST_F(DispatchTest, poll_handlerDeletesTimers) {
-    // If one timer deletes others, make sure that the loop index doesn't
-    // overflow the length of the "timers" vector.
+    // If one timer deletes others, including one that has triggered but
+    // hasn't been invoked yet, make sure that the deleted timers don't
+    // get invoked.
     DummyTimer t1("t1", &dispatch), t4("t4", &dispatch);
     DummyTimer* t2 = new DummyTimer("t2", &dispatch);
     DummyTimer* t3 = new DummyTimer("t3", &dispatch);
+    t4.start(140);
     t1.start(150);
     t2->start(160);
     t3->start(180);
-    t4.start(170);
     t4.deleteWhenInvoked(t2);
     t4.deleteWhenInvoked(t3);
     Cycles::mockTscValue = 175;
@@ -479,6 +541,38 @@ TEST_F(DispatchTest, poll_handlerDeletesTimers) {
 // No tests for Dispatch::run: it doesn't return, so can't test (it's
 // pretty simple anyway).
 
+TEST_F(DispatchTest, sleepUntilWork) {
+    // Work already pending: don't sleep at all.
+    uint64_t before = PerfStats::threadStats.dispatchSleepCycles;
+    dispatch.earliestTriggerTime = ~0lu;
+    dispatch.readyFd = 5;
+    dispatch.sleepUntilWork();
+    EXPECT_EQ(before, PerfStats::threadStats.dispatchSleepCycles);
+    EXPECT_EQ(0, dispatch.sleeping.load());
+
+    // A timer about to fire: don't sleep either.
+    dispatch.readyFd = -1;
+    dispatch.earliestTriggerTime = 0;
+    dispatch.sleepUntilWork();
+    EXPECT_EQ(before, PerfStats::threadStats.dispatchSleepCycles);
+
+    // Nothing to do: sleep until the timeout.
+    dispatch.earliestTriggerTime = ~0lu;
+    dispatch.sleepUntilWork();
+    EXPECT_LT(before, PerfStats::threadStats.dispatchSleepCycles);
+    EXPECT_EQ(0, dispatch.sleeping.load());
+}
+
+TEST_F(DispatchTest, wakeup) {
+    // Not sleeping: nothing happens.
+    dispatch.wakeup();
+    EXPECT_EQ(0, dispatch.sleeping.load());
+
+    dispatch.sleeping.store(1);
+    dispatch.wakeup();
+    EXPECT_EQ(0, dispatch.sleeping.load());
+}
+
 // Helper function that runs in a separate thread for the following test.
 static void checkDispatchThread(Dispatch* dispatch, bool* result) {
     *result = dispatch->isDispatchThread();
@@ -491,6 +585,22 @@ TEST_F(DispatchTest, isDispatchThread) {
     EXPECT_FALSE(childResult);
 }
 
+// Helper function that runs in a separate thread for the following test.
+static void takeDispatchThread(Dispatch* dispatch) {
+    dispatch->setDedicatedThread(true);
+}
+TEST_F(DispatchTest, setDedicatedThread) {
+    std::thread(takeDispatchThread, &dispatch).join();
+    EXPECT_FALSE(dispatch.isDispatchThread());
+    dispatch.setDedicatedThread(false);
+    EXPECT_TRUE(dispatch.isDispatchThread());
+    dispatch.setDedicatedThread(true);
+    EXPECT_TRUE(dispatch.isDispatchThread());
+    bool childResult = true;
+    std::thread(checkDispatchThread, &dispatch, &childResult).join();
+    EXPECT_FALSE(childResult);
+}
+
 // The following test exercises most of the functionality related to
 // pollers (creation, deletion, invocation).
 TEST_F(DispatchTest, Poller_basics) {
@@ -534,6 +644,48 @@ TEST_F(DispatchTest, Poller_reentrant) {
             *localLog);
 }
 
+TEST_F(DispatchTest, Poller_statistics) {
+    DummyPoller p1("p1", 1, &dispatch);
+    dispatch.poll();
+    dispatch.poll();
+    dispatch.poll();
+    EXPECT_EQ(3U, p1.invocations);
+    EXPECT_EQ(2U, p1.activeInvocations);
+    EXPECT_GE(p1.totalCycles, p1.maxCycles);
+    uint64_t histogramTotal = 0;
+    for (int i = 0; i < Dispatch::Poller::HISTOGRAM_BUCKETS; i++) {
+        histogramTotal += p1.cycleHistogram[i];
+    }
+    EXPECT_EQ(3U, histogramTotal);
+    EXPECT_EQ(0U, p1.slowInvocations);
+}
+
+TEST_F(DispatchTest, Poller_slowInvocation) {
+    DummyPoller p1("p1", 0, &dispatch);
+    dispatch.slowPollerCycles = 0;
+    dispatch.poll();
+    EXPECT_EQ(1U, p1.slowInvocations);
+    EXPECT_TRUE(TestUtil::contains(TestLog::get(),
+            "poll: Poller DummyPoller took"));
+}
+
+TEST_F(DispatchTest, getPollerStatistics) {
+    DummyPoller p1("p1", 0, &dispatch);
+    dispatch.poll();
+    dispatch.poll();
+    ProtoBuf::ServerStatistics stats;
+    dispatch.getPollerStatistics(&stats);
+    ASSERT_EQ(1, stats.poller_stats_size());
+    const ProtoBuf::ServerStatistics::PollerStats& entry =
+            stats.poller_stats(0);
+    EXPECT_EQ("DummyPoller", entry.name());
+    EXPECT_EQ(2U, entry.invocations());
+    EXPECT_EQ(2U, entry.active_invocations());
+    EXPECT_EQ(Dispatch::Poller::HISTOGRAM_BUCKETS,
+            entry.cycle_histogram_size());
+    EXPECT_EQ(Cycles::perSecond(), stats.cycles_per_second());
+}
+
 TEST_F(DispatchTest, File_constructor_errorInEpollCreate) {
     sys->epollCreateErrno = EPERM;
     try {
@@ -782,7 +934,7 @@ TEST_F(DispatchTest, Timer_constructorDestructor) {
     DummyTimer* t2 = new DummyTimer("t2", 100, &dispatch);
     EXPECT_EQ(1U, dispatch.timers.size());
     EXPECT_EQ(-1, t1->slot);
-    EXPECT_EQ(0, t2->slot);
+    EXPECT_LE(0, t2->slot);
     EXPECT_EQ(100UL, t2->triggerTime);
     delete t1;
     delete t2;
@@ -818,14 +970,17 @@ TEST_F(DispatchTest, Timer_start) {
     dispatch.earliestTriggerTime = 200;
     t1.start(210);
     EXPECT_EQ(210UL, t1.triggerTime);
-    EXPECT_EQ(0, t1.slot);
+    EXPECT_LE(0, t1.slot);
     EXPECT_EQ(200UL, dispatch.earliestTriggerTime);
     t2.start(190);
     EXPECT_EQ(190UL, dispatch.earliestTriggerTime);
-    EXPECT_EQ(1, t2.slot);
+    EXPECT_LE(0, t2.slot);
+    EXPECT_EQ(2U, dispatch.timers.size());
     t1.start(300);
     EXPECT_EQ(300UL, t1.triggerTime);
-    EXPECT_EQ(0, t1.slot);
+    EXPECT_LE(0, t1.slot);
+    EXPECT_EQ(2U, dispatch.timers.size());
+    EXPECT_EQ(190UL, dispatch.timers.earliest());
 }
 
 TEST_F(DispatchTest, Timer_start_dispatchDeleted) {
@@ -842,11 +997,12 @@ TEST_F(DispatchTest, Timer_stop) {
     DummyTimer t1("t1", 100, &dispatch);
     DummyTimer t2("t2", 100, &dispatch);
     DummyTimer t3("t3", 100, &dispatch);
-    EXPECT_EQ(0, t1.slot);
+    EXPECT_LE(0, t1.slot);
     t1.stop();
     EXPECT_EQ(-1, t1.slot);
     EXPECT_EQ(2U, dispatch.timers.size());
-    EXPECT_EQ(0, t3.slot);
+    EXPECT_TRUE(t2.isRunning());
+    EXPECT_TRUE(t3.isRunning());
     t1.stop();
     EXPECT_EQ(-1, t1.slot);
     EXPECT_EQ(2U, dispatch.timers.size());
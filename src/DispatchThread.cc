@@ -0,0 +1,251 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "DispatchThread.h"
+#include "ServiceLocator.h"
+#include "TransportManager.h"
+#include "WorkerManager.h"
+
+namespace RAMCloud {
+
+__thread DispatchThread* DispatchThread::current = NULL;
+
+/**
+ * Construct a DispatchThread; its thread doesn't run until #start is
+ * invoked.
+ *
+ * \param mainContext
+ *      The server's main context; RPCs received by this thread are handled
+ *      by its WorkerManager.
+ * \param index
+ *      Identifies this thread among the server's dispatch threads (the
+ *      main one is 0); used to report its load in PerfStats.
+ */
+DispatchThread::DispatchThread(Context* mainContext, uint32_t index)
+    : mainContext(mainContext)
+    , context(true)
+    , index(index)
+    , replies(4096)
+    , unforwardedRpcs()
+    , manager(NULL)
+    , poller()
+    , thread()
+    , running(0)
+    , exiting(0)
+{
+    context.dispatch->setStatsIndex(index);
+    poller.construct(this);
+
+    // Memory that the server registers with its transports (such as the
+    // log) must be registered with this thread's transports as well.
+    mainContext->transportManager->addPeer(context.transportManager);
+}
+
+/**
+ * Destructor: stops the thread (if it was started). RPCs that are still
+ * in progress are abandoned.
+ */
+DispatchThread::~DispatchThread()
+{
+    if (thread) {
+        // Detach first: once the thread has exited, a lock of the main
+        // dispatcher would wait for it forever.
+        mainContext->dispatch->detach(context.dispatch);
+        exiting.store(1);
+        context.dispatch->wakeup();
+        thread->join();
+        thread.destroy();
+        context.dispatch->setDedicatedThread(true);
+    }
+    mainContext->transportManager->removePeer(context.transportManager);
+    poller.destroy();
+
+    // The WorkerManager belongs to the main context.
+    context.workerManager = NULL;
+}
+
+/**
+ * This method is invoked by WorkerManager::handleRpc, in this thread, for
+ * each incoming RPC; it passes the RPC to the main dispatch thread, where
+ * the WorkerManager schedules it in the usual way. Its reply will be sent
+ * from this thread.
+ *
+ * \param manager
+ *      The WorkerManager that will handle the RPC.
+ * \param rpc
+ *      An incoming RPC received by one of this thread's transports.
+ */
+void
+DispatchThread::forwardRpc(WorkerManager* manager,
+        Transport::ServerRpc* rpc)
+{
+    rpc->dispatchThread = this;
+    this->manager = manager;
+
+    // Keep RPCs in order: if earlier RPCs are still waiting for room in
+    // the WorkerManager's queue, this one has to wait behind them.
+    if (unforwardedRpcs.empty() && manager->postRpc(rpc))
+        return;
+    unforwardedRpcs.push_back(rpc);
+}
+
+/**
+ * Create transports for this thread to listen on. This method must be
+ * invoked before #start.
+ *
+ * \param locators
+ *      Service locators for the transports to create; see
+ *      TransportManager::initialize.
+ * \return
+ *      The locators by which clients can reach the new transports.
+ */
+string
+DispatchThread::listen(const string& locators)
+{
+    assert(!thread);
+    context.transportManager->initialize(locators.c_str());
+    return context.transportManager->getListeningLocatorsString();
+}
+
+/**
+ * Send the reply for an RPC from the dispatch thread whose transport
+ * received it. This must be used instead of Transport::ServerRpc::sendReply
+ * for any RPC that was handed to the WorkerManager.
+ *
+ * \param rpc
+ *      The RPC whose reply is complete.
+ */
+void
+DispatchThread::sendReply(Transport::ServerRpc* rpc)
+{
+    DispatchThread* thread = rpc->dispatchThread;
+    if ((thread == NULL) || (thread == current)) {
+        rpc->sendReply();
+        return;
+    }
+
+    // The ring only fills up if the other thread falls behind for a while;
+    // it never waits for this thread, so spinning here can't deadlock.
+    while (!thread->replies.push(rpc)) {
+        // Empty loop.
+    }
+    thread->context.dispatch->wakeup();
+}
+
+/**
+ * Divide a server's listening locators among a number of dispatch
+ * threads. The locators are dealt out in turn, so each protocol is spread
+ * over as many threads as possible.
+ *
+ * \param locators
+ *      A semicolon-separated list of service locators (the server's
+ *      ServerConfig::localLocator).
+ * \param count
+ *      Number of dispatch threads.
+ * \return
+ *      One semicolon-separated list of locators for each thread that got
+ *      any; the first is for the main dispatch thread. There are fewer than
+ *      \a count entries if there are fewer than \a count locators.
+ */
+std::vector<string>
+DispatchThread::splitLocators(const string& locators, uint32_t count)
+{
+    std::vector<string> groups(std::max(count, 1u));
+    std::vector<ServiceLocator> parsed =
+            ServiceLocator::parseServiceLocators(locators);
+    for (size_t i = 0; i < parsed.size(); i++) {
+        string& group = groups[i % groups.size()];
+        if (!group.empty())
+            group += ";";
+        group += parsed[i].getOriginalString();
+    }
+    while ((groups.size() > 1) && groups.back().empty())
+        groups.pop_back();
+    return groups;
+}
+
+/**
+ * Start polling this thread's transports. The main context's WorkerManager
+ * and services must have been created already.
+ */
+void
+DispatchThread::start()
+{
+    assert(!thread);
+    context.workerManager = mainContext->workerManager;
+    context.serverList = mainContext->serverList;
+    for (size_t i = 0; i < WireFormat::INVALID_SERVICE; i++)
+        context.services[i] = mainContext->services[i];
+
+    thread.construct(threadMain, this);
+    while (running.load() == 0) {
+        // Empty loop: wait for the thread to take over the dispatcher.
+    }
+    mainContext->dispatch->attach(context.dispatch);
+}
+
+/**
+ * The top-level method of the thread.
+ *
+ * \param thread
+ *      The DispatchThread being run.
+ */
+void
+DispatchThread::threadMain(DispatchThread* thread)
+{
+    current = thread;
+    thread->context.dispatch->setDedicatedThread(true);
+    thread->running.store(1);
+    thread->context.dispatch->runUntil(&thread->exiting);
+}
+
+/**
+ * Construct a ReplyPoller.
+ *
+ * \param thread
+ *      The DispatchThread whose replies this poller sends.
+ */
+DispatchThread::ReplyPoller::ReplyPoller(DispatchThread* thread)
+    : Dispatch::Poller(thread->context.dispatch, "DispatchThread")
+    , thread(thread)
+{
+}
+
+/**
+ * Send the replies that are ready, and retry forwarding RPCs that
+ * didn't fit in the WorkerManager's queue earlier.
+ *
+ * \return
+ *      1 if any work was done, 0 otherwise.
+ */
+int
+DispatchThread::ReplyPoller::poll()
+{
+    int result = 0;
+    Transport::ServerRpc* rpc;
+    while (thread->replies.pop(&rpc)) {
+        rpc->sendReply();
+        result = 1;
+    }
+    while (!thread->unforwardedRpcs.empty()) {
+        if (!thread->manager->postRpc(thread->unforwardedRpcs.front()))
+            break;
+        thread->unforwardedRpcs.pop_front();
+        result = 1;
+    }
+    return result;
+}
+
+} // namespace RAMCloud
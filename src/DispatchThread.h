@@ -0,0 +1,141 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_DISPATCHTHREAD_H
+#define RAMCLOUD_DISPATCHTHREAD_H
+
+#include <thread>
+#include <deque>
+
+#include "Common.h"
+#include "Context.h"
+#include "Dispatch.h"
+#include "MpscRing.h"
+#include "Transport.h"
+#include "Tub.h"
+
+namespace RAMCloud {
+
+class WorkerManager;
+
+/**
+ * An additional dispatcher for a server, with its own thread, which polls
+ * some of the server's listening transports. All of a transport's packet
+ * processing happens in the thread that polls it, so a single dispatch
+ * thread limits how many small RPCs a server can handle no matter how many
+ * worker cores are idle; spreading the listening locators over several
+ * dispatch threads (see ServerConfig::dispatchThreads and splitLocators)
+ * removes that bottleneck.
+ *
+ * Each DispatchThread has a Context of its own, with its own Dispatch and
+ * TransportManager, and the transports created through #listen are polled
+ * only by this thread. RPCs that arrive on them are still scheduled by the
+ * server's one WorkerManager: WorkerManager::handleRpc passes them to the
+ * main dispatch thread, and their replies are passed back here to be sent
+ * (see sendReply). Neither thread ever waits for the other. The main
+ * dispatcher has this one attached to it (see Dispatch::attach), so a
+ * Dispatch::Lock on the main dispatcher excludes these transports too.
+ *
+ * The transports of a DispatchThread only receive requests; RPCs that the
+ * server sends to other servers use the main context's transports.
+ */
+class DispatchThread {
+  PUBLIC:
+    DispatchThread(Context* mainContext, uint32_t index);
+    ~DispatchThread();
+    void forwardRpc(WorkerManager* manager, Transport::ServerRpc* rpc);
+    string listen(const string& locators);
+    static void sendReply(Transport::ServerRpc* rpc);
+    static std::vector<string> splitLocators(const string& locators,
+            uint32_t count);
+    void start();
+
+    /**
+     * Return the DispatchThread whose thread is executing the caller, or
+     * NULL if the caller isn't running in one.
+     */
+    static DispatchThread*
+    getCurrent()
+    {
+        return current;
+    }
+
+  PRIVATE:
+    /**
+     * Runs in the DispatchThread's dispatcher: sends the replies passed
+     * to sendReply, and retries forwarding RPCs that didn't fit in the
+     * WorkerManager's queue.
+     */
+    class ReplyPoller : public Dispatch::Poller {
+      public:
+        explicit ReplyPoller(DispatchThread* thread);
+        int poll();
+
+      PRIVATE:
+        /// The DispatchThread this poller belongs to.
+        DispatchThread* thread;
+
+        DISALLOW_COPY_AND_ASSIGN(ReplyPoller);
+    };
+
+    static void threadMain(DispatchThread* thread);
+
+    /// The server's main context; its dispatcher and WorkerManager are
+    /// shared with this thread.
+    Context* mainContext;
+
+    /// This thread's own context. Its workerManager is the main context's
+    /// (but isn't owned here), and its dispatcher and TransportManager
+    /// belong to this thread.
+    Context context;
+
+    /// Identifies this thread among the server's dispatch threads (the
+    /// main one is 0); see Dispatch::setStatsIndex.
+    uint32_t index;
+
+    /// RPCs whose replies are ready to be sent by this thread (see
+    /// sendReply).
+    MpscRing<Transport::ServerRpc*> replies;
+
+    /// RPCs that arrived on this thread's transports but haven't been
+    /// accepted by the WorkerManager yet, because its queue was full.
+    /// Only used by this thread.
+    std::deque<Transport::ServerRpc*> unforwardedRpcs;
+
+    /// The WorkerManager the RPCs in #unforwardedRpcs are for.
+    WorkerManager* manager;
+
+    /// Invoked by this thread's dispatcher.
+    Tub<ReplyPoller> poller;
+
+    /// Polls #context's dispatcher, once #start has been invoked.
+    Tub<std::thread> thread;
+
+    /// Set by the thread once it owns #context's dispatcher.
+    Atomic<int> running;
+
+    /// Set to ask the thread to exit.
+    Atomic<int> exiting;
+
+    /// The DispatchThread whose thread is executing, if any (see
+    /// getCurrent).
+    static __thread DispatchThread* current;
+
+    DISALLOW_COPY_AND_ASSIGN(DispatchThread);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_DISPATCHTHREAD_H
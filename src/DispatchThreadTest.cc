@@ -0,0 +1,134 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "DispatchThread.h"
+#include "MockService.h"
+#include "MockTransport.h"
+#include "WorkerManager.h"
+
+namespace RAMCloud {
+
+class DispatchThreadTest : public ::testing::Test {
+  public:
+    Context context;
+    Tub<WorkerManager> manager;
+    MockTransport transport;
+    MockService service;
+    DispatchThread thread;
+    TestLog::Enable logEnabler;
+
+    DispatchThreadTest()
+        : context()
+        , manager()
+        , transport(&context)
+        , service()
+        , thread(&context, 1)
+        , logEnabler()
+    {
+        manager.construct(&context, 2);
+        context.services[WireFormat::BACKUP_SERVICE] = &service;
+    }
+
+    ~DispatchThreadTest()
+    {
+        DispatchThread::current = NULL;
+        manager.destroy();
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(DispatchThreadTest);
+};
+
+TEST_F(DispatchThreadTest, forwardRpc_replySentByThread) {
+    MockTransport::MockServerRpc* rpc = new MockTransport::MockServerRpc(
+            &transport, "0x10000 3 4");
+    DispatchThread::current = &thread;
+    manager->handleRpc(rpc);
+    DispatchThread::current = NULL;
+    EXPECT_EQ(&thread, rpc->dispatchThread);
+    EXPECT_EQ("", service.log);
+
+    // The main dispatcher picks up the RPC, but the reply waits for the
+    // thread that received it.
+    int sent = 0;
+    for (int i = 0; i < 1000; i++) {
+        context.dispatch->poll();
+        EXPECT_EQ("", transport.outputLog);
+        sent = thread.poller->poll();
+        if (sent > 0)
+            break;
+        usleep(1000);
+    }
+    EXPECT_EQ(1, sent);
+    EXPECT_EQ("rpc: 0x10000 3 4", service.log);
+    EXPECT_EQ("serverReply: 0x10001 4 5", transport.outputLog);
+    EXPECT_EQ(0, thread.poller->poll());
+}
+
+TEST_F(DispatchThreadTest, forwardRpc_workerManagerFull) {
+    MockTransport::MockServerRpc rpc(&transport, "0x10000 3 4");
+    while (manager->postRpc(&rpc)) {
+        // Empty loop: fill the WorkerManager's queue.
+    }
+    MockTransport::MockServerRpc* rpc2 = new MockTransport::MockServerRpc(
+            &transport, "0x10000 3 4");
+    thread.forwardRpc(manager.get(), rpc2);
+    EXPECT_EQ(1U, thread.unforwardedRpcs.size());
+    EXPECT_EQ(0, thread.poller->poll());
+
+    Transport::ServerRpc* next;
+    EXPECT_TRUE(manager->incomingRpcs.pop(&next));
+    EXPECT_EQ(1, thread.poller->poll());
+    EXPECT_EQ(0U, thread.unforwardedRpcs.size());
+    while (manager->incomingRpcs.pop(&next)) {
+        // Empty loop: drain the queue, so the WorkerManager dies quietly.
+    }
+    EXPECT_EQ(rpc2, next);
+    delete rpc2;
+}
+
+TEST_F(DispatchThreadTest, sendReply) {
+    MockTransport::MockServerRpc* rpc = new MockTransport::MockServerRpc(
+            &transport, "0x10000 3 4");
+    DispatchThread::sendReply(rpc);
+    EXPECT_EQ("serverReply: ", transport.outputLog.substr(0, 13));
+
+    // Replies for RPCs received by the current thread are sent directly.
+    transport.outputLog.clear();
+    rpc = new MockTransport::MockServerRpc(&transport, "0x10000 3 4");
+    rpc->dispatchThread = &thread;
+    DispatchThread::current = &thread;
+    DispatchThread::sendReply(rpc);
+    EXPECT_EQ("serverReply: ", transport.outputLog.substr(0, 13));
+    EXPECT_EQ(0, thread.poller->poll());
+}
+
+TEST_F(DispatchThreadTest, splitLocators) {
+    EXPECT_EQ("mock:host=a;mock:host=b",
+            DispatchThread::splitLocators("mock:host=a;mock:host=b", 1)[0]);
+
+    std::vector<string> groups = DispatchThread::splitLocators(
+            "mock:host=a;mock:host=b;mock:host=c", 2);
+    ASSERT_EQ(2U, groups.size());
+    EXPECT_EQ("mock:host=a;mock:host=c", groups[0]);
+    EXPECT_EQ("mock:host=b", groups[1]);
+
+    // Threads without locators are left out.
+    groups = DispatchThread::splitLocators("mock:host=a", 4);
+    ASSERT_EQ(1U, groups.size());
+    EXPECT_EQ("mock:host=a", groups[0]);
+}
+
+}  // namespace RAMCloud
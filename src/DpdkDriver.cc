@@ -141,7 +141,14 @@ DpdkDriver::DpdkDriver(Context* context,
                 localMac->toString().c_str(), portId);
     }
 
-    // configure some default NIC port parameters
+    // configure some default NIC port parameters. Note: we deliberately
+    // use a single RX/TX queue pair. Every transport in a process is owned
+    // by the one dispatch thread (all of Transport, Driver, and
+    // WorkerManager rely on Dispatch::Lock for synchronization), so
+    // additional queues would all be drained by the same core and RSS
+    // would buy nothing. Spreading packet processing across cores needs
+    // per-core dispatch loops first; until then, run multiple servers per
+    // host to use more cores for networking.
     memset(&portConf, 0, sizeof(portConf));
     portConf.rxmode.max_rx_pkt_len = MAX_PAYLOAD_SIZE +
             sizeof(NetUtil::EthernetHeader);
@@ -207,6 +214,7 @@ DpdkDriver::DpdkDriver(Context* context,
  */
 DpdkDriver::~DpdkDriver()
 {
+    releaseDeferred();
     if (packetBufsUtilized != 0)
         LOG(ERROR, "DpdkDriver deleted with %d packets still in use",
             packetBufsUtilized);
@@ -248,17 +256,31 @@ DpdkDriver::getMaxPacketSize()
 
 void
 DpdkDriver::release(char *payload)
+{
+    // Packets released in workers are returned in batches by the dispatch
+    // thread.
+    if (deferRelease(context->dispatch, payload)) {
+        return;
+    }
+    releaseBatch(&payload, 1);
+}
+
+// See docs in Driver class.
+void
+DpdkDriver::releaseBatch(char** payloads, uint32_t count)
 {
     // Must sync with the dispatch thread, since this method could potentially
     // be invoked in a worker.
     Dispatch::Lock _(context->dispatch);
 
-    // Note: the payload is actually contained in a PacketBuf structure,
+    // Note: each payload is actually contained in a PacketBuf structure,
     // which we return to a pool for reuse later.
-    packetBufsUtilized--;
-    assert(packetBufsUtilized >= 0);
-    packetBufPool.destroy(
-        reinterpret_cast<PacketBuf*>(payload - OFFSET_OF(PacketBuf, payload)));
+    for (uint32_t i = 0; i < count; i++) {
+        packetBufsUtilized--;
+        assert(packetBufsUtilized >= 0);
+        packetBufPool.destroy(reinterpret_cast<PacketBuf*>(
+                payloads[i] - OFFSET_OF(PacketBuf, payload)));
+    }
 }
 
 // See docs in Driver class.
@@ -330,6 +352,8 @@ DpdkDriver::Poller::poll()
     // keeping a limited number of packet buffers on stack.
     struct rte_mbuf* mPkts[MAX_MBUFS_ON_STACK];
 
+    driver->releaseDeferred();
+
     // attempt to dequeue a batch of received packets from the NIC
     // as well as from the loopback ring.
     uint32_t incomingPkts = rte_eth_rx_burst(driver->portId, 0, mPkts,
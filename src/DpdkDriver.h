@@ -59,6 +59,7 @@ class DpdkDriver : public Driver
     virtual void disconnect();
     virtual uint32_t getMaxPacketSize();
     virtual void release(char *payload);
+    virtual void releaseBatch(char** payloads, uint32_t count);
     virtual void sendPacket(const Address *addr,
                             const void *header,
                             uint32_t headerLen,
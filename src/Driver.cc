@@ -13,11 +13,22 @@
  * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include "Dispatch.h"
 #include "Driver.h"
 
 namespace RAMCloud {
 
+/// Constructor for Drivers: there are no packets waiting to be released.
+Driver::Driver()
+    : deferredMutex("Driver::deferredMutex")
+    , deferredPayloads()
+    , deferredCount(0)
+{
+}
+
 /// Virtual destructor needed since this serves as an abstract base class.
+/// Subclasses whose release methods defer packets must invoke
+/// releaseDeferred in their destructors.
 Driver::~Driver()
 {
 }
@@ -35,12 +46,83 @@ Driver::release(char *payload)
 {
 }
 
+/**
+ * Return ownership of several packet buffers back to the driver at once.
+ * Drivers that must synchronize to recycle packet buffers override this
+ * to do so once for the whole batch; the default just invokes #release
+ * for each packet.
+ *
+ * \param payloads
+ *      The payload of each packet, as for #release.
+ * \param count
+ *      Number of entries in payloads.
+ */
+void
+Driver::releaseBatch(char** payloads, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        release(payloads[i]);
+    }
+}
+
+/**
+ * Drivers whose packet buffers may only be recycled in the dispatch thread
+ * invoke this at the start of #release. In any other thread the packet is
+ * saved for the dispatch thread to release later, in a batch, when the
+ * driver invokes #releaseDeferred; this is much cheaper than making the
+ * caller wait for the dispatch thread with a Dispatch::Lock, which is
+ * otherwise needed for every packet of every message freed by a worker or
+ * application thread.
+ *
+ * \param dispatch
+ *      Dispatcher whose thread owns the driver's packet buffers.
+ * \param payload
+ *      The packet being released.
+ * \return
+ *      True means the packet was saved, so the caller has nothing more to
+ *      do; false means the caller is running in the dispatch thread and
+ *      should release the packet now.
+ */
+bool
+Driver::deferRelease(Dispatch* dispatch, char* payload)
+{
+    if (dispatch->isDispatchThread()) {
+        return false;
+    }
+    std::lock_guard<SpinLock> _(deferredMutex);
+    deferredPayloads.push_back(payload);
+    deferredCount.store(downCast<uint32_t>(deferredPayloads.size()),
+            std::memory_order_release);
+    return true;
+}
+
+/**
+ * Release, with a single call to #releaseBatch, all of the packets saved
+ * by #deferRelease. Drivers invoke this from the dispatch thread whenever
+ * they poll for incoming packets, and in their destructors.
+ */
+void
+Driver::releaseDeferred()
+{
+    if (deferredCount.load(std::memory_order_acquire) == 0) {
+        return;
+    }
+    std::vector<char*> payloads;
+    {
+        std::lock_guard<SpinLock> _(deferredMutex);
+        payloads.swap(deferredPayloads);
+        deferredCount.store(0, std::memory_order_release);
+    }
+    releaseBatch(&payloads[0], downCast<uint32_t>(payloads.size()));
+}
+
 /// Construct a received containing no data and unassociated with a Driver.
 Driver::Received::Received()
     :  sender(NULL)
     , driver(0)
     , len(0)
     , payload(0)
+    , arrivalTime(0)
 {
 }
 
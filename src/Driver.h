@@ -16,15 +16,19 @@
 #ifndef RAMCLOUD_DRIVER_H
 #define RAMCLOUD_DRIVER_H
 
+#include <atomic>
 #include <memory>
+#include <vector>
 #include "Common.h"
 #include "Buffer.h"
+#include "SpinLock.h"
 
 #undef CURRENT_LOG_MODULE
 #define CURRENT_LOG_MODULE RAMCloud::TRANSPORT_MODULE
 
 namespace RAMCloud {
 
+class Dispatch;
 class ServiceLocator;
 
 /**
@@ -99,6 +103,13 @@ class Driver {
         /// for it.
         char *payload;
 
+        /// Cycles::rdtsc() time when the packet arrived at this machine,
+        /// according to a hardware (or, failing that, kernel) receive
+        /// timestamp, so that time the packet spent queued in the NIC and
+        /// kernel can be told apart from time spent in RAMCloud. 0 means
+        /// the driver has no timestamp for the packet.
+        uint64_t arrivalTime;
+
       private:
         DISALLOW_COPY_AND_ASSIGN(Received);
     };
@@ -147,6 +158,7 @@ class Driver {
     };
 
 
+    Driver();
     virtual ~Driver();
 
     /// \copydoc Transport::dumpStats
@@ -169,6 +181,8 @@ class Driver {
      */
     virtual void release(char *payload);
 
+    virtual void releaseBatch(char** payloads, uint32_t count);
+
     /**
      * Invoked by a transport to associate itself with this
      * driver, so that the driver can invoke the transport's
@@ -285,6 +299,24 @@ class Driver {
      * other hosts to contact dynamically addressed services.
      */
     virtual string getServiceLocator() = 0;
+
+  protected:
+    bool deferRelease(Dispatch* dispatch, char* payload);
+    void releaseDeferred();
+
+  private:
+    /// Protects deferredPayloads.
+    SpinLock deferredMutex;
+
+    /// Packets released by threads other than the dispatch thread, which
+    /// haven't yet been returned to the driver (see #deferRelease).
+    std::vector<char*> deferredPayloads;
+
+    /// Number of entries in deferredPayloads; lets the dispatch thread
+    /// check for them without acquiring deferredMutex.
+    std::atomic<uint32_t> deferredCount;
+
+    DISALLOW_COPY_AND_ASSIGN(Driver);
 };
 
 /**
@@ -124,30 +124,51 @@ enumerateBucket(uint64_t reference, void* cookie)
  *      and data. True means that the returned objects have
  *      been truncated so that the object data (normally the last
  *      field of the object) is omitted.       
+ * \param filter
+ *      If non-NULL, objects that don't match this filter are skipped, and
+ *      the others are returned with just the part of their value that the
+ *      filter selects.
  */
 static int64_t
 appendObjectsToBuffer(Log& log,
                       Buffer* buffer,
                       std::vector<Log::Reference>& references,
-                      uint32_t maxBytes, bool keysOnly)
+                      uint32_t maxBytes, bool keysOnly,
+                      const ObjectFilter* filter)
 {
     for (uint32_t index = 0; index < references.size(); index++) {
         Buffer objectBuffer;
         log.getEntry(references[index], objectBuffer);
 
         Object object(objectBuffer);
-        uint32_t length = objectBuffer.size();
+        if (filter != NULL && !filter->matches(&object))
+            continue;
+
+        // The value is the last field of the object, so a projection is the
+        // object truncated after its keys, followed by part of the value.
+        uint32_t dataLength = object.getValueLength();
+        uint32_t length = objectBuffer.size() - dataLength;
+        uint32_t projectionOffset = 0;
+        uint32_t projectionLength = dataLength;
         if (keysOnly) {
-            uint32_t dataLength = object.getValueLength();
-            length -= dataLength;
+            projectionLength = 0;
+        } else if (filter != NULL) {
+            projectionLength = filter->project(dataLength, &projectionOffset);
         }
 
-        if (buffer->size() + sizeof(length) + length > maxBytes) {
+        if (buffer->size() + sizeof(length) + length + projectionLength
+                > maxBytes) {
             return index;
         }
 
-        buffer->emplaceAppend<uint32_t>(length);
-        buffer->append(&objectBuffer, 0, length);
+        buffer->emplaceAppend<uint32_t>(length + projectionLength);
+        if (projectionOffset == 0) {
+            buffer->append(&objectBuffer, 0, length + projectionLength);
+        } else {
+            buffer->append(&objectBuffer, 0, length);
+            buffer->append(&objectBuffer, length + projectionOffset,
+                    projectionLength);
+        }
     }
 
     return -1;
@@ -234,6 +255,10 @@ class ObjectHashComparator {
  *      A Buffer to hold the resulting objects.
  * \param maxPayloadBytes
  *      The maximum number of bytes of objects to be returned.
+ * \param filter
+ *      If non-NULL, only objects matching this filter are returned, with
+ *      just the part of their values that it selects. The filter must
+ *      remain valid until #complete returns.
  */
 Enumeration::Enumeration(uint64_t tableId,
                          bool keysOnly,
@@ -244,7 +269,8 @@ Enumeration::Enumeration(uint64_t tableId,
                          EnumerationIterator& iter,
                          Log& log,
                          HashTable& objectMap,
-                         Buffer& payload, uint32_t maxPayloadBytes)
+                         Buffer& payload, uint32_t maxPayloadBytes,
+                         const ObjectFilter* filter)
     : tableId(tableId)
     , keysOnly(keysOnly)
     , requestedTabletStartHash(requestedTabletStartHash)
@@ -256,6 +282,7 @@ Enumeration::Enumeration(uint64_t tableId,
     , objectMap(objectMap)
     , payload(payload)
     , maxPayloadBytes(maxPayloadBytes)
+    , filter(filter)
 {
 }
 
@@ -282,8 +309,10 @@ Enumeration::complete()
         iter.push(frame);
     }
 
+    // Use the table size recorded in the iterator: the table may be growing
+    // concurrently, and the iterator must describe the size we enumerated.
     uint64_t bucketIndex = iter.top().bucketIndex;
-    uint64_t numBuckets = objectMap.getNumBuckets();
+    uint64_t numBuckets = iter.top().numBuckets;
     uint32_t bucketStart;
     uint32_t initialPayloadLength = payload.size();
     bool payloadFull = false;
@@ -300,7 +329,8 @@ Enumeration::complete()
         bucketStart = payload.size();
         objectMap.forEachInBucket(enumerateBucket, cookie, bucketIndex);
         int64_t overflow = appendObjectsToBuffer(log, &payload, objectRefs,
-                                                 maxPayloadBytes, keysOnly);
+                                                 maxPayloadBytes, keysOnly,
+                                                 filter);
         payloadFull = overflow >= 0;
         if (payloadFull) {
             break;
@@ -320,7 +350,8 @@ Enumeration::complete()
             std::sort(objectRefs.begin(), objectRefs.end(), comparator);
 
             int64_t overflow = appendObjectsToBuffer(log, &payload, objectRefs,
-                                                     maxPayloadBytes, keysOnly);
+                                                     maxPayloadBytes, keysOnly,
+                                                     filter);
             if (overflow >= 0) {
                 LogEntryType type;
                 Buffer buffer;
@@ -20,6 +20,7 @@
 #include "EnumerationIterator.h"
 #include "HashTable.h"
 #include "Log.h"
+#include "ObjectFilter.h"
 
 namespace RAMCloud {
 
@@ -45,7 +46,8 @@ class Enumeration {
                 EnumerationIterator& iter,
                 Log& log,
                 HashTable& objectMap,
-                Buffer& payload, uint32_t maxPayloadBytes);
+                Buffer& payload, uint32_t maxPayloadBytes,
+                const ObjectFilter* filter = NULL);
     void complete();
 
   PRIVATE:
@@ -84,6 +86,10 @@ class Enumeration {
 
     /// The maximum number of bytes of objects to be returned.
     uint32_t maxPayloadBytes;
+
+    /// If non-NULL, only objects matching this filter are returned, with
+    /// just the part of their values that it selects.
+    const ObjectFilter* filter;
 };
 
 }
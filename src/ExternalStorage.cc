@@ -36,6 +36,23 @@ ExternalStorage::getLeaderInfo(const char* name, Buffer* value)
     return get(name, value);
 }
 
+// See header file for documentation.
+void
+ExternalStorage::getMulti(const vector<string>& names,
+        vector<Object>* objects)
+{
+    objects->clear();
+    foreach (const string& name, names) {
+        Buffer value;
+        if (!get(name.c_str(), &value))
+            continue;
+        string absName = (name[0] == '/') ? name : workspace + name;
+        objects->emplace_back(absName.c_str(),
+                static_cast<const char*>(value.getRange(0, value.size())),
+                downCast<int>(value.size()));
+    }
+}
+
 /**
  * Read an object from external storage, and parse it as a protocol
  * buffer of type ProtoBufType.
@@ -91,6 +108,16 @@ ExternalStorage::setWorkspace(const char* pathPrefix)
     assert(pathPrefix[workspace.size()-1] == '/');
 }
 
+// See header file for documentation.
+void
+ExternalStorage::setMulti(const vector<Write>& writes)
+{
+    foreach (const Write& write, writes) {
+        set(write.flavor, write.name.c_str(), write.value.data(),
+                downCast<int>(write.value.size()));
+    }
+}
+
 /**
  * Return the absolute node name (i.e., one that begins with "/") that
  * corresponds to the \c name argument. It is provided as a convenience for
@@ -134,6 +134,26 @@ class ExternalStorage {
         UPDATE                     // An existing object is being overwritten.
     };
 
+    /**
+     * Describes one of the objects to be written by a call to setMulti.
+     */
+    struct Write {
+        Write(Hint flavor, const string& name, const string& value)
+            : flavor(flavor)
+            , name(name)
+            , value(value)
+        {}
+
+        /// Same as the corresponding argument to set.
+        Hint flavor;
+
+        /// Name of the object to write (same as the argument to set).
+        string name;
+
+        /// New value for the object.
+        string value;
+    };
+
     ExternalStorage();
     virtual ~ExternalStorage() {}
 
@@ -221,6 +241,26 @@ class ExternalStorage {
      */
     virtual bool getLeaderInfo(const char* name, Buffer* value);
 
+    /**
+     * Read several non-lease objects, as if by calling get for each of
+     * them. Storage systems that support asynchronous operations (e.g.
+     * ZooKeeper) issue the reads together, so that reading many objects
+     * costs a few round trips rather than one per object. The default
+     * implementation simply calls get for each object.
+     *
+     * \param names
+     *      Names of the desired objects (same as the argument to get).
+     * \param objects
+     *      This vector will be filled in with one entry for each of
+     *      \a names that exists, in the same order; each entry's name is
+     *      the absolute name of the object. Any previous contents of the
+     *      vector are discarded.
+     *
+     * \throws LostLeadershipException
+     */
+    virtual void getMulti(const vector<string>& names,
+            vector<Object>* objects);
+
     bool getProtoBuf(const char* name, google::protobuf::Message* value);
 
     /**
@@ -281,6 +321,23 @@ class ExternalStorage {
     virtual void set(Hint flavor, const char* name, const char* value,
             int valueLength = -1) = 0;
 
+    /**
+     * Set the values of several objects, as if by calling set for each
+     * of them in order. Storage systems that support multi-object
+     * transactions (e.g. ZooKeeper) issue the writes together, which is
+     * much faster than a round-trip per object when the coordinator has
+     * a lot of metadata to record at once. This method does not return
+     * until all of the writes are durable. The default implementation
+     * simply calls set for each object.
+     *
+     * \param writes
+     *      Describes the objects to write and their new values. If the
+     *      same object appears more than once, the last value wins.
+     *
+     * \throws LostLeadershipException
+     */
+    virtual void setMulti(const vector<Write>& writes);
+
     /**
      * Specify the current workspace for the application. This is
      * equivalent to a working directory: if a node name specified to
@@ -84,6 +84,31 @@ TEST_F(ExternalStorageTest, get_templated_formatError) {
             "RAMCloud.ProtoBuf.TableManager", message);
 }
 
+TEST_F(ExternalStorageTest, getMulti) {
+    storage.setWorkspace("/a/");
+    storage.getResults.push("value1");
+    storage.getResults.push(string("x\0y", 3));
+    vector<ExternalStorage::Object> objects;
+    objects.emplace_back("bogus", "b", 1);
+    storage.getMulti({"/node1", "node2", "node3"}, &objects);
+    EXPECT_EQ("get(/node1); get(node2); get(node3)", storage.log);
+    ASSERT_EQ(2u, objects.size());
+    EXPECT_STREQ("/node1", objects[0].name);
+    EXPECT_EQ("value1", string(objects[0].value, objects[0].length));
+    EXPECT_STREQ("/a/node2", objects[1].name);
+    EXPECT_EQ(string("x\0y", 3), string(objects[1].value,
+            objects[1].length));
+}
+
+TEST_F(ExternalStorageTest, setMulti) {
+    vector<ExternalStorage::Write> writes;
+    writes.emplace_back(ExternalStorage::UPDATE, "/node1", "value1");
+    writes.emplace_back(ExternalStorage::CREATE, "node2", string("a\0b", 3));
+    storage.setMulti(writes);
+    EXPECT_EQ("set(UPDATE, /node1); set(CREATE, node2)", storage.log);
+    EXPECT_EQ(string("a\0b", 3), storage.setData);
+}
+
 TEST_F(ExternalStorageTest, open_unknown) {
     EXPECT_TRUE(ExternalStorage::open("bogus:", NULL) == NULL);
 }
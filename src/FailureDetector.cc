@@ -15,6 +15,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <math.h>
 
 #include "Common.h"
 #include "CycleCounter.h"
@@ -25,6 +26,7 @@
 #include "FailureDetector.h"
 #include "IpAddress.h"
 #include "MasterService.h"
+#include "RawMetrics.h"
 #include "ShortMacros.h"
 #include "WireFormat.h"
 
@@ -46,6 +48,7 @@ FailureDetector::FailureDetector(Context* context,
     : context(context),
       ourServerId(ourServerId),
       serverTracker(context),
+      latencies(),
       probesWithoutResponse(0),
       thread(),
       threadShouldExit(false)
@@ -124,9 +127,11 @@ FailureDetector::detectorThreadEntry(FailureDetector* detector,
             break;
 
         // Drain the list of changes to update our tracker.
-        ServerDetails dummy1;
-        ServerChangeEvent dummy2;
-        while (detector->serverTracker.getChange(dummy1, dummy2)) {
+        ServerDetails details;
+        ServerChangeEvent event;
+        while (detector->serverTracker.getChange(details, event)) {
+            if (event == SERVER_REMOVED)
+                detector->latencies.erase(details.serverId);
         }
 
         // Ping a random server
@@ -160,18 +165,31 @@ FailureDetector::pingRandomServer()
         locator = context->serverList->getLocator(pingee);
         LOG(DEBUG, "Sending ping to server %s (%s)", pingee.toString().c_str(),
             locator.c_str());
+        uint64_t timeoutNs = getTimeoutNs(pingee);
         uint64_t start = Cycles::rdtsc();
         PingRpc rpc(context, pingee, ourServerId);
-        if (rpc.wait(TIMEOUT_USECS *1000)) {
+        metrics->failureDetector.probeCount++;
+        if (rpc.wait(timeoutNs)) {
             probesWithoutResponse = 0;
+            uint64_t latencyNs = Cycles::toNanoseconds(Cycles::rdtsc() - start);
+            recordLatency(pingee, latencyNs);
             LOG(DEBUG, "Ping succeeded to server %s (%s) in %.1f us",
                 pingee.toString().c_str(), locator.c_str(),
-                1e06*Cycles::toSeconds(Cycles::rdtsc() - start));
+                static_cast<double>(latencyNs) / 1000);
         } else {
-            // Server appears to have crashed; notify the coordinator.
             LOG(WARNING, "Ping timeout to server id %s (locator \"%s\")",
                 pingee.toString().c_str(), locator.c_str());
-            CoordinatorClient::hintServerCrashed(context, pingee);
+            metrics->failureDetector.suspicionCount++;
+            if (!probeIndirectly(pingee)) {
+                // Server appears to have crashed; notify the coordinator.
+                uint64_t lastResponse = latencies[pingee].lastResponse;
+                if (lastResponse != 0) {
+                    metrics->failureDetector.detectionTicks +=
+                            Cycles::rdtsc() - lastResponse;
+                }
+                metrics->failureDetector.crashHintCount++;
+                CoordinatorClient::hintServerCrashed(context, pingee);
+            }
         }
     } catch (const ServerListException &sle) {
         // This isn't an error. It's just a race between this thread and
@@ -192,4 +210,132 @@ FailureDetector::pingRandomServer()
         probesWithoutResponse = 0;
     }
 }
+
+/**
+ * Compute how long to wait for a ping to a given server before treating
+ * it as timed out, based on the latencies of earlier pings to that server.
+ *
+ * \param serverId
+ *      Server that is about to be pinged.
+ * \return
+ *      The timeout, in nanoseconds: the server's mean ping latency plus
+ *      TIMEOUT_STDDEVS standard deviations, limited to the range
+ *      [MIN_TIMEOUT_USECS, TIMEOUT_USECS]. TIMEOUT_USECS is used until
+ *      enough pings to the server have succeeded.
+ */
+uint64_t
+FailureDetector::getTimeoutNs(ServerId serverId)
+{
+    const uint64_t maxTimeoutNs = TIMEOUT_USECS * 1000lu;
+    const uint64_t minTimeoutNs = MIN_TIMEOUT_USECS * 1000lu;
+    std::map<ServerId, LatencyStats>::iterator it = latencies.find(serverId);
+    if (it == latencies.end() || it->second.samples < MIN_LATENCY_SAMPLES)
+        return maxTimeoutNs;
+
+    const LatencyStats& stats = it->second;
+    double timeoutNs = stats.meanNs +
+            TIMEOUT_STDDEVS * sqrt(stats.varianceNs);
+    if (timeoutNs >= static_cast<double>(maxTimeoutNs))
+        return maxTimeoutNs;
+    if (timeoutNs <= static_cast<double>(minTimeoutNs))
+        return minTimeoutNs;
+    return static_cast<uint64_t>(timeoutNs);
+}
+
+/**
+ * Add the latency of a successful ping to a server's history.
+ *
+ * \param serverId
+ *      Server that responded.
+ * \param latencyNs
+ *      How long the server took to respond, in nanoseconds.
+ */
+void
+FailureDetector::recordLatency(ServerId serverId, uint64_t latencyNs)
+{
+    // Recent pings are weighted most heavily, so that the timeout follows
+    // changes in network conditions within a few dozen pings.
+    const double weight = 1.0 / 8;
+    LatencyStats& stats = latencies[serverId];
+    double sample = static_cast<double>(latencyNs);
+    if (stats.samples == 0) {
+        stats.meanNs = sample;
+        stats.varianceNs = 0;
+    } else {
+        double delta = sample - stats.meanNs;
+        stats.meanNs += weight * delta;
+        stats.varianceNs = (1 - weight) *
+                (stats.varianceNs + weight * delta * delta);
+    }
+    stats.samples++;
+    stats.lastResponse = Cycles::rdtsc();
+}
+
+/**
+ * Ask a few other servers to ping a server that failed to respond to our
+ * own ping, in order to tell a crashed server from a problem with the
+ * path between us and it.
+ *
+ * \param suspect
+ *      Server whose ping timed out.
+ * \return
+ *      True means at least one of the other servers got a response from
+ *      \a suspect, so it shouldn't be reported to the coordinator. False
+ *      means none did, or that there weren't any other servers to ask.
+ */
+bool
+FailureDetector::probeIndirectly(ServerId suspect)
+{
+    vector<ServerId> candidates;
+    foreach (ServerId id,
+            serverTracker.getServersWithService(WireFormat::PING_SERVICE)) {
+        if (id != suspect && id != ourServerId)
+            candidates.push_back(id);
+    }
+    uint32_t count = downCast<uint32_t>(candidates.size());
+    if (count > INDIRECT_PROBES)
+        count = INDIRECT_PROBES;
+    if (count == 0)
+        return false;
+
+    // Pick the proxies at random, and start all of the probes before
+    // waiting for any of them.
+    Tub<ProxyPingRpc> rpcs[INDIRECT_PROBES];
+    ServerId proxies[INDIRECT_PROBES];
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t j = i + downCast<uint32_t>(generateRandom() %
+                (candidates.size() - i));
+        std::swap(candidates[i], candidates[j]);
+        proxies[i] = candidates[i];
+        rpcs[i].construct(context, proxies[i], suspect,
+                TIMEOUT_USECS * 1000lu);
+        metrics->failureDetector.indirectProbeCount++;
+    }
+
+    // Give each proxy its full timeout, plus the same amount again for
+    // the proxy itself to respond.
+    uint64_t deadline = Cycles::rdtsc() +
+            Cycles::fromNanoseconds(2 * TIMEOUT_USECS * 1000lu);
+    uint32_t reached = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t now = Cycles::rdtsc();
+        uint64_t remainingNs = (now < deadline)
+                ? Cycles::toNanoseconds(deadline - now) : 0;
+        try {
+            if (rpcs[i]->wait(remainingNs) != ~0UL)
+                reached++;
+        } catch (const ClientException& e) {
+            LOG(NOTICE, "Indirect probe of server %s through %s failed: %s",
+                suspect.toString().c_str(), proxies[i].toString().c_str(),
+                e.toString());
+        }
+    }
+    if (reached == 0)
+        return false;
+    LOG(NOTICE, "%u of %u indirect probes reached server %s; not reporting "
+        "it to the coordinator", reached, count, suspect.toString().c_str());
+    metrics->failureDetector.falseSuspicionCount++;
+    return true;
+}
+
 } // namespace
@@ -18,6 +18,7 @@
 
 #include <thread>
 #include <list>
+#include <map>
 
 #include "Common.h"
 #include "PingClient.h"
@@ -37,6 +38,17 @@ namespace RAMCloud {
  * up to the coordinator to make a diagnosis. This class simply reports
  * possible symptoms that it sees.
  *
+ * The timeout for each ping adapts to the response times observed for the
+ * server being pinged, in the style of a phi-accrual detector: the
+ * detector keeps a running mean and variance of each server's ping
+ * latency, and treats a ping as timed out once it has taken so many
+ * standard deviations longer than the mean that a healthy server would
+ * almost never be that slow. This makes detection fast on a quiet network
+ * without making it trigger-happy on a noisy one. Before reporting a
+ * server that misses its timeout, the detector asks a few other servers
+ * to ping it (an indirect probe); if any of them gets through, the problem
+ * is most likely between us and the server, so nothing is reported.
+ *
  * Once you contruct a FailureDetector you may use start() and halt() to
  * start and stop the FailureDetector thread.
  */
@@ -65,6 +77,57 @@ class FailureDetector {
     static_assert(TIMEOUT_USECS <= PROBE_INTERVAL_USECS,
                   "Timeout us should be less than probe interval.");
 
+    /**
+     * Lower bound (in microseconds) on the adaptive timeout. Pings
+     * normally take a few microseconds, but a healthy server can fail to
+     * respond for a few milliseconds at a time (e.g., while the kernel
+     * deschedules it); timeouts much shorter than this would only generate
+     * indirect probes.
+     */
+    static const int MIN_TIMEOUT_USECS = 10 * 1000;
+
+    /// A ping times out once it has taken this many standard deviations
+    /// longer than the server's mean ping latency. For normally distributed
+    /// latencies this corresponds to a phi (-log10 of the probability that
+    /// a healthy server is this slow) of about 9.
+    static const int TIMEOUT_STDDEVS = 6;
+
+    /// The timeout for a server stays at TIMEOUT_USECS until this many of
+    /// its pings have succeeded.
+    static const uint32_t MIN_LATENCY_SAMPLES = 5;
+
+    /// Number of other servers asked to ping a server whose ping timed out,
+    /// before reporting it to the coordinator.
+    static const uint32_t INDIRECT_PROBES = 2;
+
+    /**
+     * Ping latency history for one server; used to compute an adaptive
+     * timeout for that server.
+     */
+    struct LatencyStats {
+        LatencyStats()
+            : samples(0)
+            , meanNs(0)
+            , varianceNs(0)
+            , lastResponse(0)
+        {}
+
+        /// Number of successful pings to the server.
+        uint32_t samples;
+
+        /// Exponentially weighted mean of successful ping latencies, in
+        /// nanoseconds.
+        double meanNs;
+
+        /// Exponentially weighted variance of successful ping latencies, in
+        /// nanoseconds squared.
+        double varianceNs;
+
+        /// Cycles::rdtsc() time when the server last responded to one of
+        /// our pings; 0 means it never has.
+        uint64_t lastResponse;
+    };
+
     /// Shared RAMCloud information.
     Context* context;
 
@@ -75,6 +138,10 @@ class FailureDetector {
     /// currently stored with servers in the tracker.
     ServerTracker<bool>  serverTracker;
 
+    /// Ping latency history for each server that we have pinged. Entries
+    /// are removed when servers leave the cluster.
+    std::map<ServerId, LatencyStats> latencies;
+
     /// Counts the number of probes that have been made since the last
     /// successful response.
     int probesWithoutResponse;
@@ -91,6 +158,9 @@ class FailureDetector {
 
     static void detectorThreadEntry(FailureDetector* detector, Context* ctx);
     void pingRandomServer();
+    uint64_t getTimeoutNs(ServerId serverId);
+    void recordLatency(ServerId serverId, uint64_t latencyNs);
+    bool probeIndirectly(ServerId suspect);
     void alertCoordinator(ServerId serverId, string locator);
 
     DISALLOW_COPY_AND_ASSIGN(FailureDetector);
@@ -99,6 +99,7 @@ TEST_F(FailureDetectorTest, pingRandomServer_pingSuccess) {
     EXPECT_TRUE(StringUtil::startsWith(TestLog::get(),
                 "pingRandomServer: Sending ping to server 1.0 (mock:) | "
                 "pingRandomServer: Ping succeeded to server 1.0 (mock:)"));
+    EXPECT_EQ(1u, fd->latencies[ServerId(1, 0)].samples);
 }
 
 TEST_F(FailureDetectorTest, pingRandomServer_pingFailure) {
@@ -154,4 +155,66 @@ TEST_F(FailureDetectorTest, pingRandomServer_tooManyFailedProbes) {
     EXPECT_EQ(0, fd->probesWithoutResponse);
 }
 
+TEST_F(FailureDetectorTest, getTimeoutNs) {
+    ServerId id(1, 0);
+    const uint64_t maxTimeoutNs = FailureDetector::TIMEOUT_USECS * 1000;
+    const uint64_t minTimeoutNs = FailureDetector::MIN_TIMEOUT_USECS * 1000;
+    EXPECT_EQ(maxTimeoutNs, fd->getTimeoutNs(id));
+
+    // Too few samples to trust.
+    for (uint32_t i = 1; i < FailureDetector::MIN_LATENCY_SAMPLES; i++)
+        fd->recordLatency(id, 5000);
+    EXPECT_EQ(maxTimeoutNs, fd->getTimeoutNs(id));
+    fd->recordLatency(id, 5000);
+    EXPECT_EQ(minTimeoutNs, fd->getTimeoutNs(id));
+
+    FailureDetector::LatencyStats& stats = fd->latencies[id];
+    stats.meanNs = 20e06;
+    stats.varianceNs = 1e12;
+    EXPECT_EQ(26000000u, fd->getTimeoutNs(id));
+    stats.varianceNs = 25e12;
+    EXPECT_EQ(maxTimeoutNs, fd->getTimeoutNs(id));
+}
+
+TEST_F(FailureDetectorTest, recordLatency) {
+    ServerId id(1, 0);
+    fd->recordLatency(id, 8000);
+    FailureDetector::LatencyStats& stats = fd->latencies[id];
+    EXPECT_EQ(1u, stats.samples);
+    EXPECT_DOUBLE_EQ(8000, stats.meanNs);
+    EXPECT_DOUBLE_EQ(0, stats.varianceNs);
+    EXPECT_NE(0u, stats.lastResponse);
+
+    fd->recordLatency(id, 16000);
+    EXPECT_EQ(2u, stats.samples);
+    EXPECT_DOUBLE_EQ(9000, stats.meanNs);
+    EXPECT_DOUBLE_EQ(7e06, stats.varianceNs);
+}
+
+TEST_F(FailureDetectorTest, probeIndirectly_noProxies) {
+    addServer(ServerId(1, 0), "mock:");
+    addServer(ServerId(57, 27342), "mock:");
+    EXPECT_FALSE(fd->probeIndirectly(ServerId(1, 0)));
+    EXPECT_EQ("", mockTransport.outputLog);
+}
+
+TEST_F(FailureDetectorTest, probeIndirectly_reached) {
+    TestLog::Enable _("probeIndirectly");
+    addServer(ServerId(1, 0), "mock:");
+    addServer(ServerId(2, 0), "mock:");
+    mockTransport.setInput("0 1000 0");
+    EXPECT_TRUE(fd->probeIndirectly(ServerId(1, 0)));
+    EXPECT_EQ("probeIndirectly: 1 of 1 indirect probes reached server 1.0; "
+            "not reporting it to the coordinator", TestLog::get());
+}
+
+TEST_F(FailureDetectorTest, probeIndirectly_notReached) {
+    TestLog::Enable _("probeIndirectly");
+    addServer(ServerId(1, 0), "mock:");
+    addServer(ServerId(2, 0), "mock:");
+    mockTransport.setInput("0 -1 -1");
+    EXPECT_FALSE(fd->probeIndirectly(ServerId(1, 0)));
+    EXPECT_EQ("", TestLog::get());
+}
+
 } // namespace RAMCloud
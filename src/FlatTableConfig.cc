@@ -0,0 +1,324 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "ClientException.h"
+#include "FlatTableConfig.h"
+
+namespace RAMCloud {
+
+const FlatTableConfig::Header FlatTableConfig::emptyHeader = {0, 0, 0, 0};
+
+/**
+ * Construct an empty Builder.
+ */
+FlatTableConfig::Builder::Builder()
+    : tablets()
+    , indexes()
+    , indexlets()
+    , strings()
+{
+}
+
+/**
+ * Add a tablet to the configuration.
+ *
+ * \param tablet
+ *      Describes the tablet.
+ * \param locator
+ *      Service locator for the server that owns the tablet; empty means
+ *      it isn't known.
+ */
+void
+FlatTableConfig::Builder::addTablet(const Tablet& tablet,
+        const string& locator)
+{
+    TabletRecord record;
+    record.tableId = tablet.tableId;
+    record.startKeyHash = tablet.startKeyHash;
+    record.endKeyHash = tablet.endKeyHash;
+    record.serverId = tablet.serverId.getId();
+    record.ctimeSegmentId = tablet.ctime.getSegmentId();
+    record.ctimeSegmentOffset = tablet.ctime.getSegmentOffset();
+    record.locatorLength = downCast<uint16_t>(locator.length());
+    record.locatorOffset = addString(locator.data(), record.locatorLength);
+    record.status = static_cast<uint8_t>(tablet.status);
+    tablets.push_back(record);
+}
+
+/**
+ * Add an index to the configuration; indexlets added after this (up to
+ * the next call to this method) belong to it.
+ *
+ * \param indexId
+ *      Identifier of the index within its table.
+ * \param indexType
+ *      Type of the index (see IndexKey::IndexType).
+ */
+void
+FlatTableConfig::Builder::addIndex(uint8_t indexId, uint8_t indexType)
+{
+    IndexRecord record;
+    record.indexId = indexId;
+    record.indexType = indexType;
+    record.firstIndexlet = downCast<uint32_t>(indexlets.size());
+    record.indexletCount = 0;
+    indexes.push_back(record);
+}
+
+/**
+ * Add an indexlet to the index added most recently with #addIndex.
+ *
+ * \param firstKey
+ *      Smallest key in the indexlet; NULL means there is no lower bound.
+ * \param firstKeyLength
+ *      Number of bytes in firstKey.
+ * \param firstNotOwnedKey
+ *      Smallest key after the indexlet; NULL means there is no upper bound.
+ * \param firstNotOwnedKeyLength
+ *      Number of bytes in firstNotOwnedKey.
+ * \param serverId
+ *      Server that owns the indexlet.
+ * \param locator
+ *      Service locator for serverId; empty means it isn't known.
+ */
+void
+FlatTableConfig::Builder::addIndexlet(const void* firstKey,
+        uint16_t firstKeyLength, const void* firstNotOwnedKey,
+        uint16_t firstNotOwnedKeyLength, ServerId serverId,
+        const string& locator)
+{
+    assert(!indexes.empty());
+    if (firstKey == NULL)
+        firstKeyLength = 0;
+    if (firstNotOwnedKey == NULL)
+        firstNotOwnedKeyLength = 0;
+    IndexletRecord record;
+    record.serverId = serverId.getId();
+    record.firstKeyLength = firstKeyLength;
+    record.firstKeyOffset = addString(firstKey, firstKeyLength);
+    record.firstNotOwnedKeyLength = firstNotOwnedKeyLength;
+    record.firstNotOwnedKeyOffset = addString(firstNotOwnedKey,
+            firstNotOwnedKeyLength);
+    record.locatorLength = downCast<uint16_t>(locator.length());
+    record.locatorOffset = addString(locator.data(), record.locatorLength);
+    indexlets.push_back(record);
+    indexes.back().indexletCount++;
+}
+
+/**
+ * Append the configuration to a Buffer.
+ *
+ * \param buffer
+ *      The serialized configuration is appended here.
+ * \return
+ *      The number of bytes appended to the buffer.
+ */
+uint32_t
+FlatTableConfig::Builder::serialize(Buffer* buffer)
+{
+    uint32_t before = buffer->size();
+    Header* header = buffer->emplaceAppend<Header>();
+    header->tabletCount = downCast<uint32_t>(tablets.size());
+    header->indexCount = downCast<uint32_t>(indexes.size());
+    header->indexletCount = downCast<uint32_t>(indexlets.size());
+    header->stringBytes = downCast<uint32_t>(strings.size());
+    if (!tablets.empty()) {
+        buffer->appendCopy(&tablets[0], downCast<uint32_t>(
+                tablets.size() * sizeof(TabletRecord)));
+    }
+    if (!indexes.empty()) {
+        buffer->appendCopy(&indexes[0], downCast<uint32_t>(
+                indexes.size() * sizeof(IndexRecord)));
+    }
+    if (!indexlets.empty()) {
+        buffer->appendCopy(&indexlets[0], downCast<uint32_t>(
+                indexlets.size() * sizeof(IndexletRecord)));
+    }
+    if (!strings.empty()) {
+        buffer->appendCopy(strings.data(),
+                downCast<uint32_t>(strings.size()));
+    }
+    return buffer->size() - before;
+}
+
+/**
+ * Add bytes to the string data.
+ *
+ * \param data
+ *      First byte to add.
+ * \param length
+ *      Number of bytes to add.
+ * \return
+ *      The offset of the bytes within the string data.
+ */
+uint32_t
+FlatTableConfig::Builder::addString(const void* data, uint16_t length)
+{
+    uint32_t offset = downCast<uint32_t>(strings.size());
+    if (length > 0)
+        strings.append(static_cast<const char*>(data), length);
+    return offset;
+}
+
+/**
+ * Construct an empty FlatTableConfig (it contains no tablets or indexes
+ * until #parse is invoked).
+ */
+FlatTableConfig::FlatTableConfig()
+    : header(&emptyHeader)
+    , tablets(NULL)
+    , indexes(NULL)
+    , indexlets(NULL)
+    , strings(NULL)
+{
+}
+
+/**
+ * Make this object refer to a configuration in a Buffer. The records are
+ * used in place: this object must not be used after the Buffer is
+ * modified or destroyed.
+ *
+ * \param buffer
+ *      Holds the serialized configuration (typically the response of a
+ *      GET_TABLE_CONFIG RPC).
+ * \param offset
+ *      Offset of the configuration within buffer.
+ * \param length
+ *      Number of bytes in the configuration.
+ *
+ * \throw ResponseFormatError
+ *      The configuration is truncated, or a record refers to data outside
+ *      the configuration. This object is left unchanged.
+ */
+void
+FlatTableConfig::parse(Buffer* buffer, uint32_t offset, uint32_t length)
+{
+    const char* start = static_cast<const char*>(
+            buffer->getRange(offset, length));
+    if ((start == NULL) || (length < sizeof(Header))) {
+        throw ResponseFormatError(HERE);
+    }
+    const Header* h = reinterpret_cast<const Header*>(start);
+    uint64_t recordBytes = h->tabletCount * uint64_t(sizeof(TabletRecord))
+            + h->indexCount * uint64_t(sizeof(IndexRecord))
+            + h->indexletCount * uint64_t(sizeof(IndexletRecord));
+    if (sizeof(Header) + recordBytes + h->stringBytes != length) {
+        throw ResponseFormatError(HERE);
+    }
+    const char* next = start + sizeof(Header);
+    const TabletRecord* newTablets =
+            reinterpret_cast<const TabletRecord*>(next);
+    next += h->tabletCount * sizeof(TabletRecord);
+    const IndexRecord* newIndexes =
+            reinterpret_cast<const IndexRecord*>(next);
+    next += h->indexCount * sizeof(IndexRecord);
+    const IndexletRecord* newIndexlets =
+            reinterpret_cast<const IndexletRecord*>(next);
+    next += h->indexletCount * sizeof(IndexletRecord);
+
+    // Check every reference once here, so the accessors don't have to.
+    for (uint32_t i = 0; i < h->tabletCount; i++) {
+        const TabletRecord& tablet = newTablets[i];
+        if (!inRange(tablet.locatorOffset, tablet.locatorLength,
+                h->stringBytes))
+            throw ResponseFormatError(HERE);
+    }
+    for (uint32_t i = 0; i < h->indexCount; i++) {
+        const IndexRecord& index = newIndexes[i];
+        if (!inRange(index.firstIndexlet, index.indexletCount,
+                h->indexletCount))
+            throw ResponseFormatError(HERE);
+    }
+    for (uint32_t i = 0; i < h->indexletCount; i++) {
+        const IndexletRecord& indexlet = newIndexlets[i];
+        if (!inRange(indexlet.firstKeyOffset, indexlet.firstKeyLength,
+                    h->stringBytes)
+                || !inRange(indexlet.firstNotOwnedKeyOffset,
+                    indexlet.firstNotOwnedKeyLength, h->stringBytes)
+                || !inRange(indexlet.locatorOffset, indexlet.locatorLength,
+                    h->stringBytes))
+            throw ResponseFormatError(HERE);
+    }
+
+    header = h;
+    tablets = newTablets;
+    indexes = newIndexes;
+    indexlets = newIndexlets;
+    strings = next;
+}
+
+/**
+ * Returns true if the range of count items starting at first lies within
+ * the first limit items.
+ */
+bool
+FlatTableConfig::inRange(uint32_t first, uint32_t count, uint32_t limit)
+{
+    return uint64_t(first) + count <= limit;
+}
+
+/**
+ * Copy the configuration into a ProtoBuf::TableConfig; used by callers
+ * that want the older representation.
+ *
+ * \param[out] tableConfig
+ *      Any existing contents are discarded, then it is filled in with the
+ *      tablets and indexes of this configuration.
+ */
+void
+FlatTableConfig::toProtoBuf(ProtoBuf::TableConfig* tableConfig) const
+{
+    tableConfig->Clear();
+    for (uint32_t n = 0; n < getTabletCount(); n++) {
+        const TabletRecord* record = getTablet(n);
+        ProtoBuf::TableConfig::Tablet& entry(*tableConfig->add_tablet());
+        entry.set_table_id(record->tableId);
+        entry.set_start_key_hash(record->startKeyHash);
+        entry.set_end_key_hash(record->endKeyHash);
+        entry.set_state(record->status == Tablet::NORMAL
+                ? ProtoBuf::TableConfig::Tablet::NORMAL
+                : ProtoBuf::TableConfig::Tablet::RECOVERING);
+        entry.set_server_id(record->serverId);
+        if (record->locatorLength != 0) {
+            entry.set_service_locator(getString(record->locatorOffset,
+                    record->locatorLength), record->locatorLength);
+        }
+        entry.set_ctime_log_head_id(record->ctimeSegmentId);
+        entry.set_ctime_log_head_offset(record->ctimeSegmentOffset);
+    }
+    for (uint32_t n = 0; n < getIndexCount(); n++) {
+        const IndexRecord* index = getIndex(n);
+        ProtoBuf::TableConfig::Index& indexEntry(*tableConfig->add_index());
+        indexEntry.set_index_id(index->indexId);
+        indexEntry.set_index_type(index->indexType);
+        for (uint32_t i = 0; i < index->indexletCount; i++) {
+            const IndexletRecord* record =
+                    getIndexlet(index->firstIndexlet + i);
+            ProtoBuf::TableConfig::Index::Indexlet& entry(
+                    *indexEntry.add_indexlet());
+            entry.set_start_key(string(strings + record->firstKeyOffset,
+                    record->firstKeyLength));
+            entry.set_end_key(string(strings + record->firstNotOwnedKeyOffset,
+                    record->firstNotOwnedKeyLength));
+            entry.set_server_id(record->serverId);
+            if (record->locatorLength != 0) {
+                entry.set_service_locator(getString(record->locatorOffset,
+                        record->locatorLength), record->locatorLength);
+            }
+        }
+    }
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,178 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_FLATTABLECONFIG_H
+#define RAMCLOUD_FLATTABLECONFIG_H
+
+#include <vector>
+
+#include "Common.h"
+#include "Buffer.h"
+#include "ServerId.h"
+#include "Tablet.h"
+#include "TableConfig.pb.h"
+
+namespace RAMCloud {
+
+/**
+ * The tablet and index configuration of a table, in the form returned by
+ * the GET_TABLE_CONFIG RPC. It carries the same information as
+ * ProtoBuf::TableConfig, but as fixed-size records followed by the bytes of
+ * all the strings (service locators and index keys), which the records
+ * refer to by offset. Clients read the records in place, straight out of
+ * the response Buffer: there is no decoding step and nothing is allocated
+ * for each record, which matters for tables with many tablets.
+ *
+ * A serialized configuration consists of a Header, then Header::tabletCount
+ * TabletRecords, Header::indexCount IndexRecords, Header::indexletCount
+ * IndexletRecords, and finally Header::stringBytes bytes of string data.
+ *
+ * Each FlatTableConfig object refers to a configuration in a Buffer (see
+ * #parse); Builder creates serialized configurations.
+ */
+class FlatTableConfig {
+  PUBLIC:
+    /// Appears at the start of a serialized configuration.
+    struct Header {
+        uint32_t tabletCount;
+        uint32_t indexCount;
+        uint32_t indexletCount;
+        uint32_t stringBytes;        // Bytes of string data after the
+                                     // records.
+    } __attribute__((packed));
+
+    /// Describes one tablet (see Tablet for the meanings of the fields).
+    struct TabletRecord {
+        uint64_t tableId;
+        uint64_t startKeyHash;
+        uint64_t endKeyHash;
+        uint64_t serverId;
+        uint64_t ctimeSegmentId;
+        uint32_t ctimeSegmentOffset;
+        uint32_t locatorOffset;      // Offset of the owner's service locator
+                                     // within the string data.
+        uint16_t locatorLength;      // 0 means the coordinator didn't know
+                                     // the owner's service locator.
+        uint8_t status;              // A Tablet::Status value.
+    } __attribute__((packed));
+
+    /// Describes one index of the table.
+    struct IndexRecord {
+        uint8_t indexId;
+        uint8_t indexType;
+        uint32_t firstIndexlet;      // Index of this index's first
+                                     // IndexletRecord; its indexlets are
+                                     // consecutive.
+        uint32_t indexletCount;
+    } __attribute__((packed));
+
+    /// Describes one indexlet (see Indexlet for the meanings of the fields).
+    /// A key length of 0 means the key is NULL.
+    struct IndexletRecord {
+        uint64_t serverId;
+        uint32_t firstKeyOffset;
+        uint32_t firstNotOwnedKeyOffset;
+        uint32_t locatorOffset;
+        uint16_t firstKeyLength;
+        uint16_t firstNotOwnedKeyLength;
+        uint16_t locatorLength;
+    } __attribute__((packed));
+
+    /**
+     * Accumulates the tablets and indexes of a table, then serializes them
+     * in FlatTableConfig format.
+     */
+    class Builder {
+      PUBLIC:
+        Builder();
+        void addTablet(const Tablet& tablet, const string& locator);
+        void addIndex(uint8_t indexId, uint8_t indexType);
+        void addIndexlet(const void* firstKey, uint16_t firstKeyLength,
+                const void* firstNotOwnedKey, uint16_t firstNotOwnedKeyLength,
+                ServerId serverId, const string& locator);
+        uint32_t serialize(Buffer* buffer);
+
+        /// Return the number of tablets added so far.
+        uint32_t getTabletCount() const
+        {
+            return downCast<uint32_t>(tablets.size());
+        }
+
+      PRIVATE:
+        uint32_t addString(const void* data, uint16_t length);
+
+        /// Records added so far.
+        std::vector<TabletRecord> tablets;
+        std::vector<IndexRecord> indexes;
+        std::vector<IndexletRecord> indexlets;
+
+        /// All of the string data referred to by the records.
+        string strings;
+
+        DISALLOW_COPY_AND_ASSIGN(Builder);
+    };
+
+    FlatTableConfig();
+    void parse(Buffer* buffer, uint32_t offset, uint32_t length);
+    void toProtoBuf(ProtoBuf::TableConfig* tableConfig) const;
+
+    /// Return the number of tablets in the configuration.
+    uint32_t getTabletCount() const { return header->tabletCount; }
+
+    /// Return the number of indexes in the configuration.
+    uint32_t getIndexCount() const { return header->indexCount; }
+
+    /// Return the i'th tablet in the configuration.
+    const TabletRecord* getTablet(uint32_t i) const { return &tablets[i]; }
+
+    /// Return the i'th index in the configuration.
+    const IndexRecord* getIndex(uint32_t i) const { return &indexes[i]; }
+
+    /// Return the i'th indexlet in the configuration (see
+    /// IndexRecord::firstIndexlet).
+    const IndexletRecord* getIndexlet(uint32_t i) const
+    {
+        return &indexlets[i];
+    }
+
+    /**
+     * Return a pointer to string data referred to by one of the records,
+     * or NULL if length is 0.
+     */
+    const char* getString(uint32_t offset, uint16_t length) const
+    {
+        return (length == 0) ? NULL : strings + offset;
+    }
+
+  PRIVATE:
+    static bool inRange(uint32_t first, uint32_t count, uint32_t limit);
+
+    /// The following variables point into the Buffer passed to parse;
+    /// NULL (or an empty header) if parse hasn't been called.
+    const Header* header;
+    const TabletRecord* tablets;
+    const IndexRecord* indexes;
+    const IndexletRecord* indexlets;
+    const char* strings;
+
+    /// Used for header before parse is called.
+    static const Header emptyHeader;
+
+    DISALLOW_COPY_AND_ASSIGN(FlatTableConfig);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_FLATTABLECONFIG_H
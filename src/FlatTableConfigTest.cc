@@ -0,0 +1,182 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "ClientException.h"
+#include "FlatTableConfig.h"
+
+namespace RAMCloud {
+
+class FlatTableConfigTest : public ::testing::Test {
+  public:
+    Buffer buffer;
+    uint32_t length;
+
+    FlatTableConfigTest()
+        : buffer()
+        , length(0)
+    {
+        FlatTableConfig::Builder builder;
+        builder.addTablet(Tablet(5, 0, 99, ServerId(1, 0), Tablet::NORMAL,
+                LogPosition(10, 20)), "mock:host=master1");
+        builder.addTablet(Tablet(5, 100, ~0lu, ServerId(2, 0),
+                Tablet::RECOVERING, LogPosition(30, 40)), "");
+        builder.addIndex(1, 0);
+        builder.addIndexlet(NULL, 0, "m", 1, ServerId(3, 0),
+                "mock:host=master3");
+        builder.addIndexlet("m", 1, NULL, 0, ServerId(4, 0), "");
+        builder.addIndex(2, 0);
+        builder.addIndexlet("abc", 3, "xyz", 3, ServerId(1, 0),
+                "mock:host=master1");
+        buffer.appendCopy("junk", 4);
+        length = builder.serialize(&buffer);
+    }
+
+    // Overwrite a field of the serialized configuration.
+    template<typename T>
+    void
+    corrupt(uint32_t offset, T value)
+    {
+        memcpy(buffer.getRange(4 + offset, sizeof(T)), &value, sizeof(T));
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(FlatTableConfigTest);
+};
+
+TEST_F(FlatTableConfigTest, constructor) {
+    FlatTableConfig config;
+    EXPECT_EQ(0U, config.getTabletCount());
+    EXPECT_EQ(0U, config.getIndexCount());
+    ProtoBuf::TableConfig tableConfig;
+    config.toProtoBuf(&tableConfig);
+    EXPECT_EQ("", tableConfig.ShortDebugString());
+}
+
+TEST_F(FlatTableConfigTest, serialize) {
+    EXPECT_EQ(sizeof(FlatTableConfig::Header)
+            + 2 * sizeof(FlatTableConfig::TabletRecord)
+            + 2 * sizeof(FlatTableConfig::IndexRecord)
+            + 3 * sizeof(FlatTableConfig::IndexletRecord)
+            + 17 + 1 + 17 + 1 + 3 + 3 + 17, length);
+    EXPECT_EQ(4 + length, buffer.size());
+}
+
+TEST_F(FlatTableConfigTest, serialize_empty) {
+    FlatTableConfig::Builder builder;
+    Buffer empty;
+    EXPECT_EQ(sizeof(FlatTableConfig::Header), builder.serialize(&empty));
+    FlatTableConfig config;
+    config.parse(&empty, 0, empty.size());
+    EXPECT_EQ(0U, config.getTabletCount());
+    EXPECT_EQ(0U, config.getIndexCount());
+}
+
+TEST_F(FlatTableConfigTest, parse) {
+    FlatTableConfig config;
+    config.parse(&buffer, 4, length);
+    EXPECT_EQ(2U, config.getTabletCount());
+    EXPECT_EQ(2U, config.getIndexCount());
+
+    const FlatTableConfig::TabletRecord* tablet = config.getTablet(0);
+    EXPECT_EQ(5U, tablet->tableId);
+    EXPECT_EQ(99U, tablet->endKeyHash);
+    EXPECT_EQ(ServerId(1, 0).getId(), tablet->serverId);
+    EXPECT_EQ(10U, tablet->ctimeSegmentId);
+    EXPECT_EQ(20U, tablet->ctimeSegmentOffset);
+    EXPECT_EQ(Tablet::NORMAL, tablet->status);
+    EXPECT_EQ("mock:host=master1", string(config.getString(
+            tablet->locatorOffset, tablet->locatorLength),
+            tablet->locatorLength));
+    tablet = config.getTablet(1);
+    EXPECT_EQ(Tablet::RECOVERING, tablet->status);
+    EXPECT_TRUE(config.getString(tablet->locatorOffset,
+            tablet->locatorLength) == NULL);
+
+    const FlatTableConfig::IndexRecord* index = config.getIndex(1);
+    EXPECT_EQ(2U, index->indexId);
+    EXPECT_EQ(2U, index->firstIndexlet);
+    EXPECT_EQ(1U, index->indexletCount);
+    const FlatTableConfig::IndexletRecord* indexlet = config.getIndexlet(0);
+    EXPECT_TRUE(config.getString(indexlet->firstKeyOffset,
+            indexlet->firstKeyLength) == NULL);
+    EXPECT_EQ("m", string(config.getString(indexlet->firstNotOwnedKeyOffset,
+            indexlet->firstNotOwnedKeyLength),
+            indexlet->firstNotOwnedKeyLength));
+}
+
+TEST_F(FlatTableConfigTest, parse_truncated) {
+    FlatTableConfig config;
+    EXPECT_THROW(config.parse(&buffer, 4, 10), ResponseFormatError);
+    EXPECT_THROW(config.parse(&buffer, 4, length - 1), ResponseFormatError);
+    EXPECT_THROW(config.parse(&buffer, 4, length + 1), ResponseFormatError);
+    EXPECT_THROW(config.parse(&buffer, 0, length), ResponseFormatError);
+
+    // The object should be unchanged.
+    EXPECT_EQ(0U, config.getTabletCount());
+}
+
+TEST_F(FlatTableConfigTest, parse_badTabletLocator) {
+    uint32_t offset = downCast<uint32_t>(sizeof(FlatTableConfig::Header)
+            + offsetof(FlatTableConfig::TabletRecord, locatorOffset));
+    corrupt<uint32_t>(offset, 1000);
+    FlatTableConfig config;
+    EXPECT_THROW(config.parse(&buffer, 4, length), ResponseFormatError);
+}
+
+TEST_F(FlatTableConfigTest, parse_badIndexletRange) {
+    uint32_t offset = downCast<uint32_t>(sizeof(FlatTableConfig::Header)
+            + 2 * sizeof(FlatTableConfig::TabletRecord)
+            + sizeof(FlatTableConfig::IndexRecord)
+            + offsetof(FlatTableConfig::IndexRecord, indexletCount));
+    corrupt<uint32_t>(offset, 2);
+    FlatTableConfig config;
+    EXPECT_THROW(config.parse(&buffer, 4, length), ResponseFormatError);
+}
+
+TEST_F(FlatTableConfigTest, parse_badIndexletKey) {
+    uint32_t offset = downCast<uint32_t>(sizeof(FlatTableConfig::Header)
+            + 2 * sizeof(FlatTableConfig::TabletRecord)
+            + 2 * sizeof(FlatTableConfig::IndexRecord)
+            + offsetof(FlatTableConfig::IndexletRecord,
+            firstNotOwnedKeyLength));
+    corrupt<uint16_t>(offset, 100);
+    FlatTableConfig config;
+    EXPECT_THROW(config.parse(&buffer, 4, length), ResponseFormatError);
+}
+
+TEST_F(FlatTableConfigTest, toProtoBuf) {
+    FlatTableConfig config;
+    config.parse(&buffer, 4, length);
+    ProtoBuf::TableConfig tableConfig;
+    tableConfig.add_tablet();
+    config.toProtoBuf(&tableConfig);
+    EXPECT_EQ("tablet { table_id: 5 start_key_hash: 0 end_key_hash: 99 "
+            "state: NORMAL server_id: 1 "
+            "service_locator: \"mock:host=master1\" "
+            "ctime_log_head_id: 10 ctime_log_head_offset: 20 } "
+            "tablet { table_id: 5 start_key_hash: 100 "
+            "end_key_hash: 18446744073709551615 state: RECOVERING "
+            "server_id: 2 ctime_log_head_id: 30 ctime_log_head_offset: 40 } "
+            "index { index_id: 1 index_type: 0 "
+            "indexlet { start_key: \"\" end_key: \"m\" server_id: 3 "
+            "service_locator: \"mock:host=master3\" } "
+            "indexlet { start_key: \"m\" end_key: \"\" server_id: 4 } } "
+            "index { index_id: 2 index_type: 0 "
+            "indexlet { start_key: \"abc\" end_key: \"xyz\" server_id: 1 "
+            "service_locator: \"mock:host=master1\" } }",
+            tableConfig.ShortDebugString());
+}
+
+}  // namespace RAMCloud
@@ -0,0 +1,220 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <algorithm>
+
+#include "HashIndex.h"
+#include "ShortMacros.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct an empty HashIndex, or one that refers to the buckets already
+ * in the backing table (e.g., after crash recovery).
+ *
+ * \param tableId
+ *      Id of the backing table that will hold the bucket objects. It must
+ *      not be used for anything else.
+ * \param objMgr
+ *      ObjectManager of the server that owns the backing table.
+ */
+HashIndex::HashIndex(uint64_t tableId, ObjectManager* objMgr)
+    : tableId(tableId)
+    , objMgr(objMgr)
+{
+}
+
+/**
+ * Return the number of entries with a given secondary key.
+ *
+ * \param key
+ *      Secondary key to count.
+ * \param keyLength
+ *      Length of key, in bytes.
+ * \param firstAllowedKeyHash
+ *      Entries whose primary key hashes are smaller than this aren't
+ *      counted.
+ */
+uint64_t
+HashIndex::count(const void* key, uint16_t keyLength,
+        uint64_t firstAllowedKeyHash)
+{
+    vector<uint64_t> hashes;
+    readBucket(key, keyLength, &hashes);
+    return downCast<uint64_t>(hashes.end() - std::lower_bound(
+            hashes.begin(), hashes.end(), firstAllowedKeyHash));
+}
+
+/**
+ * Remove one copy of an entry from the index.
+ *
+ * \param entry
+ *      Entry to remove.
+ * \return
+ *      True if the entry was found and removed; false if it didn't exist.
+ */
+bool
+HashIndex::erase(const BtreeEntry& entry)
+{
+    vector<uint64_t> hashes;
+    readBucket(entry.key, entry.keyLength, &hashes);
+    auto it = std::lower_bound(hashes.begin(), hashes.end(), entry.pKHash);
+    if (it == hashes.end() || *it != entry.pKHash)
+        return false;
+    hashes.erase(it);
+    writeBucket(entry.key, entry.keyLength, hashes);
+    return true;
+}
+
+/**
+ * Check whether an entry is in the index.
+ *
+ * \param entry
+ *      Entry to look for.
+ * \return
+ *      True if the index contains at least one copy of the entry.
+ */
+bool
+HashIndex::exists(const BtreeEntry& entry)
+{
+    vector<uint64_t> hashes;
+    readBucket(entry.key, entry.keyLength, &hashes);
+    return std::binary_search(hashes.begin(), hashes.end(), entry.pKHash);
+}
+
+/**
+ * Add an entry to the index. As with IndexBtree, inserting an entry that
+ * already exists adds another copy of it.
+ *
+ * \param entry
+ *      Entry to insert.
+ */
+void
+HashIndex::insert(const BtreeEntry& entry)
+{
+    vector<uint64_t> hashes;
+    readBucket(entry.key, entry.keyLength, &hashes);
+    hashes.insert(std::upper_bound(hashes.begin(), hashes.end(),
+            entry.pKHash), entry.pKHash);
+    writeBucket(entry.key, entry.keyLength, hashes);
+}
+
+/**
+ * Return the primary key hashes of the entries with a given secondary key,
+ * in increasing order.
+ *
+ * \param key
+ *      Secondary key to look up.
+ * \param keyLength
+ *      Length of key, in bytes.
+ * \param firstAllowedKeyHash
+ *      Hashes smaller than this are skipped; used to continue a lookup
+ *      whose earlier part didn't fit in a single response.
+ * \param maxNumHashes
+ *      Return at most this many hashes.
+ * \param[out] outBuffer
+ *      The hashes are appended to this buffer, as uint64_t's.
+ * \param[out] numHashes
+ *      Set to the number of hashes appended to outBuffer.
+ * \param[out] nextKeyHash
+ *      If the return value is true, set to the first hash that wasn't
+ *      returned.
+ * \return
+ *      True if some hashes were left out because of maxNumHashes.
+ */
+bool
+HashIndex::lookup(const void* key, uint16_t keyLength,
+        uint64_t firstAllowedKeyHash, uint32_t maxNumHashes,
+        Buffer* outBuffer, uint32_t* numHashes, uint64_t* nextKeyHash)
+{
+    vector<uint64_t> hashes;
+    readBucket(key, keyLength, &hashes);
+    *numHashes = 0;
+    for (auto it = std::lower_bound(hashes.begin(), hashes.end(),
+            firstAllowedKeyHash); it != hashes.end(); ++it) {
+        if (*numHashes == maxNumHashes) {
+            *nextKeyHash = *it;
+            return true;
+        }
+        outBuffer->emplaceAppend<uint64_t>(*it);
+        (*numHashes)++;
+    }
+    return false;
+}
+
+/**
+ * Read the bucket for a secondary key.
+ *
+ * \param key
+ *      Secondary key whose bucket is wanted.
+ * \param keyLength
+ *      Length of key, in bytes.
+ * \param[out] hashes
+ *      Filled in with the primary key hashes in the bucket, in increasing
+ *      order; empty if there is no bucket for key.
+ */
+void
+HashIndex::readBucket(const void* key, uint16_t keyLength,
+        vector<uint64_t>* hashes)
+{
+    hashes->clear();
+    Key bucketKey(tableId, key, keyLength);
+    Buffer value;
+    if (objMgr->readObject(bucketKey, &value, NULL, NULL, true) != STATUS_OK)
+        return;
+    hashes->resize(value.size() / sizeof(uint64_t));
+    value.copy(0, downCast<uint32_t>(hashes->size() * sizeof(uint64_t)),
+            hashes->data());
+}
+
+/**
+ * Replace the bucket for a secondary key, deleting it if it is now empty.
+ *
+ * \param key
+ *      Secondary key whose bucket is to be written.
+ * \param keyLength
+ *      Length of key, in bytes.
+ * \param hashes
+ *      New contents of the bucket.
+ */
+void
+HashIndex::writeBucket(const void* key, uint16_t keyLength,
+        const vector<uint64_t>& hashes)
+{
+    Key bucketKey(tableId, key, keyLength);
+    Buffer logBuffer;
+    uint32_t numEntries = 1;
+    Status status;
+    if (hashes.empty()) {
+        status = objMgr->writeTombstone(bucketKey, &logBuffer);
+    } else {
+        Buffer objectBuffer;
+        Object object(bucketKey, hashes.data(),
+                downCast<uint32_t>(hashes.size() * sizeof(uint64_t)), 1, 0,
+                objectBuffer);
+        bool tombstoneAdded = false;
+        status = objMgr->prepareForLog(object, &logBuffer, NULL,
+                &tombstoneAdded);
+        if (tombstoneAdded)
+            numEntries++;
+    }
+    if (status != STATUS_OK || !objMgr->flushEntriesToLog(&logBuffer,
+            numEntries)) {
+        LOG(WARNING, "Couldn't write index bucket in backing table %lu: %s",
+                tableId, statusToString(status));
+    }
+}
+
+} // namespace RAMCloud
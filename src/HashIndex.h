@@ -0,0 +1,69 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_HASHINDEX_H
+#define RAMCLOUD_HASHINDEX_H
+
+#include "btreeRamCloud/Btree.h"
+#include "Common.h"
+#include "Buffer.h"
+#include "ObjectManager.h"
+
+namespace RAMCloud {
+
+/**
+ * The entries of one indexlet of an IndexKey::HASH_INDEX index. This is the
+ * equality-only counterpart of IndexBtree: it supports the same insert,
+ * erase and exists operations, but lookups must name a single secondary key.
+ *
+ * All of the entries with the same secondary key are stored in a single
+ * bucket object in the indexlet's backing table. The bucket's primary key
+ * is the secondary key itself, and its value is the sorted array of primary
+ * key hashes for the entries (duplicates included). A lookup is therefore a
+ * single probe of the ObjectManager's hash table, and the buckets are
+ * written to the log, replicated, cleaned and recovered like any other
+ * object in the backing table.
+ */
+class HashIndex {
+  PUBLIC:
+    HashIndex(uint64_t tableId, ObjectManager* objMgr);
+
+    uint64_t count(const void* key, uint16_t keyLength,
+            uint64_t firstAllowedKeyHash);
+    bool erase(const BtreeEntry& entry);
+    bool exists(const BtreeEntry& entry);
+    void insert(const BtreeEntry& entry);
+    bool lookup(const void* key, uint16_t keyLength,
+            uint64_t firstAllowedKeyHash, uint32_t maxNumHashes,
+            Buffer* outBuffer, uint32_t* numHashes, uint64_t* nextKeyHash);
+
+  PRIVATE:
+    void readBucket(const void* key, uint16_t keyLength,
+            vector<uint64_t>* hashes);
+    void writeBucket(const void* key, uint16_t keyLength,
+            const vector<uint64_t>& hashes);
+
+    /// Id of the backing table that holds the bucket objects.
+    uint64_t tableId;
+
+    /// ObjectManager of the server that owns the backing table.
+    ObjectManager* objMgr;
+
+    DISALLOW_COPY_AND_ASSIGN(HashIndex);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_HASHINDEX_H
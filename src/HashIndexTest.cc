@@ -0,0 +1,136 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "HashIndex.h"
+#include "MockCluster.h"
+#include "RamCloud.h"
+
+namespace RAMCloud {
+
+class HashIndexTest : public ::testing::Test {
+  public:
+    Context context;
+    MockCluster cluster;
+    Tub<RamCloud> ramcloud;
+    ObjectManager* objectManager;
+    uint64_t backingTableId;
+    Tub<HashIndex> index;
+
+    HashIndexTest()
+        : context()
+        , cluster(&context)
+        , ramcloud()
+        , objectManager()
+        , backingTableId()
+        , index()
+    {
+        Logger::get().setLogLevels(RAMCloud::SILENT_LOG_LEVEL);
+
+        ServerConfig config = ServerConfig::forTesting();
+        config.services = {WireFormat::MASTER_SERVICE,
+                           WireFormat::BACKUP_SERVICE,
+                           WireFormat::PING_SERVICE};
+        config.localLocator = "mock:host=master1";
+        cluster.addServer(config);
+        objectManager =
+                &cluster.contexts[0]->getMasterService()->objectManager;
+
+        ramcloud.construct(&context, "mock:host=coordinator");
+        backingTableId = ramcloud->createTable("backingTable");
+        index.construct(backingTableId, objectManager);
+    }
+
+    /// Returns the hashes for a key, separated by spaces, followed by
+    /// "(next N)" if the lookup didn't return all of them.
+    string
+    lookup(const char* key, uint64_t firstAllowedKeyHash = 0,
+            uint32_t maxNumHashes = 100)
+    {
+        Buffer buffer;
+        uint32_t numHashes;
+        uint64_t nextKeyHash;
+        bool more = index->lookup(key, downCast<uint16_t>(strlen(key)),
+                firstAllowedKeyHash, maxNumHashes, &buffer, &numHashes,
+                &nextKeyHash);
+        string result;
+        for (uint32_t i = 0; i < numHashes; i++) {
+            result.append(result.empty() ? "" : " ");
+            result.append(format("%lu",
+                    *buffer.getOffset<uint64_t>(i * sizeof32(uint64_t))));
+        }
+        if (more)
+            result.append(format(" (next %lu)", nextKeyHash));
+        return result;
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(HashIndexTest);
+};
+
+TEST_F(HashIndexTest, erase) {
+    index->insert(BtreeEntry{"apple", 5, 10});
+    index->insert(BtreeEntry{"apple", 5, 20});
+    index->insert(BtreeEntry{"apple", 5, 20});
+    EXPECT_TRUE(index->erase(BtreeEntry{"apple", 5, 20}));
+    EXPECT_EQ("10 20", lookup("apple"));
+    EXPECT_FALSE(index->erase(BtreeEntry{"apple", 5, 30}));
+    EXPECT_FALSE(index->erase(BtreeEntry{"pear", 4, 10}));
+    EXPECT_EQ("10 20", lookup("apple"));
+}
+
+TEST_F(HashIndexTest, erase_lastEntryDeletesBucket) {
+    index->insert(BtreeEntry{"apple", 5, 10});
+    EXPECT_TRUE(index->erase(BtreeEntry{"apple", 5, 10}));
+    Key key(backingTableId, "apple", 5);
+    Buffer value;
+    EXPECT_EQ(STATUS_OBJECT_DOESNT_EXIST,
+            objectManager->readObject(key, &value, NULL, NULL, true));
+    EXPECT_EQ("", lookup("apple"));
+}
+
+TEST_F(HashIndexTest, exists) {
+    index->insert(BtreeEntry{"apple", 5, 10});
+    EXPECT_TRUE(index->exists(BtreeEntry{"apple", 5, 10}));
+    EXPECT_FALSE(index->exists(BtreeEntry{"apple", 5, 11}));
+    EXPECT_FALSE(index->exists(BtreeEntry{"apples", 6, 10}));
+}
+
+TEST_F(HashIndexTest, insert) {
+    index->insert(BtreeEntry{"apple", 5, 30});
+    index->insert(BtreeEntry{"apple", 5, 10});
+    index->insert(BtreeEntry{"pear", 4, 20});
+    index->insert(BtreeEntry{"apple", 5, 20});
+    EXPECT_EQ("10 20 30", lookup("apple"));
+    EXPECT_EQ("20", lookup("pear"));
+
+    // The bucket is an ordinary object in the backing table.
+    Key key(backingTableId, "pear", 4);
+    Buffer value;
+    EXPECT_EQ(STATUS_OK,
+            objectManager->readObject(key, &value, NULL, NULL, true));
+    EXPECT_EQ(8U, value.size());
+}
+
+TEST_F(HashIndexTest, lookup) {
+    for (uint64_t i = 1; i <= 5; i++)
+        index->insert(BtreeEntry{"apple", 5, i * 10});
+    EXPECT_EQ("", lookup("pear"));
+    EXPECT_EQ("10 20 (next 30)", lookup("apple", 0, 2));
+    EXPECT_EQ("30 40 50", lookup("apple", 30, 3));
+    EXPECT_EQ("40 50", lookup("apple", 35));
+    EXPECT_EQ(" (next 10)", lookup("apple", 0, 0));
+}
+
+}  // namespace RAMCloud
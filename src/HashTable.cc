@@ -13,7 +13,10 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <emmintrin.h>
+
 #include "Common.h"
+#include "Fence.h"
 #include "HashTable.h"
 
 namespace RAMCloud {
@@ -164,12 +167,54 @@ HashTable::Entry::unpack(UnpackedEntry& ue) const
     ue.ptr   = this->value         & 0x00007fffffffffffUL;
 }
 
+#ifndef HASHTABLE_SCALAR_PROBE
+/**
+ * Compare the secondary hash tags of every Entry in a cache line against a
+ * given secondary hash using SSE2. Because entries without a reference (empty
+ * entries and chain pointers) have a tag of 0, a match only indicates that
+ * the entry should be examined with Entry::hashMatches().
+ *
+ * \param[in] cacheLine
+ *      The cache line whose entries should be compared.
+ * \param[in] secondaryHash
+ *      The secondary hash bits (16 bits) computed from the key.
+ * \return
+ *      A bitmask in which bit i is set if the tag of entry i matches.
+ */
+inline uint32_t
+HashTable::findTagMatches(const CacheLine* cacheLine, uint64_t secondaryHash)
+{
+    static_assert(ENTRIES_PER_CACHE_LINE == 8,
+                  "findTagMatches assumes 8 entries per cache line");
+    const __m128i* line = reinterpret_cast<const __m128i*>(cacheLine);
+    const __m128i tag = _mm_set1_epi16(static_cast<int16_t>(secondaryHash));
+
+    // Each 16-byte load covers two entries, whose tags are 16-bit lanes 3
+    // and 7. Packing two comparison results down to bytes leaves the result
+    // for entry i in the top byte of 32-bit lane i, where movemask_ps finds
+    // it.
+    __m128i lo = _mm_packs_epi16(
+            _mm_cmpeq_epi16(_mm_loadu_si128(line + 0), tag),
+            _mm_cmpeq_epi16(_mm_loadu_si128(line + 1), tag));
+    __m128i hi = _mm_packs_epi16(
+            _mm_cmpeq_epi16(_mm_loadu_si128(line + 2), tag),
+            _mm_cmpeq_epi16(_mm_loadu_si128(line + 3), tag));
+    return downCast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(lo)) |
+                              (_mm_movemask_ps(_mm_castsi128_ps(hi)) << 4));
+}
+#endif
+
 /**
  * Construct an empty set of candidates.
  */
 HashTable::Candidates::Candidates()
-    : bucket(NULL)
+    : hashTable(NULL)
+    , bucket(NULL)
     , index()
+    , reference()
+#ifndef HASHTABLE_SCALAR_PROBE
+    , unvisitedMatches(0)
+#endif
     , secondaryHash()
 {
 }
@@ -180,10 +225,15 @@ HashTable::Candidates::Candidates()
  * given secondaryHash.
  */
 void
-HashTable::Candidates::init(CacheLine* cl, uint64_t secondaryHash)
+HashTable::Candidates::init(HashTable* hashTable, CacheLine* cl,
+                            uint64_t secondaryHash)
 {
+    this->hashTable = hashTable;
     bucket = cl;
     index = -1;
+#ifndef HASHTABLE_SCALAR_PROBE
+    unvisitedMatches = findTagMatches(cl, secondaryHash);
+#endif
     this->secondaryHash = secondaryHash;
     next();
 }
@@ -197,7 +247,7 @@ HashTable::Candidates::getReference()
 {
     if (bucket == NULL)
         return 0;
-    return bucket->entries[index].getReference();
+    return reference;
 }
 
 /**
@@ -207,8 +257,10 @@ HashTable::Candidates::getReference()
 void
 HashTable::Candidates::setReference(uint64_t reference)
 {
-    if (bucket != NULL)
+    if (bucket != NULL) {
         bucket->entries[index].setReference(secondaryHash, reference);
+        this->reference = reference;
+    }
 }
 
 /**
@@ -218,8 +270,11 @@ HashTable::Candidates::setReference(uint64_t reference)
 void
 HashTable::Candidates::remove()
 {
-    if (bucket != NULL)
+    if (bucket != NULL) {
         bucket->entries[index].clear();
+        if (hashTable != NULL)
+            hashTable->numEntries.add(-1);
+    }
 }
 
 /**
@@ -228,12 +283,35 @@ HashTable::Candidates::remove()
 void
 HashTable::Candidates::next()
 {
+#ifndef HASHTABLE_SCALAR_PROBE
+    while (bucket != NULL) {
+        while (unvisitedMatches != 0) {
+            index = downCast<uint32_t>(BitOps::findFirstSet(
+                    unvisitedMatches) - 1);
+            unvisitedMatches &= unvisitedMatches - 1;
+            // The tag comparison doesn't rule out empty entries and chain
+            // pointers (whose tags are 0), so check the entry properly.
+            Entry candidate = bucket->entries[index];
+            if (candidate.hashMatches(secondaryHash)) {
+                reference = candidate.getReference();
+                return;
+            }
+        }
+
+        // No more candidates in this cache line; see if there's a chain to
+        // another cache line.
+        Entry last = bucket->entries[ENTRIES_PER_CACHE_LINE - 1];
+        bucket = last.getChainPointer();
+        if (bucket != NULL)
+            unvisitedMatches = findTagMatches(bucket, secondaryHash);
+    }
+#else
     while (true) {
         // Not found in the cache line, see if there's a chain to
         // another cache line.
         if (index == ENTRIES_PER_CACHE_LINE && bucket != NULL) {
-            Entry* entry = &bucket->entries[ENTRIES_PER_CACHE_LINE - 1];
-            bucket = entry->getChainPointer();
+            Entry last = bucket->entries[ENTRIES_PER_CACHE_LINE - 1];
+            bucket = last.getChainPointer();
             index = -1;
         }
 
@@ -244,7 +322,9 @@ HashTable::Candidates::next()
         index++;
         Entry* candidate = &bucket->entries[index];
         while (index < ENTRIES_PER_CACHE_LINE) {
-            if (candidate->hashMatches(secondaryHash)) {
+            Entry entry = *candidate;
+            if (entry.hashMatches(secondaryHash)) {
+                reference = entry.getReference();
                 // The hash within the hash table entry matches, so with
                 // high probability this is the pointer we're looking
                 // for. We'll report this index to the user of this
@@ -256,6 +336,7 @@ HashTable::Candidates::next()
             index++;
         }
     }
+#endif
 }
 
 /**
@@ -272,19 +353,23 @@ HashTable::Candidates::isDone()
  * Constructor for HashTable.
  * \param[in] numBuckets
  *      The number of buckets in the new hash table. This should be a power
- *      of two.
+ *      of two. The table may later grow beyond this (see #splitBucket()).
  * \throw Exception
  *      An exception is thrown if numBuckets is 0.
  */
 HashTable::HashTable(uint64_t numBuckets)
     : numBuckets(BitOps::powerOfTwoLessOrEqual(numBuckets))
-    , buckets(this->numBuckets * sizeof(CacheLine))
+    , initialNumBuckets(this->numBuckets.load())
+    , initialNumBucketsShift(BitOps::findLastSet(initialNumBuckets) - 1)
+    , numEntries(0)
+    , buckets(initialNumBuckets * sizeof(CacheLine))
+    , growthBuckets()
 {
-    if (numBuckets != this->numBuckets) {
+    if (numBuckets != initialNumBuckets) {
         RAMCLOUD_LOG(DEBUG,
                      "HashTable truncated to %lu buckets "
                      "(nearest power of two)",
-                     this->numBuckets);
+                     initialNumBuckets);
     }
 
     if (numBuckets == 0)
@@ -319,7 +404,7 @@ HashTable::lookup(KeyHash keyHash, Candidates& candidates)
     // caller as it examines possible candidates.
     uint64_t secondaryHash;
     CacheLine *bucket = findBucket(keyHash, &secondaryHash);
-    candidates.init(bucket, secondaryHash);
+    candidates.init(this, bucket, secondaryHash);
 }
 
 /**
@@ -338,8 +423,29 @@ void
 HashTable::insert(KeyHash keyHash, uint64_t reference)
 {
     uint64_t secondaryHash;
-    int overflowBuckets = 0;
     CacheLine* bucket = findBucket(keyHash, &secondaryHash);
+    insertInBucket(bucket, secondaryHash, reference);
+    numEntries.add(1);
+}
+
+/**
+ * Helper for #insert() and #splitBucket(): store a reference in the first
+ * free entry of a bucket, chaining on a new overflow cache line if the
+ * bucket is full.
+ *
+ * \param[in] bucket
+ *      The first cache line of the bucket to insert into.
+ * \param[in] secondaryHash
+ *      The secondary hash bits (16 bits) of the key being inserted.
+ * \param[in] reference
+ *      Reference to the new element to insert into the hash table.
+ */
+void
+HashTable::insertInBucket(CacheLine* bucket,
+                          uint64_t secondaryHash,
+                          uint64_t reference)
+{
+    int overflowBuckets = 0;
     while (true) {
         Entry* entry = bucket->entries;
         for (size_t i = 0; i < ENTRIES_PER_CACHE_LINE; i++) {
@@ -357,9 +463,8 @@ HashTable::insert(KeyHash keyHash, uint64_t reference)
         bucket = last->getChainPointer();
         if (bucket == NULL) {
             // no empty space found, allocate a new cache line
-            RAMCLOUD_CLOG(NOTICE, "Allocating overflow bucket %d for index %lu",
-                    overflowBuckets,
-                    findBucketIndex(numBuckets, keyHash, &secondaryHash));
+            RAMCLOUD_CLOG(NOTICE, "Allocating overflow bucket %d for "
+                    "secondary hash 0x%lx", overflowBuckets, secondaryHash);
             void *buf = Memory::xmemalign(HERE, sizeof(CacheLine),
                                           sizeof(CacheLine));
             bucket = static_cast<CacheLine *>(buf);
@@ -390,7 +495,7 @@ HashTable::forEachInBucket(void (*callback)(uint64_t, void *),
                            uint64_t bucket)
 {
     uint64_t numCalls = 0;
-    CacheLine *cl = &buckets.get()[bucket];
+    CacheLine *cl = getBucket(bucket);
     while (1) {
         for (uint32_t j = 0; j < ENTRIES_PER_CACHE_LINE; j++) {
             Entry *e = &cl->entries[j];
@@ -424,7 +529,7 @@ HashTable::forEach(void (*callback)(uint64_t, void *), void *cookie)
 {
     uint64_t numCalls = 0;
 
-    for (uint64_t i = 0; i < numBuckets; i++)
+    for (uint64_t i = 0; i < numBuckets.load(); i++)
         numCalls += forEachInBucket(callback, cookie, i);
 
     return numCalls;
@@ -460,12 +565,135 @@ HashTable::entriesPerCacheLine()
 }
 
 /**
- * Returns the number of buckets allocated to the table.
+ * Returns the number of buckets currently in use by the table. This starts
+ * out as the power of two given to the constructor and increases by one with
+ * each call to #splitBucket().
  */
 uint64_t
 HashTable::getNumBuckets() const
 {
-    return numBuckets;
+    return numBuckets.load();
+}
+
+/**
+ * Returns the number of references currently stored in the table.
+ */
+uint64_t
+HashTable::getNumEntries() const
+{
+    return numEntries.load();
+}
+
+/**
+ * Returns the fraction of entry slots in the table's buckets (not counting
+ * overflow cache lines) that are in use. Values near or above 1.0 mean that
+ * most buckets have overflowed and lookups are walking long chains.
+ */
+double
+HashTable::getLoadFactor() const
+{
+    return static_cast<double>(numEntries.load()) /
+           static_cast<double>(numBuckets.load() * ENTRIES_PER_CACHE_LINE);
+}
+
+/**
+ * Returns the index of the bucket that the next call to #splitBucket() will
+ * split. The caller of #splitBucket() must hold whatever lock protects this
+ * bucket; since the bucket added by the split differs from this one by a
+ * multiple of #initialNumBuckets (and therefore of any smaller power of two),
+ * striped locks indexed by the low bits of the bucket index protect both.
+ */
+uint64_t
+HashTable::getSplitBucketIndex() const
+{
+    uint64_t current = numBuckets.load();
+    return current - BitOps::powerOfTwoLessOrEqual(current);
+}
+
+/**
+ * Make sure that memory exists for the bucket the next #splitBucket() call
+ * will create. This may allocate a block as large as the entire current
+ * table, so callers should invoke it before acquiring the bucket lock for
+ * the split. This method must not be invoked concurrently with itself or
+ * with #splitBucket().
+ *
+ * \throw FatalError
+ *      The memory for the new buckets could not be allocated.
+ */
+void
+HashTable::prepareSplit()
+{
+    int block = getGrowthBlockIndex(numBuckets.load());
+    if (block >= MAX_GROWTH_BLOCKS)
+        throw Exception(HERE, "HashTable cannot grow any further");
+    if (growthBuckets[block])
+        return;
+
+    uint64_t blockBuckets = initialNumBuckets << block;
+    RAMCLOUD_LOG(NOTICE, "Allocating %lu more hash table buckets "
+            "(table currently has %lu)", blockBuckets, numBuckets.load());
+    growthBuckets[block].reset(new LargeBlockOfMemory<CacheLine>(
+            blockBuckets * sizeof(CacheLine)));
+}
+
+/**
+ * Grow the table by one bucket: bucket #getNumBuckets() is created and the
+ * entries in bucket #getSplitBucketIndex() that now map to it are moved
+ * there. Lookups and modifications of any other bucket may proceed
+ * concurrently, but the caller must hold the lock serializing access to the
+ * bucket being split (see #getSplitBucketIndex()) while this method runs.
+ * This method must not be invoked concurrently with itself or with
+ * #prepareSplit().
+ *
+ * Entries are moved in place and the split bucket's overflow cache lines
+ * are never freed here, since unlocked readers such as Enumeration may be
+ * walking the chain.
+ *
+ * \param getKeyHash
+ *      The table only stores 16 bits of each key's hash, so this callback is
+ *      invoked with each reference in the bucket being split (and \a cookie)
+ *      to recover the full KeyHash it was inserted with.
+ * \param cookie
+ *      An opaque parameter to pass to the callback function.
+ * \return
+ *      The number of entries moved to the new bucket.
+ */
+uint64_t
+HashTable::splitBucket(KeyHash (*getKeyHash)(uint64_t, void *), void *cookie)
+{
+    prepareSplit();
+
+    uint64_t oldNumBuckets = numBuckets.load();
+    uint64_t target = oldNumBuckets;
+    CacheLine* newBucket = getBucket(target);
+    CacheLine* cl = getBucket(getSplitBucketIndex());
+    uint64_t moved = 0;
+
+    while (cl != NULL) {
+        for (uint32_t i = 0; i < ENTRIES_PER_CACHE_LINE; i++) {
+            Entry* entry = &cl->entries[i];
+            if (entry->isAvailable() || entry->getChainPointer() != NULL)
+                continue;
+
+            uint64_t reference = entry->getReference();
+            uint64_t secondaryHash;
+            if (findBucketIndex(oldNumBuckets + 1,
+                                getKeyHash(reference, cookie),
+                                &secondaryHash) == target) {
+                insertInBucket(newBucket, secondaryHash, reference);
+                entry->clear();
+                moved++;
+            }
+        }
+
+        cl = cl->entries[ENTRIES_PER_CACHE_LINE - 1].getChainPointer();
+    }
+
+    // Make sure the new bucket's contents (and the block that holds it) are
+    // visible before any thread can compute its index.
+    Fence::sfence();
+    numBuckets.store(oldNumBuckets + 1);
+    return moved;
 }
 
 /**
@@ -474,7 +702,8 @@ HashTable::getNumBuckets() const
  * in the same bucket.
  * \param[in] numBuckets
  *      The number of buckets in the HashTable as reported by
- *      #getNumBuckets().
+ *      #getNumBuckets(). This need not be a power of two if the table is
+ *      in the middle of growing (see HashTable).
  * \param[in] keyHash
  *      Hash of the key representing the element we're looking for. 
  * \param[out] secondaryHash
@@ -489,11 +718,18 @@ HashTable::findBucketIndex(uint64_t numBuckets,
 {
     uint64_t bucketHash = keyHash & 0x0000ffffffffffffUL;
     *secondaryHash = keyHash >> 48;
-    return (bucketHash & (numBuckets - 1));
-    // This is equivalent to:
-    //     &buckets.get()[bucketHash % numBuckets]
-    // since numBuckets is a power of two, and this saves about 14 cycles on
-    // an Intel Core 2 (see src/misc/modulus.cc).
+
+    // Mask for the smallest power of two >= numBuckets. Using masks rather
+    // than modulus saves about 14 cycles on an Intel Core 2 (see
+    // src/misc/modulus.cc).
+    uint64_t mask = (1UL << BitOps::findLastSet(numBuckets - 1)) - 1;
+    uint64_t bucketIndex = bucketHash & mask;
+
+    // Linear hashing: buckets at or beyond numBuckets haven't been split
+    // off yet, so their keys still live in the lower half of the table.
+    if (bucketIndex >= numBuckets)
+        bucketIndex &= (mask >> 1);
+    return bucketIndex;
 }
 
 /**
@@ -510,8 +746,39 @@ HashTable::findBucketIndex(uint64_t numBuckets,
 HashTable::CacheLine*
 HashTable::findBucket(KeyHash keyHash, uint64_t *secondaryHash) //const
 {
-    uint64_t bucketIndex = findBucketIndex(numBuckets, keyHash, secondaryHash);
-    return &buckets.get()[bucketIndex];
+    uint64_t bucketIndex = findBucketIndex(numBuckets.load(), keyHash,
+                                           secondaryHash);
+    return getBucket(bucketIndex);
+}
+
+/**
+ * Return the first cache line of a bucket, given its index.
+ *
+ * \param[in] bucketIndex
+ *      Index of the desired bucket. Must be < #numBuckets.
+ */
+inline HashTable::CacheLine*
+HashTable::getBucket(uint64_t bucketIndex)
+{
+    if (expect_true(bucketIndex < initialNumBuckets))
+        return &buckets.get()[bucketIndex];
+
+    int block = getGrowthBlockIndex(bucketIndex);
+    return &growthBuckets[block]->get()[bucketIndex -
+                                        (initialNumBuckets << block)];
+}
+
+/**
+ * Return the index of the block in #growthBuckets that holds a given
+ * bucket.
+ *
+ * \param[in] bucketIndex
+ *      Index of the desired bucket. Must be >= #initialNumBuckets.
+ */
+inline int
+HashTable::getGrowthBlockIndex(uint64_t bucketIndex) const
+{
+    return BitOps::findLastSet(bucketIndex >> initialNumBucketsShift) - 1;
 }
 
 } // namespace RAMCloud
@@ -17,6 +17,7 @@
 #define RAMCLOUD_HASHTABLE_H
 
 #include "Common.h"
+#include "Atomic.h"
 #include "BitOps.h"
 #include "CycleCounter.h"
 #include "LargeBlockOfMemory.h"
@@ -37,7 +38,8 @@ namespace RAMCloud {
  * requests. I.e., to read and write a %RAMCloud object, this lets you find the
  * location of the the object in the log.
  *
- * This code is not thread-safe.
+ * This code is not thread-safe: callers must serialize operations on the
+ * same bucket (ObjectManager does this with its hashTableBucketLocks).
  *
  * \section impl Implementation Details
  *
@@ -52,6 +54,30 @@ namespace RAMCloud {
  * buckets). In this case, the last hash table entry in each of the
  * non-terminal cache lines has a pointer to the next cache line instead of a
  * log reference.
+ *
+ * \section resize Online Resizing
+ *
+ * The table can grow while it is in use, one bucket at a time, using linear
+ * hashing. Let N be the largest power of two less than or equal to the
+ * current number of buckets, M. A key normally maps to bucket
+ * (hash mod 2N); if that bucket doesn't exist yet (>= M), the key maps to
+ * (hash mod N) instead. Each call to #splitBucket() creates bucket M by
+ * moving the keys that belong there out of bucket M - N, and then increments
+ * M. Only keys in the bucket being split change location, so the caller need
+ * only hold the lock protecting that one bucket; all other operations proceed
+ * concurrently. Buckets added by resizing live in #growthBuckets, whose
+ * blocks double in size so that bucket addresses never change.
+ *
+ * \section probe Probing Cache Lines
+ *
+ * Every Entry keeps its 16-bit secondary hash in its two most significant
+ * bytes, so the tags of a cache line sit at a fixed stride of one per 8 bytes.
+ * By default, lookups load each cache line into four SSE2 registers and
+ * compare all eight tags against the key's secondary hash at once (see
+ * #findTagMatches()); only entries whose tags match are decoded and returned
+ * as candidates. Building with HASHTABLE_PROBE=scalar (which defines
+ * HASHTABLE_SCALAR_PROBE) selects the original loop that examines one entry
+ * at a time, so that the two can be compared with HashTableBenchmark.
  */
 class HashTable {
   PRIVATE:
@@ -186,7 +212,11 @@ class HashTable {
         bool isDone();
 
       PRIVATE:
-        void init(CacheLine* cl, uint64_t secondaryHash);
+        void init(HashTable* hashTable, CacheLine* cl, uint64_t secondaryHash);
+
+        /// The table whose bucket is being iterated over. Used to keep
+        /// HashTable::numEntries up to date when entries are removed.
+        HashTable* hashTable;
 
         /// Pointer to the hash table bucket we're currently iterating over.
         CacheLine* bucket;
@@ -194,6 +224,18 @@ class HashTable {
         /// Index into bucket we're currently iterating over.
         uint32_t index;
 
+        /// The reference stored in the current candidate entry, as it was
+        /// when #next() examined it. Entries are only read once so that
+        /// readers who don't hold the bucket's lock (see
+        /// ObjectManager::readObject) never see a half-updated entry.
+        uint64_t reference;
+
+#ifndef HASHTABLE_SCALAR_PROBE
+        /// Bit i is set if entry i of #bucket has a tag matching
+        /// #secondaryHash and hasn't been visited yet.
+        uint32_t unvisitedMatches;
+#endif
+
         /// This iterator only returns references to entries that share this
         /// secondaryHash. All others cannot possibly be matches. This helps
         /// to reduce the number of candidates whose keys are extracted from
@@ -215,6 +257,12 @@ class HashTable {
     static uint32_t bytesPerCacheLine();
     static uint32_t entriesPerCacheLine();
     uint64_t getNumBuckets() const;
+    uint64_t getNumEntries() const;
+    double getLoadFactor() const;
+    uint64_t getSplitBucketIndex() const;
+    void prepareSplit();
+    uint64_t splitBucket(KeyHash (*getKeyHash)(uint64_t, void *),
+                         void *cookie);
     static uint64_t findBucketIndex(uint64_t numBuckets,
                                     KeyHash keyHash,
                                     uint64_t *secondaryHash);
@@ -226,11 +274,44 @@ class HashTable {
     struct CacheLine;
 
     CacheLine * findBucket(KeyHash keyHash, uint64_t *secondaryHash);
+    CacheLine * getBucket(uint64_t bucketIndex);
+    int getGrowthBlockIndex(uint64_t bucketIndex) const;
+#ifndef HASHTABLE_SCALAR_PROBE
+    static uint32_t findTagMatches(const CacheLine* cacheLine,
+                                   uint64_t secondaryHash);
+#endif
+    void insertInBucket(CacheLine* bucket,
+                        uint64_t secondaryHash,
+                        uint64_t reference);
+
+    /**
+     * Upper bound on the number of times the table can double in size: the
+     * bucket index is computed from at most 48 bits of the key hash.
+     */
+    static const int MAX_GROWTH_BLOCKS = 48;
 
     /**
-     * The number of buckets allocated to the table.
+     * The number of buckets currently in use (M in the description of
+     * online resizing above). Only #splitBucket() modifies this.
      */
-    const uint64_t numBuckets;
+    Atomic<uint64_t> numBuckets;
+
+    /**
+     * The number of buckets the table was created with. Always a power of
+     * two; buckets with indexes below this live in #buckets.
+     */
+    const uint64_t initialNumBuckets;
+
+    /**
+     * log2(#initialNumBuckets). Used to locate buckets in #growthBuckets.
+     */
+    const int initialNumBucketsShift;
+
+    /**
+     * The number of references currently stored in the table. This lets
+     * owners decide when the table should grow (see #getLoadFactor()).
+     */
+    Atomic<uint64_t> numEntries;
 
     /**
      * The array of buckets.
@@ -238,7 +319,18 @@ class HashTable {
      */
     LargeBlockOfMemory<CacheLine> buckets;
 
+    /**
+     * Storage for buckets added by online resizing. Block i holds the
+     * (#initialNumBuckets << i) buckets whose indexes start at
+     * (#initialNumBuckets << i). Blocks are allocated by #prepareSplit() and
+     * never move or shrink, so that readers may use buckets while the table
+     * grows.
+     */
+    std::unique_ptr<LargeBlockOfMemory<CacheLine>>
+            growthBuckets[MAX_GROWTH_BLOCKS];
+
     friend void hashTableBenchmark(uint64_t nkeys, uint64_t nlines);
+    friend void hashTableGrowthBenchmark(uint64_t nkeys, uint64_t nlines);
     DISALLOW_COPY_AND_ASSIGN(HashTable);
 };
 
@@ -43,6 +43,21 @@ class TestObject {
     uint64_t key;
 } __attribute__((aligned(64)));
 
+/**
+ * Name the cache line probing code compiled into HashTable, so that results
+ * from builds with and without HASHTABLE_PROBE=scalar can be told apart.
+ * Compare the two at load factors of 0.5, 0.9, and 1.0 (-f).
+ */
+const char*
+probeName()
+{
+#ifdef HASHTABLE_SCALAR_PROBE
+    return "scalar";
+#else
+    return "sse2";
+#endif
+}
+
 } // anonymous namespace
 
 void
@@ -52,11 +67,12 @@ hashTableBenchmark(uint64_t nkeys, uint64_t nlines)
     HashTable ht(nlines);
     LargeBlockOfMemory<TestObject> block(nkeys * sizeof(TestObject));
     TestObject* values = block.get();
-    assert(nlines == ht.numBuckets);
+    assert(nlines == ht.getNumBuckets());
 
     printf("hash table keys: %lu\n", nkeys);
     printf("hash table lines: %lu\n", nlines);
     printf("cache line size: %d\n", ht.bytesPerCacheLine());
+    printf("cache line probe: %s\n", probeName());
     printf("load factor: %.03f\n", static_cast<double>(nkeys) /
            (static_cast<double>(nlines) * ht.entriesPerCacheLine()));
 
@@ -155,7 +171,7 @@ hashTableBenchmark(uint64_t nkeys, uint64_t nlines)
         HashTable::Entry *entry;
 
         int depth = 1;
-        cl = &ht.buckets.get()[i];
+        cl = ht.getBucket(i);
         entry = &cl->entries[ht.entriesPerCacheLine() - 1];
         while ((cl = entry->getChainPointer()) != NULL) {
             depth++;
@@ -180,6 +196,93 @@ hashTableBenchmark(uint64_t nkeys, uint64_t nlines)
     histogram = NULL;
 }
 
+/**
+ * Used by hashTableGrowthBenchmark to recover the key hash of a TestObject
+ * when splitting buckets.
+ */
+static KeyHash
+getTestObjectKeyHash(uint64_t reference, void* cookie)
+{
+    TestObject* object = reinterpret_cast<TestObject*>(reference);
+    Key key(0, &object->key, sizeof(object->key));
+    return key.getHash();
+}
+
+/**
+ * Time lookups of keys [0, nkeys) in a table of TestObjects.
+ *
+ * \return
+ *      Average number of cycles per lookup.
+ */
+static uint64_t
+timeLookups(HashTable& ht, uint64_t nkeys)
+{
+    HashTable::Candidates c;
+    uint64_t start = Cycles::rdtsc();
+    for (uint64_t i = 0; i < nkeys; i++) {
+        Key key(0, &i, sizeof(i));
+        bool success = false;
+        ht.lookup(key.getHash(), c);
+        while (!c.isDone()) {
+            TestObject* candidateObject =
+                reinterpret_cast<TestObject*>(c.getReference());
+            if (candidateObject->key == i) {
+                success = true;
+                break;
+            }
+            c.next();
+        }
+        assert(success);
+    }
+    return (Cycles::rdtsc() - start) / nkeys;
+}
+
+/**
+ * Measure lookup latency while the table doubles in size with online
+ * resizing. Keys are inserted as the table grows, so that the load factor
+ * stays roughly constant, and lookups are timed after each step.
+ */
+void
+hashTableGrowthBenchmark(uint64_t nkeys, uint64_t nlines)
+{
+    const uint64_t steps = 16;
+    HashTable ht(nlines);
+    LargeBlockOfMemory<TestObject> block(2 * nkeys * sizeof(TestObject));
+    TestObject* values = block.get();
+
+    printf("hash table keys: %lu (growing to %lu)\n", nkeys, 2 * nkeys);
+    printf("hash table lines: %lu (growing to %lu)\n", nlines, 2 * nlines);
+    printf("cache line probe: %s\n", probeName());
+
+    uint64_t inserted = 0;
+    for (; inserted < nkeys; inserted++) {
+        values[inserted] = TestObject(inserted);
+        Key key(0, &inserted, sizeof(inserted));
+        ht.insert(key.getHash(),
+                  reinterpret_cast<uint64_t>(&values[inserted]));
+    }
+
+    printf("%8s %12s %12s %14s %14s\n", "buckets", "keys", "load factor",
+           "lookup ticks", "lookup nsec");
+    for (uint64_t step = 0; step <= steps; step++) {
+        if (step > 0) {
+            for (uint64_t i = 0; i < nlines / steps; i++)
+                ht.splitBucket(getTestObjectKeyHash, NULL);
+            uint64_t target = nkeys + nkeys * step / steps;
+            for (; inserted < target; inserted++) {
+                values[inserted] = TestObject(inserted);
+                Key key(0, &inserted, sizeof(inserted));
+                ht.insert(key.getHash(),
+                          reinterpret_cast<uint64_t>(&values[inserted]));
+            }
+        }
+        uint64_t ticks = timeLookups(ht, inserted);
+        printf("%8lu %12lu %12.3f %14lu %14lu\n", ht.getNumBuckets(),
+               inserted, ht.getLoadFactor(), ticks,
+               Cycles::toNanoseconds(ticks));
+    }
+}
+
 } // namespace RAMCloud
 
 int
@@ -191,6 +294,7 @@ main(int argc, char **argv)
 
     uint64_t hashTableMegs, numberOfKeys;
     double loadFactor;
+    bool grow;
 
     OptionsDescription benchmarkOptions("HashTableBenchmark");
     benchmarkOptions.add_options()
@@ -198,6 +302,9 @@ main(int argc, char **argv)
          ProgramOptions::value<uint64_t>(&hashTableMegs)->
             default_value(1),
          "Megabytes of memory allocated to the HashTable")
+        ("Grow,g",
+         ProgramOptions::bool_switch(&grow),
+         "Measure lookup latency while the table doubles in size")
         ("LoadFactor,f",
          ProgramOptions::value<double>(&loadFactor)->
             default_value(0.50),
@@ -223,6 +330,9 @@ main(int argc, char **argv)
                           static_cast<double>(totalEntries));
     }
 
-    hashTableBenchmark(numberOfKeys, numberOfCachelines);
+    if (grow)
+        hashTableGrowthBenchmark(numberOfKeys, numberOfCachelines);
+    else
+        hashTableBenchmark(numberOfKeys, numberOfCachelines);
     return 0;
 }
@@ -481,14 +481,14 @@ TEST_F(HashTableTest, constructor) {
 
 TEST_F(HashTableTest, constructor_truncate) {
     // This is effectively testing nearestPowerOfTwo.
-    EXPECT_EQ(1UL, HashTable(1).numBuckets);
-    EXPECT_EQ(2UL, HashTable(2).numBuckets);
-    EXPECT_EQ(2UL, HashTable(3).numBuckets);
-    EXPECT_EQ(4UL, HashTable(4).numBuckets);
-    EXPECT_EQ(4UL, HashTable(5).numBuckets);
-    EXPECT_EQ(4UL, HashTable(6).numBuckets);
-    EXPECT_EQ(4UL, HashTable(7).numBuckets);
-    EXPECT_EQ(8UL, HashTable(8).numBuckets);
+    EXPECT_EQ(1UL, HashTable(1).getNumBuckets());
+    EXPECT_EQ(2UL, HashTable(2).getNumBuckets());
+    EXPECT_EQ(2UL, HashTable(3).getNumBuckets());
+    EXPECT_EQ(4UL, HashTable(4).getNumBuckets());
+    EXPECT_EQ(4UL, HashTable(5).getNumBuckets());
+    EXPECT_EQ(4UL, HashTable(6).getNumBuckets());
+    EXPECT_EQ(4UL, HashTable(7).getNumBuckets());
+    EXPECT_EQ(8UL, HashTable(8).getNumBuckets());
 }
 
 TEST_F(HashTableTest, destructor) {
@@ -662,6 +662,50 @@ TEST_F(HashTableTest, lookup) {
     delete v;
 }
 
+#ifndef HASHTABLE_SCALAR_PROBE
+TEST_F(HashTableTest, findTagMatches) {
+    HashTable::CacheLine cl;
+    memset(&cl, 0, sizeof(cl));
+    EXPECT_EQ(0xffU, HashTable::findTagMatches(&cl, 0));
+    EXPECT_EQ(0U, HashTable::findTagMatches(&cl, 0xbeef));
+
+    cl.entries[0].setReference(0xbeef, 0x7fffffffffffUL);
+    cl.entries[3].setReference(0xbeef, 1);
+    cl.entries[5].setReference(0xbeee, 2);
+    cl.entries[7].setReference(0xbeef, 0xffff);
+    EXPECT_EQ(0x89U, HashTable::findTagMatches(&cl, 0xbeef));
+    EXPECT_EQ(0x20U, HashTable::findTagMatches(&cl, 0xbeee));
+    EXPECT_EQ(0x56U, HashTable::findTagMatches(&cl, 0));
+}
+#endif
+
+TEST_F(HashTableTest, Candidates_skipsEmptyAndChainEntries) {
+    // Every reference in the chain has secondary hash 0, which is also the
+    // tag of empty entries and chain pointers.
+    HashTable ht(1);
+    HashTable::CacheLine* overflow = static_cast<HashTable::CacheLine*>(
+            Memory::xmemalign(HERE, sizeof(HashTable::CacheLine),
+                              sizeof(HashTable::CacheLine)));
+    memset(overflow, 0, sizeof(*overflow));
+    HashTable::CacheLine* bucket = ht.getBucket(0);
+    bucket->entries[2].setReference(0, 10);
+    bucket->entries[HashTable::ENTRIES_PER_CACHE_LINE - 1].setChainPointer(
+            overflow);
+    overflow->entries[0].setReference(0, 11);
+    overflow->entries[6].setReference(0, 12);
+    overflow->entries[7].setReference(1, 13);
+
+    HashTable::Candidates candidates;
+    candidates.init(&ht, bucket, 0);
+    string references;
+    for (; !candidates.isDone(); candidates.next())
+        references += format("%lu ", candidates.getReference());
+    EXPECT_EQ("10 11 12 ", references);
+
+    bucket->entries[HashTable::ENTRIES_PER_CACHE_LINE - 1].clear();
+    free(overflow);
+}
+
 #if 0
 TEST_F(HashTableTest, remove) {
     HashTable ht(1);
@@ -811,4 +855,150 @@ TEST_F(HashTableTest, forEach) {
         EXPECT_EQ(1U, checkoff[i].count);
 }
 
+/**
+ * Callback used by the splitBucket tests to recover a TestObject's key hash.
+ */
+static KeyHash
+test_splitBucket_getKeyHash(uint64_t ref, void *cookie)
+{
+    EXPECT_EQ(cookie, reinterpret_cast<void *>(57));
+    TestObject* obj = reinterpret_cast<TestObject*>(ref);
+    Key key(obj->tableId, obj->stringKeyPtr, obj->stringKeyLength);
+    return key.getHash();
+}
+
+TEST_F(HashTableTest, getNumEntries) {
+    HashTable ht(4);
+    TestObject v(0, "0");
+    Key key(v.tableId, v.stringKeyPtr, v.stringKeyLength);
+    EXPECT_EQ(0UL, ht.getNumEntries());
+    replace(&ht, key, v.u64Address());
+    EXPECT_EQ(1UL, ht.getNumEntries());
+    EXPECT_DOUBLE_EQ(1.0 / 32.0, ht.getLoadFactor());
+
+    HashTable::Candidates candidates;
+    ht.lookup(key.getHash(), candidates);
+    candidates.remove();
+    EXPECT_EQ(0UL, ht.getNumEntries());
+}
+
+TEST_F(HashTableTest, findBucketIndex_linearHashing) {
+    uint64_t secondaryHash;
+
+    // Power-of-two sizes behave as a simple mask.
+    EXPECT_EQ(0x5UL, HashTable::findBucketIndex(8, 0xabcdUL, &secondaryHash));
+    EXPECT_EQ(0UL, HashTable::findBucketIndex(1, 0xabcdUL, &secondaryHash));
+
+    // With 10 buckets, buckets 0 and 1 have been split into 8 and 9;
+    // everything else still maps modulo 8.
+    EXPECT_EQ(0x8UL, HashTable::findBucketIndex(10, 0x8UL, &secondaryHash));
+    EXPECT_EQ(0x9UL, HashTable::findBucketIndex(10, 0x9UL, &secondaryHash));
+    EXPECT_EQ(0x2UL, HashTable::findBucketIndex(10, 0xaUL, &secondaryHash));
+    EXPECT_EQ(0x2UL, HashTable::findBucketIndex(10, 0x2UL, &secondaryHash));
+    EXPECT_EQ(0x7UL, HashTable::findBucketIndex(10, 0xfUL, &secondaryHash));
+    EXPECT_EQ(0x8UL, HashTable::findBucketIndex(10, 0xabcd000000000008UL,
+                                                &secondaryHash));
+    EXPECT_EQ(0xabcdUL, secondaryHash);
+}
+
+TEST_F(HashTableTest, getSplitBucketIndex) {
+    HashTable ht(4);
+    EXPECT_EQ(0UL, ht.getSplitBucketIndex());
+    ht.splitBucket(test_splitBucket_getKeyHash, reinterpret_cast<void *>(57));
+    EXPECT_EQ(1UL, ht.getSplitBucketIndex());
+    ht.splitBucket(test_splitBucket_getKeyHash, reinterpret_cast<void *>(57));
+    ht.splitBucket(test_splitBucket_getKeyHash, reinterpret_cast<void *>(57));
+    ht.splitBucket(test_splitBucket_getKeyHash, reinterpret_cast<void *>(57));
+    EXPECT_EQ(8UL, ht.getNumBuckets());
+    EXPECT_EQ(0UL, ht.getSplitBucketIndex());
+}
+
+TEST_F(HashTableTest, prepareSplit) {
+    HashTable ht(2);
+    EXPECT_FALSE(ht.growthBuckets[0]);
+    ht.prepareSplit();
+    ASSERT_TRUE(ht.growthBuckets[0]);
+    EXPECT_EQ(2 * sizeof(HashTable::CacheLine),
+              ht.growthBuckets[0]->length);
+
+    // Already allocated: nothing changes.
+    HashTable::CacheLine* block = ht.growthBuckets[0]->get();
+    ht.prepareSplit();
+    EXPECT_EQ(block, ht.growthBuckets[0]->get());
+    EXPECT_FALSE(ht.growthBuckets[1]);
+
+    ht.splitBucket(test_splitBucket_getKeyHash, reinterpret_cast<void *>(57));
+    ht.splitBucket(test_splitBucket_getKeyHash, reinterpret_cast<void *>(57));
+    ht.prepareSplit();
+    ASSERT_TRUE(ht.growthBuckets[1]);
+    EXPECT_EQ(4 * sizeof(HashTable::CacheLine),
+              ht.growthBuckets[1]->length);
+}
+
+TEST_F(HashTableTest, getBucket) {
+    HashTable ht(2);
+    for (int i = 0; i < 6; i++) {
+        ht.splitBucket(test_splitBucket_getKeyHash,
+                       reinterpret_cast<void *>(57));
+    }
+    EXPECT_EQ(&ht.buckets.get()[1], ht.getBucket(1));
+    EXPECT_EQ(&ht.growthBuckets[0]->get()[0], ht.getBucket(2));
+    EXPECT_EQ(&ht.growthBuckets[0]->get()[1], ht.getBucket(3));
+    EXPECT_EQ(&ht.growthBuckets[1]->get()[0], ht.getBucket(4));
+    EXPECT_EQ(&ht.growthBuckets[1]->get()[3], ht.getBucket(7));
+}
+
+TEST_F(HashTableTest, splitBucket) {
+    HashTable ht(1);
+    uint32_t arrayLen = 256;
+    TestObject* objects = new TestObject[arrayLen];
+    for (uint32_t i = 0; i < arrayLen; i++) {
+        objects[i].setKey(format("%u", i));
+        Key key(objects[i].tableId,
+                objects[i].stringKeyPtr,
+                objects[i].stringKeyLength);
+        replace(&ht, key, objects[i].u64Address());
+    }
+
+    // Grow from a single bucket to 13, checking each time that every key
+    // can still be found and that each one lives in the right bucket.
+    uint64_t totalMoved = 0;
+    for (uint64_t numBuckets = 2; numBuckets <= 13; numBuckets++) {
+        totalMoved += ht.splitBucket(test_splitBucket_getKeyHash,
+                                     reinterpret_cast<void *>(57));
+        EXPECT_EQ(numBuckets, ht.getNumBuckets());
+        for (uint32_t i = 0; i < arrayLen; i++) {
+            Key key(objects[i].tableId,
+                    objects[i].stringKeyPtr,
+                    objects[i].stringKeyLength);
+            uint64_t outRef;
+            EXPECT_TRUE(lookup(&ht, key, outRef));
+            EXPECT_EQ(objects[i].u64Address(), outRef);
+        }
+    }
+    EXPECT_GT(totalMoved, 0UL);
+    EXPECT_EQ(arrayLen, ht.getNumEntries());
+    EXPECT_EQ(arrayLen, ht.forEach(test_forEach_callback,
+                                   reinterpret_cast<void *>(57)));
+    for (uint32_t i = 0; i < arrayLen; i++)
+        EXPECT_EQ(1U, objects[i].count);
+
+    for (uint64_t b = 0; b < ht.getNumBuckets(); b++) {
+        HashTable::CacheLine* cl = ht.getBucket(b);
+        while (cl != NULL) {
+            for (uint32_t j = 0; j < ht.entriesPerCacheLine(); j++) {
+                HashTable::Entry* e = &cl->entries[j];
+                if (e->isAvailable() || e->getChainPointer() != NULL)
+                    continue;
+                uint64_t secondaryHash;
+                EXPECT_EQ(b, HashTable::findBucketIndex(13,
+                        test_splitBucket_getKeyHash(e->getReference(),
+                            reinterpret_cast<void *>(57)), &secondaryHash));
+            }
+            cl = cl->entries[ht.entriesPerCacheLine() - 1].getChainPointer();
+        }
+    }
+    delete[] objects;
+}
+
 } // namespace RAMCloud
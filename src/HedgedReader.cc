@@ -0,0 +1,191 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "HedgedReader.h"
+#include "ClientException.h"
+#include "Cycles.h"
+#include "Key.h"
+#include "RamCloud.h"
+#include "TransportManager.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct a HedgedReader; initially no table's reads are hedged.
+ *
+ * \param ramcloud
+ *      The client whose reads are hedged.
+ */
+HedgedReader::HedgedReader(RamCloud* ramcloud)
+    : hedges(0)
+    , replicaWins(0)
+    , ramcloud(ramcloud)
+    , tables()
+    , replicas()
+{
+}
+
+/**
+ * Start hedging the reads of a table, or change how stale the answers of
+ * its replicas may be if they are already hedged.
+ *
+ * \param tableId
+ *      The table whose reads should be hedged.
+ * \param maxStalenessMicros
+ *      How far (in microseconds) a replica may lag behind the master and
+ *      still answer a read.
+ */
+void
+HedgedReader::enable(uint64_t tableId, uint32_t maxStalenessMicros)
+{
+    auto it = tables.find(tableId);
+    if (it != tables.end()) {
+        it->second.maxStalenessMicros = maxStalenessMicros;
+        return;
+    }
+    tables.emplace(std::piecewise_construct, std::forward_as_tuple(tableId),
+            std::forward_as_tuple(maxStalenessMicros));
+}
+
+/**
+ * Read an object, hedging the read if its table's reads are hedged;
+ * otherwise the same as RamCloud::read (with no reject rules).
+ *
+ * \param tableId
+ *      The table containing the desired object.
+ * \param key
+ *      Variable length key that uniquely identifies the object within
+ *      tableId.
+ * \param keyLength
+ *      Size in bytes of the key.
+ * \param[out] value
+ *      After a successful return, this Buffer will hold the contents of
+ *      the desired object (only the value portion of the object).
+ * \param[out] version
+ *      If non-NULL, the version number of the object is returned here.
+ * \return
+ *      True means the read was done. False means reads of \a tableId
+ *      aren't hedged, and the caller should read the object itself.
+ */
+bool
+HedgedReader::read(uint64_t tableId, const void* key, uint16_t keyLength,
+        Buffer* value, uint64_t* version)
+{
+    auto it = tables.find(tableId);
+    if (it == tables.end())
+        return false;
+    Table* table = &it->second;
+
+    // Until the usual latency of the table's reads is known, there's no
+    // telling when a read is slow.
+    Transport::SessionRef replica;
+    if (table->deadline.getCycles() != 0)
+        replica = findReplica(tableId, key, keyLength);
+
+    // The replica's request must outlive the RPC, which may refer to it.
+    Buffer replicaRequest;
+    if (replica) {
+        WireFormat::ReadFromReplica::Request* reqHdr =
+                replicaRequest.emplaceAppend<
+                WireFormat::ReadFromReplica::Request>();
+        memset(reqHdr, 0, sizeof(*reqHdr));
+        reqHdr->common.opcode = WireFormat::ReadFromReplica::opcode;
+        reqHdr->common.service = WireFormat::ReadFromReplica::service;
+        reqHdr->tableId = tableId;
+        reqHdr->keyLength = keyLength;
+        reqHdr->maxStalenessMicros = table->maxStalenessMicros;
+        replicaRequest.append(key, keyLength);
+    }
+    ReadRpc rpc(ramcloud, tableId, key, keyLength, value);
+    rpc.waitHedged(ramcloud->clientContext->dispatch, &table->deadline,
+            replica, &replicaRequest);
+    if (rpc.wasHedged())
+        hedges++;
+    if (rpc.answeredByHedge())
+        replicaWins++;
+    rpc.wait(version);
+    return true;
+}
+
+/**
+ * Find the read replica of the tablet containing an object, asking the
+ * tablet's master if it hasn't been asked recently.
+ *
+ * \param tableId
+ *      The table containing the object.
+ * \param key
+ *      The object's primary key.
+ * \param keyLength
+ *      Size in bytes of the key.
+ * \return
+ *      A session to the replica, or NULL if the tablet has none.
+ */
+Transport::SessionRef
+HedgedReader::findReplica(uint64_t tableId, const void* key,
+        uint16_t keyLength)
+{
+    KeyHash keyHash = Key::getHash(tableId, key, keyLength);
+    uint64_t now = Cycles::rdtsc();
+    auto it = replicas.upper_bound(TabletKey(tableId, keyHash));
+    if (it != replicas.begin()) {
+        --it;
+        if (it->first.first == tableId && it->second.lastKeyHash >= keyHash) {
+            if (now < it->second.expiration)
+                return it->second.session;
+            replicas.erase(it);
+        }
+    }
+
+    Buffer output;
+    uint64_t firstKeyHash = keyHash;
+    uint64_t lastKeyHash = keyHash;
+    string locator;
+    try {
+        ramcloud->objectServerControl(tableId, key, keyLength,
+                WireFormat::GET_READ_REPLICA, NULL, 0, &output);
+        const WireFormat::ReadReplicaLocator* info =
+                output.getStart<WireFormat::ReadReplicaLocator>();
+        if (info != NULL) {
+            const char* chars = static_cast<const char*>(output.getRange(
+                    sizeof32(*info), info->locatorLength));
+            firstKeyHash = info->firstKeyHash;
+            lastKeyHash = info->lastKeyHash;
+            if (chars != NULL)
+                locator.assign(chars, info->locatorLength);
+        }
+    } catch (const ClientException& e) {
+        // The master doesn't support read replicas; remember that this
+        // key has no replica, so that it isn't asked on every read.
+    }
+
+    // Forget whatever was known about the tablets this one replaced.
+    replicas.erase(replicas.lower_bound(TabletKey(tableId, firstKeyHash)),
+            replicas.upper_bound(TabletKey(tableId, lastKeyHash)));
+    Replica* replica = &replicas[TabletKey(tableId, firstKeyHash)];
+    replica->lastKeyHash = lastKeyHash;
+    replica->session = NULL;
+    replica->expiration = now + Cycles::fromSeconds(REPLICA_REFRESH_SECONDS);
+    if (!locator.empty()) {
+        try {
+            replica->session = ramcloud->clientContext->transportManager->
+                    getSession(locator);
+        } catch (const TransportException& e) {
+            // Treat an unreachable replica as no replica.
+        }
+    }
+    return replica->session;
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,121 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_HEDGEDREADER_H
+#define RAMCLOUD_HEDGEDREADER_H
+
+#include <map>
+#include <unordered_map>
+
+#include "Common.h"
+#include "Buffer.h"
+#include "RpcWrapper.h"
+#include "Transport.h"
+
+namespace RAMCloud {
+
+class RamCloud;
+
+/**
+ * Hedges a client's reads of selected tables against slow masters (see
+ * RamCloud::enableHedgedReads). A master may be slow to answer because it
+ * is overloaded or busy cleaning; if its tablet has a read replica (see
+ * RamCloud::setReadReplica), a read that the master hasn't answered by the
+ * time most reads are done (the 95th percentile of the table's recent
+ * reads) is also sent to the replica, and whichever answers first wins.
+ * The replica only answers if it is within the table's staleness bound of
+ * the master; otherwise the read waits for the master as usual. The
+ * hedging itself is done by RpcWrapper::waitHedged.
+ *
+ * The read replica of each tablet is found by asking the tablet's master,
+ * and is remembered for a while. Not thread-safe: each RamCloud object has
+ * its own HedgedReader.
+ */
+class HedgedReader {
+  public:
+    explicit HedgedReader(RamCloud* ramcloud);
+    void enable(uint64_t tableId, uint32_t maxStalenessMicros);
+    bool read(uint64_t tableId, const void* key, uint16_t keyLength,
+            Buffer* value, uint64_t* version);
+
+    /// Reads that were also sent to a replica.
+    uint64_t hedges;
+
+    /// Hedged reads that the replica answered first.
+    uint64_t replicaWins;
+
+  PRIVATE:
+    /// How long a tablet's read replica is remembered before its master
+    /// is asked again, in seconds.
+    static const uint32_t REPLICA_REFRESH_SECONDS = 1;
+
+    /// A table whose reads are hedged.
+    struct Table {
+        explicit Table(uint32_t maxStalenessMicros)
+            : maxStalenessMicros(maxStalenessMicros)
+            , deadline(0.95)
+        {}
+
+        /// How stale the replicas' answers may be, in microseconds.
+        uint32_t maxStalenessMicros;
+
+        /// Follows the latencies of the table's reads from masters, and
+        /// decides when a read is hedged.
+        RpcWrapper::HedgeDeadline deadline;
+
+        DISALLOW_COPY_AND_ASSIGN(Table);
+    };
+
+    /// The read replica of a tablet, as last reported by its master.
+    struct Replica {
+        Replica()
+            : lastKeyHash(0)
+            , session()
+            , expiration(0)
+        {}
+
+        /// Last key hash in the tablet (the first one is its key in
+        /// #replicas).
+        uint64_t lastKeyHash;
+
+        /// Session to the replica; NULL if the tablet has none.
+        Transport::SessionRef session;
+
+        /// Cycles::rdtsc() time after which the master should be asked
+        /// again.
+        uint64_t expiration;
+    };
+
+    /// Identifies a tablet by its table id and first key hash.
+    typedef std::pair<uint64_t, uint64_t> TabletKey;
+
+    Transport::SessionRef findReplica(uint64_t tableId, const void* key,
+            uint16_t keyLength);
+
+    /// Used to issue reads.
+    RamCloud* ramcloud;
+
+    /// Tables whose reads are hedged, indexed by table id.
+    std::unordered_map<uint64_t, Table> tables;
+
+    /// Known read replicas of the tablets of hedged tables.
+    std::map<TabletKey, Replica> replicas;
+
+    DISALLOW_COPY_AND_ASSIGN(HedgedReader);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_HEDGEDREADER_H
@@ -0,0 +1,121 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "HedgedReader.h"
+#include "MockCluster.h"
+#include "RamCloud.h"
+
+namespace RAMCloud {
+
+class HedgedReaderTest : public ::testing::Test {
+  public:
+    TestLog::Enable logEnabler;
+    Context context;
+    MockCluster cluster;
+    Tub<RamCloud> ramcloud;
+    HedgedReader* reader;
+    Server* replica;
+    uint64_t tableId;
+
+    HedgedReaderTest()
+        : logEnabler()
+        , context()
+        , cluster(&context)
+        , ramcloud()
+        , reader(NULL)
+        , replica(NULL)
+        , tableId(-1)
+    {
+        Logger::get().setLogLevels(RAMCloud::SILENT_LOG_LEVEL);
+
+        ServerConfig config = ServerConfig::forTesting();
+        config.services = {WireFormat::MASTER_SERVICE,
+                           WireFormat::PING_SERVICE};
+        config.localLocator = "mock:host=master";
+        cluster.addServer(config);
+
+        ramcloud.construct(&context, "mock:host=coordinator");
+        tableId = ramcloud->createTable("table");
+
+        // Added after the table was created, so it holds none of it.
+        config.localLocator = "mock:host=replica";
+        replica = cluster.addServer(config);
+
+        ramcloud->enableHedgedReads(tableId, 1000);
+        reader = ramcloud->hedgedReader;
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(HedgedReaderTest);
+};
+
+TEST_F(HedgedReaderTest, enable) {
+    EXPECT_EQ(1U, reader->tables.size());
+    EXPECT_EQ(1000U, reader->tables.at(tableId).maxStalenessMicros);
+    reader->tables.at(tableId).deadline.cycles = 5;
+    ramcloud->enableHedgedReads(tableId, 2000);
+    EXPECT_EQ(1U, reader->tables.size());
+    EXPECT_EQ(2000U, reader->tables.at(tableId).maxStalenessMicros);
+    EXPECT_EQ(5U, reader->tables.at(tableId).deadline.getCycles());
+}
+
+TEST_F(HedgedReaderTest, read) {
+    ramcloud->write(tableId, "a", 1, "one");
+    Buffer value;
+    uint64_t version;
+    EXPECT_FALSE(reader->read(tableId + 1, "a", 1, &value, &version));
+    EXPECT_TRUE(reader->read(tableId, "a", 1, &value, &version));
+    EXPECT_EQ("one", TestUtil::toString(&value));
+    EXPECT_EQ(1U, reader->tables.at(tableId).deadline.samples.size());
+
+    // Reads whose masters answer in time aren't hedged.
+    ramcloud->setReadReplica(tableId, "a", 1, replica->serverId);
+    reader->tables.at(tableId).deadline.cycles = ~0UL;
+    ramcloud->read(tableId, "a", 1, &value);
+    EXPECT_EQ("one", TestUtil::toString(&value));
+    EXPECT_EQ(1U, reader->replicas.size());
+    EXPECT_EQ(0U, reader->hedges);
+    EXPECT_EQ(2U, reader->tables.at(tableId).deadline.samples.size());
+}
+
+TEST_F(HedgedReaderTest, findReplica) {
+    // No replica yet; that is remembered too.
+    EXPECT_FALSE(reader->findReplica(tableId, "a", 1));
+    EXPECT_EQ(1U, reader->replicas.size());
+    EXPECT_EQ(0U, reader->replicas.begin()->first.second);
+    EXPECT_EQ(~0UL, reader->replicas.begin()->second.lastKeyHash);
+
+    ramcloud->setReadReplica(tableId, "a", 1, replica->serverId);
+    EXPECT_FALSE(reader->findReplica(tableId, "b", 1));
+
+    // Once the entry expires the master is asked again.
+    reader->replicas.begin()->second.expiration = 0;
+    Transport::SessionRef session = reader->findReplica(tableId, "b", 1);
+    ASSERT_TRUE(session);
+    EXPECT_EQ("mock:host=replica", session->getServiceLocator());
+    EXPECT_EQ(1U, reader->replicas.size());
+}
+
+TEST_F(HedgedReaderTest, readFromReplicaRpc_notReplica) {
+    ramcloud->write(tableId, "a", 1, "one");
+    Buffer value;
+    Transport::SessionRef session =
+            context.transportManager->getSession("mock:host=replica");
+    ReadFromReplicaRpc rpc(ramcloud.get(), session, tableId, "a", 1, 1000,
+            &value);
+    EXPECT_FALSE(rpc.wait());
+}
+
+}  // namespace RAMCloud
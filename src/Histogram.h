@@ -271,6 +271,62 @@ class Histogram {
         return -1;
     }
 
+    /**
+     * Get the value below which a given fraction of the samples stored in
+     * the histogram fall (unlike getMedian, this is a sample value rather
+     * than a bucket index). If that falls within the outliers, the largest
+     * sample is returned, since it bounds the true value. If no samples were
+     * stored, returns 0.
+     *
+     * \param fraction
+     *      Fraction of the samples, such as 0.99 for the 99th percentile.
+     */
+    uint64_t
+    getPercentile(double fraction) const
+    {
+        uint64_t totalSamples = getTotalSamples();
+        if (totalSamples == 0)
+            return 0;
+
+        uint64_t target = static_cast<uint64_t>(
+                fraction * static_cast<double>(totalSamples));
+        uint64_t currentCount = 0;
+        for (uint64_t i = 0; i < numBuckets; i++) {
+            currentCount += buckets[i];
+            if (currentCount > target)
+                return i * bucketWidth;
+        }
+        return max;
+    }
+
+    /**
+     * Add all of the samples stored in another histogram to this one (for
+     * example, to combine measurements taken on several clients).
+     *
+     * \param other
+     *      Histogram to add; must have the same number of buckets and
+     *      bucket width as this one.
+     *
+     * \throw FatalError
+     *      The histograms have different shapes.
+     */
+    void
+    merge(const Histogram& other)
+    {
+        if ((other.numBuckets != numBuckets) ||
+                (other.bucketWidth != bucketWidth))
+            throw FatalError(HERE, "can't merge histograms of different "
+                    "shapes");
+        for (uint64_t i = 0; i < numBuckets; i++)
+            buckets[i] += other.buckets[i];
+        sampleSum += other.sampleSum;
+        outliers += other.outliers;
+        if (other.min < min)
+            min = other.min;
+        if (other.max > max)
+            max = other.max;
+    }
+
     /**
      * Serialize the histogram to a protocol buffer for network transmission.
      */
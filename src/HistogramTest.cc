@@ -203,6 +203,42 @@ TEST_F(HistogramTest, getMedian) {
     EXPECT_EQ(5UL, h2.getMedian());
 }
 
+TEST_F(HistogramTest, getPercentile) {
+    Histogram noSamples(10, 1);
+    EXPECT_EQ(0UL, noSamples.getPercentile(0.5));
+
+    Histogram h(10, 10);
+    for (int i = 0; i < 100; i++)
+        h.storeSample(i);
+    EXPECT_EQ(0UL, h.getPercentile(0.0));
+    EXPECT_EQ(50UL, h.getPercentile(0.5));
+    EXPECT_EQ(90UL, h.getPercentile(0.9));
+
+    // percentile falls within outliers
+    h.storeSample(1000);
+    h.storeSample(2000);
+    EXPECT_EQ(2000UL, h.getPercentile(0.99));
+}
+
+TEST_F(HistogramTest, merge) {
+    Histogram h1(10, 1);
+    h1.storeSample(3);
+    h1.storeSample(20);
+    Histogram h2(10, 1);
+    h2.storeSample(3);
+    h2.storeSample(1);
+    h1.merge(h2);
+    EXPECT_EQ(2UL, h1.buckets[3]);
+    EXPECT_EQ(1UL, h1.buckets[1]);
+    EXPECT_EQ(1UL, h1.outliers);
+    EXPECT_EQ(1UL, h1.min);
+    EXPECT_EQ(20UL, h1.max);
+    EXPECT_EQ(27UL, downCast<uint64_t>(h1.sampleSum));
+
+    Histogram h3(10, 2);
+    EXPECT_THROW(h1.merge(h3), FatalError);
+}
+
 TEST_F(HistogramTest, serialize) {
     // Covered by 'constructor_deserializer'.
 }
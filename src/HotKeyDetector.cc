@@ -0,0 +1,146 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <algorithm>
+
+#include "HotKeyDetector.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct a HotKeyDetector with no candidate keys.
+ *
+ * \param capacity
+ *      Maximum number of candidate keys to keep track of. Keys that make up
+ *      more than 1/capacity of the sampled accesses are always found; the
+ *      table is scanned linearly, so this should be small.
+ * \param sampleInterval
+ *      One in every this many accesses is sampled; 1 means record all of
+ *      them.
+ */
+HotKeyDetector::HotKeyDetector(uint32_t capacity, uint32_t sampleInterval)
+    : shards()
+    , capacity(capacity)
+    , sampleInterval(sampleInterval)
+    , mutex("HotKeyDetector::mutex")
+    , candidates()
+    , samplesSinceDecay(0)
+{
+    candidates.reserve(capacity);
+}
+
+/**
+ * Return the current candidate hot keys.
+ *
+ * \param[out] hotKeys
+ *      The candidates are appended here, with the most frequently accessed
+ *      first. Counts are estimates of the number of accesses since the
+ *      counts were last decayed (i.e., samples scaled by the sampling
+ *      interval).
+ */
+void
+HotKeyDetector::getHotKeys(vector<HotKey>* hotKeys)
+{
+    size_t first = hotKeys->size();
+    {
+        SpinLock::Guard _(mutex);
+        hotKeys->insert(hotKeys->end(), candidates.begin(), candidates.end());
+    }
+    for (size_t i = first; i < hotKeys->size(); i++) {
+        (*hotKeys)[i].count *= sampleInterval;
+        (*hotKeys)[i].error *= sampleInterval;
+    }
+    std::sort(hotKeys->begin() + first, hotKeys->end(),
+            [] (const HotKey& a, const HotKey& b) {
+                return a.count > b.count;
+            });
+}
+
+/**
+ * Add the current candidate hot keys to a ServerStatistics protocol buffer,
+ * most frequently accessed first.
+ */
+void
+HotKeyDetector::getStatistics(ProtoBuf::ServerStatistics* serverStatistics)
+{
+    vector<HotKey> hotKeys;
+    getHotKeys(&hotKeys);
+    foreach (HotKey& hotKey, hotKeys) {
+        ProtoBuf::ServerStatistics_HotKey* entry =
+                serverStatistics->add_hot_key();
+        entry->set_table_id(hotKey.tableId);
+        entry->set_key_hash(hotKey.keyHash);
+        entry->set_count(hotKey.count);
+        if (hotKey.error > 0)
+            entry->set_error(hotKey.error);
+    }
+}
+
+/**
+ * Add one sampled access to the candidate table (this is the slow path of
+ * record).
+ *
+ * \param tableId
+ *      The table containing the key.
+ * \param keyHash
+ *      Hash of the key's primary key.
+ */
+void
+HotKeyDetector::recordSample(uint64_t tableId, uint64_t keyHash)
+{
+    SpinLock::Guard _(mutex);
+
+    samplesSinceDecay++;
+    if (samplesSinceDecay >= DECAY_SAMPLES) {
+        samplesSinceDecay = 0;
+        size_t kept = 0;
+        for (size_t i = 0; i < candidates.size(); i++) {
+            HotKey hotKey = candidates[i];
+            hotKey.count /= 2;
+            hotKey.error /= 2;
+            if (hotKey.count > 0)
+                candidates[kept++] = hotKey;
+        }
+        candidates.resize(kept);
+    }
+
+    // Look for the key, remembering the least-counted candidate in case
+    // it isn't there.
+    HotKey* min = NULL;
+    foreach (HotKey& hotKey, candidates) {
+        if (hotKey.keyHash == keyHash && hotKey.tableId == tableId) {
+            hotKey.count++;
+            return;
+        }
+        if (min == NULL || hotKey.count < min->count)
+            min = &hotKey;
+    }
+
+    if (candidates.size() < capacity) {
+        candidates.push_back({tableId, keyHash, 1, 0});
+        return;
+    }
+    if (min == NULL)
+        return;
+
+    // The new key takes over the count of the key it replaces: it could
+    // have accounted for all of those accesses while it wasn't tracked.
+    min->tableId = tableId;
+    min->keyHash = keyHash;
+    min->error = min->count;
+    min->count++;
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,147 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_HOTKEYDETECTOR_H
+#define RAMCLOUD_HOTKEYDETECTOR_H
+
+#include "Atomic.h"
+#include "Common.h"
+#include "ServerStatistics.pb.h"
+#include "SpinLock.h"
+#include "ThreadId.h"
+
+namespace RAMCloud {
+
+/**
+ * Finds the individual keys that a master accesses most often, so that
+ * hot keys can be reported along with the per-tablet counts (which only
+ * say which tablets are hot). It implements the Space-Saving heavy-hitter
+ * algorithm over a sample of the accesses: one in every sampleInterval
+ * accesses (counted separately for each shard of threads, so counting
+ * doesn't bounce a cache line between threads) is added to a small table
+ * of candidate keys. When a sampled key isn't in the full table, it
+ * replaces the candidate with the smallest count and inherits that count
+ * (which becomes its error bound). Any key with more than 1/capacity of the
+ * samples is guaranteed to be in the table.
+ *
+ * Counts are halved every DECAY_SAMPLES samples, so the table reflects
+ * recent accesses rather than the server's whole lifetime.
+ *
+ * This class is thread-safe.
+ */
+class HotKeyDetector {
+  PUBLIC:
+    /// Default for the constructor's capacity argument.
+    static const uint32_t DEFAULT_CAPACITY = 32;
+
+    /// Default for the constructor's sampleInterval argument.
+    static const uint32_t DEFAULT_SAMPLE_INTERVAL = 16;
+
+    /// Counts are halved whenever this many samples have been recorded
+    /// since the last time.
+    static const uint32_t DECAY_SAMPLES = 10000;
+
+    /**
+     * Describes one of the candidate keys.
+     */
+    struct HotKey {
+        /// The table containing the key.
+        uint64_t tableId;
+
+        /// Hash of the key's primary key.
+        uint64_t keyHash;
+
+        /// Estimated number of accesses to the key (since the counts were
+        /// last decayed); an overestimate by at most #error.
+        uint64_t count;
+
+        /// Upper bound on how much #count overestimates.
+        uint64_t error;
+    };
+
+    explicit HotKeyDetector(uint32_t capacity = DEFAULT_CAPACITY,
+            uint32_t sampleInterval = DEFAULT_SAMPLE_INTERVAL);
+    void getHotKeys(vector<HotKey>* hotKeys);
+    void getStatistics(ProtoBuf::ServerStatistics* serverStatistics);
+
+    /**
+     * Record an access to a key. This is called for every object read and
+     * write, so it does no more than count unless the access is sampled.
+     *
+     * \param tableId
+     *      The table containing the key.
+     * \param keyHash
+     *      Hash of the key's primary key.
+     */
+    void
+    record(uint64_t tableId, uint64_t keyHash)
+    {
+        Shard* shard = &shards[ThreadId::get() & (NUM_SHARDS - 1)];
+        uint32_t count = shard->count.load() + 1;
+        if (count < sampleInterval) {
+            shard->count.store(count);
+            return;
+        }
+        shard->count.store(0);
+        recordSample(tableId, keyHash);
+    }
+
+  PRIVATE:
+    /// Number of shards that threads are divided among for counting
+    /// accesses (by ThreadId). Must be a power of two.
+    static const int NUM_SHARDS = 16;
+
+    /**
+     * The accesses counted by one shard of threads since its last sample,
+     * padded out to a cache line.
+     */
+    struct Shard {
+        Shard()
+            : count(0)
+            , pad()
+        {
+        }
+        Atomic<uint32_t> count;
+        char pad[60];
+    };
+    static_assert(sizeof(Shard) == 64, "Shard isn't one cache line");
+
+    void recordSample(uint64_t tableId, uint64_t keyHash);
+
+    /// Counts of accesses, one per shard.
+    Shard shards[NUM_SHARDS];
+
+    /// Maximum number of entries in #candidates.
+    uint32_t capacity;
+
+    /// One in every this many accesses is sampled.
+    uint32_t sampleInterval;
+
+    /// Protects #candidates and #samplesSinceDecay.
+    SpinLock mutex;
+
+    /// The candidate hot keys, in no particular order. Counts are in
+    /// samples, not accesses.
+    vector<HotKey> candidates;
+
+    /// Number of samples recorded since counts were last halved.
+    uint32_t samplesSinceDecay;
+
+    DISALLOW_COPY_AND_ASSIGN(HotKeyDetector);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_HOTKEYDETECTOR_H
@@ -0,0 +1,109 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "HotKeyDetector.h"
+
+namespace RAMCloud {
+
+/// Return a printable form of a detector's candidates, hottest first.
+static string
+toString(HotKeyDetector& detector)
+{
+    vector<HotKeyDetector::HotKey> hotKeys;
+    detector.getHotKeys(&hotKeys);
+    string result;
+    foreach (HotKeyDetector::HotKey& hotKey, hotKeys) {
+        if (!result.empty())
+            result.append(" ");
+        result.append(format("%lu/%lu:%lu(%lu)", hotKey.tableId,
+                hotKey.keyHash, hotKey.count, hotKey.error));
+    }
+    return result;
+}
+
+TEST(HotKeyDetectorTest, record_sampling) {
+    HotKeyDetector detector(4, 4);
+    detector.record(1, 10);
+    detector.record(1, 11);
+    detector.record(1, 12);
+    EXPECT_EQ("", toString(detector));
+    detector.record(1, 13);
+    EXPECT_EQ("1/13:4(0)", toString(detector));
+    for (int i = 0; i < 7; i++)
+        detector.record(1, 13);
+    EXPECT_EQ("1/13:8(0)", toString(detector));
+}
+
+TEST(HotKeyDetectorTest, recordSample_existingKey) {
+    HotKeyDetector detector(4, 1);
+    detector.record(1, 10);
+    detector.record(2, 10);
+    detector.record(1, 10);
+    EXPECT_EQ("1/10:2(0) 2/10:1(0)", toString(detector));
+}
+
+TEST(HotKeyDetectorTest, recordSample_replaceMinimum) {
+    HotKeyDetector detector(2, 1);
+    detector.record(1, 10);
+    detector.record(1, 10);
+    detector.record(1, 10);
+    detector.record(1, 10);
+    detector.record(1, 11);
+    detector.record(1, 11);
+    detector.record(1, 12);
+    EXPECT_EQ("1/10:4(0) 1/12:3(2)", toString(detector));
+}
+
+TEST(HotKeyDetectorTest, recordSample_decay) {
+    HotKeyDetector detector(4, 1);
+    for (uint32_t i = 0; i < HotKeyDetector::DECAY_SAMPLES - 3; i++)
+        detector.record(1, 10);
+    detector.record(1, 11);
+    detector.record(1, 12);
+    EXPECT_EQ("1/10:9997(0) 1/11:1(0) 1/12:1(0)", toString(detector));
+
+    // The next sample halves the counts first, which drops keys 11 and 12.
+    detector.record(1, 13);
+    EXPECT_EQ("1/10:4998(0) 1/13:1(0)", toString(detector));
+}
+
+TEST(HotKeyDetectorTest, getHotKeys_appends) {
+    HotKeyDetector detector(4, 2);
+    detector.record(1, 10);
+    detector.record(1, 10);
+    vector<HotKeyDetector::HotKey> hotKeys;
+    hotKeys.push_back({5, 50, 1, 0});
+    detector.getHotKeys(&hotKeys);
+    ASSERT_EQ(2U, hotKeys.size());
+    EXPECT_EQ(50U, hotKeys[0].keyHash);
+    EXPECT_EQ(10U, hotKeys[1].keyHash);
+    EXPECT_EQ(2U, hotKeys[1].count);
+}
+
+TEST(HotKeyDetectorTest, getStatistics) {
+    HotKeyDetector detector(1, 1);
+    ProtoBuf::ServerStatistics stats;
+    detector.getStatistics(&stats);
+    EXPECT_EQ("", stats.ShortDebugString());
+
+    detector.record(3, 30);
+    detector.record(3, 31);
+    detector.getStatistics(&stats);
+    EXPECT_EQ("hot_key { table_id: 3 key_hash: 31 count: 2 error: 1 }",
+            stats.ShortDebugString());
+}
+
+}  // namespace RAMCloud
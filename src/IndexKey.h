@@ -25,6 +25,17 @@ class IndexKey {
 
   PUBLIC:
 
+    /// Values for the indexType argument of RamCloud::createIndex.
+    enum IndexType : uint8_t {
+        /// Entries are kept in a B+ tree, which supports both range and
+        /// equality lookups.
+        BTREE_INDEX = 0,
+        /// Entries are kept in a hash table keyed by secondary key. Only
+        /// equality lookups are supported, but each one takes a single
+        /// hash table probe instead of a walk down the tree.
+        HASH_INDEX = 1,
+    };
+
     /// Class used to define a range of keys [first key, last key]
     /// for a particular index id, that can be used to compare a given
     /// object to determine if its corresponding key falls in this range.
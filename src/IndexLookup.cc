@@ -64,7 +64,7 @@ IndexLookup::IndexLookup(
             ramcloud, tableId, keyRange.indexId,
             keyRange.firstKey, keyRange.firstKeyLength, 0,
             keyRange.lastKey, keyRange.lastKeyLength,
-            (uint32_t)MAX_ALLOWED_HASHES, &lookupRpc.resp);
+            (uint32_t)MAX_ALLOWED_HASHES, &lookupRpc.resp, true);
 }
 
 IndexLookup::~IndexLookup()
@@ -127,6 +127,7 @@ IndexLookup::isReady()
                     + (lookupRpc.numHashes * (uint32_t) sizeof(KeyHash));
                 lookupRpc.resp.copy(off, nextKeyLength, nextKey);
             }
+            saveLookupObjects();
             lookupRpc.status = RESULT_READY;
         }
 
@@ -142,6 +143,11 @@ IndexLookup::isReady()
                 activeHashes[numInserted & ARRAY_MASK]
                     = *lookupRpc.resp.getOffset<KeyHash>(lookupRpc.offset);
                 activeRpcIds[numInserted & ARRAY_MASK] = RPC_ID_NOT_ASSIGNED;
+                if (lookupRpc.numObjectHashes > 0) {
+                    activeRpcIds[numInserted & ARRAY_MASK] =
+                            lookupRpc.objectRpcId;
+                    lookupRpc.numObjectHashes--;
+                }
                 lookupRpc.offset += sizeof32(KeyHash);
                 lookupRpc.numHashes--;
                 numInserted++;
@@ -163,7 +169,7 @@ IndexLookup::isReady()
                 lookupRpc.rpc.construct(ramcloud, tableId, keyRange.indexId,
                         nextKey, nextKeyLength, nextKeyHash,
                         keyRange.lastKey, keyRange.lastKeyLength,
-                        (uint32_t)MAX_ALLOWED_HASHES, &lookupRpc.resp);
+                        (uint32_t)MAX_ALLOWED_HASHES, &lookupRpc.resp, true);
                 lookupRpc.status = SENT;
             }
         }
@@ -262,33 +268,65 @@ IndexLookup::isReady()
             if (numProcessedPKHashes == 0)
                 ramcloud->clientContext->objectFinder->flush(tableId);
             if (numProcessedPKHashes < readRpcs[i].numHashes) {
+                // If the server processed some of the hashes, it stopped
+                // because the response message was full, and it still
+                // stores the rest: send them to it again right away, so
+                // the next chunk of objects arrives while the client works
+                // through this one.
+                uint8_t nextRpcId = RPC_ID_NOT_ASSIGNED;
+                if (numProcessedPKHashes > 0) {
+                    for (uint8_t j = 0; j < NUM_READ_RPCS; j++) {
+                        if (readRpcs[j].status == FREE) {
+                            nextRpcId = j;
+                            readRpcs[j].session = readRpcs[i].session;
+                            readRpcs[j].numHashes = 0;
+                            readRpcs[j].pKHashes.reset();
+                            readRpcs[j].status = LOADING;
+                            readRpcs[j].maxPos = 0;
+                            break;
+                        }
+                    }
+                }
                 for (size_t p = numRemoved; p < numInserted; p ++) {
                     // Some of the key hashes couldn't be looked up in this
                     // request (either because they aren't stored by that
                     // server, because the server crashed, or because there
-                    // wasn't enough space in the response message). Mark
-                    // the unprocessed hashes so they will get reassigned to
+                    // wasn't enough space in the response message). Unless
+                    // they went into the continuation RPC above, mark the
+                    // unprocessed hashes so they will get reassigned to
                     // new RPCs.
-                    if (activeRpcIds[p] == i) {
+                    if (activeRpcIds[p & ARRAY_MASK] == i) {
                         // got first numProcessedPKHashes in this Rpc
                         if (numProcessedPKHashes > 0) {
                             numProcessedPKHashes--;
+                        } else if (nextRpcId != RPC_ID_NOT_ASSIGNED) {
+                            ReadRpc* next = &readRpcs[nextRpcId];
+                            next->pKHashes.emplaceAppend<KeyHash>(
+                                    activeHashes[p & ARRAY_MASK]);
+                            next->numHashes++;
+                            next->maxPos = p;
+                            activeRpcIds[p & ARRAY_MASK] = nextRpcId;
                         } else { // the rest need to be re-assigned
-                            activeRpcIds[p] = RPC_ID_NOT_ASSIGNED;
+                            activeRpcIds[p & ARRAY_MASK] = RPC_ID_NOT_ASSIGNED;
                             if (p < numAssigned)
                                 numAssigned = p;
                         }
                     }
                 }
+                if (nextRpcId != RPC_ID_NOT_ASSIGNED)
+                    launchReadRpc(nextRpcId);
             }
         }
 
         // Rule 9:
         // If all objects have been read by user, this RPC is free to be
-        // reused.
+        // reused (unless it holds objects from the lookup whose hashes
+        // haven't all been copied to activeHashes yet).
         if (readRpcs[i].status == RESULT_READY
                 && receivedReadHashes == false
-                && readRpcs[i].numUnreadObjects == 0) {
+                && readRpcs[i].numUnreadObjects == 0
+                && !(lookupRpc.numObjectHashes > 0
+                    && lookupRpc.objectRpcId == i)) {
             readRpcs[i].status = FREE;
         }
     }
@@ -444,4 +482,44 @@ IndexLookup::launchReadRpc(uint8_t i)
     readRpcs[i].status = SENT;
 }
 
+/**
+ * Called when a lookupIndexKeys RPC completes. If the index server also
+ * returned objects for some of the hashes (because it stores them too),
+ * move those objects to a free ReadRpc, as if a readHashes RPC had
+ * already returned them, so that they needn't be read again.
+ */
+void
+IndexLookup::saveLookupObjects()
+{
+    const WireFormat::LookupIndexKeys::Response* respHdr =
+            lookupRpc.resp.getStart<WireFormat::LookupIndexKeys::Response>();
+    lookupRpc.numObjectHashes = 0;
+    if (respHdr == NULL || respHdr->numObjectHashes == 0)
+        return;
+
+    // If all of the ReadRpcs are busy, the objects are simply dropped,
+    // and the hashes will be read with readHashes RPCs like any others.
+    for (uint8_t i = 0; i < NUM_READ_RPCS; i++) {
+        if (readRpcs[i].status != FREE)
+            continue;
+
+        uint32_t offset = lookupRpc.offset
+                + lookupRpc.numHashes * sizeof32(KeyHash)
+                + respHdr->nextKeyLength;
+        uint32_t length = lookupRpc.resp.size() - offset;
+        ReadRpc& readRpc = readRpcs[i];
+        readRpc.resp.reset();
+        if (length > 0)
+            lookupRpc.resp.copy(offset, length, readRpc.resp.alloc(length));
+        readRpc.session = NULL;
+        readRpc.numHashes = respHdr->numObjectHashes;
+        readRpc.numUnreadObjects = respHdr->numObjects;
+        readRpc.offset = 0;
+        readRpc.status = RESULT_READY;
+        lookupRpc.numObjectHashes = respHdr->numObjectHashes;
+        lookupRpc.objectRpcId = i;
+        return;
+    }
+}
+
 } // end RAMCloud
@@ -82,8 +82,20 @@ class IndexLookup {
         /// been copied to activeHashes.
         uint32_t offset;
 
+        /// The number of primary key hashes from resp buffer that have not
+        /// yet been copied to activeHashes, and whose objects came back
+        /// with the lookup (because the index server also stores them).
+        /// These hashes come first, and are assigned to readRpcs[objectRpcId]
+        /// rather than being read with readHashes RPCs.
+        uint32_t numObjectHashes;
+
+        /// Index of the ReadRpc holding the objects that came back with the
+        /// lookup; only meaningful if numObjectHashes > 0.
+        uint8_t objectRpcId;
+
         LookupRpc()
             : rpc(), status(FREE), resp(), numHashes(), offset()
+            , numObjectHashes(), objectRpcId()
         {}
     };
 
@@ -130,6 +142,7 @@ class IndexLookup {
     };
 
     void launchReadRpc(uint8_t i);
+    void saveLookupObjects();
 
     /// Overall client state information.
     RamCloud* ramcloud;
@@ -143,6 +143,9 @@ TEST_F(IndexLookupTest, isReady_lookupComplete) {
     respBuffer->emplaceAppend<uint16_t>(uint16_t(nextKeyLen));
     // nextKeyHash
     respBuffer->emplaceAppend<uint64_t>(0);
+    // numObjectHashes and numObjects
+    respBuffer->emplaceAppend<uint32_t>(0);
+    respBuffer->emplaceAppend<uint32_t>(0);
     for (KeyHash i = 0; i < 10; i++) {
         respBuffer->emplaceAppend<KeyHash>(i);
     }
@@ -166,6 +169,8 @@ TEST_F(IndexLookupTest, isReady_activeHashes) {
     indexLookup.lookupRpc.rpc->response->emplaceAppend<uint32_t>(10);
     indexLookup.lookupRpc.rpc->response->emplaceAppend<uint16_t>(uint16_t(0));
     indexLookup.lookupRpc.rpc->response->emplaceAppend<uint64_t>(0);
+    indexLookup.lookupRpc.rpc->response->emplaceAppend<uint32_t>(0);
+    indexLookup.lookupRpc.rpc->response->emplaceAppend<uint32_t>(0);
     for (KeyHash i = 0; i < 10; i++) {
         indexLookup.lookupRpc.rpc->response->emplaceAppend<KeyHash>(i);
     }
@@ -189,6 +194,8 @@ TEST_F(IndexLookupTest, isReady_issueNextLookup) {
     indexLookup.lookupRpc.rpc->response->emplaceAppend<uint32_t>(10);
     indexLookup.lookupRpc.rpc->response->emplaceAppend<uint16_t>(uint16_t(1));
     indexLookup.lookupRpc.rpc->response->emplaceAppend<uint64_t>(0);
+    indexLookup.lookupRpc.rpc->response->emplaceAppend<uint32_t>(0);
+    indexLookup.lookupRpc.rpc->response->emplaceAppend<uint32_t>(0);
     for (KeyHash i = 0; i < 10; i++) {
         indexLookup.lookupRpc.rpc->response->emplaceAppend<KeyHash>(i);
     }
@@ -214,6 +221,8 @@ TEST_F(IndexLookupTest, isReady_allLookupCompleted) {
     indexLookup.lookupRpc.rpc->response->emplaceAppend<uint32_t>(10);
     indexLookup.lookupRpc.rpc->response->emplaceAppend<uint16_t>(uint16_t(0));
     indexLookup.lookupRpc.rpc->response->emplaceAppend<uint64_t>(0);
+    indexLookup.lookupRpc.rpc->response->emplaceAppend<uint32_t>(0);
+    indexLookup.lookupRpc.rpc->response->emplaceAppend<uint32_t>(0);
     for (KeyHash i = 0; i < 10; i++) {
         indexLookup.lookupRpc.rpc->response->emplaceAppend<KeyHash>(i);
     }
@@ -234,6 +243,8 @@ TEST_F(IndexLookupTest, isReady_assignPKHashesToSameServer) {
     indexLookup.lookupRpc.rpc->response->emplaceAppend<uint32_t>(10);
     indexLookup.lookupRpc.rpc->response->emplaceAppend<uint16_t>(uint16_t(0));
     indexLookup.lookupRpc.rpc->response->emplaceAppend<uint64_t>(0);
+    indexLookup.lookupRpc.rpc->response->emplaceAppend<uint32_t>(0);
+    indexLookup.lookupRpc.rpc->response->emplaceAppend<uint32_t>(0);
     for (KeyHash i = 0; i < 10; i++) {
         indexLookup.lookupRpc.rpc->response->emplaceAppend<KeyHash>(i);
     }
@@ -247,6 +258,46 @@ TEST_F(IndexLookupTest, isReady_assignPKHashesToSameServer) {
     EXPECT_EQ(IndexLookup::SENT, indexLookup.readRpcs[0].status);
 }
 
+// Rule 8:
+// A partial readHashes response sends the rest of the hashes to the same
+// server at once, rather than when the client reaches them.
+TEST_F(IndexLookupTest, isReady_continuePartialReadHashes) {
+    TestLog::Enable _;
+    IndexLookup indexLookup(ramcloud.get(), 10, azKeyRange);
+    indexLookup.lookupRpc.rpc->response->emplaceAppend<
+        WireFormat::ResponseCommon>()->status = STATUS_OK;
+    indexLookup.lookupRpc.rpc->response->emplaceAppend<uint32_t>(10);
+    indexLookup.lookupRpc.rpc->response->emplaceAppend<uint16_t>(uint16_t(0));
+    indexLookup.lookupRpc.rpc->response->emplaceAppend<uint64_t>(0);
+    indexLookup.lookupRpc.rpc->response->emplaceAppend<uint32_t>(0);
+    indexLookup.lookupRpc.rpc->response->emplaceAppend<uint32_t>(0);
+    for (KeyHash i = 0; i < 10; i++) {
+        indexLookup.lookupRpc.rpc->response->emplaceAppend<KeyHash>(i);
+    }
+    indexLookup.lookupRpc.rpc->completed();
+    indexLookup.isReady();
+    EXPECT_EQ(IndexLookup::SENT, indexLookup.readRpcs[0].status);
+
+    WireFormat::ReadHashes::Response* respHdr =
+            indexLookup.readRpcs[0].rpc->response->emplaceAppend<
+            WireFormat::ReadHashes::Response>();
+    respHdr->common.status = STATUS_OK;
+    respHdr->numHashes = 4;
+    respHdr->numObjects = 0;
+    indexLookup.readRpcs[0].rpc->completed();
+    indexLookup.isReady();
+    EXPECT_EQ(IndexLookup::RESULT_READY, indexLookup.readRpcs[0].status);
+    EXPECT_EQ(IndexLookup::SENT, indexLookup.readRpcs[1].status);
+    EXPECT_EQ("mock:dataserver=0",
+               indexLookup.readRpcs[1].rpc->session->getServiceLocator());
+    EXPECT_EQ(6U, indexLookup.readRpcs[1].numHashes);
+    EXPECT_EQ(4U, *indexLookup.readRpcs[1].pKHashes.getStart<KeyHash>());
+    EXPECT_EQ(9U, indexLookup.readRpcs[1].maxPos);
+    EXPECT_EQ(0U, indexLookup.activeRpcIds[3]);
+    EXPECT_EQ(1U, indexLookup.activeRpcIds[4]);
+    EXPECT_EQ(10U, indexLookup.numAssigned);
+}
+
 // Adds bogus index entries for an object that shouldn't be in range query.
 TEST_F(IndexLookupTest, getNext_filtering) {
     ramcloud.construct(&context, "mock:host=coordinator");
@@ -312,4 +363,30 @@ TEST_F(IndexLookupTest, getNext_filtering) {
 
     EXPECT_FALSE(indexLookup2.getNext());
 }
+// The objects come back with the lookup when the index server stores them.
+TEST_F(IndexLookupTest, getNext_objectsFromLookup) {
+    ramcloud.construct(&context, "mock:host=coordinator");
+    uint64_t tableId = ramcloud->createTable("table");
+    ramcloud->createIndex(tableId, 1, 0);
+
+    KeyInfo keyList1[2] = {{"primaryKey1", 11}, {"a", 1}};
+    KeyInfo keyList2[2] = {{"primaryKey2", 11}, {"b", 1}};
+    ramcloud->write(tableId, 2, keyList1, "value1");
+    ramcloud->write(tableId, 2, keyList2, "value2");
+
+    IndexLookup indexLookup(ramcloud.get(), tableId, azKeyRange);
+    EXPECT_TRUE(indexLookup.getNext());
+    Object* obj = indexLookup.currentObject();
+    EXPECT_STREQ("primaryKey1", StringUtil::binaryToString(
+            obj->getKey(), obj->getKeyLength(0)).c_str());
+    EXPECT_TRUE(indexLookup.getNext());
+    obj = indexLookup.currentObject();
+    EXPECT_STREQ("primaryKey2", StringUtil::binaryToString(
+            obj->getKey(), obj->getKeyLength(0)).c_str());
+    EXPECT_FALSE(indexLookup.getNext());
+
+    // No readHashes RPCs were needed.
+    for (uint8_t i = 0; i < IndexLookup::NUM_READ_RPCS; i++)
+        EXPECT_FALSE(indexLookup.readRpcs[i].rpc);
+}
 } // namespace ramcloud
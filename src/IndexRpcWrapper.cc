@@ -163,7 +163,7 @@ IndexRpcWrapper::send()
         completed();
     } else {
         state = IN_PROGRESS;
-        session->sendRequest(&request, response, this);
+        sendRequest();
     }
 }
 
@@ -13,6 +13,8 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <algorithm>
+
 #include "Cycles.h"
 #include "IndexletManager.h"
 #include "StringUtil.h"
@@ -27,6 +29,7 @@ IndexletManager::IndexletManager(Context* context, ObjectManager* objectManager)
     , indexletMap()
     , mutex("IndexletManager")
     , objectManager(objectManager)
+    , maxEntriesPerCount(100000)
 {
 }
 
@@ -60,6 +63,8 @@ IndexletManager::IndexletManager(Context* context, ObjectManager* objectManager)
  *      The lowest node id that the next node allocated for this indexlet
  *      is allowed to have. This is used to ensure that we don't
  *      reuse existing node ids after crash recovery.
+ * \param indexType
+ *      How the indexlet's entries are stored (an IndexKey::IndexType).
  * 
  * \return
  *      True if indexlet was added, false if it already existed.
@@ -73,7 +78,8 @@ IndexletManager::addIndexlet(
         uint64_t tableId, uint8_t indexId, uint64_t backingTableId,
         const void *firstKey, uint16_t firstKeyLength,
         const void *firstNotOwnedKey, uint16_t firstNotOwnedKeyLength,
-        IndexletManager::Indexlet::State state, uint64_t nextNodeId)
+        IndexletManager::Indexlet::State state, uint64_t nextNodeId,
+        uint8_t indexType)
 {
     Lock indexletMapLock(mutex);
 
@@ -99,15 +105,19 @@ IndexletManager::addIndexlet(
 
     } else {
         // Add a new indexlet.
-        IndexBtree *bt;
-        if (nextNodeId == 0)
+        IndexBtree *bt = NULL;
+        HashIndex *hashIndex = NULL;
+        if (indexType == IndexKey::HASH_INDEX)
+            hashIndex = new HashIndex(backingTableId, objectManager);
+        else if (nextNodeId == 0)
             bt = new IndexBtree(backingTableId, objectManager);
         else
             bt = new IndexBtree(backingTableId, objectManager, nextNodeId);
 
         indexletMap.insert(std::make_pair(TableAndIndexId{tableId, indexId},
                 Indexlet(firstKey, firstKeyLength, firstNotOwnedKey,
-                        firstNotOwnedKeyLength, bt, state)));
+                        firstNotOwnedKeyLength, bt, state, hashIndex,
+                        backingTableId)));
 
         return true;
     }
@@ -210,6 +220,7 @@ IndexletManager::deleteIndexlet(
                 tableId, indexId);
     } else {
         delete (&it->second)->bt;
+        delete (&it->second)->hashIndex;
         indexletMap.erase(it);
     }
 }
@@ -245,6 +256,59 @@ IndexletManager::findIndexlet(uint64_t tableId, uint8_t indexId,
     return &it->second;
 }
 
+/**
+ * Describe the recent activity on each of this master's indexlets, for the
+ * coordinator to use in deciding which indexlets to split (see
+ * TabletBalancer). The counts are reset, so each call reports the activity
+ * since the previous one; it is only called by MasterService's periodic
+ * load reports.
+ *
+ * \param masterTableMetadata
+ *      Supplies the size of each indexlet's backing table.
+ * \param[out] load
+ *      One entry is added to its indexlet_load for each indexlet in the
+ *      NORMAL state.
+ */
+void
+IndexletManager::getIndexletLoads(MasterTableMetadata* masterTableMetadata,
+        ProtoBuf::MasterRecoveryInfo* load)
+{
+    Lock indexletMapLock(mutex);
+    for (IndexletMap::iterator it = indexletMap.begin();
+            it != indexletMap.end(); it++) {
+        Indexlet* indexlet = &it->second;
+        if (indexlet->state != Indexlet::NORMAL)
+            continue;
+
+        ProtoBuf::MasterRecoveryInfo::IndexletLoad& entry =
+                *load->add_indexlet_load();
+        entry.set_table_id(it->first.tableId);
+        entry.set_index_id(it->first.indexId);
+        entry.set_first_key(indexlet->firstKey, indexlet->firstKeyLength);
+        entry.set_first_not_owned_key(indexlet->firstNotOwnedKey,
+                indexlet->firstNotOwnedKeyLength);
+        entry.set_lookup_count(indexlet->lookupCount.exchange(0));
+        entry.set_write_count(indexlet->writeCount.exchange(0));
+
+        MasterTableMetadata::Entry* metadata =
+                masterTableMetadata->find(indexlet->backingTableId);
+        if (metadata != NULL) {
+            SpinLock::Guard _(metadata->stats.lock);
+            metadata->stats.merge();
+            entry.set_byte_count(metadata->stats.byteCount);
+        }
+
+        if (indexlet->bt != NULL) {
+            Buffer splitKey;
+            ReadWriteSpinLock::SharedGuard _(indexlet->indexletMutex);
+            if (indexlet->bt->getMiddleKey(&splitKey)) {
+                entry.set_split_key(splitKey.getRange(0, splitKey.size()),
+                        splitKey.size());
+            }
+        }
+    }
+}
+
 /**
  * Obtain the total number of indexlets this object is managing.
  *
@@ -384,6 +448,8 @@ IndexletManager::setNextNodeIdIfHigher(uint64_t tableId, uint8_t indexId,
     }
 
     IndexletManager::Indexlet* indexlet = &it->second;
+    if (indexlet->bt == NULL)
+        return;
     if (indexlet->bt->getNextNodeId() < nextNodeId)
         (&it->second)->bt->setNextNodeId(nextNodeId);
 }
@@ -557,6 +623,131 @@ IndexletManager::getIndexlet(uint64_t tableId, uint8_t indexId,
 /////////////////////////////////// PUBLIC ////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 
+/**
+ * Handle COUNT_INDEX_KEYS request. This walks the same entries that a
+ * LOOKUP_INDEX_KEYS request would, but returns only how many there are and
+ * the smallest and largest keys, so large ranges can be counted without
+ * shipping their hashes to the client.
+ *
+ * \copydetails Service::ping
+ */
+void
+IndexletManager::countIndexKeys(
+        const WireFormat::CountIndexKeys::Request* reqHdr,
+        WireFormat::CountIndexKeys::Response* respHdr,
+        Service::Rpc* rpc)
+{
+    Lock indexletMapLock(mutex);
+
+    uint32_t reqOffset = sizeof32(*reqHdr);
+    uint16_t firstKeyLength = reqHdr->firstKeyLength;
+    uint16_t lastKeyLength = reqHdr->lastKeyLength;
+    const void* firstKey =
+            rpc->requestPayload->getRange(reqOffset, firstKeyLength);
+    reqOffset += firstKeyLength;
+    const void* lastKey =
+            rpc->requestPayload->getRange(reqOffset, lastKeyLength);
+
+    if ((firstKey == NULL && firstKeyLength > 0) ||
+            (lastKey == NULL && lastKeyLength > 0)) {
+        respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
+        rpc->sendReply();
+        return;
+    }
+
+    IndexletMap::iterator mapIter =
+            findIndexlet(reqHdr->tableId, reqHdr->indexId, firstKey,
+                    firstKeyLength, indexletMapLock);
+    if (mapIter == indexletMap.end()) {
+        respHdr->common.status = STATUS_UNKNOWN_INDEXLET;
+        rpc->sendReply();
+        return;
+    }
+    Indexlet* indexlet = &mapIter->second;
+    indexlet->lookupCount.inc();
+
+    ReadWriteSpinLock::SharedGuard indexletLock(indexlet->indexletMutex);
+    indexletMapLock.unlock();
+
+    respHdr->count = 0;
+    respHdr->minKeyLength = 0;
+    respHdr->maxKeyLength = 0;
+    respHdr->nextKeyLength = 0;
+    respHdr->nextKeyHash = 0;
+
+    if (indexlet->hashIndex != NULL) {
+        // Hash indexes only support equality lookups.
+        if (IndexKey::keyCompare(firstKey, firstKeyLength,
+                lastKey, lastKeyLength) != 0) {
+            respHdr->common.status = STATUS_INVALID_PARAMETER;
+            rpc->sendReply();
+            return;
+        }
+        respHdr->count = indexlet->hashIndex->count(firstKey, firstKeyLength,
+                reqHdr->firstAllowedKeyHash);
+        if (respHdr->count > 0) {
+            respHdr->minKeyLength = firstKeyLength;
+            respHdr->maxKeyLength = firstKeyLength;
+            rpc->replyPayload->append(firstKey, firstKeyLength);
+            rpc->replyPayload->append(firstKey, firstKeyLength);
+        }
+        respHdr->common.status = STATUS_OK;
+        return;
+    }
+
+    auto iter = indexlet->bt->lower_bound(BtreeEntry {
+            firstKey, firstKeyLength, reqHdr->firstAllowedKeyHash});
+    auto iterEnd = indexlet->bt->end();
+    BtreeEntry maxEntry;
+    bool scanMaxedOut = false;
+
+    while (iter != iterEnd) {
+        BtreeEntry currEntry = *iter;
+        if (IndexKey::keyCompare(currEntry.key, currEntry.keyLength,
+                lastKey, lastKeyLength) > 0)
+        {
+            break;
+        }
+        if (respHdr->count == maxEntriesPerCount) {
+            scanMaxedOut = true;
+            break;
+        }
+
+        if (respHdr->count == 0) {
+            respHdr->minKeyLength = uint16_t(currEntry.keyLength);
+            rpc->replyPayload->appendCopy(currEntry.key,
+                    uint32_t(currEntry.keyLength));
+        }
+        maxEntry = currEntry;
+        respHdr->count += 1;
+        ++iter;
+    }
+
+    if (respHdr->count > 0) {
+        respHdr->maxKeyLength = uint16_t(maxEntry.keyLength);
+        rpc->replyPayload->appendCopy(maxEntry.key,
+                uint32_t(maxEntry.keyLength));
+    }
+
+    if (scanMaxedOut) {
+
+        respHdr->nextKeyLength = uint16_t(iter->keyLength);
+        respHdr->nextKeyHash = iter->pKHash;
+        rpc->replyPayload->appendCopy(iter->key, uint32_t(iter->keyLength));
+
+    } else if (IndexKey::keyCompare(
+            lastKey, lastKeyLength,
+            indexlet->firstNotOwnedKey, indexlet->firstNotOwnedKeyLength) > 0) {
+
+        respHdr->nextKeyLength = indexlet->firstNotOwnedKeyLength;
+        rpc->replyPayload->append(indexlet->firstNotOwnedKey,
+                indexlet->firstNotOwnedKeyLength);
+
+    }
+
+    respHdr->common.status = STATUS_OK;
+}
+
 /**
  * Insert index entry for an object for a given index id.
  *
@@ -593,12 +784,16 @@ IndexletManager::insertEntry(uint64_t tableId, uint8_t indexId,
         return STATUS_UNKNOWN_INDEXLET;
     }
     Indexlet* indexlet = &it->second;
+    indexlet->writeCount.inc();
 
-    Lock indexletLock(indexlet->indexletMutex);
+    IndexletLock indexletLock(indexlet->indexletMutex);
     indexletMapLock.unlock();
 
     BtreeEntry entry = BtreeEntry(key, keyLength, pKHash);
-    indexlet->bt->insert(entry);
+    if (indexlet->hashIndex != NULL)
+        indexlet->hashIndex->insert(entry);
+    else
+        indexlet->bt->insert(entry);
 
     return STATUS_OK;
 }
@@ -647,10 +842,32 @@ IndexletManager::lookupIndexKeys(
         return;
     }
     Indexlet* indexlet = &mapIter->second;
+    indexlet->lookupCount.inc();
 
-    Lock indexletLock(indexlet->indexletMutex);
+    ReadWriteSpinLock::SharedGuard indexletLock(indexlet->indexletMutex);
     indexletMapLock.unlock();
 
+    if (indexlet->hashIndex != NULL) {
+        // Hash indexes only support equality lookups.
+        if (IndexKey::keyCompare(firstKey, firstKeyLength,
+                lastKey, lastKeyLength) != 0) {
+            respHdr->common.status = STATUS_INVALID_PARAMETER;
+            rpc->sendReply();
+            return;
+        }
+        respHdr->nextKeyHash = 0;
+        respHdr->nextKeyLength = 0;
+        if (indexlet->hashIndex->lookup(firstKey, firstKeyLength,
+                reqHdr->firstAllowedKeyHash, reqHdr->maxNumHashes,
+                rpc->replyPayload, &respHdr->numHashes,
+                &respHdr->nextKeyHash)) {
+            respHdr->nextKeyLength = firstKeyLength;
+            rpc->replyPayload->append(firstKey, firstKeyLength);
+        }
+        respHdr->common.status = STATUS_OK;
+        return;
+    }
+
     // We want to use lower_bound() instead of find() because the firstKey
     // may not correspond to a key in the indexlet.
     auto iter = indexlet->bt->lower_bound(BtreeEntry {
@@ -708,6 +925,83 @@ IndexletManager::lookupIndexKeys(
     respHdr->common.status = STATUS_OK;
 }
 
+/**
+ * Insert or remove a group of index entries, all in the same index. The
+ * group is applied all or nothing: if any of the entries doesn't belong to
+ * an indexlet on this server, none of them are applied.
+ *
+ * \param tableId
+ *      Id for a particular table.
+ * \param indexId
+ *      Id for a particular secondary index associated with tableId.
+ * \param entries
+ *      The entries to insert or remove. The caller must ensure that the
+ *      keys remain valid for the duration of this call. This vector will
+ *      be sorted in place.
+ * \param remove
+ *      True means remove the entries; false means insert them.
+ * \return
+ *      Returns STATUS_OK if the entries were inserted or removed (missing
+ *      entries are ignored during removal).
+ *      Returns STATUS_UNKNOWN_INDEXLET if the server does not own an indexlet
+ *      that could contain one of the entries.
+ */
+Status
+IndexletManager::modifyEntries(uint64_t tableId, uint8_t indexId,
+        vector<BtreeEntry>* entries, bool remove)
+{
+    // Apply the entries in key order, so that consecutive operations on
+    // each tree take place in the same or neighboring leaves.
+    std::sort(entries->begin(), entries->end(),
+            [](const BtreeEntry& a, const BtreeEntry& b) {
+                int cmp = IndexKey::keyCompare(a.key, a.keyLength,
+                        b.key, b.keyLength);
+                return (cmp < 0) || (cmp == 0 && a.pKHash < b.pKHash);
+            });
+
+    Lock indexletMapLock(mutex);
+    RAMCLOUD_LOG(DEBUG, "%s %lu entries: tableId %lu, indexId %u",
+            remove ? "Removing" : "Inserting", entries->size(), tableId,
+            indexId);
+
+    vector<Indexlet*> indexlets;
+    indexlets.reserve(entries->size());
+    foreach (const BtreeEntry& entry, *entries) {
+        IndexletMap::iterator it = findIndexlet(tableId, indexId,
+                entry.key, entry.keyLength, indexletMapLock);
+        if (it == indexletMap.end()) {
+            RAMCLOUD_LOG(DEBUG, "Unknown indexlet: tableId %lu, indexId %u, "
+                    "hash %lu,\nkey: %s", tableId, indexId, entry.pKHash,
+                    Util::hexDump(entry.key, entry.keyLength).c_str());
+            return STATUS_UNKNOWN_INDEXLET;
+        }
+        indexlets.push_back(&it->second);
+        it->second.writeCount.inc();
+    }
+
+    // Indexlets cover disjoint key ranges, so after sorting, the entries
+    // for each indexlet are adjacent.
+    vector<IndexletLock> indexletLocks;
+    for (size_t i = 0; i < indexlets.size(); i++) {
+        if (i == 0 || indexlets[i] != indexlets[i - 1])
+            indexletLocks.emplace_back(indexlets[i]->indexletMutex);
+    }
+    indexletMapLock.unlock();
+
+    for (size_t i = 0; i < entries->size(); i++) {
+        HashIndex* hashIndex = indexlets[i]->hashIndex;
+        if (remove && hashIndex != NULL)
+            hashIndex->erase((*entries)[i]);
+        else if (remove)
+            indexlets[i]->bt->erase((*entries)[i]);
+        else if (hashIndex != NULL)
+            hashIndex->insert((*entries)[i]);
+        else
+            indexlets[i]->bt->insert((*entries)[i]);
+    }
+    return STATUS_OK;
+}
+
 /**
  * Remove index entry for an object for a given index id.
  *
@@ -744,14 +1038,18 @@ IndexletManager::removeEntry(uint64_t tableId, uint8_t indexId,
         return STATUS_UNKNOWN_INDEXLET;
 
     Indexlet* indexlet = &it->second;
+    indexlet->writeCount.inc();
 
-    Lock indexletLock(indexlet->indexletMutex);
+    IndexletLock indexletLock(indexlet->indexletMutex);
     indexletMapLock.unlock();
 
     // Note that we don't have to explicitly compare the key hash in value
     // since it is also a part of the key that gets compared in the tree
     // module.
-    indexlet->bt->erase(BtreeEntry {key, keyLength, pKHash});
+    if (indexlet->hashIndex != NULL)
+        indexlet->hashIndex->erase(BtreeEntry {key, keyLength, pKHash});
+    else
+        indexlet->bt->erase(BtreeEntry {key, keyLength, pKHash});
 
     return STATUS_OK;
 }
@@ -792,9 +1090,11 @@ IndexletManager::existsIndexEntry(
     }
     Indexlet* indexlet = &mapIter->second;
 
-    Lock indexletLock(indexlet->indexletMutex);
+    ReadWriteSpinLock::SharedGuard indexletLock(indexlet->indexletMutex);
     indexletMapLock.unlock();
 
+    if (indexlet->hashIndex != NULL)
+        return indexlet->hashIndex->exists(BtreeEntry {key, keyLength, pKHash});
     return indexlet->bt->exists(BtreeEntry {key, keyLength, pKHash});
 }
 
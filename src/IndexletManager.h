@@ -19,12 +19,17 @@
 #include <unordered_map>
 
 #include "btreeRamCloud/Btree.h"
+#include "Atomic.h"
 #include "Common.h"
+#include "HashIndex.h"
 #include "HashTable.h"
 #include "SpinLock.h"
 #include "Object.h"
+#include "ReadWriteSpinLock.h"
 #include "Indexlet.h"
 #include "IndexKey.h"
+#include "MasterRecoveryInfo.pb.h"
+#include "MasterTableMetadata.h"
 #include "ObjectManager.h"
 #include "Service.h"
 #include "WireFormat.h"
@@ -66,20 +71,29 @@ class IndexletManager {
 
         Indexlet(const void *firstKey, uint16_t firstKeyLength,
                  const void *firstNotOwnedKey, uint16_t firstNotOwnedKeyLength,
-                 IndexBtree *bt, IndexletManager::Indexlet::State state)
+                 IndexBtree *bt, IndexletManager::Indexlet::State state,
+                 HashIndex *hashIndex = NULL, uint64_t backingTableId = 0)
             : RAMCloud::Indexlet(firstKey, firstKeyLength, firstNotOwnedKey,
                                  firstNotOwnedKeyLength)
             , bt(bt)
+            , hashIndex(hashIndex)
             , state(state)
-            , indexletMutex("Indexlet")
+            , indexletMutex()
+            , backingTableId(backingTableId)
+            , lookupCount(0)
+            , writeCount(0)
         {
         }
 
         Indexlet(const Indexlet& indexlet)
             : RAMCloud::Indexlet(indexlet)
             , bt(indexlet.bt)
+            , hashIndex(indexlet.hashIndex)
             , state(indexlet.state)
-            , indexletMutex("Indexlet")
+            , indexletMutex()
+            , backingTableId(indexlet.backingTableId)
+            , lookupCount(indexlet.lookupCount.load())
+            , writeCount(indexlet.writeCount.load())
         {}
 
         Indexlet& operator =(const Indexlet& indexlet)
@@ -100,19 +114,40 @@ class IndexletManager {
             }
 
             this->bt = indexlet.bt;
+            this->hashIndex = indexlet.hashIndex;
             this->state = indexlet.state;
+            this->backingTableId = indexlet.backingTableId;
+            this->lookupCount = indexlet.lookupCount.load();
+            this->writeCount = indexlet.writeCount.load();
             return *this;
         }
 
+        /// Entries of a B+ tree indexlet; NULL for a hash indexlet.
         IndexBtree *bt;
 
+        /// Entries of a hash indexlet (see IndexKey::HASH_INDEX); NULL for
+        /// a B+ tree indexlet.
+        HashIndex *hashIndex;
+
         /// The state of the tablet, see State.
         State state;
 
-        /// Mutex to protect the indexlet from concurrent access.
-        /// A lock for this mutex MUST be held to read or modify any state in
-        /// the indexlet.
-        SpinLock indexletMutex;
+        /// Protects the indexlet from concurrent access. It MUST be held
+        /// to read or modify any state in the indexlet: lookups hold it
+        /// shared, so they can proceed in parallel, and operations that
+        /// modify the entries hold it exclusively.
+        ReadWriteSpinLock indexletMutex;
+
+        /// Id of the table whose objects hold the indexlet's entries.
+        uint64_t backingTableId;
+
+        /// Number of lookups (and counts) in the indexlet since the last
+        /// call to getIndexletLoads().
+        Atomic<uint64_t> lookupCount;
+
+        /// Number of entries inserted or removed since the last call to
+        /// getIndexletLoads().
+        Atomic<uint64_t> writeCount;
     };
 
     /////////////////////////// Meta-data related functions //////////////////
@@ -123,7 +158,8 @@ class IndexletManager {
             const void *firstNotOwnedKey, uint16_t firstNotOwnedKeyLength,
             IndexletManager::Indexlet::State state =
                     IndexletManager::Indexlet::NORMAL,
-            uint64_t nextNodeId = 0);
+            uint64_t nextNodeId = 0,
+            uint8_t indexType = IndexKey::BTREE_INDEX);
     bool changeState(uint64_t tableId, uint8_t indexId,
             const void *firstKey, uint16_t firstKeyLength,
             const void *firstNotOwnedKey, uint16_t firstNotOwnedKeyLength,
@@ -134,6 +170,8 @@ class IndexletManager {
             const void *firstNotOwnedKey, uint16_t firstNotOwnedKeyLength);
     IndexletManager::Indexlet* findIndexlet(uint64_t tableId, uint8_t indexId,
             const void *key, uint16_t keyLength);
+    void getIndexletLoads(MasterTableMetadata* masterTableMetadata,
+            ProtoBuf::MasterRecoveryInfo* load);
     size_t getNumIndexlets();
     bool hasIndexlet(uint64_t tableId, uint8_t indexId,
             const void *key, uint16_t keyLength);
@@ -146,12 +184,17 @@ class IndexletManager {
 
     /////////////////////////// Index data related functions //////////////////
 
+    void countIndexKeys(const WireFormat::CountIndexKeys::Request* reqHdr,
+            WireFormat::CountIndexKeys::Response* respHdr,
+            Service::Rpc* rpc);
     Status insertEntry(uint64_t tableId, uint8_t indexId,
             const void* key, KeyLength keyLength,
             uint64_t pKHash);
     void lookupIndexKeys(const WireFormat::LookupIndexKeys::Request* reqHdr,
             WireFormat::LookupIndexKeys::Response* respHdr,
             Service::Rpc* rpc);
+    Status modifyEntries(uint64_t tableId, uint8_t indexId,
+            vector<BtreeEntry>* entries, bool remove);
     Status removeEntry(uint64_t tableId, uint8_t indexId,
             const void* key, KeyLength keyLength,
             uint64_t pKHash);
@@ -167,6 +210,9 @@ class IndexletManager {
     /// automatically released at the end of a function if not done explicitly.
     typedef std::unique_lock<SpinLock> Lock;
 
+    /// Lock type used to hold an Indexlet's indexletMutex exclusively.
+    typedef std::unique_lock<ReadWriteSpinLock> IndexletLock;
+
   PRIVATE:
     /// Shared RAMCloud information.
     Context* context;
@@ -217,6 +263,11 @@ class IndexletManager {
     /// Object Manager to handle mapping of index as objects
     ObjectManager* objectManager;
 
+    /// The most entries that a single COUNT_INDEX_KEYS request will scan
+    /// in a B-tree indexlet; the client sends further requests for the rest
+    /// of the range. This bounds how long writers to the indexlet must wait.
+    uint32_t maxEntriesPerCount;
+
     /////////////////////////// Meta-data related functions //////////////////
 
     IndexletManager::IndexletMap::iterator findIndexlet(
@@ -155,6 +155,16 @@ TEST_F(IndexletManagerTest, addIndexlet) {
     EXPECT_EQ(0, firstNotOwnedKey.compare("k"));
 }
 
+TEST_F(IndexletManagerTest, addIndexlet_hashIndex) {
+    im->addIndexlet(dataTableId, 1, backingTableId, "a", 1, "k", 1,
+            IndexletManager::Indexlet::NORMAL, 0, IndexKey::HASH_INDEX);
+    IndexletManager::Indexlet* indexlet =
+            im->findIndexlet(dataTableId, 1, "air", 3);
+    ASSERT_TRUE(indexlet != NULL);
+    EXPECT_TRUE(indexlet->bt == NULL);
+    EXPECT_TRUE(indexlet->hashIndex != NULL);
+}
+
 TEST_F(IndexletManagerTest, addIndexlet_changeState) {
     string key2 = "c";
     string key4 = "k";
@@ -485,6 +495,33 @@ TEST_F(IndexletManagerTest, findIndexlet_nullKey) {
     EXPECT_EQ(0, firstNotOwnedKey.compare("c"));
 }
 
+TEST_F(IndexletManagerTest, getIndexletLoads) {
+    ramcloud->createIndex(dataTableId, 1, 0);
+    im->insertEntry(dataTableId, 1, "air", 3, 1234);
+    im->insertEntry(dataTableId, 1, "earth", 5, 5678);
+    im->insertEntry(dataTableId, 1, "water", 5, 3456);
+    EXPECT_EQ(3U, ramcloud->countIndexKeys(dataTableId, 1, "a", 1, "z", 1));
+
+    MasterService* master = cluster.contexts[0]->getMasterService();
+    ProtoBuf::MasterRecoveryInfo load;
+    im->getIndexletLoads(&master->masterTableMetadata, &load);
+    ASSERT_EQ(1, load.indexlet_load_size());
+    const ProtoBuf::MasterRecoveryInfo::IndexletLoad& entry =
+            load.indexlet_load(0);
+    EXPECT_EQ(dataTableId, entry.table_id());
+    EXPECT_EQ(1U, entry.index_id());
+    EXPECT_EQ(1U, entry.lookup_count());
+    EXPECT_EQ(3U, entry.write_count());
+    EXPECT_EQ("earth", entry.split_key());
+
+    // The counts start over after each report.
+    load.Clear();
+    im->getIndexletLoads(&master->masterTableMetadata, &load);
+    ASSERT_EQ(1, load.indexlet_load_size());
+    EXPECT_EQ(0U, load.indexlet_load(0).lookup_count());
+    EXPECT_EQ(0U, load.indexlet_load(0).write_count());
+}
+
 TEST_F(IndexletManagerTest, getIndexlet) {
     string key1 = "a";
     string key2 = "c";
@@ -564,6 +601,79 @@ TEST_F(IndexletManagerTest, getIndexlet) {
 ////////////////////////// Index data related functions ///////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 
+TEST_F(IndexletManagerTest, countIndexKeys) {
+    ramcloud->createIndex(dataTableId, 1, 0);
+    im->insertEntry(dataTableId, 1, "air", 3, 1234);
+    im->insertEntry(dataTableId, 1, "earth", 5, 5678);
+    im->insertEntry(dataTableId, 1, "earth", 5, 9012);
+    im->insertEntry(dataTableId, 1, "water", 5, 3456);
+
+    Buffer minKey, maxKey;
+    EXPECT_EQ(3U, ramcloud->countIndexKeys(dataTableId, 1, "b", 1, "x", 1,
+            &minKey, &maxKey));
+    EXPECT_EQ("earth", TestUtil::toString(&minKey));
+    EXPECT_EQ("water", TestUtil::toString(&maxKey));
+    EXPECT_EQ(4U, ramcloud->countIndexKeys(dataTableId, 1, "a", 1, "z", 1));
+
+    minKey.reset();
+    minKey.appendCopy("unchanged", 9);
+    EXPECT_EQ(0U, ramcloud->countIndexKeys(dataTableId, 1, "f", 1, "g", 1,
+            &minKey, NULL));
+    EXPECT_EQ("unchanged", TestUtil::toString(&minKey));
+}
+
+TEST_F(IndexletManagerTest, countIndexKeys_scanLimit) {
+    ramcloud->createIndex(dataTableId, 1, 0);
+    im->insertEntry(dataTableId, 1, "air", 3, 1234);
+    im->insertEntry(dataTableId, 1, "earth", 5, 5678);
+    im->insertEntry(dataTableId, 1, "earth", 5, 9012);
+    im->insertEntry(dataTableId, 1, "water", 5, 3456);
+    im->maxEntriesPerCount = 2;
+
+    // A single request stops in the middle of the "earth" entries...
+    Buffer response;
+    uint64_t count, nextKeyHash;
+    uint16_t minKeyLength, maxKeyLength, nextKeyLength;
+    CountIndexKeysRpc rpc(ramcloud.get(), dataTableId, 1, "a", 1, 0,
+            "z", 1, &response);
+    rpc.wait(&count, &minKeyLength, &maxKeyLength, &nextKeyLength,
+            &nextKeyHash);
+    EXPECT_EQ(2U, count);
+    EXPECT_EQ(3U, minKeyLength);
+    EXPECT_EQ(5U, maxKeyLength);
+    EXPECT_EQ(5U, nextKeyLength);
+    EXPECT_EQ(9012U, nextKeyHash);
+    uint32_t offset = sizeof32(WireFormat::CountIndexKeys::Response);
+    EXPECT_EQ("airearthearth", TestUtil::toString(&response, offset, 13));
+
+    // ...and the client picks up from there.
+    Buffer minKey, maxKey;
+    EXPECT_EQ(4U, ramcloud->countIndexKeys(dataTableId, 1, "a", 1, "z", 1,
+            &minKey, &maxKey));
+    EXPECT_EQ("air", TestUtil::toString(&minKey));
+    EXPECT_EQ("water", TestUtil::toString(&maxKey));
+}
+
+TEST_F(IndexletManagerTest, countIndexKeys_hashIndex) {
+    ramcloud->createIndex(dataTableId, 1, IndexKey::HASH_INDEX);
+    im->insertEntry(dataTableId, 1, "air", 3, 5678);
+    im->insertEntry(dataTableId, 1, "air", 3, 1234);
+    im->insertEntry(dataTableId, 1, "earth", 5, 9876);
+
+    Buffer minKey;
+    EXPECT_EQ(2U, ramcloud->countIndexKeys(dataTableId, 1, "air", 3,
+            "air", 3, &minKey));
+    EXPECT_EQ("air", TestUtil::toString(&minKey));
+    EXPECT_EQ(0U, ramcloud->countIndexKeys(dataTableId, 1, "fire", 4,
+            "fire", 4));
+    EXPECT_THROW(ramcloud->countIndexKeys(dataTableId, 1, "a", 1, "z", 1),
+            InvalidParameterException);
+}
+
+TEST_F(IndexletManagerTest, countIndexKeys_unknownIndex) {
+    EXPECT_EQ(0U, ramcloud->countIndexKeys(dataTableId, 1, "a", 1, "z", 1));
+}
+
 TEST_F(IndexletManagerTest, insertEntry) {
     ramcloud->createIndex(dataTableId, 1, 0);
 
@@ -813,6 +923,37 @@ TEST_F(IndexletManagerTest, lookupIndexKeys_firstAllowedKeyHash) {
     EXPECT_EQ(9012U, *responseBuffer.getOffset<uint64_t>(lookupOffset + 8));
 }
 
+TEST_F(IndexletManagerTest, lookupIndexKeys_hashIndex) {
+    ramcloud->createIndex(dataTableId, 1, IndexKey::HASH_INDEX);
+
+    im->insertEntry(dataTableId, 1, "air", 3, 5678);
+    im->insertEntry(dataTableId, 1, "air", 3, 1234);
+    im->insertEntry(dataTableId, 1, "earth", 5, 9876);
+
+    ramcloud->lookupIndexKeys(dataTableId, 1, "air", 3, 0, "air", 3, 1,
+                              &responseBuffer, &numHashes,
+                              &nextKeyLength, &nextKeyHash);
+    EXPECT_EQ(1U, numHashes);
+    EXPECT_EQ(1234U, *responseBuffer.getOffset<uint64_t>(lookupOffset));
+    EXPECT_EQ(3U, nextKeyLength);
+    EXPECT_EQ(5678U, nextKeyHash);
+
+    responseBuffer.reset();
+    ramcloud->lookupIndexKeys(dataTableId, 1, "air", 3, 5678, "air", 3, 100,
+                              &responseBuffer, &numHashes,
+                              &nextKeyLength, &nextKeyHash);
+    EXPECT_EQ(1U, numHashes);
+    EXPECT_EQ(5678U, *responseBuffer.getOffset<uint64_t>(lookupOffset));
+    EXPECT_EQ(0U, nextKeyLength);
+
+    // Hash indexes can't answer range lookups.
+    responseBuffer.reset();
+    EXPECT_THROW(ramcloud->lookupIndexKeys(dataTableId, 1, "a", 1, 0,
+                              "z", 1, 100, &responseBuffer, &numHashes,
+                              &nextKeyLength, &nextKeyHash),
+            InvalidParameterException);
+}
+
 TEST_F(IndexletManagerTest, lookupIndexKeys_largerRange) {
     // Lookup such that the range of keys in the lookup request is larger than
     // the range of keys owned by this indexlet.
@@ -860,6 +1001,53 @@ TEST_F(IndexletManagerTest, lookupIndexKeys_largerThanMax) {
     EXPECT_EQ(5432U, nextKeyHash);
 }
 
+TEST_F(IndexletManagerTest, modifyEntries) {
+    ramcloud->createIndex(dataTableId, 1, 0);
+
+    vector<BtreeEntry> entries;
+    entries.emplace_back("fire", 4, 5432);
+    entries.emplace_back("air", 3, 5678);
+    entries.emplace_back("earth", 5, 9876);
+    EXPECT_EQ(STATUS_OK, im->modifyEntries(dataTableId, 1, &entries, false));
+
+    // The entries are applied in key order.
+    EXPECT_EQ("air", string(static_cast<const char*>(entries[0].key),
+            entries[0].keyLength));
+    EXPECT_EQ("fire", string(static_cast<const char*>(entries[2].key),
+            entries[2].keyLength));
+
+    ramcloud->lookupIndexKeys(dataTableId, 1, "a", 1, 0, "h", 1, 100,
+                              &responseBuffer, &numHashes,
+                              &nextKeyLength, &nextKeyHash);
+    EXPECT_EQ(3U, numHashes);
+    EXPECT_EQ(5678U, *responseBuffer.getOffset<uint64_t>(lookupOffset));
+
+    entries.pop_back();
+    EXPECT_EQ(STATUS_OK, im->modifyEntries(dataTableId, 1, &entries, true));
+    responseBuffer.reset();
+    ramcloud->lookupIndexKeys(dataTableId, 1, "a", 1, 0, "h", 1, 100,
+                              &responseBuffer, &numHashes,
+                              &nextKeyLength, &nextKeyHash);
+    EXPECT_EQ(1U, numHashes);
+    EXPECT_EQ(5432U, *responseBuffer.getOffset<uint64_t>(lookupOffset));
+}
+
+TEST_F(IndexletManagerTest, modifyEntries_unknownIndexlet) {
+    im->addIndexlet(dataTableId, 1, backingTableId, "a", 1, "k", 1);
+
+    // None of the entries are inserted if one of them doesn't belong here.
+    vector<BtreeEntry> entries;
+    entries.emplace_back("air", 3, 5678);
+    entries.emplace_back("water", 5, 1234);
+    EXPECT_EQ(STATUS_UNKNOWN_INDEXLET,
+            im->modifyEntries(dataTableId, 1, &entries, false));
+
+    IndexletManager::Indexlet* indexlet =
+            im->findIndexlet(dataTableId, 1, "air", 3);
+    ASSERT_TRUE(indexlet != NULL);
+    EXPECT_TRUE(indexlet->bt->begin() == indexlet->bt->end());
+}
+
 TEST_F(IndexletManagerTest, removeEntry_single) {
     ramcloud->createIndex(dataTableId, 1, 0);
 
@@ -49,6 +49,20 @@ namespace RAMCloud {
 
 /**
  * Transport mechanism that uses Infiniband reliable queue pairs.
+ *
+ * Scaling note: each session has its own RC queue pair, but receive
+ * buffers come from one shared receive queue per direction (serverSrq and
+ * clientSrq) and all completions arrive on three completion queues, so
+ * buffer memory doesn't grow with the number of connections. The QP
+ * contexts themselves still do, and with thousands of clients they no
+ * longer fit in the NIC's cache. Extended transports (XRC, or vendor DC
+ * transports) would fix that, but the QP-exchange handshake in
+ * clientTrySetupQueuePair/ServerConnectHandler assumes RC QPs. Also,
+ * splitting the SRQ/CQ pairs across cores requires a dispatch loop per
+ * core, since like every other transport this one is owned by the single
+ * dispatch thread. Deployments near these limits should prefer the
+ * datagram-based basic+infud transport, whose state is independent of
+ * the number of peers.
  */
 class InfRcTransport : public Transport {
     typedef RAMCloud::Perf::ReadRequestHandle_MetricSet
@@ -70,8 +70,15 @@ InfUdDriver::InfUdDriver(Context* context,
     , packetBufsUtilized(0)
     , mutex("InfUdDriver")
     , rxBuffers()
+    , rxSenders(new RxSender[MAX_RX_QUEUE_DEPTH])
+    , rxBuffersInHca(0)
+    , releasedRxBuffers()
+    , rxRefill()
     , txBuffers()
     , freeTxBuffers()
+    , logMemoryBase(0)
+    , logMemoryBytes(0)
+    , logMemoryRegion(NULL)
     , ibPhysicalPort(ethernet ? 2 : 1)
     , lid(0)
     , qpn(0)
@@ -135,7 +142,7 @@ InfUdDriver::InfUdDriver(Context* context,
                                      ibPhysicalPort, NULL,
                                      txcq, rxcq, MAX_TX_QUEUE_DEPTH,
                                      MAX_RX_QUEUE_DEPTH,
-                                     QKEY);
+                                     QKEY, MAX_TX_SGE_COUNT);
 
     // cache these for easier access
     lid = infiniband->getLid(ibPhysicalPort);
@@ -159,7 +166,8 @@ InfUdDriver::InfUdDriver(Context* context,
 
     // add receive buffers so we can transition to RTR
     foreach (auto& bd, *rxBuffers)
-        infiniband->postReceive(qp, &bd);
+        rxRefill.push_back(&bd);
+    refillReceiveQueue();
     foreach (auto& bd, *txBuffers)
         freeTxBuffers.push_back(&bd);
 
@@ -253,20 +261,84 @@ InfUdDriver::getTransmitBuffer()
     return bd;
 }
 
+/*
+ * See docs in the ``Driver'' class. Registering the log's seglets lets
+ * sendPacket transmit large object values straight out of the log.
+ */
+void
+InfUdDriver::registerMemory(void* base, size_t bytes)
+{
+    assert(logMemoryRegion == NULL);
+    logMemoryRegion = ibv_reg_mr(infiniband->pd.pd, base, bytes,
+        IBV_ACCESS_LOCAL_WRITE);
+    if (logMemoryRegion == NULL) {
+        LOG(ERROR, "ibv_reg_mr failed to register %Zd bytes at %p",
+            bytes, base);
+        throw DriverException(HERE, errno);
+    }
+    logMemoryBase = reinterpret_cast<uintptr_t>(base);
+    logMemoryBytes = bytes;
+    LOG(NOTICE, "Registered %Zd bytes at %p", bytes, base);
+}
+
+/**
+ * Move the receive buffers released by the transport to #rxRefill.
+ */
+void
+InfUdDriver::collectReleasedRxBuffers()
+{
+    Lock lock(mutex);
+    rxRefill.insert(rxRefill.end(), releasedRxBuffers.begin(),
+            releasedRxBuffers.end());
+    releasedRxBuffers.clear();
+}
+
+/**
+ * Post all of the receive buffers in #rxRefill to the receive queue, with
+ * as few calls to the HCA as possible.
+ */
+void
+InfUdDriver::refillReceiveQueue()
+{
+    infiniband->postReceives(qp, rxRefill.data(),
+            downCast<uint32_t>(rxRefill.size()));
+    rxBuffersInHca += downCast<uint32_t>(rxRefill.size());
+    rxRefill.clear();
+}
+
 /*
  * See docs in the ``Driver'' class.
  */
 void
 InfUdDriver::release(char *payload)
+{
+    releaseBatch(&payload, 1);
+}
+
+/*
+ * See docs in the ``Driver'' class.
+ */
+void
+InfUdDriver::releaseBatch(char** payloads, uint32_t count)
 {
     Lock lock(mutex);
 
-    // Note: the payload is actually contained in a PacketBuf structure,
+    // Note: each payload is either in one of rxBuffers, which the poller
+    // will post to the receive queue again, or in a PacketBuf structure,
     // which we return to a pool for reuse later.
-    assert(packetBufsUtilized > 0);
-    packetBufsUtilized--;
-    packetBufPool.destroy(
-        reinterpret_cast<PacketBuf*>(payload - OFFSET_OF(PacketBuf, payload)));
+    for (uint32_t i = 0; i < count; i++) {
+        if (rxBuffers->contains(payloads[i])) {
+            BufferDescriptor* bd = &rxBuffers->getDescriptor(payloads[i]);
+            rxSenders[bd - rxBuffers->begin()].infAddress.destroy();
+            rxSenders[bd - rxBuffers->begin()].macAddress.destroy();
+            releasedRxBuffers.push_back(bd);
+            continue;
+        }
+        assert(packetBufsUtilized > 0);
+        packetBufsUtilized--;
+        packetBufPool.destroy(reinterpret_cast<PacketBuf*>(
+                payloads[i] - OFFSET_OF(PacketBuf, payload)));
+    }
 }
 
 /*
@@ -284,7 +356,14 @@ InfUdDriver::sendPacket(const Driver::Address *addr,
 
     BufferDescriptor* bd = getTransmitBuffer();
 
-    // copy buffer over
+    // Copy the headers and small payload chunks into the transmit buffer.
+    // Large chunks in registered memory (i.e. object data in log seglets)
+    // get their own scatter-gather elements so the HCA reads them directly.
+    // The packet capture code needs the whole packet in one place, so
+    // don't skip any copies if it's in use.
+    ibv_sge isge[MAX_TX_SGE_COUNT];
+    uint32_t sgesUsed = 0;
+    char* unaddedStart = bd->buffer;
     char *p = bd->buffer;
     if (localMac) {
         auto& ethHdr = *new(p) EthernetHeader;
@@ -297,12 +376,41 @@ InfUdDriver::sendPacket(const Driver::Address *addr,
     }
     memcpy(p, header, headerLen);
     p += headerLen;
+    uint32_t length = static_cast<uint32_t>(p - bd->buffer);
     while (payload && !payload->isDone()) {
-        memcpy(p, payload->getData(), payload->getLength());
-        p += payload->getLength();
+        const uintptr_t chunkAddr =
+                reinterpret_cast<const uintptr_t>(payload->getData());
+        uint32_t chunkLength = payload->getLength();
+        // Leave room for the sge holding any copied bytes that follow.
+        if (!pcapFile &&
+                sgesUsed + 3 <= MAX_TX_SGE_COUNT &&
+                chunkLength >= MIN_ZERO_COPY_BYTES &&
+                chunkAddr >= logMemoryBase &&
+                chunkAddr + chunkLength <= logMemoryBase + logMemoryBytes) {
+            if (unaddedStart != p) {
+                isge[sgesUsed++] = {
+                    reinterpret_cast<uint64_t>(unaddedStart),
+                    downCast<uint32_t>(p - unaddedStart),
+                    bd->mr->lkey
+                };
+                unaddedStart = p;
+            }
+            isge[sgesUsed++] = {chunkAddr, chunkLength,
+                                logMemoryRegion->lkey};
+        } else {
+            memcpy(p, payload->getData(), chunkLength);
+            p += chunkLength;
+        }
+        length += chunkLength;
         payload->next();
     }
-    uint32_t length = static_cast<uint32_t>(p - bd->buffer);
+    if (unaddedStart != p) {
+        isge[sgesUsed++] = {
+            reinterpret_cast<uint64_t>(unaddedStart),
+            downCast<uint32_t>(p - unaddedStart),
+            bd->mr->lkey
+        };
+    }
 
     if (pcapFile)
         pcapFile->append(bd->buffer, length);
@@ -310,7 +418,7 @@ InfUdDriver::sendPacket(const Driver::Address *addr,
     try {
         LOG(DEBUG, "sending %u bytes to %s...", length,
             addr->toString().c_str());
-        infiniband->postSend(qp, bd, length,
+        infiniband->postSend(qp, bd, isge, sgesUsed, length,
                              localMac ? NULL
                                       : static_cast<const Address*>(addr),
                              QKEY);
@@ -329,7 +437,7 @@ int
 InfUdDriver::Poller::poll()
 {
     assert(driver->context->dispatch->isDispatchThread());
-    static const int MAX_COMPLETIONS = 8;
+    static const int MAX_COMPLETIONS = 32;
     ibv_wc wc[MAX_COMPLETIONS];
     int numPackets = driver->infiniband->pollCompletionQueue(driver->qp->rxcq,
             MAX_COMPLETIONS, wc);
@@ -337,8 +445,15 @@ InfUdDriver::Poller::poll()
         if (numPackets < 0) {
             LOG(ERROR, "pollCompletionQueue failed with result %d", numPackets);
         }
-        return 0;
+        // Nothing else to do, so don't leave any buffers waiting for a
+        // full batch.
+        driver->collectReleasedRxBuffers();
+        if (driver->rxRefill.empty())
+            return 0;
+        driver->refillReceiveQueue();
+        return 1;
     }
+    driver->rxBuffersInHca -= downCast<uint32_t>(numPackets);
 
     // First, prefetch the initial bytes of all the incoming packets. This
     // allows us to process multiple cache misses concurrently, which improves
@@ -357,13 +472,14 @@ InfUdDriver::Poller::poll()
         BufferDescriptor *bd =
                 reinterpret_cast<BufferDescriptor *>(incoming->wr_id);
         bd->messageBytes = incoming->byte_len;
-        PacketBuf* buffer = NULL;
         Received received;
+        uint32_t headerBytes;
         if (incoming->status != IBV_WC_SUCCESS) {
             LOG(ERROR, "error in Infiniband completion (%d: %s)",
                 incoming->status,
                 driver->infiniband->wcStatusToString(incoming->status));
-            goto error;
+            driver->rxRefill.push_back(bd);
+            continue;
         }
 
         if (pcapFile)
@@ -372,51 +488,67 @@ InfUdDriver::Poller::poll()
         if (bd->messageBytes < (driver->localMac ? 60 : GRH_SIZE)) {
             LOG(ERROR, "received impossibly short packet: %d bytes",
                     bd->messageBytes);
-            goto error;
-        }
-
-        {
-            Lock lock(driver->mutex);
-            buffer = driver->packetBufPool.construct();
-            driver->packetBufsUtilized++;
+            driver->rxRefill.push_back(bd);
+            continue;
         }
 
-        received.driver = driver;
-        received.payload = buffer->payload;
         PerfStats::threadStats.networkInputBytes += bd->messageBytes;
-        // copy from the infiniband buffer into our dynamically allocated
-        // buffer.
         if (driver->localMac) {
             auto& ethHdr = *reinterpret_cast<EthernetHeader*>(bd->buffer);
-            received.sender =
-                    buffer->macAddress.construct(ethHdr.sourceAddress);
+            headerBytes = sizeof32(ethHdr);
             received.len = ethHdr.length;
             if (received.len + sizeof(ethHdr) > bd->messageBytes) {
                 LOG(ERROR, "corrupt packet (data length %d, packet length %d",
                         received.len, bd->messageBytes);
-                goto error;
+                driver->rxRefill.push_back(bd);
+                continue;
             }
-            memcpy(received.payload, bd->buffer + sizeof(ethHdr), received.len);
         } else {
-            buffer->infAddress.construct(*driver->infiniband,
-                    driver->ibPhysicalPort, incoming->slid, incoming->src_qp);
-            received.sender = buffer->infAddress.get();
+            headerBytes = GRH_SIZE;
             received.len = bd->messageBytes - GRH_SIZE;
-            memcpy(received.payload, bd->buffer + GRH_SIZE, received.len);
         }
-        driver->incomingPacketHandler->handlePacket(&received);
-
-        // post the original infiniband buffer back to the receive queue
-        driver->infiniband->postReceive(driver->qp, bd);
-        continue;
 
-      error:
-        if (buffer != NULL) {
-            Lock lock(driver->mutex);
-            driver->packetBufPool.destroy(buffer);
-            driver->packetBufsUtilized--;
+        // Normally the transport gets the packet right where the HCA put
+        // it, and the buffer goes back to the receive queue once the
+        // transport releases it. If the transport is holding on to so many
+        // buffers that the receive queue is running low, copy the packet
+        // instead, so its buffer can be reposted right away.
+        Tub<Address>* infAddress;
+        Tub<MacAddress>* macAddress;
+        if (driver->rxBuffersInHca >= MIN_RX_BUFFERS_IN_HCA) {
+            RxSender* sender =
+                    &driver->rxSenders[bd - driver->rxBuffers->begin()];
+            infAddress = &sender->infAddress;
+            macAddress = &sender->macAddress;
+            received.payload = bd->buffer + headerBytes;
+        } else {
+            PacketBuf* buffer;
+            {
+                Lock lock(driver->mutex);
+                buffer = driver->packetBufPool.construct();
+                driver->packetBufsUtilized++;
+            }
+            infAddress = &buffer->infAddress;
+            macAddress = &buffer->macAddress;
+            received.payload = buffer->payload;
+            memcpy(received.payload, bd->buffer + headerBytes, received.len);
+            driver->rxRefill.push_back(bd);
         }
-        driver->infiniband->postReceive(driver->qp, bd);
+        received.driver = driver;
+        if (driver->localMac) {
+            auto& ethHdr = *reinterpret_cast<EthernetHeader*>(bd->buffer);
+            received.sender = macAddress->construct(ethHdr.sourceAddress);
+        } else {
+            received.sender = infAddress->construct(*driver->infiniband,
+                    driver->ibPhysicalPort, incoming->slid, incoming->src_qp);
+        }
+        driver->incomingPacketHandler->handlePacket(&received);
+    }
+
+    driver->collectReleasedRxBuffers();
+    if ((driver->rxRefill.size() >= MIN_RX_REFILL_BATCH) ||
+            (driver->rxBuffersInHca < MIN_RX_BUFFERS_IN_HCA)) {
+        driver->refillReceiveQueue();
     }
     return numPackets;
 }
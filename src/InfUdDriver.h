@@ -52,7 +52,9 @@ class InfUdDriver : public Driver {
     virtual void disconnect();
     virtual void dumpStats() { infiniband->dumpStats(); }
     virtual uint32_t getMaxPacketSize();
+    virtual void registerMemory(void* base, size_t bytes);
     virtual void release(char *payload);
+    virtual void releaseBatch(char** payloads, uint32_t count);
     virtual void sendPacket(const Driver::Address *addr,
                             const void *header,
                             uint32_t headerLen,
@@ -68,13 +70,28 @@ class InfUdDriver : public Driver {
         }
     }
 
-  private:
+  PRIVATE:
     BufferDescriptor* getTransmitBuffer();
+    void collectReleasedRxBuffers();
+    void refillReceiveQueue();
 
     static const uint32_t MAX_RX_QUEUE_DEPTH = 2000;
+    /// Incoming packets are handed to the transport in place, in the
+    /// receive buffer the HCA wrote them to, as long as at least this many
+    /// receive buffers remain posted; below that, packets are copied so
+    /// that buffers held by the transport can't starve the receive queue.
+    static const uint32_t MIN_RX_BUFFERS_IN_HCA = MAX_RX_QUEUE_DEPTH / 4;
+    /// Receive buffers are returned to the HCA in groups of at least
+    /// this many (or whenever the poller finds no new packets).
+    static const uint32_t MIN_RX_REFILL_BATCH = 16;
     static const uint32_t MAX_TX_QUEUE_DEPTH = 8;
     static const uint32_t MAX_RX_SGE_COUNT = 1;
-    static const uint32_t MAX_TX_SGE_COUNT = 1;
+    static const uint32_t MAX_TX_SGE_COUNT = 6;
+    /// Payload chunks in registered memory that are at least this large
+    /// are transmitted from their current location instead of being copied
+    /// into a transmit buffer; for smaller chunks copying is cheaper than
+    /// giving the HCA another scatter-gather element.
+    static const uint32_t MIN_ZERO_COPY_BYTES = 500;
     // see comment at top of src/InfUdDriver.cc
     static const uint32_t GRH_SIZE = 40;
 
@@ -88,7 +105,18 @@ class InfUdDriver : public Driver {
     } __attribute__((packed));
 
     /**
-     * Structure to hold an incoming packet.
+     * Sender of the packet in one of #rxBuffers, while that packet is in
+     * use by the transport.
+     */
+    struct RxSender {
+        RxSender() : infAddress(), macAddress() {}
+        Tub<Address> infAddress;
+        Tub<MacAddress> macAddress;
+    };
+
+    /**
+     * Structure to hold an incoming packet that had to be copied out of
+     * its receive buffer (see MIN_RX_BUFFERS_IN_HCA).
      */
     struct PacketBuf {
         PacketBuf() : infAddress(), macAddress() {}
@@ -129,21 +157,52 @@ class InfUdDriver : public Driver {
     /// Number of current allocations from packetBufPool.
     uint64_t            packetBufsUtilized;
 
-    /// Must be held when manipulating packetBufPool or packetBufsUtilized
-    /// (allows the release method to run in worker threads without
-    /// acquiring the Dispatch lock).
+    /// Must be held when manipulating packetBufPool, packetBufsUtilized or
+    /// releasedRxBuffers (allows the release method to run in worker
+    /// threads without acquiring the Dispatch lock).
     SpinLock mutex;
     typedef std::unique_lock<SpinLock> Lock;
 
     /// Infiniband receive buffers, written directly by the HCA.
     Tub<RegisteredBuffers> rxBuffers;
 
+    /// rxSenders[i] holds the sender of the packet in the i-th of
+    /// #rxBuffers while the transport is using it.
+    std::unique_ptr<RxSender[]> rxSenders;
+
+    /// Number of #rxBuffers currently posted to the receive queue.
+    /// Only used by the poller.
+    uint32_t rxBuffersInHca;
+
+    /// Receive buffers that the transport has released but that haven't
+    /// been collected by the poller yet; protected by #mutex.
+    vector<BufferDescriptor*> releasedRxBuffers;
+
+    /// Receive buffers waiting to be posted to the receive queue (see
+    /// MIN_RX_REFILL_BATCH). Only used by the poller.
+    vector<BufferDescriptor*> rxRefill;
+
     /// Infiniband transmit buffers
     Tub<RegisteredBuffers> txBuffers;
 
     /// Infiniband transmit buffers that are not currently in use
     vector<BufferDescriptor*> freeTxBuffers;
 
+    /// Starting address of the region registered with the HCA for zero-copy
+    /// transmission, if any. If no region is registered then 0.
+    /// See registerMemory().
+    uintptr_t logMemoryBase;
+
+    /// Length of the region starting at #logMemoryBase which is registered
+    /// with the HCA for zero-copy transmission. If no region is registered
+    /// then 0. See registerMemory().
+    size_t logMemoryBytes;
+
+    /// Infiniband memory region of the region registered with the HCA for
+    /// zero-copy transmission. If no region is registered then NULL.
+    /// See registerMemory().
+    ibv_mr* logMemoryRegion;
+
     int ibPhysicalPort;                 // our HCA's physical port index
     int lid;                            // our infiniband local id
     int qpn;                            // our queue pair number
@@ -82,4 +82,60 @@ TEST_F(InfUdDriverTest, basics) {
     delete serverAddress;
 }
 
+TEST_F(InfUdDriverTest, poll_receiveInPlace) {
+    ServiceLocator serverLocator("fast+infud:");
+    InfUdDriver *server =
+            new InfUdDriver(&context, &serverLocator, false);
+    MockFastTransport serverTransport(&context, server);
+    InfUdDriver *client =
+            new InfUdDriver(&context, NULL, false);
+    MockFastTransport clientTransport(&context, client);
+    ServiceLocator sl(server->getServiceLocator());
+    Driver::Address* serverAddress = client->newAddress(&sl);
+    EXPECT_EQ(2000U, server->rxBuffersInHca);
+
+    Buffer message;
+    message.appendExternal("abcde", 5);
+    Buffer::Iterator iterator(&message);
+    client->sendPacket(serverAddress, "header:", 7, &iterator);
+    EXPECT_STREQ("header:abcde", receivePacket(&serverTransport));
+
+    // The packet wasn't copied, and its buffer waits for a full batch
+    // (or an idle poll) before going back to the receive queue.
+    EXPECT_EQ(0U, server->packetBufsUtilized);
+    EXPECT_EQ(1999U, server->rxBuffersInHca);
+    EXPECT_EQ(1U, server->rxRefill.size());
+    EXPECT_EQ(1, server->poller->poll());
+    EXPECT_EQ(2000U, server->rxBuffersInHca);
+    EXPECT_EQ(0, server->poller->poll());
+    delete serverAddress;
+}
+
+TEST_F(InfUdDriverTest, sendPacket_zeroCopy) {
+    ServiceLocator serverLocator("fast+infud:");
+    InfUdDriver *server =
+            new InfUdDriver(&context, &serverLocator, false);
+    MockFastTransport serverTransport(&context, server);
+    InfUdDriver *client =
+            new InfUdDriver(&context, NULL, false);
+    MockFastTransport clientTransport(&context, client);
+    ServiceLocator sl(server->getServiceLocator());
+    Driver::Address* serverAddress = client->newAddress(&sl);
+
+    // The large chunk lies in registered memory, so it should be sent
+    // without being copied; the small ones around it are copied.
+    static char region[4096];
+    memset(region, 'x', sizeof(region));
+    client->registerMemory(region, sizeof(region));
+    Buffer message;
+    message.appendExternal("small", 5);
+    message.appendExternal(region, 600);
+    message.appendExternal("tail", 4);
+    Buffer::Iterator iterator(&message);
+    client->sendPacket(serverAddress, "header:", 7, &iterator);
+    EXPECT_EQ("header:small" + string(600, 'x') + "tail",
+            string(receivePacket(&serverTransport)));
+    delete serverAddress;
+}
+
 }  // namespace RAMCloud
@@ -68,10 +68,11 @@ Infiniband::dumpStats()
 Infiniband::QueuePair*
 Infiniband::createQueuePair(ibv_qp_type type, int ibPhysicalPort, ibv_srq *srq,
                             ibv_cq *txcq, ibv_cq *rxcq, uint32_t maxSendWr,
-                            uint32_t maxRecvWr, uint32_t QKey)
+                            uint32_t maxRecvWr, uint32_t QKey,
+                            uint32_t maxSendSge)
 {
     return new QueuePair(*this, type, ibPhysicalPort, srq, txcq, rxcq,
-                         maxSendWr, maxRecvWr, QKey);
+                         maxSendWr, maxRecvWr, QKey, maxSendSge);
 }
 
 /**
@@ -245,6 +246,56 @@ Infiniband::postReceive(QueuePair *qp, BufferDescriptor *bd)
     }
 }
 
+/**
+ * Add several BufferDescriptors to the receive queue for the given
+ * QueuePair. This is cheaper than calling postReceive for each of them,
+ * since the HCA is notified once per group of up to 32 buffers rather
+ * than once per buffer.
+ *
+ * \param[in] qp
+ *      The QueuePair on whose receive queue we are to enqueue the
+ *      BufferDescriptors.
+ * \param[in] bds
+ *      The BufferDescriptors to enqueue.
+ * \param count
+ *      Number of entries in \a bds.
+ * \throw
+ *      TransportException if posting to the queue fails.
+ */
+void
+Infiniband::postReceives(QueuePair* qp, BufferDescriptor* const* bds,
+        uint32_t count)
+{
+    static const uint32_t MAX_BATCH = 32;
+    ibv_sge isge[MAX_BATCH];
+    ibv_recv_wr rxWorkRequests[MAX_BATCH];
+
+    while (count > 0) {
+        uint32_t batch = std::min(count, MAX_BATCH);
+        memset(rxWorkRequests, 0, sizeof(rxWorkRequests[0]) * batch);
+        for (uint32_t i = 0; i < batch; i++) {
+            isge[i] = {
+                reinterpret_cast<uint64_t>(bds[i]->buffer),
+                bds[i]->bytes,
+                bds[i]->mr->lkey
+            };
+            rxWorkRequests[i].wr_id = reinterpret_cast<uint64_t>(bds[i]);
+            rxWorkRequests[i].next = (i + 1 < batch) ? &rxWorkRequests[i + 1]
+                                                     : NULL;
+            rxWorkRequests[i].sg_list = &isge[i];
+            rxWorkRequests[i].num_sge = 1;
+        }
+
+        ibv_recv_wr *badWorkRequest;
+        int ret = ibv_post_recv(qp->qp, rxWorkRequests, &badWorkRequest);
+        if (ret) {
+            throw TransportException(HERE, ret);
+        }
+        bds += batch;
+        count -= batch;
+    }
+}
+
 /**
  * Add the given BufferDescriptor to the given shared receive queue.
  *
@@ -298,6 +349,44 @@ Infiniband::postSrqReceive(ibv_srq* srq, BufferDescriptor *bd)
 void
 Infiniband::postSend(QueuePair* qp, BufferDescriptor *bd, uint32_t length,
                      const Address* address, uint32_t remoteQKey)
+{
+    ibv_sge isge = {
+        reinterpret_cast<uint64_t>(bd->buffer),
+        length,
+        bd->mr->lkey
+    };
+    postSend(qp, bd, &isge, 1, length, address, remoteQKey);
+}
+
+/**
+ * Asychronously transmit a packet gathered from several regions of
+ * registered memory on queue pair 'qp'. This function returns immediately.
+ *
+ * \param[in] qp
+ *      The QueuePair on which to transmit the packet.
+ * \param[in] bd
+ *      The BufferDescriptor to return in the send completion; it normally
+ *      holds the data described by the first element of \a sges.
+ * \param[in] sges
+ *      Describes the pieces of the packet, in order. Each must lie in
+ *      memory registered with the HCA. The array itself need not be
+ *      preserved after this method returns.
+ * \param[in] numSges
+ *      Number of elements in \a sges; no more than the QueuePair's
+ *      maxSendSge.
+ * \param[in] length
+ *      Total number of bytes in the packet.
+ * \param[in] address
+ *      UD queue pairs only. The address of the host to send to. 
+ * \param[in] remoteQKey
+ *      UD queue pairs only. The Q_Key of the remote pair to send to.
+ * \throw TransportException
+ *      if the send post fails.
+ */
+void
+Infiniband::postSend(QueuePair* qp, BufferDescriptor *bd, ibv_sge* sges,
+                     int numSges, uint32_t length, const Address* address,
+                     uint32_t remoteQKey)
 {
     if (qp->type == IBV_QPT_UD) {
         assert(address != NULL);
@@ -306,11 +395,6 @@ Infiniband::postSend(QueuePair* qp, BufferDescriptor *bd, uint32_t length,
         assert(remoteQKey == 0);
     }
 
-    ibv_sge isge = {
-        reinterpret_cast<uint64_t>(bd->buffer),
-        length,
-        bd->mr->lkey
-    };
     ibv_send_wr txWorkRequest;
 
     memset(&txWorkRequest, 0, sizeof(txWorkRequest));
@@ -321,8 +405,8 @@ Infiniband::postSend(QueuePair* qp, BufferDescriptor *bd, uint32_t length,
         txWorkRequest.wr.ud.remote_qkey = remoteQKey;
     }
     txWorkRequest.next = NULL;
-    txWorkRequest.sg_list = &isge;
-    txWorkRequest.num_sge = 1;
+    txWorkRequest.sg_list = sges;
+    txWorkRequest.num_sge = numSges;
     txWorkRequest.opcode = IBV_WR_SEND;
     txWorkRequest.send_flags = IBV_SEND_SIGNALED;
 
@@ -502,10 +586,14 @@ Infiniband::pollCompletionQueue(ibv_cq *cq, int numEntries, ibv_wc *retWcArray)
  *      this QueuePair.
  * \param QKey
  *      UD Queue Pairs only. The QKey for this pair. 
+ * \param maxSendSge
+ *      Maximum number of scatter-gather elements in each send work
+ *      request on this QueuePair.
  */
 Infiniband::QueuePair::QueuePair(Infiniband& infiniband, ibv_qp_type type,
     int ibPhysicalPort, ibv_srq *srq, ibv_cq *txcq, ibv_cq *rxcq,
-    uint32_t maxSendWr, uint32_t maxRecvWr, uint32_t QKey)
+    uint32_t maxSendWr, uint32_t maxRecvWr, uint32_t QKey,
+    uint32_t maxSendSge)
     : infiniband(infiniband),
       type(type),
       ctxt(infiniband.device.ctxt),
@@ -530,7 +618,7 @@ Infiniband::QueuePair::QueuePair(Infiniband& infiniband, ibv_qp_type type,
     qpia.srq = srq;                    // use the same shared receive queue
     qpia.cap.max_send_wr  = maxSendWr; // max outstanding send requests
     qpia.cap.max_recv_wr  = maxRecvWr; // max outstanding recv requests
-    qpia.cap.max_send_sge = 1;         // max send scatter-gather elements
+    qpia.cap.max_send_sge = maxSendSge; // max send scatter-gather elements
     qpia.cap.max_recv_sge = 1;         // max recv scatter-gather elements
     qpia.cap.max_inline_data =         // max bytes of immediate data on send q
         MAX_INLINE_DATA;
@@ -180,7 +180,8 @@ class Infiniband {
                   ibv_cq *rxcq,
                   uint32_t maxSendWr,
                   uint32_t maxRecvWr,
-                  uint32_t QKey = 0);
+                  uint32_t QKey = 0,
+                  uint32_t maxSendSge = 1);
         // exists solely as superclass constructor for MockQueuePair derivative
         explicit QueuePair(Infiniband& infiniband)
             : infiniband(infiniband), type(0), ctxt(NULL), ibPhysicalPort(-1),
@@ -399,6 +400,19 @@ class Infiniband {
             return descriptors[descriptorIndex];
         }
 
+        /**
+         * Return true if #buffer points into one of the buffers allocated
+         * from this RegisteredBuffers.
+         */
+        bool
+        contains(const void* buffer)
+        {
+            const char* p = static_cast<const char*>(buffer);
+            const char* base = static_cast<const char*>(basePointer);
+            return (p >= base) &&
+                    (p < base + size_t(bufferSize) * bufferCount);
+        }
+
         typedef BufferDescriptor* iterator;
         typedef const BufferDescriptor* const_iterator;
 
@@ -452,7 +466,8 @@ class Infiniband {
                     ibv_cq *rxcq,
                     uint32_t maxSendWr,
                     uint32_t maxRecvWr,
-                    uint32_t QKey = 0);
+                    uint32_t QKey = 0,
+                    uint32_t maxSendSge = 1);
 
     int
     getLid(int port);
@@ -466,6 +481,9 @@ class Infiniband {
     void
     postReceive(QueuePair* qp, BufferDescriptor* bd);
 
+    void
+    postReceives(QueuePair* qp, BufferDescriptor* const* bds, uint32_t count);
+
     void
     postSrqReceive(ibv_srq* srq, BufferDescriptor* bd);
 
@@ -476,6 +494,15 @@ class Infiniband {
              const Address* address = NULL,
              uint32_t remoteQKey = 0);
 
+    void
+    postSend(QueuePair* qp,
+             BufferDescriptor* bd,
+             ibv_sge* sges,
+             int numSges,
+             uint32_t length,
+             const Address* address = NULL,
+             uint32_t remoteQKey = 0);
+
     void
     postSendAndWait(QueuePair* qp,
                     BufferDescriptor* bd,
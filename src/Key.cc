@@ -109,6 +109,29 @@ Key::Key(uint64_t tableId, const void* key, KeyLength keyLength)
 {
 }
 
+/**
+ * Construct a new key object whose hash is already known, so that getHash()
+ * doesn't need to compute it again.
+ *
+ * \param tableId
+ *      64-bit table identifier portion of this key.
+ * \param key
+ *      Pointer to the binary string key.
+ * \param keyLength
+ *      Length of the binary string key in bytes.
+ * \param hash
+ *      The value getHash(tableId, key, keyLength) returns. It isn't checked,
+ *      so it must come from a trusted source: objects whose keys have the
+ *      wrong hashes can't be found again.
+ */
+Key::Key(uint64_t tableId, const void* key, KeyLength keyLength, KeyHash hash)
+    : tableId(tableId),
+      key(key),
+      keyLength(keyLength),
+      hash(hash)
+{
+}
+
 /**
  * Return the 64-bit hash of this key, which covers the table identifier and the
  * binary string key. The first invocation will compute the key and cache it for
@@ -56,6 +56,8 @@ class Key {
     Key(uint64_t tableId, Buffer& buffer,
         uint32_t keyOffset, KeyLength keyLength);
     Key(uint64_t tableId, const void* key, KeyLength keyLength);
+    Key(uint64_t tableId, const void* key, KeyLength keyLength,
+        KeyHash hash);
 
     KeyHash getHash();
     static KeyHash getHash(uint64_t tableId,
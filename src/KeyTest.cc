@@ -92,6 +92,13 @@ TEST_F(KeyTest, constructor_fromVoidPointer) {
     EXPECT_FALSE(key.hash);
 }
 
+TEST_F(KeyTest, constructor_withHash) {
+    Key key(74, "na-na-na-na", 12, 0x1234);
+    EXPECT_EQ(74U, key.getTableId());
+    EXPECT_EQ(12U, key.getStringKeyLength());
+    EXPECT_EQ(0x1234U, key.getHash());
+}
+
 TEST_F(KeyTest, getHash) {
     Key key(82, "hey-hey-hey", 12);
     EXPECT_FALSE(key.hash);
@@ -0,0 +1,340 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <algorithm>
+
+#include "LargeObject.h"
+#include "ClientException.h"
+#include "ObjectBuffer.h"
+
+namespace RAMCloud {
+
+/**
+ * Read a value written with write.
+ *
+ * \param ramcloud
+ *      The cluster holding the value.
+ * \param tableId
+ *      The table containing the value (return value from a previous call
+ *      to getTableId).
+ * \param key
+ *      Variable length key that uniquely identifies the value within
+ *      tableId. It does not necessarily have to be null terminated.
+ * \param keyLength
+ *      Size in bytes of the key.
+ * \param[out] value
+ *      Reset, and then filled in with the value, assembled from its chunks
+ *      in order as each batch of them arrives.
+ * \throw ObjectDoesntExistException
+ *      The value doesn't exist.
+ * \throw InvalidObjectException
+ *      The object with the given key exists but wasn't written by this class.
+ * \throw InternalError
+ *      Some of the value's chunks are missing.
+ */
+void
+LargeObject::read(RamCloud* ramcloud, uint64_t tableId, const void* key,
+        uint16_t keyLength, Buffer* value)
+{
+    bool failed = false;
+    uint64_t failedGeneration = 0;
+    while (true) {
+        Manifest manifest;
+        readManifest(ramcloud, tableId, key, keyLength, &manifest);
+        if (failed && manifest.generation == failedGeneration) {
+            // Chunks went missing without the value being overwritten.
+            throw InternalError(HERE, STATUS_INTERNAL_ERROR);
+        }
+        value->reset();
+        if (readChunks(ramcloud, tableId, key, keyLength, manifest, value))
+            return;
+
+        // The value was overwritten or removed while it was being read, so
+        // its old chunks have been removed; start over.
+        failed = true;
+        failedGeneration = manifest.generation;
+    }
+}
+
+/**
+ * Remove a value written with write, along with all of its chunks. Does
+ * nothing if the value doesn't exist.
+ *
+ * \param ramcloud
+ *      The cluster holding the value.
+ * \param tableId
+ *      The table containing the value.
+ * \param key
+ *      The value's key; see read.
+ * \param keyLength
+ *      Size in bytes of the key.
+ * \throw InvalidObjectException
+ *      The object with the given key exists but wasn't written by this class.
+ */
+void
+LargeObject::remove(RamCloud* ramcloud, uint64_t tableId, const void* key,
+        uint16_t keyLength)
+{
+    Manifest manifest;
+    try {
+        readManifest(ramcloud, tableId, key, keyLength, &manifest);
+    } catch (const ObjectDoesntExistException& e) {
+        return;
+    }
+
+    // Removing the manifest first means readers never see a value with
+    // chunks missing.
+    ramcloud->remove(tableId, key, keyLength);
+    removeChunks(ramcloud, tableId, key, keyLength, manifest);
+}
+
+/**
+ * Write a value, replacing any value previously written with the same key.
+ *
+ * \param ramcloud
+ *      The cluster that will hold the value.
+ * \param tableId
+ *      The table that will contain the value (return value from a previous
+ *      call to getTableId).
+ * \param key
+ *      The value's key; see read. Its chunks have keys made of this key
+ *      followed by CHUNK_KEY_SUFFIX more bytes, so the table must not
+ *      contain any other objects with keys of that form.
+ * \param keyLength
+ *      Size in bytes of the key.
+ * \param value
+ *      Address of the first byte of the value; must contain at least
+ *      valueLength bytes.
+ * \param valueLength
+ *      Size in bytes of the value.
+ * \param chunkSize
+ *      Size in bytes of each chunk of the value (the last may be smaller).
+ *      Must be less than the largest object the masters accept.
+ * \throw InvalidParameterException
+ *      The key is too long to make chunk keys from, or chunkSize is 0.
+ */
+void
+LargeObject::write(RamCloud* ramcloud, uint64_t tableId, const void* key,
+        uint16_t keyLength, const void* value, uint32_t valueLength,
+        uint32_t chunkSize)
+{
+    if (chunkSize == 0 || keyLength > UINT16_MAX - CHUNK_KEY_SUFFIX) {
+        throw InvalidParameterException(HERE);
+    }
+
+    bool replacing = true;
+    Manifest old;
+    try {
+        readManifest(ramcloud, tableId, key, keyLength, &old);
+    } catch (const ObjectDoesntExistException& e) {
+        replacing = false;
+    } catch (const InvalidObjectException& e) {
+        // An ordinary object is simply overwritten.
+        replacing = false;
+    }
+
+    Manifest manifest;
+    manifest.magic = MAGIC;
+    manifest.chunkSize = chunkSize;
+    manifest.valueLength = valueLength;
+    manifest.generation = generateRandom();
+    manifest.numChunks = downCast<uint32_t>(
+            (uint64_t(valueLength) + chunkSize - 1) / chunkSize);
+
+    const char* data = static_cast<const char*>(value);
+    for (uint32_t first = 0; first < manifest.numChunks;
+            first += CHUNKS_PER_BATCH) {
+        uint32_t count = std::min(CHUNKS_PER_BATCH,
+                manifest.numChunks - first);
+        string keys[CHUNKS_PER_BATCH];
+        Tub<MultiWriteObject> objects[CHUNKS_PER_BATCH];
+        MultiWriteObject* requests[CHUNKS_PER_BATCH];
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t chunk = first + i;
+            uint64_t offset = uint64_t(chunk) * chunkSize;
+            uint32_t length = downCast<uint32_t>(
+                    std::min(uint64_t(chunkSize), valueLength - offset));
+            keys[i] = chunkKey(key, keyLength, manifest.generation, chunk);
+            objects[i].construct(tableId, keys[i].data(),
+                    downCast<uint16_t>(keys[i].size()), data + offset,
+                    length);
+            requests[i] = objects[i].get();
+        }
+        ramcloud->multiWrite(requests, count);
+        for (uint32_t i = 0; i < count; i++) {
+            if (objects[i]->status != STATUS_OK) {
+                removeChunks(ramcloud, tableId, key, keyLength, manifest);
+                ClientException::throwException(HERE, objects[i]->status);
+            }
+        }
+    }
+
+    // Readers start using the new chunks once the manifest is replaced,
+    // and readers that still have the old manifest start over once the
+    // old chunks are gone.
+    ramcloud->write(tableId, key, keyLength, &manifest, sizeof32(manifest));
+    if (replacing)
+        removeChunks(ramcloud, tableId, key, keyLength, old);
+}
+
+/**
+ * Return the key of one chunk of a value.
+ *
+ * \param key
+ *      The value's key.
+ * \param keyLength
+ *      Size in bytes of the key.
+ * \param generation
+ *      From the value's manifest.
+ * \param chunk
+ *      Index of the chunk within the value.
+ */
+string
+LargeObject::chunkKey(const void* key, uint16_t keyLength,
+        uint64_t generation, uint32_t chunk)
+{
+    string result(static_cast<const char*>(key), keyLength);
+    result.push_back('\0');
+    result.append(reinterpret_cast<const char*>(&generation),
+            sizeof(generation));
+    result.append(reinterpret_cast<const char*>(&chunk), sizeof(chunk));
+    return result;
+}
+
+/**
+ * Read the manifest of a value.
+ *
+ * \param ramcloud
+ *      The cluster holding the value.
+ * \param tableId
+ *      The table containing the value.
+ * \param key
+ *      The value's key.
+ * \param keyLength
+ *      Size in bytes of the key.
+ * \param[out] manifest
+ *      Filled in with the value's manifest.
+ * \throw ObjectDoesntExistException
+ *      The value doesn't exist.
+ * \throw InvalidObjectException
+ *      The object with the given key isn't a manifest.
+ */
+void
+LargeObject::readManifest(RamCloud* ramcloud, uint64_t tableId,
+        const void* key, uint16_t keyLength, Manifest* manifest)
+{
+    Buffer buffer;
+    ramcloud->read(tableId, key, keyLength, &buffer);
+    if (buffer.size() != sizeof(Manifest))
+        throw InvalidObjectException(HERE);
+    buffer.copy(0, sizeof32(Manifest), manifest);
+    if (manifest->magic != MAGIC)
+        throw InvalidObjectException(HERE);
+}
+
+/**
+ * Read all of the chunks of a value, in batches, and append them to a
+ * buffer in order.
+ *
+ * \param ramcloud
+ *      The cluster holding the value.
+ * \param tableId
+ *      The table containing the value.
+ * \param key
+ *      The value's key.
+ * \param keyLength
+ *      Size in bytes of the key.
+ * \param manifest
+ *      The value's manifest.
+ * \param[out] value
+ *      The chunks are appended to this.
+ * \return
+ *      True means the value was read; false means some of its chunks don't
+ *      exist (because the value was overwritten since manifest was read).
+ */
+bool
+LargeObject::readChunks(RamCloud* ramcloud, uint64_t tableId,
+        const void* key, uint16_t keyLength, const Manifest& manifest,
+        Buffer* value)
+{
+    for (uint32_t first = 0; first < manifest.numChunks;
+            first += CHUNKS_PER_BATCH) {
+        uint32_t count = std::min(CHUNKS_PER_BATCH,
+                manifest.numChunks - first);
+        string keys[CHUNKS_PER_BATCH];
+        Tub<ObjectBuffer> values[CHUNKS_PER_BATCH];
+        Tub<MultiReadObject> objects[CHUNKS_PER_BATCH];
+        MultiReadObject* requests[CHUNKS_PER_BATCH];
+        for (uint32_t i = 0; i < count; i++) {
+            keys[i] = chunkKey(key, keyLength, manifest.generation,
+                    first + i);
+            objects[i].construct(tableId, keys[i].data(),
+                    downCast<uint16_t>(keys[i].size()), &values[i]);
+            requests[i] = objects[i].get();
+        }
+        ramcloud->multiRead(requests, count);
+        for (uint32_t i = 0; i < count; i++) {
+            if (objects[i]->status == STATUS_OBJECT_DOESNT_EXIST)
+                return false;
+            if (objects[i]->status != STATUS_OK)
+                ClientException::throwException(HERE, objects[i]->status);
+            uint32_t length;
+            const void* data = values[i]->getValue(&length);
+            value->appendCopy(data, length);
+        }
+    }
+    if (value->size() != manifest.valueLength)
+        throw InternalError(HERE, STATUS_INTERNAL_ERROR);
+    return true;
+}
+
+/**
+ * Remove all of the chunks of a value. Chunks that don't exist are
+ * ignored.
+ *
+ * \param ramcloud
+ *      The cluster holding the value.
+ * \param tableId
+ *      The table containing the value.
+ * \param key
+ *      The value's key.
+ * \param keyLength
+ *      Size in bytes of the key.
+ * \param manifest
+ *      The manifest that names the chunks.
+ */
+void
+LargeObject::removeChunks(RamCloud* ramcloud, uint64_t tableId,
+        const void* key, uint16_t keyLength, const Manifest& manifest)
+{
+    for (uint32_t first = 0; first < manifest.numChunks;
+            first += CHUNKS_PER_BATCH) {
+        uint32_t count = std::min(CHUNKS_PER_BATCH,
+                manifest.numChunks - first);
+        string keys[CHUNKS_PER_BATCH];
+        Tub<MultiRemoveObject> objects[CHUNKS_PER_BATCH];
+        MultiRemoveObject* requests[CHUNKS_PER_BATCH];
+        for (uint32_t i = 0; i < count; i++) {
+            keys[i] = chunkKey(key, keyLength, manifest.generation,
+                    first + i);
+            objects[i].construct(tableId, keys[i].data(),
+                    downCast<uint16_t>(keys[i].size()));
+            requests[i] = objects[i].get();
+        }
+        ramcloud->multiRemove(requests, count);
+    }
+}
+
+} // namespace RAMCloud
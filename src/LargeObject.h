@@ -0,0 +1,108 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_LARGEOBJECT_H
+#define RAMCLOUD_LARGEOBJECT_H
+
+#include "RamCloud.h"
+
+namespace RAMCloud {
+
+/**
+ * This class stores values that are too big for a single object (objects
+ * must fit in a log segment, and a master limits them to a fraction of
+ * that) by splitting them into fixed-size chunks, each of which is an
+ * ordinary object. The object with the value's own key holds a small
+ * manifest that names the chunks. Chunks are written and read with
+ * multiWrite and multiRead, so the chunks of a value are transferred in
+ * parallel from all of the masters that hold them, and the cleaner
+ * relocates only the chunks that lie in the segments it cleans instead of
+ * copying the entire value.
+ *
+ * Overwriting a value writes its new chunks before replacing the manifest,
+ * and only then removes the old chunks, so readers see either the old value
+ * or the new one. A read that loses a race with an overwrite simply starts
+ * over with the new manifest. Values stored here must be read, written,
+ * and removed only with this class.
+ *
+ * This class provides only static methods: it isn't possible to construct
+ * an instance.
+ */
+class LargeObject {
+  public:
+    static void read(RamCloud* ramcloud, uint64_t tableId, const void* key,
+            uint16_t keyLength, Buffer* value);
+    static void remove(RamCloud* ramcloud, uint64_t tableId, const void* key,
+            uint16_t keyLength);
+    static void write(RamCloud* ramcloud, uint64_t tableId, const void* key,
+            uint16_t keyLength, const void* value, uint32_t valueLength,
+            uint32_t chunkSize = DEFAULT_CHUNK_SIZE);
+
+    /// Default size of each chunk of a value, in bytes. Small enough that
+    /// many chunks fit in each multiWrite RPC, so that a value is spread
+    /// across masters, and big enough that the per-object overheads are
+    /// small.
+    static const uint32_t DEFAULT_CHUNK_SIZE = 512 * 1024;
+
+  PRIVATE:
+    LargeObject();
+
+    /**
+     * The value of the object with a large value's own key.
+     */
+    struct Manifest {
+        /// Always MAGIC; distinguishes manifests from other objects.
+        uint32_t magic;
+
+        /// Number of bytes in each chunk but the last.
+        uint32_t chunkSize;
+
+        /// Total number of bytes in the value.
+        uint64_t valueLength;
+
+        /// Chosen at random each time the value is written, and part of the
+        /// keys of its chunks, so that an overwrite doesn't change the
+        /// chunks that readers of the old value are using.
+        uint64_t generation;
+
+        /// Number of chunks.
+        uint32_t numChunks;
+    } __attribute__((packed));
+
+    static const uint32_t MAGIC = 0x4c4f424a;
+
+    /// Number of bytes chunkKey adds to a value's key: a null byte, the
+    /// generation, and the chunk index.
+    static const uint16_t CHUNK_KEY_SUFFIX = 1 + sizeof(uint64_t) +
+            sizeof(uint32_t);
+
+    /// Number of chunks passed to each multiRead or multiWrite call; bounds
+    /// the memory used for requests and responses while a value is read.
+    static const uint32_t CHUNKS_PER_BATCH = 32;
+
+    static string chunkKey(const void* key, uint16_t keyLength,
+            uint64_t generation, uint32_t chunk);
+    static void readManifest(RamCloud* ramcloud, uint64_t tableId,
+            const void* key, uint16_t keyLength, Manifest* manifest);
+    static bool readChunks(RamCloud* ramcloud, uint64_t tableId,
+            const void* key, uint16_t keyLength, const Manifest& manifest,
+            Buffer* value);
+    static void removeChunks(RamCloud* ramcloud, uint64_t tableId,
+            const void* key, uint16_t keyLength, const Manifest& manifest);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_LARGEOBJECT_H
@@ -0,0 +1,189 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "MockCluster.h"
+#include "LargeObject.h"
+
+namespace RAMCloud {
+
+class LargeObjectTest : public ::testing::Test {
+  public:
+    TestLog::Enable logEnabler;
+    Context context;
+    MockCluster cluster;
+    Tub<RamCloud> ramcloud;
+    uint64_t tableId;
+    char value[1000];
+
+    LargeObjectTest()
+        : logEnabler()
+        , context()
+        , cluster(&context)
+        , ramcloud()
+        , tableId()
+        , value()
+    {
+        Logger::get().setLogLevels(RAMCloud::SILENT_LOG_LEVEL);
+
+        ServerConfig config = ServerConfig::forTesting();
+        config.services = {WireFormat::MASTER_SERVICE,
+                           WireFormat::PING_SERVICE};
+        config.localLocator = "mock:host=master1";
+        cluster.addServer(config);
+        config.localLocator = "mock:host=master2";
+        cluster.addServer(config);
+
+        ramcloud.construct(&context, "mock:host=coordinator");
+        tableId = ramcloud->createTable("table", 2);
+        for (uint32_t i = 0; i < sizeof(value); i++)
+            value[i] = static_cast<char>('a' + i % 26);
+    }
+
+    /// Return the manifest of a value.
+    LargeObject::Manifest
+    manifest(const char* key)
+    {
+        LargeObject::Manifest result;
+        LargeObject::readManifest(ramcloud.get(), tableId, key,
+                downCast<uint16_t>(strlen(key)), &result);
+        return result;
+    }
+
+    /// Return whether one chunk of a value exists.
+    bool
+    chunkExists(const char* key, uint64_t generation, uint32_t chunk)
+    {
+        string chunkKey = LargeObject::chunkKey(key,
+                downCast<uint16_t>(strlen(key)), generation, chunk);
+        Buffer buffer;
+        try {
+            ramcloud->read(tableId, chunkKey.data(),
+                    downCast<uint16_t>(chunkKey.size()), &buffer);
+        } catch (const ObjectDoesntExistException& e) {
+            return false;
+        }
+        return true;
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(LargeObjectTest);
+};
+
+TEST_F(LargeObjectTest, readAndWrite) {
+    LargeObject::write(ramcloud.get(), tableId, "big", 3, value,
+            sizeof32(value), 64);
+    LargeObject::Manifest m = manifest("big");
+    EXPECT_EQ(16u, m.numChunks);
+    EXPECT_EQ(1000u, m.valueLength);
+    EXPECT_EQ(64u, m.chunkSize);
+
+    Buffer result;
+    result.appendCopy("leftover", 8);
+    LargeObject::read(ramcloud.get(), tableId, "big", 3, &result);
+    ASSERT_EQ(1000u, result.size());
+    EXPECT_EQ(0, memcmp(value, result.getRange(0, 1000), 1000));
+}
+
+TEST_F(LargeObjectTest, read_doesntExist) {
+    Buffer result;
+    EXPECT_THROW(LargeObject::read(ramcloud.get(), tableId, "big", 3,
+            &result), ObjectDoesntExistException);
+}
+
+TEST_F(LargeObjectTest, read_notALargeObject) {
+    ramcloud->write(tableId, "big", 3, "small");
+    Buffer result;
+    EXPECT_THROW(LargeObject::read(ramcloud.get(), tableId, "big", 3,
+            &result), InvalidObjectException);
+}
+
+TEST_F(LargeObjectTest, read_missingChunk) {
+    LargeObject::write(ramcloud.get(), tableId, "big", 3, value,
+            sizeof32(value), 100);
+    string chunkKey = LargeObject::chunkKey("big", 3,
+            manifest("big").generation, 4);
+    ramcloud->remove(tableId, chunkKey.data(),
+            downCast<uint16_t>(chunkKey.size()));
+    Buffer result;
+    EXPECT_THROW(LargeObject::read(ramcloud.get(), tableId, "big", 3,
+            &result), InternalError);
+}
+
+TEST_F(LargeObjectTest, readChunks_overwritten) {
+    LargeObject::write(ramcloud.get(), tableId, "big", 3, value,
+            sizeof32(value), 100);
+    LargeObject::Manifest old = manifest("big");
+    LargeObject::write(ramcloud.get(), tableId, "big", 3, value, 10, 100);
+    Buffer result;
+    EXPECT_FALSE(LargeObject::readChunks(ramcloud.get(), tableId, "big", 3,
+            old, &result));
+}
+
+TEST_F(LargeObjectTest, remove) {
+    LargeObject::write(ramcloud.get(), tableId, "big", 3, value,
+            sizeof32(value), 500);
+    uint64_t generation = manifest("big").generation;
+    LargeObject::remove(ramcloud.get(), tableId, "big", 3);
+    Buffer result;
+    EXPECT_THROW(ramcloud->read(tableId, "big", 3, &result),
+            ObjectDoesntExistException);
+    EXPECT_FALSE(chunkExists("big", generation, 0));
+    EXPECT_FALSE(chunkExists("big", generation, 1));
+
+    // Removing a value that doesn't exist does nothing.
+    LargeObject::remove(ramcloud.get(), tableId, "big", 3);
+}
+
+TEST_F(LargeObjectTest, write_emptyValue) {
+    LargeObject::write(ramcloud.get(), tableId, "big", 3, value, 0);
+    EXPECT_EQ(0u, manifest("big").numChunks);
+    Buffer result;
+    LargeObject::read(ramcloud.get(), tableId, "big", 3, &result);
+    EXPECT_EQ(0u, result.size());
+}
+
+TEST_F(LargeObjectTest, write_invalidParameters) {
+    EXPECT_THROW(LargeObject::write(ramcloud.get(), tableId, "big", 3,
+            value, sizeof32(value), 0), InvalidParameterException);
+}
+
+TEST_F(LargeObjectTest, write_replacesOldChunks) {
+    LargeObject::write(ramcloud.get(), tableId, "big", 3, value,
+            sizeof32(value), 500);
+    uint64_t oldGeneration = manifest("big").generation;
+    LargeObject::write(ramcloud.get(), tableId, "big", 3, value + 1, 600,
+            500);
+    uint64_t generation = manifest("big").generation;
+    EXPECT_NE(oldGeneration, generation);
+    EXPECT_FALSE(chunkExists("big", oldGeneration, 0));
+    EXPECT_FALSE(chunkExists("big", oldGeneration, 1));
+    EXPECT_TRUE(chunkExists("big", generation, 0));
+    EXPECT_TRUE(chunkExists("big", generation, 1));
+
+    Buffer result;
+    LargeObject::read(ramcloud.get(), tableId, "big", 3, &result);
+    ASSERT_EQ(600u, result.size());
+    EXPECT_EQ(0, memcmp(value + 1, result.getRange(0, 600), 600));
+}
+
+TEST_F(LargeObjectTest, write_overwritesOrdinaryObject) {
+    ramcloud->write(tableId, "big", 3, "small");
+    LargeObject::write(ramcloud.get(), tableId, "big", 3, value, 10);
+    Buffer result;
+    LargeObject::read(ramcloud.get(), tableId, "big", 3, &result);
+    EXPECT_EQ(10u, result.size());
+}
+
+}  // namespace RAMCloud
@@ -0,0 +1,90 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "LoadAwareBackupSelector.h"
+#include "ShortMacros.h"
+
+namespace RAMCloud {
+
+// --- LoadAwareBackupSelector ---
+
+/**
+ * Constructor.
+ * \param context
+ *      Overall information about this RAMCloud server; used to register
+ *      #tracker with this server's ServerList.
+ * \param serverId
+ *      The ServerId of the backup. Used for selecting appropriate primary
+ *      and secondary replicas.
+ * \param numReplicas
+ *      The replication factor of each segment.
+ * \param allowLocalBackup
+ *      Specifies whether to allow replication to the local backup.
+ */
+LoadAwareBackupSelector::LoadAwareBackupSelector(Context* context,
+    const ServerId* serverId, uint32_t numReplicas, bool allowLocalBackup)
+    : BackupSelector(context, serverId, numReplicas, allowLocalBackup)
+{
+}
+
+/**
+ * Choose the least loaded of a few random backups that don't conflict with
+ * an existing set of backups. The ServerId will be invalid if there are no
+ * more machines to choose from.
+ * \param numBackups
+ *      The number of entries in the \a backupIds array.
+ * \param backupIds
+ *      An array of numBackups backup ids, none of which may conflict with the
+ *      returned backup. All existing replica locations as well as the
+ *      server id of the master should be listed.
+ */
+ServerId
+LoadAwareBackupSelector::selectSecondary(uint32_t numBackups,
+                                         const ServerId backupIds[])
+{
+    ServerId best = BackupSelector::selectSecondary(numBackups, backupIds);
+    if (!best.isValid())
+        return best;
+    uint64_t bestLoad = getLoad(best);
+    for (uint32_t i = 1; i < CANDIDATES; i++) {
+        ServerId candidate =
+            BackupSelector::selectSecondary(numBackups, backupIds);
+        if (!candidate.isValid())
+            break;
+        uint64_t load = getLoad(candidate);
+        if (load < bestLoad) {
+            best = candidate;
+            bestLoad = load;
+        }
+    }
+    return best;
+}
+
+// - private -
+
+/**
+ * Return a figure of merit for how long a write to \a backupId can be
+ * expected to take: the recent write latency scaled by the backup's
+ * storage backlog. Backups that haven't been written to yet have load 0,
+ * so that they get tried.
+ */
+uint64_t
+LoadAwareBackupSelector::getLoad(ServerId backupId)
+{
+    BackupStats* stats = tracker[backupId];
+    return stats->writeLatencyCycles * (1 + stats->writeBuffersInUse);
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,54 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_LOADAWAREBACKUPSELECTOR_H
+#define RAMCLOUD_LOADAWAREBACKUPSELECTOR_H
+
+#include "Common.h"
+#include "BackupSelector.h"
+
+namespace RAMCloud {
+
+/**
+ * Selects backups for replicas while steering away from backups that are
+ * currently slow to accept writes. Each choice samples a few random
+ * backups that don't conflict with the existing replicas and takes the
+ * least loaded, judged by the latency of this master's recent write rpcs
+ * to each backup and the number of replicas the backup reported having
+ * buffered waiting for storage (see BackupSelector::signalWriteCompleted()).
+ * Sampling a few candidates rather than scanning every backup keeps
+ * placement spread out: one lightly loaded backup doesn't attract every
+ * new segment.
+ */
+class LoadAwareBackupSelector : public BackupSelector {
+  PUBLIC:
+    explicit LoadAwareBackupSelector(Context* context,
+                                     const ServerId* serverId,
+                                     uint32_t numReplicas,
+                                     bool allowLocalBackup);
+    ServerId selectSecondary(uint32_t numBackups, const ServerId backupIds[]);
+
+  PRIVATE:
+    uint64_t getLoad(ServerId backupId);
+
+    /// Number of random candidates compared on each selection.
+    enum { CANDIDATES = 3 };
+
+    DISALLOW_COPY_AND_ASSIGN(LoadAwareBackupSelector);
+};
+
+} // namespace RAMCloud
+
+#endif
@@ -0,0 +1,85 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "Common.h"
+#include "LoadAwareBackupSelector.h"
+#include "MockCluster.h"
+#include "ServiceMask.h"
+#include "ShortMacros.h"
+
+namespace RAMCloud {
+
+struct LoadAwareBackupSelectorTest : public ::testing::Test {
+    TestLog::Enable logEnabler;
+    Context context;
+    MockCluster cluster;
+    LoadAwareBackupSelector* selector;
+    std::vector<ServerId> ids;
+
+    LoadAwareBackupSelectorTest()
+        : logEnabler()
+        , context()
+        , cluster(&context)
+        , selector()
+        , ids()
+    {
+        ServerConfig config = ServerConfig::forTesting();
+        config.services = {WireFormat::MASTER_SERVICE,
+                           WireFormat::MEMBERSHIP_SERVICE};
+        config.master.loadAwareReplication = true;
+        Server* server = cluster.addServer(config);
+        selector = static_cast<LoadAwareBackupSelector*>(
+            server->master->objectManager.replicaManager.backupSelector.get());
+
+        config = ServerConfig::forTesting();
+        config.services = {WireFormat::BACKUP_SERVICE,
+                           WireFormat::MEMBERSHIP_SERVICE};
+        for (uint32_t i = 1; i < 5; i++) {
+            config.localLocator = format("mock:host=backup%u", i);
+            ids.push_back(cluster.addServer(config)->serverId);
+        }
+        selector->applyTrackerChanges();
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(LoadAwareBackupSelectorTest);
+};
+
+TEST_F(LoadAwareBackupSelectorTest, selectSecondary) {
+    // getRandomServerIdWithService(BACKUP_SERVICE) returns backups in the
+    // order that they enlisted above, so ids[0..2] are the candidates.
+    MockRandom _(1);
+    selector->signalWriteCompleted(ids[0], 1000, 0);
+    selector->signalWriteCompleted(ids[1], 400, 1);
+    selector->signalWriteCompleted(ids[2], 100, 9);
+    EXPECT_EQ(ids[1], selector->selectSecondary(0, NULL));
+
+    // A backup that has never been written to is preferred.
+    const ServerId conflicts[] = { ids[1] };
+    EXPECT_EQ(ids[3], selector->selectSecondary(1, conflicts));
+}
+
+TEST_F(LoadAwareBackupSelectorTest, selectSecondary_noBackups) {
+    const ServerId conflicts[] = { ids[0], ids[1], ids[2], ids[3] };
+    EXPECT_EQ(ServerId(), selector->selectSecondary(4, conflicts));
+}
+
+TEST_F(LoadAwareBackupSelectorTest, getLoad) {
+    EXPECT_EQ(0u, selector->getLoad(ids[0]));
+    selector->signalWriteCompleted(ids[0], 1000, 3);
+    EXPECT_EQ(4000u, selector->getLoad(ids[0]));
+}
+
+} // namespace RAMCloud
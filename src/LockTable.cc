@@ -137,6 +137,8 @@ LockTable::isLockAcquired(Key& key)
 bool
 LockTable::releaseLock(Key& key, Log::Reference lockObjectRef)
 {
+    Entry entry = makeEntry(key, lockObjectRef);
+
     // Find the right bucket.
     uint64_t bucketIndex = (key.getHash() & bucketIndexHashMask);
     CacheLine* cacheLine = &buckets[bucketIndex];
@@ -151,7 +153,7 @@ LockTable::releaseLock(Key& key, Log::Reference lockObjectRef)
     uint32_t entryIndex = 1;
     while (true) {
         for (; entryIndex < ENTRIES_PER_CACHE_LINE; entryIndex++) {
-            if (cacheLine->entries[entryIndex] == lockObjectRef.toInteger()) {
+            if (cacheLine->entries[entryIndex] == entry) {
                 cacheLine->entries[entryIndex] = 0;
                 return true;
             }
@@ -233,35 +235,59 @@ LockTable::tryAcquireLock(Key& key, Log::Reference lockObjectRef)
     }
 
     // Assign lock
-    *entryPtr = lockObjectRef.toInteger();
+    *entryPtr = makeEntry(key, lockObjectRef);
     return true;
 }
 
 /**
  * Return TRUE if the given key matches the key in the referenced lock object;
  * FALSE otherwise.
+ *
+ * \param key
+ *      Key to compare.
+ * \param entry
+ *      Lock table entry holding the tagged reference to the lock object, or
+ *      0 if the entry is empty.
  */
 bool
-LockTable::keysMatch(Key& key, Entry lockObjectRef)
+LockTable::keysMatch(Key& key, Entry entry)
 {
-    if (lockObjectRef != 0) {
-        Log::Reference ref(lockObjectRef);
-        Buffer buffer;
-        LogEntryType type = log.getEntry(ref, buffer);
-        if (type == LOG_ENTRY_TYPE_PREP) {
-            PreparedOp prepOp(buffer, 0, buffer.size());
-            Key refKey(prepOp.object.getTableId(),
-                       prepOp.object.getKey(),
-                       prepOp.object.getKeyLength());
-            if (key == refKey) {
-                return true;
-            }
-        } else {
-            RAMCLOUD_DIE("LockTable contains non LOG_ENTRY_TYPE_PREP type;"
-                "found %s instead", LogEntryTypeHelpers::toString(type));
-        }
+    if (entry == 0 || (entry >> TAG_SHIFT) != (key.getHash() >> TAG_SHIFT))
+        return false;
+
+    Log::Reference ref(entry & ((1UL << TAG_SHIFT) - 1));
+    Buffer buffer;
+    LogEntryType type = log.getEntry(ref, buffer);
+    if (type != LOG_ENTRY_TYPE_PREP) {
+        RAMCLOUD_DIE("LockTable contains non LOG_ENTRY_TYPE_PREP type;"
+            "found %s instead", LogEntryTypeHelpers::toString(type));
     }
+
+    PreparedOp prepOp(buffer, 0, buffer.size());
+    Key refKey(prepOp.object.getTableId(),
+               prepOp.object.getKey(),
+               prepOp.object.getKeyLength());
+    if (key == refKey)
+        return true;
+    PerfStats::threadStats.lockTableCollisions++;
     return false;
 }
 
+/**
+ * Construct the lock table entry for a lock: the log reference to its lock
+ * object, tagged with the top bits of the key's hash.
+ *
+ * \param key
+ *      The key that the lock protects.
+ * \param lockObjectRef
+ *      Reference to the object in the log that represents the lock; it must
+ *      fit below TAG_SHIFT bits, as all log references do.
+ */
+LockTable::Entry
+LockTable::makeEntry(Key& key, Log::Reference lockObjectRef)
+{
+    return (key.getHash() >> TAG_SHIFT << TAG_SHIFT) |
+            lockObjectRef.toInteger();
+}
+
 } // namespace RAMCloud
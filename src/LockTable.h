@@ -19,8 +19,10 @@
 #include "Common.h"
 
 #include "Atomic.h"
+#include "CycleCounter.h"
 #include "Fence.h"
 #include "Log.h"
+#include "PerfStats.h"
 
 namespace RAMCloud {
 
@@ -56,10 +58,14 @@ namespace RAMCloud {
  * CacheLines\endlink, the first of which lives inline in the array of buckets.
  * Each cache line consists of several LockTable Entry objects; each Entry
  * contains the reference to the object in the log that represents an acquired
- * lock or 0; only acquired locks are kept in the LockTable.  The first entry in
- * a bucket's first cache line is specially designated and is cast and used as
- * the bucket's \link BucketLock BucketLock\endlink; this is a monitor-style
- * spin-lock that protects against concurrent accesses to the same bucket.
+ * lock or 0; only acquired locks are kept in the LockTable.  Log references fit
+ * in the lower 48 bits of an Entry, so the upper 16 bits hold the top bits of
+ * the locked Key's KeyHash (as in the HashTable); entries for other keys in the
+ * same bucket can then usually be skipped without reading their log objects.
+ * The first entry in a bucket's first cache line is specially designated and
+ * is cast and used as the bucket's \link BucketLock BucketLock\endlink; this
+ * is a monitor-style spin-lock that protects against concurrent accesses to
+ * the same bucket.
  *
  * If there are two many acquired locks to fit in the bucket's first cache line,
  * additional overflow cache lines are allocated (outside the array of buckets)
@@ -90,10 +96,17 @@ class LockTable {
      *
      * Lock table entries live in \link CacheLine CacheLines\endlink.  A lock
      * table entry holds the log reference to an object in the log which
-     * represents an acquired lock on a specific key.
+     * represents an acquired lock on a specific key, tagged with the top bits
+     * of the key's hash (see #makeEntry).
      */
     typedef uint64_t Entry;
 
+    /**
+     * Entry bits at or above this position hold the KeyHash tag; those below
+     * hold the log reference.
+     */
+    static const int TAG_SHIFT = 48;
+
     /**
      * The number of bytes per cache line in this machine.
      */
@@ -141,6 +154,11 @@ class LockTable {
          */
         void lock()
         {
+            if (try_lock())
+                return;
+
+            CycleCounter<uint64_t> _(
+                    &PerfStats::threadStats.lockTableWaitCycles);
             while (mutex.exchange(1) != 0)
                 continue;
 
@@ -196,7 +214,8 @@ class LockTable {
      */
     Log& log;
 
-    bool keysMatch(Key& key, Entry lockObjectRef);
+    bool keysMatch(Key& key, Entry entry);
+    static Entry makeEntry(Key& key, Log::Reference lockObjectRef);
 
     DISALLOW_COPY_AND_ASSIGN(LockTable);
 };
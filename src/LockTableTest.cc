@@ -126,7 +126,7 @@ TEST_F(LockTableTest, acquireLock) {
     Log::Reference ref = addPreparedOp(key, lockTable.log);
     EXPECT_EQ(0UL, lockTable.buckets[0].entries[1]);
     lockTable.acquireLock(key, ref);
-    EXPECT_EQ(ref.toInteger(), lockTable.buckets[0].entries[1]);
+    EXPECT_EQ(LockTable::makeEntry(key, ref), lockTable.buckets[0].entries[1]);
 }
 
 TEST_F(LockTableTest, isLockAcquired_basic) {
@@ -134,8 +134,9 @@ TEST_F(LockTableTest, isLockAcquired_basic) {
     Log::Reference ref = addPreparedOp(key, lockTable.log);
     EXPECT_EQ(0UL, lockTable.buckets[0].next->entries[1]);
     EXPECT_FALSE(lockTable.isLockAcquired(key));
-    lockTable.buckets[0].next->entries[0] = ref.toInteger();
-    EXPECT_EQ(ref.toInteger(), lockTable.buckets[0].next->entries[0]);
+    lockTable.buckets[0].next->entries[0] = LockTable::makeEntry(key, ref);
+    EXPECT_EQ(LockTable::makeEntry(key, ref),
+            lockTable.buckets[0].next->entries[0]);
     EXPECT_TRUE(lockTable.isLockAcquired(key));
 }
 
@@ -144,19 +145,19 @@ TEST_F(LockTableTest, isLockAcquired_findBucket) {
     Key key(12, "blah", 4);
     Log::Reference ref = addPreparedOp(key, lockTable.log);
 
-    newLockTable.buckets[0].entries[2] = ref.toInteger();
+    newLockTable.buckets[0].entries[2] = LockTable::makeEntry(key, ref);
     EXPECT_FALSE(newLockTable.isLockAcquired(key));
     newLockTable.buckets[0].entries[2] = 0;
 
-    newLockTable.buckets[1].entries[2] = ref.toInteger();
+    newLockTable.buckets[1].entries[2] = LockTable::makeEntry(key, ref);
     EXPECT_FALSE(newLockTable.isLockAcquired(key));
     newLockTable.buckets[1].entries[2] = 0;
 
-    newLockTable.buckets[2].entries[2] = ref.toInteger();
+    newLockTable.buckets[2].entries[2] = LockTable::makeEntry(key, ref);
     EXPECT_TRUE(newLockTable.isLockAcquired(key));
     newLockTable.buckets[2].entries[2] = 0;
 
-    newLockTable.buckets[3].entries[2] = ref.toInteger();
+    newLockTable.buckets[3].entries[2] = LockTable::makeEntry(key, ref);
     EXPECT_FALSE(newLockTable.isLockAcquired(key));
 }
 
@@ -165,8 +166,8 @@ TEST_F(LockTableTest, releaseLock_basic) {
     Log::Reference ref1 = addPreparedOp(key, lockTable.log);
     Log::Reference ref2 = addPreparedOp(key, lockTable.log);
 
-    lockTable.buckets[0].entries[3] = ref1.toInteger();
-    lockTable.buckets[0].next->entries[1] = ref2.toInteger();
+    lockTable.buckets[0].entries[3] = LockTable::makeEntry(key, ref1);
+    lockTable.buckets[0].next->entries[1] = LockTable::makeEntry(key, ref2);
 
     EXPECT_TRUE(lockTable.releaseLock(key, ref2));
     EXPECT_EQ(0UL, lockTable.buckets[0].next->entries[0]);
@@ -184,19 +185,19 @@ TEST_F(LockTableTest, releaseLock_findBucket) {
     Key key(12, "blah", 4);
     Log::Reference ref = addPreparedOp(key, lockTable.log);
 
-    newLockTable.buckets[0].entries[2] = ref.toInteger();
+    newLockTable.buckets[0].entries[2] = LockTable::makeEntry(key, ref);
     EXPECT_FALSE(newLockTable.releaseLock(key, ref));
     newLockTable.buckets[0].entries[2] = 0;
 
-    newLockTable.buckets[1].entries[2] = ref.toInteger();
+    newLockTable.buckets[1].entries[2] = LockTable::makeEntry(key, ref);
     EXPECT_FALSE(newLockTable.releaseLock(key, ref));
     newLockTable.buckets[1].entries[2] = 0;
 
-    newLockTable.buckets[2].entries[2] = ref.toInteger();
+    newLockTable.buckets[2].entries[2] = LockTable::makeEntry(key, ref);
     EXPECT_TRUE(newLockTable.releaseLock(key, ref));
     newLockTable.buckets[2].entries[2] = 0;
 
-    newLockTable.buckets[3].entries[2] = ref.toInteger();
+    newLockTable.buckets[3].entries[2] = LockTable::makeEntry(key, ref);
     EXPECT_FALSE(newLockTable.releaseLock(key, ref));
 }
 
@@ -210,7 +211,7 @@ TEST_F(LockTableTest, tryAcquireLock_basic) {
 
     EXPECT_EQ(0UL, lockTable.buckets[0].entries[2]);
     EXPECT_TRUE(lockTable.tryAcquireLock(key, ref1));
-    EXPECT_EQ(ref1.toInteger(), lockTable.buckets[0].entries[2]);
+    EXPECT_EQ(LockTable::makeEntry(key, ref1), lockTable.buckets[0].entries[2]);
     EXPECT_FALSE(lockTable.tryAcquireLock(key, ref2));
 }
 
@@ -229,22 +230,22 @@ TEST_F(LockTableTest, tryAcquireLock_findBucket) {
     Key key(12, "blah", 4);
     Log::Reference ref = addPreparedOp(key, newLockTable.log);
 
-    newLockTable.buckets[0].entries[2] = ref.toInteger();
+    newLockTable.buckets[0].entries[2] = LockTable::makeEntry(key, ref);
     EXPECT_TRUE(newLockTable.tryAcquireLock(key, ref));
     newLockTable.buckets[0].entries[2] = 0;
     EXPECT_TRUE(newLockTable.releaseLock(key, ref));
 
-    newLockTable.buckets[1].entries[2] = ref.toInteger();
+    newLockTable.buckets[1].entries[2] = LockTable::makeEntry(key, ref);
     EXPECT_TRUE(newLockTable.tryAcquireLock(key, ref));
     newLockTable.buckets[1].entries[2] = 0;
     EXPECT_TRUE(newLockTable.releaseLock(key, ref));
 
-    newLockTable.buckets[2].entries[2] = ref.toInteger();
+    newLockTable.buckets[2].entries[2] = LockTable::makeEntry(key, ref);
     EXPECT_FALSE(newLockTable.tryAcquireLock(key, ref));
     newLockTable.buckets[2].entries[2] = 0;
     EXPECT_FALSE(newLockTable.releaseLock(key, ref));
 
-    newLockTable.buckets[3].entries[2] = ref.toInteger();
+    newLockTable.buckets[3].entries[2] = LockTable::makeEntry(key, ref);
     EXPECT_TRUE(newLockTable.tryAcquireLock(key, ref));
 }
 
@@ -290,8 +291,36 @@ TEST_F(LockTableTest, keysMatch) {
     Log::Reference unmatchedRef = addPreparedOp(unmatchedKey, lockTable.log);
 
     EXPECT_FALSE(lockTable.keysMatch(matchedKey, 0));
-    EXPECT_FALSE(lockTable.keysMatch(matchedKey, unmatchedRef.toInteger()));
-    EXPECT_TRUE(lockTable.keysMatch(matchedKey, matchedRef.toInteger()));
+    EXPECT_FALSE(lockTable.keysMatch(matchedKey,
+            LockTable::makeEntry(unmatchedKey, unmatchedRef)));
+    EXPECT_TRUE(lockTable.keysMatch(matchedKey,
+            LockTable::makeEntry(matchedKey, matchedRef)));
+}
+
+TEST_F(LockTableTest, keysMatch_tagCollision) {
+    Key matchedKey(12, "match", 5);
+    Key unmatchedKey(12, "unmatched", 9);
+    Log::Reference unmatchedRef = addPreparedOp(unmatchedKey, lockTable.log);
+    uint64_t collisions = PerfStats::threadStats.lockTableCollisions;
+
+    // A different tag rejects the entry without reading the log.
+    EXPECT_FALSE(lockTable.keysMatch(matchedKey,
+            LockTable::makeEntry(unmatchedKey, unmatchedRef)));
+    EXPECT_EQ(collisions, PerfStats::threadStats.lockTableCollisions);
+
+    // The same tag with a different key is a collision.
+    EXPECT_FALSE(lockTable.keysMatch(matchedKey,
+            LockTable::makeEntry(matchedKey, unmatchedRef)));
+    EXPECT_EQ(collisions + 1, PerfStats::threadStats.lockTableCollisions);
+}
+
+TEST_F(LockTableTest, makeEntry) {
+    Key key(12, "blah", 4);
+    Log::Reference ref = addPreparedOp(key, lockTable.log);
+    LockTable::Entry entry = LockTable::makeEntry(key, ref);
+    EXPECT_EQ(ref.toInteger(), entry & ((1UL << LockTable::TAG_SHIFT) - 1));
+    EXPECT_EQ(key.getHash() >> LockTable::TAG_SHIFT,
+            entry >> LockTable::TAG_SHIFT);
 }
 
 } // namespace RAMCloud
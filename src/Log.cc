@@ -19,8 +19,11 @@
 #include "Log.h"
 #include "LogCleaner.h"
 #include "PerfStats.h"
+#include "RpcLatency.h"
+#include "RpcLevel.h"
 #include "ServerConfig.h"
 #include "ShortMacros.h"
+#include "WorkerManager.h"
 
 namespace RAMCloud {
 
@@ -67,6 +70,9 @@ Log::Log(Context* context,
       context(context),
       cleaner(NULL),
       syncLock("Log::syncLock"),
+      syncWaiters(0),
+      syncBatchCycles(Cycles::fromMicroseconds(
+            config->master.syncBatchMicros)),
       metrics()
 {
     cleaner = new LogCleaner(context,
@@ -136,12 +142,15 @@ Log::getHead() {
  * caller will fully sync the log and return. Doing so will propagate any
  * appends done since the last sync, including those performed by other threads.
  *
- * If a sync operation is already underway, this method will block until it
- * completes. Afterwards it will either return immediately if a previous call
- * did the work for us, or, if more replication is needed, it will sync the full
- * log contents at that time, including any appends made since this method
- * started waiting. This lets us batch backup writes and improve throughput for
- * small entries.
+ * Concurrent callers are group committed. Each caller records the head offset
+ * it needs synced and then waits until either that offset has been synced or
+ * no sync is underway. In the latter case it becomes the leader: it syncs the
+ * full head contents at that time, which releases every waiting writer whose
+ * appends were covered, while writers that arrive in the meantime wait for the
+ * next leader. This lets us batch backup writes and improve throughput for
+ * small entries. If ServerConfig::Master::syncBatchMicros is nonzero, the
+ * leader also waits that long before replicating, trading a little latency
+ * for larger batches and fewer replication RPCs.
  *
  * An alternative to batching writes would have been to pipeline replication
  * RPCs to backups. That would probably also work just fine, but results in
@@ -154,6 +163,7 @@ void
 Log::sync()
 {
     CycleCounter<uint64_t> __(&PerfStats::threadStats.logSyncCycles);
+    uint64_t start = Cycles::rdtsc();
 
     Tub<SpinLock::Guard> lock;
     lock.construct(appendLock);
@@ -183,31 +193,110 @@ Log::sync()
     LogSegment* originalHead = head;
 
     // We have a consistent view of the current head segment, so drop the append
-    // lock and grab the sync lock. This allows other writers to append to the
-    // log while we wait. Once we grab the sync lock, take the append lock again
-    // to ensure our new view of the head is consistent.
+    // lock. This allows other writers to append to the log while we wait.
     lock.destroy();
-    SpinLock::Guard _(syncLock);
-    lock.construct(appendLock);
 
-    // See if we still have work to do. It's possible that another thread
-    // already did the syncing we needed for us.
-    if (appendedLength > originalHead->syncedLength) {
-        // Get the latest segment length and certificate. This allows us to
-        // batch up other appends that came in while we were waiting.
-        SegmentCertificate certificate;
-        appendedLength = originalHead->getAppendedLength(&certificate);
-
-        // Drop the append lock. We don't want to block other appending threads
-        // while we sync.
-        lock.destroy();
-
-        originalHead->replicatedSegment->sync(appendedLength, &certificate);
-        originalHead->syncedLength = appendedLength;
-        TEST_LOG("log synced");
-    } else {
-        TEST_LOG("sync not needed: already fully replicated");
+    // Wait until either a leader has synced past our appends, or no sync is
+    // underway and we can lead one ourselves. Waiters only read
+    // syncedLength, so they don't contend with the leader or each other.
+    // Either way this worker is mostly waiting for replication, so another
+    // RPC may use its core meanwhile.
+    WorkerManager::BlockingWait blocking;
+    syncWaiters.add(1);
+    while (true) {
+        if (appendedLength <= originalHead->syncedLength.load()) {
+            TEST_LOG("sync not needed: already fully replicated");
+            break;
+        }
+        if (syncLock.try_lock()) {
+            SpinLock::Guard _(syncLock, std::adopt_lock);
+
+            // Another thread may have done the syncing we needed for us
+            // between the check above and acquiring the lock.
+            if (appendedLength <= originalHead->syncedLength.load()) {
+                TEST_LOG("sync not needed: already fully replicated");
+            } else {
+                leadSync(originalHead);
+                TEST_LOG("log synced");
+            }
+            break;
+        }
     }
+    syncWaiters.add(-1);
+
+    uint64_t elapsed = Cycles::rdtsc() - start;
+    PerfStats::threadStats.logSyncMicros[PerfStats::histogramBucket(
+            Cycles::toMicroseconds(elapsed))]++;
+    RpcLatency::record(RpcLevel::getCurrentOpcode(), RpcLatency::LOG_SYNC,
+            elapsed);
+}
+
+/**
+ * Start replicating everything appended to the log so far, but don't wait
+ * for backups to acknowledge it. This lets a caller that must not reply to
+ * a client until its appends are durable release its thread in the meantime;
+ * replication proceeds as ReplicaManager::proceed() or other syncs perform
+ * tasks, and isSynced() reports when the returned prefix is durable.
+ *
+ * The caller must make sure the head segment isn't freed before it is done
+ * with the returned SyncPoint. An outstanding RPC does this, since the
+ * LogProtector keeps segments from being freed until RPCs that started
+ * before they were cleaned have finished.
+ */
+Log::SyncPoint
+Log::syncAsync()
+{
+    if (head == NULL) {
+        // Allocates the initial head; there is nothing to replicate yet.
+        sync();
+    }
+
+    SegmentCertificate certificate;
+    LogSegment* segment;
+    uint32_t appendedLength;
+    {
+        SpinLock::Guard _(appendLock);
+        segment = head;
+        appendedLength = segment->getAppendedLength(&certificate);
+    }
+
+    if (appendedLength > segment->syncedLength.load())
+        segment->replicatedSegment->queueSync(appendedLength, &certificate);
+    return SyncPoint(segment, appendedLength);
+}
+
+/**
+ * Return true if the prefix of the log identified by \a point (which was
+ * returned by syncAsync()) has been durably replicated. Never blocks.
+ */
+bool
+Log::isSynced(const SyncPoint& point)
+{
+    if (point.length <= point.segment->syncedLength.load())
+        return true;
+    return point.segment->replicatedSegment->isCommitted(point.length);
+}
+
+/**
+ * Wait for all log appends made at the time this method is invoked to be
+ * durable on at least \a minReplicas backups. Unlike sync() the caller
+ * doesn't join the group commit, which waits for all of the replicas; all of
+ * them are still written, but the caller may return before the slowest
+ * backups have acknowledged its appends. This is used for writes to tables
+ * that need less durability than the rest of the log (see
+ * ObjectManager::setTableDurability).
+ *
+ * \param minReplicas
+ *      Number of replicas that must hold the appends.
+ */
+void
+Log::syncReplicas(uint32_t minReplicas)
+{
+    SyncPoint point = syncAsync();
+    if (point.length <= point.segment->syncedLength.load())
+        return;
+    point.segment->replicatedSegment->waitForReplicas(point.length,
+            minReplicas);
 }
 
 /**
@@ -241,15 +330,73 @@ Log::rollHeadOver()
     SegmentCertificate certificate;
     uint32_t appendedLength = head->getAppendedLength(&certificate);
     head->replicatedSegment->sync(appendedLength, &certificate);
-    head->syncedLength = appendedLength;
+    head->syncedLength.store(appendedLength);
 
     return LogPosition(head->id, head->getAppendedLength());
 }
 
+/**
+ * Return all of the segments currently in the log, including the head.
+ * The caller must be running in an RPC epoch (see LogProtector) for as long
+ * as it uses the segments, so that the cleaner doesn't free them.
+ *
+ * \param[out] segments
+ *      The segments are appended here, in no particular order.
+ */
+void
+Log::getSegments(LogSegmentVector& segments)
+{
+    segmentManager->getActiveSegments(0, segments);
+}
+
 /******************************************************************************
  * PRIVATE METHODS
  ******************************************************************************/
 
+/**
+ * Replicate everything appended to a segment so far, on behalf of all of
+ * the writers waiting in sync(). This is the leader's half of sync().
+ *
+ * This method must be called with syncLock held.
+ *
+ * \param segment
+ *      The head segment that the waiting writers appended to.
+ */
+void
+Log::leadSync(LogSegment* segment)
+{
+    assert(!syncLock.try_lock());
+
+    // Give other writers a chance to append and join our batch.
+    if (syncBatchCycles != 0) {
+        uint64_t stop = Cycles::rdtsc() + syncBatchCycles;
+        while (Cycles::rdtsc() < stop) {
+            // Wait for the batching window to close.
+        }
+    }
+
+    // Get the latest segment length and certificate. This allows us to
+    // batch up other appends that came in while we were waiting. Hold the
+    // append lock only long enough to get a consistent view of the segment;
+    // we don't want to block other appending threads while we sync.
+    SegmentCertificate certificate;
+    uint32_t appendedLength;
+    int writers;
+    {
+        SpinLock::Guard _(appendLock);
+        appendedLength = segment->getAppendedLength(&certificate);
+        writers = syncWaiters.load();
+    }
+
+    segment->replicatedSegment->sync(appendedLength, &certificate);
+    segment->syncedLength.store(appendedLength);
+
+    PerfStats::threadStats.logSyncBatches++;
+    PerfStats::threadStats.logSyncBatchWriters += writers;
+    PerfStats::threadStats.logSyncBatchSizes[
+            PerfStats::histogramBucket(writers)]++;
+}
+
 /**
  * Allocate a new head segment for the log. This is used by the AbstractLog
  * superclass when a new segment is needed.
@@ -21,6 +21,7 @@
 #include <vector>
 
 #include "AbstractLog.h"
+#include "Atomic.h"
 #include "BoostIntrusive.h"
 #include "LogEntryTypes.h"
 #include "LogEntryHandlers.h"
@@ -70,6 +71,23 @@ class ServerConfig;
  */
 class Log : public AbstractLog {
   public:
+    /**
+     * Identifies a prefix of the log that syncAsync() started replicating;
+     * pass it to isSynced() to find out when that prefix is durable.
+     */
+    struct SyncPoint {
+        SyncPoint(LogSegment* segment, uint32_t length)
+            : segment(segment)
+            , length(length)
+        {}
+
+        /// Segment that was the head of the log when syncAsync() was called.
+        LogSegment* segment;
+
+        /// Number of bytes of #segment that must be replicated.
+        uint32_t length;
+    };
+
     Log(Context* context,
         const ServerConfig* config,
         LogEntryHandlers* entryHandlers,
@@ -82,10 +100,15 @@ class Log : public AbstractLog {
     LogPosition getHead();
     void getMetrics(ProtoBuf::LogMetrics& m);
     void sync();
+    SyncPoint syncAsync();
+    bool isSynced(const SyncPoint& point);
+    void syncReplicas(uint32_t minReplicas);
     LogPosition rollHeadOver();
+    void getSegments(LogSegmentVector& segments);
 
   PRIVATE:
     LogSegment* allocNextSegment(bool mustNotFail);
+    void leadSync(LogSegment* segment);
 
     INTRUSIVE_LIST_TYPEDEF(LogSegment, listEntries) SegmentList;
 
@@ -108,6 +131,15 @@ class Log : public AbstractLog {
     /// this one must be acquired first to avoid deadlock.
     SpinLock syncLock;
 
+    /// Number of threads currently inside sync(). The thread leading a sync
+    /// uses this to estimate how many writers its batch covers.
+    Atomic<int> syncWaiters;
+
+    /// How long (in Cycles::rdtsc ticks) the thread leading a sync waits
+    /// before replicating, so that more appends can join its batch. Set
+    /// from ServerConfig::Master::syncBatchMicros.
+    uint64_t syncBatchCycles;
+
     /// Various event counters and performance measurements taken during log
     /// operation.
     class Metrics {
@@ -126,8 +158,10 @@ class Log : public AbstractLog {
     } metrics;
 
     friend class LogIterator;
+    friend class ParallelLogScan;
     friend class SideLog;
     friend class CleanerCompactionBenchmark;
+    friend class CleanerTraceSimulator;
     friend class ObjectManagerBenchmark;
 
     DISALLOW_COPY_AND_ASSIGN(Log);
@@ -15,17 +15,25 @@
 
 #include <assert.h>
 #include <stdint.h>
+#include <cmath>
+#include <limits>
 
 #include "Common.h"
+#include "Cycles.h"
 #include "Fence.h"
 #include "Log.h"
 #include "LogCleaner.h"
+#include "MetricsStreamer.h"
+#include "PerfEvents.h"
 #include "PerfStats.h"
 #include "ShortMacros.h"
 #include "Segment.h"
+#include "SegletAllocator.h"
 #include "SegmentIterator.h"
 #include "ServerConfig.h"
+#include "ThreadPlacement.h"
 #include "WallTime.h"
+#include "WorkerManager.h"
 
 namespace RAMCloud {
 
@@ -61,6 +69,7 @@ LogCleaner::LogCleaner(Context* context,
       writeCostThreshold(config->master.cleanerWriteCostThreshold),
       disableInMemoryCleaning(config->master.disableInMemoryCleaning),
       numThreads(config->master.cleanerThreadCount),
+      numPassThreads(std::max(config->master.cleanerPassThreads, 1U)),
       segletSize(config->segletSize),
       segmentSize(config->segmentSize),
       activeThreads(0),
@@ -69,6 +78,14 @@ LogCleaner::LogCleaner(Context* context,
       mutex(),
       doWorkTicks(0),
       doWorkSleepTicks(0),
+      throttledTicks(0),
+      maxThrottlePercent(std::min(config->master.cleanerThrottlePercent,
+                                  99U)),
+      throttleMutex("LogCleaner::throttleMutex"),
+      lastThrottleSample(0),
+      lastDispatchActiveCycles(0),
+      lastCollectionTime(0),
+      throttle(0),
       inMemoryMetrics(),
       onDiskMetrics(),
       threadMetrics(numThreads),
@@ -76,8 +93,10 @@ LogCleaner::LogCleaner(Context* context,
       threads(),
       balancer(NULL)
 {
+    // Each additional thread within a pass may leave one more partially
+    // filled survivor behind, so it needs one more reserved segment.
     if (!segmentManager.initializeSurvivorReserve(numThreads *
-                                                  SURVIVOR_SEGMENTS_TO_RESERVE))
+            (SURVIVOR_SEGMENTS_TO_RESERVE + numPassThreads - 1)))
         throw FatalError(HERE, "Could not reserve survivor segments");
 
     // This can probably be gotten rid of.
@@ -100,6 +119,9 @@ LogCleaner::LogCleaner(Context* context,
     } else if (balancerArg.compare(0, 15, "tombstoneRatio:") == 0) {
         string ratio = balancerArg.substr(15);
         balancer = new TombstoneRatioBalancer(this, atof(ratio.c_str()));
+    } else if (balancerArg.compare(0, 9, "adaptive:") == 0) {
+        string leadSeconds = balancerArg.substr(9);
+        balancer = new AdaptiveBalancer(this, atof(leadSeconds.c_str()));
     } else {
         DIE("Unknown balancer specified: \"%s\"", balancerArg.c_str());
     }
@@ -177,9 +199,12 @@ LogCleaner::getMetrics(ProtoBuf::LogMetrics_CleanerMetrics& m)
     m.set_min_disk_utilization(MIN_DISK_UTILIZATION);
     m.set_do_work_ticks(doWorkTicks);
     m.set_do_work_sleep_ticks(doWorkSleepTicks);
+    m.set_throttled_ticks(throttledTicks);
     inMemoryMetrics.serialize(*m.mutable_in_memory_metrics());
     onDiskMetrics.serialize(*m.mutable_on_disk_metrics());
     threadMetrics.serialize(*m.mutable_thread_metrics());
+    balancer->getMetrics(*m.mutable_balancer_metrics());
+    cleanableSegments.getMetrics(m);
 }
 
 /******************************************************************************
@@ -198,6 +223,7 @@ LogCleaner::cleanerThreadEntry(LogCleaner* logCleaner, Context* context)
 {
     LOG(NOTICE, "LogCleaner thread started");
     PerfStats::registerStats(&PerfStats::threadStats);
+    ThreadPlacement::place(ThreadPlacement::CLEANER);
 
     CleanerThreadState state;
     state.threadNumber = __sync_fetch_and_add(&threadCnt, 1);
@@ -249,20 +275,23 @@ LogCleaner::doWork(CleanerThreadState* state)
             goToSleep = true;
         }
     }
+    uint64_t workTicks = 0;
     if (!goToSleep) {
         threadMetrics.noteThreadStart();
         switch (balancer->requestTask(state)) {
         case Balancer::CLEAN_DISK:
           {
-            CycleCounter<uint64_t> __(&state->diskCleaningTicks);
+            CycleCounter<uint64_t> __(&workTicks);
             doDiskCleaning();
+            state->diskCleaningTicks += workTicks;
             break;
           }
 
         case Balancer::COMPACT_MEMORY:
           {
-            CycleCounter<uint64_t> __(&state->memoryCompactionTicks);
+            CycleCounter<uint64_t> __(&workTicks);
             doMemoryCleaning();
+            state->memoryCompactionTicks += workTicks;
             break;
           }
 
@@ -291,6 +320,100 @@ LogCleaner::doWork(CleanerThreadState* state)
         // together.
         useconds_t r = downCast<useconds_t>(generateRandom() % POLL_USEC) / 10;
         usleep(POLL_USEC + r);
+    } else if (workTicks != 0) {
+        throttleAfterWork(workTicks);
+    }
+}
+
+/**
+ * Decide how much cleaner threads should hold back to leave the cpu to
+ * foreground work. The cleaner backs off in proportion to how busy the
+ * server is (the utilization of the dispatch thread, or the number of RPCs
+ * waiting for a worker, whichever indicates more load), but only while free
+ * memory is well above the reserves the cleaner and emergency heads depend
+ * on; as free seglets fall toward twice the reserves the throttle drops
+ * linearly to zero, so the cleaner is at full speed before memory runs out.
+ *
+ * The load is sampled at most every THROTTLE_SAMPLE_USEC; calls in between
+ * return the previous result.
+ *
+ * \return
+ *      The fraction of its time each cleaner thread should spend paused,
+ *      between 0 (full speed) and maxThrottlePercent / 100.
+ */
+double
+LogCleaner::getThrottle()
+{
+    if (maxThrottlePercent == 0)
+        return 0;
+
+    SpinLock::Guard _(throttleMutex);
+    uint64_t now = Cycles::rdtsc();
+    if (lastThrottleSample != 0 && now - lastThrottleSample <
+            Cycles::fromMicroseconds(THROTTLE_SAMPLE_USEC))
+        return throttle;
+
+    PerfStats stats;
+    PerfStats::collectStats(&stats);
+    double load = 0;
+    if (lastThrottleSample != 0 && stats.collectionTime > lastCollectionTime) {
+        load = static_cast<double>(stats.dispatchActiveCycles -
+                lastDispatchActiveCycles) /
+                static_cast<double>(stats.collectionTime - lastCollectionTime);
+    }
+    lastThrottleSample = now;
+    lastDispatchActiveCycles = stats.dispatchActiveCycles;
+    lastCollectionTime = stats.collectionTime;
+    if (context->workerManager != NULL) {
+        load = std::max(load,
+                static_cast<double>(context->workerManager->
+                        getWaitingRpcCount()) /
+                THROTTLE_FULL_LOAD_WAITING_RPCS);
+    }
+    load = std::min(load, 1.0);
+
+    SegletAllocator& allocator = segmentManager.getAllocator();
+    double reserve = static_cast<double>(
+            allocator.getTotalCount(SegletAllocator::EMERGENCY_HEAD) +
+            allocator.getTotalCount(SegletAllocator::CLEANER));
+    double free = static_cast<double>(
+            allocator.getFreeCount(SegletAllocator::DEFAULT));
+    double headroom = 1;
+    if (reserve > 0)
+        headroom = (free - 2 * reserve) / (2 * reserve);
+    headroom = std::max(0.0, std::min(headroom, 1.0));
+
+    throttle = maxThrottlePercent / 100.0 * load * headroom;
+    return throttle;
+}
+
+/**
+ * Called by a cleaner thread after each cleaning task to pause for however
+ * long getThrottle() says, so that the thread runs for at most
+ * (1 - throttle) of its time. The pause is cut short if the throttle drops
+ * to zero (for example, because free memory got low) or the cleaner is
+ * halted.
+ *
+ * \param workTicks
+ *      Number of cycles the task just finished took.
+ */
+void
+LogCleaner::throttleAfterWork(uint64_t workTicks)
+{
+    double fraction = getThrottle();
+    if (fraction <= 0)
+        return;
+
+    AtomicCycleCounter _(&throttledTicks);
+    uint64_t stop = Cycles::rdtsc() + static_cast<uint64_t>(
+            static_cast<double>(workTicks) * fraction / (1 - fraction));
+    uint64_t pollTicks = Cycles::fromMicroseconds(POLL_USEC);
+    while (!threadsShouldExit && getThrottle() > 0) {
+        uint64_t now = Cycles::rdtsc();
+        if (now >= stop)
+            break;
+        usleep(downCast<useconds_t>(Cycles::toMicroseconds(
+                std::min(stop - now, pollTicks))) + 1);
     }
 }
 
@@ -305,6 +428,8 @@ LogCleaner::doMemoryCleaning()
     TEST_LOG("called");
     AtomicCycleCounter _(&inMemoryMetrics.totalTicks);
     uint64_t startTicks = Cycles::rdtsc();
+    PerfStats::HardwareCounts hardwareStart = {};
+    PerfEvents::start(&hardwareStart);
 
     if (disableInMemoryCleaning)
         return;
@@ -402,8 +527,10 @@ LogCleaner::doMemoryCleaning()
             localMetrics.totalBytesInCompactedSegments;
     PerfStats::threadStats.compactorSurvivorBytes +=
             localMetrics.totalBytesAppendedToSurvivors;
-    PerfStats::threadStats.compactorActiveCycles +=
-            Cycles::rdtsc() - startTicks;
+    uint64_t activeTicks = Cycles::rdtsc() - startTicks;
+    PerfStats::threadStats.compactorActiveCycles += activeTicks;
+    MetricsStreamer::record(MetricsStreamer::CLEANER_MEMORY_PASS, activeTicks);
+    PerfEvents::stop(hardwareStart, &PerfStats::threadStats.cleanerHardware);
 
     AtomicCycleCounter __(&inMemoryMetrics.compactionCompleteTicks);
     segmentManager.compactionComplete(segment, survivor);
@@ -420,6 +547,8 @@ LogCleaner::doDiskCleaning()
     TEST_LOG("called");
     AtomicCycleCounter _(&onDiskMetrics.totalTicks);
     uint64_t startTicks = Cycles::rdtsc();
+    PerfStats::HardwareCounts hardwareStart = {};
+    PerfEvents::start(&hardwareStart);
 
     // Obtain the segments we'll clean in this pass. We're guaranteed to have
     // the resources to clean what's returned.
@@ -453,13 +582,27 @@ LogCleaner::doDiskCleaning()
     // counters and merge them into our global metrics afterwards to avoid
     // cache line ping-ponging in the hot path.
     LogSegmentVector survivors;
-    uint64_t entryBytesAppended = relocateLiveEntries(entries, survivors,
-            &localMetrics);
+    size_t passThreads = getPassThreadCount(segmentsToClean, entries.size(),
+            maxLiveBytes);
+    uint64_t entryBytesAppended;
+    if (passThreads > 1) {
+        entryBytesAppended = relocateLiveEntriesInParallel(entries,
+                passThreads, survivors, &localMetrics);
+    } else {
+        entryBytesAppended = relocateLiveEntries(entries.begin(),
+                entries.end(), survivors, &localMetrics);
+    }
 
+    // Survivors on the flash tier don't use any memory.
     uint32_t segmentsAfter = downCast<uint32_t>(survivors.size());
     uint32_t segletsAfter = 0;
-    foreach (LogSegment* segment, survivors)
-        segletsAfter += segment->getSegletsAllocated();
+    uint32_t flashSurvivors = 0;
+    foreach (LogSegment* segment, survivors) {
+        if (segment->onFlash)
+            flashSurvivors++;
+        else
+            segletsAfter += segment->getSegletsAllocated();
+    }
 
     TEST_LOG("used %u seglets and %u segments", segletsAfter, segmentsAfter);
 
@@ -469,12 +612,17 @@ LogCleaner::doDiskCleaning()
     // considered dead have come to life again.
     assert(entryBytesAppended <= maxLiveBytes);
 
+    // Switching from survivors on flash to survivors in memory part way
+    // through a pass may leave both partly empty, so a pass that writes to
+    // flash can end up using one more segment (per thread) than it cleaned.
     uint32_t segmentsBefore = downCast<uint32_t>(segmentsToClean.size());
     assert(segletsBefore >= segletsAfter);
-    assert(segmentsBefore >= segmentsAfter);
+    assert(segmentsBefore >= segmentsAfter || flashSurvivors > 0);
 
     uint64_t memoryBytesFreed = (segletsBefore - segletsAfter) * segletSize;
-    uint64_t diskBytesFreed = (segmentsBefore - segmentsAfter) * segmentSize;
+    uint64_t diskBytesFreed = 0;
+    if (segmentsBefore > segmentsAfter)
+        diskBytesFreed = (segmentsBefore - segmentsAfter) * segmentSize;
     localMetrics.totalMemoryBytesFreed += memoryBytesFreed;
     localMetrics.totalDiskBytesFreed += diskBytesFreed;
     localMetrics.totalSegmentsCleaned += segmentsToClean.size();
@@ -495,8 +643,10 @@ LogCleaner::doDiskCleaning()
     PerfStats::threadStats.cleanerSurvivorBytes +=
             localMetrics.totalDiskBytesInCleanedSegments -
             localMetrics.totalDiskBytesFreed;
-    PerfStats::threadStats.cleanerActiveCycles +=
-            Cycles::rdtsc() - startTicks;
+    uint64_t activeTicks = Cycles::rdtsc() - startTicks;
+    PerfStats::threadStats.cleanerActiveCycles += activeTicks;
+    MetricsStreamer::record(MetricsStreamer::CLEANER_DISK_PASS, activeTicks);
+    PerfEvents::stop(hardwareStart, &PerfStats::threadStats.cleanerHardware);
 
     AtomicCycleCounter __(&onDiskMetrics.cleaningCompleteTicks);
     segmentManager.cleaningComplete(segmentsToClean, survivors);
@@ -601,13 +751,124 @@ LogCleaner::getSortedEntries(LogSegmentVector& segmentsToClean,
 }
 
 /**
- * Given a vector of entries from segments being cleaned, write them out to
- * survivor segments in order and alert their owning module (MasterService,
- * usually), that they've been relocated.
+ * Decide how many threads should relocate the live entries of a disk
+ * cleaning pass. Every thread writes to its own survivor segments, so each
+ * additional thread may leave one more partially filled survivor behind.
+ * Threads are only added while the pass is large enough to keep them busy
+ * and while it is still guaranteed to free at least as many segments as it
+ * creates.
+ *
+ * \param segmentsToClean
+ *      The segments being cleaned in this pass.
+ * \param numEntries
+ *      The number of entries extracted from segmentsToClean.
+ * \param maxLiveBytes
+ *      Upper bound on the number of bytes that will be appended to
+ *      survivors.
+ * \return
+ *      The number of threads to use; 1 means relocate serially.
+ */
+size_t
+LogCleaner::getPassThreadCount(LogSegmentVector& segmentsToClean,
+                               size_t numEntries,
+                               uint64_t maxLiveBytes)
+{
+    size_t passThreads = std::min<size_t>(numPassThreads,
+            numEntries / MIN_ENTRIES_PER_PASS_THREAD);
+
+    // With n threads, at most ceil(maxLiveBytes / segmentSize) + n - 1
+    // survivors are needed.
+    size_t liveSegments = downCast<size_t>(
+            (maxLiveBytes + segmentSize - 1) / segmentSize);
+    if (segmentsToClean.size() > liveSegments)
+        passThreads = std::min(passThreads,
+                segmentsToClean.size() - liveSegments + 1);
+    else
+        passThreads = 1;
+
+    return std::max<size_t>(passThreads, 1);
+}
+
+/**
+ * Relocate the entries of a disk cleaning pass using several threads. The
+ * sorted entries are split into contiguous ranges, one per thread, so that
+ * entries of similar age still end up in the same survivor segments. Each
+ * thread writes and syncs its own survivors; the calling thread handles the
+ * first range itself.
  *
  * \param entries
- *      Vector the entries from segments being cleaned that may need to be
+ *      Sorted entries from segments being cleaned that may need to be
  *      relocated.
+ * \param numPassThreads
+ *      The number of threads to split the work across (including the
+ *      calling thread).
+ * \param outSurvivors
+ *      The new survivor segments created by all threads are returned here.
+ * \param[out] localMetrics
+ *      Contains various performance counters that are incremented here.
+ * \return
+ *      The number of live bytes appended to survivors by all threads.
+ */
+uint64_t
+LogCleaner::relocateLiveEntriesInParallel(EntryVector& entries,
+                            size_t numPassThreads,
+                            LogSegmentVector& outSurvivors,
+                            LogCleanerMetrics::OnDisk<uint64_t>* localMetrics)
+{
+    size_t entriesPerThread =
+            (entries.size() + numPassThreads - 1) / numPassThreads;
+    std::vector<EntryVector::iterator> bounds;
+    for (size_t i = 0; i < numPassThreads; i++)
+        bounds.push_back(entries.begin() +
+                std::min(i * entriesPerThread, entries.size()));
+    bounds.push_back(entries.end());
+
+    std::vector<LogSegmentVector> survivors(numPassThreads);
+    std::vector<LogCleanerMetrics::OnDisk<uint64_t>> metrics(numPassThreads);
+    std::vector<uint64_t> bytesAppended(numPassThreads, 0);
+    std::vector<std::thread> helpers;
+    for (size_t i = 1; i < numPassThreads; i++) {
+        helpers.emplace_back([this, i, &bounds, &survivors, &metrics,
+                              &bytesAppended] {
+            bytesAppended[i] = relocateLiveEntries(bounds[i], bounds[i + 1],
+                    survivors[i], &metrics[i]);
+        });
+    }
+    bytesAppended[0] = relocateLiveEntries(bounds[0], bounds[1],
+            survivors[0], localMetrics);
+    foreach (std::thread& helper, helpers)
+        helper.join();
+
+    uint64_t totalEntryBytesAppended = 0;
+    for (size_t i = 0; i < numPassThreads; i++) {
+        if (i > 0)
+            localMetrics->merge(metrics[i]);
+        outSurvivors.insert(outSurvivors.end(),
+                survivors[i].begin(), survivors[i].end());
+        totalEntryBytesAppended += bytesAppended[i];
+    }
+
+    TEST_LOG("relocated %lu entries using %lu threads",
+            entries.size(), numPassThreads);
+    return totalEntryBytesAppended;
+}
+
+/**
+ * Given a range of entries from segments being cleaned, write them out to
+ * survivor segments in order and alert their owning module (MasterService,
+ * usually), that they've been relocated.
+ *
+ * If the master has a flash tier and memory is getting full (see
+ * FLASH_MEMORY_UTILIZATION), cold entries are written to survivors on flash
+ * and the rest to survivors in memory. Since entries are sorted by age, the
+ * cold ones all come first. Once the flash tier is full, everything stays in
+ * memory.
+ *
+ * \param first
+ *      The first of the entries from segments being cleaned that may need
+ *      to be relocated.
+ * \param last
+ *      One past the last entry to relocate.
  * \param outSurvivors
  *      The new survivor segments created to hold the relocated live data are
  *      returned here.
@@ -620,7 +881,8 @@ LogCleaner::getSortedEntries(LogSegmentVector& segmentsToClean,
  *      overhead.
  */
 uint64_t
-LogCleaner::relocateLiveEntries(EntryVector& entries,
+LogCleaner::relocateLiveEntries(EntryVector::iterator first,
+                            EntryVector::iterator last,
                             LogSegmentVector& outSurvivors,
                             LogCleanerMetrics::OnDisk<uint64_t>* localMetrics)
 {
@@ -630,17 +892,50 @@ LogCleaner::relocateLiveEntries(EntryVector& entries,
     uint64_t totalEntryBytesAppended = 0;
     uint32_t currentLiveEntries[TOTAL_LOG_ENTRY_TYPES] = { 0 };
     uint32_t currentLiveEntryLengths[TOTAL_LOG_ENTRY_TYPES] = { 0 };
+    uint32_t currentYoungestTimestamp = 0;
+
+    SegletAllocator& allocator = segmentManager.getAllocator();
+    bool useFlash = allocator.hasFlash() &&
+            allocator.getFreeCount(SegletAllocator::FLASH) > 0 &&
+            segmentManager.getMemoryUtilization() >= FLASH_MEMORY_UTILIZATION;
+    uint32_t now = WallTime::secondsTimestamp();
+
+    for (EntryVector::iterator it = first; it != last; ++it) {
+        // Entries are sorted by age rather than location, so each one is
+        // likely a cache miss, as is the metadata used to check liveness.
+        // Prefetch ahead so those misses overlap (see
+        // RELOCATION_PREFETCH_DEPTH).
+        if (last - it > 2 * RELOCATION_PREFETCH_DEPTH) {
+            const Entry& next = it[2 * RELOCATION_PREFETCH_DEPTH];
+            prefetch(reinterpret_cast<const void*>(
+                    next.reference.toInteger()), 2 * CACHE_LINE_SIZE);
+        }
+        if (last - it > RELOCATION_PREFETCH_DEPTH) {
+            Buffer nextBuffer;
+            LogEntryType nextType =
+                it[RELOCATION_PREFETCH_DEPTH].reference.getEntry(
+                    &segmentManager.getAllocator(), &nextBuffer);
+            entryHandlers.prefetchForRelocation(nextType, nextBuffer);
+        }
 
-    foreach (Entry& entry, entries) {
+        Entry& entry = *it;
         Buffer buffer;
         LogEntryType type = entry.reference.getEntry(
             &segmentManager.getAllocator(), &buffer);
         Log::Reference reference = entry.reference;
         uint32_t bytesAppended = 0;
+
+        // Cold entries and the rest go to different survivors; relocating
+        // into a NULL survivor fails, so a new one is allocated below.
+        bool cold = useFlash && entry.timestamp != 0 &&
+                entry.timestamp + FLASH_COLD_AGE_SECONDS <= now;
+        LogSegment* target = survivor;
+        if (survivor != NULL && survivor->onFlash != cold)
+            target = NULL;
         RelocStatus s = relocateEntry(type,
                                       buffer,
                                       reference,
-                                      survivor,
+                                      target,
                                       localMetrics,
                                       &bytesAppended);
 
@@ -654,6 +949,8 @@ LogCleaner::relocateLiveEntries(EntryVector& entries,
                 memset(currentLiveEntries, 0, sizeof(currentLiveEntries));
                 memset(currentLiveEntryLengths, 0,
                        sizeof(currentLiveEntryLengths));
+                setSurvivorAge(survivor, currentYoungestTimestamp);
+                currentYoungestTimestamp = 0;
                 closeSurvivor(survivor);
             }
 
@@ -661,9 +958,18 @@ LogCleaner::relocateLiveEntries(EntryVector& entries,
             // one is not available right now.
             CycleCounter<uint64_t> waitTicks(
                 &localMetrics->waitForFreeSurvivorsTicks);
-            survivor = segmentManager.allocSideSegment(
-                SegmentManager::FOR_CLEANING | SegmentManager::MUST_NOT_FAIL,
-                NULL);
+            survivor = NULL;
+            if (cold) {
+                survivor = segmentManager.allocSideSegment(
+                    SegmentManager::ON_FLASH, NULL);
+                if (survivor == NULL)
+                    useFlash = false;
+            }
+            if (survivor == NULL) {
+                survivor = segmentManager.allocSideSegment(
+                    SegmentManager::FOR_CLEANING |
+                    SegmentManager::MUST_NOT_FAIL, NULL);
+            }
             assert(survivor != NULL);
             waitTicks.stop();
             outSurvivors.push_back(survivor);
@@ -686,6 +992,17 @@ LogCleaner::relocateLiveEntries(EntryVector& entries,
                 buffer.size();
             currentLiveEntries[type]++;
             currentLiveEntryLengths[type] += bytesAppended;
+            currentYoungestTimestamp = std::max(currentYoungestTimestamp,
+                                                entry.timestamp);
+
+            // Long-lived entries on flash no longer count against the log's
+            // memory (see AbstractLog::hasSpaceFor).
+            if (survivor->onFlash && (type == LOG_ENTRY_TYPE_OBJ ||
+                    type == LOG_ENTRY_TYPE_RPCRESULT ||
+                    type == LOG_ENTRY_TYPE_PREP ||
+                    type == LOG_ENTRY_TYPE_TXPLIST)) {
+                segmentManager.adjustFlashLiveBytes(bytesAppended);
+            }
         }
 
         totalEntryBytesAppended += bytesAppended;
@@ -697,6 +1014,7 @@ LogCleaner::relocateLiveEntries(EntryVector& entries,
                                       currentLiveEntries[i],
                                       currentLiveEntryLengths[i]);
         }
+        setSurvivorAge(survivor, currentYoungestTimestamp);
         closeSurvivor(survivor);
     }
 
@@ -712,9 +1030,47 @@ LogCleaner::relocateLiveEntries(EntryVector& entries,
     LOG(NOTICE, "Cleaner finished syncing survivor segments: %.1f ms, "
             "%.1f MB/sec", elapsed*1e03, survivorMb/elapsed);
 
+    // Survivors on the flash tier are now safely on backups; write them out
+    // to flash so that they stop taking up memory in the page cache.
+    foreach (survivor, outSurvivors) {
+        if (!survivor->onFlash)
+            continue;
+        for (uint32_t offset = 0; offset < survivor->getAppendedLength();
+                offset += segletSize) {
+            const void* p;
+            survivor->peek(offset, &p);
+            allocator.writeBackToFlash(p, segletSize);
+        }
+    }
+
     return totalEntryBytesAppended;
 }
 
+/**
+ * Record the age of the data in a survivor segment written by disk cleaning.
+ * Survivors would otherwise look as young as the cleaning pass that created
+ * them, even when they hold data that hasn't been overwritten in a long time.
+ * Since entries are relocated in timestamp order, survivors hold data of
+ * similar age, and this lets the cost-benefit policy treat segments of cold
+ * data as cold (and clean them at higher utilization) the way the original
+ * head segments were treated.
+ *
+ * \param survivor
+ *      The survivor segment that is about to be closed.
+ * \param youngestTimestamp
+ *      WallTime seconds timestamp of the youngest entry relocated to the
+ *      survivor. Entries without timestamps report 0; if the survivor holds
+ *      only those, its creation time is kept.
+ */
+void
+LogCleaner::setSurvivorAge(LogSegment* survivor, uint32_t youngestTimestamp)
+{
+    if (youngestTimestamp != 0 &&
+            youngestTimestamp < survivor->creationTimestamp) {
+        survivor->creationTimestamp = youngestTimestamp;
+    }
+}
+
 /**
  * Close a survivor segment we've written data to as part of a disk cleaning
  * pass and tell the replicaManager to begin flushing it asynchronously to
@@ -781,15 +1137,33 @@ LogCleaner::Balancer::compactionFailed()
 LogCleaner::Balancer::CleaningTask
 LogCleaner::Balancer::requestTask(CleanerThreadState* thread)
 {
-    if (isDiskCleaningNeeded(thread))
+    if (isDiskCleaningNeeded(thread)) {
+        diskCleaningTasks++;
         return CLEAN_DISK;
+    }
 
-    if (!cleaner->disableInMemoryCleaning && isMemoryLow(thread))
+    if (!cleaner->disableInMemoryCleaning && isMemoryLow(thread)) {
+        compactionTasks++;
         return COMPACT_MEMORY;
+    }
 
+    sleepTasks++;
     return SLEEP;
 }
 
+/**
+ * Fill in the provided protocol buffer with the decisions this balancer has
+ * made, so that its policy can be evaluated and tuned.
+ */
+void
+LogCleaner::Balancer::getMetrics(
+        ProtoBuf::LogMetrics_CleanerMetrics_BalancerMetrics& m)
+{
+    m.set_disk_cleaning_tasks(diskCleaningTasks);
+    m.set_compaction_tasks(compactionTasks);
+    m.set_sleep_tasks(sleepTasks);
+}
+
 LogCleaner::TombstoneRatioBalancer::TombstoneRatioBalancer(LogCleaner* cleaner,
                                                            double ratio)
     : Balancer(cleaner)
@@ -904,6 +1278,231 @@ LogCleaner::FixedBalancer::isDiskCleaningNeeded(CleanerThreadState* thread)
     return true;
 }
 
+/**
+ * Fold a new sample into an exponentially-weighted moving average. The first
+ * sample (when the average is still 0) is taken as is.
+ */
+static double
+movingAverage(double average, double sample, int weightPercent)
+{
+    if (average == 0)
+        return sample;
+    return (average * (100 - weightPercent) + sample * weightPercent) / 100;
+}
+
+/**
+ * Construct an AdaptiveBalancer.
+ *
+ * \param cleaner
+ *      The cleaner whose threads this balancer schedules.
+ * \param leadSeconds
+ *      Cleaning starts ahead of need once the free memory would be used up
+ *      in fewer than this many seconds at the current append rate.
+ */
+LogCleaner::AdaptiveBalancer::AdaptiveBalancer(LogCleaner* cleaner,
+                                               double leadSeconds)
+    : Balancer(cleaner)
+    , leadSeconds(leadSeconds)
+    , mutex("LogCleaner::AdaptiveBalancer::mutex")
+    , lastSampleTicks(0)
+    , lastFreeSeglets(0)
+    , lastCompactionBytesFreed(0)
+    , lastCompactionTicks(0)
+    , lastDiskBytesFreed(0)
+    , lastDiskTicks(0)
+    , appendBytesPerSecond(0)
+    , cleanerBytesPerSecond(0)
+    , compactionCyclesPerByte(0)
+    , diskCyclesPerByte(0)
+    , headroomSeconds(std::numeric_limits<double>::infinity())
+    , wantedThreads(0)
+{
+    LOG(NOTICE, "Using adaptive balancer with %.2f second lead time",
+        leadSeconds);
+    if (leadSeconds <= 0)
+        DIE("Invalid adaptive argument (%f). Must be > 0.", leadSeconds);
+}
+
+LogCleaner::AdaptiveBalancer::~AdaptiveBalancer()
+{
+}
+
+/**
+ * Fill in the provided protocol buffer with this balancer's decisions and
+ * the current state of its model.
+ */
+void
+LogCleaner::AdaptiveBalancer::getMetrics(
+        ProtoBuf::LogMetrics_CleanerMetrics_BalancerMetrics& m)
+{
+    Balancer::getMetrics(m);
+
+    SpinLock::Guard _(mutex);
+    m.set_append_bytes_per_second(appendBytesPerSecond);
+    m.set_cleaner_bytes_per_second(cleanerBytesPerSecond);
+    m.set_compaction_cycles_per_byte(compactionCyclesPerByte);
+    m.set_disk_cycles_per_byte(diskCyclesPerByte);
+    m.set_headroom_seconds(headroomSeconds);
+    m.set_wanted_threads(wantedThreads);
+}
+
+bool
+LogCleaner::AdaptiveBalancer::isMemoryLow(CleanerThreadState* thread)
+{
+    sample();
+
+    // Never clean later than the static thresholds would, but only let the
+    // first thread fall back on them. Additional threads are only run when
+    // the model says they are needed to keep up.
+    if (thread->threadNumber == 0 && Balancer::isMemoryLow(thread))
+        return true;
+
+    const int T = cleaner->segmentManager.getMemoryUtilization();
+    const int L = cleaner->cleanableSegments.getLiveObjectUtilization();
+    if (T - L < MIN_RECLAIMABLE_UTILIZATION)
+        return false;
+
+    return thread->threadNumber < wantedThreads;
+}
+
+bool
+LogCleaner::AdaptiveBalancer::isDiskCleaningNeeded(CleanerThreadState* thread)
+{
+    // See TombstoneRatioBalancer::isDiskCleaningNeeded for comments on the
+    // conditions shared with it.
+    if (thread->threadNumber != 0 && !cleaner->disableInMemoryCleaning)
+        return false;
+
+    if (cleaner->segmentManager.getSegmentUtilization() >= MIN_DISK_UTILIZATION)
+        return true;
+
+    if (!isMemoryLow(thread))
+        return false;
+
+    if (cleaner->disableInMemoryCleaning)
+        return true;
+
+    if (compactionFailures > compactionFailuresHandled) {
+        compactionFailuresHandled++;
+        return true;
+    }
+
+    // If compaction has recently been freeing memory at a higher cost per
+    // byte than disk cleaning, it is mostly copying live data around; a disk
+    // pass will do better. Forget compaction's cost afterwards so that it
+    // gets measured again rather than being locked out by a stale value.
+    {
+        SpinLock::Guard _(mutex);
+        if (diskCyclesPerByte > 0 &&
+                compactionCyclesPerByte > diskCyclesPerByte) {
+            compactionCyclesPerByte = 0;
+            return true;
+        }
+    }
+
+    const int U = cleaner->cleanableSegments.getUndeadTombstoneUtilization();
+    const int L = cleaner->cleanableSegments.getLiveObjectUtilization();
+    if (U >= static_cast<int>(TOMBSTONE_RATIO * (100 - L)))
+        return true;
+
+    return false;
+}
+
+/**
+ * Update the balancer's model of the system, at most once every
+ * SAMPLE_INTERVAL_USEC. The model tracks:
+ *   - The rate at which appends consume memory. This is the drop in free
+ *     seglets plus whatever the cleaner freed in the meantime.
+ *   - The rate at which one cleaner thread frees memory while it runs.
+ *   - The cost per byte freed of compaction and of disk cleaning.
+ * From these it computes how long the remaining free memory will last and
+ * how many cleaner threads must run to keep up.
+ */
+void
+LogCleaner::AdaptiveBalancer::sample()
+{
+    SpinLock::Guard _(mutex);
+
+    uint64_t now = Cycles::rdtsc();
+    if (lastSampleTicks != 0 &&
+            Cycles::toMicroseconds(now - lastSampleTicks) <
+            SAMPLE_INTERVAL_USEC) {
+        return;
+    }
+
+    uint64_t freeSeglets = cleaner->segmentManager.getAllocator().getFreeCount(
+            SegletAllocator::DEFAULT);
+    uint64_t compactionBytesFreed = cleaner->inMemoryMetrics.totalBytesFreed;
+    uint64_t compactionTicks = cleaner->inMemoryMetrics.totalTicks;
+    uint64_t diskBytesFreed = cleaner->onDiskMetrics.totalMemoryBytesFreed;
+    uint64_t diskTicks = cleaner->onDiskMetrics.totalTicks;
+
+    if (lastSampleTicks != 0) {
+        double elapsed = Cycles::toSeconds(now - lastSampleTicks);
+        uint64_t compactionFreed =
+                compactionBytesFreed - lastCompactionBytesFreed;
+        uint64_t diskFreed = diskBytesFreed - lastDiskBytesFreed;
+        uint64_t compactionSpent = compactionTicks - lastCompactionTicks;
+        uint64_t diskSpent = diskTicks - lastDiskTicks;
+
+        double consumed = static_cast<double>(compactionFreed + diskFreed) +
+                (static_cast<double>(lastFreeSeglets) -
+                 static_cast<double>(freeSeglets)) * cleaner->segletSize;
+        appendBytesPerSecond = movingAverage(appendBytesPerSecond,
+                std::max(0.0, consumed) / elapsed, SAMPLE_WEIGHT_PERCENT);
+
+        if (compactionSpent + diskSpent > 0) {
+            double cleanerSeconds = Cycles::toSeconds(compactionSpent +
+                                                      diskSpent);
+            cleanerBytesPerSecond = movingAverage(cleanerBytesPerSecond,
+                    static_cast<double>(compactionFreed + diskFreed) /
+                    cleanerSeconds, SAMPLE_WEIGHT_PERCENT);
+        }
+        if (compactionFreed > 0) {
+            compactionCyclesPerByte = movingAverage(compactionCyclesPerByte,
+                    static_cast<double>(compactionSpent) /
+                    static_cast<double>(compactionFreed),
+                    SAMPLE_WEIGHT_PERCENT);
+        }
+        if (diskFreed > 0) {
+            diskCyclesPerByte = movingAverage(diskCyclesPerByte,
+                    static_cast<double>(diskSpent) /
+                    static_cast<double>(diskFreed), SAMPLE_WEIGHT_PERCENT);
+        }
+    }
+
+    headroomSeconds = std::numeric_limits<double>::infinity();
+    if (appendBytesPerSecond > 0) {
+        headroomSeconds = static_cast<double>(freeSeglets) *
+                cleaner->segletSize / appendBytesPerSecond;
+    }
+
+    uint32_t wanted = 0;
+    if (headroomSeconds < leadSeconds) {
+        uint32_t maxThreads = downCast<uint32_t>(cleaner->numThreads);
+        wanted = maxThreads;
+        if (cleanerBytesPerSecond > 0) {
+            double needed = std::ceil(appendBytesPerSecond /
+                                      cleanerBytesPerSecond);
+            if (needed < maxThreads)
+                wanted = static_cast<uint32_t>(needed);
+        }
+
+        // Running out sooner than expected means we're already behind.
+        if (headroomSeconds < leadSeconds / 2)
+            wanted++;
+        wanted = std::max(1U, std::min(wanted, maxThreads));
+    }
+    wantedThreads = wanted;
+
+    lastSampleTicks = now;
+    lastFreeSeglets = freeSeglets;
+    lastCompactionBytesFreed = compactionBytesFreed;
+    lastCompactionTicks = compactionTicks;
+    lastDiskBytesFreed = diskBytesFreed;
+    lastDiskTicks = diskTicks;
+}
+
 /**
  * Construct a Disabler object. Once the constructor returns, the caller
  * can be certain that no cleaner threads are running, or will run until
@@ -28,6 +28,7 @@
 #include "LogSegment.h"
 #include "SegmentManager.h"
 #include "ReplicaManager.h"
+#include "SpinLock.h"
 
 #include "LogMetrics.pb.h"
 
@@ -111,6 +112,18 @@ class LogCleaner {
     /// seglets at the ends of survivor segments.
     enum { SURVIVOR_SEGMENTS_TO_RESERVE = 15 };
 
+    /// Disk cleaning passes are only split across multiple threads if each
+    /// thread gets at least this many entries to relocate; for smaller
+    /// passes the cost of starting threads outweighs the benefit.
+    enum { MIN_ENTRIES_PER_PASS_THREAD = 1000 };
+
+    /// How many entries ahead relocateLiveEntries() runs each stage of its
+    /// prefetch pipeline. Log entries are prefetched twice this far ahead of
+    /// the entry being relocated, and the entry handlers are asked to
+    /// prefetch their liveness metadata (e.g. hash table buckets) this far
+    /// ahead.
+    enum { RELOCATION_PREFETCH_DEPTH = 4 };
+
     /// The minimum amount of memory utilization we will begin cleaning at using
     /// the in-memory cleaner.
     enum { MIN_MEMORY_UTILIZATION = 90 };
@@ -122,6 +135,22 @@ class LogCleaner {
     /// inefficiency and requires disk cleaning to free them).
     enum { MIN_DISK_UTILIZATION = 95 };
 
+    /// If the master has a flash tier (see SegletAllocator), disk cleaning
+    /// writes cold entries to survivors on flash instead of in memory once
+    /// memory utilization reaches this percentage.
+    enum { FLASH_MEMORY_UTILIZATION = 90 };
+
+    /// Entries whose timestamps are at least this many seconds old are cold
+    /// enough to be written to the flash tier.
+    enum { FLASH_COLD_AGE_SECONDS = 600 };
+
+    /// How often, at most, getThrottle() recomputes the foreground load.
+    enum { THROTTLE_SAMPLE_USEC = 10000 };
+
+    /// Number of RPCs waiting for a worker at which the server is considered
+    /// fully loaded, however idle the dispatch thread is.
+    enum { THROTTLE_FULL_LOAD_WAITING_RPCS = 8 };
+
     /**
      * Tuple containing a reference to an entry being cleaned, as well as a
      * cache of its timestamp. The purpose of this is to make sorting entries
@@ -183,19 +212,29 @@ class LogCleaner {
             : cleaner(cleaner)
             , compactionFailures(0)
             , compactionFailuresHandled(0)
+            , diskCleaningTasks(0)
+            , compactionTasks(0)
+            , sleepTasks(0)
         {
         }
         virtual ~Balancer() { }
         CleaningTask requestTask(CleanerThreadState* thread);
         void compactionFailed();
+        virtual void getMetrics(
+                ProtoBuf::LogMetrics_CleanerMetrics_BalancerMetrics& m);
 
       PROTECTED:
-        bool isMemoryLow(CleanerThreadState* thread);
+        virtual bool isMemoryLow(CleanerThreadState* thread);
         virtual bool isDiskCleaningNeeded(CleanerThreadState* thread) = 0;
         LogCleaner* cleaner;
         std::atomic<uint64_t> compactionFailures;
         std::atomic<uint64_t> compactionFailuresHandled;
 
+        /// Number of times requestTask() handed out each kind of task.
+        std::atomic<uint64_t> diskCleaningTasks;
+        std::atomic<uint64_t> compactionTasks;
+        std::atomic<uint64_t> sleepTasks;
+
         DISALLOW_COPY_AND_ASSIGN(Balancer);
     };
 
@@ -220,12 +259,98 @@ class LogCleaner {
         const uint32_t cleaningPercentage;
     };
 
+    /**
+     * Balancer that schedules cleaning ahead of need rather than waiting
+     * for fixed memory utilization thresholds. It periodically samples how
+     * fast appends consume free seglets and how fast each cleaner thread
+     * frees memory, and runs as many cleaner threads as are needed to keep
+     * up once the free memory left would last less than a given lead time.
+     * When writes are idle it falls back to the static thresholds with a
+     * single thread, so it doesn't burn cores for nothing.
+     *
+     * Disk cleaning versus compaction is decided as in the
+     * TombstoneRatioBalancer, except that disk cleaning is also chosen when
+     * it has recently been freeing memory at a lower cost per byte than
+     * compaction (a sign that compaction is only shuffling live data).
+     */
+    class AdaptiveBalancer : public Balancer {
+      public:
+        AdaptiveBalancer(LogCleaner* cleaner, double leadSeconds);
+        ~AdaptiveBalancer();
+        void getMetrics(ProtoBuf::LogMetrics_CleanerMetrics_BalancerMetrics& m);
+
+      PRIVATE:
+        bool isMemoryLow(CleanerThreadState* thread);
+        bool isDiskCleaningNeeded(CleanerThreadState* thread);
+        void sample();
+
+        /// How often (in microseconds) the model's inputs are sampled.
+        enum { SAMPLE_INTERVAL_USEC = 100000 };
+
+        /// Weight (in percent) given to each new sample in the moving
+        /// averages of the rates below.
+        enum { SAMPLE_WEIGHT_PERCENT = 25 };
+
+        /// Memory is never cleaned ahead of need unless at least this much
+        /// of it (in percent) is not used by live objects; otherwise there is
+        /// too little to gain.
+        enum { MIN_RECLAIMABLE_UTILIZATION = 5 };
+
+        /// Fraction of reclaimable space that undead tombstones must occupy
+        /// before disk cleaning is run (see TombstoneRatioBalancer).
+        static CONSTEXPR_VAR double TOMBSTONE_RATIO = 0.40;
+
+        /// Cleaning starts once free memory would last fewer than this many
+        /// seconds at the current append rate.
+        const double leadSeconds;
+
+        /// Serializes sample().
+        SpinLock mutex;
+
+        /// Cycles::rdtsc() value of the last sample; 0 before the first.
+        uint64_t lastSampleTicks;
+
+        /// Free seglets in the default pool at the last sample.
+        uint64_t lastFreeSeglets;
+
+        /// Cleaner totals (bytes of memory freed and cycles spent) at the
+        /// last sample, for compaction and disk cleaning respectively.
+        uint64_t lastCompactionBytesFreed;
+        uint64_t lastCompactionTicks;
+        uint64_t lastDiskBytesFreed;
+        uint64_t lastDiskTicks;
+
+        /// Moving average of the rate at which appends consume memory, in
+        /// bytes per second.
+        double appendBytesPerSecond;
+
+        /// Moving average of the rate at which a single cleaner thread frees
+        /// memory while running, in bytes per second.
+        double cleanerBytesPerSecond;
+
+        /// Moving averages of the cycles spent per byte of memory freed by
+        /// compaction and by disk cleaning. 0 until measured.
+        double compactionCyclesPerByte;
+        double diskCyclesPerByte;
+
+        /// Seconds until free memory runs out at the current append rate.
+        double headroomSeconds;
+
+        /// Number of cleaner threads the model currently wants running.
+        /// Thread i may clean ahead of need iff i < wantedThreads.
+        std::atomic<uint32_t> wantedThreads;
+
+        DISALLOW_COPY_AND_ASSIGN(AdaptiveBalancer);
+    };
+
     static void cleanerThreadEntry(LogCleaner* logCleaner, Context* context);
     int getLiveObjectUtilization();
     int getUndeadTombstoneUtilization();
     bool checkIfCleaningNeeded(CleanerThreadState* thread);
     bool checkIfDiskCleaningNeeded(CleanerThreadState* thread);
     void doWork(CleanerThreadState* state);
+    double getThrottle();
+    void throttleAfterWork(uint64_t workTicks);
     void doMemoryCleaning();
     void doDiskCleaning();
     LogSegment* getSegmentToCompact();
@@ -236,9 +361,18 @@ class LogCleaner {
     void getSortedEntries(LogSegmentVector& segmentsToClean,
                           EntryVector& outEntries,
                           LogCleanerMetrics::OnDisk<uint64_t>* localMetrics);
-    uint64_t relocateLiveEntries(EntryVector& entries,
+    size_t getPassThreadCount(LogSegmentVector& segmentsToClean,
+                              size_t numEntries,
+                              uint64_t maxLiveBytes);
+    uint64_t relocateLiveEntriesInParallel(EntryVector& entries,
+                            size_t numPassThreads,
                             LogSegmentVector& outSurvivors,
                             LogCleanerMetrics::OnDisk<uint64_t>* localMetrics);
+    uint64_t relocateLiveEntries(EntryVector::iterator first,
+                            EntryVector::iterator last,
+                            LogSegmentVector& outSurvivors,
+                            LogCleanerMetrics::OnDisk<uint64_t>* localMetrics);
+    void setSurvivorAge(LogSegment* survivor, uint32_t youngestTimestamp);
     void closeSurvivor(LogSegment* survivor);
     void waitForAvailableSurvivors(size_t count, uint64_t& outTicks);
 
@@ -369,6 +503,10 @@ class LogCleaner {
     /// keep up with higher write rates and memory utilizations.
     const int numThreads;
 
+    /// The maximum number of threads that relocate live entries within a
+    /// single disk cleaning pass (see relocateLiveEntriesInParallel).
+    const uint32_t numPassThreads;
+
     /// Size of each seglet in bytes. Used to calculate the best segment for in-
     /// memory cleaning.
     uint32_t segletSize;
@@ -402,6 +540,30 @@ class LogCleaner {
     /// memory was not low.
     LogCleanerMetrics::Atomic64BitType doWorkSleepTicks;
 
+    /// Number of cpu cycles cleaner threads spent paused in
+    /// throttleAfterWork() to leave the cpu to foreground work.
+    LogCleanerMetrics::Atomic64BitType throttledTicks;
+
+    /// Largest fraction of their time, in percent, that cleaner threads
+    /// pause for foreground load (see getThrottle); 0 disables throttling.
+    uint32_t maxThrottlePercent;
+
+    /// Protects the throttle sample below, which is shared by all cleaner
+    /// threads.
+    SpinLock throttleMutex;
+
+    /// Cycles::rdtsc() value when the throttle was last computed.
+    uint64_t lastThrottleSample;
+
+    /// PerfStats::dispatchActiveCycles at lastThrottleSample.
+    uint64_t lastDispatchActiveCycles;
+
+    /// PerfStats::collectionTime at lastThrottleSample.
+    uint64_t lastCollectionTime;
+
+    /// Most recent result of getThrottle().
+    double throttle;
+
     /// Metrics kept for measuring in-memory cleaning (compaction) performance.
     /// Note that this instance uses the default template that uses atomic
     /// operations. Be careful incrementing these counters in hot paths. It's
@@ -432,6 +594,7 @@ class LogCleaner {
     Balancer* balancer;
 
     friend class CleanerCompactionBenchmark;
+    friend class CleanerTraceSimulator;
 
     DISALLOW_COPY_AND_ASSIGN(LogCleaner);
 };
@@ -38,6 +38,7 @@
 #include "RawMetrics.h"
 #include "RamCloud.h"
 #include "Segment.h"
+#include "SpinLock.h"
 #include "Tub.h"
 
 #include "LogMetrics.pb.h"
@@ -64,6 +65,8 @@ class Options {
           abortTimeout(0),
           minimumBenchmarkSeconds(0),
           distributionName(),
+          hotAccessPercentage(0),
+          hotSpacePercentage(0),
           tableName(),
           outputFilesPrefix(),
           doneWhenCleanerRuns(false)
@@ -81,6 +84,8 @@ class Options {
     unsigned abortTimeout;
     unsigned minimumBenchmarkSeconds;
     string distributionName;
+    int hotAccessPercentage;
+    int hotSpacePercentage;
     string tableName;
     string outputFilesPrefix;
     bool doneWhenCleanerRuns;
@@ -1342,6 +1347,12 @@ Output::dumpParameters(FILE* fp,
     fprintf(fp, "  Distribution:                  %s\n",
         options.distributionName.c_str());
 
+    if (options.distributionName == "hotAndCold") {
+        fprintf(fp, "  Hot Pool:                      %d%% of writes to "
+            "%d%% of objects\n",
+            options.hotAccessPercentage, options.hotSpacePercentage);
+    }
+
     fprintf(fp, "  Utilization:                   %d\n",
         options.utilization);
 
@@ -1534,6 +1545,18 @@ Output::dumpSpinLockMetrics(FILE* fp, ProtoBuf::ServerStatistics& serverStats)
             locks[i].contentionPct,
             locks[i].contendedNsec / 1000000);
     }
+
+    // Call sites are only known if the server is profiling its locks.
+    bool haveSites = false;
+    foreach (const ProtoBuf::SpinLockStatistics_Lock& lock,
+      spinLockStats.locks()) {
+        if (lock.sites_size() > 0)
+            haveSites = true;
+    }
+    if (haveSites) {
+        fprintf(fp, "===> CALL SITES WAITING LONGEST FOR SPINLOCKS\n%s",
+            SpinLock::getProfile(spinLockStats, maxLocks).c_str());
+    }
 }
 
 void
@@ -1678,6 +1701,18 @@ try
            default_value("uniform"),
          "Object distribution; choose one of \"uniform\", "
          "\"hotAndCold\", or \"zipfian\"")
+        ("hotAccessPercentage",
+         ProgramOptions::value<int>(&options.hotAccessPercentage)->
+           default_value(90),
+         "Percentage of writes that go to the hot pool in the \"hotAndCold\" "
+         "distribution.")
+        ("hotSpacePercentage",
+         ProgramOptions::value<int>(&options.hotSpacePercentage)->
+           default_value(10),
+         "Percentage of the objects that make up the hot pool in the "
+         "\"hotAndCold\" distribution. Sweeping this and "
+         "--hotAccessPercentage shows how well the cleaner separates hot and "
+         "cold data.")
         ("minimumBenchmarkSeconds,m",
          ProgramOptions::value<unsigned>(&options.minimumBenchmarkSeconds)->
             default_value(600),
@@ -1756,6 +1791,16 @@ try
             MAX_OBJECT_SIZE);
         exit(1);
     }
+    if (options.hotAccessPercentage < 0 || options.hotAccessPercentage > 100) {
+        fprintf(stderr, "ERROR: hotAccessPercentage must be between 0 and "
+            "100\n");
+        exit(1);
+    }
+    if (options.hotSpacePercentage < 1 || options.hotSpacePercentage > 99) {
+        fprintf(stderr, "ERROR: hotSpacePercentage must be between 1 and "
+            "99\n");
+        exit(1);
+    }
     if (options.objectsPerRpc < 1) {
         fprintf(stderr, "ERROR: objectPerRpc must be >= 1\n");
         exit(1);
@@ -1858,7 +1903,8 @@ try
         distribution = new HotAndColdDistribution(logSize,
                                                   options.utilization,
                                                   options.objectSize,
-                                                  90, 10);
+                                                  options.hotAccessPercentage,
+                                                  options.hotSpacePercentage);
     } else if (options.distributionName == "zipfian") {
         // Since Zipfian can take a little while to compute the right
         // distribution, disable the alarm temporarily.
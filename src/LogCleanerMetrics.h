@@ -389,6 +389,18 @@ class OnDisk {
                    static_cast<double>(totalDiskBytesFreed);
     }
 
+    /**
+     * Return the average number of cleaner cycles spent per byte freed on
+     * disk. Unlike the write cost, this also reflects the CPU spent
+     * deciding which entries are alive.
+     */
+    double
+    getAverageCyclesPerDiskByteFreed()
+    {
+        return static_cast<double>(totalTicks) /
+               static_cast<double>(totalDiskBytesFreed);
+    }
+
     double
     getAverageCleanedSegmentMemoryUtilization()
     {
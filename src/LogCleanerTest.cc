@@ -32,6 +32,7 @@
 #include "MasterTableMetadata.h"
 #include "ReplicaManager.h"
 #include "WallTime.h"
+#include "WorkerManager.h"
 
 namespace RAMCloud {
 
@@ -61,6 +62,12 @@ class TestEntryHandlers : public LogEntryHandlers {
             relocator.append(type, oldBuffer);
     }
 
+    void
+    prefetchForRelocation(LogEntryType type, Buffer& buffer)
+    {
+        RAMCLOUD_TEST_LOG("type %d", downCast<int>(type));
+    }
+
     uint32_t timestamp;
     bool attemptToRelocate;
 };
@@ -287,6 +294,83 @@ TEST_F(LogCleanerTest, doWork_notifyConditionVariable) {
     thread.join();
 }
 
+TEST_F(LogCleanerTest, getThrottle) {
+    // Use a log big enough that free memory can be well above the
+    // reserves.
+    CleanerServerConfig config;
+    config.serverConfig.segmentSize = 1024 * 1024;
+    config.serverConfig.master.logBytes = 200 * 1024 * 1024;
+    config.serverConfig.master.cleanerThrottlePercent = 50;
+    SegletAllocator bigAllocator(config());
+    SegmentManager bigSegmentManager(&context, config(), &serverId,
+            bigAllocator, replicaManager, &masterTableMetadata);
+    LogCleaner bigCleaner(&context, config(), bigSegmentManager,
+            replicaManager, entryHandlers);
+    WorkerManager workerManager(&context, 1);
+    context.workerManager = &workerManager;
+
+    // Idle server.
+    EXPECT_DOUBLE_EQ(0, bigCleaner.getThrottle());
+
+    // Half loaded; the previous sample is reused until it gets old.
+    workerManager.rpcsWaiting = LogCleaner::THROTTLE_FULL_LOAD_WAITING_RPCS / 2;
+    bigCleaner.lastThrottleSample = Cycles::rdtsc();
+    EXPECT_DOUBLE_EQ(0, bigCleaner.getThrottle());
+    bigCleaner.lastThrottleSample = 0;
+    EXPECT_DOUBLE_EQ(0.25, bigCleaner.getThrottle());
+
+    // Fully loaded, with free memory getting closer to the reserves.
+    workerManager.rpcsWaiting = 100;
+    double reserve = static_cast<double>(
+            bigAllocator.getTotalCount(SegletAllocator::EMERGENCY_HEAD) +
+            bigAllocator.getTotalCount(SegletAllocator::CLEANER));
+    vector<Seglet*> seglets;
+    EXPECT_TRUE(bigAllocator.alloc(SegletAllocator::DEFAULT,
+            downCast<uint32_t>(static_cast<double>(
+                bigAllocator.getFreeCount(SegletAllocator::DEFAULT)) -
+                3 * reserve),
+            seglets));
+    bigCleaner.lastThrottleSample = 0;
+    EXPECT_NEAR(0.25, bigCleaner.getThrottle(), 0.01);
+
+    // Free memory down to twice the reserves: full speed.
+    EXPECT_TRUE(bigAllocator.alloc(SegletAllocator::DEFAULT,
+            downCast<uint32_t>(reserve), seglets));
+    bigCleaner.lastThrottleSample = 0;
+    EXPECT_DOUBLE_EQ(0, bigCleaner.getThrottle());
+
+    foreach (Seglet* seglet, seglets)
+        seglet->free();
+    workerManager.rpcsWaiting = 0;
+    context.workerManager = NULL;
+
+    // Throttling disabled.
+    bigCleaner.maxThrottlePercent = 0;
+    bigCleaner.throttle = 0.5;
+    EXPECT_DOUBLE_EQ(0, bigCleaner.getThrottle());
+}
+
+TEST_F(LogCleanerTest, throttleAfterWork) {
+    // Not throttled.
+    cleaner.throttleAfterWork(Cycles::fromMicroseconds(1000));
+    EXPECT_EQ(0U, cleaner.throttledTicks);
+
+    // Pretend a recent sample said to spend half the time paused.
+    cleaner.maxThrottlePercent = 50;
+    cleaner.throttle = 0.5;
+    cleaner.lastThrottleSample = Cycles::rdtsc();
+    cleaner.throttleAfterWork(Cycles::fromMicroseconds(1000));
+    uint64_t ticks = cleaner.throttledTicks;
+    EXPECT_GE(ticks, Cycles::fromMicroseconds(1000));
+
+    // The cleaner is being halted: don't pause.
+    cleaner.threadsShouldExit = true;
+    cleaner.lastThrottleSample = Cycles::rdtsc();
+    cleaner.throttleAfterWork(Cycles::fromSeconds(10));
+    EXPECT_LT(cleaner.throttledTicks - ticks, Cycles::fromSeconds(1));
+    cleaner.threadsShouldExit = false;
+}
+
 // There are currently no meaningful tests for doMemoryCleaning;
 // please write some!
 
@@ -320,6 +404,129 @@ TEST_F(LogCleanerTest, doDiskCleaning) {
         TestLog::get());
 }
 
+TEST_F(LogCleanerTest, getPassThreadCount) {
+    SegletAllocator allocator2(serverConfig());
+    SegmentManager segmentManager2(&context, serverConfig(), &serverId,
+                                   allocator2, replicaManager,
+                                   &masterTableMetadata);
+    serverConfig()->master.cleanerPassThreads = 4;
+    LogCleaner cleaner2(&context, serverConfig(),
+                        segmentManager2, replicaManager, entryHandlers);
+    EXPECT_EQ(LogCleaner::SURVIVOR_SEGMENTS_TO_RESERVE + 3,
+        segmentManager2.freeSurvivorSlots.size());
+
+    uint64_t segmentSize = serverConfig()->segmentSize;
+    LogSegmentVector segments(10, NULL);
+
+    // Default configuration never splits a pass.
+    EXPECT_EQ(1U, cleaner.getPassThreadCount(segments, 100000, 0));
+
+    // Too few entries to keep all threads busy.
+    EXPECT_EQ(1U, cleaner2.getPassThreadCount(segments, 1999, 0));
+    EXPECT_EQ(2U, cleaner2.getPassThreadCount(segments, 2000, 0));
+    EXPECT_EQ(4U, cleaner2.getPassThreadCount(segments, 100000, 0));
+
+    // Each extra thread must be paid for by a segment freed.
+    EXPECT_EQ(3U, cleaner2.getPassThreadCount(segments, 100000,
+        8 * segmentSize));
+    EXPECT_EQ(1U, cleaner2.getPassThreadCount(segments, 100000,
+        9 * segmentSize + 1));
+    EXPECT_EQ(1U, cleaner2.getPassThreadCount(segments, 100000,
+        10 * segmentSize));
+}
+
+TEST_F(LogCleanerTest, relocateLiveEntries_prefetch) {
+    LogSegment* s = segmentManager.allocHeadSegment();
+
+    LogSegmentVector segments;
+    segments.push_back(s);
+    LogCleaner::EntryVector entries;
+    LogCleanerMetrics::OnDisk<uint64_t> metrics;
+    cleaner.getSortedEntries(segments, entries, &metrics);
+    ASSERT_EQ(4U, entries.size());
+    entries.push_back(entries[0]);
+    entries.push_back(entries[1]);
+    Buffer buffer;
+    int firstType = downCast<int>(entries[0].reference.getEntry(
+        &segmentManager.getAllocator(), &buffer));
+    int secondType = downCast<int>(entries[1].reference.getEntry(
+        &segmentManager.getAllocator(), &buffer));
+
+    // Only entries at least RELOCATION_PREFETCH_DEPTH from the start are
+    // prefetched; the handler sees each of them once.
+    TestLog::Enable _("prefetchForRelocation", NULL);
+    LogSegmentVector survivors;
+    cleaner.relocateLiveEntries(entries.begin(), entries.end(), survivors,
+        &metrics);
+    EXPECT_EQ(format("prefetchForRelocation: type %d | "
+        "prefetchForRelocation: type %d", firstType, secondType),
+        TestLog::get());
+}
+
+TEST_F(LogCleanerTest, relocateLiveEntries_survivorAge) {
+    entryHandlers.attemptToRelocate = true;
+    LogSegment* s = segmentManager.allocHeadSegment();
+
+    LogSegmentVector segments;
+    segments.push_back(s);
+    LogCleaner::EntryVector entries;
+    LogCleanerMetrics::OnDisk<uint64_t> metrics;
+    cleaner.getSortedEntries(segments, entries, &metrics);
+    ASSERT_EQ(4U, entries.size());
+
+    // Survivors take on the age of their youngest entry.
+    WallTime::mockWallTimeValue = 1000;
+    entries[0].timestamp = 0;
+    entries[1].timestamp = 10;
+    entries[2].timestamp = 20;
+    entries[3].timestamp = 15;
+    LogSegmentVector survivors;
+    cleaner.relocateLiveEntries(entries.begin(), entries.end(), survivors,
+        &metrics);
+    ASSERT_EQ(1U, survivors.size());
+    EXPECT_EQ(20U, survivors[0]->creationTimestamp);
+
+    // Entries without timestamps don't make a survivor look older.
+    foreach (LogCleaner::Entry& entry, entries)
+        entry.timestamp = 0;
+    survivors.clear();
+    cleaner.relocateLiveEntries(entries.begin(), entries.end(), survivors,
+        &metrics);
+    ASSERT_EQ(1U, survivors.size());
+    EXPECT_EQ(1000U, survivors[0]->creationTimestamp);
+    WallTime::mockWallTimeValue = 0;
+}
+
+TEST_F(LogCleanerTest, relocateLiveEntriesInParallel) {
+    entryHandlers.attemptToRelocate = true;
+    LogSegment* s = segmentManager.allocHeadSegment();
+
+    LogSegmentVector segments;
+    segments.push_back(s);
+    LogCleaner::EntryVector entries;
+    LogCleanerMetrics::OnDisk<uint64_t> metrics;
+    cleaner.getSortedEntries(segments, entries, &metrics);
+    size_t numEntries = entries.size();
+    ASSERT_LE(2U, numEntries);
+
+    LogSegmentVector survivors;
+    TestLog::Enable _("relocateLiveEntriesInParallel", NULL);
+    uint64_t bytes = cleaner.relocateLiveEntriesInParallel(entries, 2,
+        survivors, &metrics);
+    EXPECT_EQ(format("relocateLiveEntriesInParallel: relocated %lu entries "
+        "using 2 threads", numEntries), TestLog::get());
+    EXPECT_EQ(2U, survivors.size());
+    uint64_t liveEntries = 0;
+    foreach (uint64_t count, metrics.totalLiveEntriesScanned)
+        liveEntries += count;
+    EXPECT_EQ(numEntries, liveEntries);
+    uint64_t survivorBytes = 0;
+    foreach (LogSegment* survivor, survivors)
+        survivorBytes += survivor->getAppendedLength();
+    EXPECT_GE(survivorBytes, bytes);
+    EXPECT_LT(0U, bytes);
+}
+
 // The tests below were disabled a long time ago by Steve Rumble and
 // never got reworked to reflect his changes, so they are currently
 // broken.
@@ -501,7 +708,8 @@ TEST_F(LogCleanerTest, relocateLiveEntries) {
 
     TestLog::Enable _;
     LogSegmentVector survivors;
-    uint64_t bytes = cleaner.relocateLiveEntries(entries, survivors);
+    uint64_t bytes = cleaner.relocateLiveEntries(entries.begin(),
+        entries.end(), survivors);
     EXPECT_EQ(
         "relocate: type 1, size 24 | "
         "alloc: purpose: 3 | "
@@ -623,6 +831,92 @@ TEST_F(LogCleanerTest, relocateEntry) {
 }
 #endif
 
+TEST_F(LogCleanerTest, Balancer_requestTask) {
+    ProtoBuf::LogMetrics_CleanerMetrics_BalancerMetrics m;
+    cleaner.balancer->requestTask(&threadState);
+    cleaner.balancer->getMetrics(m);
+    EXPECT_EQ(0U, m.disk_cleaning_tasks());
+    EXPECT_EQ(0U, m.compaction_tasks());
+    EXPECT_EQ(1U, m.sleep_tasks());
+    EXPECT_FALSE(m.has_wanted_threads());
+}
+
+TEST_F(LogCleanerTest, AdaptiveBalancer_sample) {
+    LogCleaner::AdaptiveBalancer balancer(&cleaner, 100.0);
+    Cycles::mockCyclesPerSec = 1e09;
+    Cycles::mockTscValue = 1000;
+    balancer.sample();
+    EXPECT_EQ(0U, balancer.wantedThreads);
+    EXPECT_EQ(0, balancer.appendBytesPerSecond);
+
+    // One second later: appends used a segment's worth of seglets while the
+    // compactor freed 1 MB in 0.1 seconds of work.
+    SegletAllocator& allocator = segmentManager.getAllocator();
+    uint64_t freeBefore = allocator.getFreeCount(SegletAllocator::DEFAULT);
+    segmentManager.allocHeadSegment();
+    uint64_t freeAfter = allocator.getFreeCount(SegletAllocator::DEFAULT);
+    ASSERT_GT(freeBefore, freeAfter);
+    cleaner.inMemoryMetrics.totalBytesFreed += 1024 * 1024;
+    cleaner.inMemoryMetrics.totalTicks += 100000000;
+
+    // Samples are rate-limited.
+    Cycles::mockTscValue += 1000;
+    balancer.sample();
+    EXPECT_EQ(0, balancer.appendBytesPerSecond);
+
+    Cycles::mockTscValue = 1000 + 1000000000;
+    balancer.sample();
+    double consumed = 1024 * 1024 + static_cast<double>(
+        (freeBefore - freeAfter) * serverConfig()->segletSize);
+    EXPECT_DOUBLE_EQ(consumed, balancer.appendBytesPerSecond);
+    EXPECT_DOUBLE_EQ(10 * 1024 * 1024, balancer.cleanerBytesPerSecond);
+    EXPECT_DOUBLE_EQ(1e08 / (1024 * 1024), balancer.compactionCyclesPerByte);
+    EXPECT_EQ(0, balancer.diskCyclesPerByte);
+    EXPECT_DOUBLE_EQ(static_cast<double>(freeAfter) *
+        serverConfig()->segletSize / consumed, balancer.headroomSeconds);
+
+    // Headroom is under the lead time, so cleaning should start (with no
+    // more threads than are configured).
+    EXPECT_LT(balancer.headroomSeconds, 100.0);
+    EXPECT_EQ(1U, balancer.wantedThreads);
+
+    ProtoBuf::LogMetrics_CleanerMetrics_BalancerMetrics m;
+    balancer.getMetrics(m);
+    EXPECT_EQ(1U, m.wanted_threads());
+    EXPECT_DOUBLE_EQ(consumed, m.append_bytes_per_second());
+
+    Cycles::mockTscValue = 0;
+    Cycles::mockCyclesPerSec = 0;
+}
+
+TEST_F(LogCleanerTest, AdaptiveBalancer_isMemoryLow) {
+    LogCleaner::AdaptiveBalancer balancer(&cleaner, 2.0);
+    Cycles::mockTscValue = 1000;
+    balancer.sample();
+    balancer.wantedThreads = 2;
+
+    SegmentManager::mockMemoryUtilization = 10;
+    threadState.threadNumber = 1;
+    EXPECT_TRUE(balancer.isMemoryLow(&threadState));
+    threadState.threadNumber = 2;
+    EXPECT_FALSE(balancer.isMemoryLow(&threadState));
+
+    // Too little to reclaim to bother cleaning early.
+    SegmentManager::mockMemoryUtilization = 4;
+    threadState.threadNumber = 0;
+    EXPECT_FALSE(balancer.isMemoryLow(&threadState));
+
+    // The first thread still falls back on the static thresholds.
+    balancer.wantedThreads = 0;
+    SegmentManager::mockMemoryUtilization = 95;
+    EXPECT_TRUE(balancer.isMemoryLow(&threadState));
+    threadState.threadNumber = 1;
+    EXPECT_FALSE(balancer.isMemoryLow(&threadState));
+
+    SegmentManager::mockMemoryUtilization = 0;
+    Cycles::mockTscValue = 0;
+}
+
 TEST_F(LogCleanerTest, Disabler_basics) {
     TestLog::Enable _;
     Tub<LogCleaner::Disabler> disabler1, disabler2;
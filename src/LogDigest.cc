@@ -19,15 +19,25 @@
 
 namespace RAMCloud {
 
+const uint32_t LogDigest::COMPACT_MIN_IDS;
+const uint64_t LogDigest::COMPACT_MARKER;
+
 /**
  * Create a new, empty log digest.
  */
 LogDigest::LogDigest()
     : header(),
       segmentIds(),
-      checksum()
+      checksum(),
+      compactHeader(),
+      compactIds(),
+      compactChecksum()
 {
     header.checksum = checksum.getResult();
+    compactIds.resize(sizeof(COMPACT_MARKER));
+    memcpy(&compactIds[0], &COMPACT_MARKER, sizeof(COMPACT_MARKER));
+    compactChecksum.update(&compactIds[0], sizeof(COMPACT_MARKER));
+    compactHeader.checksum = compactChecksum.getResult();
 }
 
 /**
@@ -35,35 +45,41 @@ LogDigest::LogDigest()
  * previously serialized digest if the checksum is valid.
  */
 LogDigest::LogDigest(const void* buffer, uint32_t length)
-    : header(),
-      segmentIds(),
-      checksum()
+    : LogDigest()
 {
-    Crc32C actualChecksum;
-
     if (length < sizeof(header)) {
         LOG(WARNING, "buffer too small to hold header (length = %u)", length);
         throw LogDigestException(HERE, "buffer too small to hold header");
     }
 
-    header = *reinterpret_cast<const Header*>(buffer);
+    Header expected = *reinterpret_cast<const Header*>(buffer);
 
-    length -= sizeof32(header);
-    if ((length % sizeof32(segmentIds.front())) != 0) {
-        LOG(WARNING, "length left not even 64-bit multiple (%u)", length);
-        throw LogDigestException(HERE, "length left not even 64-bit multiple");
-    }
-
-    const uint64_t* ids = reinterpret_cast<const uint64_t*>(
-        reinterpret_cast<const uint8_t*>(buffer) + sizeof(header));
-    for (uint32_t i = 0; i < length / sizeof32(segmentIds.front()); i++) {
-        actualChecksum.update(&ids[i], sizeof(ids[i]));
-        segmentIds.push_back(ids[i]);
+    length -= sizeof32(expected);
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(buffer) +
+            sizeof(expected);
+    Crc32C actualChecksum;
+    if (length >= sizeof(COMPACT_MARKER) &&
+            memcmp(data, &COMPACT_MARKER, sizeof(COMPACT_MARKER)) == 0) {
+        actualChecksum.update(data, length);
+        if (actualChecksum.getResult() == expected.checksum)
+            parseCompact(data, length);
+    } else {
+        if ((length % sizeof32(segmentIds.front())) != 0) {
+            LOG(WARNING, "length left not even 64-bit multiple (%u)", length);
+            throw LogDigestException(HERE,
+                    "length left not even 64-bit multiple");
+        }
+        const uint64_t* ids = reinterpret_cast<const uint64_t*>(data);
+        for (uint32_t i = 0; i < length / sizeof32(segmentIds.front());
+                i++) {
+            actualChecksum.update(&ids[i], sizeof(ids[i]));
+            addSegmentId(ids[i]);
+        }
     }
 
-    if (actualChecksum.getResult() != header.checksum) {
+    if (actualChecksum.getResult() != expected.checksum) {
         LOG(WARNING, "invalid digest checksum (computed 0x%08x, expect 0x%08x",
-            actualChecksum.getResult(), header.checksum);
+            actualChecksum.getResult(), expected.checksum);
         throw LogDigestException(HERE, "invalid digest checksum");
     }
 }
@@ -74,9 +90,23 @@ LogDigest::LogDigest(const void* buffer, uint32_t length)
 void
 LogDigest::addSegmentId(uint64_t id)
 {
+    uint64_t previous = segmentIds.empty() ? 0 : segmentIds.back();
     segmentIds.push_back(id);
     checksum.update(&segmentIds.back(), sizeof(segmentIds.back()));
     header.checksum = checksum.getResult();
+
+    int64_t delta = static_cast<int64_t>(id - previous);
+    uint64_t zigzag = (static_cast<uint64_t>(delta) << 1) ^
+            static_cast<uint64_t>(delta >> 63);
+    size_t start = compactIds.size();
+    while (zigzag >= 0x80) {
+        compactIds.push_back(static_cast<uint8_t>(zigzag | 0x80));
+        zigzag >>= 7;
+    }
+    compactIds.push_back(static_cast<uint8_t>(zigzag));
+    compactChecksum.update(&compactIds[start],
+            downCast<uint32_t>(compactIds.size() - start));
+    compactHeader.checksum = compactChecksum.getResult();
 }
 
 /**
@@ -108,9 +138,52 @@ LogDigest::operator[](size_t index) const
 void
 LogDigest::appendToBuffer(Buffer& buffer) const
 {
+    if (segmentIds.size() >= COMPACT_MIN_IDS) {
+        buffer.append(&compactHeader, sizeof(compactHeader));
+        buffer.append(&compactIds[0], downCast<uint32_t>(compactIds.size()));
+        return;
+    }
     buffer.append(&header, sizeof(header));
     buffer.append(&segmentIds.front(),
         downCast<uint32_t>(sizeof(segmentIds.front()) * segmentIds.size()));
 }
 
+/**
+ * Helper for the deserializing constructor: decode and add the ids in a
+ * digest serialized in compact form, whose checksum has been checked.
+ *
+ * \param data
+ *      The serialized digest, just after its header (so starting with
+ *      COMPACT_MARKER).
+ * \param length
+ *      Number of bytes at \a data.
+ * \throw LogDigestException
+ *      If the digest is corrupt.
+ */
+void
+LogDigest::parseCompact(const uint8_t* data, uint32_t length)
+{
+    uint64_t id = 0;
+    uint32_t offset = sizeof32(COMPACT_MARKER);
+    while (offset < length) {
+        uint64_t zigzag = 0;
+        int shift = 0;
+        while (true) {
+            if (offset == length || shift > 63) {
+                LOG(WARNING, "truncated compact digest (length = %u)", length);
+                throw LogDigestException(HERE, "truncated compact digest");
+            }
+            uint8_t byte = data[offset++];
+            zigzag |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            shift += 7;
+            if ((byte & 0x80) == 0)
+                break;
+        }
+        int64_t delta = static_cast<int64_t>(zigzag >> 1) ^
+                -static_cast<int64_t>(zigzag & 1);
+        id += static_cast<uint64_t>(delta);
+        addSegmentId(id);
+    }
+}
+
 } // namespace RAMCloud
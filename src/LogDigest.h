@@ -36,6 +36,13 @@ struct LogDigestException : public Exception {
  * only find copies of all segments referenced by the head's LogDigest. If it
  * finds them all (and they pass checksums), it knows it has the complete log.
  *
+ * A big master's log has many segments, and the digest is rewritten (and
+ * replicated) in full every time the log gets a new head, so digests with
+ * at least COMPACT_MIN_IDS ids are serialized in a compact form: each id is
+ * stored as a variable-length difference from the previous one, which
+ * takes one or two bytes rather than eight for a typical log. Smaller
+ * digests keep the original form (an array of 64-bit ids), and either form
+ * can be deserialized.
  */
 class LogDigest {
   public:
@@ -46,7 +53,12 @@ class LogDigest {
     uint64_t operator[](size_t index) const;
     void appendToBuffer(Buffer& buffer) const;
 
+    /// Digests with at least this many ids are serialized in compact form.
+    static const uint32_t COMPACT_MIN_IDS = 1024;
+
   PRIVATE:
+    void parseCompact(const uint8_t* data, uint32_t length);
+
     /**
      * When serialized in a buffer, the log digest starts with this header.
      */
@@ -64,6 +76,24 @@ class LogDigest {
     /// Current accumulated checksum. Updated each time a new segment id is
     /// added.
     Crc32C checksum;
+
+    /// In the compact form the header is followed by this value (which is
+    /// never a segment id) and then the encoded ids.
+    static const uint64_t COMPACT_MARKER = ~0UL;
+
+    /// Header for the compact form of the digest; the checksum covers
+    /// #compactIds.
+    Header compactHeader;
+
+    /// The compact form of #segmentIds, starting with COMPACT_MARKER: for
+    /// each id, the difference from the previous one (or from 0, for the
+    /// first) zigzag-encoded as a varint, 7 bits per byte in little-endian
+    /// order with the high bit set on all but the last byte. Kept up to date
+    /// as ids are added, so that appendToBuffer needn't copy anything.
+    vector<uint8_t> compactIds;
+
+    /// Checksum of #compactIds so far.
+    Crc32C compactChecksum;
 };
 
 } // namespace RAMCloud
@@ -101,6 +101,53 @@ TEST_F(LogDigestTest, construct_fromSerializedDigest_badChecksum)
         "expect 0xc59a146a", TestLog::get());
 }
 
+TEST_F(LogDigestTest, constructor_fromSerializedDigest_compact)
+{
+    LogDigest d;
+    for (uint64_t i = 0; i < LogDigest::COMPACT_MIN_IDS; i++)
+        d.addSegmentId((i % 3 == 0) ? 1000000 + i : 5000 - i);
+    Buffer buffer;
+    d.appendToBuffer(buffer);
+
+    LogDigest d2(buffer.getRange(0, buffer.size()), buffer.size());
+    EXPECT_EQ(d.segmentIds, d2.segmentIds);
+
+    // Deserialized digests serialize the same way again.
+    Buffer buffer2;
+    d2.appendToBuffer(buffer2);
+    EXPECT_EQ(TestUtil::toString(&buffer), TestUtil::toString(&buffer2));
+}
+
+TEST_F(LogDigestTest, constructor_fromSerializedDigest_compactBadChecksum)
+{
+    LogDigest d;
+    for (uint64_t i = 0; i < LogDigest::COMPACT_MIN_IDS; i++)
+        d.addSegmentId(i);
+    d.compactIds.back()++;
+    Buffer buffer;
+    d.appendToBuffer(buffer);
+
+    TestLog::Enable _;
+    EXPECT_THROW(LogDigest(buffer.getRange(0, buffer.size()),
+        buffer.size()), LogDigestException);
+    EXPECT_EQ(0U, TestLog::get().find(
+        "LogDigest: invalid digest checksum"));
+}
+
+TEST_F(LogDigestTest, parseCompact_truncated)
+{
+    LogDigest d;
+    uint8_t data[10];
+    memcpy(data, &LogDigest::COMPACT_MARKER, 8);
+    data[8] = 0x81;
+    data[9] = 0x80;
+
+    TestLog::Enable _;
+    EXPECT_THROW(d.parseCompact(data, 10), LogDigestException);
+    EXPECT_EQ("parseCompact: truncated compact digest (length = 10)",
+        TestLog::get());
+}
+
 TEST_F(LogDigestTest, addSegmentId_and_index_operator)
 {
     LogDigest d;
@@ -133,6 +180,14 @@ TEST_F(LogDigestTest, appendToBuffer)
         d3.appendToBuffer(buffer3);
         EXPECT_EQ(4U + (8 * (i + 1)), buffer3.size());
     }
+
+    // Big digests are compact: these ids take a byte each.
+    LogDigest d4;
+    for (uint32_t i = 0; i < LogDigest::COMPACT_MIN_IDS; i++)
+        d4.addSegmentId(i);
+    Buffer buffer4;
+    d4.appendToBuffer(buffer4);
+    EXPECT_EQ(4U + 8 + LogDigest::COMPACT_MIN_IDS, buffer4.size());
 }
 
 } // namespace RAMCloud
@@ -59,6 +59,15 @@ class LogEntryHandlers {
                           Buffer& oldBuffer,
                           AbstractLog::Reference oldReference,
                           LogEntryRelocator& relocator) = 0;
+
+    /**
+     * This method is called shortly before the given entry is passed to
+     * relocate(). Handlers may use it to prefetch whatever metadata they
+     * will need to decide whether the entry is still alive, so that the
+     * cleaner can overlap those cache misses across many entries. The
+     * default implementation does nothing.
+     */
+    virtual void prefetchForRelocation(LogEntryType type, Buffer& buffer) { }
 };
 
 } // namespace
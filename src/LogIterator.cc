@@ -37,12 +37,17 @@ namespace RAMCloud {
  *
  * \param log
  *      The log to iterate over.
+ * \param firstSegmentId
+ *      Segments with lower identifiers are skipped. This lets a caller that
+ *      already has everything up to some log position (which it got from
+ *      Log::getHead) visit just the entries added since; entries moved by
+ *      the cleaner are visited again, since their new segments are newer.
  */
-LogIterator::LogIterator(Log& log)
+LogIterator::LogIterator(Log& log, uint64_t firstSegmentId)
     : log(log),
       segmentList(),
       currentIterator(),
-      currentSegmentId(Segment::INVALID_SEGMENT_ID),
+      currentSegmentId(firstSegmentId - 1),
       lastSegment(NULL),
       lastSegmentLength(),
       done(false),
@@ -50,7 +50,7 @@ namespace RAMCloud {
  */
 class LogIterator {
   PUBLIC:
-    explicit LogIterator(Log& log);
+    explicit LogIterator(Log& log, uint64_t firstSegmentId = 0);
     ~LogIterator();
 
     void next();
@@ -107,6 +107,17 @@ TEST_F(LogIteratorTest, constructor_multiSegmentLog) {
     EXPECT_EQ(1U, i.currentSegmentId);
 }
 
+TEST_F(LogIteratorTest, constructor_firstSegmentId) {
+    l.sync();
+    while (l.head == NULL || l.head->id == 1)
+        l.append(LOG_ENTRY_TYPE_OBJ, data, sizeof(data));
+    l.sync();
+
+    LogIterator i(l, 2);
+    EXPECT_EQ(1U, i.segmentList.size());
+    EXPECT_EQ(2U, i.currentSegmentId);
+}
+
 TEST_F(LogIteratorTest, next_basics) {
     l.sync();
     LogIterator i(l);
@@ -170,6 +170,35 @@ LogMetricsStringer::getGenericCleanerMetrics()
             i++, d(ticks) / d(totalTicks) * 100);
     }
 
+    if (cleanerMetrics.has_balancer_metrics()) {
+        const ProtoBuf::LogMetrics_CleanerMetrics_BalancerMetrics& balancer =
+            cleanerMetrics.balancer_metrics();
+        s += ls + format("  Balancer Decisions:            %lu disk, "
+            "%lu compaction, %lu sleep\n",
+            balancer.disk_cleaning_tasks(),
+            balancer.compaction_tasks(),
+            balancer.sleep_tasks());
+        if (balancer.has_wanted_threads()) {
+            s += ls + format("    Append Rate:                 %.2f MB/s\n",
+                balancer.append_bytes_per_second() / 1024 / 1024);
+            s += ls + format("    Per-Thread Cleaner Rate:     %.2f MB/s\n",
+                balancer.cleaner_bytes_per_second() / 1024 / 1024);
+            s += ls + format("    Headroom:                    %.2f sec\n",
+                balancer.headroom_seconds());
+            s += ls + format("    Wanted Threads:              %u\n",
+                balancer.wanted_threads());
+        }
+    }
+
+    if (cleanerMetrics.has_cold_segments()) {
+        s += ls + format("  Cold Segments (>= %u sec):     %lu (%.2f MB, "
+            "%.2f MB live objects)\n",
+            cleanerMetrics.cold_segment_age_seconds(),
+            cleanerMetrics.cold_segments(),
+            d(cleanerMetrics.cold_segment_memory_bytes()) / 1024 / 1024,
+            d(cleanerMetrics.cold_live_object_bytes()) / 1024 / 1024);
+    }
+
     return s;
 }
 
@@ -201,6 +230,9 @@ LogMetricsStringer::getDiskCleanerMetrics()
     s += ls + format("  Memory Write Cost:             %.3f\n",
         d(memFreed + wrote) / d(memFreed));
 
+    s += ls + format("  Cycles / Disk Byte Freed:      %.2f\n",
+        d(onDiskMetrics.total_ticks()) / d(diskFreed));
+
     uint64_t totalRuns = onDiskMetrics.total_runs();
     uint64_t totalLowDiskRuns = onDiskMetrics.total_low_disk_space_runs();
     s += ls + format("  Total Runs:                    %lu  (%lu / %.3f%% due "
@@ -539,6 +571,20 @@ LogMetricsStringer::getLogMetrics()
         onDisk,
         100 * static_cast<double>(onDisk) / static_cast<double>(logSegments));
 
+    const ProtoBuf::LogMetrics_SegletMetrics& segletMetrics =
+        logMetrics->seglet_metrics();
+    if (segletMetrics.has_segment_seglet_utilization_histogram()) {
+        Histogram segletUtilization(
+            segletMetrics.segment_seglet_utilization_histogram());
+        s += ls + format("  Avg Seglet Utilization:        %lu%%\n",
+            segletUtilization.getAverage());
+        s += ls + format("    Reclaimable Seglets:         %lu "
+            "(%.2f%% of usable)\n",
+            segletMetrics.reclaimable_seglets(),
+            100 * d(segletMetrics.reclaimable_seglets()) /
+              d(segletMetrics.total_usable_seglets()));
+    }
+
     return s;
 }
 
@@ -40,6 +40,16 @@ namespace RAMCloud {
  * finish. This "waiting" allows read operations to safely de-reference
  * log references to the old segment which was obtained before log cleaning.
  *
+ * Only activities on this server can be tracked this way. In particular,
+ * log memory must not be exposed for one-sided access (e.g. RDMA reads by
+ * clients that bypass the master's CPU): a remote reader has no epoch, so
+ * the cleaner could free and reuse a seglet in the middle of the read.
+ * Validating the object's checksum afterwards would not be enough either,
+ * because a reused seglet can hold a different, equally valid object
+ * at the same offset. A safe one-sided path would need remote readers to
+ * register epochs with the master, which defeats its purpose; reads must
+ * go through MasterService.
+ *
  * This class is a wrapper for other classes related to the log protection
  * mechanism. It has static members only to track global state.
  */
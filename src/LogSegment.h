@@ -84,6 +84,7 @@ class LogSegment : public Segment {
           segmentSize(segmentSize),
           creationTimestamp(creationTimestamp),
           isEmergencyHead(isEmergencyHead),
+          onFlash(false),
           cleanedEpoch(0),
           cachedCleaningCostBenefitScore(0),
           cachedCompactionCostBenefitScore(0),
@@ -231,8 +232,11 @@ class LogSegment : public Segment {
 
     /// Timestamp of this segment's creation in seconds (via WallTime::). Used
     /// by the cleaner when selecting segments to clean (as part of the cost-
-    /// benefit formula).
-    const uint32_t creationTimestamp;
+    /// benefit formula). Survivors of disk cleaning instead carry the
+    /// timestamp of the youngest entry relocated into them (see
+    /// LogCleaner::setSurvivorAge), which is set before they become
+    /// cleanable.
+    uint32_t creationTimestamp;
 
     /// If true, this segment is one of two special emergency heads the system
     /// reserves so that it can always open a new log head even if out of
@@ -247,6 +251,12 @@ class LogSegment : public Segment {
     /// that is expected to live longer.
     const bool isEmergencyHead;
 
+    /// If true, this segment's seglets are on the flash tier (see
+    /// SegletAllocator). Such segments are cold survivors written by the
+    /// cleaner and are never cleaned themselves. Set by SegmentManager when
+    /// the segment is allocated.
+    bool onFlash;
+
     /// The epoch value when cleaning was completed on this segment. Once no
     /// more RPCs in the system exist with epochs less than or equal to this,
     /// there can be no more outstanding references into the segment and its
@@ -301,8 +311,9 @@ class LogSegment : public Segment {
     /// when the desired data has already been synced (perhaps by another thread
     /// that bundled our replication traffic with theirs). The point is to allow
     /// batching of objects during backup writes when there are multiple threads
-    /// appending to the log.
-    uint32_t syncedLength;
+    /// appending to the log. Writers waiting in Log::sync poll this without
+    /// holding any lock.
+    std::atomic<uint32_t> syncedLength;
 
     /// Timestamp when this segment was last compacted or created. Used by the
     /// cleaner to decide when to scan for dead tombstones. Sometimes segments
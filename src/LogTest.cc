@@ -20,6 +20,7 @@
 #include "Log.h"
 #include "LogEntryTypes.h"
 #include "Memory.h"
+#include "PerfStats.h"
 #include "ServerConfig.h"
 #include "StringUtil.h"
 #include "Transport.h"
@@ -147,11 +148,11 @@ TEST_F(LogTest, sync) {
 
     TestLog::reset();
     l.append(LOG_ENTRY_TYPE_OBJ, "hi", 2);
-    EXPECT_NE(l.head->syncedLength, l.head->getAppendedLength());
+    EXPECT_NE(l.head->syncedLength.load(), l.head->getAppendedLength());
     l.sync();
     EXPECT_EQ("sync: syncing segment 1 to offset 84 | sync: log synced",
         TestLog::get());
-    EXPECT_EQ(l.head->syncedLength, l.head->getAppendedLength());
+    EXPECT_EQ(l.head->syncedLength.load(), l.head->getAppendedLength());
 
     TestLog::reset();
     l.sync();
@@ -161,6 +162,67 @@ TEST_F(LogTest, sync) {
     EXPECT_EQ(4U, l.metrics.totalSyncCalls);
 }
 
+TEST_F(LogTest, sync_groupCommitStats) {
+    PerfStats before = PerfStats::threadStats;
+    l.append(LOG_ENTRY_TYPE_OBJ, "hi", 2);
+    l.sync();
+    EXPECT_EQ(1U, PerfStats::threadStats.logSyncBatches -
+            before.logSyncBatches);
+    EXPECT_EQ(1U, PerfStats::threadStats.logSyncBatchWriters -
+            before.logSyncBatchWriters);
+    EXPECT_EQ(1U, PerfStats::threadStats.logSyncBatchSizes[0] -
+            before.logSyncBatchSizes[0]);
+    EXPECT_EQ(0, l.syncWaiters.load());
+
+    // A sync with nothing to do still counts towards the latency histogram,
+    // but not towards the batches.
+    l.sync();
+    EXPECT_EQ(1U, PerfStats::threadStats.logSyncBatches -
+            before.logSyncBatches);
+    uint64_t syncs = 0;
+    for (int b = 0; b < PerfStats::HISTOGRAM_BUCKETS; b++) {
+        syncs += PerfStats::threadStats.logSyncMicros[b] -
+                before.logSyncMicros[b];
+    }
+    EXPECT_EQ(2U, syncs);
+}
+
+TEST_F(LogTest, sync_batchWindow) {
+    l.syncBatchCycles = Cycles::fromMicroseconds(200);
+    l.append(LOG_ENTRY_TYPE_OBJ, "hi", 2);
+    uint64_t start = Cycles::rdtsc();
+    l.sync();
+    EXPECT_LE(200U, Cycles::toMicroseconds(Cycles::rdtsc() - start));
+    EXPECT_EQ(l.head->syncedLength.load(), l.head->getAppendedLength());
+
+    // No waiting if there is nothing to sync.
+    start = Cycles::rdtsc();
+    l.sync();
+    EXPECT_GT(200U, Cycles::toMicroseconds(Cycles::rdtsc() - start));
+}
+
+TEST_F(LogTest, syncAsync) {
+    l.append(LOG_ENTRY_TYPE_OBJ, "hi", 2);
+    Log::SyncPoint point = l.syncAsync();
+    EXPECT_EQ(l.head, point.segment);
+    EXPECT_EQ(l.head->getAppendedLength(), point.length);
+    EXPECT_GT(point.length, l.head->syncedLength.load());
+    EXPECT_EQ(point.length, l.head->replicatedSegment->queued.bytes);
+}
+
+TEST_F(LogTest, isSynced) {
+    // There are no replicas here, so queued data is durable at once.
+    l.append(LOG_ENTRY_TYPE_OBJ, "hi", 2);
+    Log::SyncPoint point = l.syncAsync();
+    EXPECT_TRUE(l.isSynced(point));
+
+    l.append(LOG_ENTRY_TYPE_OBJ, "there", 5);
+    Log::SyncPoint later(l.head, l.head->getAppendedLength());
+    EXPECT_FALSE(l.isSynced(later));
+    l.sync();
+    EXPECT_TRUE(l.isSynced(later));
+}
+
 TEST_F(LogTest, rollHeadOver) {
     LogPosition oldPos = LogPosition(0, 0);
     LogSegment* oldHead = l.head;
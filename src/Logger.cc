@@ -411,19 +411,19 @@ Logger::logMessage(bool collapse, LogModule module, LogLevel level,
         now = *testingLogTime;
     }
 #endif
-    Lock lock(mutex);
+    auto messageId = std::make_pair(where.file, where.line);
 
-    // See if this log message should be collapsed away entirely.
-    SkipInfo* skip = NULL;
+    // See if this log message should be collapsed away entirely. This is
+    // the only work done under the lock before the message is formatted.
     int skipCount = 0;
     if (collapse) {
-        auto messageId = std::make_pair(where.file, where.line);
+        Lock lock(mutex);
         CollapseMap::iterator iter = collapseMap.find(messageId);
         if (iter != collapseMap.end()) {
             // We have printed this message before; if it was recent,
             // don't print the current message, but keep track of the fact
             // that we skipped it.
-            skip = &iter->second;
+            SkipInfo* skip = &iter->second;
             if (Util::timespecLess(now, skip->nextPrintTime)) {
                 skip->skipCount++;
                 return;
@@ -432,17 +432,13 @@ Logger::logMessage(bool collapse, LogModule module, LogLevel level,
             // We've printed this message before, but it was a while ago,
             // so print the message again.
             skipCount = skip->skipCount;
-        } else {
-            // Initialize a new entry in the map.
-            if (collapseMap.size() >= maxCollapseMapSize) {
-                // The map has gotten too large; just delete an entry
-                // at random.
-                collapseMap.erase(collapseMap.begin());
-            }
-            skip = &collapseMap[messageId];
         }
     }
 
+    // The message is formatted in this thread's own buffer without holding
+    // the lock, so threads that log at the same time (during a burst of
+    // errors, for example) don't wait for each other's formatting: only
+    // copying finished messages into messageBuffer is serialized.
 #define MAX_MESSAGE_CHARS 2000
     // Extra space for a message about truncated characters, if needed.
 #define TRUNC_MESSAGE_SPACE 50
@@ -455,15 +451,17 @@ Logger::logMessage(bool collapse, LogModule module, LogLevel level,
     int charsWritten = 0;
     int actual;
 
-    // Generate a message about discarded entries, if relevant.
-    if (discardedEntries > 0) {
+    // Generate a message about discarded entries, if relevant. Taking the
+    // count makes this thread responsible for reporting those entries.
+    int discarded = discardedEntries.exchange(0);
+    if (discarded > 0) {
         CodeLocation here = HERE;
         actual = snprintf(buffer, spaceLeft,
                 "%010lu.%09lu %s:%d in %s %s[%d]: %d log messages "
                 "lost because of buffer overflow\n",
                 now.tv_sec, now.tv_nsec, here.baseFileName(),
                 here.line, here.function, logLevelNames[WARNING],
-                ThreadId::get(), discardedEntries);
+                ThreadId::get(), discarded);
         if (actual >= spaceLeft) {
             // We ran out of space in the buffer (should never happen here).
             charsLost += 1 + actual - spaceLeft;
@@ -520,10 +518,11 @@ Logger::logMessage(bool collapse, LogModule module, LogLevel level,
                 "... (%d chars truncated)\n", charsLost);
     }
 
-    if (addToBuffer(buffer, charsWritten)) {
-        discardedEntries = 0;
-    } else {
-        discardedEntries++;
+    Lock lock(mutex);
+    if (!addToBuffer(buffer, charsWritten)) {
+        // This entry is lost too, and the ones it would have reported are
+        // still unreported.
+        discardedEntries += discarded + 1;
     }
 
     if (collapse) {
@@ -531,6 +530,19 @@ Logger::logMessage(bool collapse, LogModule module, LogLevel level,
         // collapsible message (either it's new or  we haven't printed it in
         // a while). Save information so we don't print this message again
         // for a while.
+        SkipInfo* skip;
+        CollapseMap::iterator iter = collapseMap.find(messageId);
+        if (iter != collapseMap.end()) {
+            skip = &iter->second;
+        } else {
+            // Initialize a new entry in the map.
+            if (collapseMap.size() >= maxCollapseMapSize) {
+                // The map has gotten too large; just delete an entry
+                // at random.
+                collapseMap.erase(collapseMap.begin());
+            }
+            skip = &collapseMap[messageId];
+        }
         if (skip->message.empty()) {
             skip->message.assign(buffer, charsWritten);
         }
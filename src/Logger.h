@@ -16,6 +16,7 @@
 #ifndef RAMCLOUD_LOGGER_H
 #define RAMCLOUD_LOGGER_H
 
+#include <atomic>
 #include <condition_variable>
 #include <thread>
 #include <time.h>
@@ -278,9 +279,10 @@ class Logger {
     /**
      * Nonzero means that the most recently generated log entries had to be
      * discarded because we ran out of buffer space (the print thread got
-     * behind). The value indicates how many entries were lost.
+     * behind). The value indicates how many entries were lost. Atomic
+     * because logMessage reads it before acquiring #mutex.
      */
-    int discardedEntries;
+    std::atomic<int> discardedEntries;
 
     /**
      * This thread is responsible for invoking the (potentially blocking)
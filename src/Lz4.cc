@@ -0,0 +1,237 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "Lz4.h"
+
+namespace RAMCloud {
+
+namespace {
+
+/// Load 4 possibly unaligned bytes.
+inline uint32_t
+read32(const uint8_t* p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+/**
+ * Append an LZ4 length extension: the part of \a length that didn't fit
+ * in the token's nibble, as a run of 255s and a final byte less than 255.
+ * The caller must have checked that there is room.
+ */
+inline uint8_t*
+writeLengthExtension(uint8_t* out, uint32_t length)
+{
+    while (length >= 255) {
+        *out++ = 255;
+        length -= 255;
+    }
+    *out++ = static_cast<uint8_t>(length);
+    return out;
+}
+
+/**
+ * Read an LZ4 length extension and add it to \a length.
+ *
+ * \return
+ *      False if the input ran out or the length exceeds \a limit.
+ */
+inline bool
+readLengthExtension(const uint8_t*& in, const uint8_t* inEnd,
+                    size_t& length, size_t limit)
+{
+    uint8_t byte;
+    do {
+        if (in == inEnd)
+            return false;
+        byte = *in++;
+        length += byte;
+        if (length > limit)
+            return false;
+    } while (byte == 255);
+    return true;
+}
+
+} // anonymous namespace
+
+/**
+ * Compress a block of data.
+ *
+ * \param source
+ *      The data to compress.
+ * \param length
+ *      Number of bytes in \a source.
+ * \param destination
+ *      Where to place the compressed data.
+ * \param capacity
+ *      Size of \a destination; compressBound(length) is always enough.
+ * \return
+ *      The number of bytes of compressed data in \a destination, or 0 if
+ *      it didn't fit in \a capacity (callers commonly pass a capacity
+ *      smaller than \a length to compress only when it pays off).
+ */
+uint32_t
+Lz4::compress(const void* source, uint32_t length,
+              void* destination, uint32_t capacity)
+{
+    const uint8_t* in = static_cast<const uint8_t*>(source);
+    uint8_t* out = static_cast<uint8_t*>(destination);
+    uint8_t* outEnd = out + capacity;
+
+    // Positions of recent 4-byte sequences, indexed by hash. Entries are
+    // only hints; a candidate is compared before it is used.
+    uint32_t table[1 << HASH_BITS];
+    memset(table, 0, sizeof(table));
+
+    uint32_t anchor = 0;        // Start of literals not yet emitted.
+    uint32_t pos = 0;
+    if (length > MATCH_LIMIT) {
+        uint32_t matchStartLimit = length - MATCH_LIMIT;
+        uint32_t matchEndLimit = length - LAST_LITERALS;
+        while (pos < matchStartLimit) {
+            uint32_t sequence = read32(in + pos);
+            uint32_t hash = (sequence * 2654435761U) >> (32 - HASH_BITS);
+            uint32_t candidate = table[hash];
+            table[hash] = pos;
+            if (candidate >= pos || pos - candidate > MAX_OFFSET ||
+                    read32(in + candidate) != sequence) {
+                // Skip ahead faster the longer it has been since the last
+                // match, so incompressible data doesn't cost much.
+                pos += 1 + ((pos - anchor) >> 6);
+                continue;
+            }
+
+            uint32_t matchLength = MIN_MATCH;
+            while (pos + matchLength < matchEndLimit &&
+                   in[candidate + matchLength] == in[pos + matchLength]) {
+                matchLength++;
+            }
+
+            // Token, literal length, literals, offset, match length.
+            uint32_t literals = pos - anchor;
+            if (static_cast<size_t>(outEnd - out) <
+                    1 + literals / 255 + 1 + literals + 2 +
+                    matchLength / 255 + 1) {
+                return 0;
+            }
+            uint8_t* token = out++;
+            uint32_t extraMatch = matchLength - MIN_MATCH;
+            *token = static_cast<uint8_t>(
+                    (std::min(literals, 15U) << 4) | std::min(extraMatch, 15U));
+            if (literals >= 15)
+                out = writeLengthExtension(out, literals - 15);
+            memcpy(out, in + anchor, literals);
+            out += literals;
+            uint32_t offset = pos - candidate;
+            *out++ = static_cast<uint8_t>(offset);
+            *out++ = static_cast<uint8_t>(offset >> 8);
+            if (extraMatch >= 15)
+                out = writeLengthExtension(out, extraMatch - 15);
+
+            pos += matchLength;
+            anchor = pos;
+        }
+    }
+
+    // The last sequence is literals only.
+    uint32_t literals = length - anchor;
+    if (static_cast<size_t>(outEnd - out) < 1 + literals / 255 + 1 + literals)
+        return 0;
+    *out++ = static_cast<uint8_t>(std::min(literals, 15U) << 4);
+    if (literals >= 15)
+        out = writeLengthExtension(out, literals - 15);
+    memcpy(out, in + anchor, literals);
+    out += literals;
+    return downCast<uint32_t>(out - static_cast<uint8_t*>(destination));
+}
+
+/**
+ * Decompress a block produced by compress(). The input is treated as
+ * untrusted: malformed data never causes accesses outside the given
+ * buffers.
+ *
+ * \param source
+ *      The compressed data.
+ * \param length
+ *      Number of bytes in \a source.
+ * \param destination
+ *      Where to place the decompressed data.
+ * \param decompressedLength
+ *      Size of \a destination; the data must decompress to exactly this
+ *      many bytes.
+ * \return
+ *      True on success; false if the data is malformed or doesn't
+ *      decompress to exactly \a decompressedLength bytes.
+ */
+bool
+Lz4::decompress(const void* source, uint32_t length,
+                void* destination, uint32_t decompressedLength)
+{
+    const uint8_t* in = static_cast<const uint8_t*>(source);
+    const uint8_t* inEnd = in + length;
+    uint8_t* outStart = static_cast<uint8_t*>(destination);
+    uint8_t* out = outStart;
+    uint8_t* outEnd = out + decompressedLength;
+
+    while (in < inEnd) {
+        uint8_t token = *in++;
+
+        size_t literals = token >> 4;
+        if (literals == 15 &&
+                !readLengthExtension(in, inEnd, literals, length)) {
+            return false;
+        }
+        if (literals > static_cast<size_t>(inEnd - in) ||
+                literals > static_cast<size_t>(outEnd - out)) {
+            return false;
+        }
+        memcpy(out, in, literals);
+        in += literals;
+        out += literals;
+        if (in == inEnd)
+            break;              // Last sequence has no match.
+
+        if (inEnd - in < 2)
+            return false;
+        size_t offset = in[0] | (in[1] << 8);
+        in += 2;
+        if (offset == 0 || offset > static_cast<size_t>(out - outStart))
+            return false;
+
+        size_t matchLength = token & 15;
+        if (matchLength == 15 &&
+                !readLengthExtension(in, inEnd, matchLength,
+                                     decompressedLength)) {
+            return false;
+        }
+        matchLength += MIN_MATCH;
+        if (matchLength > static_cast<size_t>(outEnd - out))
+            return false;
+        const uint8_t* match = out - offset;
+        if (offset >= matchLength) {
+            memcpy(out, match, matchLength);
+            out += matchLength;
+        } else {
+            // Overlapping copy: repeats the last offset bytes.
+            for (size_t i = 0; i < matchLength; i++)
+                *out++ = *match++;
+        }
+    }
+    return out == outEnd;
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,71 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_LZ4_H
+#define RAMCLOUD_LZ4_H
+
+#include "Common.h"
+
+namespace RAMCloud {
+
+/**
+ * A fast, single-pass compressor producing the LZ4 block format, used to
+ * shrink replication traffic between masters and backups. It trades
+ * compression ratio for speed: a match is found with one lookup in a small
+ * hash table of recent 4-byte sequences, so compression runs at several
+ * hundred MB/s per core and decompression is essentially a sequence of
+ * memcpys.
+ *
+ * The class contains only static methods, so you shouldn't ever need to
+ * instantiate an object.
+ */
+class Lz4 {
+  PUBLIC:
+    /**
+     * Return the largest size that compressing \a length bytes can
+     * produce (incompressible data grows slightly).
+     */
+    static uint32_t compressBound(uint32_t length)
+    {
+        return length + length / 255 + 16;
+    }
+
+    static uint32_t compress(const void* source, uint32_t length,
+                             void* destination, uint32_t capacity);
+    static bool decompress(const void* source, uint32_t length,
+                           void* destination, uint32_t decompressedLength);
+
+  PRIVATE:
+    /// Matches are at least this long; shorter ones aren't worth encoding.
+    enum { MIN_MATCH = 4 };
+
+    /// The final LAST_LITERALS bytes of the input are always literals.
+    enum { LAST_LITERALS = 5 };
+
+    /// No match may start within the final MATCH_LIMIT bytes of the input.
+    enum { MATCH_LIMIT = 12 };
+
+    /// Largest distance back that a match can refer to.
+    enum { MAX_OFFSET = 65535 };
+
+    /// log2 of the number of entries in the compressor's hash table.
+    enum { HASH_BITS = 12 };
+
+    Lz4();
+};
+
+} // namespace RAMCloud
+
+#endif  // RAMCLOUD_LZ4_H
@@ -0,0 +1,117 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "Lz4.h"
+
+namespace RAMCloud {
+
+class Lz4Test : public ::testing::Test {
+  public:
+    string json;
+    std::vector<char> compressed;
+    std::vector<char> decompressed;
+
+    Lz4Test()
+        : json()
+        , compressed()
+        , decompressed()
+    {
+        for (int i = 0; i < 100; i++) {
+            json += format("{\"id\": %d, \"name\": \"user%d\", "
+                           "\"city\": \"Palo Alto\"}\n", i, i);
+        }
+        compressed.resize(Lz4::compressBound(size()));
+        decompressed.resize(size());
+    }
+
+    uint32_t size() { return downCast<uint32_t>(json.size()); }
+
+    uint32_t
+    compress()
+    {
+        return Lz4::compress(json.data(), size(), compressed.data(),
+                             downCast<uint32_t>(compressed.size()));
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(Lz4Test);
+};
+
+TEST_F(Lz4Test, roundTrip) {
+    uint32_t length = compress();
+    EXPECT_LT(length, size() / 2);
+    EXPECT_TRUE(Lz4::decompress(compressed.data(), length,
+                                decompressed.data(), size()));
+    EXPECT_EQ(json, string(decompressed.data(), decompressed.size()));
+}
+
+TEST_F(Lz4Test, roundTrip_short) {
+    // Too short for any matches: a single literal run.
+    json = "abc";
+    uint32_t length = compress();
+    EXPECT_EQ(4U, length);
+    EXPECT_EQ(0x30, compressed[0]);
+    EXPECT_TRUE(Lz4::decompress(compressed.data(), length,
+                                decompressed.data(), 3));
+    EXPECT_EQ("abc", string(decompressed.data(), 3));
+
+    json = "";
+    EXPECT_EQ(1U, compress());
+    EXPECT_TRUE(Lz4::decompress(compressed.data(), 1, NULL, 0));
+}
+
+TEST_F(Lz4Test, roundTrip_longRuns) {
+    // Runs long enough to need length extensions for both literals and
+    // matches.
+    json.clear();
+    for (int i = 0; i < 600; i++)
+        json += static_cast<char>('a' + (i * 7919) % 26);
+    json += string(2000, 'x');
+    compressed.resize(Lz4::compressBound(size()));
+    decompressed.resize(size());
+    uint32_t length = compress();
+    EXPECT_TRUE(Lz4::decompress(compressed.data(), length,
+                                decompressed.data(), size()));
+    EXPECT_EQ(json, string(decompressed.data(), decompressed.size()));
+}
+
+TEST_F(Lz4Test, compress_noRoom) {
+    EXPECT_EQ(0U, Lz4::compress(json.data(), size(), compressed.data(), 10));
+}
+
+TEST_F(Lz4Test, decompress_wrongLength) {
+    uint32_t length = compress();
+    EXPECT_FALSE(Lz4::decompress(compressed.data(), length,
+                                 decompressed.data(), size() - 1));
+    decompressed.resize(size() + 1);
+    EXPECT_FALSE(Lz4::decompress(compressed.data(), length,
+                                 decompressed.data(), size() + 1));
+}
+
+TEST_F(Lz4Test, decompress_truncated) {
+    uint32_t length = compress();
+    for (uint32_t i = 0; i < length; i++) {
+        EXPECT_FALSE(Lz4::decompress(compressed.data(), i,
+                                     decompressed.data(), size()));
+    }
+}
+
+TEST_F(Lz4Test, decompress_badOffset) {
+    // Token with no literals and a match at offset 1 before any output.
+    const char bad[] = {0x00, 0x01, 0x00};
+    EXPECT_FALSE(Lz4::decompress(bad, 3, decompressed.data(), 4));
+}
+
+}  // namespace RAMCloud
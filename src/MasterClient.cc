@@ -17,6 +17,7 @@
 #include "TransportManager.h"
 #include "ProtoBuf.h"
 #include "Log.h"
+#include "ObjectFinder.h"
 #include "Segment.h"
 #include "Object.h"
 #include "Status.h"
@@ -27,6 +28,136 @@ namespace RAMCloud {
 // Default RejectRules to use if none are provided by the caller.
 RejectRules defaultRejectRules;
 
+/**
+ * Ask a master whether a backup still needs to keep some of the master's
+ * replicas; this is the batched form of #isReplicaNeeded, used when a
+ * backup garbage collects the many replicas it found on storage when it
+ * started.
+ *
+ * \param context
+ *      Overall information about this RAMCloud server or client.
+ * \param serverId
+ *      Identifier for the target server.
+ * \param backupServerId
+ *      The server id which is requesting information about the replicas
+ *      (see #isReplicaNeeded).
+ * \param segmentIds
+ *      The segmentIds of the replicas which a backup server is considering
+ *      freeing.
+ * \param count
+ *      Number of entries in \a segmentIds.
+ * \param[out] needed
+ *      Filled in with \a count entries, one for each of \a segmentIds: true
+ *      means that the calling backup must continue to retain the replica,
+ *      false means that it can reclaim the replica's space.
+ */
+void
+MasterClient::areReplicasNeeded(Context* context, ServerId serverId,
+        ServerId backupServerId, const uint64_t* segmentIds, uint32_t count,
+        bool* needed)
+{
+    AreReplicasNeededRpc rpc(context, serverId, backupServerId, segmentIds,
+            count);
+    rpc.wait(needed);
+}
+
+/**
+ * Constructor for AreReplicasNeededRpc: initiates an RPC in the same way as
+ * #MasterClient::areReplicasNeeded, but returns once the RPC has been
+ * initiated, without waiting for it to complete.
+ *
+ * \param context
+ *      Overall information about this RAMCloud server or client.
+ * \param serverId
+ *      Identifier for the target server.
+ * \param backupServerId
+ *      The server id which is requesting information about the replicas
+ *      (see #MasterClient::isReplicaNeeded).
+ * \param segmentIds
+ *      The segmentIds of the replicas which a backup server is considering
+ *      freeing.
+ * \param count
+ *      Number of entries in \a segmentIds.
+ */
+AreReplicasNeededRpc::AreReplicasNeededRpc(Context* context,
+        ServerId serverId, ServerId backupServerId,
+        const uint64_t* segmentIds, uint32_t count)
+    : ServerIdRpcWrapper(context, serverId,
+            sizeof(WireFormat::AreReplicasNeeded::Response))
+    , count(count)
+{
+    WireFormat::AreReplicasNeeded::Request* reqHdr(
+            allocHeader<WireFormat::AreReplicasNeeded>(serverId));
+    reqHdr->backupServerId = backupServerId.getId();
+    reqHdr->segmentIdCount = count;
+    request.appendCopy(segmentIds, count * sizeof32(uint64_t));
+    send();
+}
+
+/**
+ * Wait for an areReplicasNeeded RPC to complete.
+ *
+ * \param[out] needed
+ *      Filled in with one entry for each segment id in the request (see
+ *      #MasterClient::areReplicasNeeded).
+ *
+ * \throw ServerNotUpException
+ *      The target server for this RPC is not part of the cluster;
+ *      if it ever existed, it has since crashed.
+ */
+void
+AreReplicasNeededRpc::wait(bool* needed)
+{
+    waitAndCheckErrors();
+    const uint8_t* flags = static_cast<const uint8_t*>(response->getRange(
+            sizeof32(WireFormat::AreReplicasNeeded::Response), count));
+    if (count != 0 && flags == NULL)
+        throw ResponseFormatError(HERE);
+    for (uint32_t i = 0; i < count; i++)
+        needed[i] = flags[i] != 0;
+}
+
+/**
+ * Ask a master to add index entries, in a newly created index, for all of
+ * the objects it stores in the table. The master replies right away and
+ * builds the entries in the background.
+ *
+ * \param context
+ *      Overall information about this RAMCloud server or client.
+ * \param serverId
+ *      Identifier for the target server.
+ * \param tableId
+ *      Identifier for the table whose objects are to be indexed.
+ * \param indexId
+ *      Identifier for the new index.
+ */
+void
+MasterClient::buildIndex(Context* context, ServerId serverId,
+        uint64_t tableId, uint8_t indexId)
+{
+    BuildIndexRpc rpc(context, serverId, tableId, indexId);
+    rpc.wait();
+}
+
+/**
+ * Constructor for BuildIndexRpc: initiates an RPC in the same way as
+ * #MasterClient::buildIndex, but returns once the RPC has been initiated,
+ * without waiting for it to complete.
+ *
+ * \copydetails MasterClient::buildIndex
+ */
+BuildIndexRpc::BuildIndexRpc(Context* context, ServerId serverId,
+        uint64_t tableId, uint8_t indexId)
+    : ServerIdRpcWrapper(context, serverId,
+            sizeof(WireFormat::BuildIndex::Response))
+{
+    WireFormat::BuildIndex::Request* reqHdr(
+            allocHeader<WireFormat::BuildIndex>(serverId));
+    reqHdr->tableId = tableId;
+    reqHdr->indexId = indexId;
+    send();
+}
+
 /**
  * Instruct the master that it must no longer serve requests for the indexlet
  * specified. The server may reclaim all memory previously allocated to that
@@ -380,6 +511,184 @@ IsReplicaNeededRpc::wait()
     return respHdr->needed;
 }
 
+/**
+ * Ask a master to migrate part or all of one of its tablets to another
+ * master. This is the same operation as RamCloud::migrateTablet, except
+ * that the RPC is addressed to a specific master rather than to whichever
+ * master a client believes owns the tablet; the coordinator uses it to
+ * rebalance load.
+ *
+ * \param context
+ *      Overall information about this RAMCloud server or client.
+ * \param serverId
+ *      Identifier for the master that currently owns the tablet.
+ * \param tableId
+ *      Identifier for the table.
+ * \param firstKeyHash
+ *      Lowest key hash in the range to be migrated; the range must lie
+ *      within a single tablet owned by \a serverId.
+ * \param lastKeyHash
+ *      Highest key hash in the range to be migrated.
+ * \param newOwnerId
+ *      Identifier for the master that will own the range once migration
+ *      completes.
+ */
+void
+MasterClient::migrateMasterTablet(Context* context, ServerId serverId,
+        uint64_t tableId, uint64_t firstKeyHash, uint64_t lastKeyHash,
+        ServerId newOwnerId)
+{
+    MigrateMasterTabletRpc rpc(context, serverId, tableId, firstKeyHash,
+            lastKeyHash, newOwnerId);
+    rpc.wait();
+}
+
+/**
+ * Constructor for MigrateMasterTabletRpc: initiates an RPC in the same way
+ * as #MasterClient::migrateMasterTablet, but returns once the RPC has been
+ * initiated, without waiting for it to complete.
+ *
+ * \param context
+ *      Overall information about this RAMCloud server or client.
+ * \param serverId
+ *      Identifier for the master that currently owns the tablet.
+ * \param tableId
+ *      Identifier for the table.
+ * \param firstKeyHash
+ *      Lowest key hash in the range to be migrated.
+ * \param lastKeyHash
+ *      Highest key hash in the range to be migrated.
+ * \param newOwnerId
+ *      Identifier for the master that will own the range once migration
+ *      completes.
+ */
+MigrateMasterTabletRpc::MigrateMasterTabletRpc(Context* context,
+        ServerId serverId, uint64_t tableId, uint64_t firstKeyHash,
+        uint64_t lastKeyHash, ServerId newOwnerId)
+    : ServerIdRpcWrapper(context, serverId,
+            sizeof(WireFormat::MigrateTablet::Response))
+{
+    WireFormat::MigrateTablet::Request* reqHdr(
+            allocHeader<WireFormat::MigrateTablet>());
+    reqHdr->tableId = tableId;
+    reqHdr->firstKeyHash = firstKeyHash;
+    reqHdr->lastKeyHash = lastKeyHash;
+    reqHdr->newOwnerMasterId = newOwnerId.getId();
+    send();
+}
+
+/**
+ * This RPC is sent to an index server to request that it insert or remove
+ * a group of index entries in one of its indexes. All of the entries must
+ * belong to indexlets on the server that owns the first entry; the server
+ * applies either all of them or none of them.
+ *
+ * \param master
+ *      Overall information about this RAMCloud server.
+ * \param tableId
+ *      Id of the table containing the objects that the index entries
+ *      point to.
+ * \param indexId
+ *      Id of the index to which all of the index keys belong.
+ * \param remove
+ *      True means remove the entries; false means insert them.
+ * \param entries
+ *      The index entries. The caller must ensure that the entries and
+ *      their keys remain valid until the RPC completes.
+ * \param numEntries
+ *      Number of elements in \a entries; must be at least 1.
+ *
+ * \return
+ *      True means the entries were inserted or removed. False means that
+ *      the entries don't all belong to indexlets on the same server (e.g.,
+ *      because an indexlet moved or split); the caller should insert or
+ *      remove them individually instead.
+ */
+bool
+MasterClient::modifyIndexEntries(MasterService* master, uint64_t tableId,
+        uint8_t indexId, bool remove, const IndexEntry* entries,
+        uint32_t numEntries)
+{
+    ModifyIndexEntriesRpc rpc(master, tableId, indexId, remove, entries,
+            numEntries);
+    return rpc.wait();
+}
+
+/**
+ * Constructor for ModifyIndexEntriesRpc: initiates an RPC in the same way as
+ * #MasterClient::modifyIndexEntries, but returns once the RPC has been
+ * initiated, without waiting for it to complete. The RPC is sent to the
+ * owner of the first entry.
+ *
+ * \copydetails MasterClient::modifyIndexEntries
+ */
+ModifyIndexEntriesRpc::ModifyIndexEntriesRpc(
+        MasterService* master, uint64_t tableId, uint8_t indexId, bool remove,
+        const IndexEntry* entries, uint32_t numEntries)
+    : IndexRpcWrapper(master, tableId, indexId, entries[0].key,
+            entries[0].keyLength,
+            sizeof(WireFormat::ModifyIndexEntries::Response))
+{
+    WireFormat::ModifyIndexEntries::Request* reqHdr(
+            allocHeader<WireFormat::ModifyIndexEntries>());
+    reqHdr->tableId = tableId;
+    reqHdr->indexId = indexId;
+    reqHdr->remove = remove;
+    reqHdr->count = numEntries;
+    for (uint32_t i = 0; i < numEntries; i++) {
+        WireFormat::ModifyIndexEntries::Entry* entry =
+                request.emplaceAppend<WireFormat::ModifyIndexEntries::Entry>();
+        entry->indexKeyLength = entries[i].keyLength;
+        entry->primaryKeyHash = entries[i].primaryKeyHash;
+        request.append(entries[i].key, entries[i].keyLength);
+    }
+    send();
+}
+
+// See RpcWrapper for documentation.
+bool
+ModifyIndexEntriesRpc::checkStatus()
+{
+    if (responseHeader->status == STATUS_UNKNOWN_INDEXLET) {
+        // Some of the entries aren't where we thought they should be, and
+        // they may now be spread across several servers, so retrying the
+        // whole group can't help; let the caller fall back to individual
+        // requests (with up-to-date configuration information).
+        objectFinder->flush(tableId);
+    }
+    return true;
+}
+
+/**
+ * Handle the case where the RPC cannot be completed as the index no longer
+ * exists; there's nothing to insert or remove.
+ */
+void
+ModifyIndexEntriesRpc::indexletNotFound()
+{
+    response->emplaceAppend<WireFormat::ResponseCommon>()->status = STATUS_OK;
+}
+
+/**
+ * Wait for the RPC to complete.
+ *
+ * \return
+ *      See MasterClient::modifyIndexEntries.
+ *
+ * \throw ClientException
+ *      The server rejected the request for some other reason.
+ */
+bool
+ModifyIndexEntriesRpc::wait()
+{
+    waitInternal(context->dispatch);
+    if (responseHeader->status == STATUS_UNKNOWN_INDEXLET)
+        return false;
+    if (responseHeader->status != STATUS_OK)
+        ClientException::throwException(HERE, responseHeader->status);
+    return true;
+}
+
 /**
  * Request that a master decide whether it will accept a migrated indexlet
  * and set up any necessary state to begin receiving indexlet data from the
@@ -597,12 +906,15 @@ MasterClient::receiveMigrationData(
  *      The secondary index key used to find the indexlet being migrated.
  * \param keyLength
  *      Length of the key.
+ * \param clusterTime
+ *      The sender's current (encoded) ClusterTime, so that the receiver's
+ *      ClusterClock can advance to it; 0 means unknown.
  */
 ReceiveMigrationDataRpc::ReceiveMigrationDataRpc(Context* context,
         ServerId serverId, Segment* segment,
         uint64_t tableId, uint64_t firstKeyHash,
         bool isIndexletData, uint64_t dataTableId, uint8_t indexId,
-        const void* key, uint16_t keyLength)
+        const void* key, uint16_t keyLength, uint64_t clusterTime)
     : ServerIdRpcWrapper(context, serverId,
             sizeof(WireFormat::ReceiveMigrationData::Response))
 {
@@ -614,12 +926,36 @@ ReceiveMigrationDataRpc::ReceiveMigrationDataRpc(Context* context,
     reqHdr->dataTableId = dataTableId;
     reqHdr->indexId = indexId;
     reqHdr->keyLength = keyLength;
+    reqHdr->clusterTime = clusterTime;
     request.appendExternal(key, keyLength);
     segment->getAppendedLength(&reqHdr->certificate);
     reqHdr->segmentBytes = segment->appendToBuffer(request);
     send();
 }
 
+/**
+ * Wait for a receiveMigrationData RPC to complete, and throw exceptions for
+ * any errors.
+ *
+ * \param[out] clusterTime
+ *      If not NULL, the receiver's current (encoded) ClusterTime is
+ *      returned here.
+ *
+ * \throw ServerNotUpException
+ *      The intended server for this RPC is not part of the cluster;
+ *      if it ever existed, it has since crashed.
+ */
+void
+ReceiveMigrationDataRpc::wait(uint64_t* clusterTime)
+{
+    waitAndCheckErrors();
+    if (clusterTime != NULL) {
+        const WireFormat::ReceiveMigrationData::Response* respHdr(
+                getResponseHeader<WireFormat::ReceiveMigrationData>());
+        *clusterTime = respHdr->clusterTime;
+    }
+}
+
 /**
  * This RPC is sent to a recovery master to request that it begin recovering
  * a collection of tablets previously stored on a master that has crashed.
@@ -987,16 +1323,19 @@ TakeTabletOwnershipRpc::TakeTabletOwnershipRpc(
  *      in the index order but not part of this indexlet.
  * \param firstNotOwnedKeyLength
  *      Number of bytes in the firstNotOwnedKey.
+ * \param indexType
+ *      How the indexlet's entries are stored (an IndexKey::IndexType).
  */
 void
 MasterClient::takeIndexletOwnership(Context* context, ServerId serverId,
         uint64_t tableId, uint8_t indexId, uint64_t backingTableId,
         const void *firstKey, uint16_t firstKeyLength,
-        const void *firstNotOwnedKey, uint16_t firstNotOwnedKeyLength)
+        const void *firstNotOwnedKey, uint16_t firstNotOwnedKeyLength,
+        uint8_t indexType)
 {
     TakeIndexletOwnershipRpc rpc(context, serverId, tableId, indexId,
             backingTableId, firstKey, firstKeyLength,
-            firstNotOwnedKey, firstNotOwnedKeyLength);
+            firstNotOwnedKey, firstNotOwnedKeyLength, indexType);
     rpc.wait();
 }
 
@@ -1025,12 +1364,15 @@ MasterClient::takeIndexletOwnership(Context* context, ServerId serverId,
  *      in the index order but not part of this indexlet.
  * \param firstNotOwnedKeyLength
  *      Number of bytes in the firstNotOwnedKey..
+ * \param indexType
+ *      How the indexlet's entries are stored (an IndexKey::IndexType).
  */
 TakeIndexletOwnershipRpc::TakeIndexletOwnershipRpc(
         Context* context, ServerId serverId, uint64_t tableId,
         uint8_t indexId, uint64_t backingTableId,
         const void *firstKey, uint16_t firstKeyLength,
-        const void *firstNotOwnedKey, uint16_t firstNotOwnedKeyLength)
+        const void *firstNotOwnedKey, uint16_t firstNotOwnedKeyLength,
+        uint8_t indexType)
     : ServerIdRpcWrapper(context, serverId,
             sizeof(WireFormat::TakeIndexletOwnership::Response))
 {
@@ -1041,6 +1383,7 @@ TakeIndexletOwnershipRpc::TakeIndexletOwnershipRpc(
     reqHdr->backingTableId = backingTableId;
     reqHdr->firstKeyLength = firstKeyLength;
     reqHdr->firstNotOwnedKeyLength = firstNotOwnedKeyLength;
+    reqHdr->indexType = indexType;
     request.append(firstKey, firstKeyLength);
     request.append(firstNotOwnedKey, firstNotOwnedKeyLength);
     send();
@@ -18,6 +18,7 @@
 
 #include "Buffer.h"
 #include "CoordinatorClient.h"
+#include "IndexKey.h"
 #include "IndexRpcWrapper.h"
 #include "Key.h"
 #include "LogMetadata.h"
@@ -33,6 +34,21 @@ namespace RAMCloud {
 class MasterService;
 class Segment;
 
+/**
+ * Describes one of the index entries in a MasterClient::modifyIndexEntries
+ * request.
+ */
+struct IndexEntry {
+    /// Index key for the entry; not necessarily null-terminated.
+    const void* key;
+
+    /// Length of #key, in bytes.
+    KeyLength keyLength;
+
+    /// Hash of the primary key of the object that the entry points to.
+    uint64_t primaryKeyHash;
+};
+
 /**
  * Provides methods for invoking RPCs to RAMCloud masters.  The invoking
  * machine is typically another RAMCloud server (either master or backup)
@@ -42,6 +58,11 @@ class Segment;
  */
 class MasterClient {
   public:
+    static void areReplicasNeeded(Context* context, ServerId serverId,
+            ServerId backupServerId, const uint64_t* segmentIds,
+            uint32_t count, bool* needed);
+    static void buildIndex(Context* context, ServerId serverId,
+            uint64_t tableId, uint8_t indexId);
     static void dropIndexletOwnership(Context* context, ServerId id,
             uint64_t tableId, uint8_t indexId, const void *firstKey,
             uint16_t firstKeyLength, const void *firstNotOwnedKey,
@@ -55,6 +76,12 @@ class MasterClient {
             uint64_t primaryKeyHash);
     static bool isReplicaNeeded(Context* context, ServerId serverId,
             ServerId backupServerId, uint64_t segmentId);
+    static void migrateMasterTablet(Context* context, ServerId serverId,
+            uint64_t tableId, uint64_t firstKeyHash, uint64_t lastKeyHash,
+            ServerId newOwnerId);
+    static bool modifyIndexEntries(MasterService* master,
+            uint64_t tableId, uint8_t indexId, bool remove,
+            const IndexEntry* entries, uint32_t numEntries);
     static void prepForIndexletMigration(Context* context, ServerId serverId,
             uint64_t tableId, uint8_t indexId, uint64_t backingTableId,
             const void* firstKey, uint16_t firstKeyLength,
@@ -88,7 +115,8 @@ class MasterClient {
     static void takeIndexletOwnership(Context* context, ServerId id,
             uint64_t tableId, uint8_t indexId, uint64_t backingTableId,
             const void *firstKey, uint16_t firstKeyLength,
-            const void *firstNotOwnedKey, uint16_t firstNotOwnedKeyLength);
+            const void *firstNotOwnedKey, uint16_t firstNotOwnedKeyLength,
+            uint8_t indexType = IndexKey::BTREE_INDEX);
     static void txHintFailed(Context* context, uint64_t tableId,
             uint64_t keyHash, uint64_t leaseId, uint64_t clientTransactionId,
             uint32_t participantCount, WireFormat::TxParticipant *participants);
@@ -97,6 +125,41 @@ class MasterClient {
     MasterClient();
 };
 
+/**
+ * Encapsulates the state of a MasterClient::areReplicasNeeded
+ * request, allowing it to execute asynchronously.
+ */
+class AreReplicasNeededRpc : public ServerIdRpcWrapper {
+  public:
+    AreReplicasNeededRpc(Context* context, ServerId serverId,
+            ServerId backupServerId, const uint64_t* segmentIds,
+            uint32_t count);
+    ~AreReplicasNeededRpc() {}
+    void wait(bool* needed);
+
+  PRIVATE:
+    /// Number of segment ids in the request.
+    uint32_t count;
+
+    DISALLOW_COPY_AND_ASSIGN(AreReplicasNeededRpc);
+};
+
+/**
+ * Encapsulates the state of a MasterClient::buildIndex
+ * request, allowing it to execute asynchronously.
+ */
+class BuildIndexRpc : public ServerIdRpcWrapper {
+  public:
+    BuildIndexRpc(Context* context, ServerId serverId,
+            uint64_t tableId, uint8_t indexId);
+    ~BuildIndexRpc() {}
+    /// \copydoc ServerIdRpcWrapper::waitAndCheckErrors
+    void wait() {waitAndCheckErrors();}
+
+  PRIVATE:
+    DISALLOW_COPY_AND_ASSIGN(BuildIndexRpc);
+};
+
 /**
  * Encapsulates the state of a MasterClient::dropIndexletOwnership
  * request, allowing it to execute asynchronously.
@@ -178,6 +241,43 @@ class IsReplicaNeededRpc : public ServerIdRpcWrapper {
     DISALLOW_COPY_AND_ASSIGN(IsReplicaNeededRpc);
 };
 
+/**
+ * Encapsulates the state of a MasterClient::migrateMasterTablet
+ * request, allowing it to execute asynchronously.
+ */
+class MigrateMasterTabletRpc : public ServerIdRpcWrapper {
+  public:
+    MigrateMasterTabletRpc(Context* context, ServerId serverId,
+            uint64_t tableId, uint64_t firstKeyHash, uint64_t lastKeyHash,
+            ServerId newOwnerId);
+    ~MigrateMasterTabletRpc() {}
+    /// \copydoc ServerIdRpcWrapper::waitAndCheckErrors
+    void wait() {waitAndCheckErrors();}
+
+  PRIVATE:
+    DISALLOW_COPY_AND_ASSIGN(MigrateMasterTabletRpc);
+};
+
+/**
+ * Encapsulates the state of a MasterClient::modifyIndexEntries
+ * request, allowing it to execute asynchronously.
+ */
+class ModifyIndexEntriesRpc : public IndexRpcWrapper {
+  public:
+    ModifyIndexEntriesRpc(MasterService* master,
+            uint64_t tableId, uint8_t indexId, bool remove,
+            const IndexEntry* entries, uint32_t numEntries);
+    ~ModifyIndexEntriesRpc() {}
+    void indexletNotFound();
+    bool wait();
+
+  PROTECTED:
+    bool checkStatus();
+
+  PRIVATE:
+    DISALLOW_COPY_AND_ASSIGN(ModifyIndexEntriesRpc);
+};
+
 /**
  * Encapsulates the state of a MasterClient::prepForIndexletMigration
  * request, allowing it to execute asynchronously.
@@ -222,10 +322,9 @@ class ReceiveMigrationDataRpc : public ServerIdRpcWrapper {
     ReceiveMigrationDataRpc(Context* context, ServerId serverId,
             Segment* segment, uint64_t tableId, uint64_t firstKey,
             bool isIndexletData, uint64_t dataTableId, uint8_t indexId,
-            const void* key, uint16_t keyLength);
+            const void* key, uint16_t keyLength, uint64_t clusterTime = 0);
     ~ReceiveMigrationDataRpc() {}
-    /// \copydoc ServerIdRpcWrapper::waitAndCheckErrors
-    void wait() {waitAndCheckErrors();}
+    void wait(uint64_t* clusterTime = NULL);
 
   PRIVATE:
     DISALLOW_COPY_AND_ASSIGN(ReceiveMigrationDataRpc);
@@ -328,7 +427,8 @@ class TakeIndexletOwnershipRpc : public ServerIdRpcWrapper {
     TakeIndexletOwnershipRpc(Context* context, ServerId id, uint64_t tableId,
             uint8_t indexId, uint64_t backingTableId, const void *firstKey,
             uint16_t firstKeyLength, const void *firstNotOwnedKey,
-            uint16_t firstNotOwnedKeyLength);
+            uint16_t firstNotOwnedKeyLength,
+            uint8_t indexType = IndexKey::BTREE_INDEX);
     ~TakeIndexletOwnershipRpc() {}
     /// \copydoc ServerIdRpcWrapper::waitAndCheckErrors
     void wait() {waitAndCheckErrors();}
@@ -13,6 +13,7 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include "Cycles.h"
 #include "MasterRecoveryManager.h"
 #include "ShortMacros.h"
 
@@ -71,9 +72,12 @@ class MaybeStartRecoveryTask : public Task {
                     "another recovery is active for the same ServerId",
                     recovery->crashedServerId.toString().c_str());
             } else {
-                if (mgr.runtimeOptions)
+                if (mgr.runtimeOptions) {
                     recovery->testingFailRecoveryMasters =
                         mgr.runtimeOptions->popFailRecoveryMasters();
+                    recovery->streamingRanges =
+                        mgr.runtimeOptions->getRecoveryStreamingRanges();
+                }
                 recovery->schedule();
                 mgr.activeRecoveries[recovery->getRecoveryId()] = recovery;
                 mgr.waitingRecoveries.pop();
@@ -180,19 +184,25 @@ class RecoveryMasterFinishedTask : public Task {
      *      then \a recoveryPartition is ignored and the tablets of
      *      the partition the recovery master was supposed to recover
      *      are left marked RECOVERING.
+     * \param partial
+     *      If true, \a recoveryPartition is only part of the recovery
+     *      master's partition; the recovery master is still recovering
+     *      the rest and will report again when it is done.
      */
     RecoveryMasterFinishedTask(MasterRecoveryManager& recoveryManager,
                                uint64_t recoveryId,
                                ServerId recoveryMasterId,
                                const ProtoBuf::RecoveryPartition&
                                      recoveryPartition,
-                               bool successful)
+                               bool successful,
+                               bool partial)
         : Task(recoveryManager.taskQueue)
         , mgr(recoveryManager)
         , recoveryId(recoveryId)
         , recoveryMasterId(recoveryMasterId)
         , recoveryPartition(recoveryPartition)
         , successful(successful)
+        , partial(partial && successful)
         , mutex()
         , taskPerformed(false)
         , performed()
@@ -218,7 +228,20 @@ class RecoveryMasterFinishedTask : public Task {
             performed.notify_all();
             return;
         }
+        Recovery* recovery = it->second;
+
+        if (partial && !recovery->isRecoveryMaster(recoveryMasterId)) {
+            LOG(NOTICE, "Recovery master %s reported part of its partition "
+                "for recovery %lu but is no longer part of that recovery; "
+                "asking it to abort", recoveryMasterId.toString().c_str(),
+                recoveryId);
+            taskPerformed = true;
+            cancelRecoveryOnRecoveryMaster = true;
+            performed.notify_all();
+            return;
+        }
 
+        uint64_t handoffStart = Cycles::rdtsc();
         if (successful) {
             // Update tablet map to point to new owner and mark as available.
             foreach (const auto& tablet, recoveryPartition.tablet()) {
@@ -298,8 +321,13 @@ class RecoveryMasterFinishedTask : public Task {
             cancelRecoveryOnRecoveryMaster = true;
         }
 
-        Recovery* recovery = it->second;
-        recovery->recoveryMasterFinished(recoveryMasterId, successful);
+        // The recovery master hasn't finished yet if it only handed over
+        // part of its partition.
+        if (!partial) {
+            recovery->timeline.addRecoveryMaster(recoveryMasterId, successful,
+                    recoveryPartition, Cycles::rdtsc() - handoffStart);
+            recovery->recoveryMasterFinished(recoveryMasterId, successful);
+        }
         taskPerformed = true;
         performed.notify_all();
     }
@@ -331,6 +359,9 @@ class RecoveryMasterFinishedTask : public Task {
     ProtoBuf::RecoveryPartition recoveryPartition;
     bool successful;
 
+    /// True if this reports only part of the recovery master's partition.
+    bool partial;
+
     /**
      * Mutex to synchronize access to the #taskPerformed and
      * #cancelRecoveryOnRecoveryMaster fields.
@@ -388,6 +419,8 @@ MasterRecoveryManager::MasterRecoveryManager(Context* context,
     , maxActiveRecoveries(1u)
     , taskQueue()
     , tracker(context, this)
+    , replacementsMutex()
+    , replacements()
     , doNotStartRecoveries(false)
     , startRecoveriesEvenIfNoThread(false)
     , skipRescheduleDelay(false)
@@ -557,6 +590,10 @@ MasterRecoveryManager::recoveryFinished(Recovery* recovery)
         recovery->crashedServerId.toString().c_str(),
         activeRecoveries.size() - 1);
     if (recovery->wasCompletelySuccessful()) {
+        {
+            std::lock_guard<std::mutex> _(replacementsMutex);
+            replacements.erase(recovery->crashedServerId.getId());
+        }
         // Remove recovered server from the server list and broadcast
         // the change to the cluster.
         try {
@@ -591,6 +628,36 @@ MasterRecoveryManager::recoveryFinished(Recovery* recovery)
     delete recovery;
 }
 
+/**
+ * Record that a master which enlisted as the replacement for a crashed
+ * master has a snapshot of the crashed master's log (see MasterSnapshot),
+ * so that recovery of the crashed master can use it. Invoked by coordinator
+ * worker threads.
+ *
+ * \param crashedServerId
+ *      The master that was shut down.
+ * \param replacementId
+ *      The master that was restarted in its place.
+ */
+void
+MasterRecoveryManager::replacementEnlisted(ServerId crashedServerId,
+                                           ServerId replacementId)
+{
+    std::lock_guard<std::mutex> _(replacementsMutex);
+    replacements[crashedServerId.getId()] = replacementId;
+}
+
+// See Recovery::Owner::getReplacement.
+ServerId
+MasterRecoveryManager::getReplacement(ServerId crashedServerId)
+{
+    std::lock_guard<std::mutex> _(replacementsMutex);
+    auto it = replacements.find(crashedServerId.getId());
+    if (it == replacements.end())
+        return ServerId();
+    return it->second;
+}
+
 /**
  * Schedule the notification of an ongoing Recovery that a recovery
  * master has finished recovering its partition
@@ -614,6 +681,12 @@ MasterRecoveryManager::recoveryFinished(Recovery* recovery)
  *      then \a recoveryPartition is ignored and the tablets of
  *      the partition the recovery master was supposed to recover
  *      are left marked RECOVERING.
+ * \param partial
+ *      If true, \a recoveryPartition holds only some of the recovery
+ *      master's tablets, which it has finished recovering ahead of the rest
+ *      of its partition so that clients can use them sooner. Those tablets
+ *      are handed over, but the recovery master still counts as working on
+ *      the recovery until it reports again without \a partial.
  * \return
  *      True if the recovery master should abort the recovery without
  *      taking ownership of the recovered tablets; false if the
@@ -627,11 +700,12 @@ MasterRecoveryManager::recoveryMasterFinished(
     uint64_t recoveryId,
     ServerId recoveryMasterId,
     const ProtoBuf::RecoveryPartition& recoveryPartition,
-    bool successful)
+    bool successful,
+    bool partial)
 {
-    LOG(NOTICE, "Called by masterId %s with %u tablets and %u indexlets",
+    LOG(NOTICE, "Called by masterId %s with %u tablets and %u indexlets%s",
         recoveryMasterId.toString().c_str(), recoveryPartition.tablet_size(),
-        recoveryPartition.indexlet_size());
+        recoveryPartition.indexlet_size(), partial ? " (partial)" : "");
 
     TEST_LOG("Recovered tablets");
     TEST_LOG("%s", recoveryPartition.ShortDebugString().c_str());
@@ -639,7 +713,7 @@ MasterRecoveryManager::recoveryMasterFinished(
     // RecoveryMasterFinishedTasks don't delete themselves so we can get the
     // result back via wait().
     RecoveryMasterFinishedTask task(*this, recoveryId, recoveryMasterId,
-                                    recoveryPartition, successful);
+                                    recoveryPartition, successful, partial);
     task.schedule();
     bool shouldAbort = task.wait();
     if (shouldAbort)
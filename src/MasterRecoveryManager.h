@@ -16,7 +16,9 @@
 #ifndef RAMCLOUD_MASTERRECOVERYMANAGER_H
 #define RAMCLOUD_MASTERRECOVERYMANAGER_H
 
+#include <mutex>
 #include <thread>
+#include <unordered_map>
 
 #include "CoordinatorServerList.h"
 #include "ProtoBuf.h"
@@ -64,11 +66,16 @@ class MasterRecoveryManager : public Recovery::Owner
                                 ServerId recoveryMasterId,
                                 const ProtoBuf::RecoveryPartition&
                                       recoveryPartition,
-                                bool successful);
+                                bool successful,
+                                bool partial = false);
+
+    void replacementEnlisted(ServerId crashedServerId,
+                             ServerId replacementId);
 
     virtual void trackerChangesEnqueued();
 
     virtual void recoveryFinished(Recovery* recovery);
+    virtual ServerId getReplacement(ServerId crashedServerId);
 
   PRIVATE:
     void main();
@@ -131,6 +138,16 @@ class MasterRecoveryManager : public Recovery::Owner
      */
     RecoveryTracker tracker;
 
+    /// Protects #replacements, which coordinator worker threads update.
+    std::mutex replacementsMutex;
+
+    /**
+     * For each crashed master that was restarted after saving a snapshot of
+     * its log (see MasterSnapshot), the id of the new master; recoveries of
+     * the crashed master use the new master to recover all of its tablets.
+     */
+    std::unordered_map<uint64_t, ServerId> replacements;
+
     /**
      * Prevents startMasterRecovery() from actually starting recovery and,
      * instead, logs arguments to the call. Used for unit testing.
@@ -236,7 +236,7 @@ TEST_F(MasterRecoveryManagerTest, recoveryMasterFinishedNoSuchRecovery) {
     TestLog::Enable _;
     std::thread thread(&MasterRecoveryManager::recoveryMasterFinished,
                        mgr,
-                       0lu, serverId, recoveryPartition, false);
+                       0lu, serverId, recoveryPartition, false, false);
     while (!mgr->taskQueue.performTask()); // Do RecoveryMasterFinishedTask.
     thread.join();
     EXPECT_EQ(
@@ -287,7 +287,7 @@ TEST_F(MasterRecoveryManagerTest, recoveryMasterFinished) {
     std::thread thread(&MasterRecoveryManager::recoveryMasterFinished,
                        mgr,
                        recovery.recoveryId,
-                       ServerId{2, 0}, recoveryPartition, true);
+                       ServerId{2, 0}, recoveryPartition, true, false);
     while (!mgr->taskQueue.performTask()); // Do RecoveryMasterFinishedTask.
     thread.join();
     EXPECT_EQ(
@@ -316,6 +316,64 @@ TEST_F(MasterRecoveryManagerTest, recoveryMasterFinished) {
     EXPECT_EQ(1lu, mgr->taskQueue.outstandingTasks());
 }
 
+TEST_F(MasterRecoveryManagerTest, recoveryMasterFinishedPartial) {
+    Lock lock(mutex); // For calls to internal functions without real lock.
+    MockRandom __(1);
+    tableManager->testCreateTable("foo", 0);
+    auto crashedServerId = addMaster(lock, ServerStatus::CRASHED);
+    addMaster(lock); // Recovery master.
+
+    Recovery recovery(&context, mgr->taskQueue, tableManager, &mgr->tracker,
+                      mgr, crashedServerId, {});
+    recovery.numPartitions = 1;
+    mgr->activeRecoveries[recovery.recoveryId] = &recovery;
+    mgr->tracker[ServerId(2, 0)] = &recovery;
+
+    ProtoBuf::RecoveryPartition recoveryPartition;
+    ProtoBuf::Tablets recoveredTablets;
+    TabletsBuilder{recoveredTablets}
+        (0, 0, 9, TabletsBuilder::RECOVERING, 0, {2, 0});
+    *recoveryPartition.add_tablet() = recoveredTablets.tablet(0);
+    tableManager->testAddTablet({0, 0, 9, {1, 0}, Tablet::RECOVERING, {}});
+    tableManager->testAddTablet({0, 10, ~0lu, {1, 0}, Tablet::RECOVERING, {}});
+
+    TestLog::Enable _;
+    std::thread thread(&MasterRecoveryManager::recoveryMasterFinished,
+                       mgr,
+                       recovery.recoveryId,
+                       ServerId{2, 0}, recoveryPartition, true, true);
+    while (!mgr->taskQueue.performTask()); // Do RecoveryMasterFinishedTask.
+    thread.join();
+    EXPECT_TRUE(TestUtil::contains(TestLog::get(),
+        "Called by masterId 2.0 with 1 tablets and 0 indexlets (partial)"));
+    EXPECT_TRUE(TestUtil::contains(TestLog::get(),
+        "Notifying recovery master ok to serve tablets"));
+    EXPECT_EQ("Table { name: foo, id 0, "
+              "Tablet { startKeyHash: 0x0, endKeyHash: 0x9, "
+              "serverId: 2.0, status: NORMAL, ctime: 0.0 } "
+              "Tablet { startKeyHash: 0xa, endKeyHash: 0xffffffffffffffff, "
+              "serverId: 1.0, status: RECOVERING, ctime: 0.0 } }",
+              tableManager->debugString());
+    // The recovery master is still working on the rest of its partition.
+    EXPECT_EQ(0u, recovery.successfulRecoveryMasters);
+    EXPECT_EQ(&recovery, mgr->tracker[ServerId(2, 0)]);
+
+    // Once it is no longer part of the recovery it may not hand over
+    // more of the partition.
+    mgr->tracker[ServerId(2, 0)] = NULL;
+    TestLog::reset();
+    std::thread thread2(&MasterRecoveryManager::recoveryMasterFinished,
+                        mgr,
+                        recovery.recoveryId,
+                        ServerId{2, 0}, recoveryPartition, true, true);
+    while (!mgr->taskQueue.performTask()); // Do RecoveryMasterFinishedTask.
+    thread2.join();
+    EXPECT_TRUE(TestUtil::contains(TestLog::get(),
+        "is no longer part of that recovery; asking it to abort"));
+    EXPECT_TRUE(TestUtil::contains(TestLog::get(),
+        "Asking recovery master to abort its recovery"));
+}
+
 TEST_F(MasterRecoveryManagerTest,
        recoveryMasterFinishedNotCompletelySuccessful)
 {
@@ -350,7 +408,7 @@ TEST_F(MasterRecoveryManagerTest,
     std::thread thread(&MasterRecoveryManager::recoveryMasterFinished,
                        mgr,
                        recovery->recoveryId,
-                       ServerId{2, 0}, recoveryPartition, false);
+                       ServerId{2, 0}, recoveryPartition, false, false);
     while (!mgr->taskQueue.performTask());
     thread.join();
     EXPECT_EQ(
@@ -470,4 +528,11 @@ TEST_F(MasterRecoveryManagerTest,
     EXPECT_EQ(1lu, mgr->activeRecoveries.size());
 }
 
+TEST_F(MasterRecoveryManagerTest, replacementEnlisted) {
+    EXPECT_FALSE(mgr->getReplacement(ServerId(1, 0)).isValid());
+    mgr->replacementEnlisted(ServerId(1, 0), ServerId(2, 0));
+    EXPECT_EQ(ServerId(2, 0), mgr->getReplacement(ServerId(1, 0)));
+    EXPECT_FALSE(mgr->getReplacement(ServerId(1, 1)).isValid());
+}
+
 } // namespace RAMCloud
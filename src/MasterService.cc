@@ -13,6 +13,13 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <thread>
+#include <algorithm>
+#include <deque>
+#include <exception>
+#include <map>
+#include <memory>
+#include <set>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -20,17 +27,23 @@
 #include "ClientException.h"
 #include "Cycles.h"
 #include "Dispatch.h"
+#include "DispatchThread.h"
 #include "Enumeration.h"
 #include "EnumerationIterator.h"
 #include "IndexKey.h"
 #include "LogIterator.h"
 #include "LogProtector.h"
+#include "Lz4.h"
 #include "MasterClient.h"
 #include "MasterService.h"
 #include "ObjectBuffer.h"
+#include "ObjectFilter.h"
 #include "PerfCounter.h"
+#include "PingClient.h"
 #include "ProtoBuf.h"
 #include "RawMetrics.h"
+#include "RecoverySegmentBuilder.h"
+#include "RpcLatency.h"
 #include "Segment.h"
 #include "ServerRpcPool.h"
 #include "ShortMacros.h"
@@ -85,7 +98,8 @@ MasterService::MasterService(Context* context, const ServerConfig* config)
                     &masterTableMetadata,
                     &unackedRpcResults,
                     &preparedOps,
-                    &txRecoveryManager)
+                    &txRecoveryManager,
+                    &clusterClock)
     , tabletManager()
     , txRecoveryManager(context)
     , indexletManager(context, &objectManager)
@@ -93,19 +107,40 @@ MasterService::MasterService(Context* context, const ServerConfig* config)
     , clientLeaseValidator(context, &clusterClock)
     , unackedRpcResults(context, &objectManager, &clientLeaseValidator)
     , preparedOps(context)
+    , rateLimiter()
+    , changeStream(config->master.changeStreamBytes)
+    , writeStreams(config->maxObjectDataSize)
+    , memoryUtilization(0)
+    , nextUtilizationCheck(0)
     , disableCount(0)
     , initCalled(false)
     , logEverSynced(false)
+    , restartSnapshot()
     , masterTableMetadata()
     , maxResponseRpcLen(Transport::MAX_RPC_LEN)
     , migrationMonitor(this)
+    , tabletLoadReporter(this)
+    , readReplicaFeeder(this)
+    , durabilityQueue(this)
+    , bucketPrefetcher(objectManager.getObjectMap())
+    , incrementMutex("MasterService::incrementMutex")
+    , activeIncrements()
 {
     context->services[WireFormat::MASTER_SERVICE] = this;
+    if (context->workerManager != NULL)
+        context->workerManager->setPrefetcher(&bucketPrefetcher);
+    if (!config->master.restartSnapshotPath.empty())
+        restartSnapshot.construct(config->master.restartSnapshotPath);
+    if (config->master.changeStreamBytes != 0)
+        objectManager.getLog()->setChangeStream(&changeStream);
 }
 
 MasterService::~MasterService()
 {
     context->services[WireFormat::MASTER_SERVICE] = NULL;
+    objectManager.getLog()->setChangeStream(NULL);
+    if (context->workerManager != NULL)
+        context->workerManager->setPrefetcher(NULL);
 }
 
 // See Server::dispatch.
@@ -127,7 +162,59 @@ MasterService::dispatch(WireFormat::Opcode opcode, Rpc* rpc)
         return;
     }
 
+    // Turn away requests for tables over their rate limits before doing
+    // any work for them; the client backs off for the time we suggest.
+    uint64_t limitedTableId = 0;
+    uint32_t ops = 0;
+    bool limited = rateLimiter.isEnabled() &&
+            TableRateLimiter::getTable(opcode, rpc->requestPayload,
+            &limitedTableId, &ops);
+    if (limited) {
+        uint32_t delayMicros = rateLimiter.admit(limitedTableId, ops);
+        if (delayMicros != 0) {
+            throw RetryException(HERE, delayMicros, 2 * delayMicros,
+                    "table over its rate limit");
+        }
+    }
+    if (config->master.writeBackpressurePercent != 0) {
+        uint32_t delayMicros = getWriteBackpressure(opcode,
+                rpc->requestPayload);
+        if (delayMicros != 0) {
+            metrics->master.writesShed++;
+            throw RetryException(HERE, delayMicros, 2 * delayMicros,
+                    "log memory nearly full");
+        }
+    }
+
     switch (opcode) {
+        case WireFormat::Append::opcode:
+            callHandler<WireFormat::Append, MasterService,
+                        &MasterService::append>(rpc);
+            break;
+        case WireFormat::AreReplicasNeeded::opcode:
+            callHandler<WireFormat::AreReplicasNeeded, MasterService,
+                        &MasterService::areReplicasNeeded>(rpc);
+            break;
+        case WireFormat::BuildIndex::opcode:
+            callHandler<WireFormat::BuildIndex, MasterService,
+                        &MasterService::buildIndex>(rpc);
+            break;
+        case WireFormat::BulkLoad::opcode:
+            callHandler<WireFormat::BulkLoad, MasterService,
+                        &MasterService::bulkLoad>(rpc);
+            break;
+        case WireFormat::CommitWrite::opcode:
+            callHandler<WireFormat::CommitWrite, MasterService,
+                        &MasterService::commitWrite>(rpc);
+            break;
+        case WireFormat::ConditionalUpdate::opcode:
+            callHandler<WireFormat::ConditionalUpdate, MasterService,
+                        &MasterService::conditionalUpdate>(rpc);
+            break;
+        case WireFormat::CountIndexKeys::opcode:
+            callHandler<WireFormat::CountIndexKeys, MasterService,
+                        &MasterService::countIndexKeys>(rpc);
+            break;
         case WireFormat::DropTabletOwnership::opcode:
             callHandler<WireFormat::DropTabletOwnership, MasterService,
                         &MasterService::dropTabletOwnership>(rpc);
@@ -180,6 +267,10 @@ MasterService::dispatch(WireFormat::Opcode opcode, Rpc* rpc)
             callHandler<WireFormat::ReadHashes, MasterService,
                         &MasterService::readHashes>(rpc);
             break;
+        case WireFormat::ModifyIndexEntries::opcode:
+            callHandler<WireFormat::ModifyIndexEntries, MasterService,
+                        &MasterService::modifyIndexEntries>(rpc);
+            break;
         case WireFormat::MultiOp::opcode:
             callHandler<WireFormat::MultiOp, MasterService,
                         &MasterService::multiOp>(rpc);
@@ -196,6 +287,14 @@ MasterService::dispatch(WireFormat::Opcode opcode, Rpc* rpc)
             callHandler<WireFormat::Read, MasterService,
                         &MasterService::read>(rpc);
             break;
+        case WireFormat::ReadChanges::opcode:
+            callHandler<WireFormat::ReadChanges, MasterService,
+                        &MasterService::readChanges>(rpc);
+            break;
+        case WireFormat::ReadFromReplica::opcode:
+            callHandler<WireFormat::ReadFromReplica, MasterService,
+                        &MasterService::readFromReplica>(rpc);
+            break;
         case WireFormat::ReadKeysAndValue::opcode:
             callHandler<WireFormat::ReadKeysAndValue, MasterService,
                         &MasterService::readKeysAndValue>(rpc);
@@ -248,6 +347,10 @@ MasterService::dispatch(WireFormat::Opcode opcode, Rpc* rpc)
             callHandler<WireFormat::Write, MasterService,
                         &MasterService::write>(rpc);
             break;
+        case WireFormat::WriteFragment::opcode:
+            callHandler<WireFormat::WriteFragment, MasterService,
+                        &MasterService::writeFragment>(rpc);
+            break;
         // Recovery. Should eventually move away with other recovery code.
         case WireFormat::Recover::opcode:
             callHandler<WireFormat::Recover, MasterService,
@@ -257,6 +360,11 @@ MasterService::dispatch(WireFormat::Opcode opcode, Rpc* rpc)
             prepareErrorResponse(rpc->replyPayload,
                                  STATUS_UNIMPLEMENTED_REQUEST);
     }
+
+    if (limited) {
+        rateLimiter.chargeBytes(limitedTableId,
+                rpc->requestPayload->size() + rpc->replyPayload->size());
+    }
 }
 
 /**
@@ -303,6 +411,346 @@ volatile int MasterService::pauseIncrement = 0;
 volatile int MasterService::continueIncrement = 0;
 #endif
 
+/**
+ * Top-level server method to handle the APPEND request.
+ *
+ * \copydetails MasterService::read
+ */
+void
+MasterService::append(const WireFormat::Append::Request* reqHdr,
+        WireFormat::Append::Response* respHdr,
+        Rpc* rpc)
+{
+    uint32_t reqOffset = sizeof32(*reqHdr);
+    const void* stringKey = rpc->requestPayload->getRange(reqOffset,
+            reqHdr->keyLength);
+    reqOffset += reqHdr->keyLength;
+    const void* data = rpc->requestPayload->getRange(reqOffset,
+            reqHdr->length);
+    if (stringKey == NULL || (data == NULL && reqHdr->length > 0)) {
+        respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
+        return;
+    }
+
+    assert(reqHdr->rpcId > 0);
+    UnackedRpcHandle rh(&unackedRpcResults,
+                        reqHdr->lease, reqHdr->rpcId, reqHdr->ackId);
+    if (rh.isDuplicate()) {
+        *respHdr = parseRpcResult<WireFormat::Append>(rh.resultLoc());
+        rpc->sendReply();
+        return;
+    }
+
+    Key key(reqHdr->tableId, stringKey, reqHdr->keyLength);
+    RpcResult rpcResult(reqHdr->tableId, key.getHash(),
+                        reqHdr->lease.leaseId, reqHdr->rpcId, reqHdr->ackId,
+                        respHdr, sizeof(*respHdr));
+    uint8_t updated;
+    uint64_t rpcResultPtr;
+    updateObject(&key, reqHdr->rejectRules, true, 0, NULL, data,
+                 reqHdr->length, &respHdr->version, &updated,
+                 &respHdr->newLength, &respHdr->common.status,
+                 &rpcResult, &rpcResultPtr);
+    finishUpdate(&rh, &rpcResult, updated, respHdr->common.status,
+                 &rpcResultPtr);
+}
+
+/**
+ * RPC handler for ARE_REPLICAS_NEEDED; the batched form of
+ * IS_REPLICA_NEEDED, which tells a backup which of many replicas of this
+ * master's segments it must keep.
+ */
+void
+MasterService::areReplicasNeeded(
+        const WireFormat::AreReplicasNeeded::Request* reqHdr,
+        WireFormat::AreReplicasNeeded::Response* respHdr,
+        Rpc* rpc)
+{
+    uint32_t count = reqHdr->segmentIdCount;
+    const uint64_t* segmentIds = static_cast<const uint64_t*>(
+            rpc->requestPayload->getRange(sizeof32(*reqHdr),
+            count * sizeof32(uint64_t)));
+    if (count != 0 && segmentIds == NULL) {
+        respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
+        return;
+    }
+    ServerId backupServerId = ServerId(reqHdr->backupServerId);
+    ReplicaManager* replicaManager = objectManager.getReplicaManager();
+    uint8_t* needed = static_cast<uint8_t*>(rpc->replyPayload->alloc(count));
+    for (uint32_t i = 0; i < count; i++) {
+        needed[i] = replicaManager->isReplicaNeeded(backupServerId,
+                segmentIds[i]);
+    }
+}
+
+/**
+ * Top-level server method to handle the BUILD_INDEX request.
+ *
+ * This RPC is issued by the coordinator after it creates an index for a
+ * table that may already contain objects. We reply right away, then add
+ * the new index's entries for all of the objects in our tablets of the
+ * table, sending them to the index servers in large batches. Objects
+ * written after the index was created get their entries the usual way.
+ *
+ * \copydetails Service::ping
+ */
+void
+MasterService::buildIndex(
+        const WireFormat::BuildIndex::Request* reqHdr,
+        WireFormat::BuildIndex::Response* respHdr,
+        Rpc* rpc)
+{
+    uint64_t tableId = reqHdr->tableId;
+    uint8_t indexId = reqHdr->indexId;
+    rpc->sendReply();
+    // reqHdr, respHdr, and rpc are off-limits now!
+
+    // New writes must add primary keys to a new primary key index too.
+    if (indexId == 0)
+        masterTableMetadata.findOrCreate(tableId)->primaryKeyIndexed = 1;
+
+    vector<TabletManager::Tablet> tablets;
+    tabletManager.getTablets(&tablets);
+    uint64_t numObjects = 0;
+    foreach (TabletManager::Tablet& tablet, tablets) {
+        if (tablet.tableId != tableId ||
+                tablet.state != TabletManager::NORMAL)
+            continue;
+        numObjects += buildIndexEntries(tableId, indexId,
+                tablet.startKeyHash, tablet.endKeyHash);
+    }
+    LOG(NOTICE, "Added index entries for %lu objects to index %u of "
+            "tableId %lu", numObjects, indexId, tableId);
+}
+
+/**
+ * Helper function for buildIndex: adds index entries for all of the
+ * objects in one tablet.
+ *
+ * \param tableId
+ *      Table containing the tablet.
+ * \param indexId
+ *      Index to which the entries are to be added.
+ * \param firstKeyHash
+ *      Smallest key hash in the tablet.
+ * \param lastKeyHash
+ *      Largest key hash in the tablet.
+ * \return
+ *      The number of objects scanned.
+ */
+uint64_t
+MasterService::buildIndexEntries(uint64_t tableId, uint8_t indexId,
+        uint64_t firstKeyHash, uint64_t lastKeyHash)
+{
+    // Scan the tablet the same way as ENUMERATE does, a batch at a time;
+    // only the keys are needed.
+    Buffer iteratorBuffer;
+    EnumerationIterator iter(iteratorBuffer, 0, 0);
+    uint64_t numObjects = 0;
+    while (true) {
+        Buffer payload;
+        uint64_t nextTabletStartHash;
+        Enumeration enumeration(tableId, true, firstKeyHash,
+                firstKeyHash, lastKeyHash, &nextTabletStartHash, iter,
+                *objectManager.getLog(), *objectManager.getObjectMap(),
+                payload, BUILD_INDEX_BATCH_BYTES);
+        enumeration.complete();
+        if (payload.size() == 0)
+            break;
+
+        std::deque<Object> objects;
+        vector<Object*> objectPointers;
+        uint32_t offset = 0;
+        while (offset < payload.size()) {
+            uint32_t length = *payload.getOffset<uint32_t>(offset);
+            offset += sizeof32(length);
+            objects.emplace_back(payload, offset, length);
+            objectPointers.push_back(&objects.back());
+            offset += length;
+        }
+        requestModifyIndexEntries(&objectPointers, false, indexId);
+        numObjects += objects.size();
+    }
+    return numObjects;
+}
+
+/**
+ * Top-level server method to handle the BULK_LOAD request.
+ *
+ * \copydetails MasterService::read
+ */
+void
+MasterService::bulkLoad(const WireFormat::BulkLoad::Request* reqHdr,
+        WireFormat::BulkLoad::Response* respHdr,
+        Rpc* rpc)
+{
+    uint32_t segmentBytes = reqHdr->segmentBytes;
+    if (rpc->requestPayload->size() != sizeof32(*reqHdr) + segmentBytes) {
+        LOG(WARNING, "RPC size (%u) does not match advertised length (%u)",
+                rpc->requestPayload->size(),
+                sizeof32(*reqHdr) + segmentBytes);
+        respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
+        return;
+    }
+    SegmentCertificate certificate = reqHdr->certificate;
+    void* segmentMemory = rpc->requestPayload->getRange(sizeof32(*reqHdr),
+            segmentBytes);
+    uint32_t objects = 0;
+    respHdr->common.status = objectManager.bulkLoad(reqHdr->tableId,
+            segmentMemory, segmentBytes, certificate, &objects);
+    respHdr->objects = objects;
+}
+
+/**
+ * Top-level server method to handle the COMMIT_WRITE request, which writes
+ * an object whose value was sent earlier in WRITE_FRAGMENT requests (see
+ * ObjectWriteStream).
+ *
+ * \copydetails MasterService::read
+ */
+void
+MasterService::commitWrite(const WireFormat::CommitWrite::Request* reqHdr,
+        WireFormat::CommitWrite::Response* respHdr,
+        Rpc* rpc)
+{
+    assert(reqHdr->rpcId > 0);
+    uint32_t keyLength = reqHdr->keyLength;
+    const void* keyString = rpc->requestPayload->getRange(sizeof32(*reqHdr),
+            keyLength);
+    if (keyString == NULL) {
+        respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
+        return;
+    }
+
+    UnackedRpcHandle rh(&unackedRpcResults,
+                        reqHdr->lease, reqHdr->rpcId, reqHdr->ackId);
+    uint32_t ackReplicas = objectManager.getTableDurability(reqHdr->tableId);
+    bool waitForAllBackups = (ackReplicas == ~0u);
+    if (rh.isDuplicate()) {
+        *respHdr = parseRpcResult<WireFormat::CommitWrite>(rh.resultLoc());
+        if (config->master.deferWriteReplies && waitForAllBackups) {
+            durabilityQueue.deferReply(rpc);
+        } else {
+            rpc->sendReply();
+        }
+        return;
+    }
+
+    std::unique_ptr<WriteStreamManager::Stream> stream;
+    respHdr->common.status = writeStreams.finish(reqHdr->streamId,
+            reqHdr->tableId, reqHdr->valueLength, reqHdr->checksum, &stream);
+    if (respHdr->common.status != STATUS_OK)
+        return;
+
+    // The object refers to the fragments rather than copying them; the
+    // log append below is the only copy.
+    Key key(reqHdr->tableId, keyString, downCast<KeyLength>(keyLength));
+    Buffer objectBuffer;
+    Object::appendKeysAndValueToBuffer(key, NULL, 0, &objectBuffer);
+    stream->appendValue(&objectBuffer);
+    Object object(reqHdr->tableId, 0, 0, objectBuffer);
+    requestInsertIndexEntries(object);
+
+    Buffer oldObjectBuffer;
+    RejectRules rejectRules = reqHdr->rejectRules;
+    uint64_t rpcResultPtr;
+    respHdr->common.status = STATUS_OK;
+    RpcResult rpcResult(
+            reqHdr->tableId, key.getHash(),
+            reqHdr->lease.leaseId, reqHdr->rpcId, reqHdr->ackId,
+            respHdr, sizeof(*respHdr));
+    respHdr->common.status = objectManager.writeObject(
+            object, &rejectRules, &respHdr->version, &oldObjectBuffer,
+            &rpcResult, &rpcResultPtr);
+
+    if (respHdr->common.status == STATUS_OK) {
+        if (!config->master.deferWriteReplies || !waitForAllBackups)
+            objectManager.syncChanges(ackReplicas);
+        rh.recordCompletion(rpcResultPtr);
+        if (config->master.deferWriteReplies && waitForAllBackups)
+            durabilityQueue.deferReply(rpc);
+    } else if (respHdr->common.status == STATUS_RETRY) {
+        // The client will send the commit again; keep the value for it.
+        writeStreams.restore(reqHdr->streamId, &stream);
+    } else if (respHdr->common.status != STATUS_UNKNOWN_TABLET) {
+        objectManager.writeRpcResultOnly(&rpcResult, &rpcResultPtr);
+        rh.recordCompletion(rpcResultPtr);
+    }
+
+    if (oldObjectBuffer.size() > 0) {
+        Object oldObject(oldObjectBuffer);
+        if (oldObject.getKeyCount() >
+                firstIndexedKey(oldObject.getTableId())) {
+            rpc->sendReply();
+            requestRemoveIndexEntries(oldObject);
+        }
+    }
+}
+
+/**
+ * Top-level server method to handle the CONDITIONAL_UPDATE request.
+ *
+ * \copydetails MasterService::read
+ */
+void
+MasterService::conditionalUpdate(
+        const WireFormat::ConditionalUpdate::Request* reqHdr,
+        WireFormat::ConditionalUpdate::Response* respHdr,
+        Rpc* rpc)
+{
+    uint32_t reqOffset = sizeof32(*reqHdr);
+    const void* stringKey = rpc->requestPayload->getRange(reqOffset,
+            reqHdr->keyLength);
+    reqOffset += reqHdr->keyLength;
+    const void* expected = rpc->requestPayload->getRange(reqOffset,
+            reqHdr->length);
+    reqOffset += reqHdr->length;
+    const void* data = rpc->requestPayload->getRange(reqOffset,
+            reqHdr->length);
+    if (stringKey == NULL ||
+            ((expected == NULL || data == NULL) && reqHdr->length > 0)) {
+        respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
+        return;
+    }
+
+    assert(reqHdr->rpcId > 0);
+    UnackedRpcHandle rh(&unackedRpcResults,
+                        reqHdr->lease, reqHdr->rpcId, reqHdr->ackId);
+    if (rh.isDuplicate()) {
+        *respHdr = parseRpcResult<WireFormat::ConditionalUpdate>(
+                rh.resultLoc());
+        rpc->sendReply();
+        return;
+    }
+
+    Key key(reqHdr->tableId, stringKey, reqHdr->keyLength);
+    RpcResult rpcResult(reqHdr->tableId, key.getHash(),
+                        reqHdr->lease.leaseId, reqHdr->rpcId, reqHdr->ackId,
+                        respHdr, sizeof(*respHdr));
+    uint32_t newLength;
+    uint64_t rpcResultPtr;
+    updateObject(&key, reqHdr->rejectRules, false, reqHdr->offset, expected,
+                 data, reqHdr->length, &respHdr->version, &respHdr->updated,
+                 &newLength, &respHdr->common.status, &rpcResult,
+                 &rpcResultPtr);
+    finishUpdate(&rh, &rpcResult, respHdr->updated, respHdr->common.status,
+                 &rpcResultPtr);
+}
+
+/**
+ * Top-level server method to handle the COUNT_INDEX_KEYS request.
+ *
+ * \copydetails Service::ping
+ */
+void
+MasterService::countIndexKeys(
+        const WireFormat::CountIndexKeys::Request* reqHdr,
+        WireFormat::CountIndexKeys::Response* respHdr,
+        Rpc* rpc)
+{
+    indexletManager.countIndexKeys(reqHdr, respHdr, rpc);
+}
+
 /**
  * Top-level server method to handle the DROP_TABLET_OWNERSHIP request.
  *
@@ -335,6 +783,44 @@ MasterService::dropTabletOwnership(
                 reqHdr->firstKeyHash, reqHdr->lastKeyHash, reqHdr->tableId);
 }
 
+/**
+ * Delete this master's read replicas (see #syncReadReplica) of any tablets
+ * that overlap a range, along with their objects. This is done before the
+ * master takes on tablets of its own, which must not overlap the replicas;
+ * a replica's possibly stale objects must never be served as current.
+ *
+ * \param tableId
+ *      Identifier of the table the range belongs to.
+ * \param firstKeyHash
+ *      The first key hash value in the range.
+ * \param lastKeyHash
+ *      The last key hash value in the range.
+ */
+void
+MasterService::dropReadReplicas(uint64_t tableId, uint64_t firstKeyHash,
+        uint64_t lastKeyHash)
+{
+    vector<TabletManager::Tablet> tablets;
+    tabletManager.getTablets(&tablets);
+    bool removed = false;
+    foreach (TabletManager::Tablet& tablet, tablets) {
+        if (tablet.tableId != tableId ||
+                tablet.state != TabletManager::READ_REPLICA ||
+                tablet.startKeyHash > lastKeyHash ||
+                tablet.endKeyHash < firstKeyHash)
+            continue;
+        if (tabletManager.deleteTablet(tableId, tablet.startKeyHash,
+                tablet.endKeyHash)) {
+            LOG(NOTICE, "Dropped read replica of tablet [0x%lx,0x%lx] in "
+                    "tableId %lu", tablet.startKeyHash, tablet.endKeyHash,
+                    tableId);
+            removed = true;
+        }
+    }
+    if (removed)
+        objectManager.removeOrphanedObjects();
+}
+
 /**
  * Top-level server method to handle the DROP_INDEXLET_OWNERSHIP request.
  *
@@ -404,6 +890,14 @@ MasterService::enumerate(const WireFormat::Enumerate::Request* reqHdr,
     EnumerationIterator iter(*rpc->requestPayload,
             downCast<uint32_t>(sizeof(*reqHdr)), reqHdr->iteratorBytes);
 
+    Tub<ObjectFilter> filter;
+    if (reqHdr->filterBytes > 0 && !filter.construct()->deserialize(
+            rpc->requestPayload, sizeof32(*reqHdr) + reqHdr->iteratorBytes,
+            reqHdr->filterBytes)) {
+        respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
+        return;
+    }
+
     // Put at most maxPayloadBytes of enumerated objects in the reply. This
     // limit is used to leave enough room in the reply buffer for the response
     // header and also the serialized iteration state at the end of enumeration.
@@ -416,7 +910,7 @@ MasterService::enumerate(const WireFormat::Enumerate::Request* reqHdr,
             &respHdr->tabletFirstHash, iter,
             *objectManager.getLog(),
             *objectManager.getObjectMap(),
-            *rpc->replyPayload, maxPayloadBytes);
+            *rpc->replyPayload, maxPayloadBytes, filter.get());
     enumeration.complete();
     respHdr->payloadBytes = rpc->replyPayload->size()
             - downCast<uint32_t>(sizeof(*respHdr));
@@ -457,6 +951,135 @@ MasterService::getLogMetrics(
             rpc->replyPayload, &logMetrics);
 }
 
+/**
+ * Find the read replica of the tablet containing a key (see
+ * #setReadReplica).
+ *
+ * \param key
+ *      Identifies the tablet.
+ * \param[out] tablet
+ *      Set to the tablet containing \a key, if this master owns it.
+ * \return
+ *      The service locator of the tablet's read replica, or an empty string
+ *      if it has none or this master doesn't own the tablet.
+ */
+string
+MasterService::getReadReplica(Key& key, TabletManager::Tablet* tablet)
+{
+    if (!tabletManager.getTablet(key, tablet) ||
+            tablet->state != TabletManager::NORMAL)
+        return "";
+    ServerId replica = readReplicaFeeder.getReplica(*tablet);
+    if (!replica.isValid())
+        return "";
+    try {
+        return context->serverList->getLocator(replica);
+    } catch (const ServerListException& e) {
+        // The replica has crashed; the feeder will notice soon.
+        return "";
+    }
+}
+
+/**
+ * Return the hash of the key named by a single-object request: the one
+ * the client sent with the request, if the master is configured to trust
+ * it, or else a newly computed one.
+ *
+ * \param tableId
+ *      Table containing the object.
+ * \param key
+ *      The object's primary key.
+ * \param keyLength
+ *      Length of \a key in bytes.
+ * \param clientKeyHash
+ *      The hash from the request's header; 0 means the client didn't
+ *      send one.
+ */
+KeyHash
+MasterService::getRequestKeyHash(uint64_t tableId, const void* key,
+        KeyLength keyLength, KeyHash clientKeyHash)
+{
+    if (config->master.trustClientKeyHashes && clientKeyHash != 0)
+        return clientKeyHash;
+    return Key::getHash(tableId, key, keyLength);
+}
+
+/**
+ * Decide whether to turn away a request because the log is nearly out of
+ * memory. Once config->master.writeBackpressurePercent of the log's memory
+ * is in use, a growing fraction of the requests that add new data to the
+ * log are asked to retry later, from none at that level to all of them when
+ * memory is full, with longer delays the fuller it gets. Clients thus slow
+ * down gradually while the cleaner frees up space, rather than all failing
+ * (and retrying in lockstep) once the log is full. Removes, whose tombstones
+ * are small and let the cleaner free their objects, are always admitted,
+ * as are transactions, which have already locked their objects.
+ *
+ * \param opcode
+ *      The request's opcode.
+ * \param request
+ *      The request.
+ * \return
+ *      0 means the request should be executed. Otherwise it should be
+ *      retried after about this many microseconds.
+ */
+uint32_t
+MasterService::getWriteBackpressure(WireFormat::Opcode opcode,
+        Buffer* request)
+{
+    // Retries are delayed this long for each percent of memory
+    // utilization at or above config->master.writeBackpressurePercent.
+    static const uint32_t DELAY_MICROS_PER_PERCENT = 500;
+
+    switch (opcode) {
+        case WireFormat::APPEND:
+        case WireFormat::CONDITIONAL_UPDATE:
+        case WireFormat::INCREMENT:
+        case WireFormat::WRITE:
+            break;
+        case WireFormat::MULTI_OP:
+        {
+            const WireFormat::MultiOp::Request* reqHdr =
+                    request->getStart<WireFormat::MultiOp::Request>();
+            if (reqHdr == NULL || reqHdr->type == WireFormat::MultiOp::READ ||
+                    reqHdr->type == WireFormat::MultiOp::REMOVE)
+                return 0;
+            break;
+        }
+        default:
+            return 0;
+    }
+
+    // Checking the utilization takes the SegmentManager's lock, so it is
+    // only done every millisecond or so.
+    uint64_t now = Cycles::rdtsc();
+    if (now >= nextUtilizationCheck) {
+        nextUtilizationCheck = now + Cycles::fromMicroseconds(1000);
+        memoryUtilization = objectManager.getSegmentManager()->
+                getMemoryUtilization();
+    }
+    int threshold = downCast<int>(config->master.writeBackpressurePercent);
+    int excess = memoryUtilization - threshold + 1;
+    if (excess <= 0)
+        return 0;
+    if (downCast<int>(generateRandom() % (101 - threshold)) >= excess)
+        return 0;
+    return DELAY_MICROS_PER_PERCENT * excess;
+}
+
+/**
+ * Return the id of the master whose log is in the snapshot this master
+ * found at startup (see MasterSnapshot), or an invalid id if it didn't find
+ * one. If valid, this master should enlist as that master's replacement.
+ */
+ServerId
+MasterService::getRestartSnapshotServerId()
+{
+    if (!restartSnapshot)
+        return ServerId();
+    return restartSnapshot->getServerId();
+}
+
 /**
  * Top-level server method to handle the GET_SERVER_STATISTICS request.
  */
@@ -469,6 +1092,8 @@ MasterService::getServerStatistics(
     ProtoBuf::ServerStatistics serverStats;
     tabletManager.getStatistics(&serverStats);
     SpinLock::getStatistics(serverStats.mutable_spin_lock_stats());
+    context->dispatch->getPollerStatistics(&serverStats);
+    RpcLatency::collect(&serverStats);
     respHdr->serverStatsLength = serializeToResponse(
             rpc->replyPayload, &serverStats);
 }
@@ -582,27 +1207,32 @@ MasterService::increment(const WireFormat::Increment::Request* reqHdr,
     // Read the current value of the object and add the increment value
     Key key(reqHdr->tableId, *rpc->requestPayload, sizeof32(*reqHdr),
             reqHdr->keyLength);
-    Status *status = &respHdr->common.status;
+    PendingIncrement pending(&key, reqHdr->rejectRules,
+            reqHdr->incrementInt64, reqHdr->incrementDouble, reqHdr, respHdr);
+    if (config->master.combineIncrements &&
+            isCombinable(reqHdr->rejectRules)) {
+        combineIncrement(&pending);
+    } else {
+        PendingIncrement* increments[] = {&pending};
+        incrementObject(increments, 1);
+    }
+    respHdr->version = pending.version;
+    respHdr->common.status = pending.status;
 
-    int64_t asInt64 = reqHdr->incrementInt64;
-    double asDouble = reqHdr->incrementDouble;
-    uint64_t rpcResultPtr;
-    incrementObject(&key, reqHdr->rejectRules, &asInt64, &asDouble,
-                    &respHdr->version, status, reqHdr, respHdr, &rpcResultPtr);
-
-    if (*status == STATUS_OK) {
+    if (pending.status == STATUS_OK) {
         objectManager.syncChanges();
-        rh.recordCompletion(rpcResultPtr);
+        rh.recordCompletion(pending.rpcResultPtr);
 
         // Return new value
-        respHdr->newValue.asInt64 = asInt64;
-        respHdr->newValue.asDouble = asDouble;
+        respHdr->newValue.asInt64 = pending.asInt64;
+        respHdr->newValue.asDouble = pending.asDouble;
     } else if (respHdr->common.status != STATUS_RETRY &&
                respHdr->common.status != STATUS_UNKNOWN_TABLET) {
         // Above status requires a client to retry. We should not write
         // RpcResult record in log for the two status values.
 
         // Write RpcResult with failed (by RejectRule) status.
+        uint64_t rpcResultPtr;
         RpcResult rpcResult(reqHdr->tableId, key.getHash(),
                             reqHdr->lease.leaseId, reqHdr->rpcId, reqHdr->ackId,
                             respHdr, sizeof(*respHdr));
@@ -613,49 +1243,25 @@ MasterService::increment(const WireFormat::Increment::Request* reqHdr,
 
 /**
  * Helper function used by increment and multiIncrement to perform the atomic
- * read, increment, write cycle.  Does _not_ sync changes in order to allow
- * for batched synchronization.
- * \param key
- *      The key of the object.  If the object does not exist, it is created as
- *      zero before incrementing.
- * \param rejectRules
- *      Conditions under which reading (thus incrementing) fails
- * \param asInt64
- *      If non-zero, interpret the object as signed, twos-complement, 8 byte
- *      integer and increase by the given value (which might be negative).
- *      On success, asInt64 contains the new value of the object.
- * \param asDouble
- *      If non-zero, interpret the object as IEEE754 double precision floating
- *      point value and increase by the given value (which might be negative).
- *      On success, asDouble contains the new value of the object.
- * \param newVersion
- *      The new version of the incremented object on success.
- * \param status
- *      returns STATUS_OK or a failure code if not successful.
- * \param reqHdr
- *      Header from the incoming RPC request; contains all the
- *      parameters for this operation except the key of the object.
- *      Used for linearizability handling.
- * \param[out] respHdr
- *      Header for the response that will be returned to the client.
- *      The caller has pre-allocated the right amount of space in the
- *      response buffer for this type of request, and has zeroed out
- *      its contents (so, for example, status is already zero).
- *      This must be filled for linearizability handling.
- * \param[out] rpcResultPtr
- *      If non-NULL, pointer to the RpcResult in log is returned.
+ * read, increment, write cycle for one or more increments of the same
+ * object. The increments are applied in order, and all of those that succeed
+ * are written as a single new version of the object, along with an RpcResult
+ * for each of them that came from an INCREMENT request. Does _not_ sync
+ * changes in order to allow for batched synchronization.
+ *
+ * \param increments
+ *      The increments to apply, all to the same object (the one named by
+ *      the first increment's key). Their results are filled in. Unless
+ *      there is only one increment, their reject rules must pass
+ *      isCombinable.
+ * \param count
+ *      Number of entries in increments.
  */
 void
-MasterService::incrementObject(Key *key,
-            RejectRules rejectRules,
-            int64_t *asInt64,
-            double *asDouble,
-            uint64_t *newVersion,
-            Status *status,
-            const WireFormat::Increment::Request* reqHdr,
-            WireFormat::Increment::Response* respHdr,
-            uint64_t *rpcResultPtr)
+MasterService::incrementObject(PendingIncrement** increments, uint32_t count)
 {
+    Key* key = increments[0]->key;
+
     // Read the object and add integer or floating point values in case
     // the summands are non-zero.  It is possible to do both an integer
     // addition and a floating point addition.
@@ -665,7 +1271,12 @@ MasterService::incrementObject(Key *key,
         int64_t asInt64;
         double asDouble;
     } oldValue, newValue;
-    const bool mustExist = rejectRules.doesntExist;
+
+    // A lone increment's reject rules are checked by the read; combined
+    // increments can only fail if the object doesn't exist, which is
+    // checked for each of them below.
+    RejectRules* readRejectRules =
+            (count == 1) ? &increments[0]->rejectRules : NULL;
 
     // Atomic read-increment-write cycle.
     RejectRules updateRejectRules;
@@ -673,24 +1284,27 @@ MasterService::incrementObject(Key *key,
     while (1) {
         ObjectBuffer value;
         uint64_t version = 0;
-        *status =
-            objectManager.readObject(*key, &value, &rejectRules, &version);
-        if (*status == STATUS_OBJECT_DOESNT_EXIST && !mustExist) {
+        bool exists = true;
+        Status status =
+            objectManager.readObject(*key, &value, readRejectRules, &version);
+        if (status == STATUS_OBJECT_DOESNT_EXIST) {
             // If the object doesn't exist, create it either as int64_t(0) or
             // as double(0.0).  Both binary representations of zero are
             // identical.
             oldValue.asInt64 = 0;
-            *status = STATUS_OK;
-        } else {
-            if (*status != STATUS_OK)
-                return;
+            exists = false;
+            status = STATUS_OK;
+        } else if (status == STATUS_OK) {
             uint32_t dataLen;
             oldValue.asInt64 = *value.get<int64_t>(&dataLen);
 
-            if (dataLen != sizeof(oldValue)) {
-                *status = STATUS_INVALID_OBJECT;
-                return;
-            }
+            if (dataLen != sizeof(oldValue))
+                status = STATUS_INVALID_OBJECT;
+        }
+        if (status != STATUS_OK) {
+            for (uint32_t i = 0; i < count; i++)
+                increments[i]->status = status;
+            return;
         }
 
 #ifdef TESTING
@@ -709,15 +1323,43 @@ MasterService::incrementObject(Key *key,
         }
 #endif
 
+        // Apply the increments one at a time, so that each sees exactly the
+        // value it would have if they had been written separately.
         newValue = oldValue;
-        if (*asInt64 != 0) {
-            newValue.asInt64 += *asInt64;
-            if (respHdr) respHdr->newValue.asInt64 = newValue.asInt64;
-        }
-        if (*asDouble != 0.0) {
-            newValue.asDouble += *asDouble;
-            if (respHdr) respHdr->newValue.asDouble = newValue.asDouble;
+        std::deque<RpcResult> rpcResults;
+        vector<RpcResult*> rpcResultPointers;
+        vector<uint64_t*> resultVersions;
+        vector<PendingIncrement*> applied;
+        for (uint32_t i = 0; i < count; i++) {
+            PendingIncrement* pending = increments[i];
+            if (!exists && pending->rejectRules.doesntExist) {
+                pending->status = STATUS_OBJECT_DOESNT_EXIST;
+                continue;
+            }
+            exists = true;
+            if (pending->incrementInt64 != 0)
+                newValue.asInt64 += pending->incrementInt64;
+            if (pending->incrementDouble != 0.0)
+                newValue.asDouble += pending->incrementDouble;
+            pending->status = STATUS_OK;
+            pending->asInt64 = newValue.asInt64;
+            pending->asDouble = newValue.asDouble;
+            applied.push_back(pending);
+
+            WireFormat::Increment::Response* respHdr = pending->respHdr;
+            if (respHdr) {
+                respHdr->common.status = STATUS_OK;
+                respHdr->newValue.asInt64 = newValue.asInt64;
+                rpcResults.emplace_back(pending->reqHdr->tableId,
+                        key->getHash(), pending->reqHdr->lease.leaseId,
+                        pending->reqHdr->rpcId, pending->reqHdr->ackId,
+                        respHdr, sizeof32(*respHdr));
+                rpcResultPointers.push_back(&rpcResults.back());
+                resultVersions.push_back(&respHdr->version);
+            }
         }
+        if (applied.empty())
+            return;
 
         // create object to populate newValueBuffer.
         Buffer newValueBuffer;
@@ -728,23 +1370,269 @@ MasterService::incrementObject(Key *key,
         updateRejectRules.givenVersion = version;
         updateRejectRules.versionNeGiven = true;
 
-        if (respHdr) {
-            KeyLength pKeyLen;
-            const void* pKey = newObject.getKey(0, &pKeyLen);
-            respHdr->common.status = STATUS_OK;
-            RpcResult rpcResult(
-                    reqHdr->tableId,
-                    Key::getHash(reqHdr->tableId, pKey, pKeyLen),
-                    reqHdr->lease.leaseId, reqHdr->rpcId, reqHdr->ackId,
-                    respHdr, sizeof(*respHdr));
-            *status = objectManager.writeObject(newObject, &updateRejectRules,
-                                                newVersion, NULL,
-                                                &rpcResult, rpcResultPtr);
+        vector<uint64_t> rpcResultPtrs(rpcResults.size());
+        uint64_t newVersion = 0;
+        status = objectManager.writeObject(newObject, &updateRejectRules,
+                &newVersion, NULL, rpcResultPointers.data(),
+                rpcResultPtrs.data(), downCast<uint32_t>(rpcResults.size()),
+                resultVersions.data());
+
+        if (status == STATUS_WRONG_VERSION) {
+            TEST_LOG("retry after version mismatch");
+            continue;
+        }
+
+        uint32_t result = 0;
+        foreach (PendingIncrement* pending, applied) {
+            pending->status = status;
+            pending->version = newVersion;
+            if (pending->respHdr)
+                pending->rpcResultPtr = rpcResultPtrs[result++];
+        }
+        if (status == STATUS_OK)
+            PerfStats::threadStats.incrementsCombined += applied.size() - 1;
+        return;
+    }
+}
+
+/**
+ * Apply an increment, combining it with any other increments of the same
+ * object that arrive while it is being applied. The first worker to
+ * increment an object applies its own increment; increments that arrive
+ * meanwhile queue up for the object, and once the first finishes, the
+ * worker of the first of them applies all of the queued increments as a
+ * single new version of the object (see incrementObject), then hands off to
+ * the next. Under contention, a popular counter is therefore written once
+ * per write latency rather than once per increment, and each INCREMENT
+ * still gets its own result (and RpcResult) as if applied on its own.
+ * Workers whose increments are applied by another worker wait for it.
+ *
+ * \param pending
+ *      The increment to apply; its reject rules must pass isCombinable. Its
+ *      results are filled in on return.
+ */
+void
+MasterService::combineIncrement(PendingIncrement* pending)
+{
+    KeyHash keyHash = pending->key->getHash();
+    bool collision = false;
+    {
+        SpinLock::Guard _(incrementMutex);
+        CombinedIncrements& combined = activeIncrements[keyHash];
+        if (combined.key == NULL) {
+            combined.key = pending->key;
+            combined.waiting.push_back(pending);
+            pending->state.store(PendingIncrement::LEADING);
+        } else if (*combined.key == *pending->key) {
+            combined.waiting.push_back(pending);
+        } else {
+            collision = true;
+        }
+    }
+    if (collision) {
+        // A different object with the same hash; don't bother combining.
+        incrementObject(&pending, 1);
+        return;
+    }
+
+    while (pending->state.load() == PendingIncrement::WAITING) {
+        // Another worker will apply our increment (or hand off to us).
+    }
+    if (pending->state.load() == PendingIncrement::DONE)
+        return;
+
+    // Our turn: our own increment is first in the queue; apply it along
+    // with those behind it.
+    vector<PendingIncrement*> batch;
+    {
+        SpinLock::Guard _(incrementMutex);
+        vector<PendingIncrement*>& waiting = activeIncrements[keyHash].waiting;
+        size_t batchSize = waiting.size();
+        if (batchSize > MAX_COMBINED_INCREMENTS)
+            batchSize = MAX_COMBINED_INCREMENTS;
+        batch.assign(waiting.begin(), waiting.begin() + batchSize);
+        waiting.erase(waiting.begin(), waiting.begin() + batchSize);
+    }
+
+    try {
+        incrementObject(&batch[0], downCast<uint32_t>(batch.size()));
+    } catch (...) {
+        // Our own client gets the exception (such as a RetryException); the
+        // others are simply asked to retry, so that none is left waiting.
+        foreach (PendingIncrement* other, batch)
+            other->status = STATUS_RETRY;
+        finishIncrements(keyHash, &batch);
+        throw;
+    }
+    finishIncrements(keyHash, &batch);
+}
+
+/**
+ * Called by combineIncrement once it has applied a batch of increments:
+ * releases the workers waiting for them and hands the object off to the
+ * worker of the next waiting increment, if any.
+ *
+ * \param keyHash
+ *      Identifies the object's entry in activeIncrements.
+ * \param batch
+ *      The increments just applied; the first is the caller's own.
+ */
+void
+MasterService::finishIncrements(KeyHash keyHash,
+        vector<PendingIncrement*>* batch)
+{
+    for (size_t i = 1; i < batch->size(); i++)
+        (*batch)[i]->state.store(PendingIncrement::DONE);
+
+    SpinLock::Guard _(incrementMutex);
+    CombinedIncrements& combined = activeIncrements[keyHash];
+    if (combined.waiting.empty()) {
+        activeIncrements.erase(keyHash);
+    } else {
+        PendingIncrement* next = combined.waiting.front();
+        combined.key = next->key;
+        next->state.store(PendingIncrement::LEADING);
+    }
+}
+
+/**
+ * Returns true if increments with the given reject rules can be combined
+ * with other increments of the same object by combineIncrement: only
+ * increments that depend on nothing but whether the object exists can be
+ * reordered into a single write.
+ */
+bool
+MasterService::isCombinable(const RejectRules& rejectRules)
+{
+    return !rejectRules.exists && !rejectRules.versionLeGiven &&
+            !rejectRules.versionNeGiven;
+}
+
+/**
+ * Helper function used by append, conditionalUpdate and multiUpdate to
+ * perform an atomic read-modify-write cycle on the value of an object, in
+ * the same way as incrementObject. The object's keys are left unchanged.
+ * Does _not_ sync changes in order to allow for batched synchronization.
+ *
+ * \param key
+ *      The key of the object.
+ * \param rejectRules
+ *      Conditions under which reading (thus updating) fails.
+ * \param append
+ *      True means append \a data to the object's value, creating the
+ *      object if it doesn't exist (unless \a rejectRules says otherwise).
+ *      False means replace the bytes at \a offset in the object's value
+ *      with \a data if they're equal to \a expected; the object must exist.
+ * \param offset
+ *      Conditional updates only: offset in the object's value of the bytes
+ *      to compare and replace.
+ * \param expected
+ *      Conditional updates only: the \a length bytes expected at
+ *      \a offset.
+ * \param data
+ *      The \a length bytes to append or store.
+ * \param length
+ *      Number of bytes in \a expected and \a data.
+ * \param[out] newVersion
+ *      The new version of the object if it was updated, else its current
+ *      version.
+ * \param[out] updated
+ *      Set to nonzero if the object was updated; zero if the bytes of a
+ *      conditional update didn't match (which is not an error) or the
+ *      update failed.
+ * \param[out] newLength
+ *      The length of the object's value after the operation.
+ * \param[out] status
+ *      Returns STATUS_OK or a failure code if not successful.
+ * \param rpcResult
+ *      If non-NULL, this is appended to the log atomically with the new
+ *      object (see ObjectManager::writeObject). It must refer to the
+ *      response that the other results are returned in; they're filled in
+ *      before the object is written.
+ * \param[out] rpcResultPtr
+ *      If non-NULL, pointer to the RpcResult in log is returned.
+ */
+void
+MasterService::updateObject(Key* key,
+            RejectRules rejectRules,
+            bool append,
+            uint32_t offset,
+            const void* expected,
+            const void* data,
+            uint32_t length,
+            uint64_t* newVersion,
+            uint8_t* updated,
+            uint32_t* newLength,
+            Status* status,
+            RpcResult* rpcResult,
+            uint64_t* rpcResultPtr)
+{
+    const bool mustExist = !append || rejectRules.doesntExist;
+    *updated = 0;
+
+    // Atomic read-modify-write cycle.
+    RejectRules updateRejectRules;
+    memset(&updateRejectRules, 0, sizeof(updateRejectRules));
+    while (1) {
+        ObjectBuffer oldObject;
+        uint64_t version = 0;
+        const uint8_t* value = NULL;
+        uint32_t valueLength = 0;
+        uint32_t valueOffset = 0;
+        *status = objectManager.readObject(*key, &oldObject, &rejectRules,
+                                           &version);
+        if (*status == STATUS_OBJECT_DOESNT_EXIST && !mustExist) {
+            *status = STATUS_OK;
+        } else {
+            if (*status != STATUS_OK)
+                return;
+            value = static_cast<const uint8_t*>(
+                    oldObject.getValue(&valueLength));
+            oldObject.getValueOffset(&valueOffset);
+        }
+        *newVersion = version;
+        *newLength = valueLength;
+
+        if (append) {
+            if (uint64_t(valueLength) + length > config->maxObjectDataSize) {
+                *status = STATUS_REQUEST_TOO_LARGE;
+                return;
+            }
+        } else if (uint64_t(offset) + length > valueLength ||
+                (length > 0 && memcmp(value + offset, expected, length))) {
+            // The bytes don't match; the object is left as it is.
+            return;
+        }
+
+        // Keep the object's keys, so that its index entries stay valid.
+        Buffer newKeysAndValue;
+        if (value == NULL) {
+            Object::appendKeysAndValueToBuffer(*key, data, length,
+                                               &newKeysAndValue);
+        } else if (append) {
+            newKeysAndValue.appendExternal(&oldObject, 0,
+                                           valueOffset + valueLength);
+            newKeysAndValue.appendExternal(data, length);
         } else {
-            *status = objectManager.writeObject(newObject, &updateRejectRules,
-                                                newVersion);
+            newKeysAndValue.appendExternal(&oldObject, 0,
+                                           valueOffset + offset);
+            newKeysAndValue.appendExternal(data, length);
+            newKeysAndValue.appendExternal(&oldObject,
+                    valueOffset + offset + length,
+                    valueLength - offset - length);
         }
+        if (append)
+            *newLength = valueLength + length;
+
+        Object newObject(key->getTableId(), 0, 0, newKeysAndValue);
+        updateRejectRules.givenVersion = version;
+        updateRejectRules.versionNeGiven = true;
 
+        // Fill in the response before it's copied into the RpcResult.
+        *updated = 1;
+        *status = objectManager.writeObject(newObject, &updateRejectRules,
+                                            newVersion, NULL, rpcResult,
+                                            rpcResultPtr);
         if (*status == STATUS_WRONG_VERSION) {
             TEST_LOG("retry after version mismatch");
         } else {
@@ -753,11 +1641,40 @@ MasterService::incrementObject(Key *key,
     }
 
     if (*status != STATUS_OK)
-        return;
+        *updated = 0;
+}
 
-    // Return new value
-    *asInt64 = newValue.asInt64;
-    *asDouble = newValue.asDouble;
+/**
+ * Helper function used by append and conditionalUpdate to sync an update
+ * made by updateObject and record the RPC's completion, in the same way as
+ * increment.
+ *
+ * \param rh
+ *      Handle for the RPC's entry in #unackedRpcResults.
+ * \param rpcResult
+ *      The RpcResult that was passed to updateObject.
+ * \param updated
+ *      The value returned by updateObject.
+ * \param status
+ *      The status returned by updateObject.
+ * \param rpcResultPtr
+ *      The log reference returned by updateObject; if the object wasn't
+ *      written, the RpcResult is written on its own and this is set to
+ *      its reference.
+ */
+void
+MasterService::finishUpdate(UnackedRpcHandle* rh, RpcResult* rpcResult,
+        uint8_t updated, Status status, uint64_t* rpcResultPtr)
+{
+    if (updated) {
+        objectManager.syncChanges();
+        rh->recordCompletion(*rpcResultPtr);
+    } else if (status != STATUS_RETRY && status != STATUS_UNKNOWN_TABLET) {
+        // Above status requires a client to retry. We should not write
+        // RpcResult record in log for the two status values.
+        objectManager.writeRpcResultOnly(rpcResult, rpcResultPtr);
+        rh->recordCompletion(*rpcResultPtr);
+    }
 }
 
 /**
@@ -796,6 +1713,7 @@ MasterService::initOnceEnlisted()
     objectManager.initOnceEnlisted();
 
     unackedRpcResults.startCleaner();
+    tabletLoadReporter.start();
 
     initCalled = true;
 }
@@ -846,6 +1764,11 @@ MasterService::isReplicaNeeded(
 /**
  * Top-level server method to handle the LOOKUP_INDEX_KEYS request.
  *
+ * If the client asks for it, the response also includes the objects for
+ * the returned hashes, as long as they are stored on this server (which is
+ * common for small tables, where the indexlet and the data tablet end up on
+ * the same master). This saves the client a round of READ_HASHES requests.
+ *
  * \copydetails Service::ping
  */
 void
@@ -855,6 +1778,152 @@ MasterService::lookupIndexKeys(
         Rpc* rpc)
 {
     indexletManager.lookupIndexKeys(reqHdr, respHdr, rpc);
+    if (!reqHdr->fetchObjects || respHdr->common.status != STATUS_OK ||
+            respHdr->numHashes == 0)
+        return;
+
+    // The hashes are already in the response; readHashes stops at the
+    // first one whose tablet isn't stored here. (Its length limit applies
+    // to the whole response buffer, not just the objects it appends.)
+    uint32_t replyLength = rpc->replyPayload->size();
+    try {
+        objectManager.readHashes(reqHdr->tableId, respHdr->numHashes,
+                rpc->replyPayload, sizeof32(*respHdr),
+                maxResponseRpcLen - sizeof32(*respHdr), rpc->replyPayload,
+                &respHdr->numObjectHashes, &respHdr->numObjects);
+    } catch (RetryException& e) {
+        // The tablet is being migrated; the client will read the objects
+        // from wherever they end up.
+        rpc->replyPayload->truncate(replyLength);
+        respHdr->numObjectHashes = 0;
+        respHdr->numObjects = 0;
+    }
+}
+
+/**
+ * Constructor for MigrationStream.
+ *
+ * \param context
+ *      Overall information about this server.
+ * \param receiver
+ *      Master that has agreed to receive the migrated tablet. If this is
+ *      invalid, segments are discarded instead of being sent.
+ * \param tableId
+ *      Table containing the tablet being migrated.
+ * \param firstKeyHash
+ *      Lowest key hash in the range being migrated.
+ * \param clusterClock
+ *      If not NULL, this master's clock, which is exchanged with the
+ *      receiver's on each rpc (see ClusterClock::updateFromPeer).
+ */
+MasterService::MigrationStream::MigrationStream(Context* context,
+        ServerId receiver, uint64_t tableId, uint64_t firstKeyHash,
+        ClusterClock* clusterClock)
+    : context(context)
+    , receiver(receiver)
+    , tableId(tableId)
+    , firstKeyHash(firstKeyHash)
+    , clusterClock(clusterClock)
+    , transfers()
+    , current(0)
+{
+}
+
+/**
+ * Append a log entry to the stream. If the current transfer segment is
+ * full, it is sent and the entry goes in the next one.
+ *
+ * \param type
+ *      Type of the log entry.
+ * \param buffer
+ *      Contents of the log entry.
+ * \return
+ *      False means the entry doesn't fit even in an empty segment.
+ *
+ * \throw ClientException
+ *      An earlier RECEIVE_MIGRATION_DATA rpc failed.
+ */
+bool
+MasterService::MigrationStream::append(LogEntryType type, Buffer& buffer)
+{
+    Tub<Segment>& segment = transfers[current].segment;
+    if (!segment)
+        segment.construct();
+    if (segment->append(type, buffer))
+        return true;
+
+    send();
+    Tub<Segment>& next = transfers[current].segment;
+    next.construct();
+    return next->append(type, buffer);
+}
+
+/**
+ * Send the partially filled transfer segment, if any, then wait for the
+ * receiver to finish processing every segment sent.
+ *
+ * \throw ClientException
+ *      One of the RECEIVE_MIGRATION_DATA rpcs failed.
+ */
+void
+MasterService::MigrationStream::finish()
+{
+    if (transfers[current].segment) {
+        LOG(DEBUG, "Sending last migration segment");
+        send();
+    }
+    foreach (Transfer& transfer, transfers) {
+        if (transfer.rpc)
+            wait(transfer.rpc);
+        transfer.segment.destroy();
+    }
+}
+
+/**
+ * Close the current transfer segment and start an rpc sending it to the
+ * receiver, then advance to the next slot in #transfers, first waiting for
+ * the rpc that last used that slot if it hasn't completed yet.
+ */
+void
+MasterService::MigrationStream::send()
+{
+    Transfer& transfer = transfers[current];
+    transfer.segment->close();
+    LOG(DEBUG, "Sending migration segment");
+    if (expect_true(receiver != ServerId{})) {
+        uint64_t clusterTime = 0;
+        if (clusterClock != NULL)
+            clusterTime = clusterClock->getTime().getEncoded();
+        transfer.rpc.construct(context, receiver, transfer.segment.get(),
+                tableId, firstKeyHash, false, 0lu, uint8_t(0),
+                static_cast<const void*>(NULL), uint16_t(0), clusterTime);
+    }
+
+    current = (current + 1) % MAX_RPCS_IN_FLIGHT;
+    Transfer& next = transfers[current];
+    if (next.rpc)
+        wait(next.rpc);
+    next.segment.destroy();
+}
+
+/**
+ * Wait for one of the stream's rpcs to complete, advance #clusterClock to
+ * the receiver's time, and destroy the rpc.
+ *
+ * \param rpc
+ *      The rpc to wait for.
+ *
+ * \throw ClientException
+ *      The rpc failed.
+ */
+void
+MasterService::MigrationStream::wait(Tub<ReceiveMigrationDataRpc>& rpc)
+{
+    uint64_t clusterTime;
+    rpc->wait(&clusterTime);
+    rpc.destroy();
+    if (clusterClock != NULL)
+        clusterClock->updateFromPeer(ClusterTime(clusterTime));
 }
 
 /**
@@ -869,9 +1938,9 @@ MasterService::lookupIndexKeys(
  *
  * \param it
  *      The iterator that points at the object we are attempting to migrate.
- * \param[out] transferSeg
- *      Segment object that we append objects to, and possibly send when it gets
- *      full.
+ * \param stream
+ *      Live entries are appended here; it sends them on to the receiver
+ *      as transfer segments fill.
  * \param[out] entryTotals
  *      Array indexed by type of the total number of log entries copied into
  *      segments for transfer thus far, which we increment whenever we append an
@@ -886,10 +1955,6 @@ MasterService::lookupIndexKeys(
  *      Lowest key hash that will be migrated.
  * \param lastKeyHash
  *      Highest key hash that will be migrated.
- * \param receiver
- *      ServerId of the master that is receiving the migration data. Each time
- *      a transfer segment fills, this server will be sent an RPC containing
- *      the data.
  * \return
  *      Returns STATUS_OK on success (either the entry is ignored or
  *      successfully added to the segment) or another status failure (an entry
@@ -898,13 +1963,12 @@ MasterService::lookupIndexKeys(
 Status
 MasterService::migrateSingleLogEntry(
         SegmentIterator& it,
-        Tub<Segment>& transferSeg,
+        MigrationStream& stream,
         uint64_t entryTotals[],
         uint64_t& totalBytes,
         uint64_t tableId,
         uint64_t firstKeyHash,
-        uint64_t lastKeyHash,
-        ServerId receiver)
+        uint64_t lastKeyHash)
 {
     LogEntryType type = it.getType();
     if (type != LOG_ENTRY_TYPE_OBJ &&
@@ -1002,28 +2066,11 @@ MasterService::migrateSingleLogEntry(
     entryTotals[type]++;
     totalBytes += buffer.size();
 
-    if (!transferSeg)
-        transferSeg.construct();
-
-    // If we can't fit it, send the current buffer and retry.
-    if (!transferSeg->append(type, buffer)) {
-        transferSeg->close();
-        LOG(DEBUG, "Sending migration segment");
-        if (expect_true(receiver != ServerId{})) {
-            MasterClient::receiveMigrationData(context, receiver,
-                    transferSeg.get(), tableId, firstKeyHash);
-        }
-
-        transferSeg.destroy();
-        transferSeg.construct();
-
-        // If it doesn't fit this time, we're in trouble.
-        if (!transferSeg->append(type, buffer)) {
-            LOG(ERROR, "Tablet migration failed: could not fit object "
-                    "into empty segment (obj bytes %u)",
-                    buffer.size());
-            return STATUS_INTERNAL_ERROR;
-        }
+    if (!stream.append(type, buffer)) {
+        LOG(ERROR, "Tablet migration failed: could not fit object "
+                "into empty segment (obj bytes %u)",
+                buffer.size());
+        return STATUS_INTERNAL_ERROR;
     }
 
     TEST_LOG("Migrated log entry type %s",
@@ -1088,7 +2135,8 @@ MasterService::migrateTablet(const WireFormat::MigrateTablet::Request* reqHdr,
 
     // We'll send over objects in Segment containers for better network
     // efficiency and convenience.
-    Tub<Segment> transferSeg;
+    MigrationStream stream(context, receiver, tableId, firstKeyHash,
+            &clusterClock);
 
     uint64_t entryTotals[TOTAL_LOG_ENTRY_TYPES] = {0};
     uint64_t totalBytes = 0;
@@ -1100,9 +2148,8 @@ MasterService::migrateTablet(const WireFormat::MigrateTablet::Request* reqHdr,
         while (true) {
             Status error = migrateSingleLogEntry(
                     *it.getCurrentSegmentIterator(),
-                    transferSeg, entryTotals, totalBytes,
-                    tableId, firstKeyHash, lastKeyHash,
-                    receiver);
+                    stream, entryTotals, totalBytes,
+                    tableId, firstKeyHash, lastKeyHash);
             if (error) return;
             if (it.onHead())
                 break;
@@ -1126,19 +2173,13 @@ MasterService::migrateTablet(const WireFormat::MigrateTablet::Request* reqHdr,
             break;
         Status error = migrateSingleLogEntry(
                 *it.getCurrentSegmentIterator(),
-                transferSeg, entryTotals, totalBytes,
-                tableId, firstKeyHash, lastKeyHash,
-                receiver);
+                stream, entryTotals, totalBytes,
+                tableId, firstKeyHash, lastKeyHash);
         if (error) return;
     }
 
-    if (transferSeg) {
-        transferSeg->close();
-        LOG(DEBUG, "Sending last migration segment");
-        MasterClient::receiveMigrationData(context, receiver,
-                transferSeg.get(), tableId, firstKeyHash);
-        transferSeg.destroy();
-    }
+    // Send whatever is left and wait for the receiver to take all of it.
+    stream.finish();
 
     // Now that all data has been transferred, we can reassign ownership of
     // the tablet. If this succeeds, we are free to drop the tablet. The
@@ -1169,6 +2210,46 @@ MasterService::migrateTablet(const WireFormat::MigrateTablet::Request* reqHdr,
     objectManager.removeOrphanedObjects();
 }
 
+/**
+ * RPC handler for MODIFY_INDEX_ENTRIES; this RPC is initiated by a data
+ * master to insert or remove a group of index entries corresponding to
+ * several objects that it is writing or removing.
+ *
+ * \copydetails Service::ping
+ */
+void
+MasterService::modifyIndexEntries(
+        const WireFormat::ModifyIndexEntries::Request* reqHdr,
+        WireFormat::ModifyIndexEntries::Response* respHdr,
+        Rpc* rpc)
+{
+    uint32_t reqOffset = sizeof32(*reqHdr);
+    vector<BtreeEntry> entries;
+    entries.reserve(reqHdr->count);
+    for (uint32_t i = 0; i < reqHdr->count; i++) {
+        const WireFormat::ModifyIndexEntries::Entry* entry =
+                rpc->requestPayload->getOffset<
+                WireFormat::ModifyIndexEntries::Entry>(reqOffset);
+        if (entry == NULL) {
+            respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
+            return;
+        }
+        reqOffset += sizeof32(*entry);
+        const void* indexKeyStr = rpc->requestPayload->getRange(
+                reqOffset, entry->indexKeyLength);
+        if (indexKeyStr == NULL) {
+            respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
+            return;
+        }
+        reqOffset += entry->indexKeyLength;
+        entries.emplace_back(indexKeyStr, entry->indexKeyLength,
+                entry->primaryKeyHash);
+    }
+
+    respHdr->common.status = indexletManager.modifyEntries(
+            reqHdr->tableId, reqHdr->indexId, &entries, reqHdr->remove != 0);
+}
+
 /**
  * Multiplexor for the MultiOp opcode.
  */
@@ -1187,6 +2268,9 @@ MasterService::multiOp(const WireFormat::MultiOp::Request* reqHdr,
         case WireFormat::MultiOp::OpType::REMOVE:
             multiRemove(reqHdr, respHdr, rpc);
             break;
+        case WireFormat::MultiOp::OpType::UPDATE:
+            multiUpdate(reqHdr, respHdr, rpc);
+            break;
         case WireFormat::MultiOp::OpType::WRITE:
             multiWrite(reqHdr, respHdr, rpc);
             break;
@@ -1228,8 +2312,12 @@ MasterService::multiIncrement(const WireFormat::MultiOp::Request* reqHdr,
 
     respHdr->count = numRequests;
 
-    // Each iteration extracts one request from request rpc, increments the
-    // corresponding object, and appends the response to the response rpc.
+    // Each iteration extracts one request from request rpc and appends
+    // space for its response to the response rpc; the increments are
+    // carried out once all of the requests have been parsed.
+    std::deque<Key> keys;
+    std::deque<PendingIncrement> parts;
+    vector<WireFormat::MultiOp::Response::IncrementPart*> responses;
     for (uint32_t i = 0; i < numRequests; i++) {
         const WireFormat::MultiOp::Request::IncrementPart *currentReq =
             rpc->requestPayload->getOffset<
@@ -1250,19 +2338,42 @@ MasterService::multiIncrement(const WireFormat::MultiOp::Request* reqHdr,
             break;
         }
 
-        Key key(currentReq->tableId, stringKey, currentReq->keyLength);
-        int64_t asInt64 = currentReq->incrementInt64;
-        double asDouble = currentReq->incrementDouble;
+        keys.emplace_back(currentReq->tableId, stringKey,
+                currentReq->keyLength);
+        parts.emplace_back(&keys.back(), currentReq->rejectRules,
+                currentReq->incrementInt64, currentReq->incrementDouble);
+        responses.push_back(rpc->replyPayload->emplaceAppend<
+                WireFormat::MultiOp::Response::IncrementPart>());
+    }
 
+    // Increments of the same object are applied together, as a single new
+    // version of the object, in the order they appear in the request.
+    vector<bool> applied(parts.size(), false);
+    vector<PendingIncrement*> group;
+    for (size_t i = 0; i < parts.size(); i++) {
+        if (applied[i])
+            continue;
+        group.assign(1, &parts[i]);
+        if (isCombinable(parts[i].rejectRules)) {
+            for (size_t j = i + 1; j < parts.size() &&
+                    group.size() < MAX_COMBINED_INCREMENTS; j++) {
+                if (!applied[j] && keys[j] == keys[i] &&
+                        isCombinable(parts[j].rejectRules)) {
+                    group.push_back(&parts[j]);
+                    applied[j] = true;
+                }
+            }
+        }
+        incrementObject(&group[0], downCast<uint32_t>(group.size()));
+    }
+    for (size_t i = 0; i < parts.size(); i++) {
         WireFormat::MultiOp::Response::IncrementPart* currentResp =
-           rpc->replyPayload->emplaceAppend<
-               WireFormat::MultiOp::Response::IncrementPart>();
-
-        incrementObject(&key, currentReq->rejectRules,
-            &asInt64, &asDouble,
-            &currentResp->version, &currentResp->status);
-        currentResp->newValue.asInt64 = asInt64;
-        currentResp->newValue.asDouble = asDouble;
+                responses[i];
+        currentResp->status = parts[i].status;
+        currentResp->version = parts[i].version;
+        currentResp->newValue.asInt64 = 0;
+        if (parts[i].status == STATUS_OK)
+            currentResp->newValue.asInt64 = parts[i].asInt64;
     }
 
     // All of the individual increments were done asynchronously. We must sync
@@ -1301,11 +2412,35 @@ MasterService::multiRead(const WireFormat::MultiOp::Request* reqHdr,
     uint32_t numRequests = reqHdr->count;
     uint32_t reqOffset = sizeof32(*reqHdr);
 
+    // Objects that don't match the filter are reported as nonexistent.
+    Tub<ObjectFilter> filter;
+    if (reqHdr->filterBytes > 0) {
+        if (!filter.construct()->deserialize(rpc->requestPayload, reqOffset,
+                reqHdr->filterBytes)) {
+            respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
+            return;
+        }
+        reqOffset += reqHdr->filterBytes;
+    }
+
     respHdr->count = numRequests;
     uint32_t oldResponseLength = rpc->replyPayload->size();
 
-    // Each iteration extracts one request from request rpc, finds the
-    // corresponding object, and appends the response to the response rpc.
+    // Objects are looked up a batch at a time with
+    // ObjectManager::readObjects, which overlaps the cache misses for the
+    // keys in a batch. The results are staged in batchValues.
+    Tub<Key> keys[MULTIREAD_BATCH_SIZE];
+    Key* keyPointers[MULTIREAD_BATCH_SIZE];
+    RejectRules rejectRules[MULTIREAD_BATCH_SIZE];
+    Status statuses[MULTIREAD_BATCH_SIZE];
+    uint64_t versions[MULTIREAD_BATCH_SIZE];
+    uint32_t lengths[MULTIREAD_BATCH_SIZE];
+    Buffer batchValues;
+    uint32_t batchSize = 0;
+    uint32_t batchValuesOffset = 0;
+
+    // Each iteration returns the result for one request, reading a new
+    // batch of objects when the previous one has been used up.
     for (uint32_t i = 0; ; i++) {
         // If the RPC response has exceeded the legal limit, truncate it
         // to the last object that fits below the limit (the client will
@@ -1326,36 +2461,84 @@ MasterService::multiRead(const WireFormat::MultiOp::Request* reqHdr,
             break;
         }
 
-        const WireFormat::MultiOp::Request::ReadPart *currentReq =
-                rpc->requestPayload->getOffset<
-                WireFormat::MultiOp::Request::ReadPart>(reqOffset);
-        reqOffset += sizeof32(WireFormat::MultiOp::Request::ReadPart);
+        uint32_t batchIndex = i % MULTIREAD_BATCH_SIZE;
+        if (batchIndex == 0) {
+            // Extract the next batch of requests from the request rpc and
+            // read the corresponding objects. A malformed request ends the
+            // batch early; it is reported when we get to it below.
+            batchSize = 0;
+            while (batchSize < MULTIREAD_BATCH_SIZE &&
+                    i + batchSize < numRequests) {
+                const WireFormat::MultiOp::Request::ReadPart *currentReq =
+                        rpc->requestPayload->getOffset<
+                        WireFormat::MultiOp::Request::ReadPart>(reqOffset);
+                reqOffset += sizeof32(WireFormat::MultiOp::Request::ReadPart);
+
+                const void* stringKey = rpc->requestPayload->getRange(
+                        reqOffset, currentReq->keyLength);
+                reqOffset += currentReq->keyLength;
+
+                if (stringKey == NULL)
+                    break;
+
+                keyPointers[batchSize] = keys[batchSize].construct(
+                        currentReq->tableId, stringKey,
+                        currentReq->keyLength);
+                rejectRules[batchSize] = currentReq->rejectRules;
+                batchSize++;
+            }
 
-        const void* stringKey = rpc->requestPayload->getRange(
-                reqOffset, currentReq->keyLength);
-        reqOffset += currentReq->keyLength;
+            batchValues.reset();
+            batchValuesOffset = 0;
+            objectManager.readObjects(batchSize, keyPointers, rejectRules,
+                    &batchValues, statuses, versions, lengths);
+        }
 
-        if (stringKey == NULL) {
+        if (batchIndex >= batchSize) {
             respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
             break;
         }
 
-        Key key(currentReq->tableId, stringKey, currentReq->keyLength);
-
         WireFormat::MultiOp::Response::ReadPart* currentResp =
                rpc->replyPayload->emplaceAppend<
                WireFormat::MultiOp::Response::ReadPart>();
 
-        uint32_t initialLength = rpc->replyPayload->size();
-        RejectRules rejectRules = currentReq->rejectRules;
-        currentResp->status = objectManager.readObject(
-                key, rpc->replyPayload, &rejectRules,
-                &currentResp->version);
+        currentResp->status = statuses[batchIndex];
+        currentResp->version = versions[batchIndex];
 
         if (currentResp->status != STATUS_OK)
             continue;
 
-        currentResp->length = rpc->replyPayload->size() - initialLength;
+        uint32_t length = lengths[batchIndex];
+        if (filter) {
+            // The value is the last field, so a projection is the keys
+            // followed by part of the value.
+            Object object(keys[batchIndex]->getTableId(),
+                    versions[batchIndex], 0, batchValues,
+                    batchValuesOffset, length);
+            if (!filter->matches(&object)) {
+                currentResp->status = STATUS_OBJECT_DOESNT_EXIST;
+                batchValuesOffset += length;
+                continue;
+            }
+            uint32_t valueLength = object.getValueLength();
+            uint32_t keysLength = length - valueLength;
+            uint32_t projectionOffset;
+            uint32_t projectionLength = filter->project(valueLength,
+                    &projectionOffset);
+            rpc->replyPayload->append(&batchValues, batchValuesOffset,
+                    keysLength);
+            rpc->replyPayload->append(&batchValues,
+                    batchValuesOffset + keysLength + projectionOffset,
+                    projectionLength);
+            batchValuesOffset += length;
+            currentResp->length = keysLength + projectionLength;
+            continue;
+        }
+
+        rpc->replyPayload->append(&batchValues, batchValuesOffset, length);
+        batchValuesOffset += length;
+        currentResp->length = length;
     }
 }
 
@@ -1436,19 +2619,90 @@ MasterService::multiRemove(const WireFormat::MultiOp::Request* reqHdr,
     // reqHdr, respHdr, and rpc are off-limits now!
 
     // Delete old index entries if any.
-    for (uint32_t i = 0; i < numRequests; i++) {
-        if (objectBuffers[i].size() > 0) {
-            Object oldObject(objectBuffers[i]);
-            requestRemoveIndexEntries(oldObject);
-        }
-    }
+    removeOldIndexEntries(objectBuffers, numRequests);
 }
 
 /**
- * Top-level server method to handle the MULTI_WRITE request.
+ * Top-level server method to handle the MULTI_UPDATE request: appends and
+ * conditional updates of several objects (see append and
+ * conditionalUpdate).
  *
  * \param reqHdr
- *      Header from the incoming RPC request. Lists the number of writes
+ *      Header from the incoming RPC request. Lists the number of updates
+ *      contained in this request.
+ * \param[out] respHdr
+ *      Header for the response that will be returned to the client.
+ *      The caller has pre-allocated the right amount of space in the
+ *      response buffer for this type of request, and has zeroed out
+ *      its contents (so, for example, status is already zero).
+ * \param[out] rpc
+ *      Complete information about the remote procedure call.
+ *      It contains the key and operands for each update, as well as
+ *      RejectRules to support conditional updates.
+ */
+void
+MasterService::multiUpdate(const WireFormat::MultiOp::Request* reqHdr,
+        WireFormat::MultiOp::Response* respHdr,
+        Rpc* rpc)
+{
+    uint32_t numRequests = reqHdr->count;
+    uint32_t reqOffset = sizeof32(*reqHdr);
+
+    respHdr->count = numRequests;
+
+    // Each iteration extracts one request from request rpc, updates the
+    // corresponding object, and appends the response to the response rpc.
+    for (uint32_t i = 0; i < numRequests; i++) {
+        const WireFormat::MultiOp::Request::UpdatePart *currentReq =
+            rpc->requestPayload->getOffset<
+                WireFormat::MultiOp::Request::UpdatePart>(reqOffset);
+
+        if (currentReq == NULL) {
+            respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
+            break;
+        }
+
+        reqOffset += sizeof32(WireFormat::MultiOp::Request::UpdatePart);
+        const void* stringKey = rpc->requestPayload->getRange(
+            reqOffset, currentReq->keyLength);
+        reqOffset += currentReq->keyLength;
+        const void* expected = NULL;
+        if (!currentReq->append) {
+            expected = rpc->requestPayload->getRange(reqOffset,
+                                                     currentReq->length);
+            reqOffset += currentReq->length;
+        }
+        const void* data = rpc->requestPayload->getRange(reqOffset,
+                                                         currentReq->length);
+        reqOffset += currentReq->length;
+
+        if (stringKey == NULL || (currentReq->length > 0 && (data == NULL
+                || (!currentReq->append && expected == NULL)))) {
+            respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
+            break;
+        }
+
+        Key key(currentReq->tableId, stringKey, currentReq->keyLength);
+        WireFormat::MultiOp::Response::UpdatePart* currentResp =
+           rpc->replyPayload->emplaceAppend<
+               WireFormat::MultiOp::Response::UpdatePart>();
+
+        updateObject(&key, currentReq->rejectRules, currentReq->append,
+                     currentReq->offset, expected, data, currentReq->length,
+                     &currentResp->version, &currentResp->updated,
+                     &currentResp->newLength, &currentResp->status);
+    }
+
+    // All of the individual updates were done asynchronously. We must sync
+    // them to backups before returning to the caller.
+    objectManager.syncChanges();
+}
+
+/**
+ * Top-level server method to handle the MULTI_WRITE request.
+ *
+ * \param reqHdr
+ *      Header from the incoming RPC request. Lists the number of writes
  *      contained in this request.
  * \param[out] respHdr
  *      Header for the response that will be returned to the client.
@@ -1475,9 +2729,12 @@ MasterService::multiWrite(const WireFormat::MultiOp::Request* reqHdr,
     // Buffer on stack.
     Buffer oldObjectBuffers[numRequests];
 
-    // Each iteration extracts one request from the rpc, writes the object
-    // if possible, and appends a status and version to the response buffer.
-    for (uint32_t i = 0; i < numRequests; i++) {
+    // Extract all of the objects from the request first, so that the index
+    // entries for all of them can be inserted together.
+    Tub<Object> objects[numRequests];
+    const WireFormat::MultiOp::Request::WritePart* requests[numRequests];
+    uint32_t numParsed = 0;
+    for (; numParsed < numRequests; numParsed++) {
         const WireFormat::MultiOp::Request::WritePart *currentReq =
                 rpc->requestPayload->getOffset<
                 WireFormat::MultiOp::Request::WritePart>(reqOffset);
@@ -1493,28 +2750,36 @@ MasterService::multiWrite(const WireFormat::MultiOp::Request* reqHdr,
             respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
             break;
         }
+        objects[numParsed].construct(currentReq->tableId, 0, 0,
+                *(rpc->requestPayload), reqOffset, currentReq->length);
+        requests[numParsed] = currentReq;
+        reqOffset += currentReq->length;
+    }
+
+    // Insert new index entries, if any, before writing the objects (for
+    // strong consistency).
+    vector<Object*> indexedObjects;
+    for (uint32_t i = 0; i < numParsed; i++)
+        indexedObjects.push_back(objects[i].get());
+    requestModifyIndexEntries(&indexedObjects, false);
+
+    // Each iteration writes one object if possible, and appends a status
+    // and version to the response buffer.
+    for (uint32_t i = 0; i < numParsed; i++) {
         WireFormat::MultiOp::Response::WritePart* currentResp =
                 rpc->replyPayload->emplaceAppend<
                 WireFormat::MultiOp::Response::WritePart>();
 
-        Object object(currentReq->tableId, 0, 0, *(rpc->requestPayload),
-                reqOffset, currentReq->length);
-
-        // Insert new index entries, if any, before writing object (for strong
-        // consistency).
-        requestInsertIndexEntries(object);
-
         // Write the object.
-        RejectRules rejectRules = currentReq->rejectRules;
+        RejectRules rejectRules = requests[i]->rejectRules;
         try {
             currentResp->status = objectManager.writeObject(
-                    object, &rejectRules, &currentResp->version,
+                    *objects[i], &rejectRules, &currentResp->version,
                     &oldObjectBuffers[i]);
         }
         catch (RetryException& e) {
             currentResp->status = STATUS_RETRY;
         }
-        reqOffset += currentReq->length;
     }
 
     // By design, our response will be shorter than the request. This ensures
@@ -1532,12 +2797,7 @@ MasterService::multiWrite(const WireFormat::MultiOp::Request* reqHdr,
 
     // It is possible that some of the writes overwrote pre-existing values.
     // So, delete old index entries if any.
-    for (uint32_t i = 0; i < numRequests; i++) {
-        if (oldObjectBuffers[i].size() > 0) {
-            Object oldObject(oldObjectBuffers[i]);
-            requestRemoveIndexEntries(oldObject);
-        }
-    }
+    removeOldIndexEntries(oldObjectBuffers, numRequests);
 }
 
 /**
@@ -1608,6 +2868,8 @@ MasterService::prepForMigration(
     // Open question: Are there situations where we should decline this request?
 
     // Try to add the tablet. If it fails, there's some overlapping tablet.
+    dropReadReplicas(reqHdr->tableId, reqHdr->firstKeyHash,
+            reqHdr->lastKeyHash);
     bool added = tabletManager.addTablet(reqHdr->tableId,
             reqHdr->firstKeyHash, reqHdr->lastKeyHash,
             TabletManager::RECOVERING);
@@ -1677,13 +2939,133 @@ MasterService::read(const WireFormat::Read::Request* reqHdr,
         return;
     }
 
-    Key key(reqHdr->tableId, stringKey, reqHdr->keyLength);
+    Key key(reqHdr->tableId, stringKey, reqHdr->keyLength,
+            getRequestKeyHash(reqHdr->tableId, stringKey, reqHdr->keyLength,
+            reqHdr->keyHash));
 
     RejectRules rejectRules = reqHdr->rejectRules;
     bool valueOnly = true;
     uint32_t initialLength = rpc->replyPayload->size();
-    respHdr->common.status = objectManager.readObject(
-            key, rpc->replyPayload, &rejectRules, &respHdr->version, valueOnly);
+    if (reqHdr->snapshotTime != 0) {
+        respHdr->snapshotTime = reqHdr->snapshotTime;
+        respHdr->common.status = objectManager.readObjectAtTime(key,
+                reqHdr->snapshotTime, rpc->replyPayload, &rejectRules,
+                &respHdr->version, valueOnly);
+    } else {
+        respHdr->snapshotTime = objectManager.getSnapshotTime();
+        respHdr->common.status = objectManager.readObject(key,
+                rpc->replyPayload, &rejectRules, &respHdr->version, valueOnly);
+    }
+
+    if (respHdr->common.status != STATUS_OK)
+        return;
+
+    respHdr->length = rpc->replyPayload->size() - initialLength;
+}
+
+/**
+ * Top-level server method to handle the READ_CHANGES request, which streams
+ * the changes to a tablet to a ChangeStreamReceiver in another cluster.
+ *
+ * \copydetails Service::ping
+ */
+void
+MasterService::readChanges(
+        const WireFormat::ReadChanges::Request* reqHdr,
+        WireFormat::ReadChanges::Response* respHdr,
+        Rpc* rpc)
+{
+    if (config->master.changeStreamBytes == 0) {
+        respHdr->common.status = STATUS_UNIMPLEMENTED_REQUEST;
+        return;
+    }
+
+    TabletManager::Tablet tablet;
+    if (!tabletManager.getTablet(reqHdr->tableId, reqHdr->firstKeyHash,
+            reqHdr->lastKeyHash, &tablet) ||
+            tablet.state != TabletManager::NORMAL) {
+        respHdr->common.status = STATUS_UNKNOWN_TABLET;
+        return;
+    }
+
+    respHdr->streamId = serverId.getId();
+    if (reqHdr->position == WireFormat::ReadChanges::Request::SUBSCRIBE) {
+        respHdr->nextPosition = changeStream.subscribe(reqHdr->tableId);
+        return;
+    }
+
+    Buffer changes;
+    if (!changeStream.read(reqHdr->tableId, reqHdr->firstKeyHash,
+            reqHdr->lastKeyHash, reqHdr->position,
+            std::min(reqHdr->maxBytes, maxResponseRpcLen - sizeof32(*respHdr)),
+            &changes, &respHdr->nextPosition, &respHdr->lagMicros)) {
+        LOG(NOTICE, "Changes to tablet [0x%lx,0x%lx] in tableId %lu at "
+                "position %lu are no longer in the change stream",
+                reqHdr->firstKeyHash, reqHdr->lastKeyHash, reqHdr->tableId,
+                reqHdr->position);
+        metrics->changeStream.lostCount++;
+        respHdr->positionLost = 1;
+        return;
+    }
+
+    uint32_t length = changes.size();
+    respHdr->length = length;
+    metrics->changeStream.sentBytes += length;
+    if (length == 0)
+        return;
+
+    // Changes travel over long links, so compress them when that saves a
+    // useful amount (as BackupClient does for replication).
+    uint32_t headerLength = rpc->replyPayload->size();
+    uint32_t capacity = length - length / 8;
+    uint32_t compressedLength = Lz4::compress(changes.getRange(0, length),
+            length, rpc->replyPayload->alloc(capacity), capacity);
+    if (compressedLength != 0) {
+        rpc->replyPayload->truncate(headerLength + compressedLength);
+        respHdr->compressedLength = compressedLength;
+        metrics->changeStream.sentCompressedBytes += compressedLength;
+    } else {
+        rpc->replyPayload->truncate(headerLength);
+        rpc->replyPayload->append(&changes);
+        metrics->changeStream.sentCompressedBytes += length;
+    }
+}
+
+/**
+ * Top-level server method to handle the READ_FROM_REPLICA request: like
+ * READ, except that if this master holds a read replica of the object's
+ * tablet, the replica may serve the read as long as it isn't too stale.
+ *
+ * \copydetails MasterService::read
+ */
+void
+MasterService::readFromReplica(
+        const WireFormat::ReadFromReplica::Request* reqHdr,
+        WireFormat::ReadFromReplica::Response* respHdr,
+        Rpc* rpc)
+{
+    uint32_t reqOffset = sizeof32(*reqHdr);
+    const void* stringKey = rpc->requestPayload->getRange(
+            reqOffset, reqHdr->keyLength);
+
+    if (stringKey == NULL) {
+        respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
+        rpc->sendReply();
+        return;
+    }
+
+    Key key(reqHdr->tableId, stringKey, reqHdr->keyLength);
+
+    // Replicas synced before this time are too stale. A replica that has
+    // never been synced has a sync time of 0 and is always rejected.
+    uint64_t now = Cycles::rdtsc();
+    uint64_t maxStaleness = Cycles::fromMicroseconds(
+            reqHdr->maxStalenessMicros);
+    uint64_t oldestSync = (now > maxStaleness) ? now - maxStaleness : 1;
+
+    uint32_t initialLength = rpc->replyPayload->size();
+    respHdr->common.status = objectManager.readObject(key,
+            rpc->replyPayload, NULL, &respHdr->version, true, oldestSync);
 
     if (respHdr->common.status != STATUS_OK)
         return;
@@ -1755,6 +3137,10 @@ MasterService::receiveMigrationData(
     uint64_t firstKeyHash = reqHdr->firstKeyHash;
     uint32_t segmentBytes = reqHdr->segmentBytes;
 
+    // Masters exchange their clocks on these rpcs (see MigrationStream).
+    clusterClock.updateFromPeer(ClusterTime(reqHdr->clusterTime));
+    respHdr->clusterTime = clusterClock.getTime().getEncoded();
+
     LOG(NOTICE, "Receiving %u bytes of migration data for tablet [0x%lx,??] "
             "in tableId %lu", segmentBytes, firstKeyHash, tableId);
 
@@ -1770,7 +3156,10 @@ MasterService::receiveMigrationData(
         return;
     }
 
-    if (tablet.state != TabletManager::RECOVERING) {
+    // Read replicas are kept up to date with the same RPCs (see
+    // ReadReplicaFeeder).
+    if (tablet.state != TabletManager::RECOVERING &&
+            tablet.state != TabletManager::READ_REPLICA) {
         LOG(WARNING, "migration data received for tablet not in the "
                 "RECOVERING state (state = %d)!",
                 static_cast<int>(tablet.state));
@@ -1841,7 +3230,9 @@ MasterService::remove(const WireFormat::Remove::Request* reqHdr,
         return;
     }
 
-    Key key(reqHdr->tableId, stringKey, reqHdr->keyLength);
+    Key key(reqHdr->tableId, stringKey, reqHdr->keyLength,
+            getRequestKeyHash(reqHdr->tableId, stringKey, reqHdr->keyLength,
+            reqHdr->keyHash));
 
     // Buffer for object being removed, so we can remove corresponding
     // index entries later.
@@ -1919,6 +3310,62 @@ MasterService::removeIndexEntry(
             indexKeyStr, reqHdr->indexKeyLength, reqHdr->primaryKeyHash);
 }
 
+/**
+ * Helper function used by multiWrite and multiRemove to remove the index
+ * entries of the objects that they overwrote or removed.
+ *
+ * \param objectBuffers
+ *      Array of buffers, each of which is either empty or contains an
+ *      object whose index entries should be removed.
+ * \param numBuffers
+ *      Number of elements in \a objectBuffers.
+ */
+void
+MasterService::removeOldIndexEntries(Buffer* objectBuffers,
+        uint32_t numBuffers)
+{
+    Tub<Object> oldObjects[numBuffers];
+    vector<Object*> objects;
+    for (uint32_t i = 0; i < numBuffers; i++) {
+        if (objectBuffers[i].size() > 0) {
+            oldObjects[i].construct(objectBuffers[i]);
+            objects.push_back(oldObjects[i].get());
+        }
+    }
+    requestModifyIndexEntries(&objects, true);
+}
+
+/**
+ * Return the index of the first key of objects in a table that may be
+ * indexed: 0 if the table has an index on its primary keys (an index with
+ * id 0; see TableManager::createIndex), which makes range scans over its
+ * primary keys possible with IndexLookup, or 1 otherwise. Write and remove
+ * handlers use this to decide whether to update the primary key index.
+ *
+ * Whether the index exists is remembered in the table's
+ * MasterTableMetadata::Entry. Until this master learns that the index
+ * exists, it asks the ObjectFinder, which fetches the table's configuration
+ * from the coordinator once; after that the ObjectFinder's cached
+ * configuration is checked, which is cheap, so that dropping the index is
+ * noticed once an index operation finds the indexlet gone. Tables without
+ * the index pay for just one lookup here; buildIndex marks a table as
+ * indexed when its primary key index is created.
+ *
+ * \param tableId
+ *      The table whose objects are being written or removed.
+ */
+KeyCount
+MasterService::firstIndexedKey(uint64_t tableId)
+{
+    MasterTableMetadata::Entry* entry =
+            masterTableMetadata.findOrCreate(tableId);
+    if (entry->primaryKeyIndexed == 0)
+        return 1;
+    bool indexed = context->objectFinder->hasIndex(tableId, 0);
+    entry->primaryKeyIndexed = indexed ? 1 : 0;
+    return indexed ? 0 : 1;
+}
+
 /**
  * Helper function used by write methods in this class to send requests
  * for inserting index entries (corresponding to the object being written)
@@ -1929,20 +3376,21 @@ MasterService::removeIndexEntry(
 void
 MasterService::requestInsertIndexEntries(Object& object)
 {
+    uint64_t tableId = object.getTableId();
     KeyCount keyCount = object.getKeyCount();
-    if (keyCount <= 1)
+    KeyCount firstKey = firstIndexedKey(tableId);
+    if (keyCount <= firstKey)
         return;
 
-    uint64_t tableId = object.getTableId();
     KeyLength primaryKeyLength;
     const void* primaryKey = object.getKey(0, &primaryKeyLength);
     KeyHash primaryKeyHash =
             Key(tableId, primaryKey, primaryKeyLength).getHash();
 
-    Tub<InsertIndexEntryRpc> rpcs[keyCount-1];
+    Tub<InsertIndexEntryRpc> rpcs[keyCount];
 
     // Send rpcs to all index servers involved.
-    for (KeyCount keyIndex = 1; keyIndex <= keyCount - 1; keyIndex++) {
+    for (KeyCount keyIndex = firstKey; keyIndex < keyCount; keyIndex++) {
         KeyLength keyLength;
         const void* key = object.getKey(keyIndex, &keyLength);
 
@@ -1954,15 +3402,150 @@ MasterService::requestInsertIndexEntries(Object& object)
                             keyLength).c_str(),
                     primaryKeyHash);
 
-            rpcs[keyIndex-1].construct(this, tableId, keyIndex,
+            rpcs[keyIndex].construct(this, tableId, keyIndex,
                     key, keyLength, primaryKeyHash);
         }
     }
 
     // Wait to receive response to all rpcs.
-    for (KeyCount keyIndex = 1; keyIndex <= keyCount - 1; keyIndex++) {
-        if (rpcs[keyIndex-1]) {
-            rpcs[keyIndex-1]->wait();
+    for (KeyCount keyIndex = firstKey; keyIndex < keyCount; keyIndex++) {
+        if (rpcs[keyIndex]) {
+            rpcs[keyIndex]->wait();
+        }
+    }
+}
+
+/**
+ * Helper function used by multiWrite and multiRemove to send requests for
+ * inserting or removing the index entries of many objects at once. Entries
+ * are grouped by the index server that owns them, so that each server gets
+ * one MODIFY_INDEX_ENTRIES request for all of its entries (or a few, if they
+ * don't fit in one RPC) instead of one request per entry.
+ *
+ * \param objects
+ *      Objects for which index entries are to be inserted or removed.
+ * \param remove
+ *      True means remove the objects' index entries; false means insert
+ *      them.
+ * \param indexId
+ *      If nonnegative, only the entries for this index are inserted or
+ *      removed.
+ */
+void
+MasterService::requestModifyIndexEntries(vector<Object*>* objects,
+        bool remove, int indexId)
+{
+    // Identifies the entries that go in the same request: the index they
+    // belong to and the server that owns them.
+    typedef std::tuple<uint64_t, uint8_t, Transport::Session*> Destination;
+    std::map<Destination, vector<IndexEntry>> groups;
+
+    // Holds the sessions in #groups until all of the RPCs are done.
+    vector<Transport::SessionRef> sessions;
+
+    foreach (Object* object, *objects) {
+        uint64_t tableId = object->getTableId();
+        KeyCount keyCount = object->getKeyCount();
+        KeyCount firstKey = firstIndexedKey(tableId);
+        if (keyCount <= firstKey)
+            continue;
+
+        KeyLength primaryKeyLength;
+        const void* primaryKey = object->getKey(0, &primaryKeyLength);
+        KeyHash primaryKeyHash =
+                Key(tableId, primaryKey, primaryKeyLength).getHash();
+
+        for (KeyCount keyIndex = firstKey; keyIndex < keyCount; keyIndex++) {
+            KeyLength keyLength;
+            if (indexId >= 0 && keyIndex != indexId)
+                continue;
+            const void* key = object->getKey(keyIndex, &keyLength);
+            if (key == NULL || keyLength == 0)
+                continue;
+
+            RAMCLOUD_LOG(DEBUG, "%s index entry for tableId %lu, "
+                    "keyIndex %u, key %s, primaryKeyHash %lu",
+                    remove ? "Removing" : "Inserting", tableId, keyIndex,
+                    string(reinterpret_cast<const char*>(key),
+                            keyLength).c_str(),
+                    primaryKeyHash);
+
+            // If the index doesn't exist, there's nothing to do for this
+            // entry (see InsertIndexEntryRpc::indexletNotFound).
+            Transport::SessionRef session = context->objectFinder->lookup(
+                    tableId, keyIndex, key, keyLength);
+            if (session == Transport::SessionRef())
+                continue;
+            sessions.push_back(session);
+            groups[Destination(tableId, keyIndex, session.get())].push_back(
+                    {key, keyLength, primaryKeyHash});
+        }
+    }
+
+    // Split each group into RPCs that fit within the maximum RPC size.
+    struct Chunk {
+        uint64_t tableId;
+        uint8_t indexId;
+        const IndexEntry* entries;
+        uint32_t numEntries;
+    };
+    vector<Chunk> chunks;
+    for (auto& group : groups) {
+        vector<IndexEntry>& entries = group.second;
+        uint32_t maxLength = Transport::MAX_RPC_LEN -
+                sizeof32(WireFormat::ModifyIndexEntries::Request);
+        uint32_t length = 0;
+        size_t first = 0;
+        for (size_t i = 0; i < entries.size(); i++) {
+            uint32_t entryLength = entries[i].keyLength +
+                    sizeof32(WireFormat::ModifyIndexEntries::Entry);
+            if (i > first && length + entryLength > maxLength) {
+                chunks.push_back({std::get<0>(group.first),
+                        std::get<1>(group.first), &entries[first],
+                        downCast<uint32_t>(i - first)});
+                first = i;
+                length = 0;
+            }
+            length += entryLength;
+        }
+        chunks.push_back({std::get<0>(group.first), std::get<1>(group.first),
+                &entries[first], downCast<uint32_t>(entries.size() - first)});
+    }
+    if (chunks.empty())
+        return;
+
+    // Send all of the rpcs, then wait for them.
+    Tub<ModifyIndexEntriesRpc> rpcs[chunks.size()];
+    for (size_t i = 0; i < chunks.size(); i++) {
+        rpcs[i].construct(this, chunks[i].tableId, chunks[i].indexId, remove,
+                chunks[i].entries, chunks[i].numEntries);
+    }
+    for (size_t i = 0; i < chunks.size(); i++) {
+        if (rpcs[i]->wait())
+            continue;
+
+        // The entries no longer all live on one server (e.g., an indexlet
+        // moved or split since we last refreshed our configuration), so
+        // fall back to sending them one at a time.
+        const Chunk& chunk = chunks[i];
+        if (remove) {
+            Tub<RemoveIndexEntryRpc> singleRpcs[chunk.numEntries];
+            for (uint32_t j = 0; j < chunk.numEntries; j++) {
+                singleRpcs[j].construct(this, chunk.tableId, chunk.indexId,
+                        chunk.entries[j].key, chunk.entries[j].keyLength,
+                        chunk.entries[j].primaryKeyHash);
+            }
+            for (uint32_t j = 0; j < chunk.numEntries; j++)
+                singleRpcs[j]->wait();
+        } else {
+            Tub<InsertIndexEntryRpc> singleRpcs[chunk.numEntries];
+            for (uint32_t j = 0; j < chunk.numEntries; j++) {
+                singleRpcs[j].construct(this, chunk.tableId, chunk.indexId,
+                        chunk.entries[j].key, chunk.entries[j].keyLength,
+                        chunk.entries[j].primaryKeyHash);
+            }
+            for (uint32_t j = 0; j < chunk.numEntries; j++)
+                singleRpcs[j]->wait();
         }
     }
 }
@@ -1978,20 +3561,21 @@ MasterService::requestInsertIndexEntries(Object& object)
 void
 MasterService::requestRemoveIndexEntries(Object& object)
 {
+    uint64_t tableId = object.getTableId();
     KeyCount keyCount = object.getKeyCount();
-    if (keyCount <= 1)
+    KeyCount firstKey = firstIndexedKey(tableId);
+    if (keyCount <= firstKey)
         return;
 
-    uint64_t tableId = object.getTableId();
     KeyLength primaryKeyLength;
     const void* primaryKey = object.getKey(0, &primaryKeyLength);
     KeyHash primaryKeyHash =
             Key(tableId, primaryKey, primaryKeyLength).getHash();
 
-    Tub<RemoveIndexEntryRpc> rpcs[keyCount-1];
+    Tub<RemoveIndexEntryRpc> rpcs[keyCount];
 
     // Send rpcs to all index servers involved.
-    for (KeyCount keyIndex = 1; keyIndex <= keyCount - 1; keyIndex++) {
+    for (KeyCount keyIndex = firstKey; keyIndex < keyCount; keyIndex++) {
         KeyLength keyLength;
         const void* key = object.getKey(keyIndex, &keyLength);
 
@@ -2003,15 +3587,15 @@ MasterService::requestRemoveIndexEntries(Object& object)
                             keyLength).c_str(),
                     primaryKeyHash);
 
-            rpcs[keyIndex-1].construct(this, tableId, keyIndex,
+            rpcs[keyIndex].construct(this, tableId, keyIndex,
                     key, keyLength, primaryKeyHash);
         }
     }
 
     // Wait to receive response to all rpcs.
-    for (KeyCount keyIndex = 1; keyIndex <= keyCount - 1; keyIndex++) {
-        if (rpcs[keyIndex-1]) {
-            rpcs[keyIndex-1]->wait();
+    for (KeyCount keyIndex = firstKey; keyIndex < keyCount; keyIndex++) {
+        if (rpcs[keyIndex]) {
+            rpcs[keyIndex]->wait();
         }
     }
 }
@@ -2180,6 +3764,112 @@ MasterService::migrateSingleIndexObject(
     return 0;
 }
 
+/**
+ * Save a snapshot of this master's log in the file given by
+ * ServerConfig::Master::restartSnapshotPath, before a planned shutdown.
+ * When the master is restarted it enlists as the replacement for this one,
+ * and then recovers the data in the snapshot from the file instead of
+ * reading it from backups (see MasterSnapshot). The coordinator still
+ * recovers this master as if it had crashed, so data written after the
+ * snapshot isn't lost; it's just read from backups.
+ *
+ * \throw Exception
+ *      There's no snapshot path, or the snapshot couldn't be written.
+ */
+void
+MasterService::saveRestartSnapshot()
+{
+    if (config->master.restartSnapshotPath.empty())
+        throw Exception(HERE, "master has no restartSnapshotPath");
+
+    // Rolling the head over syncs everything before the new head to
+    // backups, and nothing more will be appended to the older segments
+    // (other than by the cleaner, which writes new survivor segments). The
+    // RPC's epoch keeps the segments from being freed while they're saved.
+    uint64_t headSegmentId =
+            objectManager.getLog()->rollHeadOver().getSegmentId();
+    LogSegmentVector segments;
+    objectManager.getLog()->getSegments(segments);
+    MasterSnapshot::save(config->master.restartSnapshotPath, serverId,
+            headSegmentId, segments);
+}
+
+/**
+ * Give a tablet that this master owns a read replica on another master, or
+ * stop replicating it (see RamCloud::setReadReplica). The replica is
+ * created and kept up to date by #readReplicaFeeder.
+ *
+ * \param key
+ *      Identifies the tablet: the one containing this key.
+ * \param replica
+ *      The master that should hold the tablet's read replica, replacing
+ *      any existing one; an invalid id means the tablet should no longer
+ *      have one.
+ * \return
+ *      STATUS_OK, STATUS_UNKNOWN_TABLET if this master doesn't own the
+ *      tablet, or STATUS_INVALID_PARAMETER if \a replica is this master.
+ */
+Status
+MasterService::setReadReplica(Key& key, ServerId replica)
+{
+    TabletManager::Tablet tablet;
+    if (!tabletManager.getTablet(key, &tablet) ||
+            tablet.state != TabletManager::NORMAL)
+        return STATUS_UNKNOWN_TABLET;
+    if (replica == serverId)
+        return STATUS_INVALID_PARAMETER;
+    LOG(NOTICE, "Read replica of tablet [0x%lx,0x%lx] in tableId %lu is now "
+            "%s", tablet.startKeyHash, tablet.endKeyHash, tablet.tableId,
+            replica.isValid() ? replica.toString().c_str() : "none");
+    readReplicaFeeder.setReplica(tablet, replica);
+    return STATUS_OK;
+}
+
+/**
+ * Handle an update from a master whose tablet this master holds a read
+ * replica of (see ReadReplicaFeeder): the replica is created if need be,
+ * and its sync time is recorded, after which reads that accept data that
+ * stale may use it.
+ *
+ * \param sync
+ *      Describes the replica and how up to date it is.
+ * \return
+ *      STATUS_OK, or STATUS_OBJECT_EXISTS if the replica would overlap one
+ *      of this master's other tablets.
+ */
+Status
+MasterService::syncReadReplica(const WireFormat::ReadReplicaSync* sync)
+{
+    TabletManager::Tablet tablet;
+    if (!tabletManager.getTablet(sync->tableId, sync->firstKeyHash,
+            sync->lastKeyHash, &tablet)) {
+        if (!tabletManager.addTablet(sync->tableId, sync->firstKeyHash,
+                sync->lastKeyHash, TabletManager::READ_REPLICA)) {
+            LOG(WARNING, "Can't hold read replica of tablet [0x%lx,0x%lx] "
+                    "in tableId %lu: it overlaps one of this master's "
+                    "tablets", sync->firstKeyHash, sync->lastKeyHash,
+                    sync->tableId);
+            return STATUS_OBJECT_EXISTS;
+        }
+        LOG(NOTICE, "Holding read replica of tablet [0x%lx,0x%lx] in "
+                "tableId %lu", sync->firstKeyHash, sync->lastKeyHash,
+                sync->tableId);
+    } else if (tablet.state != TabletManager::READ_REPLICA) {
+        LOG(WARNING, "Can't hold read replica of tablet [0x%lx,0x%lx] in "
+                "tableId %lu: this master owns it", sync->firstKeyHash,
+                sync->lastKeyHash, sync->tableId);
+        return STATUS_OBJECT_EXISTS;
+    }
+
+    if (sync->ageMicros != WireFormat::ReadReplicaSync::NOT_SYNCED) {
+        uint64_t now = Cycles::rdtsc();
+        uint64_t age = Cycles::fromMicroseconds(sync->ageMicros);
+        tabletManager.setSyncTime(sync->tableId, sync->firstKeyHash,
+                sync->lastKeyHash, (now > age) ? now - age : 1);
+    }
+    return STATUS_OK;
+}
+
 /**
  * Top-level server method to handle the SPLIT_AND_MIGRAGE_INDEXLET request.
  *
@@ -2382,6 +4072,8 @@ MasterService::takeTabletOwnership(
         logEverSynced = true;
     }
 
+    dropReadReplicas(reqHdr->tableId, reqHdr->firstKeyHash,
+            reqHdr->lastKeyHash);
     bool added = tabletManager.addTablet(reqHdr->tableId,
             reqHdr->firstKeyHash, reqHdr->lastKeyHash,
             TabletManager::NORMAL);
@@ -2461,7 +4153,7 @@ MasterService::takeIndexletOwnership(
             reqHdr->tableId, reqHdr->indexId, reqHdr->backingTableId,
             firstKey, reqHdr->firstKeyLength,
             firstNotOwnedKey, reqHdr->firstNotOwnedKeyLength,
-            IndexletManager::Indexlet::NORMAL);
+            IndexletManager::Indexlet::NORMAL, 0, reqHdr->indexType);
     LOG(NOTICE, "Took ownership of indexlet in tableId %lu indexId %u",
             reqHdr->tableId, reqHdr->indexId);
 
@@ -2761,12 +4453,28 @@ MasterService::txPrepare(const WireFormat::TxPrepare::Request* reqHdr,
         return;
     }
 
+    // If this request holds every operation of the transaction, they are
+    // all on this server, so it can commit them on its own, in one shot.
+    if (reqHdr->opCount == participantCount &&
+            txCommitOneShot(reqHdr, respHdr, rpc, reqOffset)) {
+        return;
+    }
+
     ParticipantList participantList(participants,
                                     participantCount,
                                     reqHdr->lease.leaseId,
                                     reqHdr->clientTxId);
     TransactionId txId = participantList.getTransactionId();
-    {
+
+    // Read-only transactions are only validated: nothing is prepared, so
+    // there is nothing to recover and the participant list isn't logged.
+    // A transaction is read-only iff its first operation is (see below).
+    const WireFormat::TxPrepare::OpType* firstType =
+            rpc->requestPayload->getOffset<
+            WireFormat::TxPrepare::OpType>(reqOffset);
+    bool readOnly = firstType != NULL &&
+            *firstType == WireFormat::TxPrepare::READONLY;
+    if (!readOnly) {
         // Scope to ensure the paricipantList is tracked before processing
         // the prepareOps.
         UnackedRpcHandle participantListHandle(&unackedRpcResults,
@@ -2940,6 +4648,13 @@ MasterService::txPrepare(const WireFormat::TxPrepare::Request* reqHdr,
             break;
         }
 
+        // The participant list wasn't logged, so nothing may be prepared.
+        if (readOnly) {
+            respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
+            respHdr->vote = WireFormat::TxPrepare::ABORT;
+            break;
+        }
+
         rpcHandles.emplace_back(&unackedRpcResults,
                                 reqHdr->lease,
                                 rpcId,
@@ -3049,6 +4764,151 @@ MasterService::txPrepare(const WireFormat::TxPrepare::Request* reqHdr,
     rpc->sendReply();
 }
 
+/**
+ * Helper for #txPrepare that commits a transaction whose operations are
+ * all on this server without preparing them: the operations are validated
+ * and applied together, and their new objects, tombstones, and RpcResults
+ * are logged in a single atomic append. Neither PreparedOps nor the
+ * participant list are logged, since the transaction never needs to be
+ * recovered.
+ *
+ * \param reqHdr
+ *      Header from the incoming TX_PREPARE request; it must hold every
+ *      operation of the transaction.
+ * \param[out] respHdr
+ *      Header for the response that will be returned to the client.
+ * \param rpc
+ *      Complete information about the remote procedure call.
+ * \param reqOffset
+ *      Offset of the first operation in the request.
+ * \return
+ *      True if the request has been handled (and the response sent), or
+ *      false if it must be handled by the regular prepare path instead
+ *      (for example, for read-only transactions, which log nothing).
+ */
+bool
+MasterService::txCommitOneShot(const WireFormat::TxPrepare::Request* reqHdr,
+        WireFormat::TxPrepare::Response* respHdr,
+        Rpc* rpc, uint32_t reqOffset)
+{
+    uint32_t numOps = reqHdr->opCount;
+    Buffer keyBuffers[numOps];
+    Tub<PreparedOp> ops[numOps];
+    RejectRules rejectRules[numOps];
+    for (uint32_t i = 0; i < numOps; i++) {
+        const WireFormat::TxPrepare::OpType* type =
+                rpc->requestPayload->getOffset<
+                WireFormat::TxPrepare::OpType>(reqOffset);
+        if (type == NULL) {
+            return false;
+        } else if (*type == WireFormat::TxPrepare::WRITE) {
+            const WireFormat::TxPrepare::Request::WriteOp* currentReq =
+                    rpc->requestPayload->getOffset<
+                    WireFormat::TxPrepare::Request::WriteOp>(reqOffset);
+            reqOffset += sizeof32(WireFormat::TxPrepare::Request::WriteOp);
+            if (currentReq == NULL || rpc->requestPayload->size() <
+                                      reqOffset + currentReq->length)
+                return false;
+            ops[i].construct(*type, reqHdr->lease.leaseId,
+                             reqHdr->clientTxId, currentReq->rpcId,
+                             currentReq->tableId, 0, 0,
+                             *(rpc->requestPayload), reqOffset,
+                             currentReq->length);
+            rejectRules[i] = currentReq->rejectRules;
+            reqOffset += currentReq->length;
+        } else if (*type == WireFormat::TxPrepare::READ ||
+                   *type == WireFormat::TxPrepare::REMOVE) {
+            // ReadOp and RemoveOp have the same layout.
+            const WireFormat::TxPrepare::Request::ReadOp* currentReq =
+                    rpc->requestPayload->getOffset<
+                    WireFormat::TxPrepare::Request::ReadOp>(reqOffset);
+            reqOffset += sizeof32(WireFormat::TxPrepare::Request::ReadOp);
+            if (currentReq == NULL || rpc->requestPayload->size() <
+                                      reqOffset + currentReq->keyLength)
+                return false;
+            keyBuffers[i].emplaceAppend<KeyCount>((unsigned char) 1);
+            keyBuffers[i].emplaceAppend<CumulativeKeyLength>(
+                    currentReq->keyLength);
+            keyBuffers[i].appendExternal(rpc->requestPayload, reqOffset,
+                                         currentReq->keyLength);
+            ops[i].construct(*type, reqHdr->lease.leaseId,
+                             reqHdr->clientTxId, currentReq->rpcId,
+                             currentReq->tableId, 0, 0, keyBuffers[i]);
+            rejectRules[i] = currentReq->rejectRules;
+            reqOffset += currentReq->keyLength;
+        } else {
+            return false;
+        }
+    }
+
+    clusterClock.updateClock(ClusterTime(reqHdr->lease.timestamp));
+
+    // The operations are logged atomically, so a retry of this request is
+    // either a duplicate for all of them or for none.
+    std::vector<UnackedRpcHandle> rpcHandles;
+    rpcHandles.reserve(numOps);
+    for (uint32_t i = 0; i < numOps; i++) {
+        uint64_t rpcId = ops[i]->header.rpcId;
+        rpcHandles.emplace_back(&unackedRpcResults, reqHdr->lease,
+                                rpcId, reqHdr->ackId);
+        if (rpcHandles.back().isDuplicate()) {
+            respHdr->vote = parsePrepRpcResult(
+                    rpcHandles.back().resultLoc());
+            rpc->sendReply();
+            return true;
+        }
+    }
+
+    WireFormat::TxPrepare::Vote vote = WireFormat::TxPrepare::COMMITTED;
+    std::deque<RpcResult> results;
+    std::vector<PreparedOp*> opPtrs;
+    std::vector<RejectRules*> rejectRulePtrs;
+    std::vector<RpcResult*> resultPtrs;
+    for (uint32_t i = 0; i < numOps; i++) {
+        uint64_t tableId = ops[i]->object.getTableId();
+        uint64_t rpcId = ops[i]->header.rpcId;
+        KeyLength pKeyLen;
+        const void* pKey = ops[i]->object.getKey(0, &pKeyLen);
+        results.emplace_back(tableId, Key::getHash(tableId, pKey, pKeyLen),
+                             reqHdr->lease.leaseId, rpcId,
+                             reqHdr->ackId, &vote, sizeof32(vote));
+        opPtrs.push_back(ops[i].get());
+        rejectRulePtrs.push_back(&rejectRules[i]);
+        resultPtrs.push_back(&results.back());
+    }
+
+    std::vector<uint64_t> rpcResultLogRefs;
+    bool isCommitVote;
+    try {
+        respHdr->common.status = objectManager.commitTransaction(opPtrs,
+                rejectRulePtrs, resultPtrs, &rpcResultLogRefs, &isCommitVote);
+        if (respHdr->common.status != STATUS_OK) {
+            // Nothing was logged (for example, a tablet has moved); the
+            // client will retry.
+            respHdr->vote = WireFormat::TxPrepare::ABORT;
+        } else if (isCommitVote) {
+            respHdr->vote = WireFormat::TxPrepare::COMMITTED;
+            for (uint32_t i = 0; i < numOps; i++)
+                rpcHandles[i].recordCompletion(rpcResultLogRefs[i]);
+        } else {
+            vote = WireFormat::TxPrepare::ABORT;
+            respHdr->vote = WireFormat::TxPrepare::ABORT;
+            for (uint32_t i = 0; i < numOps; i++) {
+                uint64_t rpcResultPtr;
+                objectManager.writePrepareFail(resultPtrs[i], &rpcResultPtr);
+                rpcHandles[i].recordCompletion(rpcResultPtr);
+            }
+        }
+    } catch (RetryException& e) {
+        objectManager.syncChanges();
+        throw;
+    }
+
+    objectManager.syncChanges();
+    rpc->sendReply();
+    return true;
+}
+
 /**
  * Top-level server method to handle the WRITE request.
  *
@@ -3062,9 +4922,20 @@ MasterService::write(const WireFormat::Write::Request* reqHdr,
     assert(reqHdr->rpcId > 0);
     UnackedRpcHandle rh(&unackedRpcResults,
                         reqHdr->lease, reqHdr->rpcId, reqHdr->ackId);
+    // Writes to some tables (such as caches) need not wait for all of the
+    // backups, or any of them.
+    uint32_t ackReplicas = objectManager.getTableDurability(reqHdr->tableId);
+    bool waitForAllBackups = (ackReplicas == ~0u);
     if (rh.isDuplicate()) {
         *respHdr = parseRpcResult<WireFormat::Write>(rh.resultLoc());
-        rpc->sendReply();
+        if (config->master.deferWriteReplies && waitForAllBackups) {
+            // The original write recorded its completion before it was
+            // necessarily durable (see below), so its reply must still
+            // wait for the log.
+            durabilityQueue.deferReply(rpc);
+        } else {
+            rpc->sendReply();
+        }
         return;
     }
 
@@ -3096,125 +4967,562 @@ MasterService::write(const WireFormat::Write::Request* reqHdr,
             reqHdr->lease.leaseId, reqHdr->rpcId, reqHdr->ackId,
             respHdr, sizeof(*respHdr));
 
-    // Write the object.
-    respHdr->common.status = objectManager.writeObject(
-            object, &rejectRules, &respHdr->version, &oldObjectBuffer,
-            &rpcResult, &rpcResultPtr);
+    // Write the object.
+    respHdr->common.status = objectManager.writeObject(
+            object, &rejectRules, &respHdr->version, &oldObjectBuffer,
+            &rpcResult, &rpcResultPtr);
+
+    if (respHdr->common.status == STATUS_OK) {
+        if (!config->master.deferWriteReplies || !waitForAllBackups)
+            objectManager.syncChanges(ackReplicas);
+        rh.recordCompletion(rpcResultPtr); // Complete only if RpcResult is
+                                           // written.
+                                           // Otherwise, RPC state should reset
+                                           // especially for STATUS_RETRY.
+        if (config->master.deferWriteReplies && waitForAllBackups) {
+            // Free this worker instead of having it wait for backups; the
+            // dispatch thread will reply once the write is durable.
+            durabilityQueue.deferReply(rpc);
+        }
+    } else if (respHdr->common.status != STATUS_RETRY &&
+               respHdr->common.status != STATUS_UNKNOWN_TABLET) {
+        // Above status requires a client to retry. We should not write
+        // RpcResult record in log for the two status values.
+
+        // Write RpcResult with failed (by RejectRule) status.
+        objectManager.writeRpcResultOnly(&rpcResult, &rpcResultPtr);
+        rh.recordCompletion(rpcResultPtr);
+    }
+
+    // If this is a overwrite, delete old index entries if any (this can
+    // be done asynchronously after sending a reply).
+    if (oldObjectBuffer.size() > 0) {
+        Object oldObject(oldObjectBuffer);
+        if (oldObject.getKeyCount() >
+                firstIndexedKey(oldObject.getTableId())) {
+            rpc->sendReply();
+            requestRemoveIndexEntries(oldObject);
+        }
+    }
+}
+
+/**
+ * Top-level server method to handle the WRITE_FRAGMENT request, which
+ * holds part of the value of a streaming write until the client sends
+ * COMMIT_WRITE (see ObjectWriteStream).
+ *
+ * \copydetails MasterService::read
+ */
+void
+MasterService::writeFragment(const WireFormat::WriteFragment::Request* reqHdr,
+        WireFormat::WriteFragment::Response* respHdr,
+        Rpc* rpc)
+{
+    uint32_t length = reqHdr->length;
+    if (rpc->requestPayload->size() != sizeof32(*reqHdr) + length) {
+        respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
+        return;
+    }
+
+    // Turn away fragments for tablets we don't own right away, so that the
+    // client finds the right master before sending the rest of the value.
+    TabletManager::Tablet tablet;
+    if (!tabletManager.getTablet(reqHdr->tableId, reqHdr->keyHash, &tablet)) {
+        respHdr->common.status = STATUS_UNKNOWN_TABLET;
+        return;
+    }
+    if (tablet.state != TabletManager::NORMAL) {
+        respHdr->common.status = STATUS_RETRY;
+        return;
+    }
+    respHdr->common.status = writeStreams.addFragment(reqHdr->streamId,
+            reqHdr->tableId, reqHdr->keyHash, reqHdr->offset,
+            rpc->requestPayload, sizeof32(*reqHdr), length);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/////Migration support code.                                              /////
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Constructor for MigrationMonitor objects.
+ * \param owner
+ *      The MasterService that controls/uses this object.
+ */
+MasterService::MigrationMonitor::MigrationMonitor(MasterService* owner)
+        : WorkerTimer(owner->context->dispatch)
+        , owner(owner)
+        , mutex("MigrationMonitor")
+        , incomingMigrations()
+        , protector()
+        , wakeupInterval(Cycles::fromSeconds(1.0))
+        , startTime()
+{
+}
+
+/**
+ * This method is invoked whenever an inbound migration starts (i.e.
+ * we prepare to accept tablet data from another server). It arranges for
+ * that migration to be monitored appropriately.
+ * \param tableId
+ *      Identifier for the table containing the tablet that is incoming.
+ * \param startKeyHash
+ *      Lowest key hash that will be contained in the incoming tablet.
+ * \param endKeyHash
+ *      Highest key hash that will be contained in the incoming tablet
+ */
+void
+MasterService::MigrationMonitor::migrationStarting(uint64_t tableId,
+        uint64_t startKeyHash, uint64_t endKeyHash)
+{
+    SpinLock::Guard guard(mutex);
+    incomingMigrations.emplace_back(tableId, startKeyHash, endKeyHash);
+    if (!protector) {
+        protector.construct(&owner->objectManager);
+    }
+    if (!isRunning()) {
+        startTime = Cycles::rdtsc();
+        start(startTime + wakeupInterval);
+    }
+}
+
+/**
+ * This method is invoked at regular intervals by WorkerTimer whenever
+ * there is at least one migration running. It releases the
+ * TombstoneProtector when all of the migrations finish, and it prints
+ * warning messages if migrations take too long to finish.
+ */
+void
+MasterService::MigrationMonitor::handleTimerEvent()
+{
+    SpinLock::Guard guard(mutex);
+
+    // Delete information for any migrations that have completed.
+    // Immigration is considered to have finished when its tablet
+    // state becomes NORMAL, or if the tablet ceases to exist.
+    std::vector<TabletId>::iterator it = incomingMigrations.begin();
+    while (it != incomingMigrations.end()) {
+        TabletId* id = &(*it);
+        TabletManager::Tablet tabletInfo;
+        bool found = owner->tabletManager.getTablet(id->tableId,
+                id->startKeyHash, id->endKeyHash, &tabletInfo);
+        if (!found || tabletInfo.state == TabletManager::TabletState::NORMAL) {
+            it = incomingMigrations.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // See if all of the migrations have completed.
+    if (incomingMigrations.empty()) {
+        protector.destroy();
+        return;
+    }
+
+    uint64_t now = Cycles::rdtsc();
+    double elapsed = Cycles::toSeconds(now - startTime);
+    if (elapsed > 30.0) {
+        LOG(WARNING, "Inbound migrations have been running continuously "
+                "for %.0f seconds; is it possible that something is hung?",
+                elapsed);
+    }
+    start(Cycles::rdtsc() + wakeupInterval);
+}
+
+/**
+ * Constructor for TabletLoadReporter objects.
+ * \param owner
+ *      The MasterService that controls/uses this object.
+ */
+MasterService::TabletLoadReporter::TabletLoadReporter(MasterService* owner)
+        : WorkerTimer(owner->context->dispatch)
+        , owner(owner)
+        , wakeupInterval(Cycles::fromSeconds(
+                owner->config->master.tabletLoadReportInterval))
+        , lastCounts()
+        , lastReportIdle(false)
+{
+}
+
+/**
+ * Begin sending periodic reports, unless they are disabled. Called once
+ * the master has enlisted, since the coordinator only accepts reports for
+ * servers it knows about.
+ */
+void
+MasterService::TabletLoadReporter::start()
+{
+    if (wakeupInterval != 0)
+        WorkerTimer::start(Cycles::rdtsc() + wakeupInterval);
+}
+
+/**
+ * This method is invoked by WorkerTimer once per report interval. It
+ * collects the number of reads and writes on each tablet (and the lookups
+ * and writes on each indexlet) since the previous report and hands them to
+ * the ReplicaManager to send to the coordinator.
+ */
+void
+MasterService::TabletLoadReporter::handleTimerEvent()
+{
+    vector<TabletManager::Tablet> tablets;
+    owner->tabletManager.getTablets(&tablets);
+
+    ProtoBuf::MasterRecoveryInfo load;
+    std::map<TabletKey, Counts> counts;
+    bool idle = true;
+    foreach (TabletManager::Tablet& tablet, tablets) {
+        if (tablet.state != TabletManager::NORMAL)
+            continue;
+        TabletKey key(tablet.tableId, tablet.startKeyHash);
+        counts[key] = Counts(tablet.readCount, tablet.writeCount);
+
+        // Counts restart from 0 if a tablet is dropped and recreated.
+        Counts last = lastCounts[key];
+        if (last.first > tablet.readCount || last.second > tablet.writeCount)
+            last = Counts(0, 0);
+        uint64_t reads = tablet.readCount - last.first;
+        uint64_t writes = tablet.writeCount - last.second;
+        if (reads != 0 || writes != 0)
+            idle = false;
+
+        ProtoBuf::MasterRecoveryInfo::TabletLoad& entry =
+                *load.add_tablet_load();
+        entry.set_table_id(tablet.tableId);
+        entry.set_start_key_hash(tablet.startKeyHash);
+        entry.set_end_key_hash(tablet.endKeyHash);
+        entry.set_read_count(reads);
+        entry.set_write_count(writes);
+    }
+    lastCounts.swap(counts);
+
+    owner->indexletManager.getIndexletLoads(&owner->masterTableMetadata,
+            &load);
+    foreach (const ProtoBuf::MasterRecoveryInfo::IndexletLoad& entry,
+            load.indexlet_load()) {
+        if (entry.lookup_count() != 0 || entry.write_count() != 0)
+            idle = false;
+    }
+
+    if (!(idle && lastReportIdle))
+        owner->objectManager.getReplicaManager()->updateTabletLoad(load);
+    lastReportIdle = idle;
+    WorkerTimer::start(Cycles::rdtsc() + wakeupInterval);
+}
+
+/**
+ * Constructor for ReadReplicaFeeder objects.
+ * \param owner
+ *      The MasterService that controls/uses this object.
+ */
+MasterService::ReadReplicaFeeder::ReadReplicaFeeder(MasterService* owner)
+        : WorkerTimer(owner->context->dispatch)
+        , owner(owner)
+        , wakeupInterval(Cycles::fromMicroseconds(
+                uint64_t(owner->config->master.readReplicaSyncMs) * 1000))
+        , mutex("MasterService::ReadReplicaFeeder::mutex")
+        , replicas()
+        , dropped()
+{
+}
+
+/**
+ * Return the master holding a tablet's read replica, or an invalid id if
+ * the tablet has none.
+ *
+ * \param tablet
+ *      One of the owner's tablets.
+ */
+ServerId
+MasterService::ReadReplicaFeeder::getReplica(
+        const TabletManager::Tablet& tablet)
+{
+    SpinLock::Guard _(mutex);
+    std::map<TabletKey, Replica>::iterator it =
+            replicas.find(TabletKey(tablet.tableId, tablet.startKeyHash));
+    if (it == replicas.end() || it->second.lastKeyHash != tablet.endKeyHash)
+        return ServerId();
+    return it->second.serverId;
+}
+
+/**
+ * Give one of the owner's tablets a read replica, replacing any it has. The
+ * first round for the new replica starts right away.
+ *
+ * \param tablet
+ *      The tablet to replicate.
+ * \param replica
+ *      The master that should hold the replica; an invalid id removes the
+ *      tablet's replica.
+ */
+void
+MasterService::ReadReplicaFeeder::setReplica(
+        const TabletManager::Tablet& tablet, ServerId replica)
+{
+    SpinLock::Guard _(mutex);
+    TabletKey key(tablet.tableId, tablet.startKeyHash);
+    std::map<TabletKey, Replica>::iterator it = replicas.find(key);
+    if (it != replicas.end()) {
+        if (it->second.serverId == replica &&
+                it->second.lastKeyHash == tablet.endKeyHash)
+            return;
+        dropped.push_back(*it);
+        replicas.erase(it);
+    }
+    if (replica.isValid()) {
+        Replica* newReplica = &replicas[key];
+        newReplica->serverId = replica;
+        newReplica->lastKeyHash = tablet.endKeyHash;
+    }
+    if (wakeupInterval != 0)
+        WorkerTimer::start(0);
+}
+
+/**
+ * This method is invoked by WorkerTimer once per sync interval. It deletes
+ * replicas that are no longer wanted and then runs a round for each of the
+ * others (see #sync).
+ */
+void
+MasterService::ReadReplicaFeeder::handleTimerEvent()
+{
+    vector<std::pair<TabletKey, Replica>> work;
+    vector<std::pair<TabletKey, Replica>> unwanted;
+    {
+        SpinLock::Guard _(mutex);
+        work.assign(replicas.begin(), replicas.end());
+        unwanted.swap(dropped);
+    }
+    for (size_t i = 0; i < unwanted.size(); i++)
+        drop(unwanted[i].first, unwanted[i].second);
+
+    for (size_t i = 0; i < work.size(); i++) {
+        bool keep = sync(work[i].first, &work[i].second);
+        SpinLock::Guard _(mutex);
+        std::map<TabletKey, Replica>::iterator it =
+                replicas.find(work[i].first);
+        if (it == replicas.end() ||
+                it->second.serverId != work[i].second.serverId) {
+            // The replica was replaced or removed during the round; it is
+            // now in #dropped.
+            continue;
+        }
+        if (keep) {
+            it->second = work[i].second;
+        } else {
+            replicas.erase(it);
+            dropped.push_back(work[i]);
+        }
+    }
+
+    SpinLock::Guard _(mutex);
+    if (wakeupInterval != 0 && (!replicas.empty() || !dropped.empty()))
+        WorkerTimer::start(Cycles::rdtsc() + wakeupInterval);
+}
 
-    if (respHdr->common.status == STATUS_OK) {
-        objectManager.syncChanges();
-        rh.recordCompletion(rpcResultPtr); // Complete only if RpcResult is
-                                           // written.
-                                           // Otherwise, RPC state should reset
-                                           // especially for STATUS_RETRY.
-    } else if (respHdr->common.status != STATUS_RETRY &&
-               respHdr->common.status != STATUS_UNKNOWN_TABLET) {
-        // Above status requires a client to retry. We should not write
-        // RpcResult record in log for the two status values.
+/**
+ * Delete a read replica from the master holding it.
+ *
+ * \param key
+ *      Identifies the replicated tablet.
+ * \param replica
+ *      The replica to delete.
+ */
+void
+MasterService::ReadReplicaFeeder::drop(const TabletKey& key,
+        const Replica& replica)
+{
+    try {
+        MasterClient::dropTabletOwnership(owner->context, replica.serverId,
+                key.first, key.second, replica.lastKeyHash);
+    } catch (const ServerNotUpException& e) {
+        // The replica's master has crashed, taking the replica with it.
+    }
+}
 
-        // Write RpcResult with failed (by RejectRule) status.
-        objectManager.writeRpcResultOnly(&rpcResult, &rpcResultPtr);
-        rh.recordCompletion(rpcResultPtr);
+/**
+ * Run one round for a read replica: send it the log entries for its tablet
+ * that it may not have yet, then tell it how up to date it is.
+ *
+ * \param key
+ *      Identifies the replicated tablet.
+ * \param replica
+ *      The replica to update; its position in the log is advanced if the
+ *      round succeeds.
+ * \return
+ *      False means the replica should be deleted: the owner no longer has
+ *      the tablet, or the replica's master has crashed.
+ */
+bool
+MasterService::ReadReplicaFeeder::sync(const TabletKey& key,
+        Replica* replica)
+{
+    uint64_t tableId = key.first;
+    uint64_t firstKeyHash = key.second;
+    uint64_t lastKeyHash = replica->lastKeyHash;
+    TabletManager::Tablet tablet;
+    if (!owner->tabletManager.getTablet(tableId, firstKeyHash, lastKeyHash,
+            &tablet)) {
+        LOG(NOTICE, "No longer own tablet [0x%lx,0x%lx] in tableId %lu; "
+                "deleting its read replica on %s", firstKeyHash, lastKeyHash,
+                tableId, replica->serverId.toString().c_str());
+        return false;
+    }
+    if (tablet.state != TabletManager::NORMAL) {
+        // The tablet is being migrated, for example; try again next round.
+        return true;
     }
 
-    // If this is a overwrite, delete old index entries if any (this can
-    // be done asynchronously after sending a reply).
-    if (oldObjectBuffer.size() > 0) {
-        Object oldObject(oldObjectBuffer);
-        if (oldObject.getKeyCount() > 1) {
-            rpc->sendReply();
-            requestRemoveIndexEntries(oldObject);
+    WireFormat::ReadReplicaSync sync = {tableId, firstKeyHash, lastKeyHash,
+            WireFormat::ReadReplicaSync::NOT_SYNCED};
+    uint64_t start = Cycles::rdtsc();
+    Log* log = owner->objectManager.getLog();
+    uint64_t headSegmentId = log->getHead().getSegmentId();
+    uint64_t firstSegmentId = replica->firstSegmentId;
+    if (replica->rounds % FULL_SYNC_ROUNDS == 0)
+        firstSegmentId = 0;
+    try {
+        if (replica->rounds == 0) {
+            PingClient::serverControl(owner->context, replica->serverId,
+                    WireFormat::SYNC_READ_REPLICA, &sync, sizeof32(sync));
+        }
+
+        MigrationStream stream(owner->context, replica->serverId, tableId,
+                firstKeyHash, &owner->clusterClock);
+        uint64_t entryTotals[TOTAL_LOG_ENTRY_TYPES] = {0};
+        uint64_t totalBytes = 0;
+        for (LogIterator it(*log, firstSegmentId); !it.isDone(); it.next()) {
+            // Reads only need objects and tombstones.
+            LogEntryType type = it.getType();
+            if (type != LOG_ENTRY_TYPE_OBJ && type != LOG_ENTRY_TYPE_OBJTOMB)
+                continue;
+            if (owner->migrateSingleLogEntry(*it.getCurrentSegmentIterator(),
+                    stream, entryTotals, totalBytes, tableId, firstKeyHash,
+                    lastKeyHash) != STATUS_OK)
+                return true;
         }
+        stream.finish();
+
+        sync.ageMicros = downCast<uint32_t>(std::min<uint64_t>(
+                Cycles::toMicroseconds(Cycles::rdtsc() - start),
+                WireFormat::ReadReplicaSync::NOT_SYNCED - 1));
+        PingClient::serverControl(owner->context, replica->serverId,
+                WireFormat::SYNC_READ_REPLICA, &sync, sizeof32(sync));
+    } catch (const ServerNotUpException& e) {
+        LOG(WARNING, "Master %s holding the read replica of tablet "
+                "[0x%lx,0x%lx] in tableId %lu has crashed",
+                replica->serverId.toString().c_str(), firstKeyHash,
+                lastKeyHash, tableId);
+        return false;
+    } catch (const ClientException& e) {
+        LOG(WARNING, "Couldn't update read replica of tablet [0x%lx,0x%lx] "
+                "in tableId %lu on %s: %s", firstKeyHash, lastKeyHash,
+                tableId, replica->serverId.toString().c_str(),
+                e.toString());
+        return true;
     }
+    replica->firstSegmentId = headSegmentId;
+    replica->rounds++;
+    return true;
 }
 
-///////////////////////////////////////////////////////////////////////////////
-/////Migration support code.                                              /////
-///////////////////////////////////////////////////////////////////////////////
-
 /**
- * Constructor for MigrationMonitor objects.
+ * Constructor for DurabilityQueue objects.
  * \param owner
  *      The MasterService that controls/uses this object.
  */
-MasterService::MigrationMonitor::MigrationMonitor(MasterService* owner)
-        : WorkerTimer(owner->context->dispatch)
-        , owner(owner)
-        , mutex("MigrationMonitor")
-        , incomingMigrations()
-        , protector()
-        , wakeupInterval(Cycles::fromSeconds(1.0))
-        , startTime()
+MasterService::DurabilityQueue::DurabilityQueue(MasterService* owner)
+    : Dispatch::Poller(owner->context->dispatch, "DurabilityQueue")
+    , owner(owner)
+    , mutex("MasterService::DurabilityQueue::mutex")
+    , entries()
+    , numEntries(0)
+    , readyRpcs()
 {
 }
 
 /**
- * This method is invoked whenever an inbound migration starts (i.e.
- * we prepare to accept tablet data from another server). It arranges for
- * that migration to be monitored appropriately.
- * \param tableId
- *      Identifier for the table containing the tablet that is incoming.
- * \param startKeyHash
- *      Lowest key hash that will be contained in the incoming tablet.
- * \param endKeyHash
- *      Highest key hash that will be contained in the incoming tablet
+ * Destructor for DurabilityQueue objects: make any replies still waiting
+ * durable and send them.
  */
-void
-MasterService::MigrationMonitor::migrationStarting(uint64_t tableId,
-        uint64_t startKeyHash, uint64_t endKeyHash)
+MasterService::DurabilityQueue::~DurabilityQueue()
 {
-    SpinLock::Guard guard(mutex);
-    incomingMigrations.emplace_back(tableId, startKeyHash, endKeyHash);
-    if (!protector) {
-        protector.construct(&owner->objectManager);
-    }
-    if (!isRunning()) {
-        startTime = Cycles::rdtsc();
-        start(startTime + wakeupInterval);
+    if (entries.empty())
+        return;
+    owner->objectManager.syncChanges();
+    foreach (Entry& entry, entries) {
+        DispatchThread::sendReply(entry.rpc);
     }
 }
 
 /**
- * This method is invoked at regular intervals by WorkerTimer whenever
- * there is at least one migration running. It releases the
- * TombstoneProtector when all of the migrations finish, and it prints
- * warning messages if migrations take too long to finish.
+ * Arrange for the reply to an RPC to be sent by the dispatch thread once
+ * everything appended to the log so far is durable, rather than when the
+ * RPC's handler returns. The caller's worker is free to move on to other
+ * requests as soon as the handler returns, and must not touch the response
+ * after this method is invoked. This method should be invoked in a worker
+ * thread.
+ *
+ * \param rpc
+ *      RPC whose response has been fully filled in, but which must not be
+ *      returned until its log appends are durable.
  */
 void
-MasterService::MigrationMonitor::handleTimerEvent()
+MasterService::DurabilityQueue::deferReply(Rpc* rpc)
 {
-    SpinLock::Guard guard(mutex);
-
-    // Delete information for any migrations that have completed.
-    // Immigration is considered to have finished when its tablet
-    // state becomes NORMAL, or if the tablet ceases to exist.
-    std::vector<TabletId>::iterator it = incomingMigrations.begin();
-    while (it != incomingMigrations.end()) {
-        TabletId* id = &(*it);
-        TabletManager::Tablet tabletInfo;
-        bool found = owner->tabletManager.getTablet(id->tableId,
-                id->startKeyHash, id->endKeyHash, &tabletInfo);
-        if (!found || tabletInfo.state == TabletManager::TabletState::NORMAL) {
-            it = incomingMigrations.erase(it);
-        } else {
-            ++it;
-        }
+    // Start replication before giving up the reply, so there is no window
+    // in which the dispatch thread could see the entry but have nothing
+    // to wait for.
+    Log::SyncPoint point = owner->objectManager.getLog()->syncAsync();
+    Transport::ServerRpc* serverRpc = rpc->deferReply();
+    if (serverRpc == NULL) {
+        // There is no worker to take the reply from (this only happens
+        // in unit tests), so we have to wait here after all.
+        owner->objectManager.syncChanges();
+        return;
     }
 
-    // See if all of the migrations have completed.
-    if (incomingMigrations.empty()) {
-        protector.destroy();
-        return;
+    SpinLock::Guard _(mutex);
+    entries.emplace_back(point, serverRpc);
+    numEntries.store(downCast<int>(entries.size()));
+}
+
+/**
+ * This method is invoked by the dispatcher. It moves replication along for
+ * any waiting replies and sends those that are now durable.
+ *
+ * \return
+ *      1 if any replies were sent, 0 otherwise.
+ */
+int
+MasterService::DurabilityQueue::poll()
+{
+    if (numEntries.load() == 0)
+        return 0;
+
+    // Workers no longer wait in Log::sync for these writes, so nobody
+    // else may be driving replication.
+    owner->objectManager.getReplicaManager()->proceed();
+
+    Log* log = owner->objectManager.getLog();
+    {
+        SpinLock::Guard _(mutex);
+        while (!entries.empty() && log->isSynced(entries.front().point)) {
+            readyRpcs.push_back(entries.front().rpc);
+            entries.pop_front();
+        }
+        numEntries.store(downCast<int>(entries.size()));
     }
+    if (readyRpcs.empty())
+        return 0;
 
-    uint64_t now = Cycles::rdtsc();
-    double elapsed = Cycles::toSeconds(now - startTime);
-    if (elapsed > 30.0) {
-        LOG(WARNING, "Inbound migrations have been running continuously "
-                "for %.0f seconds; is it possible that something is hung?",
-                elapsed);
+    // Send the replies without holding the lock, so workers that are
+    // deferring new replies don't have to wait for us.
+    foreach (Transport::ServerRpc* rpc, readyRpcs) {
+        DispatchThread::sendReply(rpc);
     }
-    start(Cycles::rdtsc() + wakeupInterval);
+    readyRpcs.clear();
+    return 1;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -3269,6 +5577,215 @@ class RecoveryTask {
     Tub<GetRecoveryDataRpc> rpc;
     DISALLOW_COPY_AND_ASSIGN(RecoveryTask);
 };
+
+/**
+ * Replays the recovery segments of a single recovery, dividing each
+ * segment among several threads by hash table bucket range (see
+ * ObjectManager::ReplayShard). The calling thread replays the first shard
+ * itself; each other shard gets a thread of its own per segment. Every
+ * shard has its own SideLog and its own copy of the nextNodeIdMap, so the
+ * threads share little more than the hash table, whose bucket locks they
+ * don't contend for, and the segment allocator. The SideLogs are committed
+ * together once all of the segments have been replayed.
+ *
+ * Checking entry checksums can also be moved off the replay threads: helper
+ * threads each take every numVerifyThreads'th chunk of the segment's entries
+ * and check them while the segment is replayed.
+ */
+class RecoveryReplayer {
+  PUBLIC:
+    /**
+     * \param objectManager
+     *      The ObjectManager to replay segments into.
+     * \param numThreads
+     *      The number of threads to replay each segment with, including
+     *      the caller's. 0 is treated as 1.
+     * \param nextNodeIdMap
+     *      Keeps track of the nextNodeId in each indexlet table; see
+     *      ObjectManager::replaySegment(). Brought up to date by commit().
+     * \param numVerifyThreads
+     *      The number of helper threads that check each segment's entry
+     *      checksums while it is replayed. 0 leaves the checks to the
+     *      replay threads.
+     */
+    RecoveryReplayer(ObjectManager* objectManager, uint32_t numThreads,
+                     std::unordered_map<uint64_t, uint64_t>* nextNodeIdMap,
+                     uint32_t numVerifyThreads = 0)
+        : objectManager(objectManager)
+        , numShards(std::max(numThreads, 1U))
+        , numVerifyThreads(numVerifyThreads)
+        , numBuckets(objectManager->getObjectMap()->getNumBuckets())
+        , nextNodeIdMap(nextNodeIdMap)
+        , sideLogs()
+        , shardNextNodeIdMaps(numShards - 1, *nextNodeIdMap)
+    {
+        // The bucket count is sampled only once so that all the entries
+        // for a key are replayed by the same shard, even if the hash table
+        // grows during recovery. Each key's entries then live in a single
+        // SideLog.
+        for (uint32_t i = 0; i < numShards; i++)
+            sideLogs.emplace_back(new SideLog(objectManager->getLog()));
+        metrics->master.replayThreadCount += numShards;
+    }
+
+    /**
+     * Replay all of a segment's entries, returning once every shard has
+     * finished with it. If replaying any shard throws an exception, the
+     * first such exception is rethrown here after all of the threads are
+     * done.
+     *
+     * \param it
+     *      Iterator positioned at the start of the recovery segment.
+     * \param verifyChecksums
+     *      If false, the entries' checksums have already been checked (by
+     *      the backup that built the segment) and aren't checked again.
+     */
+    void
+    replay(SegmentIterator& it, bool verifyChecksums = true)
+    {
+        CycleCounter<RawMetric> _(&metrics->master.replayTicks);
+        std::vector<std::thread> verifiers;
+        if (verifyChecksums && numVerifyThreads > 0) {
+            for (uint32_t i = 0; i < numVerifyThreads; i++) {
+                verifiers.emplace_back(&RecoveryReplayer::verifyChunks, it,
+                                       i, numVerifyThreads);
+            }
+            verifyChecksums = false;
+        }
+
+        std::vector<std::exception_ptr> errors(numShards);
+        std::vector<std::thread> threads;
+        if (numShards == 1) {
+            try {
+                objectManager->replaySegment(sideLogs[0].get(), it,
+                        nextNodeIdMap, ObjectManager::ReplayShard(),
+                        verifyChecksums);
+            } catch (...) {
+                errors[0] = std::current_exception();
+            }
+        } else {
+            for (uint32_t i = 1; i < numShards; i++) {
+                threads.emplace_back(&RecoveryReplayer::replayShard, this,
+                                     std::cref(it), i, verifyChecksums,
+                                     &errors[i]);
+            }
+            replayShard(it, 0, verifyChecksums, &errors[0]);
+        }
+        foreach (std::thread& thread, threads)
+            thread.join();
+        foreach (std::thread& verifier, verifiers)
+            verifier.join();
+        foreach (std::exception_ptr& error, errors) {
+            if (error)
+                std::rethrow_exception(error);
+        }
+    }
+
+    /**
+     * Make everything replayed so far durable and part of the log, and
+     * fold the nextNodeIds the shards found into the caller's
+     * nextNodeIdMap.
+     */
+    void
+    commit()
+    {
+        foreach (auto& sideLog, sideLogs)
+            sideLog->commit();
+        foreach (auto& shardMap, shardNextNodeIdMaps) {
+            foreach (auto& entry, shardMap) {
+                uint64_t& nextNodeId = (*nextNodeIdMap)[entry.first];
+                nextNodeId = std::max(nextNodeId, entry.second);
+            }
+        }
+    }
+
+  PRIVATE:
+    /**
+     * Replay one shard's entries from a segment into the shard's SideLog,
+     * saving any exception in \a error rather than letting it escape the
+     * thread.
+     */
+    void
+    replayShard(const SegmentIterator& it, uint32_t shard,
+                bool verifyChecksums, std::exception_ptr* error)
+    {
+        std::unordered_map<uint64_t, uint64_t>* shardMap = nextNodeIdMap;
+        if (shard > 0)
+            shardMap = &shardNextNodeIdMaps[shard - 1];
+        try {
+            SegmentIterator shardIt(it);
+            objectManager->replaySegment(sideLogs[shard].get(), shardIt,
+                    shardMap,
+                    ObjectManager::ReplayShard(shard, numShards, numBuckets),
+                    verifyChecksums);
+        } catch (...) {
+            *error = std::current_exception();
+        }
+    }
+
+    /**
+     * Check the checksums of one helper's share of a segment's entries,
+     * logging any that don't match, as replay would have. The entries are
+     * dealt out to the helpers VERIFY_CHUNK_ENTRIES at a time.
+     *
+     * \param it
+     *      Iterator positioned at the start of the recovery segment.
+     * \param helper
+     *      Which helper this is, from 0 to \a numHelpers - 1.
+     * \param numHelpers
+     *      Number of helpers checking the segment.
+     */
+    static void
+    verifyChunks(SegmentIterator it, uint32_t helper, uint32_t numHelpers)
+    {
+        uint64_t verifyChecksumTicks = 0;
+        for (uint32_t i = 0; !it.isDone(); it.next(), i++) {
+            if ((i / VERIFY_CHUNK_ENTRIES) % numHelpers != helper)
+                continue;
+            Buffer buffer;
+            it.appendToBuffer(buffer);
+            CycleCounter<uint64_t> _(&verifyChecksumTicks);
+            if (!RecoverySegmentBuilder::isEntryIntact(it.getType(),
+                                                       buffer)) {
+                LOG(WARNING, "bad %s checksum at offset %u of recovery "
+                    "segment", LogEntryTypeHelpers::toString(it.getType()),
+                    it.getOffset());
+                // JIRA Issue: RAM-673:
+                // Should throw and try another segment replica.
+            }
+        }
+        metrics->master.verifyChecksumTicks += verifyChecksumTicks;
+    }
+
+    /// Number of consecutive entries each verify helper checks before
+    /// skipping ahead to its next chunk; large enough that a helper spends
+    /// little time walking past the other helpers' entries.
+    static const uint32_t VERIFY_CHUNK_ENTRIES = 64;
+
+    ObjectManager* objectManager;
+
+    /// The number of shards each segment is split into, one per thread.
+    const uint32_t numShards;
+
+    /// The number of helper threads checking each segment's checksums.
+    const uint32_t numVerifyThreads;
+
+    /// Number of buckets in the object map when recovery started; all of
+    /// the shards are computed from this.
+    const uint64_t numBuckets;
+
+    /// The caller's nextNodeIdMap; shard 0 updates it directly.
+    std::unordered_map<uint64_t, uint64_t>* nextNodeIdMap;
+
+    /// One SideLog per shard, indexed by shard.
+    std::vector<std::unique_ptr<SideLog>> sideLogs;
+
+    /// Private nextNodeIdMaps for shards 1 and up (entry i is for shard
+    /// i + 1), merged into #nextNodeIdMap by commit().
+    std::vector<std::unordered_map<uint64_t, uint64_t>> shardNextNodeIdMaps;
+
+    DISALLOW_COPY_AND_ASSIGN(RecoveryReplayer);
+};
 } // namespace MasterServiceInternal
 
 using namespace MasterServiceInternal; // NOLINT
@@ -3341,6 +5858,15 @@ MasterService::detectSegmentRecoveryFailure(
  * \param nextNodeIdMap
  *      A unordered map that keeps track of the nextNodeId in
  *      each indexlet table.
+ * \param[in,out] timeline
+ *      If not NULL, the time this method spent waiting for, replaying, and
+ *      replicating segments, and the number and size of the segments, are
+ *      added to this for the coordinator's report on the recovery.
+ * \param recoveryPartition
+ *      If not NULL, all of the tablets being recovered, with partition
+ *      ids in their user_data; segments that are in this master's restart
+ *      snapshot of \a masterId are filtered with it and replayed from the
+ *      snapshot rather than being read from backups.
  * \throw SegmentRecoveryFailedException
  *      If some segment was not recovered and the recovery master is not
  *      a valid replacement for the crashed master.
@@ -3348,7 +5874,9 @@ MasterService::detectSegmentRecoveryFailure(
 void
 MasterService::recover(uint64_t recoveryId, ServerId masterId,
         uint64_t partitionId, vector<Replica>& replicas,
-        std::unordered_map<uint64_t, uint64_t>& nextNodeIdMap)
+        std::unordered_map<uint64_t, uint64_t>& nextNodeIdMap,
+        ProtoBuf::RecoveryMasterTimeline* timeline,
+        const ProtoBuf::RecoveryPartition* recoveryPartition)
 {
     /* Overview of the internals of this method and its structures.
      *
@@ -3408,14 +5936,74 @@ MasterService::recover(uint64_t recoveryId, ServerId masterId,
     std::unordered_set<uint64_t> runningSet;
     Tub<RecoveryTask> tasks[4];
     uint32_t activeRequests = 0;
+    uint64_t segmentCount = 0;
+    uint64_t segmentBytes = 0;
 
-    auto notStarted = replicas.begin();
-    auto replicasEnd = replicas.end();
-
-    // The SideLog we'll append recovered entries to. It will be committed after
+    // Replays recovered entries into SideLogs. They will be committed after
     // replay completes on all segments, making all of the recovered data
     // durable.
-    SideLog sideLog(objectManager.getLog());
+    RecoveryReplayer replayer(&objectManager,
+                              config->master.recoveryReplayThreads,
+                              &nextNodeIdMap,
+                              config->master.recoveryVerifyThreads);
+
+    // If this master was restarted after saving a snapshot of the crashed
+    // master's log, replay the segments in the snapshot from local storage
+    // and don't fetch them from backups. Segments written after the
+    // snapshot, and any that can't be read from it, still come from
+    // backups.
+    if (recoveryPartition != NULL && restartSnapshot &&
+            restartSnapshot->getServerId() == masterId) {
+        int numPartitions = 0;
+        foreach (const ProtoBuf::Tablets::Tablet& tablet,
+                recoveryPartition->tablet()) {
+            numPartitions = std::max(numPartitions,
+                    downCast<int>(tablet.user_data()) + 1);
+        }
+        std::unordered_set<uint64_t> replayed;
+        foreach (Replica& replica, replicas) {
+            uint64_t segmentId = replica.segmentId;
+            if (partitionId >= static_cast<uint64_t>(numPartitions) ||
+                    contains(replayed, segmentId) ||
+                    !restartSnapshot->contains(segmentId))
+                continue;
+            uint64_t startUseful = Cycles::rdtsc();
+            Buffer buffer;
+            SegmentCertificate certificate;
+            if (!restartSnapshot->read(segmentId, &buffer, &certificate))
+                continue;
+            uint32_t length = buffer.size();
+            std::unique_ptr<Segment[]> recoverySegments(
+                    new Segment[numPartitions]);
+            try {
+                RecoverySegmentBuilder::build(buffer.getRange(0, length),
+                        length, certificate, numPartitions,
+                        *recoveryPartition, recoverySegments.get());
+            } catch (const Exception& e) {
+                LOG(WARNING, "Couldn't replay segment %lu from snapshot; "
+                        "reading it from backups instead: %s", segmentId,
+                        e.what());
+                continue;
+            }
+            SegmentIterator it(recoverySegments[partitionId]);
+            replayer.replay(it);
+            usefulTime += Cycles::rdtsc() - startUseful;
+            segmentCount++;
+            segmentBytes += length;
+            replayed.insert(segmentId);
+        }
+        replicas.erase(std::remove_if(replicas.begin(), replicas.end(),
+                [&replayed](const Replica& replica) {
+                    return contains(replayed, replica.segmentId);
+                }), replicas.end());
+        LOG(NOTICE, "Replayed %lu segments of master %s from the restart "
+                "snapshot; %lu replicas left to read from backups",
+                replayed.size(), masterId.toString().c_str(),
+                replicas.size());
+    }
+
+    auto notStarted = replicas.begin();
+    auto replicasEnd = replicas.end();
 
     // Start RPCs
     auto replicaIt = notStarted;
@@ -3445,6 +6033,7 @@ MasterService::recover(uint64_t recoveryId, ServerId masterId,
 
     // As RPCs complete, process them and start more
     Tub<CycleCounter<RawMetric>> readStallTicks;
+    uint64_t readStallStart = metrics->master.segmentReadStallTicks;
 
     bool gotFirstGRD = false;
 
@@ -3468,7 +6057,9 @@ MasterService::recover(uint64_t recoveryId, ServerId masterId,
                     context->serverList->toString(
                             task->replica.backupId).c_str());
             try {
-                SegmentCertificate certificate = task->rpc->wait();
+                bool entriesVerified = false;
+                SegmentCertificate certificate =
+                        task->rpc->wait(&entriesVerified);
                 task->rpc.destroy();
                 uint64_t grdTime = Cycles::rdtsc() - task->startTime;
                 metrics->master.segmentReadTicks += grdTime;
@@ -3530,8 +6121,14 @@ MasterService::recover(uint64_t recoveryId, ServerId masterId,
                                     ReplicatedSegment::recoveryStart),
                             task->replica.segmentId, responseLen);
                 }
-                objectManager.replaySegment(&sideLog, it, &nextNodeIdMap);
+                // The certificate checked above guarantees that the segment
+                // arrived as the backup built it, so entries the backup
+                // checked needn't be checked again.
+                replayer.replay(it, !(entriesVerified &&
+                        config->master.trustBackupChecksums));
                 usefulTime += Cycles::rdtsc() - startUseful;
+                segmentCount++;
+                segmentBytes += responseLen;
                 TEST_LOG("Segment %lu replay complete",
                          task->replica.segmentId);
                 if (LOG_RECOVERY_REPLICATION_RPC_TIMING) {
@@ -3616,9 +6213,12 @@ MasterService::recover(uint64_t recoveryId, ServerId masterId,
         }
     }
     readStallTicks.destroy();
+    uint64_t readStallTime = metrics->master.segmentReadStallTicks -
+            readStallStart;
 
     detectSegmentRecoveryFailure(masterId, partitionId, replicas);
 
+    uint64_t logSyncTime;
     {
         CycleCounter<RawMetric> logSyncTicks(&metrics->master.logSyncTicks);
         LOG(NOTICE, "Committing the SideLog...");
@@ -3630,7 +6230,7 @@ MasterService::recover(uint64_t recoveryId, ServerId masterId,
                 0 - metrics->transport.infiniband.transmitActiveTicks;
         metrics->master.logSyncPostingWriteRpcTicks =
                 0 - metrics->master.replicationPostingWriteRpcTicks;
-        sideLog.commit();
+        replayer.commit();
         metrics->master.logSyncBytes += metrics->transport.transmit.byteCount;
         metrics->master.logSyncTransmitCopyTicks +=
                 metrics->transport.transmit.copyTicks;
@@ -3639,6 +6239,7 @@ MasterService::recover(uint64_t recoveryId, ServerId masterId,
         metrics->master.logSyncPostingWriteRpcTicks +=
                 metrics->master.replicationPostingWriteRpcTicks;
         LOG(NOTICE, "SideLog finished committing (data is durable).");
+        logSyncTime = logSyncTicks.stop();
     }
 
     metrics->master.replicationBytes += metrics->transport.transmit.byteCount;
@@ -3667,6 +6268,16 @@ MasterService::recover(uint64_t recoveryId, ServerId masterId,
     LOG(NOTICE, "Recovery complete, took %.1f ms, useful replaying "
             "time %.1f ms (%.1f%% effective)",
             totalSecs * 1e03, usefulSecs * 1e03, 100 * usefulSecs / totalSecs);
+    if (timeline != NULL) {
+        timeline->set_segment_wait_micros(timeline->segment_wait_micros() +
+                Cycles::toMicroseconds(readStallTime));
+        timeline->set_replay_micros(timeline->replay_micros() +
+                Cycles::toMicroseconds(usefulTime));
+        timeline->set_replication_micros(timeline->replication_micros() +
+                Cycles::toMicroseconds(logSyncTime));
+        timeline->set_segments(timeline->segments() + segmentCount);
+        timeline->set_segment_bytes(timeline->segment_bytes() + segmentBytes);
+    }
 }
 
 /**
@@ -3679,6 +6290,127 @@ struct OutOfSpaceException : public Exception {
         : Exception(where) {}
 };
 
+/**
+ * Thrown by recoverByRange() when the coordinator refuses a range this
+ * master finished recovering ahead of the rest of its partition. Caught by
+ * recover() which aborts the recovery cleanly.
+ */
+struct RangeRefusedException : public Exception {
+    explicit RangeRefusedException(const CodeLocation& where)
+        : Exception(where) {}
+};
+
+/**
+ * Helper for public recover() method, used when the coordinator divided
+ * the partition this master is recovering into ranges with recovery
+ * segments of their own (see Recovery::divideIntoRanges()). Recovers the
+ * ranges one at a time and hands each over to the coordinator as soon as
+ * it is done, so that clients can use it while the rest of the partition
+ * is still being recovered. The last range, and ranges holding tablets
+ * that back indexlets, are left for recover() to report along with the
+ * indexlets.
+ *
+ * \param recoveryId
+ *      Id of the recovery this recovery master is performing.
+ * \param masterId
+ *      The id of the crashed master whose tablets are being recovered.
+ * \param replicas
+ *      A list specifying for each segmentId a backup who can provide a
+ *      filtered recovery data segment; see the other recover().
+ * \param headOfLog
+ *      Position of the head of this master's log before recovery started;
+ *      becomes the creation time of the recovered tablets.
+ * \param nextNodeIdMap
+ *      A unordered map that keeps track of the nextNodeId in
+ *      each indexlet table.
+ * \param[in,out] recoveryPartition
+ *      The tablets and indexlets being recovered; the user_data of each
+ *      tablet is its range id. Tablets that were handed over are removed.
+ * \param[in,out] timeline
+ *      The time spent recovering each range and handing it over is added
+ *      to this; see the other recover().
+ * \throw SegmentRecoveryFailedException
+ *      If some segment of a range was not recovered.
+ * \throw RangeRefusedException
+ *      If the coordinator refused a range, so this master must abort the
+ *      recovery.
+ */
+void
+MasterService::recoverByRange(uint64_t recoveryId, ServerId masterId,
+        const vector<Replica>& replicas, LogPosition headOfLog,
+        std::unordered_map<uint64_t, uint64_t>& nextNodeIdMap,
+        ProtoBuf::RecoveryPartition* recoveryPartition,
+        ProtoBuf::RecoveryMasterTimeline* timeline)
+{
+    std::set<uint64_t> rangeIds;
+    foreach (const ProtoBuf::Tablets::Tablet& tablet,
+             recoveryPartition->tablet()) {
+        rangeIds.insert(tablet.user_data());
+    }
+    std::unordered_set<uint64_t> backingTableIds;
+    foreach (const ProtoBuf::Indexlet& indexlet,
+             recoveryPartition->indexlet()) {
+        backingTableIds.insert(indexlet.backing_table_id());
+    }
+
+    foreach (uint64_t rangeId, rangeIds) {
+        vector<Replica> rangeReplicas(replicas);
+        recover(recoveryId, masterId, rangeId, rangeReplicas, nextNodeIdMap,
+                timeline);
+        if (rangeId == *rangeIds.rbegin())
+            break;
+
+        ProtoBuf::RecoveryPartition range;
+        ProtoBuf::RecoveryPartition rest;
+        bool backsIndexlet = false;
+        foreach (const ProtoBuf::Tablets::Tablet& tablet,
+                 recoveryPartition->tablet()) {
+            if (tablet.user_data() != rangeId) {
+                *rest.add_tablet() = tablet;
+                continue;
+            }
+            *range.add_tablet() = tablet;
+            if (backingTableIds.count(tablet.table_id()))
+                backsIndexlet = true;
+        }
+        if (backsIndexlet)
+            continue;
+
+        foreach (ProtoBuf::Tablets::Tablet& tablet, *range.mutable_tablet()) {
+            tablet.set_service_locator(config->localLocator);
+            tablet.set_server_id(serverId.getId());
+            tablet.set_ctime_log_head_id(headOfLog.getSegmentId());
+            tablet.set_ctime_log_head_offset(headOfLog.getSegmentOffset());
+        }
+        LOG(NOTICE, "Reporting completion of range %lu (%d tablets) of "
+            "recovery %lu", rangeId, range.tablet_size(), recoveryId);
+        uint64_t handoffStart = Cycles::rdtsc();
+        bool cancelRecovery = CoordinatorClient::recoveryMasterFinished(
+                context, recoveryId, serverId, &range, true, true);
+        timeline->set_handoff_micros(timeline->handoff_micros() +
+                Cycles::toMicroseconds(Cycles::rdtsc() - handoffStart));
+        if (cancelRecovery)
+            throw RangeRefusedException(HERE);
+
+        // Start serving the range; see the end of recover().
+        preparedOps.regrabLocksAfterRecovery(&objectManager);
+        foreach (const ProtoBuf::Tablets::Tablet& tablet, range.tablet()) {
+            bool changed = tabletManager.changeState(
+                    tablet.table_id(),
+                    tablet.start_key_hash(), tablet.end_key_hash(),
+                    TabletManager::RECOVERING, TabletManager::NORMAL);
+            if (!changed) {
+                throw FatalError(HERE, format("Could not change recovering "
+                        "tablet's state to NORMAL (%lu range [%lu,%lu])",
+                        tablet.table_id(),
+                        tablet.start_key_hash(), tablet.end_key_hash()));
+            }
+        }
+        *rest.mutable_indexlet() = recoveryPartition->indexlet();
+        recoveryPartition->Swap(&rest);
+    }
+}
+
 /**
  * Top-level server method to handle the RECOVER request.
  * \copydetails Service::ping
@@ -3689,8 +6421,20 @@ MasterService::recover(const WireFormat::Recover::Request* reqHdr,
         Rpc* rpc)
 {
     ReplicatedSegment::recoveryStart = Cycles::rdtsc();
+    uint64_t recoveryStart = ReplicatedSegment::recoveryStart;
     CycleCounter<RawMetric> recoveryTicks(&metrics->master.recoveryTicks);
     metrics->master.recoveryCount++;
+
+    // Where this recovery master's time goes, for the coordinator's report
+    // on the recovery (see RecoveryTimeline).
+    ProtoBuf::RecoveryMasterTimeline timeline;
+    timeline.set_total_micros(0);
+    timeline.set_segment_wait_micros(0);
+    timeline.set_replay_micros(0);
+    timeline.set_replication_micros(0);
+    timeline.set_handoff_micros(0);
+    timeline.set_segments(0);
+    timeline.set_segment_bytes(0);
     metrics->master.replicas = objectManager.getReplicaManager()->numReplicas;
 
     uint64_t recoveryId = reqHdr->recoveryId;
@@ -3732,6 +6476,8 @@ MasterService::recover(const WireFormat::Recover::Request* reqHdr,
     // own them yet).
     foreach (const ProtoBuf::Tablets::Tablet& newTablet,
              recoveryPartition.tablet()) {
+        dropReadReplicas(newTablet.table_id(), newTablet.start_key_hash(),
+                newTablet.end_key_hash());
         bool added = tabletManager.addTablet(newTablet.table_id(),
                 newTablet.start_key_hash(), newTablet.end_key_hash(),
                 TabletManager::RECOVERING);
@@ -3767,8 +6513,22 @@ MasterService::recover(const WireFormat::Recover::Request* reqHdr,
                 recoveryPartition.indexlet()) {
             nextNodeIdMap[indexlet.backing_table_id()] = 0;
         }
-        recover(recoveryId, crashedServerId, partitionId, replicas,
-                nextNodeIdMap);
+        std::set<uint64_t> rangeIds;
+        foreach (const ProtoBuf::Tablets::Tablet& tablet,
+                 recoveryPartition.tablet()) {
+            rangeIds.insert(tablet.user_data());
+        }
+        if (rangeIds.size() > 1) {
+            recoverByRange(recoveryId, crashedServerId, replicas, headOfLog,
+                    nextNodeIdMap, &recoveryPartition, &timeline);
+        } else {
+            // A partition that wasn't divided has a single range, whose id
+            // is usually the partition id.
+            if (!rangeIds.empty())
+                partitionId = *rangeIds.begin();
+            recover(recoveryId, crashedServerId, partitionId, replicas,
+                    nextNodeIdMap, &timeline, &recoveryPartition);
+        }
         // Install indexlets we are recovering
         foreach (const ProtoBuf::Indexlet& newIndexlet,
                  recoveryPartition.indexlet()) {
@@ -3786,13 +6546,16 @@ MasterService::recover(const WireFormat::Recover::Request* reqHdr,
                     newIndexlet.first_not_owned_key().c_str(),
                     (uint16_t)newIndexlet.first_not_owned_key().length(),
                     IndexletManager::Indexlet::RECOVERING,
-                    nextNodeIdMap[newIndexlet.backing_table_id()]);
+                    nextNodeIdMap[newIndexlet.backing_table_id()],
+                    downCast<uint8_t>(newIndexlet.index_type()));
         }
         successful = true;
     } catch (const SegmentRecoveryFailedException& e) {
         // Recovery wasn't successful.
     } catch (const OutOfSpaceException& e) {
         // Recovery wasn't successful.
+    } catch (const RangeRefusedException& e) {
+        // Recovery wasn't successful.
     } catch (const Exception& e) {
         LOG(ERROR, "Unexpected exception during recovery: %s",
                 e.message.c_str());
@@ -3830,6 +6593,9 @@ MasterService::recover(const WireFormat::Recover::Request* reqHdr,
         indexlet.set_server_id(serverId.getId());
     }
 
+    timeline.set_total_micros(Cycles::toMicroseconds(Cycles::rdtsc() -
+            recoveryStart));
+    *recoveryPartition.mutable_timeline() = timeline;
     LOG(NOTICE, "Reporting completion of recovery %lu", reqHdr->recoveryId);
     bool cancelRecovery = CoordinatorClient::recoveryMasterFinished(
             context, recoveryId, serverId, &recoveryPartition, successful);
@@ -16,14 +16,22 @@
 #ifndef RAMCLOUD_MASTERSERVICE_H
 #define RAMCLOUD_MASTERSERVICE_H
 
+#include <deque>
+#include <map>
+#include <unordered_map>
+
 #include "Common.h"
+#include "ChangeStream.h"
 #include "ClientLeaseValidator.h"
 #include "ClusterClock.h"
 #include "CoordinatorClient.h"
+#include "Dispatch.h"
 #include "Log.h"
 #include "LogCleaner.h"
 #include "LogIterator.h"
 #include "HashTable.h"
+#include "MasterClient.h"
+#include "MasterSnapshot.h"
 #include "MasterTableMetadata.h"
 #include "Object.h"
 #include "ObjectFinder.h"
@@ -38,11 +46,14 @@
 #include "Service.h"
 #include "SideLog.h"
 #include "SpinLock.h"
+#include "TableRateLimiter.h"
 #include "TabletManager.h"
 #include "TxRecoveryManager.h"
 #include "IndexletManager.h"
 #include "WireFormat.h"
 #include "UnackedRpcResults.h"
+#include "WorkerManager.h"
+#include "WriteStreamManager.h"
 
 namespace RAMCloud {
 
@@ -62,6 +73,11 @@ class MasterService : public Service {
     virtual ~MasterService();
 
     void dispatch(WireFormat::Opcode opcode, Rpc* rpc);
+    void saveRestartSnapshot();
+    ServerId getRestartSnapshotServerId();
+    string getReadReplica(Key& key, TabletManager::Tablet* tablet);
+    Status setReadReplica(Key& key, ServerId replica);
+    Status syncReadReplica(const WireFormat::ReadReplicaSync* sync);
 
     /*
      * The following class is used to temporarily disable the servicing of
@@ -134,6 +150,36 @@ class MasterService : public Service {
      */
     PreparedOps preparedOps;
 
+    /**
+     * Limits the rate of requests for individual tables (see
+     * RamCloud::setTableRateLimit).
+     */
+    TableRateLimiter rateLimiter;
+
+    /**
+     * Records the changes to the tables that are replicated to another
+     * cluster, for READ_CHANGES requests (see ChangeStreamReceiver).
+     */
+    ChangeStream changeStream;
+
+    /**
+     * Holds the fragments of streaming writes until they are committed
+     * (see ObjectWriteStream).
+     */
+    WriteStreamManager writeStreams;
+
+    /**
+     * SegmentManager::getMemoryUtilization as of the last time
+     * getWriteBackpressure checked it.
+     */
+    std::atomic<int> memoryUtilization;
+
+    /**
+     * Cycles::rdtsc time after which getWriteBackpressure should check the
+     * memory utilization again.
+     */
+    std::atomic<uint64_t> nextUtilizationCheck;
+
 #ifdef TESTING
     /// Used to pause the read-increment-write cycle in incrementObject
     /// between the read and the write.  While paused, a second thread can
@@ -147,10 +193,37 @@ class MasterService : public Service {
 #endif
 
   PRIVATE:
+    void append(const WireFormat::Append::Request* reqHdr,
+                WireFormat::Append::Response* respHdr,
+                Rpc* rpc);
+    void areReplicasNeeded(
+                const WireFormat::AreReplicasNeeded::Request* reqHdr,
+                WireFormat::AreReplicasNeeded::Response* respHdr,
+                Rpc* rpc);
+    void buildIndex(const WireFormat::BuildIndex::Request* reqHdr,
+                WireFormat::BuildIndex::Response* respHdr,
+                Rpc* rpc);
+    uint64_t buildIndexEntries(uint64_t tableId, uint8_t indexId,
+                uint64_t firstKeyHash, uint64_t lastKeyHash);
+    void bulkLoad(const WireFormat::BulkLoad::Request* reqHdr,
+                WireFormat::BulkLoad::Response* respHdr,
+                Rpc* rpc);
+    void commitWrite(const WireFormat::CommitWrite::Request* reqHdr,
+                WireFormat::CommitWrite::Response* respHdr,
+                Rpc* rpc);
+    void conditionalUpdate(
+                const WireFormat::ConditionalUpdate::Request* reqHdr,
+                WireFormat::ConditionalUpdate::Response* respHdr,
+                Rpc* rpc);
+    void countIndexKeys(const WireFormat::CountIndexKeys::Request* reqHdr,
+                WireFormat::CountIndexKeys::Response* respHdr,
+                Rpc* rpc);
     void dropTabletOwnership(
                 const WireFormat::DropTabletOwnership::Request* reqHdr,
                 WireFormat::DropTabletOwnership::Response* respHdr,
                 Rpc* rpc);
+    void dropReadReplicas(uint64_t tableId, uint64_t firstKeyHash,
+                uint64_t lastKeyHash);
     void dropIndexletOwnership(
                 const WireFormat::DropIndexletOwnership::Request* reqHdr,
                 WireFormat::DropIndexletOwnership::Response* respHdr,
@@ -164,6 +237,10 @@ class MasterService : public Service {
     void getLogMetrics(const WireFormat::GetLogMetrics::Request* reqHdr,
                 WireFormat::GetLogMetrics::Response* respHdr,
                 Rpc* rpc);
+    KeyHash getRequestKeyHash(uint64_t tableId, const void* key,
+                KeyLength keyLength, KeyHash clientKeyHash);
+    uint32_t getWriteBackpressure(WireFormat::Opcode opcode,
+                Buffer* request);
     void getServerStatistics(
                 const WireFormat::GetServerStatistics::Request* reqHdr,
                 WireFormat::GetServerStatistics::Response* respHdr,
@@ -171,18 +248,30 @@ class MasterService : public Service {
     void fillWithTestData(const WireFormat::FillWithTestData::Request* reqHdr,
                 WireFormat::FillWithTestData::Response* respHdr,
                 Rpc* rpc);
+    struct PendingIncrement;
+    void combineIncrement(PendingIncrement* pending);
+    void finishIncrements(KeyHash keyHash,
+                vector<PendingIncrement*>* batch);
     void increment(const WireFormat::Increment::Request* reqHdr,
                 WireFormat::Increment::Response* respHdr,
                 Rpc* rpc);
-    void incrementObject(Key *key,
+    void incrementObject(PendingIncrement** increments, uint32_t count);
+    static bool isCombinable(const RejectRules& rejectRules);
+    void updateObject(Key* key,
                 RejectRules rejectRules,
-                int64_t *asInt64,
-                double *asDouble,
-                uint64_t *newVersion,
-                Status *status,
-                const WireFormat::Increment::Request* reqHdr = NULL,
-                WireFormat::Increment::Response* respHdr = NULL,
-                uint64_t *rpcResultPtr = NULL);
+                bool append,
+                uint32_t offset,
+                const void* expected,
+                const void* data,
+                uint32_t length,
+                uint64_t* newVersion,
+                uint8_t* updated,
+                uint32_t* newLength,
+                Status* status,
+                RpcResult* rpcResult = NULL,
+                uint64_t* rpcResultPtr = NULL);
+    void finishUpdate(UnackedRpcHandle* rh, RpcResult* rpcResult,
+                uint8_t updated, Status status, uint64_t* rpcResultPtr);
     void readHashes(
                 const WireFormat::ReadHashes::Request* reqHdr,
                 WireFormat::ReadHashes::Response* respHdr,
@@ -208,18 +297,83 @@ class MasterService : public Service {
                 uint64_t& totalBytes,
                 WireFormat::SplitAndMigrateIndexlet::Response* respHdr);
   public: // For MigrateTabletBenchmark.
+    /**
+     * Carries the data for one outgoing tablet migration to the receiving
+     * master. Log entries are packed into transfer segments, and each full
+     * segment is sent with an asynchronous RECEIVE_MIGRATION_DATA rpc.
+     * Several of these rpcs are kept in flight at once, so that scanning
+     * the log here overlaps with the network transfer, and the receiver
+     * replays several segments in parallel (on different worker threads)
+     * instead of idling between rpcs.
+     */
+    class MigrationStream {
+      public:
+        MigrationStream(Context* context, ServerId receiver,
+                uint64_t tableId, uint64_t firstKeyHash,
+                ClusterClock* clusterClock = NULL);
+        bool append(LogEntryType type, Buffer& buffer);
+        void finish();
+
+      PRIVATE:
+        void send();
+        void wait(Tub<ReceiveMigrationDataRpc>& rpc);
+
+        /**
+         * One transfer segment, plus the rpc sending it (if it has been
+         * sent and the rpc hasn't been reaped yet).
+         */
+        struct Transfer {
+            Transfer()
+                : segment()
+                , rpc()
+            {}
+            Tub<Segment> segment;
+            Tub<ReceiveMigrationDataRpc> rpc;
+            DISALLOW_COPY_AND_ASSIGN(Transfer);
+        };
+
+        /// Maximum number of RECEIVE_MIGRATION_DATA rpcs outstanding at
+        /// once. Each one pins a full transfer segment.
+        static const uint32_t MAX_RPCS_IN_FLIGHT = 4;
+
+        /// Shared RAMCloud information.
+        Context* context;
+
+        /// Master receiving the data. If invalid, full segments are simply
+        /// discarded; MigrateTabletBenchmark uses this to measure just the
+        /// sending side.
+        ServerId receiver;
+
+        /// Identifies the tablet being migrated (for the rpcs).
+        uint64_t tableId;
+        uint64_t firstKeyHash;
+
+        /// If not NULL, the sender's clock: its time is sent with each
+        /// rpc, and advanced to the receiver's time in each response.
+        ClusterClock* clusterClock;
+
+        /// Used round-robin: entries are appended to transfers[current]
+        /// and the others hold segments whose rpcs may be in flight.
+        Transfer transfers[MAX_RPCS_IN_FLIGHT];
+        uint32_t current;
+
+        DISALLOW_COPY_AND_ASSIGN(MigrationStream);
+    };
     Status migrateSingleLogEntry(SegmentIterator& it,
-                Tub<Segment>& transferSeg,
+                MigrationStream& stream,
                 uint64_t entryTotals[],
                 uint64_t& totalBytes,
                 uint64_t tableId,
                 uint64_t firstKeyHash,
-                uint64_t lastKeyHash,
-                ServerId receiver);
+                uint64_t lastKeyHash);
   PRIVATE:
     void migrateTablet(const WireFormat::MigrateTablet::Request* reqHdr,
                 WireFormat::MigrateTablet::Response* respHdr,
                 Rpc* rpc);
+    void modifyIndexEntries(
+                const WireFormat::ModifyIndexEntries::Request* reqHdr,
+                WireFormat::ModifyIndexEntries::Response* respHdr,
+                Rpc* rpc);
     void multiOp(const WireFormat::MultiOp::Request* reqHdr,
                 WireFormat::MultiOp::Response* respHdr,
                 Rpc* rpc);
@@ -232,6 +386,9 @@ class MasterService : public Service {
     void multiRemove(const WireFormat::MultiOp::Request* reqHdr,
                 WireFormat::MultiOp::Response* respHdr,
                 Rpc* rpc);
+    void multiUpdate(const WireFormat::MultiOp::Request* reqHdr,
+                WireFormat::MultiOp::Response* respHdr,
+                Rpc* rpc);
     void multiWrite(const WireFormat::MultiOp::Request* reqHdr,
                 WireFormat::MultiOp::Response* respHdr,
                 Rpc* rpc);
@@ -245,6 +402,12 @@ class MasterService : public Service {
     void read(const WireFormat::Read::Request* reqHdr,
                 WireFormat::Read::Response* respHdr,
                 Rpc* rpc);
+    void readChanges(const WireFormat::ReadChanges::Request* reqHdr,
+                WireFormat::ReadChanges::Response* respHdr,
+                Rpc* rpc);
+    void readFromReplica(const WireFormat::ReadFromReplica::Request* reqHdr,
+                WireFormat::ReadFromReplica::Response* respHdr,
+                Rpc* rpc);
     void readKeysAndValue(const WireFormat::ReadKeysAndValue::Request* reqHdr,
                 WireFormat::ReadKeysAndValue::Response* respHdr,
                 Rpc* rpc);
@@ -258,7 +421,11 @@ class MasterService : public Service {
     void removeIndexEntry(const WireFormat::RemoveIndexEntry::Request* reqHdr,
                 WireFormat::RemoveIndexEntry::Response* respHdr,
                 Rpc* rpc);
+    void removeOldIndexEntries(Buffer* objectBuffers, uint32_t numBuffers);
+    KeyCount firstIndexedKey(uint64_t tableId);
     void requestInsertIndexEntries(Object& object);
+    void requestModifyIndexEntries(vector<Object*>* objects, bool remove,
+                int indexId = -1);
     void requestRemoveIndexEntries(Object& object);
     void splitAndMigrateIndexlet(
                 const WireFormat::SplitAndMigrateIndexlet::Request* reqHdr,
@@ -283,6 +450,10 @@ class MasterService : public Service {
                 const WireFormat::TxRequestAbort::Request* reqHdr,
                 WireFormat::TxRequestAbort::Response* respHdr,
                 Rpc* rpc);
+    bool txCommitOneShot(
+                const WireFormat::TxPrepare::Request* reqHdr,
+                WireFormat::TxPrepare::Response* respHdr,
+                Rpc* rpc, uint32_t reqOffset);
     void txHintFailed(
                 const WireFormat::TxHintFailed::Request* reqHdr,
                 WireFormat::TxHintFailed::Response* respHdr,
@@ -294,6 +465,9 @@ class MasterService : public Service {
     void write(const WireFormat::Write::Request* reqHdr,
                 WireFormat::Write::Response* respHdr,
                 Rpc* rpc);
+    void writeFragment(const WireFormat::WriteFragment::Request* reqHdr,
+                WireFormat::WriteFragment::Response* respHdr,
+                Rpc* rpc);
 
     /**
      * Helper function for handling linearizable RPCs. Parse the log location
@@ -359,6 +533,13 @@ class MasterService : public Service {
      */
     bool logEverSynced;
 
+    /**
+     * The snapshot of this master's log found at startup (see
+     * ServerConfig::Master::restartSnapshotPath), if any; used to recover
+     * the data of the master that wrote it.
+     */
+    Tub<MasterSnapshot> restartSnapshot;
+
     /**
      * The MasterTableMetadata object keeps per table metadata.
      */
@@ -371,6 +552,19 @@ class MasterService : public Service {
      */
     uint32_t maxResponseRpcLen;
 
+    /**
+     * How many objects multiRead() looks up with each call to
+     * ObjectManager::readObjects. Larger batches hide more cache misses but
+     * may read objects that end up being truncated from the response.
+     */
+    static const uint32_t MULTIREAD_BATCH_SIZE = 16;
+
+    /**
+     * How many bytes of objects (keys only) buildIndex() scans before
+     * sending their index entries to the index servers.
+     */
+    static const uint32_t BUILD_INDEX_BATCH_BYTES = 1 << 20;
+
     /*
      * Used to identify tablets for which migration is underway.
      */
@@ -435,6 +629,334 @@ class MasterService : public Service {
     };
     MigrationMonitor migrationMonitor;
 
+    /*
+     * This class periodically reports the read and write activity on this
+     * master's tablets to the coordinator (see
+     * ServerConfig::Master::tabletLoadReportInterval), so that if this
+     * master crashes its busiest tablets can be spread across recovery
+     * masters. The activity on its indexlets is included too, so that the
+     * coordinator can split indexlets that have become hot spots.
+     */
+    class TabletLoadReporter : public WorkerTimer {
+      public:
+        explicit TabletLoadReporter(MasterService* owner);
+        void start();
+        void handleTimerEvent();
+
+      PRIVATE:
+        /**
+         * Copy of constructor argument.
+         */
+        MasterService* owner;
+
+        /**
+         * Time between reports, in rdtsc ticks; 0 means don't report.
+         */
+        uint64_t wakeupInterval;
+
+        /// Identifies a tablet by its table id and first key hash.
+        typedef std::pair<uint64_t, uint64_t> TabletKey;
+
+        /// Read and write counts for a tablet.
+        typedef std::pair<uint64_t, uint64_t> Counts;
+
+        /*
+         * Each tablet's counts as of the previous report; reports give the
+         * activity since then, so that they reflect current load rather
+         * than the tablet's whole history.
+         */
+        std::map<TabletKey, Counts> lastCounts;
+
+        /*
+         * True if the previous report showed no activity at all; further
+         * idle reports are skipped so idle masters don't keep writing to
+         * the coordinator.
+         */
+        bool lastReportIdle;
+
+        DISALLOW_COPY_AND_ASSIGN(TabletLoadReporter);
+    };
+    TabletLoadReporter tabletLoadReporter;
+
+    /*
+     * This class keeps the read replicas of this master's tablets (see
+     * RamCloud::setReadReplica) up to date. Every
+     * ServerConfig::Master::readReplicaSyncMs it sends each replica the log
+     * entries for its tablet that were written since the previous round,
+     * using the same RPCs as tablet migration, and then tells the replica
+     * how old its copy is. Rounds start from the log head as of the start
+     * of the previous round, so all but the first scan just the newest
+     * segments; every FULL_SYNC_ROUNDS rounds the whole log is sent again,
+     * which catches entries that the cleaner moved into segments that
+     * weren't yet in the log at the time.
+     */
+    class ReadReplicaFeeder : public WorkerTimer {
+      public:
+        explicit ReadReplicaFeeder(MasterService* owner);
+        ServerId getReplica(const TabletManager::Tablet& tablet);
+        void setReplica(const TabletManager::Tablet& tablet,
+                ServerId replica);
+        void handleTimerEvent();
+
+      PRIVATE:
+        /// Every this many rounds, a replica is sent the whole log rather
+        /// than just its newest segments.
+        static const uint32_t FULL_SYNC_ROUNDS = 64;
+
+        /// Identifies a tablet by its table id and first key hash.
+        typedef std::pair<uint64_t, uint64_t> TabletKey;
+
+        /**
+         * The state of one tablet's read replica.
+         */
+        struct Replica {
+            Replica()
+                : serverId()
+                , lastKeyHash(0)
+                , firstSegmentId(0)
+                , rounds(0)
+            {}
+
+            /// The master holding the replica.
+            ServerId serverId;
+
+            /// The last key hash of the replicated tablet.
+            uint64_t lastKeyHash;
+
+            /// The next round sends entries in this segment of our log and
+            /// later ones.
+            uint64_t firstSegmentId;
+
+            /// Number of rounds sent to the replica so far. 0 means that
+            /// the replica may not have been created yet.
+            uint32_t rounds;
+        };
+
+        void drop(const TabletKey& key, const Replica& replica);
+        bool sync(const TabletKey& key, Replica* replica);
+
+        /**
+         * Copy of constructor argument.
+         */
+        MasterService* owner;
+
+        /**
+         * Time between rounds, in rdtsc ticks; 0 means replicas are never
+         * synced.
+         */
+        uint64_t wakeupInterval;
+
+        /// Protects #replicas and #dropped.
+        SpinLock mutex;
+
+        /// Tablets that have read replicas.
+        std::map<TabletKey, Replica> replicas;
+
+        /// Replicas that are no longer wanted; the timer handler deletes
+        /// them from their masters, so that only it talks to replicas.
+        vector<std::pair<TabletKey, Replica>> dropped;
+
+        DISALLOW_COPY_AND_ASSIGN(ReadReplicaFeeder);
+    };
+    ReadReplicaFeeder readReplicaFeeder;
+
+    /*
+     * This class holds the replies to writes that have been appended to the
+     * log but are not yet durable, so that the workers that executed them
+     * don't have to wait in Log::sync. The dispatch thread drives replication
+     * and sends each reply once the log is replicated past its write. It is
+     * only used if ServerConfig::Master::deferWriteReplies is set.
+     */
+    class DurabilityQueue : public Dispatch::Poller {
+      public:
+        explicit DurabilityQueue(MasterService* owner);
+        ~DurabilityQueue();
+        void deferReply(Rpc* rpc);
+        int poll();
+
+      PRIVATE:
+        /**
+         * Describes one reply that is waiting for the log to be synced.
+         */
+        struct Entry {
+            Entry(Log::SyncPoint point, Transport::ServerRpc* rpc)
+                : point(point)
+                , rpc(rpc)
+            {}
+
+            /// The reply can be sent once this part of the log is durable.
+            Log::SyncPoint point;
+
+            /// RPC whose reply is waiting.
+            Transport::ServerRpc* rpc;
+        };
+
+        /**
+         * Copy of constructor argument.
+         */
+        MasterService* owner;
+
+        /*
+         * Protects #entries (workers add to it, the dispatch thread
+         * removes from it).
+         */
+        SpinLock mutex;
+
+        /*
+         * Replies that are waiting, in the order they were deferred. Since
+         * the log is replicated in order, entries become durable in roughly
+         * this order too.
+         */
+        std::deque<Entry> entries;
+
+        /*
+         * Number of elements in #entries; lets poll() return quickly
+         * without acquiring #mutex when there is nothing to do.
+         */
+        Atomic<int> numEntries;
+
+        /*
+         * Used by poll() to collect the RPCs whose replies it will send
+         * once it has released #mutex. Kept here to avoid reallocating it.
+         */
+        std::vector<Transport::ServerRpc*> readyRpcs;
+
+        DISALLOW_COPY_AND_ASSIGN(DurabilityQueue);
+    };
+    DurabilityQueue durabilityQueue;
+
+    /**
+     * Prefetches the hash table buckets of single-object requests while
+     * they wait for a worker (see WorkerManager::Prefetcher), so that the
+     * workers find them in the cache.
+     */
+    class BucketPrefetcher : public WorkerManager::Prefetcher {
+      public:
+        explicit BucketPrefetcher(HashTable* objectMap)
+            : objectMap(objectMap)
+        {}
+        void prefetch(uint64_t keyHash)
+        {
+            objectMap->prefetchBucket(keyHash);
+        }
+
+      PRIVATE:
+        /// The master's hash table.
+        HashTable* objectMap;
+
+        DISALLOW_COPY_AND_ASSIGN(BucketPrefetcher);
+    };
+    BucketPrefetcher bucketPrefetcher;
+
+    /**
+     * Describes one increment of an object, as it is carried out by
+     * incrementObject (possibly together with other increments of the same
+     * object; see combineIncrement).
+     */
+    struct PendingIncrement {
+        /// Values for #state.
+        enum State {
+            /// Waiting in #activeIncrements for another worker to apply it.
+            WAITING,
+            /// This worker must now apply it, along with whatever else is
+            /// waiting for the same object.
+            LEADING,
+            /// Another worker has applied it; the results are filled in.
+            DONE,
+        };
+
+        PendingIncrement(Key* key, RejectRules rejectRules,
+                int64_t incrementInt64, double incrementDouble,
+                const WireFormat::Increment::Request* reqHdr = NULL,
+                WireFormat::Increment::Response* respHdr = NULL)
+            : key(key)
+            , rejectRules(rejectRules)
+            , incrementInt64(incrementInt64)
+            , incrementDouble(incrementDouble)
+            , reqHdr(reqHdr)
+            , respHdr(respHdr)
+            , asInt64(0)
+            , asDouble(0.0)
+            , version(0)
+            , status(STATUS_OK)
+            , rpcResultPtr(0)
+            , state(WAITING)
+        {}
+
+        /// The object to increment. If it doesn't exist, it is created as
+        /// zero before incrementing.
+        Key* key;
+
+        /// Conditions under which the increment fails.
+        RejectRules rejectRules;
+
+        /// Amounts to add to the object, interpreted as a twos-complement
+        /// integer and as a double respectively; either may be zero.
+        int64_t incrementInt64;
+        double incrementDouble;
+
+        /// If non-NULL, the INCREMENT request and response for this
+        /// increment; the response is filled in and recorded in an
+        /// RpcResult written with the object, for linearizability.
+        const WireFormat::Increment::Request* reqHdr;
+        WireFormat::Increment::Response* respHdr;
+
+        /// On success, the value of the object just after this increment.
+        int64_t asInt64;
+        double asDouble;
+
+        /// The new version of the object on success (or the current version
+        /// if the write was rejected).
+        uint64_t version;
+
+        /// STATUS_OK or the reason this increment failed.
+        Status status;
+
+        /// If #respHdr is non-NULL, the RpcResult's location in the log.
+        uint64_t rpcResultPtr;
+
+        /// A State; used only by combineIncrement.
+        Atomic<int> state;
+
+        DISALLOW_COPY_AND_ASSIGN(PendingIncrement);
+    };
+
+    /**
+     * The increments waiting for one object (see combineIncrement).
+     */
+    struct CombinedIncrements {
+        CombinedIncrements()
+            : key(NULL)
+            , waiting()
+        {}
+
+        /// The object being incremented; refers to the key of the increment
+        /// currently being applied.
+        Key* key;
+
+        /// Increments that arrived while an earlier one was being applied,
+        /// in order of arrival.
+        vector<PendingIncrement*> waiting;
+
+        DISALLOW_COPY_AND_ASSIGN(CombinedIncrements);
+    };
+
+    /**
+     * Most increments combineIncrement applies in a single write.
+     */
+    static const uint32_t MAX_COMBINED_INCREMENTS = 64;
+
+    /**
+     * Protects #activeIncrements.
+     */
+    SpinLock incrementMutex;
+
+    /**
+     * One entry, keyed by key hash, for each object that a worker is
+     * incrementing in combineIncrement.
+     */
+    std::unordered_map<KeyHash, CombinedIncrements> activeIncrements;
+
 ///////////////////////////////////////////////////////////////////////////////
 /////Recovery related code. This should eventually move into its own file./////
 ///////////////////////////////////////////////////////////////////////////////
@@ -481,7 +1003,16 @@ class MasterService : public Service {
                 ServerId masterId,
                 uint64_t partitionId,
                 vector<Replica>& replicas,
-                std::unordered_map<uint64_t, uint64_t>& nextNodeIdMap);
+                std::unordered_map<uint64_t, uint64_t>& nextNodeIdMap,
+                ProtoBuf::RecoveryMasterTimeline* timeline = NULL,
+                const ProtoBuf::RecoveryPartition* recoveryPartition = NULL);
+    void recoverByRange(uint64_t recoveryId,
+                ServerId masterId,
+                const vector<Replica>& replicas,
+                LogPosition headOfLog,
+                std::unordered_map<uint64_t, uint64_t>& nextNodeIdMap,
+                ProtoBuf::RecoveryPartition* recoveryPartition,
+                ProtoBuf::RecoveryMasterTimeline* timeline);
 
 ///////////////////////////////////////////////////////////////////////////////
 /////////////////////////End of Recovery related code./////////////////////////
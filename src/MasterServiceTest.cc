@@ -19,6 +19,7 @@
 
 #include "BackupStorage.h"
 #include "Buffer.h"
+#include "BulkLoader.h"
 #include "Cycles.h"
 #include "EnumerationIterator.h"
 #include "LogIterator.h"
@@ -28,10 +29,12 @@
 #include "MasterService.h"
 #include "Memory.h"
 #include "MockCluster.h"
+#include "MockTransport.h"
 #include "MultiRead.h"
 #include "MultiRemove.h"
 #include "MultiWrite.h"
 #include "ObjectBuffer.h"
+#include "ObjectFilter.h"
 #include "RamCloud.h"
 #include "ShortMacros.h"
 #include "StringUtil.h"
@@ -357,6 +360,231 @@ bool tabletCompare(const TabletManager::Tablet &a,
         return a.startKeyHash < b.startKeyHash;
 }
 
+TEST_F(MasterServiceTest, append_basic) {
+    Buffer value;
+    uint64_t version = 0;
+
+    EXPECT_EQ(3U, ramcloud->append(1, "key0", 4, "abc", 3, NULL, &version));
+    EXPECT_EQ(1U, version);
+    EXPECT_EQ(5U, ramcloud->append(1, "key0", 4, "de", 2, NULL, &version));
+    EXPECT_EQ(2U, version);
+
+    ramcloud->read(1, "key0", 4, &value);
+    EXPECT_EQ("abcde", TestUtil::toString(&value));
+}
+
+TEST_F(MasterServiceTest, append_keepsSecondaryKeys) {
+    ObjectBuffer keysAndValue;
+    KeyInfo keyList[2];
+    keyList[0].keyLength = 2;
+    keyList[0].key = "ha";
+    keyList[1].keyLength = 2;
+    keyList[1].key = "hi";
+    ramcloud->write(1, 2, keyList, "data", NULL, NULL, false);
+
+    EXPECT_EQ(7U, ramcloud->append(1, "ha", 2, "123", 3));
+    ramcloud->readKeysAndValue(1, "ha", 2, &keysAndValue);
+    EXPECT_EQ("data123", string(reinterpret_cast<const char*>(
+            keysAndValue.getValue()), 7));
+    EXPECT_EQ(2U, keysAndValue.getNumKeys());
+    EXPECT_EQ("hi", string(reinterpret_cast<const char *>(
+            keysAndValue.getKey(1)), 2));
+}
+
+TEST_F(MasterServiceTest, append_rejectRules) {
+    RejectRules rules;
+    memset(&rules, 0, sizeof(rules));
+    rules.doesntExist = true;
+    EXPECT_THROW(ramcloud->append(1, "key0", 4, "abc", 3, &rules),
+                 ObjectDoesntExistException);
+}
+
+TEST_F(MasterServiceTest, append_tooLarge) {
+    uint32_t length = masterConfig.maxObjectDataSize / 2 + 1;
+    char* buf = new char[length];
+    memset(buf, 'x', length);
+    ramcloud->append(1, "key0", 4, buf, length);
+    EXPECT_THROW(ramcloud->append(1, "key0", 4, buf, length),
+                 RequestTooLargeException);
+    delete[] buf;
+
+    Buffer value;
+    ramcloud->read(1, "key0", 4, &value);
+    EXPECT_EQ(length, value.size());
+}
+
+TEST_F(MasterServiceTest, append_linearizability) {
+    Buffer value;
+    AppendRpc appendRpc(ramcloud.get(), 1, "key0", 4, "abc", 3);
+    WireFormat::Append::Request* reqHdr =
+        appendRpc.request.getStart<WireFormat::Append::Request>();
+    EXPECT_EQ(3U, appendRpc.wait());
+
+    // A retry of the same RPC returns the saved result.
+    WireFormat::Append::Response respHdr;
+    Service::Rpc rpc(NULL, &appendRpc.request, NULL);
+    service->append(reqHdr, &respHdr, &rpc);
+    EXPECT_EQ(STATUS_OK, respHdr.common.status);
+    EXPECT_EQ(3U, respHdr.newLength);
+
+    ramcloud->read(1, "key0", 4, &value);
+    EXPECT_EQ("abc", TestUtil::toString(&value));
+}
+
+TEST_F(MasterServiceTest, areReplicasNeeded) {
+    uint64_t segmentIds[] = {1, 2, 3};
+    bool needed[] = {false, false, false};
+    // The master hasn't heard of the backup, so it can't be sure that
+    // the replicas aren't needed.
+    MasterClient::areReplicasNeeded(&context, masterServer->serverId,
+            {99, 0}, segmentIds, 3, needed);
+    EXPECT_TRUE(needed[0]);
+    EXPECT_TRUE(needed[1]);
+    EXPECT_TRUE(needed[2]);
+
+    MasterClient::areReplicasNeeded(&context, masterServer->serverId,
+            {99, 0}, segmentIds, 0, needed);
+}
+
+TEST_F(MasterServiceTest, buildIndex) {
+    uint64_t tableId1 = ramcloud->createTable("table1");
+    KeyInfo keyList0[3] = {{"0", 1}, {"air", 3}, {"x", 1}};
+    KeyInfo keyList1[2] = {{"1", 1}, {"earth", 5}};
+    KeyInfo keyList2[1] = {{"2", 1}};
+    ramcloud->write(tableId1, 3, keyList0, "value0");
+    ramcloud->write(tableId1, 2, keyList1, "value1");
+    ramcloud->write(tableId1, 1, keyList2, "value2");
+
+    // Creating the index adds entries for the existing objects.
+    TestLog::Enable _("buildIndex", "modifyEntries", NULL);
+    ramcloud->createIndex(tableId1, 1, 0);
+    EXPECT_EQ(format("modifyEntries: Inserting 2 entries: tableId %lu, "
+            "indexId 1 | buildIndex: Added index entries for 3 objects to "
+            "index 1 of tableId %lu", tableId1, tableId1),
+            TestLog::get());
+
+    Buffer responseBuffer;
+    uint32_t numHashes;
+    uint16_t nextKeyLength;
+    uint64_t nextKeyHash;
+    ramcloud->lookupIndexKeys(tableId1, 1, "a", 1, 0, "z", 1, 100,
+            &responseBuffer, &numHashes, &nextKeyLength, &nextKeyHash);
+    EXPECT_EQ(2U, numHashes);
+}
+
+static void
+appendObject(Segment* segment, uint64_t tableId, const char* key,
+        const char* value)
+{
+    Key objectKey(tableId, key, downCast<uint16_t>(strlen(key)));
+    Buffer dataBuffer;
+    Object object(objectKey, value, downCast<uint32_t>(strlen(value)), 0, 0,
+            dataBuffer);
+    Buffer entry;
+    object.assembleForLog(entry);
+    EXPECT_TRUE(segment->append(LOG_ENTRY_TYPE_OBJ, entry));
+}
+
+TEST_F(MasterServiceTest, bulkLoad) {
+    uint64_t version;
+    ramcloud->write(1, "key0", 4, "old", 3, NULL, &version);
+
+    Segment segment;
+    appendObject(&segment, 1, "key0", "new0");
+    appendObject(&segment, 1, "key1", "new1");
+    BulkLoadRpc rpc(ramcloud.get(), 1, 0, &segment);
+    uint32_t objects = 0;
+    EXPECT_TRUE(rpc.wait(&objects));
+    EXPECT_EQ(2U, objects);
+
+    Buffer value;
+    uint64_t newVersion;
+    ramcloud->read(1, "key0", 4, &value, NULL, &newVersion);
+    EXPECT_EQ("new0", TestUtil::toString(&value));
+    EXPECT_GT(newVersion, version);
+    ramcloud->read(1, "key1", 4, &value);
+    EXPECT_EQ("new1", TestUtil::toString(&value));
+}
+
+TEST_F(MasterServiceTest, bulkLoad_unknownTablet) {
+    // The client thinks this master stores table 99, but it doesn't.
+    Segment segment;
+    appendObject(&segment, 99, "key0", "new0");
+    BulkLoadRpc rpc(ramcloud.get(), 99, 0, &segment);
+    EXPECT_FALSE(rpc.wait());
+}
+
+TEST_F(MasterServiceTest, bulkLoad_badSegment) {
+    // An object of a different table makes the whole segment fail.
+    Segment segment;
+    appendObject(&segment, 1, "key0", "new0");
+    appendObject(&segment, 99, "key1", "new1");
+    BulkLoadRpc rpc(ramcloud.get(), 1, 0, &segment);
+    EXPECT_THROW(rpc.wait(), RequestFormatError);
+    Buffer value;
+    EXPECT_THROW(ramcloud->read(1, "key0", 4, &value),
+            ObjectDoesntExistException);
+
+    // Only objects may be loaded.
+    Segment segment2;
+    EXPECT_TRUE(segment2.append(LOG_ENTRY_TYPE_OBJTOMB, "junk", 4));
+    BulkLoadRpc rpc2(ramcloud.get(), 1, 0, &segment2);
+    EXPECT_THROW(rpc2.wait(), RequestFormatError);
+}
+
+TEST_F(MasterServiceTest, conditionalUpdate_basic) {
+    Buffer value;
+    uint64_t version = 0;
+    ramcloud->write(1, "key0", 4, "abcdef", 6);
+
+    EXPECT_TRUE(ramcloud->conditionalUpdate(1, "key0", 4, 2, "cd", "CD", 2,
+                                            NULL, &version));
+    EXPECT_EQ(2U, version);
+    ramcloud->read(1, "key0", 4, &value);
+    EXPECT_EQ("abCDef", TestUtil::toString(&value));
+}
+
+TEST_F(MasterServiceTest, conditionalUpdate_mismatch) {
+    Buffer value;
+    uint64_t version = 0;
+    ramcloud->write(1, "key0", 4, "abcdef", 6);
+
+    EXPECT_FALSE(ramcloud->conditionalUpdate(1, "key0", 4, 2, "xx", "CD", 2,
+                                             NULL, &version));
+    EXPECT_EQ(1U, version);
+
+    // The bytes run past the end of the object.
+    EXPECT_FALSE(ramcloud->conditionalUpdate(1, "key0", 4, 5, "fg", "FG", 2,
+                                             NULL, &version));
+    EXPECT_EQ(1U, version);
+
+    ramcloud->read(1, "key0", 4, &value);
+    EXPECT_EQ("abcdef", TestUtil::toString(&value));
+}
+
+TEST_F(MasterServiceTest, conditionalUpdate_objectDoesntExist) {
+    EXPECT_THROW(ramcloud->conditionalUpdate(1, "key0", 4, 0, "a", "b", 1),
+                 ObjectDoesntExistException);
+}
+
+TEST_F(MasterServiceTest, conditionalUpdate_malformedRequest) {
+    WireFormat::ConditionalUpdate::Request reqHdr;
+    memset(&reqHdr, 0, sizeof(reqHdr));
+    reqHdr.tableId = 1;
+    reqHdr.keyLength = 4;
+    reqHdr.length = 2;
+    Buffer request;
+    request.appendCopy(&reqHdr, sizeof(reqHdr));
+    request.appendCopy("key0ab", 6);
+
+    // The new bytes are missing.
+    WireFormat::ConditionalUpdate::Response respHdr;
+    memset(&respHdr, 0, sizeof(respHdr));
+    Service::Rpc rpc(NULL, &request, NULL);
+    service->conditionalUpdate(&reqHdr, &respHdr, &rpc);
+    EXPECT_EQ(STATUS_REQUEST_FORMAT_ERROR, respHdr.common.status);
+}
+
 TEST_F(MasterServiceTest, dispatch_initializationNotFinished) {
     Buffer request, response;
     Service::Rpc rpc(NULL, &request, &response);
@@ -424,6 +652,26 @@ TEST_F(MasterServiceTest, dropTabletOwnership) {
             "tablet [0x1,0x1] in tableId 2", TestLog::get());
 }
 
+TEST_F(MasterServiceTest, dropReadReplicas) {
+    TestLog::Enable _("dropReadReplicas");
+    service->tabletManager.addTablet(2, 0, 99, TabletManager::READ_REPLICA);
+    service->tabletManager.addTablet(2, 100, 199,
+            TabletManager::READ_REPLICA);
+    service->tabletManager.addTablet(3, 0, 99, TabletManager::READ_REPLICA);
+
+    // Taking ownership of a tablet replaces any replicas it overlaps.
+    MasterClient::takeTabletOwnership(&context, masterServer->serverId,
+            2, 50, 60);
+    EXPECT_EQ("dropReadReplicas: Dropped read replica of tablet [0x0,0x63] "
+            "in tableId 2", TestLog::get());
+    TabletManager::Tablet tablet;
+    ASSERT_TRUE(service->tabletManager.getTablet(2, 50, &tablet));
+    EXPECT_EQ(TabletManager::NORMAL, tablet.state);
+    EXPECT_FALSE(service->tabletManager.getTablet(2, 10));
+    EXPECT_TRUE(service->tabletManager.getTablet(2, 100, 199));
+    EXPECT_TRUE(service->tabletManager.getTablet(3, 0, 99));
+}
+
 TEST_F(MasterServiceTest, dropIndexletOwnership) {
     TestLog::Enable _("dropIndexletOwnership");
 
@@ -540,6 +788,27 @@ TEST_F(MasterServiceTest, enumerate_basics) {
     EXPECT_EQ(0U, objects.size());
 }
 
+TEST_F(MasterServiceTest, enumerate_filter) {
+    ramcloud->write(1, "0", 1, "abcdef", 6);
+    ramcloud->write(1, "1", 1, "ghijkl", 6);
+    ObjectFilter filter(ObjectFilter::EQUAL, ObjectFilter::VALUE, 0, "gh", 2);
+    filter.setProjection(2, 2);
+    Buffer iter, nextIter, objects;
+    EnumerateTableRpc rpc(ramcloud.get(), 1, false, 0, iter, objects,
+            &filter);
+    EXPECT_EQ(0U, rpc.wait(nextIter));
+
+    EXPECT_EQ(30U, *objects.getOffset<uint32_t>(0));            // size
+    EXPECT_EQ(34U, objects.size());
+    Object object(objects, 4, 30);
+    EXPECT_EQ("1", string(reinterpret_cast<const char*>(
+            object.getKey()), 1));
+    uint32_t valueLength;
+    const void* value = object.getValue(&valueLength);
+    EXPECT_EQ("ij", string(reinterpret_cast<const char*>(value),
+            valueLength));
+}
+
 TEST_F(MasterServiceTest, enumerate_tabletNotOnServer) {
     TestLog::Enable _;
     Buffer iter, nextIter, objects;
@@ -612,6 +881,80 @@ TEST_F(MasterServiceTest, getHeadOfLog) {
             MasterClient::getHeadOfLog(&context, masterServer->serverId));
 }
 
+TEST_F(MasterServiceTest, getRequestKeyHash) {
+    KeyHash hash = Key::getHash(1, "abc", 3);
+    EXPECT_EQ(hash, service->getRequestKeyHash(1, "abc", 3, 99));
+
+    const_cast<ServerConfig*>(service->config)->master.trustClientKeyHashes =
+            true;
+    EXPECT_EQ(99U, service->getRequestKeyHash(1, "abc", 3, 99));
+    EXPECT_EQ(hash, service->getRequestKeyHash(1, "abc", 3, 0));
+}
+
+TEST_F(MasterServiceTest, getWriteBackpressure) {
+    const_cast<ServerConfig*>(service->config)->
+            master.writeBackpressurePercent = 96;
+    Cycles::mockTscValue = 1000;
+    SegmentManager::mockMemoryUtilization = 95;
+    MockRandom _(1);
+    Buffer request;
+    EXPECT_EQ(0U, service->getWriteBackpressure(WireFormat::WRITE,
+            &request));
+
+    // The utilization is only checked again a millisecond later.
+    SegmentManager::mockMemoryUtilization = 100;
+    EXPECT_EQ(0U, service->getWriteBackpressure(WireFormat::WRITE,
+            &request));
+    Cycles::mockTscValue += Cycles::fromMicroseconds(1000);
+    EXPECT_EQ(2500U, service->getWriteBackpressure(WireFormat::WRITE,
+            &request));
+    EXPECT_EQ(0U, service->getWriteBackpressure(WireFormat::REMOVE,
+            &request));
+
+    // Only some writes are turned away below full.
+    Cycles::mockTscValue += Cycles::fromMicroseconds(1000);
+    SegmentManager::mockMemoryUtilization = 97;
+    mockRandomValue = 8;
+    EXPECT_EQ(0U, service->getWriteBackpressure(WireFormat::WRITE,
+            &request));
+    mockRandomValue = 6;
+    EXPECT_EQ(1000U, service->getWriteBackpressure(WireFormat::INCREMENT,
+            &request));
+
+    WireFormat::MultiOp::Request* reqHdr =
+            request.emplaceAppend<WireFormat::MultiOp::Request>();
+    reqHdr->type = WireFormat::MultiOp::READ;
+    EXPECT_EQ(0U, service->getWriteBackpressure(WireFormat::MULTI_OP,
+            &request));
+    reqHdr->type = WireFormat::MultiOp::WRITE;
+    mockRandomValue = 6;
+    EXPECT_EQ(1000U, service->getWriteBackpressure(WireFormat::MULTI_OP,
+            &request));
+
+    SegmentManager::mockMemoryUtilization = 0;
+    Cycles::mockTscValue = 0;
+}
+
+TEST_F(MasterServiceTest, dispatch_writeBackpressure) {
+    const_cast<ServerConfig*>(service->config)->
+            master.writeBackpressurePercent = 96;
+    SegmentManager::mockMemoryUtilization = 100;
+    Buffer request, response;
+    Service::Rpc rpc(NULL, &request, &response);
+    uint64_t shed = metrics->master.writesShed;
+    string message("no exception");
+    try {
+        service->dispatch(WireFormat::Opcode::WRITE, &rpc);
+    } catch (RetryException& e) {
+        message = e.message;
+        EXPECT_EQ(2500U, e.minDelayMicros);
+        EXPECT_EQ(5000U, e.maxDelayMicros);
+    }
+    EXPECT_EQ("log memory nearly full", message);
+    EXPECT_EQ(shed + 1, metrics->master.writesShed);
+    SegmentManager::mockMemoryUtilization = 0;
+}
+
 TEST_F(MasterServiceTest, getServerStatistics) {
     Buffer value;
     uint64_t version;
@@ -849,6 +1192,143 @@ TEST_F(MasterServiceTest, increment_parallel) {
     EXPECT_EQ(2, value);
 }
 
+TEST_F(MasterServiceTest, increment_combine) {
+    // A first thread pauses in incrementObject; two more increments of the
+    // same object queue up behind it and are applied together once it is
+    // done.
+    const_cast<ServerConfig*>(service->config)->master.combineIncrements =
+            true;
+    KeyHash keyHash = Key::getHash(1, "key0", 4);
+    std::thread threads[3];
+    MasterService::pauseIncrement = 1;
+    threads[0] =
+      std::thread(&MasterServiceTest::threadfunIncrementOne, this, 1, "key0");
+    uint64_t deadline = Cycles::rdtsc() + Cycles::fromSeconds(1.);
+    do {
+    } while ((MasterService::pauseIncrement == 1) &&
+             (Cycles::rdtsc() < deadline));
+    EXPECT_EQ(MasterService::pauseIncrement, 0);
+
+    threads[1] =
+      std::thread(&MasterServiceTest::threadfunIncrementOne, this, 1, "key0");
+    threads[2] =
+      std::thread(&MasterServiceTest::threadfunIncrementOne, this, 1, "key0");
+    size_t waiting = 0;
+    deadline = Cycles::rdtsc() + Cycles::fromSeconds(1.);
+    while (waiting < 2 && Cycles::rdtsc() < deadline) {
+        SpinLock::Guard _(service->incrementMutex);
+        auto it = service->activeIncrements.find(keyHash);
+        if (it != service->activeIncrements.end())
+            waiting = it->second.waiting.size();
+    }
+    EXPECT_EQ(2U, waiting);
+
+    MasterService::continueIncrement = 1;
+    for (int i = 0; i < 3; i++)
+        threads[i].join();
+    EXPECT_EQ(0U, service->activeIncrements.size());
+
+    // The second and third increments made a single new version.
+    int64_t value;
+    uint64_t version;
+    Buffer buffer;
+    ramcloud->read(1, "key0", 4, &buffer, NULL, &version);
+    buffer.copy(0, sizeof(value), &value);
+    EXPECT_EQ(3, value);
+    EXPECT_EQ(2U, version);
+}
+
+TEST_F(MasterServiceTest, incrementObject_combined) {
+    Key key(1, "key0", 4);
+    RejectRules rejectRules;
+    memset(&rejectRules, 0, sizeof(rejectRules));
+    WireFormat::Increment::Request reqHdrs[2];
+    WireFormat::Increment::Response respHdrs[2];
+    memset(reqHdrs, 0, sizeof(reqHdrs));
+    memset(respHdrs, 0, sizeof(respHdrs));
+    reqHdrs[0].tableId = reqHdrs[1].tableId = 1;
+    reqHdrs[0].rpcId = 10;
+    reqHdrs[1].rpcId = 11;
+
+    RejectRules mustExistRules = rejectRules;
+    mustExistRules.doesntExist = true;
+    MasterService::PendingIncrement mustExist(&key, mustExistRules, 1, 0.0);
+    MasterService::PendingIncrement first(&key, rejectRules, 2, 0.0,
+            &reqHdrs[0], &respHdrs[0]);
+    MasterService::PendingIncrement second(&key, rejectRules, 3, 0.0,
+            &reqHdrs[1], &respHdrs[1]);
+    MasterService::PendingIncrement* increments[] =
+            {&mustExist, &first, &second};
+
+    uint64_t combined = PerfStats::threadStats.incrementsCombined;
+    TestLog::Enable _("writeObject");
+    service->incrementObject(increments, 3);
+    EXPECT_TRUE(TestUtil::matchesPosixRegex("^writeObject: object: "
+            "[0-9]+ bytes, version [0-9]+ \\| writeObject: rpcResult: "
+            "[0-9]+ bytes \\| writeObject: rpcResult: [0-9]+ bytes$",
+            TestLog::get()));
+    EXPECT_EQ(1U, PerfStats::threadStats.incrementsCombined - combined);
+
+    // The first increment fails, since the object doesn't exist until the
+    // second creates it.
+    EXPECT_EQ(STATUS_OBJECT_DOESNT_EXIST, mustExist.status);
+    EXPECT_EQ(STATUS_OK, first.status);
+    EXPECT_EQ(2, first.asInt64);
+    EXPECT_EQ(STATUS_OK, second.status);
+    EXPECT_EQ(5, second.asInt64);
+    EXPECT_EQ(first.version, second.version);
+    EXPECT_NE(first.rpcResultPtr, second.rpcResultPtr);
+
+    // The responses recorded for linearizability are complete.
+    EXPECT_EQ(first.version, respHdrs[0].version);
+    EXPECT_EQ(2, respHdrs[0].newValue.asInt64);
+    EXPECT_EQ(first.version, respHdrs[1].version);
+    EXPECT_EQ(5, respHdrs[1].newValue.asInt64);
+
+    int64_t value;
+    Buffer buffer;
+    ramcloud->read(1, "key0", 4, &buffer);
+    buffer.copy(0, sizeof(value), &value);
+    EXPECT_EQ(5, value);
+}
+
+TEST_F(MasterServiceTest, lookupIndexKeys_fetchObjects) {
+    uint64_t tableId1 = ramcloud->createTable("table1");
+    ramcloud->createIndex(tableId1, 1, 0);
+    KeyInfo keyList0[2] = {{"0", 1}, {"air", 3}};
+    KeyInfo keyList1[2] = {{"1", 1}, {"earth", 5}};
+    ramcloud->write(tableId1, 2, keyList0, "value0");
+    ramcloud->write(tableId1, 2, keyList1, "value1");
+
+    Buffer response;
+    LookupIndexKeysRpc rpc(ramcloud.get(), tableId1, 1, "a", 1, 0, "z", 1,
+            100, &response, true);
+    uint32_t numHashes;
+    uint16_t nextKeyLength;
+    uint64_t nextKeyHash;
+    rpc.wait(&numHashes, &nextKeyLength, &nextKeyHash);
+    EXPECT_EQ(2U, numHashes);
+    const WireFormat::LookupIndexKeys::Response* respHdr =
+            response.getStart<WireFormat::LookupIndexKeys::Response>();
+    EXPECT_EQ(2U, respHdr->numObjectHashes);
+    EXPECT_EQ(2U, respHdr->numObjects);
+
+    // The objects follow the hashes, in ReadHashes format.
+    uint32_t offset = sizeof32(*respHdr) + 2 * sizeof32(KeyHash);
+    uint32_t length = *response.getOffset<uint32_t>(offset + 8);
+    Object object(tableId1, 1, 0, response, offset + 12, length);
+    EXPECT_EQ("value0", string(reinterpret_cast<const char*>(
+            object.getValue()), 6));
+
+    // The objects aren't included unless they are requested.
+    LookupIndexKeysRpc rpc2(ramcloud.get(), tableId1, 1, "a", 1, 0, "z", 1,
+            100, &response);
+    rpc2.wait(&numHashes, &nextKeyLength, &nextKeyHash);
+    respHdr = response.getStart<WireFormat::LookupIndexKeys::Response>();
+    EXPECT_EQ(0U, respHdr->numObjectHashes);
+    EXPECT_EQ(sizeof32(*respHdr) + 2 * sizeof32(KeyHash), response.size());
+}
+
 TEST_F(MasterServiceTest, migrateSingleLogEntry_basic) {
     // Populate segment
     Key key(1, "1", 1);
@@ -857,7 +1337,6 @@ TEST_F(MasterServiceTest, migrateSingleLogEntry_basic) {
     EXPECT_EQ(STATUS_OK, service->objectManager.writeObject(obj, 0, 0));
 
     LogIterator it(*service->objectManager.getLog());
-    Tub<Segment> transferSeg;
 
     uint64_t entryTotals[TOTAL_LOG_ENTRY_TYPES] = {0};
     uint64_t totalBytes = 0;
@@ -865,15 +1344,16 @@ TEST_F(MasterServiceTest, migrateSingleLogEntry_basic) {
     uint64_t firstKeyHash = 0x0;
     uint64_t lastKeyHash = 0xffffffffffffffff;
     ServerId receiver(1);
+    MasterService::MigrationStream stream(service->context, receiver,
+            tableId, firstKeyHash);
 
     Status error;
     for (; !it.isDone(); it.next()) {
         TestLog::reset();
         error = service->migrateSingleLogEntry(
                 *it.getCurrentSegmentIterator(),
-                transferSeg, entryTotals, totalBytes,
-                tableId, firstKeyHash, lastKeyHash,
-                receiver);
+                stream, entryTotals, totalBytes,
+                tableId, firstKeyHash, lastKeyHash);
         if (error) break;
     }
 
@@ -892,7 +1372,6 @@ TEST_F(MasterServiceTest, migrateSingleLogEntry_wrongTable) {
     EXPECT_EQ(STATUS_OK, service->objectManager.writeObject(obj, 0, 0));
 
     LogIterator it(*service->objectManager.getLog());
-    Tub<Segment> transferSeg;
 
     uint64_t entryTotals[TOTAL_LOG_ENTRY_TYPES] = {0};
     uint64_t totalBytes = 0;
@@ -900,15 +1379,16 @@ TEST_F(MasterServiceTest, migrateSingleLogEntry_wrongTable) {
     uint64_t firstKeyHash = 0x0;
     uint64_t lastKeyHash = 0xffffffffffffffff;
     ServerId receiver(1);
+    MasterService::MigrationStream stream(service->context, receiver,
+            tableId, firstKeyHash);
 
     Status error;
     for (; !it.isDone(); it.next()) {
         TestLog::reset();
         error = service->migrateSingleLogEntry(
                 *it.getCurrentSegmentIterator(),
-                transferSeg, entryTotals, totalBytes,
-                tableId, firstKeyHash, lastKeyHash,
-                receiver);
+                stream, entryTotals, totalBytes,
+                tableId, firstKeyHash, lastKeyHash);
         if (error) break;
     }
 
@@ -928,7 +1408,6 @@ TEST_F(MasterServiceTest, migrateSingleLogEntry_wrongKeyHash) {
     EXPECT_EQ(STATUS_OK, service->objectManager.writeObject(obj, 0, 0));
 
     LogIterator it(*service->objectManager.getLog());
-    Tub<Segment> transferSeg;
 
     uint64_t entryTotals[TOTAL_LOG_ENTRY_TYPES] = {0};
     uint64_t totalBytes = 0;
@@ -936,15 +1415,16 @@ TEST_F(MasterServiceTest, migrateSingleLogEntry_wrongKeyHash) {
     uint64_t firstKeyHash = 0x0;
     uint64_t lastKeyHash = 0x0;
     ServerId receiver(1);
+    MasterService::MigrationStream stream(service->context, receiver,
+            tableId, firstKeyHash);
 
     Status error;
     for (; !it.isDone(); it.next()) {
         TestLog::reset();
         error = service->migrateSingleLogEntry(
                 *it.getCurrentSegmentIterator(),
-                transferSeg, entryTotals, totalBytes,
-                tableId, firstKeyHash, lastKeyHash,
-                receiver);
+                stream, entryTotals, totalBytes,
+                tableId, firstKeyHash, lastKeyHash);
         if (error) break;
     }
 
@@ -983,7 +1463,6 @@ TEST_F(MasterServiceTest, migrateSingleLogEntry_rpcResult) {
         ASSERT_TRUE(segment.append(LOG_ENTRY_TYPE_RPCRESULT, buffer));
     }
 
-    Tub<Segment> transferSeg;
 
     uint64_t entryTotals[TOTAL_LOG_ENTRY_TYPES] = {0};
     uint64_t totalBytes = 0;
@@ -991,6 +1470,8 @@ TEST_F(MasterServiceTest, migrateSingleLogEntry_rpcResult) {
     uint64_t firstKeyHash = 0x0;
     uint64_t lastKeyHash = 0x0;
     ServerId receiver(1);
+    MasterService::MigrationStream stream(service->context, receiver,
+            tableId, firstKeyHash);
 
     TestLog::reset();
     Status error;
@@ -998,9 +1479,8 @@ TEST_F(MasterServiceTest, migrateSingleLogEntry_rpcResult) {
     for (SegmentIterator it(segment); !it.isDone(); it.next()) {
         error = service->migrateSingleLogEntry(
                 it,
-                transferSeg, entryTotals, totalBytes,
-                tableId, firstKeyHash, lastKeyHash,
-                receiver);
+                stream, entryTotals, totalBytes,
+                tableId, firstKeyHash, lastKeyHash);
         if (error) break;
     }
 
@@ -1071,7 +1551,6 @@ TEST_F(MasterServiceTest, migrateSingleLogEntry_prepAndprepTomb) {
         ASSERT_TRUE(segment.append(LOG_ENTRY_TYPE_PREPTOMB, buffer));
     }
 
-    Tub<Segment> transferSeg;
 
     uint64_t entryTotals[TOTAL_LOG_ENTRY_TYPES] = {0};
     uint64_t totalBytes = 0;
@@ -1079,6 +1558,8 @@ TEST_F(MasterServiceTest, migrateSingleLogEntry_prepAndprepTomb) {
     uint64_t firstKeyHash = keyToMigrate.getHash();
     uint64_t lastKeyHash = keyToMigrate.getHash();
     ServerId receiver(1);
+    MasterService::MigrationStream stream(service->context, receiver,
+            tableId, firstKeyHash);
 
     TestLog::reset();
     Status error;
@@ -1086,9 +1567,8 @@ TEST_F(MasterServiceTest, migrateSingleLogEntry_prepAndprepTomb) {
     for (SegmentIterator it(segment); !it.isDone(); it.next()) {
         error = service->migrateSingleLogEntry(
                 it,
-                transferSeg, entryTotals, totalBytes,
-                tableId, firstKeyHash, lastKeyHash,
-                receiver);
+                stream, entryTotals, totalBytes,
+                tableId, firstKeyHash, lastKeyHash);
         if (error) break;
     }
 
@@ -1131,7 +1611,6 @@ TEST_F(MasterServiceTest, migrateSingleLogEntry_decisionRecord) {
     }
 
     LogIterator it(*service->objectManager.getLog());
-    Tub<Segment> transferSeg;
 
     uint64_t entryTotals[TOTAL_LOG_ENTRY_TYPES] = {0};
     uint64_t totalBytes = 0;
@@ -1139,15 +1618,16 @@ TEST_F(MasterServiceTest, migrateSingleLogEntry_decisionRecord) {
     uint64_t firstKeyHash = 0x0;
     uint64_t lastKeyHash = 0x0;
     ServerId receiver(1);
+    MasterService::MigrationStream stream(service->context, receiver,
+            tableId, firstKeyHash);
 
     TestLog::reset();
     Status error;
     for (; !it.isDone(); it.next()) {
         error = service->migrateSingleLogEntry(
                 *it.getCurrentSegmentIterator(),
-                transferSeg, entryTotals, totalBytes,
-                tableId, firstKeyHash, lastKeyHash,
-                receiver);
+                stream, entryTotals, totalBytes,
+                tableId, firstKeyHash, lastKeyHash);
         if (error) break;
     }
 
@@ -1204,7 +1684,6 @@ TEST_F(MasterServiceTest, migrateSingleLogEntry_participantList) {
     }
 
     LogIterator it(*service->objectManager.getLog());
-    Tub<Segment> transferSeg;
 
     uint64_t entryTotals[TOTAL_LOG_ENTRY_TYPES] = {0};
     uint64_t totalBytes = 0;
@@ -1212,15 +1691,16 @@ TEST_F(MasterServiceTest, migrateSingleLogEntry_participantList) {
     uint64_t firstKeyHash = 0x0;
     uint64_t lastKeyHash = 0x0;
     ServerId receiver(1);
+    MasterService::MigrationStream stream(service->context, receiver,
+            tableId, firstKeyHash);
 
     TestLog::reset();
     Status error;
     for (; !it.isDone(); it.next()) {
         error = service->migrateSingleLogEntry(
                 *it.getCurrentSegmentIterator(),
-                transferSeg, entryTotals, totalBytes,
-                tableId, firstKeyHash, lastKeyHash,
-                receiver);
+                stream, entryTotals, totalBytes,
+                tableId, firstKeyHash, lastKeyHash);
         if (error) break;
     }
 
@@ -1242,6 +1722,45 @@ TEST_F(MasterServiceTest, migrateSingleLogEntry_participantList) {
     EXPECT_EQ(1U, entryTotals[LOG_ENTRY_TYPE_TXPLIST]);
 }
 
+TEST_F(MasterServiceTest, migrationStream_reusesTransferSegments) {
+    // No receiver, so sent segments are just discarded.
+    MasterService::MigrationStream stream(service->context, ServerId(),
+            1, 0);
+    string data(3 * 1024 * 1024, 'x');
+    Buffer buffer;
+    buffer.appendExternal(data.data(), downCast<uint32_t>(data.size()));
+
+    TestLog::Enable _("send", "finish", NULL);
+    // Two entries fit in each transfer segment, so this fills more
+    // segments than there are slots and wraps around.
+    for (int i = 0; i < 11; i++)
+        EXPECT_TRUE(stream.append(LOG_ENTRY_TYPE_OBJ, buffer));
+    EXPECT_EQ("send: Sending migration segment | "
+              "send: Sending migration segment | "
+              "send: Sending migration segment | "
+              "send: Sending migration segment | "
+              "send: Sending migration segment", TestLog::get());
+    EXPECT_EQ(1u, stream.current);
+
+    TestLog::reset();
+    stream.finish();
+    EXPECT_EQ("finish: Sending last migration segment | "
+              "send: Sending migration segment", TestLog::get());
+    foreach (MasterService::MigrationStream::Transfer& transfer,
+            stream.transfers) {
+        EXPECT_FALSE(transfer.segment);
+    }
+}
+
+TEST_F(MasterServiceTest, migrationStream_entryTooLarge) {
+    MasterService::MigrationStream stream(service->context, ServerId(),
+            1, 0);
+    string data(Segment::DEFAULT_SEGMENT_SIZE + 1, 'x');
+    Buffer buffer;
+    buffer.appendExternal(data.data(), downCast<uint32_t>(data.size()));
+    EXPECT_FALSE(stream.append(LOG_ENTRY_TYPE_OBJ, buffer));
+}
+
 TEST_F(MasterServiceTest, migrateTablet_tabletNotOnServer) {
     TestLog::Enable _;
     EXPECT_THROW(ramcloud->migrateTablet(99, 0, -1, ServerId(0, 0)),
@@ -1349,6 +1868,29 @@ TEST_F(MasterServiceTest, multiIncrement_basics) {
     EXPECT_EQ(3U, request1.version + request2.version);
 }
 
+TEST_F(MasterServiceTest, multiIncrement_sameObject) {
+    uint64_t tableId1 = ramcloud->createTable("table1");
+
+    MultiIncrementObject request1(tableId1, "0", 1, 1, 0.0);
+    MultiIncrementObject request2(tableId1, "1", 1, 5, 0.0);
+    MultiIncrementObject request3(tableId1, "0", 1, 2, 0.0);
+    MultiIncrementObject* requests[] = {&request1, &request2, &request3};
+
+    ramcloud->multiIncrement(requests, 3);
+    EXPECT_STREQ("STATUS_OK", statusToSymbol(request1.status));
+    EXPECT_EQ(1, request1.newValue.asInt64);
+    EXPECT_EQ(5, request2.newValue.asInt64);
+    EXPECT_STREQ("STATUS_OK", statusToSymbol(request3.status));
+    EXPECT_EQ(3, request3.newValue.asInt64);
+
+    // Both increments of "0" were written as one version.
+    EXPECT_EQ(request1.version, request3.version);
+    Buffer buffer;
+    uint64_t version;
+    ramcloud->read(tableId1, "0", 1, &buffer, NULL, &version);
+    EXPECT_EQ(request1.version, version);
+}
+
 TEST_F(MasterServiceTest, multiIncrement_rejectRules) {
     RejectRules rules;
     memset(&rules, 0, sizeof(rules));
@@ -1420,6 +1962,40 @@ TEST_F(MasterServiceTest, multiRead_basics) {
             value2.get()->getValue()), 9));
 }
 
+TEST_F(MasterServiceTest, multiRead_multipleBatches) {
+    uint64_t tableId1 = ramcloud->createTable("table1");
+    const uint32_t numObjects = 2 * MasterService::MULTIREAD_BATCH_SIZE + 3;
+    Tub<ObjectBuffer> values[numObjects];
+    Tub<MultiReadObject> objects[numObjects];
+    MultiReadObject* requests[numObjects];
+    string keys[numObjects];
+    for (uint32_t i = 0; i < numObjects; i++) {
+        keys[i] = format("%u", i);
+        // Leave every fifth object out.
+        if (i % 5 != 4) {
+            string value = format("value%u", i);
+            ramcloud->write(tableId1, keys[i].c_str(),
+                    downCast<uint16_t>(keys[i].length()), value.c_str(),
+                    downCast<uint32_t>(value.length()));
+        }
+        objects[i].construct(tableId1, keys[i].c_str(),
+                downCast<uint16_t>(keys[i].length()), &values[i]);
+        requests[i] = objects[i].get();
+    }
+    ramcloud->multiRead(requests, numObjects);
+
+    for (uint32_t i = 0; i < numObjects; i++) {
+        if (i % 5 == 4) {
+            EXPECT_EQ(STATUS_OBJECT_DOESNT_EXIST, objects[i]->status);
+            continue;
+        }
+        string value = format("value%u", i);
+        EXPECT_EQ(STATUS_OK, objects[i]->status);
+        EXPECT_EQ(value, string(reinterpret_cast<const char*>(
+                values[i].get()->getValue()), value.length()));
+    }
+}
+
 TEST_F(MasterServiceTest, multiRead_bufferSizeExceeded) {
     uint64_t tableId1 = ramcloud->createTable("table1");
     service->maxResponseRpcLen = 78;
@@ -1489,6 +2065,27 @@ TEST_F(MasterServiceTest, multiRead_noSuchObject) {
     EXPECT_EQ(STATUS_OBJECT_DOESNT_EXIST, request.status);
 }
 
+TEST_F(MasterServiceTest, multiRead_filter) {
+    uint64_t tableId1 = ramcloud->createTable("table1");
+    ramcloud->write(tableId1, "0", 1, "firstVal", 8);
+    ramcloud->write(tableId1, "1", 1, "secondVal", 9);
+    Tub<ObjectBuffer> value1, value2;
+    MultiReadObject request1(tableId1, "0", 1, &value1);
+    MultiReadObject request2(tableId1, "1", 1, &value2);
+    MultiReadObject* requests[] = {&request1, &request2};
+    ObjectFilter filter(ObjectFilter::EQUAL, ObjectFilter::VALUE, 0, "sec", 3);
+    filter.setProjection(6, ~0U);
+    ramcloud->multiRead(requests, 2, &filter);
+
+    EXPECT_EQ(STATUS_OBJECT_DOESNT_EXIST, request1.status);
+    EXPECT_EQ(STATUS_OK, request2.status);
+    EXPECT_EQ(2U, request2.version);
+    uint32_t valueLength;
+    const void* value = value2.get()->getValue(&valueLength);
+    EXPECT_EQ("Val", string(reinterpret_cast<const char*>(value),
+            valueLength));
+}
+
 TEST_F(MasterServiceTest, multiRemove_basics) {
     uint64_t tableId1 = ramcloud->createTable("table1");
     ramcloud->write(tableId1, "0", 1, "firstVal", 8);
@@ -1546,6 +2143,33 @@ TEST_F(MasterServiceTest, multiRemove_unknownTable) {
     }
 }
 
+TEST_F(MasterServiceTest, multiRemove_indexEntries) {
+    uint64_t tableId1 = ramcloud->createTable("table1");
+    ramcloud->createIndex(tableId1, 1, 0);
+    KeyInfo keyList0[2] = {{"0", 1}, {"air", 3}};
+    KeyInfo keyList1[2] = {{"1", 1}, {"earth", 5}};
+    MultiWriteObject write0(tableId1, "value", 5, 2, keyList0);
+    MultiWriteObject write1(tableId1, "value", 5, 2, keyList1);
+    MultiWriteObject* writes[] = {&write0, &write1};
+    ramcloud->multiWrite(writes, 2);
+
+    TestLog::Enable _("modifyEntries");
+    MultiRemoveObject request1(tableId1, "0", 1);
+    MultiRemoveObject request2(tableId1, "1", 1);
+    MultiRemoveObject* requests[] = {&request1, &request2};
+    ramcloud->multiRemove(requests, 2);
+    EXPECT_EQ(format("modifyEntries: Removing 2 entries: tableId %lu, "
+            "indexId 1", tableId1), TestLog::get());
+
+    Buffer responseBuffer;
+    uint32_t numHashes;
+    uint16_t nextKeyLength;
+    uint64_t nextKeyHash;
+    ramcloud->lookupIndexKeys(tableId1, 1, "a", 1, 0, "z", 1, 100,
+            &responseBuffer, &numHashes, &nextKeyLength, &nextKeyHash);
+    EXPECT_EQ(0U, numHashes);
+}
+
 TEST_F(MasterServiceTest, multiRemove_malformedRequests) {
     // Fabricate a valid-looking RPC, but truncate the increment payload and
     // the key in the buffer.
@@ -1689,6 +2313,46 @@ TEST_F(MasterServiceTest, multiWrite_nullAndEmptyValues) {
             value.getValue()), 15));
 }
 
+TEST_F(MasterServiceTest, multiWrite_indexEntries) {
+    uint64_t tableId1 = ramcloud->createTable("table1");
+    ramcloud->createIndex(tableId1, 1, 0);
+    KeyInfo keyList0[2] = {{"0", 1}, {"air", 3}};
+    KeyInfo keyList1[2] = {{"1", 1}, {"earth", 5}};
+    KeyInfo keyList2[2] = {{"0", 1}, {"fire", 4}};
+    MultiWriteObject request1(tableId1, "value", 5, 2, keyList0);
+    MultiWriteObject request2(tableId1, "value", 5, 2, keyList1);
+    MultiWriteObject* requests[] = {&request1, &request2};
+
+    // The entries for both objects go to the index server in one request.
+    TestLog::Enable _("modifyEntries");
+    ramcloud->multiWrite(requests, 2);
+    EXPECT_EQ(STATUS_OK, request1.status);
+    EXPECT_EQ(STATUS_OK, request2.status);
+    EXPECT_EQ(format("modifyEntries: Inserting 2 entries: tableId %lu, "
+            "indexId 1", tableId1), TestLog::get());
+
+    Buffer responseBuffer;
+    uint32_t numHashes;
+    uint16_t nextKeyLength;
+    uint64_t nextKeyHash;
+    ramcloud->lookupIndexKeys(tableId1, 1, "a", 1, 0, "z", 1, 100,
+            &responseBuffer, &numHashes, &nextKeyLength, &nextKeyHash);
+    EXPECT_EQ(2U, numHashes);
+
+    // Overwriting an object replaces its old index entry.
+    MultiWriteObject request3(tableId1, "value", 5, 2, keyList2);
+    MultiWriteObject* requests2[] = {&request3};
+    ramcloud->multiWrite(requests2, 1);
+    responseBuffer.reset();
+    ramcloud->lookupIndexKeys(tableId1, 1, "air", 3, 0, "air", 3, 100,
+            &responseBuffer, &numHashes, &nextKeyLength, &nextKeyHash);
+    EXPECT_EQ(0U, numHashes);
+    responseBuffer.reset();
+    ramcloud->lookupIndexKeys(tableId1, 1, "fire", 4, 0, "fire", 4, 100,
+            &responseBuffer, &numHashes, &nextKeyLength, &nextKeyHash);
+    EXPECT_EQ(1U, numHashes);
+}
+
 TEST_F(MasterServiceTest, multiWrite_malformedRequests) {
     // Fabricate a valid-looking RPC, but make the key and value length
     // fields not match what's in the buffer.
@@ -1936,6 +2600,100 @@ TEST_F(MasterServiceTest, read_rejectRules) {
     EXPECT_EQ(1U, version);
 }
 
+TEST_F(MasterServiceTest, readChanges) {
+    Buffer changes;
+    uint64_t streamId, position;
+    uint32_t lagMicros;
+    const uint64_t SUBSCRIBE = WireFormat::ReadChanges::Request::SUBSCRIBE;
+    {
+        ReadChangesRpc rpc(ramcloud.get(), 1, 0, ~0UL, SUBSCRIBE, 1000,
+                &changes);
+        EXPECT_THROW(rpc.wait(&streamId, &position, &lagMicros),
+                UnimplementedRequestError);
+    }
+
+    const_cast<ServerConfig*>(service->config)->master.changeStreamBytes =
+            10000;
+    service->changeStream.capacity = 10000;
+    service->objectManager.getLog()->setChangeStream(&service->changeStream);
+    {
+        // Only whole tablets stream changes.
+        ReadChangesRpc rpc(ramcloud.get(), 1, 0, 5, SUBSCRIBE, 1000,
+                &changes);
+        EXPECT_THROW(rpc.wait(&streamId, &position, &lagMicros),
+                UnknownTabletException);
+    }
+    {
+        ReadChangesRpc rpc(ramcloud.get(), 1, 0, ~0UL, SUBSCRIBE, 1000,
+                &changes);
+        EXPECT_TRUE(rpc.wait(&streamId, &position, &lagMicros));
+        EXPECT_EQ(masterServer->serverId.getId(), streamId);
+        EXPECT_EQ(0U, position);
+    }
+
+    string value(1000, 'x');
+    ramcloud->write(1, "0", 1, "abcdef", 6);
+    ramcloud->remove(1, "0", 1);
+    ramcloud->write(1, "1", 1, value.c_str(), 1000);
+    metrics->changeStream.sentBytes = 0;
+    metrics->changeStream.sentCompressedBytes = 0;
+    {
+        ReadChangesRpc rpc(ramcloud.get(), 1, 0, ~0UL, position, 10000,
+                &changes);
+        EXPECT_TRUE(rpc.wait(&streamId, &position, &lagMicros));
+        EXPECT_EQ(service->changeStream.head, position);
+        EXPECT_EQ(0U, lagMicros);
+        string types;
+        uint32_t offset = 0;
+        while (offset < changes.size()) {
+            const WireFormat::ReadChanges::Change* change =
+                    changes.getOffset<WireFormat::ReadChanges::Change>(
+                    offset);
+            if (!types.empty())
+                types += " | ";
+            types += LogEntryTypeHelpers::toString(
+                    static_cast<LogEntryType>(change->type));
+            offset += sizeof32(*change) + change->length;
+        }
+        EXPECT_EQ("Object | Object Tombstone | Object", types);
+        EXPECT_EQ(changes.size(), metrics->changeStream.sentBytes);
+        EXPECT_LT(metrics->changeStream.sentCompressedBytes,
+                metrics->changeStream.sentBytes);
+    }
+
+    // Fall so far behind that the changes are overwritten.
+    while (service->changeStream.tail <= position)
+        ramcloud->write(1, "1", 1, value.c_str(), 1000);
+    {
+        ReadChangesRpc rpc(ramcloud.get(), 1, 0, ~0UL, position, 10000,
+                &changes);
+        EXPECT_FALSE(rpc.wait(&streamId, &position, &lagMicros));
+    }
+}
+
+TEST_F(MasterServiceTest, readFromReplica) {
+    ramcloud->write(1, "0", 1, "abcdef", 6);
+    Transport::SessionRef session =
+            context.transportManager->getSession("mock:host=master");
+    Buffer value;
+    uint64_t version;
+    {
+        // The tablet's owner is always up to date.
+        ReadFromReplicaRpc rpc(ramcloud.get(), session, 1, "0", 1, 0,
+                &value);
+        EXPECT_TRUE(rpc.wait(&version));
+        EXPECT_EQ("abcdef", TestUtil::toString(&value));
+        EXPECT_EQ(1U, version);
+    }
+
+    // A replica that has never been synced serves nothing.
+    service->tabletManager.addTablet(2, 0, ~0UL,
+            TabletManager::READ_REPLICA);
+    ReadFromReplicaRpc rpc(ramcloud.get(), session, 2, "0", 1, 1000000,
+            &value);
+    EXPECT_FALSE(rpc.wait());
+}
+
 TEST_F(MasterServiceTest, receiveMigrationData) {
     Segment s;
 
@@ -1990,6 +2748,25 @@ TEST_F(MasterServiceTest, receiveMigrationData) {
             "watch out for the migrant object");
 }
 
+TEST_F(MasterServiceTest, receiveMigrationData_clusterTime) {
+    Segment s;
+    service->clusterClock.raiseSafeLimit(ClusterTime(1000));
+    service->clusterClock.updateClock(ClusterTime(50));
+
+    // The receiver advances to the sender's time, up to its safe limit,
+    // even if the rpc fails.
+    ReceiveMigrationDataRpc rpc(&context, masterServer->serverId, &s, 6, 0,
+            false, 0, 0, NULL, 0, ClusterTime(200).getEncoded());
+    uint64_t clusterTime = 0;
+    EXPECT_THROW(rpc.wait(&clusterTime), UnknownTabletException);
+    EXPECT_EQ(ClusterTime(200), service->clusterClock.getTime());
+
+    ReceiveMigrationDataRpc rpc2(&context, masterServer->serverId, &s, 6, 0,
+            false, 0, 0, NULL, 0, ClusterTime(5000).getEncoded());
+    EXPECT_THROW(rpc2.wait(&clusterTime), UnknownTabletException);
+    EXPECT_EQ(ClusterTime(1000), service->clusterClock.getTime());
+}
+
 TEST_F(MasterServiceTest, receiveMigrationData_indexletData) {
     Segment s;
 
@@ -2288,6 +3065,27 @@ TEST_F(MasterServiceTest, requestInsertIndexEntries_basics) {
             TestLog::get());
 }
 
+TEST_F(MasterServiceTest, requestInsertIndexEntries_primaryKeyIndex) {
+    ramcloud->createIndex(1, 0, IndexKey::BTREE_INDEX);
+    TestLog::Enable _("requestInsertIndexEntries", NULL);
+    Key key(1, "key0", 4);
+    Buffer objBuffer;
+    Object obj(key, "value", 5, 1, 0, objBuffer);
+    service->requestInsertIndexEntries(obj);
+    EXPECT_EQ(format("requestInsertIndexEntries: "
+            "Inserting index entry for tableId 1, keyIndex 0, "
+            "key key0, primaryKeyHash %lu", key.getHash()),
+            TestLog::get());
+    EXPECT_EQ(1, service->masterTableMetadata.find(1)->primaryKeyIndexed);
+}
+
+TEST_F(MasterServiceTest, firstIndexedKey) {
+    EXPECT_EQ(1U, service->firstIndexedKey(1));
+    EXPECT_EQ(0, service->masterTableMetadata.find(1)->primaryKeyIndexed);
+    ramcloud->createIndex(1, 0, IndexKey::BTREE_INDEX);
+    EXPECT_EQ(0U, service->firstIndexedKey(1));
+}
+
 TEST_F(MasterServiceTest, requestRemoveIndexEntries_noIndexEntries) {
     TestLog::Enable _;
 
@@ -2332,6 +3130,24 @@ TEST_F(MasterServiceTest, requestRemoveIndexEntries_basics) {
 }
 
 
+TEST_F(MasterServiceTest, setReadReplica) {
+    Key key(1, "0", 1);
+    Key other(2, "0", 1);
+    ServerId replica(5, 0);
+    EXPECT_EQ(STATUS_UNKNOWN_TABLET, service->setReadReplica(other, replica));
+    EXPECT_EQ(STATUS_INVALID_PARAMETER,
+            service->setReadReplica(key, masterServer->serverId));
+    EXPECT_EQ(STATUS_OK, service->setReadReplica(key, replica));
+    TabletManager::Tablet tablet;
+    ASSERT_TRUE(service->tabletManager.getTablet(key, &tablet));
+    EXPECT_EQ(replica, service->readReplicaFeeder.getReplica(tablet));
+
+    // Removing the replica queues it to be deleted.
+    EXPECT_EQ(STATUS_OK, service->setReadReplica(key, ServerId()));
+    EXPECT_FALSE(service->readReplicaFeeder.getReplica(tablet).isValid());
+    EXPECT_EQ(1U, service->readReplicaFeeder.dropped.size());
+}
+
 TEST_F(MasterServiceTest, splitAndMigrateIndexlet_indexletNotOnServer) {
     ServerConfig master2Config = masterConfig;
     master2Config.master.numReplicas = 0;
@@ -2598,6 +3414,27 @@ TEST_F(MasterServiceTest, splitMasterTablet) {
             service->tabletManager.toString());
 }
 
+TEST_F(MasterServiceTest, syncReadReplica) {
+    Key key(2, "0", 1);
+    WireFormat::ReadReplicaSync sync = {2, 0, ~0UL,
+            WireFormat::ReadReplicaSync::NOT_SYNCED};
+    EXPECT_EQ(STATUS_OK, service->syncReadReplica(&sync));
+    TabletManager::Tablet tablet;
+    ASSERT_TRUE(service->tabletManager.getTablet(key, &tablet));
+    EXPECT_EQ(TabletManager::READ_REPLICA, tablet.state);
+    EXPECT_FALSE(service->tabletManager.checkAndIncrementReadCount(key, 1));
+
+    sync.ageMicros = 0;
+    EXPECT_EQ(STATUS_OK, service->syncReadReplica(&sync));
+    EXPECT_TRUE(service->tabletManager.checkAndIncrementReadCount(key, 1));
+
+    // Replicas may not overlap the master's other tablets.
+    WireFormat::ReadReplicaSync overlap = {2, 5, 10, 0};
+    EXPECT_EQ(STATUS_OBJECT_EXISTS, service->syncReadReplica(&overlap));
+    WireFormat::ReadReplicaSync owned = {1, 0, ~0UL, 0};
+    EXPECT_EQ(STATUS_OBJECT_EXISTS, service->syncReadReplica(&owned));
+}
+
 TEST_F(MasterServiceTest, takeTabletOwnership_syncLog) {
     TestLog::Enable _("takeTabletOwnership", "sync", NULL);
 
@@ -2881,7 +3718,7 @@ TEST_F(MasterServiceTest, txDecision_abort) {
     EXPECT_EQ(STATUS_OK, respHdr.common.status);
 
     // 4. Check outcome of ABORT.
-    EXPECT_EQ(0U, service->preparedOps.items.size());
+    EXPECT_EQ(0U, service->preparedOps.size());
 
     // 5. check locks are released.
     EXPECT_FALSE(isObjectLocked(key1));
@@ -2950,7 +3787,7 @@ TEST_F(MasterServiceTest, txDecision_unknownTablet) {
     EXPECT_EQ(STATUS_UNKNOWN_TABLET, respHdr.common.status);
 
     // 4. Check outcome of ABORT. key1 is processed and key3 couldn't.
-    EXPECT_EQ(1U, service->preparedOps.items.size());
+    EXPECT_EQ(1U, service->preparedOps.size());
 
     // 5. check locks are released.
     EXPECT_FALSE(isObjectLocked(key1));
@@ -3059,7 +3896,7 @@ TEST_F(MasterServiceTest, txPrepare_basics) {
     EXPECT_EQ(TxPrepare::PREPARED, respHdr.vote);
 
     // 4. Check outcome of Prepare.
-    EXPECT_EQ(3U, service->preparedOps.items.size());
+    EXPECT_EQ(3U, service->preparedOps.size());
     EXPECT_TRUE(isObjectLocked(key1));
     EXPECT_TRUE(isObjectLocked(key2));
     EXPECT_TRUE(isObjectLocked(key3));
@@ -3166,7 +4003,7 @@ TEST_F(MasterServiceTest, txPrepare_retriedPrepares) {
     EXPECT_EQ(TxPrepare::PREPARED, respHdr.vote);
 
     // 4. Check outcome of Prepare.
-    EXPECT_EQ(3U, service->preparedOps.items.size());
+    EXPECT_EQ(3U, service->preparedOps.size());
     EXPECT_TRUE(isObjectLocked(key1));
     EXPECT_TRUE(isObjectLocked(key2));
     EXPECT_TRUE(isObjectLocked(key3));
@@ -3176,7 +4013,7 @@ TEST_F(MasterServiceTest, txPrepare_retriedPrepares) {
     EXPECT_EQ(STATUS_OK, respHdr.common.status);
     EXPECT_EQ(TxPrepare::PREPARED, respHdr.vote);
 
-    EXPECT_EQ(3U, service->preparedOps.items.size());
+    EXPECT_EQ(3U, service->preparedOps.size());
     EXPECT_TRUE(isObjectLocked(key1));
     EXPECT_TRUE(isObjectLocked(key2));
     EXPECT_TRUE(isObjectLocked(key3));
@@ -3217,7 +4054,7 @@ TEST_F(MasterServiceTest, txPrepare_retriedPrepares) {
     EXPECT_EQ(STATUS_OK, respHdr.common.status);
     EXPECT_EQ(TxPrepare::ABORT, respHdr.vote);
 
-    EXPECT_EQ(3U, service->preparedOps.items.size());
+    EXPECT_EQ(3U, service->preparedOps.size());
     EXPECT_TRUE(isObjectLocked(key1));
     EXPECT_TRUE(isObjectLocked(key2));
     EXPECT_TRUE(isObjectLocked(key3));
@@ -3240,7 +4077,7 @@ TEST_F(MasterServiceTest, txPrepare_retriedPrepares) {
     EXPECT_EQ(STATUS_OK, respHdr.common.status);
     EXPECT_EQ(TxPrepare::PREPARED, respHdr.vote);
 
-    EXPECT_EQ(4U, service->preparedOps.items.size());
+    EXPECT_EQ(4U, service->preparedOps.size());
     EXPECT_TRUE(isObjectLocked(key1));
     EXPECT_TRUE(isObjectLocked(key2));
     EXPECT_TRUE(isObjectLocked(key3));
@@ -3337,13 +4174,16 @@ TEST_F(MasterServiceTest, txPrepare_singleRpcOptimization) {
                                 value.getRange(0, value.size())),
                                 value.size()));
     }
+    TestLog::reset();
+    TestLog::Enable _("prepareOp", NULL);
     service->txPrepare(&reqHdr, &respHdr, &rpc);
 
     EXPECT_EQ(STATUS_OK, respHdr.common.status);
     EXPECT_EQ(TxPrepare::COMMITTED, respHdr.vote);
+    EXPECT_EQ("", TestLog::get());
 
     // 4. Check outcome of Prepare.
-    EXPECT_EQ(0U, service->preparedOps.items.size());
+    EXPECT_EQ(0U, service->preparedOps.size());
     EXPECT_FALSE(isObjectLocked(key1));
     EXPECT_FALSE(isObjectLocked(key2));
     EXPECT_FALSE(isObjectLocked(key3));
@@ -3365,6 +4205,73 @@ TEST_F(MasterServiceTest, txPrepare_singleRpcOptimization) {
                             value.size()));
 }
 
+TEST_F(MasterServiceTest, txPrepare_oneShotRetried) {
+    ramcloud->write(1, "key1", 4, "item1", 5);
+
+    using WireFormat::TxParticipant;
+    using WireFormat::TxPrepare;
+    Key key1(1, "key1", 4);
+    TxParticipant participant(key1.getTableId(), key1.getHash(), 10U);
+    Buffer keysAndValueBuf;
+    Object::appendKeysAndValueToBuffer(key1, "new", 3, &keysAndValueBuf);
+
+    TxPrepare::Request reqHdr;
+    reqHdr.common.opcode = WireFormat::Opcode::TX_PREPARE;
+    reqHdr.common.service = WireFormat::MASTER_SERVICE;
+    reqHdr.lease = {1, 10, 5};
+    reqHdr.clientTxId = 9;
+    reqHdr.ackId = 8;
+    reqHdr.participantCount = 1;
+    reqHdr.opCount = 1;
+
+    // The reject rule fails, so the transaction aborts; so does its retry.
+    RejectRules rejectRules = {2UL, false, false, false, true};
+    TxPrepare::Request::WriteOp op(key1.getTableId(), 10,
+                                   keysAndValueBuf.size(), rejectRules);
+    Buffer reqBuffer, respBuffer;
+    reqBuffer.appendCopy(&reqHdr, sizeof32(reqHdr));
+    reqBuffer.appendExternal(&participant, sizeof32(participant));
+    reqBuffer.appendExternal(&op, sizeof32(op));
+    reqBuffer.appendExternal(&keysAndValueBuf);
+    for (int i = 0; i < 2; i++) {
+        TxPrepare::Response respHdr;
+        Service::Rpc rpc(NULL, &reqBuffer, &respBuffer);
+        service->txPrepare(&reqHdr, &respHdr, &rpc);
+        EXPECT_EQ(STATUS_OK, respHdr.common.status);
+        EXPECT_EQ(TxPrepare::ABORT, respHdr.vote);
+    }
+    Buffer value;
+    uint64_t version;
+    ramcloud->read(1, "key1", 4, &value, NULL, &version);
+    EXPECT_EQ(1U, version);
+
+    // A new transaction commits; retrying it doesn't write the object again.
+    reqHdr.clientTxId = 11;
+    participant.rpcId = 12;
+    TxPrepare::Request::WriteOp op2(key1.getTableId(), 12,
+                                    keysAndValueBuf.size(), RejectRules());
+    reqBuffer.reset();
+    reqBuffer.appendCopy(&reqHdr, sizeof32(reqHdr));
+    reqBuffer.appendExternal(&participant, sizeof32(participant));
+    reqBuffer.appendExternal(&op2, sizeof32(op2));
+    reqBuffer.appendExternal(&keysAndValueBuf);
+    for (int i = 0; i < 2; i++) {
+        TxPrepare::Response respHdr;
+        Service::Rpc rpc(NULL, &reqBuffer, &respBuffer);
+        service->txPrepare(&reqHdr, &respHdr, &rpc);
+        EXPECT_EQ(STATUS_OK, respHdr.common.status);
+        EXPECT_EQ(TxPrepare::COMMITTED, respHdr.vote);
+    }
+    EXPECT_EQ(0U, service->preparedOps.size());
+    EXPECT_FALSE(isObjectLocked(key1));
+    value.reset();
+    ramcloud->read(1, "key1", 4, &value, NULL, &version);
+    EXPECT_EQ(2U, version);
+    EXPECT_EQ("new", string(reinterpret_cast<const char*>(
+                            value.getRange(0, value.size())),
+                            value.size()));
+}
+
 TEST_F(MasterServiceTest, txPrepare_readOnly) {
     // 1. Test setup: Add objects to be used during experiment.
     uint64_t version;
@@ -3464,7 +4371,8 @@ TEST_F(MasterServiceTest, txPrepare_readOnly) {
     EXPECT_EQ(TxPrepare::PREPARED, respHdr.vote);
 
     // 4. Check outcome of Prepare.
-    EXPECT_EQ(0U, service->preparedOps.items.size());
+    EXPECT_EQ(0U, service->preparedOps.size());
+    EXPECT_FALSE(service->unackedRpcResults.hasRecord(1, 9));
     EXPECT_FALSE(isObjectLocked(key1));
     EXPECT_FALSE(isObjectLocked(key2));
     EXPECT_FALSE(isObjectLocked(key3));
@@ -3598,7 +4506,7 @@ TEST_F(MasterServiceTest, txPrepare_readOnly_failByLock) {
     EXPECT_EQ(TxPrepare::ABORT, respHdr.vote);
 
     // 4. Check outcome of Prepare.
-    EXPECT_EQ(1U, service->preparedOps.items.size());
+    EXPECT_EQ(1U, service->preparedOps.size());
     EXPECT_FALSE(isObjectLocked(key1));
     EXPECT_TRUE(isObjectLocked(key2));
     EXPECT_FALSE(isObjectLocked(key3));
@@ -3703,7 +4611,7 @@ TEST_F(MasterServiceTest, txPrepare_readOnly_failByVer) {
     EXPECT_EQ(TxPrepare::ABORT, respHdr.vote);
 
     // 4. Check outcome of Prepare.
-    EXPECT_EQ(0U, service->preparedOps.items.size());
+    EXPECT_EQ(0U, service->preparedOps.size());
     EXPECT_FALSE(isObjectLocked(key1));
     EXPECT_FALSE(isObjectLocked(key2));
     EXPECT_FALSE(isObjectLocked(key3));
@@ -3972,6 +4880,126 @@ TEST_F(MasterServiceTest, MigrationMonitor_basics) {
     Cycles::mockTscValue = 0;
 }
 
+TEST_F(MasterServiceTest, ReadReplicaFeeder_sync) {
+    ServerConfig master2Config = masterConfig;
+    master2Config.master.numReplicas = 0;
+    master2Config.localLocator = "mock:host=master2";
+    master2Config.services = {WireFormat::MASTER_SERVICE,
+            WireFormat::MEMBERSHIP_SERVICE, WireFormat::PING_SERVICE};
+    Server* master2 = cluster.addServer(master2Config);
+    MasterService::ReadReplicaFeeder& feeder = service->readReplicaFeeder;
+    Transport::SessionRef session =
+            context.transportManager->getSession("mock:host=master2");
+    Buffer value;
+
+    ramcloud->write(1, "0", 1, "abcdef", 6);
+    Key key(1, "0", 1);
+    EXPECT_EQ(STATUS_OK, service->setReadReplica(key, master2->serverId));
+    feeder.handleTimerEvent();
+    TabletManager::Tablet tablet;
+    ASSERT_TRUE(master2->master->tabletManager.getTablet(key, &tablet));
+    EXPECT_EQ(TabletManager::READ_REPLICA, tablet.state);
+    {
+        ReadFromReplicaRpc rpc(ramcloud.get(), session, 1, "0", 1, 1000000,
+                &value);
+        EXPECT_TRUE(rpc.wait());
+        EXPECT_EQ("abcdef", TestUtil::toString(&value));
+    }
+
+    // Later rounds carry on from where the previous one stopped.
+    ramcloud->remove(1, "0", 1);
+    feeder.handleTimerEvent();
+    EXPECT_EQ(2U, feeder.replicas.begin()->second.rounds);
+    {
+        ReadFromReplicaRpc rpc(ramcloud.get(), session, 1, "0", 1, 1000000,
+                &value);
+        EXPECT_FALSE(rpc.wait());
+    }
+
+    // A replica that is no longer wanted is deleted.
+    EXPECT_EQ(STATUS_OK, service->setReadReplica(key, ServerId()));
+    feeder.handleTimerEvent();
+    EXPECT_FALSE(master2->master->tabletManager.getTablet(key));
+    EXPECT_EQ(0U, feeder.dropped.size());
+}
+
+TEST_F(MasterServiceTest, ReadReplicaFeeder_ownerLosesTablet) {
+    Key key(1, "0", 1);
+    EXPECT_EQ(STATUS_OK, service->setReadReplica(key, ServerId(5, 0)));
+    service->tabletManager.deleteTablet(1, 0, ~0UL);
+    TestLog::reset();
+    service->readReplicaFeeder.handleTimerEvent();
+    EXPECT_EQ(0U, service->readReplicaFeeder.replicas.size());
+    EXPECT_EQ("sync: No longer own tablet [0x0,0xffffffffffffffff] in "
+            "tableId 1; deleting its read replica on 5.0",
+            TestLog::get());
+}
+
+TEST_F(MasterServiceTest, TabletLoadReporter_handleTimerEvent) {
+    service->tabletManager.addTablet(2, 0, 99, TabletManager::NORMAL);
+    service->tabletManager.addTablet(2, 100, 200, TabletManager::RECOVERING);
+    service->tabletManager.incrementReadCount(1, 5);
+    service->tabletManager.incrementReadCount(1, 5);
+    service->tabletManager.incrementWriteCount(2, 50);
+    MasterService::TabletLoadReporter& reporter = service->tabletLoadReporter;
+    reporter.wakeupInterval = Cycles::fromSeconds(10.0);
+
+    reporter.handleTimerEvent();
+    EXPECT_TRUE(reporter.isRunning());
+    reporter.stop();
+    EXPECT_FALSE(reporter.lastReportIdle);
+    // The recovering tablet isn't reported.
+    EXPECT_EQ(2u, reporter.lastCounts.size());
+    service->objectManager.getReplicaManager()->proceed(); // send rpc
+    service->objectManager.getReplicaManager()->proceed(); // reap rpc
+    CoordinatorServerList::Entry entry =
+        (*cluster.coordinatorContext.coordinatorServerList)[
+            masterServer->serverId];
+    ASSERT_EQ(2, entry.masterRecoveryInfo.tablet_load_size());
+    // Tablets may be reported in any order.
+    std::map<uint64_t, ProtoBuf::MasterRecoveryInfo::TabletLoad> loads;
+    foreach (const ProtoBuf::MasterRecoveryInfo::TabletLoad& load,
+             entry.masterRecoveryInfo.tablet_load()) {
+        loads[load.table_id()] = load;
+    }
+    EXPECT_EQ(2lu, loads[1].read_count());
+    EXPECT_EQ(0lu, loads[1].write_count());
+    EXPECT_EQ(99lu, loads[2].end_key_hash());
+    EXPECT_EQ(1lu, loads[2].write_count());
+
+    // Reports cover only the activity since the previous one.
+    service->tabletManager.incrementReadCount(1, 5);
+    reporter.handleTimerEvent();
+    reporter.stop();
+    service->objectManager.getReplicaManager()->proceed();
+    service->objectManager.getReplicaManager()->proceed();
+    entry = (*cluster.coordinatorContext.coordinatorServerList)[
+            masterServer->serverId];
+    foreach (const ProtoBuf::MasterRecoveryInfo::TabletLoad& load,
+             entry.masterRecoveryInfo.tablet_load()) {
+        loads[load.table_id()] = load;
+    }
+    EXPECT_EQ(1lu, loads[1].read_count());
+    EXPECT_EQ(0lu, loads[2].write_count());
+}
+
+TEST_F(MasterServiceTest, TabletLoadReporter_idle) {
+    MasterService::TabletLoadReporter& reporter = service->tabletLoadReporter;
+    reporter.wakeupInterval = Cycles::fromSeconds(10.0);
+    reporter.handleTimerEvent();
+    reporter.stop();
+    EXPECT_TRUE(reporter.lastReportIdle);
+    // The first idle report is still sent; later ones aren't.
+    EXPECT_TRUE(service->objectManager.getReplicaManager()->
+                replicationEpoch->tabletLoadChanged);
+    service->objectManager.getReplicaManager()->replicationEpoch->
+            tabletLoadChanged = false;
+    reporter.handleTimerEvent();
+    reporter.stop();
+    EXPECT_FALSE(service->objectManager.getReplicaManager()->
+                 replicationEpoch->tabletLoadChanged);
+}
+
 TEST_F(MasterServiceTest, MigrationMonitor_migrationRunsTooLong) {
     Cycles::mockTscValue = 1000;
     service->migrationMonitor.migrationStarting(1, 0, ~0ul);
@@ -4028,6 +5056,55 @@ TEST_F(MasterServiceTest, MigrationMonitor_longRunningMigration) {
     Cycles::mockTscValue = 0;
 }
 
+TEST_F(MasterServiceTest, DurabilityQueue_basics) {
+    MockTransport transport(&context);
+    MasterService::DurabilityQueue* queue = &service->durabilityQueue;
+
+    // Append an object without syncing it.
+    Key key(1, "0", 1);
+    Buffer buffer;
+    Object::appendKeysAndValueToBuffer(key, "item0", 5, &buffer);
+    Object object(1, 0, 0, buffer);
+    EXPECT_EQ(STATUS_OK,
+            service->objectManager.writeObject(object, NULL, NULL));
+
+    Worker worker(NULL);
+    worker.rpc = new MockTransport::MockServerRpc(&transport, NULL);
+    worker.state = Worker::WORKING;
+    worker.rpc->replyPayload.fillFromString("0x10001");
+    Service::Rpc rpc(&worker, &worker.rpc->requestPayload,
+            &worker.rpc->replyPayload);
+    queue->deferReply(&rpc);
+    EXPECT_TRUE(worker.rpc == NULL);
+    EXPECT_TRUE(worker.replySent());
+    EXPECT_EQ(1, queue->numEntries.load());
+    EXPECT_EQ("", transport.outputLog);
+
+    for (int i = 0; i < 1000 && queue->numEntries.load() > 0; i++) {
+        queue->poll();
+    }
+    EXPECT_EQ(0, queue->numEntries.load());
+    EXPECT_EQ("serverReply: 0x10001", transport.outputLog);
+    EXPECT_EQ(0, queue->poll());
+}
+
+TEST_F(MasterServiceTest, DurabilityQueue_deferReply_noWorker) {
+    Key key(1, "0", 1);
+    Buffer buffer;
+    Object::appendKeysAndValueToBuffer(key, "item0", 5, &buffer);
+    Object object(1, 0, 0, buffer);
+    EXPECT_EQ(STATUS_OK,
+            service->objectManager.writeObject(object, NULL, NULL));
+
+    // Without a worker the reply can't be deferred, so we sync instead.
+    Buffer request, reply;
+    Service::Rpc rpc(NULL, &request, &reply);
+    service->durabilityQueue.deferReply(&rpc);
+    EXPECT_EQ(0, service->durabilityQueue.numEntries.load());
+    LogSegment* head = service->objectManager.log.head;
+    EXPECT_EQ(head->getAppendedLength(), head->syncedLength.load());
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 /////Recovery related tests. This should eventually move into its own file.////
 ///////////////////////////////////////////////////////////////////////////////
@@ -4058,7 +5135,7 @@ TEST_F(MasterServiceTest, detectSegmentRecoveryFailure_failure) {
 TEST_F(MasterServiceTest, recover_basics) {
     cluster.coordinator->recoveryManager.start();
     ServerId serverId(123, 0);
-    ReplicaManager mgr(&context, &serverId, 1, false, false);
+    ReplicaManager mgr(&context, &serverId, 1, false, false, false);
 
     // Create a segment with objectSafeVersion 23
     writeRecoverableSegment(&context, mgr, serverId, serverId.getId(), 87, 23U);
@@ -4152,7 +5229,7 @@ TEST_F(MasterServiceTest, recover_basics) {
 TEST_F(MasterServiceTest, recover_basic_indexlet) {
     cluster.coordinator->recoveryManager.start();
     ServerId serverId(123, 0);
-    ReplicaManager mgr(&context, &serverId, 1, false, false);
+    ReplicaManager mgr(&context, &serverId, 1, false, false, false);
 
     // Create a segment with objectSafeVersion 23
     writeRecoverableSegment(&context, mgr, serverId, serverId.getId(),
@@ -4252,7 +5329,7 @@ TEST_F(MasterServiceTest, recover_basic_indexlet) {
 TEST_F(MasterServiceTest, recover) {
     ServerId serverId(123, 0);
 
-    ReplicaManager mgr(&context, &serverId, 1, false, false);
+    ReplicaManager mgr(&context, &serverId, 1, false, false, false);
     writeRecoverableSegment(&context, mgr, serverId, serverId.getId(), 88);
 
     ServerConfig backup2Config = backup1Config;
@@ -4408,6 +5485,36 @@ TEST_F(MasterServiceTest, recover_ctimeUpdateIssued) {
             TestLog::getUntil("ctime_log_head_id", curPos, &curPos));
 }
 
+TEST_F(MasterServiceTest, recover_byRange) {
+    cluster.coordinator->recoveryManager.start();
+    TestLog::Enable _("recoverByRange", "recoveryMasterFinished", NULL);
+    ProtoBuf::RecoveryPartition recoveryPartition;
+    createRecoveryPartition(recoveryPartition);
+    // Divide the partition into two ranges.
+    recoveryPartition.mutable_tablet(2)->set_user_data(1);
+    recoveryPartition.mutable_tablet(3)->set_user_data(1);
+    WireFormat::Recover::Replica replicas[] = {};
+    MasterClient::recover(&context, masterServer->serverId, 10lu,
+            ServerId(123), 0, &recoveryPartition, replicas, 0);
+
+    // The first range is reported on its own as soon as it is recovered.
+    // The coordinator has no record of the recovery, so it refuses the
+    // range and the rest of the partition isn't recovered.
+    size_t curPos = 0;
+    EXPECT_EQ("recoverByRange: Reporting completion of range 0 (2 tablets) "
+            "of recovery 10 | "
+            "recoveryMasterFinished: Called by masterId 2.0 with 2 tablets "
+            "and 0 indexlets (partial) | ",
+            TestLog::getUntil("recoveryMasterFinished: Recovered tablets",
+                    curPos, &curPos));
+    EXPECT_TRUE(TestUtil::contains(TestLog::get(),
+            "Called by masterId 2.0 with 4 tablets and 0 indexlets | "));
+    foreach (const auto& tablet, recoveryPartition.tablet()) {
+        EXPECT_FALSE(service->tabletManager.getTablet(tablet.table_id(),
+                tablet.start_key_hash(), tablet.end_key_hash()));
+    }
+}
+
 TEST_F(MasterServiceTest, recover_unsuccessful) {
     cluster.coordinator->recoveryManager.start();
     TestLog::Enable _("recover", "deleteKeyHashRange", NULL);
@@ -4485,13 +5592,14 @@ class MasterRecoverTest : public ::testing::Test {
     { }
 
     MasterService*
-    createMasterService()
+    createMasterService(uint32_t recoveryReplayThreads = 1)
     {
         ServerConfig config = ServerConfig::forTesting();
         config.localLocator = "mock:host=master";
         config.services = {WireFormat::MASTER_SERVICE,
                 WireFormat::MEMBERSHIP_SERVICE};
         config.master.numReplicas = 2;
+        config.master.recoveryReplayThreads = recoveryReplayThreads;
         return cluster.addServer(config)->master.get();
     }
 
@@ -4534,7 +5642,7 @@ TEST_F(MasterRecoverTest, recover) {
             {WireFormat::BACKUP_SERVICE, WireFormat::MEMBERSHIP_SERVICE},
             100, ServerStatus::UP});
     ServerId serverId(99, 0);
-    ReplicaManager mgr(&context2, &serverId, 1, false, false);
+    ReplicaManager mgr(&context2, &serverId, 1, false, false, false);
     MasterServiceTest::writeRecoverableSegment(&context, mgr, serverId, 99, 87);
     MasterServiceTest::writeRecoverableSegment(&context, mgr, serverId, 99, 88);
 
@@ -4573,6 +5681,51 @@ TEST_F(MasterRecoverTest, recover) {
             "recover: Segment 87 replay complete"));
 }
 
+TEST_F(MasterRecoverTest, recover_parallelReplay) {
+    MasterService* master = createMasterService(3);
+
+    Context context2;
+    ServerList serverList2(&context2);
+    context2.transportManager->registerMock(&cluster.transport);
+    serverList2.testingAdd({backup1Id, "mock:host=backup1",
+            {WireFormat::BACKUP_SERVICE, WireFormat::MEMBERSHIP_SERVICE},
+            100, ServerStatus::UP});
+    ServerId serverId(99, 0);
+    ReplicaManager mgr(&context2, &serverId, 1, false, false, false);
+    MasterServiceTest::writeRecoverableSegment(&context, mgr, serverId, 99, 87,
+                                               1000);
+    MasterServiceTest::writeRecoverableSegment(&context, mgr, serverId, 99, 88,
+                                               2000);
+
+    ProtoBuf::RecoveryPartition recoveryPartition;
+    createRecoveryPartition(recoveryPartition);
+    BackupClient::startReadingData(&context, backup1Id, 456lu, ServerId(99));
+    BackupClient::StartPartitioningReplicas(&context, backup1Id, 456lu,
+            ServerId(99), &recoveryPartition);
+
+    vector<MasterService::Replica> replicas {
+        { backup1Id.getId(), 87 },
+        { backup1Id.getId(), 88 },
+    };
+
+    uint64_t threadCount = metrics->master.replayThreadCount;
+    uint64_t safeVersions = metrics->master.safeVersionRecoveryCount +
+            metrics->master.safeVersionNonRecoveryCount;
+    TestLog::Enable _("recover", NULL);
+    std::unordered_map<uint64_t, uint64_t> nextNodeIdMap;
+    master->recover(456lu, ServerId(99, 0), 0, replicas, nextNodeIdMap);
+    EXPECT_NE(string::npos, TestLog::get().find(
+            "recover: Segment 87 replay complete"));
+    EXPECT_NE(string::npos, TestLog::get().find(
+            "recover: Segment 88 replay complete"));
+    EXPECT_EQ(3U, metrics->master.replayThreadCount - threadCount);
+
+    // Each segment's safe version is replayed once, by the first shard.
+    EXPECT_EQ(2U, metrics->master.safeVersionRecoveryCount +
+            metrics->master.safeVersionNonRecoveryCount - safeVersions);
+    EXPECT_EQ(2000U, master->objectManager.segmentManager.safeVersion);
+}
+
 TEST_F(MasterRecoverTest, failedToRecoverAll) {
     MasterService* master = createMasterService();
 
@@ -0,0 +1,232 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "MasterSnapshot.h"
+#include "ShortMacros.h"
+
+namespace RAMCloud {
+
+namespace {
+
+/**
+ * Write all of a region to a file, throwing an Exception on failure.
+ */
+void
+writeAll(int fd, const void* buf, size_t count, const string& path)
+{
+    const char* p = static_cast<const char*>(buf);
+    while (count > 0) {
+        ssize_t r = write(fd, p, count);
+        if (r < 0) {
+            if (errno == EINTR)
+                continue;
+            throw Exception(HERE, format("Couldn't write snapshot %s",
+                    path.c_str()), errno);
+        }
+        p += r;
+        count -= static_cast<size_t>(r);
+    }
+}
+
+} // anonymous namespace
+
+/**
+ * Open a snapshot written earlier by save and find the segments in it. If
+ * there is no snapshot at \a path, or it can't be read, the result has an
+ * invalid server id and no segments.
+ *
+ * \param path
+ *      Name of the snapshot file.
+ */
+MasterSnapshot::MasterSnapshot(const string& path)
+    : fd(-1)
+    , serverId()
+    , headSegmentId(0)
+    , segments()
+{
+    fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        if (errno != ENOENT) {
+            LOG(WARNING, "Couldn't open snapshot %s: %s", path.c_str(),
+                    strerror(errno));
+        }
+        return;
+    }
+
+    Header header;
+    if ((pread(fd, &header, sizeof(header), 0) !=
+            static_cast<ssize_t>(sizeof(header))) ||
+            (header.magic != MAGIC)) {
+        LOG(WARNING, "%s isn't a master snapshot; ignoring it", path.c_str());
+        return;
+    }
+
+    off_t offset = sizeof(header);
+    for (uint32_t i = 0; i < header.segmentCount; i++) {
+        SegmentHeader segmentHeader;
+        if (pread(fd, &segmentHeader, sizeof(segmentHeader), offset) !=
+                static_cast<ssize_t>(sizeof(segmentHeader))) {
+            LOG(WARNING, "Snapshot %s is truncated; ignoring it",
+                    path.c_str());
+            segments.clear();
+            return;
+        }
+        offset += sizeof(segmentHeader);
+        Location& location = segments[segmentHeader.segmentId];
+        location.offset = static_cast<uint64_t>(offset);
+        location.length = segmentHeader.length;
+        location.certificate = segmentHeader.certificate;
+        offset += segmentHeader.length;
+    }
+    serverId = ServerId(header.serverId);
+    headSegmentId = header.headSegmentId;
+    LOG(NOTICE, "Found snapshot of %u segments of master %s in %s",
+            header.segmentCount, serverId.toString().c_str(), path.c_str());
+}
+
+MasterSnapshot::~MasterSnapshot()
+{
+    if (fd >= 0)
+        close(fd);
+}
+
+/**
+ * Write a snapshot of a master's log. The snapshot is written to a
+ * temporary file, which replaces \a path only once all of it is on disk, so
+ * a crash while saving leaves any earlier snapshot in place.
+ *
+ * \param path
+ *      Name of the snapshot file.
+ * \param serverId
+ *      Id of the master whose log this is.
+ * \param headSegmentId
+ *      Id of the log's head segment; segments in \a segments with ids
+ *      at or after this aren't saved.
+ * \param segments
+ *      The segments of the log. Their contents must not change, and they
+ *      must not be freed, while this method runs.
+ * \throw Exception
+ *      The snapshot couldn't be written.
+ */
+void
+MasterSnapshot::save(const string& path, ServerId serverId,
+        uint64_t headSegmentId, LogSegmentVector& segments)
+{
+    string tempPath = path + ".tmp";
+    int fd = open(tempPath.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0600);
+    if (fd < 0) {
+        throw Exception(HERE, format("Couldn't create snapshot %s",
+                tempPath.c_str()), errno);
+    }
+
+    try {
+        Header header;
+        header.magic = MAGIC;
+        header.segmentCount = 0;
+        header.serverId = serverId.getId();
+        header.headSegmentId = headSegmentId;
+        foreach (LogSegment* segment, segments) {
+            if (segment->id < headSegmentId)
+                header.segmentCount++;
+        }
+        writeAll(fd, &header, sizeof(header), tempPath);
+
+        std::unique_ptr<char[]> data;
+        uint32_t dataLength = 0;
+        foreach (LogSegment* segment, segments) {
+            if (segment->id >= headSegmentId)
+                continue;
+            SegmentHeader segmentHeader;
+            segmentHeader.segmentId = segment->id;
+            segmentHeader.length =
+                    segment->getAppendedLength(&segmentHeader.certificate);
+            if (segmentHeader.length > dataLength) {
+                dataLength = segmentHeader.length;
+                data.reset(new char[dataLength]);
+            }
+            segment->copyOut(0, data.get(), segmentHeader.length);
+            writeAll(fd, &segmentHeader, sizeof(segmentHeader), tempPath);
+            writeAll(fd, data.get(), segmentHeader.length, tempPath);
+        }
+        if (fsync(fd) != 0) {
+            throw Exception(HERE, format("Couldn't sync snapshot %s",
+                    tempPath.c_str()), errno);
+        }
+        close(fd);
+        fd = -1;
+        if (rename(tempPath.c_str(), path.c_str()) != 0) {
+            throw Exception(HERE, format("Couldn't rename snapshot %s",
+                    tempPath.c_str()), errno);
+        }
+        LOG(NOTICE, "Saved snapshot of %u segments of master %s in %s",
+                header.segmentCount, serverId.toString().c_str(),
+                path.c_str());
+    } catch (...) {
+        if (fd >= 0)
+            close(fd);
+        unlink(tempPath.c_str());
+        throw;
+    }
+}
+
+/**
+ * Return whether a segment is in the snapshot.
+ */
+bool
+MasterSnapshot::contains(uint64_t segmentId) const
+{
+    return segments.find(segmentId) != segments.end();
+}
+
+/**
+ * Read one segment out of the snapshot.
+ *
+ * \param segmentId
+ *      Which segment to read.
+ * \param[out] buffer
+ *      The segment's contents are appended here, in a single chunk.
+ * \param[out] certificate
+ *      The certificate to iterate the segment with.
+ * \return
+ *      True if the segment was read; false if it isn't in the snapshot or
+ *      couldn't be read (a warning is logged).
+ */
+bool
+MasterSnapshot::read(uint64_t segmentId, Buffer* buffer,
+        SegmentCertificate* certificate) const
+{
+    auto it = segments.find(segmentId);
+    if (it == segments.end())
+        return false;
+    const Location& location = it->second;
+    void* data = buffer->alloc(location.length);
+    if (pread(fd, data, location.length,
+            static_cast<off_t>(location.offset)) !=
+            static_cast<ssize_t>(location.length)) {
+        LOG(WARNING, "Couldn't read segment %lu from snapshot: %s",
+                segmentId, strerror(errno));
+        return false;
+    }
+    *certificate = location.certificate;
+    return true;
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,117 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_MASTERSNAPSHOT_H
+#define RAMCLOUD_MASTERSNAPSHOT_H
+
+#include <unordered_map>
+
+#include "Common.h"
+#include "Buffer.h"
+#include "LogSegment.h"
+#include "ServerId.h"
+
+namespace RAMCloud {
+
+/**
+ * A copy of a master's log segments in a file on the master's own machine,
+ * written when the master is shut down on purpose (see
+ * MasterService::saveSnapshot). When the master is restarted on the same
+ * machine it enlists as the replacement for its former self, and during
+ * the recovery of its former self it replays the segments it finds here
+ * instead of fetching them from backups; only segments written after the
+ * snapshot are read over the network. This makes a planned restart (for
+ * example, to upgrade the server) take about as long as reading the local
+ * file, rather than a full recovery.
+ *
+ * The file holds a header followed by each segment's id, length, and
+ * certificate, and its contents. Segments are checked against their
+ * certificates when they are replayed, so a damaged snapshot makes the
+ * recovery master fall back to backups rather than recover bad data.
+ */
+class MasterSnapshot {
+  PUBLIC:
+    explicit MasterSnapshot(const string& path);
+    ~MasterSnapshot();
+
+    static void save(const string& path, ServerId serverId,
+            uint64_t headSegmentId, LogSegmentVector& segments);
+
+    bool contains(uint64_t segmentId) const;
+    bool read(uint64_t segmentId, Buffer* buffer,
+            SegmentCertificate* certificate) const;
+
+    /// Return the id the master had when it wrote the snapshot, or an
+    /// invalid id if there is no usable snapshot.
+    ServerId getServerId() const { return serverId; }
+
+    /// Return the id of the head segment created when the snapshot was
+    /// written; all of the segments before it are in the snapshot.
+    uint64_t getHeadSegmentId() const { return headSegmentId; }
+
+    /// Identifies a snapshot file.
+    static const uint32_t MAGIC = 0x70616e73;
+
+  PRIVATE:
+    /// Appears at the start of a snapshot file.
+    struct Header {
+        uint32_t magic;
+        uint32_t segmentCount;
+        uint64_t serverId;
+        uint64_t headSegmentId;
+    } __attribute__((packed));
+
+    /// Precedes the contents of each segment in a snapshot file.
+    struct SegmentHeader {
+        SegmentHeader()
+            : segmentId(0)
+            , length(0)
+            , certificate()
+        {}
+        uint64_t segmentId;
+        uint32_t length;
+        SegmentCertificate certificate;
+    } __attribute__((packed));
+
+    /// Where one segment is in the snapshot file.
+    struct Location {
+        Location()
+            : offset(0)
+            , length(0)
+            , certificate()
+        {}
+        uint64_t offset;
+        uint32_t length;
+        SegmentCertificate certificate;
+    };
+
+    /// File descriptor of the open snapshot, or -1.
+    int fd;
+
+    /// See getServerId.
+    ServerId serverId;
+
+    /// See getHeadSegmentId.
+    uint64_t headSegmentId;
+
+    /// Where each segment in the snapshot is, by segment id.
+    std::unordered_map<uint64_t, Location> segments;
+
+    DISALLOW_COPY_AND_ASSIGN(MasterSnapshot);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_MASTERSNAPSHOT_H
@@ -0,0 +1,127 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+
+#include "MasterSnapshot.h"
+#include "MasterTableMetadata.h"
+#include "SegmentIterator.h"
+#include "SegmentManager.h"
+#include "ServerConfig.h"
+
+namespace RAMCloud {
+
+class MasterSnapshotTest : public ::testing::Test {
+  public:
+    Context context;
+    ServerId serverId;
+    ServerList serverList;
+    ServerConfig serverConfig;
+    ReplicaManager replicaManager;
+    MasterTableMetadata masterTableMetadata;
+    SegletAllocator allocator;
+    SegmentManager segmentManager;
+    char fileName[100];
+
+    MasterSnapshotTest()
+        : context()
+        , serverId(ServerId(57, 0))
+        , serverList(&context)
+        , serverConfig(ServerConfig::forTesting())
+        , replicaManager(&context, &serverId, 0, false, false)
+        , masterTableMetadata()
+        , allocator(&serverConfig)
+        , segmentManager(&context, &serverConfig, &serverId,
+                         allocator, replicaManager, &masterTableMetadata)
+        , fileName()
+    {
+        strncpy(fileName, "/tmp/ramcloud-snapshot-test-delete-this-XXXXXX",
+                sizeof(fileName));
+        close(mkstemp(fileName));
+        unlink(fileName);
+    }
+
+    ~MasterSnapshotTest()
+    {
+        unlink(fileName);
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(MasterSnapshotTest);
+};
+
+TEST_F(MasterSnapshotTest, constructor_noFile) {
+    TestLog::Enable _;
+    MasterSnapshot snapshot(fileName);
+    EXPECT_FALSE(snapshot.getServerId().isValid());
+    EXPECT_FALSE(snapshot.contains(0));
+    EXPECT_EQ("", TestLog::get());
+}
+
+TEST_F(MasterSnapshotTest, constructor_notASnapshot) {
+    FILE* f = fopen(fileName, "w");
+    fputs("this is not a snapshot of anything", f);
+    fclose(f);
+    TestLog::Enable _("MasterSnapshot");
+    MasterSnapshot snapshot(fileName);
+    EXPECT_FALSE(snapshot.getServerId().isValid());
+    EXPECT_EQ(format("MasterSnapshot: %s isn't a master snapshot; "
+            "ignoring it", fileName), TestLog::get());
+}
+
+TEST_F(MasterSnapshotTest, saveAndRead) {
+    LogSegment* first = segmentManager.allocHeadSegment();
+    first->append(LOG_ENTRY_TYPE_OBJ, "hello", 5);
+    LogSegment* second = segmentManager.allocHeadSegment();
+    second->append(LOG_ENTRY_TYPE_OBJ, "again", 5);
+    LogSegment* head = segmentManager.allocHeadSegment();
+    LogSegmentVector segments;
+    segments.push_back(first);
+    segments.push_back(second);
+    segments.push_back(head);
+    MasterSnapshot::save(fileName, serverId, head->id, segments);
+
+    MasterSnapshot snapshot(fileName);
+    EXPECT_EQ(serverId, snapshot.getServerId());
+    EXPECT_EQ(head->id, snapshot.getHeadSegmentId());
+    EXPECT_TRUE(snapshot.contains(first->id));
+    EXPECT_TRUE(snapshot.contains(second->id));
+    EXPECT_FALSE(snapshot.contains(head->id));
+
+    Buffer buffer;
+    SegmentCertificate certificate;
+    EXPECT_TRUE(snapshot.read(second->id, &buffer, &certificate));
+    SegmentCertificate expected;
+    EXPECT_EQ(second->getAppendedLength(&expected), buffer.size());
+    EXPECT_EQ(expected, certificate);
+    SegmentIterator it(buffer.getRange(0, buffer.size()), buffer.size(),
+            certificate);
+    EXPECT_NO_THROW(it.checkMetadataIntegrity());
+    while (!it.isDone() && it.getType() != LOG_ENTRY_TYPE_OBJ)
+        it.next();
+    ASSERT_FALSE(it.isDone());
+    Buffer entry;
+    it.appendToBuffer(entry);
+    EXPECT_EQ("again", TestUtil::toString(&entry));
+
+    EXPECT_FALSE(snapshot.read(head->id, &buffer, &certificate));
+}
+
+TEST_F(MasterSnapshotTest, save_badPath) {
+    LogSegmentVector segments;
+    EXPECT_THROW(MasterSnapshot::save("/nonexistent/directory/snapshot",
+            serverId, 1, segments), Exception);
+}
+
+}  // namespace RAMCloud
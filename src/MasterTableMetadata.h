@@ -17,6 +17,7 @@
 #ifndef RAMCLOUD_MASTERTABLEMETADATA_H
 #define RAMCLOUD_MASTERTABLEMETADATA_H
 
+#include <atomic>
 #include <unordered_map>
 #include "Common.h"
 #include "SpinLock.h"
@@ -67,9 +68,34 @@ class MasterTableMetadata {
         uint64_t tableId;
         TableStats::Block stats;
 
+        /// Objects in the table expire this many seconds after they were
+        /// last written; 0 means they never expire. See
+        /// ObjectManager::setTableTtl.
+        std::atomic<uint32_t> ttlSeconds;
+
+        /// If nonzero, the table is a cache: writes to it don't wait for
+        /// backups, and once its data on this master exceeds this many
+        /// bytes the cleaner evicts its objects. See
+        /// ObjectManager::setTableCacheQuota.
+        std::atomic<uint64_t> cacheQuotaBytes;
+
+        /// Writes to the table are acknowledged once this many replicas
+        /// of them are durable; ~0u means all of them. See
+        /// ObjectManager::setTableDurability.
+        std::atomic<uint32_t> ackReplicas;
+
+        /// Whether the table has an index on its primary keys: 1 if it
+        /// does, 0 if it doesn't, and -1 if this master hasn't found out
+        /// yet. See MasterService::firstIndexedKey.
+        std::atomic<int8_t> primaryKeyIndexed;
+
         explicit Entry(uint64_t tableId)
             : tableId(tableId)
             , stats()
+            , ttlSeconds(0)
+            , cacheQuotaBytes(0)
+            , ackReplicas(~0u)
+            , primaryKeyIndexed(-1)
         {}
     };
 
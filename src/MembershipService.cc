@@ -21,6 +21,7 @@
  */
 
 #include "Common.h"
+#include "Cycles.h"
 #include "MembershipService.h"
 #include "ProtoBuf.h"
 #include "ServerId.h"
@@ -64,6 +65,10 @@ MembershipService::dispatch(WireFormat::Opcode opcode, Rpc* rpc)
         callHandler<WireFormat::UpdateServerList, MembershipService,
             &MembershipService::updateServerList>(rpc);
         break;
+    case WireFormat::RelayedUpdateServerList::opcode:
+        callHandler<WireFormat::RelayedUpdateServerList, MembershipService,
+            &MembershipService::updateServerList>(rpc);
+        break;
     default:
         throw UnimplementedRequestError(HERE);
     }
@@ -92,7 +97,9 @@ MembershipService::getServerConfig(
 }
 
 /**
- * Top-level service method to handle the UPDATE_SERVER_LIST request.
+ * Top-level service method to handle the UPDATE_SERVER_LIST and
+ * RELAYED_UPDATE_SERVER_LIST requests. If the request lists servers to
+ * relay to, the update is then relayed to each of them (see relayUpdate()).
  *
  * \copydetails Service::ping
  */
@@ -102,8 +109,17 @@ MembershipService::updateServerList(
     WireFormat::UpdateServerList::Response* respHdr,
     Rpc* rpc)
 {
+    // Relayed updates are never relayed further; see RpcLevel.
+    if (reqHdr->relayCount > WireFormat::UpdateServerList::MAX_RELAYS ||
+            (reqHdr->relayCount > 0 && reqHdr->common.opcode ==
+                WireFormat::RELAYED_UPDATE_SERVER_LIST)) {
+        throw RequestFormatError(HERE);
+    }
     uint32_t reqOffset = sizeof32(*reqHdr);
-    uint32_t reqLen = rpc->requestPayload->size();
+    uint32_t relayListLength = reqHdr->relayCount * sizeof32(uint64_t);
+    if (rpc->requestPayload->size() < reqOffset + relayListLength)
+        throw MessageTooShortError(HERE);
+    uint32_t reqLen = rpc->requestPayload->size() - relayListLength;
 
     // Repeatedly apply the server lists in the RPC while we haven't reached
     // the end of the RPC.
@@ -128,6 +144,111 @@ MembershipService::updateServerList(
         reqOffset += part->serverListLength;
         respHdr->currentVersion = serverList->applyServerList(list);
     }
+
+    relayUpdate(reqHdr, rpc, reqLen - sizeof32(*reqHdr));
+}
+
+/**
+ * Relay a server list update that has been applied locally to the servers
+ * listed in the request, so that the coordinator only has to send it to
+ * one of every few servers that need it. The relays are sent in parallel
+ * and this returns once all of them have completed, failed, or timed out
+ * (see #RELAY_TIMEOUT_MS). A RelayResult is appended to the response for
+ * each, telling the coordinator which version each server now has.
+ *
+ * \param reqHdr
+ *      Header of the update request; the server lists follow it, and then
+ *      reqHdr->relayCount server ids.
+ * \param rpc
+ *      The update being serviced.
+ * \param partsLength
+ *      Number of bytes of server lists following \a reqHdr.
+ */
+void
+MembershipService::relayUpdate(
+    const WireFormat::UpdateServerList::Request* reqHdr,
+    Rpc* rpc, uint32_t partsLength)
+{
+    uint32_t relayCount = reqHdr->relayCount;
+    if (relayCount == 0)
+        return;
+    uint32_t partsOffset = sizeof32(*reqHdr);
+    const uint64_t* relayTo = static_cast<const uint64_t*>(
+        rpc->requestPayload->getRange(partsOffset + partsLength,
+                                      relayCount * sizeof32(uint64_t)));
+    if (relayTo == NULL)
+        throw MessageTooShortError(HERE);
+
+    Tub<RelayedUpdateServerListRpc>
+        relays[WireFormat::UpdateServerList::MAX_RELAYS];
+    for (uint32_t i = 0; i < relayCount; i++) {
+        relays[i].construct(context, ServerId(relayTo[i]),
+                            rpc->requestPayload, partsOffset, partsLength);
+    }
+
+    uint64_t abortTime = Cycles::rdtsc() +
+        Cycles::fromMicroseconds(RELAY_TIMEOUT_MS * 1000);
+    for (uint32_t i = 0; i < relayCount; i++) {
+        auto* result = rpc->replyPayload->emplaceAppend<
+                WireFormat::UpdateServerList::Response::RelayResult>();
+        result->serverId = relayTo[i];
+        result->currentVersion = relays[i]->wait(abortTime);
+        if (result->currentVersion == 0) {
+            RAMCLOUD_CLOG(NOTICE, "Couldn't relay server list update to "
+                "server %s; coordinator will retry it",
+                ServerId(relayTo[i]).toString().c_str());
+        }
+    }
+}
+
+/**
+ * Constructor for RelayedUpdateServerListRpc: forwards the server lists of
+ * an UpdateServerList request to another server, without any relays of its
+ * own.
+ *
+ * \param context
+ *      Overall information about this RAMCloud server.
+ * \param serverId
+ *      Identifies the server to which this update should be sent.
+ * \param parts
+ *      Buffer holding the request being relayed.
+ * \param offset
+ *      Offset in \a parts of the first Part of the request. The bytes are
+ *      not copied, so they must remain valid until the rpc completes.
+ * \param length
+ *      Number of bytes of Parts (and the server lists that follow them).
+ */
+RelayedUpdateServerListRpc::RelayedUpdateServerListRpc(Context* context,
+        ServerId serverId, Buffer* parts, uint32_t offset, uint32_t length)
+    : ServerIdRpcWrapper(context, serverId,
+            sizeof(WireFormat::RelayedUpdateServerList::Response))
+{
+    allocHeader<WireFormat::RelayedUpdateServerList>(serverId);
+    request.appendExternal(parts, offset, length);
+    send();
+}
+
+/**
+ * Wait for a relayed update to complete, giving up (and canceling it) at
+ * \a abortTime.
+ *
+ * \param abortTime
+ *      Give up if Cycles::rdtsc() exceeds this time.
+ * \return
+ *      The server list version of the target server after processing the
+ *      update, or 0 if the server couldn't be updated.
+ */
+uint64_t
+RelayedUpdateServerListRpc::wait(uint64_t abortTime)
+{
+    if (!waitInternal(context->dispatch, abortTime)) {
+        cancel();
+        return 0;
+    }
+    if (serverCrashed || responseHeader->status != STATUS_OK)
+        return 0;
+    return getResponseHeader<WireFormat::RelayedUpdateServerList>()
+            ->currentVersion;
 }
 
 } // namespace RAMCloud
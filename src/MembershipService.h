@@ -22,11 +22,28 @@
 #define RAMCLOUD_MEMBERSHIPSERVICE_H
 
 #include "ServerConfig.h"
+#include "ServerIdRpcWrapper.h"
 #include "ServerList.h"
 #include "Service.h"
 
 namespace RAMCloud {
 
+/**
+ * Forwards a server list update received from the coordinator to another
+ * server (see MembershipService::relayUpdate()).
+ */
+class RelayedUpdateServerListRpc : public ServerIdRpcWrapper {
+  public:
+    RelayedUpdateServerListRpc(Context* context, ServerId serverId,
+                               Buffer* parts, uint32_t offset,
+                               uint32_t length);
+    ~RelayedUpdateServerListRpc() {}
+    uint64_t wait(uint64_t abortTime);
+
+  PRIVATE:
+    DISALLOW_COPY_AND_ASSIGN(RelayedUpdateServerListRpc);
+};
+
 /**
  * This Service is primarily used to maintain a server's global ServerList
  * object. More specifically, the coordinator issues RPCs to this service
@@ -43,6 +60,11 @@ namespace RAMCloud {
  * the coordinator resend the list if the lost update still has not been
  * received.
  *
+ * To spare the coordinator from sending every update to every server
+ * itself, an update may list other servers that are at the same version;
+ * this server forwards the update to them once it has applied it (see
+ * relayUpdate()).
+ *
  * Additional functionality includes retrieving the ServerId of the machine
  * running this service (see #ServerId for more information) and advertising
  * the server's configuration.
@@ -62,6 +84,16 @@ class MembershipService : public Service {
     void updateServerList(const WireFormat::UpdateServerList::Request* reqHdr,
                        WireFormat::UpdateServerList::Response* respHdr,
                        Rpc* rpc);
+    void relayUpdate(const WireFormat::UpdateServerList::Request* reqHdr,
+                     Rpc* rpc, uint32_t partsLength);
+
+    /**
+     * How long to wait for the servers an update is relayed to before
+     * reporting to the coordinator that they weren't updated; it will try
+     * them again later. This keeps one unresponsive server from holding up
+     * updates to this one until the crash is detected.
+     */
+    static const uint32_t RELAY_TIMEOUT_MS = 500;
 
     /// Shared state.
     Context* context;
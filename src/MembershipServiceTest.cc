@@ -137,4 +137,36 @@ TEST_F(MembershipServiceTest, updateServerList_multi) {
     EXPECT_EQ(3lu, respHdr->currentVersion);
 }
 
+TEST_F(MembershipServiceTest, updateServerList_relay) {
+    Lock lock(mutex); // Lock used to trick internal calls
+    Context context2;
+    context2.externalStorage = &storage;
+    CoordinatorServerList source(&context2);
+    source.haltUpdater();
+    CoordinatorService coordinatorService(&context2, 1000, true);
+    ServerId id1 = source.enlistServer({WireFormat::MASTER_SERVICE,
+            WireFormat::MEMBERSHIP_SERVICE}, 0, 100, "mock:host=55");
+    ProtoBuf::ServerList fullList;
+    source.serialize(&fullList, {WireFormat::MASTER_SERVICE,
+            WireFormat::BACKUP_SERVICE});
+
+    // A second member for the update to be relayed to.
+    Context context3;
+    ServerList serverList3(&context3);
+    MembershipService service3(&context3, &serverList3, &serverConfig);
+    transport.registerServer(&context3, "mock:host=55");
+
+    CoordinatorServerList::UpdateServerListRpc
+        rpc(&context, serverId, &fullList);
+    rpc.appendRelays({id1, ServerId(40, 0)});
+    rpc.send();
+    rpc.waitAndCheckErrors();
+    EXPECT_EQ(1lu, rpc.getResponseHeader<WireFormat::UpdateServerList>()
+            ->currentVersion);
+    EXPECT_STREQ("mock:host=55", serverList3.getLocator(id1).c_str());
+    EXPECT_EQ(1lu, rpc.getRelayedVersion(0));
+    // Server 40.0 isn't in the cluster.
+    EXPECT_EQ(0lu, rpc.getRelayedVersion(1));
+}
+
 }  // namespace RAMCloud
@@ -0,0 +1,276 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <unordered_set>
+#include <algorithm>
+
+#include "HashTable.h"
+#include "LogMetadata.h"
+#include "MemoryAccounting.h"
+#include "Object.h"
+#include "PreparedOps.h"
+#include "RpcResult.h"
+#include "SegmentIterator.h"
+#include "TxDecisionRecord.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct a MemoryAccounting with nothing counted.
+ */
+MemoryAccounting::MemoryAccounting()
+    : logCapacityBytes(0)
+    , hashTableBytes(0)
+    , tables()
+    , otherBytes(0)
+{
+}
+
+/**
+ * Count one log entry.
+ *
+ * \param type
+ *      The type of the entry.
+ * \param entry
+ *      The contents of the entry.
+ * \param live
+ *      True means the entry is still needed: for an object, that it is the
+ *      current version; for a tombstone, that the object it deletes may
+ *      still be in the log. False means the cleaner can reclaim the entry.
+ *      Ignored for entries that belong to no table.
+ */
+void
+MemoryAccounting::addEntry(LogEntryType type, Buffer& entry, bool live)
+{
+    uint64_t bytes = entry.size() +
+            Segment::getEntryHeaderLength(type, entry.size());
+
+    uint64_t tableId;
+    if (!getTableId(type, entry, &tableId)) {
+        otherBytes += bytes;
+        return;
+    }
+    Table& table = tables[tableId];
+    if (!live) {
+        table.deadEntries++;
+        table.deadBytes += bytes;
+    } else if (type == LOG_ENTRY_TYPE_OBJ) {
+        Object object(entry);
+        uint64_t dataBytes = object.getValueLength();
+        for (KeyIndex i = 0; i < object.getKeyCount(); i++)
+            dataBytes += object.getKeyLength(i);
+        table.liveObjects++;
+        table.liveBytes += dataBytes;
+        table.metadataBytes += bytes - dataBytes +
+                HashTable::bytesPerCacheLine() /
+                HashTable::entriesPerCacheLine();
+    } else if (type == LOG_ENTRY_TYPE_OBJTOMB) {
+        table.tombstones++;
+        table.tombstoneBytes += bytes;
+    } else {
+        table.metadataBytes += bytes;
+    }
+}
+
+/**
+ * Count all of the entries in a collection of segments, deciding which are
+ * live from the segments alone: an object is live if it is the newest
+ * version of its key in the segments and no tombstone in the segments
+ * deletes it, and a tombstone is live if the segment holding the object it
+ * deletes is one of the segments. The results match what a master would
+ * report if the segments are its entire log.
+ *
+ * \param segments
+ *      The segments to examine (for example, all of the replicas of a
+ *      master's log read back from backups). The capacity given in each
+ *      segment's header is added to logCapacityBytes.
+ */
+void
+MemoryAccounting::addSegments(const std::vector<Segment*>& segments)
+{
+    typedef std::pair<uint64_t, string> ObjectName;
+    std::map<ObjectName, uint64_t> newestVersions;
+    std::map<ObjectName, uint64_t> deletedVersions;
+    std::unordered_set<uint64_t> segmentIds;
+
+    // The first pass finds the newest version of each object, the newest
+    // version that has been deleted, and which segments are present.
+    foreach (Segment* segment, segments) {
+        for (SegmentIterator it(*segment); !it.isDone(); it.next()) {
+            LogEntryType type = it.getType();
+            Buffer buffer;
+            it.appendToBuffer(buffer);
+            if (type == LOG_ENTRY_TYPE_SEGHEADER) {
+                const SegmentHeader* header =
+                        buffer.getStart<SegmentHeader>();
+                segmentIds.insert(header->segmentId);
+                logCapacityBytes += header->capacity;
+            } else if (type == LOG_ENTRY_TYPE_OBJ) {
+                Object object(buffer);
+                ObjectName name(object.getTableId(), string(
+                        static_cast<const char*>(object.getKey()),
+                        object.getKeyLength()));
+                uint64_t& version = newestVersions[name];
+                version = std::max(version, object.getVersion());
+            } else if (type == LOG_ENTRY_TYPE_OBJTOMB) {
+                ObjectTombstone tombstone(buffer);
+                ObjectName name(tombstone.getTableId(), string(
+                        static_cast<const char*>(tombstone.getKey()),
+                        tombstone.getKeyLength()));
+                uint64_t& version = deletedVersions[name];
+                version = std::max(version, tombstone.getObjectVersion());
+            }
+        }
+    }
+
+    foreach (Segment* segment, segments) {
+        for (SegmentIterator it(*segment); !it.isDone(); it.next()) {
+            LogEntryType type = it.getType();
+            Buffer buffer;
+            it.appendToBuffer(buffer);
+            bool live = true;
+            if (type == LOG_ENTRY_TYPE_OBJ) {
+                Object object(buffer);
+                ObjectName name(object.getTableId(), string(
+                        static_cast<const char*>(object.getKey()),
+                        object.getKeyLength()));
+                auto deleted = deletedVersions.find(name);
+                live = (object.getVersion() == newestVersions[name]) &&
+                        ((deleted == deletedVersions.end()) ||
+                        (object.getVersion() > deleted->second));
+            } else if (type == LOG_ENTRY_TYPE_OBJTOMB) {
+                ObjectTombstone tombstone(buffer);
+                live = segmentIds.count(tombstone.getSegmentId()) != 0;
+            }
+            addEntry(type, buffer, live);
+        }
+    }
+}
+
+/**
+ * Record the number of bytes that TableStats attributes to each table, so
+ * that the estimates used during recovery can be compared with the actual
+ * use of the log.
+ *
+ * \param masterTableMetadata
+ *      The master's table metadata, which holds its TableStats.
+ */
+void
+MemoryAccounting::addTableStats(MasterTableMetadata* masterTableMetadata)
+{
+    MasterTableMetadata::scanner sc = masterTableMetadata->getScanner();
+    while (sc.hasNext()) {
+        MasterTableMetadata::Entry* entry = sc.next();
+        SpinLock::Guard _(entry->stats.lock);
+        if (entry->stats.byteCount != 0)
+            tables[entry->tableId].statsBytes = entry->stats.byteCount;
+    }
+}
+
+/**
+ * Add another MemoryAccounting's totals to this one's; for example, to
+ * combine the results of scanning different parts of a log in parallel.
+ *
+ * \param other
+ *      The totals to add.
+ */
+void
+MemoryAccounting::merge(const MemoryAccounting& other)
+{
+    logCapacityBytes += other.logCapacityBytes;
+    hashTableBytes += other.hashTableBytes;
+    for (auto& it : other.tables) {
+        Table& table = tables[it.first];
+        table.liveObjects += it.second.liveObjects;
+        table.liveBytes += it.second.liveBytes;
+        table.deadEntries += it.second.deadEntries;
+        table.deadBytes += it.second.deadBytes;
+        table.tombstones += it.second.tombstones;
+        table.tombstoneBytes += it.second.tombstoneBytes;
+        table.metadataBytes += it.second.metadataBytes;
+        table.statsBytes += it.second.statsBytes;
+    }
+    otherBytes += other.otherBytes;
+}
+
+/**
+ * Copy the totals into a protocol buffer, which can be sent to clients.
+ *
+ * \param[out] usage
+ *      Filled in with the totals.
+ */
+void
+MemoryAccounting::serialize(ProtoBuf::MemoryUsage* usage) const
+{
+    for (auto& it : tables) {
+        const Table& table = it.second;
+        ProtoBuf::MemoryUsage::Table* entry = usage->add_table();
+        entry->set_table_id(it.first);
+        entry->set_live_objects(table.liveObjects);
+        entry->set_live_bytes(table.liveBytes);
+        entry->set_dead_entries(table.deadEntries);
+        entry->set_dead_bytes(table.deadBytes);
+        entry->set_tombstones(table.tombstones);
+        entry->set_tombstone_bytes(table.tombstoneBytes);
+        entry->set_metadata_bytes(table.metadataBytes);
+        entry->set_stats_bytes(table.statsBytes);
+    }
+    usage->set_other_bytes(otherBytes);
+    usage->set_log_capacity_bytes(logCapacityBytes);
+    usage->set_hash_table_bytes(hashTableBytes);
+}
+
+/**
+ * Find the table that a log entry belongs to.
+ *
+ * \param type
+ *      The type of the entry.
+ * \param entry
+ *      The contents of the entry.
+ * \param[out] tableId
+ *      Set to the id of the entry's table, if it has one.
+ * \return
+ *      True if the entry belongs to a table, false if it doesn't (such as
+ *      segment headers and log digests).
+ */
+bool
+MemoryAccounting::getTableId(LogEntryType type, Buffer& entry,
+        uint64_t* tableId)
+{
+    if (type == LOG_ENTRY_TYPE_OBJ) {
+        Object object(entry);
+        *tableId = object.getTableId();
+    } else if (type == LOG_ENTRY_TYPE_OBJTOMB) {
+        ObjectTombstone tombstone(entry);
+        *tableId = tombstone.getTableId();
+    } else if (type == LOG_ENTRY_TYPE_RPCRESULT) {
+        RpcResult rpcResult(entry);
+        *tableId = rpcResult.getTableId();
+    } else if (type == LOG_ENTRY_TYPE_PREP) {
+        PreparedOp op(entry, 0, entry.size());
+        *tableId = op.object.getTableId();
+    } else if (type == LOG_ENTRY_TYPE_PREPTOMB) {
+        PreparedOpTombstone opTomb(entry, 0);
+        *tableId = opTomb.header.tableId;
+    } else if (type == LOG_ENTRY_TYPE_TXDECISION) {
+        TxDecisionRecord decisionRecord(entry);
+        *tableId = decisionRecord.getTableId();
+    } else {
+        return false;
+    }
+    return true;
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,101 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_MEMORYACCOUNTING_H
+#define RAMCLOUD_MEMORYACCOUNTING_H
+
+#include <map>
+#include <vector>
+
+#include "Buffer.h"
+#include "LogEntryTypes.h"
+#include "MasterTableMetadata.h"
+#include "Segment.h"
+#include "ServerStatistics.pb.h"
+
+namespace RAMCloud {
+
+/**
+ * This class adds up how much of a master's log each table uses, split into
+ * the keys and values of current objects, space that the cleaner can
+ * reclaim, tombstones that must be kept, and metadata (object headers,
+ * segment entry headers, hash table entries, and records such as RPC
+ * results). LogMetrics only reports totals for the whole log, which makes it
+ * impossible to tell what a table with (say) many small objects really
+ * costs.
+ *
+ * The caller feeds in every entry of the log along with whether the entry is
+ * still needed: ObjectManager::getMemoryUsage does this for a running master
+ * using its hash table, and addSegments works it out from the segments
+ * alone, so that replicas read from backups (or segments built by a
+ * benchmark) can be examined offline.
+ */
+class MemoryAccounting {
+  PUBLIC:
+    MemoryAccounting();
+    void addEntry(LogEntryType type, Buffer& entry, bool live);
+    void addSegments(const std::vector<Segment*>& segments);
+    void addTableStats(MasterTableMetadata* masterTableMetadata);
+    void merge(const MemoryAccounting& other);
+    void serialize(ProtoBuf::MemoryUsage* usage) const;
+
+    /// Total bytes of log memory, or 0 if unknown (see
+    /// ProtoBuf::MemoryUsage::log_capacity_bytes).
+    uint64_t logCapacityBytes;
+
+    /// Total size of the hash table, or 0 if unknown.
+    uint64_t hashTableBytes;
+
+  PRIVATE:
+    /// Totals for one table; see ProtoBuf::MemoryUsage::Table for the
+    /// meaning of each field.
+    struct Table {
+        Table()
+            : liveObjects(0)
+            , liveBytes(0)
+            , deadEntries(0)
+            , deadBytes(0)
+            , tombstones(0)
+            , tombstoneBytes(0)
+            , metadataBytes(0)
+            , statsBytes(0)
+        {}
+
+        uint64_t liveObjects;
+        uint64_t liveBytes;
+        uint64_t deadEntries;
+        uint64_t deadBytes;
+        uint64_t tombstones;
+        uint64_t tombstoneBytes;
+        uint64_t metadataBytes;
+        uint64_t statsBytes;
+    };
+
+    static bool getTableId(LogEntryType type, Buffer& entry,
+            uint64_t* tableId);
+
+    /// Totals for each table that has entries in the log, indexed by table
+    /// id (ordered, so that reports are too).
+    std::map<uint64_t, Table> tables;
+
+    /// Bytes of entries that belong to no table.
+    uint64_t otherBytes;
+
+    DISALLOW_COPY_AND_ASSIGN(MemoryAccounting);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_MEMORYACCOUNTING_H
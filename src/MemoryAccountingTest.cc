@@ -0,0 +1,189 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "LogMetadata.h"
+#include "MemoryAccounting.h"
+#include "Object.h"
+#include "TableStats.h"
+
+namespace RAMCloud {
+
+class MemoryAccountingTest : public ::testing::Test {
+  public:
+    MemoryAccounting accounting;
+
+    MemoryAccountingTest()
+        : accounting()
+    {
+    }
+
+    /// Build the log form of an object and return the number of bytes it
+    /// will occupy in a segment.
+    uint32_t
+    buildObject(Buffer* buffer, uint64_t tableId, const char* key,
+            const char* value, uint64_t version)
+    {
+        Key k(tableId, key, downCast<uint16_t>(strlen(key)));
+        Buffer dataBuffer;
+        Object object(k, value, downCast<uint32_t>(strlen(value)), version, 0,
+                dataBuffer);
+        object.assembleForLog(*buffer);
+        return buffer->size() + 2;
+    }
+
+    void
+    appendObject(Segment* segment, uint64_t tableId, const char* key,
+            const char* value, uint64_t version)
+    {
+        Buffer buffer;
+        buildObject(&buffer, tableId, key, value, version);
+        segment->append(LOG_ENTRY_TYPE_OBJ, buffer);
+    }
+
+    void
+    appendTombstone(Segment* segment, uint64_t tableId, const char* key,
+            uint64_t version, uint64_t segmentId)
+    {
+        Key k(tableId, key, downCast<uint16_t>(strlen(key)));
+        Buffer dataBuffer;
+        Object object(k, "", 0, version, 0, dataBuffer);
+        ObjectTombstone tombstone(object, segmentId, 0);
+        Buffer buffer;
+        tombstone.assembleForLog(buffer);
+        segment->append(LOG_ENTRY_TYPE_OBJTOMB, buffer);
+    }
+
+    void
+    appendHeader(Segment* segment, uint64_t segmentId)
+    {
+        SegmentHeader header(1, segmentId, 8192);
+        segment->append(LOG_ENTRY_TYPE_SEGHEADER, &header, sizeof32(header));
+    }
+
+    /// Return a summary of the counts (but not the sizes) for each table.
+    string
+    counts()
+    {
+        ProtoBuf::MemoryUsage usage;
+        accounting.serialize(&usage);
+        string s;
+        foreach (const ProtoBuf::MemoryUsage::Table& table, usage.table()) {
+            if (s.size() > 0)
+                s.append(" | ");
+            s.append(format("table %lu: %lu live, %lu dead, %lu tombstones",
+                    table.table_id(), table.live_objects(),
+                    table.dead_entries(), table.tombstones()));
+        }
+        return s;
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(MemoryAccountingTest);
+};
+
+TEST_F(MemoryAccountingTest, addEntry_liveObject) {
+    Buffer buffer;
+    uint32_t bytes = buildObject(&buffer, 3, "key", "value", 1);
+    accounting.addEntry(LOG_ENTRY_TYPE_OBJ, buffer, true);
+    ProtoBuf::MemoryUsage usage;
+    accounting.serialize(&usage);
+    ASSERT_EQ(1, usage.table_size());
+    EXPECT_EQ(3U, usage.table(0).table_id());
+    EXPECT_EQ(1U, usage.table(0).live_objects());
+    EXPECT_EQ(8U, usage.table(0).live_bytes());
+
+    // Metadata includes the object's hash table entry.
+    EXPECT_EQ(bytes - 8 + 8, usage.table(0).metadata_bytes());
+    EXPECT_EQ(0U, usage.table(0).dead_bytes());
+    EXPECT_EQ(0U, usage.other_bytes());
+}
+
+TEST_F(MemoryAccountingTest, addEntry_deadObject) {
+    Buffer buffer;
+    uint32_t bytes = buildObject(&buffer, 3, "key", "value", 1);
+    accounting.addEntry(LOG_ENTRY_TYPE_OBJ, buffer, false);
+    ProtoBuf::MemoryUsage usage;
+    accounting.serialize(&usage);
+    ASSERT_EQ(1, usage.table_size());
+    EXPECT_EQ(0U, usage.table(0).live_objects());
+    EXPECT_EQ(1U, usage.table(0).dead_entries());
+    EXPECT_EQ(bytes, usage.table(0).dead_bytes());
+    EXPECT_EQ(0U, usage.table(0).metadata_bytes());
+}
+
+TEST_F(MemoryAccountingTest, addEntry_noTable) {
+    SegmentHeader header(1, 2, 8192);
+    Buffer buffer;
+    buffer.appendExternal(&header, sizeof32(header));
+    accounting.addEntry(LOG_ENTRY_TYPE_SEGHEADER, buffer, true);
+    ProtoBuf::MemoryUsage usage;
+    accounting.serialize(&usage);
+    EXPECT_EQ(0, usage.table_size());
+    EXPECT_EQ(sizeof(header) + 2, usage.other_bytes());
+}
+
+TEST_F(MemoryAccountingTest, addSegments) {
+    Segment first;
+    appendHeader(&first, 10);
+    appendObject(&first, 1, "overwritten", "a", 1);
+    appendObject(&first, 1, "removed", "b", 1);
+    appendObject(&first, 2, "kept", "c", 1);
+    Segment second;
+    appendHeader(&second, 11);
+    appendObject(&second, 1, "overwritten", "d", 2);
+    appendTombstone(&second, 1, "overwritten", 1, 10);
+    appendTombstone(&second, 1, "removed", 1, 10);
+
+    // This tombstone's object was in a segment that has been cleaned.
+    appendTombstone(&second, 2, "gone", 5, 7);
+
+    std::vector<Segment*> segments = {&first, &second};
+    accounting.addSegments(segments);
+    EXPECT_EQ("table 1: 1 live, 2 dead, 2 tombstones | "
+            "table 2: 1 live, 1 dead, 0 tombstones", counts());
+    EXPECT_EQ(2 * 8192U, accounting.logCapacityBytes);
+}
+
+TEST_F(MemoryAccountingTest, addTableStats) {
+    MasterTableMetadata masterTableMetadata;
+    TableStats::increment(&masterTableMetadata, 4, 1000, 10);
+    TableStats::increment(&masterTableMetadata, 5, 0, 0);
+    accounting.addTableStats(&masterTableMetadata);
+    ProtoBuf::MemoryUsage usage;
+    accounting.serialize(&usage);
+    ASSERT_EQ(1, usage.table_size());
+    EXPECT_EQ(4U, usage.table(0).table_id());
+    EXPECT_EQ(1000U, usage.table(0).stats_bytes());
+}
+
+TEST_F(MemoryAccountingTest, merge) {
+    Buffer buffer;
+    buildObject(&buffer, 1, "key", "value", 1);
+    accounting.addEntry(LOG_ENTRY_TYPE_OBJ, buffer, true);
+    accounting.logCapacityBytes = 100;
+
+    MemoryAccounting other;
+    other.addEntry(LOG_ENTRY_TYPE_OBJ, buffer, false);
+    buffer.reset();
+    buildObject(&buffer, 2, "key", "value", 1);
+    other.addEntry(LOG_ENTRY_TYPE_OBJ, buffer, true);
+    other.logCapacityBytes = 50;
+    accounting.merge(other);
+    EXPECT_EQ("table 1: 1 live, 1 dead, 0 tombstones | "
+            "table 2: 1 live, 0 dead, 0 tombstones", counts());
+    EXPECT_EQ(150U, accounting.logCapacityBytes);
+}
+
+}  // namespace RAMCloud
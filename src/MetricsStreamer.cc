@@ -0,0 +1,344 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include "Cycles.h"
+#include "IpAddress.h"
+#include "MetricsStreamer.h"
+#include "ServiceLocator.h"
+#include "ShortMacros.h"
+
+namespace RAMCloud {
+
+volatile int MetricsStreamer::streaming = 0;
+__thread MetricsStreamer::Counts* MetricsStreamer::threadCounts = NULL;
+SpinLock MetricsStreamer::mutex("MetricsStreamer::mutex");
+std::vector<MetricsStreamer::Counts*> MetricsStreamer::registeredThreads;
+int MetricsStreamer::fd = -1;
+std::string MetricsStreamer::prefix;
+uint32_t MetricsStreamer::windowSeconds = 10;
+std::unique_ptr<MetricsStreamer::Intervals> MetricsStreamer::intervals;
+uint32_t MetricsStreamer::intervalCount = 0;
+std::vector<uint64_t> MetricsStreamer::lastTotals;
+volatile bool MetricsStreamer::stopReporter = false;
+Tub<std::thread> MetricsStreamer::reporter;
+
+/**
+ * Start recording events and sending reports. If streaming is already on,
+ * the current output is finished first.
+ *
+ * \param destination
+ *      Where to send the reports: either the name of a file, which is
+ *      replaced, or a service locator such as "udp:host=rc01,port=2003"
+ *      for a collector that accepts Graphite lines in datagrams.
+ * \param seconds
+ *      Percentiles are computed over this many of the latest seconds
+ *      (at most MAX_WINDOW_SECONDS).
+ *
+ * \throw FatalError
+ *      The destination couldn't be opened.
+ */
+void
+MetricsStreamer::start(const string& destination, uint32_t seconds)
+{
+    stop();
+    if (destination.compare(0, 4, "udp:") == 0) {
+        ServiceLocator locator(destination);
+        IpAddress address(&locator);
+        fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (fd < 0) {
+            throw FatalError(HERE, format("couldn't create socket for "
+                    "metrics collector: %s", strerror(errno)));
+        }
+        if (connect(fd, &address.address, sizeof(address.address)) != 0) {
+            int error = errno;
+            close(fd);
+            fd = -1;
+            throw FatalError(HERE, format("couldn't connect to metrics "
+                    "collector %s: %s", destination.c_str(),
+                    strerror(error)));
+        }
+    } else {
+        fd = open(destination.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644);
+        if (fd < 0) {
+            throw FatalError(HERE, format("couldn't open metrics file %s: %s",
+                    destination.c_str(), strerror(errno)));
+        }
+    }
+    LOG(NOTICE, "Streaming %u-second metrics to %s",
+            seconds, destination.c_str());
+
+    char hostName[100];
+    if (gethostname(hostName, sizeof(hostName)) != 0)
+        snprintf(hostName, sizeof(hostName), "unknown");
+    hostName[sizeof(hostName) - 1] = '\0';
+    prefix = "ramcloud.";
+    prefix.append(hostName);
+    std::replace(prefix.begin() + 9, prefix.end(), '.', '_');
+
+    if (seconds > MAX_WINDOW_SECONDS)
+        seconds = MAX_WINDOW_SECONDS;
+    windowSeconds = std::max(1U, seconds);
+    if (!intervals)
+        intervals.reset(new Intervals);
+    intervals->reset();
+    intervalCount = 0;
+    collect(&lastTotals);
+    stopReporter = false;
+    streaming = 1;
+    reporter.construct(reporterMain);
+}
+
+/**
+ * Stop recording events and close the output. Does nothing if streaming
+ * is off.
+ */
+void
+MetricsStreamer::stop()
+{
+    if (!reporter)
+        return;
+    streaming = 0;
+    stopReporter = true;
+    reporter->join();
+    reporter.destroy();
+    close(fd);
+    fd = -1;
+}
+
+/**
+ * Add up the counts of all the distributions, as recorded by all threads
+ * since startup.
+ *
+ * \param[out] totals
+ *      Filled in with the count for each bucket of each distribution,
+ *      indexed by index * NUM_BUCKETS + bucket.
+ */
+void
+MetricsStreamer::collect(std::vector<uint64_t>* totals)
+{
+    totals->assign(NUM_INDEXES * RpcLatency::NUM_BUCKETS, 0);
+
+    ProtoBuf::ServerStatistics stats;
+    RpcLatency::collect(&stats);
+    foreach (const ProtoBuf::ServerStatistics_RpcLatency& entry,
+            stats.rpc_latency()) {
+        int index;
+        if (entry.stage() == RpcLatency::TOTAL)
+            index = downCast<int>(entry.opcode());
+        else if (entry.stage() == RpcLatency::LOG_SYNC)
+            index = LOG_SYNC_INDEX;
+        else
+            continue;
+        for (int i = 0; i < entry.bucket_size(); i++) {
+            (*totals)[index * RpcLatency::NUM_BUCKETS + entry.bucket(i)] +=
+                    entry.count(i);
+        }
+    }
+
+    std::lock_guard<SpinLock> lock(mutex);
+    foreach (Counts* counts, registeredThreads) {
+        for (int series = 0; series < NUM_SERIES; series++) {
+            uint64_t* total = &(*totals)[(SERIES_INDEX + series) *
+                    RpcLatency::NUM_BUCKETS];
+            for (int b = 0; b < RpcLatency::NUM_BUCKETS; b++)
+                total[b] += counts->counts[series][b];
+        }
+    }
+}
+
+/**
+ * Return the name under which a distribution is reported, such as
+ * "rpc.READ" or "cleaner.disk_pass".
+ *
+ * \param index
+ *      Identifies the distribution (its first index in Interval::counts).
+ */
+string
+MetricsStreamer::getName(int index)
+{
+    if (index < LOG_SYNC_INDEX)
+        return format("rpc.%s", WireFormat::opcodeSymbol(index));
+    switch (index) {
+        case LOG_SYNC_INDEX:
+            return "log_sync";
+        case SERIES_INDEX + CLEANER_MEMORY_PASS:
+            return "cleaner.memory_pass";
+        case SERIES_INDEX + CLEANER_DISK_PASS:
+            return "cleaner.disk_pass";
+    }
+    return format("unknown_%d", index);
+}
+
+/**
+ * Create the counts for the calling thread, the first time it records an
+ * event.
+ *
+ * \return
+ *      The thread's new counts (also stored in threadCounts).
+ */
+MetricsStreamer::Counts*
+MetricsStreamer::registerThread()
+{
+    Counts* counts = new Counts();
+    std::lock_guard<SpinLock> lock(mutex);
+    registeredThreads.push_back(counts);
+    threadCounts = counts;
+    return counts;
+}
+
+/**
+ * Generate a report on the latest intervals: the number of events in each
+ * distribution that has any, and the 50th, 99th and 99.9th percentile
+ * times in microseconds.
+ *
+ * \param unixTime
+ *      The time the report is for, in seconds since the epoch.
+ * \return
+ *      The report, as Graphite plaintext lines such as
+ *      "ramcloud.rc01.rpc.READ.10s.p99_us 5.3 1465000000".
+ */
+string
+MetricsStreamer::report(uint64_t unixTime)
+{
+    uint32_t window = std::min(windowSeconds, intervalCount);
+    string lines;
+    std::vector<uint64_t> total(RpcLatency::NUM_BUCKETS);
+    for (int index = 0; index < NUM_INDEXES; index++) {
+        std::fill(total.begin(), total.end(), 0);
+        for (uint32_t i = intervalCount - window; i < intervalCount; i++) {
+            Interval& interval = (*intervals)[i];
+            for (int b = 0; b < RpcLatency::NUM_BUCKETS; b++)
+                total[b] += interval.counts[index][b];
+        }
+
+        ProtoBuf::ServerStatistics_RpcLatency histogram;
+        uint64_t count = 0;
+        for (int b = 0; b < RpcLatency::NUM_BUCKETS; b++) {
+            if (total[b] == 0)
+                continue;
+            histogram.add_bucket(b);
+            histogram.add_count(total[b]);
+            count += total[b];
+        }
+        if (count == 0)
+            continue;
+
+        string path = format("%s.%s.%us", prefix.c_str(),
+                getName(index).c_str(), windowSeconds);
+        lines.append(format("%s.count %lu %lu\n", path.c_str(), count,
+                unixTime));
+        const char* names[] = {"p50_us", "p99_us", "p999_us"};
+        double fractions[] = {0.5, 0.99, 0.999};
+        for (int i = 0; i < 3; i++) {
+            uint64_t cycles = RpcLatency::getPercentile(histogram,
+                    fractions[i]);
+            lines.append(format("%s.%s %.1f %lu\n", path.c_str(), names[i],
+                    static_cast<double>(Cycles::toNanoseconds(cycles)) / 1e3,
+                    unixTime));
+        }
+    }
+    return lines;
+}
+
+/**
+ * The main program for the reporter thread, which samples the counts and
+ * sends a report every INTERVAL_MICROS until stop is called.
+ */
+void
+MetricsStreamer::reporterMain()
+{
+    uint64_t interval = Cycles::fromMicroseconds(INTERVAL_MICROS);
+    uint64_t next = Cycles::rdtsc() + interval;
+    while (!stopReporter) {
+        // Sleep in short steps so that stop doesn't have to wait long.
+        if (Cycles::rdtsc() < next) {
+            usleep(10000);
+            continue;
+        }
+        next += interval;
+        sample();
+        send(report(static_cast<uint64_t>(time(NULL))));
+    }
+}
+
+/**
+ * Record the events counted since the last call as a new interval,
+ * discarding the oldest interval if the window is full. Only one thread
+ * may call this at a time (normally the reporter).
+ */
+void
+MetricsStreamer::sample()
+{
+    std::vector<uint64_t> totals;
+    collect(&totals);
+    if (intervalCount >= intervals->getOffset() + intervals->getLength())
+        intervals->advance();
+    Interval& interval = (*intervals)[intervalCount];
+    for (int index = 0; index < NUM_INDEXES; index++) {
+        for (int b = 0; b < RpcLatency::NUM_BUCKETS; b++) {
+            size_t i = index * RpcLatency::NUM_BUCKETS + b;
+
+            // Counts only go down if they were reset (see
+            // RpcLatency::reset); everything since then is new.
+            uint64_t delta = totals[i];
+            if (delta >= lastTotals[i])
+                delta -= lastTotals[i];
+            interval.counts[index][b] = downCast<uint32_t>(
+                    std::min(delta, uint64_t(~0U)));
+        }
+    }
+    lastTotals.swap(totals);
+    intervalCount++;
+}
+
+/**
+ * Write a report to the output, in chunks that each end with a complete
+ * line and fit in a UDP datagram.
+ *
+ * \param lines
+ *      The report, as returned by report.
+ */
+void
+MetricsStreamer::send(const string& lines)
+{
+    size_t offset = 0;
+    while (offset < lines.size()) {
+        size_t length = lines.size() - offset;
+        if (length > UDP_CHUNK_BYTES) {
+            size_t end = lines.rfind('\n', offset + UDP_CHUNK_BYTES - 1);
+            if (end == string::npos || end < offset)
+                end = offset + UDP_CHUNK_BYTES - 1;
+            length = end + 1 - offset;
+        }
+        ssize_t count = write(fd, lines.data() + offset, length);
+        if (count < 0) {
+            if (errno == EINTR)
+                continue;
+            // A collector that isn't listening yet shouldn't stop the
+            // reports; the rest of this one is lost.
+            RAMCLOUD_CLOG(WARNING, "couldn't write metrics: %s",
+                    strerror(errno));
+            return;
+        }
+        offset += static_cast<size_t>(count);
+    }
+}
+
+} // namespace RAMCloud
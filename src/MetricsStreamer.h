@@ -0,0 +1,168 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_METRICSSTREAMER_H
+#define RAMCLOUD_METRICSSTREAMER_H
+
+#include <thread>
+#include <memory>
+#include <vector>
+#include "Common.h"
+#include "RpcLatency.h"
+#include "SpinLock.h"
+#include "Tub.h"
+#include "Window.h"
+
+namespace RAMCloud {
+
+/**
+ * This class exports latency percentiles over a sliding window of recent
+ * time (such as "99th percentile READ time over the last 10 seconds") to a
+ * monitoring system, once a second. Cumulative statistics (see RpcLatency
+ * and PerfStats) can only give this by diffing snapshots offline.
+ *
+ * The distributions covered are the total time of each kind of RPC and the
+ * time spent in log syncs, both from RpcLatency, and the time of each
+ * cleaner pass, which is recorded here. Recording stays lock-free: each
+ * thread counts into its own histograms. Once a second a background thread
+ * adds up all of the threads' histograms, keeps the difference from the
+ * previous second in a Window of per-second intervals, and sends the
+ * percentiles over the window's intervals as Graphite plaintext lines
+ * ("<path> <value> <unix time>"), either to a file or to a UDP collector.
+ *
+ * Recording costs nothing more than a test when streaming is off.
+ *
+ * This class provides only static methods and variables: it isn't
+ * possible to construct an instance from outside.
+ */
+class MetricsStreamer {
+  public:
+    /// Distributions recorded through this class (RPC times come from
+    /// RpcLatency instead).
+    enum Series {
+        CLEANER_MEMORY_PASS = 0,    // One in-memory cleaning pass.
+        CLEANER_DISK_PASS = 1,      // One disk cleaning pass.
+        NUM_SERIES = 2
+    };
+
+    /**
+     * Count one event in one of the distributions, if streaming is on.
+     *
+     * \param series
+     *      Which distribution \a cycles belongs in.
+     * \param cycles
+     *      How long the event took, in Cycles::rdtsc ticks.
+     */
+    static inline void
+    record(Series series, uint64_t cycles)
+    {
+        if (!streaming)
+            return;
+        Counts* counts = threadCounts;
+        if (counts == NULL)
+            counts = registerThread();
+        counts->counts[series][RpcLatency::getBucket(cycles)]++;
+    }
+
+    static void start(const string& destination, uint32_t seconds);
+    static void stop();
+
+    /// The longest window, in seconds, that percentiles can be computed
+    /// over.
+    static const uint32_t MAX_WINDOW_SECONDS = 30;
+
+  PRIVATE:
+    /// Counts recorded by one thread for each of the distributions in
+    /// Series; cumulative since the thread first recorded something.
+    struct Counts {
+        uint64_t counts[NUM_SERIES][RpcLatency::NUM_BUCKETS];
+    };
+
+    /// Distributions kept in each Interval: each opcode's total time
+    /// (indexed by opcode), then log syncs, then the entries of Series.
+    static const int LOG_SYNC_INDEX = WireFormat::ILLEGAL_RPC_TYPE;
+    static const int SERIES_INDEX = LOG_SYNC_INDEX + 1;
+    static const int NUM_INDEXES = SERIES_INDEX + NUM_SERIES;
+
+    /// The events of each distribution counted during one interval.
+    struct Interval {
+        uint32_t counts[NUM_INDEXES][RpcLatency::NUM_BUCKETS];
+    };
+
+    /// The most recent intervals, indexed by interval number.
+    typedef Window<Interval, MAX_WINDOW_SECONDS + 1> Intervals;
+
+    /// Report is sent in chunks of at most this many bytes, split between
+    /// lines, so that each fits in a single UDP datagram.
+    static const size_t UDP_CHUNK_BYTES = 8192;
+
+    /// How long each interval lasts, and how often reports are sent.
+    static const int INTERVAL_MICROS = 1000000;
+
+    MetricsStreamer();
+    static void collect(std::vector<uint64_t>* totals);
+    static string getName(int index);
+    static Counts* registerThread();
+    static string report(uint64_t unixTime);
+    static void reporterMain();
+    static void sample();
+    static void send(const string& lines);
+
+    /// Nonzero means events are being recorded and reports sent.
+    static volatile int streaming;
+
+    /// The calling thread's counts; NULL until it records something.
+    static __thread Counts* threadCounts;
+
+    /// Protects #registeredThreads.
+    static SpinLock mutex;
+
+    /// The counts of every thread that has recorded anything. They are
+    /// never freed, since the reporter may be reading them at any time.
+    static std::vector<Counts*> registeredThreads;
+
+    /// File descriptor for the output (a file, or a connected UDP socket);
+    /// -1 if not streaming.
+    static int fd;
+
+    /// Starts the path of every line in the report; names this server.
+    static string prefix;
+
+    /// Percentiles are reported over this many of the latest intervals.
+    static uint32_t windowSeconds;
+
+    /// Counts for the latest intervals; entry #intervalCount - 1 is the
+    /// newest. NULL until streaming is first started.
+    static std::unique_ptr<Intervals> intervals;
+
+    /// Number of intervals sampled since streaming was started.
+    static uint32_t intervalCount;
+
+    /// Counts of all the distributions, cumulative since startup, as of
+    /// the last sample; indexed by index * NUM_BUCKETS + bucket.
+    static std::vector<uint64_t> lastTotals;
+
+    /// Set to ask the reporter thread to exit.
+    static volatile bool stopReporter;
+
+    /// Thread running reporterMain while streaming.
+    static Tub<std::thread> reporter;
+
+    DISALLOW_COPY_AND_ASSIGN(MetricsStreamer);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_METRICSSTREAMER_H
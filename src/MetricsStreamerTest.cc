@@ -0,0 +1,237 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "TestUtil.h"
+#include "Cycles.h"
+#include "MetricsStreamer.h"
+
+namespace RAMCloud {
+
+class MetricsStreamerTest : public ::testing::Test {
+  public:
+    char fileName[100];
+
+    MetricsStreamerTest()
+        : fileName()
+    {
+        strncpy(fileName, "/tmp/ramcloud-metrics-test-delete-this-XXXXXX",
+                sizeof(fileName));
+        close(mkstemp(fileName));
+        RpcLatency::reset();
+        Cycles::mockCyclesPerSec = 1e09;
+    }
+
+    ~MetricsStreamerTest()
+    {
+        MetricsStreamer::stop();
+        MetricsStreamer::streaming = 0;
+        MetricsStreamer::fd = -1;
+        Cycles::mockCyclesPerSec = 0;
+        unlink(fileName);
+    }
+
+    /// Set up the streamer as start would, but without the reporter thread,
+    /// so that tests can call sample and report themselves.
+    void
+    startWithoutReporter(uint32_t windowSeconds)
+    {
+        MetricsStreamer::prefix = "ramcloud.host";
+        MetricsStreamer::windowSeconds = windowSeconds;
+        if (!MetricsStreamer::intervals)
+            MetricsStreamer::intervals.reset(new MetricsStreamer::Intervals);
+        MetricsStreamer::intervals->reset();
+        MetricsStreamer::intervalCount = 0;
+        MetricsStreamer::collect(&MetricsStreamer::lastTotals);
+        MetricsStreamer::streaming = 1;
+    }
+
+    /// Return the number of events in one distribution of an interval.
+    uint64_t
+    count(uint32_t interval, int index)
+    {
+        uint64_t total = 0;
+        for (int b = 0; b < RpcLatency::NUM_BUCKETS; b++)
+            total += (*MetricsStreamer::intervals)[interval].counts[index][b];
+        return total;
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(MetricsStreamerTest);
+};
+
+TEST_F(MetricsStreamerTest, record_notStreaming) {
+    MetricsStreamer::Counts* counts = MetricsStreamer::threadCounts;
+    uint64_t before = (counts == NULL) ? 0 :
+            counts->counts[MetricsStreamer::CLEANER_DISK_PASS][10];
+    MetricsStreamer::record(MetricsStreamer::CLEANER_DISK_PASS, 10);
+    EXPECT_EQ(counts, MetricsStreamer::threadCounts);
+    if (counts != NULL) {
+        EXPECT_EQ(before,
+                counts->counts[MetricsStreamer::CLEANER_DISK_PASS][10]);
+    }
+}
+
+TEST_F(MetricsStreamerTest, startAndStop_file) {
+    MetricsStreamer::start(fileName, 100);
+    EXPECT_EQ(1, MetricsStreamer::streaming);
+    EXPECT_EQ(30U, MetricsStreamer::windowSeconds);
+    EXPECT_EQ(0U, MetricsStreamer::prefix.find("ramcloud."));
+    EXPECT_EQ(string::npos, MetricsStreamer::prefix.find('.', 9));
+    MetricsStreamer::stop();
+    EXPECT_EQ(0, MetricsStreamer::streaming);
+    EXPECT_EQ(-1, MetricsStreamer::fd);
+    EXPECT_FALSE(MetricsStreamer::reporter);
+
+    // Stopping again is harmless.
+    MetricsStreamer::stop();
+
+    MetricsStreamer::start(fileName, 0);
+    EXPECT_EQ(1U, MetricsStreamer::windowSeconds);
+}
+
+TEST_F(MetricsStreamerTest, start_badFile) {
+    EXPECT_THROW(MetricsStreamer::start("/nonexistent/directory/metrics", 10),
+            FatalError);
+    EXPECT_FALSE(MetricsStreamer::reporter);
+}
+
+TEST_F(MetricsStreamerTest, collect) {
+    startWithoutReporter(10);
+    std::vector<uint64_t> before = MetricsStreamer::lastTotals;
+    RpcLatency::record(WireFormat::READ, RpcLatency::TOTAL, 100);
+    RpcLatency::record(WireFormat::READ, RpcLatency::EXECUTING, 100);
+    RpcLatency::record(WireFormat::WRITE, RpcLatency::LOG_SYNC, 100);
+    RpcLatency::record(WireFormat::MULTI_OP, RpcLatency::LOG_SYNC, 100);
+    MetricsStreamer::record(MetricsStreamer::CLEANER_MEMORY_PASS, 100);
+    std::vector<uint64_t> after;
+    MetricsStreamer::collect(&after);
+
+    int bucket = RpcLatency::getBucket(100);
+    int numBuckets = RpcLatency::NUM_BUCKETS;
+    for (int index = 0; index < MetricsStreamer::NUM_INDEXES; index++) {
+        size_t i = index * numBuckets + bucket;
+        uint64_t expected = 0;
+        if (index == WireFormat::READ)
+            expected = 1;
+        else if (index == MetricsStreamer::LOG_SYNC_INDEX)
+            expected = 2;
+        else if (index == MetricsStreamer::SERIES_INDEX +
+                MetricsStreamer::CLEANER_MEMORY_PASS)
+            expected = 1;
+        EXPECT_EQ(expected, after[i] - before[i]) << "index " << index;
+    }
+}
+
+TEST_F(MetricsStreamerTest, sample) {
+    startWithoutReporter(10);
+    int diskIndex = MetricsStreamer::SERIES_INDEX +
+            MetricsStreamer::CLEANER_DISK_PASS;
+    RpcLatency::record(WireFormat::READ, RpcLatency::TOTAL, 100);
+    RpcLatency::record(WireFormat::READ, RpcLatency::TOTAL, 200);
+    MetricsStreamer::record(MetricsStreamer::CLEANER_DISK_PASS, 300);
+    MetricsStreamer::sample();
+    RpcLatency::record(WireFormat::READ, RpcLatency::TOTAL, 100);
+    MetricsStreamer::sample();
+    EXPECT_EQ(2U, MetricsStreamer::intervalCount);
+    EXPECT_EQ(2U, count(0, WireFormat::READ));
+    EXPECT_EQ(1U, count(0, diskIndex));
+    EXPECT_EQ(1U, count(1, WireFormat::READ));
+    EXPECT_EQ(0U, count(1, diskIndex));
+
+    // Counts that were reset are all new.
+    RpcLatency::reset();
+    RpcLatency::record(WireFormat::READ, RpcLatency::TOTAL, 100);
+    MetricsStreamer::sample();
+    EXPECT_EQ(1U, count(2, WireFormat::READ));
+
+    // Once the window is full, the oldest interval is discarded.
+    while (MetricsStreamer::intervalCount <
+            MetricsStreamer::intervals->getLength())
+        MetricsStreamer::sample();
+    EXPECT_EQ(0U, MetricsStreamer::intervals->getOffset());
+    MetricsStreamer::sample();
+    EXPECT_EQ(1U, MetricsStreamer::intervals->getOffset());
+    EXPECT_EQ(1U, count(1, WireFormat::READ));
+    EXPECT_EQ(0U, count(MetricsStreamer::intervalCount - 1,
+            WireFormat::READ));
+}
+
+TEST_F(MetricsStreamerTest, getName) {
+    EXPECT_EQ("rpc.READ", MetricsStreamer::getName(WireFormat::READ));
+    EXPECT_EQ("log_sync",
+            MetricsStreamer::getName(MetricsStreamer::LOG_SYNC_INDEX));
+    EXPECT_EQ("cleaner.memory_pass",
+            MetricsStreamer::getName(MetricsStreamer::SERIES_INDEX +
+            MetricsStreamer::CLEANER_MEMORY_PASS));
+    EXPECT_EQ("cleaner.disk_pass",
+            MetricsStreamer::getName(MetricsStreamer::SERIES_INDEX +
+            MetricsStreamer::CLEANER_DISK_PASS));
+}
+
+TEST_F(MetricsStreamerTest, report) {
+    startWithoutReporter(2);
+    EXPECT_EQ("", MetricsStreamer::report(1000));
+
+    // Only the latest 2 intervals are included: the WRITE is too old.
+    RpcLatency::record(WireFormat::WRITE, RpcLatency::TOTAL, 1024);
+    MetricsStreamer::sample();
+    for (int i = 0; i < 99; i++)
+        RpcLatency::record(WireFormat::READ, RpcLatency::TOTAL, 1024);
+    MetricsStreamer::sample();
+    RpcLatency::record(WireFormat::READ, RpcLatency::TOTAL, 8192);
+    MetricsStreamer::record(MetricsStreamer::CLEANER_MEMORY_PASS, 2048);
+    MetricsStreamer::sample();
+    EXPECT_EQ("ramcloud.host.rpc.READ.2s.count 100 1000\n"
+            "ramcloud.host.rpc.READ.2s.p50_us 1.0 1000\n"
+            "ramcloud.host.rpc.READ.2s.p99_us 1.0 1000\n"
+            "ramcloud.host.rpc.READ.2s.p999_us 8.2 1000\n"
+            "ramcloud.host.cleaner.memory_pass.2s.count 1 1000\n"
+            "ramcloud.host.cleaner.memory_pass.2s.p50_us 2.0 1000\n"
+            "ramcloud.host.cleaner.memory_pass.2s.p99_us 2.0 1000\n"
+            "ramcloud.host.cleaner.memory_pass.2s.p999_us 2.0 1000\n",
+            MetricsStreamer::report(1000));
+}
+
+TEST_F(MetricsStreamerTest, send_chunks) {
+    int fds[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_DGRAM, 0, fds));
+    MetricsStreamer::fd = fds[0];
+    string lines;
+    for (int i = 0; i < 1000; i++)
+        lines.append(format("ramcloud.host.metric%d 1 1000\n", i));
+    MetricsStreamer::send(lines);
+    close(fds[0]);
+    MetricsStreamer::fd = -1;
+
+    // Each datagram holds only complete lines.
+    char buffer[MetricsStreamer::UDP_CHUNK_BYTES];
+    string received;
+    int datagrams = 0;
+    while (1) {
+        ssize_t count = recv(fds[1], buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (count <= 0)
+            break;
+        datagrams++;
+        EXPECT_EQ('\n', buffer[count - 1]);
+        received.append(buffer, count);
+    }
+    close(fds[1]);
+    EXPECT_GT(datagrams, 1);
+    EXPECT_EQ(lines, received);
+}
+
+}  // namespace RAMCloud
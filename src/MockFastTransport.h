@@ -27,7 +27,8 @@ namespace RAMCloud {
 class MockFastTransport : public FastTransport {
   public:
     explicit MockFastTransport(Context* context, Driver *driver)
-            : FastTransport(context, driver), packetData(), sender(NULL) { }
+            : FastTransport(context, driver), packetData(), sender(NULL)
+            , arrivalTime(0) { }
     ~MockFastTransport() {
         delete sender;
     }
@@ -37,9 +38,11 @@ class MockFastTransport : public FastTransport {
         }
         packetData.append(received->payload, received->len);
         sender = received->sender->clone();
+        arrivalTime = received->arrivalTime;
     }
     string packetData;
     const Driver::Address *sender;
+    uint64_t arrivalTime;           // From the most recent packet.
   private:
     DISALLOW_COPY_AND_ASSIGN(MockFastTransport);
 };
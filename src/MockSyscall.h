@@ -42,8 +42,9 @@ class MockSyscall : public Syscall {
                     getsocknameErrno(0), ioctlErrno(0),
                     ioctlRetriesToSuccess(0), listenErrno(0), pipeErrno(0),
                     recvErrno(0), recvEof(false), recvfromErrno(0),
-                    recvfromEof(false), sendmsgErrno(0), sendmsgReturnCount(-1),
-                    sendtoErrno(0), sendtoReturnCount(-1), setsockoptErrno(0),
+                    recvfromEof(false), recvmmsgErrno(0), sendmsgErrno(0),
+                    sendmsgReturnCount(-1), sendtoErrno(0),
+                    sendtoReturnCount(-1), setsockoptErrno(0),
                     socketErrno(0), writeErrno(0) {}
 
     int acceptErrno;
@@ -241,6 +242,16 @@ class MockSyscall : public Syscall {
         return -1;
     }
 
+    int recvmmsgErrno;
+    int recvmmsg(int sockfd, mmsghdr *msgvec, unsigned int vlen, int flags,
+                 timespec *timeout) {
+        if (recvmmsgErrno == 0) {
+            return ::recvmmsg(sockfd, msgvec, vlen, flags, timeout);
+        }
+        errno = recvmmsgErrno;
+        return -1;
+    }
+
     int sendmsgErrno;
     int sendmsgReturnCount;
     ssize_t sendmsg(int sockfd, const msghdr *msg, int flags) {
@@ -0,0 +1,169 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_MPSCRING_H
+#define RAMCLOUD_MPSCRING_H
+
+#include <atomic>
+#include <vector>
+
+#include "Common.h"
+
+namespace RAMCloud {
+
+/**
+ * A fixed-size, lock-free queue that any number of threads may push
+ * values into and a single thread pops them from. Neither side ever
+ * blocks or takes a lock: a push into a full ring fails instead of
+ * waiting, so the caller needs some other (slower) way of getting its
+ * value to the consumer in that case.
+ *
+ * Each slot carries a sequence number saying whose turn it is to use the
+ * slot: producers claim a slot by advancing #tail, fill it in, then bump
+ * the slot's sequence to publish it; the consumer bumps it again when it
+ * has taken the value, making the slot available to the producer one lap
+ * later. Values become visible to the consumer in the order their slots
+ * were claimed.
+ *
+ * \tparam T
+ *      Type of the values in the ring; it should be cheap to copy (for
+ *      example, a pointer).
+ */
+template<typename T>
+class MpscRing {
+  public:
+    /**
+     * Construct an empty ring.
+     *
+     * \param minCapacity
+     *      The ring holds at least this many values; its actual capacity is
+     *      the next power of two.
+     */
+    explicit MpscRing(size_t minCapacity)
+        : slots(capacityFor(minCapacity))
+        , mask(slots.size() - 1)
+        , head(0)
+        , tail(0)
+    {
+        for (size_t i = 0; i < slots.size(); i++)
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    /// Return the number of values the ring can hold.
+    size_t capacity() const { return slots.size(); }
+
+    /**
+     * Add a value at the end of the ring. May be invoked concurrently by
+     * any number of threads.
+     *
+     * \param value
+     *      Value to add.
+     * \return
+     *      True means the value was added; false means the ring was full,
+     *      so nothing was added.
+     */
+    bool
+    push(const T& value)
+    {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &slots[pos & mask];
+            size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            if (sequence == pos) {
+                if (tail.compare_exchange_weak(pos, pos + 1,
+                        std::memory_order_relaxed))
+                    break;
+            } else if (sequence < pos) {
+                // The consumer hasn't taken the value from the previous
+                // lap yet.
+                return false;
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+        slot->value = value;
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Remove the value at the front of the ring. Must only be invoked by
+     * one thread at a time (the consumer).
+     *
+     * \param[out] value
+     *      The value removed is stored here.
+     * \return
+     *      True means a value was removed; false means the ring was empty
+     *      (or the next value is still being pushed), and *value is
+     *      unchanged.
+     */
+    bool
+    pop(T* value)
+    {
+        Slot* slot = &slots[head & mask];
+        if (slot->sequence.load(std::memory_order_acquire) != head + 1)
+            return false;
+        *value = slot->value;
+        slot->sequence.store(head + slots.size(), std::memory_order_release);
+        head++;
+        return true;
+    }
+
+  PRIVATE:
+    /// One entry in the ring.
+    struct Slot {
+        Slot()
+            : sequence(0)
+            , value()
+        {}
+
+        /// Equal to the position (count of pushes) a producer may fill this
+        /// slot at; one more than that once it has been filled.
+        std::atomic<size_t> sequence;
+
+        /// The value pushed into this slot.
+        T value;
+    };
+
+    /// Return the smallest power of two that is at least minCapacity.
+    static size_t
+    capacityFor(size_t minCapacity)
+    {
+        size_t result = 1;
+        while (result < minCapacity)
+            result <<= 1;
+        return result;
+    }
+
+    /// Storage for the values; its size is a power of two.
+    std::vector<Slot> slots;
+
+    /// slots.size() - 1; used to turn positions into indexes.
+    const size_t mask;
+
+    /// Position of the next value to pop; only used by the consumer. Kept
+    /// on its own cache line so producers don't contend with it.
+    size_t head CACHE_ALIGN;
+
+    /// Position that the next push will claim.
+    std::atomic<size_t> tail CACHE_ALIGN;
+
+    DISALLOW_COPY_AND_ASSIGN(MpscRing);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_MPSCRING_H
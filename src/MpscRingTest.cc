@@ -0,0 +1,87 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <thread>
+
+#include "TestUtil.h"
+#include "MpscRing.h"
+
+namespace RAMCloud {
+
+TEST(MpscRingTest, constructor) {
+    MpscRing<int> ring1(5);
+    EXPECT_EQ(8U, ring1.capacity());
+    MpscRing<int> ring2(16);
+    EXPECT_EQ(16U, ring2.capacity());
+    MpscRing<int> ring3(0);
+    EXPECT_EQ(1U, ring3.capacity());
+}
+
+TEST(MpscRingTest, pushAndPop) {
+    MpscRing<int> ring(4);
+    int value = -1;
+    EXPECT_FALSE(ring.pop(&value));
+    EXPECT_EQ(-1, value);
+
+    // Go around the ring a few times.
+    for (int lap = 0; lap < 3; lap++) {
+        for (int i = 0; i < 4; i++)
+            EXPECT_TRUE(ring.push(10 * lap + i));
+        EXPECT_FALSE(ring.push(99));
+        for (int i = 0; i < 4; i++) {
+            EXPECT_TRUE(ring.pop(&value));
+            EXPECT_EQ(10 * lap + i, value);
+        }
+        EXPECT_FALSE(ring.pop(&value));
+    }
+}
+
+// Helper function that runs in a separate thread for the following test.
+static void pushValues(MpscRing<int>* ring, int first, int count) {
+    for (int i = first; i < first + count; i++) {
+        while (!ring->push(i)) {
+            // The ring is full; wait for the consumer to catch up.
+            std::this_thread::yield();
+        }
+    }
+}
+
+TEST(MpscRingTest, concurrentProducers) {
+    MpscRing<int> ring(64);
+    std::thread thread1(pushValues, &ring, 0, 10000);
+    std::thread thread2(pushValues, &ring, 10000, 10000);
+
+    // Each producer's values must arrive in order, and all of them must
+    // arrive exactly once.
+    int next[2] = {0, 10000};
+    int value;
+    for (int received = 0; received < 20000; ) {
+        if (!ring.pop(&value)) {
+            std::this_thread::yield();
+            continue;
+        }
+        int producer = value / 10000;
+        EXPECT_EQ(next[producer], value);
+        next[producer] = value + 1;
+        received++;
+    }
+    thread1.join();
+    thread2.join();
+    EXPECT_EQ(10000, next[0]);
+    EXPECT_EQ(20000, next[1]);
+    EXPECT_FALSE(ring.pop(&value));
+}
+
+}  // namespace RAMCloud
@@ -16,6 +16,7 @@
 #include <utility>
 
 #include "Context.h"
+#include "Cycles.h"
 #include "Dispatch.h"
 #include "MultiOp.h"
 #include "ObjectFinder.h"
@@ -41,16 +42,18 @@ namespace RAMCloud {
  *
  * Internally, startRPCs dispatches the request array into sessionQueues,
  * each of which buffers requests intended for a particular master (identified
- * by its session).  Whenever a session queue reaches MAX_OBJECTS_PER_RPC it is
+ * by its session).  Whenever a session queue reaches objectsPerRpc it is
  * packaged into an RPC and sent.  All sesseion queues are drained (sent) once
  * all requests are dispatched.  startRPC is typically called multiple times and
  * it returns to isReady whenever MAX_RPC RPCs are underway or when the MultiOp
- * is finished.
+ * is finished.  A session queue is also left alone while its master's
+ * SessionWindow is full; it keeps growing until an RPC to the master returns.
  *
  * isReady takes care of the respones by calling finishRpc, which can trigger a
  * retry of an RPC if necessary.  The retry re-inserts the RPC into
  * sessionQueues, allowing the session queue to grow slightly beyond
- * MAX_OBJECTS_PER_RPC.
+ * objectsPerRpc.  isReady also uses the size and round-trip time of each
+ * returned RPC to adjust objectsPerRpc and its master's window.
  *
  * isReady also calls startRPC when there is at least one free RPC.  The list
  * of free RPCs and RPCs underway is maintained through startIndexIdleRpc and
@@ -82,10 +85,12 @@ MultiOp::MultiOp(RamCloud* ramcloud, WireFormat::MultiOp::OpType type,
     , requests(requests)
     , numRequests(numRequests)
     , numDispatched(0)
+    , objectsPerRpc(INITIAL_OBJECTS_PER_RPC)
     , rpcs()
     , startIndexIdleRpc(0)
     , canceled(false)
     , sessionQueues()
+    , sessionWindows()
     , test_ignoreBufferOverflow(false)
 {
     for (uint32_t i = 0; i < MAX_RPCS; ++i) {
@@ -103,9 +108,64 @@ MultiOp::cancel()
     for (uint32_t i = 0; i < MAX_RPCS; i++) {
         rpcs[i].destroy();
     }
+    for (SessionWindows::iterator it = sessionWindows.begin();
+            it != sessionWindows.end(); it++) {
+        it->second.outstanding = 0;
+    }
     canceled = true;
 }
 
+/**
+ * Adjust the number of RPCs that may be outstanding to a server, given the
+ * round-trip time of an RPC to it that just finished.
+ *
+ * \param window
+ *      Flow control state for the server.
+ * \param latency
+ *      Time between sending the RPC and seeing its response, in
+ *      Cycles::rdtsc ticks.
+ */
+void
+MultiOp::adjustWindow(SessionWindow* window, uint64_t latency)
+{
+    if (window->minLatency == 0 || latency < window->minLatency)
+        window->minLatency = latency;
+
+    // A round trip much longer than the fastest one means the RPC spent
+    // most of its time waiting at the server (small differences are noise,
+    // such as a larger response).
+    uint64_t slack = Cycles::fromMicroseconds(20);
+    if (latency > 2 * window->minLatency &&
+            latency - window->minLatency > slack) {
+        if (window->limit > 1)
+            window->limit--;
+    } else if (window->limit < MAX_RPCS_PER_SESSION) {
+        window->limit++;
+    }
+}
+
+/**
+ * Choose how many objects to pack into each RPC, given the size of an RPC
+ * that just finished, so that RPCs carry about TARGET_RPC_BYTES: large
+ * objects are spread over more RPCs (which can be pipelined), small ones
+ * are packed into fewer.
+ *
+ * \param rpcBytes
+ *      The larger of the RPC's request and response sizes.
+ * \param count
+ *      Number of objects in the RPC.
+ */
+void
+MultiOp::adjustObjectsPerRpc(uint32_t rpcBytes, uint32_t count)
+{
+    if (count == 0)
+        return;
+    uint32_t bytesPerObject = std::max(rpcBytes / count, 1U);
+    objectsPerRpc = std::max(TARGET_RPC_BYTES / bytesPerObject, 1U);
+    uint32_t maxObjectsPerRpc = MAX_OBJECTS_PER_RPC;
+    objectsPerRpc = std::min(objectsPerRpc, maxObjectsPerRpc);
+}
+
 /**
  * Looks up the SessionQueue that matches the request's session and adds the
  * the request.  Creates a new session buffer if the requests is for a formerly
@@ -142,7 +202,7 @@ MultiOp::dispatchRequest(MultiOpObject* request,
     auto iter = sessionQueues.find(*session);
     if (iter == sessionQueues.end()) {
         *queue = new SessionQueue();
-        (*queue)->reserve(PartRpc::MAX_OBJECTS_PER_RPC);
+        (*queue)->reserve(objectsPerRpc);
         (*queue)->push_back(request);
         sessionQueues.insert(
             SessionQueues::value_type(*session,
@@ -153,6 +213,19 @@ MultiOp::dispatchRequest(MultiOpObject* request,
     }
 }
 
+/**
+ * Return the flow control state for a server, creating it if this is the
+ * first RPC to the server.
+ *
+ * \param session
+ *      Session for the server.
+ */
+MultiOp::SessionWindow*
+MultiOp::findWindow(Transport::SessionRef session)
+{
+    return &sessionWindows[session];
+}
+
 /**
  * This method is invoked when an RPC finishes; it copies result
  * information back to the request objects, and handles certain
@@ -251,27 +324,33 @@ MultiOp::finishRpc(MultiOp::PartRpc* rpc) {
 }
 
 /**
- * Package up to MAX_OBJECTS_PER_RPC requests from a session buffer into an RPC
- * and send the RPC.
+ * Package up to objectsPerRpc requests from a session buffer into an RPC
+ * and send the RPC, unless the server's window is full.
  *
  * \param session
  *      The session of the requests in queue
  * \param queue
  *      An array of requests for session.  The array can be larger than
- *      MAX_OBJECTS_PER_RPC but at most one RPC is sent.  The size of a non
- *      empty queue will decrease.
+ *      objectsPerRpc but at most one RPC is sent.  The size of a non
+ *      empty queue will decrease if an RPC was sent.
  */
 void
 MultiOp::flushSessionQueue(Transport::SessionRef session, SessionQueue *queue) {
     assert(startIndexIdleRpc < MAX_RPCS);
 
+    SessionWindow* window = findWindow(session);
+    if (window->outstanding >= window->limit)
+        return;
+
     Tub<PartRpc> *rpc = ptrRpcs[startIndexIdleRpc];
-    rpc->construct(ramcloud, session, opType);
+    rpc->construct(ramcloud, session, opType, window);
+    (*rpc)->reqHdr->filterBytes = appendFilter(&(*rpc)->request);
     startIndexIdleRpc++;
 
     size_t queueLen = queue->size();
-    size_t residue = (queueLen <= PartRpc::MAX_OBJECTS_PER_RPC) ?
-        0 : queueLen - PartRpc::MAX_OBJECTS_PER_RPC;
+    size_t residue = (queueLen <= objectsPerRpc) ?
+        0 : queueLen - objectsPerRpc;
+    (*rpc)->requests.reserve(queueLen - residue);
     while (queueLen > residue) {
         MultiOpObject *request = (*queue)[queueLen-1];
         uint32_t lengthBefore = (*rpc)->request.size();
@@ -292,7 +371,7 @@ MultiOp::flushSessionQueue(Transport::SessionRef session, SessionQueue *queue) {
         }
 
         request->status = UNDERWAY;
-        (*rpc)->requests[(*rpc)->reqHdr->count] = request;
+        (*rpc)->requests.push_back(request);
         (*rpc)->reqHdr->count++;
         queueLen--;
     }
@@ -300,6 +379,7 @@ MultiOp::flushSessionQueue(Transport::SessionRef session, SessionQueue *queue) {
 
     // Send if there is at least one good request in the RPC
     if ((*rpc)->reqHdr->count > 0) {
+        window->outstanding++;
         (*rpc)->send();
     } else {
         rpc->destroy();
@@ -325,6 +405,13 @@ MultiOp::isReady() {
     for (uint32_t i = 0; i < startIndexIdleRpc; ) {
         Tub<PartRpc>& rpc = *(ptrRpcs[i]);
         if (rpc->isReady()) {
+            rpc->window->outstanding--;
+            if (rpc->isFinished()) {
+                adjustWindow(rpc->window, Cycles::rdtsc() - rpc->sendTime);
+                adjustObjectsPerRpc(std::max(rpc->request.size(),
+                                             rpc->response->size()),
+                                    rpc->reqHdr->count);
+            }
             finishRpc(rpc.get());
             rpc.destroy();
             startIndexIdleRpc--;
@@ -369,7 +456,7 @@ MultiOp::startRpcs()
         if (queue == NULL) {
             continue;
         }
-        if (queue->size() >= PartRpc::MAX_OBJECTS_PER_RPC) {
+        if (queue->size() >= objectsPerRpc) {
             flushSessionQueue(session, queue);
         }
 
@@ -456,14 +543,19 @@ MultiOp::retryRequest(MultiOpObject* request) {
  *      The Multi OpType kind of messages this PartRpc shall contain.
  * \param session
  *      Session on which this RPC will eventually be sent.
+ * \param window
+ *      Flow control state for \a session.
  */
 MultiOp::PartRpc::PartRpc(RamCloud* ramcloud,
-        Transport::SessionRef session, WireFormat::MultiOp::OpType type)
+        Transport::SessionRef session, WireFormat::MultiOp::OpType type,
+        SessionWindow* window)
     : RpcWrapper(sizeof(WireFormat::MultiOp::Response))
     , ramcloud(ramcloud)
     , session(session)
     , requests()
     , reqHdr(allocHeader<WireFormat::MultiOp>())
+    , window(window)
+    , sendTime(0)
 {
     reqHdr->type = type;
     reqHdr->count = 0;
@@ -492,7 +584,8 @@ void
 MultiOp::PartRpc::send()
 {
     state = IN_PROGRESS;
-    session->sendRequest(&request, response, this);
+    sendTime = Cycles::rdtsc();
+    sendRequest();
 }
 
 } // namespace RAMCloud
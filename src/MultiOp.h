@@ -69,12 +69,34 @@ class MultiOp {
     MultiOp(RamCloud* ramcloud,  WireFormat::MultiOp::OpType type,
                 MultiOpObject * const requests[], uint32_t numRequests);
 
+    /// Flow control state for the RPCs sent to one server: how many of
+    /// them may be outstanding at once. The limit shrinks when the server
+    /// takes much longer than usual to answer (its queue is building up, so
+    /// more RPCs would only wait there) and grows again when it doesn't.
+    struct SessionWindow {
+        SessionWindow()
+            : outstanding(0)
+            , limit(MAX_RPCS_PER_SESSION)
+            , minLatency(0)
+        {}
+
+        /// Number of RPCs currently underway to the server.
+        uint32_t outstanding;
+
+        /// Most RPCs that may be underway to the server at once.
+        uint32_t limit;
+
+        /// Shortest round trip seen for an RPC to the server, in
+        /// Cycles::rdtsc ticks; 0 means none has finished yet.
+        uint64_t minLatency;
+    };
+
     /// Encapsulates the state of a single RPC sent to a single server.
     class PartRpc : public RpcWrapper {
         friend class MultiOp;
       public:
         PartRpc(RamCloud* ramcloud, Transport::SessionRef session,
-                WireFormat::MultiOp::OpType type);
+                WireFormat::MultiOp::OpType type, SessionWindow* window);
         virtual ~PartRpc() {}
         bool inProgress() {return getState() == IN_PROGRESS;
                                 };
@@ -90,25 +112,19 @@ class MultiOp {
         Transport::SessionRef session;
 
         /// Information about all of the objects that are being requested
-        /// in this RPC. Note: the batch size used to be larger than this,
-        /// but one of the biggest the performance benefits comes from
-        /// issuing multiple RPCs that can be pipelined. Thus, it's
-        /// better to have a smaller batch size so that pipelining kicks
-        /// in for fewer total objects. If the total size of the multi-op
-        /// request is huge (thousands?) then this approach is slightly
-        /// slower (as of 12/2014) but smaller batch sizes are faster as
-        /// long as the total number of objects in the multi-op request
-        /// is a few hundred or less.
-#ifdef TESTING
-        static const uint32_t MAX_OBJECTS_PER_RPC = 3;
-#else
-        static const uint32_t MAX_OBJECTS_PER_RPC = 20;
-#endif
-        MultiOpObject* requests[MAX_OBJECTS_PER_RPC];
+        /// in this RPC (see MultiOp::objectsPerRpc for how many there are).
+        std::vector<MultiOpObject*> requests;
 
         /// Header for the RPC (used to update count as objects are added).
         WireFormat::MultiOp::Request* reqHdr;
 
+        /// Flow control state for the server; its count of outstanding
+        /// RPCs includes this one while it's underway.
+        SessionWindow* window;
+
+        /// Cycles::rdtsc() when the RPC was sent.
+        uint64_t sendTime;
+
         DISALLOW_COPY_AND_ASSIGN(PartRpc);
     };
 
@@ -116,12 +132,15 @@ class MultiOp {
 
   PRIVATE:
     /// Buffer of requests for the same master.  Buffer is flushed at the
-    /// end or when its size reaches MAX_OBJECTS_PER_RPC.
+    /// end or when its size reaches objectsPerRpc.
     typedef std::vector<MultiOpObject*> SessionQueue;
 
+    static void adjustWindow(SessionWindow* window, uint64_t latency);
+    void adjustObjectsPerRpc(uint32_t rpcBytes, uint32_t count);
     void dispatchRequest(MultiOpObject* request,
                          Transport::SessionRef *session,
                          SessionQueue **queue);
+    SessionWindow* findWindow(Transport::SessionRef session);
     void finishRpc(MultiOp::PartRpc* rpc);
     void flushSessionQueue(Transport::SessionRef session,
                            SessionQueue *queue);
@@ -155,11 +174,36 @@ class MultiOp {
     /// is equal to numRequests.
     uint32_t numDispatched;
 
-    /// An array holding the constituent RPCs that we are managing.
+    /// Most objects that will be packed into one RPC, however small they
+    /// are. One of the biggest performance benefits comes from issuing
+    /// multiple RPCs that can be pipelined, so the first RPCs of an
+    /// operation hold only a few objects (INITIAL_OBJECTS_PER_RPC) so that
+    /// pipelining kicks in early; after that, the number of objects per
+    /// RPC is chosen so that RPCs carry about TARGET_RPC_BYTES (see
+    /// adjustObjectsPerRpc).
+#ifdef TESTING
+    static const uint32_t MAX_OBJECTS_PER_RPC = 3;
+    static const uint32_t INITIAL_OBJECTS_PER_RPC = 3;
+    static const uint32_t TARGET_RPC_BYTES = 4096;
+#else
+    static const uint32_t MAX_OBJECTS_PER_RPC = 1000;
+    static const uint32_t INITIAL_OBJECTS_PER_RPC = 20;
+    static const uint32_t TARGET_RPC_BYTES = 64 * 1024;
+#endif
+
+    /// Number of objects to put in each RPC; starts at
+    /// INITIAL_OBJECTS_PER_RPC and is adjusted as RPCs finish.
+    uint32_t objectsPerRpc;
+
+    /// An array holding the constituent RPCs that we are managing, and
+    /// the most of them that may be underway to any one server (see
+    /// SessionWindow).
 #ifdef TESTING
     static const uint32_t MAX_RPCS = 2;
+    static const uint32_t MAX_RPCS_PER_SESSION = 2;
 #else
-    static const uint32_t MAX_RPCS = 10;
+    static const uint32_t MAX_RPCS = 16;
+    static const uint32_t MAX_RPCS_PER_SESSION = 8;
 #endif
     Tub<PartRpc> rpcs[MAX_RPCS];
 
@@ -188,11 +232,27 @@ class MultiOp {
                                HashSessionRef> SessionQueues;
     SessionQueues sessionQueues;
 
+    /// Flow control state for each server that RPCs have been sent to.
+    /// Entries are never removed, so PartRpcs can refer to them.
+    typedef std::unordered_map<Transport::SessionRef, SessionWindow,
+                               HashSessionRef> SessionWindows;
+    SessionWindows sessionWindows;
+
     /// Used for tests only. True = ignores buffer size checking in finishRpc.
     /// Needed since test responses don't put anything in the response buffer.
     bool test_ignoreBufferOverflow;
 
     // TOOD(syang0) These should be abstracted into sub class.
+    /**
+     * Append anything that must precede the parts in each RPC (such as
+     * MultiRead's filter).
+     *
+     * \param buf
+     *      Request buffer, which holds just the request header.
+     * \return
+     *      Number of bytes appended; stored in Request::filterBytes.
+     */
+    virtual uint32_t appendFilter(Buffer* buf) { return 0; }
     virtual void appendRequest(MultiOpObject* request, Buffer* buf)=0;
     virtual bool readResponse(MultiOpObject* request, Buffer* response,
                                  uint32_t* respOffset)=0;
@@ -162,7 +162,8 @@ class MultiOpTest : public ::testing::Test {
         MultiOpTester(RamCloud* rc,
                       MultiOpObject* const requests[],
                       uint32_t numRequests,
-                      uint32_t appendSize = 0)
+                      uint32_t appendSize = 0,
+                      bool start = true)
               : MultiOp(rc, type, requests, numRequests)
               , appendSize(appendSize)
               , appendCalls(0)
@@ -171,7 +172,8 @@ class MultiOpTest : public ::testing::Test {
               , returnStatuses()
         {
             test_ignoreBufferOverflow = true;
-            startRpcs();
+            if (start)
+                startRpcs();
         }
 
         void appendRequest(MultiOpObject* request,
@@ -228,6 +230,46 @@ TEST_F(MultiOpTest, basics) {
     }
 }
 
+TEST_F(MultiOpTest, adjustWindow) {
+    uint64_t us = Cycles::fromMicroseconds(1);
+    MultiOp::SessionWindow window;
+    EXPECT_EQ(2U, window.limit);
+    MultiOp::adjustWindow(&window, 100 * us);
+    EXPECT_EQ(100 * us, window.minLatency);
+    EXPECT_EQ(2U, window.limit);
+
+    // Much slower than usual: the server is queueing requests.
+    MultiOp::adjustWindow(&window, 300 * us);
+    EXPECT_EQ(1U, window.limit);
+    MultiOp::adjustWindow(&window, 300 * us);
+    EXPECT_EQ(1U, window.limit);
+    MultiOp::adjustWindow(&window, 150 * us);
+    EXPECT_EQ(2U, window.limit);
+    EXPECT_EQ(100 * us, window.minLatency);
+
+    // The difference is too small to matter.
+    MultiOp::SessionWindow window2;
+    MultiOp::adjustWindow(&window2, 5 * us);
+    MultiOp::adjustWindow(&window2, 15 * us);
+    EXPECT_EQ(2U, window2.limit);
+}
+
+TEST_F(MultiOpTest, adjustObjectsPerRpc) {
+    MultiOpTester request(ramcloud.get(), NULL, 0);
+    EXPECT_EQ(3U, request.objectsPerRpc);
+
+    request.adjustObjectsPerRpc(3 * 2048, 3);
+    EXPECT_EQ(2U, request.objectsPerRpc);
+    request.adjustObjectsPerRpc(100000, 1);
+    EXPECT_EQ(1U, request.objectsPerRpc);
+    request.adjustObjectsPerRpc(100000, 0);
+    EXPECT_EQ(1U, request.objectsPerRpc);
+
+    // Small objects: limited by MAX_OBJECTS_PER_RPC.
+    request.adjustObjectsPerRpc(30, 3);
+    EXPECT_EQ(3U, request.objectsPerRpc);
+}
+
 TEST_F(MultiOpTest, cancel) {
     MultiOpObject* requests[] = {&objects[0], &objects[1], &objects[2],
         &objects[4]};
@@ -359,6 +401,30 @@ TEST_F(MultiOpTest, startRpcs_overflowSessionQueue) {
     EXPECT_TRUE(request2.isReady());
 }
 
+TEST_F(MultiOpTest, flushSessionQueue_windowFull) {
+    MultiOpObject* requests[] = {&objects[6], &objects[7], &objects[8],
+                                 &objects[9]};
+    MultiOpTester request(ramcloud.get(), requests, 4, 0, false);
+    Transport::SessionRef session =
+            ramcloud->clientContext->transportManager->getSession(
+            "mock:host=master3");
+    request.findWindow(session)->limit = 1;
+    session3->dontNotify = true;
+
+    EXPECT_FALSE(request.startRpcs());
+    EXPECT_EQ("mock:host=master3(3) -", rpcStatus(request));
+    EXPECT_EQ(1U, request.findWindow(session)->outstanding);
+    EXPECT_EQ(1UL, request.sessionQueues.size());
+
+    // The last object is sent once the first RPC returns.
+    session3->lastNotifier->completed();
+    EXPECT_FALSE(request.isReady());
+    EXPECT_EQ("mock:host=master3(1) -", rpcStatus(request));
+    session3->lastNotifier->completed();
+    EXPECT_TRUE(request.isReady());
+    EXPECT_EQ(0U, request.findWindow(session)->outstanding);
+}
+
 TEST_F(MultiOpTest, flushSessionQueue_requestTooLarge) {
     MultiOpObject* requests[] = {&objects[0]};
 
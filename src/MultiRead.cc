@@ -34,13 +34,20 @@ static RejectRules defaultRejectRules;
  *      where to put the value.
  * \param numRequests
  *      Number of elements in \c requests.
+ * \param filter
+ *      If non-NULL, the masters return only the objects that match this
+ *      filter, with just the part of their values that it selects; the
+ *      others are reported as STATUS_OBJECT_DOESNT_EXIST. The filter must
+ *      remain valid until the operation completes.
  */
 MultiRead::MultiRead(RamCloud* ramcloud,
                      MultiReadObject* const requests[],
-                     uint32_t numRequests)
+                     uint32_t numRequests,
+                     const ObjectFilter* filter)
         : MultiOp(ramcloud, type,
                   reinterpret_cast<MultiOpObject* const *>(requests),
                   numRequests)
+        , filter(filter)
 {
     for (uint32_t i = 0; i < numRequests; i++) {
         requests[i]->value->destroy();
@@ -48,6 +55,21 @@ MultiRead::MultiRead(RamCloud* ramcloud,
 
     startRpcs();
 }
+/**
+ * Append the filter, if any, to the request for each RPC.
+ *
+ * \param buf
+ *      Buffer to append to
+ *
+ * \return
+ *      Number of bytes appended.
+ */
+uint32_t
+MultiRead::appendFilter(Buffer* buf)
+{
+    return (filter != NULL) ? filter->serialize(buf) : 0;
+}
+
 /**
  * Append a given MultiReadObject to a buffer.
  *
@@ -17,6 +17,7 @@
 #define RAMCLOUD_MULTIREAD_H
 
 #include "MultiOp.h"
+#include "ObjectFilter.h"
 
 namespace RAMCloud {
 
@@ -34,13 +35,20 @@ class MultiRead : public MultiOp {
   PUBLIC:
     MultiRead(RamCloud* ramcloud,
               MultiReadObject* const requests[],
-              uint32_t numRequests);
+              uint32_t numRequests,
+              const ObjectFilter* filter = NULL);
 
   PROTECTED:
+    uint32_t appendFilter(Buffer* buf);
     void appendRequest(MultiOpObject* request, Buffer* buf);
     bool readResponse(MultiOpObject* request, Buffer* response,
                       uint32_t* respOffset);
 
+    /// If non-NULL, only objects matching this filter are returned (the
+    /// others are reported as STATUS_OBJECT_DOESNT_EXIST), with just the
+    /// part of their values that it selects.
+    const ObjectFilter* filter;
+
     DISALLOW_COPY_AND_ASSIGN(MultiRead);
 };
 
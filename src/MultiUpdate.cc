@@ -0,0 +1,126 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "MultiUpdate.h"
+#include "Object.h"
+#include "ShortMacros.h"
+
+namespace RAMCloud {
+
+// Default RejectRules to use if none are provided by the caller: rejects
+// nothing.
+static RejectRules defaultRejectRules;
+
+/**
+ * Constructor for MultiUpdate objects: initiates one or more RPCs for a
+ * multiUpdate operation, but returns once the RPCs have been initiated,
+ * without waiting for any of them to complete.
+ *
+ * \param ramcloud
+ *      The RAMCloud object that governs this operation.
+ * \param requests
+ *      Each element in this array describes one object to be updated.
+ * \param numRequests
+ *      Number of elements in \c requests.
+ */
+MultiUpdate::MultiUpdate(RamCloud* ramcloud,
+                         MultiUpdateObject* const requests[],
+                         uint32_t numRequests)
+    : MultiOp(ramcloud, type,
+                  reinterpret_cast<MultiOpObject* const *>(requests),
+                  numRequests)
+{
+    startRpcs();
+}
+
+/**
+ * Append a given MultiUpdateObject to a buffer.
+ *
+ * It is the responsibility of the caller to ensure that the
+ * MultiOpObject passed in is actually a MultiUpdateObject.
+ *
+ * \param request
+ *      MultiUpdateObject request to append
+ * \param buf
+ *      Buffer to append to
+ */
+void
+MultiUpdate::appendRequest(MultiOpObject* request, Buffer* buf)
+{
+    MultiUpdateObject* req =
+        reinterpret_cast<MultiUpdateObject*>(request);
+
+    // Add the current object to the list of those being
+    // updated by this RPC.
+    buf->emplaceAppend<WireFormat::MultiOp::Request::UpdatePart>(
+            req->tableId,
+            req->keyLength,
+            req->append,
+            req->offset,
+            req->length,
+            req->rejectRules ? *req->rejectRules :
+                               defaultRejectRules);
+
+    buf->appendCopy(req->key, req->keyLength);
+    if (!req->append)
+        buf->appendCopy(req->expected, req->length);
+    buf->appendCopy(req->data, req->length);
+}
+
+/**
+ * Read the MultiUpdate response in the buffer given an offset
+ * and put the response into a MultiUpdateObject. This modifies
+ * the offset as necessary and checks for missing data.
+ *
+ * It is the responsibility of the caller to ensure that the
+ * MultiOpObject passed in is actually a MultiUpdateObject.
+ *
+ * \param request
+ *      MultiUpdateObject where the interpreted response goes
+ * \param buf
+ *      Buffer to read the response from
+ * \param respOffset
+ *      Offset into the buffer for the current position
+ *              which will be modified as this method reads.
+ *
+ * \return
+ *      true if there is missing data
+ */
+bool
+MultiUpdate::readResponse(MultiOpObject* request,
+                          Buffer* buf,
+                          uint32_t* respOffset)
+{
+    MultiUpdateObject* req =
+        reinterpret_cast<MultiUpdateObject*>(request);
+
+    const WireFormat::MultiOp::Response::UpdatePart* part =
+        buf->getOffset<
+            WireFormat::MultiOp::Response::UpdatePart>(*respOffset);
+    if (part == NULL) {
+        TEST_LOG("missing Response::Part");
+        return true;
+    }
+    *respOffset += sizeof32(*part);
+
+    req->status = part->status;
+    req->version = part->version;
+    req->updated = part->updated != 0;
+    req->newLength = part->newLength;
+
+    return false;
+}
+
+} // end RAMCloud
@@ -0,0 +1,140 @@
+/* Copyright (c) 2011-2014 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "MockCluster.h"
+#include "MultiUpdate.h"
+#include "ShortMacros.h"
+#include "RamCloud.h"
+
+namespace RAMCloud {
+
+class MultiUpdateTest : public ::testing::Test {
+  public:
+    TestLog::Enable logEnabler;
+    Context context;
+    MockCluster cluster;
+    Tub<RamCloud> ramcloud;
+    uint64_t tableId1;
+    uint64_t tableId2;
+    Tub<MultiUpdateObject> objects[4];
+
+  public:
+    MultiUpdateTest()
+        : logEnabler()
+        , context()
+        , cluster(&context)
+        , ramcloud()
+        , tableId1(-1)
+        , tableId2(-2)
+        , objects()
+    {
+        Logger::get().setLogLevels(RAMCloud::SILENT_LOG_LEVEL);
+
+        ServerConfig config = ServerConfig::forTesting();
+        config.services = {WireFormat::MASTER_SERVICE,
+                           WireFormat::PING_SERVICE};
+        config.localLocator = "mock:host=master1";
+        config.maxObjectKeySize = 512;
+        config.maxObjectDataSize = 1024;
+        config.segmentSize = 128*1024;
+        config.segletSize = 128*1024;
+        cluster.addServer(config);
+        config.localLocator = "mock:host=master2";
+        cluster.addServer(config);
+        ramcloud.construct(&context, "mock:host=coordinator");
+
+        tableId1 = ramcloud->createTable("table1");
+        tableId2 = ramcloud->createTable("table2");
+        ramcloud->write(tableId1, "object1-1", 9, "abcdef", 6);
+        ramcloud->write(tableId2, "object2-1", 9, "abcdef", 6);
+
+        // Create some object descriptors for use in requests.
+        uint16_t keyLen9 = 9;
+        objects[0].construct(tableId1, "object1-1", keyLen9, "gh", 2);
+        objects[1].construct(tableId1, "object1-2", keyLen9, "new", 3);
+        objects[2].construct(tableId2, "object2-1", keyLen9, 2, "cd", "CD",
+                             2);
+        objects[3].construct(tableId2, "object2-1", keyLen9, 2, "xy", "XY",
+                             2);
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(MultiUpdateTest);
+};
+
+TEST_F(MultiUpdateTest, basics_end_to_end) {
+    MultiUpdateObject* requests[] = {
+        objects[0].get(), objects[1].get(), objects[2].get(),
+        objects[3].get()
+    };
+    ramcloud->multiUpdate(requests, 4);
+
+    EXPECT_EQ(STATUS_OK, objects[0]->status);
+    EXPECT_TRUE(objects[0]->updated);
+    EXPECT_EQ(8U, objects[0]->newLength);
+    EXPECT_EQ(2U, objects[0]->version);
+    EXPECT_EQ(STATUS_OK, objects[1]->status);
+    EXPECT_TRUE(objects[1]->updated);
+    EXPECT_EQ(3U, objects[1]->newLength);
+    EXPECT_EQ(STATUS_OK, objects[2]->status);
+    EXPECT_TRUE(objects[2]->updated);
+
+    // The bytes no longer match after the update before it.
+    EXPECT_EQ(STATUS_OK, objects[3]->status);
+    EXPECT_FALSE(objects[3]->updated);
+    EXPECT_EQ(objects[2]->version, objects[3]->version);
+
+    ObjectBuffer value;
+    ramcloud->readKeysAndValue(tableId1, "object1-1", 9, &value);
+    EXPECT_EQ("abcdefgh", string(value.get<char>(), 8));
+    ramcloud->readKeysAndValue(tableId2, "object2-1", 9, &value);
+    EXPECT_EQ("abCDef", string(value.get<char>(), 6));
+}
+
+TEST_F(MultiUpdateTest, appendRequest) {
+    MultiUpdateObject* requests[] = {objects[0].get(), objects[2].get()};
+    Buffer buf;
+
+    // Create a non-operating multi update.
+    MultiUpdate request(ramcloud.get(), requests, 0);
+    request.wait();
+
+    request.appendRequest(requests[0], &buf);
+    EXPECT_EQ(sizeof32(WireFormat::MultiOp::Request::UpdatePart) + 9 + 2,
+              buf.size());
+    buf.reset();
+    request.appendRequest(requests[1], &buf);
+    EXPECT_EQ(sizeof32(WireFormat::MultiOp::Request::UpdatePart) + 9 + 4,
+              buf.size());
+}
+
+TEST_F(MultiUpdateTest, readResponse_shortResponse) {
+    TestLog::Enable _;
+    MultiUpdateObject* requests[] = {objects[0].get()};
+    MultiUpdate request(ramcloud.get(), requests, 0);
+    request.wait();
+
+    Buffer buf;
+    buf.emplaceAppend<WireFormat::MultiOp::Response::UpdatePart>();
+    uint32_t offset = 1;
+    EXPECT_TRUE(request.readResponse(requests[0], &buf, &offset));
+    EXPECT_EQ("readResponse: missing Response::Part", TestLog::get());
+
+    offset = 0;
+    EXPECT_FALSE(request.readResponse(requests[0], &buf, &offset));
+    EXPECT_EQ(buf.size(), offset);
+}
+
+}  // namespace RAMCloud
@@ -35,8 +35,8 @@ namespace NetUtil {
 // in EthernetHeader field `etherType'.
 enum EthPayloadType {
     IP_V4 = 0x0800, // Standard ethernet type when the payload is an ip packet.
-#ifdef DPDK
-    FAST  = 0x88b5  // FAST+DPDK
+#if defined(DPDK) || defined(XDP)
+    FAST  = 0x88b5  // FAST+DPDK, BASIC+XDP
 #endif
 };
 
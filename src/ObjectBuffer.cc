@@ -32,22 +32,31 @@ ObjectBuffer::getNumKeys()
 
 /**
  * Returns a pointer to one of the keys for the current object. The key will be
- * contiguous in memory.
+ * contiguous in memory; it is only copied if it spans chunks of the buffer.
  *
  * \param[in] keyIndex
  *      Identifies the desired key (o means first key)
+ * \param[out] keyLength
+ *      If non-NULL, the length of the key is returned here (unless there is
+ *      no such key).
  * \return
  *      Pointer to a key or NULL if there is no key at
  *      the given index position
  */
 const void*
-ObjectBuffer::getKey(KeyIndex keyIndex)
+ObjectBuffer::getKey(KeyIndex keyIndex, KeyLength *keyLength)
 {
-    // create a dummy object just so that we can invoke methods from
-    // the object class rather than redoing it in this class.
-    if (!object)
-        object.construct(1, 0, 0, *this);
-    return object.get()->getKey(keyIndex);
+    if (!parseKeyOffsets() || keyIndex >= keyOffsets->numKeys)
+        return NULL;
+
+    const CumulativeKeyLength *cumLengths = keyOffsets->cumulativeLengths;
+    uint32_t start = (keyIndex == 0) ? 0 : cumLengths[keyIndex - 1];
+    uint32_t length = cumLengths[keyIndex] - start;
+    if (length == 0)
+        return NULL;
+    if (keyLength)
+        *keyLength = downCast<KeyLength>(length);
+    return getRange(KEY_INFO_LENGTH(keyOffsets->numKeys) + start, length);
 }
 
 /**
@@ -61,16 +70,21 @@ ObjectBuffer::getKey(KeyIndex keyIndex)
 KeyLength
 ObjectBuffer::getKeyLength(KeyIndex keyIndex)
 {
-    if (!object)
-        object.construct(1, 0, 0, *this);
-    return object.get()->getKeyLength(keyIndex);
+    if (!parseKeyOffsets() || keyIndex >= keyOffsets->numKeys)
+        return 0;
+
+    const CumulativeKeyLength *cumLengths = keyOffsets->cumulativeLengths;
+    if (keyIndex == 0)
+        return cumLengths[0];
+    return static_cast<KeyLength>(cumLengths[keyIndex] -
+               cumLengths[keyIndex - 1]);
 }
 
 /**
  * Obtain a pointer to a contiguous copy of the object's value. Note
  * that if the value is not already contiguous, it will be copied.
  * NOTE: if the value of the object is large, this function will
- * be expensive as it may involve copying the data.
+ * be expensive as it may involve copying the data; see peekValue().
 
  * \param[out] valueLength
  *      The length of the data blob in this object buffer
@@ -80,9 +94,26 @@ ObjectBuffer::getKeyLength(KeyIndex keyIndex)
 const void *
 ObjectBuffer::getValue(uint32_t *valueLength)
 {
-    if (!object)
-        object.construct(1, 0, 0, *this);
-    return object.get()->getValue(valueLength);
+    if (!parseKeyOffsets())
+        return NULL;
+    uint32_t length = size() - valueOffset;
+    if (valueLength)
+        *valueLength = length;
+    return getRange(valueOffset, length);
+}
+
+/**
+ * Obtain the length of the object's value.
+ *
+ * \return
+ *      The length of the value, or 0 if the buffer is malformed.
+ */
+uint32_t
+ObjectBuffer::getValueLength()
+{
+    if (!parseKeyOffsets())
+        return 0;
+    return size() - valueOffset;
 }
 
 /**
@@ -94,9 +125,36 @@ ObjectBuffer::getValue(uint32_t *valueLength)
 bool
 ObjectBuffer::getValueOffset(uint32_t *offset)
 {
-    if (!object)
-        object.construct(1, 0, 0, *this);
-    return object.get()->getValueOffset(offset);
+    if (!parseKeyOffsets())
+        return false;
+    *offset = valueOffset;
+    return true;
+}
+
+/**
+ * Look at the start of the object's value where it lies in the buffer,
+ * without copying anything. This is the cheap alternative to getValue()
+ * for callers that can consume the value a piece at a time: if the value
+ * spans several chunks, only the part in the first one is returned, and
+ * the rest can be reached with Buffer::Iterator or Buffer::peek starting
+ * at getValueOffset().
+ *
+ * \param[out] value
+ *      Set to point to the first byte of the value, or NULL if the value
+ *      is empty or the buffer is malformed.
+ * \return
+ *      The number of contiguous bytes of value at *value.
+ */
+uint32_t
+ObjectBuffer::peekValue(const void **value)
+{
+    *value = NULL;
+    if (!parseKeyOffsets() || valueOffset == size())
+        return 0;
+    void* data;
+    uint32_t length = peek(valueOffset, &data);
+    *value = data;
+    return length;
 }
 
 /**
@@ -132,6 +190,41 @@ void
 ObjectBuffer::reset()
 {
     object.destroy();
+    keyOffsets = NULL;
+    valueOffset = 0;
     Buffer::reset();
 }
+
+/**
+ * Locate the number of keys and their cumulative lengths at the start of
+ * the buffer (copying them if they span chunks), and compute where the value
+ * begins. This is a no-op after the first successful call; the keys
+ * themselves aren't looked at.
+ *
+ * \return
+ *      False if the buffer is too small to hold the key information it
+ *      describes, True otherwise.
+ */
+bool
+ObjectBuffer::parseKeyOffsets()
+{
+    if (keyOffsets != NULL)
+        return true;
+    if (size() < sizeof32(KeyCount))
+        return false;
+
+    KeyCount numKeys = *getOffset<KeyCount>(0);
+    uint32_t offset = KEY_INFO_LENGTH(numKeys);
+    const KeyOffsets *offsets =
+            static_cast<const KeyOffsets*>(getRange(0, offset));
+    if (offsets == NULL)
+        return false;
+    if (numKeys > 0)
+        offset += offsets->cumulativeLengths[numKeys - 1];
+    if (offset > size())
+        return false;
+    keyOffsets = offsets;
+    valueOffset = offset;
+    return true;
+}
 } // namespace
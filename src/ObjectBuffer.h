@@ -28,12 +28,20 @@ namespace RAMCloud {
  * All of the methods in this class assume that the first bytes in the buffer
  * contain the keys and value for an object in the standard representation
  * used throughout RAMCloud.
+ *
+ * Nothing is parsed until it is needed: the key count and key lengths are
+ * located on the first call to a key or value accessor, and no individual
+ * key is touched unless it is asked for. Callers that only want the value
+ * (the common case for multiRead) can use peekValue() to look at it in
+ * place, without copying it even if it spans several chunks.
  */
 
 class ObjectBuffer : public Buffer {
   PUBLIC:
     ObjectBuffer()
     : object()
+    , keyOffsets(NULL)
+    , valueOffset(0)
     {
     }
 
@@ -43,15 +51,16 @@ class ObjectBuffer : public Buffer {
     }
 
     KeyCount getNumKeys();
-    const void *getKey(KeyIndex keyIndex = 0);
+    const void *getKey(KeyIndex keyIndex = 0, KeyLength *keyLength = NULL);
     KeyLength getKeyLength(KeyIndex keyIndex = 0);
     const void *getValue(uint32_t *dataLength = NULL);
+    uint32_t getValueLength();
     uint64_t getVersion();
     Object *getObject();
 
     /**
      * Convenience for getValue.
-     * \return
+     * eturn
      *      An appropriately casted pointer to the object's value
      */
     template<typename T> const T* get(uint32_t *dataLength = NULL) {
@@ -59,11 +68,25 @@ class ObjectBuffer : public Buffer {
     }
 
     bool getValueOffset(uint32_t *offset);
+    uint32_t peekValue(const void **value);
     void reset();
 
   PRIVATE:
+    bool parseKeyOffsets();
+
+    /// Object view of the buffer, used for the version and by callers that
+    /// want a full Object. Constructed on the first call to getVersion() or
+    /// getObject(); the other accessors don't need it.
     Tub<Object> object;
 
+    /// The number of keys and their cumulative lengths, in contiguous
+    /// memory owned by this buffer. NULL until parseKeyOffsets() has run.
+    const KeyOffsets *keyOffsets;
+
+    /// Offset of the object's value in this buffer. Only valid if
+    /// keyOffsets isn't NULL.
+    uint32_t valueOffset;
+
     DISALLOW_COPY_AND_ASSIGN(ObjectBuffer);
 };
 
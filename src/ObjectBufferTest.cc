@@ -86,6 +86,17 @@ TEST_F(ObjectBufferTest, getKey)
     EXPECT_EQ("ho", string(reinterpret_cast<const char*>(
                     buffer.getKey(2))));
     EXPECT_STREQ(NULL, (const char *)buffer.getKey(3));
+
+    // None of this needed an Object.
+    EXPECT_FALSE(buffer.object);
+}
+
+TEST_F(ObjectBufferTest, getKey_length)
+{
+    KeyLength keyLength = 0;
+    EXPECT_EQ("hi", string(reinterpret_cast<const char*>(
+                    buffer.getKey(1, &keyLength))));
+    EXPECT_EQ(3U, keyLength);
 }
 
 TEST_F(ObjectBufferTest, getKeyLength)
@@ -104,6 +115,26 @@ TEST_F(ObjectBufferTest, getValue)
     EXPECT_EQ(4U, dataLen);
 }
 
+TEST_F(ObjectBufferTest, getValue_malformed)
+{
+    ObjectBuffer shortBuffer;
+    uint32_t dataLen = 99;
+    EXPECT_TRUE(shortBuffer.getValue(&dataLen) == NULL);
+    EXPECT_EQ(99U, dataLen);
+
+    // The key lengths say there's more data than the buffer holds.
+    shortBuffer.appendExternal(&numKeys, sizeof(numKeys));
+    shortBuffer.appendExternal(cumulativeKeyLengths, 3 *sizeof(KeyLength));
+    EXPECT_TRUE(shortBuffer.getValue(&dataLen) == NULL);
+    EXPECT_EQ(0U, shortBuffer.getValueLength());
+    EXPECT_STREQ(NULL, (const char *)shortBuffer.getKey(0));
+}
+
+TEST_F(ObjectBufferTest, getValueLength)
+{
+    EXPECT_EQ(4U, buffer.getValueLength());
+}
+
 TEST_F(ObjectBufferTest, getValueOffset)
 {
     uint32_t valueOffset;
@@ -111,6 +142,21 @@ TEST_F(ObjectBufferTest, getValueOffset)
     EXPECT_EQ(16U, valueOffset);
 }
 
+TEST_F(ObjectBufferTest, peekValue)
+{
+    // The value spans two chunks; only the first is returned, in place.
+    const void* value;
+    EXPECT_EQ(2U, buffer.peekValue(&value));
+    EXPECT_EQ(&dataBlob[0], value);
+
+    ObjectBuffer noValue;
+    noValue.appendExternal(&numKeys, sizeof(numKeys));
+    noValue.appendExternal(cumulativeKeyLengths, 3 *sizeof(KeyLength));
+    noValue.appendExternal(stringKeys, sizeof(stringKeys));
+    EXPECT_EQ(0U, noValue.peekValue(&value));
+    EXPECT_TRUE(value == NULL);
+}
+
 TEST_F(ObjectBufferTest, getVersion) {
     // These two implicitly construct the object
     EXPECT_EQ(0U, buffer.getVersion());
@@ -131,7 +177,10 @@ TEST_F(ObjectBufferTest, getObject) {
 
 TEST_F(ObjectBufferTest, reset)
 {
+    buffer.getObject();
+    buffer.getValue();
     buffer.reset();
     EXPECT_FALSE((buffer.object));
+    EXPECT_TRUE(buffer.keyOffsets == NULL);
 }
 } // namespace
@@ -0,0 +1,194 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <algorithm>
+
+#include "ObjectFilter.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct an ObjectFilter that matches every object and returns the
+ * whole value; use #setProjection to return less.
+ */
+ObjectFilter::ObjectFilter()
+    : op(ALL)
+    , field(0)
+    , offset(0)
+    , operand()
+    , projectionOffset(0)
+    , projectionLength(~0U)
+{
+}
+
+/**
+ * Construct an ObjectFilter that matches objects whose field bytes compare
+ * with an operand in a given way.
+ *
+ * \param op
+ *      How the bytes are compared; for example, LESS means the object
+ *      matches if its bytes sort before the operand.
+ * \param field
+ *      Index of the key whose bytes are compared (0 for the primary key),
+ *      or VALUE to compare bytes of the object's value.
+ * \param offset
+ *      Offset within the key or value of the first byte to compare.
+ * \param operand
+ *      The bytes to compare with; operandLength bytes of the field are
+ *      compared. Copied, so it needn't outlive this call.
+ * \param operandLength
+ *      Length of operand, in bytes.
+ */
+ObjectFilter::ObjectFilter(Op op, uint8_t field, uint32_t offset,
+        const void* operand, uint16_t operandLength)
+    : op(op)
+    , field(field)
+    , offset(offset)
+    , operand(static_cast<const char*>(operand), operandLength)
+    , projectionOffset(0)
+    , projectionLength(~0U)
+{
+}
+
+/**
+ * Fill in this filter from its serialized form, as generated by
+ * #serialize.
+ *
+ * \param buffer
+ *      Buffer containing the serialized filter.
+ * \param offset
+ *      Offset within buffer of the serialized filter.
+ * \param length
+ *      Length of the serialized filter, in bytes.
+ * \return
+ *      False if the filter is malformed, in which case this filter is
+ *      left unchanged.
+ */
+bool
+ObjectFilter::deserialize(Buffer* buffer, uint32_t offset, uint32_t length)
+{
+    const Header* header = buffer->getOffset<Header>(offset);
+    if (header == NULL || length != sizeof32(Header) + header->operandLength
+            || header->op > GREATER_EQUAL)
+        return false;
+    const void* bytes = buffer->getRange(offset + sizeof32(Header),
+            header->operandLength);
+    if (bytes == NULL && header->operandLength > 0)
+        return false;
+
+    op = static_cast<Op>(header->op);
+    field = header->field;
+    this->offset = header->offset;
+    operand.assign(static_cast<const char*>(bytes), header->operandLength);
+    projectionOffset = header->projectionOffset;
+    projectionLength = header->projectionLength;
+    return true;
+}
+
+/**
+ * Decide whether an object satisfies this filter's condition.
+ *
+ * \param object
+ *      Object to check.
+ * \return
+ *      True if the object should be returned.
+ */
+bool
+ObjectFilter::matches(Object* object) const
+{
+    if (op == ALL)
+        return true;
+
+    const void* bytes;
+    uint32_t length = 0;
+    if (field == VALUE) {
+        bytes = object->getValue(&length);
+    } else {
+        KeyLength keyLength = 0;
+        bytes = object->getKey(field, &keyLength);
+        length = keyLength;
+    }
+    if (bytes == NULL || offset > length ||
+            length - offset < operand.size())
+        return false;
+
+    int result = memcmp(static_cast<const char*>(bytes) + offset,
+            operand.data(), operand.size());
+    switch (op) {
+        case EQUAL:         return result == 0;
+        case NOT_EQUAL:     return result != 0;
+        case LESS:          return result < 0;
+        case LESS_EQUAL:    return result <= 0;
+        case GREATER:       return result > 0;
+        case GREATER_EQUAL: return result >= 0;
+        default:            return true;
+    }
+}
+
+/**
+ * Find the part of an object's value that should be returned.
+ *
+ * \param valueLength
+ *      Length of the object's value, in bytes.
+ * \param[out] offset
+ *      Set to the offset within the value of the part to return.
+ * \return
+ *      The length of the part of the value to return (possibly 0).
+ */
+uint32_t
+ObjectFilter::project(uint32_t valueLength, uint32_t* offset) const
+{
+    *offset = std::min(projectionOffset, valueLength);
+    return std::min(projectionLength, valueLength - *offset);
+}
+
+/**
+ * Return only part of each object's value, rather than all of it.
+ *
+ * \param offset
+ *      Offset within the value of the first byte to return.
+ * \param length
+ *      Number of bytes to return; values that are too short return fewer.
+ */
+void
+ObjectFilter::setProjection(uint32_t offset, uint32_t length)
+{
+    projectionOffset = offset;
+    projectionLength = length;
+}
+
+/**
+ * Append the serialized form of this filter to a buffer, for use in an RPC.
+ *
+ * \param buffer
+ *      Buffer to append to (the filter is copied).
+ * \return
+ *      The number of bytes appended.
+ */
+uint32_t
+ObjectFilter::serialize(Buffer* buffer) const
+{
+    Header* header = buffer->emplaceAppend<Header>();
+    header->op = downCast<uint8_t>(op);
+    header->field = field;
+    header->offset = offset;
+    header->operandLength = downCast<uint16_t>(operand.size());
+    header->projectionOffset = projectionOffset;
+    header->projectionLength = projectionLength;
+    buffer->appendCopy(operand.data(), downCast<uint32_t>(operand.size()));
+    return sizeof32(Header) + downCast<uint32_t>(operand.size());
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,95 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_OBJECTFILTER_H
+#define RAMCLOUD_OBJECTFILTER_H
+
+#include "Common.h"
+#include "Buffer.h"
+#include "Object.h"
+
+namespace RAMCloud {
+
+/**
+ * A condition on objects and a part of their values, which a client can
+ * attach to table enumerations and multiReads so that masters only return
+ * the objects it wants, and only the part of each value it needs.
+ *
+ * The condition compares the bytes at a given offset in one of the
+ * object's keys, or in its value, with an operand (lexicographically, as
+ * with memcmp); an object whose field is too short to hold the operand at
+ * that offset doesn't match. The projection is a byte range of the value;
+ * objects are returned with their keys intact but with just this part of
+ * their value.
+ */
+class ObjectFilter {
+  public:
+    /// How the bytes of an object are compared with the operand.
+    enum Op {
+        ALL = 0,            // Every object matches (no condition).
+        EQUAL,
+        NOT_EQUAL,
+        LESS,
+        LESS_EQUAL,
+        GREATER,
+        GREATER_EQUAL
+    };
+
+    /// Value for the \a field argument to #ObjectFilter that refers to the
+    /// object's value rather than one of its keys.
+    enum { VALUE = 255 };
+
+    /// The serialized form of an ObjectFilter in an RPC; the operand follows.
+    struct Header {
+        uint8_t op;
+        uint8_t field;
+        uint32_t offset;
+        uint16_t operandLength;
+        uint32_t projectionOffset;
+        uint32_t projectionLength;
+    } __attribute__((packed));
+
+    ObjectFilter();
+    ObjectFilter(Op op, uint8_t field, uint32_t offset,
+            const void* operand, uint16_t operandLength);
+
+    bool deserialize(Buffer* buffer, uint32_t offset, uint32_t length);
+    bool matches(Object* object) const;
+    uint32_t project(uint32_t valueLength, uint32_t* offset) const;
+    void setProjection(uint32_t offset, uint32_t length);
+    uint32_t serialize(Buffer* buffer) const;
+
+  PRIVATE:
+    /// Comparison to make; see Op.
+    Op op;
+
+    /// Index of the key to compare, or VALUE.
+    uint8_t field;
+
+    /// Offset within the key or value of the bytes to compare.
+    uint32_t offset;
+
+    /// Bytes to compare with.
+    string operand;
+
+    /// Offset and length of the part of each value to return; by default,
+    /// the whole value.
+    uint32_t projectionOffset;
+    uint32_t projectionLength;
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_OBJECTFILTER_H
@@ -0,0 +1,130 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "ObjectFilter.h"
+
+namespace RAMCloud {
+
+class ObjectFilterTest : public ::testing::Test {
+  public:
+    Buffer buffer;
+    Key key;
+    Object object;
+
+    ObjectFilterTest()
+        : buffer()
+        , key(1, "key1", 4)
+        , object(key, "abcdef", 6, 1, 0, buffer)
+    {
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(ObjectFilterTest);
+};
+
+TEST_F(ObjectFilterTest, matches_all) {
+    ObjectFilter filter;
+    EXPECT_TRUE(filter.matches(&object));
+}
+
+TEST_F(ObjectFilterTest, matches_value) {
+    EXPECT_TRUE(ObjectFilter(ObjectFilter::EQUAL, ObjectFilter::VALUE,
+            2, "cd", 2).matches(&object));
+    EXPECT_FALSE(ObjectFilter(ObjectFilter::EQUAL, ObjectFilter::VALUE,
+            2, "ce", 2).matches(&object));
+    EXPECT_TRUE(ObjectFilter(ObjectFilter::NOT_EQUAL, ObjectFilter::VALUE,
+            2, "ce", 2).matches(&object));
+    EXPECT_TRUE(ObjectFilter(ObjectFilter::LESS, ObjectFilter::VALUE,
+            0, "abd", 3).matches(&object));
+    EXPECT_FALSE(ObjectFilter(ObjectFilter::LESS, ObjectFilter::VALUE,
+            0, "abc", 3).matches(&object));
+    EXPECT_TRUE(ObjectFilter(ObjectFilter::LESS_EQUAL, ObjectFilter::VALUE,
+            0, "abc", 3).matches(&object));
+    EXPECT_TRUE(ObjectFilter(ObjectFilter::GREATER, ObjectFilter::VALUE,
+            0, "abb", 3).matches(&object));
+    EXPECT_FALSE(ObjectFilter(ObjectFilter::GREATER, ObjectFilter::VALUE,
+            0, "abc", 3).matches(&object));
+    EXPECT_TRUE(ObjectFilter(ObjectFilter::GREATER_EQUAL, ObjectFilter::VALUE,
+            0, "abc", 3).matches(&object));
+}
+
+TEST_F(ObjectFilterTest, matches_key) {
+    EXPECT_TRUE(ObjectFilter(ObjectFilter::EQUAL, 0, 3, "1", 1)
+            .matches(&object));
+    EXPECT_FALSE(ObjectFilter(ObjectFilter::EQUAL, 0, 3, "2", 1)
+            .matches(&object));
+
+    // There is no secondary key.
+    EXPECT_FALSE(ObjectFilter(ObjectFilter::NOT_EQUAL, 1, 0, "x", 1)
+            .matches(&object));
+}
+
+TEST_F(ObjectFilterTest, matches_fieldTooShort) {
+    EXPECT_TRUE(ObjectFilter(ObjectFilter::EQUAL, ObjectFilter::VALUE,
+            4, "ef", 2).matches(&object));
+    EXPECT_FALSE(ObjectFilter(ObjectFilter::NOT_EQUAL, ObjectFilter::VALUE,
+            5, "ef", 2).matches(&object));
+    EXPECT_FALSE(ObjectFilter(ObjectFilter::NOT_EQUAL, ObjectFilter::VALUE,
+            7, "", 0).matches(&object));
+}
+
+TEST_F(ObjectFilterTest, project) {
+    ObjectFilter filter;
+    uint32_t offset;
+    EXPECT_EQ(6U, filter.project(6, &offset));
+    EXPECT_EQ(0U, offset);
+
+    filter.setProjection(2, 3);
+    EXPECT_EQ(3U, filter.project(6, &offset));
+    EXPECT_EQ(2U, offset);
+    EXPECT_EQ(1U, filter.project(3, &offset));
+    EXPECT_EQ(2U, offset);
+    EXPECT_EQ(0U, filter.project(1, &offset));
+    EXPECT_EQ(1U, offset);
+}
+
+TEST_F(ObjectFilterTest, serializeAndDeserialize) {
+    ObjectFilter filter(ObjectFilter::GREATER, ObjectFilter::VALUE,
+            1, "bc", 2);
+    filter.setProjection(1, 2);
+    Buffer rpc;
+    rpc.appendCopy("xyz", 3);
+    EXPECT_EQ(sizeof32(ObjectFilter::Header) + 2, filter.serialize(&rpc));
+
+    ObjectFilter copy;
+    EXPECT_TRUE(copy.deserialize(&rpc, 3, rpc.size() - 3));
+    EXPECT_EQ(ObjectFilter::GREATER, copy.op);
+    EXPECT_EQ(ObjectFilter::VALUE, copy.field);
+    EXPECT_EQ(1U, copy.offset);
+    EXPECT_EQ("bc", copy.operand);
+    EXPECT_EQ(1U, copy.projectionOffset);
+    EXPECT_EQ(2U, copy.projectionLength);
+}
+
+TEST_F(ObjectFilterTest, deserialize_malformed) {
+    ObjectFilter filter(ObjectFilter::EQUAL, 0, 0, "key1", 4);
+    Buffer rpc;
+    uint32_t length = filter.serialize(&rpc);
+
+    ObjectFilter copy;
+    EXPECT_FALSE(copy.deserialize(&rpc, 0, length - 1));
+    EXPECT_FALSE(copy.deserialize(&rpc, 0, length + 1));
+    EXPECT_FALSE(copy.deserialize(&rpc, 1, length));
+    rpc.getStart<ObjectFilter::Header>()->op = 99;
+    EXPECT_FALSE(copy.deserialize(&rpc, 0, length));
+    EXPECT_EQ(ObjectFilter::ALL, copy.op);
+}
+
+}  // namespace RAMCloud
@@ -14,6 +14,7 @@
  */
 
 #include "Cycles.h"
+#include "FlatTableConfig.h"
 #include "IndexKey.h"
 #include "ObjectFinder.h"
 #include "ShortMacros.h"
@@ -24,7 +25,7 @@ namespace RAMCloud {
 
 /**
  * The implementation of ObjectFinder::TableConfigFetcher that is used for
- * normal execution. Simply invokes CoordinatorClient::getTableConfig
+ * normal execution. Simply invokes the GET_TABLE_CONFIG RPC.
  */
 class RealTableConfigFetcher : public ObjectFinder::TableConfigFetcher {
   public:
@@ -39,80 +40,107 @@ class RealTableConfigFetcher : public ObjectFinder::TableConfigFetcher {
           std::multimap< std::pair<uint64_t, uint8_t>,
                                    ObjectFinder::Indexlet>* tableIndexMap) {
 
-        ProtoBuf::TableConfig tableConfig;
-        CoordinatorClient::getTableConfig(context, tableId, &tableConfig);
+        // The configuration is used in place, straight out of the RPC's
+        // response buffer.
+        GetTableConfigRpc rpc(context, tableId);
+        FlatTableConfig tableConfig;
+        rpc.wait(&tableConfig);
+        addTablets(tableConfig, tableMap);
+
+        for (uint32_t i = 0; i < tableConfig.getIndexCount(); i++) {
+            const FlatTableConfig::IndexRecord* index =
+                    tableConfig.getIndex(i);
+            uint64_t indexId = index->indexId;
+            for (uint32_t j = 0; j < index->indexletCount; j++) {
+                const FlatTableConfig::IndexletRecord* indexlet =
+                        tableConfig.getIndexlet(index->firstIndexlet + j);
+                const char* firstKey = tableConfig.getString(
+                        indexlet->firstKeyOffset, indexlet->firstKeyLength);
+                const char* firstNotOwnedKey = tableConfig.getString(
+                        indexlet->firstNotOwnedKeyOffset,
+                        indexlet->firstNotOwnedKeyLength);
+                ServerId serverId(indexlet->serverId);
+                string serviceLocator(tableConfig.getString(
+                        indexlet->locatorOffset, indexlet->locatorLength),
+                        indexlet->locatorLength);
+                ObjectFinder::Indexlet rawIndexlet(firstKey,
+                        indexlet->firstKeyLength, firstNotOwnedKey,
+                        indexlet->firstNotOwnedKeyLength, serverId,
+                        serviceLocator);
 
-        foreach (const ProtoBuf::TableConfig::Tablet& tablet,
-                 tableConfig.tablet()) {
+                tableIndexMap->insert(std::make_pair(
+                        std::make_pair(tableId, indexId), rawIndexlet));
+            }
+        }
+    }
 
-            uint64_t tableId = tablet.table_id();
-            uint64_t startKeyHash = tablet.start_key_hash();
-            uint64_t endKeyHash = tablet.end_key_hash();
-            ServerId serverId(tablet.server_id());
+    void getTabletConfig(
+          uint64_t tableId, KeyHash keyHash,
+          std::map<TabletKey, TabletWithLocator>* tableMap) {
+
+        GetTableConfigRpc rpc(context, tableId, keyHash, keyHash);
+        FlatTableConfig tableConfig;
+        rpc.wait(&tableConfig);
+        addTablets(tableConfig, tableMap);
+    }
+
+  private:
+    /**
+     * Add an entry to \a tableMap for each tablet in \a tableConfig.
+     */
+    static void
+    addTablets(const FlatTableConfig& tableConfig,
+               std::map<TabletKey, TabletWithLocator>* tableMap) {
+        for (uint32_t i = 0; i < tableConfig.getTabletCount(); i++) {
+            const FlatTableConfig::TabletRecord* tablet =
+                    tableConfig.getTablet(i);
+            ServerId serverId(tablet->serverId);
             Tablet::Status state = Tablet::Status::RECOVERING;
-            if (tablet.state() == ProtoBuf::TableConfig_Tablet_State_NORMAL) {
+            if (tablet->status == Tablet::NORMAL) {
                 state = Tablet::NORMAL;
             }
-            LogPosition ctime(tablet.ctime_log_head_id(),
-                              tablet.ctime_log_head_offset());
+            LogPosition ctime(tablet->ctimeSegmentId,
+                              tablet->ctimeSegmentOffset);
 
-            Tablet rawTablet(tableId, startKeyHash, endKeyHash,
-                                            serverId, state, ctime);
-            string serviceLocator = tablet.service_locator();
+            Tablet rawTablet(tablet->tableId, tablet->startKeyHash,
+                    tablet->endKeyHash, serverId, state, ctime);
+            string serviceLocator(tableConfig.getString(
+                    tablet->locatorOffset, tablet->locatorLength),
+                    tablet->locatorLength);
 
-            TabletKey key{tablet.table_id(),
-                          tablet.start_key_hash()};
+            TabletKey key{tablet->tableId, tablet->startKeyHash};
             TabletWithLocator tabletWithLocator(rawTablet, serviceLocator);
 
             tableMap->insert(std::make_pair(key, tabletWithLocator));
         }
-
-        foreach (const ProtoBuf::TableConfig::Index& index,
-                                                    tableConfig.index()) {
-
-            uint64_t indexId = index.index_id();
-            foreach (const ProtoBuf::TableConfig::Index::Indexlet& indexlet,
-                                                            index.indexlet()) {
-                void* firstKey;
-                uint16_t firstKeyLength;
-                void* firstNotOwnedKey;
-                uint16_t firstNotOwnedKeyLength;
-
-                if (indexlet.start_key().compare("") != 0) {
-                    firstKey = const_cast<char *>(indexlet.start_key().c_str());
-                    firstKeyLength = (uint16_t)indexlet.start_key().length();
-                } else {
-                    firstKey = NULL;
-                    firstKeyLength = 0;
-                }
-
-                if (indexlet.end_key().compare("") != 0) {
-                    firstNotOwnedKey = const_cast<char *>
-                                                (indexlet.end_key().c_str());
-                    firstNotOwnedKeyLength =
-                                    (uint16_t)indexlet.end_key().length();
-                } else {
-                    firstNotOwnedKey = NULL;
-                    firstNotOwnedKeyLength = 0;
-                }
-
-                ServerId serverId(indexlet.server_id());
-                string serviceLocator = indexlet.service_locator();
-                ObjectFinder::Indexlet rawIndexlet(firstKey, firstKeyLength,
-                                    firstNotOwnedKey, firstNotOwnedKeyLength,
-                                    serverId, serviceLocator);
-
-                tableIndexMap->insert(std::make_pair(
-                        std::make_pair(tableId, indexId), rawIndexlet));
-            }
-        }
     }
 
-  private:
     Context* context;
     DISALLOW_COPY_AND_ASSIGN(RealTableConfigFetcher);
 };
 
+/**
+ * Fetch configuration information for the tablet of a table that contains
+ * a given key hash; used to refresh a single stale tablet without
+ * reloading the whole table. This default implementation fetches every
+ * tablet in the table; the caller ignores all but the ones it needs.
+ *
+ * \param tableId
+ *      The table containing the desired tablet.
+ * \param keyHash
+ *      A key hash within the desired tablet.
+ * \param[out] tableMap
+ *      Entries are added here for the tablet containing keyHash (and
+ *      possibly others).
+ */
+void
+ObjectFinder::TableConfigFetcher::getTabletConfig(uint64_t tableId,
+        KeyHash keyHash, std::map<TabletKey, TabletWithLocator>* tableMap)
+{
+    std::multimap< std::pair<uint64_t, uint8_t>, Indexlet> tableIndexMap;
+    getTableConfig(tableId, tableMap, &tableIndexMap);
+}
+
 /**
  * Constructor.
  * \param context
@@ -123,6 +151,7 @@ ObjectFinder::ObjectFinder(Context* context)
     , tableMap()
     , tableIndexMap()
     , tableConfigFetcher(new RealTableConfigFetcher(context))
+    , mutex()
 {
 }
 
@@ -135,6 +164,7 @@ ObjectFinder::ObjectFinder(Context* context)
  */
 void ObjectFinder::reset()
 {
+    Lock lock(mutex);
     tableMap.clear();
     tableIndexMap.clear();
 }
@@ -150,6 +180,7 @@ void ObjectFinder::reset()
  */
 void
 ObjectFinder::flush(uint64_t tableId) {
+    Lock lock(mutex);
     TabletKey start {tableId, 0U};
     TabletKey end {tableId, std::numeric_limits<KeyHash>::max()};
     TabletIter lower = tableMap.lower_bound(start);
@@ -163,6 +194,32 @@ ObjectFinder::flush(uint64_t tableId) {
     tableIndexMap.erase(indexLower, indexUpper);
 }
 
+/**
+ * This method is invoked when the caller has reason to believe that
+ * the configuration information for the tablet containing a particular
+ * key hash is out-of-date. Only that tablet is forgotten; the next lookup
+ * in it will fetch fresh information for just that tablet from the
+ * coordinator, so a stale tablet in a large table doesn't cause the
+ * configuration of the whole table to be fetched again.
+ * \param tableId
+ *      The table containing the stale tablet.
+ * \param keyHash
+ *      A key hash within the stale tablet.
+ */
+void
+ObjectFinder::flush(uint64_t tableId, KeyHash keyHash)
+{
+    Lock lock(mutex);
+    TabletKey key{tableId, keyHash};
+    TabletIter iter = tableMap.upper_bound(key);
+    if (iter == tableMap.begin())
+        return;
+    --iter;
+    if (iter->first.tableId == tableId &&
+            iter->second.tablet.endKeyHash >= keyHash)
+        tableMap.erase(iter);
+}
+
 /**
  * Return a string representation of all the table id's presented
  * at the tableMap at any given moment. Used mainly for testing.
@@ -172,6 +229,7 @@ ObjectFinder::flush(uint64_t tableId) {
  */
 string
 ObjectFinder::debugString() const {
+    Lock lock(mutex);
     std::map<TabletKey, TabletWithLocator>::const_iterator it;
     std::stringstream result;
     for (it = tableMap.begin(); it != tableMap.end(); it++) {
@@ -207,6 +265,7 @@ ObjectFinder::debugString() const {
  */
 Transport::SessionRef
 ObjectFinder::lookup(uint64_t tableId, const void* key, uint16_t keyLength) {
+    Lock lock(mutex);
     KeyHash keyHash = Key::getHash(tableId, key, keyLength);
     return lookup(tableId, keyHash);
 }
@@ -229,6 +288,7 @@ ObjectFinder::lookup(uint64_t tableId, const void* key, uint16_t keyLength) {
 Transport::SessionRef
 ObjectFinder::lookup(uint64_t tableId, KeyHash keyHash)
 {
+    Lock lock(mutex);
     TabletWithLocator* tablet = lookupTablet(tableId, keyHash);
     if (tablet->session == NULL) {
         tablet->session = context->transportManager->getSession(
@@ -257,6 +317,7 @@ Transport::SessionRef
 ObjectFinder::lookup(uint64_t tableId, uint8_t indexId,
                      const void* key, uint16_t keyLength)
 {
+    Lock lock(mutex);
     Indexlet* indexlet = lookupIndexlet(tableId, indexId, key, keyLength);
     // If indexlet doesn't exist, don't throw an exception.
     if (indexlet == NULL) {
@@ -269,6 +330,28 @@ ObjectFinder::lookup(uint64_t tableId, uint8_t indexId,
     return indexlet->session;
 }
 
+/**
+ * Return whether a table has a given index. If the index isn't in the
+ * cached configuration, the configuration is fetched again from the
+ * coordinator before giving up.
+ *
+ * \param tableId
+ *      The table to check.
+ * \param indexId
+ *      Id of the index.
+ */
+bool
+ObjectFinder::hasIndex(uint64_t tableId, uint8_t indexId)
+{
+    Lock lock(mutex);
+    std::pair<uint64_t, uint8_t> indexKey = std::make_pair(tableId, indexId);
+    if (tableIndexMap.count(indexKey) > 0)
+        return true;
+    flush(tableId);
+    tableConfigFetcher->getTableConfig(tableId, &tableMap, &tableIndexMap);
+    return tableIndexMap.count(indexKey) > 0;
+}
+
 /**
  * Lookup the indexlet containing the given key.
  *
@@ -290,6 +373,7 @@ ObjectFinder::Indexlet*
 ObjectFinder::lookupIndexlet(uint64_t tableId, uint8_t indexId,
                              const void* key, uint16_t keyLength)
 {
+    Lock lock(mutex);
     std::pair<uint64_t, uint8_t> indexKey = std::make_pair(tableId, indexId);
     IndexletIter iter;
 
@@ -344,6 +428,7 @@ ObjectFinder::lookupIndexlet(uint64_t tableId, uint8_t indexId,
 TabletWithLocator*
 ObjectFinder::lookupTablet(uint64_t tableId, KeyHash keyHash)
 {
+    Lock lock(mutex);
     bool haveRefreshed = false;
     TabletKey key{tableId, keyHash};
     TabletIter iter;
@@ -366,12 +451,71 @@ ObjectFinder::lookupTablet(uint64_t tableId, KeyHash keyHash)
         if (haveRefreshed) {
           throw TableDoesntExistException(HERE);
         }
-        flush(tableId);
-        tableConfigFetcher->getTableConfig(tableId, &tableMap, &tableIndexMap);
+        refreshTablet(tableId, keyHash);
         haveRefreshed = true;
     }
 }
 
+/**
+ * Fetch fresh configuration information from the coordinator for the
+ * tablet containing a given key hash. If nothing is cached for the table
+ * then the configuration of the whole table (including its indexes) is
+ * fetched. Otherwise only the tablet containing keyHash is fetched and
+ * merged into tableMap, replacing any cached tablets it overlaps; this
+ * keeps clients of tables with many tablets from reloading all of them
+ * each time one tablet moves.
+ *
+ * \param tableId
+ *      The table containing the desired tablet.
+ * \param keyHash
+ *      A key hash within the desired tablet.
+ */
+void
+ObjectFinder::refreshTablet(uint64_t tableId, KeyHash keyHash)
+{
+    TabletKey start{tableId, 0U};
+    TabletIter lower = tableMap.lower_bound(start);
+    if (lower == tableMap.end() || lower->first.tableId != tableId) {
+        flush(tableId);
+        tableConfigFetcher->getTableConfig(tableId, &tableMap,
+                                           &tableIndexMap);
+        return;
+    }
+
+    std::map<TabletKey, TabletWithLocator> fetched;
+    tableConfigFetcher->getTabletConfig(tableId, keyHash, &fetched);
+    flush(tableId, keyHash);
+    for (TabletIter it = fetched.begin(); it != fetched.end(); ++it) {
+        const Tablet& tablet = it->second.tablet;
+        if (tablet.tableId != tableId)
+            continue;
+
+        // Leave up-to-date entries alone so they keep their sessions.
+        TabletIter existing = tableMap.find(it->first);
+        if (existing != tableMap.end() &&
+                existing->second.tablet.endKeyHash == tablet.endKeyHash &&
+                existing->second.tablet.status == tablet.status &&
+                existing->second.serviceLocator ==
+                        it->second.serviceLocator)
+            continue;
+
+        // Discard cached tablets that overlap the new one.
+        TabletKey key{tableId, tablet.startKeyHash};
+        TabletIter cached = tableMap.upper_bound(key);
+        if (cached != tableMap.begin()) {
+            --cached;
+            if (cached->first.tableId != tableId ||
+                    cached->second.tablet.endKeyHash < tablet.startKeyHash)
+                ++cached;
+        }
+        while (cached != tableMap.end() && cached->first.tableId == tableId &&
+                cached->first.keyHash <= tablet.endKeyHash) {
+            cached = tableMap.erase(cached);
+        }
+        tableMap.insert(*it);
+    }
+}
+
 /**
  * Delete the session connecting to the master that owns a particular
  * object, if such a session exists. This method is typically invoked after
@@ -388,6 +532,7 @@ ObjectFinder::lookupTablet(uint64_t tableId, KeyHash keyHash)
 void
 ObjectFinder::flushSession(uint64_t tableId, KeyHash keyHash)
 {
+    Lock lock(mutex);
     try {
         TabletWithLocator* tabletWithLocator = lookupTablet(tableId,
                                                                 keyHash);
@@ -420,6 +565,7 @@ void
 ObjectFinder::flushSession(uint64_t tableId, uint8_t indexId,
                            const void* key, uint16_t keyLength)
 {
+    Lock lock(mutex);
     Indexlet* indexlet = lookupIndexlet(tableId, indexId,
                                               key, keyLength);
     if (indexlet != NULL) {
@@ -439,6 +585,7 @@ ObjectFinder::flushSession(uint64_t tableId, uint8_t indexId,
 void
 ObjectFinder::waitForTabletDown(uint64_t tableId)
 {
+    Lock lock(mutex);
     RAMCLOUD_TEST_LOG("flushing object map");
     flush(tableId);
     for (;;) {
@@ -466,6 +613,7 @@ ObjectFinder::waitForTabletDown(uint64_t tableId)
 void
 ObjectFinder::waitForAllTabletsNormal(uint64_t tableId, uint64_t timeoutNs)
 {
+    Lock lock(mutex);
     uint64_t start = Cycles::rdtsc();
     RAMCLOUD_TEST_LOG("flushing object map");
     while (Cycles::toNanoseconds(Cycles::rdtsc() - start) < timeoutNs) {
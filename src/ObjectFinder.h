@@ -16,6 +16,7 @@
 #ifndef RAMCLOUD_OBJECTFINDER_H
 #define RAMCLOUD_OBJECTFINDER_H
 
+#include <mutex>
 #include <boost/function.hpp>
 #include <map>
 
@@ -71,6 +72,10 @@ struct TabletWithLocator {
  * This class maps from an object identifier (table and key) to a session
  * that can be used to communicate with the master that stores the object.
  * It retrieves configuration information from the coordinator and caches it.
+ * The public methods are thread-safe, so that the threads of a multi-threaded
+ * client (see RamCloud::enableMultiThreading) can share one cache. Pointers
+ * returned by #lookupTablet and #lookupIndexlet may be invalidated by a
+ * flush in another thread, however.
  */
 class ObjectFinder {
   public:
@@ -85,11 +90,13 @@ class ObjectFinder {
     Transport::SessionRef lookup(uint64_t tableId, uint8_t indexId,
                                  const void* key, uint16_t keyLength);
 
+    bool hasIndex(uint64_t tableId, uint8_t indexId);
     Indexlet* lookupIndexlet(uint64_t tableId, uint8_t indexId,
                              const void* key, uint16_t keyLength);
     TabletWithLocator* lookupTablet(uint64_t table, KeyHash keyHash);
 
     void flush(uint64_t tableId);
+    void flush(uint64_t tableId, KeyHash keyHash);
     void flushSession(uint64_t tableId, KeyHash keyHash);
     void flushSession(uint64_t tableId, uint8_t indexId,
                       const void* key, uint16_t keyLength);
@@ -104,6 +111,8 @@ class ObjectFinder {
     string debugString() const;
 
   PRIVATE:
+    void refreshTablet(uint64_t tableId, KeyHash keyHash);
+
     /**
      * Shared RAMCloud information.
      */
@@ -134,6 +143,14 @@ class ObjectFinder {
      */
     std::unique_ptr<ObjectFinder::TableConfigFetcher> tableConfigFetcher;
 
+    /**
+     * Serializes access to #tableMap and #tableIndexMap. It's recursive
+     * because public methods call each other (e.g. #lookup calls
+     * #lookupTablet, which may call #flush).
+     */
+    mutable std::recursive_mutex mutex;
+    typedef std::lock_guard<std::recursive_mutex> Lock;
+
     DISALLOW_COPY_AND_ASSIGN(ObjectFinder);
 };
 
@@ -185,6 +202,9 @@ class ObjectFinder::TableConfigFetcher {
                std::map<TabletKey, TabletWithLocator>* tableMap,
                std::multimap< std::pair<uint64_t, uint8_t>,
                                 Indexlet>* tableIndexMap) = 0;
+    virtual void getTabletConfig(
+               uint64_t tableId, KeyHash keyHash,
+               std::map<TabletKey, TabletWithLocator>* tableMap);
 };
 
 } // end RAMCloud
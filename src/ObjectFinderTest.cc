@@ -209,6 +209,79 @@ TEST_F(ObjectFinderTest, flush) {
     EXPECT_EQ(objectFinder->debugString(), "");
 }
 
+TEST_F(ObjectFinderTest, flush_keyHash) {
+    objectFinder->lookup(2, 0);
+    objectFinder->flush(3);
+    objectFinder->flush(4);
+    objectFinder->flush(5);
+
+    // Key hash in a tablet that isn't the first.
+    objectFinder->flush(2, 5000);
+    EXPECT_EQ("{{tableId : 1, keyHash : 0}, {start_key_hash : 0,"
+              " end_key_hash : 18446744073709551615, state : 1}},"
+              " {{tableId : 2, keyHash : 0}, {start_key_hash : 0,"
+              " end_key_hash : 1000, state : 0}}",
+              objectFinder->debugString());
+
+    // No tablet contains the key hash.
+    objectFinder->flush(2, 5000);
+    objectFinder->flush(0, 5000);
+    objectFinder->flush(7, 5000);
+    EXPECT_EQ("{{tableId : 1, keyHash : 0}, {start_key_hash : 0,"
+              " end_key_hash : 18446744073709551615, state : 1}},"
+              " {{tableId : 2, keyHash : 0}, {start_key_hash : 0,"
+              " end_key_hash : 1000, state : 0}}",
+              objectFinder->debugString());
+
+    objectFinder->flush(2, 1000);
+    objectFinder->flush(1, 0);
+    EXPECT_EQ("", objectFinder->debugString());
+}
+
+TEST_F(ObjectFinderTest, refreshTablet_nothingCached) {
+    objectFinder->refreshTablet(2, 0);
+    EXPECT_EQ(1U, refresher->called);
+    EXPECT_EQ(4U, objectFinder->tableIndexMap.size());
+    EXPECT_EQ("mock:host=server2",
+              objectFinder->lookupTablet(2, 0)->serviceLocator);
+}
+
+TEST_F(ObjectFinderTest, refreshTablet_onlyStaleTablet) {
+    objectFinder->lookup(3, 0);
+    objectFinder->flush(1);
+    objectFinder->flush(2);
+    objectFinder->flush(4);
+    objectFinder->flush(5);
+    Transport::SessionRef session = objectFinder->lookup(3, 0);
+
+    // Pretend that cached information about the second tablet is stale:
+    // we think it has been split in two.
+    objectFinder->flush(3, 10000);
+    Tablet rawTablet({3, 10000, 19999, ServerId(), Tablet::NORMAL,
+            LogPosition()});
+    objectFinder->tableMap.insert({{3, 10000},
+            TabletWithLocator(rawTablet, "mock:host=stale")});
+    Tablet rawTablet2({3, 20000, uint64_t(~0), ServerId(), Tablet::NORMAL,
+            LogPosition()});
+    objectFinder->tableMap.insert({{3, 20000},
+            TabletWithLocator(rawTablet2, "mock:host=stale")});
+    objectFinder->flush(3, 15000);
+    EXPECT_EQ("mock:host=server3", objectFinder->lookup(3, 15000)->
+            getServiceLocator());
+    EXPECT_EQ(2U, refresher->called);
+
+    // Only table 3 was updated, and the overlapping stale tablet was
+    // discarded.
+    EXPECT_EQ("{{tableId : 3, keyHash : 0}, {start_key_hash : 0,"
+              " end_key_hash : 1000, state : 0}},"
+              " {{tableId : 3, keyHash : 10000}, {start_key_hash : 10000,"
+              " end_key_hash : 18446744073709551615, state : 0}}",
+              objectFinder->debugString());
+
+    // The tablet that wasn't stale kept its session.
+    EXPECT_EQ(session, objectFinder->lookupTablet(3, 0)->session);
+}
+
 TEST_F(ObjectFinderTest, lookup_stringKey) {
     Transport::SessionRef session = objectFinder->lookup(1, "abc", 3);
     ASSERT_TRUE(session != NULL);
@@ -247,6 +320,15 @@ TEST_F(ObjectFinderTest, lookup_index_success) {
     EXPECT_EQ(session, objectFinder->lookupIndexlet(1, 1, "abc", 3)->session);
 }
 
+TEST_F(ObjectFinderTest, hasIndex) {
+    EXPECT_TRUE(objectFinder->hasIndex(1, 0));
+    EXPECT_EQ(1u, refresher->called);
+    EXPECT_TRUE(objectFinder->hasIndex(1, 1));
+    EXPECT_EQ(1u, refresher->called);
+    EXPECT_FALSE(objectFinder->hasIndex(1, 2));
+    EXPECT_EQ(2u, refresher->called);
+}
+
 TEST_F(ObjectFinderTest, lookupIndexlet) {
     char a = 'a';
     char b = 'b';
@@ -13,6 +13,9 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <algorithm>
+#include <deque>
+
 #include "Buffer.h"
 #include "Cycles.h"
 #include "Dispatch.h"
@@ -67,6 +70,9 @@ namespace RAMCloud {
  *      Pointer to the master's TxRecoveryManager instance.  This keeps track
  *      of ongoing transaction recoveries; these recoveries may need records
  *      stored in the log.
+ * \param clusterClock
+ *      Pointer to the master's ClusterClock, which times writes for
+ *      snapshot reads. NULL disables snapshot reads.
  */
 ObjectManager::ObjectManager(Context* context, ServerId* serverId,
                 const ServerConfig* config,
@@ -74,7 +80,8 @@ ObjectManager::ObjectManager(Context* context, ServerId* serverId,
                 MasterTableMetadata* masterTableMetadata,
                 UnackedRpcResults* unackedRpcResults,
                 PreparedOps* preparedOps,
-                TxRecoveryManager* txRecoveryManager)
+                TxRecoveryManager* txRecoveryManager,
+                ClusterClock* clusterClock)
     : context(context)
     , config(config)
     , tabletManager(tabletManager)
@@ -82,20 +89,32 @@ ObjectManager::ObjectManager(Context* context, ServerId* serverId,
     , unackedRpcResults(unackedRpcResults)
     , preparedOps(preparedOps)
     , txRecoveryManager(txRecoveryManager)
+    , clusterClock(clusterClock)
     , allocator(config)
     , replicaManager(context, serverId,
                      config->master.numReplicas,
                      config->master.useMinCopysets,
-                     config->master.allowLocalBackup)
+                     config->master.allowLocalBackup,
+                     config->master.relayReplication,
+                     config->master.compressReplication,
+                     config->master.loadAwareReplication)
     , segmentManager(context, config, serverId,
                      allocator, replicaManager, masterTableMetadata)
     , log(context, config, this, &segmentManager, &replicaManager)
     , objectMap(config->master.hashTableBytes / HashTable::bytesPerCacheLine())
     , anyWrites(false)
     , hashTableBucketLocks()
-    , lockTable(1000, log)
+    , hashTableBucketVersions()
+    , lockTable(config->master.lockTableSize, log)
     , mutex("ObjectManager::mutex")
     , tombstoneRemover(this, &objectMap)
+    , hashTableResizer(this, &objectMap, config->master.hashTableMaxBytes)
+    , versionHistory()
+    , versionCollector(this)
+    , anyTableTtl(false)
+    , anyCacheTable(false)
+    , anyTableDurability(false)
+    , expiredObjectRemover(this)
     , tombstoneProtectorCount(0)
 {
     for (size_t i = 0; i < arrayLength(hashTableBucketLocks); i++)
@@ -143,6 +162,12 @@ ObjectManager::initOnceEnlisted()
 
     if (!config->master.disableLogCleaner)
         log.enableCleaner();
+
+    if (config->master.hashTableMaxBytes > config->master.hashTableBytes)
+        hashTableResizer.start(0);
+
+    if (clusterClock != NULL && config->master.snapshotVersions > 0)
+        versionCollector.start(0);
 }
 
 /**
@@ -195,9 +220,36 @@ ObjectManager::readHashes(const uint64_t tableId, uint32_t reqNumHashes,
 
     *numObjects = 0;
 
+    // The hashes are all available up front, so they are run through the
+    // same prefetch pipeline as readObjects: buckets 2 * READ_PREFETCH_DEPTH
+    // hashes ahead, and the log entries they refer to READ_PREFETCH_DEPTH
+    // ahead. Without this, every hash takes at least two cache misses in
+    // series.
+    for (uint32_t i = 0; i < reqNumHashes && i < 2 * READ_PREFETCH_DEPTH;
+            i++) {
+        objectMap.prefetchBucket(*pKHashes->getOffset<uint64_t>(
+                initialPKHashesOffset + i * sizeof32(uint64_t)));
+    }
+    for (uint32_t i = 0; i < reqNumHashes && i < READ_PREFETCH_DEPTH; i++) {
+        prefetchObject(*pKHashes->getOffset<uint64_t>(
+                initialPKHashesOffset + i * sizeof32(uint64_t)));
+    }
+
     for (*respNumHashes = 0; *respNumHashes < reqNumHashes;
             *respNumHashes += 1) {
 
+        // Hash i + k is k hashes past pKHashesOffset.
+        uint32_t i = *respNumHashes;
+        if (i + 2 * READ_PREFETCH_DEPTH < reqNumHashes) {
+            objectMap.prefetchBucket(*pKHashes->getOffset<uint64_t>(
+                    pKHashesOffset +
+                    2 * READ_PREFETCH_DEPTH * sizeof32(uint64_t)));
+        }
+        if (i + READ_PREFETCH_DEPTH < reqNumHashes) {
+            prefetchObject(*pKHashes->getOffset<uint64_t>(
+                    pKHashesOffset + READ_PREFETCH_DEPTH * sizeof32(uint64_t)));
+        }
+
         pKHash = *(pKHashes->getOffset<uint64_t>(pKHashesOffset));
         pKHashesOffset += sizeof32(pKHash);
 
@@ -205,7 +257,6 @@ ObjectManager::readHashes(const uint64_t tableId, uint32_t reqNumHashes,
         // doing the work here directly, since the abstraction breaks down
         // as multiple objects having the same primary key hash may match
         // the index key range.
-        objectMap.prefetchBucket(pKHash);
         HashTableBucketLock lock(*this, pKHash); // unlocks self on destruct
 
         // If the tablet doesn't exist in the NORMAL state,
@@ -262,39 +313,118 @@ ObjectManager::readHashes(const uint64_t tableId, uint32_t reqNumHashes,
 
 /**
  * This method is used by replaySegment() to prefetch the hash table bucket
- * corresponding to the next entry to be replayed. Doing so avoids a cache
- * miss for subsequent hash table lookups and significantly speeds up replay.
+ * corresponding to an entry that will be replayed soon (see
+ * #REPLAY_PREFETCH_DEPTH). Doing so avoids a cache miss for subsequent hash
+ * table lookups and significantly speeds up replay.
  *
- * \param it
- *      SegmentIterator to use for prefetching. Whatever is currently pointed
- *      to by this iterator will be used to prefetch, if possible. Some entries
- *      do not contain keys; they are safely ignored.
+ * \param entry
+ *      The entry whose bucket should be prefetched, as returned by
+ *      SegmentIterator::nextBatch. Entries that do not contain keys, or
+ *      aren't contiguous in memory, are safely ignored.
+ * \param shard
+ *      If not NULL, the shard being replayed; buckets of entries that
+ *      another shard will replay aren't prefetched.
  */
 inline void
-ObjectManager::prefetchHashTableBucket(SegmentIterator* it)
+ObjectManager::prefetchHashTableBucket(const SegmentIterator::Entry& entry,
+        const ReplayShard* shard)
 {
-    if (expect_false(it->isDone()))
+    if (expect_false(entry.data == NULL))
         return;
 
-    if (expect_true(it->getType() == LOG_ENTRY_TYPE_OBJ)) {
+    KeyHash keyHash;
+    if (expect_true(entry.type == LOG_ENTRY_TYPE_OBJ)) {
         const Object::Header* obj =
-            it->getContiguous<Object::Header>(NULL, 0);
+            static_cast<const Object::Header*>(entry.data);
 
-        Object prefetchObj(obj, it->getLength());
+        Object prefetchObj(obj, entry.length);
         KeyLength primaryKeyLen = 0;
         const void *primaryKey = prefetchObj.getKey(0, &primaryKeyLen);
 
         Key key(obj->tableId, primaryKey, primaryKeyLen);
-        objectMap.prefetchBucket(key.getHash());
-    } else if (it->getType() == LOG_ENTRY_TYPE_OBJTOMB) {
+        keyHash = key.getHash();
+    } else if (entry.type == LOG_ENTRY_TYPE_OBJTOMB) {
         const ObjectTombstone::Header* tomb =
-            it->getContiguous<ObjectTombstone::Header>(NULL, 0);
+            static_cast<const ObjectTombstone::Header*>(entry.data);
         Key key(tomb->tableId, tomb->key,
-            downCast<uint16_t>(it->getLength() - sizeof32(*tomb)));
-        objectMap.prefetchBucket(key.getHash());
+            downCast<uint16_t>(entry.length - sizeof32(*tomb)));
+        keyHash = key.getHash();
+    } else {
+        return;
+    }
+    if (shard == NULL || shard->contains(keyHash))
+        objectMap.prefetchBucket(keyHash);
+}
+
+/**
+ * This method is used by readObjects() and readHashes() to bring the log
+ * entries that a key hash may refer to into the cache before they are read.
+ * It assumes the hash's table bucket has already been prefetched (see
+ * HashTable::prefetchBucket()); otherwise it stalls on the bucket and gains
+ * little.
+ *
+ * \param keyHash
+ *      Primary key hash of an object that will be read soon.
+ */
+inline void
+ObjectManager::prefetchObject(KeyHash keyHash)
+{
+    uint64_t unused;
+    HashTableBucketLock lock(*this, HashTable::findBucketIndex(
+            objectMap.getNumBuckets(), keyHash, &unused));
+    HashTable::Candidates candidates;
+    objectMap.lookup(keyHash, candidates);
+    while (!candidates.isDone()) {
+        // References are pointers to log entries (see Segment::Reference).
+        // The entry header, object header, and (usually) the key fit in the
+        // first two cache lines.
+        prefetch(reinterpret_cast<const void*>(candidates.getReference()),
+                 2 * HashTable::bytesPerCacheLine());
+        candidates.next();
     }
 }
 
+/**
+ * If any of the log entries that might hold the given key are on the flash
+ * tier (see SegletAllocator) and aren't in memory, start fetching them, so
+ * that readObject() doesn't block its worker thread on a page fault while
+ * the entry is read from flash.
+ *
+ * Only reads do this; other operations that find an object on flash (for
+ * example, a conditional write) simply wait for the page fault.
+ *
+ * \param key
+ *      Key of an object that is about to be read.
+ * \return
+ *      True if the entries for this key can be read without blocking; false
+ *      if they are being fetched and the read should be retried later.
+ */
+bool
+ObjectManager::fetchFromFlash(Key& key)
+{
+    HashTableBucketLock lock(*this, key);
+    bool inMemory = true;
+    HashTable::Candidates candidates;
+    objectMap.lookup(key.getHash(), candidates);
+    while (!candidates.isDone()) {
+        const void* p = reinterpret_cast<const void*>(
+                candidates.getReference());
+        candidates.next();
+        if (!allocator.isOnFlash(p))
+            continue;
+
+        // An entry's header holds its length and is at most 5 bytes long.
+        uint32_t length = FLASH_FETCH_BYTES;
+        if (allocator.isInMemory(p, 5)) {
+            Log::Reference reference(reinterpret_cast<uint64_t>(p));
+            reference.getEntry(&allocator, NULL, &length);
+        }
+        if (!allocator.fetchFromFlash(p, length))
+            inMemory = false;
+    }
+    return inMemory;
+}
+
 /**
  * Read an object previously written to this ObjectManager.
  *
@@ -312,29 +442,139 @@ ObjectManager::prefetchHashTableBucket(SegmentIterator* it)
  * \param valueOnly
  *      If true, then only the value portion of the object is written to
  *      outBuffer. Otherwise, keys and value are written to outBuffer.
+ * \param oldestSync
+ *      If the object's tablet is a read replica, the read is only done if
+ *      the replica was up to date as of this Cycles::rdtsc() time (see
+ *      TabletManager::checkAndIncrementReadCount). The default allows only
+ *      reads from tablets this master owns.
  * \return
  *      Returns STATUS_OK if the lookup succeeded and the reject rules did not
  *      preclude this read. Other status values indicate different failures
  *      (object not found, tablet doesn't exist, reject rules applied, etc).
+ *      STATUS_RETRY means the object is on the flash tier and is being
+ *      brought into memory (see fetchFromFlash()).
  */
 Status
 ObjectManager::readObject(Key& key, Buffer* outBuffer,
                 RejectRules* rejectRules, uint64_t* outVersion,
-                bool valueOnly)
+                bool valueOnly, uint64_t oldestSync)
 {
     objectMap.prefetchBucket(key.getHash());
-    HashTableBucketLock lock(*this, key);
 
+    // If the tablet doesn't exist in the NORMAL state, we must plead ignorance.
+    if (!tabletManager->checkAndIncrementReadCount(key, oldestSync))
+        return STATUS_UNKNOWN_TABLET;
+
+    if (expect_false(allocator.hasFlash()) && !fetchFromFlash(key))
+        return STATUS_RETRY;
+
+    // Reads vastly outnumber writes, so first try without taking the bucket
+    // lock (which would bounce the lock's cache line between cores). If a
+    // writer or the cleaner holds the lock in the meantime, discard what we
+    // read and try again, eventually falling back to taking the lock.
+    uint32_t initialLength = outBuffer->size();
+    uint32_t valueLength = 0;
+    uint32_t keysAndValueLength = 0;
+    Status status = STATUS_OK;
+    bool done = false;
+    for (uint32_t attempt = 0; attempt < MAX_OPTIMISTIC_READ_ATTEMPTS;
+            attempt++) {
+        HashTableBucketSnapshot snapshot(*this, key);
+        status = readObjectInBucket(key, outBuffer, rejectRules, outVersion,
+                valueOnly, &valueLength, &keysAndValueLength);
+        if (snapshot.validate()) {
+            done = true;
+            break;
+        }
+        outBuffer->truncate(initialLength);
+        ++PerfStats::threadStats.readRetries;
+    }
+    if (!done) {
+        HashTableBucketLock lock(*this, key);
+        status = readObjectInBucket(key, outBuffer, rejectRules, outVersion,
+                valueOnly, &valueLength, &keysAndValueLength);
+    }
+    if (status != STATUS_OK)
+        return status;
+
+    ++PerfStats::threadStats.readCount;
+    PerfStats::threadStats.readObjectBytes += valueLength;
+    PerfStats::threadStats.readKeyBytes += keysAndValueLength - valueLength;
+
+    return STATUS_OK;
+}
+
+/**
+ * Read an object as it was at a given cluster time (a snapshot read). This
+ * requires ServerConfig::Master::snapshotVersions to be set: the master
+ * then keeps a few older versions of each object written recently (see
+ * VersionHistory).
+ *
+ * \param key
+ *      Key of the object being read.
+ * \param snapshotTime
+ *      The cluster time of the snapshot (encoded, as by
+ *      ClusterTime::getEncoded). The read returns the newest version that
+ *      was written before this time; it returns the same result however
+ *      many times it's repeated, as long as the version isn't collected
+ *      (see ServerConfig::Master::snapshotRetentionMs).
+ * \param outBuffer
+ *      Buffer to populate with the value of the object, if found.
+ * \param rejectRules
+ *      If non-NULL, use the specified rules to perform a conditional read,
+ *      given the version at the snapshot's time. See the RejectRules class
+ *      documentation for more details.
+ * \param outVersion
+ *      If non-NULL and the object is found, the version is returned here.
+ * \param valueOnly
+ *      If true, then only the value portion of the object is written to
+ *      outBuffer. Otherwise, keys and value are written to outBuffer.
+ * \return
+ *      The same as readObject(), plus STATUS_INVALID_PARAMETER if snapshot
+ *      reads are disabled or the version needed is no longer available.
+ */
+Status
+ObjectManager::readObjectAtTime(Key& key, uint64_t snapshotTime,
+                Buffer* outBuffer, RejectRules* rejectRules,
+                uint64_t* outVersion, bool valueOnly)
+{
     // If the tablet doesn't exist in the NORMAL state, we must plead ignorance.
     if (!tabletManager->checkAndIncrementReadCount(key))
         return STATUS_UNKNOWN_TABLET;
 
+    if (clusterClock == NULL || config->master.snapshotVersions == 0 ||
+            snapshotTime < getSnapshotWatermark())
+        return STATUS_INVALID_PARAMETER;
+
+    // Writes made from now on must not be visible to the snapshot.
+    clusterClock->updateClock(ClusterTime(snapshotTime));
+
+    HashTableBucketLock lock(*this, key);
     Buffer buffer;
     LogEntryType type;
-    uint64_t version;
-    Log::Reference reference;
-    bool found = lookup(lock, key, type, buffer, &version, &reference);
-    if (!found || type != LOG_ENTRY_TYPE_OBJ)
+    uint64_t version = VERSION_NONEXISTENT;
+    if (!lookup(lock, key, type, buffer, &version) ||
+            type != LOG_ENTRY_TYPE_OBJ)
+        version = VERSION_NONEXISTENT;
+
+    {
+        SpinLock::Guard guard(versionHistory.mutex);
+        VersionHistory::Version older(VERSION_NONEXISTENT, 0, 0);
+        switch (versionHistory.find(key, version, snapshotTime, &older,
+                guard)) {
+            case VersionHistory::CURRENT:
+                break;
+            case VersionHistory::OLDER:
+                version = older.version;
+                buffer.reset();
+                if (version != VERSION_NONEXISTENT)
+                    log.getEntry(Log::Reference(older.reference), buffer);
+                break;
+            case VersionHistory::TOO_OLD:
+                return STATUS_INVALID_PARAMETER;
+        }
+    }
+    if (version == VERSION_NONEXISTENT)
         return STATUS_OBJECT_DOESNT_EXIST;
 
     if (outVersion != NULL)
@@ -352,15 +592,143 @@ ObjectManager::readObject(Key& key, Buffer* outBuffer,
     } else {
         object.appendKeysAndValueToBuffer(*outBuffer);
     }
-    ++PerfStats::threadStats.readCount;
+
     uint32_t valueLength = object.getValueLength();
+    ++PerfStats::threadStats.readCount;
     PerfStats::threadStats.readObjectBytes += valueLength;
     PerfStats::threadStats.readKeyBytes +=
             object.getKeysAndValueLength() - valueLength;
+    return STATUS_OK;
+}
+
+/**
+ * This method does the work of readObject() once the caller has either
+ * locked the key's hash table bucket or taken a HashTableBucketSnapshot of
+ * it. In the latter case, the caller must discard the results if the
+ * snapshot doesn't validate.
+ *
+ * \param key
+ *      Key of the object being read.
+ * \param outBuffer
+ *      Buffer to populate with the value of the object, if found.
+ * \param rejectRules
+ *      If non-NULL, use the specified rules to perform a conditional read. See
+ *      the RejectRules class documentation for more details.
+ * \param outVersion
+ *      If non-NULL and the object is found, the version is returned here.
+ * \param valueOnly
+ *      If true, then only the value portion of the object is written to
+ *      outBuffer. Otherwise, keys and value are written to outBuffer.
+ * \param[out] outValueLength
+ *      If the read succeeds, the length of the object's value is returned
+ *      here.
+ * \param[out] outKeysAndValueLength
+ *      If the read succeeds, the length of the object's keys and value is
+ *      returned here.
+ * \return
+ *      The same as readObject(), except that the tablet is not checked.
+ */
+Status
+ObjectManager::readObjectInBucket(Key& key, Buffer* outBuffer,
+                RejectRules* rejectRules, uint64_t* outVersion,
+                bool valueOnly, uint32_t* outValueLength,
+                uint32_t* outKeysAndValueLength)
+{
+    Buffer buffer;
+    LogEntryType type;
+    uint64_t version;
+    Log::Reference reference;
+    bool found = lookupInBucket(key, type, buffer, &version, &reference);
+    if (!found || type != LOG_ENTRY_TYPE_OBJ)
+        return STATUS_OBJECT_DOESNT_EXIST;
+
+    Object object(buffer);
+    if (isExpired(object))
+        return STATUS_OBJECT_DOESNT_EXIST;
+
+    if (outVersion != NULL)
+        *outVersion = version;
+
+    if (rejectRules != NULL) {
+        Status status = rejectOperation(rejectRules, version);
+        if (status != STATUS_OK)
+            return status;
+    }
 
+    if (valueOnly) {
+        object.appendValueToBuffer(outBuffer);
+    } else {
+        object.appendKeysAndValueToBuffer(*outBuffer);
+    }
+    *outValueLength = object.getValueLength();
+    *outKeysAndValueLength = object.getKeysAndValueLength();
+    if (expect_false(allocator.isOnFlash(
+            reinterpret_cast<const void*>(reference.toInteger())))) {
+        ++PerfStats::threadStats.flashReads;
+    }
     return STATUS_OK;
 }
 
+/**
+ * Read a batch of objects previously written to this ObjectManager. The
+ * result is the same as calling readObject() on each key in turn, but the
+ * hash table buckets and log entries for upcoming keys are prefetched while
+ * earlier keys are read (see #READ_PREFETCH_DEPTH), so that the cache misses
+ * for different keys overlap rather than being paid one after another.
+ *
+ * \param numObjects
+ *      Number of objects to read. Each of the following arrays must have
+ *      this many elements.
+ * \param keys
+ *      Keys of the objects to read.
+ * \param rejectRules
+ *      Rules to use for a conditional read of each object. See the
+ *      RejectRules class documentation for more details.
+ * \param outBuffer
+ *      Buffer to which the objects found are appended, in order. Entry i of
+ *      \a outLengths says how many bytes were appended for object i.
+ * \param[out] outStatuses
+ *      The status that readObject() would have returned for each object.
+ * \param[out] outVersions
+ *      The version of each object, if it was found. If the reject rules
+ *      failed the read, the current object's version is still returned. 0 is
+ *      returned for objects that weren't found.
+ * \param[out] outLengths
+ *      The number of bytes appended to outBuffer for each object. 0 unless
+ *      the corresponding status is STATUS_OK.
+ * \param valueOnly
+ *      If true, then only the value portion of each object is written to
+ *      outBuffer. Otherwise, keys and value are written to outBuffer.
+ */
+void
+ObjectManager::readObjects(uint32_t numObjects, Key** keys,
+                RejectRules* rejectRules, Buffer* outBuffer,
+                Status* outStatuses, uint64_t* outVersions,
+                uint32_t* outLengths, bool valueOnly)
+{
+    // Prime the pipeline: the first few keys have nothing ahead of them to
+    // hide their misses.
+    for (uint32_t i = 0; i < numObjects && i < 2 * READ_PREFETCH_DEPTH; i++)
+        objectMap.prefetchBucket(keys[i]->getHash());
+    for (uint32_t i = 0; i < numObjects && i < READ_PREFETCH_DEPTH; i++)
+        prefetchObject(keys[i]->getHash());
+
+    for (uint32_t i = 0; i < numObjects; i++) {
+        if (i + 2 * READ_PREFETCH_DEPTH < numObjects) {
+            objectMap.prefetchBucket(
+                    keys[i + 2 * READ_PREFETCH_DEPTH]->getHash());
+        }
+        if (i + READ_PREFETCH_DEPTH < numObjects)
+            prefetchObject(keys[i + READ_PREFETCH_DEPTH]->getHash());
+
+        uint32_t initialLength = outBuffer->size();
+        outVersions[i] = 0;
+        outStatuses[i] = readObject(*keys[i], outBuffer, &rejectRules[i],
+                &outVersions[i], valueOnly);
+        outLengths[i] = outBuffer->size() - initialLength;
+    }
+}
+
 /**
  * Remove an object previously written to this ObjectManager.
  *
@@ -477,7 +845,7 @@ ObjectManager::removeObject(Key& key, RejectRules* rejectRules,
                           appends[0].buffer.size(),
                           1);
     segmentManager.raiseSafeVersion(object.getVersion() + 1);
-    log.free(reference);
+    retireVersion(key, object.getVersion(), reference, VERSION_NONEXISTENT);
     remove(lock, key);
     return STATUS_OK;
 }
@@ -497,6 +865,128 @@ ObjectManager::removeOrphanedObjects()
     }
 }
 
+/**
+ * Add the objects in a segment built by a client (see BulkLoader) to the
+ * log. This is much cheaper than writing them one at a time: the segment is
+ * replayed into a SideLog just as recovery and migration add data, so there
+ * is no per-object RPC, and the whole segment is replicated to backups in a
+ * few large writes when the SideLog is committed.
+ *
+ * Every entry is checked before any of them is added, so either all of the
+ * objects are loaded or none are. Each object is given a new version and
+ * timestamp here, ahead of any existing version of it, so a loaded object
+ * replaces an existing one just as a write would. Index entries are not
+ * created for loaded objects; indexes are usually created after a table has
+ * been loaded, and building an index creates entries for the objects
+ * already in the table.
+ *
+ * \param tableId
+ *      The table that all of the objects in the segment belong to.
+ * \param segment
+ *      The contents of the segment. The object headers in it are modified to
+ *      hold the new versions and timestamps.
+ * \param length
+ *      Number of bytes in \a segment.
+ * \param certificate
+ *      The segment's certificate, used to check its metadata.
+ * \param[out] outObjects
+ *      The number of objects loaded is returned here.
+ * \return
+ *      STATUS_OK if the objects were loaded, STATUS_UNKNOWN_TABLET if any of
+ *      them is in a tablet this master doesn't own, STATUS_RETRY if any of
+ *      them is locked by a transaction, or STATUS_REQUEST_FORMAT_ERROR if the
+ *      segment is malformed or holds anything other than uncorrupted objects
+ *      in table \a tableId.
+ * \throw RetryException
+ *      A tablet is locked for migration, or there isn't enough free memory
+ *      in the log for the segment.
+ */
+Status
+ObjectManager::bulkLoad(uint64_t tableId, void* segment, uint32_t length,
+        const SegmentCertificate& certificate, uint32_t* outObjects)
+{
+    *outObjects = 0;
+    SegmentIterator it(segment, length, certificate);
+    try {
+        it.checkMetadataIntegrity();
+    } catch (SegmentIteratorException& e) {
+        RAMCLOUD_LOG(WARNING, "Bulk load segment for table %lu is corrupt",
+                tableId);
+        return STATUS_REQUEST_FORMAT_ERROR;
+    }
+
+    if (!log.hasSpaceFor(length))
+        throw RetryException(HERE, 1000, 2000, "Memory capacity exceeded");
+
+    uint32_t objects = 0;
+    uint32_t timestamp = WallTime::secondsTimestamp();
+    for (; !it.isDone(); it.next()) {
+        uint32_t entryLength = it.getLength();
+        if ((it.getType() != LOG_ENTRY_TYPE_OBJ) ||
+                (entryLength < sizeof32(Object::Header) + sizeof32(KeyCount))) {
+            return STATUS_REQUEST_FORMAT_ERROR;
+        }
+        // The segment wraps a single block of memory, so this points into
+        // \a segment rather than at a copy, and the header can be restamped
+        // in place. The segment's certificate covers only entry lengths and
+        // types, so the change doesn't invalidate it.
+        Object::Header* header = const_cast<Object::Header*>(
+                it.getContiguous<Object::Header>(NULL, 0));
+        Object object(header, entryLength);
+        KeyCount keyCount = object.getKeyCount();
+        uint32_t valueOffset = 0;
+        if ((header->tableId != tableId) || (keyCount == 0) ||
+                (object.getKeysAndValueLength() < KEY_INFO_LENGTH(keyCount)) ||
+                !object.getValueOffset(&valueOffset) ||
+                (valueOffset > object.getKeysAndValueLength()) ||
+                !object.checkIntegrity()) {
+            return STATUS_REQUEST_FORMAT_ERROR;
+        }
+
+        KeyLength keyLength;
+        const void* keyString = object.getKey(0, &keyLength);
+        Key key(tableId, keyString, keyLength);
+        objectMap.prefetchBucket(key.getHash());
+        HashTableBucketLock lock(*this, key);
+
+        TabletManager::Tablet tablet;
+        if (!tabletManager->getTablet(key, &tablet))
+            return STATUS_UNKNOWN_TABLET;
+        if (tablet.state != TabletManager::NORMAL) {
+            if (tablet.state == TabletManager::LOCKED_FOR_MIGRATION)
+                throw RetryException(HERE, 1000, 2000,
+                        "Tablet is currently locked for migration!");
+            return STATUS_UNKNOWN_TABLET;
+        }
+        if (lockTable.isLockAcquired(key))
+            return STATUS_RETRY;
+
+        // Replay keeps whichever of two versions of an object is newer, so
+        // the loaded object must be newer than any existing one.
+        LogEntryType currentType = LOG_ENTRY_TYPE_INVALID;
+        Buffer currentBuffer;
+        uint64_t currentVersion = VERSION_NONEXISTENT;
+        if (lookup(lock, key, currentType, currentBuffer) &&
+                (currentType == LOG_ENTRY_TYPE_OBJ)) {
+            Object currentObject(currentBuffer);
+            currentVersion = currentObject.getVersion();
+        }
+        header->version = (currentVersion == VERSION_NONEXISTENT) ?
+                segmentManager.allocateVersion() : currentVersion + 1;
+        header->timestamp = timestamp;
+        header->checksum = Object::computeChecksum(header, entryLength);
+        objects++;
+    }
+
+    TombstoneProtector protector(this);
+    SideLog sideLog(&log);
+    SegmentIterator replayIt(segment, length, certificate);
+    replaySegment(&sideLog, replayIt);
+    sideLog.commit();
+    *outObjects = objects;
+    return STATUS_OK;
+}
+
 /**
  * This class is used by replaySegment to increment the number of times that
  * that method returns, regardless of the return path. That counter is used
@@ -545,6 +1035,26 @@ ObjectManager::replaySegment(SideLog* sideLog, SegmentIterator& it)
     replaySegment(sideLog, it, NULL);
 }
 
+/**
+ * A wrapper function for replaySegment that replays every entry of the
+ * segment.
+ *
+ * \param sideLog
+ *      Pointer to the SideLog in which replayed data will be stored.
+ * \param it
+ *       SegmentIterator which is pointing to the start of the recovery segment
+ *       to be replayed into the log.
+ * \param nextNodeIdMap
+ *       A unordered map that keeps track of the nextNodeId in
+ *       each indexlet table.
+ */
+void
+ObjectManager::replaySegment(SideLog* sideLog, SegmentIterator& it,
+    std::unordered_map<uint64_t, uint64_t>* nextNodeIdMap)
+{
+    replaySegment(sideLog, it, nextNodeIdMap, ReplayShard());
+}
+
 /**
  * Replay the entries within a segment and store the appropriate objects.
  * This method is used during recovery to replay a portion of a failed
@@ -572,10 +1082,20 @@ ObjectManager::replaySegment(SideLog* sideLog, SegmentIterator& it)
  * \param nextNodeIdMap
  *       A unordered map that keeps track of the nextNodeId in
  *       each indexlet table.
+ * \param shard
+ *       Which of the segment's entries to replay. When several threads
+ *       replay the same segment, each passes a different shard and its own
+ *       SideLog and nextNodeIdMap; the entries for any one key are then all
+ *       replayed by the same thread, into the same SideLog.
+ * \param verifyChecksums
+ *       If false, the checksums of the entries aren't checked. Only for
+ *       segments whose entries have already been checked, such as by the
+ *       backup that built them or by helper threads running alongside.
  */
 void
 ObjectManager::replaySegment(SideLog* sideLog, SegmentIterator& it,
-    std::unordered_map<uint64_t, uint64_t>* nextNodeIdMap)
+    std::unordered_map<uint64_t, uint64_t>* nextNodeIdMap,
+    const ReplayShard& shard, bool verifyChecksums)
 {
     uint64_t startReplicationTicks = metrics->master.replicaManagerTicks;
     uint64_t startReplicationPostingWriteRpcTicks =
@@ -602,24 +1122,40 @@ ObjectManager::replaySegment(SideLog* sideLog, SegmentIterator& it,
     uint64_t safeVersionRecoveryCount = 0;
     uint64_t safeVersionNonRecoveryCount = 0;
 
+    // Keep the hash table buckets of the next REPLAY_PREFETCH_DEPTH
+    // entries on their way into the cache. The prefetcher decodes the
+    // headers of the entries ahead a batch at a time.
     SegmentIterator prefetcher = it;
-    prefetcher.next();
+    SegmentIterator::Entry ahead[REPLAY_PREFETCH_DEPTH];
+    uint32_t aheadCount = prefetcher.nextBatch(ahead, REPLAY_PREFETCH_DEPTH);
+    for (uint32_t i = 0; i < aheadCount; i++)
+        prefetchHashTableBucket(ahead[i], &shard);
+    uint32_t aheadIndex = aheadCount;
 
     uint64_t bytesIterated = 0;
     for (; expect_true(!it.isDone()); it.next()) {
-        prefetchHashTableBucket(&prefetcher);
-        prefetcher.next();
+        if (aheadIndex == aheadCount) {
+            aheadCount = prefetcher.nextBatch(ahead, REPLAY_PREFETCH_DEPTH);
+            aheadIndex = 0;
+        }
+        if (aheadIndex < aheadCount)
+            prefetchHashTableBucket(ahead[aheadIndex++], &shard);
 
         LogEntryType type = it.getType();
 
-        if (bytesIterated > 50000) {
-            bytesIterated = 0;
-            replicaManager.proceed();
-        }
-        bytesIterated += it.getLength();
+        // Every shard sees every entry; let only one of them drive
+        // replication and count the entries.
+        if (shard.handlesUnkeyed()) {
+            if (bytesIterated > 50000) {
+                bytesIterated = 0;
+                sideLog->replicateAppended();
+                replicaManager.proceed();
+            }
+            bytesIterated += it.getLength();
 
-        recoverySegmentEntryCount++;
-        recoverySegmentEntryBytes += it.getLength();
+            recoverySegmentEntryCount++;
+            recoverySegmentEntryBytes += it.getLength();
+        }
 
         if (expect_true(type == LOG_ENTRY_TYPE_OBJ)) {
             // The recovery segment is guaranteed to be contiguous, so we need
@@ -633,6 +1169,8 @@ ObjectManager::replaySegment(SideLog* sideLog, SegmentIterator& it,
             const void *primaryKey = replayObj.getKey(0, &primaryKeyLen);
 
             Key key(recoveryObj->tableId, primaryKey, primaryKeyLen);
+            if (!shard.contains(key.getHash()))
+                continue;
 
             // If table is an BTree table,i.e., tableId exists in
             // nextNodeIdMap, update nextNodeId of its table.
@@ -648,7 +1186,7 @@ ObjectManager::replaySegment(SideLog* sideLog, SegmentIterator& it,
                 }
             }
 
-            bool checksumIsValid = ({
+            bool checksumIsValid = !verifyChecksums || ({
                 CycleCounter<uint64_t> c(&verifyChecksumTicks);
                 Object::computeChecksum(recoveryObj, it.getLength()) ==
                     recoveryObj->checksum;
@@ -737,13 +1275,15 @@ ObjectManager::replaySegment(SideLog* sideLog, SegmentIterator& it,
             Buffer buffer;
             it.appendToBuffer(buffer);
             Key key(type, buffer);
+            if (!shard.contains(key.getHash()))
+                continue;
 
             // TODO(syang0) A B+ Tree nextNodeId check was removed here because
             // we only need to set the nextNodeId to the highest live node;
             // any (deleted) nodeId's higher than that can be overwritten.
 
             ObjectTombstone recoverTomb(buffer);
-            bool checksumIsValid = ({
+            bool checksumIsValid = !verifyChecksums || ({
                 CycleCounter<uint64_t> c(&verifyChecksumTicks);
                 recoverTomb.checkIntegrity();
             });
@@ -860,13 +1400,15 @@ ObjectManager::replaySegment(SideLog* sideLog, SegmentIterator& it,
         } else if (type == LOG_ENTRY_TYPE_SAFEVERSION) {
             // LOG_ENTRY_TYPE_SAFEVERSION is duplicated to all the
             // partitions in BackupService::buildRecoverySegments()
+            if (!shard.handlesUnkeyed())
+                continue;
             Buffer buffer;
             it.appendToBuffer(buffer);
 
             ObjectSafeVersion recoverSafeVer(buffer);
             uint64_t safeVersion = recoverSafeVer.getSafeVersion();
 
-            bool checksumIsValid = ({
+            bool checksumIsValid = !verifyChecksums || ({
                 CycleCounter<uint64_t> _(&verifyChecksumTicks);
                 recoverSafeVer.checkIntegrity();
             });
@@ -903,6 +1445,8 @@ ObjectManager::replaySegment(SideLog* sideLog, SegmentIterator& it,
             it.appendToBuffer(buffer);
 
             RpcResult rpcResult(buffer);
+            if (!shard.contains(rpcResult.getKeyHash()))
+                continue;
 
             if (unackedRpcResults->shouldRecover(rpcResult.getLeaseId(),
                                                  rpcResult.getRpcId(),
@@ -944,8 +1488,10 @@ ObjectManager::replaySegment(SideLog* sideLog, SegmentIterator& it,
             const void *pKey = op.object.getKey(0, &pKeyLen);
 
             Key key(op.object.header.tableId, pKey, pKeyLen);
+            if (!shard.contains(key.getHash()))
+                continue;
 
-            if (expect_false(!op.checkIntegrity())) {
+            if (expect_false(verifyChecksums && !op.checkIntegrity())) {
                 LOG(WARNING, "bad preparedOp checksum! key: %s, leaseId: %lu"
                              ", rpcId: %lu",
                              key.toString().c_str(),
@@ -1000,8 +1546,11 @@ ObjectManager::replaySegment(SideLog* sideLog, SegmentIterator& it,
             it.appendToBuffer(buffer);
 
             PreparedOpTombstone opTomb(buffer, 0);
+            if (!shard.contains(opTomb.header.keyHash))
+                continue;
 
-            if (expect_false(!opTomb.checkIntegrity())) {
+            if (expect_false(verifyChecksums &&
+                    !opTomb.checkIntegrity())) {
                 LOG(WARNING, "bad preparedOpTombstone checksum! tableId: %lu, "
                              "keyHash: %lu, leaseId: %lu, rpcId: %lu",
                              opTomb.header.tableId,
@@ -1041,12 +1590,14 @@ ObjectManager::replaySegment(SideLog* sideLog, SegmentIterator& it,
                                             opTomb.header.rpcId);
             }
         } else if (type == LOG_ENTRY_TYPE_TXDECISION) {
+            if (!shard.handlesUnkeyed())
+                continue;
             Buffer buffer;
             it.appendToBuffer(buffer);
 
             TxDecisionRecord record(buffer);
 
-            bool checksumIsValid = ({
+            bool checksumIsValid = !verifyChecksums || ({
                 CycleCounter<uint64_t> c(&verifyChecksumTicks);
                 record.checkIntegrity();
             });
@@ -1065,12 +1616,14 @@ ObjectManager::replaySegment(SideLog* sideLog, SegmentIterator& it,
                                       1);
             }
         } else if (type == LOG_ENTRY_TYPE_TXPLIST) {
+            if (!shard.handlesUnkeyed())
+                continue;
             Buffer buffer;
             it.appendToBuffer(buffer);
 
             ParticipantList participantList(buffer);
 
-            bool checksumIsValid = ({
+            bool checksumIsValid = !verifyChecksums || ({
                 CycleCounter<uint64_t> c(&verifyChecksumTicks);
                 participantList.checkIntegrity();
             });
@@ -1130,17 +1683,129 @@ ObjectManager::replaySegment(SideLog* sideLog, SegmentIterator& it,
     metrics->master.safeVersionNonRecoveryCount += safeVersionNonRecoveryCount;
 }
 
+/**
+ * Put a table in cache mode, or take it out. The data in a cache table can
+ * be lost without harm, so writes to it return without waiting for their
+ * log entries to reach backups (the entries are still replicated along
+ * with the rest of the log), and the table's memory on this master is
+ * bounded: once its log records take more than the quota, the cleaner
+ * drops its objects, without tombstones, instead of relocating them. The
+ * cleaner cleans the segments that have gone longest without changing, so
+ * the objects evicted are roughly the least recently written ones. When
+ * memory fills up, the cleaner thus makes room by evicting cache data
+ * instead of relocating it.
+ *
+ * Like a TTL (see setTableTtl), cache mode is part of this master's state
+ * and must be set again on masters that later take over tablets of the
+ * table. Since evictions write no tombstones, recovery may bring back
+ * older versions of evicted objects.
+ *
+ * \param tableId
+ *      The table to change.
+ * \param quotaBytes
+ *      Bytes of log records the table may hold on this master before its
+ *      objects are evicted. 0 takes the table out of cache mode.
+ */
+void
+ObjectManager::setTableCacheQuota(uint64_t tableId, uint64_t quotaBytes)
+{
+    MasterTableMetadata::Entry* entry =
+            masterTableMetadata->findOrCreate(tableId);
+    entry->cacheQuotaBytes = quotaBytes;
+    LOG(NOTICE, "Table %lu now has a cache quota of %lu bytes (0 means it "
+            "isn't a cache)", tableId, quotaBytes);
+    if (quotaBytes != 0)
+        anyCacheTable = true;
+}
+
+/**
+ * Set how durable writes to a table must be before they are acknowledged.
+ * The log is shared by all tables, so every write is still replicated to
+ * all of this master's backups; but a write to a table with a lower level
+ * is acknowledged as soon as \a ackReplicas backups have it, rather than
+ * waiting for the slowest backup, and with a level of 0 it is acknowledged
+ * as soon as it is in this master's log. Data that is acknowledged but not
+ * yet on every backup can be lost if this master and the backups that have
+ * it all crash.
+ *
+ * Like a TTL (see setTableTtl), the level is part of this master's state
+ * and must be set on every master that holds part of the table.
+ *
+ * \param tableId
+ *      The table whose durability to set.
+ * \param ackReplicas
+ *      Number of replicas a write must reach before it is acknowledged.
+ *      Values at least as large as the master's replication factor restore
+ *      the default of waiting for all of them.
+ */
+void
+ObjectManager::setTableDurability(uint64_t tableId, uint32_t ackReplicas)
+{
+    MasterTableMetadata::Entry* entry =
+            masterTableMetadata->findOrCreate(tableId);
+    entry->ackReplicas = ackReplicas;
+    LOG(NOTICE, "Writes to table %lu are now acknowledged once %u replicas "
+            "are durable", tableId, ackReplicas);
+    anyTableDurability = true;
+}
+
+/**
+ * Make the objects in a table expire a given time after they were last
+ * written. Expired objects can't be read, and their space is reclaimed
+ * without writing tombstones: the cleaner drops them instead of relocating
+ * them, and a background sweep removes them from segments that aren't
+ * being cleaned (see ExpiredObjectRemover).
+ *
+ * A TTL is part of this master's state, not of the table's metadata on the
+ * coordinator, so it must be set on every master that holds part of the
+ * table (RamCloud::setTableTtl does this) and set again on masters that
+ * later take over tablets of the table, such as recovery masters.
+ * Shortening a table's TTL can make current objects disappear at once, and
+ * lengthening it may make versions that expired before a crash visible
+ * again after recovery, since removing expired objects writes no
+ * tombstones.
+ *
+ * \param tableId
+ *      The table whose objects expire.
+ * \param ttlSeconds
+ *      Objects expire this many seconds after they were last written.
+ *      0 means they never expire.
+ */
+void
+ObjectManager::setTableTtl(uint64_t tableId, uint32_t ttlSeconds)
+{
+    MasterTableMetadata::Entry* entry =
+            masterTableMetadata->findOrCreate(tableId);
+    entry->ttlSeconds = ttlSeconds;
+    LOG(NOTICE, "Objects in table %lu now expire after %u seconds (0 means "
+            "never)", tableId, ttlSeconds);
+    if (ttlSeconds == 0)
+        return;
+    anyTableTtl = true;
+    if (!expiredObjectRemover.isRunning())
+        expiredObjectRemover.start(0);
+}
+
 /**
  * Sync any previous writes or removes. This operation is required after any
  * writeObject() or removeObject() invocation if the caller wants to ensure that
  * the change is committed to stable storage. Prior to invoking this, no
  * guarantees are made about the consistency of backup and master views of the
  * log since the previous syncChanges() operation.
+ *
+ * \param ackReplicas
+ *      Return once this many replicas of the changes are durable (see
+ *      getTableDurability). The default waits for all of them.
  */
 void
-ObjectManager::syncChanges()
+ObjectManager::syncChanges(uint32_t ackReplicas)
 {
-    log.sync();
+    if (ackReplicas == 0)
+        return;
+    if (ackReplicas == ~0u)
+        log.sync();
+    else
+        log.syncReplicas(ackReplicas);
 }
 
 /**
@@ -1189,6 +1854,50 @@ Status
 ObjectManager::writeObject(Object& newObject, RejectRules* rejectRules,
                 uint64_t* outVersion, Buffer* removedObjBuffer,
                 RpcResult* rpcResult, uint64_t* rpcResultPtr)
+{
+    return writeObject(newObject, rejectRules, outVersion, removedObjBuffer,
+            &rpcResult, rpcResultPtr, rpcResult ? 1U : 0U);
+}
+
+/**
+ * This form of writeObject appends any number of RpcResults atomically with
+ * the new object. It is used when one write carries out several RPCs (see
+ * MasterService::combineIncrement), each of which needs its own
+ * linearizability record.
+ *
+ * \param newObject
+ *      The new object to be written to the log; see the other form.
+ * \param rejectRules
+ *      Specifies conditions under which the write should be aborted with an
+ *      error. May be NULL if no special reject conditions are desired.
+ * \param[out] outVersion
+ *      If non-NULL, the version number of the new object (or the current
+ *      version, on failure) is returned here; see the other form.
+ * \param[out] removedObjBuffer
+ *      If non-NULL, pointer to the buffer in log for the object being removed
+ *      is returned.
+ * \param rpcResults
+ *      Array of rpcResultCount RpcResults to append to the log atomically
+ *      with the other record(s) for the write.
+ * \param[out] rpcResultPtrs
+ *      If non-NULL, an array of rpcResultCount entries; the log reference of
+ *      each RpcResult is returned in the corresponding entry.
+ * \param rpcResultCount
+ *      Number of entries in rpcResults (may be 0).
+ * \param[out] resultVersions
+ *      If non-NULL, an array of rpcResultCount pointers. The new object's
+ *      version is stored through each of them before the RpcResults are
+ *      assembled, so that responses which refer to those locations record
+ *      the version.
+ * \return
+ *      STATUS_OK if the object was written. Otherwise, for example,
+ *      STATUS_UKNOWN_TABLE may be returned.
+ */
+Status
+ObjectManager::writeObject(Object& newObject, RejectRules* rejectRules,
+                uint64_t* outVersion, Buffer* removedObjBuffer,
+                RpcResult** rpcResults, uint64_t* rpcResultPtrs,
+                uint32_t rpcResultCount, uint64_t** resultVersions)
 {
     uint16_t keyLength = 0;
     const void *keyString = newObject.getKey(0, &keyLength);
@@ -1276,7 +1985,7 @@ ObjectManager::writeObject(Object& newObject, RejectRules* rejectRules,
     // for the old deleted version. Both cases lead to consistency problems.
     // The same argument holds for linearizability records; the linearizability
     // record should exist if and only if new object is written.
-    Log::AppendVector appends[2 + (rpcResult ? 1 : 0)];
+    Log::AppendVector appends[2 + rpcResultCount];
 
     newObject.assembleForLog(appends[0].buffer);
     appends[0].type = LOG_ENTRY_TYPE_OBJ;
@@ -1295,13 +2004,15 @@ ObjectManager::writeObject(Object& newObject, RejectRules* rejectRules,
     if (outVersion != NULL)
         *outVersion = newObject.getVersion();
 
-    int rpcResultIndex = 1 + (tombstone ? 1 : 0);
-    if (rpcResult) {
-        rpcResult->assembleForLog(appends[rpcResultIndex].buffer);
-        appends[rpcResultIndex].type = LOG_ENTRY_TYPE_RPCRESULT;
+    uint32_t rpcResultIndex = 1 + (tombstone ? 1 : 0);
+    for (uint32_t i = 0; i < rpcResultCount; i++) {
+        if (resultVersions != NULL)
+            *resultVersions[i] = newObject.getVersion();
+        rpcResults[i]->assembleForLog(appends[rpcResultIndex + i].buffer);
+        appends[rpcResultIndex + i].type = LOG_ENTRY_TYPE_RPCRESULT;
     }
 
-    if (!log.append(appends, (tombstone ? 2 : 1) + (rpcResult ? 1 : 0))) {
+    if (!log.append(appends, rpcResultIndex + rpcResultCount)) {
         // The log is out of space. Tell the client to retry and hope
         // that the cleaner makes space soon.
         throw RetryException(HERE, 1000, 2000, "Must wait for cleaner");
@@ -1309,13 +2020,19 @@ ObjectManager::writeObject(Object& newObject, RejectRules* rejectRules,
 
     if (tombstone) {
         currentHashTableEntry.setReference(appends[0].reference.toInteger());
-        log.free(currentReference);
+        retireVersion(key, currentVersion, currentReference, newObjectVersion);
     } else {
         objectMap.insert(key.getHash(), appends[0].reference.toInteger());
+        retireVersion(key, VERSION_NONEXISTENT, Log::Reference(),
+                newObjectVersion);
     }
 
-    if (rpcResult && rpcResultPtr)
-        *rpcResultPtr = appends[rpcResultIndex].reference.toInteger();
+    if (rpcResultPtrs != NULL) {
+        for (uint32_t i = 0; i < rpcResultCount; i++) {
+            rpcResultPtrs[i] =
+                    appends[rpcResultIndex + i].reference.toInteger();
+        }
+    }
 
     tabletManager->incrementWriteCount(key);
     ++PerfStats::threadStats.writeCount;
@@ -1331,9 +2048,9 @@ ObjectManager::writeObject(Object& newObject, RejectRules* rejectRules,
         TEST_LOG("tombstone: %u bytes, version %lu",
             appends[1].buffer.size(), tombstone->getObjectVersion());
     }
-    if (rpcResult) {
+    for (uint32_t i = 0; i < rpcResultCount; i++) {
         TEST_LOG("rpcResult: %u bytes",
-            appends[rpcResultIndex].buffer.size());
+            appends[rpcResultIndex + i].buffer.size());
     }
 
     {
@@ -1343,8 +2060,8 @@ ObjectManager::writeObject(Object& newObject, RejectRules* rejectRules,
             byteCount += appends[1].buffer.size();
             recordCount += 1;
         }
-        if (rpcResult) {
-            byteCount += appends[rpcResultIndex].buffer.size();
+        for (uint32_t i = 0; i < rpcResultCount; i++) {
+            byteCount += appends[rpcResultIndex + i].buffer.size();
             recordCount += 1;
         }
 
@@ -1979,7 +2696,7 @@ ObjectManager::commitRemove(PreparedOp& op,
     }
 
     segmentManager.raiseSafeVersion(object.getVersion() + 1);
-    log.free(reference);
+    retireVersion(key, object.getVersion(), reference, VERSION_NONEXISTENT);
     log.free(refToPreparedOp);
     preparedOps->removeOp(op.header.clientId, op.header.rpcId);
     remove(lock, key);
@@ -2099,25 +2816,257 @@ ObjectManager::commitWrite(PreparedOp& op,
                      refToPreparedOp.toInteger());
     }
 
-    TableStats::increment(masterTableMetadata,
-                          prepOpTombstone.header.tableId,
-                          byteCount,
-                          recordCount);
-    ++PerfStats::threadStats.writeCount;
-    uint32_t valueLength = op.object.getValueLength();
-    PerfStats::threadStats.writeObjectBytes += valueLength;
-    PerfStats::threadStats.writeKeyBytes +=
-            op.object.getKeysAndValueLength() - valueLength;
-
-    log.free(refToPreparedOp);
-    preparedOps->removeOp(op.header.clientId, op.header.rpcId);
+    TableStats::increment(masterTableMetadata,
+                          prepOpTombstone.header.tableId,
+                          byteCount,
+                          recordCount);
+    ++PerfStats::threadStats.writeCount;
+    uint32_t valueLength = op.object.getValueLength();
+    PerfStats::threadStats.writeObjectBytes += valueLength;
+    PerfStats::threadStats.writeKeyBytes +=
+            op.object.getKeysAndValueLength() - valueLength;
+
+    log.free(refToPreparedOp);
+    preparedOps->removeOp(op.header.clientId, op.header.rpcId);
+
+    if (!newKey) {
+        currentHashTableEntry.setReference(appends[1].reference.toInteger());
+        retireVersion(key, oldObject->getVersion(), oldReference,
+                op.object.getVersion());
+    } else {
+        objectMap.insert(key.getHash(), appends[1].reference.toInteger());
+        retireVersion(key, VERSION_NONEXISTENT, Log::Reference(),
+                op.object.getVersion());
+    }
+    return STATUS_OK;
+}
+
+/**
+ * Commit all of the operations of a transaction at once, for transactions
+ * whose objects are all stored on this master. This is equivalent to
+ * preparing each operation and then committing them, but the operations
+ * are validated with all of their hash table buckets locked, and the new
+ * objects, tombstones, and RpcResults are appended to the log in a single
+ * atomic append; no PreparedOps are written and no transaction locks are
+ * taken.
+ *
+ * \param ops
+ *      The operations of the transaction; only READ, REMOVE, and WRITE
+ *      operations are allowed. Their objects don't have valid versions or
+ *      timestamps; this method fills them in for the writes.
+ * \param rejectRules
+ *      Conditions under which each operation (in the same position in
+ *      \a ops) should cause the transaction to abort.
+ * \param rpcResults
+ *      Record of the outcome of each operation, to ensure linearizability;
+ *      appended to the log along with the operations if the transaction
+ *      commits.
+ * \param[out] rpcResultPtrs
+ *      If the transaction commits, the log references of the entries in
+ *      \a rpcResults are returned here.
+ * \param[out] isCommitVote
+ *      Set to true if the transaction committed, or false if it must abort
+ *      (an object was locked by another transaction or a reject rule
+ *      applied). Nothing is written to the log in the latter case.
+ * \return
+ *      STATUS_OK if the transaction either committed or must abort.
+ *      Otherwise, for example, STATUS_UNKNOWN_TABLET may be returned, in
+ *      which case nothing was written.
+ *
+ * \throw RetryException
+ *      The log is out of space.
+ */
+Status
+ObjectManager::commitTransaction(std::vector<PreparedOp*>& ops,
+        std::vector<RejectRules*>& rejectRules,
+        std::vector<RpcResult*>& rpcResults,
+        std::vector<uint64_t>* rpcResultPtrs, bool* isCommitVote)
+{
+    *isCommitVote = false;
+    size_t numOps = ops.size();
+
+    // Lock the hash table buckets of all of the keys at once. The locks are
+    // taken in order of their index (so that concurrent transactions can't
+    // deadlock), and each just once, since keys may share a lock.
+    uint64_t numLocks = arrayLength(hashTableBucketLocks);
+    std::deque<Key> keys;
+    std::vector<uint64_t> lockIndexes;
+    foreach (PreparedOp* op, ops) {
+        uint16_t keyLength = 0;
+        const void* keyString = op->object.getKey(0, &keyLength);
+        keys.emplace_back(op->object.getTableId(), keyString, keyLength);
+        uint64_t unused;
+        lockIndexes.push_back(HashTable::findBucketIndex(
+                objectMap.getNumBuckets(), keys.back().getHash(), &unused)
+                & (numLocks - 1));
+    }
+    std::vector<uint64_t> sortedLockIndexes(lockIndexes);
+    std::sort(sortedLockIndexes.begin(), sortedLockIndexes.end());
+    sortedLockIndexes.erase(std::unique(sortedLockIndexes.begin(),
+            sortedLockIndexes.end()), sortedLockIndexes.end());
+    std::deque<HashTableBucketLock> locks;
+    foreach (uint64_t lockIndex, sortedLockIndexes)
+        locks.emplace_back(*this, lockIndex);
+
+    // Validate every operation before changing anything.
+    Buffer oldBuffers[numOps];
+    Log::Reference oldReferences[numOps];
+    bool oldExists[numOps];
+    uint32_t numAppends = 0;
+    for (size_t i = 0; i < numOps; i++) {
+        HashTableBucketLock& lock = locks[std::lower_bound(
+                sortedLockIndexes.begin(), sortedLockIndexes.end(),
+                lockIndexes[i]) - sortedLockIndexes.begin()];
+        Key& key = keys[i];
+
+        // If the tablet doesn't exist in the NORMAL state, we must plead
+        // ignorance.
+        TabletManager::Tablet tablet;
+        if (!tabletManager->getTablet(key, &tablet))
+            return STATUS_UNKNOWN_TABLET;
+        if (tablet.state != TabletManager::NORMAL)
+            return STATUS_UNKNOWN_TABLET;
+
+        // Abort if another transaction has prepared the key (or if this
+        // one names it twice, as a prepare would).
+        if (lockTable.isLockAcquired(key) ||
+                std::find(keys.begin(), keys.begin() + i, key) !=
+                keys.begin() + i) {
+            RAMCLOUD_LOG(DEBUG, "TxCommit fail. Key: %.*s, object is already "
+                    "locked", key.getStringKeyLength(),
+                    reinterpret_cast<const char*>(key.getStringKey()));
+            return STATUS_OK;
+        }
+
+        LogEntryType currentType = LOG_ENTRY_TYPE_INVALID;
+        uint64_t currentVersion = VERSION_NONEXISTENT;
+        oldExists[i] = false;
+        if (lookup(lock, key, currentType, oldBuffers[i], 0,
+                   &oldReferences[i])) {
+            if (currentType == LOG_ENTRY_TYPE_OBJTOMB) {
+                removeIfTombstone(oldReferences[i].toInteger(), this);
+            } else {
+                Object currentObject(oldBuffers[i]);
+                currentVersion = currentObject.getVersion();
+                oldExists[i] = true;
+            }
+        }
+
+        Status status = rejectOperation(rejectRules[i], currentVersion);
+        if (status != STATUS_OK) {
+            RAMCLOUD_LOG(DEBUG, "TxCommit fail. Type: %d Key: %.*s, "
+                    "RejectRule outcome: %s", ops[i]->header.type,
+                    key.getStringKeyLength(),
+                    reinterpret_cast<const char*>(key.getStringKey()),
+                    statusToString(status));
+            return STATUS_OK;
+        }
+
+        numAppends++;
+        if (ops[i]->header.type == WireFormat::TxPrepare::WRITE) {
+            // Existing objects get a bump in version, new objects start
+            // from the next version allocated in the table.
+            ops[i]->object.setVersion((currentVersion == VERSION_NONEXISTENT)
+                    ? segmentManager.allocateVersion() : currentVersion + 1);
+            ops[i]->object.setTimestamp(WallTime::secondsTimestamp());
+            numAppends++;
+        }
+        if (ops[i]->header.type != WireFormat::TxPrepare::READ && oldExists[i])
+            numAppends++;
+    }
+
+    // Every operation may proceed: log all of the new entries at once.
+    Log::AppendVector appends[numAppends];
+    int objectIndexes[numOps];
+    uint32_t numBytes = 0;
+    uint32_t n = 0;
+    for (size_t i = 0; i < numOps; i++) {
+        rpcResults[i]->assembleForLog(appends[n].buffer);
+        appends[n].type = LOG_ENTRY_TYPE_RPCRESULT;
+        n++;
+
+        objectIndexes[i] = -1;
+        if (ops[i]->header.type == WireFormat::TxPrepare::WRITE) {
+            ops[i]->object.assembleForLog(appends[n].buffer);
+            appends[n].type = LOG_ENTRY_TYPE_OBJ;
+            numBytes += appends[n].buffer.size();
+            objectIndexes[i] = n;
+            n++;
+        }
+        if (ops[i]->header.type != WireFormat::TxPrepare::READ &&
+                oldExists[i]) {
+            Object oldObject(oldBuffers[i]);
+            ObjectTombstone tombstone(oldObject,
+                                      log.getSegmentId(oldReferences[i]),
+                                      WallTime::secondsTimestamp());
+            tombstone.assembleForLog(appends[n].buffer);
+            appends[n].type = LOG_ENTRY_TYPE_OBJTOMB;
+            n++;
+        }
+    }
+    assert(n == numAppends);
+
+    if (!log.hasSpaceFor(numBytes)) {
+        // We must bound the amount of live data to ensure deletes are possible
+        throw RetryException(HERE, 1000, 2000, "Log is out of space!");
+    }
+
+    if (!log.append(appends, numAppends)) {
+        // The log is out of space. Tell the client to retry and hope
+        // that either the cleaner makes space soon or we shift load
+        // off of this server.
+        return STATUS_RETRY;
+    }
+
+    // Point the hash table at the new objects and free the old ones.
+    n = 0;
+    for (size_t i = 0; i < numOps; i++) {
+        HashTableBucketLock& lock = locks[std::lower_bound(
+                sortedLockIndexes.begin(), sortedLockIndexes.end(),
+                lockIndexes[i]) - sortedLockIndexes.begin()];
+        uint64_t byteCount = appends[n].buffer.size();
+        uint64_t recordCount = 1;
+        rpcResultPtrs->push_back(appends[n].reference.toInteger());
+        n++;
+
+        uint64_t newVersion = VERSION_NONEXISTENT;
+        if (objectIndexes[i] >= 0) {
+            Log::AppendVector& append = appends[objectIndexes[i]];
+            replace(lock, keys[i], append.reference);
+            newVersion = ops[i]->object.getVersion();
+            byteCount += append.buffer.size();
+            recordCount++;
+            n++;
+
+            ++PerfStats::threadStats.writeCount;
+            uint32_t valueLength = ops[i]->object.getValueLength();
+            PerfStats::threadStats.writeObjectBytes += valueLength;
+            PerfStats::threadStats.writeKeyBytes +=
+                    ops[i]->object.getKeysAndValueLength() - valueLength;
+        }
+        if (ops[i]->header.type != WireFormat::TxPrepare::READ &&
+                oldExists[i]) {
+            byteCount += appends[n].buffer.size();
+            recordCount++;
+            n++;
+
+            Object oldObject(oldBuffers[i]);
+            if (objectIndexes[i] < 0) {
+                segmentManager.raiseSafeVersion(oldObject.getVersion() + 1);
+                remove(lock, keys[i]);
+            }
+            retireVersion(keys[i], oldObject.getVersion(), oldReferences[i],
+                    newVersion);
+        } else if (objectIndexes[i] >= 0) {
+            retireVersion(keys[i], VERSION_NONEXISTENT, Log::Reference(),
+                    newVersion);
+        }
 
-    if (!newKey) {
-        currentHashTableEntry.setReference(appends[1].reference.toInteger());
-        log.free(oldReference);
-    } else {
-        objectMap.insert(key.getHash(), appends[1].reference.toInteger());
+        TableStats::increment(masterTableMetadata, keys[i].getTableId(),
+                              byteCount, recordCount);
     }
+
+    *isCommitVote = true;
     return STATUS_OK;
 }
 
@@ -2379,6 +3328,16 @@ ObjectManager::prepareForLog(Object& newObject, Buffer *logBuffer,
  * Write a tombstone including the corresponding log entry header
  * into a buffer based on the primary key of the object.
  *
+ * Tombstones are appended to the head rather than recorded against the
+ * segment holding the deleted object (e.g. as a per-segment dead-entry
+ * bitmap) because replicas of closed segments are immutable on backups:
+ * any such bitmap would need its own replication and ordering rules
+ * against the head during recovery, replaySegment() would have to fetch
+ * it before replaying the object's segment, and it would still have to
+ * outlive that segment's cleaning in the same way tombstones do now. The
+ * cleaner's tombstone scanning (see CleanableSegmentManager) is what keeps
+ * their space overhead in check.
+ *
  * \param key
  *      Key of the object for which a tombstone needs to be written.
  * \param [out] logBuffer
@@ -2489,6 +3448,25 @@ ObjectManager::relocate(LogEntryType type, Buffer& oldBuffer,
         relocateTxParticipantList(oldBuffer, relocator);
 }
 
+/**
+ * The cleaner calls this method a few entries ahead of passing an entry to
+ * relocate(). For objects and tombstones it prefetches the hash table bucket
+ * that relocate() will scan to decide whether the entry is still alive.
+ *
+ * \param type
+ *      Type of the entry that will soon be relocated.
+ * \param buffer
+ *      Buffer pointing to the entry in the log.
+ */
+void
+ObjectManager::prefetchForRelocation(LogEntryType type, Buffer& buffer)
+{
+    if (type == LOG_ENTRY_TYPE_OBJ || type == LOG_ENTRY_TYPE_OBJTOMB) {
+        Key key(type, buffer);
+        objectMap.prefetchBucket(key.getHash());
+    }
+}
+
 /**
  * Clean tombstones from #objectMap lazily and in the background.
  *
@@ -2533,6 +3511,163 @@ ObjectManager::TombstoneRemover::handleTimerEvent()
     start(0);
 }
 
+/**
+ * Construct a HashTableResizer. The resizer doesn't do anything until
+ * it is started.
+ *
+ * \param objectManager
+ *      The instance of ObjectManager that owns the #objectMap.
+ * \param objectMap
+ *      The HashTable that will be grown.
+ * \param maxBytes
+ *      Upper limit on the size of the table's buckets, in bytes. If this is
+ *      no larger than the table's current size, the table never grows.
+ */
+ObjectManager::HashTableResizer::HashTableResizer(
+                ObjectManager* objectManager,
+                HashTable* objectMap,
+                uint64_t maxBytes)
+    : WorkerTimer(objectManager->context->dispatch)
+    , objectManager(objectManager)
+    , objectMap(objectMap)
+    , maxBuckets(maxBytes / HashTable::bytesPerCacheLine())
+    , splits(0)
+{
+    if (maxBuckets <= objectMap->getNumBuckets()) {
+        maxBuckets = 0;
+        return;
+    }
+
+    // Splitting a bucket holds only its HashTableBucketLock. That is safe
+    // only if every bucket's lock also protects the bucket split off from
+    // it, which requires the table to have at least as many buckets as
+    // there are locks (see HashTable::getSplitBucketIndex).
+    uint64_t numLocks = arrayLength(objectManager->hashTableBucketLocks);
+    if (objectMap->getNumBuckets() < numLocks) {
+        LOG(WARNING, "Hash table has only %lu buckets (fewer than %lu bucket "
+                "locks); online resizing disabled",
+                objectMap->getNumBuckets(), numLocks);
+        maxBuckets = 0;
+    }
+}
+
+/**
+ * Split a batch of hash table buckets if the table's load factor is too
+ * high, then reschedule ourselves.
+ */
+void
+ObjectManager::HashTableResizer::handleTimerEvent()
+{
+    if (maxBuckets == 0)
+        return;
+
+    for (int i = 0; i < SPLITS_PER_EVENT; i++) {
+        if (objectMap->getNumBuckets() >= maxBuckets ||
+                objectMap->getLoadFactor() * 100 < GROW_LOAD_FACTOR_PERCENT) {
+            // Nothing to do for now; check again later.
+            start(Cycles::rdtsc() +
+                  Cycles::fromNanoseconds(POLL_INTERVAL_MS * 1000000UL));
+            return;
+        }
+
+        // Allocating new buckets can take a while, so do it before locking.
+        objectMap->prepareSplit();
+        HashTableBucketLock lock(*objectManager,
+                                 objectMap->getSplitBucketIndex());
+        objectMap->splitBucket(getKeyHashForReference, objectManager);
+        splits++;
+        if (BitOps::isPowerOfTwo(objectMap->getNumBuckets())) {
+            LOG(NOTICE, "Hash table grew to %lu buckets (load factor %.2f)",
+                objectMap->getNumBuckets(), objectMap->getLoadFactor());
+        }
+    }
+
+    // The table still needs to grow. Reschedule ourselves to run again,
+    // after any other WorkerTimers that may be ready.
+    start(0);
+}
+
+/**
+ * Construct a VersionCollector. The collector doesn't do anything until
+ * it is started.
+ *
+ * \param objectManager
+ *      The instance of ObjectManager that owns the version history.
+ */
+ObjectManager::VersionCollector::VersionCollector(
+                ObjectManager* objectManager)
+    : WorkerTimer(objectManager->context->dispatch)
+    , objectManager(objectManager)
+{
+}
+
+/**
+ * Drop the versions that snapshot reads can no longer see from part of the
+ * version history, free their log entries, and reschedule ourselves.
+ */
+void
+ObjectManager::VersionCollector::handleTimerEvent()
+{
+    std::vector<uint64_t> freed;
+    {
+        // Freed with the history's lock held; see retireVersion.
+        SpinLock::Guard guard(objectManager->versionHistory.mutex);
+        objectManager->versionHistory.collect(
+                objectManager->getSnapshotWatermark(), BUCKETS_PER_EVENT,
+                &freed, guard);
+        foreach (uint64_t reference, freed)
+            objectManager->log.free(Log::Reference(reference));
+    }
+    if (freed.size() > 0)
+        TEST_LOG("freed %lu old versions", freed.size());
+
+    start(Cycles::rdtsc() +
+          Cycles::fromNanoseconds(POLL_INTERVAL_MS * 1000000UL));
+}
+
+/**
+ * Construct an ExpiredObjectRemover. The remover doesn't do anything until
+ * it is started.
+ *
+ * \param objectManager
+ *      The instance of ObjectManager whose hash table is swept.
+ */
+ObjectManager::ExpiredObjectRemover::ExpiredObjectRemover(
+                ObjectManager* objectManager)
+    : WorkerTimer(objectManager->context->dispatch)
+    , objectManager(objectManager)
+    , currentBucket(0)
+    , removed(0)
+{
+}
+
+/**
+ * Remove the expired objects from a few buckets of the hash table and then
+ * reschedule ourselves; once the whole table has been swept, start over.
+ */
+void
+ObjectManager::ExpiredObjectRemover::handleTimerEvent()
+{
+    HashTable* objectMap = &objectManager->objectMap;
+    for (int i = 0; i < BUCKETS_PER_EVENT; i++) {
+        if (currentBucket >= objectMap->getNumBuckets()) {
+            if (removed > 0)
+                LOG(NOTICE, "Removed %lu expired objects", removed);
+            currentBucket = 0;
+            removed = 0;
+            break;
+        }
+
+        HashTableBucketLock lock(*objectManager, currentBucket);
+        CleanupParameters params = { objectManager, &lock };
+        objectMap->forEachInBucket(removeIfExpired, &params, currentBucket);
+        ++currentBucket;
+    }
+
+    start(Cycles::rdtsc() +
+          Cycles::fromNanoseconds(INTERVAL_MS * 1000000UL));
+}
+
 /**
  * Constructor for TombstoneProtectors. Make sure the tombstone
  * remover isn't running.
@@ -2560,6 +3695,21 @@ ObjectManager::TombstoneProtector::~TombstoneProtector()
     }
 }
 
+/**
+ * Return true if the entries for keys with the given hash belong to this
+ * shard.
+ */
+bool
+ObjectManager::ReplayShard::contains(KeyHash keyHash) const
+{
+    if (count == 1)
+        return true;
+    uint64_t secondaryHash;
+    uint64_t bucket = HashTable::findBucketIndex(numBuckets, keyHash,
+                                                 &secondaryHash);
+    return bucket * count / numBuckets == index;
+}
+
 /**
  * Produce a human-readable description of the contents of a segment.
  * Intended primarily for use in unit tests.
@@ -2680,6 +3830,108 @@ ObjectManager::getObjectTimestamp(Buffer& buffer)
     return object.getTimestamp();
 }
 
+/**
+ * Add up how much of the log each table uses (see MemoryAccounting). This
+ * reads every entry in the log (using MEMORY_USAGE_SCAN_THREADS threads),
+ * so it is only meant for occasional diagnostics and benchmarks; entries
+ * appended or moved by the cleaner while it runs may or may not be counted.
+ *
+ * \param accounting
+ *      Every entry in the log is added to this, along with the capacity of
+ *      the log, the size of the hash table, and the byte counts kept by
+ *      TableStats.
+ */
+void
+ObjectManager::getMemoryUsage(MemoryAccounting* accounting)
+{
+    std::vector<std::unique_ptr<MemoryUsageCounter>> counters;
+    std::vector<ParallelLogScan::Callback*> callbacks;
+    for (uint32_t i = 0; i < MEMORY_USAGE_SCAN_THREADS; i++) {
+        counters.emplace_back(new MemoryUsageCounter(this));
+        callbacks.push_back(counters.back().get());
+    }
+    ParallelLogScan scan(log);
+    scan.run(callbacks);
+    foreach (std::unique_ptr<MemoryUsageCounter>& counter, counters) {
+        accounting->merge(counter->accounting);
+    }
+    accounting->logCapacityBytes = allocator.getTotalBytes();
+    accounting->hashTableBytes = objectMap.getNumBuckets() *
+            HashTable::bytesPerCacheLine();
+    accounting->addTableStats(masterTableMetadata);
+}
+
+/**
+ * Count one log entry for getMemoryUsage.
+ *
+ * \param type
+ *      Type of the entry.
+ * \param buffer
+ *      The entry's contents.
+ * \param reference
+ *      Where the entry is in the log.
+ */
+void
+ObjectManager::MemoryUsageCounter::handleEntry(LogEntryType type,
+        Buffer& buffer, Log::Reference reference)
+{
+    // An object is live if the hash table refers to this copy of it; a
+    // tombstone is live until the segment holding its object is cleaned.
+    bool live = true;
+    if (type == LOG_ENTRY_TYPE_OBJ) {
+        Key key(type, buffer);
+        HashTableBucketLock lock(*objectManager, key);
+        LogEntryType currentType;
+        Buffer currentBuffer;
+        Log::Reference currentReference;
+        live = objectManager->lookup(lock, key, currentType, currentBuffer,
+                NULL, &currentReference) && (currentReference == reference);
+    } else if (type == LOG_ENTRY_TYPE_OBJTOMB) {
+        ObjectTombstone tombstone(buffer);
+        live = objectManager->log.segmentExists(tombstone.getSegmentId());
+    } else if (type == LOG_ENTRY_TYPE_PREPTOMB) {
+        PreparedOpTombstone opTomb(buffer, 0);
+        live = objectManager->log.segmentExists(opTomb.header.segmentId);
+    }
+    accounting.addEntry(type, buffer, live);
+}
+
+/**
+ * Return a time for snapshot reads (see readObjectAtTime) that see every
+ * write made on this master so far, and none made later.
+ *
+ * \return
+ *      An encoded ClusterTime, or 0 if snapshot reads are disabled.
+ */
+uint64_t
+ObjectManager::getSnapshotTime()
+{
+    if (clusterClock == NULL || config->master.snapshotVersions == 0)
+        return 0;
+
+    // Writes so far were timed at or before the clock's current time;
+    // advance the clock so that later writes are timed after the snapshot.
+    ClusterTime time = clusterClock->getTime() +
+            ClusterTimeDuration::fromNanoseconds(1);
+    clusterClock->updateClock(time);
+    return time.getEncoded();
+}
+
+/**
+ * Return the earliest cluster time at which snapshot reads may be made
+ * (encoded, as by ClusterTime::getEncoded). Older versions that are only
+ * seen by snapshots before this are collected. Only valid if #clusterClock
+ * isn't NULL.
+ */
+uint64_t
+ObjectManager::getSnapshotWatermark()
+{
+    // Cluster time is measured in nanoseconds.
+    uint64_t now = clusterClock->getTime().getEncoded();
+    uint64_t retention = config->master.snapshotRetentionMs * 1000000UL;
+    return (now > retention) ? now - retention : 0;
+}
+
 /**
  * Callback used by the Log to determine the age of Tombstone.
  *
@@ -2711,6 +3963,28 @@ ObjectManager::getTxDecisionRecordTimestamp(Buffer& buffer)
     return record.getTimestamp();
 }
 
+/**
+ * Callback used by HashTable::splitBucket to recover the full key hash of an
+ * entry in the hash table.
+ *
+ * \param reference
+ *      Log reference for an object or tombstone stored in #objectMap.
+ * \param cookie
+ *      The ObjectManager that owns #objectMap.
+ * \return
+ *      The hash of the entry's key.
+ */
+KeyHash
+ObjectManager::getKeyHashForReference(uint64_t reference, void *cookie)
+{
+    ObjectManager* objectManager = reinterpret_cast<ObjectManager*>(cookie);
+    Buffer buffer;
+    LogEntryType type = objectManager->log.getEntry(
+            Log::Reference(reference), buffer);
+    Key key(type, buffer);
+    return key.getHash();
+}
+
 /**
  * Look up an object in the hash table, then extract the entry from the
  * log. Since tombstones are stored in the hash table during recovery,
@@ -2751,6 +4025,22 @@ ObjectManager::lookup(HashTableBucketLock& lock, Key& key,
                 uint64_t* outVersion,
                 Log::Reference* outReference,
                 HashTable::Candidates* outCandidates)
+{
+    return lookupInBucket(key, outType, buffer, outVersion, outReference,
+            outCandidates);
+}
+
+/**
+ * This method does all of the work of #lookup(). Callers must either hold
+ * the key's hash table bucket lock, or read under a HashTableBucketSnapshot
+ * and discard the results if it doesn't validate. Parameters are the same as
+ * for #lookup().
+ */
+inline bool
+ObjectManager::lookupInBucket(Key& key, LogEntryType& outType, Buffer& buffer,
+                uint64_t* outVersion,
+                Log::Reference* outReference,
+                HashTable::Candidates* outCandidates)
 {
     HashTable::Candidates candidates;
     objectMap.lookup(key.getHash(), candidates);
@@ -2853,6 +4143,44 @@ ObjectManager::removeIfOrphanedObject(uint64_t reference, void *cookie)
     }
 }
 
+/**
+ * This function is a callback used by ExpiredObjectRemover to remove an
+ * object from the hash table and free its log entry if it has expired. No
+ * tombstone is written (see setTableTtl). Objects in tablets that aren't
+ * in the NORMAL state are left alone, so that the replay of a recovery
+ * doesn't bring back older versions of them.
+ *
+ * This function must be called with the appropriate HashTableBucketLock
+ * held.
+ */
+void
+ObjectManager::removeIfExpired(uint64_t reference, void *cookie)
+{
+    CleanupParameters* params = reinterpret_cast<CleanupParameters*>(cookie);
+    ObjectManager* objectManager = params->objectManager;
+    Buffer buffer;
+    LogEntryType type = objectManager->log.getEntry(Log::Reference(reference),
+            buffer);
+    if (type != LOG_ENTRY_TYPE_OBJ)
+        return;
+
+    Object object(buffer);
+    if (!objectManager->isExpired(object))
+        return;
+    Key key(type, buffer);
+    TabletManager::Tablet tablet;
+    if (!objectManager->tabletManager->getTablet(key, &tablet) ||
+            tablet.state != TabletManager::NORMAL)
+        return;
+
+    TEST_LOG("removing expired object at ref %lu", reference);
+    objectManager->segmentManager.raiseSafeVersion(object.getVersion() + 1);
+    bool r = objectManager->remove(*params->lock, key);
+    assert(r);
+    objectManager->log.free(Log::Reference(reference));
+    objectManager->expiredObjectRemover.removed++;
+}
+
 /**
  * This function is a callback used to purge the tombstones from the hash
  * table after a recovery has taken place. It is invoked by HashTable::
@@ -2878,13 +4206,15 @@ ObjectManager::removeIfTombstone(uint64_t maybeTomb, void *cookie)
         // following criteria:
         //  1) Tablet is not assigned to us (not in TabletManager, so we don't
         //     care about it).
-        //  2) Tablet is not in the RECOVERING state (replaySegment won't be
-        //     called for objects in that tablet anymore).
+        //  2) Tablet is not in the RECOVERING or READ_REPLICA state
+        //     (replaySegment won't be called for objects in that tablet
+        //     anymore).
         bool discard = false;
 
         TabletManager::Tablet tablet;
         if (!objectManager->tabletManager->getTablet(key, &tablet) ||
-          tablet.state != TabletManager::RECOVERING) {
+          (tablet.state != TabletManager::RECOVERING &&
+          tablet.state != TabletManager::READ_REPLICA)) {
             discard = true;
         }
 
@@ -2999,6 +4329,19 @@ ObjectManager::relocateObject(Buffer& oldBuffer, Log::Reference oldReference,
             continue;
         }
 
+        // An expired object, or one evicted from a cache table that is
+        // over its quota, is dropped rather than relocated, with no
+        // tombstone; later versions must still be numbered above it.
+        if (anyTableTtl || anyCacheTable) {
+            Object object(oldBuffer);
+            if (isExpired(object) ||
+                    isOverCacheQuota(object.getTableId())) {
+                segmentManager.raiseSafeVersion(object.getVersion() + 1);
+                candidates.remove();
+                break;
+            }
+        }
+
         // Try to relocate this live object. If we fail, just return. The
         // cleaner will allocate more memory and retry.
         if (!relocator.append(LOG_ENTRY_TYPE_OBJ, oldBuffer))
@@ -3008,6 +4351,20 @@ ObjectManager::relocateObject(Buffer& oldBuffer, Log::Reference oldReference,
         return;
     }
 
+    // Older versions kept for snapshot reads are live too. The history's
+    // lock is held throughout, so that the version can't be freed between
+    // checking and relocating it.
+    {
+        SpinLock::Guard guard(versionHistory.mutex);
+        if (versionHistory.isRetained(key, oldReference.toInteger(), guard)) {
+            if (!relocator.append(LOG_ENTRY_TYPE_OBJ, oldBuffer))
+                return;
+            versionHistory.relocate(key, oldReference.toInteger(),
+                    relocator.getNewReference().toInteger(), guard);
+            return;
+        }
+    }
+
     // No reference was found meaning object will be cleaned.  We should update
     // the stats accordingly.
     TableStats::decrement(masterTableMetadata,
@@ -3016,6 +4373,89 @@ ObjectManager::relocateObject(Buffer& oldBuffer, Log::Reference oldReference,
                           1);
 }
 
+/**
+ * Returns true if an object has outlived its table's TTL (see setTableTtl)
+ * and must be treated as if it didn't exist.
+ *
+ * \param object
+ *      The object to check.
+ */
+bool
+ObjectManager::isExpired(Object& object)
+{
+    if (!anyTableTtl)
+        return false;
+    MasterTableMetadata::Entry* entry =
+            masterTableMetadata->find(object.getTableId());
+    if (entry == NULL)
+        return false;
+    uint32_t ttlSeconds = entry->ttlSeconds;
+    if (ttlSeconds == 0)
+        return false;
+    return uint64_t(object.getTimestamp()) + ttlSeconds <=
+            WallTime::secondsTimestamp();
+}
+
+/**
+ * Returns true if a table is in cache mode (see setTableCacheQuota), so
+ * writes to it needn't wait for backups.
+ *
+ * \param tableId
+ *      The table to check.
+ */
+bool
+ObjectManager::isCacheTable(uint64_t tableId)
+{
+    if (!anyCacheTable)
+        return false;
+    MasterTableMetadata::Entry* entry = masterTableMetadata->find(tableId);
+    return (entry != NULL) && (entry->cacheQuotaBytes != 0);
+}
+
+/**
+ * Return how many replicas of a write to a table must be durable before the
+ * write is acknowledged (see setTableDurability): ~0u means all of them,
+ * and 0 (which is also the level of cache tables) means none.
+ *
+ * \param tableId
+ *      The table being written.
+ */
+uint32_t
+ObjectManager::getTableDurability(uint64_t tableId)
+{
+    if (!anyTableDurability && !anyCacheTable)
+        return ~0u;
+    MasterTableMetadata::Entry* entry = masterTableMetadata->find(tableId);
+    if (entry == NULL)
+        return ~0u;
+    if (entry->cacheQuotaBytes != 0)
+        return 0;
+    return entry->ackReplicas;
+}
+
+/**
+ * Returns true if a table is in cache mode and its log records on this
+ * master take more than its quota, so the cleaner should evict its objects
+ * (see setTableCacheQuota).
+ *
+ * \param tableId
+ *      The table to check.
+ */
+bool
+ObjectManager::isOverCacheQuota(uint64_t tableId)
+{
+    if (!anyCacheTable)
+        return false;
+    MasterTableMetadata::Entry* entry = masterTableMetadata->find(tableId);
+    if (entry == NULL)
+        return false;
+    uint64_t quotaBytes = entry->cacheQuotaBytes;
+    if (quotaBytes == 0)
+        return false;
+    SpinLock::Guard _(entry->stats.lock);
+    return entry->stats.byteCount > quotaBytes;
+}
+
 /**
  * Returns true iff the given key still points at the given reference.
  *
@@ -3394,4 +4834,43 @@ ObjectManager::replace(HashTableBucketLock& lock, Key& key,
     return false;
 }
 
+/**
+ * Called instead of freeing an object's log entry when the object has been
+ * overwritten or removed, and also when it is created. If snapshot reads are
+ * enabled, the old version is kept in #versionHistory for them (and freed
+ * once they can't need it); otherwise it is freed right away.
+ *
+ * \param key
+ *      The object's primary key. Its hash table bucket lock must be held.
+ * \param oldVersion
+ *      The version that was replaced, or VERSION_NONEXISTENT if the object
+ *      has just been created.
+ * \param oldReference
+ *      The log reference of the replaced version (ignored if it doesn't
+ *      exist).
+ * \param newVersion
+ *      The object's new version, or VERSION_NONEXISTENT if it was removed.
+ */
+void
+ObjectManager::retireVersion(Key& key, uint64_t oldVersion,
+                Log::Reference oldReference, uint64_t newVersion)
+{
+    uint32_t maxVersions = config->master.snapshotVersions;
+    if (clusterClock == NULL || maxVersions == 0) {
+        if (oldVersion != VERSION_NONEXISTENT)
+            log.free(oldReference);
+        return;
+    }
+
+    // Free while holding the history's lock, so that the cleaner can't
+    // treat the entries as dead before they are (see relocateObject).
+    std::vector<uint64_t> freed;
+    SpinLock::Guard guard(versionHistory.mutex);
+    versionHistory.record(key, oldVersion, oldReference.toInteger(),
+            newVersion, clusterClock->getTime().getEncoded(), maxVersions,
+            &freed, guard);
+    foreach (uint64_t reference, freed)
+        log.free(Log::Reference(reference));
+}
+
 } //enamespace RAMCloud
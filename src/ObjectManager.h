@@ -16,7 +16,10 @@
 #ifndef RAMCLOUD_OBJECTMANAGER_H
 #define RAMCLOUD_OBJECTMANAGER_H
 
+#include <atomic>
+
 #include "Common.h"
+#include "ClusterClock.h"
 #include "Log.h"
 #include "SideLog.h"
 #include "LogEntryHandlers.h"
@@ -36,6 +39,9 @@
 #include "MasterTableMetadata.h"
 #include "UnackedRpcResults.h"
 #include "LockTable.h"
+#include "MemoryAccounting.h"
+#include "ParallelLogScan.h"
+#include "VersionHistory.h"
 
 namespace RAMCloud {
 
@@ -62,30 +68,57 @@ class ObjectManager : public LogEntryHandlers,
                 MasterTableMetadata* masterTableMetadata,
                 UnackedRpcResults* unackedRpcResults,
                 PreparedOps* preparedOps,
-                TxRecoveryManager* txRecoveryManager);
+                TxRecoveryManager* txRecoveryManager,
+                ClusterClock* clusterClock = NULL);
     virtual ~ObjectManager();
     virtual void freeLogEntry(Log::Reference ref);
     void initOnceEnlisted();
 
+    Status bulkLoad(uint64_t tableId, void* segment, uint32_t length,
+                const SegmentCertificate& certificate, uint32_t* outObjects);
+
     void readHashes(const uint64_t tableId, uint32_t reqNumHashes,
                 Buffer* pKHashes, uint32_t initialPKHashesOffset,
                 uint32_t maxLength, Buffer* response, uint32_t* respNumHashes,
                 uint32_t* numObjects);
-    void prefetchHashTableBucket(SegmentIterator* it);
+    void getMemoryUsage(MemoryAccounting* accounting);
+    uint64_t getSnapshotTime();
     Status readObject(Key& key, Buffer* outBuffer,
                 RejectRules* rejectRules, uint64_t* outVersion,
-                bool valueOnly = false);
+                bool valueOnly = false, uint64_t oldestSync = ~0UL);
+    Status readObjectAtTime(Key& key, uint64_t snapshotTime,
+                Buffer* outBuffer, RejectRules* rejectRules,
+                uint64_t* outVersion, bool valueOnly = false);
+    void readObjects(uint32_t numObjects, Key** keys,
+                RejectRules* rejectRules, Buffer* outBuffer,
+                Status* outStatuses, uint64_t* outVersions,
+                uint32_t* outLengths, bool valueOnly = false);
     Status removeObject(Key& key, RejectRules* rejectRules,
                 uint64_t* outVersion, Buffer* removedObjBuffer = NULL,
                 RpcResult* rpcResult = NULL, uint64_t* rpcResultPtr = NULL);
     void removeOrphanedObjects();
+    class ReplayShard;
+    void prefetchHashTableBucket(const SegmentIterator::Entry& entry,
+                const ReplayShard* shard = NULL);
+    void replaySegment(SideLog* sideLog, SegmentIterator& it,
+                std::unordered_map<uint64_t, uint64_t>* nextNodeIdMap,
+                const ReplayShard& shard, bool verifyChecksums = true);
     void replaySegment(SideLog* sideLog, SegmentIterator& it,
                 std::unordered_map<uint64_t, uint64_t>* nextNodeIdMap);
     void replaySegment(SideLog* sideLog, SegmentIterator& it);
-    void syncChanges();
+    void setTableCacheQuota(uint64_t tableId, uint64_t quotaBytes);
+    void setTableDurability(uint64_t tableId, uint32_t ackReplicas);
+    void setTableTtl(uint64_t tableId, uint32_t ttlSeconds);
+    bool isCacheTable(uint64_t tableId);
+    uint32_t getTableDurability(uint64_t tableId);
+    void syncChanges(uint32_t ackReplicas = ~0u);
     Status writeObject(Object& newObject, RejectRules* rejectRules,
                 uint64_t* outVersion, Buffer* removedObjBuffer = NULL,
                 RpcResult* rpcResult = NULL, uint64_t* rpcResultPtr = NULL);
+    Status writeObject(Object& newObject, RejectRules* rejectRules,
+                uint64_t* outVersion, Buffer* removedObjBuffer,
+                RpcResult** rpcResults, uint64_t* rpcResultPtrs,
+                uint32_t rpcResultCount, uint64_t** resultVersions = NULL);
     bool keyPointsAtReference(Key& k, AbstractLog::Reference oldReference);
     void writePrepareFail(RpcResult* rpcResult, uint64_t* rpcResultPtr);
     void writeRpcResultOnly(RpcResult* rpcResult, uint64_t* rpcResultPtr);
@@ -103,6 +136,10 @@ class ObjectManager : public LogEntryHandlers,
                         Buffer* removedObjBuffer = NULL);
     Status commitWrite(PreparedOp& op, Log::Reference& refToPreparedOp,
                         Buffer* removedObjBuffer = NULL);
+    Status commitTransaction(std::vector<PreparedOp*>& ops,
+                std::vector<RejectRules*>& rejectRules,
+                std::vector<RpcResult*>& rpcResults,
+                std::vector<uint64_t>* rpcResultPtrs, bool* isCommitVote);
 
     /**
      * The following three methods are used when multiple log entries
@@ -115,12 +152,13 @@ class ObjectManager : public LogEntryHandlers,
     Status writeTombstone(Key& key, Buffer *logBuffer);
 
     /**
-     * The following two methods are used by the log cleaner. They aren't
+     * The following methods are used by the log cleaner. They aren't
      * intended to be called from any other modules.
      */
     uint32_t getTimestamp(LogEntryType type, Buffer& buffer);
     void relocate(LogEntryType type, Buffer& oldBuffer,
                 Log::Reference oldReference, LogEntryRelocator& relocator);
+    void prefetchForRelocation(LogEntryType type, Buffer& buffer);
 
     /**
      * The following methods exist because our current abstraction doesn't quite
@@ -133,6 +171,7 @@ class ObjectManager : public LogEntryHandlers,
     Log* getLog() { return &log; }
     ReplicaManager* getReplicaManager() { return &replicaManager; }
     HashTable* getObjectMap() { return &objectMap; }
+    SegmentManager* getSegmentManager() { return &segmentManager; }
 
     /**
      * An object of this class must be held by any activity that places
@@ -154,6 +193,91 @@ class ObjectManager : public LogEntryHandlers,
         DISALLOW_COPY_AND_ASSIGN(TombstoneProtector);
     };
 
+    /**
+     * Identifies the share of a segment's entries that a replaySegment()
+     * call is responsible for, so that several threads can replay the same
+     * recovery segment at once. Entries are divided by the hash table bucket
+     * their key falls in: shard i of n handles the i-th of n equal ranges of
+     * buckets, so each key is only ever touched by one thread and the
+     * threads rarely contend for bucket locks. Entries that aren't tied to
+     * a key (safe versions, transaction decisions and participant lists)
+     * are all handled by shard 0.
+     *
+     * All the shards of a segment must be built from the same number of
+     * buckets, since the hash table may grow while they are being replayed.
+     */
+    class ReplayShard {
+      public:
+        /// A shard that handles every entry of the segment.
+        ReplayShard()
+            : index(0)
+            , count(1)
+            , numBuckets(1)
+        {}
+
+        /**
+         * \param index
+         *      Which of the \a count shards this is, starting at 0.
+         * \param count
+         *      The number of shards the segment is divided into.
+         * \param numBuckets
+         *      The number of buckets in the object map, sampled once for
+         *      all of the shards.
+         */
+        ReplayShard(uint32_t index, uint32_t count, uint64_t numBuckets)
+            : index(index)
+            , count(count)
+            , numBuckets(numBuckets)
+        {
+            assert(index < count);
+        }
+
+        bool contains(KeyHash keyHash) const;
+
+        /// True if this shard handles the entries that have no key.
+        bool handlesUnkeyed() const { return index == 0; }
+
+        /// Which of the #count shards this is.
+        uint32_t index;
+
+        /// The number of shards the segment is divided into.
+        uint32_t count;
+
+        /// Number of buckets in the object map when the shards were made.
+        uint64_t numBuckets;
+    };
+
+    /**
+     * How many keys ahead readObjects() and readHashes() run each stage of
+     * their prefetch pipeline. Hash table buckets are prefetched twice this
+     * far ahead of the key being read, and the log entries they refer to
+     * this far ahead.
+     */
+    static const uint32_t READ_PREFETCH_DEPTH = 4;
+
+    /**
+     * How many entries ahead replaySegment() prefetches the hash table
+     * buckets of the entries it replays. Entries are small compared with
+     * the time it takes to fetch a bucket from memory, so the bucket for
+     * the next entry alone is rarely in the cache in time. The entries
+     * ahead are found with SegmentIterator::nextBatch, which decodes their
+     * headers REPLAY_PREFETCH_DEPTH at a time.
+     */
+    static const uint32_t REPLAY_PREFETCH_DEPTH = 16;
+
+    /**
+     * How many times readObject() tries to read an object without locking
+     * its hash table bucket before giving up and taking the lock.
+     */
+    static const uint32_t MAX_OPTIMISTIC_READ_ATTEMPTS = 3;
+
+    /**
+     * When readObject() finds that an object on the flash tier isn't in
+     * memory and can't yet tell how long it is (because even its header is
+     * on flash), it fetches this many bytes; most objects on flash are small.
+     */
+    static const uint32_t FLASH_FETCH_BYTES = 4096;
+
   PRIVATE:
     /**
      * An instance of this class locks the bucket of the hash table that a given
@@ -178,6 +302,7 @@ class ObjectManager : public LogEntryHandlers,
          */
         HashTableBucketLock(ObjectManager& objectManager, Key& key)
             : lock(NULL)
+            , version(NULL)
         {
             uint64_t unused;
             uint64_t bucket = HashTable::findBucketIndex(
@@ -197,12 +322,17 @@ class ObjectManager : public LogEntryHandlers,
          */
         HashTableBucketLock(ObjectManager& objectManager, uint64_t bucket)
             : lock(NULL)
+            , version(NULL)
         {
             takeBucketLock(objectManager, bucket);
         }
 
         ~HashTableBucketLock()
         {
+            // Make our changes visible before telling optimistic readers
+            // that the bucket is stable again.
+            Fence::sfence();
+            version->store(version->load() + 1);
             lock->unlock();
         }
 
@@ -225,15 +355,109 @@ class ObjectManager : public LogEntryHandlers,
             uint64_t lockIndex = bucket & (numLocks - 1);
             lock = &objectManager.hashTableBucketLocks[lockIndex];
             lock->lock();
+
+            // An odd version tells optimistic readers that the bucket may
+            // be changing under them (see HashTableBucketSnapshot).
+            version = &objectManager.hashTableBucketVersions[lockIndex];
+            version->store(version->load() + 1);
+            Fence::sfence();
         }
 
         /// The hash table bucket spinlock this object acquired in the
         /// constructor and will release in the destructor.
         SpinLock* lock;
 
+        /// Version counter paired with #lock. Incremented when the lock is
+        /// taken and again when it is released.
+        Atomic<uint64_t>* version;
+
         DISALLOW_COPY_AND_ASSIGN(HashTableBucketLock);
     };
 
+    /**
+     * An instance of this class lets a reader look at the hash table bucket
+     * that a given key maps into without taking the bucket's lock, in the
+     * style of a seqlock. The constructor records the version of the
+     * bucket's lock (see ObjectManager::hashTableBucketVersions); after
+     * reading, the caller invokes #validate(), which returns false if anyone
+     * may have locked the bucket in the meantime. In that case the caller
+     * must discard what it read and try again.
+     *
+     * Anything read this way may be inconsistent until validated, but it
+     * stays safe to dereference: hash table overflow lines are never freed,
+     * and the log cleaner doesn't reuse memory until all RPCs that could
+     * have seen it have finished.
+     */
+    class HashTableBucketSnapshot {
+      public:
+        /**
+         * Construct a snapshot of the bucket that a given key maps to.
+         *
+         * \param objectManager
+         *      The ObjectManager that owns the hash table bucket to read.
+         * \param key
+         *      Key whose corresponding bucket in the hash table will be read.
+         */
+        HashTableBucketSnapshot(ObjectManager& objectManager, Key& key)
+            : version(NULL)
+            , startVersion(0)
+            , stable(false)
+        {
+            uint32_t numLocks = arrayLength(objectManager.hashTableBucketLocks);
+            uint64_t lockIndex = getBucketIndex(objectManager, key) &
+                                 (numLocks - 1);
+            version = &objectManager.hashTableBucketVersions[lockIndex];
+            startVersion = version->load();
+            Fence::lfence();
+
+            // A bucket split changes which bucket the key maps to after
+            // bumping the version of the old bucket's lock; make sure we
+            // look at the lock that covers the key now.
+            uint64_t currentLockIndex = getBucketIndex(objectManager, key) &
+                                        (numLocks - 1);
+            stable = (startVersion & 1) == 0 && currentLockIndex == lockIndex;
+        }
+
+        /**
+         * Return true if nobody could have held the bucket's lock between
+         * the construction of this object and the call to this method, in
+         * which case everything read from the bucket in that time is
+         * consistent. Otherwise returns false.
+         */
+        bool
+        validate()
+        {
+            Fence::lfence();
+            return stable && version->load() == startVersion;
+        }
+
+      PRIVATE:
+        /**
+         * Return the index of the hash table bucket that a key maps to.
+         */
+        static uint64_t
+        getBucketIndex(ObjectManager& objectManager, Key& key)
+        {
+            uint64_t unused;
+            return HashTable::findBucketIndex(
+                        objectManager.objectMap.getNumBuckets(),
+                        key.getHash(), &unused);
+        }
+
+        /// Version counter of the bucket lock this snapshot is based on.
+        Atomic<uint64_t>* version;
+
+        /// Value of #version when this object was constructed.
+        uint64_t startVersion;
+
+        /// False if the bucket was locked when this object was constructed,
+        /// or if a split moved the key to a bucket covered by a different
+        /// lock. Such snapshots never validate.
+        bool stable;
+
+        DISALLOW_COPY_AND_ASSIGN(HashTableBucketSnapshot);
+    };
+
     /**
      * Struct used to pass parameters into the removeIfOrphanedObject and
      * removeIfTombstone methods through the generic HashTable::forEachInBucket
@@ -274,17 +498,159 @@ class ObjectManager : public LogEntryHandlers,
         DISALLOW_COPY_AND_ASSIGN(TombstoneRemover);
     };
 
+    /**
+     * This object executes in the background (as a WorkerTimer) to grow
+     * #objectMap, one bucket at a time, whenever its load factor gets too
+     * high. Each split holds only the HashTableBucketLock for the bucket
+     * being split, so reads and writes continue while the table grows.
+     */
+    class HashTableResizer : public WorkerTimer {
+      public:
+        HashTableResizer(ObjectManager* objectManager,
+                         HashTable* objectMap,
+                         uint64_t maxBytes);
+        void handleTimerEvent();
+
+        /// The resizer grows the table whenever its load factor (see
+        /// HashTable::getLoadFactor) exceeds this percentage.
+        static const int GROW_LOAD_FACTOR_PERCENT = 75;
+
+        /// Maximum number of buckets split per invocation of
+        /// handleTimerEvent, so that we don't lock out other WorkerTimers
+        /// for a long time.
+        static const int SPLITS_PER_EVENT = 1000;
+
+        /// How often (in milliseconds) to check the load factor when the
+        /// table doesn't need to grow.
+        static const int POLL_INTERVAL_MS = 100;
+
+      PRIVATE:
+        /// The ObjectManager that owns the hash table and its bucket locks.
+        ObjectManager* objectManager;
+
+        /// The hash table to grow.
+        HashTable* objectMap;
+
+        /// The table will not grow beyond this many buckets. 0 means that
+        /// resizing is disabled.
+        uint64_t maxBuckets;
+
+        /// Total number of buckets split since this object was created.
+        uint64_t splits;
+
+        DISALLOW_COPY_AND_ASSIGN(HashTableResizer);
+    };
+
+    /**
+     * This object executes in the background (as a WorkerTimer) to drop
+     * older versions of objects from #versionHistory once no snapshot read
+     * can need them, and to free their log entries.
+     */
+    class VersionCollector : public WorkerTimer {
+      public:
+        explicit VersionCollector(ObjectManager* objectManager);
+        void handleTimerEvent();
+
+        /// Maximum number of buckets of the version history examined per
+        /// invocation of handleTimerEvent, so that we don't lock out
+        /// writers for a long time.
+        static const int BUCKETS_PER_EVENT = 1000;
+
+        /// How often (in milliseconds) to collect old versions.
+        static const int POLL_INTERVAL_MS = 100;
+
+      PRIVATE:
+        /// The ObjectManager that owns the version history.
+        ObjectManager* objectManager;
+
+        DISALLOW_COPY_AND_ASSIGN(VersionCollector);
+    };
+
+    /**
+     * This object executes in the background (as a WorkerTimer) while any
+     * table has a TTL, slowly sweeping #objectMap to remove expired objects
+     * and free their log entries, so that the space they use is reclaimed
+     * even in segments that the cleaner doesn't choose to clean.
+     */
+    class ExpiredObjectRemover : public WorkerTimer {
+      public:
+        explicit ExpiredObjectRemover(ObjectManager* objectManager);
+        void handleTimerEvent();
+
+        /// Maximum number of buckets of #objectMap examined per invocation
+        /// of handleTimerEvent.
+        static const int BUCKETS_PER_EVENT = 1000;
+
+        /// How long (in milliseconds) to wait between invocations; together
+        /// with BUCKETS_PER_EVENT this limits the sweep to a small fraction
+        /// of a core.
+        static const int INTERVAL_MS = 10;
+
+      PRIVATE:
+        /// The ObjectManager whose hash table is swept.
+        ObjectManager* objectManager;
+
+        /// Which bucket of #objectMap should be swept next.
+        uint64_t currentBucket;
+
+        /// Number of objects removed since the current sweep started.
+        uint64_t removed;
+
+        friend class ObjectManager;
+        DISALLOW_COPY_AND_ASSIGN(ExpiredObjectRemover);
+    };
+
+    /**
+     * Counts the log entries visited by one thread of getMemoryUsage's
+     * scan of the log.
+     */
+    class MemoryUsageCounter : public ParallelLogScan::Callback {
+      public:
+        explicit MemoryUsageCounter(ObjectManager* objectManager)
+            : objectManager(objectManager)
+            , accounting()
+        {}
+        void handleEntry(LogEntryType type, Buffer& buffer,
+                Log::Reference reference);
+
+        /// The ObjectManager whose log is scanned.
+        ObjectManager* objectManager;
+
+        /// The entries visited by this thread.
+        MemoryAccounting accounting;
+
+        DISALLOW_COPY_AND_ASSIGN(MemoryUsageCounter);
+    };
+
+    /// Number of threads getMemoryUsage uses to scan the log.
+    static const uint32_t MEMORY_USAGE_SCAN_THREADS = 4;
+
     static string dumpSegment(Segment* segment);
     uint32_t getObjectTimestamp(Buffer& buffer);
+    uint64_t getSnapshotWatermark();
     uint32_t getTombstoneTimestamp(Buffer& buffer);
     uint32_t getTxDecisionRecordTimestamp(Buffer& buffer);
+    static KeyHash getKeyHashForReference(uint64_t reference, void *cookie);
     bool lookup(HashTableBucketLock& lock, Key& key,
                 LogEntryType& outType, Buffer& buffer,
                 uint64_t* outVersion = NULL,
                 Log::Reference* outReference = NULL,
                 HashTable::Candidates* outCandidates = NULL);
+    bool isExpired(Object& object);
+    bool isOverCacheQuota(uint64_t tableId);
+    bool lookupInBucket(Key& key, LogEntryType& outType, Buffer& buffer,
+                uint64_t* outVersion = NULL,
+                Log::Reference* outReference = NULL,
+                HashTable::Candidates* outCandidates = NULL);
+    void prefetchObject(KeyHash keyHash);
+    bool fetchFromFlash(Key& key);
+    Status readObjectInBucket(Key& key, Buffer* outBuffer,
+                RejectRules* rejectRules, uint64_t* outVersion,
+                bool valueOnly, uint32_t* outValueLength,
+                uint32_t* outKeysAndValueLength);
     friend void recoveryCleanup(uint64_t maybeTomb, void *cookie);
     bool remove(HashTableBucketLock& lock, Key& key);
+    static void removeIfExpired(uint64_t reference, void *cookie);
     static void removeIfOrphanedObject(uint64_t reference, void *cookie);
     static void removeIfTombstone(uint64_t maybeTomb, void *cookie);
     void removeTombstones();
@@ -304,6 +670,8 @@ class ObjectManager : public LogEntryHandlers,
     void relocateTxParticipantList(
             Buffer& oldBuffer, LogEntryRelocator& relocator);
     bool replace(HashTableBucketLock& lock, Key& key, Log::Reference reference);
+    void retireVersion(Key& key, uint64_t oldVersion,
+                Log::Reference oldReference, uint64_t newVersion);
 
     /**
      * Shared RAMCloud information.
@@ -346,6 +714,12 @@ class ObjectManager : public LogEntryHandlers,
      */
     TxRecoveryManager* txRecoveryManager;
 
+    /**
+     * The master's clock, used to time writes and snapshot reads; NULL means
+     * that snapshot reads are disabled.
+     */
+    ClusterClock* clusterClock;
+
     /**
      * Allocator used by the SegmentManager to obtain main memory for log
      * segments.
@@ -396,6 +770,14 @@ class ObjectManager : public LogEntryHandlers,
      */
     UnnamedSpinLock hashTableBucketLocks[1024];
 
+    /**
+     * One version counter for each of #hashTableBucketLocks. A counter is
+     * odd while its lock is held and is incremented on every acquire and
+     * release, which lets readObject() read objects without locking (see
+     * HashTableBucketSnapshot).
+     */
+    Atomic<uint64_t> hashTableBucketVersions[1024];
+
     /**
      * Locks objects during transactions.
      */
@@ -412,6 +794,48 @@ class ObjectManager : public LogEntryHandlers,
      */
     TombstoneRemover tombstoneRemover;
 
+    /**
+     * Grows #objectMap online when it fills up (if the configuration allows
+     * it to grow; see ServerConfig::Master::hashTableMaxBytes).
+     */
+    HashTableResizer hashTableResizer;
+
+    /**
+     * Older versions of objects, kept for snapshot reads (see
+     * readObjectAtTime) if ServerConfig::Master::snapshotVersions is set.
+     */
+    VersionHistory versionHistory;
+
+    /**
+     * Frees the older versions in #versionHistory once they can't be read.
+     */
+    VersionCollector versionCollector;
+
+    /**
+     * True means at least one table has been given a TTL (see setTableTtl),
+     * so objects must be checked for expiration. Lets reads skip the check
+     * entirely when no table uses TTLs.
+     */
+    std::atomic<bool> anyTableTtl;
+
+    /**
+     * True means at least one table is in cache mode (see
+     * setTableCacheQuota). Lets writes and the cleaner skip looking up
+     * quotas when no table is a cache.
+     */
+    std::atomic<bool> anyCacheTable;
+
+    /**
+     * True means at least one table has been given a durability level (see
+     * setTableDurability). Lets writes skip looking it up otherwise.
+     */
+    std::atomic<bool> anyTableDurability;
+
+    /**
+     * Removes expired objects from the hash table in the background.
+     */
+    ExpiredObjectRemover expiredObjectRemover;
+
     /**
      * Number of TombstoneProtector objects that currently exist for this
      * ObjectsManager.
@@ -419,6 +843,7 @@ class ObjectManager : public LogEntryHandlers,
     int tombstoneProtectorCount;
 
     friend class CleanerCompactionBenchmark;
+    friend class CleanerTraceSimulator;
     friend class ObjectManagerBenchmark;
 
     DISALLOW_COPY_AND_ASSIGN(ObjectManager);
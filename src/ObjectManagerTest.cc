@@ -69,7 +69,8 @@ class ObjectManagerTest : public ::testing::Test,
                         &masterTableMetadata,
                         &unackedRpcResults,
                         &preparedOps,
-                        &txRecoveryManager)
+                        &txRecoveryManager,
+                        &clusterClock)
     {
         objectManager.initOnceEnlisted();
         tabletManager.addTablet(0, 0, ~0UL, TabletManager::NORMAL);
@@ -422,6 +423,8 @@ class ObjectManagerTest : public ::testing::Test,
 
         entry = masterTableMetadata.find(tableId);
         if (entry != NULL) {
+            SpinLock::Guard _(entry->stats.lock);
+            entry->stats.merge();
             return format("found=true tableId=%lu byteCount=%lu recordCount=%lu"
                        , tableId
                        , entry->stats.byteCount
@@ -599,6 +602,253 @@ TEST_F(ObjectManagerTest, readObject) {
         tabletManager.toString());
 }
 
+TEST_F(ObjectManagerTest, readObject_expired) {
+    Buffer buffer;
+    Key key(0, "1", 1);
+    storeObject(key, "hi", 93);
+    objectManager.setTableTtl(0, 10);
+
+    WallTime::mockWallTimeValue = 9;
+    EXPECT_EQ(STATUS_OK, objectManager.readObject(key, &buffer, 0, 0));
+    WallTime::mockWallTimeValue = 10;
+    EXPECT_EQ(STATUS_OBJECT_DOESNT_EXIST,
+        objectManager.readObject(key, &buffer, 0, 0));
+
+    // Other tables are unaffected.
+    Key key2(1, "1", 1);
+    storeObject(key2, "hi", 93);
+    tabletManager.addTablet(1, 0, ~0UL, TabletManager::NORMAL);
+    EXPECT_EQ(STATUS_OK, objectManager.readObject(key2, &buffer, 0, 0));
+
+    // A TTL of 0 means objects never expire.
+    objectManager.setTableTtl(0, 0);
+    EXPECT_EQ(STATUS_OK, objectManager.readObject(key, &buffer, 0, 0));
+    WallTime::mockWallTimeValue = 0;
+}
+
+TEST_F(ObjectManagerTest, readObject_retryWhileBucketLocked) {
+    tabletManager.addTablet(1, 0, ~0UL, TabletManager::NORMAL);
+    Key key(1, "1", 1);
+    storeObject(key, "hi", 93);
+
+    // Pretend that someone holds the bucket's lock: every optimistic
+    // attempt fails and the read falls back to locking.
+    uint64_t unused;
+    uint64_t bucket = HashTable::findBucketIndex(
+            objectManager.objectMap.getNumBuckets(), key.getHash(), &unused);
+    Atomic<uint64_t>* version = &objectManager.hashTableBucketVersions[
+            bucket & (arrayLength(objectManager.hashTableBucketLocks) - 1)];
+    version->store(version->load() + 1);
+
+    Buffer buffer;
+    uint64_t retries = PerfStats::threadStats.readRetries;
+    EXPECT_EQ(STATUS_OK, objectManager.readObject(key, &buffer, 0, 0, true));
+    EXPECT_EQ("hi", TestUtil::toString(&buffer));
+    EXPECT_EQ(ObjectManager::MAX_OPTIMISTIC_READ_ATTEMPTS,
+              PerfStats::threadStats.readRetries - retries);
+
+    version->store(version->load() + 1);
+    retries = PerfStats::threadStats.readRetries;
+    buffer.reset();
+    EXPECT_EQ(STATUS_OK, objectManager.readObject(key, &buffer, 0, 0, true));
+    EXPECT_EQ("hi", TestUtil::toString(&buffer));
+    EXPECT_EQ(0UL, PerfStats::threadStats.readRetries - retries);
+}
+
+TEST_F(ObjectManagerTest, readObjectAtTime) {
+    masterConfig.master.snapshotVersions = 3;
+    clusterClock.updateClock(ClusterTime(2000000000));
+    Key key(0, "key0", 4);
+    Buffer value;
+    Object a(key, "a", 1, 0, 0, value);
+    uint64_t versionA;
+    objectManager.writeObject(a, NULL, &versionA);
+    uint64_t t1 = objectManager.getSnapshotTime();
+
+    value.reset();
+    Object b(key, "b", 1, 0, 0, value);
+    uint64_t versionB;
+    objectManager.writeObject(b, NULL, &versionB);
+    uint64_t t2 = objectManager.getSnapshotTime();
+    objectManager.removeObject(key, NULL, NULL);
+    uint64_t t3 = objectManager.getSnapshotTime();
+
+    Buffer buffer;
+    uint64_t version;
+    EXPECT_EQ(STATUS_OK, objectManager.readObjectAtTime(key, t1, &buffer,
+            NULL, &version, true));
+    EXPECT_EQ("a", TestUtil::toString(&buffer));
+    EXPECT_EQ(versionA, version);
+
+    buffer.reset();
+    EXPECT_EQ(STATUS_OK, objectManager.readObjectAtTime(key, t2, &buffer,
+            NULL, &version, true));
+    EXPECT_EQ("b", TestUtil::toString(&buffer));
+    EXPECT_EQ(versionB, version);
+
+    // Reject rules apply to the version the snapshot sees.
+    RejectRules rules;
+    memset(&rules, 0, sizeof(rules));
+    rules.versionNeGiven = 1;
+    rules.givenVersion = versionA;
+    EXPECT_EQ(STATUS_WRONG_VERSION, objectManager.readObjectAtTime(key, t2,
+            &buffer, &rules, NULL, true));
+
+    EXPECT_EQ(STATUS_OBJECT_DOESNT_EXIST, objectManager.readObjectAtTime(
+            key, t3, &buffer, NULL, NULL, true));
+
+    // Before the object was created.
+    EXPECT_EQ(STATUS_OBJECT_DOESNT_EXIST, objectManager.readObjectAtTime(
+            key, 1500000000, &buffer, NULL, NULL, true));
+
+    // Before the retention period.
+    EXPECT_EQ(STATUS_INVALID_PARAMETER, objectManager.readObjectAtTime(
+            key, 500000000, &buffer, NULL, NULL, true));
+}
+
+TEST_F(ObjectManagerTest, readObjectAtTime_disabled) {
+    Key key(0, "key0", 4);
+    storeObject(key, "hi", 93);
+    Buffer buffer;
+    EXPECT_EQ(0UL, objectManager.getSnapshotTime());
+    EXPECT_EQ(STATUS_INVALID_PARAMETER, objectManager.readObjectAtTime(
+            key, 1000, &buffer, NULL, NULL, true));
+}
+
+TEST_F(ObjectManagerTest, getSnapshotTime) {
+    masterConfig.master.snapshotVersions = 1;
+    clusterClock.updateClock(ClusterTime(1000));
+    EXPECT_EQ(1001UL, objectManager.getSnapshotTime());
+    EXPECT_EQ(1001UL, clusterClock.getTime().getEncoded());
+}
+
+TEST_F(ObjectManagerTest, getMemoryUsage) {
+    Key key(0, "key0", 4);
+    Buffer value;
+    Object first(key, "hi", 2, 0, 0, value);
+    objectManager.writeObject(first, NULL, NULL);
+    value.reset();
+    Object second(key, "hello", 5, 0, 0, value);
+    objectManager.writeObject(second, NULL, NULL);
+    Key key2(0, "key1", 4);
+    value.reset();
+    Object third(key2, "x", 1, 0, 0, value);
+    objectManager.writeObject(third, NULL, NULL);
+    objectManager.removeObject(key2, NULL, NULL);
+
+    MemoryAccounting accounting;
+    objectManager.getMemoryUsage(&accounting);
+    ProtoBuf::MemoryUsage usage;
+    accounting.serialize(&usage);
+    ASSERT_EQ(1, usage.table_size());
+    const ProtoBuf::MemoryUsage::Table& table = usage.table(0);
+    EXPECT_EQ(0U, table.table_id());
+    EXPECT_EQ(1U, table.live_objects());
+    EXPECT_EQ(9U, table.live_bytes());
+    EXPECT_EQ(2U, table.dead_entries());
+    EXPECT_EQ(2U, table.tombstones());
+    EXPECT_NE(0U, table.stats_bytes());
+
+    // Everything in the log (just the head segment) is counted once, plus
+    // one hash table entry for the live object.
+    EXPECT_EQ(objectManager.log.head->getAppendedLength() + 8,
+            table.live_bytes() + table.dead_bytes() +
+            table.tombstone_bytes() + table.metadata_bytes() +
+            usage.other_bytes());
+    EXPECT_EQ(objectManager.allocator.getTotalBytes(),
+            usage.log_capacity_bytes());
+    EXPECT_EQ(objectManager.objectMap.getNumBuckets() * 64,
+            usage.hash_table_bytes());
+}
+
+TEST_F(ObjectManagerTest, VersionCollector_handleTimerEvent) {
+    masterConfig.master.snapshotVersions = 3;
+    clusterClock.updateClock(ClusterTime(2000000000));
+    Key key(0, "key0", 4);
+    Buffer value;
+    Object a(key, "a", 1, 0, 0, value);
+    objectManager.writeObject(a, NULL, NULL);
+    objectManager.getSnapshotTime();
+    value.reset();
+    Object b(key, "b", 1, 0, 0, value);
+    objectManager.writeObject(b, NULL, NULL);
+    uint64_t t2 = objectManager.getSnapshotTime();
+
+    TestLog::Enable _("handleTimerEvent");
+    objectManager.versionCollector.handleTimerEvent();
+    EXPECT_EQ("", TestLog::get());
+
+    clusterClock.updateClock(ClusterTime(t2 + 1000000000));
+    objectManager.versionCollector.handleTimerEvent();
+    EXPECT_EQ("handleTimerEvent: freed 1 old versions", TestLog::get());
+    EXPECT_EQ(0U, objectManager.versionHistory.chains.size());
+}
+
+TEST_F(ObjectManagerTest, HashTableBucketSnapshot) {
+    Key key(1, "1", 1);
+    {
+        ObjectManager::HashTableBucketSnapshot snapshot(objectManager, key);
+        EXPECT_TRUE(snapshot.validate());
+    }
+    {
+        ObjectManager::HashTableBucketSnapshot snapshot(objectManager, key);
+        { ObjectManager::HashTableBucketLock lock(objectManager, key); }
+        EXPECT_FALSE(snapshot.validate());
+    }
+    {
+        ObjectManager::HashTableBucketLock lock(objectManager, key);
+        ObjectManager::HashTableBucketSnapshot snapshot(objectManager, key);
+        EXPECT_FALSE(snapshot.stable);
+        EXPECT_FALSE(snapshot.validate());
+    }
+}
+
+TEST_F(ObjectManagerTest, readObjects) {
+    tabletManager.addTablet(1, 0, ~0UL, TabletManager::NORMAL);
+    const uint32_t numObjects = 3 * ObjectManager::READ_PREFETCH_DEPTH + 1;
+    Tub<Key> keys[numObjects];
+    Key* keyPointers[numObjects];
+    RejectRules rejectRules[numObjects];
+    string keyStrings[numObjects];
+    memset(rejectRules, 0, sizeof(rejectRules));
+    for (uint32_t i = 0; i < numObjects; i++) {
+        keyStrings[i] = format("%u", i);
+        keyPointers[i] = keys[i].construct(1, keyStrings[i].c_str(),
+                downCast<uint16_t>(keyStrings[i].length()));
+        // Every third object is missing.
+        if (i % 3 != 1)
+            storeObject(*keyPointers[i], format("v%u", i), 10 + i);
+    }
+    rejectRules[2].exists = 1;
+
+    Buffer buffer;
+    Status statuses[numObjects];
+    uint64_t versions[numObjects];
+    uint32_t lengths[numObjects];
+    objectManager.readObjects(numObjects, keyPointers, rejectRules, &buffer,
+            statuses, versions, lengths, true);
+
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < numObjects; i++) {
+        if (i % 3 == 1) {
+            EXPECT_EQ(STATUS_OBJECT_DOESNT_EXIST, statuses[i]);
+            EXPECT_EQ(0UL, versions[i]);
+            EXPECT_EQ(0U, lengths[i]);
+        } else if (i == 2) {
+            EXPECT_EQ(STATUS_OBJECT_EXISTS, statuses[i]);
+            EXPECT_EQ(12UL, versions[i]);
+            EXPECT_EQ(0U, lengths[i]);
+        } else {
+            string value = format("v%u", i);
+            EXPECT_EQ(STATUS_OK, statuses[i]);
+            EXPECT_EQ(10UL + i, versions[i]);
+            EXPECT_EQ(value, TestUtil::toString(&buffer, offset, lengths[i]));
+        }
+        offset += lengths[i];
+    }
+    EXPECT_EQ(offset, buffer.size());
+}
+
 static bool
 antiGetEntryFilter(string s)
 {
@@ -771,6 +1021,87 @@ TEST_F(ObjectManagerTest, removeOrphanedObjects) {
     EXPECT_EQ(32lu, objectManager.log.totalLiveBytes);
 }
 
+TEST_F(ObjectManagerTest, removeIfExpired) {
+    tabletManager.addTablet(97, 0, ~0UL, TabletManager::RECOVERING);
+    Key key1(0, "1", 1);
+    Key key2(0, "2", 1);
+    Key key3(97, "3", 1);
+    Log::Reference ref1 = storeObject(key1, "old", 1);
+    Buffer value;
+    Object obj(key2, "new", 3, 2, 15, value);
+    EXPECT_EQ(STATUS_OK, objectManager.writeObject(obj, NULL, NULL));
+    storeObject(key3, "old", 3);
+    objectManager.setTableTtl(0, 10);
+    objectManager.setTableTtl(97, 10);
+
+    TestLog::Enable _("removeIfExpired", NULL);
+    WallTime::mockWallTimeValue = 20;
+    do {
+        objectManager.expiredObjectRemover.handleTimerEvent();
+    } while (objectManager.expiredObjectRemover.currentBucket != 0);
+    WallTime::mockWallTimeValue = 0;
+
+    // Only the object that expired in a NORMAL tablet is removed.
+    EXPECT_EQ(format("removeIfExpired: removing expired object at ref %lu",
+            ref1.toInteger()), TestLog::get());
+    LogEntryType type;
+    Buffer buffer;
+    {
+        ObjectManager::HashTableBucketLock lock(objectManager, key1);
+        EXPECT_FALSE(objectManager.lookup(lock, key1, type, buffer));
+        EXPECT_TRUE(objectManager.lookup(lock, key2, type, buffer));
+        EXPECT_TRUE(objectManager.lookup(lock, key3, type, buffer));
+    }
+    // The count is reset once the sweep wraps around.
+    EXPECT_EQ(0u, objectManager.expiredObjectRemover.removed);
+}
+
+TEST_F(ObjectManagerTest, setTableCacheQuota) {
+    EXPECT_FALSE(objectManager.isCacheTable(5));
+    objectManager.setTableCacheQuota(5, 0);
+    EXPECT_FALSE(objectManager.anyCacheTable);
+    objectManager.setTableCacheQuota(5, 1000);
+    EXPECT_EQ(1000u, masterTableMetadata.find(5)->cacheQuotaBytes);
+    EXPECT_TRUE(objectManager.anyCacheTable);
+    EXPECT_TRUE(objectManager.isCacheTable(5));
+    EXPECT_FALSE(objectManager.isCacheTable(6));
+}
+
+TEST_F(ObjectManagerTest, isOverCacheQuota) {
+    Key key(0, "key0", 4);
+    Buffer value;
+    Object obj(key, "item0", 5, 0, 0, value);
+    objectManager.writeObject(obj, NULL, NULL);
+    EXPECT_FALSE(objectManager.isOverCacheQuota(0));
+    objectManager.setTableCacheQuota(0, 36);
+    EXPECT_FALSE(objectManager.isOverCacheQuota(0));
+    objectManager.setTableCacheQuota(0, 35);
+    EXPECT_TRUE(objectManager.isOverCacheQuota(0));
+    EXPECT_FALSE(objectManager.isOverCacheQuota(1));
+}
+
+TEST_F(ObjectManagerTest, setTableDurability) {
+    EXPECT_EQ(~0u, objectManager.getTableDurability(5));
+    objectManager.setTableDurability(5, 1);
+    EXPECT_TRUE(objectManager.anyTableDurability);
+    EXPECT_EQ(1u, objectManager.getTableDurability(5));
+    EXPECT_EQ(~0u, objectManager.getTableDurability(6));
+
+    // Cache tables never wait for backups.
+    objectManager.setTableCacheQuota(5, 1000);
+    EXPECT_EQ(0u, objectManager.getTableDurability(5));
+}
+
+TEST_F(ObjectManagerTest, setTableTtl) {
+    objectManager.setTableTtl(5, 0);
+    EXPECT_FALSE(objectManager.anyTableTtl);
+    EXPECT_FALSE(objectManager.expiredObjectRemover.isRunning());
+    objectManager.setTableTtl(5, 60);
+    EXPECT_EQ(60u, masterTableMetadata.find(5)->ttlSeconds);
+    EXPECT_TRUE(objectManager.anyTableTtl);
+    EXPECT_TRUE(objectManager.expiredObjectRemover.isRunning());
+}
+
 TEST_F(ObjectManagerTest, replaySegment_nextNodeIdMap) {
     ObjectManager::TombstoneProtector p(&objectManager);
     uint32_t segLen = 8192;
@@ -794,6 +1125,48 @@ TEST_F(ObjectManagerTest, replaySegment_nextNodeIdMap) {
               , verifyMetadata(0));
 }
 
+TEST_F(ObjectManagerTest, replaySegment_shard) {
+    ObjectManager::TombstoneProtector p(&objectManager);
+    uint32_t segLen = 8192;
+    char seg[segLen];
+    SideLog sl(&objectManager.log);
+    Tub<SegmentIterator> it;
+
+    Key key0(0, "key0", 4);
+    SegmentCertificate certificate;
+    uint32_t len = buildRecoverySegment(seg, segLen, key0, 1, "original",
+                                        &certificate);
+    uint64_t numBuckets = objectManager.objectMap.getNumBuckets();
+    ObjectManager::ReplayShard owner(0, 2, numBuckets);
+    ObjectManager::ReplayShard other(1, 2, numBuckets);
+    if (!owner.contains(key0.getHash()))
+        std::swap(owner, other);
+
+    it.construct(&seg[0], len, certificate);
+    objectManager.replaySegment(&sl, *it, NULL, other);
+    Buffer buffer;
+    EXPECT_EQ(STATUS_OBJECT_DOESNT_EXIST,
+              objectManager.readObject(key0, &buffer, 0, 0));
+
+    it.construct(&seg[0], len, certificate);
+    objectManager.replaySegment(&sl, *it, NULL, owner);
+    verifyRecoveryObject(key0, "original");
+}
+
+TEST_F(ObjectManagerTest, ReplayShard_contains) {
+    ObjectManager::ReplayShard all;
+    EXPECT_TRUE(all.contains(12345));
+
+    // Four shards of eight buckets: two buckets each.
+    ObjectManager::ReplayShard shard(1, 4, 8);
+    EXPECT_FALSE(shard.contains(1));
+    EXPECT_TRUE(shard.contains(2));
+    EXPECT_TRUE(shard.contains(3));
+    EXPECT_FALSE(shard.contains(4));
+    EXPECT_TRUE(shard.contains(10));
+    EXPECT_FALSE(shard.contains(13));
+}
+
 TEST_F(ObjectManagerTest, replaySegment_tombstoneSynthesis) {
     ObjectManager::TombstoneProtector p(&objectManager);
     uint32_t segLen = 8192;
@@ -2321,6 +2694,96 @@ TEST_F(ObjectManagerTest, TombstoneRemover_handleTimerEvent_doWork) {
     }
 }
 
+TEST_F(ObjectManagerTest, HashTableResizer_constructor) {
+    TestLog::Enable logEnabler("HashTableResizer");
+    uint64_t tableBytes = objectManager.objectMap.getNumBuckets() *
+            HashTable::bytesPerCacheLine();
+
+    ObjectManager::HashTableResizer noGrowth(&objectManager,
+            &objectManager.objectMap, tableBytes);
+    EXPECT_EQ(0UL, noGrowth.maxBuckets);
+
+    ObjectManager::HashTableResizer resizer(&objectManager,
+            &objectManager.objectMap, 2 * tableBytes);
+    EXPECT_EQ(2 * objectManager.objectMap.getNumBuckets(),
+              resizer.maxBuckets);
+    EXPECT_EQ("", TestLog::get());
+
+    HashTable smallTable(16);
+    ObjectManager::HashTableResizer tooFewBuckets(&objectManager,
+            &smallTable, 1024 * 1024);
+    EXPECT_EQ(0UL, tooFewBuckets.maxBuckets);
+    EXPECT_EQ("HashTableResizer: Hash table has only 16 buckets (fewer "
+              "than 1024 bucket locks); online resizing disabled",
+              TestLog::get());
+}
+
+TEST_F(ObjectManagerTest, HashTableResizer_handleTimerEvent_noWorkToDo) {
+    uint64_t numBuckets = objectManager.objectMap.getNumBuckets();
+    ObjectManager::HashTableResizer resizer(&objectManager,
+            &objectManager.objectMap,
+            2 * numBuckets * HashTable::bytesPerCacheLine());
+    resizer.handleTimerEvent();
+    EXPECT_EQ(numBuckets, objectManager.objectMap.getNumBuckets());
+    EXPECT_EQ(0UL, resizer.splits);
+    EXPECT_TRUE(resizer.isRunning());
+}
+
+TEST_F(ObjectManagerTest, HashTableResizer_handleTimerEvent_doWork) {
+    Key keys[] = { {0, "key0", 4}, {0, "key1", 4}, {0, "key2", 4},
+                   {0, "key3", 4}, {0, "key4", 4}, {0, "key5", 4} };
+    for (uint32_t i = 0; i < arrayLength(keys); i++) {
+        Buffer value;
+        Object obj(keys[i], "hi", 2, 0, 0, value);
+        EXPECT_EQ(STATUS_OK, objectManager.writeObject(obj, NULL, NULL));
+    }
+
+    uint64_t numBuckets = objectManager.objectMap.getNumBuckets();
+    ObjectManager::HashTableResizer resizer(&objectManager,
+            &objectManager.objectMap,
+            2 * numBuckets * HashTable::bytesPerCacheLine());
+
+    // Pretend the table is overfull.
+    objectManager.objectMap.numEntries.store(
+            2 * numBuckets * HashTable::entriesPerCacheLine());
+    resizer.handleTimerEvent();
+    EXPECT_EQ(numBuckets + ObjectManager::HashTableResizer::SPLITS_PER_EVENT,
+              objectManager.objectMap.getNumBuckets());
+    EXPECT_TRUE(resizer.isRunning());
+
+    // Keep going until the table reaches its maximum size.
+    while (objectManager.objectMap.getNumBuckets() < 2 * numBuckets)
+        resizer.handleTimerEvent();
+    EXPECT_EQ(2 * numBuckets, objectManager.objectMap.getNumBuckets());
+    EXPECT_EQ(numBuckets, resizer.splits);
+    resizer.handleTimerEvent();
+    EXPECT_EQ(2 * numBuckets, objectManager.objectMap.getNumBuckets());
+
+    for (uint32_t i = 0; i < arrayLength(keys); i++) {
+        Buffer value;
+        EXPECT_EQ(STATUS_OK, objectManager.readObject(keys[i], &value,
+                                                      NULL, NULL, true));
+        EXPECT_EQ("hi", string(reinterpret_cast<const char*>(
+                  value.getRange(0, 2)), 2));
+    }
+}
+
+TEST_F(ObjectManagerTest, getKeyHashForReference) {
+    Key key(0, "key0", 4);
+    Buffer value;
+    Object obj(key, "hi", 2, 0, 0, value);
+    EXPECT_EQ(STATUS_OK, objectManager.writeObject(obj, NULL, NULL));
+
+    LogEntryType type;
+    Buffer buffer;
+    Log::Reference reference;
+    ObjectManager::HashTableBucketLock lock(objectManager, key);
+    EXPECT_TRUE(objectManager.lookup(lock, key, type, buffer, NULL,
+                                     &reference));
+    EXPECT_EQ(key.getHash(), ObjectManager::getKeyHashForReference(
+            reference.toInteger(), &objectManager));
+}
+
 TEST_F(ObjectManagerTest, TombstoneProtector) {
     TestLog::Enable logEnabler("handleTimerEvent");
     Tub<ObjectManager::TombstoneProtector> protector1, protector2;
@@ -2647,6 +3110,87 @@ TEST_F(ObjectManagerTest, relocateObject_objectDeleted) {
               , verifyMetadata(0));
 }
 
+TEST_F(ObjectManagerTest, relocateObject_objectExpired) {
+    Key key(0, "key0", 4);
+
+    Buffer value;
+    Object obj(key, "item0", 5, 0, 0, value);
+    objectManager.writeObject(obj, NULL, NULL);
+    EXPECT_EQ("found=true tableId=0 byteCount=36 recordCount=1"
+              , verifyMetadata(0));
+
+    LogEntryType type;
+    Buffer buffer;
+    Log::Reference reference;
+    uint64_t version;
+    {
+        ObjectManager::HashTableBucketLock lock(objectManager, key);
+        EXPECT_TRUE(objectManager.lookup(lock, key, type, buffer, &version,
+                &reference));
+    }
+
+    objectManager.setTableTtl(0, 10);
+    WallTime::mockWallTimeValue = 10;
+    LogEntryRelocator relocator(
+        objectManager.segmentManager.getHeadSegment(), 1000);
+    objectManager.relocate(LOG_ENTRY_TYPE_OBJ, buffer, reference, relocator);
+    WallTime::mockWallTimeValue = 0;
+
+    // The object was dropped without a tombstone.
+    EXPECT_FALSE(relocator.didAppend);
+    EXPECT_EQ("found=true tableId=0 byteCount=0 recordCount=0"
+              , verifyMetadata(0));
+    {
+        ObjectManager::HashTableBucketLock lock(objectManager, key);
+        EXPECT_FALSE(objectManager.lookup(lock, key, type, buffer));
+    }
+    EXPECT_LT(version, objectManager.segmentManager.safeVersion);
+}
+
+TEST_F(ObjectManagerTest, relocateObject_cacheQuotaExceeded) {
+    Key key(0, "key0", 4);
+
+    Buffer value;
+    Object obj(key, "item0", 5, 0, 0, value);
+    objectManager.writeObject(obj, NULL, NULL);
+
+    LogEntryType type;
+    Buffer buffer;
+    Log::Reference reference;
+    uint64_t version;
+    {
+        ObjectManager::HashTableBucketLock lock(objectManager, key);
+        EXPECT_TRUE(objectManager.lookup(lock, key, type, buffer, &version,
+                &reference));
+    }
+
+    // Within the quota the object is relocated as usual.
+    objectManager.setTableCacheQuota(0, 1000);
+    LogEntryRelocator relocator(
+        objectManager.segmentManager.getHeadSegment(), 1000);
+    objectManager.relocate(LOG_ENTRY_TYPE_OBJ, buffer, reference, relocator);
+    EXPECT_TRUE(relocator.didAppend);
+    {
+        ObjectManager::HashTableBucketLock lock(objectManager, key);
+        EXPECT_TRUE(objectManager.lookup(lock, key, type, buffer, &version,
+                &reference));
+    }
+
+    // Over the quota it is evicted without a tombstone.
+    objectManager.setTableCacheQuota(0, 1);
+    LogEntryRelocator relocator2(
+        objectManager.segmentManager.getHeadSegment(), 1000);
+    objectManager.relocate(LOG_ENTRY_TYPE_OBJ, buffer, reference, relocator2);
+    EXPECT_FALSE(relocator2.didAppend);
+    EXPECT_EQ("found=true tableId=0 byteCount=0 recordCount=0"
+              , verifyMetadata(0));
+    {
+        ObjectManager::HashTableBucketLock lock(objectManager, key);
+        EXPECT_FALSE(objectManager.lookup(lock, key, type, buffer));
+    }
+    EXPECT_LT(version, objectManager.segmentManager.safeVersion);
+}
+
 TEST_F(ObjectManagerTest, relocateObject_objectModified) {
     Key key(0, "key0", 4);
 
@@ -2683,6 +3227,39 @@ TEST_F(ObjectManagerTest, relocateObject_objectModified) {
               , verifyMetadata(0));
 }
 
+TEST_F(ObjectManagerTest, relocateObject_retainedVersion) {
+    masterConfig.master.snapshotVersions = 3;
+    clusterClock.updateClock(ClusterTime(2000000000));
+    Key key(0, "key0", 4);
+
+    Buffer value;
+    Object obj(key, "item0", 5, 0, 0, value);
+    objectManager.writeObject(obj, NULL, NULL);
+
+    LogEntryType type;
+    Buffer buffer;
+    Log::Reference reference;
+    {
+        ObjectManager::HashTableBucketLock lock(objectManager, key);
+        objectManager.lookup(lock, key, type, buffer, 0, &reference);
+    }
+
+    value.reset();
+    Object object(key, "item0-v2", 8, 0, 0, value);
+    objectManager.writeObject(object, NULL, NULL);
+
+    // Snapshot reads may still need the first version, so it's live.
+    LogEntryRelocator relocator(
+        objectManager.segmentManager.getHeadSegment(), 1000);
+    objectManager.relocate(LOG_ENTRY_TYPE_OBJ, buffer, reference, relocator);
+    EXPECT_TRUE(relocator.didAppend);
+    SpinLock::Guard guard(objectManager.versionHistory.mutex);
+    EXPECT_FALSE(objectManager.versionHistory.isRetained(key,
+            reference.toInteger(), guard));
+    EXPECT_TRUE(objectManager.versionHistory.isRetained(key,
+            relocator.getNewReference().toInteger(), guard));
+}
+
 TEST_F(ObjectManagerTest, keyPointsAtReference) {
     SideLog sl(&objectManager.log);
     Tub<SegmentIterator> it;
@@ -22,18 +22,16 @@
 /*
  * Notes on performance and efficiency:
  *
- * This class is currently extremely simple and has some notable
- * inefficiencies. It does not allocate in blocks of objects, so
- * each allocation that cannot be satisfied by the space of a
- * previously destroyed object results in a malloc. Furthermore,
- * the individual mallocs can cause poor cache locality when small
- * objects are used.
+ * Memory is allocated in slabs holding several objects each, so most
+ * allocations don't call malloc at all, and objects allocated together
+ * are adjacent in memory. Slabs start small (one object) and double in
+ * size up to MAX_SLAB_BYTES, so a pool that only ever holds a few objects
+ * stays small. Destroyed objects go on a LIFO free list and are reused
+ * before any new slab space, which keeps recently touched (and likely
+ * cached) memory in use.
  *
- * Compared to the former boost-based ObjectPool, for very small
- * objects a fast allocation is about 70% slower (6.2ns vs 3.6ns;
- * due to cache effects) for 4-byte objects. For 64-byte objects
- * they're about the same. Slow allocation (no pool memory left)
- * is considerably slower.
+ * The pool never returns memory to malloc until it is destroyed; its
+ * footprint is that of the most objects that have existed at once.
  */
 
 namespace RAMCloud {
@@ -61,13 +59,17 @@ class ObjectPool
   public:
     /**
      * Construct a new ObjectPool. The pool begins life with no allocated
-     * memory. Objects are first allocated individually via malloc. Destroyed
-     * objects have their backing memory stashed away to speed up future
-     * allocations. For simplicity, no bulk allocations are performed.
+     * memory. Objects are carved out of slabs of memory allocated via
+     * malloc. Destroyed objects have their backing memory stashed away to
+     * speed up future allocations.
      */
     ObjectPool()
         : outstandingObjects(0),
-          pool()
+          pool(),
+          slabs(),
+          slabBytes(0),
+          nextInSlab(NULL),
+          slabEnd(NULL)
     {
     }
 
@@ -78,21 +80,23 @@ class ObjectPool
      */
     ~ObjectPool()
     {
-        foreach(void* p, pool) {
-            free(p);
-        }
-
         // Catching this isn't intended, but could be done if the caller really
-        // wants to, so make sure we free the pooled memory first.
+        // wants to, so leave the slabs (and the objects still in them) alone.
         if (outstandingObjects > 0) {
             RAMCLOUD_LOG(ERROR, "Pool destroyed before objects!");
+            return;
+        }
+
+        foreach(void* slab, slabs) {
+            free(slab);
         }
     }
 
     /**
      * Construct a new object of templated type T. This method allocates memory
-     * from the pool if possible. If the pool is empty, it mallocs more space.
-     * If malloc fails, the process is terminated.
+     * from the pool if possible. If the pool is empty, it takes space from the
+     * current slab, or mallocs a new slab if that is full. If malloc fails,
+     * the process is terminated.
      * 
      * \param args
      *      Arguments to provide to T's constructor.
@@ -104,11 +108,14 @@ class ObjectPool
     construct(Args&&... args)
     {
         void* backing = NULL;
-        if (pool.size() == 0) {
-            backing = Memory::xmalloc(HERE, sizeof(T));
-        } else {
+        if (pool.size() != 0) {
             backing = pool.back();
             pool.pop_back();
+        } else {
+            if (nextInSlab == slabEnd)
+                allocateSlab();
+            backing = nextInSlab;
+            nextInSlab += sizeof(T);
         }
 
         T* object = NULL;
@@ -135,13 +142,61 @@ class ObjectPool
         outstandingObjects--;
     }
 
+    /**
+     * Return the total number of bytes of memory the pool has allocated for
+     * objects, whether in use or not.
+     */
+    uint64_t
+    getSlabBytes() const
+    {
+        return slabBytes;
+    }
+
   PRIVATE:
+    /// Slabs never get bigger than this (unless a single object is).
+    static const uint32_t MAX_SLAB_BYTES = 64 * 1024;
+
+    /**
+     * Allocate a new slab for objects, twice as big as the last one (up to
+     * MAX_SLAB_BYTES), and make it the current one.
+     */
+    void
+    allocateSlab()
+    {
+        size_t objects = 1;
+        if (!slabs.empty()) {
+            objects = std::max(size_t(1), std::min(
+                    2 * (slabEnd - static_cast<char*>(slabs.back())) /
+                    sizeof(T), MAX_SLAB_BYTES / sizeof(T)));
+        }
+        size_t bytes = objects * sizeof(T);
+        nextInSlab = static_cast<char*>(Memory::xmalloc(HERE, bytes));
+        slabEnd = nextInSlab + bytes;
+        slabs.push_back(nextInSlab);
+        slabBytes += bytes;
+    }
+
     /// Count of the number of objects for which construct() was called, but
     /// destroy() was not.
     uint64_t outstandingObjects;
 
     /// Pool of backing memory from previously destroyed objects.
     vector<void*> pool;
+
+    /// Every slab the pool has allocated (the last is the current one).
+    vector<void*> slabs;
+
+    /// Total size of the slabs in #slabs.
+    uint64_t slabBytes;
+
+    /// Space for the next object in the current slab that has never been
+    /// used; equal to #slabEnd if the slab is full.
+    char* nextInSlab;
+
+    /// The end of the current slab.
+    char* slabEnd;
+
+    DISALLOW_COPY_AND_ASSIGN(ObjectPool);
 };
 
 } // end RAMCloud
@@ -97,6 +97,38 @@ TEST(ObjectPoolTest, construct) {
     pool.destroy(a);
 }
 
+TEST(ObjectPoolTest, construct_slabs) {
+    ObjectPool<TestObject> pool;
+    TestObject* objects[8];
+    for (int i = 0; i < 8; i++)
+        objects[i] = pool.construct();
+    EXPECT_EQ(4U, pool.slabs.size());
+    EXPECT_EQ(15 * sizeof(TestObject), pool.getSlabBytes());
+
+    // Objects in the same slab are adjacent.
+    EXPECT_EQ(objects[3] + 1, objects[4]);
+
+    // Destroyed objects are reused before the rest of the slab.
+    pool.destroy(objects[2]);
+    EXPECT_EQ(objects[2], pool.construct());
+    TestObject* extra = pool.construct();
+    EXPECT_EQ(objects[7] + 1, extra);
+    EXPECT_EQ(4U, pool.slabs.size());
+    EXPECT_EQ(9U, pool.outstandingObjects);
+
+    pool.destroy(extra);
+    for (int i = 0; i < 8; i++)
+        pool.destroy(objects[i]);
+}
+
+TEST(ObjectPoolTest, allocateSlab_maxSize) {
+    ObjectPool<char[1000]> pool;
+    for (int i = 0; i < 20; i++)
+        pool.allocateSlab();
+    EXPECT_EQ(65000U, static_cast<size_t>(pool.slabEnd -
+            static_cast<char*>(pool.slabs.back())));
+}
+
 TEST(ObjectPoolTests, destroy) {
     ObjectPool<TestObject> pool;
     bool destroyed = false;
@@ -94,7 +94,7 @@ ObjectRpcWrapper::checkStatus()
                 "refreshing object map",
                 session->getServiceLocator().c_str(),
                 tableId, keyHash);
-        context->objectFinder->flush(tableId);
+        context->objectFinder->flush(tableId, keyHash);
         send();
         return false;
     }
@@ -110,7 +110,7 @@ ObjectRpcWrapper::handleTransportError()
     // Then retry.
     context->objectFinder->flushSession(tableId, keyHash);
     session = NULL;
-    context->objectFinder->flush(tableId);
+    context->objectFinder->flush(tableId, keyHash);
     send();
     return false;
 }
@@ -121,7 +121,7 @@ ObjectRpcWrapper::send()
 {
     session = context->objectFinder->lookup(tableId, keyHash);
     state = IN_PROGRESS;
-    session->sendRequest(&request, response, this);
+    sendRequest();
 }
 
 } // namespace RAMCloud
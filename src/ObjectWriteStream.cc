@@ -0,0 +1,155 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <algorithm>
+
+#include "ObjectWriteStream.h"
+#include "ClientException.h"
+#include "Key.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct an ObjectWriteStream; nothing is sent until data is appended.
+ *
+ * \param ramcloud
+ *      The RAMCloud object that governs the RPCs.
+ * \param tableId
+ *      The table containing the object (return value from a previous call
+ *      to getTableId).
+ * \param key
+ *      Variable length key that uniquely identifies the object within
+ *      tableId. It is copied, so it needn't remain valid.
+ * \param keyLength
+ *      Size in bytes of the key.
+ */
+ObjectWriteStream::ObjectWriteStream(RamCloud* ramcloud, uint64_t tableId,
+        const void* key, uint16_t keyLength)
+    : ramcloud(ramcloud)
+    , tableId(tableId)
+    , key(static_cast<const char*>(key), keyLength)
+    , keyHash(Key::getHash(tableId, key, keyLength))
+    , streamId(generateRandom())
+    , length(0)
+    , checksum()
+    , rpcs()
+    , nextRpc(0)
+    , outstanding(0)
+    , committed(false)
+    , maxFragmentBytes(DEFAULT_MAX_FRAGMENT_BYTES)
+{
+}
+
+/**
+ * Destructor. If commit wasn't called (or failed), any fragment requests
+ * still outstanding are abandoned, and the master discards the fragments
+ * it received after WriteStreamManager::STREAM_TIMEOUT_SECONDS.
+ */
+ObjectWriteStream::~ObjectWriteStream()
+{
+}
+
+/**
+ * Add data to the end of the object's value. The data is sent to the
+ * master in fragments of at most maxFragmentBytes; this method returns
+ * once the requests for all of the data have been started, waiting for
+ * older ones first if needed.
+ *
+ * \param data
+ *      The next bytes of the value. The data is copied into the requests,
+ *      so the caller can reuse this memory as soon as this method returns.
+ * \param length
+ *      Number of bytes at \a data.
+ *
+ * \throw ClientException
+ *      A fragment sent earlier couldn't be stored (for example,
+ *      RequestTooLargeException if the value is now larger than the
+ *      largest object the servers allow).
+ */
+void
+ObjectWriteStream::append(const void* data, uint32_t length)
+{
+    assert(!committed);
+    if (uint64_t(this->length) + length > ~0u)
+        ClientException::throwException(HERE, STATUS_REQUEST_TOO_LARGE);
+
+    const char* next = static_cast<const char*>(data);
+    while (length > 0) {
+        uint32_t fragmentLength = std::min(length, maxFragmentBytes);
+        waitForFragments(MAX_OUTSTANDING_FRAGMENTS - 1);
+        rpcs[nextRpc].construct(ramcloud, tableId, keyHash, streamId,
+                this->length, next, fragmentLength);
+        nextRpc = (nextRpc + 1) % MAX_OUTSTANDING_FRAGMENTS;
+        outstanding++;
+        checksum.update(next, fragmentLength);
+        this->length += fragmentLength;
+        next += fragmentLength;
+        length -= fragmentLength;
+    }
+}
+
+/**
+ * Write the object, with all of the data appended so far as its value.
+ * Returns once the object has been written (or an error occurs). No more
+ * data may be appended afterwards.
+ *
+ * \param[out] version
+ *      If non-NULL, the version number of the new object is returned here.
+ * \param rejectRules
+ *      If non-NULL, specifies conditions under which the write should be
+ *      aborted with an error.
+ *
+ * \throw InvalidParameterException
+ *      The master doesn't have the whole value (for example, because it
+ *      crashed after receiving some of it); the write has to be started
+ *      over.
+ * \throw ClientException
+ *      Any of the exceptions RamCloud::write may throw.
+ */
+void
+ObjectWriteStream::commit(uint64_t* version, const RejectRules* rejectRules)
+{
+    assert(!committed);
+    committed = true;
+    waitForFragments(0);
+    CommitWriteRpc rpc(ramcloud, tableId, key.data(),
+            downCast<uint16_t>(key.size()), streamId, length,
+            checksum.getResult(), rejectRules);
+    rpc.wait(version);
+}
+
+/**
+ * Wait for the oldest fragment requests to complete until no more than a
+ * given number are outstanding.
+ *
+ * \param maxOutstanding
+ *      Return once at most this many requests are outstanding.
+ *
+ * \throw ClientException
+ *      The master couldn't store one of the fragments.
+ */
+void
+ObjectWriteStream::waitForFragments(uint32_t maxOutstanding)
+{
+    while (outstanding > maxOutstanding) {
+        uint32_t oldest = (nextRpc + MAX_OUTSTANDING_FRAGMENTS - outstanding)
+                % MAX_OUTSTANDING_FRAGMENTS;
+        outstanding--;
+        rpcs[oldest]->wait();
+        rpcs[oldest].destroy();
+    }
+}
+
+} // namespace RAMCloud
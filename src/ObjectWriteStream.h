@@ -0,0 +1,109 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_OBJECTWRITESTREAM_H
+#define RAMCLOUD_OBJECTWRITESTREAM_H
+
+#include "Common.h"
+#include "Crc32C.h"
+#include "RamCloud.h"
+#include "Tub.h"
+
+namespace RAMCloud {
+
+/**
+ * Writes an object whose value is produced a piece at a time, without
+ * the whole value ever being in the client's memory. Each call to append
+ * sends the data to the object's master in WRITE_FRAGMENT requests, and
+ * commit then asks the master to write the object; the master holds the
+ * fragments until then (see WriteStreamManager), so readers see either the
+ * old object or the whole new one. Several fragments are in flight at
+ * once, so the transfer of one fragment overlaps the master's handling
+ * of the previous ones.
+ *
+ * If the master crashes, or the object's tablet moves, before commit
+ * returns, the fragments it received are lost: commit throws
+ * InvalidParameterException and the write must be started over with a
+ * new ObjectWriteStream. The value is still limited to the servers'
+ * maximum object size.
+ *
+ * Usage:
+ *     ObjectWriteStream stream(&ramcloud, tableId, key, keyLength);
+ *     while (...)
+ *         stream.append(data, length);
+ *     stream.commit(&version);
+ */
+class ObjectWriteStream {
+  PUBLIC:
+    /// Default value for maxFragmentBytes.
+    static const uint32_t DEFAULT_MAX_FRAGMENT_BYTES = 256*1024;
+
+    /// Number of WRITE_FRAGMENT requests that may be outstanding at once.
+    static const uint32_t MAX_OUTSTANDING_FRAGMENTS = 4;
+
+    ObjectWriteStream(RamCloud* ramcloud, uint64_t tableId, const void* key,
+            uint16_t keyLength);
+    ~ObjectWriteStream();
+    void append(const void* data, uint32_t length);
+    void commit(uint64_t* version = NULL,
+            const RejectRules* rejectRules = NULL);
+
+  PRIVATE:
+    void waitForFragments(uint32_t maxOutstanding);
+
+    /// Overall client state information.
+    RamCloud* ramcloud;
+
+    /// The table containing the object.
+    uint64_t tableId;
+
+    /// The object's primary key.
+    string key;
+
+    /// Key::getHash of #key.
+    uint64_t keyHash;
+
+    /// Chosen at random; identifies this write to the master.
+    uint64_t streamId;
+
+    /// Number of bytes of the value appended so far.
+    uint32_t length;
+
+    /// Checksum of the bytes of the value appended so far.
+    Crc32C checksum;
+
+    /// Fragment requests that may still be outstanding, used in a
+    /// circular fashion (the oldest is at #nextRpc).
+    Tub<WriteFragmentRpc> rpcs[MAX_OUTSTANDING_FRAGMENTS];
+
+    /// Index in #rpcs of the slot to use for the next fragment.
+    uint32_t nextRpc;
+
+    /// Number of constructed entries in #rpcs.
+    uint32_t outstanding;
+
+    /// True once commit has been called.
+    bool committed;
+
+    /// Upper limit on the number of bytes sent in one WRITE_FRAGMENT
+    /// request. Changed by unit tests.
+    uint32_t maxFragmentBytes;
+
+    DISALLOW_COPY_AND_ASSIGN(ObjectWriteStream);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_OBJECTWRITESTREAM_H
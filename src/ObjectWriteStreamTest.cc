@@ -0,0 +1,115 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "MockCluster.h"
+#include "ObjectWriteStream.h"
+
+namespace RAMCloud {
+
+class ObjectWriteStreamTest : public ::testing::Test {
+  public:
+    TestLog::Enable logEnabler;
+    Context context;
+    MockCluster cluster;
+    Tub<RamCloud> ramcloud;
+    uint64_t tableId;
+
+    ObjectWriteStreamTest()
+        : logEnabler()
+        , context()
+        , cluster(&context)
+        , ramcloud()
+        , tableId(-1)
+    {
+        Logger::get().setLogLevels(RAMCloud::SILENT_LOG_LEVEL);
+
+        ServerConfig config = ServerConfig::forTesting();
+        config.services = {WireFormat::MASTER_SERVICE,
+                           WireFormat::PING_SERVICE};
+        config.localLocator = "mock:host=master1";
+        cluster.addServer(config);
+
+        ramcloud.construct(&context, "mock:host=coordinator");
+        tableId = ramcloud->createTable("table1");
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(ObjectWriteStreamTest);
+};
+
+TEST_F(ObjectWriteStreamTest, basics) {
+    ramcloud->write(tableId, "key", 3, "old value", 9);
+    ObjectWriteStream stream(ramcloud.get(), tableId, "key", 3);
+    stream.maxFragmentBytes = 4;
+    stream.append("abcdefghij", 10);
+    stream.append("klmnopqrstuvwxyz", 16);
+    EXPECT_EQ(26U, stream.length);
+
+    // The object doesn't change until commit.
+    ObjectBuffer value;
+    ramcloud->readKeysAndValue(tableId, "key", 3, &value);
+    EXPECT_EQ("old value", string(reinterpret_cast<const char*>(
+            value.getValue()), 9));
+
+    uint64_t version;
+    stream.commit(&version);
+    EXPECT_EQ(2U, version);
+    uint32_t length;
+    ramcloud->readKeysAndValue(tableId, "key", 3, &value);
+    const void* data = value.getValue(&length);
+    EXPECT_EQ("abcdefghijklmnopqrstuvwxyz",
+            string(reinterpret_cast<const char*>(data), length));
+}
+
+TEST_F(ObjectWriteStreamTest, emptyValue) {
+    ObjectWriteStream stream(ramcloud.get(), tableId, "key", 3);
+    stream.commit();
+    ObjectBuffer value;
+    ramcloud->readKeysAndValue(tableId, "key", 3, &value);
+    uint32_t length;
+    value.getValue(&length);
+    EXPECT_EQ(0U, length);
+}
+
+TEST_F(ObjectWriteStreamTest, valueTooLarge) {
+    ObjectWriteStream stream(ramcloud.get(), tableId, "key", 3);
+    stream.maxFragmentBytes = 8192;
+    string data(40000, 'x');
+    EXPECT_THROW({
+        stream.append(data.data(), downCast<uint32_t>(data.size()));
+        stream.commit();
+    }, RequestTooLargeException);
+}
+
+TEST_F(ObjectWriteStreamTest, commit_missingData) {
+    ObjectWriteStream stream(ramcloud.get(), tableId, "key", 3);
+    stream.append("abcdef", 6);
+    stream.length++;
+    EXPECT_THROW(stream.commit(), InvalidParameterException);
+    Buffer value;
+    EXPECT_THROW(ramcloud->read(tableId, "key", 3, &value),
+            ObjectDoesntExistException);
+}
+
+TEST_F(ObjectWriteStreamTest, commit_rejectRules) {
+    ObjectWriteStream stream(ramcloud.get(), tableId, "key", 3);
+    stream.append("abcdef", 6);
+    RejectRules rules;
+    memset(&rules, 0, sizeof(rules));
+    rules.doesntExist = 1;
+    EXPECT_THROW(stream.commit(NULL, &rules), ObjectDoesntExistException);
+}
+
+}  // namespace RAMCloud
@@ -0,0 +1,85 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "PackedSchema.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct a schema with no fields; add them with addField.
+ */
+PackedSchema::PackedSchema()
+    : fields()
+    , recordLength(0)
+{
+}
+
+/**
+ * Add a field to the end of the schema's packed records.
+ *
+ * \param width
+ *      Bytes in the field, such as sizeof(uint32_t). Must be nonzero.
+ * \param structOffset
+ *      Where the field starts in the unpacked struct passed to pack and
+ *      unpack, such as offsetof(Reading, temperature).
+ * \return
+ *      The index of the new field, for use with ColumnScanner::getColumn.
+ */
+uint32_t
+PackedSchema::addField(uint32_t width, uint32_t structOffset)
+{
+    assert(width > 0);
+    fields.emplace_back(width, structOffset, recordLength);
+    recordLength += width;
+    return downCast<uint32_t>(fields.size() - 1);
+}
+
+/**
+ * Copy the fields of a struct into a packed record.
+ *
+ * \param source
+ *      The struct the schema describes.
+ * \param[out] record
+ *      The packed record is written here; it must have room for
+ *      getRecordLength() bytes.
+ */
+void
+PackedSchema::pack(const void* source, void* record) const
+{
+    const char* in = static_cast<const char*>(source);
+    char* out = static_cast<char*>(record);
+    foreach (const Field& field, fields)
+        memcpy(out + field.packedOffset, in + field.structOffset, field.width);
+}
+
+/**
+ * Copy the fields of a packed record into a struct. Bytes of the struct
+ * that aren't in any field (such as padding) are left alone.
+ *
+ * \param record
+ *      A packed record of getRecordLength() bytes.
+ * \param[out] destination
+ *      The struct the schema describes.
+ */
+void
+PackedSchema::unpack(const void* record, void* destination) const
+{
+    const char* in = static_cast<const char*>(record);
+    char* out = static_cast<char*>(destination);
+    foreach (const Field& field, fields)
+        memcpy(out + field.structOffset, in + field.packedOffset, field.width);
+}
+
+} // namespace RAMCloud
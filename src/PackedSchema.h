@@ -0,0 +1,93 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_PACKEDSCHEMA_H
+#define RAMCLOUD_PACKEDSCHEMA_H
+
+#include <vector>
+
+#include "Common.h"
+
+namespace RAMCloud {
+
+/**
+ * Describes a record made of fixed-width fields, such as a C struct, and
+ * converts between it and a packed form that stores the fields one after
+ * another with no padding between them. Clients use the packed form as the
+ * value of each object in tables whose objects all have the same layout,
+ * which makes the values smaller than the structs they came from, and lets
+ * ColumnScanner split them into one array per field.
+ *
+ * The packed form doesn't record the schema; the reader and writer of a
+ * table must agree on it.
+ */
+class PackedSchema {
+  PUBLIC:
+    PackedSchema();
+
+    uint32_t addField(uint32_t width, uint32_t structOffset);
+    void pack(const void* source, void* record) const;
+    void unpack(const void* record, void* destination) const;
+
+    /// Return the number of fields added so far.
+    uint32_t getFieldCount() const
+    {
+        return downCast<uint32_t>(fields.size());
+    }
+
+    /// Return the width, in bytes, of a field.
+    uint32_t getFieldWidth(uint32_t field) const
+    {
+        return fields[field].width;
+    }
+
+    /// Return where a field starts in a packed record.
+    uint32_t getFieldOffset(uint32_t field) const
+    {
+        return fields[field].packedOffset;
+    }
+
+    /// Return the length of a packed record.
+    uint32_t getRecordLength() const { return recordLength; }
+
+  PRIVATE:
+    /// Describes one field.
+    struct Field {
+        Field(uint32_t width, uint32_t structOffset, uint32_t packedOffset)
+            : width(width)
+            , structOffset(structOffset)
+            , packedOffset(packedOffset)
+        {}
+
+        /// Bytes in the field.
+        uint32_t width;
+
+        /// Where the field starts in the unpacked struct.
+        uint32_t structOffset;
+
+        /// Where the field starts in a packed record.
+        uint32_t packedOffset;
+    };
+
+    /// The fields, in the order they appear in packed records.
+    std::vector<Field> fields;
+
+    /// Sum of the widths of all of the fields.
+    uint32_t recordLength;
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_PACKEDSCHEMA_H
@@ -0,0 +1,74 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stddef.h>
+
+#include "TestUtil.h"
+#include "PackedSchema.h"
+
+namespace RAMCloud {
+
+namespace {
+struct Reading {
+    uint8_t sensor;
+    uint64_t time;
+    uint16_t flags;
+    float temperature;
+};
+}
+
+TEST(PackedSchemaTest, addField) {
+    PackedSchema schema;
+    EXPECT_EQ(0u, schema.getRecordLength());
+    EXPECT_EQ(0u, schema.addField(1, offsetof(Reading, sensor)));
+    EXPECT_EQ(1u, schema.addField(8, offsetof(Reading, time)));
+    EXPECT_EQ(2u, schema.addField(2, offsetof(Reading, flags)));
+    EXPECT_EQ(3u, schema.getFieldCount());
+    EXPECT_EQ(8u, schema.getFieldWidth(1));
+    EXPECT_EQ(9u, schema.getFieldOffset(2));
+    EXPECT_EQ(11u, schema.getRecordLength());
+}
+
+TEST(PackedSchemaTest, packAndUnpack) {
+    PackedSchema schema;
+    schema.addField(1, offsetof(Reading, sensor));
+    schema.addField(8, offsetof(Reading, time));
+    schema.addField(2, offsetof(Reading, flags));
+    schema.addField(4, offsetof(Reading, temperature));
+    EXPECT_LT(schema.getRecordLength(), sizeof(Reading));
+
+    Reading in;
+    memset(&in, 0, sizeof(in));
+    in.sensor = 7;
+    in.time = 123456789012UL;
+    in.flags = 0x1234;
+    in.temperature = 21.5;
+    char record[15];
+    schema.pack(&in, record);
+    EXPECT_EQ(7, record[0]);
+    uint64_t time;
+    memcpy(&time, record + 1, sizeof(time));
+    EXPECT_EQ(123456789012UL, time);
+
+    Reading out;
+    memset(&out, 0, sizeof(out));
+    schema.unpack(record, &out);
+    EXPECT_EQ(7, out.sensor);
+    EXPECT_EQ(123456789012UL, out.time);
+    EXPECT_EQ(0x1234, out.flags);
+    EXPECT_EQ(21.5, out.temperature);
+}
+
+}  // namespace RAMCloud
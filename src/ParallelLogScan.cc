@@ -0,0 +1,110 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <thread>
+
+#include "ParallelLogScan.h"
+#include "SegmentIterator.h"
+#include "ShortMacros.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct a ParallelLogScan; nothing is scanned until #run is invoked.
+ *
+ * \param log
+ *      The log to scan.
+ */
+ParallelLogScan::ParallelLogScan(Log& log)
+    : log(log)
+    , activity()
+    , segments()
+    , head(NULL)
+    , headLength(0)
+    , nextSegment(0)
+{
+}
+
+/**
+ * Visit every entry in the log, splitting the work across one thread per
+ * callback (including the calling thread, which uses the first). Returns
+ * once all of the entries have been visited.
+ *
+ * \param callbacks
+ *      Each thread hands the entries it visits to its own one of these.
+ *      Must not be empty.
+ */
+void
+ParallelLogScan::run(std::vector<Callback*>& callbacks)
+{
+    LogProtector::Guard _(activity);
+    segments.clear();
+    {
+        SpinLock::Guard lock(log.appendLock);
+        head = log.head;
+        if (head != NULL)
+            headLength = head->getAppendedLength();
+    }
+    log.getSegments(segments);
+    nextSegment = 0;
+
+    std::vector<std::thread> helpers;
+    for (size_t i = 1; i < callbacks.size(); i++) {
+        helpers.emplace_back([this, i, &callbacks] {
+            scanSegments(callbacks[i]);
+        });
+    }
+    scanSegments(callbacks[0]);
+    foreach (std::thread& helper, helpers)
+        helper.join();
+    TEST_LOG("scanned %lu segments using %lu threads", segments.size(),
+            callbacks.size());
+}
+
+/**
+ * The main loop of each thread in #run: visit the entries of one segment
+ * after another, until there are no more segments left to scan.
+ *
+ * \param callback
+ *      The entries are handed to this.
+ */
+void
+ParallelLogScan::scanSegments(Callback* callback)
+{
+    while (true) {
+        size_t index = nextSegment++;
+        if (index >= segments.size())
+            return;
+        LogSegment* segment = segments[index];
+        SegmentIterator it(*segment);
+        if (segment == head)
+            it.setLimit(headLength);
+        for (; !it.isDone(); it.next()) {
+            // Entries are laid out one after another, so prefetching a
+            // fixed distance ahead covers the next few of them.
+            const void* ahead;
+            uint32_t contiguous = segment->peek(it.getOffset() +
+                    PREFETCH_BYTES, &ahead);
+            if (contiguous > 0)
+                prefetch(ahead, std::min<uint32_t>(contiguous, 64));
+
+            Buffer buffer;
+            it.appendToBuffer(buffer);
+            callback->handleEntry(it.getType(), buffer, it.getReference());
+        }
+    }
+}
+
+} // namespace RAMCloud
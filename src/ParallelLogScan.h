@@ -0,0 +1,100 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_PARALLELLOGSCAN_H
+#define RAMCLOUD_PARALLELLOGSCAN_H
+
+#include <atomic>
+#include <vector>
+
+#include "Log.h"
+#include "LogProtector.h"
+
+namespace RAMCloud {
+
+/**
+ * A ParallelLogScan visits every entry in a log using several threads, for
+ * maintenance operations (such as ObjectManager::getMemoryUsage) that read
+ * the whole log and don't care in what order its entries are visited. Work
+ * is handed out a segment at a time, so threads that land on emptier
+ * segments simply take more of them, and each thread prefetches the entries
+ * a little ahead of the one it is visiting, since whole-log scans are
+ * otherwise dominated by cache misses.
+ *
+ * Each thread hands its entries to its own Callback, so callbacks can keep
+ * their own totals without synchronizing and the caller combines them once
+ * the scan is done. Unlike LogIterator, a scan doesn't wait for the head:
+ * it visits the segments in the log when it starts, up to where the head
+ * had been appended to, and entries appended during the scan may or may
+ * not be visited. Entries moved by the cleaner during the scan may be
+ * visited twice or not at all, so callers that need an exact view of the
+ * log (such as migration) must use LogIterator instead.
+ */
+class ParallelLogScan {
+  PUBLIC:
+    /**
+     * Receives the entries visited by one thread of a scan. Callbacks must
+     * not throw exceptions.
+     */
+    class Callback {
+      public:
+        virtual ~Callback() {}
+
+        /**
+         * Visit one log entry.
+         *
+         * \param type
+         *      Type of the entry.
+         * \param buffer
+         *      The entry's contents.
+         * \param reference
+         *      Where the entry is in the log.
+         */
+        virtual void handleEntry(LogEntryType type, Buffer& buffer,
+                Log::Reference reference) = 0;
+    };
+
+    explicit ParallelLogScan(Log& log);
+    void run(std::vector<Callback*>& callbacks);
+
+  PRIVATE:
+    void scanSegments(Callback* callback);
+
+    /// Bytes to prefetch ahead of the entry being visited.
+    static const uint32_t PREFETCH_BYTES = 1024;
+
+    /// The log being scanned.
+    Log& log;
+
+    /// Keeps the cleaner from freeing the segments being scanned.
+    LogProtector::Activity activity;
+
+    /// The segments being scanned.
+    LogSegmentVector segments;
+
+    /// The head of the log when the scan started, and how much of it had
+    /// been appended to then.
+    LogSegment* head;
+    uint32_t headLength;
+
+    /// Index in #segments of the next one for a thread to scan.
+    std::atomic<size_t> nextSegment;
+
+    DISALLOW_COPY_AND_ASSIGN(ParallelLogScan);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_PARALLELLOGSCAN_H
@@ -0,0 +1,151 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <set>
+
+#include "TestUtil.h"
+
+#include "Log.h"
+#include "LogIterator.h"
+#include "ParallelLogScan.h"
+#include "ReplicaManager.h"
+#include "SegmentManager.h"
+#include "ServerConfig.h"
+#include "ServerList.h"
+#include "MasterTableMetadata.h"
+
+namespace RAMCloud {
+
+class ParallelLogScanTestHandlers : public LogEntryHandlers {
+  public:
+    uint32_t getTimestamp(LogEntryType type, Buffer& buffer) { return 0; }
+    void relocate(LogEntryType type,
+                  Buffer& oldBuffer,
+                  Log::Reference oldReference,
+                  LogEntryRelocator& relocator) { }
+};
+
+/**
+ * Records the entries handed to it.
+ */
+class EntryRecorder : public ParallelLogScan::Callback {
+  public:
+    EntryRecorder() : references(), objects(0) {}
+    void
+    handleEntry(LogEntryType type, Buffer& buffer, Log::Reference reference)
+    {
+        references.push_back(reference.toInteger());
+        if (type == LOG_ENTRY_TYPE_OBJ)
+            objects++;
+    }
+
+    std::vector<uint64_t> references;
+    uint32_t objects;
+};
+
+class ParallelLogScanTest : public ::testing::Test {
+  public:
+    Context context;
+    ServerId serverId;
+    ServerList serverList;
+    ServerConfig serverConfig;
+    ReplicaManager replicaManager;
+    MasterTableMetadata masterTableMetadata;
+    SegletAllocator allocator;
+    SegmentManager segmentManager;
+    ParallelLogScanTestHandlers entryHandlers;
+    Log l;
+    char data[1000];
+
+    ParallelLogScanTest()
+        : context(),
+          serverId(ServerId(57, 0)),
+          serverList(&context),
+          serverConfig(ServerConfig::forTesting()),
+          replicaManager(&context, &serverId, 0, false, false),
+          masterTableMetadata(),
+          allocator(&serverConfig),
+          segmentManager(&context, &serverConfig, &serverId,
+                         allocator, replicaManager, &masterTableMetadata),
+          entryHandlers(),
+          l(&context, &serverConfig, &entryHandlers,
+            &segmentManager, &replicaManager),
+          data()
+    {
+    }
+
+  private:
+    DISALLOW_COPY_AND_ASSIGN(ParallelLogScanTest);
+};
+
+TEST_F(ParallelLogScanTest, run_emptyLog) {
+    EntryRecorder recorder;
+    std::vector<ParallelLogScan::Callback*> callbacks = {&recorder};
+    ParallelLogScan scan(l);
+    scan.run(callbacks);
+    EXPECT_EQ(0U, recorder.references.size());
+}
+
+TEST_F(ParallelLogScanTest, run_visitsEveryEntryOnce) {
+    l.sync();
+    while (l.head == NULL || l.head->id < 5)
+        l.append(LOG_ENTRY_TYPE_OBJ, data, sizeof(data));
+    uint32_t appended = 0;
+    for (LogIterator it(l); !it.isDone(); it.next()) {
+        if (it.getType() == LOG_ENTRY_TYPE_OBJ)
+            appended++;
+    }
+
+    EntryRecorder recorders[3];
+    std::vector<ParallelLogScan::Callback*> callbacks = {
+            &recorders[0], &recorders[1], &recorders[2]};
+    ParallelLogScan scan(l);
+    TestLog::Enable _("run");
+    scan.run(callbacks);
+    EXPECT_EQ("run: scanned 5 segments using 3 threads", TestLog::get());
+
+    std::set<uint64_t> references;
+    uint32_t objects = 0;
+    size_t visited = 0;
+    foreach (EntryRecorder& recorder, recorders) {
+        references.insert(recorder.references.begin(),
+                recorder.references.end());
+        visited += recorder.references.size();
+        objects += recorder.objects;
+    }
+    EXPECT_EQ(appended, objects);
+    EXPECT_EQ(visited, references.size());
+}
+
+TEST_F(ParallelLogScanTest, run_stopsAtHeadLength) {
+    l.sync();
+    l.append(LOG_ENTRY_TYPE_OBJ, data, sizeof(data));
+    EntryRecorder recorder;
+    std::vector<ParallelLogScan::Callback*> callbacks = {&recorder};
+    ParallelLogScan scan(l);
+    scan.run(callbacks);
+    EXPECT_EQ(1U, recorder.objects);
+
+    // Entries appended after the scan starts aren't visited.
+    l.append(LOG_ENTRY_TYPE_OBJ, data, sizeof(data));
+    scan.segments.clear();
+    scan.nextSegment = 0;
+    l.getSegments(scan.segments);
+    recorder.objects = 0;
+    scan.scanSegments(&recorder);
+    EXPECT_EQ(1U, recorder.objects);
+}
+
+}  // namespace RAMCloud
@@ -0,0 +1,311 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "ParallelTableEnumerator.h"
+#include "ObjectFinder.h"
+#include "ShortMacros.h"
+
+namespace RAMCloud {
+
+/**
+ * Constructor for ParallelTableEnumerator objects. This finds the tablets
+ * of the table, but doesn't start enumerating them until the first call
+ * to #hasNext or #next.
+ *
+ * \param ramcloud
+ *      Overall information about the RAMCloud cluster to use for this
+ *      enumeration.
+ * \param tableId
+ *      Identifier for the table to enumerate.
+ * \param keysOnly
+ *      False means that full objects are returned, containing both keys
+ *      and data. True means that the returned objects have
+ *      been truncated so that the object data (normally the last
+ *      field of the object) is omitted.
+ * \param maxStreams
+ *      The most tablets to enumerate at once. Each one may hold up to two
+ *      responses (several MB each) in memory.
+ * \param filter
+ *      If non-NULL, only the objects that match this filter are returned,
+ *      with just the part of their values that it selects. The filter is
+ *      copied, so it needn't outlive this call.
+ *
+ * \throw TableDoesntExistException
+ *      The coordinator has no record of the table.
+ */
+ParallelTableEnumerator::ParallelTableEnumerator(RamCloud& ramcloud,
+        uint64_t tableId, bool keysOnly, uint32_t maxStreams,
+        const ObjectFilter* filter)
+    : ramcloud(ramcloud)
+    , tableId(tableId)
+    , keysOnly(keysOnly)
+    , maxStreams(maxStreams)
+    , filter()
+    , pendingStreams()
+    , activeStreams()
+    , readyBatches()
+    , currentStream(NULL)
+    , currentBatch(NULL)
+    , nextOffset(0)
+    , nextObjectChecked(false)
+    , done(false)
+{
+    if (filter != NULL)
+        this->filter.construct(*filter);
+
+    ObjectFinder* objectFinder = ramcloud.clientContext->objectFinder;
+    uint64_t firstHash = 0;
+    while (true) {
+        uint64_t lastHash = objectFinder->lookupTablet(tableId,
+                firstHash)->tablet.endKeyHash;
+        pendingStreams.push_back(new Stream(firstHash, lastHash));
+        if (lastHash == ~0LU)
+            break;
+        firstHash = lastHash + 1;
+    }
+}
+
+/**
+ * Destructor for ParallelTableEnumerator objects; cancels any outstanding
+ * requests.
+ */
+ParallelTableEnumerator::~ParallelTableEnumerator()
+{
+    foreach (Stream* stream, pendingStreams)
+        delete stream;
+    foreach (Stream* stream, activeStreams)
+        delete stream;
+}
+
+/**
+ * Test if any objects remain to be enumerated from the table.
+ *
+ * \result
+ *      True if any objects remain, or false otherwise.
+ */
+bool
+ParallelTableEnumerator::hasNext()
+{
+    requestMoreObjects();
+    return !done;
+}
+
+/**
+ * Return the next object in the table.  Note: each object that existed
+ * throughout the entire lifetime of the enumeration is guaranteed to
+ * be returned exactly once.  Objects that are created after the enumeration
+ * starts, or that are deleted before the enumeration completes, will be
+ * returned either 0 or 1 time.
+ *
+ * \param[out] size
+ *      After a successful return, this field will hold the size of
+ *      the object in bytes.
+ * \param[out] object
+ *      After a successful return, this will point to contiguous
+ *      memory containing an instance of Object immediately followed
+ *      by its key and data payloads. NULL is returned to indicate
+ *      that the enumeration is complete. The memory remains valid until
+ *      the next call to #hasNext or #next.
+ */
+void
+ParallelTableEnumerator::next(uint32_t* size, const void** object)
+{
+    *size = 0;
+    *object = NULL;
+
+    requestMoreObjects();
+    if (done) return;
+
+    uint32_t objectSize = *currentBatch->getOffset<uint32_t>(nextOffset);
+    nextOffset += sizeof32(uint32_t);
+    *object = currentBatch->getRange(nextOffset, objectSize);
+    *size = objectSize;
+    nextOffset += objectSize;
+    nextObjectChecked = false;
+}
+
+/**
+ * Returns the next object in the enumeration, if any, with a more
+ * convenient interface than hasNext and next; see
+ * TableEnumerator::nextKeyAndData.
+ *
+ * \param[out] keyLength
+ *      After successful return, this field holds the size of the key in bytes.
+ * \param[out] key
+ *      After a successful return, this points to contiguous memory containing
+ *      the key. NULL is returned to indicate enumeration is complete.
+ * \param[out] dataLength
+ *      After successful return, this field holds the size of the data in bytes.
+ * \param[out] data
+ *      After a successful return, this points to contiguous memory containing
+ *      the data. If the keysOnly flag is set while constructing the
+ *      enumerator, NULL is returned.
+ */
+void
+ParallelTableEnumerator::nextKeyAndData(uint32_t* keyLength, const void** key,
+        uint32_t* dataLength, const void** data)
+{
+    *keyLength = 0;
+    *key = NULL;
+    *dataLength = 0;
+    *data = NULL;
+
+    uint32_t size = 0;
+    const void* buffer = 0;
+    next(&size, &buffer);
+    if (done) return;
+
+    Object object(buffer, size);
+    *keyLength = object.getKeyLength();
+    *key = object.getKey();
+
+    if (!keysOnly) {
+        *data = object.getValue(dataLength);
+    }
+}
+
+/**
+ * Collect the response to a stream's outstanding request, and either queue
+ * the objects it returned for the caller or move on to the next request.
+ *
+ * \param stream
+ *      Stream whose request has completed (isReady returned true).
+ */
+void
+ParallelTableEnumerator::finishRpc(Stream* stream)
+{
+    uint64_t nextHash = stream->rpc->wait(stream->state);
+    stream->rpc.destroy();
+    Buffer* objects = &stream->batches[stream->fill];
+
+    if (objects->size() > 0) {
+        stream->nextHash = nextHash;
+        readyBatches.emplace_back(stream, objects);
+        stream->held++;
+        stream->fill ^= 1;
+        if (stream->held < 2)
+            sendRpc(stream);
+        return;
+    }
+
+    // The tablet has been enumerated completely. If it was split during
+    // the enumeration, the rest of this stream's range is in another tablet.
+    if (nextHash != 0 && nextHash <= stream->lastHash) {
+        stream->nextHash = nextHash;
+        stream->state.reset();
+        sendRpc(stream);
+    } else {
+        stream->finished = true;
+    }
+}
+
+/**
+ * Called when the caller has read all of the objects in #currentBatch,
+ * so that its buffer can be reused.
+ */
+void
+ParallelTableEnumerator::releaseBatch()
+{
+    currentBatch->reset();
+    currentStream->held--;
+    if (!currentStream->finished && !currentStream->rpc)
+        sendRpc(currentStream);
+    currentBatch = NULL;
+    currentStream = NULL;
+}
+
+/**
+ * Used internally by #hasNext() and #next() to retrieve objects. Will
+ * set the #done field if enumeration is complete. Otherwise #nextOffset
+ * will refer to an object in #currentBatch that belongs to #currentStream.
+ */
+void
+ParallelTableEnumerator::requestMoreObjects()
+{
+    while (!done) {
+        if (currentBatch != NULL) {
+            // If a tablet is merged with its neighbor while it is being
+            // enumerated, the server returns the neighbor's objects as
+            // well; those belong to another stream, so skip them.
+            while (nextOffset < currentBatch->size()) {
+                if (nextObjectChecked)
+                    return;
+                uint32_t objectSize =
+                        *currentBatch->getOffset<uint32_t>(nextOffset);
+                Object object(*currentBatch, nextOffset + sizeof32(uint32_t),
+                        objectSize);
+                Key key(tableId, object.getKey(), object.getKeyLength());
+                if (key.getHash() <= currentStream->lastHash) {
+                    nextObjectChecked = true;
+                    return;
+                }
+                nextOffset += sizeof32(uint32_t) + objectSize;
+            }
+            releaseBatch();
+        }
+
+        while (readyBatches.empty()) {
+            while (activeStreams.size() < maxStreams &&
+                    !pendingStreams.empty()) {
+                Stream* stream = pendingStreams.front();
+                pendingStreams.pop_front();
+                activeStreams.push_back(stream);
+                sendRpc(stream);
+            }
+            if (activeStreams.empty()) {
+                done = true;
+                return;
+            }
+
+            for (size_t i = 0; i < activeStreams.size(); ) {
+                Stream* stream = activeStreams[i];
+                if (stream->rpc && stream->rpc->isReady())
+                    finishRpc(stream);
+                if (stream->finished && stream->held == 0) {
+                    delete stream;
+                    activeStreams.erase(activeStreams.begin() + i);
+                    continue;
+                }
+                i++;
+            }
+            if (readyBatches.empty())
+                ramcloud.poll();
+        }
+
+        currentStream = readyBatches.front().first;
+        currentBatch = readyBatches.front().second;
+        readyBatches.pop_front();
+        nextOffset = 0;
+        nextObjectChecked = false;
+    }
+}
+
+/**
+ * Issue the next ENUMERATE request for a stream.
+ *
+ * \param stream
+ *      Stream that has no outstanding request and at least one free batch
+ *      buffer.
+ */
+void
+ParallelTableEnumerator::sendRpc(Stream* stream)
+{
+    Buffer* objects = &stream->batches[stream->fill];
+    objects->reset();
+    stream->rpc.construct(&ramcloud, tableId, keysOnly, stream->nextHash,
+            stream->state, *objects, filter.get());
+}
+
+} // namespace RAMCloud
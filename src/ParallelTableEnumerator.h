@@ -0,0 +1,153 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_PARALLELTABLEENUMERATOR_H
+#define RAMCLOUD_PARALLELTABLEENUMERATOR_H
+
+#include <deque>
+#include <utility>
+
+#include "RamCloud.h"
+#include "Object.h"
+#include "ObjectFilter.h"
+#include "Tub.h"
+
+namespace RAMCloud {
+
+/**
+ * A TableEnumerator that enumerates all of the tablets of a table at once,
+ * rather than one after another. Each tablet is enumerated by its own
+ * stream of ENUMERATE requests, and each stream keeps its next request
+ * outstanding while the caller reads the objects from the previous one,
+ * so the latency of each batch overlaps with the processing of others.
+ *
+ * Objects are returned with the same guarantees as TableEnumerator, but
+ * in no particular order (batches from different tablets are interleaved
+ * in the order they arrive).
+ */
+class ParallelTableEnumerator {
+  public:
+    ParallelTableEnumerator(RamCloud& ramcloud, uint64_t tableId,
+            bool keysOnly, uint32_t maxStreams = 8,
+            const ObjectFilter* filter = NULL);
+    ~ParallelTableEnumerator();
+    bool hasNext();
+    void next(uint32_t* size, const void** object);
+    void nextKeyAndData(uint32_t* keyLength, const void** key,
+                        uint32_t* dataLength, const void** data);
+
+  PRIVATE:
+    /**
+     * The enumeration of the objects with key hashes in a given range,
+     * which was a single tablet when the enumeration started.
+     */
+    struct Stream {
+        Stream(uint64_t firstHash, uint64_t lastHash)
+            : nextHash(firstHash)
+            , lastHash(lastHash)
+            , state()
+            , batches()
+            , fill(0)
+            , held(0)
+            , finished(false)
+            , rpc()
+        {}
+
+        /// Passed as tabletFirstHash in the next ENUMERATE request.
+        uint64_t nextHash;
+
+        /// Largest key hash that belongs to this stream.
+        uint64_t lastHash;
+
+        /// Server-managed state of the enumeration of the current tablet.
+        Buffer state;
+
+        /// Each request fills one of these while the caller may be reading
+        /// objects from the other.
+        Buffer batches[2];
+
+        /// Index in #batches of the buffer for the next response.
+        int fill;
+
+        /// Number of #batches that have been received but not yet completely
+        /// read by the caller.
+        int held;
+
+        /// True means that all of this stream's objects have been received.
+        bool finished;
+
+        /// The outstanding request, if any.
+        Tub<EnumerateTableRpc> rpc;
+
+        DISALLOW_COPY_AND_ASSIGN(Stream);
+    };
+
+    void finishRpc(Stream* stream);
+    void releaseBatch();
+    void requestMoreObjects();
+    void sendRpc(Stream* stream);
+
+    /// The RamCloud master object.
+    RamCloud& ramcloud;
+
+    /// The table being enumerated.
+    uint64_t tableId;
+
+    /// False means that full objects are returned, containing both keys
+    /// and data. True means that the returned objects have
+    /// been truncated so that the object data (normally the last
+    /// field of the object) is omitted.
+    bool keysOnly;
+
+    /// The most streams that may be enumerating at once; each one may
+    /// hold up to two full responses.
+    uint32_t maxStreams;
+
+    /// If set, the masters return only the objects that match this
+    /// filter, with just the part of their values that it selects.
+    Tub<ObjectFilter> filter;
+
+    /// Streams that haven't been started yet.
+    std::deque<Stream*> pendingStreams;
+
+    /// Streams that have been started and not yet deleted.
+    std::vector<Stream*> activeStreams;
+
+    /// Batches that have been received but not yet read, in the order
+    /// they arrived, along with their streams.
+    std::deque<std::pair<Stream*, Buffer*>> readyBatches;
+
+    /// The stream that #currentBatch belongs to.
+    Stream* currentStream;
+
+    /// The batch of objects currently being read out by the caller, or NULL.
+    Buffer* currentBatch;
+
+    /// The next offset to read within #currentBatch.
+    uint32_t nextOffset;
+
+    /// True means the object at #nextOffset is known to belong to
+    /// #currentStream.
+    bool nextObjectChecked;
+
+    /// Set to true when the entire enumeration has completed.
+    bool done;
+
+    DISALLOW_COPY_AND_ASSIGN(ParallelTableEnumerator);
+};
+
+} // end RAMCloud
+
+#endif  // RAMCLOUD_PARALLELTABLEENUMERATOR_H
@@ -0,0 +1,177 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "MockCluster.h"
+#include "ParallelTableEnumerator.h"
+
+namespace RAMCloud {
+
+class ParallelTableEnumeratorTest : public ::testing::Test {
+  public:
+    TestLog::Enable logEnabler;
+    Context context;
+    MockCluster cluster;
+    RamCloud ramcloud;
+    uint64_t tableId1;
+
+  public:
+    ParallelTableEnumeratorTest()
+        : logEnabler()
+        , context()
+        , cluster(&context)
+        , ramcloud(&context, "mock:host=coordinator")
+        , tableId1(-1)
+    {
+        Logger::get().setLogLevels(RAMCloud::SILENT_LOG_LEVEL);
+
+        ServerConfig config = ServerConfig::forTesting();
+        config.services = {WireFormat::MASTER_SERVICE,
+                           WireFormat::PING_SERVICE};
+        config.localLocator = "mock:host=master1";
+        cluster.addServer(config);
+        config.localLocator = "mock:host=master2";
+        cluster.addServer(config);
+
+        tableId1 = ramcloud.createTable("table1", 2);
+    }
+
+    /// Enumerate the table and return the keys and values, sorted
+    /// by key, in the form "key:value key:value ...".
+    string
+    enumerate(ParallelTableEnumerator* iter)
+    {
+        std::vector<string> objects;
+        while (iter->hasNext()) {
+            uint32_t keyLength, dataLength;
+            const void* key;
+            const void* data;
+            iter->nextKeyAndData(&keyLength, &key, &dataLength, &data);
+            string object(static_cast<const char*>(key), keyLength);
+            object.append(":");
+            if (data != NULL)
+                object.append(static_cast<const char*>(data), dataLength);
+            objects.push_back(object);
+        }
+        std::sort(objects.begin(), objects.end());
+        string result;
+        foreach (const string& object, objects) {
+            result.append(result.empty() ? "" : " ");
+            result.append(object);
+        }
+        return result;
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(ParallelTableEnumeratorTest);
+};
+
+TEST_F(ParallelTableEnumeratorTest, constructor) {
+    ParallelTableEnumerator iter(ramcloud, tableId1, false);
+    ASSERT_EQ(2U, iter.pendingStreams.size());
+    EXPECT_EQ(0U, iter.pendingStreams[0]->nextHash);
+    EXPECT_EQ(0x7fffffffffffffffU, iter.pendingStreams[0]->lastHash);
+    EXPECT_EQ(0x8000000000000000U, iter.pendingStreams[1]->nextHash);
+    EXPECT_EQ(~0LU, iter.pendingStreams[1]->lastHash);
+
+    EXPECT_THROW(ParallelTableEnumerator(ramcloud, 99, false),
+            TableDoesntExistException);
+}
+
+TEST_F(ParallelTableEnumeratorTest, basics) {
+    ramcloud.write(tableId1, "0", 1, "abcdef", 6);
+    ramcloud.write(tableId1, "1", 1, "ghijkl", 6);
+    ramcloud.write(tableId1, "2", 1, "mnopqr", 6);
+    ramcloud.write(tableId1, "3", 1, "stuvwx", 6);
+    ramcloud.write(tableId1, "4", 1, "yzabcd", 6);
+
+    ParallelTableEnumerator iter(ramcloud, tableId1, false);
+    EXPECT_EQ("0:abcdef 1:ghijkl 2:mnopqr 3:stuvwx 4:yzabcd",
+            enumerate(&iter));
+    EXPECT_EQ(0U, iter.activeStreams.size());
+
+    uint32_t size;
+    const void* object;
+    iter.next(&size, &object);
+    EXPECT_EQ(0U, size);
+    EXPECT_TRUE(object == NULL);
+}
+
+TEST_F(ParallelTableEnumeratorTest, emptyTable) {
+    ParallelTableEnumerator iter(ramcloud, tableId1, false);
+    EXPECT_FALSE(iter.hasNext());
+}
+
+TEST_F(ParallelTableEnumeratorTest, keysOnly) {
+    ramcloud.write(tableId1, "0", 1, "abcdef", 6);
+    ramcloud.write(tableId1, "1", 1, "ghijkl", 6);
+
+    ParallelTableEnumerator iter(ramcloud, tableId1, true);
+    EXPECT_EQ("0: 1:", enumerate(&iter));
+}
+
+TEST_F(ParallelTableEnumeratorTest, pipelinedBatches) {
+    uint32_t dataSize(1024 * 32);
+    char data[dataSize];
+    memset(data, 'x', dataSize);
+    uint32_t totalObjects(1024);
+    for (uint32_t i = 0; i < totalObjects; i++) {
+        ramcloud.write(tableId1, &i, 4, data, dataSize);
+    }
+
+    // Each tablet needs several batches; the next one for a tablet is
+    // requested as soon as the previous one arrives.
+    ParallelTableEnumerator iter(ramcloud, tableId1, false, 1);
+    EXPECT_TRUE(iter.hasNext());
+    ASSERT_EQ(1U, iter.activeStreams.size());
+    EXPECT_EQ(1U, iter.pendingStreams.size());
+    EXPECT_TRUE(iter.activeStreams[0]->rpc);
+
+    std::vector<bool> seen(totalObjects, false);
+    uint32_t count = 0;
+    while (iter.hasNext()) {
+        uint32_t size = 0;
+        const void* buffer = 0;
+        iter.next(&size, &buffer);
+        Object object(buffer, size);
+        EXPECT_EQ(4U, object.getKeyLength());
+        EXPECT_EQ(dataSize, object.getValueLength());
+        uint32_t key = *static_cast<const uint32_t*>(object.getKey());
+        ASSERT_LT(key, totalObjects);
+        EXPECT_FALSE(seen[key]);
+        seen[key] = true;
+        count++;
+    }
+    EXPECT_EQ(totalObjects, count);
+
+    for (uint32_t i = 0; i < totalObjects; i++) {
+        ramcloud.remove(tableId1, &i, 4);
+    }
+}
+
+TEST_F(ParallelTableEnumeratorTest, requestMoreObjects_skipForeignObjects) {
+    ramcloud.write(tableId1, "0", 1, "abcdef", 6);
+    ramcloud.write(tableId1, "1", 1, "ghijkl", 6);
+    ramcloud.write(tableId1, "2", 1, "mnopqr", 6);
+
+    // Pretend that each stream covers only its first key hash; the servers
+    // still return all of their objects (as they would if the tablets had
+    // been merged with their neighbors), but those must be skipped.
+    ParallelTableEnumerator iter(ramcloud, tableId1, false);
+    foreach (ParallelTableEnumerator::Stream* stream, iter.pendingStreams)
+        stream->lastHash = stream->nextHash;
+    EXPECT_FALSE(iter.hasNext());
+}
+
+}  // namespace RAMCloud
@@ -19,11 +19,14 @@
 // tests measure performance in a single stand-alone process, not in a cluster
 // with multiple servers.  Invoke the program like this:
 //
-//     Perf test1 test2 ...
+//     Perf [--json] [--repeat count] test1 test2 ...
 //
 // test1 and test2 are the names of individual performance measurements to
 // run.  If no test names are provided then all of the performance tests
-// are run.
+// are run.  --repeat runs each test count times and reports the median,
+// which varies less from one invocation to the next; --json prints the
+// results (including the fastest and slowest run) in a form that scripts
+// can compare across releases to find regressions.
 //
 // To add a new test:
 // * Write a function that implements the test.  Use existing test functions
@@ -36,9 +39,11 @@
 #include <cstdatomic>
 #endif
 #include <vector>
+#include <algorithm>
 
 #include "Common.h"
 #include "Atomic.h"
+#include "Crc32C.h"
 #include "Cycles.h"
 #include "CycleCounter.h"
 #include "Dispatch.h"
@@ -334,6 +339,41 @@ double bufferCopy()
     return Cycles::toSeconds(stop - start)/count;
 }
 
+// Measure the cost of copying 100 bytes that span 2 chunks out of a buffer.
+double bufferCopy100()
+{
+    int count = 1000000;
+    char data[200];
+    memset(data, 'a', sizeof(data));
+    Buffer b;
+    b.appendExternal(data, 60);
+    b.appendExternal(data + 60, 140);
+    char copy[100];
+    uint64_t start = Cycles::rdtsc();
+    for (int i = 0; i < count; i++) {
+        b.copy(10, 100, copy);
+    }
+    uint64_t stop = Cycles::rdtsc();
+    return Cycles::toSeconds(stop - start)/count;
+}
+
+// Measure the cost of copying 8 MB (a segment's worth) out of a buffer.
+double bufferCopyLarge()
+{
+    int count = 100;
+    uint32_t length = 8*1024*1024;
+    std::vector<char> data(length, 'a');
+    std::vector<char> copy(length);
+    Buffer b;
+    b.appendExternal(&data[0], length);
+    uint64_t start = Cycles::rdtsc();
+    for (int i = 0; i < count; i++) {
+        b.copy(0, length, &copy[0]);
+    }
+    uint64_t stop = Cycles::rdtsc();
+    return Cycles::toSeconds(stop - start)/count;
+}
+
 double bufferConstruct() {
     int count = 1000000;
     uint64_t start = Cycles::rdtsc();
@@ -397,6 +437,27 @@ double bufferGetStart()
     return Cycles::toSeconds(stop - start)/count;
 }
 
+// Measure the cost of Buffer::getRange for a range that lies within one
+// chunk, but not the chunk most recently accessed.
+double bufferGetRange()
+{
+    int count = 1000000;
+    char data[100];
+    memset(data, 'a', sizeof(data));
+    Buffer b;
+    b.appendExternal(data, 50);
+    b.appendExternal(data + 50, 50);
+    int sum = 0;
+    uint64_t start = Cycles::rdtsc();
+    for (int i = 0; i < count; i++) {
+        sum += *static_cast<char*>(b.getRange(60, 20));
+        sum += *static_cast<char*>(b.getRange(10, 20));
+    }
+    uint64_t stop = Cycles::rdtsc();
+    discard(&sum);
+    return Cycles::toSeconds(stop - start)/(2*count);
+}
+
 // Measure the cost of creating an iterator and iterating over/accessing
 // 1 byte in every appendCopy()ed, 100-byte chunk.
 template<uint32_t chunks>
@@ -559,6 +620,27 @@ double cppAtomicLoad()
     return Cycles::toSeconds(stop - start)/count;
 }
 
+// Measure the cost of computing a CRC32C over a buffer of the given size
+// that is already in the cache.
+template <int bufferSize>
+double crc32c()
+{
+    int count = 100000;
+    static char buf[bufferSize];
+    for (int i = 0; i < bufferSize; i++)
+        buf[i] = static_cast<char>(i);
+    uint32_t total = 0;
+
+    uint64_t start = Cycles::rdtsc();
+    for (int i = 0; i < count; i++) {
+        Crc32C crc;
+        total += crc.update(buf, bufferSize).getResult();
+    }
+    uint64_t stop = Cycles::rdtsc();
+    discard(&total);
+    return Cycles::toSeconds(stop - start)/count;
+}
+
 // Measure the minimum cost of Dispatch::poll, when there are no
 // Pollers and no Timers.
 double dispatchPoll()
@@ -736,6 +818,25 @@ double hashTableLookup()
     return Cycles::toSeconds((stop - start) / numLookups);
 }
 
+// Measure the cost of computing the hash of a key, as done for every
+// object operation on a master.
+template<uint16_t keyLength>
+double keyHash()
+{
+    int count = 1000000;
+    char keyData[keyLength];
+    for (int i = 0; i < keyLength; i++)
+        keyData[i] = static_cast<char>('a' + i % 26);
+    KeyHash total = 0;
+    uint64_t start = Cycles::rdtsc();
+    for (int i = 0; i < count; i++) {
+        total += Key::getHash(i, keyData, keyLength);
+    }
+    uint64_t stop = Cycles::rdtsc();
+    discard(&total);
+    return Cycles::toSeconds(stop - start)/count;
+}
+
 // Measure the cost of an lfence instruction.
 double lfence()
 {
@@ -1159,6 +1260,57 @@ double segmentIterator()
     return time;
 }
 
+// Measure the cost of appending objects of a given size to a segment
+// (including copying them into the segment's memory), as done for every
+// write on a master.
+template<uint32_t objectBytes>
+double segmentAppend()
+{
+    int count = 0;
+    uint64_t total = 0;
+    char data[objectBytes];
+    memset(data, 'x', objectBytes);
+    while (count < 1000000) {
+        Segment segment;
+        int i = 0;
+        while (true) {
+            Key key(0, &i, downCast<uint16_t>(sizeof(i)));
+            Buffer dataBuffer;
+            Object object(key, data, objectBytes, 0, 0, dataBuffer);
+            Buffer buffer;
+            object.assembleForLog(buffer);
+            uint64_t start = Cycles::rdtsc();
+            bool appended = segment.append(LOG_ENTRY_TYPE_OBJ, buffer);
+            total += Cycles::rdtsc() - start;
+            if (!appended)
+                break;
+            i++;
+        }
+        count += i;
+    }
+    return Cycles::toSeconds(total)/count;
+}
+
+// Measure the cost of constructing an object from a key and value and
+// serializing it into the form stored in the log.
+template<uint32_t objectBytes>
+double objectSerialize()
+{
+    int count = 1000000;
+    char data[objectBytes];
+    memset(data, 'x', objectBytes);
+    uint64_t start = Cycles::rdtsc();
+    for (int i = 0; i < count; i++) {
+        Key key(0, &i, downCast<uint16_t>(sizeof(i)));
+        Buffer dataBuffer;
+        Object object(key, data, objectBytes, 0, 0, dataBuffer);
+        Buffer buffer;
+        object.assembleForLog(buffer);
+    }
+    uint64_t stop = Cycles::rdtsc();
+    return Cycles::toSeconds(stop - start)/count;
+}
+
 // Measure the cost of cpuid
 double serialize() {
     int count = 1000000;
@@ -1472,10 +1624,16 @@ TestInfo tests[] = {
      "buffer create, copy small block, delete"},
     {"bufferCopy", bufferCopy,
      "copy out 2 small chunks from buffer"},
+    {"bufferCopy100", bufferCopy100,
+     "copy out 100 bytes spanning 2 chunks from buffer"},
+    {"bufferCopyLarge", bufferCopyLarge,
+     "copy out 8 MB from buffer"},
     {"bufferExtendChunk", bufferExtendChunk,
      "buffer add onto existing chunk"},
     {"bufferGetStart", bufferGetStart,
      "Buffer::getStart"},
+    {"bufferGetRange", bufferGetRange,
+     "Buffer::getRange within one chunk, not the cursor chunk"},
     {"bufferConstruct", bufferConstruct,
      "buffer stack allocation"},
     {"bufferReset", bufferReset,
@@ -1494,6 +1652,12 @@ TestInfo tests[] = {
      "Exchange method on a C++ atomic_int"},
     {"cppAtomicLoad", cppAtomicLoad,
      "Read a C++ atomic_int"},
+    {"crc32c", crc32c<100>,
+     "Crc32C over 100 bytes of cached data"},
+    {"crc32c", crc32c<4096>,
+     "Crc32C over 4096 bytes of cached data"},
+    {"crc32c", crc32c<65536>,
+     "Crc32C over 65536 bytes of cached data"},
     {"cyclesToSeconds", perfCyclesToSeconds,
      "Convert a rdtsc result to (double) seconds"},
     {"cyclesToNanos", perfCyclesToNanoseconds,
@@ -1516,6 +1680,10 @@ TestInfo tests[] = {
      "Key lookup in a 1GB HashTable"},
     {"hashTableLookupPf", hashTableLookup<20>,
      "Key lookup in a 1GB HashTable with prefetching"},
+    {"keyHash", keyHash<8>,
+     "Key::getHash, 8-byte key"},
+    {"keyHash30", keyHash<30>,
+     "Key::getHash, 30-byte key"},
     {"lfence", lfence,
      "Lfence instruction"},
     {"lockInDispThrd", lockInDispThrd,
@@ -1552,10 +1720,18 @@ TestInfo tests[] = {
      "Cost of new allocations from an ObjectPool (no destroys)"},
     {"objectPoolRealloc", objectPoolAlloc<int, true>,
      "Cost of ObjectPool allocation after destroying an object"},
+    {"objectSerialize", objectSerialize<100>,
+     "Construct and assembleForLog a 100-byte Object"},
+    {"objectSerialize1K", objectSerialize<1000>,
+     "Construct and assembleForLog a 1000-byte Object"},
     {"prefetch", prefetch,
      "Prefetch instruction"},
     {"rdtsc", rdtscTest,
      "Read the fine-grain cycle counter"},
+    {"segmentAppend", segmentAppend<100>,
+     "Append a 100-byte Object to a Segment"},
+    {"segmentAppend1K", segmentAppend<1000>,
+     "Append a 1000-byte Object to a Segment"},
     {"segmentEntrySort", segmentEntrySort,
      "Sort a Segment full of avg. 100-byte Objects by age"},
     {"segmentIterator", segmentIterator<50, 150>,
@@ -1594,6 +1770,32 @@ TestInfo tests[] = {
      "Push and pop a std::vector"},
 };
 
+/// Number of times each test is run (see --repeat); the median time is
+/// reported.
+static int repetitions = 1;
+
+/// True means results are printed as JSON (see --json) rather than as one
+/// line of text per test.
+static bool jsonOutput = false;
+
+/// Number of results printed so far in JSON form.
+static int jsonResults = 0;
+
+/**
+ * Print a string as a JSON string literal.
+ */
+static void
+printJsonString(const char* s)
+{
+    putchar('"');
+    for (; *s != '\0'; s++) {
+        if (*s == '"' || *s == '\\')
+            putchar('\\');
+        putchar(*s);
+    }
+    putchar('"');
+}
+
 /**
  * Runs a particular test and prints a one-line result message.
  *
@@ -1602,7 +1804,26 @@ TestInfo tests[] = {
  */
 void runTest(TestInfo& info)
 {
-    double secs = info.func();
+    // Individual runs can be disturbed by other activity on the machine,
+    // so the median of several runs is more repeatable than any one run.
+    std::vector<double> times;
+    for (int i = 0; i < repetitions; i++)
+        times.push_back(info.func());
+    std::sort(times.begin(), times.end());
+    double secs = times[times.size()/2];
+
+    if (jsonOutput) {
+        printf("%s\n    {\"name\": ", (jsonResults == 0) ? "" : ",");
+        printJsonString(info.name);
+        printf(", \"description\": ");
+        printJsonString(info.description);
+        printf(", \"repetitions\": %d, \"ns\": %.2f, \"minNs\": %.2f, "
+                "\"maxNs\": %.2f}", repetitions, 1e09*secs,
+                1e09*times.front(), 1e09*times.back());
+        fflush(stdout);
+        jsonResults++;
+        return;
+    }
     int width = printf("%-23s ", info.name);
     if (secs < 1.0e-06) {
         width += printf("%8.2fns", 1e09*secs);
@@ -1620,14 +1841,31 @@ int
 main(int argc, char *argv[])
 {
     bindThreadToCpu(3);
-    if (argc == 1) {
+    int firstTest = 1;
+    while (firstTest < argc && strncmp(argv[firstTest], "--", 2) == 0) {
+        if (strcmp(argv[firstTest], "--json") == 0) {
+            jsonOutput = true;
+            firstTest++;
+        } else if (strcmp(argv[firstTest], "--repeat") == 0 &&
+                firstTest + 1 < argc) {
+            repetitions = std::max(1, atoi(argv[firstTest + 1]));
+            firstTest += 2;
+        } else {
+            fprintf(stderr, "Usage: %s [--json] [--repeat count] "
+                    "[test ...]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (jsonOutput)
+        printf("{\"repetitions\": %d, \"results\": [", repetitions);
+    if (firstTest == argc) {
         // No test names specified; run all tests.
         foreach (TestInfo& info, tests) {
             runTest(info);
         }
     } else {
         // Run only the tests that were specified on the command line.
-        for (int i = 1; i < argc; i++) {
+        for (int i = firstTest; i < argc; i++) {
             bool foundTest = false;
             foreach (TestInfo& info, tests) {
                 if (strcmp(argv[i], info.name) == 0) {
@@ -1637,9 +1875,15 @@ main(int argc, char *argv[])
                 }
             }
             if (!foundTest) {
+                if (jsonOutput) {
+                    fprintf(stderr, "%s: No such test\n", argv[i]);
+                    continue;
+                }
                 int width = printf("%-18s ??", argv[i]);
                 printf("%*s No such test\n", 26-width, "");
             }
         }
     }
+    if (jsonOutput)
+        printf("\n]}\n");
 }
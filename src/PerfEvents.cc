@@ -0,0 +1,200 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "PerfEvents.h"
+#include "ShortMacros.h"
+
+namespace RAMCloud {
+
+/**
+ * The file descriptors of one thread's counters, and the pages through
+ * which the kernel tells user space how to read them with rdpmc.
+ */
+struct PerfEvents::ThreadCounters {
+    int fds[EVENTS];
+    perf_event_mmap_page* pages[EVENTS];
+};
+
+__thread PerfEvents::ThreadCounters* PerfEvents::threadCounters = NULL;
+__thread bool PerfEvents::openFailed = false;
+bool PerfEvents::enabled = false;
+
+/**
+ * Turn the counting of hardware events on or off for all threads. This is
+ * normally invoked once, before the server's threads start.
+ *
+ * \param enable
+ *      True means count events from now on.
+ */
+void
+PerfEvents::setEnabled(bool enable)
+{
+    enabled = enable;
+}
+
+/**
+ * Does the work of stop.
+ */
+void
+PerfEvents::accumulate(const PerfStats::HardwareCounts& start,
+        PerfStats::HardwareCounts* total)
+{
+    PerfStats::HardwareCounts now = {};
+    read(&now);
+    total->cycles += now.cycles - start.cycles;
+    total->instructions += now.instructions - start.instructions;
+    total->llcMisses += now.llcMisses - start.llcMisses;
+    total->branchMisses += now.branchMisses - start.branchMisses;
+    total->count++;
+}
+
+/**
+ * Open the calling thread's counters.
+ *
+ * \return
+ *      True means the counters are open; false means they couldn't be
+ *      opened, and a warning has been logged.
+ */
+bool
+PerfEvents::open()
+{
+    static const struct {
+        uint32_t type;
+        uint64_t config;
+        const char* name;
+    } events[EVENTS] = {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles"},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions"},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "LLC misses"},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, "branch misses"},
+    };
+    size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    ThreadCounters* counters = new ThreadCounters;
+    int opened = 0;
+    for (; opened < EVENTS; opened++) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = events[opened].type;
+        attr.config = events[opened].config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        // Count for the calling thread only, on whichever core it runs.
+        int fd = downCast<int>(syscall(__NR_perf_event_open, &attr, 0, -1,
+                -1, 0));
+        if (fd < 0) {
+            LOG(WARNING, "Couldn't open hardware counter for %s: %s",
+                    events[opened].name, strerror(errno));
+            break;
+        }
+        void* page = mmap(NULL, pageSize, PROT_READ, MAP_SHARED, fd, 0);
+        if (page == MAP_FAILED) {
+            LOG(WARNING, "Couldn't map hardware counter for %s: %s",
+                    events[opened].name, strerror(errno));
+            close(fd);
+            break;
+        }
+        counters->fds[opened] = fd;
+        counters->pages[opened] = static_cast<perf_event_mmap_page*>(page);
+    }
+    if (opened < EVENTS) {
+        for (int i = 0; i < opened; i++) {
+            munmap(counters->pages[i], pageSize);
+            close(counters->fds[i]);
+        }
+        delete counters;
+        return false;
+    }
+    if (!counters->pages[CYCLES]->cap_user_rdpmc) {
+        LOG(WARNING, "Kernel doesn't allow rdpmc; reading hardware counters "
+                "will take a system call");
+    }
+    threadCounters = counters;
+    return true;
+}
+
+/**
+ * Read all of the calling thread's counters, opening them if this thread
+ * hasn't yet.
+ *
+ * \param[out] counts
+ *      Filled in with the current values of the counters (but not the
+ *      count of intervals). Left unchanged if the counters can't be opened.
+ */
+void
+PerfEvents::read(PerfStats::HardwareCounts* counts)
+{
+    if (threadCounters == NULL) {
+        if (openFailed)
+            return;
+        if (!open()) {
+            openFailed = true;
+            return;
+        }
+    }
+    counts->cycles = readCounter(CYCLES);
+    counts->instructions = readCounter(INSTRUCTIONS);
+    counts->llcMisses = readCounter(LLC_MISSES);
+    counts->branchMisses = readCounter(BRANCH_MISSES);
+}
+
+/**
+ * Read one of the calling thread's counters, which must be open.
+ *
+ * \param event
+ *      Which counter to read.
+ * \return
+ *      The number of events counted since the counter was opened.
+ */
+uint64_t
+PerfEvents::readCounter(int event)
+{
+    volatile perf_event_mmap_page* page = threadCounters->pages[event];
+    while (true) {
+        // The kernel changes the page (for example, when the thread is
+        // moved to another core) with a sequence lock.
+        uint32_t seq = page->lock;
+        __asm__ __volatile__("" ::: "memory");
+        uint32_t index = page->index;
+        if (!page->cap_user_rdpmc || (index == 0))
+            break;
+        int64_t count = page->offset;
+        uint32_t low, high;
+        __asm__ __volatile__("rdpmc" : "=a" (low), "=d" (high)
+                : "c" (index - 1));
+        uint32_t shift = 64 - static_cast<uint32_t>(page->pmc_width);
+        int64_t pmc = static_cast<int64_t>(
+                ((uint64_t(high) << 32) | low) << shift) >> shift;
+        __asm__ __volatile__("" ::: "memory");
+        if (page->lock == seq)
+            return static_cast<uint64_t>(count + pmc);
+    }
+
+    // The counter can't be read from user space right now.
+    uint64_t value = 0;
+    if (::read(threadCounters->fds[event], &value, sizeof(value)) !=
+            static_cast<ssize_t>(sizeof(value))) {
+        return 0;
+    }
+    return value;
+}
+
+} // namespace RAMCloud
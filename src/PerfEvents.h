@@ -0,0 +1,106 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_PERFEVENTS_H
+#define RAMCLOUD_PERFEVENTS_H
+
+#include "PerfStats.h"
+
+namespace RAMCloud {
+
+/**
+ * This class reads the CPU's hardware performance counters (via the Linux
+ * perf_event interface), so that PerfStats can report how many instructions,
+ * cache misses, and branch mispredictions go into each kind of work (see
+ * PerfStats::HardwareCounts). Cycle counts alone can't tell whether a
+ * slow read path is limited by memory or by the code it executes.
+ *
+ * Each thread opens its own counters the first time it reads them, and
+ * reads them from user space with the rdpmc instruction, which takes a few
+ * tens of cycles; if the kernel doesn't allow this, a read system call is
+ * used instead, which is much slower. Counting is off unless setEnabled has
+ * been called; measuring an interval then costs one test of a variable. If
+ * the counters can't be opened (for example, because of
+ * /proc/sys/kernel/perf_event_paranoid, or in a virtual machine without a
+ * PMU), a warning is logged once per thread and its counts remain zero.
+ *
+ * This class provides only static methods and variables: it isn't
+ * possible to construct an instance.
+ */
+class PerfEvents {
+  public:
+    /**
+     * Invoked at the start of an interval whose events are to be counted.
+     *
+     * \param[out] start
+     *      Filled in with the calling thread's counters. Must be
+     *      zero-initialized by the caller; it is left alone if counting
+     *      is off.
+     */
+    static inline void
+    start(PerfStats::HardwareCounts* start)
+    {
+        if (enabled)
+            read(start);
+    }
+
+    /**
+     * Invoked at the end of an interval started with start; adds the events
+     * counted during the interval to a total.
+     *
+     * \param start
+     *      Filled in by start at the beginning of the interval.
+     * \param[out] total
+     *      The events counted since start are added to this, and its count
+     *      of intervals is incremented. Unchanged if counting was off when
+     *      the interval started or the counters couldn't be opened.
+     */
+    static inline void
+    stop(const PerfStats::HardwareCounts& start,
+            PerfStats::HardwareCounts* total)
+    {
+        if (start.cycles != 0)
+            accumulate(start, total);
+    }
+
+    static void setEnabled(bool enable);
+
+  PRIVATE:
+    PerfEvents();
+    static void accumulate(const PerfStats::HardwareCounts& start,
+            PerfStats::HardwareCounts* total);
+    static bool open();
+    static void read(PerfStats::HardwareCounts* counts);
+    static uint64_t readCounter(int event);
+
+    /// The events counted, in the order of the fields of
+    /// PerfStats::HardwareCounts (not including the count of intervals).
+    enum Event { CYCLES, INSTRUCTIONS, LLC_MISSES, BRANCH_MISSES, EVENTS };
+
+    /// The calling thread's counters, once open has succeeded.
+    struct ThreadCounters;
+    static __thread ThreadCounters* threadCounters;
+
+    /// True means open has failed for the calling thread, so it shouldn't
+    /// be tried again.
+    static __thread bool openFailed;
+
+    /// True means threads count hardware events; see setEnabled.
+    static bool enabled;
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_PERFEVENTS_H
@@ -0,0 +1,74 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "PerfEvents.h"
+
+namespace RAMCloud {
+
+class PerfEventsTest : public ::testing::Test {
+  public:
+    PerfEventsTest()
+    {
+        // Hardware counters may not be available where the tests run, so
+        // these tests never try to open them.
+        PerfEvents::openFailed = true;
+    }
+
+    ~PerfEventsTest()
+    {
+        PerfEvents::setEnabled(false);
+        PerfEvents::openFailed = false;
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(PerfEventsTest);
+};
+
+TEST_F(PerfEventsTest, start_disabled) {
+    PerfStats::HardwareCounts start = {};
+    PerfEvents::openFailed = false;
+    PerfEvents::start(&start);
+    EXPECT_EQ(0u, start.cycles);
+    EXPECT_TRUE(PerfEvents::threadCounters == NULL);
+}
+
+TEST_F(PerfEventsTest, start_openFailed) {
+    PerfEvents::setEnabled(true);
+    PerfStats::HardwareCounts start = {};
+    PerfEvents::start(&start);
+    EXPECT_EQ(0u, start.cycles);
+    EXPECT_EQ(0u, start.instructions);
+}
+
+TEST_F(PerfEventsTest, stop_notStarted) {
+    PerfEvents::setEnabled(true);
+    PerfStats::HardwareCounts start = {};
+    PerfStats::HardwareCounts total = {};
+    PerfEvents::stop(start, &total);
+    EXPECT_EQ(0u, total.count);
+}
+
+TEST_F(PerfEventsTest, accumulate) {
+    // With the counters unavailable, the final reading is all zeros.
+    PerfStats::HardwareCounts start = {};
+    PerfStats::HardwareCounts total = {};
+    total.cycles = 10;
+    total.count = 4;
+    PerfEvents::accumulate(start, &total);
+    EXPECT_EQ(10u, total.cycles);
+    EXPECT_EQ(5u, total.count);
+}
+
+}  // namespace RAMCloud
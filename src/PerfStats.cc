@@ -80,15 +80,48 @@ PerfStats::collectStats(PerfStats* total)
         total->readCount += stats->readCount;
         total->readObjectBytes += stats->readObjectBytes;
         total->readKeyBytes += stats->readKeyBytes;
+        total->readRetries += stats->readRetries;
+        total->readsCoalesced += stats->readsCoalesced;
+        total->flashReads += stats->flashReads;
+        total->flashFetches += stats->flashFetches;
+        total->flashFetchMicros += stats->flashFetchMicros;
         total->writeCount += stats->writeCount;
         total->writeObjectBytes += stats->writeObjectBytes;
         total->writeKeyBytes += stats->writeKeyBytes;
+        total->incrementsCombined += stats->incrementsCombined;
         total->dispatchActiveCycles += stats->dispatchActiveCycles;
+        total->dispatchSleepCycles += stats->dispatchSleepCycles;
+        for (int d = 0; d < MAX_DISPATCH_THREADS; d++) {
+            total->dispatchThreadActiveCycles[d] +=
+                    stats->dispatchThreadActiveCycles[d];
+        }
         total->logBytesAppended += stats->logBytesAppended;
         total->replicationRpcs += stats->replicationRpcs;
+        total->replicationRpcBytes += stats->replicationRpcBytes;
+        total->replicationSyncs += stats->replicationSyncs;
+        total->replicationCompressionInputBytes +=
+                stats->replicationCompressionInputBytes;
+        total->replicationCompressionOutputBytes +=
+                stats->replicationCompressionOutputBytes;
+        total->replicationCompressionCycles +=
+                stats->replicationCompressionCycles;
         total->logSyncCycles += stats->logSyncCycles;
+        total->logAppendLockCycles += stats->logAppendLockCycles;
+        total->logSyncBatches += stats->logSyncBatches;
+        total->logSyncBatchWriters += stats->logSyncBatchWriters;
+        for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+            total->logSyncBatchSizes[b] += stats->logSyncBatchSizes[b];
+            total->logSyncMicros[b] += stats->logSyncMicros[b];
+        }
         total->segmentUnopenedCycles += stats->segmentUnopenedCycles;
         total->workerActiveCycles += stats->workerActiveCycles;
+        for (int c = 0; c < RPC_CLASSES; c++) {
+            total->rpcClassRpcs[c] += stats->rpcClassRpcs[c];
+            total->rpcClassQueued[c] += stats->rpcClassQueued[c];
+            total->rpcClassQueueMicros[c] += stats->rpcClassQueueMicros[c];
+        }
+        total->lockTableWaitCycles += stats->lockTableWaitCycles;
+        total->lockTableCollisions += stats->lockTableCollisions;
         total->compactorInputBytes += stats->compactorInputBytes;
         total->compactorSurvivorBytes += stats->compactorSurvivorBytes;
         total->compactorActiveCycles += stats->compactorActiveCycles;
@@ -103,8 +136,13 @@ PerfStats::collectStats(PerfStats* total)
         total->backupWriteOps += stats->backupWriteOps;
         total->backupWriteBytes += stats->backupWriteBytes;
         total->backupWriteActiveCycles += stats->backupWriteActiveCycles;
+        total->backupFlushCycles += stats->backupFlushCycles;
         total->networkInputBytes += stats->networkInputBytes;
         total->networkOutputBytes += stats->networkOutputBytes;
+        total->dispatchHardware.add(stats->dispatchHardware);
+        total->workerHardware.add(stats->workerHardware);
+        total->readHardware.add(stats->readHardware);
+        total->cleanerHardware.add(stats->cleanerHardware);
         total->temp1 += stats->temp1;
         total->temp2 += stats->temp2;
         total->temp3 += stats->temp3;
@@ -113,6 +151,22 @@ PerfStats::collectStats(PerfStats* total)
     }
 }
 
+/**
+ * Return a human-readable description of the range of values counted by
+ * one histogram bucket, such as "4-7" (see HISTOGRAM_BUCKETS).
+ *
+ * \param bucket
+ *      Index of the bucket.
+ */
+string
+PerfStats::histogramRange(int bucket)
+{
+    if (bucket == HISTOGRAM_BUCKETS - 1)
+        return format("%d+", 1 << bucket);
+    return format("%d-%d", (bucket == 0) ? 0 : 1 << bucket,
+            (2 << bucket) - 1);
+}
+
 /**
  * Given two collections of cluster PerfStats, computes the changes from
  * the first collection to the second and formats it for printing.
@@ -148,6 +202,9 @@ PerfStats::printClusterStats(Buffer* first, Buffer* second)
                 diff["readObjectBytes"][i] + diff["readKeyBytes"][i]);
         diff["writeBytesObjectsAndKeys"].push_back(
                 diff["writeObjectBytes"][i] + diff["writeKeyBytes"][i]);
+        diff["logMetadataBytes"].push_back(std::max(0.0,
+                diff["logBytesAppended"][i] -
+                diff["writeBytesObjectsAndKeys"][i]));
     }
 
     result.append(format("%-30s %s\n", "Server index",
@@ -158,9 +215,51 @@ PerfStats::printClusterStats(Buffer* first, Buffer* second)
     result.append(format("%-30s %s\n", "Dispatcher load factor",
             formatMetricRatio(&diff, "dispatchActiveCycles", "collectionTime",
             " %8.3f").c_str()));
+    result.append(format("%-30s %s\n", "Dispatcher sleep fraction",
+            formatMetricRatio(&diff, "dispatchSleepCycles", "collectionTime",
+            " %8.3f").c_str()));
+    // Servers with several dispatch threads also show each one's load
+    // (on other servers only the main thread's entry is nonzero).
+    int dispatchThreads = 1;
+    for (int d = 1; d < MAX_DISPATCH_THREADS; d++) {
+        foreach (double cycles,
+                diff[format("dispatchThreadActiveCycles%d", d)]) {
+            if (cycles != 0)
+                dispatchThreads = d + 1;
+        }
+    }
+    for (int d = 0; (dispatchThreads > 1) && (d < dispatchThreads); d++) {
+        result.append(format("%-30s %s\n",
+                format("  dispatcher %d load factor", d).c_str(),
+                formatMetricRatio(&diff,
+                format("dispatchThreadActiveCycles%d", d).c_str(),
+                "collectionTime", " %8.3f").c_str()));
+    }
     result.append(format("%-30s %s\n", "Worker load factor",
             formatMetricRatio(&diff, "workerActiveCycles", "collectionTime",
             " %8.3f").c_str()));
+    for (int c = 0; c < RPC_CLASSES; c++) {
+        static const char* classNames[RPC_CLASSES] =
+                {"critical", "normal", "background"};
+        result.append(format("%-30s %s\n",
+                format("  %s RPCs (K)", classNames[c]).c_str(),
+                formatMetric(&diff, format("rpcClassRpcs%d", c).c_str(),
+                " %8.1f", 1e-3).c_str()));
+        result.append(format("%-30s %s\n",
+                format("  %s queued/RPC", classNames[c]).c_str(),
+                formatMetricRatio(&diff, format("rpcClassQueued%d", c).c_str(),
+                format("rpcClassRpcs%d", c).c_str(), " %8.3f").c_str()));
+        result.append(format("%-30s %s\n",
+                format("  %s queue wait (us)", classNames[c]).c_str(),
+                formatMetricRatio(&diff,
+                format("rpcClassQueueMicros%d", c).c_str(),
+                format("rpcClassQueued%d", c).c_str(), " %8.1f").c_str()));
+    }
+    result.append(format("%-30s %s\n", "Lock table wait factor",
+            formatMetricRatio(&diff, "lockTableWaitCycles", "collectionTime",
+            " %8.3f").c_str()));
+    result.append(format("%-30s %s\n", "Lock table collisions",
+            formatMetric(&diff, "lockTableCollisions", " %8.0f").c_str()));
 
     result.append("\nReads:\n");
     result.append(format("%-30s %s\n", "  Objects read (K)",
@@ -179,6 +278,30 @@ PerfStats::printClusterStats(Buffer* first, Buffer* second)
     result.append(format("%-30s %s\n", "  Total MB/s (objects & keys)",
             formatMetricRate(&diff, "readBytesObjectsAndKeys",
             " %8.2f", 1e-6).c_str()));
+    result.append(format("%-30s %s\n", "  Retries/read",
+            formatMetricRatio(&diff, "readRetries", "readCount",
+            " %8.3f").c_str()));
+    result.append(format("%-30s %s\n", "  Coalesced/read",
+            formatMetricRatio(&diff, "readsCoalesced", "readCount",
+            " %8.3f").c_str()));
+    result.append(format("%-30s %s\n", "  Flash reads/read",
+            formatMetricRatio(&diff, "flashReads", "readCount",
+            " %8.3f").c_str()));
+    result.append(format("%-30s %s\n", "  Flash fetches/read",
+            formatMetricRatio(&diff, "flashFetches", "readCount",
+            " %8.3f").c_str()));
+    result.append(format("%-30s %s\n", "  Flash fetch latency (us)",
+            formatMetricRatio(&diff, "flashFetchMicros", "flashFetches",
+            " %8.1f").c_str()));
+    result.append(format("%-30s %s\n", "  LLC misses/read",
+            formatMetricRatio(&diff, "readHardware.llcMisses",
+            "readHardware.count", " %8.2f").c_str()));
+    result.append(format("%-30s %s\n", "  Branch misses/read",
+            formatMetricRatio(&diff, "readHardware.branchMisses",
+            "readHardware.count", " %8.2f").c_str()));
+    result.append(format("%-30s %s\n", "  Instructions/read",
+            formatMetricRatio(&diff, "readHardware.instructions",
+            "readHardware.count", " %8.0f").c_str()));
 
     result.append("\nWrites:\n");
     result.append(format("%-30s %s\n", "  Objects written (K)",
@@ -197,15 +320,53 @@ PerfStats::printClusterStats(Buffer* first, Buffer* second)
     result.append(format("%-30s %s\n", "  Total MB/s (objects & keys)",
             formatMetricRate(&diff, "writeBytesObjectsAndKeys",
             " %8.2f", 1e-6).c_str()));
+    result.append(format("%-30s %s\n", "  Combined increments/write",
+            formatMetricRatio(&diff, "incrementsCombined", "writeCount",
+            " %8.3f").c_str()));
     result.append(format("%-30s %s\n", "  Log bytes appended (MB/s)",
             formatMetricRate(&diff, "logBytesAppended",
             " %8.2f", 1e-6).c_str()));
+    result.append(format("%-30s %s\n", "  Log metadata/write (bytes)",
+            formatMetricRatio(&diff, "logMetadataBytes", "writeCount",
+            " %8.1f").c_str()));
     result.append(format("%-30s %s\n", "  Replication RPCs/write",
             formatMetricRatio(&diff, "replicationRpcs", "writeCount",
             " %8.2f").c_str()));
+    result.append(format("%-30s %s\n", "  Replication bytes/RPC",
+            formatMetricRatio(&diff, "replicationRpcBytes",
+            "replicationRpcs", " %8.1f").c_str()));
+    result.append(format("%-30s %s\n", "  Replication RPCs/sync",
+            formatMetricRatio(&diff, "replicationRpcs",
+            "replicationSyncs", " %8.2f").c_str()));
+    result.append(format("%-30s %s\n", "  Compression ratio",
+            formatMetricRatio(&diff, "replicationCompressionInputBytes",
+            "replicationCompressionOutputBytes", " %8.2f").c_str()));
+    result.append(format("%-30s %s\n", "  Compression load factor",
+            formatMetricRatio(&diff, "replicationCompressionCycles",
+            "collectionTime", " %8.3f").c_str()));
     result.append(format("%-30s %s\n", "  Log sync load factor",
             formatMetricRatio(&diff, "logSyncCycles",
             "collectionTime", " %8.2f").c_str()));
+    result.append(format("%-30s %s\n", "  Append lock wait factor",
+            formatMetricRatio(&diff, "logAppendLockCycles",
+            "collectionTime", " %8.3f").c_str()));
+    result.append(format("%-30s %s\n", "  Writers per log sync",
+            formatMetricRatio(&diff, "logSyncBatchWriters",
+            "logSyncBatches", " %8.2f").c_str()));
+    for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+        string metric = format("logSyncBatchSizes%d", b);
+        result.append(format("%-30s %s\n",
+                format("  Sync batches, %s writers",
+                histogramRange(b).c_str()).c_str(),
+                formatMetric(&diff, metric.c_str(), " %8.0f").c_str()));
+    }
+    for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+        string metric = format("logSyncMicros%d", b);
+        result.append(format("%-30s %s\n",
+                format("  Syncs taking %s us",
+                histogramRange(b).c_str()).c_str(),
+                formatMetric(&diff, metric.c_str(), " %8.0f").c_str()));
+    }
     result.append(format("%-30s %s\n", "  Segment unopened time (%)",
             formatMetricRatio(&diff, "segmentUnopenedCycles",
             "collectionTime", " %8.2f", 100).c_str()));
@@ -258,6 +419,9 @@ PerfStats::printClusterStats(Buffer* first, Buffer* second)
     result.append(format("%-30s %s\n", "  Storage write load factor",
             formatMetricRatio(&diff, "backupWriteActiveCycles",
             "collectionTime", " %8.3f").c_str()));
+    result.append(format("%-30s %s\n", "  Cache flush load factor",
+            formatMetricRatio(&diff, "backupFlushCycles",
+            "collectionTime", " %8.3f").c_str()));
     result.append(format("%-30s %s\n", "  Storage reads (MB/s)",
             formatMetricRate(&diff, "backupReadBytes",
             " %8.2f", 1e-6).c_str()));
@@ -271,6 +435,38 @@ PerfStats::printClusterStats(Buffer* first, Buffer* second)
             formatMetricRatio(&diff, "backupReadActiveCycles",
             "collectionTime", " %8.3f").c_str()));
 
+    result.append("\nHardware counters:\n");
+    struct {
+        const char* name;
+        const char* metric;
+        const char* unit;
+    } kinds[] = {
+        {"Dispatch", "dispatchHardware", "poll"},
+        {"Worker", "workerHardware", "RPC"},
+        {"Read", "readHardware", "read"},
+        {"Cleaner", "cleanerHardware", "pass"},
+    };
+    for (auto& kind : kinds) {
+        string metric(kind.metric);
+        result.append(format("%-30s %s\n",
+                format("  %s IPC", kind.name).c_str(),
+                formatMetricRatio(&diff, (metric + ".instructions").c_str(),
+                (metric + ".cycles").c_str(), " %8.2f").c_str()));
+        result.append(format("%-30s %s\n",
+                format("  %s LLC misses (K/sec)", kind.name).c_str(),
+                formatMetricRate(&diff, (metric + ".llcMisses").c_str(),
+                " %8.1f", 1e-3).c_str()));
+        result.append(format("%-30s %s\n",
+                format("  %s LLC misses/%s", kind.name, kind.unit).c_str(),
+                formatMetricRatio(&diff, (metric + ".llcMisses").c_str(),
+                (metric + ".count").c_str(), " %8.2f").c_str()));
+        result.append(format("%-30s %s\n",
+                format("  %s branch misses/%s", kind.name,
+                kind.unit).c_str(),
+                formatMetricRatio(&diff, (metric + ".branchMisses").c_str(),
+                (metric + ".count").c_str(), " %8.2f").c_str()));
+    }
+
     result.append("\nNetwork:\n");
     result.append(format("%-30s %s\n", "  Input bytes (MB/s)",
             formatMetricRate(&diff, "networkInputBytes",
@@ -322,6 +518,12 @@ PerfStats::clusterDiff(Buffer* before, Buffer* after,
 
 #define ADD_METRIC(metric) \
         (*diff)[#metric].push_back(static_cast<double>(p2.metric - p1.metric))
+#define ADD_HARDWARE(metric) \
+        ADD_METRIC(metric.cycles); \
+        ADD_METRIC(metric.instructions); \
+        ADD_METRIC(metric.llcMisses); \
+        ADD_METRIC(metric.branchMisses); \
+        ADD_METRIC(metric.count)
 
         // Collect data for each of the metrics. The order below should
         // match the declaration order in PerfStats.h.
@@ -331,14 +533,57 @@ PerfStats::clusterDiff(Buffer* before, Buffer* after,
         ADD_METRIC(readCount);
         ADD_METRIC(readObjectBytes);
         ADD_METRIC(readKeyBytes);
+        ADD_METRIC(readRetries);
+        ADD_METRIC(readsCoalesced);
+        ADD_METRIC(flashReads);
+        ADD_METRIC(flashFetches);
+        ADD_METRIC(flashFetchMicros);
         ADD_METRIC(writeCount);
         ADD_METRIC(writeObjectBytes);
         ADD_METRIC(writeKeyBytes);
+        ADD_METRIC(incrementsCombined);
         ADD_METRIC(dispatchActiveCycles);
+        ADD_METRIC(dispatchSleepCycles);
+        for (int d = 0; d < MAX_DISPATCH_THREADS; d++) {
+            (*diff)[format("dispatchThreadActiveCycles%d", d)].push_back(
+                    static_cast<double>(p2.dispatchThreadActiveCycles[d] -
+                    p1.dispatchThreadActiveCycles[d]));
+        }
         ADD_METRIC(workerActiveCycles);
+        for (int c = 0; c < RPC_CLASSES; c++) {
+            (*diff)[format("rpcClassRpcs%d", c)].push_back(
+                    static_cast<double>(p2.rpcClassRpcs[c] -
+                    p1.rpcClassRpcs[c]));
+            (*diff)[format("rpcClassQueued%d", c)].push_back(
+                    static_cast<double>(p2.rpcClassQueued[c] -
+                    p1.rpcClassQueued[c]));
+            (*diff)[format("rpcClassQueueMicros%d", c)].push_back(
+                    static_cast<double>(p2.rpcClassQueueMicros[c] -
+                    p1.rpcClassQueueMicros[c]));
+        }
+        ADD_METRIC(lockTableWaitCycles);
+        ADD_METRIC(lockTableCollisions);
         ADD_METRIC(logBytesAppended);
         ADD_METRIC(replicationRpcs);
+        ADD_METRIC(replicationRpcBytes);
+        ADD_METRIC(replicationSyncs);
+        ADD_METRIC(replicationCompressionInputBytes);
+        ADD_METRIC(replicationCompressionOutputBytes);
+        ADD_METRIC(replicationCompressionCycles);
         ADD_METRIC(logSyncCycles);
+        ADD_METRIC(logAppendLockCycles);
+        ADD_METRIC(logSyncBatches);
+        ADD_METRIC(logSyncBatchWriters);
+        for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+            (*diff)[format("logSyncBatchSizes%d", b)].push_back(
+                    static_cast<double>(p2.logSyncBatchSizes[b] -
+                    p1.logSyncBatchSizes[b]));
+        }
+        for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+            (*diff)[format("logSyncMicros%d", b)].push_back(
+                    static_cast<double>(p2.logSyncMicros[b] -
+                    p1.logSyncMicros[b]));
+        }
         ADD_METRIC(segmentUnopenedCycles);
         ADD_METRIC(compactorInputBytes);
         ADD_METRIC(compactorSurvivorBytes);
@@ -354,8 +599,13 @@ PerfStats::clusterDiff(Buffer* before, Buffer* after,
         ADD_METRIC(backupWriteOps);
         ADD_METRIC(backupWriteBytes);
         ADD_METRIC(backupWriteActiveCycles);
+        ADD_METRIC(backupFlushCycles);
         ADD_METRIC(networkInputBytes);
         ADD_METRIC(networkOutputBytes);
+        ADD_HARDWARE(dispatchHardware);
+        ADD_HARDWARE(workerHardware);
+        ADD_HARDWARE(readHardware);
+        ADD_HARDWARE(cleanerHardware);
         ADD_METRIC(temp1);
         ADD_METRIC(temp2);
         ADD_METRIC(temp3);
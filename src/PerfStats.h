@@ -18,6 +18,7 @@
 
 #include <unordered_map>
 #include <vector>
+#include "BitOps.h"
 #include "Buffer.h"
 #include "SpinLock.h"
 
@@ -68,6 +69,30 @@ struct PerfStats {
     /// metadata).
     uint64_t readKeyBytes;
 
+    /// Total number of times an object read had to be retried because its
+    /// hash table bucket was locked while it was being read without the
+    /// lock (see ObjectManager::readObject).
+    uint64_t readRetries;
+
+    /// Total number of READ requests that were answered with a copy of the
+    /// reply to an identical READ that was waiting for a worker at the same
+    /// time (see WorkerManager::coalesceRead). These are also counted in
+    /// readCount.
+    uint64_t readsCoalesced;
+
+    /// Total number of objects read from the flash tier (see
+    /// SegletAllocator::fetchFromFlash). These are also counted in readCount.
+    uint64_t flashReads;
+
+    /// Total number of times a read found its object on the flash tier but
+    /// not in memory, so that the object had to be fetched from flash and
+    /// the read retried.
+    uint64_t flashFetches;
+
+    /// Total time, in microseconds, from the start of each fetch from the
+    /// flash tier until a retry found the object in memory.
+    uint64_t flashFetchMicros;
+
     /// Total number of RAMCloud objects written (each object in a multi-write
     /// operation counts as one).
     uint64_t writeCount;
@@ -80,15 +105,54 @@ struct PerfStats {
     /// metadata).
     uint64_t writeKeyBytes;
 
+    /// Total number of INCREMENTs (or parts of MULTI_INCREMENTs) that were
+    /// applied in the same log append as an earlier increment of the same
+    /// object (see MasterService::combineIncrement), rather than writing a
+    /// new version of their own.
+    uint64_t incrementsCombined;
+
     /// Total time (in Cycles::rdtsc ticks) spent in calls to Dispatch::poll
     /// that did useful work (if a call to Dispatch::poll found no useful
     /// work, then it's execution time is excluded).
     uint64_t dispatchActiveCycles;
 
+    /// Total time (in Cycles::rdtsc ticks) the dispatch thread spent
+    /// sleeping because it was idle (see Dispatch::setIdleSleepMicros);
+    /// the rest of its time was spent busy-polling.
+    uint64_t dispatchSleepCycles;
+
+    /// Number of a server's dispatch threads whose load is also counted
+    /// separately (see DispatchThread).
+    static const int MAX_DISPATCH_THREADS = 8;
+
+    /// The part of #dispatchActiveCycles spent in each of a server's
+    /// dispatch threads, indexed by Dispatch::setStatsIndex; entry 0 is the
+    /// main dispatch thread.
+    uint64_t dispatchThreadActiveCycles[MAX_DISPATCH_THREADS];
+
     /// Total time (in Cycles::rdtsc ticks) spent by executing RPC requests
     /// as a worker.
     uint64_t workerActiveCycles;
 
+    /// Number of priority classes of RPCs (see WorkerManager::RpcClass).
+    static const int RPC_CLASSES = 3;
+
+    /// Number of RPCs of each priority class that general worker threads
+    /// started, the number of those that had to wait for a worker first,
+    /// and the total time (in microseconds) that they waited.
+    uint64_t rpcClassRpcs[RPC_CLASSES];
+    uint64_t rpcClassQueued[RPC_CLASSES];
+    uint64_t rpcClassQueueMicros[RPC_CLASSES];
+
+    /// Total time (in cycles) spent by threads waiting for a bucket lock
+    /// in a master's transaction LockTable.
+    uint64_t lockTableWaitCycles;
+
+    /// Number of times a LockTable entry's KeyHash tag matched a key being
+    /// looked up but the lock was for a different key, so reading its lock
+    /// object from the log was wasted.
+    uint64_t lockTableCollisions;
+
     //--------------------------------------------------------------------
     // Statistics for log replication follow below. These metrics are
     // related to new information appended to the head segment (i.e., not
@@ -101,11 +165,56 @@ struct PerfStats {
     /// segment.
     uint64_t replicationRpcs;
 
+    /// Total bytes of log data carried by the replication RPCs counted in
+    /// replicationRpcs.
+    uint64_t replicationRpcBytes;
+
+    /// Number of times a segment sync had to wait for replication RPCs to
+    /// backups (syncs that found their data already committed aren't
+    /// counted).
+    uint64_t replicationSyncs;
+
+    /// Total bytes of data that replication RPCs offered to the compressor
+    /// (see ServerConfig::Master::compressReplication), and the number of
+    /// bytes actually sent for them (compressed or not, whichever was
+    /// smaller). Unlike replicationRpcBytes these include every replica.
+    uint64_t replicationCompressionInputBytes;
+    uint64_t replicationCompressionOutputBytes;
+
+    /// Total time (in cycles) spent compressing replication data.
+    uint64_t replicationCompressionCycles;
+
     /// Total time (in cycles) spent by worker threads waiting for log
     /// syncs (i.e. if 2 threads are waiting at once, this counter advances
     /// at twice real time).
     uint64_t logSyncCycles;
 
+    /// Total time (in cycles) spent by threads waiting to acquire the lock
+    /// that serializes appends to the log head. Compare with
+    /// workerActiveCycles to see how much appends are limiting write
+    /// throughput.
+    uint64_t logAppendLockCycles;
+
+    /// Total number of times Log::sync replicated data to backups on behalf
+    /// of a group of waiting writers.
+    uint64_t logSyncBatches;
+
+    /// Total number of writers released by those syncs (logSyncBatchWriters
+    /// divided by logSyncBatches gives the average batch size).
+    uint64_t logSyncBatchWriters;
+
+    /// Number of buckets in each of the histograms below. Bucket i counts
+    /// values in the range [2^i, 2^(i+1)); bucket 0 also counts zeros and
+    /// the last bucket also counts everything larger.
+    static const int HISTOGRAM_BUCKETS = 8;
+
+    /// Histogram of the number of writers in each log sync batch.
+    uint64_t logSyncBatchSizes[HISTOGRAM_BUCKETS];
+
+    /// Histogram of the time (in microseconds) each writer spent in
+    /// Log::sync, including any wait for the batching window.
+    uint64_t logSyncMicros[HISTOGRAM_BUCKETS];
+
     /// Total time (in cycles) spend my segments in a state where they have
     /// at least one replica that has not yet been successfully opened. If
     /// this value is significant, it probably means that backups don't have
@@ -173,6 +282,11 @@ struct PerfStats {
     /// storage device(s) were actively performing backup writes.
     uint64_t backupWriteActiveCycles;
 
+    /// Total time (in Cycles::rdtsc ticks) spent flushing appended data
+    /// from CPU caches to persistent memory (see PmemStorage). This is
+    /// included in backupWriteActiveCycles.
+    uint64_t backupFlushCycles;
+
     //--------------------------------------------------------------------
     // Statistics for the network follow below.
     //--------------------------------------------------------------------
@@ -183,6 +297,57 @@ struct PerfStats {
     /// Total bytes transmitted on the network by all transports.
     uint64_t networkOutputBytes;
 
+    //--------------------------------------------------------------------
+    // Statistics from the CPU's hardware performance counters follow
+    // below. They are only gathered if the server was started with
+    // --hardwareCounters (see PerfEvents); otherwise they are all zero.
+    //--------------------------------------------------------------------
+
+    /// Events counted during one kind of work.
+    struct HardwareCounts {
+        /// Core clock cycles (unlike Cycles::rdtsc ticks, these vary with
+        /// the clock frequency and stop while the thread isn't running).
+        uint64_t cycles;
+
+        /// Instructions retired.
+        uint64_t instructions;
+
+        /// References that missed in the last-level cache.
+        uint64_t llcMisses;
+
+        /// Mispredicted branches.
+        uint64_t branchMisses;
+
+        /// Number of intervals (polls, RPCs, or cleaner passes) measured.
+        uint64_t count;
+
+        /// Add another set of counts to this one.
+        void
+        add(const HardwareCounts& other)
+        {
+            cycles += other.cycles;
+            instructions += other.instructions;
+            llcMisses += other.llcMisses;
+            branchMisses += other.branchMisses;
+            count += other.count;
+        }
+    };
+
+    /// Events during calls to Dispatch::poll that did useful work (the
+    /// same intervals as dispatchActiveCycles).
+    HardwareCounts dispatchHardware;
+
+    /// Events during RPCs executed by worker threads.
+    HardwareCounts workerHardware;
+
+    /// Events during READ requests, whether they were executed by a worker
+    /// or in the dispatch thread; these are also included in
+    /// dispatchHardware or workerHardware.
+    HardwareCounts readHardware;
+
+    /// Events during passes of the compactor and the combined cleaner.
+    HardwareCounts cleanerHardware;
+
     //--------------------------------------------------------------------
     // Temporary counters. The values below have no pre-defined use;
     // they are intended for temporary use during debugging or performance
@@ -226,11 +391,25 @@ struct PerfStats {
     static string printClusterStats(Buffer* first, Buffer* second);
     static void registerStats(PerfStats* stats);
 
+    /**
+     * Return the index of the histogram bucket (see HISTOGRAM_BUCKETS) that
+     * a given value belongs in.
+     */
+    static int
+    histogramBucket(uint64_t value)
+    {
+        int bucket = BitOps::findLastSet(value) - 1;
+        if (bucket < 0)
+            return 0;
+        return std::min(bucket, HISTOGRAM_BUCKETS - 1);
+    }
+
     /// The following thread-local variable is used to access the statistics
     /// for the current thread.
     static __thread PerfStats threadStats;
 
   PRIVATE:
+    static string histogramRange(int bucket);
     static void parseStats(Buffer* rawData, std::vector<PerfStats>* results);
 
     /// Used in a monitor-style fashion for mutual exclusion.
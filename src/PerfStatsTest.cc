@@ -47,6 +47,7 @@ class PerfStatsTest : public ::testing::Test {
         stats->readObjectBytes = 3*value;
         stats->writeObjectBytes = 4*value;
         stats->temp5 = 5*value;
+        stats->workerHardware.llcMisses = value;
     }
 
     // Fills a PerfStats::Diff with sample data.
@@ -161,6 +162,23 @@ TEST_F(PerfStatsTest, collectStats) {
     EXPECT_EQ(220u, total.writeCount);
 }
 
+TEST_F(PerfStatsTest, collectStats_hardwareCounts) {
+    PerfStats::registerStats(&stats);
+    stats.readHardware.llcMisses = 10;
+    stats.readHardware.count = 1;
+    PerfStats stats2;
+    PerfStats::registerStats(&stats2);
+    stats2.readHardware.llcMisses = 100;
+    stats2.readHardware.count = 2;
+    stats2.cleanerHardware.cycles = 5;
+    PerfStats total;
+    PerfStats::collectStats(&total);
+    EXPECT_EQ(110u, total.readHardware.llcMisses);
+    EXPECT_EQ(3u, total.readHardware.count);
+    EXPECT_EQ(5u, total.cleanerHardware.cycles);
+    EXPECT_EQ(0u, total.workerHardware.cycles);
+}
+
 TEST_F(PerfStatsTest, clusterDiff_findMatchingData) {
     // Test code that skips entries where either before or after
     // data is missing.
@@ -193,6 +211,8 @@ TEST_F(PerfStatsTest, clusterDiff_collectMetrics) {
     EXPECT_EQ(5000.0, diff["temp5"][0]);
     EXPECT_EQ(15000.0, diff["temp5"][1]);
     EXPECT_EQ(10000.0, diff["temp5"][2]);
+    EXPECT_EQ(1000.0, diff["workerHardware.llcMisses"][0]);
+    EXPECT_EQ(3000.0, diff["workerHardware.llcMisses"][1]);
 }
 
 TEST_F(PerfStatsTest, parseStats_basics) {
@@ -279,4 +299,22 @@ TEST_F(PerfStatsTest, clusterDiff_formatMetricRatio) {
             "cyclesPerSecond", " %.3f", 2.0));
 }
 
+TEST_F(PerfStatsTest, histogramBucket) {
+    EXPECT_EQ(0, PerfStats::histogramBucket(0));
+    EXPECT_EQ(0, PerfStats::histogramBucket(1));
+    EXPECT_EQ(1, PerfStats::histogramBucket(2));
+    EXPECT_EQ(1, PerfStats::histogramBucket(3));
+    EXPECT_EQ(2, PerfStats::histogramBucket(4));
+    EXPECT_EQ(6, PerfStats::histogramBucket(127));
+    EXPECT_EQ(7, PerfStats::histogramBucket(128));
+    EXPECT_EQ(7, PerfStats::histogramBucket(~0UL));
+}
+
+TEST_F(PerfStatsTest, histogramRange) {
+    EXPECT_EQ("0-1", PerfStats::histogramRange(0));
+    EXPECT_EQ("2-3", PerfStats::histogramRange(1));
+    EXPECT_EQ("64-127", PerfStats::histogramRange(6));
+    EXPECT_EQ("128+", PerfStats::histogramRange(7));
+}
+
 }  // namespace RAMCloud
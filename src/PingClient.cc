@@ -199,6 +199,39 @@ ProxyPingRpc::wait()
     return respHdr->replyNanoseconds;
 }
 
+/**
+ * Wait for a proxyPing RPC to complete, but give up if the proxy itself
+ * doesn't respond in time.
+ *
+ * \param timeoutNanoseconds
+ *      Return after this much time, even if the proxy hasn't responded.
+ *
+ * \return
+ *      The amount of time it took the target server to respond to the ping
+ *      request.  All ones is returned if the proxy didn't receive a response
+ *      within its timeout period, if the proxy didn't respond within
+ *      \a timeoutNanoseconds, or if the proxy has crashed.
+ */
+uint64_t
+ProxyPingRpc::wait(uint64_t timeoutNanoseconds)
+{
+    uint64_t abortTime = Cycles::rdtsc() +
+            Cycles::fromNanoseconds(timeoutNanoseconds);
+    if (!waitInternal(context->dispatch, abortTime)) {
+        TEST_LOG("timeout");
+        return ~0UL;
+    }
+    if (serverCrashed) {
+        TEST_LOG("server doesn't exist");
+        return ~0UL;
+    }
+    if (responseHeader->status != STATUS_OK)
+        ClientException::throwException(HERE, responseHeader->status);
+    const WireFormat::ProxyPing::Response* respHdr(
+            getResponseHeader<WireFormat::ProxyPing>());
+    return respHdr->replyNanoseconds;
+}
+
 
 /**
  * This RPC is used to invoke a variety of miscellaneous operations on a server,
@@ -93,6 +93,7 @@ class ProxyPingRpc : public ServerIdRpcWrapper {
             uint64_t timeoutNanoseconds);
     ~ProxyPingRpc() {}
     uint64_t wait();
+    uint64_t wait(uint64_t timeoutNanoseconds);
 
     PRIVATE:
     DISALLOW_COPY_AND_ASSIGN(ProxyPingRpc);
@@ -18,7 +18,9 @@
 #include "BackupService.h"
 #include "CycleCounter.h"
 #include "Cycles.h"
+#include "Fence.h"
 #include "MasterService.h"
+#include "MemoryAccounting.h"
 #include "RawMetrics.h"
 #include "ShortMacros.h"
 #include "PerfStats.h"
@@ -26,7 +28,9 @@
 #include "PingService.h"
 #include "ServerList.h"
 #include "TimeTrace.h"
+#include "TransportManager.h"
 #include "CacheTrace.h"
+#include "WorkerManager.h"
 
 namespace RAMCloud {
 
@@ -52,6 +56,100 @@ PingService::~PingService()
     context->services[WireFormat::PING_SERVICE] = NULL;
 }
 
+/**
+ * Records the outcome of a request sent by PingService::forward.
+ */
+class ForwardNotifier : public Transport::RpcNotifier {
+  public:
+    ForwardNotifier()
+        : state(WAITING)
+    {}
+
+    void
+    completed()
+    {
+        Fence::sfence();
+        state = RECEIVED;
+    }
+
+    void
+    failed()
+    {
+        Fence::sfence();
+        state = FAILED;
+    }
+
+    enum State { WAITING, RECEIVED, FAILED };
+    volatile State state;
+
+    DISALLOW_COPY_AND_ASSIGN(ForwardNotifier);
+};
+
+/**
+ * Top-level service method to handle the FORWARD request: the request
+ * embedded in it is sent to the server it names, and that server's
+ * response is returned. Client processes use this to share one set of
+ * sessions to each server (see ProxySession), so a server that acts as a
+ * proxy should normally run no services other than this one (FORWARD can
+ * carry any RPC, so it has no well-defined RPC level).
+ *
+ * \copydetails Service::ping
+ */
+void
+PingService::forward(const WireFormat::Forward::Request* reqHdr,
+        WireFormat::Forward::Response* respHdr,
+        Rpc* rpc)
+{
+    uint32_t offset = sizeof32(*reqHdr);
+    const char* locator = static_cast<const char*>(
+            rpc->requestPayload->getRange(offset, reqHdr->locatorLength));
+    if ((locator == NULL) || (reqHdr->locatorLength == 0)) {
+        respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
+        return;
+    }
+    string target(locator, reqHdr->locatorLength);
+    offset += reqHdr->locatorLength;
+    if (rpc->requestPayload->size() - offset <
+            sizeof(WireFormat::RequestCommon)) {
+        respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
+        return;
+    }
+
+    Buffer request;
+    request.appendExternal(rpc->requestPayload, offset,
+            rpc->requestPayload->size() - offset);
+    Buffer response;
+    ForwardNotifier notifier;
+    Transport::SessionRef session =
+            context->transportManager->getSession(target);
+    session->sendRequest(&request, &response, &notifier);
+    {
+        bool isDispatchThread = context->dispatch->isDispatchThread();
+        Tub<WorkerManager::BlockingWait> blocking;
+        if (!isDispatchThread)
+            blocking.construct();
+        while (notifier.state == ForwardNotifier::WAITING) {
+            if (isDispatchThread)
+                context->dispatch->poll();
+        }
+        Fence::lfence();
+    }
+    if (notifier.state == ForwardNotifier::FAILED) {
+        // The transport has already logged the problem. Open a new session
+        // for the next request, and let the client decide what to do
+        // (typically it will look up the target again and retry).
+        context->transportManager->flushSession(target);
+        respHdr->common.status = STATUS_COULDNT_CONNECT;
+        return;
+    }
+
+    // The response may refer to memory owned by the transport, which
+    // could be reclaimed once it is destroyed, so copy it.
+    for (Buffer::Iterator it(&response); !it.isDone(); it.next()) {
+        rpc->replyPayload->appendCopy(it.getData(), it.getLength());
+    }
+}
+
 /**
  * Top-level service method to handle the GET_METRICS request.
  *
@@ -324,6 +422,188 @@ PingService::serverControl(const WireFormat::ServerControl::Request* reqHdr,
             context->timeTrace->reset();
             break;
         }
+        case WireFormat::GET_MEMORY_USAGE:
+        {
+            MasterService* master = context->getMasterService();
+            if (master == NULL) {
+                respHdr->common.status = STATUS_UNIMPLEMENTED_REQUEST;
+                return;
+            }
+            MemoryAccounting accounting;
+            master->objectManager.getMemoryUsage(&accounting);
+            ProtoBuf::MemoryUsage usage;
+            accounting.serialize(&usage);
+            respHdr->outputLength = ProtoBuf::serializeToResponse(
+                    rpc->replyPayload, &usage);
+            break;
+        }
+        case WireFormat::SET_TABLE_TTL:
+        {
+            MasterService* master = context->getMasterService();
+            if (master == NULL) {
+                // Only masters hold objects; other servers ignore TTLs.
+                break;
+            }
+            if (reqHdr->inputLength < sizeof(WireFormat::TableTtl)) {
+                respHdr->common.status = STATUS_MESSAGE_TOO_SHORT;
+                return;
+            }
+            const WireFormat::TableTtl* ttl =
+                    static_cast<const WireFormat::TableTtl*>(inputData);
+            master->objectManager.setTableTtl(ttl->tableId, ttl->ttlSeconds);
+            break;
+        }
+        case WireFormat::SET_TABLE_CACHE_QUOTA:
+        {
+            MasterService* master = context->getMasterService();
+            if (master == NULL) {
+                // Only masters hold objects; other servers ignore quotas.
+                break;
+            }
+            if (reqHdr->inputLength < sizeof(WireFormat::TableCacheQuota)) {
+                respHdr->common.status = STATUS_MESSAGE_TOO_SHORT;
+                return;
+            }
+            const WireFormat::TableCacheQuota* quota =
+                    static_cast<const WireFormat::TableCacheQuota*>(
+                    inputData);
+            master->objectManager.setTableCacheQuota(quota->tableId,
+                    quota->quotaBytes);
+            break;
+        }
+        case WireFormat::SET_TABLE_DURABILITY:
+        {
+            MasterService* master = context->getMasterService();
+            if (master == NULL) {
+                // Only masters accept writes; other servers ignore this.
+                break;
+            }
+            if (reqHdr->inputLength < sizeof(WireFormat::TableDurability)) {
+                respHdr->common.status = STATUS_MESSAGE_TOO_SHORT;
+                return;
+            }
+            const WireFormat::TableDurability* durability =
+                    static_cast<const WireFormat::TableDurability*>(
+                    inputData);
+            master->objectManager.setTableDurability(durability->tableId,
+                    durability->ackReplicas);
+            break;
+        }
+        case WireFormat::SET_TABLE_RATE_LIMIT:
+        {
+            MasterService* master = context->getMasterService();
+            if (master == NULL) {
+                // Only masters serve tables; other servers ignore limits.
+                break;
+            }
+            if (reqHdr->inputLength < sizeof(WireFormat::TableRateLimit)) {
+                respHdr->common.status = STATUS_MESSAGE_TOO_SHORT;
+                return;
+            }
+            const WireFormat::TableRateLimit* limit =
+                    static_cast<const WireFormat::TableRateLimit*>(
+                    inputData);
+            master->rateLimiter.setLimit(limit->tableId,
+                    limit->opsPerSecond, limit->bytesPerSecond);
+            break;
+        }
+        case WireFormat::SET_READ_REPLICA:
+        case WireFormat::GET_READ_REPLICA:
+        {
+            // These are sent to the owner of the tablet, which has been
+            // checked above.
+            if (reqHdr->type != WireFormat::ServerControl::OBJECT) {
+                respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
+                return;
+            }
+            MasterService* master = context->getMasterService();
+            Key key(reqHdr->tableId, rpc->requestPayload->getRange(
+                    sizeof32(*reqHdr), reqHdr->keyLength),
+                    reqHdr->keyLength);
+            if (reqHdr->controlOp == WireFormat::SET_READ_REPLICA) {
+                if (reqHdr->inputLength <
+                        sizeof(WireFormat::ReadReplicaServer)) {
+                    respHdr->common.status = STATUS_MESSAGE_TOO_SHORT;
+                    return;
+                }
+                const WireFormat::ReadReplicaServer* replica =
+                        static_cast<const WireFormat::ReadReplicaServer*>(
+                        inputData);
+                respHdr->common.status = master->setReadReplica(key,
+                        ServerId(replica->serverId));
+                break;
+            }
+            TabletManager::Tablet tablet;
+            string locator = master->getReadReplica(key, &tablet);
+            WireFormat::ReadReplicaLocator* output =
+                    rpc->replyPayload->emplaceAppend<
+                    WireFormat::ReadReplicaLocator>();
+            output->firstKeyHash = tablet.startKeyHash;
+            output->lastKeyHash = tablet.endKeyHash;
+            output->locatorLength = downCast<uint32_t>(locator.length());
+            rpc->replyPayload->appendCopy(locator.c_str(),
+                    output->locatorLength);
+            respHdr->outputLength = sizeof32(*output) +
+                    output->locatorLength;
+            break;
+        }
+        case WireFormat::SYNC_READ_REPLICA:
+        {
+            MasterService* master = context->getMasterService();
+            if (master == NULL) {
+                respHdr->common.status = STATUS_UNKNOWN_TABLET;
+                return;
+            }
+            if (reqHdr->inputLength < sizeof(WireFormat::ReadReplicaSync)) {
+                respHdr->common.status = STATUS_MESSAGE_TOO_SHORT;
+                return;
+            }
+            respHdr->common.status = master->syncReadReplica(
+                    static_cast<const WireFormat::ReadReplicaSync*>(
+                    inputData));
+            break;
+        }
+        case WireFormat::SET_WORKER_OPTION:
+        {
+            // The input is the option's name and then its value, each
+            // followed by a null character.
+            const char* option = static_cast<const char*>(inputData);
+            uint32_t nameLength = 0;
+            if (reqHdr->inputLength > 0) {
+                nameLength = downCast<uint32_t>(
+                        strnlen(option, reqHdr->inputLength));
+            }
+            if ((nameLength + 1 >= reqHdr->inputLength) ||
+                    (option[reqHdr->inputLength - 1] != '\0')) {
+                respHdr->common.status = STATUS_MESSAGE_TOO_SHORT;
+                return;
+            }
+            if (context->workerManager == NULL) {
+                break;
+            }
+            if (!context->workerManager->setOption(option,
+                    option + nameLength + 1)) {
+                respHdr->common.status = STATUS_INVALID_PARAMETER;
+                return;
+            }
+            break;
+        }
+        case WireFormat::SAVE_RESTART_SNAPSHOT:
+        {
+            MasterService* master = context->getMasterService();
+            if (master == NULL) {
+                respHdr->common.status = STATUS_UNIMPLEMENTED_REQUEST;
+                return;
+            }
+            try {
+                master->saveRestartSnapshot();
+            } catch (const Exception& e) {
+                LOG(ERROR, "Couldn't save restart snapshot: %s", e.what());
+                respHdr->common.status = STATUS_INTERNAL_ERROR;
+                return;
+            }
+            break;
+        }
         case WireFormat::START_PERF_COUNTERS:
         {
             Perf::EnabledCounter::enabled = true;
@@ -364,6 +644,10 @@ void
 PingService::dispatch(WireFormat::Opcode opcode, Rpc* rpc)
 {
     switch (opcode) {
+        case WireFormat::Forward::opcode:
+            callHandler<WireFormat::Forward, PingService,
+                        &PingService::forward>(rpc);
+            break;
         case WireFormat::GetMetrics::opcode:
             callHandler<WireFormat::GetMetrics, PingService,
                         &PingService::getMetrics>(rpc);
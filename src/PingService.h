@@ -33,6 +33,9 @@ class PingService : public Service {
     void dispatch(WireFormat::Opcode opcode, Rpc* rpc);
 
   PRIVATE:
+    void forward(const WireFormat::Forward::Request* reqHdr,
+            WireFormat::Forward::Response* respHdr,
+            Rpc* rpc);
     void getMetrics(const WireFormat::GetMetrics::Request* reqHdr,
             WireFormat::GetMetrics::Response* respHdr,
             Rpc* rpc);
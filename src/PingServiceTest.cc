@@ -154,6 +154,85 @@ class PingServiceTest : public ::testing::Test {
     DISALLOW_COPY_AND_ASSIGN(PingServiceTest);
 };
 
+// Fill in a FORWARD request that carries a GET_SERVER_ID request for
+// the server at locator.
+static void
+appendForwardRequest(Buffer* request, const char* locator)
+{
+    WireFormat::Forward::Request* reqHdr =
+            request->emplaceAppend<WireFormat::Forward::Request>();
+    reqHdr->common.opcode = WireFormat::Forward::opcode;
+    reqHdr->common.service = WireFormat::Forward::service;
+    reqHdr->locatorLength = downCast<uint16_t>(strlen(locator));
+    request->appendCopy(locator, reqHdr->locatorLength);
+    WireFormat::GetServerId::Request* innerHdr =
+            request->emplaceAppend<WireFormat::GetServerId::Request>();
+    innerHdr->common.opcode = WireFormat::GetServerId::opcode;
+    innerHdr->common.service = WireFormat::GetServerId::service;
+}
+
+TEST_F(PingServiceTest, forward_basics) {
+    pingService.setServerId(ServerId(3, 5));
+    MockWrapper rpc;
+    appendForwardRequest(&rpc.request, "mock:host=ping");
+    Transport::SessionRef session =
+            context.transportManager->openSession("mock:host=ping");
+    session->sendRequest(&rpc.request, &rpc.response, &rpc);
+    EXPECT_STREQ("completed: 1, failed: 0", rpc.getState());
+    ASSERT_EQ(sizeof(WireFormat::Forward::Response)
+            + sizeof(WireFormat::GetServerId::Response), rpc.response.size());
+    EXPECT_EQ(STATUS_OK, rpc.response.getStart<
+            WireFormat::Forward::Response>()->common.status);
+    const WireFormat::GetServerId::Response* innerHdr =
+            rpc.response.getOffset<WireFormat::GetServerId::Response>(
+            sizeof32(WireFormat::Forward::Response));
+    EXPECT_EQ(STATUS_OK, innerHdr->common.status);
+    EXPECT_EQ(ServerId(3, 5).getId(), innerHdr->serverId);
+}
+
+TEST_F(PingServiceTest, forward_badRequest) {
+    Transport::SessionRef session =
+            context.transportManager->openSession("mock:host=ping");
+
+    // Locator extends past the end of the request.
+    MockWrapper rpc;
+    WireFormat::Forward::Request* reqHdr =
+            rpc.request.emplaceAppend<WireFormat::Forward::Request>();
+    reqHdr->common.opcode = WireFormat::Forward::opcode;
+    reqHdr->common.service = WireFormat::Forward::service;
+    reqHdr->locatorLength = 100;
+    rpc.request.appendCopy("mock:host=ping", 14);
+    session->sendRequest(&rpc.request, &rpc.response, &rpc);
+    EXPECT_EQ(STATUS_REQUEST_FORMAT_ERROR, rpc.response.getStart<
+            WireFormat::Forward::Response>()->common.status);
+
+    // No request after the locator.
+    MockWrapper rpc2;
+    reqHdr = rpc2.request.emplaceAppend<WireFormat::Forward::Request>();
+    reqHdr->common.opcode = WireFormat::Forward::opcode;
+    reqHdr->common.service = WireFormat::Forward::service;
+    reqHdr->locatorLength = 14;
+    rpc2.request.appendCopy("mock:host=ping", 14);
+    session->sendRequest(&rpc2.request, &rpc2.response, &rpc2);
+    EXPECT_EQ(STATUS_REQUEST_FORMAT_ERROR, rpc2.response.getStart<
+            WireFormat::Forward::Response>()->common.status);
+}
+
+TEST_F(PingServiceTest, forward_couldntConnect) {
+    MockTransport mockTransport(&context);
+    context.transportManager->registerMock(&mockTransport, "mock2");
+    mockTransport.setInput(NULL);
+    MockWrapper rpc;
+    appendForwardRequest(&rpc.request, "mock2:");
+    Transport::SessionRef session =
+            context.transportManager->openSession("mock:host=ping");
+    session->sendRequest(&rpc.request, &rpc.response, &rpc);
+    EXPECT_STREQ("completed: 1, failed: 0", rpc.getState());
+    EXPECT_EQ(sizeof(WireFormat::Forward::Response), rpc.response.size());
+    EXPECT_EQ(STATUS_COULDNT_CONNECT, rpc.response.getStart<
+            WireFormat::Forward::Response>()->common.status);
+}
+
 TEST_F(PingServiceTest, getServerId) {
     pingService.setServerId(ServerId(3, 5));
     Transport::SessionRef session =
@@ -0,0 +1,601 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <cpuid.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "PmemStorage.h"
+#include "Buffer.h"
+#include "ClientException.h"
+#include "CycleCounter.h"
+#include "Fence.h"
+#include "PerfStats.h"
+#include "ShortMacros.h"
+
+// Older C libraries don't define these; the values are fixed by the kernel
+// ABI.
+#ifndef MAP_SHARED_VALIDATE
+#define MAP_SHARED_VALIDATE 0x03
+#endif
+#ifndef MAP_SYNC
+#define MAP_SYNC 0x80000
+#endif
+
+namespace RAMCloud {
+
+// --- PmemStorage::Frame ---
+
+/**
+ * Create a Frame associated with a region of persistent memory that may
+ * hold a replica in storage.
+ */
+PmemStorage::Frame::Frame(PmemStorage* storage, size_t frameIndex)
+    : storage(storage)
+    , frameIndex(frameIndex)
+    , isOpen()
+    , isClosed()
+    , appendedToByCurrentProcess()
+    , loadRequested()
+    , metadata(new char[METADATA_SIZE])
+{
+    memset(metadata.get(), '\0', METADATA_SIZE);
+}
+
+/**
+ * Returns true if append has been called on this frame during the life of
+ * this process; returns false otherwise. See
+ * SingleFileStorage::Frame::wasAppendedToByCurrentProcess().
+ */
+bool
+PmemStorage::Frame::wasAppendedToByCurrentProcess()
+{
+    return appendedToByCurrentProcess;
+}
+
+/**
+ * Read the metadata for this frame from persistent memory. Only safe
+ * immediately after the frame is constructed, before any other operations.
+ */
+void
+PmemStorage::Frame::loadMetadata()
+{
+    storage->readAtomicBlock(storage->metadataOfFrame(frameIndex),
+                             metadata.get());
+}
+
+/**
+ * Return a pointer to the most recently appended metadata for this frame.
+ * See InMemoryStorage::Frame::getMetadata() for restrictions.
+ */
+const void*
+PmemStorage::Frame::getMetadata()
+{
+    return metadata.get();
+}
+
+/**
+ * Prevents any further append() calls from being accepted; the data is
+ * always accessible, so there is nothing to load.
+ */
+void
+PmemStorage::Frame::startLoading()
+{
+    Lock lock(storage->mutex);
+    loadRequested = true;
+}
+
+/**
+ * Returns true if calling load() would not block, which is always the case
+ * for PmemStorage.
+ */
+bool
+PmemStorage::Frame::isLoaded()
+{
+    return true;
+}
+
+/**
+ * Return a pointer to the replica data for recovery; it points directly
+ * into persistent memory. Never blocks; prevents any further append()
+ * calls from being accepted.
+ */
+void*
+PmemStorage::Frame::load()
+{
+    startLoading();
+    return storage->dataOfFrame(frameIndex);
+}
+
+/**
+ * Has no effect for PmemStorage.
+ */
+void
+PmemStorage::Frame::unload()
+{
+}
+
+/**
+ * Append data to frame and update metadata. Both are durable in persistent
+ * memory when this method returns.
+ *
+ * Idempotence: the caller must guarantee duplicated calls provide identical
+ * arguments.
+ *
+ * append() after a load() or a close() throws an exception to
+ * the master performing the append since it is either an error by the master
+ * or the master has crashed.
+ *
+ * \param source
+ *      Buffer contained the data to be copied into the frame.
+ * \param sourceOffset
+ *      Offset into \a source where data should be copied from.
+ * \param length
+ *      Bytes to copy to the frame starting at \a sourceOffset in \a source.
+ * \param destinationOffset
+ *      Offset into the frame where the source data should be copied.
+ * \param metadata
+ *      Metadata which should be written to storage immediately after the data
+ *      appended is written. May be NULL if there is no updated metadata to
+ *      commit to storage along with this data.
+ * \param metadataLength
+ *      Bytes of metadata pointed to by \a metadata. Ignored if \a metadata
+ *      is NULL.
+ */
+void
+PmemStorage::Frame::append(Buffer& source,
+                           size_t sourceOffset,
+                           size_t length,
+                           size_t destinationOffset,
+                           const void* metadata,
+                           size_t metadataLength)
+{
+    Lock lock(storage->mutex);
+    CycleCounter<uint64_t> ticks;
+    if (!isOpen) {
+        LOG(ERROR, "Tried to append to a frame but it wasn't"
+            "open on this backup");
+        throw BackupBadSegmentIdException(HERE);
+    }
+    if (loadRequested) {
+        LOG(NOTICE, "Tried to append to a frame but it was already enqueued "
+            "for load for recovery; calling master is probabaly already dead");
+        throw BackupBadSegmentIdException(HERE);
+    }
+    // Three conditions because overflow is possible on addition.
+    if (length > storage->segmentSize ||
+        destinationOffset > storage->segmentSize ||
+        length + destinationOffset > storage->segmentSize)
+    {
+        LOG(ERROR, "Out-of-bounds appended attempted on storage frame: "
+            "offset %lu, length %lu, segmentSize %lu ",
+            destinationOffset, length, storage->segmentSize);
+        throw BackupSegmentOverflowException(HERE);
+    }
+    if (metadataLength > METADATA_SIZE) {
+        LOG(ERROR, "Tried to append to a frame with metadata of length %lu "
+            "but storage only allows max length of %d",
+            metadataLength, METADATA_SIZE);
+        throw BackupSegmentOverflowException(HERE);
+    }
+
+    appendedToByCurrentProcess = true;
+    char* dest = storage->dataOfFrame(frameIndex) + destinationOffset;
+    source.copy(downCast<uint32_t>(sourceOffset),
+                downCast<uint32_t>(length), dest);
+    // The data must be durable before the metadata that describes it.
+    storage->persist(dest, length);
+
+    if (metadata) {
+        memcpy(this->metadata.get(), metadata, metadataLength);
+        storage->writeAtomicBlock(storage->metadataOfFrame(frameIndex),
+                                  metadata, metadataLength);
+    }
+
+    uint64_t elapsed = ticks.stop();
+    ++PerfStats::threadStats.backupWriteOps;
+    PerfStats::threadStats.backupWriteBytes += length;
+    PerfStats::threadStats.backupWriteActiveCycles += elapsed;
+    storage->sleepToThrottleWrites(length + metadataLength, elapsed);
+}
+
+/**
+ * Mark this frame as closed. Calls to close after a call to load() throw
+ * BackupBadSegmentIdException which should kill the calling master; in this
+ * case recovery has already started for them so they are likely already dead.
+ */
+void
+PmemStorage::Frame::close()
+{
+    Lock lock(storage->mutex);
+    if (isClosed)
+        return;
+    if (loadRequested) {
+        LOG(NOTICE, "Tried to close a frame but it was already enqueued "
+            "for load for recovery; calling master is probably already dead");
+        throw BackupBadSegmentIdException(HERE);
+    }
+    isOpen = false;
+    isClosed = true;
+}
+
+// See BackupStorage.h for documentation.
+void
+PmemStorage::Frame::reopen(size_t length)
+{
+    // The replica data is already in place; just start accepting appends
+    // again.
+    Lock lock(storage->mutex);
+    assert(!isOpen && !isClosed);
+    isOpen = true;
+    loadRequested = false;
+}
+
+/**
+ * Do not call; see BackupStorage::freeFrame().
+ * Make this frame available for reuse; data previously stored in this frame
+ * may or may not be part of future recoveries.
+ */
+void
+PmemStorage::Frame::free()
+{
+    Lock lock(storage->mutex);
+    isOpen = false;
+    isClosed = false;
+    storage->freeMap[frameIndex] = 1;
+}
+
+// - private -
+
+/**
+ * Open the frame, resetting its state to accept appends for a new replica.
+ * Nothing is written to persistent memory; see
+ * SingleFileStorage::Frame::open() for the consistency implications.
+ *
+ * Idempotence: Duplicate calls to open() are ignored until the frame is freed.
+ * Calling open() after the frame is freed will reset this frame for reuse
+ * with an new replica.
+ */
+void
+PmemStorage::Frame::open()
+{
+    Lock _(storage->mutex);
+    if (isOpen || isClosed)
+        return;
+    isOpen = true;
+    isClosed = false;
+    memset(metadata.get(), '\0', METADATA_SIZE);
+    loadRequested = false;
+}
+
+// --- PmemStorage ---
+
+/**
+ * Create a PmemStorage.
+ *
+ * \param segmentSize
+ *      The size in bytes of the segments this storage will deal with.
+ * \param frameCount
+ *      The number of segments this storage can store simultaneously.
+ * \param writeRateLimit
+ *      When specified, writes to this storage instance should be
+ *      limited to at most the given rate (in megabytes per second).
+ *      The special value 0 turns off throttling.
+ * \param filePath
+ *      A file on a DAX filesystem (or a DAX device) to map. If NULL or
+ *      empty then a temporary file in the system temp directory is created
+ *      and it is deleted when this storage instance is destroyed.
+ */
+PmemStorage::PmemStorage(size_t segmentSize,
+                         size_t frameCount,
+                         size_t writeRateLimit,
+                         const char* filePath)
+    : BackupStorage(segmentSize, Type::PMEM, writeRateLimit)
+    , mutex()
+    , frames()
+    , frameCount(frameCount)
+    , freeMap(frameCount)
+    , lastAllocatedFrame(FreeMap::npos)
+    , fd(-1)
+    , base(NULL)
+    , mappingLength(sizeof(AtomicBlock) +
+                    frameCount * (segmentSize + sizeof(AtomicBlock)))
+    , flushInstruction(CLFLUSH)
+    , tempFilePath()
+{
+    if (filePath == NULL || filePath[0] == '\0') {
+        tempFilePath =
+            strdup("/tmp/ramcloud-pmem-storage-test-delete-this-XXXXXX");
+        fd = ::mkostemp(tempFilePath, O_CREAT | O_RDWR);
+        filePath = tempFilePath;
+    } else {
+        fd = ::open(filePath, O_CREAT | O_RDWR, 0666);
+    }
+    if (fd == -1) {
+        int e = errno;
+        LOG(ERROR, "Failed to open backup storage file %s: %s",
+            filePath, strerror(e));
+        throw BackupStorageException(HERE,
+              format("Failed to open backup storage file %s", filePath), e);
+    }
+
+    // Allocate all the blocks now, so that page faults on the mapping
+    // never have to.
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        int e = posix_fallocate(fd, 0, mappingLength);
+        if (e != 0) {
+            LOG(ERROR, "Failed to reserve %lu bytes in %s: %s",
+                mappingLength, filePath, strerror(e));
+            ::close(fd);
+            throw BackupStorageException(HERE,
+                  format("Failed to reserve space in %s", filePath), e);
+        }
+    }
+
+    void* mapping = mmap(NULL, mappingLength, PROT_READ | PROT_WRITE,
+                         MAP_SHARED_VALIDATE | MAP_SYNC, fd, 0);
+    if (mapping == MAP_FAILED) {
+        LOG(WARNING, "Couldn't map %s for direct access (%s); replicas "
+            "will only be as durable as the page cache", filePath,
+            strerror(errno));
+        mapping = mmap(NULL, mappingLength, PROT_READ | PROT_WRITE,
+                       MAP_SHARED, fd, 0);
+    }
+    if (mapping == MAP_FAILED) {
+        int e = errno;
+        LOG(ERROR, "Failed to map backup storage file %s: %s",
+            filePath, strerror(e));
+        ::close(fd);
+        throw BackupStorageException(HERE,
+              format("Failed to map backup storage file %s", filePath), e);
+    }
+    base = static_cast<char*>(mapping);
+
+    // CPUID leaf 7 reports CLFLUSHOPT (bit 23) and CLWB (bit 24) in EBX.
+    if (__get_cpuid_max(0, NULL) >= 7) {
+        uint32_t eax, ebx, ecx, edx;
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        if (ebx & (1 << 24))
+            flushInstruction = CLWB;
+        else if (ebx & (1 << 23))
+            flushInstruction = CLFLUSHOPT;
+    }
+
+    for (size_t frame = 0; frame < frameCount; ++frame)
+        frames.emplace_back(this, frame);
+    freeMap.set();
+}
+
+/// Unmap and close the file.
+PmemStorage::~PmemStorage()
+{
+    if (base != NULL)
+        munmap(base, mappingLength);
+    if (fd != -1 && close(fd) == -1)
+        LOG(ERROR, "Couldn't close backup storage file");
+    if (tempFilePath) {
+        unlink(tempFilePath);
+        ::free(tempFilePath);
+        tempFilePath = NULL;
+    }
+}
+
+/**
+ * Allocate a frame on storage, resetting its state to accept appends for a
+ * new replica. See BackupStorage::open(). \a sync is ignored, since
+ * appends are always durable when they return.
+ */
+PmemStorage::FrameRef
+PmemStorage::open(bool sync)
+{
+    Lock lock(mutex);
+    FreeMap::size_type next = freeMap.find_next(lastAllocatedFrame);
+    if (next == FreeMap::npos) {
+        next = freeMap.find_first();
+        if (next == FreeMap::npos) {
+            RAMCLOUD_CLOG(NOTICE, "Rejecting open: no free storage frames");
+            throw BackupOpenRejectedException(HERE);
+        }
+    }
+    lastAllocatedFrame = next;
+    size_t frameIndex = next;
+    assert(freeMap[frameIndex] == 1);
+    freeMap[frameIndex] = 0;
+    Frame* frame = &frames[frameIndex];
+    lock.unlock();
+    frame->open();
+    return {frame, BackupStorage::freeFrame};
+}
+
+/**
+ * Returns the maximum number of bytes of metadata that can be stored
+ * which each append(). See BackupStorage::getMetadataSize().
+ */
+size_t
+PmemStorage::getMetadataSize()
+{
+    return METADATA_SIZE;
+}
+
+/**
+ * Marks ALL storage frames as allocated and loads their metadata from
+ * persistent memory. See BackupStorage::loadAllMetadata().
+ */
+std::vector<BackupStorage::FrameRef>
+PmemStorage::loadAllMetadata()
+{
+    std::vector<FrameRef> ret;
+    ret.reserve(frames.size());
+    foreach (auto& frame, frames) {
+        frame.loadMetadata();
+        assert(freeMap[frame.frameIndex] == 1);
+        freeMap[frame.frameIndex] = 0;
+        ret.push_back({&frame, BackupStorage::freeFrame});
+    }
+    return ret;
+}
+
+/**
+ * Atomically replace the superblock. See BackupStorage::resetSuperblock();
+ * \a frameSkipMask is ignored, since there is only one superblock image
+ * (which can't be left partially written).
+ */
+void
+PmemStorage::resetSuperblock(ServerId serverId,
+                             const string& clusterName,
+                             const uint32_t frameSkipMask)
+{
+    Superblock newSuperblock(loadSuperblock().version + 1,
+                             serverId, clusterName.c_str());
+    Lock lock(mutex);
+    writeAtomicBlock(reinterpret_cast<AtomicBlock*>(base),
+                     &newSuperblock, sizeof(newSuperblock));
+}
+
+/**
+ * Return the superblock from persistent memory, or a default superblock if
+ * none has ever been written. See BackupStorage::loadSuperblock().
+ */
+BackupStorage::Superblock
+PmemStorage::loadSuperblock()
+{
+    char block[METADATA_SIZE];
+    const AtomicBlock* superblockBlock = reinterpret_cast<AtomicBlock*>(base);
+    readAtomicBlock(superblockBlock, block);
+    if (superblockBlock->version == 0)
+        return {};
+    Superblock superblock;
+    memcpy(&superblock, block, sizeof(superblock));
+    return superblock;
+}
+
+/**
+ * No-op for PmemStorage: appends are durable when they return.
+ */
+void
+PmemStorage::quiesce()
+{
+}
+
+/**
+ * Invalidate the metadata of all the storage frames to prevent what is
+ * already in persistent memory from being reused in future runs. See
+ * BackupStorage::fry().
+ */
+void
+PmemStorage::fry()
+{
+    for (size_t frame = 0; frame < frameCount; ++frame) {
+        AtomicBlock* block = metadataOfFrame(frame);
+        block->version = 0;
+        persist(&block->version, sizeof(block->version));
+    }
+}
+
+/// Return the start of the data area for a frame.
+char*
+PmemStorage::dataOfFrame(size_t frameIndex) const
+{
+    return base + sizeof(AtomicBlock) +
+           frameIndex * (segmentSize + sizeof(AtomicBlock));
+}
+
+/// Return the metadata block for a frame, which follows its data.
+PmemStorage::AtomicBlock*
+PmemStorage::metadataOfFrame(size_t frameIndex) const
+{
+    return reinterpret_cast<AtomicBlock*>(dataOfFrame(frameIndex) +
+                                          segmentSize);
+}
+
+/**
+ * Write a range of the mapping back from the CPU caches to persistent
+ * memory, and wait until that is done. The time spent is recorded in
+ * PerfStats::backupFlushCycles.
+ */
+void
+PmemStorage::persist(const void* start, size_t length) const
+{
+    CycleCounter<uint64_t> ticks;
+    uintptr_t line = reinterpret_cast<uintptr_t>(start) &
+                     ~static_cast<uintptr_t>(CACHE_LINE_SIZE - 1);
+    uintptr_t end = reinterpret_cast<uintptr_t>(start) + length;
+    for (; line < end; line += CACHE_LINE_SIZE) {
+        volatile char* p = reinterpret_cast<volatile char*>(line);
+        // The CLWB and CLFLUSHOPT encodings are spelled out so that older
+        // assemblers can handle them.
+        switch (flushInstruction) {
+        case CLWB:
+            __asm__ __volatile__(".byte 0x66; xsaveopt %0" : "+m" (*p));
+            break;
+        case CLFLUSHOPT:
+            __asm__ __volatile__(".byte 0x66; clflush %0" : "+m" (*p));
+            break;
+        case CLFLUSH:
+            __asm__ __volatile__("clflush %0" : "+m" (*p));
+            break;
+        }
+    }
+    Fence::sfence();
+    PerfStats::threadStats.backupFlushCycles += ticks.stop();
+}
+
+/**
+ * Copy the current image of a block into \a dest (METADATA_SIZE bytes);
+ * zeros if the block has never been written.
+ */
+void
+PmemStorage::readAtomicBlock(const AtomicBlock* block, void* dest) const
+{
+    uint64_t version = block->version;
+    if (version == 0)
+        memset(dest, 0, METADATA_SIZE);
+    else
+        memcpy(dest, block->slots[version % 2], METADATA_SIZE);
+}
+
+/**
+ * Atomically replace the contents of a block: after a crash, the block
+ * holds either its old contents or the new ones. Returns once the new
+ * contents are durable.
+ *
+ * \param block
+ *      Block to update.
+ * \param src
+ *      New contents.
+ * \param length
+ *      Bytes of \a src; at most METADATA_SIZE. The rest of the block is
+ *      zeroed.
+ */
+void
+PmemStorage::writeAtomicBlock(AtomicBlock* block, const void* src,
+                              size_t length) const
+{
+    uint64_t version = block->version + 1;
+    char* slot = block->slots[version % 2];
+    memcpy(slot, src, length);
+    memset(slot + length, 0, METADATA_SIZE - length);
+    persist(slot, METADATA_SIZE);
+
+    // An aligned 8-byte store can't be torn, so this switches atomically
+    // to the new slot.
+    *reinterpret_cast<volatile uint64_t*>(&block->version) = version;
+    persist(&block->version, sizeof(block->version));
+}
+
+} // namespace RAMCloud
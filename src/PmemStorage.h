@@ -0,0 +1,219 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_PMEMSTORAGE_H
+#define RAMCLOUD_PMEMSTORAGE_H
+
+#include <deque>
+
+#include "Common.h"
+#include "BackupStorage.h"
+#include "SingleFileStorage.h"
+
+namespace RAMCloud {
+
+/**
+ * A BackupStorage backend which keeps replicas in byte-addressable
+ * persistent memory (e.g. NVDIMMs or CXL memory exposed through a file on
+ * a DAX filesystem). The whole file is mapped into the address space;
+ * append() copies data straight from the RPC buffer into the mapping and
+ * then flushes it out of the CPU caches, so it is durable by the time
+ * append() returns and no IO thread or staging buffer is needed. Loads
+ * return a pointer into the mapping.
+ *
+ * For metadata (and the superblock) to be updated atomically, each has two
+ * slots plus an 8-byte version word: a new image is written and flushed
+ * into the slot not named by the version, and then the version (whose
+ * store is failure-atomic) is advanced to select it.
+ *
+ * If the file isn't on a DAX filesystem the mapping goes through the page
+ * cache, and data is only as durable as the page cache (a warning is
+ * logged); this is useful for testing.
+ */
+class PmemStorage : public BackupStorage {
+  public:
+    /**
+     * Represents a region of persistent memory which holds a single
+     * replica. PmemStorage keeps exactly one frame for each space in the
+     * mapping where it holds (or could hold) a replica. Frames get reused
+     * for different replicas making a frame something of a state machine.
+     * See SingleFileStorage::Frame for the life cycle.
+     */
+    class Frame : public BackupStorage::Frame {
+      PUBLIC:
+        typedef std::unique_lock<std::mutex> Lock;
+
+        Frame(PmemStorage* storage, size_t frameIndex);
+
+        bool wasAppendedToByCurrentProcess();
+
+        void loadMetadata();
+        const void* getMetadata();
+
+        void startLoading();
+        bool isLoaded();
+        bool currentlyOpen() {return isOpen;}
+        void* load();
+        void unload();
+
+        void append(Buffer& source,
+                    size_t sourceOffset,
+                    size_t length,
+                    size_t destinationOffset,
+                    const void* metadata,
+                    size_t metadataLength);
+        void close();
+        void reopen(size_t length);
+        void free();
+
+      PRIVATE:
+        void open();
+
+        /// Storage where this frame resides.
+        PmemStorage* storage;
+
+        /// Index of the frame in #storage.frames. Used to mark the frame free.
+        const size_t frameIndex;
+
+        /**
+         * Tracks whether a replica has been opened (either initially or
+         * since the time of the last free). False if #isClosed.
+         */
+        bool isOpen;
+
+        /**
+         * Tracks whether a replica has been closed (either initially or
+         * since the time of the last free). False if #isOpen.
+         */
+        bool isClosed;
+
+        /**
+         * Tracks whether append has been called on this frame during the
+         * life of this process. This includes across free()/open() cycles.
+         * See SingleFileStorage::Frame::appendedToByCurrentProcess.
+         */
+        bool appendedToByCurrentProcess;
+
+        /**
+         * True if the replica data has been requested. Used to reject
+         * appends after load requests.
+         */
+        bool loadRequested;
+
+        /**
+         * Copy of the most recently appended metadata for this frame (or
+         * the metadata found in persistent memory by loadMetadata()).
+         */
+        std::unique_ptr<char[]> metadata;
+
+        friend class PmemStorage;
+        DISALLOW_COPY_AND_ASSIGN(Frame);
+    };
+
+    PmemStorage(size_t segmentSize,
+                size_t frameCount,
+                size_t writeRateLimit,
+                const char* filePath);
+    ~PmemStorage();
+
+    FrameRef open(bool sync);
+    size_t getMetadataSize();
+    std::vector<FrameRef> loadAllMetadata();
+    void resetSuperblock(ServerId serverId,
+                         const string& clusterName,
+                         uint32_t frameSkipMask = 0);
+    Superblock loadSuperblock();
+    void quiesce();
+    void fry();
+
+  PRIVATE:
+    /// Maximum size of metadata for each frame.
+    enum { METADATA_SIZE = SingleFileStorage::METADATA_SIZE };
+
+    /**
+     * Layout in persistent memory of a block of METADATA_SIZE bytes that
+     * can be replaced atomically (see the class comment).
+     */
+    struct AtomicBlock {
+        /// Number of times the block has been written; slot (version % 2)
+        /// holds the current image. 0 means never written.
+        uint64_t version;
+        char padding[METADATA_SIZE - sizeof(uint64_t)];
+
+        /// The two images.
+        char slots[2][METADATA_SIZE];
+    };
+
+    /// Instructions that can be used to write back a cache line.
+    enum FlushInstruction {
+        CLWB,           // Writes back without evicting the line.
+        CLFLUSHOPT,     // Evicts; weakly ordered.
+        CLFLUSH,        // Evicts; strongly ordered (always available).
+    };
+
+    char* dataOfFrame(size_t frameIndex) const;
+    AtomicBlock* metadataOfFrame(size_t frameIndex) const;
+    void persist(const void* start, size_t length) const;
+    void readAtomicBlock(const AtomicBlock* block, void* dest) const;
+    void writeAtomicBlock(AtomicBlock* block, const void* src,
+                          size_t length) const;
+
+    /// Protects concurrent operations on storage and all of its frames.
+    std::mutex mutex;
+    typedef std::unique_lock<std::mutex> Lock;
+
+    /// A frame for each region of the mapping which can hold a replica.
+    std::deque<Frame> frames;
+
+    /// The number of replicas this storage can store simultaneously.
+    const size_t frameCount;
+
+    /// Type of the freeMap.  A bitmap.
+    typedef boost::dynamic_bitset<> FreeMap;
+    /// Keeps a bit set for each frame in frames indicating if it is free.
+    FreeMap freeMap;
+
+    /**
+     * Track the last used segment frame so they can be used in FIFO.
+     * This gives recovery dump tools a much better chance at recovering
+     * data since old data is destroyed from storage first rather than new.
+     */
+    FreeMap::size_type lastAllocatedFrame;
+
+    /// The file descriptor of the mapped file.
+    int fd;
+
+    /// Start of the mapping: the superblock's AtomicBlock, followed by each
+    /// frame's data and then its metadata AtomicBlock.
+    char* base;
+
+    /// Length of the mapping, in bytes.
+    size_t mappingLength;
+
+    /// The best flush instruction this CPU supports.
+    FlushInstruction flushInstruction;
+
+    /**
+     * Filename if none was specified. If set the file is deleted when this
+     * instance is destroyed. Useful for testing.
+     */
+    char* tempFilePath;
+
+    DISALLOW_COPY_AND_ASSIGN(PmemStorage);
+};
+
+} // namespace RAMCloud
+
+#endif
@@ -0,0 +1,138 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "ClientException.h"
+#include "PerfStats.h"
+#include "PmemStorage.h"
+
+namespace RAMCloud {
+
+class PmemStorageTest : public ::testing::Test {
+  public:
+    typedef PmemStorage::Frame Frame;
+
+    const char* test;
+    uint32_t testLength;
+    Buffer testSource;
+    uint32_t segmentFrames;
+    uint32_t segmentSize;
+    Tub<PmemStorage> storage;
+
+    PmemStorageTest()
+        : test("test")
+        , testLength(downCast<uint32_t>(strlen(test)))
+        , testSource()
+        , segmentFrames(4)
+        , segmentSize(4096)
+        , storage()
+    {
+        Logger::get().setLogLevels(SILENT_LOG_LEVEL);
+        testSource.appendExternal(test, testLength + 1);
+        storage.construct(segmentSize, segmentFrames, 0,
+                          static_cast<const char*>(NULL));
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(PmemStorageTest);
+};
+
+TEST_F(PmemStorageTest, Frame_append) {
+    BackupStorage::FrameRef frame = storage->open(false);
+    uint64_t flushCycles = PerfStats::threadStats.backupFlushCycles;
+    frame->append(testSource, 0, testLength + 1, 10, test, testLength + 1);
+    EXPECT_STREQ(test, storage->dataOfFrame(0) + 10);
+    EXPECT_STREQ(test, static_cast<const char*>(frame->getMetadata()));
+    EXPECT_LT(flushCycles, PerfStats::threadStats.backupFlushCycles);
+
+    // Metadata made it to persistent memory too.
+    char metadata[PmemStorage::METADATA_SIZE];
+    storage->readAtomicBlock(storage->metadataOfFrame(0), metadata);
+    EXPECT_STREQ(test, metadata);
+}
+
+TEST_F(PmemStorageTest, Frame_appendAfterLoad) {
+    BackupStorage::FrameRef frame = storage->open(false);
+    frame->append(testSource, 0, testLength + 1, 0, NULL, 0);
+    EXPECT_STREQ(test, static_cast<char*>(frame->load()));
+    EXPECT_THROW(frame->append(testSource, 0, testLength + 1, 0, NULL, 0),
+                 BackupBadSegmentIdException);
+}
+
+TEST_F(PmemStorageTest, Frame_appendOutOfBounds) {
+    BackupStorage::FrameRef frame = storage->open(false);
+    EXPECT_THROW(frame->append(testSource, 0, testLength + 1,
+                               segmentSize, NULL, 0),
+                 BackupSegmentOverflowException);
+}
+
+TEST_F(PmemStorageTest, Frame_loadMetadata) {
+    {
+        BackupStorage::FrameRef frame = storage->open(false);
+        frame->append(testSource, 0, 0, 0, test, testLength + 1);
+    }
+    Frame* frame = &storage->frames[0];
+    memset(frame->metadata.get(), 0, PmemStorage::METADATA_SIZE);
+    frame->loadMetadata();
+    EXPECT_STREQ(test, static_cast<const char*>(frame->getMetadata()));
+}
+
+TEST_F(PmemStorageTest, writeAtomicBlock) {
+    PmemStorage::AtomicBlock* block = storage->metadataOfFrame(1);
+    char result[PmemStorage::METADATA_SIZE];
+    storage->readAtomicBlock(block, result);
+    EXPECT_EQ(0, result[0]);
+
+    storage->writeAtomicBlock(block, "first", 6);
+    EXPECT_EQ(1U, block->version);
+    storage->writeAtomicBlock(block, "second", 7);
+    EXPECT_EQ(2U, block->version);
+    storage->readAtomicBlock(block, result);
+    EXPECT_STREQ("second", result);
+
+    // The previous image is untouched until the next write.
+    EXPECT_STREQ("first", block->slots[1]);
+}
+
+TEST_F(PmemStorageTest, open_noFreeFrames) {
+    std::vector<BackupStorage::FrameRef> frames;
+    for (uint32_t i = 0; i < segmentFrames; i++)
+        frames.push_back(storage->open(false));
+    EXPECT_THROW(storage->open(false), BackupOpenRejectedException);
+    frames.pop_back();
+    EXPECT_NO_THROW(storage->open(false));
+}
+
+TEST_F(PmemStorageTest, superblock) {
+    EXPECT_EQ(0U, storage->loadSuperblock().version);
+    storage->resetSuperblock({99, 0}, "cluster");
+    storage->resetSuperblock({100, 0}, "cluster");
+    auto superblock = storage->loadSuperblock();
+    EXPECT_EQ(2U, superblock.version);
+    EXPECT_EQ(ServerId(100, 0), superblock.getServerId());
+    EXPECT_STREQ("cluster", superblock.getClusterName());
+}
+
+TEST_F(PmemStorageTest, fry) {
+    {
+        BackupStorage::FrameRef frame = storage->open(false);
+        frame->append(testSource, 0, 0, 0, test, testLength + 1);
+    }
+    storage->fry();
+    std::vector<BackupStorage::FrameRef> frames = storage->loadAllMetadata();
+    ASSERT_EQ(segmentFrames, frames.size());
+    EXPECT_EQ(0, static_cast<const char*>(frames[0]->getMetadata())[0]);
+}
+
+}  // namespace RAMCloud
@@ -383,8 +383,7 @@ ParticipantList::computeChecksum()
  */
 PreparedOps::PreparedOps(Context* context)
     : context(context)
-    , mutex()
-    , items()
+    , shards()
 {
 }
 
@@ -393,13 +392,13 @@ PreparedOps::PreparedOps(Context* context)
  */
 PreparedOps::~PreparedOps()
 {
-    Lock lock(mutex);
-    std::map<std::pair<uint64_t, uint64_t>,
-        PreparedItem*>::iterator it;
-
-    for (it = items.begin(); it != items.end(); ++it) {
-        PreparedItem* item = it->second;
-        delete item;
+    for (uint32_t i = 0; i < NUM_SHARDS; i++) {
+        Lock lock(shards[i].mutex);
+        ItemsMap& items = shards[i].items;
+        for (ItemsMap::iterator it = items.begin(); it != items.end(); ++it) {
+            PreparedItem* item = it->second;
+            delete item;
+        }
     }
 }
 
@@ -424,7 +423,9 @@ PreparedOps::bufferOp(uint64_t leaseId,
                             uint64_t newOpPtr,
                             bool isRecovery)
 {
-    Lock lock(mutex);
+    Shard* shard = getShard(leaseId, rpcId);
+    Lock lock(shard->mutex);
+    ItemsMap& items = shard->items;
 
     assert(items.find(std::make_pair(leaseId, rpcId)) == items.end());
 
@@ -448,13 +449,12 @@ void
 PreparedOps::removeOp(uint64_t leaseId,
                       uint64_t rpcId)
 {
-    Lock lock(mutex);
-    std::map<std::pair<uint64_t, uint64_t>,
-        PreparedItem*>::iterator it;
-    it = items.find(std::make_pair(leaseId, rpcId));
-    if (it != items.end()) {
+    Shard* shard = getShard(leaseId, rpcId);
+    Lock lock(shard->mutex);
+    ItemsMap::iterator it = shard->items.find(std::make_pair(leaseId, rpcId));
+    if (it != shard->items.end()) {
         delete it->second;
-        items.erase(it);
+        shard->items.erase(it);
     }
 }
 
@@ -479,11 +479,10 @@ PreparedOps::removeOp(uint64_t leaseId,
 uint64_t
 PreparedOps::getOp(uint64_t leaseId, uint64_t rpcId)
 {
-    Lock lock(mutex);
-    std::map<std::pair<uint64_t, uint64_t>,
-        PreparedItem*>::iterator it;
-    it = items.find(std::make_pair(leaseId, rpcId));
-    if (it == items.end()) {
+    Shard* shard = getShard(leaseId, rpcId);
+    Lock lock(shard->mutex);
+    ItemsMap::iterator it = shard->items.find(std::make_pair(leaseId, rpcId));
+    if (it == shard->items.end()) {
         return 0;
     } else {
         // During recovery, must check isDeleted before using this method since
@@ -515,8 +514,9 @@ PreparedOps::updatePtr(uint64_t leaseId,
                           uint64_t rpcId,
                           uint64_t newOpPtr)
 {
-    Lock lock(mutex);
-    PreparedItem* item = items[std::make_pair(leaseId, rpcId)];
+    Shard* shard = getShard(leaseId, rpcId);
+    Lock lock(shard->mutex);
+    PreparedItem* item = shard->items[std::make_pair(leaseId, rpcId)];
     item->newOpPtr = newOpPtr;
 }
 
@@ -611,26 +611,29 @@ PreparedOps::PreparedItem::handleTimerEvent()
 void
 PreparedOps::regrabLocksAfterRecovery(ObjectManager* objectManager)
 {
-    Lock lock(mutex);
-    ItemsMap::iterator it = items.begin();
-    while (it != items.end()) {
-        PreparedItem *item = it->second;
-
-        if (item == NULL) { //Cleanup marks for deleted.
-            items.erase(it++);
-        } else {
-            Buffer buffer;
-            Log::Reference ref(item->newOpPtr);
-            objectManager->getLog()->getEntry(ref, buffer);
-            PreparedOp op(buffer, 0, buffer.size());
-            objectManager->tryGrabTxLock(op.object, ref);
-
-            if (!item->isRunning()) {
-                item->start(Cycles::rdtsc() +
-                        Cycles::fromMicroseconds(PreparedItem::TX_TIMEOUT_US));
+    for (uint32_t i = 0; i < NUM_SHARDS; i++) {
+        Lock lock(shards[i].mutex);
+        ItemsMap& items = shards[i].items;
+        ItemsMap::iterator it = items.begin();
+        while (it != items.end()) {
+            PreparedItem *item = it->second;
+
+            if (item == NULL) { //Cleanup marks for deleted.
+                items.erase(it++);
+            } else {
+                Buffer buffer;
+                Log::Reference ref(item->newOpPtr);
+                objectManager->getLog()->getEntry(ref, buffer);
+                PreparedOp op(buffer, 0, buffer.size());
+                objectManager->tryGrabTxLock(op.object, ref);
+
+                if (!item->isRunning()) {
+                    item->start(Cycles::rdtsc() + Cycles::fromMicroseconds(
+                            PreparedItem::TX_TIMEOUT_US));
+                }
+
+                ++it;
             }
-
-            ++it;
         }
     }
 }
@@ -649,7 +652,9 @@ void
 PreparedOps::markDeleted(uint64_t leaseId,
                             uint64_t rpcId)
 {
-    Lock lock(mutex);
+    Shard* shard = getShard(leaseId, rpcId);
+    Lock lock(shard->mutex);
+    ItemsMap& items = shard->items;
     assert(items.find(std::make_pair(leaseId, rpcId)) == items.end() ||
            items.find(std::make_pair(leaseId, rpcId))->second == NULL);
     items[std::make_pair(leaseId, rpcId)] = NULL;
@@ -668,12 +673,11 @@ bool
 PreparedOps::isDeleted(uint64_t leaseId,
                           uint64_t rpcId)
 {
-    Lock lock(mutex);
+    Shard* shard = getShard(leaseId, rpcId);
+    Lock lock(shard->mutex);
 
-    std::map<std::pair<uint64_t, uint64_t>,
-        PreparedItem*>::iterator it;
-    it = items.find(std::make_pair(leaseId, rpcId));
-    if (it == items.end()) {
+    ItemsMap::iterator it = shard->items.find(std::make_pair(leaseId, rpcId));
+    if (it == shard->items.end()) {
         return false;
     } else {
         if (it->second == NULL) {
@@ -684,4 +688,37 @@ PreparedOps::isDeleted(uint64_t leaseId,
     }
 }
 
+/**
+ * Return the shard that holds (or would hold) the PreparedItem for a given
+ * preparedOp.
+ *
+ * \param leaseId
+ *      leaseId given for the preparedOp.
+ * \param rpcId
+ *      rpcId given for the preparedOp.
+ */
+PreparedOps::Shard*
+PreparedOps::getShard(uint64_t leaseId, uint64_t rpcId)
+{
+    // Consecutive rpcIds from one client land in different shards, as do
+    // the same rpcIds from different clients.
+    uint64_t hash = (leaseId * 0x9e3779b97f4a7c15UL) ^ rpcId;
+    return &shards[hash & (NUM_SHARDS - 1)];
+}
+
+/**
+ * Return the number of entries (including those marked deleted) across all
+ * shards.  This method is used only for unit testing.
+ */
+size_t
+PreparedOps::size()
+{
+    size_t count = 0;
+    for (uint32_t i = 0; i < NUM_SHARDS; i++) {
+        Lock lock(shards[i].mutex);
+        count += shards[i].items.size();
+    }
+    return count;
+}
+
 } // namespace RAMCloud
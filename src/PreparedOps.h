@@ -356,6 +356,9 @@ class PreparedOps {
     void regrabLocksAfterRecovery(ObjectManager* objectManager);
 
   PRIVATE:
+    /// Used only for testing.
+    size_t size();
+
     /**
      * Wrapper for the pointer to PreparedOp with WorkerTimer.
      * This represents an active locking on an object, and its timer
@@ -414,17 +417,34 @@ class PreparedOps {
 
     Context* context;
 
-    /**
-     * Monitor-style lock. Any operation on internal data structure should
-     * hold this lock.
-     */
-    std::mutex mutex;
     typedef std::lock_guard<std::mutex> Lock;
 
     /// mapping from <LeaseId, RpcId> to PreparedItem.
-    std::map<std::pair<uint64_t, uint64_t>, PreparedItem*> items;
     typedef std::map<std::pair<uint64_t, uint64_t>, PreparedItem*> ItemsMap;
 
+    /**
+     * The PreparedItems are split among several shards, each with its own
+     * lock, so that transactions from different clients (or different
+     * transactions from the same client) rarely contend with each other.
+     */
+    struct Shard {
+        Shard() : mutex(), items() {}
+
+        /// Monitor-style lock. Any operation on this shard's items should
+        /// hold this lock.
+        std::mutex mutex;
+
+        /// The PreparedItems whose <LeaseId, RpcId> map to this shard.
+        ItemsMap items;
+    };
+
+    /// Number of shards; must be a power of two.
+    static const uint32_t NUM_SHARDS = 16;
+
+    Shard shards[NUM_SHARDS];
+
+    Shard* getShard(uint64_t leaseId, uint64_t rpcId);
+
     DISALLOW_COPY_AND_ASSIGN(PreparedOps);
 };
 
@@ -13,6 +13,8 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <set>
+
 #include "TestUtil.h"
 
 #include "AbstractLog.h"
@@ -435,21 +437,23 @@ class PreparedOpsTest : public ::testing::Test {
 
 TEST_F(PreparedOpsTest, bufferWrite) {
     writes.bufferOp(2, 8, 1028);
-    PreparedOps::PreparedItem* item = writes.items[std::make_pair(2UL, 8UL)];
+    PreparedOps::PreparedItem* item =
+            writes.getShard(2, 8)->items[std::make_pair(2UL, 8UL)];
     EXPECT_EQ(1028UL, item->newOpPtr);
     EXPECT_TRUE(item->isRunning());
 
     // Use during recovery. Should not set timer.
     writes.bufferOp(2, 9, 1029, true);
-    item = writes.items[std::make_pair(2UL, 9UL)];
+    item = writes.getShard(2, 9)->items[std::make_pair(2UL, 9UL)];
     EXPECT_EQ(1029UL, item->newOpPtr);
     EXPECT_FALSE(item->isRunning());
 }
 
 TEST_F(PreparedOpsTest, removeOp) {
-    EXPECT_EQ(1011UL, writes.items[std::make_pair(1, 10)]->newOpPtr);
+    PreparedOps::ItemsMap* items = &writes.getShard(1, 10)->items;
+    EXPECT_EQ(1011UL, (*items)[std::make_pair(1, 10)]->newOpPtr);
     writes.removeOp(1, 10);
-    EXPECT_EQ(writes.items.end(), writes.items.find(std::make_pair(1, 10)));
+    EXPECT_EQ(items->end(), items->find(std::make_pair(1, 10)));
 }
 
 TEST_F(PreparedOpsTest, getOp) {
@@ -472,6 +476,19 @@ TEST_F(PreparedOpsTest, markDeletedAndIsDeleted) {
     EXPECT_FALSE(writes.isDeleted(2, 9));
 }
 
+TEST_F(PreparedOpsTest, getShard) {
+    // Consecutive rpcIds from one client are spread across shards.
+    std::set<PreparedOps::Shard*> used;
+    for (uint64_t rpcId = 1; rpcId <= PreparedOps::NUM_SHARDS; rpcId++)
+        used.insert(writes.getShard(1, rpcId));
+    EXPECT_EQ(PreparedOps::NUM_SHARDS, used.size());
+    EXPECT_EQ(writes.getShard(3, 7), writes.getShard(3, 7));
+
+    writes.bufferOp(2, 8, 1028);
+    writes.markDeleted(2, 9);
+    EXPECT_EQ(3U, writes.size());
+}
+
 /**
  * Unit tests for ParticipantList.
  */
@@ -684,9 +701,9 @@ class PreparedItemTest : public ::testing::Test {
             service1->context->dispatch->poll();
             service2->context->dispatch->poll();
             service3->context->dispatch->poll();
-            if (service1->preparedOps.items.size() == 0 &&
-                    service2->preparedOps.items.size() == 0 &&
-                    service3->preparedOps.items.size() == 0 &&
+            if (service1->preparedOps.size() == 0 &&
+                    service2->preparedOps.size() == 0 &&
+                    service3->preparedOps.size() == 0 &&
                     service1->txRecoveryManager.recoveries.size() == 0 &&
                     service2->txRecoveryManager.recoveries.size() == 0 &&
                     service3->txRecoveryManager.recoveries.size() == 0) {
@@ -694,9 +711,9 @@ class PreparedItemTest : public ::testing::Test {
             }
             usleep(1000);
         }
-        EXPECT_EQ(0lu, service1->preparedOps.items.size());
-        EXPECT_EQ(0lu, service2->preparedOps.items.size());
-        EXPECT_EQ(0lu, service3->preparedOps.items.size());
+        EXPECT_EQ(0lu, service1->preparedOps.size());
+        EXPECT_EQ(0lu, service2->preparedOps.size());
+        EXPECT_EQ(0lu, service3->preparedOps.size());
         EXPECT_EQ(0lu, service1->txRecoveryManager.recoveries.size());
         EXPECT_EQ(0lu, service2->txRecoveryManager.recoveries.size());
         EXPECT_EQ(0lu, service3->txRecoveryManager.recoveries.size());
@@ -741,7 +758,8 @@ TEST_F(PreparedItemTest, handleTimerEvent_basic) {
     Cycles::mockTscValue = 100;
     service1->preparedOps.bufferOp(1, 13, opRef.toInteger());
     EXPECT_EQ(opRef.toInteger(), service1->preparedOps.getOp(1, 13));
-    PreparedOps::PreparedItem* item = service1->preparedOps.items[
+    PreparedOps::PreparedItem* item =
+            service1->preparedOps.getShard(1, 13)->items[
             std::make_pair<uint64_t, uint64_t>(1, 13)];
     EXPECT_TRUE(item != NULL && item->isRunning());
     service1->context->dispatch->poll();
@@ -777,7 +795,8 @@ TEST_F(PreparedItemTest, handleTimerEvent_noParticipantList) {
     Cycles::mockTscValue = 100;
     service1->preparedOps.bufferOp(1, 13, opRef.toInteger());
     EXPECT_EQ(opRef.toInteger(), service1->preparedOps.getOp(1, 13));
-    PreparedOps::PreparedItem* item = service1->preparedOps.items[
+    PreparedOps::PreparedItem* item =
+            service1->preparedOps.getShard(1, 13)->items[
             std::make_pair<uint64_t, uint64_t>(1, 13)];
 
     TestLog::reset();
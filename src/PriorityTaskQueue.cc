@@ -103,10 +103,12 @@ PriorityTask::deschedule()
 PriorityTaskQueue::PriorityTaskQueue()
     : mutex()
     , changes()
-    , thread()
+    , threads()
     , running(true)
     , tasks(PriorityTaskQueue::entryLessThan)
     , entryPool()
+    , executing()
+    , blocked()
     , enqueuedCount()
     , doneCount()
 {
@@ -126,6 +128,10 @@ PriorityTaskQueue::~PriorityTaskQueue()
         deschedule(lock, entry->task);
         entryPool.destroy(entry);
     }
+    foreach (PriorityQueueEntry* entry, blocked) {
+        deschedule(lock, entry->task);
+        entryPool.destroy(entry);
+    }
 }
 
 /**
@@ -152,8 +158,7 @@ PriorityTaskQueue::performTask()
     if (!task)
         return;
     task->performTask();
-    ++doneCount;
-    changes.notify_all();
+    finishTask(task);
 }
 
 /**
@@ -180,8 +185,7 @@ PriorityTaskQueue::performTasksUntilHalt()
 {
     while (PriorityTask* task = getNextTask(true)) {
         task->performTask();
-        ++doneCount;
-        changes.notify_all();
+        finishTask(task);
     }
 }
 
@@ -212,7 +216,7 @@ try {
 /**
  * Notify any executing calls to performTaskUntilHalt() that they should
  * exit as soon as they finish executing any currently executing task, if
- * any. This includes the thread created by start() if it was called.
+ * any. This includes the threads created by start() if it was called.
  */
 void
 PriorityTaskQueue::halt()
@@ -220,24 +224,30 @@ PriorityTaskQueue::halt()
     Lock lock(mutex);
     running = false;
     changes.notify_all();
+    std::vector<std::unique_ptr<std::thread>> stopping;
+    stopping.swap(threads);
     lock.unlock();
-    if (thread)
+    foreach (std::unique_ptr<std::thread>& thread, stopping)
         thread->join();
-    thread.destroy();
 }
 
 /**
  * Start performing enqueued tasks in the background.
  * Calling start() on an instance that is already started has no effect.
+ *
+ * \param threadCount
+ *      Number of threads to perform tasks with. If more than one, tasks
+ *      are performed in parallel; see PriorityTaskQueue.
  */
 void
-PriorityTaskQueue::start()
+PriorityTaskQueue::start(uint32_t threadCount)
 {
     Lock _(mutex);
-    if (thread)
+    if (!threads.empty())
         return;
     running = true;
-    thread.construct(&PriorityTaskQueue::main, this);
+    for (uint32_t i = 0; i < threadCount; i++)
+        threads.emplace_back(new std::thread(&PriorityTaskQueue::main, this));
 }
 
 /**
@@ -344,15 +354,53 @@ PriorityTaskQueue::getNextTask(bool sleepIfIdle)
         if (tasks.empty())
             return NULL;
         PriorityQueueEntry* entry = tasks.top();
+        tasks.pop();
         task = entry->task;
+        if (task && (executing.find(task) != executing.end())) {
+            // Another thread is performing this task; it stays scheduled
+            // until that finishes.
+            blocked.push_back(entry);
+            task = NULL;
+            continue;
+        }
         if (task)
             task->entry = NULL;
-        tasks.pop();
         entryPool.destroy(entry);
     }
+    executing.insert(task);
     return task;
 }
 
+/**
+ * Record that a task returned by getNextTask has been performed; if it was
+ * scheduled again while it ran, it may now be performed again.
+ *
+ * \param task
+ *      The task, which may have been destroyed by now (it isn't
+ *      dereferenced).
+ */
+void
+PriorityTaskQueue::finishTask(PriorityTask* task)
+{
+    Lock _(mutex);
+    executing.erase(task);
+    ++doneCount;
+    for (size_t i = 0; i < blocked.size(); ) {
+        PriorityQueueEntry* entry = blocked[i];
+        if ((entry->task == task) || (entry->task == NULL)) {
+            if (entry->task == NULL)
+                entryPool.destroy(entry);
+            else
+                tasks.push(entry);
+            blocked[i] = blocked.back();
+            blocked.pop_back();
+        } else {
+            i++;
+        }
+    }
+    changes.notify_all();
+}
+
 /**
  * Returns true if \a left should be done LATER THAN \a right.
  * Based on the priority of the tasks and then using the order the tasks
@@ -20,7 +20,10 @@
 #include <thread>
 #include <condition_variable>
 #include <deque>
+#include <memory>
 #include <queue>
+#include <unordered_set>
+#include <vector>
 
 #include "Common.h"
 #include "ObjectPool.h"
@@ -136,9 +139,11 @@ class PriorityTask {
  * and TaskQueue instead.
  *
  * Users of PriorityTaskQueue have three choices how/when tasks get executed:
- * 1) Calling start() creates a thread which executes tasks until halt() is
- *    called. Whenever the queue is empty the thread will sleep waiting for
- *    new tasks.
+ * 1) Calling start() creates threads which execute tasks until halt() is
+ *    called. Whenever the queue is empty the threads will sleep waiting for
+ *    new tasks. With more than one thread, tasks run in parallel (so they
+ *    must synchronize any state they share), and the highest priority
+ *    tasks are started first but may finish out of order.
  * 2) Calling performTasksUntilHalt() blocks the calling thread until halt()
  *    is called. Just as above, whenever there are no tasks to perform the
  *    thread will be put to sleep.
@@ -147,6 +152,9 @@ class PriorityTask {
  *    it will return immediately. This allows the most flexibility. It allows
  *    tasks to be cooperatively scheduled with other work on the same thread
  *    or for tasks to be executed concurrently by multiple threads.
+ * However many threads execute tasks, a task is never executed by two of
+ * them at once: if it is scheduled again while it runs, it waits until it
+ * has finished.
  */
 class PriorityTaskQueue {
   PUBLIC:
@@ -156,7 +164,7 @@ class PriorityTaskQueue {
     void performTask();
     void performTasksUntilHalt();
     void main();
-    void start();
+    void start(uint32_t threadCount = 1);
     void halt();
 
     void quiesce();
@@ -170,6 +178,7 @@ class PriorityTaskQueue {
     void deschedule(Lock& lock, PriorityTask* task);
 
     PriorityTask* getNextTask(bool sleepIfIdle);
+    void finishTask(PriorityTask* task);
     typedef PriorityTask::PriorityQueueEntry PriorityQueueEntry;
     static bool entryLessThan(const PriorityQueueEntry* left,
                               const PriorityQueueEntry* right);
@@ -188,10 +197,10 @@ class PriorityTaskQueue {
     std::condition_variable changes;
 
     /**
-     * If start() is call, drives main() waiting for new tasks and performing
-     * them one-at-a-time. Exits if halt() is called.
+     * If start() is called, these drive main() waiting for new tasks and
+     * performing them. They exit if halt() is called.
      */
-    Tub<std::thread> thread;
+    std::vector<std::unique_ptr<std::thread>> threads;
 
     /// If false exit (from performTasksUntilHalt()) on the next task pop.
     bool running;
@@ -215,6 +224,15 @@ class PriorityTaskQueue {
      */
     ObjectPool<PriorityQueueEntry> entryPool;
 
+    /// Tasks currently being performed (by any thread).
+    std::unordered_set<PriorityTask*> executing;
+
+    /**
+     * Entries taken off #tasks because their task was in #executing; each
+     * goes back into #tasks once its task has finished (see finishTask).
+     */
+    std::vector<PriorityQueueEntry*> blocked;
+
     /**
      * Counts tasks that have been enqueued.
      * Has two uses:
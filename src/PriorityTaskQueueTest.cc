@@ -224,12 +224,66 @@ TEST_F(PriorityTaskQueueTest, getNextTask)
     EXPECT_FALSE(taskQueue.getNextTask(false));
     task1.schedule(PriorityTask::LOW);
     EXPECT_EQ(&task1, taskQueue.getNextTask(false));
+    taskQueue.finishTask(&task1);
     task1.schedule(PriorityTask::LOW);
     EXPECT_EQ(&task1, taskQueue.getNextTask(true));
     taskQueue.halt();
     EXPECT_FALSE(taskQueue.getNextTask(true));
 }
 
+TEST_F(PriorityTaskQueueTest, getNextTask_executing)
+{
+    // A task scheduled again while it is being performed waits until it has
+    // finished, but doesn't hold up other tasks.
+    task1.schedule(PriorityTask::HIGH);
+    EXPECT_EQ(&task1, taskQueue.getNextTask(false));
+    task1.schedule(PriorityTask::HIGH);
+    task2.schedule(PriorityTask::LOW);
+    EXPECT_EQ(&task2, taskQueue.getNextTask(false));
+    EXPECT_FALSE(taskQueue.getNextTask(false));
+    EXPECT_TRUE(task1.isScheduled());
+    EXPECT_EQ(1U, taskQueue.blocked.size());
+
+    taskQueue.finishTask(&task1);
+    EXPECT_EQ(0U, taskQueue.blocked.size());
+    EXPECT_EQ(&task1, taskQueue.getNextTask(false));
+    taskQueue.finishTask(&task1);
+    taskQueue.finishTask(&task2);
+}
+
+TEST_F(PriorityTaskQueueTest, finishTask_descheduled)
+{
+    task1.schedule(PriorityTask::NORMAL);
+    EXPECT_EQ(&task1, taskQueue.getNextTask(false));
+    task1.schedule(PriorityTask::NORMAL);
+    EXPECT_FALSE(taskQueue.getNextTask(false));
+    task1.deschedule();
+    taskQueue.finishTask(&task1);
+    EXPECT_EQ(0U, taskQueue.blocked.size());
+    EXPECT_TRUE(taskQueue.tasks.empty());
+    EXPECT_FALSE(taskQueue.getNextTask(false));
+}
+
+TEST_F(PriorityTaskQueueTest, startSeveralThreads)
+{
+    std::deque<MockTask> tasks;
+    for (int i = 0; i < 20; ++i) {
+        tasks.emplace_back(taskQueue);
+        tasks.back().schedule(PriorityTask::NORMAL);
+    }
+    taskQueue.start(4);
+    EXPECT_EQ(4U, taskQueue.threads.size());
+    for (int i = 0; i < 1000; ++i) {
+        if (taskQueue.doneCount >= 20)
+            break;
+        usleep(1000);
+    }
+    taskQueue.halt();
+    EXPECT_EQ(0U, taskQueue.threads.size());
+    foreach (MockTask& task, tasks)
+        EXPECT_EQ(1, task.count);
+}
+
 TEST_F(PriorityTaskQueueTest, getNextTaskPriorities) {
     PriorityTask::Priority priorities[] = {
         PriorityTask::LOW,
@@ -0,0 +1,192 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "Logger.h"
+#include "ProxySession.h"
+#include "ShortMacros.h"
+#include "WireFormat.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct a ProxySession.
+ *
+ * \param proxy
+ *      Session to the proxy that will forward requests.
+ * \param serviceLocator
+ *      Service locator of the server that requests are intended for.
+ */
+ProxySession::ProxySession(Transport::SessionRef proxy,
+        const string& serviceLocator)
+    : proxy(proxy)
+    , outstanding()
+    , mutex("ProxySession::mutex")
+{
+    setServiceLocator(serviceLocator);
+}
+
+/**
+ * Destructor for ProxySessions: any requests still outstanding are
+ * canceled.
+ */
+ProxySession::~ProxySession()
+{
+    std::lock_guard<SpinLock> lock(mutex);
+    for (auto it = outstanding.begin(); it != outstanding.end(); it++) {
+        proxy->cancelRequest(it->second);
+        delete it->second;
+    }
+    outstanding.clear();
+}
+
+/// \copydoc Transport::Session::abort
+void
+ProxySession::abort()
+{
+    // This fails all of the requests outstanding on the proxy session,
+    // which are all ours.
+    proxy->abort();
+}
+
+/// \copydoc Transport::Session::cancelRequest
+void
+ProxySession::cancelRequest(Transport::RpcNotifier* notifier)
+{
+    ForwardRpc* rpc = NULL;
+    {
+        std::lock_guard<SpinLock> lock(mutex);
+        auto it = outstanding.find(notifier);
+        if (it == outstanding.end())
+            return;
+        rpc = it->second;
+        outstanding.erase(it);
+    }
+    proxy->cancelRequest(rpc);
+    delete rpc;
+}
+
+/// \copydoc Transport::Session::getRpcInfo
+string
+ProxySession::getRpcInfo()
+{
+    return format("%s (forwarding to %s)", proxy->getRpcInfo().c_str(),
+            getServiceLocator().c_str());
+}
+
+/// \copydoc Transport::Session::sendRequest
+void
+ProxySession::sendRequest(Buffer* request, Buffer* response,
+        Transport::RpcNotifier* notifier)
+{
+    ForwardRpc* rpc = new ForwardRpc(this, request, response, notifier);
+    {
+        std::lock_guard<SpinLock> lock(mutex);
+        outstanding[notifier] = rpc;
+    }
+
+    // The proxy may finish the request before this returns.
+    proxy->sendRequest(&rpc->request, response, rpc);
+}
+
+/**
+ * Forget about a request that has completed, and free it.
+ *
+ * \param rpc
+ *      The request.
+ * \return
+ *      False means the request had already been canceled (so \a rpc
+ *      has already been freed, and no one should be notified).
+ */
+bool
+ProxySession::finish(ForwardRpc* rpc)
+{
+    std::lock_guard<SpinLock> lock(mutex);
+    auto it = outstanding.find(rpc->notifier);
+    if ((it == outstanding.end()) || (it->second != rpc))
+        return false;
+    outstanding.erase(it);
+    delete rpc;
+    return true;
+}
+
+/**
+ * Construct a ForwardRpc, which holds the FORWARD request for a
+ * request sent on a ProxySession.
+ *
+ * \param session
+ *      The session on which the request was sent.
+ * \param request
+ *      The caller's request; it is forwarded as is.
+ * \param response
+ *      The caller's response buffer.
+ * \param notifier
+ *      The caller's notifier.
+ */
+ProxySession::ForwardRpc::ForwardRpc(ProxySession* session, Buffer* request,
+        Buffer* response, Transport::RpcNotifier* notifier)
+    : session(session)
+    , request()
+    , response(response)
+    , notifier(notifier)
+{
+    const string& locator = session->getServiceLocator();
+    WireFormat::Forward::Request* reqHdr =
+            this->request.emplaceAppend<WireFormat::Forward::Request>();
+    reqHdr->common.opcode = WireFormat::Forward::opcode;
+    reqHdr->common.service = WireFormat::Forward::service;
+    reqHdr->locatorLength = downCast<uint16_t>(locator.size());
+    this->request.appendExternal(locator.data(), reqHdr->locatorLength);
+    this->request.appendExternal(request);
+}
+
+/**
+ * Invoked by the proxy's transport when the FORWARD response has arrived.
+ */
+void
+ProxySession::ForwardRpc::completed()
+{
+    ProxySession* owner = session;
+    Buffer* reply = response;
+    Transport::RpcNotifier* caller = notifier;
+    if (!owner->finish(this))
+        return;
+
+    const WireFormat::Forward::Response* respHdr =
+            reply->getStart<WireFormat::Forward::Response>();
+    if ((respHdr != NULL) && (respHdr->common.status == STATUS_OK)) {
+        reply->truncateFront(sizeof32(*respHdr));
+        caller->completed();
+        return;
+    }
+    RAMCLOUD_CLOG(NOTICE, "Proxy %s couldn't forward request to %s: %s",
+            owner->proxy->getServiceLocator().c_str(),
+            owner->getServiceLocator().c_str(),
+            (respHdr == NULL) ? "response too short"
+                    : statusToSymbol(respHdr->common.status));
+    caller->failed();
+}
+
+/**
+ * Invoked by the proxy's transport if the proxy couldn't be reached.
+ */
+void
+ProxySession::ForwardRpc::failed()
+{
+    Transport::RpcNotifier* caller = notifier;
+    if (session->finish(this))
+        caller->failed();
+}
+
+} // namespace RAMCloud
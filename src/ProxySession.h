@@ -0,0 +1,97 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_PROXYSESSION_H
+#define RAMCLOUD_PROXYSESSION_H
+
+#include <unordered_map>
+
+#include "SpinLock.h"
+#include "Transport.h"
+
+namespace RAMCloud {
+
+/**
+ * A ProxySession sends requests to a server by way of a proxy: another
+ * RAMCloud process (typically on the same host) that forwards them to the
+ * server over its own sessions, using the FORWARD RPC (see
+ * PingService::forward). When all of the client processes on a host use
+ * the same proxy, servers see one set of sessions from the host, rather
+ * than one for each process, which cuts the per-client connection state
+ * kept by their transports.
+ *
+ * A failure to reach either the proxy or the server is reported to the
+ * caller as a transport error, so the usual recovery (looking up the
+ * server again and retrying) applies. ProxySessions are created by the
+ * TransportManager once TransportManager::setProxy has been invoked.
+ */
+class ProxySession : public Transport::Session {
+  public:
+    ProxySession(Transport::SessionRef proxy, const string& serviceLocator);
+    ~ProxySession();
+    void abort();
+    void cancelRequest(Transport::RpcNotifier* notifier);
+    string getRpcInfo();
+    void sendRequest(Buffer* request, Buffer* response,
+            Transport::RpcNotifier* notifier);
+
+  PRIVATE:
+    /**
+     * Keeps track of one request that has been sent to the proxy but has
+     * not yet completed.
+     */
+    class ForwardRpc : public Transport::RpcNotifier {
+      public:
+        ForwardRpc(ProxySession* session, Buffer* request, Buffer* response,
+                Transport::RpcNotifier* notifier);
+        void completed();
+        void failed();
+
+        /// The session that sent the request.
+        ProxySession* session;
+
+        /// The FORWARD request sent to the proxy: its header and the
+        /// server's service locator, followed by the caller's request.
+        Buffer request;
+
+        /// The caller's response buffer; it receives the FORWARD response,
+        /// whose header is removed once the RPC completes.
+        Buffer* response;
+
+        /// The caller's notifier, which is invoked once the RPC completes.
+        Transport::RpcNotifier* notifier;
+
+        DISALLOW_COPY_AND_ASSIGN(ForwardRpc);
+    };
+
+    bool finish(ForwardRpc* rpc);
+
+    /// Session to the proxy; requests are sent on this.
+    Transport::SessionRef proxy;
+
+    /// The requests sent on this session that haven't completed or been
+    /// canceled, indexed by the caller's notifier.
+    std::unordered_map<Transport::RpcNotifier*, ForwardRpc*> outstanding;
+
+    /// Protects outstanding: completions arrive in the dispatch thread,
+    /// while requests may be sent and canceled in any thread.
+    SpinLock mutex;
+
+    DISALLOW_COPY_AND_ASSIGN(ProxySession);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_PROXYSESSION_H
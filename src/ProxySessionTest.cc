@@ -0,0 +1,122 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "MockTransport.h"
+#include "MockWrapper.h"
+#include "ProxySession.h"
+
+namespace RAMCloud {
+
+class ProxySessionTest : public ::testing::Test {
+  public:
+    Context context;
+    MockTransport transport;
+    MockWrapper rpc;
+    Tub<ProxySession> session;
+    TestLog::Enable logEnabler;
+
+    ProxySessionTest()
+        : context()
+        , transport(&context)
+        , rpc("abcdefg")
+        , session()
+        , logEnabler()
+    {
+        session.construct(transport.getSession(), "mock:host=server");
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(ProxySessionTest);
+};
+
+TEST_F(ProxySessionTest, destructor) {
+    session->sendRequest(&rpc.request, &rpc.response, &rpc);
+    EXPECT_EQ(1U, session->outstanding.size());
+    transport.clearOutput();
+    session.destroy();
+    EXPECT_EQ("cancel: ", transport.outputLog);
+    EXPECT_STREQ("completed: 0, failed: 0", rpc.getState());
+}
+
+TEST_F(ProxySessionTest, abort) {
+    session->abort();
+    EXPECT_EQ("abort: ", transport.outputLog);
+}
+
+TEST_F(ProxySessionTest, cancelRequest) {
+    session->sendRequest(&rpc.request, &rpc.response, &rpc);
+    transport.clearOutput();
+    session->cancelRequest(&rpc);
+    EXPECT_EQ("cancel: ", transport.outputLog);
+    EXPECT_EQ(0U, session->outstanding.size());
+
+    // Canceling again (or canceling an unknown request) does nothing.
+    transport.clearOutput();
+    session->cancelRequest(&rpc);
+    EXPECT_EQ("", transport.outputLog);
+}
+
+TEST_F(ProxySessionTest, getRpcInfo) {
+    EXPECT_EQ("dummy RPC info for MockTransport (forwarding to "
+            "mock:host=server)", session->getRpcInfo());
+}
+
+TEST_F(ProxySessionTest, sendRequest_requestFormat) {
+    session->sendRequest(&rpc.request, &rpc.response, &rpc);
+    ASSERT_EQ(1U, transport.output.size());
+    Buffer* sent = &transport.output[0].second;
+    const WireFormat::Forward::Request* reqHdr =
+            sent->getStart<WireFormat::Forward::Request>();
+    ASSERT_TRUE(reqHdr != NULL);
+    EXPECT_EQ(WireFormat::FORWARD, reqHdr->common.opcode);
+    EXPECT_EQ(WireFormat::PING_SERVICE, reqHdr->common.service);
+    EXPECT_EQ(16U, reqHdr->locatorLength);
+    EXPECT_EQ("mock:host=serverabcdefg", TestUtil::toString(sent,
+            sizeof32(*reqHdr), sent->size() - sizeof32(*reqHdr)));
+}
+
+TEST_F(ProxySessionTest, forwardRpc_completed) {
+    transport.setInput("0 xyz");
+    session->sendRequest(&rpc.request, &rpc.response, &rpc);
+    EXPECT_STREQ("completed: 1, failed: 0", rpc.getState());
+    EXPECT_EQ("xyz/0", TestUtil::toString(&rpc.response));
+    EXPECT_EQ(0U, session->outstanding.size());
+}
+
+TEST_F(ProxySessionTest, forwardRpc_completed_forwardFailed) {
+    transport.setInput("11");
+    session->sendRequest(&rpc.request, &rpc.response, &rpc);
+    EXPECT_STREQ("completed: 0, failed: 1", rpc.getState());
+    EXPECT_EQ("completed: Proxy test: couldn't forward request to "
+            "mock:host=server: STATUS_COULDNT_CONNECT", TestLog::get());
+    EXPECT_EQ(0U, session->outstanding.size());
+}
+
+TEST_F(ProxySessionTest, forwardRpc_completed_responseTooShort) {
+    transport.setInput("");
+    session->sendRequest(&rpc.request, &rpc.response, &rpc);
+    EXPECT_STREQ("completed: 0, failed: 1", rpc.getState());
+    EXPECT_EQ("completed: Proxy test: couldn't forward request to "
+            "mock:host=server: response too short", TestLog::get());
+}
+
+TEST_F(ProxySessionTest, forwardRpc_failed) {
+    transport.setInput(NULL);
+    session->sendRequest(&rpc.request, &rpc.response, &rpc);
+    EXPECT_STREQ("completed: 0, failed: 1", rpc.getState());
+    EXPECT_EQ(0U, session->outstanding.size());
+}
+
+}  // namespace RAMCloud
@@ -16,16 +16,21 @@
 #include <stdarg.h>
 
 #include "RamCloud.h"
+#include "ClientDispatchThread.h"
 #include "ClientLeaseAgent.h"
+#include "ClientReadCache.h"
 #include "ClientTransactionManager.h"
 #include "CoordinatorSession.h"
 #include "Dispatch.h"
 #include "LinearizableObjectRpcWrapper.h"
+#include "Lz4.h"
 #include "FailSession.h"
+#include "HedgedReader.h"
 #include "MasterClient.h"
 #include "MultiIncrement.h"
 #include "MultiRead.h"
 #include "MultiRemove.h"
+#include "MultiUpdate.h"
 #include "MultiWrite.h"
 #include "Object.h"
 #include "ObjectFinder.h"
@@ -33,6 +38,7 @@
 #include "RpcTracker.h"
 #include "ShortMacros.h"
 #include "TimeTrace.h"
+#include "TransportManager.h"
 
 namespace RAMCloud {
 
@@ -70,11 +76,14 @@ static RejectRules defaultRejectRules;
 RamCloud::RamCloud(const char* locator, const char* clusterName)
     : coordinatorLocator(locator)
     , realClientContext(new Context(false))
+    , dispatchThread(NULL)
     , clientContext(realClientContext)
     , status(STATUS_OK)
     , clientLeaseAgent(new ClientLeaseAgent(this))
     , rpcTracker(new RpcTracker())
     , transactionManager(new ClientTransactionManager())
+    , readCache(NULL)
+    , hedgedReader(NULL)
 {
     clientContext->coordinatorSession->setLocation(locator, clusterName);
 }
@@ -88,27 +97,64 @@ RamCloud::RamCloud(Context* context, const char* locator,
         const char* clusterName)
     : coordinatorLocator(locator)
     , realClientContext(NULL)
+    , dispatchThread(NULL)
     , clientContext(context)
     , status(STATUS_OK)
     , clientLeaseAgent(new ClientLeaseAgent(this))
     , rpcTracker(new RpcTracker())
     , transactionManager(new ClientTransactionManager())
+    , readCache(NULL)
+    , hedgedReader(NULL)
 {
     clientContext->coordinatorSession->setLocation(locator, clusterName);
 }
 
+/**
+ * Construct a RamCloud for use by one thread of a multi-threaded client.
+ * The new object shares the context of an existing one, and with it the
+ * cached table configuration and the sessions to servers, but has its own
+ * lease, RPC tracker, and transactions, so that threads don't contend on
+ * them.
+ *
+ * \param shared
+ *      The RamCloud object for the cluster; #enableMultiThreading must have
+ *      been invoked on it, and it must outlive the new object.
+ */
+RamCloud::RamCloud(RamCloud* shared)
+    : coordinatorLocator(shared->coordinatorLocator)
+    , realClientContext(NULL)
+    , dispatchThread(NULL)
+    , clientContext(shared->clientContext)
+    , status(STATUS_OK)
+    , clientLeaseAgent(new ClientLeaseAgent(this))
+    , rpcTracker(new RpcTracker())
+    , transactionManager(new ClientTransactionManager())
+    , readCache(NULL)
+    , hedgedReader(NULL)
+{
+    assert(shared->dispatchThread != NULL);
+}
+
 /**
  * Destructor of Ramcloud
  **/
 
 RamCloud::~RamCloud()
 {
+    // Stop polling before anything that the dispatcher may refer to goes
+    // away.
+    delete dispatchThread;
+
     delete clientLeaseAgent;
 
     delete rpcTracker;
     delete realClientContext;
 
     delete transactionManager;
+
+    delete readCache;
+
+    delete hedgedReader;
 }
 
 /**
@@ -129,6 +175,307 @@ RamCloud::poll()
         clientContext->dispatch->poll();
 }
 
+/**
+ * Atomically append bytes to the value of an object. If the object does
+ * not exist, it is created with the given bytes as its value. The object's
+ * keys are unchanged.
+ *
+ * \param tableId
+ *      The table containing the desired object (return value from
+ *      a previous call to getTableId).
+ * \param key
+ *      Variable length key that uniquely identifies the object within tableId.
+ *      It does not necessarily have to be null terminated.  The caller must
+ *      ensure that the storage for this key is unchanged through the life of
+ *      the RPC.
+ * \param keyLength
+ *      Size in bytes of the key.
+ * \param buf
+ *      The bytes to append to the object's value.
+ * \param length
+ *      Size in bytes of \a buf.
+ * \param rejectRules
+ *      If non-NULL, specifies conditions under which the append
+ *      should be aborted with an error.
+ * \param[out] version
+ *      If non-NULL, the version number of the object is returned here.
+ *
+ * \return
+ *      The length of the object's value after the append.
+ *
+ * \exception RequestTooLargeException
+ *      The object would be larger than the largest allowed.
+ */
+uint32_t
+RamCloud::append(uint64_t tableId, const void* key, uint16_t keyLength,
+        const void* buf, uint32_t length, const RejectRules* rejectRules,
+        uint64_t* version)
+{
+    if (readCache != NULL)
+        readCache->invalidate(tableId, key, keyLength);
+    AppendRpc rpc(this, tableId, key, keyLength, buf, length, rejectRules);
+    return rpc.wait(version);
+}
+
+/**
+ * Constructor for AppendRpc: initiates an RPC in the same way as
+ * #RamCloud::append, but returns once the RPC has been initiated,
+ * without waiting for it to complete.
+ *
+ * \param ramcloud
+ *      The RAMCloud object that governs this RPC.
+ * \param tableId
+ *      The table containing the desired object (return value from
+ *      a previous call to getTableId).
+ * \param key
+ *      Variable length key that uniquely identifies the object within tableId.
+ *      It does not necessarily have to be null terminated.  The caller must
+ *      ensure that the storage for this key is unchanged through the life of
+ *      the RPC.
+ * \param keyLength
+ *      Size in bytes of the key.
+ * \param buf
+ *      The bytes to append to the object's value.
+ * \param length
+ *      Size in bytes of \a buf.
+ * \param rejectRules
+ *      If non-NULL, specifies conditions under which the append
+ *      should be aborted with an error.
+ */
+AppendRpc::AppendRpc(RamCloud* ramcloud, uint64_t tableId,
+        const void* key, uint16_t keyLength, const void* buf,
+        uint32_t length, const RejectRules* rejectRules)
+    : LinearizableObjectRpcWrapper(ramcloud, true, tableId, key, keyLength,
+            sizeof(WireFormat::Append::Response))
+{
+    WireFormat::Append::Request* reqHdr(allocHeader<WireFormat::Append>());
+    reqHdr->tableId = tableId;
+    reqHdr->keyLength = keyLength;
+    reqHdr->length = length;
+    reqHdr->rejectRules = rejectRules ? *rejectRules : defaultRejectRules;
+    request.append(key, keyLength);
+    request.append(buf, length);
+    fillLinearizabilityHeader<WireFormat::Append::Request>(reqHdr);
+    send();
+}
+
+/**
+ * Wait for an append RPC to complete, and return the same results as
+ * #RamCloud::append.
+ *
+ * \param[out] version
+ *      If non-NULL, the current version number of the object is
+ *      returned here.
+ */
+uint32_t
+AppendRpc::wait(uint64_t* version)
+{
+    waitInternal(context->dispatch);
+    const WireFormat::Append::Response* respHdr(
+            getResponseHeader<WireFormat::Append>());
+    if (version != NULL)
+        *version = respHdr->version;
+
+    if (respHdr->common.status != STATUS_OK)
+        ClientException::throwException(HERE, respHdr->common.status);
+    return respHdr->newLength;
+}
+
+/**
+ * Constructor for CommitWriteRpc: writes an object whose value was sent
+ * earlier with WriteFragmentRpcs, once the master has checked that it has
+ * received the whole value. Returns once the RPC has been initiated,
+ * without waiting for it to complete.
+ *
+ * \param ramcloud
+ *      The RAMCloud object that governs this RPC.
+ * \param tableId
+ *      The table containing the desired object (return value from
+ *      a previous call to getTableId).
+ * \param key
+ *      Variable length key that uniquely identifies the object within tableId.
+ *      It does not necessarily have to be null terminated.
+ * \param keyLength
+ *      Size in bytes of the key.
+ * \param streamId
+ *      The identifier used in the WriteFragmentRpcs for the value.
+ * \param valueLength
+ *      Total size in bytes of the value.
+ * \param checksum
+ *      Crc32C of the whole value.
+ * \param rejectRules
+ *      If non-NULL, specifies conditions under which the write
+ *      should be aborted with an error.
+ */
+CommitWriteRpc::CommitWriteRpc(RamCloud* ramcloud, uint64_t tableId,
+        const void* key, uint16_t keyLength, uint64_t streamId,
+        uint32_t valueLength, uint32_t checksum,
+        const RejectRules* rejectRules)
+    : LinearizableObjectRpcWrapper(ramcloud, true, tableId, key, keyLength,
+            sizeof(WireFormat::CommitWrite::Response))
+{
+    WireFormat::CommitWrite::Request* reqHdr(
+            allocHeader<WireFormat::CommitWrite>());
+    reqHdr->tableId = tableId;
+    reqHdr->streamId = streamId;
+    reqHdr->valueLength = valueLength;
+    reqHdr->checksum = checksum;
+    reqHdr->rejectRules = rejectRules ? *rejectRules : defaultRejectRules;
+    reqHdr->keyLength = keyLength;
+    reqHdr->keyHash = keyHash;
+    request.appendCopy(key, keyLength);
+    fillLinearizabilityHeader<WireFormat::CommitWrite::Request>(reqHdr);
+    send();
+}
+
+/**
+ * Wait for a CommitWriteRpc to complete.
+ *
+ * \param[out] version
+ *      If non-NULL, the version number of the new object is returned
+ *      here.
+ *
+ * \exception InvalidParameterException
+ *      The master doesn't have the whole value (for example, because a
+ *      fragment was lost when the master crashed, or the stream expired),
+ *      or the value doesn't match the checksum. The write must be
+ *      started over.
+ */
+void
+CommitWriteRpc::wait(uint64_t* version)
+{
+    waitInternal(context->dispatch);
+    const WireFormat::CommitWrite::Response* respHdr(
+            getResponseHeader<WireFormat::CommitWrite>());
+    if (version != NULL)
+        *version = respHdr->version;
+
+    if (respHdr->common.status != STATUS_OK)
+        ClientException::throwException(HERE, respHdr->common.status);
+}
+
+/**
+ * Atomically replace some bytes in the value of an object if they are
+ * equal to given bytes (a compare-and-swap on part of the object). The
+ * object's keys are unchanged.
+ *
+ * \param tableId
+ *      The table containing the desired object (return value from
+ *      a previous call to getTableId).
+ * \param key
+ *      Variable length key that uniquely identifies the object within tableId.
+ *      It does not necessarily have to be null terminated.  The caller must
+ *      ensure that the storage for this key is unchanged through the life of
+ *      the RPC.
+ * \param keyLength
+ *      Size in bytes of the key.
+ * \param offset
+ *      Offset in the object's value of the bytes to compare and replace.
+ * \param expected
+ *      The bytes expected at \a offset.
+ * \param newValue
+ *      The bytes to store at \a offset if they match.
+ * \param length
+ *      Size in bytes of \a expected and \a newValue.
+ * \param rejectRules
+ *      If non-NULL, specifies conditions under which the update
+ *      should be aborted with an error.
+ * \param[out] version
+ *      If non-NULL, the version number of the object is returned here
+ *      (the new version if it was updated).
+ *
+ * \return
+ *      True if the object was updated; false if its bytes at \a offset
+ *      weren't equal to \a expected (or it's too short to hold them).
+ *
+ * \exception ObjectDoesntExistException
+ *      The object doesn't exist.
+ */
+bool
+RamCloud::conditionalUpdate(uint64_t tableId, const void* key,
+        uint16_t keyLength, uint32_t offset, const void* expected,
+        const void* newValue, uint32_t length, const RejectRules* rejectRules,
+        uint64_t* version)
+{
+    if (readCache != NULL)
+        readCache->invalidate(tableId, key, keyLength);
+    ConditionalUpdateRpc rpc(this, tableId, key, keyLength, offset, expected,
+            newValue, length, rejectRules);
+    return rpc.wait(version);
+}
+
+/**
+ * Constructor for ConditionalUpdateRpc: initiates an RPC in the same way as
+ * #RamCloud::conditionalUpdate, but returns once the RPC has been initiated,
+ * without waiting for it to complete.
+ *
+ * \param ramcloud
+ *      The RAMCloud object that governs this RPC.
+ * \param tableId
+ *      The table containing the desired object (return value from
+ *      a previous call to getTableId).
+ * \param key
+ *      Variable length key that uniquely identifies the object within tableId.
+ *      It does not necessarily have to be null terminated.  The caller must
+ *      ensure that the storage for this key is unchanged through the life of
+ *      the RPC.
+ * \param keyLength
+ *      Size in bytes of the key.
+ * \param offset
+ *      Offset in the object's value of the bytes to compare and replace.
+ * \param expected
+ *      The bytes expected at \a offset.
+ * \param newValue
+ *      The bytes to store at \a offset if they match.
+ * \param length
+ *      Size in bytes of \a expected and \a newValue.
+ * \param rejectRules
+ *      If non-NULL, specifies conditions under which the update
+ *      should be aborted with an error.
+ */
+ConditionalUpdateRpc::ConditionalUpdateRpc(RamCloud* ramcloud,
+        uint64_t tableId, const void* key, uint16_t keyLength,
+        uint32_t offset, const void* expected, const void* newValue,
+        uint32_t length, const RejectRules* rejectRules)
+    : LinearizableObjectRpcWrapper(ramcloud, true, tableId, key, keyLength,
+            sizeof(WireFormat::ConditionalUpdate::Response))
+{
+    WireFormat::ConditionalUpdate::Request* reqHdr(
+            allocHeader<WireFormat::ConditionalUpdate>());
+    reqHdr->tableId = tableId;
+    reqHdr->keyLength = keyLength;
+    reqHdr->offset = offset;
+    reqHdr->length = length;
+    reqHdr->rejectRules = rejectRules ? *rejectRules : defaultRejectRules;
+    request.append(key, keyLength);
+    request.append(expected, length);
+    request.append(newValue, length);
+    fillLinearizabilityHeader<WireFormat::ConditionalUpdate::Request>(reqHdr);
+    send();
+}
+
+/**
+ * Wait for a conditionalUpdate RPC to complete, and return the same results
+ * as #RamCloud::conditionalUpdate.
+ *
+ * \param[out] version
+ *      If non-NULL, the current version number of the object is
+ *      returned here.
+ */
+bool
+ConditionalUpdateRpc::wait(uint64_t* version)
+{
+    waitInternal(context->dispatch);
+    const WireFormat::ConditionalUpdate::Response* respHdr(
+            getResponseHeader<WireFormat::ConditionalUpdate>());
+    if (version != NULL)
+        *version = respHdr->version;
+
+    if (respHdr->common.status != STATUS_OK)
+        ClientException::throwException(HERE, respHdr->common.status);
+    return respHdr->updated != 0;
+}
+
 /**
  * Split an indexlet into two disjoint indexlets at a specific key.
  * Check if the split already exists, in which case, just return.
@@ -199,6 +546,193 @@ CoordSplitAndMigrateIndexletRpc::CoordSplitAndMigrateIndexletRpc(
     send();
 }
 
+/**
+ * Count the index entries whose keys fall in a given range, without
+ * retrieving their primary key hashes or objects. The counting is done by
+ * the index servers, one indexlet at a time, so only a few bytes are
+ * transferred no matter how large the range is.
+ *
+ * \param tableId
+ *      Id of the table whose index is to be used.
+ * \param indexId
+ *      Id of the index to be used. Must be greater than 0.
+ * \param firstKey
+ *      Starting key for the key range in which keys are to be counted.
+ *      The key range includes the firstKey.
+ *      It does not necessarily have to be null terminated.
+ * \param firstKeyLength
+ *      Length in bytes of the firstKey.
+ * \param lastKey
+ *      Ending key for the key range in which keys are to be counted.
+ *      The key range includes the lastKey. For an IndexKey::HASH_INDEX
+ *      index, this must be the same as firstKey.
+ *      It does not necessarily have to be null terminated.
+ * \param lastKeyLength
+ *      Length in bytes of the lastKey.
+ * \param[out] minKey
+ *      If non-NULL and the count is nonzero, this buffer is set to the
+ *      smallest key in the range.
+ * \param[out] maxKey
+ *      If non-NULL and the count is nonzero, this buffer is set to the
+ *      largest key in the range.
+ *
+ * \return
+ *      The number of index entries with keys in [firstKey, lastKey].
+ */
+uint64_t
+RamCloud::countIndexKeys(uint64_t tableId, uint8_t indexId,
+        const void* firstKey, uint16_t firstKeyLength,
+        const void* lastKey, uint16_t lastKeyLength,
+        Buffer* minKey, Buffer* maxKey)
+{
+    uint64_t total = 0;
+    string nextKey;
+    const void* key = firstKey;
+    uint16_t keyLength = firstKeyLength;
+    uint64_t keyHash = 0;
+
+    while (true) {
+        Buffer response;
+        uint64_t count;
+        uint16_t minKeyLength, maxKeyLength, nextKeyLength;
+        uint64_t nextKeyHash;
+        {
+            CountIndexKeysRpc rpc(this, tableId, indexId, key, keyLength,
+                    keyHash, lastKey, lastKeyLength, &response);
+            rpc.wait(&count, &minKeyLength, &maxKeyLength, &nextKeyLength,
+                    &nextKeyHash);
+        }
+
+        uint32_t offset = sizeof32(WireFormat::CountIndexKeys::Response);
+        if (count > 0) {
+            if (minKey != NULL && total == 0) {
+                minKey->reset();
+                minKey->appendCopy(response.getRange(offset, minKeyLength),
+                        minKeyLength);
+            }
+            if (maxKey != NULL) {
+                maxKey->reset();
+                maxKey->appendCopy(response.getRange(offset + minKeyLength,
+                        maxKeyLength), maxKeyLength);
+            }
+            offset += minKeyLength + maxKeyLength;
+        }
+        total += count;
+
+        if (nextKeyLength == 0)
+            break;
+        nextKey.assign(static_cast<const char*>(
+                response.getRange(offset, nextKeyLength)), nextKeyLength);
+        key = nextKey.data();
+        keyLength = nextKeyLength;
+        keyHash = nextKeyHash;
+    }
+    return total;
+}
+
+/**
+ * Constructor for CountIndexKeysRpc: sends a single COUNT_INDEX_KEYS
+ * request to the server owning the indexlet that contains firstKey, and
+ * returns once the RPC has been initiated, without waiting for it to
+ * complete. RamCloud::countIndexKeys continues with further requests as
+ * long as the response names a next key.
+ *
+ * \param ramcloud
+ *      The RAMCloud object that governs this RPC.
+ * \param tableId
+ *      Id of the table whose index is to be used.
+ * \param indexId
+ *      Id of the index to be used. Must be greater than 0.
+ * \param firstKey
+ *      Starting key for the key range in which keys are to be counted.
+ *      The caller must ensure that the storage for this key is unchanged
+ *      through the life of the RPC.
+ * \param firstKeyLength
+ *      Length in bytes of the firstKey.
+ * \param firstAllowedKeyHash
+ *      Smallest primary key hash value allowed for firstKey.
+ * \param lastKey
+ *      Ending key for the key range in which keys are to be counted.
+ *      The caller must ensure that the storage for this key is unchanged
+ *      through the life of the RPC.
+ * \param lastKeyLength
+ *      Length in bytes of the lastKey.
+ * \param[out] responseBuffer
+ *      Response buffer returned on wait(); see
+ *      WireFormat::CountIndexKeys::Response for its contents.
+ */
+CountIndexKeysRpc::CountIndexKeysRpc(
+        RamCloud* ramcloud, uint64_t tableId, uint8_t indexId,
+        const void* firstKey, uint16_t firstKeyLength,
+        uint64_t firstAllowedKeyHash,
+        const void* lastKey, uint16_t lastKeyLength,
+        Buffer* responseBuffer)
+    : IndexRpcWrapper(ramcloud, tableId, indexId, firstKey, firstKeyLength,
+            sizeof(WireFormat::CountIndexKeys::Response), responseBuffer)
+{
+    WireFormat::CountIndexKeys::Request* reqHdr(
+            allocHeader<WireFormat::CountIndexKeys>());
+    reqHdr->tableId = tableId;
+    reqHdr->indexId = indexId;
+    reqHdr->firstKeyLength = firstKeyLength;
+    reqHdr->firstAllowedKeyHash = firstAllowedKeyHash;
+    reqHdr->lastKeyLength = lastKeyLength;
+    request.append(firstKey, firstKeyLength);
+    request.append(lastKey, lastKeyLength);
+    send();
+}
+
+/**
+ * Handle the case where the RPC cannot be completed as the indexlet containing
+ * the key(s) was not found.
+ */
+void
+CountIndexKeysRpc::indexletNotFound()
+{
+    response->reset();
+    WireFormat::CountIndexKeys::Response* respHdr =
+            response->emplaceAppend<WireFormat::CountIndexKeys::Response>();
+    respHdr->common.status = STATUS_OK;
+    respHdr->count = 0;
+    respHdr->minKeyLength = 0;
+    respHdr->maxKeyLength = 0;
+    respHdr->nextKeyLength = 0;
+    respHdr->nextKeyHash = 0;
+}
+
+/**
+ * Wait for a COUNT_INDEX_KEYS request to complete.
+ *
+ * \param[out] count
+ *      Number of entries counted by this request.
+ * \param[out] minKeyLength
+ *      Length of the smallest key counted (the first key in the response
+ *      buffer, if count is nonzero).
+ * \param[out] maxKeyLength
+ *      Length of the largest key counted (the second key in the response
+ *      buffer, if count is nonzero).
+ * \param[out] nextKeyLength
+ *      Length of the next key to count (the last key in the response
+ *      buffer), or 0 if the range has been counted completely.
+ * \param[out] nextKeyHash
+ *      Smallest primary key hash allowed for the next key to count.
+ */
+void
+CountIndexKeysRpc::wait(uint64_t* count, uint16_t* minKeyLength,
+        uint16_t* maxKeyLength, uint16_t* nextKeyLength,
+        uint64_t* nextKeyHash)
+{
+    simpleWait(context);
+
+    const WireFormat::CountIndexKeys::Response* respHdr(
+            getResponseHeader<WireFormat::CountIndexKeys>());
+    *count = respHdr->count;
+    *minKeyLength = respHdr->minKeyLength;
+    *maxKeyLength = respHdr->maxKeyLength;
+    *nextKeyLength = respHdr->nextKeyLength;
+    *nextKeyHash = respHdr->nextKeyHash;
+}
+
 /**
  * Create a new table.
  *
@@ -322,12 +856,14 @@ DropTableRpc::DropTableRpc(RamCloud* ramcloud, const char* name)
  * \param tableId
  *      Id of the table to which the index belongs.
  * \param indexId
- *      Id of the secondary keys corresponding to this index.
- *      Must be greater than 0. Id 0 is reserved for "primary key".
+ *      Id of the secondary keys corresponding to this index, which is
+ *      greater than 0; or 0 for an index on the primary keys. A primary key
+ *      index keeps the table's primary keys in order, so IndexLookup can
+ *      scan ranges of them (it must be IndexKey::BTREE_INDEX).
  * \param indexType
- *      Type of the keys corresponding to this index.
- *      Currently only string keys are supported, so this parameter is not yet
- *      used (i.e., caller can provide any value).
+ *      How entries of the index are stored: IndexKey::BTREE_INDEX or
+ *      IndexKey::HASH_INDEX. Hash indexes answer equality lookups with a
+ *      single hash table probe, but don't support range lookups.
  * \param numIndexlets
  *      Number of indexlets to partition the index key space.
  *      This is only for performance testing and unit tests.
@@ -351,12 +887,12 @@ RamCloud::createIndex(uint64_t tableId, uint8_t indexId, uint8_t indexType,
  * \param tableId
  *      Id of the table to which the index belongs.
  * \param indexId
- *      Id of the secondary keys corresponding to this index.
- *      Must be greater than 0. Id 0 is reserved for "primary key".
+ *      Id of the secondary keys corresponding to this index, or 0 for the
+ *      index on the primary keys (see createIndex).
  * \param indexType
- *      Type of the keys corresponding to this index.
- *      Currently only string keys are supported, so this parameter is not yet
- *      used (i.e., caller can provide any value).
+ *      How entries of the index are stored: IndexKey::BTREE_INDEX or
+ *      IndexKey::HASH_INDEX. Hash indexes answer equality lookups with a
+ *      single hash table probe, but don't support range lookups.
  * \param numIndexlets
  *      Number of indexlets to partition the index key space.
  *      This is only for performance testing, and value should always be 1 for
@@ -391,8 +927,8 @@ CreateIndexRpc::CreateIndexRpc(RamCloud* ramcloud, uint64_t tableId,
  * \param tableId
  *      Id of the table to which the index belongs.
  * \param indexId
- *      Id of the secondary keys corresponding to this index.
- *      Must be greater than 0. Id 0 is reserved for "primary key".
+ *      Id of the secondary keys corresponding to this index, or 0 for the
+ *      index on the primary keys (see createIndex).
  */
 void
 RamCloud::dropIndex(uint64_t tableId, uint8_t indexId)
@@ -411,8 +947,8 @@ RamCloud::dropIndex(uint64_t tableId, uint8_t indexId)
  * \param tableId
  *      Id of the table to which the index belongs
  * \param indexId
- *      Id of the secondary keys corresponding to this index.
- *      Must be greater than 0. Id 0 is reserved for "primary key".
+ *      Id of the secondary keys corresponding to this index, or 0 for the
+ *      index on the primary keys (see createIndex).
  */
 DropIndexRpc::DropIndexRpc(RamCloud* ramcloud, uint64_t tableId,
         uint8_t indexId)
@@ -426,6 +962,97 @@ DropIndexRpc::DropIndexRpc(RamCloud* ramcloud, uint64_t tableId,
     send();
 }
 
+/**
+ * Hedge the reads of a table that this RamCloud object issues: a read that
+ * its master hasn't answered within the usual time (the 95th percentile of
+ * recent reads) is also sent to the read replica of its tablet, if it has
+ * one, and whichever answers first is returned (see HedgedReader and
+ * #setReadReplica). Reads with reject rules always go to the master only.
+ * Once this has been invoked, a read of the table may return a value up to
+ * \a maxStalenessMicros old.
+ *
+ * \param tableId
+ *      The table whose reads are hedged (return value from a previous call
+ *      to getTableId).
+ * \param maxStalenessMicros
+ *      How far (in microseconds) a replica may lag behind the master and
+ *      still answer a read.
+ */
+void
+RamCloud::enableHedgedReads(uint64_t tableId, uint32_t maxStalenessMicros)
+{
+    if (hedgedReader == NULL)
+        hedgedReader = new HedgedReader(this);
+    hedgedReader->enable(tableId, maxStalenessMicros);
+}
+
+/**
+ * Allow several threads to use this cluster at once. A separate thread is
+ * started to poll the dispatcher, and sessions to servers are reopened so
+ * that any thread can send requests on them. Each application thread should
+ * then construct its own RamCloud object from this one (see
+ * RamCloud(RamCloud*)) and issue its requests through that; the objects
+ * share sessions and the cached table configuration. This object should
+ * not be used for RPCs after this call except by a single thread.
+ *
+ * Must be invoked before any other threads use this object.
+ */
+void
+RamCloud::enableMultiThreading()
+{
+    if (dispatchThread != NULL)
+        return;
+    clientContext->transportManager->setMultiThreaded();
+    clientContext->objectFinder->reset();
+    clientContext->coordinatorSession->flush();
+    clientContext->coordinatorSession->flushReadSession();
+    dispatchThread = new ClientDispatchThread(clientContext);
+}
+
+/**
+ * Cache the objects read by this RamCloud object, so that repeated reads
+ * of the same objects needn't go to their masters (see ClientReadCache).
+ * Reads with reject rules always go to the master. Once this has been
+ * invoked, a read may return a value up to a lease old, unless the object
+ * was modified through this RamCloud object, which invalidates it.
+ *
+ * \param maxBytes
+ *      The most bytes of keys and values to cache.
+ * \param leaseMicros
+ *      How long (in microseconds) a value may be returned from the cache
+ *      before asking its master whether it has changed.
+ */
+void
+RamCloud::enableReadCache(uint64_t maxBytes, uint32_t leaseMicros)
+{
+    delete readCache;
+    readCache = new ClientReadCache(this, maxBytes, leaseMicros);
+}
+
+/**
+ * Send this client's requests through a proxy: a RAMCloud server
+ * (normally on the same host, running only the ping service) that
+ * forwards them to their servers over its own sessions. When all of the
+ * client processes on a host use the same proxy, the servers keep session
+ * state for the host rather than for each process. Each request makes an
+ * extra hop through the proxy.
+ *
+ * Must be invoked before any other threads use this object; RamCloud
+ * objects sharing its context (see RamCloud(RamCloud*)) use the proxy too.
+ *
+ * \param proxyLocator
+ *      Service locator of the proxy; an empty string means send requests
+ *      directly again.
+ */
+void
+RamCloud::enableProxy(const char* proxyLocator)
+{
+    clientContext->transportManager->setProxy(proxyLocator);
+    clientContext->objectFinder->reset();
+    clientContext->coordinatorSession->flush();
+    clientContext->coordinatorSession->flushReadSession();
+}
+
 /**
  * This method provides the core of table enumeration. It is invoked
  * repeatedly to enumerate a table; each invocation returns the next
@@ -463,6 +1090,9 @@ DropIndexRpc::DropIndexRpc(RamCloud* ramcloud, uint64_t tableId,
  *      tablet. When this happens, the return value will be set to
  *      point to the next tablet, or will be set to zero if this is
  *      the end of the entire table.
+ * \param filter
+ *      If non-NULL, only the objects that match this filter are returned,
+ *      with just the part of their values that it selects.
  *
  * \return
  *       The return value is a key hash indicating where to continue
@@ -474,10 +1104,11 @@ DropIndexRpc::DropIndexRpc(RamCloud* ramcloud, uint64_t tableId,
  */
 uint64_t
 RamCloud::enumerateTable(uint64_t tableId, bool keysOnly,
-        uint64_t tabletFirstHash, Buffer& state, Buffer& objects)
+        uint64_t tabletFirstHash, Buffer& state, Buffer& objects,
+        const ObjectFilter* filter)
 {
     EnumerateTableRpc rpc(this, tableId, keysOnly,
-                            tabletFirstHash, state, objects);
+                            tabletFirstHash, state, objects, filter);
     return rpc.wait(state);
 }
 
@@ -510,9 +1141,14 @@ RamCloud::enumerateTable(uint64_t tableId, bool keysOnly,
  * \param[out] objects
  *      After a successful return, this buffer will contain zero or
  *      more objects from the requested tablet.
+ * \param filter
+ *      If non-NULL, only the objects that match this filter are returned,
+ *      with just the part of their values that it selects. It is copied
+ *      into the request, so it needn't outlive this call.
  */
 EnumerateTableRpc::EnumerateTableRpc(RamCloud* ramcloud, uint64_t tableId,
-        bool keysOnly, uint64_t tabletFirstHash, Buffer& state, Buffer& objects)
+        bool keysOnly, uint64_t tabletFirstHash, Buffer& state, Buffer& objects,
+        const ObjectFilter* filter)
     : ObjectRpcWrapper(ramcloud->clientContext, tableId, tabletFirstHash,
             sizeof(WireFormat::Enumerate::Response), &objects)
 {
@@ -524,6 +1160,8 @@ EnumerateTableRpc::EnumerateTableRpc(RamCloud* ramcloud, uint64_t tableId,
     reqHdr->iteratorBytes = state.size();
     for (Buffer::Iterator it(&state); !it.isDone(); it.next())
         request.append(it.getData(), it.getLength());
+    if (filter != NULL)
+        reqHdr->filterBytes = filter->serialize(&request);
     send();
 }
 
@@ -1060,6 +1698,8 @@ RamCloud::incrementDouble(uint64_t tableId, const void* key, uint16_t keyLength,
         double incrementValue, const RejectRules* rejectRules,
         uint64_t* version)
 {
+    if (readCache != NULL)
+        readCache->invalidate(tableId, key, keyLength);
     IncrementDoubleRpc rpc(this, tableId, key, keyLength, incrementValue,
             rejectRules);
     return rpc.wait(version);
@@ -1164,6 +1804,8 @@ RamCloud::incrementInt64(uint64_t tableId, const void* key, uint16_t keyLength,
         int64_t incrementValue, const RejectRules* rejectRules,
         uint64_t* version)
 {
+    if (readCache != NULL)
+        readCache->invalidate(tableId, key, keyLength);
     IncrementInt64Rpc rpc(this, tableId, key, keyLength, incrementValue,
             rejectRules);
     return rpc.wait(version);
@@ -1362,7 +2004,7 @@ ReadHashesRpc::wait(uint32_t* numObjects)
  *      server that will handle this operation.
  * \param indexId
  *      Id of an index within tableId.
- *      Must be greater than 0. Id 0 is reserved for "primary key".
+ *      Id 0 is the index on the primary keys, if the table has one.
  * \param key
  *      Secondary key within the index given by tableId and indexId. The
  *      request will be sent to the server responsible for this key in the
@@ -1404,7 +2046,7 @@ RamCloud::indexServerControl(uint64_t tableId, uint8_t indexId,
  *      server that will handle this operation.
  * \param indexId
  *      Id of an index within tableId.
- *      Must be greater than 0. Id 0 is reserved for "primary key".
+ *      Id 0 is the index on the primary keys, if the table has one.
  * \param key
  *      Secondary key within the index given by tableId and indexId. The
  *      request will be sent to the server responsible for this key in the
@@ -1492,7 +2134,7 @@ IndexServerControlRpc::wait()
  *      Id of the table in which lookup is to be done.
  * \param indexId
  *      Id of the index to use for lookup.
- *      Must be greater than 0. Id 0 is reserved for "primary key".
+ *      Id 0 is the index on the primary keys, if the table has one.
  * \param firstKey
  *      Starting key for the key range in which keys are to be matched.
  *      The key range includes the firstKey.
@@ -1561,7 +2203,7 @@ RamCloud::lookupIndexKeys(uint64_t tableId, uint8_t indexId,
  *      Id of the table in which lookup is to be done.
  * \param indexId
  *      Id of the index for which keys have to be compared.
- *      Must be greater than 0. Id 0 is reserved for "primary key".
+ *      Id 0 is the index on the primary keys, if the table has one.
  * \param firstKey
  *      Starting key for the key range in which keys are to be matched.
  *      The key range includes the firstKey.
@@ -1588,13 +2230,17 @@ RamCloud::lookupIndexKeys(uint64_t tableId, uint8_t indexId,
  *
  * \param[out] responseBuffer
  *      Response buffer returned on wait().
+ * \param fetchObjects
+ *      True means the index server should also include in the response
+ *      the objects for the returned hashes that it stores itself (see
+ *      WireFormat::LookupIndexKeys::Response).
  */
 LookupIndexKeysRpc::LookupIndexKeysRpc(
         RamCloud* ramcloud, uint64_t tableId, uint8_t indexId,
         const void* firstKey, uint16_t firstKeyLength,
         uint64_t firstAllowedKeyHash,
         const void* lastKey, uint16_t lastKeyLength,
-        uint32_t maxNumHashes, Buffer* responseBuffer)
+        uint32_t maxNumHashes, Buffer* responseBuffer, bool fetchObjects)
     : IndexRpcWrapper(ramcloud, tableId, indexId, firstKey, firstKeyLength,
             sizeof(WireFormat::LookupIndexKeys::Response), responseBuffer)
 {
@@ -1606,6 +2252,7 @@ LookupIndexKeysRpc::LookupIndexKeysRpc(
     reqHdr->firstAllowedKeyHash = firstAllowedKeyHash;
     reqHdr->lastKeyLength = lastKeyLength;
     reqHdr->maxNumHashes = maxNumHashes;
+    reqHdr->fetchObjects = fetchObjects;
     request.append(firstKey, firstKeyLength);
     request.append(lastKey, lastKeyLength);
     send();
@@ -1625,6 +2272,8 @@ LookupIndexKeysRpc::indexletNotFound()
     respHdr->numHashes = 0;
     respHdr->nextKeyLength = 0;
     respHdr->nextKeyHash = 0;
+    respHdr->numObjectHashes = 0;
+    respHdr->numObjects = 0;
 }
 
 /**
@@ -1722,6 +2371,12 @@ MigrateTabletRpc::MigrateTabletRpc(RamCloud* ramcloud, uint64_t tableId,
 void
 RamCloud::multiIncrement(MultiIncrementObject* requests[], uint32_t numRequests)
 {
+    if (readCache != NULL) {
+        for (uint32_t i = 0; i < numRequests; i++) {
+            readCache->invalidate(requests[i]->tableId, requests[i]->key,
+                    requests[i]->keyLength);
+        }
+    }
     MultiIncrement request(this, requests, numRequests);
     request.wait();
 }
@@ -1740,11 +2395,17 @@ RamCloud::multiIncrement(MultiIncrementObject* requests[], uint32_t numRequests)
  *      to place its value.
  * \param numRequests
  *      Number of valid entries in \c requests.
+ * \param filter
+ *      If non-NULL, only the objects that match this filter are returned,
+ *      with just the part of their values that it selects; the others are
+ *      reported as STATUS_OBJECT_DOESNT_EXIST. The filter is evaluated by
+ *      the masters, so unwanted objects and bytes never cross the network.
  */
 void
-RamCloud::multiRead(MultiReadObject* requests[], uint32_t numRequests)
+RamCloud::multiRead(MultiReadObject* requests[], uint32_t numRequests,
+        const ObjectFilter* filter)
 {
-    MultiRead request(this, requests, numRequests);
+    MultiRead request(this, requests, numRequests, filter);
     request.wait();
 }
 
@@ -1765,10 +2426,45 @@ RamCloud::multiRead(MultiReadObject* requests[], uint32_t numRequests)
 void
 RamCloud::multiRemove(MultiRemoveObject* requests[], uint32_t numRequests)
 {
+    if (readCache != NULL) {
+        for (uint32_t i = 0; i < numRequests; i++) {
+            readCache->invalidate(requests[i]->tableId, requests[i]->key,
+                    requests[i]->keyLength);
+        }
+    }
     MultiRemove request(this, requests, numRequests);
     request.wait();
 }
 
+/**
+ * Append to or conditionally update multiple objects (see RamCloud::append
+ * and RamCloud::conditionalUpdate). This method has two performance
+ * advantages over calling those methods separately for each object:
+ * - If multiple objects are stored on a single server, this method
+ *   issues a single RPC to update all of them at once.
+ * - If different objects are stored on different servers, this method
+ *   issues multiple RPCs concurrently.
+ * Unlike the single-object methods, these updates aren't linearizable: an
+ * update may be applied twice if its RPC is retried.
+ *
+ * \param requests
+ *      Each element in this array describes one object to update.
+ * \param numRequests
+ *      Number of valid entries in \c requests.
+ */
+void
+RamCloud::multiUpdate(MultiUpdateObject* requests[], uint32_t numRequests)
+{
+    if (readCache != NULL) {
+        for (uint32_t i = 0; i < numRequests; i++) {
+            readCache->invalidate(requests[i]->tableId, requests[i]->key,
+                    requests[i]->keyLength);
+        }
+    }
+    MultiUpdate request(this, requests, numRequests);
+    request.wait();
+}
+
 /**
  * Write multiple objects. This method has two performance advantages over
  * calling RamCloud::write separately for each object:
@@ -1786,6 +2482,17 @@ RamCloud::multiRemove(MultiRemoveObject* requests[], uint32_t numRequests)
 void
 RamCloud::multiWrite(MultiWriteObject* requests[], uint32_t numRequests)
 {
+    if (readCache != NULL) {
+        for (uint32_t i = 0; i < numRequests; i++) {
+            MultiWriteObject* object = requests[i];
+            if (object->keyInfo != NULL) {
+                readCache->invalidate(object->tableId, object->keyInfo);
+            } else {
+                readCache->invalidate(object->tableId, object->key,
+                        object->keyLength);
+            }
+        }
+    }
     MultiWrite request(this, requests, numRequests);
     request.wait();
 }
@@ -1816,10 +2523,98 @@ void
 RamCloud::read(uint64_t tableId, const void* key, uint16_t keyLength,
         Buffer* value, const RejectRules* rejectRules, uint64_t* version)
 {
+    if (readCache != NULL && rejectRules == NULL) {
+        readCache->read(tableId, key, keyLength, value, version);
+        return;
+    }
+    if (hedgedReader != NULL && rejectRules == NULL &&
+            hedgedReader->read(tableId, key, keyLength, value, version)) {
+        return;
+    }
     ReadRpc rpc(this, tableId, key, keyLength, value, rejectRules);
     rpc.wait(version);
 }
 
+/**
+ * Read the current contents of an object into memory provided by the
+ * caller, such as a language binding's own buffers. The value is copied
+ * once, straight from the RPC's response, and the caller needn't manage a
+ * Buffer; this suits values of a known, bounded size.
+ *
+ * \param tableId
+ *      The table containing the desired object (return value from
+ *      a previous call to getTableId).
+ * \param key
+ *      Variable length key that uniquely identifies the object within tableId.
+ *      It does not necessarily have to be null terminated.  The caller must
+ *      ensure that the storage for this key is unchanged through the life of
+ *      the RPC.
+ * \param keyLength
+ *      Size in bytes of the key.
+ * \param[out] value
+ *      After a successful return, this holds the first \a maxLength bytes
+ *      (or all, if it is shorter) of the object's value.
+ * \param maxLength
+ *      Number of bytes of storage at \a value.
+ * \param[out] actualLength
+ *      The length of the object's value is returned here; it may be larger
+ *      than \a maxLength, in which case the value was truncated.
+ * \param rejectRules
+ *      If non-NULL, specifies conditions under which the read
+ *      should be aborted with an error.
+ * \param[out] version
+ *      If non-NULL, the version number of the object is returned here.
+ */
+void
+RamCloud::read(uint64_t tableId, const void* key, uint16_t keyLength,
+        void* value, uint32_t maxLength, uint32_t* actualLength,
+        const RejectRules* rejectRules, uint64_t* version)
+{
+    // The response (headers and all) usually fits in the Buffer's internal
+    // storage, so this doesn't allocate any memory.
+    Buffer response;
+    read(tableId, key, keyLength, &response, rejectRules, version);
+    *actualLength = response.size();
+    response.copy(0, std::min(maxLength, *actualLength), value);
+}
+
+/**
+ * Read the contents of an object as they were at a given time, so that
+ * several reads (from any servers) see a consistent snapshot of the
+ * cluster. Servers only keep recent older versions of objects, and only if
+ * the --snapshotVersions option is set.
+ *
+ * \param tableId
+ *      The table containing the desired object (return value from
+ *      a previous call to getTableId).
+ * \param key
+ *      Variable length key that uniquely identifies the object within tableId.
+ *      It does not necessarily have to be null terminated.  The caller must
+ *      ensure that the storage for this key is unchanged through the life of
+ *      the RPC.
+ * \param keyLength
+ *      Size in bytes of the key.
+ * \param[in,out] snapshotTime
+ *      The time of the snapshot. If it is 0, the current version of the
+ *      object is read and this is set to the time of the read; pass the
+ *      result to later calls to read other objects at the same time.
+ * \param[out] value
+ *      After a successful return, this Buffer will hold the
+ *      contents of the desired object - only the value portion of the object.
+ * \param[out] version
+ *      If non-NULL, the version number of the object is returned here.
+ *
+ * \throw InvalidParameterException
+ *      The server doesn't keep the versions needed to read at this time.
+ */
+void
+RamCloud::readAtTime(uint64_t tableId, const void* key, uint16_t keyLength,
+        uint64_t* snapshotTime, Buffer* value, uint64_t* version)
+{
+    ReadRpc rpc(this, tableId, key, keyLength, value, NULL, *snapshotTime);
+    rpc.wait(version, snapshotTime);
+}
+
 /**
  * Read the current contents of an object including the keys and the value.
  *
@@ -1874,10 +2669,13 @@ RamCloud::readKeysAndValue(uint64_t tableId, const void* key,
  * \param rejectRules
  *      If non-NULL, specifies conditions under which the read
  *      should be aborted with an error.
+ * \param snapshotTime
+ *      If nonzero, read the object as it was at this time (see
+ *      RamCloud::readAtTime).
  */
 ReadRpc::ReadRpc(RamCloud* ramcloud, uint64_t tableId,
         const void* key, uint16_t keyLength, Buffer* value,
-        const RejectRules* rejectRules)
+        const RejectRules* rejectRules, uint64_t snapshotTime)
     : ObjectRpcWrapper(ramcloud->clientContext, tableId, key, keyLength,
             sizeof(WireFormat::Read::Response), value)
 {
@@ -1886,6 +2684,8 @@ ReadRpc::ReadRpc(RamCloud* ramcloud, uint64_t tableId,
     reqHdr->tableId = tableId;
     reqHdr->keyLength = keyLength;
     reqHdr->rejectRules = rejectRules ? *rejectRules : defaultRejectRules;
+    reqHdr->snapshotTime = snapshotTime;
+    reqHdr->keyHash = keyHash;
     request.append(key, keyLength);
     send();
 }
@@ -1896,15 +2696,21 @@ ReadRpc::ReadRpc(RamCloud* ramcloud, uint64_t tableId,
  *
  * \param[out] version
  *      If non-NULL, the version number of the object is returned here.
+ * \param[out] snapshotTime
+ *      If non-NULL, the time of the snapshot the read saw is returned here
+ *      (0 if the server doesn't support snapshot reads); see
+ *      RamCloud::readAtTime.
  */
 void
-ReadRpc::wait(uint64_t* version)
+ReadRpc::wait(uint64_t* version, uint64_t* snapshotTime)
 {
     waitInternal(context->dispatch);
     const WireFormat::Read::Response* respHdr(
             getResponseHeader<WireFormat::Read>());
     if (version != NULL)
         *version = respHdr->version;
+    if (snapshotTime != NULL)
+        *snapshotTime = respHdr->snapshotTime;
 
     // Truncate the response Buffer so that it consists of nothing
     // but the object data.
@@ -1981,6 +2787,185 @@ ReadKeysAndValueRpc::wait(uint64_t* version)
         ClientException::throwException(HERE, respHdr->common.status);
 }
 
+/**
+ * Constructor for ReadChangesRpc: asks a tablet's master for the changes to
+ * the tablet, and returns once the RPC has been initiated, without waiting
+ * for it to complete.
+ *
+ * \param ramcloud
+ *      The RAMCloud object that governs this RPC.
+ * \param tableId
+ *      The table containing the tablet.
+ * \param firstKeyHash
+ *      Smallest key hash in the tablet.
+ * \param lastKeyHash
+ *      Largest key hash in the tablet.
+ * \param position
+ *      Where to start reading the master's change stream: the nextPosition
+ *      returned by an earlier read, or
+ *      WireFormat::ReadChanges::Request::SUBSCRIBE to start streaming the
+ *      tablet's table and learn the position of its next change.
+ * \param maxBytes
+ *      Return at most about this many bytes of changes.
+ * \param[out] changes
+ *      After a successful return, this Buffer will hold the changes: each a
+ *      WireFormat::ReadChanges::Change followed by an Object or
+ *      ObjectTombstone, in the order they were made.
+ */
+ReadChangesRpc::ReadChangesRpc(RamCloud* ramcloud, uint64_t tableId,
+        uint64_t firstKeyHash, uint64_t lastKeyHash, uint64_t position,
+        uint32_t maxBytes, Buffer* changes)
+    : ObjectRpcWrapper(ramcloud->clientContext, tableId, firstKeyHash,
+            sizeof(WireFormat::ReadChanges::Response), changes)
+{
+    changes->reset();
+    WireFormat::ReadChanges::Request* reqHdr(
+            allocHeader<WireFormat::ReadChanges>());
+    reqHdr->tableId = tableId;
+    reqHdr->firstKeyHash = firstKeyHash;
+    reqHdr->lastKeyHash = lastKeyHash;
+    reqHdr->position = position;
+    reqHdr->maxBytes = maxBytes;
+    send();
+}
+
+// See RpcWrapper for documentation.
+bool
+ReadChangesRpc::checkStatus()
+{
+    if (responseHeader->status == STATUS_UNKNOWN_TABLET) {
+        // Retrying won't help if the tablet has been split or merged; let
+        // the caller find out where it is now.
+        context->objectFinder->flush(tableId);
+        return true;
+    }
+    return ObjectRpcWrapper::checkStatus();
+}
+
+/**
+ * Wait for the RPC to complete. On a successful return the changes buffer
+ * holds the (decompressed) changes.
+ *
+ * \param[out] streamId
+ *      Identifies the master's change stream; positions from one stream
+ *      mean nothing in another.
+ * \param[out] nextPosition
+ *      Where the next read should start.
+ * \param[out] lagMicros
+ *      Age, in microseconds, of the oldest change not yet read; 0 means
+ *      there are none.
+ * \return
+ *      True means the changes were read. False means some of the changes
+ *      from the requested position are gone: the caller must subscribe
+ *      again and copy the tablet afresh.
+ *
+ * \throw UnknownTabletException
+ *      The master no longer stores exactly this tablet.
+ */
+bool
+ReadChangesRpc::wait(uint64_t* streamId, uint64_t* nextPosition,
+        uint32_t* lagMicros)
+{
+    waitInternal(context->dispatch);
+    const WireFormat::ReadChanges::Response* respHdr(
+            getResponseHeader<WireFormat::ReadChanges>());
+    if (respHdr->common.status != STATUS_OK)
+        ClientException::throwException(HERE, respHdr->common.status);
+
+    *streamId = respHdr->streamId;
+    *nextPosition = respHdr->nextPosition;
+    *lagMicros = respHdr->lagMicros;
+    if (respHdr->positionLost)
+        return false;
+
+    uint32_t length = respHdr->length;
+    uint32_t compressedLength = respHdr->compressedLength;
+    response->truncateFront(sizeof(*respHdr));
+    if (compressedLength != 0) {
+        Buffer compressed;
+        compressed.append(response);
+        response->reset();
+        if (!Lz4::decompress(compressed.getRange(0, compressedLength),
+                compressedLength, response->alloc(length), length)) {
+            LOG(WARNING, "Compressed changes to tableId %lu are corrupt",
+                    tableId);
+            throw ResponseFormatError(HERE);
+        }
+    }
+    assert(length == response->size());
+    return true;
+}
+
+/**
+ * Constructor for ReadFromReplicaRpc: asks a read replica for an object,
+ * and returns once the RPC has been initiated, without waiting for it to
+ * complete.
+ *
+ * \param ramcloud
+ *      The RAMCloud object that governs this RPC.
+ * \param session
+ *      Session to the read replica.
+ * \param tableId
+ *      The table containing the desired object.
+ * \param key
+ *      Variable length key that uniquely identifies the object within tableId.
+ *      The caller must ensure that the storage for this key is unchanged
+ *      through the life of the RPC.
+ * \param keyLength
+ *      Size in bytes of the key.
+ * \param maxStalenessMicros
+ *      The replica refuses the read if it may be more than this many
+ *      microseconds behind the tablet's master.
+ * \param[out] value
+ *      After a successful return, this Buffer will hold the value of the
+ *      desired object.
+ */
+ReadFromReplicaRpc::ReadFromReplicaRpc(RamCloud* ramcloud,
+        Transport::SessionRef session, uint64_t tableId, const void* key,
+        uint16_t keyLength, uint32_t maxStalenessMicros, Buffer* value)
+    : RpcWrapper(sizeof(WireFormat::ReadFromReplica::Response), value)
+    , ramcloud(ramcloud)
+{
+    this->session = session;
+    value->reset();
+    WireFormat::ReadFromReplica::Request* reqHdr(
+            allocHeader<WireFormat::ReadFromReplica>());
+    reqHdr->tableId = tableId;
+    reqHdr->keyLength = keyLength;
+    reqHdr->maxStalenessMicros = maxStalenessMicros;
+    request.append(key, keyLength);
+    send();
+}
+
+/**
+ * Wait for the RPC to complete.
+ *
+ * \param[out] version
+ *      If non-NULL and the replica returned the object, its version number
+ *      is returned here.
+ * \return
+ *      True means the replica returned the object, and the response buffer
+ *      holds its value. False means it didn't (the replica was too stale,
+ *      didn't have the object, or couldn't be reached); the read should be
+ *      left to the object's master.
+ */
+bool
+ReadFromReplicaRpc::wait(uint64_t* version)
+{
+    waitInternal(ramcloud->clientContext->dispatch);
+    if (getState() != RpcState::FINISHED)
+        return false;
+    const WireFormat::ReadFromReplica::Response* respHdr(
+            getResponseHeader<WireFormat::ReadFromReplica>());
+    if (respHdr->common.status != STATUS_OK)
+        return false;
+    if (version != NULL)
+        *version = respHdr->version;
+    response->truncateFront(sizeof(*respHdr));
+    assert(respHdr->length == response->size());
+    return true;
+}
+
 /**
  * Delete an object from a table. If the object does not currently exist
  * then the operation succeeds without doing anything (unless rejectRules
@@ -2007,6 +2992,8 @@ void
 RamCloud::remove(uint64_t tableId, const void* key, uint16_t keyLength,
         const RejectRules* rejectRules, uint64_t* version)
 {
+    if (readCache != NULL)
+        readCache->invalidate(tableId, key, keyLength);
     RemoveRpc rpc(this, tableId, key, keyLength, rejectRules);
     rpc.wait(version);
 }
@@ -2040,6 +3027,7 @@ RemoveRpc::RemoveRpc(RamCloud* ramcloud, uint64_t tableId,
     WireFormat::Remove::Request* reqHdr(allocHeader<WireFormat::Remove>());
     reqHdr->tableId = tableId;
     reqHdr->keyLength = keyLength;
+    reqHdr->keyHash = keyHash;
     reqHdr->rejectRules = rejectRules ? *rejectRules : defaultRejectRules;
     request.append(key, keyLength);
     fillLinearizabilityHeader<WireFormat::Remove::Request>(reqHdr);
@@ -2535,6 +3523,161 @@ KillRpc::KillRpc(RamCloud* ramcloud, uint64_t tableId,
     send();
 }
 
+/**
+ * Make a table a cache, whose data may be lost: writes to it return without
+ * waiting for backups, and once its data on a master exceeds a quota, the
+ * master's log cleaner evicts its objects (roughly the least recently
+ * written ones) instead of keeping them. The quota is sent to every server
+ * in the cluster; like a TTL (see setTableTtl) it should be set again after
+ * the cluster's membership changes. See ObjectManager::setTableCacheQuota
+ * for more information.
+ *
+ * \param tableId
+ *      The table to make a cache (return value from a previous call to
+ *      getTableId).
+ * \param quotaBytes
+ *      Bytes of the table's data that each master may hold before it
+ *      starts evicting. 0 makes the table durable again.
+ */
+void
+RamCloud::setTableCacheQuota(uint64_t tableId, uint64_t quotaBytes)
+{
+    WireFormat::TableCacheQuota quota = {tableId, quotaBytes};
+    serverControlAll(WireFormat::SET_TABLE_CACHE_QUOTA, &quota,
+            sizeof32(quota));
+}
+
+/**
+ * Choose how durable writes to a table must be before they are
+ * acknowledged. Every write is still replicated to all of its master's
+ * backups (all tables on a master share its log), but a write to a table
+ * with a lower level returns as soon as \a ackReplicas backups have it,
+ * so it doesn't wait for the slowest one; with 0 a write returns as soon
+ * as it is in the master's memory. The level is sent to every server in the
+ * cluster; like a TTL (see setTableTtl) it should be set again after the
+ * cluster's membership changes. See ObjectManager::setTableDurability for
+ * more information.
+ *
+ * \param tableId
+ *      The table whose durability to set (return value from a previous call
+ *      to getTableId).
+ * \param ackReplicas
+ *      Number of replicas a write must reach before it is acknowledged;
+ *      ~0u (or any value at least the replication factor) waits for all.
+ */
+void
+RamCloud::setTableDurability(uint64_t tableId, uint32_t ackReplicas)
+{
+    WireFormat::TableDurability durability = {tableId, ackReplicas};
+    serverControlAll(WireFormat::SET_TABLE_DURABILITY, &durability,
+            sizeof32(durability));
+}
+
+/**
+ * Limit the rate at which each master serves a table's requests, so that
+ * the table's clients can't starve other tables of the masters' bandwidth
+ * and CPU. Once a master has done a second's worth of work for the table,
+ * it rejects further reads, writes, and other object requests for it with
+ * STATUS_RETRY, telling the clients how long to back off; requests waiting
+ * this way appear to the application as slow operations, not errors. The
+ * limit is sent to every server in the cluster; like a TTL (see
+ * setTableTtl) it should be set again after the cluster's membership
+ * changes. See TableRateLimiter for more information.
+ *
+ * \param tableId
+ *      The table to limit (return value from a previous call to
+ *      getTableId).
+ * \param opsPerSecond
+ *      Object operations each master may perform for the table per second
+ *      (each object in a multi-operation counts); 0 means no limit.
+ * \param bytesPerSecond
+ *      Bytes of requests and responses each master may transfer for the
+ *      table per second; 0 means no limit.
+ */
+void
+RamCloud::setTableRateLimit(uint64_t tableId, uint64_t opsPerSecond,
+        uint64_t bytesPerSecond)
+{
+    WireFormat::TableRateLimit limit = {tableId, opsPerSecond,
+            bytesPerSecond};
+    serverControlAll(WireFormat::SET_TABLE_RATE_LIMIT, &limit,
+            sizeof32(limit));
+}
+
+/**
+ * Make the objects in a table expire a given time after they were last
+ * written: from then on reads treat them as if they didn't exist, and the
+ * masters reclaim their space without writing tombstones. The TTL is sent
+ * to every server in the cluster; masters that join later (including
+ * recovery masters that take over part of the table) don't have it, so
+ * it should be set again after the cluster's membership changes. See
+ * ObjectManager::setTableTtl for more information.
+ *
+ * \param tableId
+ *      The table whose objects expire (return value from a previous call
+ *      to getTableId).
+ * \param ttlSeconds
+ *      Objects expire this many seconds after they were last written. 0
+ *      means they never expire.
+ */
+void
+RamCloud::setTableTtl(uint64_t tableId, uint32_t ttlSeconds)
+{
+    WireFormat::TableTtl ttl = {tableId, ttlSeconds};
+    serverControlAll(WireFormat::SET_TABLE_TTL, &ttl, sizeof32(ttl));
+}
+
+/**
+ * Change how the servers in the cluster schedule RPCs on their worker
+ * threads. The option is sent to every server in the cluster; servers that
+ * join later use the defaults. See WorkerManager::setOption for the options
+ * and their values; servers leave their settings unchanged if they don't
+ * recognize the option or its value.
+ *
+ * \param option
+ *      Name of the option to change, such as "reservedWorkers".
+ * \param value
+ *      The option's new value.
+ */
+void
+RamCloud::setWorkerOption(const char* option, const char* value)
+{
+    string input(option);
+    input.push_back('\0');
+    input.append(value);
+    input.push_back('\0');
+    serverControlAll(WireFormat::SET_WORKER_OPTION, input.data(),
+            downCast<uint32_t>(input.size()));
+}
+
+/**
+ * Give the tablet containing an object a read replica: another master that
+ * its master keeps up to date in the background, and that hedged reads
+ * (see #enableHedgedReads) may use when the master is slow. The replica
+ * only serves reads, within the staleness each read allows; it is dropped
+ * if the tablet moves or its master crashes, and should be set again then.
+ * Each tablet has at most one read replica.
+ *
+ * \param tableId
+ *      The table containing the tablet (return value from a previous call
+ *      to getTableId).
+ * \param key
+ *      Any key in the tablet.
+ * \param keyLength
+ *      Size in bytes of the key.
+ * \param replica
+ *      The master to hold the replica; an invalid id removes the tablet's
+ *      replica.
+ */
+void
+RamCloud::setReadReplica(uint64_t tableId, const void* key,
+        uint16_t keyLength, ServerId replica)
+{
+    WireFormat::ReadReplicaServer input = {replica.getId()};
+    objectServerControl(tableId, key, keyLength,
+            WireFormat::SET_READ_REPLICA, &input, sizeof32(input));
+}
+
 /**
  * Set a runtime option field on the coordinator to the indicated value.
  *
@@ -2637,6 +3780,8 @@ RamCloud::write(uint64_t tableId, const void* key, uint16_t keyLength,
         const void* buf, uint32_t length, const RejectRules* rejectRules,
         uint64_t* version, bool async)
 {
+    if (readCache != NULL)
+        readCache->invalidate(tableId, key, keyLength);
     WriteRpc rpc(this, tableId, key, keyLength, buf, length, rejectRules,
             async);
     rpc.wait(version);
@@ -2679,6 +3824,8 @@ RamCloud::write(uint64_t tableId, const void* key, uint16_t keyLength,
         const char* value, const RejectRules* rejectRules, uint64_t* version,
         bool async)
 {
+    if (readCache != NULL)
+        readCache->invalidate(tableId, key, keyLength);
     uint32_t valueLength =
             (value == NULL) ? 0 : downCast<uint32_t>(strlen(value));
 
@@ -2732,6 +3879,8 @@ RamCloud::write(uint64_t tableId, uint8_t numKeys, KeyInfo *keyList,
         const void* buf, uint32_t length, const RejectRules* rejectRules,
         uint64_t* version, bool async)
 {
+    if (readCache != NULL)
+        readCache->invalidate(tableId, keyList);
     WriteRpc rpc(this, tableId, numKeys, keyList, buf, length, rejectRules,
             async);
     rpc.wait(version);
@@ -2779,6 +3928,8 @@ RamCloud::write(uint64_t tableId, uint8_t numKeys, KeyInfo *keyList,
         const char* value, const RejectRules* rejectRules, uint64_t* version,
         bool async)
 {
+    if (readCache != NULL)
+        readCache->invalidate(tableId, keyList);
     uint32_t valueLength =
             (value == NULL) ? 0 : downCast<uint32_t>(strlen(value));
     WriteRpc rpc(this, tableId, numKeys, keyList, value,
@@ -2840,6 +3991,7 @@ WriteRpc::WriteRpc(RamCloud* ramcloud, uint64_t tableId,
     reqHdr->rejectRules = rejectRules ? *rejectRules : defaultRejectRules;
     reqHdr->async = async;
     reqHdr->length = totalLength;
+    reqHdr->keyHash = keyHash;
 
     fillLinearizabilityHeader<WireFormat::Write::Request>(reqHdr);
 
@@ -2895,6 +4047,7 @@ WriteRpc::WriteRpc(RamCloud* ramcloud, uint64_t tableId,
     reqHdr->rejectRules = rejectRules ? *rejectRules : defaultRejectRules;
     reqHdr->async = async;
     reqHdr->length = totalLength;
+    reqHdr->keyHash = keyHash;
 
     fillLinearizabilityHeader<WireFormat::Write::Request>(reqHdr);
 
@@ -2923,4 +4076,43 @@ WriteRpc::wait(uint64_t* version)
         ClientException::throwException(HERE, respHdr->common.status);
 }
 
+/**
+ * Constructor for WriteFragmentRpc: sends part of the value of a streaming
+ * write to the object's master, which holds it until a CommitWriteRpc for
+ * the same stream. Returns once the RPC has been initiated, without
+ * waiting for it to complete.
+ *
+ * \param ramcloud
+ *      The RAMCloud object that governs this RPC.
+ * \param tableId
+ *      The table containing the object.
+ * \param keyHash
+ *      Key::getHash of the object's primary key; selects the master.
+ * \param streamId
+ *      Identifies the value; the same for all of its fragments.
+ * \param offset
+ *      Offset in the value of the first byte of \a data.
+ * \param data
+ *      The fragment. It is copied into the request, so the caller may
+ *      reuse this memory as soon as the constructor returns.
+ * \param length
+ *      Size in bytes of \a data.
+ */
+WriteFragmentRpc::WriteFragmentRpc(RamCloud* ramcloud, uint64_t tableId,
+        uint64_t keyHash, uint64_t streamId, uint32_t offset,
+        const void* data, uint32_t length)
+    : ObjectRpcWrapper(ramcloud->clientContext, tableId, keyHash,
+            sizeof(WireFormat::WriteFragment::Response))
+{
+    WireFormat::WriteFragment::Request* reqHdr(
+            allocHeader<WireFormat::WriteFragment>());
+    reqHdr->tableId = tableId;
+    reqHdr->keyHash = keyHash;
+    reqHdr->streamId = streamId;
+    reqHdr->offset = offset;
+    reqHdr->length = length;
+    request.appendCopy(data, length);
+    send();
+}
+
 }  // namespace RAMCloud
@@ -28,12 +28,17 @@
 #include "ServerStatistics.pb.h"
 
 namespace RAMCloud {
+class ClientDispatchThread;
 class ClientLeaseAgent;
+class ClientReadCache;
 class ClientTransactionManager;
+class HedgedReader;
 class MultiIncrementObject;
 class MultiReadObject;
 class MultiRemoveObject;
+class MultiUpdateObject;
 class MultiWriteObject;
+class ObjectFilter;
 class ObjectFinder;
 class RpcTracker;
 
@@ -65,16 +70,32 @@ struct KeyInfo
  */
 class RamCloud {
   public:
+    uint32_t append(uint64_t tableId, const void* key, uint16_t keyLength,
+            const void* buf, uint32_t length,
+            const RejectRules* rejectRules = NULL, uint64_t* version = NULL);
+    bool conditionalUpdate(uint64_t tableId, const void* key,
+            uint16_t keyLength, uint32_t offset, const void* expected,
+            const void* newValue, uint32_t length,
+            const RejectRules* rejectRules = NULL, uint64_t* version = NULL);
     void coordSplitAndMigrateIndexlet(
             ServerId newOwner, uint64_t tableId, uint8_t indexId,
             const void* splitKey, KeyLength splitKeyLength);
+    uint64_t countIndexKeys(uint64_t tableId, uint8_t indexId,
+            const void* firstKey, uint16_t firstKeyLength,
+            const void* lastKey, uint16_t lastKeyLength,
+            Buffer* minKey = NULL, Buffer* maxKey = NULL);
     uint64_t createTable(const char* name, uint32_t serverSpan = 1);
     void dropTable(const char* name);
     void createIndex(uint64_t tableId, uint8_t indexId, uint8_t indexType,
             uint8_t numIndexlets = 1);
     void dropIndex(uint64_t tableId, uint8_t indexId);
+    void enableHedgedReads(uint64_t tableId, uint32_t maxStalenessMicros);
+    void enableMultiThreading();
+    void enableProxy(const char* proxyLocator);
+    void enableReadCache(uint64_t maxBytes, uint32_t leaseMicros);
     uint64_t enumerateTable(uint64_t tableId, bool keysOnly,
-         uint64_t tabletFirstHash, Buffer& state, Buffer& objects);
+         uint64_t tabletFirstHash, Buffer& state, Buffer& objects,
+         const ObjectFilter* filter = NULL);
     void getLogMetrics(const char* serviceLocator,
             ProtoBuf::LogMetrics& logMetrics);
     ServerMetrics getMetrics(uint64_t tableId, const void* key,
@@ -112,8 +133,10 @@ class RamCloud {
     void migrateTablet(uint64_t tableId, uint64_t firstKeyHash,
             uint64_t lastKeyHash, ServerId newOwnerMasterId);
     void multiIncrement(MultiIncrementObject* requests[], uint32_t numRequests);
-    void multiRead(MultiReadObject* requests[], uint32_t numRequests);
+    void multiRead(MultiReadObject* requests[], uint32_t numRequests,
+            const ObjectFilter* filter = NULL);
     void multiRemove(MultiRemoveObject* requests[], uint32_t numRequests);
+    void multiUpdate(MultiUpdateObject* requests[], uint32_t numRequests);
     void multiWrite(MultiWriteObject* requests[], uint32_t numRequests);
     void objectServerControl(uint64_t tableId, const void* key,
             uint16_t keyLength, WireFormat::ControlOp controlOp,
@@ -122,6 +145,11 @@ class RamCloud {
     void read(uint64_t tableId, const void* key, uint16_t keyLength,
             Buffer* value, const RejectRules* rejectRules = NULL,
             uint64_t* version = NULL);
+    void read(uint64_t tableId, const void* key, uint16_t keyLength,
+            void* value, uint32_t maxLength, uint32_t* actualLength,
+            const RejectRules* rejectRules = NULL, uint64_t* version = NULL);
+    void readAtTime(uint64_t tableId, const void* key, uint16_t keyLength,
+            uint64_t* snapshotTime, Buffer* value, uint64_t* version = NULL);
     void readKeysAndValue(uint64_t tableId, const void* key, uint16_t keyLength,
             ObjectBuffer* value, const RejectRules* rejectRules = NULL,
             uint64_t* version = NULL);
@@ -140,7 +168,15 @@ class RamCloud {
     string testingGetServiceLocator(uint64_t tableId, const void* key,
             uint16_t keyLength);
     void testingKill(uint64_t tableId, const void* key, uint16_t keyLength);
+    void setReadReplica(uint64_t tableId, const void* key,
+            uint16_t keyLength, ServerId replica);
     void setRuntimeOption(const char* option, const char* value);
+    void setTableCacheQuota(uint64_t tableId, uint64_t quotaBytes);
+    void setTableDurability(uint64_t tableId, uint32_t ackReplicas);
+    void setTableRateLimit(uint64_t tableId, uint64_t opsPerSecond,
+            uint64_t bytesPerSecond);
+    void setTableTtl(uint64_t tableId, uint32_t ttlSeconds);
+    void setWorkerOption(const char* option, const char* value);
     void testingWaitForAllTabletsNormal(uint64_t tableId,
             uint64_t timeoutNs = ~0lu);
     void write(uint64_t tableId, const void* key, uint16_t keyLength,
@@ -163,6 +199,7 @@ class RamCloud {
             const char* clusterName = "main");
     RamCloud(Context* context, const char* serviceLocator,
             const char* clusterName = "main");
+    explicit RamCloud(RamCloud* shared);
     virtual ~RamCloud();
 
   PRIVATE:
@@ -178,6 +215,13 @@ class RamCloud {
      */
     Context* realClientContext;
 
+    /**
+     * Polls the dispatcher of #clientContext on behalf of all of the threads
+     * using it, once #enableMultiThreading has been invoked; NULL otherwise
+     * (and always NULL for RamCloud objects that share another's context).
+     */
+    ClientDispatchThread* dispatchThread;
+
   public:
     /**
      * This usually refers to realClientContext. For testing purposes and
@@ -200,10 +244,65 @@ class RamCloud {
     RpcTracker *rpcTracker;
     ClientTransactionManager *transactionManager;
 
+    /// NULL unless #enableReadCache has been invoked.
+    ClientReadCache *readCache;
+
+    /// NULL unless #enableHedgedReads has been invoked.
+    HedgedReader *hedgedReader;
+
   private:
     DISALLOW_COPY_AND_ASSIGN(RamCloud);
 };
 
+/**
+ * Encapsulates the state of a RamCloud::append operation,
+ * allowing it to execute asynchronously.
+ */
+class AppendRpc : public LinearizableObjectRpcWrapper {
+  public:
+    AppendRpc(RamCloud* ramcloud, uint64_t tableId, const void* key,
+            uint16_t keyLength, const void* buf, uint32_t length,
+            const RejectRules* rejectRules = NULL);
+    ~AppendRpc() {}
+    uint32_t wait(uint64_t* version = NULL);
+
+  PRIVATE:
+    DISALLOW_COPY_AND_ASSIGN(AppendRpc);
+};
+
+/**
+ * Writes an object whose value was sent earlier with WriteFragmentRpcs
+ * (see ObjectWriteStream).
+ */
+class CommitWriteRpc : public LinearizableObjectRpcWrapper {
+  public:
+    CommitWriteRpc(RamCloud* ramcloud, uint64_t tableId, const void* key,
+            uint16_t keyLength, uint64_t streamId, uint32_t valueLength,
+            uint32_t checksum, const RejectRules* rejectRules = NULL);
+    ~CommitWriteRpc() {}
+    void wait(uint64_t* version = NULL);
+
+  PRIVATE:
+    DISALLOW_COPY_AND_ASSIGN(CommitWriteRpc);
+};
+
+/**
+ * Encapsulates the state of a RamCloud::conditionalUpdate operation,
+ * allowing it to execute asynchronously.
+ */
+class ConditionalUpdateRpc : public LinearizableObjectRpcWrapper {
+  public:
+    ConditionalUpdateRpc(RamCloud* ramcloud, uint64_t tableId,
+            const void* key, uint16_t keyLength, uint32_t offset,
+            const void* expected, const void* newValue, uint32_t length,
+            const RejectRules* rejectRules = NULL);
+    ~ConditionalUpdateRpc() {}
+    bool wait(uint64_t* version = NULL);
+
+  PRIVATE:
+    DISALLOW_COPY_AND_ASSIGN(ConditionalUpdateRpc);
+};
+
 /**
  * Encapsulates the state of a RamCloud::coordSplitAndMigrateIndexlet operation,
  * allowing it to execute asynchronously.
@@ -221,6 +320,28 @@ class CoordSplitAndMigrateIndexletRpc : public CoordinatorRpcWrapper {
     DISALLOW_COPY_AND_ASSIGN(CoordSplitAndMigrateIndexletRpc);
 };
 
+/**
+ * Encapsulates the state of a single COUNT_INDEX_KEYS request issued by
+ * RamCloud::countIndexKeys, allowing it to execute asynchronously.
+ */
+class CountIndexKeysRpc : public IndexRpcWrapper {
+  public:
+    CountIndexKeysRpc(RamCloud* ramcloud, uint64_t tableId, uint8_t indexId,
+            const void* firstKey, uint16_t firstKeyLength,
+            uint64_t firstAllowedKeyHash,
+            const void* lastKey, uint16_t lastKeyLength,
+            Buffer* responseBuffer);
+    ~CountIndexKeysRpc() {}
+
+    void indexletNotFound();
+    void wait(uint64_t* count, uint16_t* minKeyLength,
+            uint16_t* maxKeyLength, uint16_t* nextKeyLength,
+            uint64_t* nextKeyHash);
+
+  PRIVATE:
+    DISALLOW_COPY_AND_ASSIGN(CountIndexKeysRpc);
+};
+
 /**
  * Encapsulates the state of a RamCloud::createTable operation,
  * allowing it to execute asynchronously.
@@ -287,7 +408,8 @@ class DropIndexRpc : public CoordinatorRpcWrapper {
 class EnumerateTableRpc : public ObjectRpcWrapper {
   public:
     EnumerateTableRpc(RamCloud* ramcloud, uint64_t tableId, bool keysOnly,
-            uint64_t tabletFirstHash, Buffer& iter, Buffer& objects);
+            uint64_t tabletFirstHash, Buffer& iter, Buffer& objects,
+            const ObjectFilter* filter = NULL);
     ~EnumerateTableRpc() {}
     uint64_t wait(Buffer& nextIter);
 
@@ -509,7 +631,8 @@ class LookupIndexKeysRpc : public IndexRpcWrapper {
             const void* firstKey, uint16_t firstKeyLength,
             uint64_t firstAllowedKeyHash,
             const void* lastKey, uint16_t lastKeyLength,
-            uint32_t maxNumHashes, Buffer* responseBuffer);
+            uint32_t maxNumHashes, Buffer* responseBuffer,
+            bool fetchObjects = false);
     ~LookupIndexKeysRpc() {}
 
     void indexletNotFound();
@@ -766,6 +889,132 @@ struct MultiRemoveObject : public MultiOpObject {
     }
 };
 
+/**
+ * Objects of this class are used to pass parameters into \c multiUpdate
+ * and for multiUpdate to return result values. Each one describes either
+ * an append or a conditional update (see RamCloud::append and
+ * RamCloud::conditionalUpdate).
+ */
+struct MultiUpdateObject : public MultiOpObject {
+    /**
+     * True means append \c data to the object; false means replace the
+     * bytes at \c offset with \c data if they're equal to \c expected.
+     */
+    bool append;
+
+    /**
+     * Conditional updates only: offset in the object's value of the bytes
+     * to compare and replace.
+     */
+    uint32_t offset;
+
+    /**
+     * Conditional updates only: the bytes expected at \c offset.
+     */
+    const void* expected;
+
+    /**
+     * The bytes to append or store.
+     */
+    const void* data;
+
+    /**
+     * Length in bytes of \c data (and of \c expected).
+     */
+    uint32_t length;
+
+    /**
+     * The RejectRules specify when updates should be aborted.
+     */
+    const RejectRules* rejectRules;
+
+    /**
+     * The version number of the object is returned here.
+     */
+    uint64_t version;
+
+    /**
+     * Whether the object was updated: false if the bytes of a conditional
+     * update didn't match, or if the status is not STATUS_OK.
+     */
+    bool updated;
+
+    /**
+     * Length of the object's value after the operation.
+     */
+    uint32_t newLength;
+
+    MultiUpdateObject(uint64_t tableId, const void* key, uint16_t keyLength,
+                const void* data, uint32_t length,
+                const RejectRules* rejectRules = NULL)
+        : MultiOpObject(tableId, key, keyLength)
+        , append(true)
+        , offset()
+        , expected()
+        , data(data)
+        , length(length)
+        , rejectRules(rejectRules)
+        , version()
+        , updated()
+        , newLength()
+    {}
+
+    MultiUpdateObject(uint64_t tableId, const void* key, uint16_t keyLength,
+                uint32_t offset, const void* expected, const void* data,
+                uint32_t length, const RejectRules* rejectRules = NULL)
+        : MultiOpObject(tableId, key, keyLength)
+        , append(false)
+        , offset(offset)
+        , expected(expected)
+        , data(data)
+        , length(length)
+        , rejectRules(rejectRules)
+        , version()
+        , updated()
+        , newLength()
+    {}
+
+    MultiUpdateObject()
+        : MultiOpObject()
+        , append()
+        , offset()
+        , expected()
+        , data()
+        , length()
+        , rejectRules()
+        , version()
+        , updated()
+        , newLength()
+    {}
+
+    MultiUpdateObject(const MultiUpdateObject& other)
+        : MultiOpObject(other)
+        , append(other.append)
+        , offset(other.offset)
+        , expected(other.expected)
+        , data(other.data)
+        , length(other.length)
+        , rejectRules(other.rejectRules)
+        , version(other.version)
+        , updated(other.updated)
+        , newLength(other.newLength)
+    {}
+
+    MultiUpdateObject& operator=(const MultiUpdateObject& other) {
+        MultiOpObject::operator =(other);
+        append = other.append;
+        offset = other.offset;
+        expected = other.expected;
+        data = other.data;
+        length = other.length;
+        rejectRules = other.rejectRules;
+        version = other.version;
+        updated = other.updated;
+        newLength = other.newLength;
+        return *this;
+    }
+};
+
 /**
  * Objects of this class are used to pass parameters into \c multiWrite
  * and for multiWrite to return status values for conditional operations
@@ -916,9 +1165,9 @@ class ReadRpc : public ObjectRpcWrapper {
   public:
     ReadRpc(RamCloud* ramcloud, uint64_t tableId, const void* key,
             uint16_t keyLength, Buffer* value,
-            const RejectRules* rejectRules = NULL);
+            const RejectRules* rejectRules = NULL, uint64_t snapshotTime = 0);
     ~ReadRpc() {}
-    void wait(uint64_t* version = NULL);
+    void wait(uint64_t* version = NULL, uint64_t* snapshotTime = NULL);
 
   PRIVATE:
     DISALLOW_COPY_AND_ASSIGN(ReadRpc);
@@ -941,6 +1190,47 @@ class ReadKeysAndValueRpc : public ObjectRpcWrapper {
     DISALLOW_COPY_AND_ASSIGN(ReadKeysAndValueRpc);
 };
 
+/**
+ * Reads the latest changes to a tablet from its master's change stream
+ * (see ChangeStreamReceiver). If the tablet can't be found at exactly the
+ * given key hash range (it has been split, for example), wait throws
+ * UnknownTabletException rather than retrying.
+ */
+class ReadChangesRpc : public ObjectRpcWrapper {
+  public:
+    ReadChangesRpc(RamCloud* ramcloud, uint64_t tableId,
+            uint64_t firstKeyHash, uint64_t lastKeyHash, uint64_t position,
+            uint32_t maxBytes, Buffer* changes);
+    ~ReadChangesRpc() {}
+    bool wait(uint64_t* streamId, uint64_t* nextPosition,
+            uint32_t* lagMicros);
+
+  PROTECTED:
+    virtual bool checkStatus();
+
+  PRIVATE:
+    DISALLOW_COPY_AND_ASSIGN(ReadChangesRpc);
+};
+
+/**
+ * Reads an object from a particular read replica of its tablet, rather
+ * than from its master (see HedgedReader). Unlike most wrappers, this one
+ * never retries: if the replica can't serve the read, the caller is
+ * expected to use the master's answer instead.
+ */
+class ReadFromReplicaRpc : public RpcWrapper {
+  public:
+    ReadFromReplicaRpc(RamCloud* ramcloud, Transport::SessionRef session,
+            uint64_t tableId, const void* key, uint16_t keyLength,
+            uint32_t maxStalenessMicros, Buffer* value);
+    ~ReadFromReplicaRpc() {}
+    bool wait(uint64_t* version = NULL);
+
+  PRIVATE:
+    RamCloud* ramcloud;
+    DISALLOW_COPY_AND_ASSIGN(ReadFromReplicaRpc);
+};
+
 /**
  * Encapsulates the state of a RamCloud::remove operation,
  * allowing it to execute asynchronously.
@@ -1041,6 +1331,23 @@ class WriteRpc : public LinearizableObjectRpcWrapper {
     DISALLOW_COPY_AND_ASSIGN(WriteRpc);
 };
 
+/**
+ * Sends part of the value of a streaming write to the object's master
+ * (see ObjectWriteStream).
+ */
+class WriteFragmentRpc : public ObjectRpcWrapper {
+  public:
+    WriteFragmentRpc(RamCloud* ramcloud, uint64_t tableId, uint64_t keyHash,
+            uint64_t streamId, uint32_t offset, const void* data,
+            uint32_t length);
+    ~WriteFragmentRpc() {}
+    /// \copydoc RpcWrapper::docForWait
+    void wait() {simpleWait(context);}
+
+  PRIVATE:
+    DISALLOW_COPY_AND_ASSIGN(WriteFragmentRpc);
+};
+
 } // namespace RAMCloud
 
 #endif // RAMCLOUD_RAMCLOUD_H
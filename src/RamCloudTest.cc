@@ -198,6 +198,31 @@ TEST_F(RamCloudTest, concurrentAsyncRpc) {
     EXPECT_EQ("STATUS_TABLE_DOESNT_EXIST", message2);
 }
 
+static void multiThreadTestThread(RamCloud* shared, uint64_t tableId,
+        const char* key) {
+    RamCloud ramcloud(shared);
+    Buffer value;
+    ramcloud.read(tableId, "0", 1, &value);
+    ramcloud.write(tableId, key, 1, TestUtil::toString(&value).c_str());
+}
+
+TEST_F(RamCloudTest, enableMultiThreading) {
+    ramcloud->write(tableId1, "0", 1, "abcdef");
+    ramcloud->enableMultiThreading();
+    EXPECT_FALSE(context.dispatch->isDispatchThread());
+
+    std::thread thread1(multiThreadTestThread, ramcloud.get(), tableId1, "1");
+    std::thread thread2(multiThreadTestThread, ramcloud.get(), tableId1, "2");
+    thread1.join();
+    thread2.join();
+
+    Buffer value;
+    ramcloud->read(tableId1, "1", 1, &value);
+    EXPECT_EQ("abcdef", TestUtil::toString(&value));
+    ramcloud->read(tableId1, "2", 1, &value);
+    EXPECT_EQ("abcdef", TestUtil::toString(&value));
+}
+
 TEST_F(RamCloudTest, enumeration_basics) {
     uint64_t version0, version1, version2, version3, version4;
     ramcloud->write(tableId3, "0", 1, "abcdef", 6, NULL, &version0);
@@ -706,6 +731,24 @@ TEST_F(RamCloudTest, writeNullValue) {
     EXPECT_EQ(0U, valueLength);
 }
 
+TEST_F(RamCloudTest, read_callerMemory) {
+    ramcloud->write(tableId1, "0", 1, "abcdef", 6);
+    char value[10];
+    uint32_t actualLength;
+    uint64_t version;
+    ramcloud->read(tableId1, "0", 1, value, sizeof32(value), &actualLength,
+            NULL, &version);
+    EXPECT_EQ(6U, actualLength);
+    EXPECT_EQ("abcdef", string(value, actualLength));
+    EXPECT_EQ(1U, version);
+
+    // The value is truncated to fit.
+    memset(value, 'x', sizeof(value));
+    ramcloud->read(tableId1, "0", 1, value, 3, &actualLength);
+    EXPECT_EQ(6U, actualLength);
+    EXPECT_EQ("abcxxx", string(value, 6));
+}
+
 TEST_F(RamCloudTest, readHashes) {
     uint64_t tableId = ramcloud->createTable("table");
     ramcloud->createIndex(tableId, 1, 0);
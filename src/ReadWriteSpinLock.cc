@@ -0,0 +1,108 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "Fence.h"
+#include "ReadWriteSpinLock.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct a ReadWriteSpinLock; it is initially free.
+ */
+ReadWriteSpinLock::ReadWriteSpinLock()
+    : state(0)
+{
+}
+
+/**
+ * Acquire the lock exclusively, spinning until all current holders have
+ * released it.
+ */
+void
+ReadWriteSpinLock::lock()
+{
+    while (true) {
+        int current = state.load();
+        if ((current & ~WRITER_WAITING) == 0) {
+            // Clearing WRITER_WAITING is safe: any other waiting writer will
+            // set it again on its next pass.
+            if (state.compareExchange(current, WRITER) == current)
+                break;
+        } else if ((current & WRITER_WAITING) == 0) {
+            state.compareExchange(current, current | WRITER_WAITING);
+        }
+    }
+    Fence::enter();
+}
+
+/**
+ * Try to acquire the lock exclusively; does not spin.
+ *
+ * \return
+ *      True if the lock was acquired, false if it was already held.
+ */
+bool
+ReadWriteSpinLock::try_lock()
+{
+    int current = state.load();
+    if ((current & ~WRITER_WAITING) != 0)
+        return false;
+    if (state.compareExchange(current, WRITER) != current)
+        return false;
+    Fence::enter();
+    return true;
+}
+
+/**
+ * Release the lock after a successful call to #lock or #try_lock.
+ */
+void
+ReadWriteSpinLock::unlock()
+{
+    Fence::leave();
+    while (true) {
+        int current = state.load();
+        if (state.compareExchange(current, current & ~WRITER) == current)
+            break;
+    }
+}
+
+/**
+ * Acquire the lock in shared mode, spinning while a writer holds the lock
+ * or is waiting for it.
+ */
+void
+ReadWriteSpinLock::lock_shared()
+{
+    while (true) {
+        int current = state.load();
+        if ((current & (WRITER | WRITER_WAITING)) == 0 &&
+                state.compareExchange(current, current + READER) == current)
+            break;
+    }
+    Fence::enter();
+}
+
+/**
+ * Release the lock after a call to #lock_shared.
+ */
+void
+ReadWriteSpinLock::unlock_shared()
+{
+    Fence::leave();
+    state.add(-READER);
+}
+
+} // end RAMCloud
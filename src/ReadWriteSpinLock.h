@@ -0,0 +1,85 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_READWRITESPINLOCK_H
+#define RAMCLOUD_READWRITESPINLOCK_H
+
+#include <mutex>
+
+#include "Atomic.h"
+#include "Common.h"
+
+namespace RAMCloud {
+
+/**
+ * A SpinLock that can be held either exclusively, by a single writer, or
+ * shared, by any number of readers. Like SpinLock, it never blocks the
+ * thread, so it should only be held for short periods. Once a writer is
+ * waiting, new readers hold off until it has had its turn, so a steady
+ * stream of readers can't starve writers.
+ *
+ * lock(), try_lock() and unlock() acquire and release the lock exclusively,
+ * so this class can be used with std::unique_lock and std::lock_guard;
+ * use SharedGuard for shared access.
+ */
+class ReadWriteSpinLock {
+  public:
+    ReadWriteSpinLock();
+    void lock();
+    bool try_lock();
+    void unlock();
+    void lock_shared();
+    void unlock_shared();
+
+    /**
+     * Acquires a ReadWriteSpinLock in shared mode on construction and
+     * releases it on destruction.
+     */
+    class SharedGuard {
+      public:
+        explicit SharedGuard(ReadWriteSpinLock& lock)
+            : lock(lock)
+        {
+            lock.lock_shared();
+        }
+        ~SharedGuard()
+        {
+            lock.unlock_shared();
+        }
+
+      PRIVATE:
+        ReadWriteSpinLock& lock;
+        DISALLOW_COPY_AND_ASSIGN(SharedGuard);
+    };
+
+  PRIVATE:
+    /// Set in #state while a writer holds the lock.
+    static const int WRITER = 1;
+
+    /// Set in #state while a writer is waiting for the lock.
+    static const int WRITER_WAITING = 2;
+
+    /// Added to #state for each reader holding the lock.
+    static const int READER = 4;
+
+    /// A combination of the values above.
+    Atomic<int> state;
+
+    DISALLOW_COPY_AND_ASSIGN(ReadWriteSpinLock);
+};
+
+} // end RAMCloud
+
+#endif  // RAMCLOUD_READWRITESPINLOCK_H
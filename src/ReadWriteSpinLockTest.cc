@@ -0,0 +1,71 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "ReadWriteSpinLock.h"
+
+namespace RAMCloud {
+
+TEST(ReadWriteSpinLockTest, exclusive) {
+    ReadWriteSpinLock lock;
+    lock.lock();
+    EXPECT_EQ(1, lock.state.load());
+    EXPECT_FALSE(lock.try_lock());
+    lock.unlock();
+    EXPECT_EQ(0, lock.state.load());
+    EXPECT_TRUE(lock.try_lock());
+    lock.unlock();
+}
+
+TEST(ReadWriteSpinLockTest, shared) {
+    ReadWriteSpinLock lock;
+    {
+        ReadWriteSpinLock::SharedGuard guard1(lock);
+        ReadWriteSpinLock::SharedGuard guard2(lock);
+        EXPECT_EQ(8, lock.state.load());
+        EXPECT_FALSE(lock.try_lock());
+    }
+    EXPECT_EQ(0, lock.state.load());
+    EXPECT_TRUE(lock.try_lock());
+    lock.unlock();
+}
+
+static void
+writer(ReadWriteSpinLock* lock, Atomic<int>* done)
+{
+    lock->lock();
+    done->store(1);
+    lock->unlock();
+}
+
+TEST(ReadWriteSpinLockTest, writerWaitsForReaders) {
+    ReadWriteSpinLock lock;
+    Atomic<int> done(0);
+    lock.lock_shared();
+    std::thread thread(writer, &lock, &done);
+
+    // Wait for the writer to announce itself; after that, it must wait
+    // for the reader to finish.
+    for (int i = 0; i < 1000 && (lock.state.load() & 2) == 0; i++)
+        usleep(1000);
+    EXPECT_EQ(6, lock.state.load());
+    EXPECT_EQ(0, done.load());
+    lock.unlock_shared();
+    thread.join();
+    EXPECT_EQ(1, done.load());
+    EXPECT_EQ(0, lock.state.load());
+}
+
+}  // namespace RAMCloud
@@ -70,6 +70,7 @@ Recovery::Recovery(Context* context,
     , context(context)
     , crashedServerId(crashedServerId)
     , masterRecoveryInfo(recoveryInfo)
+    , timeline()
     , dataToRecover()
     , tableManager(tableManager)
     , tracker(tracker)
@@ -79,12 +80,15 @@ Recovery::Recovery(Context* context,
     , recoveryTicks()
     , replicaMap()
     , numPartitions()
+    , rangePartitions()
+    , snapshotMaster()
     , successfulRecoveryMasters()
     , unsuccessfulRecoveryMasters()
     , testingBackupStartTaskSendCallback()
     , testingMasterStartTaskSendCallback()
     , testingBackupEndTaskSendCallback()
     , testingFailRecoveryMasters()
+    , streamingRanges(1)
 {
     // if the crashed master had no tablets, recovery is effectively done.
     // When this recovery gets scheduled, it will call back into
@@ -223,12 +227,15 @@ namespace {
  * Repesents a collection of tablets (a single recovery partition). This
  * structure is used internal to the partitionTablets method and is not meant
  * for use outside the method. This representation of a partition only keeps
- * track of the cumulative byteCount and recordCount of tablets assigned to it.
+ * track of the cumulative byteCount, recordCount, and expected load of
+ * tablets assigned to it.
  */
 struct Partition {
     uint64_t partitionId;    //< Id used to differentiate tablet partitions
     uint64_t byteCount;      //< Number of bytes assigned to this partition.
     uint64_t recordCount;    //< Number of records assigned to this partition.
+    double load;             //< Expected reads and writes on the partition's
+                             //< tablets after recovery (relative units).
 
     /**
      * Constructs a new partition with partitionId.
@@ -237,6 +244,7 @@ struct Partition {
         : partitionId(partitionId)
         , byteCount(0)
         , recordCount(0)
+        , load(0)
     {}
 
     /**
@@ -261,13 +269,22 @@ struct Partition {
      * \param estimate
      *      Contains the tablet's estatmated stats information that is used to
      *      determine if said tablet would fit in the partition.
+     * \param tabletLoad
+     *      Expected load on the tablet after recovery.
+     * \param maxLoad
+     *      Limit on the total expected load of a partition; 0 means no limit.
+     *      A tablet busier than this still fits in an otherwise idle
+     *      partition.
      */
-    bool fits(TableStats::Estimator::Estimate estimate) {
+    bool fits(TableStats::Estimator::Estimate estimate, double tabletLoad,
+              double maxLoad) {
         if ((byteCount + estimate.byteCount) > Recovery::PARTITION_MAX_BYTES)
             return false;
         if ((recordCount + estimate.recordCount) >
                 Recovery::PARTITION_MAX_RECORDS)
             return false;
+        if (maxLoad > 0 && load > 0 && load + tabletLoad > maxLoad)
+            return false;
         return true;
     }
 
@@ -277,12 +294,22 @@ struct Partition {
      * \param estimate
      *      Contains the estatmated stats information of the tablet that is to
      *      be assigned.
+     * \param tabletLoad
+     *      Expected load on the tablet after recovery.
      */
-    void add(TableStats::Estimator::Estimate estimate) {
+    void add(TableStats::Estimator::Estimate estimate, double tabletLoad) {
         byteCount += estimate.byteCount;
         recordCount += estimate.recordCount;
+        load += tabletLoad;
     }
 };
+
+/**
+ * How far above an even share of the crashed master's load a partition may
+ * go before busy tablets are pushed to other partitions. Some slack keeps
+ * the randomized packing below from creating many extra partitions.
+ */
+const double PARTITION_LOAD_SLACK = 1.25;
 }
 
 /**
@@ -290,6 +317,13 @@ struct Partition {
  * of bytes and number of records in each partition is limited (to ensure fast
  * crash recovery) and there are as few partitions as possible.
  *
+ * If the crashed master reported the activity on its tablets (see
+ * MasterRecoveryInfo), the expected load after recovery is balanced too:
+ * the busiest tablets are placed first, and no partition takes much more
+ * than an even share of the load across the partitions that the size
+ * limits require. That way one recovery master doesn't end up with most
+ * of the crashed master's traffic.
+ *
  * Partitions are set by serializing the tablet entry into dataToRecover and
  * setting partitionId in the entry's "user_data".
  *
@@ -324,9 +358,43 @@ Recovery::partitionTablets(vector<Tablet> tablets,
 
     splitTablets(&tablets, estimator);
 
-    // An "open" partition has been partially assigned to but is not full.
-    std::vector<Partition> openPartitions;
-    foreach (Tablet& tablet, tablets) {
+    // Order in which tablets are assigned, and each one's expected load.
+    std::vector<size_t> order;
+    std::vector<double> loads(tablets.size(), 0);
+    double totalLoad = 0;
+    uint64_t totalBytes = 0;
+    uint64_t totalRecords = 0;
+    for (size_t i = 0; i < tablets.size(); i++) {
+        order.push_back(i);
+        if (masterRecoveryInfo.tablet_load_size() == 0)
+            continue;
+        loads[i] = estimateLoad(tablets[i]);
+        totalLoad += loads[i];
+        TableStats::Estimator::Estimate stats =
+                estimator->estimate(&tablets[i]);
+        totalBytes += stats.byteCount;
+        totalRecords += stats.recordCount;
+    }
+    double maxLoad = 0;
+    if (totalLoad > 0) {
+        uint64_t sizedPartitions = std::max({1lu,
+                (totalBytes + PARTITION_MAX_BYTES - 1) / PARTITION_MAX_BYTES,
+                (totalRecords + PARTITION_MAX_RECORDS - 1) /
+                    PARTITION_MAX_RECORDS});
+        maxLoad = totalLoad / double(sizedPartitions) * PARTITION_LOAD_SLACK;
+        std::stable_sort(order.begin(), order.end(),
+            [&loads](size_t a, size_t b) {
+                return loads[a] > loads[b];
+            });
+    }
+
+    // Every partition, indexed by partition id; an "open" partition has been
+    // partially assigned to but is not full.
+    std::vector<Partition> partitions;
+    std::vector<size_t> openPartitions;
+    foreach (size_t t, order) {
+        Tablet& tablet = tablets[t];
+        TableStats::Estimator::Estimate estimate = estimator->estimate(&tablet);
         bool done = false;
         size_t numOpenPartitions = openPartitions.size();
         // From a few ramdomly selected open partitions, assign the tablet to
@@ -334,16 +402,16 @@ Recovery::partitionTablets(vector<Tablet> tablets,
         // create a new partition.
         for (size_t i = 0; i < std::min(numOpenPartitions, 5lu); i++) {
             size_t j = generateRandom() % numOpenPartitions;
-            Partition& partition = openPartitions[j];
-            if (partition.fits(estimator->estimate(&tablet))) {
-                partition.add(estimator->estimate(&tablet));
+            Partition& partition = partitions[openPartitions[j]];
+            if (partition.fits(estimate, loads[t], maxLoad)) {
+                partition.add(estimate, loads[t]);
                 ProtoBuf::Tablets::Tablet& entry =
                                             *dataToRecover.add_tablet();
                 tablet.serialize(entry);
                 entry.set_user_data(partition.partitionId);
                 // If the partition is mostly full, remove the partition
                 if (partition.usage() > 0.9) {
-                    partition = openPartitions.back();
+                    openPartitions[j] = openPartitions.back();
                     openPartitions.pop_back();
                 }
                 done = true;
@@ -353,18 +421,146 @@ Recovery::partitionTablets(vector<Tablet> tablets,
         if (!done) {
             // This tablet did not fit in any of the open partitions we tried,
             // so make a new partition.
-            Partition partition(numPartitions++);
-            partition.add(estimator->estimate(&tablet));
+            partitions.emplace_back(numPartitions++);
+            Partition& partition = partitions.back();
+            partition.add(estimate, loads[t]);
             ProtoBuf::Tablets::Tablet& entry = *dataToRecover.add_tablet();
             tablet.serialize(entry);
             entry.set_user_data(partition.partitionId);
             // If the partition still has room for more tablets, add it to the
             // available set of partitions.
             if (partition.usage() <= 0.9) {
-                openPartitions.push_back(partition);
+                openPartitions.push_back(partitions.size() - 1);
             }
         }
     }
+
+    // Placement report.
+    foreach (Partition& partition, partitions) {
+        if (totalLoad > 0) {
+            LOG(NOTICE, "Recovery partition %lu: %lu bytes, %lu records, "
+                "%.1f%% of recent reads and writes", partition.partitionId,
+                partition.byteCount, partition.recordCount,
+                100 * partition.load / totalLoad);
+        } else {
+            LOG(NOTICE, "Recovery partition %lu: %lu bytes, %lu records",
+                partition.partitionId, partition.byteCount,
+                partition.recordCount);
+        }
+    }
+}
+
+/**
+ * Divide each partition into up to #streamingRanges ranges, so that its
+ * recovery master can recover and hand over the ranges one at a time
+ * instead of all at once (see MasterService::recover()). Each range gets
+ * recovery segments of its own: its id replaces the partition id in the
+ * user_data of its tablets, which is what backups divide replicas by, and
+ * #rangePartitions records which partition it belongs to.
+ *
+ * A partition's tablets are assigned to ranges in key hash order, with
+ * about the same number of tablets in each range. Tablets backing indexlets
+ * all go in the partition's last range, since an indexlet can't be served
+ * until all of it has been recovered.
+ */
+void
+Recovery::divideIntoRanges()
+{
+    // Indexes in dataToRecover of each partition's tablets.
+    vector<vector<int>> tablets(numPartitions);
+    vector<vector<int>> backingTablets(numPartitions);
+    for (int i = 0; i < dataToRecover.tablet_size(); i++) {
+        const ProtoBuf::Tablets::Tablet& tablet = dataToRecover.tablet(i);
+        if (tableManager->isIndexletTable(tablet.table_id()))
+            backingTablets[tablet.user_data()].push_back(i);
+        else
+            tablets[tablet.user_data()].push_back(i);
+    }
+
+    rangePartitions.clear();
+    for (uint32_t partitionId = 0; partitionId < numPartitions;
+            partitionId++) {
+        vector<int>& indexes = tablets[partitionId];
+        std::sort(indexes.begin(), indexes.end(),
+            [this](int a, int b) {
+                const ProtoBuf::Tablets::Tablet& x = dataToRecover.tablet(a);
+                const ProtoBuf::Tablets::Tablet& y = dataToRecover.tablet(b);
+                return std::make_pair(x.table_id(), x.start_key_hash()) <
+                       std::make_pair(y.table_id(), y.start_key_hash());
+            });
+        uint64_t firstRange = rangePartitions.size();
+        uint64_t numRanges = std::max(1lu,
+                std::min(uint64_t(streamingRanges), indexes.size()));
+        for (size_t i = 0; i < indexes.size(); i++) {
+            dataToRecover.mutable_tablet(indexes[i])->set_user_data(
+                    firstRange + i * numRanges / indexes.size());
+        }
+        foreach (int index, backingTablets[partitionId]) {
+            dataToRecover.mutable_tablet(index)->set_user_data(
+                    firstRange + numRanges - 1);
+        }
+        for (uint64_t i = 0; i < numRanges; i++)
+            rangePartitions.push_back(partitionId);
+    }
+    LOG(NOTICE, "Divided %u partitions into %lu ranges for streaming "
+        "recovery", numPartitions, rangePartitions.size());
+}
+
+/**
+ * Return the expected load on a tablet after recovery: the number of reads
+ * and writes on it in the crashed master's last report of tablet activity
+ * (see MasterRecoveryInfo). Reported tablets that only partly overlap
+ * \a tablet (e.g. because splitTablets() split them) contribute in
+ * proportion to the overlap, assuming accesses are spread evenly across
+ * key hashes.
+ *
+ * \param tablet
+ *      Tablet whose load is estimated.
+ * \return
+ *      Expected load, in reads and writes per report interval; 0 if the
+ *      master didn't report any activity on the tablet.
+ */
+double
+Recovery::estimateLoad(const Tablet& tablet)
+{
+    double load = 0;
+    foreach (const ProtoBuf::MasterRecoveryInfo::TabletLoad& entry,
+             masterRecoveryInfo.tablet_load()) {
+        if (entry.table_id() != tablet.tableId)
+            continue;
+        uint64_t start = std::max(entry.start_key_hash(), tablet.startKeyHash);
+        uint64_t end = std::min(entry.end_key_hash(), tablet.endKeyHash);
+        if (start > end)
+            continue;
+        double fraction = (double(end - start) + 1) /
+                (double(entry.end_key_hash() - entry.start_key_hash()) + 1);
+        load += fraction * double(entry.read_count() + entry.write_count());
+    }
+    return load;
+}
+
+/**
+ * Find a master that can recover the crashed master from a snapshot of its
+ * log: one that enlisted as its replacement after a planned restart (see
+ * MasterSnapshot) and isn't already a recovery master.
+ *
+ * \return
+ *      The master, or an invalid id if there is none.
+ */
+ServerId
+Recovery::findSnapshotMaster()
+{
+    if (owner == NULL)
+        return ServerId();
+    ServerId replacement = owner->getReplacement(crashedServerId);
+    if (!replacement.isValid())
+        return ServerId();
+    foreach (ServerId master,
+            tracker->getServersWithService(WireFormat::MASTER_SERVICE)) {
+        if ((master == replacement) && !(*tracker)[master])
+            return master;
+    }
+    return ServerId();
 }
 
 /**
@@ -395,9 +591,11 @@ Recovery::performTask()
     case START_RECOVERY_ON_BACKUPS:
         LOG(NOTICE, "Starting recovery %lu for crashed server %s",
             recoveryId, crashedServerId.toString().c_str());
+        timeline.startPhase(RecoveryTimeline::START_BACKUPS);
         startBackups();
         break;
     case START_RECOVERY_MASTERS:
+        timeline.startPhase(RecoveryTimeline::START_RECOVERY_MASTERS);
         startRecoveryMasters();
         break;
     case WAIT_FOR_RECOVERY_MASTERS:
@@ -419,8 +617,11 @@ Recovery::performTask()
         // when metrics are fetched.
 #define BCAST_INLINE 0
 #if !BCAST_INLINE
+        timeline.startPhase(RecoveryTimeline::NOTIFY_BACKUPS);
         broadcastRecoveryComplete();
 #endif
+        timeline.finish();
+        LOG(NOTICE, "%s", timeline.report(recoveryId, crashedServerId).c_str());
         status = DONE;
         if (owner)
             owner->recoveryFinished(this);
@@ -455,6 +656,16 @@ Recovery::getRecoveryId() const
     return recoveryId;
 }
 
+/**
+ * Returns true if \a serverId is a recovery master for this recovery that
+ * hasn't yet reported finishing its partition.
+ */
+bool
+Recovery::isRecoveryMaster(ServerId serverId) const
+{
+    return (*tracker)[serverId] == this;
+}
+
 // - private -
 
 namespace RecoveryInternal {
@@ -899,6 +1110,20 @@ Recovery::startBackups()
     /* Broadcast 2: partition replicas into tablets for recovery masters */
     TableStats::Estimator estimator(tableStats);
     partitionTablets(tablets, &estimator);
+    snapshotMaster = findSnapshotMaster();
+    if (snapshotMaster.isValid()) {
+        // The restarted master has most of the data locally, so splitting
+        // the tablets among recovery masters would only make the others
+        // read it all from backups.
+        LOG(NOTICE, "Master %s has a snapshot of crashed master %s; it will "
+            "recover all of the tablets", snapshotMaster.toString().c_str(),
+            crashedServerId.toString().c_str());
+        for (int i = 0; i < dataToRecover.tablet_size(); i++)
+            dataToRecover.mutable_tablet(i)->set_user_data(0);
+        numPartitions = 1;
+    } else if (streamingRanges > 1) {
+        divideIntoRanges();
+    }
     LOG(NOTICE, "Partition Scheme for Recovery:\n%s",
                 dataToRecover.DebugString().c_str());
 
@@ -1013,6 +1238,11 @@ Recovery::startRecoveryMasters()
     std::vector<ServerId> masters =
         tracker->getServersWithService(WireFormat::MASTER_SERVICE);
     std::random_shuffle(masters.begin(), masters.end(), randomNumberGenerator);
+    if (snapshotMaster.isValid()) {
+        auto it = std::find(masters.begin(), masters.end(), snapshotMaster);
+        if (it != masters.end())
+            std::iter_swap(masters.begin(), it);
+    }
     uint32_t started = 0;
     Tub<MasterStartTask> recoverTasks[numPartitions];
     foreach (ServerId master, masters) {
@@ -1042,7 +1272,10 @@ Recovery::startRecoveryMasters()
     // Hand out each tablet to one of the recovery masters depending on
     // which partition it was in.
     foreach (auto& tablet, dataToRecover.tablet()) {
-        auto& task = recoverTasks[tablet.user_data()];
+        uint64_t partitionId = tablet.user_data();
+        if (!rangePartitions.empty())
+            partitionId = rangePartitions[partitionId];
+        auto& task = recoverTasks[partitionId];
         if (task) {
             *task->dataToRecover.add_tablet() = tablet;
             if (tableManager->isIndexletTable(tablet.table_id())) {
@@ -1059,6 +1292,7 @@ Recovery::startRecoveryMasters()
 
     // Tell the recovery masters to begin recovery.
     parallelRun(recoverTasks, numPartitions, 10);
+    timeline.startPhase(RecoveryTimeline::RECOVERY_MASTERS);
 
     // If all of the recovery masters failed to get off to a start then
     // skip waiting for them.
@@ -1155,7 +1389,9 @@ struct BackupEndTask {
         if (!rpc)
             return;
         try {
-            rpc->wait();
+            WireFormat::BackupRecoveryComplete::Response times;
+            rpc->wait(&times);
+            recovery.timeline.addBackup(serverId, times);
         } catch (const ServerNotUpException& e) {
             LOG(DEBUG, "recoveryComplete failed on %s, ignoring; "
                 "server no longer in the servers list",
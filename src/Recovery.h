@@ -27,6 +27,7 @@
 #include "ServerTracker.h"
 #include "TableManager.h"
 #include "RecoveryPartition.pb.h"
+#include "RecoveryTimeline.h"
 #include "TaskQueue.h"
 #include "TableStats.h"
 
@@ -137,6 +138,12 @@ class Recovery : public Task {
      */
     struct Owner {
         virtual void recoveryFinished(Recovery* recovery) {}
+        /// Return the master that was restarted from a snapshot of the
+        /// log of \a crashedServerId (see MasterSnapshot), if any.
+        virtual ServerId getReplacement(ServerId crashedServerId)
+        {
+            return ServerId();
+        }
         virtual ~Owner() {}
     };
     Recovery(Context* context,
@@ -154,6 +161,7 @@ class Recovery : public Task {
     bool isDone() const;
     bool wasCompletelySuccessful() const;
     uint64_t getRecoveryId() const;
+    bool isRecoveryMaster(ServerId serverId) const;
 
     /// Shared RAMCloud information.
     Context* context;
@@ -173,6 +181,13 @@ class Recovery : public Task {
      */
     const ProtoBuf::MasterRecoveryInfo masterRecoveryInfo;
 
+    /**
+     * Time spent in each phase of this recovery on the coordinator, the
+     * recovery masters, and the backups; reported once the recovery is
+     * over.
+     */
+    RecoveryTimeline timeline;
+
     /// Defines max number of bytes a tablet partition should accommodate.
     static const uint64_t PARTITION_MAX_BYTES = 500*1024*1024;
     /// Defines the max number of records a tablet partition should accommodate.
@@ -183,6 +198,9 @@ class Recovery : public Task {
                       TableStats::Estimator* estimator);
     void partitionTablets(vector<Tablet> tablets,
                           TableStats::Estimator* estimator);
+    double estimateLoad(const Tablet& tablet);
+    void divideIntoRanges();
+    ServerId findSnapshotMaster();
     void startBackups();
     void startRecoveryMasters();
     void broadcastRecoveryComplete();
@@ -262,6 +280,22 @@ class Recovery : public Task {
      */
     uint32_t numPartitions;
 
+    /**
+     * If the partitions were divided into ranges for streaming recovery
+     * (see divideIntoRanges()), the partition that each range belongs to,
+     * indexed by range id. In that case the user_data of the tablets in
+     * #dataToRecover holds range ids rather than partition ids. Empty if
+     * the partitions weren't divided.
+     */
+    vector<uint32_t> rangePartitions;
+
+    /**
+     * If valid, a master that was restarted from a snapshot of the crashed
+     * master's log and so can recover most of its data without reading it
+     * from backups; it recovers all of the tablets as a single partition.
+     */
+    ServerId snapshotMaster;
+
     /**
      * Number of recovery masters which have completed (as part of the
      * WAIT_FOR_RECOVERY_MASTERS phase) and successfully recovered
@@ -310,6 +344,15 @@ class Recovery : public Task {
      */
     uint32_t testingFailRecoveryMasters;
 
+    /**
+     * Divide each recovery master's partition into up to this many ranges
+     * that it recovers and hands over one at a time, so that clients can
+     * use the first ranges while the rest are still being recovered. 1
+     * recovers each partition all at once. Comes from the coordinator's
+     * RuntimeOptions.
+     */
+    uint32_t streamingRanges;
+
     friend class RecoveryInternal::BackupStartTask;
     friend class RecoveryInternal::BackupStartPartitionTask;
     friend class RecoveryInternal::MasterStartTask;
@@ -460,6 +460,29 @@ try
                     metricIt->second);
         }
     }
+
+    // Summarize how well segment replay scaled on each recovery master:
+    // the time all of its replay threads spent in replaySegment, relative
+    // to the elapsed replay time, is the parallelism it achieved.
+    for (ClusterMetrics::iterator serverIt = diff.begin();
+            serverIt != diff.end(); serverIt++) {
+        ServerMetrics &server = serverIt->second;
+        uint64_t recoveries = server["master.recoveryCount"];
+        uint64_t replayTicks = server["master.replayTicks"];
+        if (recoveries == 0 || replayTicks == 0)
+            continue;
+        double threads = static_cast<double>(
+                server["master.replayThreadCount"]) /
+                static_cast<double>(recoveries);
+        double parallelism = static_cast<double>(
+                server["master.recoverSegmentTicks"]) /
+                static_cast<double>(replayTicks);
+        LOG(NOTICE, "Replay on %s: %.1f ms with %.0f threads, parallelism "
+                "%.2f (%.0f%% efficiency)", serverIt->first.c_str(),
+                1e03 * static_cast<double>(replayTicks) /
+                static_cast<double>(server["clockFrequency"]),
+                threads, parallelism, 100 * parallelism / threads);
+    }
     client.serverControlAll(WireFormat::ControlOp::QUIESCE);
 
     return 0;
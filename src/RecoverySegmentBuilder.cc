@@ -239,6 +239,78 @@ RecoverySegmentBuilder::extractDigest(const void* buffer, uint32_t length,
     return foundDigest;
 }
 
+/**
+ * Check the checksum of a log entry that may end up in a recovery segment.
+ * Used both by backups that verify the recovery segments they build (see
+ * verifyEntries) and by recovery masters that check entries ahead of replay.
+ *
+ * \param type
+ *      Type of the entry in \a buffer.
+ * \param buffer
+ *      The whole of the entry.
+ * \return
+ *      False if the entry carries a checksum and it doesn't match the
+ *      entry's contents, otherwise true. Entries of types without a
+ *      checksum of their own are always considered intact.
+ */
+bool
+RecoverySegmentBuilder::isEntryIntact(LogEntryType type, Buffer& buffer)
+{
+    switch (type) {
+    case LOG_ENTRY_TYPE_OBJ:
+        return Object(buffer).checkIntegrity();
+    case LOG_ENTRY_TYPE_OBJTOMB:
+        return ObjectTombstone(buffer).checkIntegrity();
+    case LOG_ENTRY_TYPE_SAFEVERSION:
+        return ObjectSafeVersion(buffer).checkIntegrity();
+    case LOG_ENTRY_TYPE_RPCRESULT:
+        return RpcResult(buffer).checkIntegrity();
+    case LOG_ENTRY_TYPE_PREP:
+        return PreparedOp(buffer, 0, buffer.size()).checkIntegrity();
+    case LOG_ENTRY_TYPE_PREPTOMB:
+        return PreparedOpTombstone(buffer, 0).checkIntegrity();
+    case LOG_ENTRY_TYPE_TXDECISION:
+        return TxDecisionRecord(buffer).checkIntegrity();
+    case LOG_ENTRY_TYPE_TXPLIST:
+        return ParticipantList(buffer).checkIntegrity();
+    default:
+        return true;
+    }
+}
+
+/**
+ * Check the checksum of every entry in a set of recovery segments created by
+ * build(). Backups that do this let recovery masters replay the segments
+ * without checking the entries again (see MasterService::recover), so long
+ * as the segments' certificates show they arrived intact.
+ *
+ * \param recoverySegments
+ *      Array of \a numPartitions recovery segments filled in by build().
+ * \param numPartitions
+ *      Number of segments in \a recoverySegments.
+ * \throw SegmentRecoveryFailedException
+ *      If any entry's checksum doesn't match its contents; the recovery
+ *      master should get the segment from another replica.
+ */
+void
+RecoverySegmentBuilder::verifyEntries(Segment* recoverySegments,
+                                      int numPartitions)
+{
+    for (int i = 0; i < numPartitions; i++) {
+        for (SegmentIterator it(recoverySegments[i]); !it.isDone(); it.next()) {
+            Buffer buffer;
+            it.appendToBuffer(buffer);
+            if (!isEntryIntact(it.getType(), buffer)) {
+                LOG(WARNING, "Bad checksum on %s entry at offset %u of "
+                    "recovery segment for partition %d",
+                    LogEntryTypeHelpers::toString(it.getType()),
+                    it.getOffset(), i);
+                throw SegmentRecoveryFailedException(HERE);
+            }
+        }
+    }
+}
+
 // - private -
 
 /**
@@ -49,6 +49,8 @@ class RecoverySegmentBuilder {
     static bool extractDigest(const void* buffer, uint32_t length,
                               const SegmentCertificate& certificate,
                               Buffer* digestBuffer, Buffer* tableStatsBuffer);
+    static bool isEntryIntact(LogEntryType type, Buffer& buffer);
+    static void verifyEntries(Segment* recoverySegments, int numPartitions);
   PRIVATE:
     static bool isEntryAlive(const LogPosition& position,
                              const ProtoBuf::Tablets::Tablet* tablet);
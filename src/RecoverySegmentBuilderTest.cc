@@ -373,6 +373,56 @@ TEST_F(RecoverySegmentBuilderTest, extractDigest) {
     EXPECT_EQ(0u, digestBuffer.size());
 }
 
+TEST_F(RecoverySegmentBuilderTest, isEntryIntact) {
+    Key key(1, "1", 1);
+    Buffer dataBuffer;
+    Object object(key, "hello", 6, 0, 0, dataBuffer);
+    Buffer buffer;
+    object.assembleForLog(buffer);
+    EXPECT_TRUE(RecoverySegmentBuilder::isEntryIntact(LOG_ENTRY_TYPE_OBJ,
+                                                      buffer));
+
+    // Flip a byte of the value.
+    char corrupt[buffer.size()];
+    buffer.copy(0, buffer.size(), corrupt);
+    corrupt[buffer.size() - 2] ^= 1;
+    Buffer corruptBuffer;
+    corruptBuffer.appendExternal(corrupt, buffer.size());
+    EXPECT_FALSE(RecoverySegmentBuilder::isEntryIntact(LOG_ENTRY_TYPE_OBJ,
+                                                       corruptBuffer));
+
+    // Types without checksums of their own are never corrupt.
+    EXPECT_TRUE(RecoverySegmentBuilder::isEntryIntact(
+            LOG_ENTRY_TYPE_SEGHEADER, corruptBuffer));
+}
+
+TEST_F(RecoverySegmentBuilderTest, verifyEntries) {
+    Key key(1, "1", 1);
+    Buffer dataBuffer;
+    Object object(key, "hello", 6, 0, 0, dataBuffer);
+    Buffer buffer;
+    object.assembleForLog(buffer);
+
+    std::unique_ptr<Segment[]> recoverySegments(new Segment[2]);
+    ASSERT_TRUE(recoverySegments[0].append(LOG_ENTRY_TYPE_OBJ, buffer));
+    ASSERT_TRUE(recoverySegments[1].append(LOG_ENTRY_TYPE_OBJ, buffer));
+    RecoverySegmentBuilder::verifyEntries(recoverySegments.get(), 2);
+
+    char corrupt[buffer.size()];
+    buffer.copy(0, buffer.size(), corrupt);
+    corrupt[buffer.size() - 2] ^= 1;
+    buffer.reset();
+    buffer.appendExternal(corrupt, sizeof32(corrupt));
+    ASSERT_TRUE(recoverySegments[1].append(LOG_ENTRY_TYPE_OBJ, buffer));
+    TestLog::Enable _;
+    EXPECT_THROW(RecoverySegmentBuilder::verifyEntries(recoverySegments.get(),
+                                                       2),
+                 SegmentRecoveryFailedException);
+    EXPECT_EQ("verifyEntries: Bad checksum on Object entry at "
+              "offset 36 of recovery segment for partition 1",
+              TestLog::get());
+}
+
 TEST_F(RecoverySegmentBuilderTest, isEntryAlive) {
     auto isEntryAlive = RecoverySegmentBuilder::isEntryAlive;
     // Tablet's creation time log position was (12741, 57273)
@@ -728,6 +728,123 @@ TEST_F(RecoveryTest, partitionTablets_mixed) {
     EXPECT_EQ(6lu, recovery->numPartitions);
 }
 
+TEST_F(RecoveryTest, partitionTablets_load) {
+    // Four tablets, each 30% of a partition, need two partitions; the two
+    // busy ones should be split between them.
+    Lock lock(mutex);     // To trick TableManager internal calls.
+    Tub<Recovery> recovery;
+    Recovery::Owner* own = static_cast<Recovery::Owner*>(NULL);
+    for (uint64_t i = 1; i <= 4; i++) {
+        tableManager.testCreateTable(TestUtil::toString(i).c_str(), i);
+        tableManager.testAddTablet(
+            {i,  0,  9, {99, 0}, Tablet::RECOVERING, {}});
+    }
+    for (uint64_t i = 1; i <= 2; i++) {
+        ProtoBuf::MasterRecoveryInfo::TabletLoad& load =
+                *recoveryInfo.add_tablet_load();
+        load.set_table_id(i);
+        load.set_start_key_hash(0);
+        load.set_end_key_hash(9);
+        load.set_read_count(90);
+        load.set_write_count(10);
+    }
+    recovery.construct(&context, taskQueue, &tableManager, &tracker, own,
+                       ServerId(99), recoveryInfo);
+    vector<Tablet> tablets =
+                        tableManager.markAllTabletsRecovering(ServerId(99));
+    std::sort(tablets.begin(), tablets.end(), tabletComp);
+
+    char buffer[sizeof(TableStats::DigestHeader) +
+                0 * sizeof(TableStats::DigestEntry)];
+    TableStats::Digest* digest = reinterpret_cast<TableStats::Digest*>(buffer);
+    digest->header.entryCount = 0;
+    digest->header.otherBytesPerKeyHash = (0.3 / 10)
+                                          * Recovery::PARTITION_MAX_BYTES;
+    digest->header.otherRecordsPerKeyHash = (0.3 / 10)
+                                            * Recovery::PARTITION_MAX_RECORDS;
+
+    TableStats::Estimator e(digest);
+
+    recovery->partitionTablets(tablets, &e);
+    EXPECT_EQ(2lu, recovery->numPartitions);
+    std::map<uint64_t, uint64_t> partitionOf;
+    foreach (const ProtoBuf::Tablets::Tablet& tablet,
+             recovery->dataToRecover.tablet()) {
+        partitionOf[tablet.table_id()] = tablet.user_data();
+    }
+    EXPECT_NE(partitionOf[1], partitionOf[2]);
+}
+
+TEST_F(RecoveryTest, estimateLoad) {
+    Tub<Recovery> recovery;
+    Recovery::Owner* own = static_cast<Recovery::Owner*>(NULL);
+    ProtoBuf::MasterRecoveryInfo::TabletLoad* load =
+            recoveryInfo.add_tablet_load();
+    load->set_table_id(1);
+    load->set_start_key_hash(0);
+    load->set_end_key_hash(99);
+    load->set_read_count(150);
+    load->set_write_count(50);
+    load = recoveryInfo.add_tablet_load();
+    load->set_table_id(2);
+    load->set_start_key_hash(0);
+    load->set_end_key_hash(~0lu);
+    load->set_read_count(10);
+    recovery.construct(&context, taskQueue, &tableManager, &tracker, own,
+                       ServerId(99), recoveryInfo);
+
+    Tablet tablet({1, 0, 99, {99, 0}, Tablet::RECOVERING, {}});
+    EXPECT_DOUBLE_EQ(200, recovery->estimateLoad(tablet));
+    tablet.endKeyHash = 49;           // Half of the reported range.
+    EXPECT_DOUBLE_EQ(100, recovery->estimateLoad(tablet));
+    tablet.startKeyHash = 100;        // No overlap.
+    tablet.endKeyHash = 200;
+    EXPECT_DOUBLE_EQ(0, recovery->estimateLoad(tablet));
+    tablet = {2, 0, ~0lu, {99, 0}, Tablet::RECOVERING, {}};
+    EXPECT_DOUBLE_EQ(10, recovery->estimateLoad(tablet));
+    tablet = {3, 0, ~0lu, {99, 0}, Tablet::RECOVERING, {}};
+    EXPECT_DOUBLE_EQ(0, recovery->estimateLoad(tablet));
+}
+
+TEST_F(RecoveryTest, divideIntoRanges) {
+    Lock lock(mutex);     // To trick TableManager internal calls.
+    tableManager.testCreateTable("t", 123);
+    tableManager.testAddTablet({123, 30, 39, {99, 0}, Tablet::RECOVERING, {}});
+    tableManager.testAddTablet({123,  0,  9, {99, 0}, Tablet::RECOVERING, {}});
+    tableManager.testAddTablet({123, 20, 29, {99, 0}, Tablet::RECOVERING, {}});
+    tableManager.testAddTablet({123, 10, 19, {99, 0}, Tablet::RECOVERING, {}});
+    tableManager.testCreateTable("u", 124);
+    tableManager.testAddTablet({124,  0, 99, {99, 0}, Tablet::RECOVERING, {}});
+    tableManager.testCreateTable("__backingTable:123:1:0", 3);
+    tableManager.testAddTablet({3,  0,  ~0UL, {99, 0}, Tablet::RECOVERING, {}});
+    tableManager.createIndex(123, 1, 0, 1);
+    Recovery recovery(&context, taskQueue, &tableManager, &tracker, NULL,
+                      {99, 0}, recoveryInfo);
+    recovery.partitionTablets(
+                tableManager.markAllTabletsRecovering({99, 0}), NULL);
+    // Put table 124 in partition 1 and everything else in partition 0.
+    foreach (ProtoBuf::Tablets::Tablet& tablet,
+             *recovery.dataToRecover.mutable_tablet()) {
+        tablet.set_user_data(tablet.table_id() == 124 ? 1 : 0);
+    }
+    recovery.numPartitions = 2;
+    recovery.streamingRanges = 2;
+    recovery.divideIntoRanges();
+
+    std::map<std::pair<uint64_t, uint64_t>, uint64_t> rangeOf;
+    foreach (const ProtoBuf::Tablets::Tablet& tablet,
+             recovery.dataToRecover.tablet()) {
+        rangeOf[{tablet.table_id(), tablet.start_key_hash()}] =
+                tablet.user_data();
+    }
+    EXPECT_EQ(0lu, (rangeOf[{123, 0}]));
+    EXPECT_EQ(0lu, (rangeOf[{123, 10}]));
+    EXPECT_EQ(1lu, (rangeOf[{123, 20}]));
+    EXPECT_EQ(1lu, (rangeOf[{123, 30}]));
+    EXPECT_EQ(1lu, (rangeOf[{3, 0}]));
+    EXPECT_EQ(2lu, (rangeOf[{124, 0}]));
+    EXPECT_EQ((vector<uint32_t>{0, 0, 1}), recovery.rangePartitions);
+}
 
 TEST_F(RecoveryTest, startBackups) {
     /**
@@ -1272,6 +1389,51 @@ TEST_F(RecoveryTest, recoveryMasterFinished) {
     EXPECT_EQ(Recovery::ALL_RECOVERY_MASTERS_FINISHED, recovery.status);
 }
 
+TEST_F(RecoveryTest, startRecoveryMasters_ranges) {
+    // Both ranges of partition 0 should go to the same recovery master.
+    struct Cb : public MasterStartTaskTestingCallback {
+        int callCount;
+        Cb() : callCount() {}
+        void masterStartTaskSend(uint64_t recoveryId,
+            ServerId crashedServerId, uint32_t partitionId,
+            const ProtoBuf::RecoveryPartition& recoveryPartition,
+            const WireFormat::Recover::Replica replicaMap[],
+            size_t replicaMapSize)
+        {
+            EXPECT_EQ(0u, partitionId);
+            EXPECT_EQ(2, recoveryPartition.tablet_size());
+            ++callCount;
+        }
+    } callback;
+    Lock lock(mutex);     // To trick TableManager internal calls.
+    addServersToTracker(2, {WireFormat::MASTER_SERVICE});
+    tableManager.testCreateTable("t", 123);
+    tableManager.testAddTablet({123,  0,  9, {99, 0}, Tablet::RECOVERING, {}});
+    tableManager.testAddTablet({123, 10, 19, {99, 0}, Tablet::RECOVERING, {}});
+    Recovery recovery(&context, taskQueue, &tableManager, &tracker, NULL,
+                      {99, 0}, recoveryInfo);
+    recovery.partitionTablets(
+                tableManager.markAllTabletsRecovering({99, 0}), NULL);
+    recovery.dataToRecover.mutable_tablet(0)->set_user_data(0);
+    recovery.dataToRecover.mutable_tablet(1)->set_user_data(1);
+    recovery.numPartitions = 1;
+    recovery.rangePartitions = {0, 0};
+    recovery.testingMasterStartTaskSendCallback = &callback;
+    recovery.startRecoveryMasters();
+    EXPECT_EQ(1, callback.callCount);
+}
+
+TEST_F(RecoveryTest, isRecoveryMaster) {
+    addServersToTracker(3, {WireFormat::MASTER_SERVICE});
+    Recovery recovery(&context, taskQueue, &tableManager, &tracker, NULL,
+                      {99, 0}, recoveryInfo);
+    tracker[ServerId(2, 0)] = &recovery;
+    EXPECT_FALSE(recovery.isRecoveryMaster({1, 0}));
+    EXPECT_TRUE(recovery.isRecoveryMaster({2, 0}));
+    tracker[ServerId(2, 0)] = NULL;
+    EXPECT_FALSE(recovery.isRecoveryMaster({2, 0}));
+}
+
 TEST_F(RecoveryTest, broadcastRecoveryComplete) {
     addServersToTracker(3, {WireFormat::BACKUP_SERVICE});
     struct Cb : public BackupEndTaskTestingCallback {
@@ -0,0 +1,247 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <algorithm>
+#include <utility>
+
+#include "Cycles.h"
+#include "RecoveryTimeline.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct a RecoveryTimeline; the QUEUED phase starts now.
+ */
+RecoveryTimeline::RecoveryTimeline()
+    : phaseStart()
+    , end(0)
+    , recoveryMasters()
+    , backups()
+{
+    startPhase(QUEUED);
+}
+
+/**
+ * Record that a phase of the recovery has started, which ends the phase
+ * before it. Phases may be skipped but must start in order.
+ *
+ * \param phase
+ *      The phase that is starting.
+ */
+void
+RecoveryTimeline::startPhase(Phase phase)
+{
+    phaseStart[phase] = Cycles::rdtsc();
+}
+
+/**
+ * Record that the last phase of the recovery has ended.
+ */
+void
+RecoveryTimeline::finish()
+{
+    end = Cycles::rdtsc();
+}
+
+/**
+ * Record that a recovery master has finished its part of the recovery.
+ *
+ * \param serverId
+ *      The recovery master.
+ * \param successful
+ *      Whether it recovered its partition.
+ * \param recoveryPartition
+ *      The partition it reported, which holds its timeline (recovery masters
+ *      that fail before reporting don't have one).
+ * \param handoffCycles
+ *      Time (in Cycles::rdtsc ticks) the coordinator took to assign the
+ *      recovered tablets to the recovery master.
+ */
+void
+RecoveryTimeline::addRecoveryMaster(ServerId serverId, bool successful,
+        const ProtoBuf::RecoveryPartition& recoveryPartition,
+        uint64_t handoffCycles)
+{
+    uint64_t finishedCycles = 0;
+    if (phaseStart[RECOVERY_MASTERS] != 0)
+        finishedCycles = Cycles::rdtsc() - phaseStart[RECOVERY_MASTERS];
+    recoveryMasters.emplace_back(serverId, successful,
+            recoveryPartition.timeline(), finishedCycles, handoffCycles);
+}
+
+/**
+ * Record how long a backup took to prepare the crashed master's data.
+ *
+ * \param serverId
+ *      The backup.
+ * \param times
+ *      The backup's response to the recoveryComplete RPC.
+ */
+void
+RecoveryTimeline::addBackup(ServerId serverId,
+        const WireFormat::BackupRecoveryComplete::Response& times)
+{
+    if (times.primaryReplicas == 0)
+        return;
+    backups.emplace_back(serverId, times);
+}
+
+/**
+ * Return the length of one of the coordinator's phases, in Cycles::rdtsc
+ * ticks, or 0 if it never started.
+ */
+uint64_t
+RecoveryTimeline::getPhaseCycles(Phase phase) const
+{
+    if (phaseStart[phase] == 0)
+        return 0;
+    uint64_t next = end;
+    for (int i = phase + 1; i < PHASE_COUNT; i++) {
+        if (phaseStart[i] != 0) {
+            next = phaseStart[i];
+            break;
+        }
+    }
+    if (next < phaseStart[phase])
+        return 0;
+    return next - phaseStart[phase];
+}
+
+/**
+ * Return a human-readable report on a finished recovery: how long each
+ * phase took, the phases of the recovery master that finished last and of
+ * the slowest backup, and which single step on the critical path took the
+ * most time.
+ *
+ * \param recoveryId
+ *      The recovery's id, for the report.
+ * \param crashedServerId
+ *      The crashed master, for the report.
+ */
+string
+RecoveryTimeline::report(uint64_t recoveryId, ServerId crashedServerId) const
+{
+    static const char* phaseNames[PHASE_COUNT] = {
+        "Queued",
+        "Starting backups",
+        "Starting recovery masters",
+        "Running recovery masters",
+        "Notifying backups",
+    };
+    double totalMs = 0;
+    for (int i = 0; i < PHASE_COUNT; i++)
+        totalMs += Cycles::toSeconds(getPhaseCycles(Phase(i))) * 1e03;
+
+    // The recovery master that finished last is on the critical path.
+    const RecoveryMaster* slowest = NULL;
+    foreach (const RecoveryMaster& master, recoveryMasters) {
+        if ((slowest == NULL) ||
+                (master.finishedCycles > slowest->finishedCycles))
+            slowest = &master;
+    }
+
+    // The backup that finished filtering last is the one most likely to
+    // have held up the recovery masters.
+    const Backup* slowestBackup = NULL;
+    foreach (const Backup& backup, backups) {
+        if ((slowestBackup == NULL) ||
+                (backup.times.partitionWaitMicros +
+                backup.times.filterDoneMicros >
+                slowestBackup->times.partitionWaitMicros +
+                slowestBackup->times.filterDoneMicros))
+            slowestBackup = &backup;
+    }
+
+    // Each step on the critical path, in the order they happen.
+    std::vector<std::pair<string, double>> steps;
+    string result = format("Recovery %lu of crashed server %s took %.1f ms "
+            "(%lu recovery masters, %lu backups)\n", recoveryId,
+            crashedServerId.toString().c_str(), totalMs,
+            recoveryMasters.size(), backups.size());
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        double ms = Cycles::toSeconds(getPhaseCycles(Phase(i))) * 1e03;
+        result.append(format("  %-36s %8.1f ms\n", phaseNames[i], ms));
+        if ((i != RECOVERY_MASTERS) || (slowest == NULL)) {
+            steps.emplace_back(phaseNames[i], ms);
+            continue;
+        }
+
+        const ProtoBuf::RecoveryMasterTimeline& t = slowest->timeline;
+        double handoffMs = Cycles::toSeconds(slowest->handoffCycles) * 1e03;
+        double masterMs = static_cast<double>(t.total_micros()) * 1e-03;
+        std::pair<string, double> masterSteps[] = {
+            {"Waiting for recovery segments",
+                    static_cast<double>(t.segment_wait_micros()) * 1e-03},
+            {"Replaying recovery segments",
+                    static_cast<double>(t.replay_micros()) * 1e-03},
+            {"Replicating recovered data",
+                    static_cast<double>(t.replication_micros()) * 1e-03},
+            {"Handing off ranges early",
+                    static_cast<double>(t.handoff_micros()) * 1e-03},
+            {"Other work on recovery master", 0},
+            {"Updating the tablet map", handoffMs},
+            {"RPCs and waiting to start", 0},
+        };
+        double other = masterMs;
+        for (int j = 0; j < 4; j++)
+            other -= masterSteps[j].second;
+        masterSteps[4].second = std::max(0.0, other);
+        masterSteps[6].second = std::max(0.0,
+                Cycles::toSeconds(slowest->finishedCycles) * 1e03 -
+                masterMs - handoffMs);
+        result.append(format("    Slowest recovery master was %s%s, "
+                "replayed %lu segments (%.1f MB)\n",
+                slowest->serverId.toString().c_str(),
+                slowest->successful ? "" : " (failed)", t.segments(),
+                static_cast<double>(t.segment_bytes()) * 1e-06));
+        for (auto& step : masterSteps) {
+            result.append(format("    %-34s %8.1f ms\n",
+                    step.first.c_str(), step.second));
+            steps.push_back(step);
+        }
+    }
+
+    if (slowestBackup != NULL) {
+        const WireFormat::BackupRecoveryComplete::Response& b =
+                slowestBackup->times;
+        result.append(format("  Slowest backup was %s: partitions arrived "
+                "after %.1f ms, filtered %u primary replicas in %.1f ms "
+                "(%.1f ms of filtering)\n",
+                slowestBackup->serverId.toString().c_str(),
+                static_cast<double>(b.partitionWaitMicros) * 1e-03,
+                b.primaryReplicas,
+                static_cast<double>(b.filterDoneMicros) * 1e-03,
+                static_cast<double>(b.filterMicros) * 1e-03));
+    }
+
+    const std::pair<string, double>* critical = NULL;
+    for (const auto& step : steps) {
+        if ((critical == NULL) || (step.second > critical->second))
+            critical = &step;
+    }
+    if (critical != NULL && totalMs > 0) {
+        result.append(format("  Critical path: %s (%.0f%% of recovery)",
+                critical->first.c_str(), 100 * critical->second / totalMs));
+        if ((critical->first == "Waiting for recovery segments") &&
+                (slowestBackup != NULL)) {
+            result.append(format("; slowest backup was %s",
+                    slowestBackup->serverId.toString().c_str()));
+        }
+        result.append("\n");
+    }
+    return result;
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,121 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_RECOVERYTIMELINE_H
+#define RAMCLOUD_RECOVERYTIMELINE_H
+
+#include <vector>
+
+#include "Common.h"
+#include "RecoveryPartition.pb.h"
+#include "ServerId.h"
+#include "WireFormat.h"
+
+namespace RAMCloud {
+
+/**
+ * Collects the time spent in each phase of one master recovery, on the
+ * coordinator, the recovery masters, and the backups, and works out which
+ * of them determined how long the recovery took. Recovery records its own
+ * phases as it moves through them, and adds the timelines that recovery
+ * masters include when they report completion and that backups return when
+ * told the recovery is over; once the recovery has finished it logs a
+ * report. This replaces piecing the timing of a recovery together from the
+ * logs of all of the servers.
+ *
+ * Servers' clocks aren't synchronized, so each server reports durations
+ * rather than times. The recovery masters all run in parallel while the
+ * coordinator waits for them, so the recovery master that finished last is
+ * the one on the critical path, and its phases are counted in place of the
+ * coordinator's wait.
+ */
+class RecoveryTimeline {
+  PUBLIC:
+    /// The coordinator's phases of a recovery, in the order they occur.
+    enum Phase {
+        QUEUED,                 ///< Between the coordinator deciding the
+                                ///< master had crashed and the start of its
+                                ///< recovery.
+        START_BACKUPS,          ///< Finding replicas on backups and
+                                ///< partitioning the tablets.
+        START_RECOVERY_MASTERS, ///< Sending RECOVER requests.
+        RECOVERY_MASTERS,       ///< Waiting for all of the recovery masters
+                                ///< to finish.
+        NOTIFY_BACKUPS,         ///< Telling backups the recovery is over.
+        PHASE_COUNT
+    };
+
+    RecoveryTimeline();
+    void startPhase(Phase phase);
+    void finish();
+    void addRecoveryMaster(ServerId serverId, bool successful,
+            const ProtoBuf::RecoveryPartition& recoveryPartition,
+            uint64_t handoffCycles);
+    void addBackup(ServerId serverId,
+            const WireFormat::BackupRecoveryComplete::Response& times);
+    string report(uint64_t recoveryId, ServerId crashedServerId) const;
+
+  PRIVATE:
+    uint64_t getPhaseCycles(Phase phase) const;
+
+    /// Cycles::rdtsc time when each phase started, or 0 if it hasn't.
+    uint64_t phaseStart[PHASE_COUNT];
+
+    /// Cycles::rdtsc time when the whole recovery ended, or 0 if it hasn't.
+    uint64_t end;
+
+    /// What one recovery master reported.
+    struct RecoveryMaster {
+        RecoveryMaster(ServerId serverId, bool successful,
+                const ProtoBuf::RecoveryMasterTimeline& timeline,
+                uint64_t finishedCycles, uint64_t handoffCycles)
+            : serverId(serverId)
+            , successful(successful)
+            , timeline(timeline)
+            , finishedCycles(finishedCycles)
+            , handoffCycles(handoffCycles)
+        {}
+
+        ServerId serverId;
+        bool successful;
+        ProtoBuf::RecoveryMasterTimeline timeline;
+
+        /// Time (in Cycles::rdtsc ticks) from the start of RECOVERY_MASTERS
+        /// until the coordinator heard that this recovery master was done.
+        uint64_t finishedCycles;
+
+        /// Time (in Cycles::rdtsc ticks) the coordinator took to assign the
+        /// recovered tablets to this recovery master.
+        uint64_t handoffCycles;
+    };
+    std::vector<RecoveryMaster> recoveryMasters;
+
+    /// What one backup reported.
+    struct Backup {
+        Backup(ServerId serverId,
+                const WireFormat::BackupRecoveryComplete::Response& times)
+            : serverId(serverId)
+            , times(times)
+        {}
+
+        ServerId serverId;
+        WireFormat::BackupRecoveryComplete::Response times;
+    };
+    std::vector<Backup> backups;
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_RECOVERYTIMELINE_H
@@ -0,0 +1,153 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "Cycles.h"
+#include "RecoveryTimeline.h"
+
+namespace RAMCloud {
+
+class RecoveryTimelineTest : public ::testing::Test {
+  public:
+    RecoveryTimelineTest()
+    {
+        // One cycle per nanosecond, so 1 ms is 1000000 cycles.
+        Cycles::mockCyclesPerSec = 1e09;
+        Cycles::mockTscValue = 1000000;
+    }
+
+    ~RecoveryTimelineTest()
+    {
+        Cycles::mockCyclesPerSec = 0;
+        Cycles::mockTscValue = 0;
+    }
+
+    /// Advance the mocked clock by a number of milliseconds.
+    void
+    advance(uint64_t ms)
+    {
+        Cycles::mockTscValue += ms * 1000000;
+    }
+
+    /// Return a partition holding a recovery master's timeline.
+    ProtoBuf::RecoveryPartition
+    partition(uint64_t totalMicros, uint64_t segmentWaitMicros,
+            uint64_t replayMicros, uint64_t replicationMicros)
+    {
+        ProtoBuf::RecoveryPartition recoveryPartition;
+        ProtoBuf::RecoveryMasterTimeline* timeline =
+                recoveryPartition.mutable_timeline();
+        timeline->set_total_micros(totalMicros);
+        timeline->set_segment_wait_micros(segmentWaitMicros);
+        timeline->set_replay_micros(replayMicros);
+        timeline->set_replication_micros(replicationMicros);
+        timeline->set_handoff_micros(0);
+        timeline->set_segments(10);
+        timeline->set_segment_bytes(8000000);
+        return recoveryPartition;
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(RecoveryTimelineTest);
+};
+
+TEST_F(RecoveryTimelineTest, getPhaseCycles) {
+    RecoveryTimeline timeline;
+    advance(2);
+    timeline.startPhase(RecoveryTimeline::START_BACKUPS);
+    advance(1);
+    // START_RECOVERY_MASTERS is skipped.
+    timeline.startPhase(RecoveryTimeline::RECOVERY_MASTERS);
+    advance(5);
+    timeline.finish();
+
+    EXPECT_EQ(2000000u,
+            timeline.getPhaseCycles(RecoveryTimeline::QUEUED));
+    EXPECT_EQ(1000000u,
+            timeline.getPhaseCycles(RecoveryTimeline::START_BACKUPS));
+    EXPECT_EQ(0u,
+            timeline.getPhaseCycles(RecoveryTimeline::START_RECOVERY_MASTERS));
+    EXPECT_EQ(5000000u,
+            timeline.getPhaseCycles(RecoveryTimeline::RECOVERY_MASTERS));
+    EXPECT_EQ(0u,
+            timeline.getPhaseCycles(RecoveryTimeline::NOTIFY_BACKUPS));
+}
+
+TEST_F(RecoveryTimelineTest, addBackup_noPrimaries) {
+    RecoveryTimeline timeline;
+    WireFormat::BackupRecoveryComplete::Response times = {};
+    timeline.addBackup(ServerId(1, 0), times);
+    EXPECT_EQ(0u, timeline.backups.size());
+    times.primaryReplicas = 2;
+    timeline.addBackup(ServerId(1, 0), times);
+    EXPECT_EQ(1u, timeline.backups.size());
+}
+
+TEST_F(RecoveryTimelineTest, report) {
+    RecoveryTimeline timeline;
+    advance(1);
+    timeline.startPhase(RecoveryTimeline::START_BACKUPS);
+    advance(2);
+    timeline.startPhase(RecoveryTimeline::START_RECOVERY_MASTERS);
+    advance(1);
+    timeline.startPhase(RecoveryTimeline::RECOVERY_MASTERS);
+    advance(5);
+    timeline.addRecoveryMaster(ServerId(2, 0), true,
+            partition(3000, 1000, 1000, 500), 0);
+    advance(14);
+    timeline.addRecoveryMaster(ServerId(3, 0), true,
+            partition(15000, 8000, 4000, 2000), 1000000);
+    advance(1);
+    timeline.startPhase(RecoveryTimeline::NOTIFY_BACKUPS);
+    advance(1);
+    timeline.finish();
+
+    WireFormat::BackupRecoveryComplete::Response times = {};
+    times.primaryReplicas = 5;
+    times.partitionWaitMicros = 1000;
+    times.filterDoneMicros = 9000;
+    times.filterMicros = 6000;
+    timeline.addBackup(ServerId(4, 0), times);
+    times.filterDoneMicros = 2000;
+    timeline.addBackup(ServerId(5, 0), times);
+
+    string report = timeline.report(7, ServerId(1, 0));
+    EXPECT_TRUE(TestUtil::contains(report, "Recovery 7 of crashed server "
+            "1.0 took 25.0 ms (2 recovery masters, 2 backups)"));
+    EXPECT_TRUE(TestUtil::contains(report, "Running recovery masters"
+            "                 20.0 ms"));
+    EXPECT_TRUE(TestUtil::contains(report, "Slowest recovery master was "
+            "3.0, replayed 10 segments (8.0 MB)"));
+    EXPECT_TRUE(TestUtil::contains(report, "Other work on recovery master"
+            "           1.0 ms"));
+    EXPECT_TRUE(TestUtil::contains(report, "RPCs and waiting to start"
+            "               3.0 ms"));
+    EXPECT_TRUE(TestUtil::contains(report, "Slowest backup was 4.0: "
+            "partitions arrived after 1.0 ms, filtered 5 primary replicas "
+            "in 9.0 ms (6.0 ms of filtering)"));
+    EXPECT_TRUE(TestUtil::contains(report, "Critical path: Waiting for "
+            "recovery segments (32% of recovery); slowest backup was 4.0"));
+}
+
+TEST_F(RecoveryTimelineTest, report_noRecoveryMasters) {
+    RecoveryTimeline timeline;
+    advance(1);
+    timeline.startPhase(RecoveryTimeline::START_BACKUPS);
+    advance(3);
+    timeline.finish();
+    EXPECT_TRUE(TestUtil::contains(timeline.report(7, ServerId(1, 0)),
+            "Critical path: Starting backups (75% of recovery)\n"));
+}
+
+}  // namespace RAMCloud
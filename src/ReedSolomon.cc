@@ -0,0 +1,300 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#if __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+#include "ReedSolomon.h"
+#include "Exception.h"
+
+namespace RAMCloud {
+
+namespace {
+
+/**
+ * Log and antilog tables for GF(2^8) with the generator polynomial
+ * x^8 + x^4 + x^3 + x^2 + 1 (0x11d), on which 2 is primitive.
+ */
+struct GaloisTables {
+    GaloisTables()
+        : log()
+        , exp()
+    {
+        uint32_t x = 1;
+        for (uint32_t i = 0; i < 255; i++) {
+            exp[i] = exp[i + 255] = static_cast<uint8_t>(x);
+            log[x] = static_cast<uint8_t>(i);
+            x <<= 1;
+            if (x & 0x100)
+                x ^= 0x11d;
+        }
+    }
+
+    /// log[a] is the discrete log of a (undefined for 0).
+    uint8_t log[256];
+
+    /// exp[i] is 2^i; doubled in length so that exp[log a + log b] needs
+    /// no reduction modulo 255.
+    uint8_t exp[510];
+};
+
+const GaloisTables gf;
+
+} // anonymous namespace
+
+/**
+ * Construct a code with the given shape.
+ *
+ * \param dataFragments
+ *      Number of data fragments (k) each buffer is split into; at least 1.
+ * \param parityFragments
+ *      Number of parity fragments (m), i.e. the number of fragments that
+ *      can be lost. k + m must be at most 256.
+ * \throw FatalError
+ *      The shape is invalid.
+ */
+ReedSolomon::ReedSolomon(uint32_t dataFragments, uint32_t parityFragments)
+    : dataFragments(dataFragments)
+    , parityFragments(parityFragments)
+    , matrix()
+{
+    if (dataFragments == 0 || dataFragments + parityFragments > 256) {
+        throw FatalError(HERE, format("Invalid Reed-Solomon shape %u+%u",
+                                      dataFragments, parityFragments));
+    }
+    uint32_t k = dataFragments;
+    uint32_t total = dataFragments + parityFragments;
+    matrix.resize(total * k, 0);
+    for (uint32_t i = 0; i < k; i++)
+        matrix[i * k + i] = 1;
+    // Cauchy rows: 1 / (x_i + y_j) with x_i = i and y_j = j for i >= k,
+    // j < k. The x's and y's are distinct, so every entry is defined.
+    for (uint32_t i = k; i < total; i++) {
+        for (uint32_t j = 0; j < k; j++)
+            matrix[i * k + j] = inverse(static_cast<uint8_t>(i ^ j));
+    }
+}
+
+/**
+ * Compute the parity fragments for a buffer.
+ *
+ * \param data
+ *      The k data fragments, each \a length bytes.
+ * \param parity
+ *      The m parity fragments, each \a length bytes, are written here.
+ * \param length
+ *      Length in bytes of each fragment.
+ */
+void
+ReedSolomon::encode(const void* const data[],
+                    void* const parity[],
+                    size_t length) const
+{
+    uint32_t k = dataFragments;
+    for (uint32_t i = 0; i < parityFragments; i++) {
+        uint8_t* out = static_cast<uint8_t*>(parity[i]);
+        memset(out, 0, length);
+        for (uint32_t j = 0; j < k; j++) {
+            multiplyAdd(matrix[(k + i) * k + j],
+                        static_cast<const uint8_t*>(data[j]), out, length);
+        }
+    }
+}
+
+/**
+ * Regenerate missing fragments from the ones that survive.
+ *
+ * \param fragments
+ *      All k+m fragments, data fragments first, each \a length bytes.
+ *      Those marked present are read; the rest are overwritten with their
+ *      reconstructed contents.
+ * \param present
+ *      For each of the k+m fragments, whether its contents are valid.
+ * \param length
+ *      Length in bytes of each fragment.
+ * \return
+ *      True if the missing fragments were reconstructed; false if fewer
+ *      than k fragments are present (in which case nothing is modified).
+ */
+bool
+ReedSolomon::reconstruct(void* const fragments[],
+                         const bool present[],
+                         size_t length) const
+{
+    uint32_t k = dataFragments;
+    uint32_t total = dataFragments + parityFragments;
+
+    // Pick the first k present fragments as the basis to decode from.
+    std::vector<uint32_t> basis;
+    for (uint32_t i = 0; i < total && basis.size() < k; i++) {
+        if (present[i])
+            basis.push_back(i);
+    }
+    if (basis.size() < k)
+        return false;
+
+    // Recover missing data fragments: data = inv(rows of basis) * basis.
+    bool dataMissing = false;
+    for (uint32_t i = 0; i < k; i++)
+        dataMissing |= !present[i];
+    if (dataMissing) {
+        std::vector<uint8_t> decode(k * k);
+        for (uint32_t r = 0; r < k; r++) {
+            memcpy(&decode[r * k], &matrix[basis[r] * k], k);
+        }
+        // Cannot fail: every k x k submatrix of the coding matrix is
+        // invertible.
+        invert(decode, k);
+        for (uint32_t i = 0; i < k; i++) {
+            if (present[i])
+                continue;
+            uint8_t* out = static_cast<uint8_t*>(fragments[i]);
+            memset(out, 0, length);
+            for (uint32_t j = 0; j < k; j++) {
+                multiplyAdd(decode[i * k + j],
+                            static_cast<const uint8_t*>(fragments[basis[j]]),
+                            out, length);
+            }
+        }
+    }
+
+    // All data fragments are valid now, so re-encode any missing parity.
+    for (uint32_t i = k; i < total; i++) {
+        if (present[i])
+            continue;
+        uint8_t* out = static_cast<uint8_t*>(fragments[i]);
+        memset(out, 0, length);
+        for (uint32_t j = 0; j < k; j++) {
+            multiplyAdd(matrix[i * k + j],
+                        static_cast<const uint8_t*>(fragments[j]),
+                        out, length);
+        }
+    }
+    return true;
+}
+
+/// Return the product of \a a and \a b in GF(2^8).
+uint8_t
+ReedSolomon::multiply(uint8_t a, uint8_t b)
+{
+    if (a == 0 || b == 0)
+        return 0;
+    return gf.exp[gf.log[a] + gf.log[b]];
+}
+
+/// Return the multiplicative inverse of \a a (which must be nonzero).
+uint8_t
+ReedSolomon::inverse(uint8_t a)
+{
+    assert(a != 0);
+    return gf.exp[255 - gf.log[a]];
+}
+
+/**
+ * Add \a factor times each byte of \a source into the corresponding byte
+ * of \a destination, in GF(2^8); this is the inner loop of both encoding
+ * and decoding.
+ */
+void
+ReedSolomon::multiplyAdd(uint8_t factor, const uint8_t* source,
+                         uint8_t* destination, size_t length)
+{
+    if (factor == 0)
+        return;
+    size_t i = 0;
+#if __SSSE3__
+    // factor * x = factor * (x & 0x0f) + factor * (x & 0xf0), so two
+    // 16-entry tables indexed by nibble give the product of 16 bytes at a
+    // time with pshufb.
+    uint8_t lowTable[16] __attribute__((aligned(16)));
+    uint8_t highTable[16] __attribute__((aligned(16)));
+    for (uint32_t n = 0; n < 16; n++) {
+        lowTable[n] = multiply(factor, static_cast<uint8_t>(n));
+        highTable[n] = multiply(factor, static_cast<uint8_t>(n << 4));
+    }
+    __m128i low = _mm_load_si128(reinterpret_cast<__m128i*>(lowTable));
+    __m128i high = _mm_load_si128(reinterpret_cast<__m128i*>(highTable));
+    __m128i mask = _mm_set1_epi8(0x0f);
+    for (; i + 16 <= length; i += 16) {
+        __m128i x = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(source + i));
+        __m128i product = _mm_xor_si128(
+                _mm_shuffle_epi8(low, _mm_and_si128(x, mask)),
+                _mm_shuffle_epi8(high,
+                        _mm_and_si128(_mm_srli_epi64(x, 4), mask)));
+        __m128i* out = reinterpret_cast<__m128i*>(destination + i);
+        _mm_storeu_si128(out, _mm_xor_si128(product, _mm_loadu_si128(out)));
+    }
+#endif
+    if (i == length)
+        return;
+    uint32_t logFactor = gf.log[factor];
+    for (; i < length; i++) {
+        if (source[i] != 0)
+            destination[i] ^= gf.exp[logFactor + gf.log[source[i]]];
+    }
+}
+
+/**
+ * Invert a square matrix over GF(2^8) in place by Gauss-Jordan
+ * elimination.
+ *
+ * \param matrix
+ *      Row-major n x n matrix; replaced by its inverse.
+ * \param n
+ *      Dimension of the matrix.
+ * \return
+ *      False if the matrix is singular (its contents are then undefined).
+ */
+bool
+ReedSolomon::invert(std::vector<uint8_t>& matrix, uint32_t n)
+{
+    std::vector<uint8_t> result(n * n, 0);
+    for (uint32_t i = 0; i < n; i++)
+        result[i * n + i] = 1;
+
+    for (uint32_t col = 0; col < n; col++) {
+        uint32_t pivot = col;
+        while (pivot < n && matrix[pivot * n + col] == 0)
+            pivot++;
+        if (pivot == n)
+            return false;
+        if (pivot != col) {
+            for (uint32_t j = 0; j < n; j++) {
+                std::swap(matrix[pivot * n + j], matrix[col * n + j]);
+                std::swap(result[pivot * n + j], result[col * n + j]);
+            }
+        }
+        uint8_t scale = inverse(matrix[col * n + col]);
+        for (uint32_t j = 0; j < n; j++) {
+            matrix[col * n + j] = multiply(matrix[col * n + j], scale);
+            result[col * n + j] = multiply(result[col * n + j], scale);
+        }
+        for (uint32_t row = 0; row < n; row++) {
+            uint8_t factor = matrix[row * n + col];
+            if (row == col || factor == 0)
+                continue;
+            for (uint32_t j = 0; j < n; j++) {
+                matrix[row * n + j] ^= multiply(factor, matrix[col * n + j]);
+                result[row * n + j] ^= multiply(factor, result[col * n + j]);
+            }
+        }
+    }
+    matrix.swap(result);
+    return true;
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,85 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_REEDSOLOMON_H
+#define RAMCLOUD_REEDSOLOMON_H
+
+#include <vector>
+
+#include "Common.h"
+
+namespace RAMCloud {
+
+/**
+ * A systematic k+m Reed-Solomon erasure code over GF(2^8). A buffer is
+ * split into k equal-length data fragments, from which m parity fragments
+ * are computed; the original data can be reconstructed from any k of the
+ * k+m fragments. This is meant to let closed segments be kept on backups
+ * as k+m fragments rather than as full replicas, which stores (k+m)/k
+ * times the data instead of once per replica while still tolerating m
+ * lost backups.
+ *
+ * The parity rows of the coding matrix form a Cauchy matrix, so every
+ * square submatrix of the full (k+m) x k matrix is invertible. The inner
+ * loop multiplies a whole fragment by a constant and adds it into
+ * another; with SSSE3 this uses the split nibble-table technique (two
+ * pshufb lookups per 16 bytes), otherwise a per-byte log/exp lookup.
+ *
+ * Instances are immutable after construction and are safe to share among
+ * threads.
+ */
+class ReedSolomon {
+  PUBLIC:
+    ReedSolomon(uint32_t dataFragments, uint32_t parityFragments);
+
+    void encode(const void* const data[],
+                void* const parity[],
+                size_t length) const;
+    bool reconstruct(void* const fragments[],
+                     const bool present[],
+                     size_t length) const;
+
+    /// Number of data fragments (k).
+    uint32_t getDataFragments() const { return dataFragments; }
+
+    /// Number of parity fragments (m).
+    uint32_t getParityFragments() const { return parityFragments; }
+
+  PRIVATE:
+    static uint8_t multiply(uint8_t a, uint8_t b);
+    static uint8_t inverse(uint8_t a);
+    static void multiplyAdd(uint8_t factor, const uint8_t* source,
+                            uint8_t* destination, size_t length);
+    static bool invert(std::vector<uint8_t>& matrix, uint32_t n);
+
+    /// Number of data fragments (k).
+    const uint32_t dataFragments;
+
+    /// Number of parity fragments (m).
+    const uint32_t parityFragments;
+
+    /**
+     * Row-major (k+m) x k coding matrix: fragment i is the sum over j of
+     * matrix[i * k + j] times data fragment j. The first k rows are the
+     * identity.
+     */
+    std::vector<uint8_t> matrix;
+
+    DISALLOW_COPY_AND_ASSIGN(ReedSolomon);
+};
+
+} // namespace RAMCloud
+
+#endif  // RAMCLOUD_REEDSOLOMON_H
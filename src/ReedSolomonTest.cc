@@ -0,0 +1,136 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "ReedSolomon.h"
+
+namespace RAMCloud {
+
+class ReedSolomonTest : public ::testing::Test {
+  public:
+    // Not a multiple of 16, so both the vector and scalar paths run.
+    enum { LENGTH = 37 };
+
+    ReedSolomon code;
+    std::vector<std::vector<uint8_t>> fragments;
+    std::vector<void*> pointers;
+
+    ReedSolomonTest()
+        : code(4, 2)
+        , fragments(6, std::vector<uint8_t>(LENGTH))
+        , pointers()
+    {
+        for (uint32_t i = 0; i < 6; i++)
+            pointers.push_back(fragments[i].data());
+        for (uint32_t i = 0; i < 4; i++) {
+            for (uint32_t j = 0; j < LENGTH; j++)
+                fragments[i][j] = static_cast<uint8_t>(i * 59 + j * 13 + 1);
+        }
+        code.encode(pointers.data(), pointers.data() + 4, LENGTH);
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(ReedSolomonTest);
+};
+
+TEST_F(ReedSolomonTest, constructor) {
+    EXPECT_THROW(ReedSolomon(0, 2), FatalError);
+    EXPECT_THROW(ReedSolomon(200, 57), FatalError);
+    EXPECT_EQ(1U, code.matrix[0]);
+    EXPECT_EQ(0U, code.matrix[1]);
+    EXPECT_NE(0U, code.matrix[4 * 4]);
+}
+
+TEST_F(ReedSolomonTest, multiply) {
+    EXPECT_EQ(0U, ReedSolomon::multiply(0, 7));
+    EXPECT_EQ(7U, ReedSolomon::multiply(1, 7));
+    EXPECT_EQ(0x1dU, ReedSolomon::multiply(2, 0x80));
+    for (uint32_t a = 1; a < 256; a++) {
+        uint8_t x = static_cast<uint8_t>(a);
+        EXPECT_EQ(1U, ReedSolomon::multiply(x, ReedSolomon::inverse(x)));
+    }
+}
+
+TEST_F(ReedSolomonTest, multiplyAdd) {
+    uint8_t source[LENGTH];
+    uint8_t destination[LENGTH];
+    for (uint32_t i = 0; i < LENGTH; i++) {
+        source[i] = static_cast<uint8_t>(i * 7);
+        destination[i] = static_cast<uint8_t>(i);
+    }
+    ReedSolomon::multiplyAdd(0x53, source, destination, LENGTH);
+    for (uint32_t i = 0; i < LENGTH; i++) {
+        EXPECT_EQ(i ^ ReedSolomon::multiply(0x53,
+                                            static_cast<uint8_t>(i * 7)),
+                  destination[i]);
+    }
+}
+
+TEST_F(ReedSolomonTest, encode) {
+    // Parity is linear in the data: with only fragment 2 nonzero, each
+    // parity byte is the matrix entry times the data byte.
+    std::vector<std::vector<uint8_t>> data(4,
+                                           std::vector<uint8_t>(LENGTH, 0));
+    data[2].assign(LENGTH, 1);
+    const void* in[4] = {data[0].data(), data[1].data(),
+                         data[2].data(), data[3].data()};
+    uint8_t parity[2][LENGTH];
+    void* out[2] = {parity[0], parity[1]};
+    code.encode(in, out, LENGTH);
+    EXPECT_EQ(code.matrix[4 * 4 + 2], parity[0][LENGTH - 1]);
+    EXPECT_EQ(code.matrix[5 * 4 + 2], parity[1][0]);
+}
+
+TEST_F(ReedSolomonTest, reconstruct) {
+    std::vector<std::vector<uint8_t>> original = fragments;
+    // Every pair of lost fragments is recoverable.
+    for (uint32_t a = 0; a < 6; a++) {
+        for (uint32_t b = a + 1; b < 6; b++) {
+            bool present[6] = {true, true, true, true, true, true};
+            present[a] = present[b] = false;
+            fragments[a].assign(LENGTH, 0xff);
+            fragments[b].assign(LENGTH, 0xff);
+            EXPECT_TRUE(code.reconstruct(pointers.data(), present, LENGTH));
+            EXPECT_TRUE(original == fragments) << a << "," << b;
+        }
+    }
+}
+
+TEST_F(ReedSolomonTest, reconstruct_tooFewFragments) {
+    bool present[6] = {true, false, true, false, false, true};
+    fragments[1].assign(LENGTH, 0xff);
+    EXPECT_FALSE(code.reconstruct(pointers.data(), present, LENGTH));
+    EXPECT_EQ(0xff, fragments[1][0]);
+}
+
+TEST_F(ReedSolomonTest, invert) {
+    std::vector<uint8_t> matrix = {1, 2, 3, 4};
+    std::vector<uint8_t> inverse = matrix;
+    EXPECT_TRUE(ReedSolomon::invert(inverse, 2));
+    for (uint32_t i = 0; i < 2; i++) {
+        for (uint32_t j = 0; j < 2; j++) {
+            uint8_t sum = 0;
+            for (uint32_t x = 0; x < 2; x++) {
+                sum ^= ReedSolomon::multiply(matrix[i * 2 + x],
+                                             inverse[x * 2 + j]);
+            }
+            EXPECT_EQ(i == j ? 1U : 0U, sum);
+        }
+    }
+
+    std::vector<uint8_t> singular = {1, 2, 1, 2};
+    EXPECT_FALSE(ReedSolomon::invert(singular, 2));
+}
+
+}  // namespace RAMCloud
@@ -16,6 +16,7 @@
 #include "BackupClient.h"
 #include "CycleCounter.h"
 #include "Logger.h"
+#include "LoadAwareBackupSelector.h"
 #include "MinCopysetsBackupSelector.h"
 #include "ShortMacros.h"
 #include "RawMetrics.h"
@@ -41,12 +42,23 @@ namespace RAMCloud {
  *      replication.
  * \param allowLocalBackup
  *      Specifies whether to allow replication to the local backup.
+ * \param relayReplication
+ *      Specifies whether to send each write only to the primary replica's
+ *      backup and have it relay the write to the other replicas.
+ * \param compressReplication
+ *      Specifies whether to compress the data sent to backups.
+ * \param loadAwareReplication
+ *      Specifies whether to place replicas with a LoadAwareBackupSelector
+ *      (ignored if \a useMinCopysets is set).
  */
 ReplicaManager::ReplicaManager(Context* context,
                                const ServerId* masterId,
                                uint32_t numReplicas,
                                bool useMinCopysets,
-                               bool allowLocalBackup)
+                               bool allowLocalBackup,
+                               bool relayReplication,
+                               bool compressReplication,
+                               bool loadAwareReplication)
     : context(context)
     , numReplicas(numReplicas)
     , backupSelector()
@@ -56,17 +68,24 @@ ReplicaManager::ReplicaManager(Context* context,
     , replicatedSegmentList()
     , taskQueue()
     , writeRpcsInFlight(0)
+    , writeRpcWindow()
     , freeRpcsInFlight(0)
     , replicationEpoch()
     , failureMonitor(context, this)
     , replicationCounter()
     , useMinCopysets(useMinCopysets)
     , allowLocalBackup(allowLocalBackup)
+    , relayReplication(relayReplication)
+    , compressReplication(compressReplication)
 {
     if (useMinCopysets) {
         backupSelector.reset(new MinCopysetsBackupSelector(context, masterId,
                                                            numReplicas,
                                                            allowLocalBackup));
+    } else if (loadAwareReplication) {
+        backupSelector.reset(new LoadAwareBackupSelector(context, masterId,
+                                                         numReplicas,
+                                                         allowLocalBackup));
     } else {
         backupSelector.reset(new BackupSelector(context, masterId,
                                                 numReplicas, allowLocalBackup));
@@ -375,6 +394,24 @@ ReplicaManager::proceed()
                  taskQueue.outstandingTasks());
 }
 
+/**
+ * Send a report of recent activity on this master's tablets to the
+ * coordinator, where it is kept with this master's replication epoch for
+ * use in partitioning the master's tablets if it crashes (and in balancing
+ * load while it's up). The report is sent asynchronously as replication
+ * proceeds (see proceed()).
+ *
+ * \param load
+ *      Its tablet_load and indexlet_load fields hold the report; other
+ *      fields are ignored.
+ */
+void
+ReplicaManager::updateTabletLoad(const ProtoBuf::MasterRecoveryInfo& load)
+{
+    Lock _(dataMutex);
+    replicationEpoch->updateTabletLoad(load);
+}
+
 // - private -
 
 /**
@@ -418,10 +455,12 @@ ReplicaManager::allocateSegment(const Lock& lock,
         DIE("Out of memory");
     ReplicatedSegment* replicatedSegment =
         new(p) ReplicatedSegment(context, taskQueue, *backupSelector, *this,
-                                 writeRpcsInFlight, freeRpcsInFlight,
+                                 writeRpcsInFlight, writeRpcWindow,
+                                 freeRpcsInFlight,
                                  *replicationEpoch,
                                  dataMutex, segmentId, segment,
                                  isLogHead, *masterId, numReplicas,
+                                 relayReplication, compressReplication,
                                  &replicationCounter);
     replicatedSegmentList.push_back(*replicatedSegment);
 
@@ -446,8 +485,14 @@ ReplicaManager::handleBackupFailure(ServerId failedId)
     LOG(NOTICE, "Handling backup failure of serverId %s",
         failedId.toString().c_str());
 
-    foreach (auto& segment, replicatedSegmentList)
-        segment.handleBackupFailure(failedId, useMinCopysets);
+    // Schedule the newest segments first: the task queue runs segments in
+    // the order they were scheduled, and the newest segments are the ones
+    // that recovery needs most (the head in particular can't be closed
+    // until its replicas are back).
+    for (auto it = replicatedSegmentList.rbegin();
+            it != replicatedSegmentList.rend(); ++it) {
+        it->handleBackupFailure(failedId, useMinCopysets);
+    }
 }
 
 /**
@@ -68,7 +68,10 @@ class ReplicaManager
                    const ServerId* masterId,
                    uint32_t numReplicas,
                    bool useMinCopysets,
-                   bool allowLocalBackup);
+                   bool allowLocalBackup,
+                   bool relayReplication = false,
+                   bool compressReplication = false,
+                   bool loadAwareReplication = false);
     ~ReplicaManager();
 
     bool isIdle();
@@ -82,6 +85,7 @@ class ReplicaManager
     void startFailureMonitor();
     void haltFailureMonitor();
     void proceed();
+    void updateTabletLoad(const ProtoBuf::MasterRecoveryInfo& load);
 
   PRIVATE:
     ReplicatedSegment* allocateSegment(const Lock& lock, uint64_t segmentId,
@@ -162,6 +166,12 @@ class ReplicaManager
      */
     uint32_t writeRpcsInFlight;
 
+    /**
+     * Limits writeRpcsInFlight based on observed backup write latency.
+     * Shared among ReplicatedSegments.
+     */
+    ReplicatedSegment::WriteRpcWindow writeRpcWindow;
+
     /**
      * Number of collective outstanding free rpcs to all backups.
      * Used by ReplicatedSegment to throttle rpc creation.
@@ -200,6 +210,18 @@ class ReplicaManager
      */
     bool allowLocalBackup;
 
+    /**
+     * Specifies whether the primary replica's backup should relay writes
+     * to the other replicas' backups (see ReplicatedSegment::relayWrites).
+     */
+    bool relayReplication;
+
+    /**
+     * Specifies whether write rpcs to backups carry compressed data (see
+     * ReplicatedSegment::compressWrites).
+     */
+    bool compressReplication;
+
   PUBLIC:
     // Only used by BackupFailureMonitor.
     void handleBackupFailure(ServerId failedId);
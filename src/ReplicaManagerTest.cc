@@ -60,7 +60,7 @@ struct ReplicaManagerTest : public ::testing::Test {
         // anymore.
         serverId = CoordinatorClient::enlistServer(&context, 0, {},
             {WireFormat::MASTER_SERVICE}, "", 0);
-        mgr.construct(&context, &serverId, 2, false, false);
+        mgr.construct(&context, &serverId, 2, false, false, false);
         cluster.coordinatorContext.coordinatorServerList->sync();
     }
 
@@ -240,14 +240,14 @@ TEST_F(ReplicaManagerTest, handleBackupFailure) {
     mgr->handleBackupFailure(backup1Id);
     EXPECT_EQ(
         "handleBackupFailure: Handling backup failure of serverId 1.0 | "
-        "handleBackupFailure: Segment 89 recovering from lost replica which "
-            "was on backup 1.0 | "
-        "handleBackupFailure: Segment 90 recovering from lost replica which "
-            "was on backup 1.0 | "
         "handleBackupFailure: Segment 91 recovering from lost replica which "
             "was on backup 1.0 | "
         "handleBackupFailure: Lost replica(s) for segment 91 while open due "
-            "to crash of backup 1.0",
+            "to crash of backup 1.0 | "
+        "handleBackupFailure: Segment 90 recovering from lost replica which "
+            "was on backup 1.0 | "
+        "handleBackupFailure: Segment 89 recovering from lost replica which "
+            "was on backup 1.0",
         TestLog::get());
 }
 
@@ -363,13 +363,14 @@ TEST_F(ReplicaManagerTest, endToEndBackupRecovery) {
         "main: Notifying replica manager of failure of serverId 1.0 | "
         // Next few, ensure open/closed segments get tagged appropriately
         // since recovery is different for each.
+        // The newest segment is handled first.
         "handleBackupFailure: Handling backup failure of serverId 1.0 | "
-        "handleBackupFailure: Segment 1 recovering from lost replica which "
-            "was on backup 1.0 | "
         "handleBackupFailure: Segment 2 recovering from lost replica which "
             "was on backup 1.0 | "
         "handleBackupFailure: Lost replica(s) for segment 2 while open due "
             "to crash of backup 1.0 | "
+        "handleBackupFailure: Segment 1 recovering from lost replica which "
+            "was on backup 1.0 | "
         // Segment 2 goes first; since it stayed open it was always scheduled.
         // Replica slot 0 just needs an updated epoch, so that is sent out.
         "performWrite: Sending write to backup 2.0 | "
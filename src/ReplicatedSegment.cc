@@ -47,6 +47,9 @@ enum { OBEY_SAFETY_CONSTRAINTS = true };
  * \param writeRpcsInFlight
  *      Number of outstanding write rpcs to backups across all
  *      ReplicatedSegments.  Used to throttle write rpcs.
+ * \param writeRpcWindow
+ *      Decides how many write rpcs may be in flight; shared among
+ *      ReplicatedSegments and fed the latency of each completed write rpc.
  * \param freeRpcsInFlight
  *      Number of outstanding free rpcs to backups across all
  *      ReplicatedSegments.  Used to throttle free rpcs.
@@ -73,6 +76,11 @@ enum { OBEY_SAFETY_CONSTRAINTS = true };
  *      The server id of the master whose log this segment belongs to.
  * \param numReplicas
  *      Number of replicas of this segment that must be maintained.
+ * \param relayWrites
+ *      If true, have the primary replica's backup relay writes to the
+ *      other replicas once they have caught up (see #relayWrites).
+ * \param compressWrites
+ *      If true, compress the data sent in write rpcs (see #compressWrites).
  * \param replicationCounter
  *      Used to measure time when backup write rpcs are active.
  *      Shared among ReplicatedSegments.
@@ -85,6 +93,7 @@ ReplicatedSegment::ReplicatedSegment(Context* context,
                                      BaseBackupSelector& backupSelector,
                                      Deleter& deleter,
                                      uint32_t& writeRpcsInFlight,
+                                     WriteRpcWindow& writeRpcWindow,
                                      uint32_t& freeRpcsInFlight,
                                      UpdateReplicationEpochTask&
                                                             replicationEpoch,
@@ -94,6 +103,8 @@ ReplicatedSegment::ReplicatedSegment(Context* context,
                                      bool normalLogSegment,
                                      ServerId masterId,
                                      uint32_t numReplicas,
+                                     bool relayWrites,
+                                     bool compressWrites,
                                      Tub<CycleCounter<RawMetric>>*
                                                              replicationCounter,
                                      uint32_t maxBytesPerWriteRpc)
@@ -102,6 +113,7 @@ ReplicatedSegment::ReplicatedSegment(Context* context,
     , backupSelector(backupSelector)
     , deleter(deleter)
     , writeRpcsInFlight(writeRpcsInFlight)
+    , writeRpcWindow(writeRpcWindow)
     , freeRpcsInFlight(freeRpcsInFlight)
     , replicationEpoch(replicationEpoch)
     , dataMutex(dataMutex)
@@ -111,6 +123,8 @@ ReplicatedSegment::ReplicatedSegment(Context* context,
     , masterId(masterId)
     , segmentId(segmentId)
     , maxBytesPerWriteRpc(maxBytesPerWriteRpc)
+    , relayWrites(relayWrites)
+    , compressWrites(compressWrites)
     , queued(true, 0, 0, false)
     , queuedCertificate()
     , openLen(0)
@@ -187,6 +201,7 @@ ReplicatedSegment::free()
         replica.writeRpc.destroy();
         --writeRpcsInFlight;
     }
+    cancelRelays();
 
     // Segment should free itself ASAP. It must not start new write rpcs after
     // this.
@@ -215,6 +230,24 @@ ReplicatedSegment::isSynced() const
     return true;
 }
 
+/**
+ * Return true if the first \a offset bytes of the segment have been durably
+ * replicated; see sync() for the exact definition. Unlike sync() this never
+ * waits, so it can be used to poll for the completion of a queueSync().
+ *
+ * \param offset
+ *      The number of bytes of the segment that must be replicated. ~0u
+ *      means all enqueued data and the closed flag.
+ * \param minReplicas
+ *      See committedThrough().
+ */
+bool
+ReplicatedSegment::isCommitted(uint32_t offset, uint32_t minReplicas)
+{
+    Lock _(dataMutex);
+    return committedThrough(offset, minReplicas);
+}
+
 /**
  * Request the eventual close of the replicas of a segment on its backups.
  *
@@ -306,8 +339,11 @@ ReplicatedSegment::handleBackupFailure(ServerId failedId, bool useMinCopysets)
             ++metrics->master.openReplicaRecoveries;
         }
 
-        if (replica.writeRpc)
+        if (replica.writeRpc) {
             --writeRpcsInFlight;
+            if (replicaIsPrimary(replica))
+                cancelRelays();
+        }
         if (replica.freeRpc)
             --freeRpcsInFlight;
         replica.reset(true);
@@ -320,6 +356,28 @@ ReplicatedSegment::handleBackupFailure(ServerId failedId, bool useMinCopysets)
     }
 }
 
+/**
+ * Start the durable replication of data starting at the beginning of the
+ * segment up through \a offset bytes, but return without waiting for it to
+ * complete. The replication proceeds as ReplicaManager::proceed() (or any
+ * sync()) performs tasks; isCommitted() indicates when it is done.
+ *
+ * \param offset
+ *      The number of bytes of the segment that must be replicated.
+ * \param certificate
+ *      If non-NULL, the certificate associated with \a offset; see sync().
+ */
+void
+ReplicatedSegment::queueSync(uint32_t offset, SegmentCertificate* certificate)
+{
+    CycleCounter<RawMetric> _(&metrics->master.replicaManagerTicks);
+    TEST_LOG("queueing segment %lu to offset %u", segmentId, offset);
+    Lock __(dataMutex);
+    if (committedThrough(offset))
+        return;
+    queueThrough(offset, certificate);
+}
+
 /**
  * Wait for the durable replication (meaning at least durably buffered on
  * backups) of data starting at the beginning of the segment up through \a
@@ -381,54 +439,17 @@ ReplicatedSegment::sync(uint32_t offset, SegmentCertificate* certificate)
     Tub<Lock> lock;
     lock.construct(dataMutex);
 
-    // Definition of synced changes if this segment isn't durably closed
-    // and is recovering from a lost replica.  In that case the data
-    // the data isn't durable until it has been replicated *along with*
-    // a durable close on the replicas as well *and* any lost, open
-    // replicas have been shot down by setting the replicationEpoch.
-    // Once this flag is cleared those conditions have been met and
-    // it is safe to use the usual definition.
-    if (!recoveringFromLostOpenReplicas) {
-        if (!normalLogSegment || precedingSegmentCloseCommitted) {
-            if (offset == ~0u) {
-                if (getCommitted().close)
-                    return;
-            } else {
-                if (getCommitted().bytes >= offset)
-                    return;
-            }
-        }
-    }
-
-    // If the caller did not provide the desired certificate, obtain the
-    // latest one and use that.
-    uint32_t appendedBytes = offset;
-    SegmentCertificate localCertificate;
-    if (certificate == NULL) {
-        appendedBytes = segment->getAppendedLength(&localCertificate);
-        certificate = &localCertificate;
-    }
+    if (committedThrough(offset))
+        return;
 
-    if (appendedBytes > queued.bytes) {
-        queued.bytes = appendedBytes;
-        queuedCertificate = *certificate;
-        schedule();
-    }
+    queueThrough(offset, certificate);
+    PerfStats::threadStats.replicationSyncs++;
 
     uint64_t syncStartTicks = Cycles::rdtsc();
     while (true) {
         taskQueue.performTask();
-        if (!recoveringFromLostOpenReplicas) {
-            if (!normalLogSegment || precedingSegmentCloseCommitted) {
-                if (offset == ~0u) {
-                    if (getCommitted().close)
-                        return;
-                } else {
-                    if (getCommitted().bytes >= offset)
-                        return;
-                }
-            }
-        }
+        if (committedThrough(offset))
+            return;
         double waited = Cycles::toSeconds(Cycles::rdtsc() - syncStartTicks);
         if (waited > 10) {
             LOG(WARNING, "Log write sync has taken over 10s; seems to "
@@ -440,6 +461,34 @@ ReplicatedSegment::sync(uint32_t offset, SegmentCertificate* certificate)
     }
 }
 
+/**
+ * Wait until the first \a offset bytes of the segment are durable on at
+ * least \a minReplicas backups, which must already have been queued for
+ * replication (see queueSync()). This lets writes to tables that need less
+ * durability than the rest of the log (see ObjectManager::setTableDurability)
+ * be acknowledged before the slowest backups have their data; all of the
+ * replicas are still written.
+ *
+ * Unlike sync() this doesn't take #syncMutex, so it doesn't wait behind
+ * a sync() that is waiting for all of the replicas.
+ *
+ * \param offset
+ *      The number of bytes of the segment that must be replicated.
+ * \param minReplicas
+ *      See committedThrough().
+ */
+void
+ReplicatedSegment::waitForReplicas(uint32_t offset, uint32_t minReplicas)
+{
+    CycleCounter<RawMetric> _(&metrics->master.replicaManagerTicks);
+    Tub<Lock> lock;
+    lock.construct(dataMutex);
+    while (!committedThrough(offset, minReplicas)) {
+        taskQueue.performTask();
+        lock.construct(dataMutex);
+    }
+}
+
 /**
  * Replace the current in-memory segment this object is providing durability for
  * with a different, but logically identical one, and return the old segment.
@@ -498,6 +547,106 @@ ReplicatedSegment::swapSegment(const Segment* newSegment)
 
 // - private -
 
+/**
+ * Account for the completion of a write rpc and, once a window's worth of
+ * rpcs have completed, resize the window. See WriteRpcWindow.
+ *
+ * \param cycles
+ *      Time between sending the rpc and finding it complete.
+ */
+void
+ReplicatedSegment::WriteRpcWindow::rpcCompleted(uint64_t cycles)
+{
+    minLatencyCycles = std::min(minLatencyCycles, cycles);
+    latencyCycles += cycles;
+    if (++samples < size)
+        return;
+
+    uint64_t averageCycles = latencyCycles / samples;
+    if (averageCycles > 4 * minLatencyCycles) {
+        size = std::max(size / 2, uint32_t(MIN_SIZE));
+        RAMCLOUD_CLOG(DEBUG, "Backup write latency rising; allowing %u "
+                      "write rpcs in flight", size);
+    } else if (averageCycles <= 2 * minLatencyCycles) {
+        size = std::min(size + 1, uint32_t(MAX_SIZE));
+    }
+    latencyCycles = 0;
+    samples = 0;
+}
+
+/**
+ * Return true if the first \a offset bytes of the segment are durable on
+ * backups (or if \a offset is ~0u, if the segment is durably closed).
+ * The caller must hold #dataMutex.
+ *
+ * \param offset
+ *      See above.
+ * \param minReplicas
+ *      Number of replicas that must hold the data. If this is at least the
+ *      number of replicas the segment has (the default) all of them must.
+ */
+bool
+ReplicatedSegment::committedThrough(uint32_t offset,
+                                    uint32_t minReplicas) const
+{
+    // Definition of synced changes if this segment isn't durably closed
+    // and is recovering from a lost replica.  In that case the data
+    // the data isn't durable until it has been replicated *along with*
+    // a durable close on the replicas as well *and* any lost, open
+    // replicas have been shot down by setting the replicationEpoch.
+    // Once this flag is cleared those conditions have been met and
+    // it is safe to use the usual definition.
+    if (recoveringFromLostOpenReplicas)
+        return false;
+    if (normalLogSegment && !precedingSegmentCloseCommitted)
+        return false;
+    if (minReplicas < replicas.size()) {
+        uint32_t count = 0;
+        foreach (auto& replica, replicas) {
+            if (!replica.isActive)
+                continue;
+            if ((offset == ~0u) ? replica.committed.close :
+                    (replica.committed.bytes >= offset))
+                count++;
+        }
+        return count >= minReplicas;
+    }
+    if (offset == ~0u)
+        return getCommitted().close;
+    return getCommitted().bytes >= offset;
+}
+
+/**
+ * Make sure the first \a offset bytes of the segment are queued for
+ * replication and schedule this segment if that adds new data.
+ * The caller must hold #dataMutex.
+ *
+ * \param offset
+ *      See sync().
+ * \param certificate
+ *      See sync(). If NULL, the latest length and certificate of the
+ *      segment are used instead of \a offset.
+ */
+void
+ReplicatedSegment::queueThrough(uint32_t offset,
+                                SegmentCertificate* certificate)
+{
+    // If the caller did not provide the desired certificate, obtain the
+    // latest one and use that.
+    uint32_t appendedBytes = offset;
+    SegmentCertificate localCertificate;
+    if (certificate == NULL) {
+        appendedBytes = segment->getAppendedLength(&localCertificate);
+        certificate = &localCertificate;
+    }
+
+    if (appendedBytes > queued.bytes) {
+        queued.bytes = appendedBytes;
+        queuedCertificate = *certificate;
+        schedule();
+    }
+}
+
 /**
  * Schedule this task if the number of replicas is greater than zero.
  */
@@ -731,12 +880,25 @@ ReplicatedSegment::performWrite(Replica& replica)
         // for scheduling the task.
     }
 
+    if (replica.relayIndex != 0) {
+        // The primary replica's write rpc is carrying this replica's data;
+        // its completion will update this replica (and the primary keeps
+        // the segment scheduled meanwhile).
+        return;
+    }
+
     if (replica.writeRpc) {
         // This replica has a write request outstanding to a backup.
         if (replica.writeRpc->isReady()) {
             // Wait for it to complete if it is ready.
             try {
-                replica.writeRpc->wait();
+                uint32_t writeBuffersInUse = 0;
+                uint32_t relayedMask =
+                    replica.writeRpc->wait(&writeBuffersInUse);
+                uint64_t latency = Cycles::rdtsc() - replica.writeRpcStartTicks;
+                writeRpcWindow.rpcCompleted(latency);
+                backupSelector.signalWriteCompleted(replica.backupId, latency,
+                                                    writeBuffersInUse);
                 TEST_LOG("Write RPC finished for replica slot %ld",
                          &replica - &replicas[0]);
                 if (replica.acked.open && !replica.sent.open) {
@@ -744,14 +906,19 @@ ReplicatedSegment::performWrite(Replica& replica)
                             "Resetting acked.open for segment %lu replica %lu",
                             segmentId, &replica - &replicas[0]);
                 }
-                replica.acked = replica.sent;
-                if (replica.sentCertificate) {
-                    replica.committed = replica.acked;
-                } else {
-                    // Update open bit even if certificate wasn't sent; this
-                    // is needed to avoid deadlocks over the safety
-                    // constraints during recovery of lost replicas.
-                    replica.committed.open = replica.acked.open;
+                bool wasClosed = replica.committed.close;
+                replica.acknowledgeSent();
+                if (replica.replacesLostReplica && !wasClosed &&
+                        replica.committed.close) {
+                    ++metrics->master.replicaRecoveriesCompleted;
+                }
+                foreach (auto& relayed, replicas) {
+                    if (relayed.relayIndex == 0)
+                        continue;
+                    if (relayedMask & (1u << (relayed.relayIndex - 1))) {
+                        relayed.acknowledgeSent();
+                        relayed.relayIndex = 0;
+                    }
                 }
                 if (getCommitted().open && followingSegment)
                     followingSegment->precedingSegmentOpenCommitted = true;
@@ -792,6 +959,9 @@ ReplicatedSegment::performWrite(Replica& replica)
             }
             replica.writeRpc.destroy();
             --writeRpcsInFlight;
+            // Any relays not acknowledged above failed; the replicas
+            // will be written to directly.
+            bool relaysFailed = cancelRelays();
             if (LOG_RECOVERY_REPLICATION_RPC_TIMING && recoveryStart) {
                 LOG(DEBUG, "@%7lu: Replica <%s,%lu,%lu> write <- %7u "
                     "%u rpcs out %s",
@@ -800,7 +970,8 @@ ReplicatedSegment::performWrite(Replica& replica)
                     segmentId, &replica - &replicas[0], replica.acked.bytes,
                     writeRpcsInFlight, replica.committed.close ? " CLOSE" : "");
             }
-            if (replica.committed != queued || recoveringFromLostOpenReplicas)
+            if (replica.committed != queued || recoveringFromLostOpenReplicas ||
+                    relaysFailed)
                 schedule();
             return;
         } else {
@@ -817,7 +988,7 @@ ReplicatedSegment::performWrite(Replica& replica)
                 return;
             }
             // No outstanding write, but not yet durably open.
-            if (writeRpcsInFlight == MAX_WRITE_RPCS_IN_FLIGHT) {
+            if (writeRpcWindow.isFull(writeRpcsInFlight)) {
                 RAMCLOUD_CLOG(DEBUG, "Delaying open for segment %lu, "
                         "replica %lu: too many RPCs in flight", segmentId,
                         &replica - &replicas[0]);
@@ -847,9 +1018,13 @@ ReplicatedSegment::performWrite(Replica& replica)
             replica.writeRpc.construct(context, replica.backupId,
                                        masterId, segmentId, queued.epoch,
                                        segment, 0, length, certificateToSend,
-                                       true, false, replicaIsPrimary(replica));
+                                       true, false, replicaIsPrimary(replica),
+                                       static_cast<const ServerId*>(NULL), 0,
+                                       compressWrites);
+            replica.writeRpcStartTicks = Cycles::rdtsc();
             if (replicaIsPrimary(replica)) {
                 PerfStats::threadStats.replicationRpcs++;
+                PerfStats::threadStats.replicationRpcBytes += length;
             }
             ++writeRpcsInFlight;
             if (LOG_RECOVERY_REPLICATION_RPC_TIMING && recoveryStart) {
@@ -914,7 +1089,7 @@ ReplicatedSegment::performWrite(Replica& replica)
                 return;
             }
 
-            if (writeRpcsInFlight == MAX_WRITE_RPCS_IN_FLIGHT) {
+            if (writeRpcWindow.isFull(writeRpcsInFlight)) {
                 RAMCLOUD_CLOG(DEBUG, "Delaying write to segment %lu, "
                         "replica %lu: too many RPCs in flight", segmentId,
                         &replica - &replicas[0]);
@@ -922,18 +1097,66 @@ ReplicatedSegment::performWrite(Replica& replica)
                 return;
             }
 
+            // Re-creating the replicas of closed segments lost with a backup
+            // can wait; don't let it crowd out writes of the log head.
+            bool recovering = replica.replacesLostReplica && queued.close;
+            if (recovering &&
+                    writeRpcWindow.isFullForRecovery(writeRpcsInFlight)) {
+                RAMCLOUD_CLOG(DEBUG, "Delaying re-replication of segment %lu, "
+                        "replica %lu: too many RPCs in flight", segmentId,
+                        &replica - &replicas[0]);
+                schedule();
+                return;
+            }
+
+            // When relaying, have the primary's backup forward this write
+            // to each secondary that has caught up to the primary. If some
+            // secondary is still busy with a write of its own, wait for it
+            // so that the replicas fall into step again.
+            Replica* relayed[WireFormat::BackupWrite::MAX_RELAYS];
+            ServerId relayTo[WireFormat::BackupWrite::MAX_RELAYS];
+            uint32_t relayCount = 0;
+            if (relayWrites && replicaIsPrimary(replica)) {
+                foreach (auto& secondary, replicas) {
+                    if (&secondary == &replica)
+                        continue;
+                    if (secondary.writeRpc) {
+                        schedule();
+                        return;
+                    }
+                    if (secondary.isActive && secondary.committed.open &&
+                            secondary.sent == replica.sent &&
+                            secondary.acked == secondary.sent &&
+                            relayCount < WireFormat::BackupWrite::MAX_RELAYS) {
+                        relayed[relayCount] = &secondary;
+                        relayTo[relayCount] = secondary.backupId;
+                        relayCount++;
+                    }
+                }
+            }
+
             TEST_LOG("Sending write to backup %s",
                      replica.backupId.toString().c_str());
+            if (relayCount > 0) {
+                TEST_LOG("Relaying write through backup %s to %u other "
+                         "backups", replica.backupId.toString().c_str(),
+                         relayCount);
+            }
             replica.writeRpc.construct(context, replica.backupId, masterId,
                                        segmentId, queued.epoch,
                                        segment, offset, length,
                                        certificateToSend,
                                        false, sendClose,
-                                       replicaIsPrimary(replica));
+                                       replicaIsPrimary(replica),
+                                       relayTo, relayCount, compressWrites);
+            replica.writeRpcStartTicks = Cycles::rdtsc();
             if (replicaIsPrimary(replica)) {
                 PerfStats::threadStats.replicationRpcs++;
+                PerfStats::threadStats.replicationRpcBytes += length;
             }
             ++writeRpcsInFlight;
+            if (replica.replacesLostReplica)
+                metrics->master.replicaRecoveryBytes += length;
             if (LOG_RECOVERY_REPLICATION_RPC_TIMING && recoveryStart) {
                 LOG(DEBUG, "@%7lu: Replica <%s,%lu,%lu> write -> %7u+%7u "
                     "%u rpcs out %s",
@@ -945,6 +1168,11 @@ ReplicatedSegment::performWrite(Replica& replica)
             replica.sent.bytes += length;
             replica.sent.epoch = queued.epoch;
             replica.sent.close = sendClose;
+            for (uint32_t i = 0; i < relayCount; i++) {
+                relayed[i]->sent = replica.sent;
+                relayed[i]->sentCertificate = replica.sentCertificate;
+                relayed[i]->relayIndex = i + 1;
+            }
             schedule();
             return;
         } else {
@@ -957,6 +1185,29 @@ ReplicatedSegment::performWrite(Replica& replica)
     assert(false); // Unreachable by construction
 }
 
+/**
+ * Give up on the relays requested by the primary replica's write rpc
+ * (because it completed without them, failed, or was abandoned): each
+ * replica that was waiting on a relay goes back to its acknowledged state
+ * so that the data will be written to it directly.
+ *
+ * \return
+ *      True if any replica was waiting on a relay.
+ */
+bool
+ReplicatedSegment::cancelRelays()
+{
+    bool cancelled = false;
+    foreach (auto& replica, replicas) {
+        if (replica.relayIndex == 0)
+            continue;
+        replica.sent = replica.acked;
+        replica.relayIndex = 0;
+        cancelled = true;
+    }
+    return cancelled;
+}
+
 /**
  * Prints a ton of internal state of the replica. Useful for diagnosing why
  * a particular segment's replication is stuck.
@@ -982,14 +1233,14 @@ ReplicatedSegment::dumpProgress()
             "    sent: open %u, bytes %u, close %u\n"
             "    acked: open %u, bytes %u, close %u\n"
             "    committed: open %u, bytes, %u, close %u\n"
-            "    write rpc outstanding: %u\n",
+            "    write rpc outstanding: %u, relay index %u\n",
             i++,
             replica.backupId.toString().c_str(), backupLocator.c_str(),
             replica.sent.open, replica.sent.bytes, replica.sent.close,
             replica.acked.open, replica.acked.bytes, replica.acked.close,
             replica.committed.open, replica.committed.bytes,
             replica.committed.close,
-            bool(replica.writeRpc)));
+            bool(replica.writeRpc), replica.relayIndex));
     }
     LOG(NOTICE, "\n%s", info.c_str());
 }
@@ -230,6 +230,8 @@ class ReplicatedSegment : public Task {
             , sent()
             , freeRpc()
             , writeRpc()
+            , writeRpcStartTicks(0)
+            , relayIndex(0)
             , replacesLostReplica(false)
             , sentCertificate(false)
         {}
@@ -269,6 +271,21 @@ class ReplicatedSegment : public Task {
             this->replacesLostReplica = replacesLostReplica;
         }
 
+        /**
+         * Record that the backup has acknowledged everything in #sent.
+         */
+        void acknowledgeSent() {
+            acked = sent;
+            if (sentCertificate) {
+                committed = acked;
+            } else {
+                // Update open bit even if certificate wasn't sent; this
+                // is needed to avoid deadlocks over the safety
+                // constraints during recovery of lost replicas.
+                committed.open = acked.open;
+            }
+        }
+
         /**
          * If true the rest of the fields in this structure are valid and
          * represent the known state of some replica.  Otherwise, this
@@ -314,6 +331,19 @@ class ReplicatedSegment : public Task {
         /// The outstanding write operation to this backup, if any.
         Tub<WriteSegmentRpc> writeRpc;
 
+        /// Cycles::rdtsc() when #writeRpc was sent; used to measure backup
+        /// write latency for the WriteRpcWindow.
+        uint64_t writeRpcStartTicks;
+
+        /**
+         * If nonzero, the data in #sent beyond #acked was not sent to this
+         * replica's backup by the master; instead the primary replica's
+         * write rpc asked its backup to relay it, as entry (relayIndex - 1)
+         * of the relay list. This replica has no write rpc of its own
+         * until the primary's completes. See #relayWrites.
+         */
+        uint32_t relayIndex;
+
         // Fields below survive across failed()/start() calls.
 
         /**
@@ -336,13 +366,72 @@ class ReplicatedSegment : public Task {
         DISALLOW_COPY_AND_ASSIGN(Replica);
     };
 
+    /**
+     * Decides how many write rpcs to backups may be outstanding at once
+     * across all the ReplicatedSegments of a ReplicaManager. A fixed limit
+     * is either too low to keep fast backups busy (small log syncs make rpcs
+     * whose cost is mostly round-trip latency) or too high for slow backups,
+     * where extra rpcs just queue up at the backup and delay syncs. Instead,
+     * the window is sized from observed write latency: once per window's
+     * worth of completed rpcs it grows by one if the average latency stayed
+     * close to the lowest latency seen so far, and halves if the average
+     * rose well above it (meaning backups are queueing requests).
+     */
+    class WriteRpcWindow {
+      PUBLIC:
+        WriteRpcWindow()
+            : size(INITIAL_SIZE)
+            , minLatencyCycles(~0LU)
+            , latencyCycles(0)
+            , samples(0)
+        {}
+
+        /// Return true if no more write rpcs should be sent while
+        /// \a rpcsInFlight are outstanding.
+        bool isFull(uint32_t rpcsInFlight) const {
+            return rpcsInFlight >= size;
+        }
+
+        /// Return true if no more write rpcs that re-create lost replicas
+        /// of closed segments should be sent while \a rpcsInFlight are
+        /// outstanding: they may use only half of the window, so that the
+        /// rest is left for log syncs however many replicas were lost.
+        bool isFullForRecovery(uint32_t rpcsInFlight) const {
+            return 2 * rpcsInFlight >= size;
+        }
+
+        void rpcCompleted(uint64_t cycles);
+
+        /// Bounds and starting point for #size.
+        enum { MIN_SIZE = 4, INITIAL_SIZE = 8, MAX_SIZE = 32 };
+
+        /// Current number of write rpcs allowed in flight.
+        uint32_t size;
+
+        /// Lowest write rpc latency observed; approximates the latency of
+        /// an unloaded backup.
+        uint64_t minLatencyCycles;
+
+        /// Sum of the latencies of the #samples rpcs completed since #size
+        /// was last adjusted.
+        uint64_t latencyCycles;
+
+        /// Number of rpcs completed since #size was last adjusted.
+        uint32_t samples;
+
+        DISALLOW_COPY_AND_ASSIGN(WriteRpcWindow);
+    };
+
 // --- ReplicatedSegment ---
   PUBLIC:
     void free();
     bool isSynced() const;
+    bool isCommitted(uint32_t offset, uint32_t minReplicas = ~0u);
     void close();
     void handleBackupFailure(ServerId failedId, bool useMinCopysets);
+    void queueSync(uint32_t offset, SegmentCertificate* certificate);
     void sync(uint32_t offset = ~0u, SegmentCertificate* certificate = NULL);
+    void waitForReplicas(uint32_t offset, uint32_t minReplicas);
     const Segment* swapSegment(const Segment* newSegment);
 
     /**
@@ -357,12 +446,6 @@ class ReplicatedSegment : public Task {
   PRIVATE:
     friend class ReplicaManager;
 
-    /**
-     * Maximum number of simultaneous outstanding write rpcs to backups
-     * to allow across all ReplicatedSegments.
-     */
-    enum { MAX_WRITE_RPCS_IN_FLIGHT = 8 };
-
     /**
      * Maximum number of simultaneous outstanding free rpcs to backups
      * to allow across all ReplicatedSegments.
@@ -374,6 +457,7 @@ class ReplicatedSegment : public Task {
                       BaseBackupSelector& backupSelector,
                       Deleter& deleter,
                       uint32_t& writeRpcsInFlight,
+                      WriteRpcWindow& writeRpcWindow,
                       uint32_t& freeRpcsInFlight,
                       UpdateReplicationEpochTask& replicationEpoch,
                       std::mutex& dataMutex,
@@ -382,14 +466,19 @@ class ReplicatedSegment : public Task {
                       bool normalLogSegment,
                       ServerId masterId,
                       uint32_t numReplicas,
+                      bool relayWrites,
+                      bool compressWrites,
                       Tub<CycleCounter<RawMetric>>* replicationCounter = NULL,
                       uint32_t maxBytesPerWriteRpc = 1024 * 1024);
     ~ReplicatedSegment();
 
+    bool committedThrough(uint32_t offset, uint32_t minReplicas = ~0u) const;
+    void queueThrough(uint32_t offset, SegmentCertificate* certificate);
     void schedule();
     void performTask();
     void performFree(Replica& replica);
     void performWrite(Replica& replica);
+    bool cancelRelays();
 
     void dumpProgress();
 
@@ -434,6 +523,12 @@ class ReplicatedSegment : public Task {
      */
     uint32_t& writeRpcsInFlight;
 
+    /**
+     * Limits #writeRpcsInFlight; shared among all ReplicatedSegments.
+     * See WriteRpcWindow.
+     */
+    WriteRpcWindow& writeRpcWindow;
+
     /**
      * Number of outstanding free rpcs to backups across all
      * ReplicatedSegments.  Needed because the cleaner can potentially
@@ -498,6 +593,21 @@ class ReplicatedSegment : public Task {
      */
     const uint32_t maxBytesPerWriteRpc;
 
+    /**
+     * If true, once all replicas are open and caught up with each other,
+     * writes are sent only to the primary replica's backup, which relays
+     * them to the other replicas' backups. This cuts the master's outgoing
+     * replication traffic by a factor of the number of replicas at the
+     * cost of an extra hop of latency.
+     */
+    const bool relayWrites;
+
+    /**
+     * If true, the data in write rpcs is Lz4 compressed to save network
+     * bandwidth to backups (see WriteSegmentRpc).
+     */
+    const bool compressWrites;
+
     /**
      * Tracks how much of a segment the log module has made available for
      * replication.
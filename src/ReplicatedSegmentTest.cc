@@ -19,6 +19,7 @@
 #include "BackupSelector.h"
 #include "Memory.h"
 #include "PerfStats.h"
+#include "RawMetrics.h"
 #include "ReplicatedSegment.h"
 #include "Segment.h"
 #include "ShortMacros.h"
@@ -112,6 +113,7 @@ struct ReplicatedSegmentTest : public ::testing::Test {
                                               test->backupSelector,
                                               test->deleter,
                                               test->writeRpcsInFlight,
+                                              test->writeRpcWindow,
                                               test->freeRpcsInFlight,
                                               test->replicationEpoch,
                                               test->dataMutex,
@@ -120,6 +122,8 @@ struct ReplicatedSegmentTest : public ::testing::Test {
                                               true,
                                               test->masterId,
                                               numReplicas,
+                                              test->relayWrites,
+                                              test->compressWrites,
                                               NULL,
                                               MAX_BYTES_PER_WRITE));
             // Set up ordering constraints between this new segment and the
@@ -142,7 +146,10 @@ struct ReplicatedSegmentTest : public ::testing::Test {
     ServerList serverList;
     CountingDeleter deleter;
     uint32_t writeRpcsInFlight;
+    ReplicatedSegment::WriteRpcWindow writeRpcWindow;
     uint32_t freeRpcsInFlight;
+    bool relayWrites;
+    bool compressWrites;
     std::mutex dataMutex;
     const ServerId masterId;
     const uint64_t segmentId;
@@ -165,7 +172,10 @@ struct ReplicatedSegmentTest : public ::testing::Test {
         , serverList(&context)
         , deleter()
         , writeRpcsInFlight(0)
+        , writeRpcWindow()
         , freeRpcsInFlight(0)
+        , relayWrites(false)
+        , compressWrites(false)
         , dataMutex()
         , masterId(999, 0)
         , segmentId(888)
@@ -462,6 +472,61 @@ TEST_F(ReplicatedSegmentTest, handleBackupFailureWithMinCopysets) {
     EXPECT_TRUE(segment->replicas[1].replacesLostReplica);
 }
 
+TEST_F(ReplicatedSegmentTest, queueSync) {
+    transport.setInput("0 0"); // write
+    transport.setInput("0 0"); // write
+    transport.setInput("0 0"); // write
+    transport.setInput("0 0"); // write
+
+    createSegment->logSegment.head = openLen;
+    segment->sync(openLen); // sends the opens
+    transport.clearOutput();
+
+    createSegment->logSegment.head = openLen + 10;
+    SegmentCertificate certificate;
+    createSegment->logSegment.getAppendedLength(&certificate);
+    segment->queueSync(openLen + 10, &certificate);
+    EXPECT_EQ(openLen + 10, segment->queued.bytes);
+    EXPECT_TRUE(segment->isScheduled());
+    EXPECT_TRUE(transport.output.empty());
+    EXPECT_TRUE(segment->isCommitted(openLen));
+    EXPECT_FALSE(segment->isCommitted(openLen + 10));
+
+    for (int i = 0; i < 10 && !segment->isCommitted(openLen + 10); i++)
+        taskQueue.performTask();
+    EXPECT_TRUE(segment->isCommitted(openLen + 10));
+    EXPECT_EQ(openLen + 10, segment->getCommitted().bytes);
+
+    // Already committed: nothing more is queued.
+    transport.clearOutput();
+    segment->queueSync(openLen + 5, NULL);
+    EXPECT_EQ(openLen + 10, segment->queued.bytes);
+    EXPECT_TRUE(taskQueue.isIdle());
+}
+
+TEST_F(ReplicatedSegmentTest, committedThrough_minReplicas) {
+    transport.setInput("0 0"); // write
+    transport.setInput("0 0"); // write
+
+    createSegment->logSegment.head = openLen;
+    segment->sync(openLen); // sends the opens
+    EXPECT_TRUE(segment->committedThrough(openLen, 1));
+
+    // Only the first replica has the new data.
+    segment->queued.bytes = openLen + 10;
+    segment->replicas[0].committed.bytes = openLen + 10;
+    EXPECT_FALSE(segment->committedThrough(openLen + 10));
+    EXPECT_TRUE(segment->committedThrough(openLen + 10, 1));
+    EXPECT_FALSE(segment->committedThrough(openLen + 10, 2));
+    EXPECT_TRUE(segment->committedThrough(openLen + 10, 0));
+    EXPECT_FALSE(segment->committedThrough(~0u, 1));
+
+    segment->replicas[1].isActive = false;
+    EXPECT_TRUE(segment->committedThrough(openLen + 10, 1));
+    segment->replicas[0].isActive = false;
+    EXPECT_FALSE(segment->committedThrough(openLen + 10, 1));
+}
+
 TEST_F(ReplicatedSegmentTest, sync) {
     transport.setInput("0 0"); // write
     transport.setInput("0 0"); // write
@@ -469,7 +534,9 @@ TEST_F(ReplicatedSegmentTest, sync) {
     transport.setInput("0 0"); // write
 
     createSegment->logSegment.head = openLen;
+    uint64_t syncs = PerfStats::threadStats.replicationSyncs;
     segment->sync(segment->queued.bytes); // first sync sends the opens
+    EXPECT_EQ(1u, PerfStats::threadStats.replicationSyncs - syncs);
     SegmentCertificate certificate;
     createSegment->logSegment.getAppendedLength(&certificate);
     EXPECT_TRUE(transport.outputMatches(0, MockTransport::SEND_REQUEST,
@@ -486,6 +553,7 @@ TEST_F(ReplicatedSegmentTest, sync) {
 
     segment->sync(segment->queued.bytes); // second sync doesn't send anything
     EXPECT_EQ("", transport.outputLog);
+    EXPECT_EQ(1u, PerfStats::threadStats.replicationSyncs - syncs);
     transport.clearOutput();
     EXPECT_EQ(openLen, segment->getCommitted().bytes);
 
@@ -1222,7 +1290,7 @@ TEST_F(ReplicatedSegmentTest, performWriteTooManyInFlight) {
     ASSERT_TRUE(segment->replicas[1].isActive);
     EXPECT_FALSE(segment->replicas[1].writeRpc);
 
-    writeRpcsInFlight = ReplicatedSegment::MAX_WRITE_RPCS_IN_FLIGHT;
+    writeRpcsInFlight = writeRpcWindow.size;
     createSegment->logSegment.head = openLen + 10; // write queued
     segment->queued.bytes = openLen + 10;
     segment->schedule();
@@ -1231,9 +1299,9 @@ TEST_F(ReplicatedSegmentTest, performWriteTooManyInFlight) {
 
     EXPECT_TRUE(segment->replicas[0].isActive);
     EXPECT_EQ(openLen, segment->replicas[0].sent.bytes);
-    EXPECT_EQ(ReplicatedSegment::MAX_WRITE_RPCS_IN_FLIGHT, writeRpcsInFlight);
+    EXPECT_EQ(writeRpcWindow.size, writeRpcsInFlight);
 
-    writeRpcsInFlight = ReplicatedSegment::MAX_WRITE_RPCS_IN_FLIGHT - 1;
+    writeRpcsInFlight = writeRpcWindow.size - 1;
     taskQueue.performTask(); // retry writes since a slot freed up
     EXPECT_TRUE(transport.outputMatches(0, MockTransport::SEND_REQUEST,
         WrReq{{BACKUP_WRITE, BACKUP_SERVICE, 0},
@@ -1241,7 +1309,7 @@ TEST_F(ReplicatedSegmentTest, performWriteTooManyInFlight) {
                  openingCertificate},
                 "klmnopqrst", 10));
     transport.clearOutput();
-    EXPECT_EQ(ReplicatedSegment::MAX_WRITE_RPCS_IN_FLIGHT, writeRpcsInFlight);
+    EXPECT_EQ(writeRpcWindow.size, writeRpcsInFlight);
     ASSERT_TRUE(segment->replicas[0].isActive);
     EXPECT_TRUE(segment->replicas[0].writeRpc);
     EXPECT_EQ(openLen + 10, segment->replicas[0].sent.bytes);
@@ -1255,7 +1323,7 @@ TEST_F(ReplicatedSegmentTest, performWriteTooManyInFlight) {
                  999, 888, 0, 10, 10, false, false, false,
                  true, openingCertificate},
                 "klmnopqrst", 10));
-    EXPECT_EQ(ReplicatedSegment::MAX_WRITE_RPCS_IN_FLIGHT, writeRpcsInFlight);
+    EXPECT_EQ(writeRpcWindow.size, writeRpcsInFlight);
     ASSERT_TRUE(segment->replicas[1].isActive);
     EXPECT_TRUE(segment->replicas[1].writeRpc);
     EXPECT_EQ(openLen + 10, segment->replicas[1].sent.bytes);
@@ -1264,8 +1332,7 @@ TEST_F(ReplicatedSegmentTest, performWriteTooManyInFlight) {
 
     taskQueue.performTask(); // reap write
     EXPECT_FALSE(segment->replicas[1].writeRpc);
-    EXPECT_EQ(uint32_t(ReplicatedSegment::MAX_WRITE_RPCS_IN_FLIGHT - 1),
-              writeRpcsInFlight);
+    EXPECT_EQ(writeRpcWindow.size - 1, writeRpcsInFlight);
     EXPECT_FALSE(segment->isScheduled());
     EXPECT_EQ(0u, deleter.count);
 }
@@ -1312,14 +1379,14 @@ TEST_F(ReplicatedSegmentTest, performWriteOpenTooManyInFlight) {
     transport.setInput("0 0"); // write
     transport.setInput("0 0"); // write
 
-    writeRpcsInFlight = ReplicatedSegment::MAX_WRITE_RPCS_IN_FLIGHT;
+    writeRpcsInFlight = writeRpcWindow.size;
     taskQueue.performTask(); // try to send writes, shouldn't be able to.
 
     EXPECT_TRUE(segment->replicas[0].isActive);
     EXPECT_FALSE(segment->replicas[0].sent.open);
-    EXPECT_EQ(ReplicatedSegment::MAX_WRITE_RPCS_IN_FLIGHT, writeRpcsInFlight);
+    EXPECT_EQ(writeRpcWindow.size, writeRpcsInFlight);
 
-    writeRpcsInFlight = ReplicatedSegment::MAX_WRITE_RPCS_IN_FLIGHT - 1;
+    writeRpcsInFlight = writeRpcWindow.size - 1;
     taskQueue.performTask(); // retry writes since a slot freed up
     SegmentCertificate certificate;
     createSegment->logSegment.getAppendedLength(&certificate);
@@ -1327,7 +1394,7 @@ TEST_F(ReplicatedSegmentTest, performWriteOpenTooManyInFlight) {
         WrReq{{BACKUP_WRITE, BACKUP_SERVICE, 0},
                  999, 888, 0, 0, 10, true, false, true, true, certificate},
                 "abcdefghij", 10));
-    EXPECT_EQ(ReplicatedSegment::MAX_WRITE_RPCS_IN_FLIGHT, writeRpcsInFlight);
+    EXPECT_EQ(writeRpcWindow.size, writeRpcsInFlight);
     ASSERT_TRUE(segment->replicas[0].isActive);
     EXPECT_TRUE(segment->replicas[0].writeRpc);
     EXPECT_TRUE(segment->replicas[0].sent.open);
@@ -1341,7 +1408,7 @@ TEST_F(ReplicatedSegmentTest, performWriteOpenTooManyInFlight) {
         WrReq{{BACKUP_WRITE, BACKUP_SERVICE, 1},
                  999, 888, 0, 0, 10, true, false, false, true, certificate},
                 "abcdefghij", 10));
-    EXPECT_EQ(ReplicatedSegment::MAX_WRITE_RPCS_IN_FLIGHT, writeRpcsInFlight);
+    EXPECT_EQ(writeRpcWindow.size, writeRpcsInFlight);
     ASSERT_TRUE(segment->replicas[1].isActive);
     EXPECT_TRUE(segment->replicas[1].writeRpc);
     EXPECT_TRUE(segment->replicas[1].sent.open);
@@ -1351,8 +1418,7 @@ TEST_F(ReplicatedSegmentTest, performWriteOpenTooManyInFlight) {
 
     taskQueue.performTask(); // reap write
     EXPECT_FALSE(segment->replicas[1].writeRpc);
-    EXPECT_EQ(uint32_t(ReplicatedSegment::MAX_WRITE_RPCS_IN_FLIGHT - 1),
-              writeRpcsInFlight);
+    EXPECT_EQ(writeRpcWindow.size - 1, writeRpcsInFlight);
     EXPECT_FALSE(segment->isScheduled());
     EXPECT_EQ(0u, deleter.count);
 }
@@ -1363,7 +1429,13 @@ TEST_F(ReplicatedSegmentTest, performWriteRpcIsReady) {
 
     segment->close();
 
+    PerfStats before = PerfStats::threadStats;
     taskQueue.performTask();
+    EXPECT_EQ(1u, PerfStats::threadStats.replicationRpcs -
+            before.replicationRpcs);
+    EXPECT_EQ(openLen, PerfStats::threadStats.replicationRpcBytes -
+            before.replicationRpcBytes);
+    EXPECT_EQ(0u, writeRpcWindow.samples);
     ASSERT_TRUE(segment->replicas[0].isActive);
     EXPECT_EQ(openLen, segment->replicas[0].sent.bytes);
     EXPECT_EQ(0u, segment->replicas[0].acked.bytes);
@@ -1375,10 +1447,175 @@ TEST_F(ReplicatedSegmentTest, performWriteRpcIsReady) {
     EXPECT_EQ(openLen, segment->replicas[0].committed.bytes);
     EXPECT_TRUE(segment->isScheduled());
     EXPECT_FALSE(segment->replicas[0].writeRpc);
+    EXPECT_EQ(1u, writeRpcWindow.samples);
     EXPECT_EQ(0u, deleter.count);
     reset();
 }
 
+TEST_F(ReplicatedSegmentTest, performWriteThrottlesReReplication) {
+    transport.setInput("0 0"); // open
+    transport.setInput("0 0"); // open
+    createSegment->logSegment.head = openLen; // write queued
+    segment->close();
+    taskQueue.performTask(); // send opens
+    taskQueue.performTask(); // reap opens
+    transport.setInput("0 0"); // close
+    transport.setInput("0 0"); // close
+    taskQueue.performTask(); // send closes
+    taskQueue.performTask(); // reap closes
+    ASSERT_TRUE(segment->getCommitted().close);
+
+    segment->handleBackupFailure({1, 0}, false);
+    EXPECT_TRUE(segment->replicas[1].replacesLostReplica);
+    transport.setInput("0 0"); // open
+    taskQueue.performTask(); // send open
+    taskQueue.performTask(); // reap open
+    ASSERT_TRUE(segment->replicas[1].committed.open);
+
+    // Re-replication may only use half of the window.
+    writeRpcsInFlight = writeRpcWindow.size / 2;
+    taskQueue.performTask();
+    EXPECT_FALSE(segment->replicas[1].writeRpc);
+    EXPECT_EQ(0u, segment->replicas[1].sent.bytes);
+    EXPECT_TRUE(segment->isScheduled());
+
+    uint64_t bytes = metrics->master.replicaRecoveryBytes;
+    uint64_t completed = metrics->master.replicaRecoveriesCompleted;
+    writeRpcsInFlight = 0;
+    transport.setInput("0 0"); // close
+    taskQueue.performTask(); // send write
+    EXPECT_TRUE(segment->replicas[1].writeRpc);
+    EXPECT_EQ(openLen, metrics->master.replicaRecoveryBytes - bytes);
+    taskQueue.performTask(); // reap write
+    EXPECT_TRUE(segment->replicas[1].committed.close);
+    EXPECT_EQ(1u, metrics->master.replicaRecoveriesCompleted - completed);
+    reset();
+}
+
+TEST_F(ReplicatedSegmentTest, WriteRpcWindow_isFullForRecovery) {
+    ReplicatedSegment::WriteRpcWindow window;
+    window.size = 8;
+    EXPECT_FALSE(window.isFullForRecovery(3));
+    EXPECT_TRUE(window.isFullForRecovery(4));
+    EXPECT_FALSE(window.isFull(4));
+}
+
+TEST_F(ReplicatedSegmentTest, WriteRpcWindow_rpcCompleted) {
+    ReplicatedSegment::WriteRpcWindow window;
+    uint32_t initialSize = window.size;
+    for (uint32_t i = 0; i < initialSize - 1; i++)
+        window.rpcCompleted(100);
+    EXPECT_EQ(initialSize, window.size);
+    EXPECT_EQ(100u, window.minLatencyCycles);
+
+    // Latency stayed near the minimum: grow.
+    window.rpcCompleted(150);
+    EXPECT_EQ(initialSize + 1, window.size);
+    EXPECT_EQ(0u, window.samples);
+
+    // Moderately elevated latency: hold steady.
+    for (uint32_t i = 0; i < initialSize + 1; i++)
+        window.rpcCompleted(300);
+    EXPECT_EQ(initialSize + 1, window.size);
+
+    // Backups are queueing: back off, but not below the minimum.
+    for (int round = 0; round < 5; round++) {
+        uint32_t size = window.size;
+        for (uint32_t i = 0; i < size; i++)
+            window.rpcCompleted(1000);
+    }
+    EXPECT_EQ(uint32_t(ReplicatedSegment::WriteRpcWindow::MIN_SIZE),
+              window.size);
+
+    window.size = ReplicatedSegment::WriteRpcWindow::MAX_SIZE;
+    for (uint32_t i = 0; i < window.size; i++)
+        window.rpcCompleted(100);
+    EXPECT_EQ(uint32_t(ReplicatedSegment::WriteRpcWindow::MAX_SIZE),
+              window.size);
+}
+
+TEST_F(ReplicatedSegmentTest, performWriteRelayed) {
+    reset();
+    relayWrites = true;
+    CreateSegment relaying(this, NULL, segmentId + 1, numReplicas);
+    ReplicatedSegment* relayed = relaying.segment.get();
+    transport.setInput("0 0"); // open
+    transport.setInput("0 0"); // open
+    transport.setInput("0 1"); // write, relayed to the second replica
+    taskQueue.performTask(); // send opens
+    taskQueue.performTask(); // reap opens
+    transport.clearOutput();
+
+    relaying.logSegment.head = openLen + 10; // write queued
+    relayed->queued.bytes = openLen + 10;
+    SegmentCertificate certificate;
+    relaying.logSegment.getAppendedLength(&certificate);
+    relayed->queuedCertificate = certificate;
+    relayed->schedule();
+    {
+        TestLog::Enable _(filter);
+        taskQueue.performTask();
+        EXPECT_EQ("performWrite: Sending write to backup 0.0 | "
+                  "performWrite: Relaying write through backup 0.0 to 1 "
+                  "other backups", TestLog::get());
+    }
+    WrReq header{{BACKUP_WRITE, BACKUP_SERVICE, 0},
+                 999, 889, 0, 10, 10, false, false, true, true, certificate};
+    header.relayCount = 1;
+    char payload[sizeof(uint64_t) + 10];
+    uint64_t relayTo = backupId2.getId();
+    memcpy(payload, &relayTo, sizeof(relayTo));
+    memcpy(payload + sizeof(relayTo), "klmnopqrst", 10);
+    EXPECT_EQ(1u, transport.output.size());
+    EXPECT_TRUE(transport.outputMatches(0, MockTransport::SEND_REQUEST,
+                                        header, payload, sizeof(payload)));
+    EXPECT_EQ(1u, writeRpcsInFlight);
+    EXPECT_FALSE(relayed->replicas[1].writeRpc);
+    EXPECT_EQ(1u, relayed->replicas[1].relayIndex);
+    EXPECT_EQ(openLen + 10, relayed->replicas[1].sent.bytes);
+
+    taskQueue.performTask(); // reap write
+    EXPECT_EQ(0u, relayed->replicas[1].relayIndex);
+    EXPECT_EQ(openLen + 10, relayed->replicas[1].committed.bytes);
+    EXPECT_EQ(openLen + 10, relayed->getCommitted().bytes);
+    EXPECT_EQ(0u, writeRpcsInFlight);
+    EXPECT_FALSE(relayed->isScheduled());
+}
+
+TEST_F(ReplicatedSegmentTest, performWriteRelayFailed) {
+    reset();
+    relayWrites = true;
+    CreateSegment relaying(this, NULL, segmentId + 1, numReplicas);
+    ReplicatedSegment* relayed = relaying.segment.get();
+    transport.setInput("0 0"); // open
+    transport.setInput("0 0"); // open
+    transport.setInput("0 0"); // write, but the relay failed
+    transport.setInput("0 0"); // direct write to the second replica
+    taskQueue.performTask(); // send opens
+    taskQueue.performTask(); // reap opens
+
+    relaying.logSegment.head = openLen + 10; // write queued
+    relayed->queued.bytes = openLen + 10;
+    relayed->schedule();
+    taskQueue.performTask(); // send relayed write
+    EXPECT_EQ(1u, relayed->replicas[1].relayIndex);
+    transport.clearOutput();
+
+    taskQueue.performTask(); // reap write; second replica wasn't written
+    EXPECT_EQ(openLen + 10, relayed->replicas[0].committed.bytes);
+    EXPECT_EQ(0u, relayed->replicas[1].relayIndex);
+    EXPECT_TRUE(relayed->replicas[1].writeRpc);
+    EXPECT_TRUE(transport.outputMatches(0, MockTransport::SEND_REQUEST,
+        WrReq{{BACKUP_WRITE, BACKUP_SERVICE, 1},
+                 999, 889, 0, 10, 10, false, false, false, true,
+                 relayed->queuedCertificate},
+                "klmnopqrst", 10));
+
+    taskQueue.performTask(); // reap write
+    EXPECT_EQ(openLen + 10, relayed->getCommitted().bytes);
+    EXPECT_FALSE(relayed->isScheduled());
+}
+
 TEST_F(ReplicatedSegmentTest, performWriteRpcFailed) {
     ServerIdRpcWrapper::ConvertExceptionsToDoesntExist _;
     transport.clearInput();
@@ -0,0 +1,171 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <algorithm>
+
+#include "RpcCompletionQueue.h"
+#include "RamCloud.h"
+#include "RpcWrapper.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct an empty RpcCompletionQueue.
+ *
+ * \param ramcloud
+ *      The client whose RPCs will be added to the queue; its dispatcher
+ *      is polled by #poll.
+ */
+RpcCompletionQueue::RpcCompletionQueue(RamCloud* ramcloud)
+    : ramcloud(ramcloud)
+    , callbacks()
+    , mutex("RpcCompletionQueue::mutex")
+    , finished()
+    , retrying()
+{
+}
+
+/**
+ * Destructor for RpcCompletionQueue. The callbacks of any RPCs still in
+ * the queue are never invoked; the RPCs themselves are unaffected.
+ */
+RpcCompletionQueue::~RpcCompletionQueue()
+{
+    for (auto it = callbacks.begin(); it != callbacks.end(); it++)
+        it->first->completionQueue = NULL;
+}
+
+/**
+ * Arrange for a callback to be invoked (by #poll) once an RPC is ready.
+ *
+ * \param rpc
+ *      An RPC that has been started (normally by its constructor). It must
+ *      not already be in a queue. If it is canceled or destroyed before it
+ *      is ready, it is removed from the queue without invoking the callback.
+ * \param callback
+ *      Invoked once, when rpc->isReady() returns true.
+ */
+void
+RpcCompletionQueue::add(RpcWrapper* rpc, Callback callback)
+{
+    assert(rpc->completionQueue == NULL);
+    callbacks[rpc] = callback;
+    rpc->completionQueue = this;
+
+    // The RPC may have finished already, in which case no transport will
+    // tell us about it.
+    SpinLock::Guard _(mutex);
+    finished.push_back(rpc);
+}
+
+/**
+ * Return true if no RPCs in the queue are waiting for their callbacks.
+ */
+bool
+RpcCompletionQueue::empty()
+{
+    return callbacks.empty();
+}
+
+/**
+ * Poll the client's dispatcher (see RamCloud::poll), then invoke the
+ * callbacks of any RPCs in the queue that have become ready. Only RPCs
+ * that transports have finished with, or that are waiting to be retried,
+ * are checked, so the cost doesn't grow with the number of RPCs that are
+ * still outstanding.
+ *
+ * \return
+ *      The number of callbacks invoked.
+ */
+int
+RpcCompletionQueue::poll()
+{
+    ramcloud->poll();
+
+    std::vector<RpcWrapper*> candidates;
+    {
+        SpinLock::Guard _(mutex);
+        candidates.swap(finished);
+    }
+    candidates.insert(candidates.end(), retrying.begin(), retrying.end());
+    retrying.clear();
+
+    int invoked = 0;
+    foreach (RpcWrapper* rpc, candidates) {
+        // The RPC may have been removed (even destroyed) by an earlier
+        // callback.
+        auto it = callbacks.find(rpc);
+        if (it == callbacks.end())
+            continue;
+        if (!rpc->isReady()) {
+            if (rpc->getState() == RpcWrapper::RETRY)
+                retrying.push_back(rpc);
+            continue;
+        }
+        Callback callback(std::move(it->second));
+        callbacks.erase(it);
+        rpc->completionQueue = NULL;
+        callback();
+        invoked++;
+    }
+    return invoked;
+}
+
+/**
+ * Remove an RPC from the queue without invoking its callback; this
+ * happens automatically when an RPC is canceled or destroyed. Does
+ * nothing if the RPC isn't in the queue.
+ *
+ * \param rpc
+ *      The RPC to remove.
+ */
+void
+RpcCompletionQueue::remove(RpcWrapper* rpc)
+{
+    if (callbacks.erase(rpc) == 0)
+        return;
+    rpc->completionQueue = NULL;
+    retrying.erase(std::remove(retrying.begin(), retrying.end(), rpc),
+            retrying.end());
+    SpinLock::Guard _(mutex);
+    finished.erase(std::remove(finished.begin(), finished.end(), rpc),
+            finished.end());
+}
+
+/**
+ * Return the number of RPCs in the queue that are waiting for their
+ * callbacks.
+ */
+size_t
+RpcCompletionQueue::size()
+{
+    return callbacks.size();
+}
+
+/**
+ * Invoked by an RPC in the queue when a transport has finished with it
+ * (see RpcWrapper::completed); may be invoked in the dispatch thread.
+ *
+ * \param rpc
+ *      The RPC whose state changed.
+ */
+void
+RpcCompletionQueue::notify(RpcWrapper* rpc)
+{
+    SpinLock::Guard _(mutex);
+    finished.push_back(rpc);
+}
+
+} // namespace RAMCloud
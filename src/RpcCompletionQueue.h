@@ -0,0 +1,92 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_RPCCOMPLETIONQUEUE_H
+#define RAMCLOUD_RPCCOMPLETIONQUEUE_H
+
+#include <functional>
+#include <unordered_map>
+
+#include "Common.h"
+#include "SpinLock.h"
+
+namespace RAMCloud {
+
+class RamCloud;
+class RpcWrapper;
+
+/**
+ * An RpcCompletionQueue invokes a callback for each of a collection of
+ * asynchronous RPCs once it is ready, so that a thread can keep many
+ * independent RPCs outstanding without calling isReady on each of them
+ * in turn. Transports tell the queue when they finish with an RPC (from
+ * RpcWrapper::completed and RpcWrapper::failed); #poll then gives those
+ * RPCs (and only those) a chance to process their responses, including
+ * any retries, and invokes the callbacks of the ones that are ready.
+ *
+ * Typical use:
+ *     RpcCompletionQueue queue(ramcloud);
+ *     ReadRpc* rpc = new ReadRpc(ramcloud, tableId, key, keyLength, &value);
+ *     queue.add(rpc, [=] { rpc->wait(); ...; delete rpc; });
+ *     while (!queue.empty())
+ *         queue.poll();
+ *
+ * Callbacks run in the thread that invokes #poll, outside the dispatcher,
+ * so they may block, start new RPCs, or delete their RPC. This class is
+ * not thread-safe, except that transports may notify it from the dispatch
+ * thread: all of its other methods must be invoked by a single thread.
+ */
+class RpcCompletionQueue {
+  public:
+    /// Invoked once an RPC is ready; it should call the RPC's wait method
+    /// (which won't block) to collect the results or the exception.
+    typedef std::function<void()> Callback;
+
+    explicit RpcCompletionQueue(RamCloud* ramcloud);
+    ~RpcCompletionQueue();
+    void add(RpcWrapper* rpc, Callback callback);
+    bool empty();
+    int poll();
+    void remove(RpcWrapper* rpc);
+    size_t size();
+
+  PRIVATE:
+    void notify(RpcWrapper* rpc);
+
+    /// Used to poll the client's dispatcher.
+    RamCloud* ramcloud;
+
+    /// The callback for each RPC in the queue.
+    std::unordered_map<RpcWrapper*, Callback> callbacks;
+
+    /// Protects #finished, which is appended to by transports.
+    SpinLock mutex;
+
+    /// RPCs that transports have finished with since the last call to
+    /// #poll (they may be ready, or they may need to be retried). May
+    /// contain RPCs that have since been removed.
+    std::vector<RpcWrapper*> finished;
+
+    /// RPCs waiting until it's time to retry them; #poll checks these
+    /// each time, since no transport will notify us about them.
+    std::vector<RpcWrapper*> retrying;
+
+    friend class RpcWrapper;
+    DISALLOW_COPY_AND_ASSIGN(RpcCompletionQueue);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_RPCCOMPLETIONQUEUE_H
@@ -0,0 +1,166 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "RamCloud.h"
+#include "RpcCompletionQueue.h"
+#include "RpcWrapper.h"
+
+namespace RAMCloud {
+
+class RpcCompletionQueueTest : public ::testing::Test {
+  public:
+    Context context;
+    RamCloud ramcloud;
+    RpcCompletionQueue queue;
+    string log;
+
+    RpcCompletionQueueTest()
+        : context()
+        , ramcloud(&context, "mock:host=coordinator")
+        , queue(&ramcloud)
+        , log()
+    {
+    }
+
+    /// Make an RPC finish successfully, as a transport would.
+    void
+    complete(RpcWrapper* rpc)
+    {
+        rpc->response->emplaceAppend<WireFormat::ResponseCommon>()->status =
+                STATUS_OK;
+        rpc->completed();
+    }
+
+    /// Returns a callback that records that \a name is ready.
+    RpcCompletionQueue::Callback
+    logger(const char* name)
+    {
+        return [this, name] {
+            if (log.size() > 0)
+                log.append(", ");
+            log.append(name);
+        };
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(RpcCompletionQueueTest);
+};
+
+TEST_F(RpcCompletionQueueTest, destructor) {
+    RpcWrapper rpc(4);
+    rpc.send();
+    Tub<RpcCompletionQueue> other;
+    other.construct(&ramcloud);
+    other->add(&rpc, logger("rpc"));
+    EXPECT_EQ(other.get(), rpc.completionQueue);
+    other.destroy();
+    EXPECT_TRUE(rpc.completionQueue == NULL);
+}
+
+TEST_F(RpcCompletionQueueTest, add_alreadyReady) {
+    RpcWrapper rpc(4);
+    rpc.send();
+    complete(&rpc);
+    queue.add(&rpc, logger("rpc"));
+    EXPECT_EQ(1U, queue.size());
+    EXPECT_EQ(1, queue.poll());
+    EXPECT_EQ("rpc", log);
+    EXPECT_TRUE(queue.empty());
+    EXPECT_TRUE(rpc.completionQueue == NULL);
+}
+
+TEST_F(RpcCompletionQueueTest, poll_onlyChecksFinishedRpcs) {
+    RpcWrapper rpc1(4), rpc2(4);
+    rpc1.send();
+    rpc2.send();
+    queue.add(&rpc1, logger("rpc1"));
+    queue.add(&rpc2, logger("rpc2"));
+    EXPECT_EQ(0, queue.poll());
+    EXPECT_EQ(0U, queue.finished.size());
+
+    complete(&rpc2);
+    EXPECT_EQ(1U, queue.finished.size());
+    EXPECT_EQ(1, queue.poll());
+    EXPECT_EQ("rpc2", log);
+    EXPECT_EQ(1U, queue.size());
+
+    rpc1.failed();
+    EXPECT_EQ(1, queue.poll());
+    EXPECT_EQ("rpc2, rpc1", log);
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST_F(RpcCompletionQueueTest, poll_retry) {
+    RpcWrapper rpc(4);
+    rpc.send();
+    queue.add(&rpc, logger("rpc"));
+    rpc.retry(1000000, 1000000);
+    EXPECT_EQ(0, queue.poll());
+    EXPECT_EQ(1U, queue.retrying.size());
+
+    // Waiting RPCs are checked without being notified.
+    EXPECT_EQ(0, queue.poll());
+    EXPECT_EQ(1U, queue.retrying.size());
+    rpc.retryTime = 0;
+    EXPECT_EQ(0, queue.poll());
+    EXPECT_STREQ("IN_PROGRESS", rpc.stateString());
+    EXPECT_EQ(0U, queue.retrying.size());
+
+    complete(&rpc);
+    EXPECT_EQ(1, queue.poll());
+    EXPECT_EQ("rpc", log);
+}
+
+TEST_F(RpcCompletionQueueTest, poll_callbackDeletesRpc) {
+    RpcWrapper* rpc = new RpcWrapper(4);
+    rpc->send();
+    queue.add(rpc, [rpc] {
+        delete rpc;
+    });
+    complete(rpc);
+
+    // The second notification refers to a deleted RPC.
+    rpc->completed();
+    EXPECT_EQ(1, queue.poll());
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST_F(RpcCompletionQueueTest, remove) {
+    RpcWrapper rpc1(4), rpc2(4);
+    rpc1.send();
+    rpc2.send();
+    queue.add(&rpc1, logger("rpc1"));
+    queue.add(&rpc2, logger("rpc2"));
+    rpc2.retry(1000000, 1000000);
+    queue.poll();
+    complete(&rpc1);
+    rpc2.completed();
+
+    // Canceling an RPC removes it.
+    rpc2.cancel();
+    EXPECT_EQ(1U, queue.size());
+    EXPECT_EQ(1U, queue.finished.size());
+    EXPECT_EQ(0U, queue.retrying.size());
+    EXPECT_TRUE(rpc2.completionQueue == NULL);
+
+    queue.remove(&rpc1);
+    queue.remove(&rpc1);
+    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(0U, queue.finished.size());
+    EXPECT_EQ(0, queue.poll());
+    EXPECT_EQ("", log);
+}
+
+}  // namespace RAMCloud
@@ -0,0 +1,225 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <cmath>
+
+#include "RpcLatency.h"
+
+namespace RAMCloud {
+
+__thread RpcLatency* RpcLatency::threadLatency = NULL;
+SpinLock RpcLatency::mutex("RpcLatency::mutex");
+std::vector<RpcLatency*> RpcLatency::registeredThreads;
+
+/**
+ * Construct an RpcLatency with no histograms; only registerThread does this.
+ */
+RpcLatency::RpcLatency()
+    : opcodes()
+{
+}
+
+/**
+ * Return the smallest time counted by a histogram bucket.
+ *
+ * \param bucket
+ *      Index of the bucket (see getBucket).
+ * \return
+ *      The time, in cycles.
+ */
+uint64_t
+RpcLatency::getLowerBound(int bucket)
+{
+    if (bucket < SUB_BUCKETS)
+        return bucket;
+    int exponent = bucket / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+    uint64_t subBucket = bucket % SUB_BUCKETS;
+    return (SUB_BUCKETS + subBucket) << (exponent - SUB_BUCKET_BITS);
+}
+
+/**
+ * Add the histograms of all threads to a ServerStatistics, with one
+ * rpc_latency entry for each opcode and stage that has been recorded.
+ *
+ * \param[out] serverStats
+ *      The entries are appended to this.
+ */
+void
+RpcLatency::collect(ProtoBuf::ServerStatistics* serverStats)
+{
+    std::lock_guard<SpinLock> lock(mutex);
+    std::vector<uint64_t> total(NUM_BUCKETS);
+    for (int opcode = 0; opcode < WireFormat::ILLEGAL_RPC_TYPE; opcode++) {
+        for (int stage = 0; stage < NUM_STAGES; stage++) {
+            std::fill(total.begin(), total.end(), 0);
+            bool found = false;
+            foreach (RpcLatency* latency, registeredThreads) {
+                Histograms* histograms = latency->opcodes[opcode].load();
+                if (histograms == NULL)
+                    continue;
+                for (int b = 0; b < NUM_BUCKETS; b++)
+                    total[b] += histograms->counts[stage][b];
+                found = true;
+            }
+            if (!found)
+                continue;
+
+            ProtoBuf::ServerStatistics_RpcLatency* entry = NULL;
+            for (int b = 0; b < NUM_BUCKETS; b++) {
+                if (total[b] == 0)
+                    continue;
+                if (entry == NULL) {
+                    entry = serverStats->add_rpc_latency();
+                    entry->set_opcode(opcode);
+                    entry->set_stage(stage);
+                }
+                entry->add_bucket(b);
+                entry->add_count(total[b]);
+            }
+        }
+    }
+}
+
+/**
+ * Add the RPC latency histograms of one server to those of another (or
+ * to a running total for a cluster).
+ *
+ * \param from
+ *      Statistics whose rpc_latency entries are to be added.
+ * \param[out] to
+ *      The entries of \a from are added to the entries for the same opcode
+ *      and stage here, or appended if there are none.
+ */
+void
+RpcLatency::merge(const ProtoBuf::ServerStatistics& from,
+        ProtoBuf::ServerStatistics* to)
+{
+    std::vector<uint64_t> total(NUM_BUCKETS);
+    foreach (const ProtoBuf::ServerStatistics_RpcLatency& source,
+            from.rpc_latency()) {
+        ProtoBuf::ServerStatistics_RpcLatency* entry = NULL;
+        for (int i = 0; i < to->rpc_latency_size(); i++) {
+            ProtoBuf::ServerStatistics_RpcLatency* candidate =
+                    to->mutable_rpc_latency(i);
+            if ((candidate->opcode() == source.opcode()) &&
+                    (candidate->stage() == source.stage())) {
+                entry = candidate;
+                break;
+            }
+        }
+        if (entry == NULL) {
+            to->add_rpc_latency()->CopyFrom(source);
+            continue;
+        }
+
+        std::fill(total.begin(), total.end(), 0);
+        for (int i = 0; i < entry->bucket_size(); i++)
+            total[entry->bucket(i)] += entry->count(i);
+        for (int i = 0; i < source.bucket_size(); i++)
+            total[source.bucket(i)] += source.count(i);
+        entry->clear_bucket();
+        entry->clear_count();
+        for (int b = 0; b < NUM_BUCKETS; b++) {
+            if (total[b] == 0)
+                continue;
+            entry->add_bucket(b);
+            entry->add_count(total[b]);
+        }
+    }
+}
+
+/**
+ * Return a percentile of the times in a histogram.
+ *
+ * \param latency
+ *      The histogram, as returned by collect or merge.
+ * \param fraction
+ *      Selects the percentile: 0.5 for the median, 0.999 for the 99.9th
+ *      percentile, and so on.
+ * \return
+ *      The lower bound, in cycles, of the bucket holding the selected time,
+ *      or 0 if the histogram is empty.
+ */
+uint64_t
+RpcLatency::getPercentile(const ProtoBuf::ServerStatistics_RpcLatency& latency,
+        double fraction)
+{
+    uint64_t count = 0;
+    for (int i = 0; i < latency.count_size(); i++)
+        count += latency.count(i);
+    uint64_t target = static_cast<uint64_t>(
+            std::ceil(fraction * static_cast<double>(count)));
+    uint64_t seen = 0;
+    for (int i = 0; i < latency.count_size(); i++) {
+        seen += latency.count(i);
+        if (seen >= target)
+            return getLowerBound(latency.bucket(i));
+    }
+    return 0;
+}
+
+/**
+ * Discard all of the times recorded so far (on all threads). Used in tests;
+ * counts being recorded concurrently may be lost or kept.
+ */
+void
+RpcLatency::reset()
+{
+    std::lock_guard<SpinLock> lock(mutex);
+    foreach (RpcLatency* latency, registeredThreads) {
+        for (int opcode = 0; opcode < WireFormat::ILLEGAL_RPC_TYPE; opcode++) {
+            Histograms* histograms = latency->opcodes[opcode].load();
+            if (histograms != NULL)
+                memset(histograms, 0, sizeof(*histograms));
+        }
+    }
+}
+
+/**
+ * Create the histograms for the calling thread, the first time it records
+ * a time.
+ *
+ * \return
+ *      The thread's new RpcLatency (also stored in threadLatency).
+ */
+RpcLatency*
+RpcLatency::registerThread()
+{
+    RpcLatency* latency = new RpcLatency;
+    std::lock_guard<SpinLock> lock(mutex);
+    registeredThreads.push_back(latency);
+    threadLatency = latency;
+    return latency;
+}
+
+/**
+ * Create this thread's histograms for an opcode, the first time an RPC of
+ * that kind is recorded. Must only be called by the thread that owns this
+ * object.
+ *
+ * \param opcode
+ *      The kind of RPC.
+ * \return
+ *      The new (empty) histograms.
+ */
+RpcLatency::Histograms*
+RpcLatency::addOpcode(WireFormat::Opcode opcode)
+{
+    Histograms* histograms = new Histograms();
+    opcodes[opcode].store(histograms);
+    return histograms;
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,152 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_RPCLATENCY_H
+#define RAMCLOUD_RPCLATENCY_H
+
+#include <vector>
+#include "Atomic.h"
+#include "BitOps.h"
+#include "SpinLock.h"
+#include "WireFormat.h"
+#include "ServerStatistics.pb.h"
+
+namespace RAMCloud {
+
+/**
+ * This class keeps distributions of how long a server spends on each kind
+ * of RPC, broken down by stage (waiting for a worker, executing, syncing the
+ * log, and in total), so that a latency regression can be traced to the
+ * stage responsible. Recording is always on: each thread counts into its own
+ * histograms, which costs an increment and no synchronization, and readers
+ * add up the histograms of all threads when statistics are requested.
+ *
+ * Buckets are spaced logarithmically with SUB_BUCKETS linear buckets per
+ * power of two (as in HdrHistogram), so every recorded time is known to
+ * within 1/SUB_BUCKETS of its value, from a few cycles to several minutes.
+ *
+ * This class provides only static methods and variables: it isn't
+ * possible to construct an instance from outside.
+ */
+class RpcLatency {
+  public:
+    /// The parts of an RPC's life that are measured separately.
+    enum Stage {
+        WAITING = 0,        // From arrival until a worker starts on it.
+        EXECUTING = 1,      // Time in the service's handler.
+        LOG_SYNC = 2,       // Waiting for the log to be replicated.
+        TOTAL = 3,          // From arrival until the reply is sent.
+        RECEIVING = 4,      // From the first packet of the request reaching
+                            // this machine until arrival (only for drivers
+                            // that timestamp packets).
+        NUM_STAGES = 5
+    };
+
+    /// log2 of the number of buckets for each power of two.
+    static const int SUB_BUCKET_BITS = 3;
+    static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+
+    /// Times of 2^MAX_EXPONENT cycles or more all go in the last bucket.
+    static const int MAX_EXPONENT = 40;
+
+    static const int NUM_BUCKETS =
+            (MAX_EXPONENT - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    /**
+     * Return the index of the histogram bucket that counts a given time.
+     *
+     * \param cycles
+     *      A time, in Cycles::rdtsc ticks.
+     */
+    static inline int
+    getBucket(uint64_t cycles)
+    {
+        if (cycles < SUB_BUCKETS)
+            return static_cast<int>(cycles);
+        int exponent = BitOps::findLastSet(cycles) - 1;
+        if (exponent >= MAX_EXPONENT)
+            return NUM_BUCKETS - 1;
+        return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS +
+                static_cast<int>((cycles >> (exponent - SUB_BUCKET_BITS)) &
+                (SUB_BUCKETS - 1));
+    }
+
+    /**
+     * Count one RPC in the distribution for one of its stages. This is cheap
+     * enough to call for every RPC.
+     *
+     * \param opcode
+     *      The kind of RPC; NO_RPC (0) or illegal opcodes are ignored.
+     * \param stage
+     *      Which part of the RPC's life \a cycles measures.
+     * \param cycles
+     *      How long the stage took, in Cycles::rdtsc ticks.
+     */
+    static inline void
+    record(WireFormat::Opcode opcode, Stage stage, uint64_t cycles)
+    {
+        if ((opcode == 0) || (opcode >= WireFormat::ILLEGAL_RPC_TYPE))
+            return;
+        RpcLatency* latency = threadLatency;
+        if (latency == NULL)
+            latency = registerThread();
+        Histograms* histograms = latency->opcodes[opcode].load();
+        if (histograms == NULL)
+            histograms = latency->addOpcode(opcode);
+        histograms->counts[stage][getBucket(cycles)]++;
+    }
+
+    static uint64_t getLowerBound(int bucket);
+    static void collect(ProtoBuf::ServerStatistics* serverStats);
+    static void merge(const ProtoBuf::ServerStatistics& from,
+            ProtoBuf::ServerStatistics* to);
+    static uint64_t getPercentile(
+            const ProtoBuf::ServerStatistics_RpcLatency& latency,
+            double fraction);
+    static void reset();
+
+  PRIVATE:
+    /// Counts for all of the stages of one opcode, on one thread.
+    struct Histograms {
+        uint64_t counts[NUM_STAGES][NUM_BUCKETS];
+    };
+
+    RpcLatency();
+    static RpcLatency* registerThread();
+    Histograms* addOpcode(WireFormat::Opcode opcode);
+
+    /// Histograms for each opcode that this thread has recorded, indexed
+    /// by opcode. Entries are NULL until the first RPC of that kind is
+    /// recorded; once set, they never change (readers on other threads
+    /// may use them at any time).
+    Atomic<Histograms*> opcodes[WireFormat::ILLEGAL_RPC_TYPE];
+
+    /// The calling thread's histograms; NULL until it records something.
+    static __thread RpcLatency* threadLatency;
+
+    /// Protects #registeredThreads.
+    static SpinLock mutex;
+
+    /// The histograms of every thread that has recorded anything. They are
+    /// never freed, so times recorded by threads that have exited are still
+    /// reported.
+    static std::vector<RpcLatency*> registeredThreads;
+
+    DISALLOW_COPY_AND_ASSIGN(RpcLatency);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_RPCLATENCY_H
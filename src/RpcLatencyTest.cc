@@ -0,0 +1,154 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "RpcLatency.h"
+
+namespace RAMCloud {
+
+class RpcLatencyTest : public ::testing::Test {
+  public:
+    RpcLatencyTest()
+    {
+        RpcLatency::reset();
+    }
+
+    /// Return the buckets and counts of a histogram as "bucket:count"
+    /// separated by spaces.
+    string
+    toString(const ProtoBuf::ServerStatistics_RpcLatency& latency)
+    {
+        string s;
+        for (int i = 0; i < latency.bucket_size(); i++) {
+            if (s.size() > 0)
+                s.append(" ");
+            s.append(format("%u:%lu", latency.bucket(i), latency.count(i)));
+        }
+        return s;
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(RpcLatencyTest);
+};
+
+TEST_F(RpcLatencyTest, getBucket) {
+    EXPECT_EQ(0, RpcLatency::getBucket(0));
+    EXPECT_EQ(7, RpcLatency::getBucket(7));
+    EXPECT_EQ(8, RpcLatency::getBucket(8));
+    EXPECT_EQ(15, RpcLatency::getBucket(15));
+    EXPECT_EQ(16, RpcLatency::getBucket(16));
+    EXPECT_EQ(16, RpcLatency::getBucket(17));
+    EXPECT_EQ(17, RpcLatency::getBucket(18));
+    EXPECT_EQ(RpcLatency::NUM_BUCKETS - 1,
+            RpcLatency::getBucket((1UL << RpcLatency::MAX_EXPONENT) - 1));
+    EXPECT_EQ(RpcLatency::NUM_BUCKETS - 1,
+            RpcLatency::getBucket(~0UL));
+}
+
+TEST_F(RpcLatencyTest, getLowerBound) {
+    for (int b = 0; b < RpcLatency::NUM_BUCKETS; b++) {
+        uint64_t lower = RpcLatency::getLowerBound(b);
+        EXPECT_EQ(b, RpcLatency::getBucket(lower));
+        if (lower > 0) {
+            EXPECT_EQ(b - 1, RpcLatency::getBucket(lower - 1));
+        }
+    }
+
+    // Every bucket is within 1/SUB_BUCKETS of its lower bound.
+    uint64_t lower = RpcLatency::getLowerBound(RpcLatency::getBucket(1000));
+    EXPECT_EQ(960U, lower);
+    EXPECT_GT(lower * (RpcLatency::SUB_BUCKETS + 1) / RpcLatency::SUB_BUCKETS,
+            1000U);
+}
+
+TEST_F(RpcLatencyTest, recordAndCollect) {
+    RpcLatency::record(WireFormat::READ, RpcLatency::TOTAL, 3);
+    RpcLatency::record(WireFormat::READ, RpcLatency::TOTAL, 3);
+    RpcLatency::record(WireFormat::READ, RpcLatency::TOTAL, 100);
+    RpcLatency::record(WireFormat::WRITE, RpcLatency::LOG_SYNC, 5);
+
+    // Not RPCs.
+    RpcLatency::record(WireFormat::Opcode(0), RpcLatency::TOTAL, 5);
+    RpcLatency::record(WireFormat::ILLEGAL_RPC_TYPE, RpcLatency::TOTAL, 5);
+
+    // Times recorded on other threads are included.
+    std::thread thread(RpcLatency::record, WireFormat::READ,
+            RpcLatency::TOTAL, 4);
+    thread.join();
+
+    ProtoBuf::ServerStatistics serverStats;
+    RpcLatency::collect(&serverStats);
+    ASSERT_EQ(2, serverStats.rpc_latency_size());
+    const ProtoBuf::ServerStatistics_RpcLatency& read =
+            serverStats.rpc_latency(0);
+    EXPECT_EQ(uint32_t(WireFormat::READ), read.opcode());
+    EXPECT_EQ(uint32_t(RpcLatency::TOTAL), read.stage());
+    EXPECT_EQ(format("3:2 4:1 %d:1", RpcLatency::getBucket(100)),
+            toString(read));
+    const ProtoBuf::ServerStatistics_RpcLatency& write =
+            serverStats.rpc_latency(1);
+    EXPECT_EQ(uint32_t(WireFormat::WRITE), write.opcode());
+    EXPECT_EQ(uint32_t(RpcLatency::LOG_SYNC), write.stage());
+    EXPECT_EQ("5:1", toString(write));
+}
+
+TEST_F(RpcLatencyTest, merge) {
+    ProtoBuf::ServerStatistics from, to;
+    ProtoBuf::ServerStatistics_RpcLatency* entry = from.add_rpc_latency();
+    entry->set_opcode(WireFormat::READ);
+    entry->set_stage(RpcLatency::TOTAL);
+    entry->add_bucket(3);
+    entry->add_count(2);
+    entry->add_bucket(9);
+    entry->add_count(1);
+    entry = from.add_rpc_latency();
+    entry->set_opcode(WireFormat::WRITE);
+    entry->set_stage(RpcLatency::TOTAL);
+    entry->add_bucket(4);
+    entry->add_count(1);
+
+    entry = to.add_rpc_latency();
+    entry->set_opcode(WireFormat::READ);
+    entry->set_stage(RpcLatency::TOTAL);
+    entry->add_bucket(5);
+    entry->add_count(7);
+    entry->add_bucket(9);
+    entry->add_count(1);
+
+    RpcLatency::merge(from, &to);
+    ASSERT_EQ(2, to.rpc_latency_size());
+    EXPECT_EQ("3:2 5:7 9:2", toString(to.rpc_latency(0)));
+    EXPECT_EQ(uint32_t(WireFormat::WRITE), to.rpc_latency(1).opcode());
+    EXPECT_EQ("4:1", toString(to.rpc_latency(1)));
+}
+
+TEST_F(RpcLatencyTest, getPercentile) {
+    ProtoBuf::ServerStatistics_RpcLatency latency;
+    EXPECT_EQ(0U, RpcLatency::getPercentile(latency, 0.5));
+
+    latency.add_bucket(2);
+    latency.add_count(98);
+    latency.add_bucket(RpcLatency::getBucket(1000));
+    latency.add_count(1);
+    latency.add_bucket(RpcLatency::getBucket(100000));
+    latency.add_count(1);
+    EXPECT_EQ(2U, RpcLatency::getPercentile(latency, 0.5));
+    EXPECT_EQ(2U, RpcLatency::getPercentile(latency, 0.98));
+    EXPECT_EQ(RpcLatency::getLowerBound(RpcLatency::getBucket(1000)),
+            RpcLatency::getPercentile(latency, 0.99));
+    EXPECT_EQ(RpcLatency::getLowerBound(RpcLatency::getBucket(100000)),
+            RpcLatency::getPercentile(latency, 0.999));
+}
+
+}  // namespace RAMCloud
@@ -105,6 +105,16 @@ class RpcLevel {
         currentOpcode = opcode;
     }
 
+    /**
+     * Return the RPC type currently being served by this thread, as last
+     * passed to setCurrentOpcode.
+     */
+    static inline WireFormat::Opcode
+    getCurrentOpcode()
+    {
+        return currentOpcode;
+    }
+
   PRIVATE:
     RpcLevel();
 
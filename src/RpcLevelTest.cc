@@ -33,7 +33,7 @@ TEST(RpcLevelTest, checkCall) {
 }
 
 TEST(RpcLevelTest, getLevel) {
-    EXPECT_EQ(2, RpcLevel::getLevel(WireFormat::Opcode::CREATE_TABLE));
+    EXPECT_EQ(3, RpcLevel::getLevel(WireFormat::Opcode::CREATE_TABLE));
 }
 
 TEST(RpcLevelTest, maxLevel) {
@@ -41,8 +41,8 @@ TEST(RpcLevelTest, maxLevel) {
     EXPECT_EQ(11, RpcLevel::maxLevel());
 
     RpcLevel::savedMaxLevel = -1;
-    EXPECT_EQ(3, RpcLevel::maxLevel());
-    EXPECT_EQ(3, RpcLevel::savedMaxLevel);
+    EXPECT_EQ(4, RpcLevel::maxLevel());
+    EXPECT_EQ(4, RpcLevel::savedMaxLevel);
 }
 
 }  // namespace RAMCloud
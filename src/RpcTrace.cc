@@ -0,0 +1,137 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "RpcTrace.h"
+#include "TimeTrace.h"
+
+namespace RAMCloud {
+
+__thread uint64_t RpcTrace::currentTraceId = 0;
+__thread uint32_t RpcTrace::requestCount = 0;
+uint32_t RpcTrace::sampleOneIn = 0;
+
+/**
+ * Select how many of the requests that clients in this process send are
+ * traced. Requests that servers send on behalf of traced requests are
+ * always traced.
+ *
+ * \param oneIn
+ *      One in this many requests is traced; 0 turns tracing off.
+ */
+void
+RpcTrace::setSampling(uint32_t oneIn)
+{
+    sampleOneIn = oneIn;
+}
+
+/**
+ * Record one step of a traced RPC in the time trace.
+ *
+ * \param traceId
+ *      The RPC's trace id.
+ * \param opcode
+ *      The RPC's opcode.
+ * \param format
+ *      Describes the step; contains "%08x%08x" for the trace id followed by
+ *      "%u" for the opcode.
+ */
+void
+RpcTrace::record(uint64_t traceId, WireFormat::Opcode opcode,
+        const char* format)
+{
+    TimeTrace* timeTrace = TimeTrace::globalTimeTrace;
+    if (timeTrace == NULL)
+        return;
+    timeTrace->record(format, downCast<uint32_t>(traceId >> 32),
+            downCast<uint32_t>(traceId & 0xffffffff), opcode);
+}
+
+/**
+ * Record one step of a traced RPC in the time trace, taking the opcode
+ * from the RPC's request.
+ *
+ * \param traceId
+ *      The RPC's trace id.
+ * \param request
+ *      The RPC's request.
+ * \param format
+ *      Describes the step; see the other form.
+ */
+void
+RpcTrace::record(uint64_t traceId, Buffer* request, const char* format)
+{
+    const WireFormat::RequestCommon* header =
+            request->getStart<WireFormat::RequestCommon>();
+    if (header != NULL) {
+        record(traceId, WireFormat::Opcode(header->opcode), format);
+    }
+}
+
+/**
+ * Does the work of receive for traced requests.
+ */
+uint64_t
+RpcTrace::receiveInternal(Buffer* request)
+{
+    WireFormat::RequestCommon* header =
+            request->getStart<WireFormat::RequestCommon>();
+    header->service = downCast<uint16_t>(
+            header->service & ~WireFormat::TRACED_REQUEST);
+    uint32_t length = request->size();
+    if (length < sizeof32(WireFormat::RequestCommon) +
+            sizeof32(WireFormat::RequestTrace))
+        return 0;
+    WireFormat::RequestTrace trailer;
+    request->copy(length - sizeof32(trailer), sizeof32(trailer), &trailer);
+    request->truncate(length - sizeof32(trailer));
+    return trailer.traceId;
+}
+
+/**
+ * Does the work of startClientRpc when the calling thread is working on a
+ * traced operation or sampling is on.
+ */
+uint64_t
+RpcTrace::startClientRpcInternal(Buffer* request)
+{
+    WireFormat::RequestCommon* header =
+            request->getStart<WireFormat::RequestCommon>();
+    if (header == NULL)
+        return 0;
+
+    // A request that is being resent already has its trailer.
+    if (header->service & WireFormat::TRACED_REQUEST) {
+        WireFormat::RequestTrace trailer;
+        request->copy(request->size() - sizeof32(trailer), sizeof32(trailer),
+                &trailer);
+        return trailer.traceId;
+    }
+
+    uint64_t traceId = currentTraceId;
+    if (traceId == 0) {
+        requestCount++;
+        if ((sampleOneIn == 0) || ((requestCount % sampleOneIn) != 0))
+            return 0;
+        while (traceId == 0)
+            traceId = generateRandom();
+    }
+    header->service = downCast<uint16_t>(
+            header->service | WireFormat::TRACED_REQUEST);
+    request->emplaceAppend<WireFormat::RequestTrace>()->traceId = traceId;
+    record(traceId, request, "rpctrace %08x%08x client send %u");
+    return traceId;
+}
+
+} // namespace RAMCloud
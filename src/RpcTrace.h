@@ -0,0 +1,159 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_RPCTRACE_H
+#define RAMCLOUD_RPCTRACE_H
+
+#include "Buffer.h"
+#include "WireFormat.h"
+
+namespace RAMCloud {
+
+/**
+ * This class follows individual operations across the cluster, so that the
+ * time of (say) a client's write can be broken down into the time spent on
+ * the client, in the master, and in each of the backup RPCs the master made
+ * for it. A sample of the RPCs that clients send are given trace ids, which
+ * travel with them in a trailer (see WireFormat::RequestTrace); a server
+ * executing a traced request passes its id on to any RPCs that it sends on
+ * the request's behalf from the same thread (backup writes during a log
+ * sync, index and transaction RPCs). Each hop records when its part began
+ * and ended in the time trace, and scripts/rpctrace.py gathers the traces
+ * of all of the servers and prints where the time went for each operation.
+ *
+ * Tracing is off unless setSampling has been called; untraced RPCs cost
+ * one test of a thread-local variable on each side.
+ *
+ * This class provides only static methods and variables: it isn't
+ * possible to construct an instance.
+ */
+class RpcTrace {
+  public:
+    /**
+     * Invoked by a client just before it sends (or resends) a request.
+     * Decides whether the request is traced and, if so, marks it as such.
+     *
+     * \param request
+     *      The complete request.
+     * \return
+     *      The request's trace id, or 0 if it isn't traced.
+     */
+    static inline uint64_t
+    startClientRpc(Buffer* request)
+    {
+        if ((currentTraceId == 0) && (sampleOneIn == 0))
+            return 0;
+        return startClientRpcInternal(request);
+    }
+
+    /**
+     * Invoked by a client when the response to a traced request arrives.
+     *
+     * \param traceId
+     *      Value returned by startClientRpc for the request.
+     * \param request
+     *      The request.
+     */
+    static inline void
+    finishClientRpc(uint64_t traceId, Buffer* request)
+    {
+        if (traceId != 0)
+            record(traceId, request, "rpctrace %08x%08x client done %u");
+    }
+
+    /**
+     * Invoked by a server when a request arrives, before anything else
+     * looks at it. If the request is traced, its trailer is removed and
+     * the TRACED_REQUEST bit cleared, so that services see the request as
+     * it was before startClientRpc.
+     *
+     * \param request
+     *      The request.
+     * \return
+     *      The request's trace id, or 0 if it isn't traced.
+     */
+    static inline uint64_t
+    receive(Buffer* request)
+    {
+        WireFormat::RequestCommon* header =
+                request->getStart<WireFormat::RequestCommon>();
+        if ((header == NULL) ||
+                !(header->service & WireFormat::TRACED_REQUEST))
+            return 0;
+        return receiveInternal(request);
+    }
+
+    /**
+     * Invoked by a server just before it executes a request; the calling
+     * thread is then working on behalf of the request's operation until
+     * finishServerRpc is called.
+     *
+     * \param traceId
+     *      Value returned by receive for the request.
+     * \param opcode
+     *      The request's opcode.
+     */
+    static inline void
+    startServerRpc(uint64_t traceId, WireFormat::Opcode opcode)
+    {
+        currentTraceId = traceId;
+        if (traceId != 0)
+            record(traceId, opcode, "rpctrace %08x%08x server start %u");
+    }
+
+    /**
+     * Invoked by a server when it has finished executing a request (the
+     * request itself may be gone by then, if the reply was sent early).
+     *
+     * \param opcode
+     *      The request's opcode.
+     */
+    static inline void
+    finishServerRpc(WireFormat::Opcode opcode)
+    {
+        if (currentTraceId != 0) {
+            record(currentTraceId, opcode,
+                    "rpctrace %08x%08x server done %u");
+            currentTraceId = 0;
+        }
+    }
+
+    static void setSampling(uint32_t oneIn);
+
+  PRIVATE:
+    RpcTrace();
+    static void record(uint64_t traceId, Buffer* request,
+            const char* format);
+    static void record(uint64_t traceId, WireFormat::Opcode opcode,
+            const char* format);
+    static uint64_t receiveInternal(Buffer* request);
+    static uint64_t startClientRpcInternal(Buffer* request);
+
+    /// Trace id of the operation on whose behalf the calling thread is
+    /// executing a request, or 0 if there is none.
+    static __thread uint64_t currentTraceId;
+
+    /// Number of requests started by the calling thread (other than on
+    /// behalf of a traced operation); used for sampling.
+    static __thread uint32_t requestCount;
+
+    /// One in this many requests started by clients is traced; 0 means
+    /// tracing is off.
+    static uint32_t sampleOneIn;
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_RPCTRACE_H
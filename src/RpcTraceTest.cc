@@ -0,0 +1,158 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "RpcTrace.h"
+#include "TimeTrace.h"
+
+namespace RAMCloud {
+
+class RpcTraceTest : public ::testing::Test {
+  public:
+    TimeTrace timeTrace;
+    Buffer request;
+
+    RpcTraceTest()
+        : timeTrace()
+        , request()
+    {
+        RpcTrace::sampleOneIn = 0;
+        RpcTrace::requestCount = 0;
+        RpcTrace::currentTraceId = 0;
+        WireFormat::RequestCommon* header =
+                request.emplaceAppend<WireFormat::RequestCommon>();
+        header->opcode = WireFormat::READ;
+        header->service = WireFormat::MASTER_SERVICE;
+        request.appendCopy("abcd", 4);
+    }
+
+    ~RpcTraceTest()
+    {
+        RpcTrace::sampleOneIn = 0;
+        RpcTrace::currentTraceId = 0;
+    }
+
+    /// Return the messages in the time trace, without their times,
+    /// separated by " | ".
+    string
+    getMessages()
+    {
+        string s;
+        std::istringstream trace(timeTrace.getTrace());
+        string line;
+        while (std::getline(trace, line)) {
+            size_t colon = line.find(": ");
+            if (colon == string::npos)
+                continue;
+            if (s.size() > 0)
+                s.append(" | ");
+            s.append(line.substr(colon + 2));
+        }
+        return s;
+    }
+
+    uint16_t
+    getService()
+    {
+        return request.getStart<WireFormat::RequestCommon>()->service;
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(RpcTraceTest);
+};
+
+TEST_F(RpcTraceTest, startClientRpc_tracingOff) {
+    EXPECT_EQ(0U, RpcTrace::startClientRpc(&request));
+    EXPECT_EQ(8U, request.size());
+    EXPECT_EQ(WireFormat::MASTER_SERVICE, getService());
+    EXPECT_EQ("", getMessages());
+}
+
+TEST_F(RpcTraceTest, startClientRpc_sampling) {
+    RpcTrace::setSampling(3);
+    int traced = 0;
+    for (int i = 0; i < 6; i++) {
+        Buffer buffer;
+        buffer.appendCopy(request.getRange(0, 8), 8);
+        if (RpcTrace::startClientRpc(&buffer) != 0)
+            traced++;
+    }
+    EXPECT_EQ(2, traced);
+}
+
+TEST_F(RpcTraceTest, startClientRpc_traced) {
+    RpcTrace::setSampling(1);
+    uint64_t traceId = RpcTrace::startClientRpc(&request);
+    EXPECT_NE(0U, traceId);
+    EXPECT_EQ(16U, request.size());
+    EXPECT_EQ(WireFormat::MASTER_SERVICE | WireFormat::TRACED_REQUEST,
+            getService());
+    EXPECT_EQ(traceId, request.getOffset<WireFormat::RequestTrace>(
+            8)->traceId);
+    EXPECT_EQ(format("rpctrace %016lx client send %d", traceId,
+            WireFormat::READ), getMessages());
+
+    // Resending the request doesn't add another trailer.
+    EXPECT_EQ(traceId, RpcTrace::startClientRpc(&request));
+    EXPECT_EQ(16U, request.size());
+    EXPECT_EQ(format("rpctrace %016lx client send %d", traceId,
+            WireFormat::READ), getMessages());
+}
+
+TEST_F(RpcTraceTest, startClientRpc_inheritFromServer) {
+    RpcTrace::startServerRpc(0x123456789aUL, WireFormat::WRITE);
+    EXPECT_EQ(0x123456789aUL, RpcTrace::startClientRpc(&request));
+    RpcTrace::finishServerRpc(WireFormat::WRITE);
+    EXPECT_EQ(format("rpctrace 000000123456789a server start %d | "
+            "rpctrace 000000123456789a client send %d | "
+            "rpctrace 000000123456789a server done %d",
+            WireFormat::WRITE, WireFormat::READ, WireFormat::WRITE),
+            getMessages());
+    EXPECT_EQ(0U, RpcTrace::currentTraceId);
+}
+
+TEST_F(RpcTraceTest, finishClientRpc) {
+    RpcTrace::finishClientRpc(0, &request);
+    RpcTrace::finishClientRpc(5, &request);
+    EXPECT_EQ(format("rpctrace 0000000000000005 client done %d",
+            WireFormat::READ), getMessages());
+}
+
+TEST_F(RpcTraceTest, receive_notTraced) {
+    EXPECT_EQ(0U, RpcTrace::receive(&request));
+    EXPECT_EQ(8U, request.size());
+    Buffer empty;
+    EXPECT_EQ(0U, RpcTrace::receive(&empty));
+}
+
+TEST_F(RpcTraceTest, receive_traced) {
+    RpcTrace::setSampling(1);
+    uint64_t traceId = RpcTrace::startClientRpc(&request);
+    EXPECT_EQ(traceId, RpcTrace::receive(&request));
+    EXPECT_EQ(8U, request.size());
+    EXPECT_EQ(WireFormat::MASTER_SERVICE, getService());
+    EXPECT_EQ("abcd", TestUtil::toString(&request, 4, 4));
+}
+
+TEST_F(RpcTraceTest, receive_trailerMissing) {
+    WireFormat::RequestCommon* header =
+            request.getStart<WireFormat::RequestCommon>();
+    header->service = downCast<uint16_t>(
+            header->service | WireFormat::TRACED_REQUEST);
+    request.truncate(sizeof32(WireFormat::RequestCommon));
+    EXPECT_EQ(0U, RpcTrace::receive(&request));
+    EXPECT_EQ(WireFormat::MASTER_SERVICE, getService());
+}
+
+}  // namespace RAMCloud
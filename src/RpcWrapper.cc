@@ -13,14 +13,20 @@
  * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <algorithm>
+
 #include "ClientException.h"
 #include "Cycles.h"
 #include "Dispatch.h"
 #include "Exception.h"
 #include "Logger.h"
+#include "RawMetrics.h"
+#include "RpcCompletionQueue.h"
+#include "RpcTrace.h"
 #include "RpcWrapper.h"
 #include "ShortMacros.h"
 #include "WireFormat.h"
+#include "WorkerManager.h"
 
 namespace RAMCloud {
 
@@ -46,6 +52,10 @@ RpcWrapper::RpcWrapper(uint32_t responseHeaderLength, Buffer* response)
     , retryTime(0)
     , responseHeaderLength(responseHeaderLength)
     , responseHeader(NULL)
+    , completionQueue(NULL)
+    , traceId(0)
+    , hedgeRpc()
+    , hedgeWon(false)
 {
     if (response == NULL) {
         defaultResponse.construct();
@@ -73,11 +83,73 @@ RpcWrapper::cancel()
     // This code is potentially tricky, because complete or failed
     // could get invoked concurrently. Fortunately, we know that
     // this can only happen before cancelRequest returns, and
-    // neither of these methods does anything besides setting state.
+    // neither of these methods does anything besides setting state
+    // (and notifying the completion queue, which locks itself).
     if ((getState() == IN_PROGRESS) && session) {
         session->cancelRequest(this);
     }
+    if (hedgeRpc)
+        cancelHedge();
     state = CANCELED;
+    if (completionQueue != NULL)
+        completionQueue->remove(this);
+}
+
+/**
+ * If a duplicate of this RPC is still outstanding, cancel it; its response
+ * is no longer needed.
+ */
+void
+RpcWrapper::cancelHedge()
+{
+    if (hedgeRpc->getState() == IN_PROGRESS) {
+        hedgeRpc->session->cancelRequest(hedgeRpc.get());
+        metrics->hedge.canceledCount++;
+    }
+    hedgeRpc->state = CANCELED;
+}
+
+/**
+ * This method is invoked by isReady, while the RPC is waiting for its
+ * server, if a duplicate of it has been sent to another server (see
+ * #hedge). If the duplicate has been answered successfully, the RPC is
+ * canceled at its own server and the duplicate's response becomes the
+ * RPC's.
+ *
+ * \return
+ *      True means the RPC is now FINISHED with the duplicate's response;
+ *      false means it must keep waiting for its own server.
+ */
+bool
+RpcWrapper::checkHedge()
+{
+    RpcState hedgeState = hedgeRpc->getState();
+    if ((hedgeState == IN_PROGRESS) || (hedgeState == CANCELED))
+        return false;
+    const WireFormat::ResponseCommon* hedgeHeader =
+            static_cast<const WireFormat::ResponseCommon*>(
+            hedgeRpc->response.getRange(0, responseHeaderLength));
+    if ((hedgeState == FAILED) || (hedgeHeader == NULL) ||
+            (hedgeHeader->status != STATUS_OK)) {
+        // The other server couldn't serve the request (for example, its
+        // copy of the data is too stale); this RPC's own server will.
+        metrics->hedge.failedCount++;
+        hedgeRpc->state = CANCELED;
+        return false;
+    }
+
+    // The RPC must be canceled before its response buffer is touched:
+    // until then the transport may still be filling it in.
+    if ((getState() == IN_PROGRESS) && session)
+        session->cancelRequest(this);
+    response->reset();
+    uint32_t length = hedgeRpc->response.size();
+    response->appendCopy(hedgeRpc->response.getRange(0, length), length);
+    hedgeRpc->state = CANCELED;
+    hedgeWon = true;
+    metrics->hedge.wonCount++;
+    state = FINISHED;
+    return true;
 }
 
 /**
@@ -104,11 +176,14 @@ void
 RpcWrapper::completed() {
     // Since this method can be invoked concurrently with other
     // methods, it's important that it does nothing except modify
-    // state. Don't add any more functionality to this method
+    // state (and tell the completion queue, which synchronizes
+    // internally). Don't add any more functionality to this method
     // unless you carefully review all of the synchronization
     // properties of RpcWrappers!
     Fence::sfence();
     state = FINISHED;
+    if (completionQueue != NULL)
+        completionQueue->notify(this);
 }
 
 
@@ -118,9 +193,47 @@ RpcWrapper::failed() {
     // See comment in completed: the same warning applies here.
     Fence::sfence();
     state = FAILED;
+    if (completionQueue != NULL)
+        completionQueue->notify(this);
 }
 
 
+/**
+ * Send a duplicate of this RPC's request to another server, in case that
+ * server answers sooner than this RPC's own (for example, because the
+ * RPC's server is overloaded). Whichever server answers first with
+ * STATUS_OK wins and the other request is canceled; if the other server
+ * fails or returns an error, the RPC simply keeps waiting for its own
+ * server. Only idempotent requests, such as reads, should be hedged.
+ * Most callers use #waitHedged, which decides when to call this method.
+ *
+ * Hedging requires the RPC to be polled with isReady (as all wait methods
+ * do); it is not meant for RPCs in an RpcCompletionQueue.
+ *
+ * \param alternate
+ *      Session to the other server.
+ * \param alternateRequest
+ *      If non-NULL, the request to send to the other server, in case it
+ *      must differ from this RPC's (for example, to allow a read replica
+ *      to answer); it must outlive the RPC and its response must have the
+ *      same form as the RPC's. NULL means send this RPC's own request.
+ */
+void
+RpcWrapper::hedge(Transport::SessionRef alternate, Buffer* alternateRequest)
+{
+    RpcState copyOfState = getState();
+    if (hedgeRpc || !alternate || (copyOfState == NOT_STARTED) ||
+            (copyOfState == FINISHED) || (copyOfState == CANCELED)) {
+        return;
+    }
+    hedgeRpc.construct(alternate);
+    hedgeRpc->request.appendExternal((alternateRequest != NULL)
+            ? alternateRequest : &request);
+    metrics->hedge.sentCount++;
+    alternate->sendRequest(&hedgeRpc->request, &hedgeRpc->response,
+            hedgeRpc.get());
+}
+
 /**
  * This method is implemented in RpcWrapper subclasses; it is invoked
  * by isReady to handle RPC failures that occur because of transport
@@ -154,8 +267,19 @@ RpcWrapper::isReady() {
     // Note: in addition to indicating whether the RPC is complete,
     // this method is where all the work of retrying is implemented.
     RpcState copyOfState = getState();
+    if (hedgeRpc && (copyOfState != FINISHED) && (copyOfState != CANCELED)
+            && checkHedge()) {
+        copyOfState = FINISHED;
+    }
 
     if (copyOfState == FINISHED) {
+        if (hedgeRpc)
+            cancelHedge();
+        if (traceId != 0) {
+            RpcTrace::finishClientRpc(traceId, &request);
+            traceId = 0;
+        }
+
         // Retrieve the status value from the response and handle the
         // normal case of success as quickly as possible.  Note: check to
         // make sure the server has returned enough bytes for the header length
@@ -299,7 +423,18 @@ RpcWrapper::send()
 
     state = IN_PROGRESS;
     if (session)
-        session->sendRequest(&request, response, this);
+        sendRequest();
+}
+
+/**
+ * Transmit the request message on #session; subclasses' send methods
+ * invoke this once they have chosen a session and set #state.
+ */
+void
+RpcWrapper::sendRequest()
+{
+    traceId = RpcTrace::startClientRpc(&request);
+    session->sendRequest(&request, response, this);
 }
 
 /**
@@ -369,7 +504,11 @@ RpcWrapper::waitInternal(Dispatch* dispatch, uint64_t abortTime)
     // When invoked in RAMCloud servers there is a separate dispatch thread,
     // so we just busy-wait here. When invoked on RAMCloud clients we're in
     // the dispatch thread so we have to invoke the dispatcher while waiting.
+    // In a worker thread, another RPC may use this core while we wait.
     bool isDispatchThread = dispatch->isDispatchThread();
+    Tub<WorkerManager::BlockingWait> blocking;
+    if (!isDispatchThread && !isReady())
+        blocking.construct();
 
     while (!isReady()) {
         if (isDispatchThread)
@@ -382,4 +521,91 @@ RpcWrapper::waitInternal(Dispatch* dispatch, uint64_t abortTime)
     return true;
 }
 
+/**
+ * Wait for the RPC to become ready (see isReady), sending a duplicate of
+ * it to another server (see #hedge) if its own server hasn't answered by
+ * a deadline. Typically the caller then invokes the RPC's own wait method,
+ * which returns immediately, to check and unpack the response.
+ *
+ * \param dispatch
+ *      Dispatch to use for polling while waiting.
+ * \param deadline
+ *      Decides how long to wait before hedging; the RPC's latency is
+ *      recorded in it, measured from when this method is invoked.
+ * \param alternate
+ *      Session to the server the duplicate is sent to; NULL means the
+ *      RPC isn't hedged, though its latency is still recorded.
+ * \param alternateRequest
+ *      See #hedge.
+ */
+void
+RpcWrapper::waitHedged(Dispatch* dispatch, HedgeDeadline* deadline,
+        Transport::SessionRef alternate, Buffer* alternateRequest)
+{
+    uint64_t start = Cycles::rdtsc();
+    uint64_t hedgeCycles = deadline->getCycles();
+    bool isDispatchThread = dispatch->isDispatchThread();
+    Tub<WorkerManager::BlockingWait> blocking;
+    if (!isDispatchThread && !isReady())
+        blocking.construct();
+
+    while (!isReady()) {
+        if (alternate && !hedgeRpc && (hedgeCycles != 0) &&
+                (Cycles::rdtsc() - start >= hedgeCycles)) {
+            hedge(alternate, alternateRequest);
+        }
+        if (isDispatchThread)
+            dispatch->poll();
+    }
+
+    // A hedged RPC's own server took at least this long.
+    if (getState() == FINISHED)
+        deadline->record(Cycles::rdtsc() - start);
+}
+
+/**
+ * Construct a HedgeDeadline; RPCs aren't hedged until SAMPLES latencies
+ * have been recorded.
+ *
+ * \param percentile
+ *      Fraction of RPCs that should finish without being hedged; 0.95
+ *      hedges the slowest 5%.
+ */
+RpcWrapper::HedgeDeadline::HedgeDeadline(double percentile)
+    : percentile(percentile)
+    , samples()
+    , nextSample(0)
+    , cycles(0)
+{
+}
+
+/**
+ * Record the latency of an RPC, and update the deadline.
+ *
+ * \param latency
+ *      How long the RPC took, in cycles.
+ */
+void
+RpcWrapper::HedgeDeadline::record(uint64_t latency)
+{
+    if (samples.size() < SAMPLES) {
+        samples.push_back(latency);
+        if (samples.size() < SAMPLES)
+            return;
+    } else {
+        samples[nextSample] = latency;
+        nextSample = (nextSample + 1) % SAMPLES;
+
+        // Recomputing the percentile every tenth of the window is often
+        // enough to follow changes in load.
+        if (nextSample % (SAMPLES / 10) != 0)
+            return;
+    }
+    vector<uint64_t> sorted(samples);
+    uint32_t rank = std::min(SAMPLES - 1,
+            static_cast<uint32_t>(SAMPLES * percentile));
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    cycles = std::max(sorted[rank], 1UL);
+}
+
 } // namespace RAMCloud
@@ -26,6 +26,7 @@ namespace RAMCloud {
 class Context;
 class Dispatch;
 class RamCloud;
+class RpcCompletionQueue;
 
 /**
  * RpcWrapper is the base class for a collection of classes that provide
@@ -60,10 +61,76 @@ class RpcWrapper : public Transport::RpcNotifier {
             Buffer* response = NULL);
     virtual ~RpcWrapper();
 
+    /**
+     * Decides when an RPC has waited long enough for its server that a
+     * duplicate should be sent to another server (see #waitHedged). One
+     * HedgeDeadline follows the latencies of a stream of similar RPCs,
+     * such as the reads of one table, and an RPC is hedged once it has
+     * taken longer than a given percentile of the stream's recent RPCs.
+     */
+    class HedgeDeadline {
+      public:
+        explicit HedgeDeadline(double percentile = 0.95);
+        void record(uint64_t latency);
+
+        /**
+         * Return how long an RPC may wait for its server before it is
+         * hedged, in cycles; 0 means not enough RPCs have been seen yet
+         * to tell, so RPCs shouldn't be hedged.
+         */
+        uint64_t
+        getCycles()
+        {
+            return cycles;
+        }
+
+      PRIVATE:
+        /// Number of recent latencies from which the deadline is computed.
+        static const uint32_t SAMPLES = 100;
+
+        /// Fraction of RPCs that should finish before the deadline.
+        double percentile;
+
+        /// Latencies of the last SAMPLES RPCs, in cycles; a ring once full.
+        vector<uint64_t> samples;
+
+        /// Index in #samples of the next sample to replace.
+        uint32_t nextSample;
+
+        /// Current deadline, in cycles (see getCycles).
+        uint64_t cycles;
+
+        DISALLOW_COPY_AND_ASSIGN(HedgeDeadline);
+    };
+
+    /**
+     * Return true if the RPC's response came from the server a duplicate
+     * was sent to (see #hedge) rather than its own server.
+     */
+    bool
+    answeredByHedge()
+    {
+        return hedgeWon;
+    }
+
+    /**
+     * Return true if a duplicate of the RPC has been sent to another
+     * server (see #hedge).
+     */
+    bool
+    wasHedged()
+    {
+        return hedgeRpc;
+    }
+
     void cancel();
     virtual void completed();
     virtual void failed();
+    void hedge(Transport::SessionRef alternate,
+            Buffer* alternateRequest = NULL);
     virtual bool isReady();
+    void waitHedged(Dispatch* dispatch, HedgeDeadline* deadline,
+            Transport::SessionRef alternate, Buffer* alternateRequest = NULL);
 
   PROTECTED:
     /// Possible states for an RPC.
@@ -82,6 +149,58 @@ class RpcWrapper : public Transport::RpcNotifier {
                                     // time given by retryTime.
     };
 
+    /**
+     * A duplicate of the RPC's request, sent to another server (see
+     * #hedge). Not an RpcWrapper: the duplicate is never retried, and
+     * its response is only of use if it arrives first and says STATUS_OK.
+     */
+    class Hedge : public Transport::RpcNotifier {
+      public:
+        explicit Hedge(Transport::SessionRef session)
+            : request()
+            , response()
+            , session(session)
+            , state(IN_PROGRESS)
+        {}
+
+        // See Transport::Notifier for documentation. As with RpcWrapper,
+        // these may run in the dispatch thread and must only set state.
+        virtual void
+        completed()
+        {
+            Fence::sfence();
+            state = FINISHED;
+        }
+        virtual void
+        failed()
+        {
+            Fence::sfence();
+            state = FAILED;
+        }
+
+        /// See RpcWrapper::getState.
+        RpcState
+        getState()
+        {
+            RpcState result = state;
+            Fence::lfence();
+            return result;
+        }
+
+        /// The duplicate request and its response.
+        Buffer request;
+        Buffer response;
+
+        /// Session on which the duplicate was sent.
+        Transport::SessionRef session;
+
+        /// IN_PROGRESS, FINISHED or FAILED, as set by the transport;
+        /// CANCELED once the duplicate no longer matters.
+        Atomic<RpcState> state;
+
+        DISALLOW_COPY_AND_ASSIGN(Hedge);
+    };
+
     /**
      * Given an RPC type (from WireFormat), allocates a request header
      * in the request buffer, initializes its opcode and service fields,
@@ -205,9 +324,12 @@ class RpcWrapper : public Transport::RpcNotifier {
         return result;
     }
 
+    void cancelHedge();
+    bool checkHedge();
     virtual bool handleTransportError();
     void retry(uint32_t minDelayMicros, uint32_t maxDelayMicros);
     virtual void send();
+    void sendRequest();
     void simpleWait(Context* context);
     const char* stateString();
     bool waitInternal(Dispatch* dispatch, uint64_t abortTime = ~0UL);
@@ -242,6 +364,23 @@ class RpcWrapper : public Transport::RpcNotifier {
     /// least responseHeaderLength bytes.
     const WireFormat::ResponseCommon* responseHeader;
 
+    /// If non-NULL, the queue that invokes a callback once this RPC is
+    /// ready (see RpcCompletionQueue::add); it is told whenever the
+    /// transport finishes with the RPC.
+    RpcCompletionQueue* completionQueue;
+
+    /// Trace id of the request (see RpcTrace), or 0 if it isn't traced.
+    uint64_t traceId;
+
+    /// The duplicate of this RPC sent to another server, if any (see
+    /// #hedge); at most one duplicate is sent.
+    Tub<Hedge> hedgeRpc;
+
+    /// True means the duplicate's response became this RPC's response.
+    bool hedgeWon;
+
+    friend class RpcCompletionQueue;
+
     DISALLOW_COPY_AND_ASSIGN(RpcWrapper);
 };
 
@@ -15,6 +15,7 @@
 
 #include "TestUtil.h"
 #include "MockTransport.h"
+#include "RawMetrics.h"
 #include "RpcWrapper.h"
 #include "Service.h"
 #include "ShortMacros.h"
@@ -91,6 +92,19 @@ TEST_F(RpcWrapperTest, cancel) {
     EXPECT_EQ("cancel: ", transport.outputLog);
 }
 
+TEST_F(RpcWrapperTest, cancel_hedge) {
+    Transport::SessionRef alternate = transport.getSession(&locator);
+    RpcWrapper wrapper(4);
+    wrapper.session = session;
+    wrapper.send();
+    wrapper.hedge(alternate);
+    transport.outputLog.clear();
+    uint64_t canceled = metrics->hedge.canceledCount;
+    wrapper.cancel();
+    EXPECT_EQ("cancel:  | cancel: ", transport.outputLog);
+    EXPECT_EQ(1U, metrics->hedge.canceledCount - canceled);
+}
+
 TEST_F(RpcWrapperTest, completed) {
     RpcWrapper wrapper(100);
     wrapper.completed();
@@ -103,6 +117,38 @@ TEST_F(RpcWrapperTest, failed) {
     EXPECT_STREQ("FAILED", wrapper.stateString());
 }
 
+TEST_F(RpcWrapperTest, hedge) {
+    Transport::SessionRef alternate = transport.getSession(&locator);
+    RpcWrapper wrapper(4);
+    wrapper.request.fillFromString("abc");
+
+    // An RPC that hasn't been sent isn't hedged.
+    wrapper.hedge(alternate);
+    EXPECT_FALSE(wrapper.wasHedged());
+
+    wrapper.session = session;
+    wrapper.send();
+    uint64_t sent = metrics->hedge.sentCount;
+    wrapper.hedge(alternate);
+    EXPECT_TRUE(wrapper.wasHedged());
+    EXPECT_EQ("sendRequest: abc/0 | sendRequest: abc/0", transport.outputLog);
+    EXPECT_EQ(1U, metrics->hedge.sentCount - sent);
+
+    // At most one duplicate is sent.
+    wrapper.hedge(alternate);
+    EXPECT_EQ(1U, metrics->hedge.sentCount - sent);
+
+    // The duplicate may have its own request.
+    Buffer other;
+    other.fillFromString("xyz");
+    RpcWrapper wrapper2(4);
+    wrapper2.session = session;
+    wrapper2.send();
+    transport.outputLog.clear();
+    wrapper2.hedge(alternate, &other);
+    EXPECT_EQ("sendRequest: xyz/0", transport.outputLog);
+}
+
 TEST_F(RpcWrapperTest, isReady_finished) {
     RpcWrapper wrapper(4);
     wrapper.state = RpcWrapper::RpcState::FINISHED;
@@ -245,6 +291,77 @@ TEST_F(RpcWrapperTest, isReady_unknownState) {
             "for null request", TestLog::get());
 }
 
+TEST_F(RpcWrapperTest, isReady_hedgeWins) {
+    Transport::SessionRef alternate = transport.getSession(&locator);
+    RpcWrapper wrapper(4);
+    wrapper.session = session;
+    wrapper.send();
+    wrapper.hedge(alternate);
+    transport.outputLog.clear();
+    EXPECT_FALSE(wrapper.isReady());
+
+    wrapper.hedgeRpc->response.fillFromString("0 abc");
+    wrapper.hedgeRpc->completed();
+    uint64_t won = metrics->hedge.wonCount;
+    EXPECT_TRUE(wrapper.isReady());
+    EXPECT_TRUE(wrapper.answeredByHedge());
+    EXPECT_STREQ("FINISHED", wrapper.stateString());
+    EXPECT_EQ("cancel: ", transport.outputLog);
+    EXPECT_EQ(8U, wrapper.response->size());
+    EXPECT_STREQ("abc", wrapper.response->getOffset<char>(4));
+    EXPECT_EQ(1U, metrics->hedge.wonCount - won);
+}
+
+TEST_F(RpcWrapperTest, isReady_hedgeLoses) {
+    Transport::SessionRef alternate = transport.getSession(&locator);
+    RpcWrapper wrapper(4);
+    wrapper.session = session;
+    wrapper.send();
+    wrapper.hedge(alternate);
+    transport.outputLog.clear();
+    setStatus(wrapper.response, Status::STATUS_OK);
+    wrapper.completed();
+    uint64_t canceled = metrics->hedge.canceledCount;
+    EXPECT_TRUE(wrapper.isReady());
+    EXPECT_FALSE(wrapper.answeredByHedge());
+    EXPECT_EQ("cancel: ", transport.outputLog);
+    EXPECT_EQ(1U, metrics->hedge.canceledCount - canceled);
+
+    // The duplicate is only canceled once.
+    EXPECT_TRUE(wrapper.isReady());
+    EXPECT_EQ(1U, metrics->hedge.canceledCount - canceled);
+}
+
+TEST_F(RpcWrapperTest, isReady_hedgeFails) {
+    Transport::SessionRef alternate = transport.getSession(&locator);
+    RpcWrapper wrapper(4);
+    wrapper.session = session;
+    wrapper.send();
+    wrapper.hedge(alternate);
+    transport.outputLog.clear();
+    setStatus(&wrapper.hedgeRpc->response, Status::STATUS_UNKNOWN_TABLET);
+    wrapper.hedgeRpc->completed();
+    uint64_t failed = metrics->hedge.failedCount;
+    EXPECT_FALSE(wrapper.isReady());
+    EXPECT_EQ(1U, metrics->hedge.failedCount - failed);
+
+    // The RPC's own server still answers; nothing is canceled.
+    setStatus(wrapper.response, Status::STATUS_OK);
+    wrapper.completed();
+    EXPECT_TRUE(wrapper.isReady());
+    EXPECT_FALSE(wrapper.answeredByHedge());
+    EXPECT_EQ("", transport.outputLog);
+
+    // A duplicate that fails in the transport is ignored too.
+    RpcWrapper wrapper2(4);
+    wrapper2.session = session;
+    wrapper2.send();
+    wrapper2.hedge(alternate);
+    wrapper2.hedgeRpc->failed();
+    EXPECT_FALSE(wrapper2.isReady());
+    EXPECT_EQ(2U, metrics->hedge.failedCount - failed);
+}
+
 TEST_F(RpcWrapperTest, retry) {
     TestLog::Enable _;
     Cycles::mockTscValue = 1000;
@@ -384,4 +501,49 @@ TEST_F(RpcWrapperTest, waitInternal_simpleSuccess) {
     EXPECT_TRUE(wrapper.waitInternal(context.dispatch));
 }
 
+TEST_F(RpcWrapperTest, waitHedged) {
+    Transport::SessionRef alternate = transport.getSession(&locator);
+    RpcWrapper::HedgeDeadline deadline;
+
+    // Until the deadline is known, RPCs aren't hedged.
+    RpcWrapper wrapper(4);
+    wrapper.session = session;
+    wrapper.send();
+    setStatus(wrapper.response, Status::STATUS_OK);
+    wrapper.completed();
+    wrapper.waitHedged(context.dispatch, &deadline, alternate);
+    EXPECT_FALSE(wrapper.wasHedged());
+    EXPECT_EQ(1U, deadline.samples.size());
+
+    // The alternate answers at once.
+    deadline.cycles = 1;
+    RpcWrapper wrapper2(4);
+    wrapper2.session = session;
+    wrapper2.send();
+    transport.outputLog.clear();
+    transport.setInput("0");
+    wrapper2.waitHedged(context.dispatch, &deadline, alternate);
+    EXPECT_TRUE(wrapper2.answeredByHedge());
+    EXPECT_EQ("sendRequest:  | cancel: ", transport.outputLog);
+    EXPECT_EQ(2U, deadline.samples.size());
+}
+
+TEST_F(RpcWrapperTest, HedgeDeadline_record) {
+    RpcWrapper::HedgeDeadline deadline(0.95);
+    for (uint64_t i = 100; i >= 2; i--)
+        deadline.record(i);
+    EXPECT_EQ(0U, deadline.getCycles());
+    deadline.record(1);
+    EXPECT_EQ(96U, deadline.getCycles());
+
+    // The oldest samples are replaced, and the percentile is recomputed
+    // every tenth of the window.
+    for (uint32_t i = 0; i < 9; i++)
+        deadline.record(1000);
+    EXPECT_EQ(96U, deadline.getCycles());
+    deadline.record(1000);
+    EXPECT_EQ(1000U, deadline.getCycles());
+    EXPECT_EQ(10U, deadline.nextSample);
+}
+
 }  // namespace RAMCloud
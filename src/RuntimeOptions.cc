@@ -69,6 +69,35 @@ struct Parser<std::queue<T>> : public RuntimeOptions::Parseable {
 
 };
 
+/**
+ * Specialization which parses a single integer, such as "4". If the string
+ * doesn't start with an integer then the field keeps its old value.
+ */
+template <>
+struct Parser<uint32_t> : public RuntimeOptions::Parseable {
+    explicit Parser(uint32_t& target)
+        : target(target), optionValue("")
+    {}
+
+    void
+    parse(const char* value)
+    {
+        std::istringstream iss(value);
+        uint32_t parsed;
+        if (iss >> parsed)
+            target = parsed;
+        optionValue = value;
+    }
+    std::string
+    getValue() {
+        return optionValue;
+    }
+    // target holds a parsed copy of value for the option.
+    uint32_t& target;
+    // A copy of the value string is saved in optionValue.
+    std::string optionValue;
+};
+
 /**
  * Parser for coordinator crash point run time options.
  * An option is just a string in this case and currently,
@@ -129,10 +158,22 @@ RuntimeOptions::RuntimeOptions()
     : parsers()
     , mutex()
     , failRecoveryMasters()
+    , recoveryStreamingRanges(1)
+    , tabletBalancerIntervalMs(0)
+    , tabletBalancerImbalancePercent(25)
+    , tabletBalancerMaxMigrations(1)
+    , indexletSplitOps(0)
+    , indexletSplitMB(0)
     , crashCoordinator()
 {
 #define REGISTER(field) registerOption(#field, newParser(field))
     REGISTER(failRecoveryMasters);
+    REGISTER(recoveryStreamingRanges);
+    REGISTER(tabletBalancerIntervalMs);
+    REGISTER(tabletBalancerImbalancePercent);
+    REGISTER(tabletBalancerMaxMigrations);
+    REGISTER(indexletSplitOps);
+    REGISTER(indexletSplitMB);
 #undef REGISTER
     registerOption("crashCoordinator",
             newcrashCoordParser(crashCoordinator));
@@ -199,6 +240,66 @@ RuntimeOptions::popFailRecoveryMasters()
     return result;
 }
 
+/**
+ * Return #recoveryStreamingRanges; never less than 1.
+ */
+uint32_t
+RuntimeOptions::getRecoveryStreamingRanges()
+{
+    Lock _(mutex);
+    return std::max(1u, recoveryStreamingRanges);
+}
+
+/**
+ * Return #tabletBalancerIntervalMs; 0 means balancing is disabled.
+ */
+uint32_t
+RuntimeOptions::getTabletBalancerIntervalMs()
+{
+    Lock _(mutex);
+    return tabletBalancerIntervalMs;
+}
+
+/**
+ * Return #tabletBalancerImbalancePercent.
+ */
+uint32_t
+RuntimeOptions::getTabletBalancerImbalancePercent()
+{
+    Lock _(mutex);
+    return tabletBalancerImbalancePercent;
+}
+
+/**
+ * Return #tabletBalancerMaxMigrations; never less than 1.
+ */
+uint32_t
+RuntimeOptions::getTabletBalancerMaxMigrations()
+{
+    Lock _(mutex);
+    return std::max(1u, tabletBalancerMaxMigrations);
+}
+
+/**
+ * Return #indexletSplitOps; 0 means indexlets aren't split on load.
+ */
+uint32_t
+RuntimeOptions::getIndexletSplitOps()
+{
+    Lock _(mutex);
+    return indexletSplitOps;
+}
+
+/**
+ * Return #indexletSplitMB; 0 means indexlets aren't split on size.
+ */
+uint32_t
+RuntimeOptions::getIndexletSplitMB()
+{
+    Lock _(mutex);
+    return indexletSplitMB;
+}
+
 /**
  * Check if the argument matches the currently active crash point
  * and kills the coordinator if necessary
@@ -44,6 +44,12 @@ class RuntimeOptions {
         void set(const char* option, const char* value);
         std::string get(const char* option);
         uint32_t popFailRecoveryMasters();
+        uint32_t getRecoveryStreamingRanges();
+        uint32_t getTabletBalancerIntervalMs();
+        uint32_t getTabletBalancerImbalancePercent();
+        uint32_t getTabletBalancerMaxMigrations();
+        uint32_t getIndexletSplitOps();
+        uint32_t getIndexletSplitMB();
         void checkAndCrashCoordinator(const char *crashPoint);
 
     PRIVATE:
@@ -88,6 +94,52 @@ class RuntimeOptions {
          */
         std::queue<uint32_t> failRecoveryMasters;
 
+        /**
+         * How many ranges each recovery master should divide its partition
+         * into during upcoming recoveries, so that it can hand over the
+         * first ranges to clients while it is still recovering the rest
+         * (see Recovery::divideIntoRanges()). 1 (the default) recovers each
+         * partition all at once.
+         */
+        uint32_t recoveryStreamingRanges;
+
+        /**
+         * How often (in milliseconds) the TabletBalancer looks for
+         * overloaded masters and moves load off of them. 0 (the default)
+         * disables automatic balancing.
+         */
+        uint32_t tabletBalancerIntervalMs;
+
+        /**
+         * The TabletBalancer only moves load off of a master whose recent
+         * load exceeds the average across all masters by more than this
+         * percentage.
+         */
+        uint32_t tabletBalancerImbalancePercent;
+
+        /**
+         * Upper limit on the number of tablet migrations the TabletBalancer
+         * will have in progress at once; limits how much of the cluster's
+         * bandwidth goes to rebalancing. Never less than 1.
+         */
+        uint32_t tabletBalancerMaxMigrations;
+
+        /**
+         * The TabletBalancer splits a B+ tree indexlet in two (and moves
+         * the upper half to another master) once the lookups and writes on
+         * it during one of its master's load report intervals exceed this
+         * number. 0 (the default) disables splitting on load.
+         */
+        uint32_t indexletSplitOps;
+
+        /**
+         * The TabletBalancer splits a B+ tree indexlet in two (and moves
+         * the upper half to another master) once its backing table holds
+         * more than this many megabytes. 0 (the default) disables
+         * splitting on size.
+         */
+        uint32_t indexletSplitMB;
+
         /**
          * Keeps track of the currently active crash point. Crashes the
          * coordinator the next time this crash point is reached.
@@ -70,5 +70,39 @@ TEST_F(RuntimeOptionsTest, popFailRecoveryMasters) {
     EXPECT_EQ(0u, options.popFailRecoveryMasters());
 }
 
+TEST_F(RuntimeOptionsTest, getRecoveryStreamingRanges) {
+    EXPECT_EQ(1u, options.getRecoveryStreamingRanges());
+    options.set("recoveryStreamingRanges", "4");
+    EXPECT_EQ(4u, options.getRecoveryStreamingRanges());
+    EXPECT_STREQ("4", options.get("recoveryStreamingRanges").c_str());
+    options.set("recoveryStreamingRanges", "foo");
+    EXPECT_EQ(4u, options.getRecoveryStreamingRanges());
+    options.set("recoveryStreamingRanges", "0");
+    EXPECT_EQ(1u, options.getRecoveryStreamingRanges());
+}
+
+TEST_F(RuntimeOptionsTest, tabletBalancerOptions) {
+    EXPECT_EQ(0u, options.getTabletBalancerIntervalMs());
+    EXPECT_EQ(25u, options.getTabletBalancerImbalancePercent());
+    EXPECT_EQ(1u, options.getTabletBalancerMaxMigrations());
+    options.set("tabletBalancerIntervalMs", "5000");
+    options.set("tabletBalancerImbalancePercent", "10");
+    options.set("tabletBalancerMaxMigrations", "3");
+    EXPECT_EQ(5000u, options.getTabletBalancerIntervalMs());
+    EXPECT_EQ(10u, options.getTabletBalancerImbalancePercent());
+    EXPECT_EQ(3u, options.getTabletBalancerMaxMigrations());
+    options.set("tabletBalancerMaxMigrations", "0");
+    EXPECT_EQ(1u, options.getTabletBalancerMaxMigrations());
+}
+
+TEST_F(RuntimeOptionsTest, indexletSplitOptions) {
+    EXPECT_EQ(0u, options.getIndexletSplitOps());
+    EXPECT_EQ(0u, options.getIndexletSplitMB());
+    options.set("indexletSplitOps", "50000");
+    options.set("indexletSplitMB", "512");
+    EXPECT_EQ(50000u, options.getIndexletSplitOps());
+    EXPECT_EQ(512u, options.getIndexletSplitMB());
+}
+
 
 }  // namespace RAMCloud
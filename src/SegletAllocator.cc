@@ -13,9 +13,21 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <fcntl.h>
+#include <linux/falloc.h>
+#include <linux/magic.h>
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/statfs.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+
 #include "Common.h"
 #include "BitOps.h"
+#include "Cycles.h"
 #include "LogSegment.h"
+#include "PerfStats.h"
 #include "SegletAllocator.h"
 #include "Segment.h"
 #include "ServerConfig.h"
@@ -43,16 +55,175 @@ SegletAllocator::SegletAllocator(const ServerConfig* config)
       cleanerPoolReserve(0),
       defaultPool(),
       segletToSegmentTable(),
-      block(config->master.logBytes)
+      block(allocateBlock(config)),
+      flashPool(),
+      flashBase(0),
+      flashBytes(0),
+      flashFd(-1),
+      flashPunchHoles(true),
+      flashLock("SegletAllocator::flashLock"),
+      pendingFetches()
 {
     assert(BitOps::isPowerOfTwo(segletSize));
-    uint8_t* segletBlock = block.get();
-    for (size_t i = 0; i < (block.length / segletSize); i++) {
+    uint8_t* segletBlock = block->get();
+    for (size_t i = 0; i < (block->length / segletSize); i++) {
         Seglet* seglet = new Seglet(*this, segletBlock, segletSize);
         segletToSegmentTable.push_back(NULL);
         defaultPool.push_back(seglet);
         segletBlock += segletSize;
     }
+    mapFlash(config);
+}
+
+/**
+ * Allocate the memory that will back all seglets, as directed by the server's
+ * configuration:
+ *   - If config->master.hugePagePath is set, the memory comes from a file in
+ *     that directory, which must be a hugetlbfs mount with 1GB pages. Rather
+ *     than silently falling back on small pages, server startup fails if
+ *     that isn't possible.
+ *   - If config->master.logMemoryNode is not negative, the memory is
+ *     allocated from that NUMA node only. Running the master's threads on
+ *     the same node (e.g. with numactl or taskset) then keeps log appends
+ *     and reads on the local socket.
+ *
+ * \param config
+ *      Server runtime configuration.
+ * \return
+ *      The newly allocated block, which the caller owns.
+ * \throw FatalError
+ *      If the memory could not be allocated as requested.
+ */
+LargeBlockOfMemory<uint8_t>*
+SegletAllocator::allocateBlock(const ServerConfig* config)
+{
+    const string& hugePagePath = config->master.hugePagePath;
+    const uint64_t gigabyte = LargeBlockOfMemory<uint8_t>::GIGABYTE;
+    if (!hugePagePath.empty()) {
+        struct statfs fs;
+        if (statfs(hugePagePath.c_str(), &fs) != 0) {
+            throw FatalError(HERE, format("Could not stat huge page "
+                    "directory [%s]", hugePagePath.c_str()), errno);
+        }
+        if (static_cast<uint64_t>(fs.f_type) != HUGETLBFS_MAGIC ||
+                static_cast<uint64_t>(fs.f_bsize) != gigabyte) {
+            throw FatalError(HERE, format("[%s] is not a hugetlbfs mount "
+                    "with 1GB pages", hugePagePath.c_str()));
+        }
+        if (config->master.logBytes % gigabyte != 0) {
+            throw FatalError(HERE, format("Log size (%lu bytes) must be a "
+                    "multiple of 1GB to use huge pages",
+                    config->master.logBytes));
+        }
+    }
+
+    // Bind this thread's allocations to the requested node while the block
+    // is mmapped and faulted in, then restore the default policy.
+    int node = config->master.logMemoryNode;
+    if (node >= 0) {
+        unsigned long nodeMask[16] = { 0 }; // NOLINT
+        const int bitsPerWord = 8 * sizeof32(nodeMask[0]);
+        if (node >= 16 * bitsPerWord)
+            throw FatalError(HERE, format("Invalid NUMA node %d", node));
+        nodeMask[node / bitsPerWord] = 1UL << (node % bitsPerWord);
+        if (syscall(SYS_set_mempolicy, MPOL_BIND, nodeMask,
+                    16 * bitsPerWord + 1) != 0) {
+            throw FatalError(HERE, format("Could not bind log memory to NUMA "
+                    "node %d", node), errno);
+        }
+    }
+
+    LargeBlockOfMemory<uint8_t>* block = NULL;
+    try {
+        if (!hugePagePath.empty()) {
+            block = new LargeBlockOfMemory<uint8_t>(
+                    format("%s/ramcloud-log-%d", hugePagePath.c_str(),
+                           getpid()),
+                    config->master.logBytes);
+        } else {
+            block = new LargeBlockOfMemory<uint8_t>(config->master.logBytes);
+        }
+
+        // Anonymous memory is only placed when first touched, so touch it
+        // now, while the policy is in effect.
+        if (node >= 0 && hugePagePath.empty()) {
+            uint64_t pageSize = sysconf(_SC_PAGESIZE);
+            for (uint64_t i = 0; i < block->length; i += pageSize)
+                block->get()[i] = 0;
+        }
+    } catch (...) {
+        if (node >= 0)
+            syscall(SYS_set_mempolicy, MPOL_DEFAULT, NULL, 0);
+        throw;
+    }
+
+    if (node >= 0) {
+        syscall(SYS_set_mempolicy, MPOL_DEFAULT, NULL, 0);
+        LOG(NOTICE, "Bound %lu bytes of log memory to NUMA node %d",
+            block->length, node);
+    }
+    return block;
+}
+
+/**
+ * Set up the flash tier, if config->master.flashTierPath and
+ * config->master.flashTierBytes ask for one: create a file of that size in
+ * that directory (which should be on local flash), map it into memory, and
+ * chop the mapping up into seglets in the flash pool. The file is removed
+ * from the directory immediately, so it disappears when the master exits;
+ * everything written to it is also replicated on backups.
+ *
+ * \param config
+ *      Server runtime configuration.
+ * \throw FatalError
+ *      If the file could not be created or mapped.
+ */
+void
+SegletAllocator::mapFlash(const ServerConfig* config)
+{
+    const string& path = config->master.flashTierPath;
+    uint64_t bytes = config->master.flashTierBytes & ~(segletSize - 1UL);
+    if (path.empty() || bytes == 0)
+        return;
+
+    string fileName = format("%s/ramcloud-flash-%d", path.c_str(), getpid());
+    int fd = open(fileName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd == -1) {
+        throw FatalError(HERE, format("Could not create flash tier file "
+                "[%s]", fileName.c_str()), errno);
+    }
+    unlink(fileName.c_str());
+    if (ftruncate(fd, downCast<off_t>(bytes)) != 0) {
+        int e = errno;
+        close(fd);
+        throw FatalError(HERE, format("Could not extend flash tier file "
+                "[%s] to %lu bytes", fileName.c_str(), bytes), e);
+    }
+    void* base = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        int e = errno;
+        close(fd);
+        throw FatalError(HERE, format("Could not map flash tier file [%s]",
+                fileName.c_str()), e);
+    }
+
+    // Reads of cold objects are scattered, so reading ahead would mostly
+    // waste flash bandwidth and page cache.
+    madvise(base, bytes, MADV_RANDOM);
+
+    flashBase = reinterpret_cast<uintptr_t>(base);
+    flashBytes = bytes;
+    flashFd = fd;
+    uint8_t* segletBlock = static_cast<uint8_t*>(base);
+    for (size_t i = 0; i < (bytes / segletSize); i++) {
+        Seglet* seglet = new Seglet(*this, segletBlock, segletSize);
+        seglet->setSourcePool(&flashPool);
+        segletToSegmentTable.push_back(NULL);
+        flashPool.push_back(seglet);
+        segletBlock += segletSize;
+    }
+    LOG(NOTICE, "Mapped %lu MB flash tier from [%s]", bytes / 1024 / 1024,
+        fileName.c_str());
 }
 
 /**
@@ -63,8 +234,9 @@ SegletAllocator::~SegletAllocator()
 {
     size_t totalFree = emergencyHeadPool.size() +
                        cleanerPool.size() +
-                       defaultPool.size();
-    size_t expectedFree = block.length / segletSize;
+                       defaultPool.size() +
+                       flashPool.size();
+    size_t expectedFree = (block->length + flashBytes) / segletSize;
 
     if (totalFree != expectedFree)
         LOG(WARNING, "Destructor called before all seglets freed!");
@@ -75,6 +247,12 @@ SegletAllocator::~SegletAllocator()
         delete s;
     foreach (Seglet* s, defaultPool)
         delete s;
+    foreach (Seglet* s, flashPool)
+        delete s;
+    if (flashBase != 0)
+        munmap(reinterpret_cast<void*>(flashBase), flashBytes);
+    if (flashFd != -1)
+        close(flashFd);
 }
 
 /**
@@ -96,6 +274,8 @@ SegletAllocator::getMetrics(ProtoBuf::LogMetrics_SegletMetrics& m)
     m.set_cleaner_pool_reserve(cleanerPoolReserve);
     m.set_cleaner_pool_count(cleanerPool.size());
     m.set_default_pool_count(defaultPool.size());
+    m.set_flash_seglets(flashBytes / segletSize);
+    m.set_flash_pool_count(flashPool.size());
 }
 
 /**
@@ -124,6 +304,9 @@ SegletAllocator::alloc(AllocationType type,
     if (type == CLEANER)
         return allocFromPool(cleanerPool, count, outSeglets);
 
+    if (type == FLASH)
+        return allocFromPool(flashPool, count, outSeglets);
+
     return allocFromPool(defaultPool, count, outSeglets);
 }
 
@@ -207,8 +390,11 @@ SegletAllocator::initializeCleanerReserve(uint32_t numSeglets)
 void
 SegletAllocator::free(Seglet* seglet)
 {
-    if (DEBUG_BUILD)
+    // Scribbling on flash seglets would write them all back to flash.
+    if (DEBUG_BUILD && !isOnFlash(seglet->get()))
         memset(seglet->get(), '!', seglet->getLength());
+    if (isOnFlash(seglet->get()))
+        discardFromFlash(seglet->get(), seglet->getLength());
 
     std::lock_guard<SpinLock> guard(lock);
 
@@ -228,6 +414,12 @@ SegletAllocator::free(Seglet* seglet)
         return;
     }
 
+    // Likewise, flash seglets can only ever be used for the flash tier.
+    if (seglet->getSourcePool() == &flashPool) {
+        flashPool.push_back(seglet);
+        return;
+    }
+
     // Any seglets not allocated to emergency heads should be used to fill empty
     // space in the cleaner reserve. The cleaner maintains the invariant that
     // after every pass it has consumed no more seglets than it has freed. Thus
@@ -245,12 +437,13 @@ SegletAllocator::free(Seglet* seglet)
 
 /**
  * Return the total number of seglets this allocator is managing. This includes
- * free seglets, reserved seglets, and currently allocated ones.
+ * free seglets, reserved seglets, and currently allocated ones, but not the
+ * flash tier.
  */
 size_t
 SegletAllocator::getTotalCount()
 {
-    return block.length / segletSize;
+    return block->length / segletSize;
 }
 
 /**
@@ -266,6 +459,8 @@ SegletAllocator::getFreeCount(AllocationType type)
         return emergencyHeadPool.size();
     if (type == CLEANER)
         return cleanerPool.size();
+    if (type == FLASH)
+        return flashPool.size();
     assert(type == DEFAULT);
     return defaultPool.size();
 }
@@ -277,6 +472,8 @@ SegletAllocator::getTotalCount(AllocationType type)
         return emergencyHeadPoolReserve;
     if (type == CLEANER)
         return cleanerPoolReserve;
+    if (type == FLASH)
+        return flashBytes / segletSize;
     assert(type == DEFAULT);
     return getTotalCount() - emergencyHeadPoolReserve - cleanerPoolReserve;
 }
@@ -298,7 +495,7 @@ SegletAllocator::getSegletSize()
 const void*
 SegletAllocator::getBaseAddress()
 {
-    return block.get();
+    return block->get();
 }
 
 /**
@@ -307,7 +504,7 @@ SegletAllocator::getBaseAddress()
 uint64_t
 SegletAllocator::getTotalBytes()
 {
-    return block.length;
+    return block->length;
 }
 
 /**
@@ -362,15 +559,153 @@ size_t
 SegletAllocator::getSegletIndex(const void* p)
 {
     uintptr_t i = reinterpret_cast<uintptr_t>(p);
-    uintptr_t blockBase = reinterpret_cast<uintptr_t>(block.get());
-    if ((i < blockBase) || (i >= (blockBase + block.length))) {
+
+    // Flash seglets come after the ones in memory in segletToSegmentTable.
+    if (isOnFlash(p))
+        return (block->length >> segletSizeShift) +
+               ((i - flashBase) >> segletSizeShift);
+
+    uintptr_t blockBase = reinterpret_cast<uintptr_t>(block->get());
+    if ((i < blockBase) || (i >= (blockBase + block->length))) {
         RAMCLOUD_DIE("pointer out of range; p: %p, blockBase: 0x%lu, "
                 "length: %lu",
-                p, blockBase, block.length);
+                p, blockBase, block->length);
     }
     return (i - blockBase) >> segletSizeShift;
 }
 
+/**
+ * Make sure that part of the flash tier can be read without blocking. If it
+ * isn't all in memory, start reading it in from flash in the background and
+ * return false: the caller should try again later (typically by asking its
+ * client to retry) rather than touch it now, which would block the calling
+ * thread until the read completed. The time from the first call for a given
+ * address until a call finds it in memory is recorded in PerfStats.
+ *
+ * \param p
+ *      Start of the range, which must be on flash (see isOnFlash).
+ * \param length
+ *      Number of bytes needed, starting at p.
+ * \return
+ *      True if the range is in memory; false if it is being fetched.
+ */
+bool
+SegletAllocator::fetchFromFlash(const void* p, uint32_t length)
+{
+    uintptr_t start = reinterpret_cast<uintptr_t>(p);
+    if (isInMemory(p, length)) {
+        std::lock_guard<SpinLock> guard(flashLock);
+        auto it = pendingFetches.find(start);
+        if (it != pendingFetches.end()) {
+            PerfStats::threadStats.flashFetchMicros +=
+                    Cycles::toMicroseconds(Cycles::rdtsc() - it->second);
+            pendingFetches.erase(it);
+        }
+        return true;
+    }
+
+    uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+    uintptr_t firstPage = start & ~(pageSize - 1);
+    uintptr_t end = std::min(start + length, flashBase + flashBytes);
+    madvise(reinterpret_cast<void*>(firstPage), end - firstPage,
+            MADV_WILLNEED);
+
+    std::lock_guard<SpinLock> guard(flashLock);
+    if (pendingFetches.size() >= MAX_PENDING_FETCHES)
+        pendingFetches.clear();
+    if (pendingFetches.emplace(start, Cycles::rdtsc()).second)
+        PerfStats::threadStats.flashFetches++;
+    return false;
+}
+
+/**
+ * Return true if all of the given part of the flash tier is in memory, so
+ * that reading it won't block.
+ *
+ * \param p
+ *      Start of the range, which must be on flash (see isOnFlash).
+ * \param length
+ *      Number of bytes in the range.
+ */
+bool
+SegletAllocator::isInMemory(const void* p, uint32_t length)
+{
+    uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+    uintptr_t start = reinterpret_cast<uintptr_t>(p) & ~(pageSize - 1);
+    uintptr_t end = std::min(reinterpret_cast<uintptr_t>(p) + length,
+                             flashBase + flashBytes);
+    unsigned char resident[64];
+    while (start < end) {
+        uintptr_t pages = std::min<uintptr_t>(
+                (end - start + pageSize - 1) / pageSize, sizeof(resident));
+        if (mincore(reinterpret_cast<void*>(start), pages * pageSize,
+                    resident) != 0) {
+            return false;
+        }
+        for (uintptr_t i = 0; i < pages; i++) {
+            if ((resident[i] & 1) == 0)
+                return false;
+        }
+        start += pages * pageSize;
+    }
+    return true;
+}
+
+/**
+ * Write part of the flash tier out to flash and drop it from memory. The
+ * log cleaner calls this for each survivor segment it writes to flash, once
+ * the segment is complete; otherwise the data would stay in the page cache,
+ * using the DRAM that the flash tier is meant to free, until the kernel
+ * needed the memory for something else.
+ *
+ * \param p
+ *      Start of the range, which must be on flash and page-aligned.
+ * \param length
+ *      Number of bytes in the range.
+ */
+void
+SegletAllocator::writeBackToFlash(const void* p, uint32_t length)
+{
+    void* start = const_cast<void*>(p);
+    if (msync(start, length, MS_SYNC) != 0) {
+        LOG(WARNING, "Could not write flash tier back to flash: %s",
+            strerror(errno));
+        return;
+    }
+    madvise(start, length, MADV_DONTNEED);
+    posix_fadvise(flashFd,
+                  downCast<off_t>(reinterpret_cast<uintptr_t>(p) - flashBase),
+                  length, POSIX_FADV_DONTNEED);
+}
+
+/**
+ * Throw away part of the flash tier's contents, which no segment uses any
+ * more, by punching a hole in its file. Otherwise the first time the log
+ * cleaner writes a survivor segment there, each page it touches would fault
+ * the page's stale contents in from flash before it could be overwritten;
+ * instead the pages fault in as zeros without any I/O. This also lets the
+ * flash erase the blocks ahead of time.
+ *
+ * \param p
+ *      Start of the range, which must be on flash and page-aligned.
+ * \param length
+ *      Number of bytes in the range.
+ */
+void
+SegletAllocator::discardFromFlash(const void* p, uint32_t length)
+{
+    if (!flashPunchHoles)
+        return;
+    if (fallocate(flashFd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                  downCast<off_t>(reinterpret_cast<uintptr_t>(p) - flashBase),
+                  length) != 0) {
+        LOG(WARNING, "Could not punch hole in flash tier file, so reused "
+            "flash seglets will be read in before they are written: %s",
+            strerror(errno));
+        flashPunchHoles = false;
+    }
+}
+
 /**
  * Allocate the exact number of requested seglets from a specific pool. If
  * the full allocation cannot be met, allocate nothing and return false.
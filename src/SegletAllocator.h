@@ -16,6 +16,9 @@
 #ifndef RAMCLOUD_SEGLETALLOCATOR_H
 #define RAMCLOUD_SEGLETALLOCATOR_H
 
+#include <memory>
+#include <unordered_map>
+
 #include "Common.h"
 #include "LargeBlockOfMemory.h"
 #include "Seglet.h"
@@ -49,6 +52,17 @@ class LogSegment;
  * Finally, there is a "default" pool from which regular log heads are allocated
  * to service normal log appends.
  *
+ * If the master has a flash tier (see ServerConfig::Master::flashTierPath),
+ * there is also a "flash" pool, whose seglets are backed by a file on local
+ * flash that is mapped into memory rather than by DRAM. The log cleaner
+ * writes survivor segments holding cold data into it, so that their DRAM can
+ * hold new data instead. Entries in these segments are accessed through
+ * ordinary log references, so the rest of the master needn't know where they
+ * are; the kernel pages them in on access. Since a page fault would block the
+ * thread taking it, readers that want to avoid blocking use fetchFromFlash
+ * first. Flash seglets are not counted as log memory anywhere in this class
+ * (getTotalCount, getMemoryUtilization, etc.), except the FLASH variants.
+ *
  * How seglets are returned to appropriate pools is somewhat subtle (and
  * annoyingly so). See the free() method's documentation if you're interested.
  *
@@ -67,7 +81,8 @@ class SegletAllocator {
     enum AllocationType {
         EMERGENCY_HEAD,
         CLEANER,
-        DEFAULT
+        DEFAULT,
+        FLASH
     };
 
     explicit SegletAllocator(const ServerConfig* config);
@@ -88,9 +103,35 @@ class SegletAllocator {
     int getMemoryUtilization();
     LogSegment* getOwnerSegment(const void* p);
     void setOwnerSegment(Seglet* seglet, LogSegment* segment);
+    bool fetchFromFlash(const void* p, uint32_t length);
+    bool isInMemory(const void* p, uint32_t length);
+    void writeBackToFlash(const void* p, uint32_t length);
+
+    /**
+     * Return true if this allocator has a flash tier.
+     */
+    bool
+    hasFlash() const
+    {
+        return flashBytes != 0;
+    }
+
+    /**
+     * Return true if the given pointer refers to the flash tier (that is, to
+     * an entry in a segment allocated from the FLASH pool).
+     */
+    bool
+    isOnFlash(const void* p) const
+    {
+        return (reinterpret_cast<uintptr_t>(p) - flashBase) < flashBytes;
+    }
 
   PRIVATE:
+    static LargeBlockOfMemory<uint8_t>* allocateBlock(
+            const ServerConfig* config);
+    void mapFlash(const ServerConfig* config);
     size_t getSegletIndex(const void* p);
+    void discardFromFlash(const void* p, uint32_t length);
     bool allocFromPool(vector<Seglet*>& pool,
                        uint32_t count,
                        vector<Seglet*>& outSeglets);
@@ -145,8 +186,40 @@ class SegletAllocator {
     /// based on a pointer anywhere into ``block'' below.
     vector<LogSegment*> segletToSegmentTable;
 
-    /// Single contiguous block of memory backing all of our seglets.
-    LargeBlockOfMemory<uint8_t> block;
+    /// Single contiguous block of memory backing all of our seglets (see
+    /// allocateBlock()).
+    std::unique_ptr<LargeBlockOfMemory<uint8_t>> block;
+
+    /// Pool holding the flash tier's unallocated seglets (see mapFlash()).
+    /// Seglets allocated from it always return to it.
+    vector<Seglet*> flashPool;
+
+    /// Address at which the flash tier's file is mapped, or 0 if there is no
+    /// flash tier.
+    uintptr_t flashBase;
+
+    /// Size of the flash tier in bytes; 0 if there is none.
+    uint64_t flashBytes;
+
+    /// Open file descriptor for the flash tier's file, or -1.
+    int flashFd;
+
+    /// False once punching a hole in the flash tier's file has failed (its
+    /// file system doesn't support it), so that discardFromFlash stops
+    /// trying.
+    bool flashPunchHoles;
+
+    /// Protects pendingFetches.
+    SpinLock flashLock;
+
+    /// Entries that fetchFromFlash has started reading in from flash but
+    /// that no reader has yet found in memory, mapped to the Cycles::rdtsc
+    /// time the fetch started. Used to measure how long fetches take.
+    std::unordered_map<uintptr_t, uint64_t> pendingFetches;
+
+    /// If this many fetches are outstanding (because clients gave up before
+    /// retrying, say) pendingFetches is cleared, rather than growing forever.
+    enum { MAX_PENDING_FETCHES = 10000 };
 
     DISALLOW_COPY_AND_ASSIGN(SegletAllocator);
 };
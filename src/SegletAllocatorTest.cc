@@ -15,6 +15,7 @@
 
 #include "TestUtil.h"
 
+#include "PerfStats.h"
 #include "Seglet.h"
 #include "ServerConfig.h"
 
@@ -47,6 +48,129 @@ TEST_F(SegletAllocatorTest, constructor) {
         allocator.defaultPool.size());
 }
 
+TEST_F(SegletAllocatorTest, allocateBlock_hugePages) {
+    ServerConfig config = ServerConfig::forTesting();
+    config.master.hugePagePath = "/proc";
+    EXPECT_THROW(SegletAllocator::allocateBlock(&config), FatalError);
+    config.master.hugePagePath = "/ramcloud/does/not/exist";
+    EXPECT_THROW(SegletAllocator::allocateBlock(&config), FatalError);
+
+    config.master.hugePagePath = "";
+    std::unique_ptr<LargeBlockOfMemory<uint8_t>> block(
+        SegletAllocator::allocateBlock(&config));
+    EXPECT_EQ(config.master.logBytes, block->length);
+}
+
+TEST_F(SegletAllocatorTest, mapFlash) {
+    ServerConfig config = ServerConfig::forTesting();
+    config.master.flashTierPath = "/tmp";
+    config.master.flashTierBytes = 4 * config.segletSize + 10;
+    TestLog::Enable _("mapFlash");
+    SegletAllocator flashAllocator(&config);
+    EXPECT_TRUE(flashAllocator.hasFlash());
+    EXPECT_EQ(4U * config.segletSize, flashAllocator.flashBytes);
+    EXPECT_EQ(4U, flashAllocator.flashPool.size());
+    EXPECT_EQ(4U, flashAllocator.getTotalCount(SegletAllocator::FLASH));
+    EXPECT_EQ(config.master.logBytes / config.segletSize,
+              flashAllocator.getTotalCount());
+    EXPECT_TRUE(flashAllocator.isOnFlash(
+              flashAllocator.flashPool[0]->get()));
+    EXPECT_FALSE(flashAllocator.isOnFlash(
+              flashAllocator.defaultPool[0]->get()));
+    EXPECT_EQ(0U, TestLog::get().find("mapFlash: Mapped"));
+
+    EXPECT_FALSE(allocator.hasFlash());
+    EXPECT_FALSE(allocator.isOnFlash(allocator.defaultPool[0]->get()));
+}
+
+TEST_F(SegletAllocatorTest, mapFlash_badPath) {
+    ServerConfig config = ServerConfig::forTesting();
+    config.master.flashTierPath = "/ramcloud/does/not/exist";
+    config.master.flashTierBytes = config.segletSize;
+    EXPECT_THROW(SegletAllocator flashAllocator(&config), FatalError);
+}
+
+TEST_F(SegletAllocatorTest, alloc_flash) {
+    ServerConfig config = ServerConfig::forTesting();
+    config.master.flashTierPath = "/tmp";
+    config.master.flashTierBytes = 2 * config.segletSize;
+    SegletAllocator flashAllocator(&config);
+    size_t defaultSeglets = flashAllocator.defaultPool.size();
+
+    vector<Seglet*> seglets;
+    EXPECT_FALSE(flashAllocator.alloc(SegletAllocator::FLASH, 3, seglets));
+    EXPECT_TRUE(flashAllocator.alloc(SegletAllocator::FLASH, 2, seglets));
+    EXPECT_EQ(0U, flashAllocator.getFreeCount(SegletAllocator::FLASH));
+    EXPECT_EQ(defaultSeglets, flashAllocator.defaultPool.size());
+
+    // Flash seglets have their own entries in the owner table.
+    LogSegment* owner = reinterpret_cast<LogSegment*>(0x1234);
+    flashAllocator.setOwnerSegment(seglets[1], owner);
+    EXPECT_EQ(owner, flashAllocator.getOwnerSegment(
+              static_cast<char*>(seglets[1]->get()) + 10));
+    EXPECT_TRUE(flashAllocator.getOwnerSegment(seglets[0]->get()) == NULL);
+    EXPECT_EQ(defaultSeglets + 1, flashAllocator.getSegletIndex(
+              seglets[1]->get()));
+
+    // Freed flash seglets always go back to the flash pool.
+    flashAllocator.cleanerPoolReserve = 1;
+    foreach (Seglet* s, seglets)
+        s->free();
+    EXPECT_EQ(2U, flashAllocator.getFreeCount(SegletAllocator::FLASH));
+    EXPECT_EQ(0U, flashAllocator.cleanerPool.size());
+    EXPECT_TRUE(flashAllocator.getOwnerSegment(seglets[1]->get()) == NULL);
+    flashAllocator.cleanerPoolReserve = 0;
+}
+
+TEST_F(SegletAllocatorTest, free_discardsFlash) {
+    ServerConfig config = ServerConfig::forTesting();
+    config.master.flashTierPath = "/tmp";
+    config.master.flashTierBytes = config.segletSize;
+    SegletAllocator flashAllocator(&config);
+    vector<Seglet*> seglets;
+    EXPECT_TRUE(flashAllocator.alloc(SegletAllocator::FLASH, 1, seglets));
+    char* p = static_cast<char*>(seglets[0]->get());
+    memset(p, 'x', config.segletSize);
+    seglets[0]->free();
+
+    // Not all file systems can punch holes.
+    if (flashAllocator.flashPunchHoles) {
+        EXPECT_EQ(0, p[0]);
+        EXPECT_EQ(0, p[config.segletSize - 1]);
+    }
+}
+
+TEST_F(SegletAllocatorTest, fetchFromFlash) {
+    ServerConfig config = ServerConfig::forTesting();
+    config.master.flashTierPath = "/tmp";
+    config.master.flashTierBytes = config.segletSize;
+    SegletAllocator flashAllocator(&config);
+    char* p = static_cast<char*>(flashAllocator.flashPool[0]->get());
+
+    // Pages of the file that have been written are in the page cache.
+    memset(p, 'x', 100);
+    EXPECT_TRUE(flashAllocator.isInMemory(p, 100));
+    PerfStats::threadStats.flashFetches = 0;
+    EXPECT_TRUE(flashAllocator.fetchFromFlash(p + 10, 90));
+    EXPECT_EQ(0U, PerfStats::threadStats.flashFetches);
+
+    // Once written back, they have to be fetched again.
+    flashAllocator.writeBackToFlash(p, config.segletSize);
+    if (!flashAllocator.isInMemory(p, 100)) {
+        bool fetched = flashAllocator.fetchFromFlash(p + 10, 90);
+        if (!fetched) {
+            EXPECT_EQ(1U, PerfStats::threadStats.flashFetches);
+            EXPECT_EQ(1U, flashAllocator.pendingFetches.size());
+        }
+        while (!flashAllocator.fetchFromFlash(p + 10, 90))
+            usleep(100);
+        EXPECT_EQ(0U, flashAllocator.pendingFetches.size());
+    }
+    EXPECT_EQ('x', p[99]);
+    PerfStats::threadStats.flashFetches = 0;
+    PerfStats::threadStats.flashFetchMicros = 0;
+}
+
 TEST_F(SegletAllocatorTest, destructor) {
     TestLog::Enable _;
     Tub<SegletAllocator> allocator2;
@@ -246,7 +246,30 @@ Segment::append(LogEntryType type,
                 Reference* outReference)
 {
     uint32_t length = buffer.size();
-    return append(type, buffer.getRange(0, length), length, outReference);
+    EntryHeader entryHeader(type, length);
+
+    if (!hasSpaceFor(&length, 1))
+        return false;
+
+    uint32_t startOffset = head;
+
+    copyIn(head, &entryHeader, sizeof(entryHeader));
+    checksum.update(&entryHeader, sizeof(entryHeader));
+    head += sizeof32(entryHeader);
+
+    copyIn(head, &length, entryHeader.getLengthBytes());
+    checksum.update(&length, entryHeader.getLengthBytes());
+    head += entryHeader.getLengthBytes();
+
+    // Copy each chunk of the buffer straight into the segment, rather than
+    // flattening the buffer first (which would copy the entry twice).
+    copyInFromBuffer(head, buffer, 0, length);
+    head += length;
+
+    if (outReference != NULL)
+        *outReference = Reference(this, startOffset);
+
+    return true;
 }
 
 /**
@@ -346,6 +369,22 @@ Segment::appendLogHeader(LogEntryType type,
     memcpy(header + 1, &objectSize, entryHeader.getLengthBytes());
 }
 
+/**
+ * Return the number of bytes of metadata that a segment stores in front of
+ * an entry (the EntryHeader and the entry's length).
+ *
+ * \param type
+ *      Type of the entry. See LogEntryTypes.h.
+ * \param length
+ *      Length of the entry's contents, in bytes.
+ */
+uint32_t
+Segment::getEntryHeaderLength(LogEntryType type, uint32_t length)
+{
+    EntryHeader entryHeader(type, length);
+    return sizeof32(EntryHeader) + entryHeader.getLengthBytes();
+}
+
 /**
  * Close the segment, making it permanently immutable. Closing it will cause all
  * future append operations to fail.
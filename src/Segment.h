@@ -285,6 +285,7 @@ class Segment {
     static void appendLogHeader(LogEntryType type,
                                 uint32_t objectSize,
                                 Buffer *logBuffer);
+    static uint32_t getEntryHeaderLength(LogEntryType type, uint32_t length);
     void close();
     void appendToBuffer(Buffer& buffer,
                         uint32_t offset,
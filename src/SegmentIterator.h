@@ -46,6 +46,24 @@ struct SegmentIteratorException : public Exception {
  */
 class SegmentIterator {
   public:
+    /**
+     * Describes one entry of the segment; filled in by #nextBatch.
+     */
+    struct Entry {
+        /// Type of the entry.
+        LogEntryType type;
+
+        /// Offset of the entry (that is, of its header) in the segment.
+        uint32_t offset;
+
+        /// Length of the entry's contents, in bytes.
+        uint32_t length;
+
+        /// The entry's contents, or NULL if they aren't contiguous in
+        /// memory.
+        const void* data;
+    };
+
     explicit SegmentIterator(Segment& segment);
     SegmentIterator(const void* buffer, uint32_t length,
                     const SegmentCertificate& certificate);
@@ -53,6 +71,7 @@ class SegmentIterator {
     SegmentIterator& operator=(const SegmentIterator& other);
     ~SegmentIterator();
     void next();
+    uint32_t nextBatch(Entry* entries, uint32_t maxEntries);
     LogEntryType getType();
     uint32_t getLength();
     uint32_t getOffset();
@@ -164,6 +164,50 @@ TEST_F(SegmentIteratorTest, next) {
     EXPECT_EQ(s.getEntryHeader(7), it2.currentHeader);
 }
 
+TEST_F(SegmentIteratorTest, nextBatch) {
+    char big[70000];
+    memset(big, 'x', sizeof(big));
+    s.append(LOG_ENTRY_TYPE_OBJ, "hi", 3);
+    s.append(LOG_ENTRY_TYPE_OBJTOMB, big, 300);
+    s.append(LOG_ENTRY_TYPE_OBJ, big, sizeof32(big));
+    s.append(LOG_ENTRY_TYPE_SAFEVERSION, "yo", 3);
+
+    SegmentIterator expected(s);
+    SegmentIterator it(s);
+    SegmentIterator::Entry entries[3];
+    EXPECT_EQ(3U, it.nextBatch(entries, 3));
+    for (uint32_t i = 0; i < 3; i++) {
+        EXPECT_EQ(expected.getType(), entries[i].type);
+        EXPECT_EQ(expected.getOffset(), entries[i].offset);
+        EXPECT_EQ(expected.getLength(), entries[i].length);
+        Buffer buffer;
+        expected.appendToBuffer(buffer);
+        EXPECT_EQ(0, memcmp(buffer.getRange(0, buffer.size()),
+                entries[i].data, entries[i].length));
+        expected.next();
+    }
+    EXPECT_EQ(expected.getOffset(), it.getOffset());
+    EXPECT_EQ(LOG_ENTRY_TYPE_SAFEVERSION, it.getType());
+    EXPECT_EQ(3U, it.getLength());
+
+    EXPECT_EQ(1U, it.nextBatch(entries, 3));
+    EXPECT_EQ(LOG_ENTRY_TYPE_SAFEVERSION, entries[0].type);
+    EXPECT_STREQ("yo", static_cast<const char*>(entries[0].data));
+    EXPECT_TRUE(it.isDone());
+    EXPECT_EQ(LOG_ENTRY_TYPE_INVALID, it.getType());
+    EXPECT_EQ(0U, it.nextBatch(entries, 3));
+}
+
+TEST_F(SegmentIteratorTest, nextBatch_limit) {
+    s.append(LOG_ENTRY_TYPE_OBJ, "hi", 3);
+    s.append(LOG_ENTRY_TYPE_OBJ, "yo", 3);
+    SegmentIterator it(s);
+    it.setLimit(5);
+    SegmentIterator::Entry entries[3];
+    EXPECT_EQ(1U, it.nextBatch(entries, 3));
+    EXPECT_TRUE(it.isDone());
+}
+
 TEST_F(SegmentIteratorTest, getType) {
     s.append(LOG_ENTRY_TYPE_OBJ, "hi", 3);
     s.append(LOG_ENTRY_TYPE_OBJTOMB, "hi", 3);
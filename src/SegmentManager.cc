@@ -65,7 +65,9 @@ SegmentManager::SegmentManager(Context* context,
       segletsPerSegment(segmentSize / allocator.getSegletSize()),
       maxSegments(static_cast<uint32_t>(static_cast<double>(
         allocator.getTotalCount() / segletsPerSegment)
-          * config->master.diskExpansionFactor)),
+          * config->master.diskExpansionFactor) +
+        downCast<uint32_t>(allocator.getTotalCount(SegletAllocator::FLASH) /
+                           segletsPerSegment)),
       segments(NULL),
       states(NULL),
       freeEmergencyHeadSlots(),
@@ -81,9 +83,11 @@ SegmentManager::SegmentManager(Context* context,
       segmentsOnDisk(0),
       segmentsOnDiskHistogram(maxSegments, 1),
       safeVersion(1),
+      freeableEpoch(0),
       oldestRpcEpoch(0),
       stuckStartTime(0),
-      nextMessageSeconds(0.0)
+      nextMessageSeconds(0.0),
+      flashLiveBytes(0)
 {
     if ((segmentSize % allocator.getSegletSize()) != 0)
         throw SegmentManagerException(HERE, "segmentSize % segletSize != 0");
@@ -156,6 +160,39 @@ SegmentManager::getMetrics(ProtoBuf::LogMetrics_SegmentMetrics& m)
     }
 }
 
+/**
+ * Add seglet-level fragmentation statistics for the closed, in-memory segments
+ * we're managing to the given protocol buffer (the rest of it is filled in by
+ * SegletAllocator::getMetrics). Trailing seglets are already returned as soon
+ * as a survivor is closed, so what remains is dead space within seglets that
+ * only compaction or cleaning can reclaim.
+ */
+void
+SegmentManager::getSegletMetrics(ProtoBuf::LogMetrics_SegletMetrics& m)
+{
+    SpinLock::Guard _(lock);
+
+    Histogram utilizationHistogram(101, 1);
+    uint64_t reclaimableSeglets = 0;
+    State closedStates[] = { NEWLY_CLEANABLE, CLEANABLE };
+    foreach (State state, closedStates) {
+        foreach (LogSegment& s, segmentsByState[state]) {
+            uint32_t allocated = s.getSegletsAllocated();
+            if (allocated == 0 || s.onFlash)
+                continue;
+            utilizationHistogram.storeSample(s.getMemoryUtilization());
+            uint32_t live = (s.getLiveBytes() + s.segletSize - 1) /
+                            s.segletSize;
+            if (allocated > live)
+                reclaimableSeglets += allocated - live;
+        }
+    }
+
+    utilizationHistogram.serialize(
+        *m.mutable_segment_seglet_utilization_histogram());
+    m.set_reclaimable_seglets(reclaimableSeglets);
+}
+
 /**
  * Return the allocator that is being used to provide backing memory to segments
  * this module is managing.
@@ -271,7 +308,9 @@ SegmentManager::allocHeadSegment(uint32_t flags)
  *      If the FOR_CLEANING flag is provided, the allocation will be attempted
  *      from a pool specially reserved for the cleaner. If MUST_NOT_FAIL is
  *      provided, the method will block until a segment is free. Otherwise, it
- *      will return immediately with NULL if no segment is available.
+ *      will return immediately with NULL if no segment is available. If
+ *      ON_FLASH is provided, the segment comes from the flash tier, and NULL
+ *      is returned immediately if none is available there.
  *
  * \param replacing
  *      If memory compaction is being performed, this must point to the current
@@ -301,7 +340,9 @@ SegmentManager::allocSideSegment(uint32_t flags, LogSegment* replacing)
             creationTimestamp = replacing->creationTimestamp;
         }
 
-        if (flags & FOR_CLEANING)
+        if (flags & ON_FLASH)
+            s = alloc(ALLOC_FLASH_SIDELOG, id, creationTimestamp);
+        else if (flags & FOR_CLEANING)
             s = alloc(ALLOC_CLEANER_SIDELOG, id, creationTimestamp);
         else
             s = alloc(ALLOC_REGULAR_SIDELOG, id, creationTimestamp);
@@ -309,6 +350,9 @@ SegmentManager::allocSideSegment(uint32_t flags, LogSegment* replacing)
         if (s != NULL)
             break;
 
+        if (flags & ON_FLASH)
+            return NULL;
+
         if ((flags & MUST_NOT_FAIL) == 0)
             return NULL;
 
@@ -366,11 +410,14 @@ SegmentManager::cleaningComplete(LogSegmentVector& clean,
 {
     SpinLock::Guard guard(lock);
 
-    // Sanity check: the cleaner must not have used more seglets than it freed.
+    // Sanity check: the cleaner must not have used more seglets than it freed
+    // (survivors on the flash tier don't use any memory).
     uint32_t segletsUsed = 0;
     uint32_t segletsFreed = 0;
-    foreach (LogSegment* s, survivors)
-        segletsUsed += s->getSegletsAllocated();
+    foreach (LogSegment* s, survivors) {
+        if (!s->onFlash)
+            segletsUsed += s->getSegletsAllocated();
+    }
     foreach (LogSegment* s, clean)
         segletsFreed += s->getSegletsAllocated();
     assert(segletsUsed <= segletsFreed);
@@ -680,9 +727,12 @@ SegmentManager::allocateVersion() {
  */
 bool
 SegmentManager::raiseSafeVersion(uint64_t minimum) {
-    if (minimum > safeVersion) {
-        safeVersion = minimum;
-        return true;
+    // Recovery may replay a segment on several threads at once, so the
+    // comparison and the update must be a single atomic step.
+    uint64_t current = safeVersion.load();
+    while (minimum > current) {
+        if (safeVersion.compare_exchange_weak(current, minimum))
+            return true;
     }
     return false;
 }
@@ -958,6 +1008,8 @@ SegmentManager::alloc(AllocPurpose purpose,
         type = SegletAllocator::CLEANER;
     else if (purpose == ALLOC_EMERGENCY_HEAD)
         type = SegletAllocator::EMERGENCY_HEAD;
+    else if (purpose == ALLOC_FLASH_SIDELOG)
+        type = SegletAllocator::FLASH;
 
     if (!allocator.alloc(type, segmentSize / segletSize, seglets)) {
         assert(purpose != ALLOC_EMERGENCY_HEAD);
@@ -966,7 +1018,9 @@ SegmentManager::alloc(AllocPurpose purpose,
     }
 
     State state = HEAD;
-    if (purpose == ALLOC_REGULAR_SIDELOG || purpose == ALLOC_CLEANER_SIDELOG)
+    if (purpose == ALLOC_REGULAR_SIDELOG ||
+        purpose == ALLOC_CLEANER_SIDELOG ||
+        purpose == ALLOC_FLASH_SIDELOG)
         state = SIDELOG;
 
     segments[slot].construct(seglets,
@@ -984,6 +1038,7 @@ SegmentManager::alloc(AllocPurpose purpose,
     idToSlotMap[segmentId] = slot;
 
     LogSegment& s = *segments[slot];
+    s.onFlash = (purpose == ALLOC_FLASH_SIDELOG);
     addToLists(s);
 
     return &s;
@@ -1006,6 +1061,7 @@ SegmentManager::allocSlot(AllocPurpose purpose)
     switch (purpose) {
     case ALLOC_HEAD:
     case ALLOC_REGULAR_SIDELOG:
+    case ALLOC_FLASH_SIDELOG:
         source = &freeSlots;
         break;
     case ALLOC_EMERGENCY_HEAD:
@@ -1127,6 +1183,10 @@ SegmentManager::removeFromLists(LogSegment& s)
  * immediately freed.
  *
  * This method is lazily invoked when new segments are allocated.
+ *
+ * Scanning the outstanding RPCs means stopping the dispatch thread, and it
+ * takes longer the more RPCs there are, so the scan is skipped whenever the
+ * result of the previous one shows that all of the segments can be freed.
  */
 void
 SegmentManager::freeUnreferencedSegments()
@@ -1135,13 +1195,36 @@ SegmentManager::freeUnreferencedSegments()
     if (freeablePending.empty())
         return;
 
+    // First free the segments that the last scan already cleared.
+    bool needScan = false;
+    SegmentList::iterator it = freeablePending.begin();
+    while (it != freeablePending.end()) {
+        LogSegment& s = *it;
+        ++it;
+        if (s.cleanedEpoch < freeableEpoch) {
+            free(&s);
+        } else {
+            needScan = true;
+        }
+    }
+    if (!needScan) {
+        nextMessageSeconds = 0;
+        return;
+    }
+
+    // Anything that starts after this point gets at least the current
+    // epoch, so the scan's result can be reused for segments cleaned
+    // before both.
+    uint64_t currentEpoch = LogProtector::getCurrentEpoch();
     uint64_t earliestEpoch;
     {
         Dispatch::Lock lock(context->dispatch);
         earliestEpoch = LogProtector::getEarliestOutstandingEpoch(
                             Transport::ServerRpc::READ_ACTIVITY);
     }
-    SegmentList::iterator it = freeablePending.begin();
+    freeableEpoch = std::max(freeableEpoch,
+            std::min(earliestEpoch, currentEpoch));
+    it = freeablePending.begin();
 
     int skippedCount = 0;
     uint64_t savedEpoch = ~0;
@@ -105,7 +105,14 @@ class SegmentManager {
         /// The segment being allocated will be used for cleaning. This simply
         /// tells SegmentManager which pool of memory to allocate from. This
         /// flag only makes sense in the allocSideSegment method.
-        FOR_CLEANING = 2
+        FOR_CLEANING = 2,
+
+        /// The segment being allocated will hold cold data and should be
+        /// stored on the master's flash tier instead of in memory (see
+        /// SegletAllocator). If the flash tier is full or there isn't one,
+        /// NULL is returned, regardless of MUST_NOT_FAIL. This flag only
+        /// makes sense in the allocSideSegment method.
+        ON_FLASH = 4
     };
 
     SegmentManager(Context* context,
@@ -116,6 +123,7 @@ class SegmentManager {
                    MasterTableMetadata* masterTableMetadata);
     ~SegmentManager();
     void getMetrics(ProtoBuf::LogMetrics_SegmentMetrics& m);
+    void getSegletMetrics(ProtoBuf::LogMetrics_SegletMetrics& m);
     SegletAllocator& getAllocator() const;
     LogSegment* allocHeadSegment(uint32_t flags = EMPTY);
     LogSegment* allocSideSegment(uint32_t flags = EMPTY,
@@ -134,6 +142,27 @@ class SegmentManager {
     bool raiseSafeVersion(uint64_t minimum);
     int getMemoryUtilization();
 
+    /**
+     * Return the number of bytes of live objects and other long-lived
+     * entries in segments on the flash tier. These count towards the log's
+     * live bytes, but not towards its use of memory.
+     */
+    uint64_t
+    getFlashLiveBytes() const
+    {
+        return flashLiveBytes;
+    }
+
+    /**
+     * Adjust the value returned by getFlashLiveBytes, as long-lived entries
+     * are written to and freed from the flash tier.
+     */
+    void
+    adjustFlashLiveBytes(int64_t delta)
+    {
+        flashLiveBytes += delta;
+    }
+
 #ifdef TESTING
     /// Used to mock the return value of getSegmentUtilization() when set to
     /// anything other than 0.
@@ -223,11 +252,11 @@ class SegmentManager {
     INTRUSIVE_LIST_TYPEDEF(LogSegment, listEntries) SegmentList;
     INTRUSIVE_LIST_TYPEDEF(LogSegment, allListEntries) AllSegmentList;
 
-    /// The private alloc() routine allocates segments for four different
+    /// The private alloc() routine allocates segments for five different
     /// purposes: heads, emergency heads, regular SideLog segments, and
-    /// cleaner SideLog segments. These enums specify which. They affect the
-    /// pools from which segments (and seglets) are allocated, as well as the
-    /// initial states of the segments returned.
+    /// cleaner SideLog segments in memory and on flash. These enums specify
+    /// which. They affect the pools from which segments (and seglets) are
+    /// allocated, as well as the initial states of the segments returned.
     enum AllocPurpose {
         /// Allocate a head segment that entries may be appended to. The log
         /// will be rolled over to this new segment in memory and on backups.
@@ -250,7 +279,12 @@ class SegmentManager {
         /// in log cleaning. These segments are allocated from the cleaner pool.
         /// This separate pool ensures that the system does not deadlock itself
         /// by allocating all segments and having nothing left to clean with.
-        ALLOC_CLEANER_SIDELOG
+        ALLOC_CLEANER_SIDELOG,
+
+        /// Allocate a segment for use by a SideLog instance that is involved
+        /// in log cleaning, to hold cold data on the flash tier. These
+        /// segments are allocated from the flash pool.
+        ALLOC_FLASH_SIDELOG
     };
 
     LogSegment* alloc(AllocPurpose purpose,
@@ -410,6 +444,12 @@ class SegmentManager {
     std::atomic_uint_fast64_t safeVersion;
 
 
+    /// Segments cleaned before this epoch can be freed without checking the
+    /// outstanding RPCs again: when freeUnreferencedSegments last checked,
+    /// every RPC or other log activity still running had started at or
+    /// after it, and epochs only move forward.
+    uint64_t freeableEpoch;
+
     /// The following variables allow us to log messages if the epoch
     /// mechanism gets "stuck", where some old RPC is never completing and
     /// that prevents us from freeing cleaned segments. OldestRpcEpoch is
@@ -426,6 +466,9 @@ class SegmentManager {
     /// stuck. 0 means we aren't stuck.
     double nextMessageSeconds;
 
+    /// See getFlashLiveBytes.
+    std::atomic<uint64_t> flashLiveBytes;
+
     DISALLOW_COPY_AND_ASSIGN(SegmentManager);
 };
 
@@ -199,6 +199,16 @@ TEST_F(SegmentManagerTest, allocSideSegment_forCleanerSideLog) {
         segmentManager.allocSideSegment(SegmentManager::FOR_CLEANING));
 }
 
+TEST_F(SegmentManagerTest, allocSideSegment_onFlash) {
+    TestLog::Enable _(allocFilter);
+
+    // Without a flash tier, the allocation fails even if it mustn't.
+    EXPECT_EQ(static_cast<LogSegment*>(NULL),
+        segmentManager.allocSideSegment(SegmentManager::ON_FLASH |
+                                        SegmentManager::MUST_NOT_FAIL));
+    EXPECT_EQ("alloc: purpose: 4", TestLog::get());
+}
+
 static void
 initCleanerSegmentPool(SegmentManager* sm)
 {
@@ -332,6 +342,26 @@ TEST_F(SegmentManagerTest, getActiveSegments) {
     EXPECT_EQ(0U, active.size());
 }
 
+TEST_F(SegmentManagerTest, getSegletMetrics) {
+    segmentManager.allocHeadSegment();
+    LogSegment* cleanable = segmentManager.allocHeadSegment();
+    segmentManager.allocHeadSegment();
+    LogSegmentVector unused;
+    segmentManager.cleanableSegments(unused);
+
+    ProtoBuf::LogMetrics_SegletMetrics m;
+    segmentManager.getSegletMetrics(m);
+    Histogram histogram(m.segment_seglet_utilization_histogram());
+    EXPECT_EQ(2U, histogram.getTotalSamples());
+    EXPECT_EQ(0U, m.reclaimable_seglets());
+
+    // Once everything in a segment is dead, all of its seglets are stranded.
+    for (int i = 0; i < TOTAL_LOG_ENTRY_TYPES; i++)
+        cleanable->deadEntryLengths[i] = cleanable->entryLengths[i].load();
+    segmentManager.getSegletMetrics(m);
+    EXPECT_EQ(cleanable->getSegletsAllocated(), m.reclaimable_seglets());
+}
+
 TEST_F(SegmentManagerTest, initializeSurvivorSegmentReserve) {
     LogSegment* nullSeg = NULL;
     EXPECT_EQ(nullSeg,
@@ -636,6 +666,43 @@ TEST_F(SegmentManagerTest, freeUnreferencedSegments) {
     pool.destroy(rpc);
 }
 
+TEST_F(SegmentManagerTest, freeUnreferencedSegments_skipScan) {
+    LogSegment* freeable1 = segmentManager.allocHeadSegment();
+    LogSegment* freeable2 = segmentManager.allocHeadSegment();
+    segmentManager.allocHeadSegment();
+
+    // This RPC would keep both segments from being freed, if it were seen.
+    ServerRpcPool<TestServerRpc> pool;
+    TestServerRpc* rpc = pool.construct();
+    rpc->epoch = 3;
+
+    segmentManager.changeState(*freeable1,
+        SegmentManager::FREEABLE_PENDING_REFERENCES);
+    segmentManager.changeState(*freeable2,
+        SegmentManager::FREEABLE_PENDING_REFERENCES);
+    freeable1->cleanedEpoch = 5;
+    freeable2->cleanedEpoch = 12;
+
+    // An earlier scan cleared epochs before 10: no need to scan for the
+    // first segment, but there is for the second.
+    segmentManager.freeableEpoch = 10;
+    segmentManager.freeUnreferencedSegments();
+    EXPECT_EQ(1U, segmentManager.segmentsByState[
+        SegmentManager::FREEABLE_PENDING_REFERENCES].size());
+    EXPECT_EQ(freeable2, &segmentManager.segmentsByState[
+        SegmentManager::FREEABLE_PENDING_REFERENCES].front());
+    EXPECT_EQ(10U, segmentManager.freeableEpoch);
+
+    // A scan that finds nothing running clears everything before the
+    // current epoch.
+    pool.destroy(rpc);
+    LogProtector::currentSystemEpoch = 20;
+    segmentManager.freeUnreferencedSegments();
+    EXPECT_EQ(0U, segmentManager.segmentsByState[
+        SegmentManager::FREEABLE_PENDING_REFERENCES].size());
+    EXPECT_EQ(20U, segmentManager.freeableEpoch);
+}
+
 // Helper function that invokes Dispatch::poll in a separate thread.
 static void testPoll(Dispatch* dispatch) {
     dispatch->poll();
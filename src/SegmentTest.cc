@@ -163,6 +163,28 @@ TEST_P(SegmentTest, append_whiteBox) {
     EXPECT_EQ(0, memcmp("hi", buffer.getRange(2, 2), 2));
 }
 
+TEST_P(SegmentTest, append_multiChunkBuffer) {
+    SegmentAndAllocator segAndAlloc(GetParam());
+    Segment& s = *segAndAlloc.segment;
+
+    Buffer dataBuffer;
+    dataBuffer.appendExternal("h", 1);
+    dataBuffer.appendExternal("i", 1);
+
+    Segment::Reference ref;
+    EXPECT_TRUE(s.append(LOG_ENTRY_TYPE_OBJ, dataBuffer, &ref));
+
+    // The result must be identical to appending the flattened entry.
+    EXPECT_EQ(s.segletBlocks[0], reinterpret_cast<const void*>(ref.reference));
+    SegmentCertificate certificate;
+    EXPECT_EQ(4U, s.getAppendedLength(&certificate));
+    EXPECT_EQ(0x87a632e2u, certificate.checksum);
+
+    Buffer buffer;
+    s.appendToBuffer(buffer);
+    EXPECT_EQ(0, memcmp("hi", buffer.getRange(2, 2), 2));
+}
+
 TEST_P(SegmentTest, append_fullLogEntry) {
     SegmentAndAllocator segAndAlloc(GetParam());
     Segment& s = *segAndAlloc.segment;
@@ -261,6 +283,16 @@ TEST_F(SegmentTest, appendLogHeader) {
     }
 }
 
+TEST_F(SegmentTest, getEntryHeaderLength) {
+    EXPECT_EQ(2U, Segment::getEntryHeaderLength(LOG_ENTRY_TYPE_OBJ, 0));
+    EXPECT_EQ(2U, Segment::getEntryHeaderLength(LOG_ENTRY_TYPE_OBJ, 255));
+    EXPECT_EQ(3U, Segment::getEntryHeaderLength(LOG_ENTRY_TYPE_OBJ, 256));
+    EXPECT_EQ(4U, Segment::getEntryHeaderLength(LOG_ENTRY_TYPE_OBJTOMB,
+            65536));
+    EXPECT_EQ(5U, Segment::getEntryHeaderLength(LOG_ENTRY_TYPE_OBJ,
+            0x01000000));
+}
+
 TEST_P(SegmentTest, close) {
     SegmentAndAllocator segAndAlloc(GetParam());
     Segment& s = *segAndAlloc.segment;
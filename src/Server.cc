@@ -16,6 +16,7 @@
 #include "BindTransport.h"
 #include "Server.h"
 #include "ShortMacros.h"
+#include "ThreadPlacement.h"
 #include "WorkerManager.h"
 
 namespace RAMCloud {
@@ -44,10 +45,18 @@ Server::Server(Context* context, const ServerConfig* config)
     , membership()
     , ping()
     , enlistTimer()
+    , dispatchThreads()
 {
     context->coordinatorSession->setLocation(
             config->coordinatorLocator.c_str(), config->clusterName.c_str());
-    context->workerManager = new WorkerManager(context, config->maxCores-1);
+    ThreadPlacement::configure(config->threadPlacement, config->maxCores-1);
+    context->workerManager = new WorkerManager(context, config->maxCores-1,
+                                              config->workerShards,
+                                              config->inlineShortRpcs,
+                                              (config->minCores > 1)
+                                                  ? config->minCores-1 : 0,
+                                              config->maxBlockedWorkers);
+    context->dispatch->setIdleSleepMicros(config->dispatchIdleMicros);
 }
 
 /**
@@ -58,6 +67,22 @@ Server::~Server()
     delete serverList;
 }
 
+/**
+ * Have an additional dispatch thread poll some of this server's transports
+ * once it runs; the thread is started by #run, after the services have been
+ * created.
+ *
+ * \param thread
+ *      A DispatchThread for this server's context whose transports have
+ *      already been created (see DispatchThread::listen). The Server takes
+ *      ownership of it.
+ */
+void
+Server::addDispatchThread(DispatchThread* thread)
+{
+    dispatchThreads.emplace_back(thread);
+}
+
 /**
  * Create services according to #config, enlist with the coordinator and
  * then return. This method should almost exclusively be used by MockCluster
@@ -87,6 +112,8 @@ Server::run()
     LOG(NOTICE, "Starting services");
     ServerId formerServerId = createAndRegisterServices();
     LOG(NOTICE, "Services started");
+    foreach (auto& thread, dispatchThreads)
+        thread->start();
 
     // Only pin down memory _after_ users of LargeBlockOfMemory have
     // obtained their allocations (since LBOM probes are much slower if
@@ -114,6 +141,9 @@ Server::run()
     // servicing requests.
     enlistTimer.construct(this, formerServerId);
 
+    // Only move this thread once the services have started their threads,
+    // since they would otherwise have inherited the dispatch core.
+    ThreadPlacement::place(ThreadPlacement::DISPATCH);
     dispatch.run();
 }
 
@@ -160,6 +190,11 @@ Server::createAndRegisterServices()
         LOG(NOTICE, "Backup service started");
     }
 
+    // A master restarted from a restart snapshot takes over for the master
+    // that saved it (unless its backup found replicas of some other server).
+    if (master && !formerServerId.isValid())
+        formerServerId = master->getRestartSnapshotServerId();
+
     if (config.services.has(WireFormat::MEMBERSHIP_SERVICE)) {
         membership.construct(context,
                              static_cast<ServerList*>(context->serverList),
@@ -195,12 +230,15 @@ Server::enlist(ServerId replacingId)
     // service rpcs after enlisting with the coordinator (which can
     // lead to session open timeouts).
     LOG(NOTICE, "Enlisting with cooordinator");
+    bool fromSnapshot = master && replacingId.isValid() &&
+            (master->getRestartSnapshotServerId() == replacingId);
     serverId = CoordinatorClient::enlistServer(context,
                                                config.preferredIndex,
                                                replacingId,
                                                config.services,
                                                config.localLocator,
-                                               backupReadSpeed);
+                                               backupReadSpeed,
+                                               fromSnapshot);
     LOG(NOTICE, "Enlisted; serverId %s", serverId.toString().c_str());
 
     // Finish PingService initialization first, so that the getServerId
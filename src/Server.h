@@ -19,6 +19,7 @@
 #include "BackupService.h"
 #include "CoordinatorClient.h"
 #include "CoordinatorSession.h"
+#include "DispatchThread.h"
 #include "FailureDetector.h"
 #include "MasterService.h"
 #include "MembershipService.h"
@@ -46,6 +47,7 @@ class Server {
     explicit Server(Context* context, const ServerConfig* config);
     ~Server();
 
+    void addDispatchThread(DispatchThread* thread);
     void startForTesting(BindTransport& bindTransport);
     void run();
 
@@ -138,6 +140,13 @@ class Server {
     };
     Tub<EnlistTimer> enlistTimer;
 
+    /**
+     * Additional dispatch threads polling some of this server's transports
+     * (see addDispatchThread). Declared last, so that the threads stop
+     * before the services they pass RPCs to are destroyed.
+     */
+    std::vector<std::unique_ptr<DispatchThread>> dispatchThreads;
+
     DISALLOW_COPY_AND_ASSIGN(Server);
 };
 
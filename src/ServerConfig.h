@@ -64,6 +64,13 @@ struct ServerConfig {
         , maxObjectDataSize(segmentSize / 4)
         , maxObjectKeySize((64 * 1024) - 1)
         , maxCores(2)
+        , minCores(0)
+        , maxBlockedWorkers(0)
+        , workerShards(0)
+        , inlineShortRpcs(false)
+        , dispatchIdleMicros(0)
+        , dispatchThreads(1)
+        , threadPlacement()
         , master(testing)
         , backup(testing)
     {}
@@ -88,6 +95,13 @@ struct ServerConfig {
         , maxObjectDataSize(segmentSize / 8)
         , maxObjectKeySize((64 * 1024) - 1)
         , maxCores(2)
+        , minCores(0)
+        , maxBlockedWorkers(0)
+        , workerShards(0)
+        , inlineShortRpcs(false)
+        , dispatchIdleMicros(0)
+        , dispatchThreads(1)
+        , threadPlacement()
         , master()
         , backup()
     {}
@@ -137,6 +151,13 @@ struct ServerConfig {
         config.set_max_object_data_size(maxObjectDataSize);
         config.set_max_object_key_size(maxObjectKeySize);
         config.set_max_cores(maxCores);
+        config.set_min_cores(minCores);
+        config.set_max_blocked_workers(maxBlockedWorkers);
+        config.set_worker_shards(workerShards);
+        config.set_inline_short_rpcs(inlineShortRpcs);
+        config.set_dispatch_idle_micros(dispatchIdleMicros);
+        config.set_dispatch_threads(dispatchThreads);
+        config.set_thread_placement(threadPlacement);
 
         if (services.has(WireFormat::MASTER_SERVICE))
             master.serialize(*config.mutable_master());
@@ -217,6 +238,62 @@ struct ServerConfig {
      */
     uint32_t maxCores;
 
+    /**
+     * If nonzero, the server starts out using this many cores for the
+     * dispatch and worker threads, and uses more (up to #maxCores) only
+     * while RPCs are waiting for workers, giving them back once they are
+     * unused (see WorkerManager). 0 means the server always uses up to
+     * #maxCores.
+     */
+    uint32_t minCores;
+
+    /**
+     * Up to this many worker threads that are waiting (for example for
+     * replication or for RPCs to other servers) don't count towards
+     * #maxCores, so other requests can run on their cores in the meantime
+     * (see WorkerManager::BlockingWait). This many extra worker threads are
+     * created. 0 means waiting workers count like any others.
+     */
+    uint32_t maxBlockedWorkers;
+
+    /**
+     * If nonzero, the key hash space is partitioned into this many shards,
+     * each with a dedicated worker thread that executes all reads, writes,
+     * and removes for keys in its shard (see WorkerManager). These threads
+     * are in addition to those allowed by #maxCores.
+     */
+    uint32_t workerShards;
+
+    /**
+     * If true, short non-blocking requests such as READs (see
+     * WireFormat::isShortRpc) are executed directly in the dispatch thread
+     * instead of being handed off to a worker thread.
+     */
+    bool inlineShortRpcs;
+
+    /**
+     * If nonzero, the dispatch thread stops busy-polling after finding no
+     * work for this many microseconds, and sleeps between polls until work
+     * arrives again (see Dispatch::setIdleSleepMicros). 0 means always
+     * busy-poll.
+     */
+    uint32_t dispatchIdleMicros;
+
+    /**
+     * Number of threads that poll the server's listening transports; the
+     * listening locators are divided among them (see DispatchThread). 1
+     * means the main dispatch thread polls them all.
+     */
+    uint32_t dispatchThreads;
+
+    /**
+     * Which CPUs the dispatch, worker and cleaner threads run on (see
+     * ThreadPlacement::configure): empty for wherever the kernel puts them,
+     * "auto" to choose from the machine's topology, or explicit CPU lists
+     * by role, such as "dispatch=0 workers=2-7 cleaner=10-15".
+     */
+    string threadPlacement;
+
     /**
      * Configuration details specific to the MasterService on a server,
      * if any.  If !config.has(MASTER_SERVICE) then this field is ignored.
@@ -229,15 +306,40 @@ struct ServerConfig {
         Master(Testing) // NOLINT
             : logBytes(40 * 1024 * 1024)
             , hashTableBytes(1 * 1024 * 1024)
+            , hashTableMaxBytes(0)
             , disableLogCleaner(true)
             , disableInMemoryCleaning(true)
             , diskExpansionFactor(1.0)
             , cleanerBalancer("tombstoneRatio:0.40")
             , cleanerWriteCostThreshold(0)
             , cleanerThreadCount(1)
+            , cleanerPassThreads(1)
+            , cleanerThrottlePercent(0)
             , numReplicas(0)
             , useMinCopysets(false)
             , allowLocalBackup(false)
+            , relayReplication(false)
+            , compressReplication(false)
+            , loadAwareReplication(false)
+            , syncBatchMicros(0)
+            , tabletLoadReportInterval(0)
+            , readReplicaSyncMs(0)
+            , changeStreamBytes(0)
+            , trustClientKeyHashes(false)
+            , writeBackpressurePercent(0)
+            , combineIncrements(false)
+            , recoveryReplayThreads(1)
+            , recoveryVerifyThreads(0)
+            , trustBackupChecksums(false)
+            , lockTableSize(1000)
+            , snapshotVersions(0)
+            , snapshotRetentionMs(1000)
+            , deferWriteReplies(false)
+            , hugePagePath()
+            , logMemoryNode(-1)
+            , flashTierPath()
+            , flashTierBytes(0)
+            , restartSnapshotPath()
         {}
 
         /**
@@ -248,15 +350,40 @@ struct ServerConfig {
         Master()
             : logBytes()
             , hashTableBytes()
+            , hashTableMaxBytes()
             , disableLogCleaner()
             , disableInMemoryCleaning()
             , diskExpansionFactor()
             , cleanerBalancer()
             , cleanerWriteCostThreshold()
             , cleanerThreadCount()
+            , cleanerPassThreads()
+            , cleanerThrottlePercent()
             , numReplicas()
             , useMinCopysets()
             , allowLocalBackup()
+            , relayReplication()
+            , compressReplication()
+            , loadAwareReplication()
+            , syncBatchMicros()
+            , tabletLoadReportInterval()
+            , readReplicaSyncMs()
+            , changeStreamBytes()
+            , trustClientKeyHashes()
+            , writeBackpressurePercent()
+            , combineIncrements()
+            , recoveryReplayThreads()
+            , recoveryVerifyThreads()
+            , trustBackupChecksums()
+            , lockTableSize()
+            , snapshotVersions()
+            , snapshotRetentionMs()
+            , deferWriteReplies()
+            , hugePagePath()
+            , logMemoryNode(-1)
+            , flashTierPath()
+            , flashTierBytes(0)
+            , restartSnapshotPath()
         {}
 
         /**
@@ -267,15 +394,40 @@ struct ServerConfig {
         {
             config.set_log_bytes(logBytes);
             config.set_hash_table_bytes(hashTableBytes);
+            config.set_hash_table_max_bytes(hashTableMaxBytes);
             config.set_disable_log_cleaner(disableLogCleaner);
             config.set_disable_in_memory_cleaning(disableInMemoryCleaning);
             config.set_backup_disk_expansion_factor(diskExpansionFactor);
             config.set_cleaner_balancer(cleanerBalancer);
             config.set_cleaner_write_cost_threshold(cleanerWriteCostThreshold);
             config.set_cleaner_thread_count(cleanerThreadCount);
+            config.set_cleaner_pass_threads(cleanerPassThreads);
+            config.set_cleaner_throttle_percent(cleanerThrottlePercent);
             config.set_num_replicas(numReplicas);
             config.set_use_mincopysets(useMinCopysets);
             config.set_use_local_backup(allowLocalBackup);
+            config.set_relay_replication(relayReplication);
+            config.set_compress_replication(compressReplication);
+            config.set_load_aware_replication(loadAwareReplication);
+            config.set_sync_batch_micros(syncBatchMicros);
+            config.set_tablet_load_report_interval(tabletLoadReportInterval);
+            config.set_read_replica_sync_ms(readReplicaSyncMs);
+            config.set_change_stream_bytes(changeStreamBytes);
+            config.set_trust_client_key_hashes(trustClientKeyHashes);
+            config.set_write_backpressure_percent(writeBackpressurePercent);
+            config.set_combine_increments(combineIncrements);
+            config.set_recovery_replay_threads(recoveryReplayThreads);
+            config.set_recovery_verify_threads(recoveryVerifyThreads);
+            config.set_trust_backup_checksums(trustBackupChecksums);
+            config.set_lock_table_size(lockTableSize);
+            config.set_snapshot_versions(snapshotVersions);
+            config.set_snapshot_retention_ms(snapshotRetentionMs);
+            config.set_defer_write_replies(deferWriteReplies);
+            config.set_huge_page_path(hugePagePath);
+            config.set_log_memory_node(logMemoryNode);
+            config.set_flash_tier_path(flashTierPath);
+            config.set_flash_tier_bytes(flashTierBytes);
+            config.set_restart_snapshot_path(restartSnapshotPath);
         }
 
         /**
@@ -287,15 +439,40 @@ struct ServerConfig {
         {
             logBytes = config.log_bytes();
             hashTableBytes = config.hash_table_bytes();
+            hashTableMaxBytes = config.hash_table_max_bytes();
             disableLogCleaner = config.disable_log_cleaner();
             disableInMemoryCleaning = config.disable_in_memory_cleaning();
             diskExpansionFactor = config.backup_disk_expansion_factor();
             cleanerBalancer = config.cleaner_balancer();
             cleanerWriteCostThreshold = config.cleaner_write_cost_threshold();
             cleanerThreadCount = config.cleaner_thread_count();
+            cleanerPassThreads = config.cleaner_pass_threads();
+            cleanerThrottlePercent = config.cleaner_throttle_percent();
             numReplicas = config.num_replicas();
             useMinCopysets = config.use_mincopysets();
             allowLocalBackup = config.use_local_backup();
+            relayReplication = config.relay_replication();
+            compressReplication = config.compress_replication();
+            loadAwareReplication = config.load_aware_replication();
+            syncBatchMicros = config.sync_batch_micros();
+            tabletLoadReportInterval = config.tablet_load_report_interval();
+            readReplicaSyncMs = config.read_replica_sync_ms();
+            changeStreamBytes = config.change_stream_bytes();
+            trustClientKeyHashes = config.trust_client_key_hashes();
+            writeBackpressurePercent = config.write_backpressure_percent();
+            combineIncrements = config.combine_increments();
+            recoveryReplayThreads = config.recovery_replay_threads();
+            recoveryVerifyThreads = config.recovery_verify_threads();
+            trustBackupChecksums = config.trust_backup_checksums();
+            lockTableSize = config.lock_table_size();
+            snapshotVersions = config.snapshot_versions();
+            snapshotRetentionMs = config.snapshot_retention_ms();
+            deferWriteReplies = config.defer_write_replies();
+            hugePagePath = config.huge_page_path();
+            logMemoryNode = config.log_memory_node();
+            flashTierPath = config.flash_tier_path();
+            flashTierBytes = config.flash_tier_bytes();
+            restartSnapshotPath = config.restart_snapshot_path();
         }
 
         /// Total number bytes to use for the in-memory Log.
@@ -304,6 +481,12 @@ struct ServerConfig {
         /// Total number of bytes to use for the HashTable.
         uint64_t hashTableBytes;
 
+        /// The HashTable may grow online, as it fills, up to this many bytes
+        /// (not counting overflow cache lines). Memory for growth is
+        /// allocated in addition to #logBytes and #hashTableBytes. If no
+        /// larger than #hashTableBytes, the HashTable never grows.
+        uint64_t hashTableMaxBytes;
+
         /// If true, disable the log cleaner entirely.
         bool disableLogCleaner;
 
@@ -330,6 +513,17 @@ struct ServerConfig {
         /// at the expense of CPU cycles.
         uint32_t cleanerThreadCount;
 
+        /// Maximum number of threads that relocate live entries within a
+        /// single disk cleaning pass. Each cleaner thread may use up to this
+        /// many; 1 means every pass is relocated serially.
+        uint32_t cleanerPassThreads;
+
+        /// While clients keep the server busy and free memory is well above
+        /// the reserves, cleaner threads pause after each task for up to
+        /// this percentage of their time (see LogCleaner::getThrottle); 0
+        /// means the cleaner always runs at full speed.
+        uint32_t cleanerThrottlePercent;
+
         /// Number of replicas to keep per segment stored on backups.
         uint32_t numReplicas;
 
@@ -339,6 +533,120 @@ struct ServerConfig {
 
         /// If true, allow replication to local backup.
         bool allowLocalBackup;
+
+        /// If true, send each replication write only to the backup holding
+        /// the primary replica, which relays it to the other replicas'
+        /// backups; cuts the master's replication egress by a factor of
+        /// numReplicas.
+        bool relayReplication;
+
+        /// If true, compress the data in replication writes to backups,
+        /// which decompress it before storing it. Trades master CPU for
+        /// network bandwidth when objects compress well.
+        bool compressReplication;
+
+        /// If true, place replicas on backups that have been quick to
+        /// accept writes lately (see LoadAwareBackupSelector). Ignored if
+        /// useMinCopysets is set.
+        bool loadAwareReplication;
+
+        /// How long (in microseconds) the thread that leads a Log::sync
+        /// waits before replicating, so that appends from other writers can
+        /// join the same batch. Zero means replicate immediately.
+        uint32_t syncBatchMicros;
+
+        /// How often (in seconds) the master reports the read and write
+        /// activity on its tablets to the coordinator, which uses it to
+        /// balance load across recovery masters if this master crashes.
+        /// Zero disables reporting.
+        uint32_t tabletLoadReportInterval;
+
+        /// How often (in milliseconds) the master sends the read replicas
+        /// of its tablets the data written since their last update (see
+        /// MasterService::ReadReplicaFeeder); reads from replicas may be
+        /// about this stale. Zero means replicas are never updated.
+        uint32_t readReplicaSyncMs;
+
+        /// Size, in bytes, of the master's stream of recent changes to the
+        /// tables replicated to another cluster (see ChangeStream); a
+        /// receiver that falls further behind than this must start over.
+        /// Zero disables change streams.
+        uint32_t changeStreamBytes;
+
+        /// If true, reads and removes use the key hash their client computed
+        /// to find the master, rather than hashing the key again. Only safe
+        /// when every client is trusted to send correct hashes: an object
+        /// accessed with a wrong one can't be found.
+        bool trustClientKeyHashes;
+
+        /// Once this percentage of the log's memory is in use, the master
+        /// starts turning away writes, more of them the fuller the log gets,
+        /// and asks their clients to retry later (see
+        /// MasterService::getWriteBackpressure). 0 disables backpressure.
+        uint32_t writeBackpressurePercent;
+
+        /// If true, increments of an object that arrive while another
+        /// increment of it is being applied are applied together, in a
+        /// single write (see MasterService::combineIncrement).
+        bool combineIncrements;
+
+        /// Number of threads that replay each recovery segment on a recovery
+        /// master, each handling the objects in its own range of hash table
+        /// buckets. 1 replays on the recovery thread alone.
+        uint32_t recoveryReplayThreads;
+
+        /// Number of helper threads that check the checksums of the entries
+        /// in each recovery segment while it is being replayed, each taking
+        /// its own chunks of the segment. 0 leaves the checks to the replay
+        /// threads.
+        uint32_t recoveryVerifyThreads;
+
+        /// If true, the entries in recovery segments whose backups already
+        /// checked their checksums (see Backup::verifyRecoveryChecksums)
+        /// aren't checked again during replay. The segment certificate is
+        /// still checked.
+        bool trustBackupChecksums;
+
+        /// Number of transaction locks the master's LockTable holds without
+        /// chaining overflow cache lines; should exceed the number of
+        /// objects that are prepared at once.
+        uint32_t lockTableSize;
+
+        /// The most older versions of each object the master keeps for
+        /// snapshot reads (see VersionHistory). 0 disables snapshot reads.
+        uint32_t snapshotVersions;
+
+        /// How far back in cluster time (in milliseconds) snapshot reads
+        /// may go; older versions are collected once they're needed only
+        /// by snapshots before this.
+        uint32_t snapshotRetentionMs;
+
+        /// If true, workers don't wait for writes to be replicated; the
+        /// dispatch thread returns each write's reply once the write is
+        /// durable (see MasterService::DurabilityQueue).
+        bool deferWriteReplies;
+
+        /// If non-empty, the log's memory is allocated from a file in this
+        /// directory, which must be a hugetlbfs mount with 1GB pages (see
+        /// SegletAllocator::allocateBlock).
+        string hugePagePath;
+
+        /// If not negative, the log's memory is allocated only from this NUMA
+        /// node.
+        int logMemoryNode;
+
+        /// If non-empty and #flashTierBytes is non-zero, the cleaner may move
+        /// cold data out of memory into a file in this directory, which
+        /// should be on local flash (see SegletAllocator::FLASH).
+        string flashTierPath;
+
+        /// Size of the flash tier in bytes; 0 means there is none.
+        uint64_t flashTierBytes;
+
+        /// If non-empty, the file in which the master saves its log before
+        /// a planned shutdown and from which it recovers its data when it
+        /// is restarted (see MasterSnapshot).
+        string restartSnapshotPath;
     } master;
 
     /**
@@ -353,6 +661,7 @@ struct ServerConfig {
         Backup(Testing) // NOLINT
             : gc(false)
             , inMemory(true)
+            , persistentMemory(false)
             , sync(false)
             , numSegmentFrames(4)
             , maxNonVolatileBuffers(0)
@@ -360,6 +669,9 @@ struct ServerConfig {
             , strategy(1)
             , mockSpeed(100)
             , writeRateLimit(0)
+            , recoveryBuilderThreads(0)
+            , mapReplicaLoads(false)
+            , verifyRecoveryChecksums(false)
         {}
 
         /**
@@ -370,6 +682,7 @@ struct ServerConfig {
         Backup()
             : gc(true)
             , inMemory(false)
+            , persistentMemory(false)
             , sync(false)
             , numSegmentFrames(512)
             , maxNonVolatileBuffers(0)
@@ -377,6 +690,9 @@ struct ServerConfig {
             , strategy(1)
             , mockSpeed(0)
             , writeRateLimit(0)
+            , recoveryBuilderThreads(0)
+            , mapReplicaLoads(false)
+            , verifyRecoveryChecksums(false)
         {}
 
         /**
@@ -387,6 +703,7 @@ struct ServerConfig {
         {
             config.set_gc(gc);
             config.set_in_memory(inMemory);
+            config.set_persistent_memory(persistentMemory);
             config.set_num_segment_frames(numSegmentFrames);
             config.set_max_non_volatile_buffers(maxNonVolatileBuffers);
             if (!inMemory)
@@ -394,6 +711,9 @@ struct ServerConfig {
             config.set_strategy(strategy);
             config.set_mock_speed(mockSpeed);
             config.set_write_rate_limit(writeRateLimit);
+            config.set_recovery_builder_threads(recoveryBuilderThreads);
+            config.set_map_replica_loads(mapReplicaLoads);
+            config.set_verify_recovery_checksums(verifyRecoveryChecksums);
         }
 
         /**
@@ -405,6 +725,7 @@ struct ServerConfig {
         {
             gc = config.gc();
             inMemory = config.in_memory();
+            persistentMemory = config.persistent_memory();
             numSegmentFrames = config.num_segment_frames();
             maxNonVolatileBuffers = config.max_non_volatile_buffers();
             if (!inMemory)
@@ -412,6 +733,9 @@ struct ServerConfig {
             strategy = config.strategy();
             mockSpeed = config.mock_speed();
             writeRateLimit = config.write_rate_limit();
+            recoveryBuilderThreads = config.recovery_builder_threads();
+            mapReplicaLoads = config.map_replica_loads();
+            verifyRecoveryChecksums = config.verify_recovery_checksums();
         }
 
         /**
@@ -425,6 +749,12 @@ struct ServerConfig {
         /// Whether the BackupService should store replicas in RAM or on disk.
         bool inMemory;
 
+        /**
+         * If true (and inMemory is false), #file is on a DAX filesystem and
+         * replicas are stored in it as persistent memory (see PmemStorage).
+         */
+        bool persistentMemory;
+
         /**
          * If true backups block until data from calls to writeSegment have
          * been written to storage. Setting this to false is only safe if
@@ -470,6 +800,26 @@ struct ServerConfig {
          * If non-0, limit writes to backup to this many megabytes per second.
          */
         size_t writeRateLimit;
+
+        /**
+         * Number of threads used to build recovery segments from primary
+         * replicas in parallel during a master recovery. If 0, they are
+         * built one at a time on the backup's task queue thread.
+         */
+        uint32_t recoveryBuilderThreads;
+
+        /**
+         * Whether replicas on disk are mapped into memory, rather than read
+         * into buffers, when they are loaded for recovery.
+         */
+        bool mapReplicaLoads;
+
+        /**
+         * Whether the checksums of the entries in recovery segments are
+         * checked when the segments are built, so that recovery masters
+         * with Master::trustBackupChecksums set don't have to.
+         */
+        bool verifyRecoveryChecksums;
     } backup;
 
   public:
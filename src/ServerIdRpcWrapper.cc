@@ -156,7 +156,7 @@ ServerIdRpcWrapper::send()
     assert(context->serverList != NULL);
     session = context->serverList->getSession(id);
     state = IN_PROGRESS;
-    session->sendRequest(&request, response, this);
+    sendRequest();
 }
 
 /**
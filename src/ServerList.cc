@@ -182,6 +182,8 @@ ServerList::applyServerList(const ProtoBuf::ServerList& list)
         if (index >= serverList.size())
             serverList.resize(index + 1);
         auto& entry = serverList[index];
+        if (status != ServerStatus::UP)
+            sessionCache.erase(ServerId{server.server_id()});
         if (status == ServerStatus::UP) {
             LOG(NOTICE, "Server %s is up (server list version %lu)",
                     ServerId{server.server_id()}.toString().c_str(),
@@ -261,6 +263,7 @@ ServerList::testingCrashed(ServerId serverId)
 {
     auto& entry = serverList.at(serverId.indexNumber());
     entry->status = ServerStatus::CRASHED;
+    sessionCache.erase(serverId);
     foreach (ServerTrackerInterface* tracker, trackers)
         tracker->enqueueChange(*entry, ServerChangeEvent::SERVER_CRASHED);
 }
@@ -280,6 +283,7 @@ ServerList::testingRemove(ServerId serverId)
 {
     auto& entry = serverList.at(serverId.indexNumber());
     entry->status = ServerStatus::REMOVE;
+    sessionCache.erase(serverId);
     foreach (ServerTrackerInterface* tracker, trackers)
         tracker->enqueueChange(*entry, ServerChangeEvent::SERVER_REMOVED);
     entry.destroy();
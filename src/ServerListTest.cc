@@ -171,4 +171,23 @@ TEST_F(ServerListTest, applyServerList_success) {
     tr.changes.pop();
 }
 
+TEST_F(ServerListTest, applyServerList_flushesCachedSessions) {
+    sl.testingAdd({{1, 0}, "mock:host=one", {}, 100, ServerStatus::UP});
+    sl.testingAdd({{2, 0}, "mock:host=two", {}, 100, ServerStatus::UP});
+    sl.sessionCache.insert({1, 0}, new Transport::Session());
+    sl.sessionCache.insert({2, 0}, new Transport::Session());
+
+    ProtoBuf::ServerList update;
+    ServerListBuilder{update}
+        ({}, *ServerId{1, 0}, "mock:host=one", 101, 1, ServerStatus::CRASHED);
+    update.set_version_number(1);
+    update.set_type(ProtoBuf::ServerList_Type_UPDATE);
+    sl.applyServerList(update);
+    EXPECT_TRUE(sl.sessionCache.find({1, 0}) == NULL);
+    EXPECT_TRUE(sl.sessionCache.find({2, 0}) != NULL);
+
+    sl.testingCrashed({2, 0});
+    EXPECT_TRUE(sl.sessionCache.find({2, 0}) == NULL);
+}
+
 }  // namespace RAMCloud
@@ -20,15 +20,20 @@
 
 #include "Context.h"
 #include "CoordinatorSession.h"
+#include "DispatchThread.h"
 #if INFINIBAND
 #include "InfRcTransport.h"
 #endif
 #include "MemoryMonitor.h"
+#include "MetricsStreamer.h"
 #include "OptionParser.h"
+#include "PerfEvents.h"
 #include "PortAlarm.h"
 #include "Server.h"
 #include "PerfStats.h"
 #include "ShortMacros.h"
+#include "SpinLock.h"
+#include "TraceStreamer.h"
 #include "TransportManager.h"
 #include "WorkerTimer.h"
 
@@ -100,9 +105,16 @@ main(int argc, char *argv[])
     try {
         ServerConfig config = ServerConfig::forExecution();
         string masterTotalMemory, hashTableMemory;
+        uint64_t maxHashTableMemory;
+        uint64_t flashTierMemory;
 
         bool masterOnly;
         bool backupOnly;
+        string traceStream;
+        string metricsStream;
+        uint32_t metricsWindowSeconds;
+        uint32_t spinLockProfiling;
+        bool hardwareCounters;
 
         OptionsDescription serverOptions("Server");
         serverOptions.add_options()
@@ -112,6 +124,11 @@ main(int argc, char *argv[])
             ("backupInMemory,m",
              ProgramOptions::bool_switch(&config.backup.inMemory),
              "Backup will store segment replicas in memory")
+            ("backupPmem",
+             ProgramOptions::bool_switch(&config.backup.persistentMemory),
+             "Backup will store segment replicas in persistent memory, "
+             "mapped from the file given by --file (which should be on a "
+             "DAX filesystem)")
             ("backupOnly,B",
              ProgramOptions::bool_switch(&backupOnly),
              "The server should run the backup service only (no master)")
@@ -127,15 +144,43 @@ main(int argc, char *argv[])
              "of bandwidth this backup should use. Useful for artificially "
              "restricting bandwidth when measuring various parts of the "
              "system.")
+            ("changeStreamBytes",
+             ProgramOptions::value<uint32_t>(
+                &config.master.changeStreamBytes)->default_value(64 << 20),
+             "Number of bytes of recent changes the master keeps for the "
+             "tables whose changes are streamed to another cluster (see "
+             "ChangeStreamReceiver). A receiver that falls further behind "
+             "than this must copy the tables again. 0 disables change "
+             "streams.")
             ("cleanerBalancer",
              ProgramOptions::value<string>(&config.master.cleanerBalancer)->
                 default_value("tombstoneRatio:0.40"),
              "Which balancing algorithm to use to schedule cleaning on disk "
              "and in-memory compaction, as well as how to orchestrate multiple "
              "cleaner threads. You will almost certainly want to use the "
-             "default value. Currently the only other option is \"fixed:X\", "
-             "where 0 <= X <= 100 represents the percentage of CPU time the "
-             "disk cleaner will be limited to (the rest is for compaction).")
+             "default value. The other options are \"fixed:X\", where "
+             "0 <= X <= 100 represents the percentage of CPU time the disk "
+             "cleaner will be limited to (the rest is for compaction), and "
+             "\"adaptive:S\", which starts cleaning (and adds cleaner threads) "
+             "once the free memory would last fewer than S seconds at the "
+             "current write rate.")
+            ("combineIncrements",
+             ProgramOptions::value<bool>(&config.master.combineIncrements)->
+                default_value(true),
+             "Apply increments of an object that arrive while another "
+             "increment of it is in progress together, as a single new "
+             "version, so that popular counters don't write a log entry "
+             "per increment")
+            ("compressReplication",
+             ProgramOptions::bool_switch(&config.master.compressReplication),
+             "Compress the data in replication writes to backups; saves "
+             "backup network bandwidth at some CPU cost when objects "
+             "compress well")
+            ("deferWriteReplies",
+             ProgramOptions::bool_switch(&config.master.deferWriteReplies),
+             "Don't make worker threads wait for writes to be replicated; "
+             "the dispatch thread replies to each write once it is durable. "
+             "Lets a few cores keep many writes outstanding.")
             ("detectFailures",
              ProgramOptions::value<bool>(&config.detectFailures)->
                 default_value(true),
@@ -161,18 +206,73 @@ main(int argc, char *argv[])
             ("file,f",
              ProgramOptions::value<string>(&config.backup.file)->
                 default_value("/var/tmp/backup.log"),
-             "The file path to the backup storage.")
+             "The file path to the backup storage. A comma-separated list of "
+             "paths stripes replicas across several files or devices.")
+            ("flashTierMemory",
+             ProgramOptions::value<uint64_t>(&flashTierMemory)->
+                default_value(0),
+             "Megabytes of local flash (see flashTierPath) to which the log "
+             "cleaner may move cold data when the master's memory is "
+             "nearly full. 0 means all data stays in memory.")
+            ("flashTierPath",
+             ProgramOptions::value<string>(&config.master.flashTierPath)->
+                default_value(""),
+             "Directory on local flash in which the master creates the file "
+             "holding its flash tier (see flashTierMemory).")
             ("hashTableMemory,h",
              ProgramOptions::value<string>(&hashTableMemory)->
                 default_value("10%"),
              "Percentage or megabytes of master memory allocated to "
              "the hash table")
+            ("hugePagePath",
+             ProgramOptions::value<string>(&config.master.hugePagePath)->
+                default_value(""),
+             "If set, a hugetlbfs mount with 1GB pages from which the log's "
+             "memory is allocated. The server refuses to start if the "
+             "memory can't be backed by 1GB pages.")
+            ("loadAwareReplication",
+             ProgramOptions::bool_switch(&config.master.loadAwareReplication),
+             "Place replicas on backups that have been quick to accept "
+             "writes lately, judged by write latency and the backups' "
+             "storage backlogs")
+            ("lockTableSize",
+             ProgramOptions::value<uint32_t>(
+                &config.master.lockTableSize)->default_value(1000),
+             "The number of transaction locks the master can hold before "
+             "its lock table chains overflow cache lines. Should exceed "
+             "the number of objects prepared at once.")
             ("logCleanerThreads",
              ProgramOptions::value<uint32_t>(
                 &config.master.cleanerThreadCount)->default_value(1),
              "The number of cleaner threads controls the amount of parallelism "
              "in the cleaner. More threads will use more cores, but may be "
              "able to better keep up with high write rates.")
+            ("logCleanerPassThreads",
+             ProgramOptions::value<uint32_t>(
+                &config.master.cleanerPassThreads)->default_value(1),
+             "The maximum number of threads that relocate live data within a "
+             "single disk cleaning pass. Values above 1 shorten large "
+             "cleaning passes at the cost of additional cores.")
+            ("logCleanerThrottlePercent",
+             ProgramOptions::value<uint32_t>(
+                &config.master.cleanerThrottlePercent)->default_value(0),
+             "While the server is busy with client requests and has plenty "
+             "of free memory, cleaner threads pause after each pass for up "
+             "to this percentage of their time, returning to full speed as "
+             "free memory approaches the reserves. 0 means the cleaner never "
+             "pauses for load.")
+            ("logMemoryNode",
+             ProgramOptions::value<int>(&config.master.logMemoryNode)->
+                default_value(-1),
+             "If not negative, allocate the log's memory only from this NUMA "
+             "node. Run the server on the same node's cores to keep log "
+             "accesses local.")
+            ("mapReplicaLoads",
+             ProgramOptions::bool_switch(&config.backup.mapReplicaLoads),
+             "Load replicas from disk for recovery by mapping them into "
+             "memory rather than reading them into buffers, so they are "
+             "paged in as recovery segments are built and don't tie up the "
+             "backup's buffer pool.")
             ("masterOnly,M",
              ProgramOptions::bool_switch(&masterOnly),
              "The server should run the master service only (no backup)")
@@ -185,6 +285,40 @@ main(int argc, char *argv[])
              "under this limit, but may occasionally need to exceed it "
              "(e.g., to avoid distributed deadlocks). Th limit does not "
              "include cleaner threads and some other miscellaneous functions.")
+            ("minCores",
+             ProgramOptions::value<uint32_t>(
+                &config.minCores)->default_value(0),
+             "If nonzero (and at least 2), use only this many cores for the "
+             "dispatch and worker threads while the server is lightly "
+             "loaded, adding worker cores up to maxCores while requests are "
+             "waiting for workers and giving them back once they go unused. "
+             "0 means always allow maxCores.")
+            ("threadPlacement",
+             ProgramOptions::value<string>(&config.threadPlacement)->
+                default_value(""),
+             "Which CPUs to run the dispatch, worker and cleaner threads on. "
+             "\"auto\" chooses from the machine's topology: the dispatch "
+             "thread gets its own core on the NIC's socket (name the NIC "
+             "with \"auto:<device>\", such as auto:mlx4_0), workers get one "
+             "hardware thread on each of their own physical cores, and the "
+             "cleaner gets the workers' SMT siblings or other cores. CPUs "
+             "can also be given by role, as in \"dispatch=0 workers=2-7 "
+             "cleaner=10-15\" (this may follow \"auto\" to override it). "
+             "Empty means leave placement to the kernel.")
+            ("maxBlockedWorkers",
+             ProgramOptions::value<uint32_t>(
+                &config.maxBlockedWorkers)->default_value(0),
+             "Number of worker threads that may be waiting (for example for "
+             "log replication or for RPCs to other servers) without counting "
+             "towards maxCores, so that other requests can use their cores "
+             "meanwhile. 0 means waiting workers count towards maxCores.")
+            ("maxHashTableMemory",
+             ProgramOptions::value<uint64_t>(&maxHashTableMemory)->
+                default_value(0),
+             "Megabytes of memory the hash table may grow to, online, as the "
+             "master fills up. This memory is in addition to "
+             "totalMasterMemory. If not larger than hashTableMemory, the hash "
+             "table never grows.")
             ("maxNonVolatileBuffers",
              ProgramOptions::value<uint32_t>(
                &config.backup.maxNonVolatileBuffers)->default_value(10),
@@ -198,17 +332,78 @@ main(int argc, char *argv[])
              "Use this value as the index number for this server's server id, "
              "if that number isn't already in use. Can be used to ensure "
              "a reproducible assignment of server ids.")
+            ("readReplicaSyncMs",
+             ProgramOptions::value<uint32_t>(
+                &config.master.readReplicaSyncMs)->default_value(100),
+             "Number of milliseconds between the master's updates of the "
+             "read replicas of its tablets: reads served by a replica may be "
+             "about this stale. 0 means replicas are never updated.")
+            ("recoveryBuilderThreads",
+             ProgramOptions::value<uint32_t>(
+               &config.backup.recoveryBuilderThreads)->default_value(0),
+             "Number of threads the backup uses to build recovery segments "
+             "from primary replicas in parallel during a master recovery. "
+             "The value 0 builds them one at a time on the backup's task "
+             "queue thread.")
+            ("recoveryReplayThreads",
+             ProgramOptions::value<uint32_t>(
+               &config.master.recoveryReplayThreads)->default_value(1),
+             "Number of threads a recovery master uses to replay each "
+             "recovery segment. Each thread handles the objects in its own "
+             "range of hash table buckets.")
+            ("recoveryVerifyThreads",
+             ProgramOptions::value<uint32_t>(
+               &config.master.recoveryVerifyThreads)->default_value(0),
+             "Number of helper threads a recovery master uses to check the "
+             "checksums of each recovery segment's entries while the segment "
+             "is replayed. The value 0 leaves the checks to the replay "
+             "threads.")
+            ("relayReplication",
+             ProgramOptions::bool_switch(&config.master.relayReplication),
+             "Send each replication write only to the primary replica's "
+             "backup, which relays it to the other replicas' backups")
             ("replicas,r",
              ProgramOptions::value<uint32_t>(&config.master.numReplicas),
              "Number of backup copies to make for each segment")
+            ("restartSnapshotPath",
+             ProgramOptions::value<string>(
+                    &config.master.restartSnapshotPath)->default_value(""),
+             "File on local storage in which the master saves its log when "
+             "asked to before a planned shutdown, and from which it recovers "
+             "its data when restarted, instead of reading it from backups.")
             ("segmentFrames",
              ProgramOptions::value<uint32_t>(&config.backup.numSegmentFrames)->
                 default_value(512),
              "Number of segment frames in backup storage")
+            ("snapshotRetentionMs",
+             ProgramOptions::value<uint32_t>(
+                &config.master.snapshotRetentionMs)->default_value(1000),
+             "How far back in cluster time, in milliseconds, snapshot reads "
+             "may go.")
+            ("snapshotVersions",
+             ProgramOptions::value<uint32_t>(
+                &config.master.snapshotVersions)->default_value(0),
+             "The most older versions of each recently written object the "
+             "master keeps for snapshot reads. The value 0 disables "
+             "snapshot reads.")
             ("sync",
              ProgramOptions::bool_switch(&config.backup.sync),
              "Make all updates completely synchronous all the way down to "
              "stable storage.")
+            ("syncBatchMicros",
+             ProgramOptions::value<uint32_t>(
+                &config.master.syncBatchMicros)->default_value(0),
+             "Number of microseconds a log sync waits before replicating, so "
+             "that concurrent writes can share the same replication RPCs. "
+             "Larger values reduce the number of backup RPCs at the cost of "
+             "write latency.")
+            ("tabletLoadReportInterval",
+             ProgramOptions::value<uint32_t>(
+                &config.master.tabletLoadReportInterval)->default_value(10),
+             "Number of seconds between the master's reports of read and "
+             "write activity on its tablets to the coordinator. If the "
+             "master crashes, recovery uses the last report to spread its "
+             "busiest tablets across recovery masters. 0 disables reports.")
             ("totalMasterMemory,t",
 
              // Note: we have tried changing the default value below to
@@ -221,10 +416,35 @@ main(int argc, char *argv[])
                 default_value("500"),
              "Percentage or megabytes of system memory for master log & "
              "hash table")
+            ("trustBackupChecksums",
+             ProgramOptions::bool_switch(&config.master.trustBackupChecksums),
+             "During recovery, don't check the checksums of entries in "
+             "recovery segments whose backups have already checked them "
+             "(see --verifyRecoveryChecksums). Segment certificates are "
+             "still checked.")
+            ("trustClientKeyHashes",
+             ProgramOptions::bool_switch(&config.master.trustClientKeyHashes),
+             "Use the key hashes clients send with reads and removes instead "
+             "of hashing the keys again. Only for clusters whose clients "
+             "are all trusted: an object accessed with a wrong hash can't "
+             "be found.")
             ("useMinCopysets",
              ProgramOptions::value<bool>(&config.master.useMinCopysets)->
                 default_value(false),
              "Whether to use MinCopysets or random replication")
+            ("verifyRecoveryChecksums",
+             ProgramOptions::bool_switch(
+               &config.backup.verifyRecoveryChecksums),
+             "Check the checksums of the entries in recovery segments when "
+             "the backup builds them. A replica with a corrupt entry fails "
+             "to recover, so masters fetch the segment elsewhere.")
+            ("writeBackpressurePercent",
+             ProgramOptions::value<uint32_t>(
+                &config.master.writeBackpressurePercent)->default_value(96),
+             "Once this percentage of the log's memory is in use, turn away "
+             "a growing fraction of writes with a retry-after hint, so that "
+             "clients slow down gradually while the cleaner catches up "
+             "instead of all failing when memory runs out. 0 disables.")
             ("writeCostThreshold,w",
              ProgramOptions::value<uint32_t>(
                 &config.master.cleanerWriteCostThreshold)->default_value(8),
@@ -233,7 +453,68 @@ main(int argc, char *argv[])
              "this value. Lower values cause the disk cleaner to run more "
              "frequently. Higher values do more in-memory cleaning and "
              "reduce the amount of backup disk bandwidth used during disk "
-             "cleaning.");
+             "cleaning.")
+            ("workerShards",
+             ProgramOptions::value<uint32_t>(
+                &config.workerShards)->default_value(0),
+             "If nonzero, partition the key hash space into this many shards, "
+             "each with a dedicated worker thread that executes all reads, "
+             "writes, and removes for its keys. These threads are in addition "
+             "to those allowed by maxCores. 0 means all requests share one "
+             "pool of worker threads.")
+            ("inlineShortRpcs",
+             ProgramOptions::bool_switch(&config.inlineShortRpcs),
+             "Execute short, non-blocking requests such as reads directly in "
+             "the dispatch thread, rather than handing them off to a worker "
+             "thread. This lowers their latency but delays other network "
+             "processing while they run.")
+            ("dispatchIdleMicros",
+             ProgramOptions::value<uint32_t>(
+                &config.dispatchIdleMicros)->default_value(0),
+             "If nonzero, the dispatch thread stops spinning after finding no "
+             "work for this many microseconds, and sleeps between polls "
+             "until work arrives again. This frees a core on idle servers at "
+             "the cost of extra latency for the first request after an idle "
+             "period. 0 means always spin.")
+            ("dispatchThreads",
+             ProgramOptions::value<uint32_t>(
+                &config.dispatchThreads)->default_value(1),
+             "Number of threads that poll the server's network transports. "
+             "The locators in --local are dealt out among them in turn, so "
+             "to use more than one thread, list several locators (such as "
+             "one per port). Clients spread their sessions over a server's "
+             "locators for the same protocol.")
+            ("traceStream",
+             ProgramOptions::value<string>(&traceStream)->default_value(""),
+             "If nonempty, export time trace events continuously to this "
+             "file, or to a collector if this is a locator such as "
+             "\"udp:host=rc01,port=7000\" (see TraceStreamer). The output "
+             "can be converted for chrome://tracing with "
+             "scripts/timetrace2chrome.py.")
+            ("metricsStream",
+             ProgramOptions::value<string>(&metricsStream)->default_value(""),
+             "If nonempty, report the recent percentiles of RPC, log sync, "
+             "and cleaner pass times once a second as Graphite lines, to "
+             "this file or to a collector if this is a locator such as "
+             "\"udp:host=rc01,port=2003\" (see MetricsStreamer).")
+            ("metricsWindowSeconds",
+             ProgramOptions::value<uint32_t>(
+                &metricsWindowSeconds)->default_value(10),
+             "Number of seconds (at most 30) over which the percentiles "
+             "sent to --metricsStream are computed.")
+            ("spinLockProfiling",
+             ProgramOptions::value<uint32_t>(
+                &spinLockProfiling)->default_value(0),
+             "If nonzero, attribute SpinLock waits to the code that acquired "
+             "each lock, and measure the hold time of one in this many "
+             "acquisitions (see SpinLock::setProfiling). The results are "
+             "part of the server's statistics.")
+            ("hardwareCounters",
+             ProgramOptions::bool_switch(&hardwareCounters),
+             "Count instructions, cycles, last-level cache misses, and branch "
+             "mispredictions with the CPU's performance counters while the "
+             "dispatch, worker, and cleaner threads do useful work (see "
+             "PerfEvents). The results are part of the server's PerfStats.");
 
         OptionParser optionParser(serverOptions, argc, argv);
 
@@ -272,11 +553,19 @@ main(int argc, char *argv[])
 #endif
         context.transportManager->setSessionTimeout(
                 optionParser.options.getSessionTimeout());
-        context.transportManager->initialize(localLocator.c_str());
+        std::vector<string> locators = DispatchThread::splitLocators(
+                localLocator, config.dispatchThreads);
+        context.transportManager->initialize(locators[0].c_str());
         // Transports may augment the local locator somewhat.
         // Make sure the server is aware of that augmented locator.
         config.localLocator =
             context.transportManager->getListeningLocatorsString();
+        std::vector<DispatchThread*> dispatchThreads;
+        for (uint32_t i = 1; i < locators.size(); i++) {
+            dispatchThreads.push_back(new DispatchThread(&context, i));
+            config.localLocator += ";" +
+                    dispatchThreads.back()->listen(locators[i]);
+        }
         LOG(NOTICE, "%s: Listening on %s",
             config.services.toString().c_str(), config.localLocator.c_str());
 
@@ -311,6 +600,8 @@ main(int argc, char *argv[])
         if (!backupOnly) {
             LOG(NOTICE, "Using %u backups", config.master.numReplicas);
             config.setLogAndHashTableSize(masterTotalMemory, hashTableMemory);
+            config.master.hashTableMaxBytes = maxHashTableMemory * 1024 * 1024;
+            config.master.flashTierBytes = flashTierMemory * 1024 * 1024;
         }
 
         // Set PortTimeout and start portTimer
@@ -322,7 +613,16 @@ main(int argc, char *argv[])
         // StatsLogger logger(context.dispatch, 1.0);
         MemoryMonitor monitor(context.dispatch, 1.0, 100);
 
+        if (traceStream.size() > 0)
+            TraceStreamer::start(traceStream);
+        if (metricsStream.size() > 0)
+            MetricsStreamer::start(metricsStream, metricsWindowSeconds);
+        SpinLock::setProfiling(spinLockProfiling);
+        PerfEvents::setEnabled(hardwareCounters);
+
         Server server(&context, &config);
+        foreach (DispatchThread* thread, dispatchThreads)
+            server.addDispatchThread(thread);
         server.run(); // Never returns except for exceptions.
 
         return 0;
@@ -158,7 +158,7 @@ Service::handleRpc(Context* context, Rpc* rpc) {
     try {
         service->dispatch(opcode, rpc);
     } catch (RetryException& e) {
-        if (rpc->worker->replySent()) {
+        if ((rpc->worker != NULL) && rpc->worker->replySent()) {
             DIE("Retry exception thrown after reply sent for %s RPC",
                     WireFormat::opcodeSymbol(opcode));
         } else {
@@ -166,7 +166,7 @@ Service::handleRpc(Context* context, Rpc* rpc) {
                     e.maxDelayMicros, e.message);
         }
     } catch (ClientException& e) {
-        if (rpc->worker->replySent()) {
+        if ((rpc->worker != NULL) && rpc->worker->replySent()) {
             DIE("%s exception thrown after reply sent for %s RPC",
                     statusToSymbol(e.status),
                     WireFormat::opcodeSymbol(opcode));
@@ -270,6 +270,26 @@ Service::setServerId(ServerId assignedServerId)
     initOnceEnlisted();
 }
 
+/**
+ * A worker thread can invoke this method to take the reply to an RPC away
+ * from its worker, so that it can be sent later by someone else (for
+ * example, once the effects of the RPC are durable). See
+ * Worker::deferReply for details.
+ *
+ * \return
+ *      The transport's RPC object, on which the caller must eventually
+ *      invoke sendReply from the dispatch thread. NULL means there is no
+ *      worker (unit tests only); the reply will be sent when the handler
+ *      returns.
+ */
+Transport::ServerRpc*
+Service::Rpc::deferReply()
+{
+    if (worker == NULL)
+        return NULL;
+    return worker->deferReply();
+}
+
 /**
  * A worker thread can invoke this method to start sending a reply to
  * an RPC.  Normally a worker thread does not call this method; when it
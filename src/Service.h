@@ -24,6 +24,7 @@
 #include "ServerId.h"
 #include "WireFormat.h"
 #include "PerfCounter.h"
+#include "Transport.h"
 
 namespace RAMCloud {
 
@@ -60,6 +61,7 @@ class Service {
             , replyPayload(replyPayload)
             , worker(worker) {}
 
+        Transport::ServerRpc* deferReply();
         void sendReply();
 
         /// The incoming request, which describes the desired operation.
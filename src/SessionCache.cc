@@ -0,0 +1,113 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "SessionCache.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct an empty SessionCache.
+ */
+SessionCache::SessionCache()
+    : mutex("SessionCache::mutex")
+    , slots()
+    , epoch(0)
+    , activeReaders()
+{
+}
+
+/**
+ * Destructor for SessionCache. No lookups may be in progress.
+ */
+SessionCache::~SessionCache()
+{
+    for (uint32_t i = 0; i < NUM_SLOTS; i++)
+        delete slots[i].load();
+}
+
+/**
+ * Discard all of the cached sessions.
+ */
+void
+SessionCache::clear()
+{
+    std::lock_guard<SpinLock> lock(mutex);
+    for (uint32_t i = 0; i < NUM_SLOTS; i++)
+        retire(slots[i].exchange(NULL));
+}
+
+/**
+ * Discard the cached session for a server, if there is one.
+ *
+ * \param id
+ *      Identifies the server whose session should no longer be returned
+ *      by #find.
+ */
+void
+SessionCache::erase(ServerId id)
+{
+    std::lock_guard<SpinLock> lock(mutex);
+    Atomic<Entry*>& slot = slots[id.indexNumber() & (NUM_SLOTS - 1)];
+    Entry* entry = slot.load();
+    if ((entry == NULL) || (entry->serverId != id))
+        return;
+    retire(slot.exchange(NULL));
+}
+
+/**
+ * Cache a session for a server, replacing any session cached for it (or
+ * for another server that uses the same slot).
+ *
+ * \param id
+ *      Identifies the server that \a session communicates with.
+ * \param session
+ *      Session to return from future calls to #find for \a id.
+ */
+void
+SessionCache::insert(ServerId id, Transport::SessionRef session)
+{
+    Entry* entry = new Entry(id, session);
+    std::lock_guard<SpinLock> lock(mutex);
+    retire(slots[id.indexNumber() & (NUM_SLOTS - 1)].exchange(entry));
+}
+
+/**
+ * Free an entry that has been removed from #slots, once no lookup can
+ * still be using it. The caller must hold #mutex.
+ *
+ * \param entry
+ *      Entry that is no longer in #slots; may be NULL.
+ */
+void
+SessionCache::retire(Entry* entry)
+{
+    if (entry == NULL)
+        return;
+
+    // A lookup that may have found the entry counted itself in one of the
+    // counters before reading the slot. Advance the epoch so that new
+    // lookups use the other counter and wait for the old one to drain;
+    // doing this twice covers lookups that read the epoch just before it
+    // advanced.
+    for (int i = 0; i < 2; i++) {
+        int previous = epoch.inc();
+        while (activeReaders[previous & 1].load() != 0) {
+            // Lookups finish in a few instructions; just spin.
+        }
+    }
+    delete entry;
+}
+
+} // namespace RAMCloud
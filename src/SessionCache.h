@@ -0,0 +1,116 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_SESSIONCACHE_H
+#define RAMCLOUD_SESSIONCACHE_H
+
+#include "Atomic.h"
+#include "Fence.h"
+#include "ServerId.h"
+#include "SpinLock.h"
+#include "Transport.h"
+
+namespace RAMCloud {
+
+/**
+ * A cache of open sessions, keyed by ServerId, that can be read without
+ * taking locks or parsing service locators. AbstractServerList uses it so
+ * that the sessions for RPCs addressed by ServerId (ServerIdRpcWrapper,
+ * and so backup RPCs from ReplicaManager and server list updates from the
+ * coordinator) are found with a few loads instead of a trip through the
+ * server list's mutex.
+ *
+ * Sessions are held in a direct-mapped table indexed by the server's index
+ * number; a lookup that finds a different server in its slot is simply a
+ * miss. Updates are serialized by a SpinLock and are expected to be rare
+ * (a session is opened or flushed, or a server crashes). A replaced entry
+ * isn't freed until every lookup that might be copying its session has
+ * finished: lookups count themselves in one of two counters, selected by
+ * the parity of an epoch that updates advance, and an update waits for
+ * both counters in turn to drain (as in sleepable RCU).
+ */
+class SessionCache {
+  public:
+    SessionCache();
+    ~SessionCache();
+
+    /**
+     * Return the cached session for a server. This never blocks, and
+     * may be invoked concurrently with itself and with the other methods.
+     *
+     * \param id
+     *      Identifies the desired server.
+     * \return
+     *      The session cached for \a id, or NULL if there is none.
+     */
+    Transport::SessionRef
+    find(ServerId id)
+    {
+        Atomic<int>* readers = &activeReaders[epoch.load() & 1];
+        readers->inc();
+        Transport::SessionRef session;
+        Entry* entry = slots[id.indexNumber() & (NUM_SLOTS - 1)].load();
+        if ((entry != NULL) && (entry->serverId == id))
+            session = entry->session;
+        Fence::leave();
+        readers->add(-1);
+        return session;
+    }
+
+    void clear();
+    void erase(ServerId id);
+    void insert(ServerId id, Transport::SessionRef session);
+
+    /// Number of slots in the table (a power of two).
+    static const uint32_t NUM_SLOTS = 1024;
+
+  PRIVATE:
+    /// A cached session; immutable once published in #slots.
+    struct Entry {
+        Entry(ServerId serverId, Transport::SessionRef session)
+            : serverId(serverId)
+            , session(session)
+        {}
+
+        /// The server that #session communicates with.
+        ServerId serverId;
+
+        /// Open session to #serverId.
+        Transport::SessionRef session;
+    };
+
+    void retire(Entry* entry);
+
+    /// Serializes updates (but not lookups).
+    SpinLock mutex;
+
+    /// Entries indexed by (server index number) % NUM_SLOTS; NULL means
+    /// the slot is empty.
+    Atomic<Entry*> slots[NUM_SLOTS];
+
+    /// Advanced by each update; its low bit selects which of
+    /// #activeReaders new lookups count themselves in.
+    Atomic<int> epoch;
+
+    /// Number of lookups in progress that started under each value of
+    /// (#epoch & 1).
+    Atomic<int> activeReaders[2];
+
+    DISALLOW_COPY_AND_ASSIGN(SessionCache);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_SESSIONCACHE_H
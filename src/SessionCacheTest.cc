@@ -0,0 +1,130 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <unistd.h>
+#include <thread>
+
+#include "TestUtil.h"
+#include "SessionCache.h"
+
+namespace RAMCloud {
+
+class SessionCacheTest : public ::testing::Test {
+  public:
+    SessionCache cache;
+
+    SessionCacheTest()
+        : cache()
+    {
+    }
+
+    /// Return a new session whose service locator is \a locator.
+    Transport::SessionRef
+    newSession(const char* locator)
+    {
+        Transport::SessionRef session(new Transport::Session());
+        session->setServiceLocator(locator);
+        return session;
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(SessionCacheTest);
+};
+
+TEST_F(SessionCacheTest, find) {
+    EXPECT_TRUE(cache.find({1, 0}) == NULL);
+    Transport::SessionRef session = newSession("mock:id=1");
+    cache.insert({1, 0}, session);
+    EXPECT_EQ(session, cache.find({1, 0}));
+
+    // A different generation of the same server index is a miss.
+    EXPECT_TRUE(cache.find({1, 1}) == NULL);
+    EXPECT_TRUE(cache.find({2, 0}) == NULL);
+    EXPECT_EQ(0, cache.activeReaders[0].load());
+    EXPECT_EQ(0, cache.activeReaders[1].load());
+}
+
+TEST_F(SessionCacheTest, insert_replace) {
+    Transport::SessionRef session1 = newSession("mock:id=1");
+    Transport::SessionRef session2 = newSession("mock:id=2");
+    cache.insert({1, 0}, session1);
+    EXPECT_EQ(2, session1->refCount.load());
+    cache.insert({1, 0}, session2);
+    EXPECT_EQ(session2, cache.find({1, 0}));
+    EXPECT_EQ(1, session1->refCount.load());
+
+    // A server whose index maps to the same slot evicts the other.
+    ServerId other(1 + SessionCache::NUM_SLOTS, 0);
+    cache.insert(other, session1);
+    EXPECT_EQ(session1, cache.find(other));
+    EXPECT_TRUE(cache.find({1, 0}) == NULL);
+}
+
+TEST_F(SessionCacheTest, erase) {
+    Transport::SessionRef session = newSession("mock:id=1");
+    cache.insert({1, 0}, session);
+
+    // Erasing a different server in the same slot does nothing.
+    cache.erase({1, 1});
+    cache.erase({1 + SessionCache::NUM_SLOTS, 0});
+    EXPECT_EQ(session, cache.find({1, 0}));
+
+    cache.erase({1, 0});
+    EXPECT_TRUE(cache.find({1, 0}) == NULL);
+    EXPECT_EQ(1, session->refCount.load());
+    cache.erase({1, 0});
+}
+
+TEST_F(SessionCacheTest, clear) {
+    cache.insert({1, 0}, newSession("mock:id=1"));
+    cache.insert({2, 0}, newSession("mock:id=2"));
+    cache.clear();
+    EXPECT_TRUE(cache.find({1, 0}) == NULL);
+    EXPECT_TRUE(cache.find({2, 0}) == NULL);
+}
+
+TEST_F(SessionCacheTest, retire_advancesEpochTwice) {
+    cache.insert({1, 0}, newSession("mock:id=1"));
+    int epoch = cache.epoch.load();
+    cache.erase({1, 0});
+    EXPECT_EQ(epoch + 2, cache.epoch.load());
+
+    // Nothing to retire: the epoch doesn't change.
+    cache.erase({1, 0});
+    EXPECT_EQ(epoch + 2, cache.epoch.load());
+}
+
+static void
+finishLookup(Atomic<int>* readers)
+{
+    usleep(1000);
+    readers->add(-1);
+}
+
+TEST_F(SessionCacheTest, retire_waitsForLookups) {
+    Transport::SessionRef session = newSession("mock:id=1");
+    cache.insert({1, 0}, session);
+
+    // Pretend that a lookup is in progress; the entry can't be freed
+    // until it finishes.
+    Atomic<int>* readers = &cache.activeReaders[cache.epoch.load() & 1];
+    readers->inc();
+    std::thread thread(finishLookup, readers);
+    cache.erase({1, 0});
+    EXPECT_EQ(0, readers->load());
+    EXPECT_EQ(1, session->refCount.load());
+    thread.join();
+}
+
+}  // namespace RAMCloud
@@ -0,0 +1,572 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <atomic>
+
+#include "Common.h"
+#include "ShortMacros.h"
+#include "ShmDriver.h"
+#include "PerfStats.h"
+
+namespace RAMCloud
+{
+
+/**
+ * Construct a ShmDriver, creating its shared memory region.
+ *
+ * \param context
+ *      Overall information about the RAMCloud server or client.
+ * \param localServiceLocator
+ *      "name" option gives the name other drivers on this host use to send
+ *      to this one; it must be unique on the host. If there is no locator
+ *      or it has no name (typical for clients), a name is generated from
+ *      the process id.
+ *
+ * \throw DriverException
+ *      The name is invalid, or the region couldn't be created.
+ */
+ShmDriver::ShmDriver(Context* context,
+                     const ServiceLocator* localServiceLocator)
+    : context(context)
+    , incomingPacketHandler()
+    , poller()
+    , name()
+    , localHost()
+    , ring()
+    , dequeuePosition(0)
+    , slotsLoaned(0)
+    , peers()
+    , senders()
+    , packetBufPool()
+    , packetBufsUtilized(0)
+    , locatorString()
+{
+    char hostName[HOST_NAME_MAX + 1];
+    if (gethostname(hostName, sizeof(hostName)) != 0) {
+        throw DriverException(HERE, "ShmDriver couldn't get host name",
+                errno);
+    }
+    hostName[HOST_NAME_MAX] = '\0';
+    localHost = hostName;
+
+    if ((localServiceLocator != NULL) &&
+            localServiceLocator->hasOption("name")) {
+        name = localServiceLocator->getOption("name");
+    } else {
+        static std::atomic<uint32_t> nextId(0);
+        name = format("client%d.%u", getpid(), nextId++);
+    }
+    if (name.empty() || (name.size() > MAX_NAME_LENGTH) ||
+            (name.find('/') != string::npos)) {
+        throw DriverException(HERE, format("ShmDriver name '%s' is invalid "
+                "(it must have 1-%u characters, none of them '/')",
+                name.c_str(), MAX_NAME_LENGTH));
+    }
+
+    // If a driver with this name existed before (e.g. its process
+    // crashed), mark its region dead, so that drivers that still have it
+    // mapped will map the name again and find ours.
+    string path = regionName(name);
+    Ring stale;
+    if (mapRegion(name, &stale)) {
+        __atomic_store_n(&stale.header->alive, 0, __ATOMIC_RELEASE);
+        unmapRegion(&stale);
+    }
+    shm_unlink(path.c_str());
+
+    int fd = shm_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        throw DriverException(HERE, format("ShmDriver couldn't create "
+                "shared memory region %s", path.c_str()), errno);
+    }
+    size_t size = regionSize(NUM_SLOTS);
+    void* map = MAP_FAILED;
+    if (ftruncate(fd, size) == 0) {
+        map = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, fd, 0);
+    }
+    int savedErrno = errno;
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        shm_unlink(path.c_str());
+        throw DriverException(HERE, format("ShmDriver couldn't map shared "
+                "memory region %s", path.c_str()), savedErrno);
+    }
+
+    ring.header = static_cast<RegionHeader*>(map);
+    ring.slots = reinterpret_cast<Slot*>(ring.header + 1);
+    ring.mask = NUM_SLOTS - 1;
+    ring.mapLength = size;
+    for (uint32_t i = 0; i < NUM_SLOTS; i++) {
+        ring.slots[i].sequence = i;
+    }
+    ring.header->numSlots = NUM_SLOTS;
+    ring.header->enqueuePosition = 0;
+    ring.header->alive = 1;
+
+    // Other drivers don't use the region until they see the magic number.
+    __atomic_store_n(&ring.header->magic, MAGIC, __ATOMIC_RELEASE);
+
+    locatorString = format("basic+shm:host=%s,name=%s", localHost.c_str(),
+            name.c_str());
+    if (localServiceLocator != NULL) {
+        LOG(NOTICE, "ShmDriver locator: %s", locatorString.c_str());
+    }
+}
+
+/**
+ * Destroy the ShmDriver. Its region is removed, so other drivers can no
+ * longer send to it.
+ */
+ShmDriver::~ShmDriver()
+{
+    poller.destroy();
+    releaseDeferred();
+    if ((packetBufsUtilized != 0) || (slotsLoaned != 0))
+        LOG(ERROR, "ShmDriver deleted with %d packets still in use",
+            packetBufsUtilized + slotsLoaned);
+    for (auto it = peers.begin(); it != peers.end(); it++) {
+        unmapRegion(it->second);
+        delete it->second;
+    }
+    for (auto it = senders.begin(); it != senders.end(); it++) {
+        delete it->second;
+    }
+
+    // If a newer driver has taken over our name, the name refers to
+    // its region, which must be left alone.
+    if (__atomic_load_n(&ring.header->alive, __ATOMIC_ACQUIRE) != 0) {
+        __atomic_store_n(&ring.header->alive, 0, __ATOMIC_RELEASE);
+        shm_unlink(regionName(name).c_str());
+    }
+    unmapRegion(&ring);
+}
+
+// See docs in Driver class.
+void
+ShmDriver::connect(IncomingPacketHandler* incomingPacketHandler)
+{
+    this->incomingPacketHandler.reset(incomingPacketHandler);
+    poller.construct(context, this);
+}
+
+// See docs in Driver class.
+void
+ShmDriver::disconnect()
+{
+    poller.destroy();
+    this->incomingPacketHandler.reset();
+}
+
+// See docs in Driver class.
+uint32_t
+ShmDriver::getMaxPacketSize()
+{
+    return MAX_PAYLOAD_SIZE;
+}
+
+// See docs in Driver class.
+void
+ShmDriver::release(char *payload)
+{
+    // Packets released in workers are returned in batches by the dispatch
+    // thread.
+    if (deferRelease(context->dispatch, payload)) {
+        return;
+    }
+    releaseBatch(&payload, 1);
+}
+
+// See docs in Driver class.
+void
+ShmDriver::releaseBatch(char** payloads, uint32_t count)
+{
+    // Must sync with the dispatch thread, since this method could potentially
+    // be invoked in a worker.
+    Dispatch::Lock _(context->dispatch);
+
+    char* slotsStart = reinterpret_cast<char*>(ring.slots);
+    char* slotsEnd = slotsStart + (ring.mask + 1) * sizeof(Slot);
+    for (uint32_t i = 0; i < count; i++) {
+        char* payload = payloads[i];
+        if ((payload >= slotsStart) && (payload < slotsEnd)) {
+            // The packet was passed up in place; its slot can now be reused.
+            slotsLoaned--;
+            freeSlot(reinterpret_cast<Slot*>(payload -
+                    OFFSET_OF(Slot, payload)));
+            continue;
+        }
+
+        // Note: the payload is actually contained in a PacketBuf structure,
+        // which we return to a pool for reuse later.
+        packetBufsUtilized--;
+        assert(packetBufsUtilized >= 0);
+        packetBufPool.destroy(reinterpret_cast<PacketBuf*>(
+                payload - OFFSET_OF(PacketBuf, payload)));
+    }
+}
+
+// See docs in Driver class.
+void
+ShmDriver::sendPacket(const Address *addr,
+                      const void *header,
+                      uint32_t headerLen,
+                      Buffer::Iterator *payload)
+{
+    uint32_t totalLength = headerLen + (payload ? payload->size() : 0);
+    assert(totalLength <= MAX_PAYLOAD_SIZE);
+    const ShmAddress* recipient = static_cast<const ShmAddress*>(addr);
+    Ring* peer = getPeer(recipient->name);
+    if (peer == NULL) {
+        return;
+    }
+    if (!enqueue(peer, name, header, headerLen, payload)) {
+        // The transport will retransmit if necessary.
+        RAMCLOUD_CLOG(NOTICE, "ShmDriver ring for %s is full; dropping "
+                "packet", recipient->name.c_str());
+        return;
+    }
+    PerfStats::threadStats.networkOutputBytes += totalLength;
+}
+
+// See docs in Driver class.
+string
+ShmDriver::getServiceLocator()
+{
+    return locatorString;
+}
+
+/**
+ * Return a new ShmAddress for a service locator.
+ *
+ * \param serviceLocator
+ *      "name" option identifies the driver. "host" option gives the host
+ *      it is on (default: this host).
+ *
+ * \throw DriverException
+ *      The locator refers to a driver on another host, which can't be
+ *      reached through shared memory.
+ * \throw NoSuchKeyException
+ *      The locator has no name option.
+ */
+Driver::Address*
+ShmDriver::newAddress(const ServiceLocator* serviceLocator)
+{
+    const string& host = serviceLocator->getOption("host", localHost);
+    if (host != localHost) {
+        throw DriverException(HERE, format("ShmDriver can't reach %s: it "
+                "is on host %s, not %s",
+                serviceLocator->getOriginalString().c_str(), host.c_str(),
+                localHost.c_str()));
+    }
+    return new ShmAddress(serviceLocator->getOption("name"));
+}
+
+/**
+ * Place a packet in a ring. This is safe to invoke concurrently with
+ * other senders to the same ring, in this process or others.
+ *
+ * \param ring
+ *      Ring of the recipient.
+ * \param sender
+ *      Name of the driver sending the packet.
+ * \param header
+ *      Bytes placed in the packet ahead of those from payload.
+ * \param headerLen
+ *      Number of bytes in header.
+ * \param payload
+ *      The rest of the packet; NULL means there is none.
+ * \return
+ *      False means the ring was full, so the packet wasn't sent.
+ */
+bool
+ShmDriver::enqueue(Ring* ring, const string& sender, const void* header,
+        uint32_t headerLen, Buffer::Iterator* payload)
+{
+    uint64_t* enqueuePosition = &ring->header->enqueuePosition;
+    uint64_t position = __atomic_load_n(enqueuePosition, __ATOMIC_RELAXED);
+    Slot* slot;
+    while (true) {
+        slot = &ring->slots[position & ring->mask];
+        uint64_t sequence = __atomic_load_n(&slot->sequence,
+                __ATOMIC_ACQUIRE);
+        int64_t difference = static_cast<int64_t>(sequence - position);
+        if (difference == 0) {
+            // The slot is free; try to claim it. On failure, position is
+            // updated to the current enqueue position.
+            if (__atomic_compare_exchange_n(enqueuePosition, &position,
+                    position + 1, false, __ATOMIC_RELAXED,
+                    __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (difference < 0) {
+            // The slot still holds a packet from the previous pass around
+            // the ring.
+            return false;
+        } else {
+            // Another sender claimed the slot since we read the position.
+            position = __atomic_load_n(enqueuePosition, __ATOMIC_RELAXED);
+        }
+    }
+
+    char* p = slot->payload;
+    memcpy(p, header, headerLen);
+    p += headerLen;
+    while (payload && !payload->isDone()) {
+        memcpy(p, payload->getData(), payload->getLength());
+        p += payload->getLength();
+        payload->next();
+    }
+    slot->length = downCast<uint32_t>(p - slot->payload);
+    slot->senderLength = downCast<uint32_t>(sender.size());
+    memcpy(slot->sender, sender.data(), sender.size());
+    __atomic_store_n(&slot->sequence, position + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/**
+ * Make a slot in our ring available to senders again.
+ *
+ * \param slot
+ *      A slot whose packet has been received.
+ */
+void
+ShmDriver::freeSlot(Slot* slot)
+{
+    uint64_t position = slot->sequence - 1;
+    __atomic_store_n(&slot->sequence, position + ring.mask + 1,
+            __ATOMIC_RELEASE);
+}
+
+/**
+ * Return the address of the driver that sent a packet.
+ *
+ * \param slot
+ *      Holds the packet.
+ */
+const ShmDriver::ShmAddress*
+ShmDriver::getSender(const Slot* slot)
+{
+    string senderName(slot->sender,
+            std::min(slot->senderLength, MAX_NAME_LENGTH));
+    auto it = senders.find(senderName);
+    if (it != senders.end()) {
+        return it->second;
+    }
+    ShmAddress* address = new ShmAddress(senderName);
+    senders[senderName] = address;
+    return address;
+}
+
+/**
+ * Return the ring of the driver with a given name, mapping its region if
+ * this is the first packet we have sent it (or its name now refers to a
+ * different driver).
+ *
+ * \param name
+ *      Name of the driver.
+ * \return
+ *      The driver's ring, or NULL if there is no such driver on this host
+ *      (a log message will have been generated).
+ */
+ShmDriver::Ring*
+ShmDriver::getPeer(const string& name)
+{
+    if (name == this->name) {
+        return &ring;
+    }
+    auto it = peers.find(name);
+    if (it != peers.end()) {
+        Ring* peer = it->second;
+        if (__atomic_load_n(&peer->header->alive, __ATOMIC_ACQUIRE) != 0) {
+            return peer;
+        }
+
+        // The driver has gone away; its name may now refer to a new one.
+        unmapRegion(peer);
+        delete peer;
+        peers.erase(it);
+    }
+
+    Ring* peer = new Ring;
+    if (!mapRegion(name, peer)) {
+        delete peer;
+        RAMCLOUD_CLOG(NOTICE, "ShmDriver couldn't find driver %s on this "
+                "host; dropping packet", name.c_str());
+        return NULL;
+    }
+    peers[name] = peer;
+    return peer;
+}
+
+/**
+ * Map the region of an existing driver.
+ *
+ * \param name
+ *      Name of the driver.
+ * \param[out] ring
+ *      Filled in with pointers into the mapped region.
+ * \return
+ *      False means there is no such region, or it isn't (yet) a valid one.
+ */
+bool
+ShmDriver::mapRegion(const string& name, Ring* ring)
+{
+    int fd = shm_open(regionName(name).c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat status;
+    void* map = MAP_FAILED;
+    size_t size = 0;
+    if ((fstat(fd, &status) == 0) &&
+            (status.st_size >= static_cast<off_t>(sizeof(RegionHeader)))) {
+        size = static_cast<size_t>(status.st_size);
+        map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+
+    RegionHeader* header = static_cast<RegionHeader*>(map);
+    if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != MAGIC) {
+        munmap(map, size);
+        return false;
+    }
+    uint32_t numSlots = header->numSlots;
+    if ((numSlots == 0) || ((numSlots & (numSlots - 1)) != 0) ||
+            (regionSize(numSlots) != size)) {
+        munmap(map, size);
+        return false;
+    }
+    ring->header = header;
+    ring->slots = reinterpret_cast<Slot*>(header + 1);
+    ring->mask = numSlots - 1;
+    ring->mapLength = size;
+    return true;
+}
+
+/**
+ * Return the name of the shared memory region for a driver.
+ *
+ * \param name
+ *      Name of the driver.
+ */
+string
+ShmDriver::regionName(const string& name)
+{
+    return "/ramcloud-shm-" + name;
+}
+
+/**
+ * Return the number of bytes in a region whose ring has a given number of
+ * slots.
+ */
+size_t
+ShmDriver::regionSize(uint32_t numSlots)
+{
+    return sizeof(RegionHeader) + size_t(numSlots) * sizeof(Slot);
+}
+
+/**
+ * Unmap a region mapped by mapRegion (or the constructor).
+ *
+ * \param ring
+ *      Describes the region; reset to refer to nothing.
+ */
+void
+ShmDriver::unmapRegion(Ring* ring)
+{
+    if (ring->header != NULL) {
+        munmap(ring->header, ring->mapLength);
+    }
+    ring->header = NULL;
+    ring->slots = NULL;
+    ring->mask = 0;
+    ring->mapLength = 0;
+}
+
+/**
+ * Invoked by the dispatcher on every pass through the polling loop: passes
+ * a burst of received packets to the transport.
+ *
+ * \return
+ *      1 if any packets were received, 0 otherwise.
+ */
+int
+ShmDriver::Poller::poll()
+{
+    ShmDriver* d = driver;
+    Ring& ring = d->ring;
+    int result = 0;
+
+    // Return packets that workers finished with first, so their slots are
+    // available to senders again.
+    d->releaseDeferred();
+    for (uint32_t i = 0; i < MAX_RX_BURST; i++) {
+        Slot* slot = &ring.slots[d->dequeuePosition & ring.mask];
+        if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) !=
+                d->dequeuePosition + 1) {
+            break;
+        }
+        d->dequeuePosition++;
+        result = 1;
+        if (slot->length > MAX_PAYLOAD_SIZE) {
+            RAMCLOUD_CLOG(WARNING, "ShmDriver received packet with bad "
+                    "length %u", slot->length);
+            d->freeSlot(slot);
+            continue;
+        }
+
+        Received received;
+        received.len = slot->length;
+        received.sender = d->getSender(slot);
+        received.driver = d;
+        PerfStats::threadStats.networkInputBytes += slot->length;
+        if (d->slotsLoaned < (ring.mask + 1) / 2) {
+            // Normal case: lend the slot to the transport, which can use
+            // the packet in place (and even keep it in a Buffer, see
+            // Driver::PayloadChunk). It comes back through release.
+            d->slotsLoaned++;
+            received.payload = slot->payload;
+        } else {
+            // The transport is holding on to much of the ring (e.g. it
+            // is assembling a long message); copy the packet so that
+            // senders don't run out of slots.
+            PacketBuf* buffer = d->packetBufPool.construct();
+            memcpy(buffer->payload, slot->payload, slot->length);
+            d->freeSlot(slot);
+            d->packetBufsUtilized++;
+            received.payload = buffer->payload;
+        }
+        d->incomingPacketHandler->handlePacket(&received);
+
+        // The handler may have disconnected us, which destroys this
+        // object.
+        if (!d->poller) {
+            break;
+        }
+    }
+    return result;
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,277 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_SHMDRIVER_H
+#define RAMCLOUD_SHMDRIVER_H
+
+#include <unordered_map>
+
+#include "Dispatch.h"
+#include "Driver.h"
+#include "ObjectPool.h"
+#include "ServiceLocator.h"
+#include "Tub.h"
+
+namespace RAMCloud
+{
+
+/**
+ * A Driver for communication between processes on the same host through
+ * shared memory. Each driver owns a receive ring in a POSIX shared memory
+ * region named after the driver; other drivers on the host map the region
+ * and place packets directly into its slots, so a packet is written once
+ * by the sender and read in place by the receiver, without entering the
+ * kernel. The ring is a bounded multi-producer queue, since any number of
+ * processes may send to the same driver; slots are claimed with an atomic
+ * compare-and-swap and published with a per-slot sequence number. Rings
+ * are busy-polled from the dispatch thread, like the other kernel-bypass
+ * drivers.
+ *
+ * Service locators have the form "basic+shm:host=rc01,name=master1". A
+ * driver refuses to create addresses for locators that name another host,
+ * so a server can list a basic+shm locator ahead of its network ones and
+ * clients will use it only if they are on the same host (the
+ * TransportManager falls back to the next locator for everyone else).
+ *
+ * See Driver.h for more detail on the driver interface.
+ */
+class ShmDriver : public Driver
+{
+  public:
+    /// Total size of each ring slot, including its header.
+    static const uint32_t SLOT_SIZE = 8192;
+
+    /// The longest name a driver may have (see the "name" service locator
+    /// option).
+    static const uint32_t MAX_NAME_LENGTH = 48;
+
+    /// The largest packet that fits in a slot.
+    static const uint32_t MAX_PAYLOAD_SIZE = SLOT_SIZE - 64;
+
+    /// Number of slots in each driver's receive ring (must be a power of 2).
+    static const uint32_t NUM_SLOTS = 512;
+
+    /// Maximum number of packets processed by a single call to
+    /// Poller::poll.
+    static const uint32_t MAX_RX_BURST = 32;
+
+    explicit ShmDriver(Context* context,
+                       const ServiceLocator* localServiceLocator = NULL);
+    virtual ~ShmDriver();
+    virtual void connect(IncomingPacketHandler* incomingPacketHandler);
+    virtual void disconnect();
+    virtual uint32_t getMaxPacketSize();
+    virtual void release(char *payload);
+    virtual void releaseBatch(char** payloads, uint32_t count);
+    virtual void sendPacket(const Address *addr,
+                            const void *header,
+                            uint32_t headerLen,
+                            Buffer::Iterator *payload);
+    virtual string getServiceLocator();
+    virtual Address* newAddress(const ServiceLocator* serviceLocator);
+
+    /**
+     * Identifies a ShmDriver on this host by its name.
+     */
+    class ShmAddress : public Address {
+      public:
+        explicit ShmAddress(const string& name)
+            : name(name)
+        {}
+        ShmAddress(const ShmAddress& other)
+            : Address(other)
+            , name(other.name)
+        {}
+        ShmAddress* clone() const
+        {
+            return new ShmAddress(*this);
+        }
+        string toString() const
+        {
+            return name;
+        }
+
+        /// Name of the driver (see the "name" service locator option).
+        const string name;
+
+      private:
+        void operator=(ShmAddress&);
+    };
+
+    /**
+     * Structure to hold an incoming packet that had to be copied out of
+     * its slot (see #poll).
+     */
+    struct PacketBuf {
+        PacketBuf() : payload() {}
+        char payload[MAX_PAYLOAD_SIZE];        /// Packet data (may not fill all
+                                               /// of the allocated space).
+    };
+
+  PRIVATE:
+    /**
+     * Appears at the start of each shared memory region.
+     */
+    struct RegionHeader {
+        /// Always MAGIC once the region has been initialized.
+        uint32_t magic;
+
+        /// Number of slots in the ring (a power of 2).
+        uint32_t numSlots;
+
+        /// Nonzero means the driver that created the region still owns it;
+        /// senders that find it cleared must map the name again, since it
+        /// now refers to a different region.
+        uint32_t alive;
+
+        char pad1[52];
+
+        /// Position at which the next packet will be enqueued; advanced by
+        /// senders with compare-and-swap. It has a cache line to itself,
+        /// since every sender writes it.
+        uint64_t enqueuePosition;
+
+        char pad2[56];
+    };
+
+    /**
+     * One entry in a receive ring.
+     */
+    struct Slot {
+        /// Synchronizes senders with the receiver. A slot at ring position
+        /// p is free if sequence is p and holds a packet if it is p+1; the
+        /// receiver frees it for position p+numSlots by storing that value.
+        uint64_t sequence;
+
+        /// Number of bytes of packet data in payload.
+        uint32_t length;
+
+        /// Number of bytes in sender.
+        uint32_t senderLength;
+
+        /// Name of the driver that sent the packet (not null-terminated).
+        char sender[MAX_NAME_LENGTH];
+
+        char payload[MAX_PAYLOAD_SIZE];
+    };
+    static_assert(sizeof(RegionHeader) == 128,
+            "ShmDriver::RegionHeader must fill two cache lines");
+    static_assert(sizeof(Slot) == SLOT_SIZE,
+            "ShmDriver::Slot must be SLOT_SIZE bytes");
+
+    /**
+     * Describes a receive ring mapped into this process: either our own
+     * or that of a driver we send to.
+     */
+    struct Ring {
+        Ring()
+            : header(NULL)
+            , slots(NULL)
+            , mask(0)
+            , mapLength(0)
+        {}
+
+        /// Start of the mapped region; NULL means not mapped.
+        RegionHeader* header;
+
+        /// The slots, which follow the header.
+        Slot* slots;
+
+        /// Number of slots in the ring, minus one.
+        uint32_t mask;
+
+        /// Number of bytes mapped.
+        size_t mapLength;
+    };
+
+    /**
+     * Polls our ring for incoming packets.
+     */
+    class Poller : public Dispatch::Poller {
+      public:
+        explicit Poller(Context* context, ShmDriver* driver)
+            : Dispatch::Poller(context->dispatch, "ShmDriver::Poller")
+            , driver(driver)
+        {}
+        virtual int poll();
+      private:
+        /// Driver on whose behalf this poller operates.
+        ShmDriver* driver;
+        DISALLOW_COPY_AND_ASSIGN(Poller);
+    };
+
+    static bool enqueue(Ring* ring, const string& sender, const void* header,
+                        uint32_t headerLen, Buffer::Iterator* payload);
+    void freeSlot(Slot* slot);
+    const ShmAddress* getSender(const Slot* slot);
+    Ring* getPeer(const string& name);
+    static bool mapRegion(const string& name, Ring* ring);
+    static string regionName(const string& name);
+    static size_t regionSize(uint32_t numSlots);
+    static void unmapRegion(Ring* ring);
+
+    /// Value of RegionHeader::magic.
+    static const uint32_t MAGIC = 0x53484d31;
+
+    /// Shared RAMCloud information.
+    Context* context;
+
+    /// Handler to invoke whenever packets arrive.
+    std::unique_ptr<IncomingPacketHandler> incomingPacketHandler;
+
+    /// Polls for incoming packets while we are connected.
+    Tub<Poller> poller;
+
+    /// Name of this driver, which other drivers use to send to it.
+    string name;
+
+    /// Host name of this machine; addresses for other hosts are refused.
+    string localHost;
+
+    /// Our receive ring.
+    Ring ring;
+
+    /// Ring position of the next packet we will receive.
+    uint64_t dequeuePosition;
+
+    /// Number of slots in our ring whose packets have been passed to the
+    /// transport in place and not yet released.
+    uint32_t slotsLoaned;
+
+    /// The rings of drivers we have sent to, indexed by name. Used only
+    /// in the dispatch thread.
+    std::unordered_map<string, Ring*> peers;
+
+    /// Addresses of the drivers we have received from, indexed by name.
+    /// They are kept until this object is destroyed, so Received::sender
+    /// remains valid as long as its packet.
+    std::unordered_map<string, ShmAddress*> senders;
+
+    /// Holds packet buffers that are no longer in use, for use in future
+    /// requests; saves the overhead of calling malloc/free for each request.
+    ObjectPool<PacketBuf> packetBufPool;
+
+    /// Tracks number of outstanding allocated payloads.  For detecting leaks.
+    int packetBufsUtilized;
+
+    /// Service locator for this driver.
+    string locatorString;
+
+    DISALLOW_COPY_AND_ASSIGN(ShmDriver);
+};
+
+} // end RAMCloud
+
+#endif  // RAMCLOUD_SHMDRIVER_H
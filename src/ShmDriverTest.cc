@@ -0,0 +1,202 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <unistd.h>
+
+#include "TestUtil.h"
+#include "MockFastTransport.h"
+#include "ShmDriver.h"
+
+namespace RAMCloud {
+class ShmDriverTest : public ::testing::Test {
+  public:
+    Context context;
+    string serverName;
+    ServiceLocator serverLocator;
+    ShmDriver* server;
+    ShmDriver* client;
+    MockFastTransport* serverTransport;
+    MockFastTransport* clientTransport;
+    Tub<ShmDriver::ShmAddress> serverAddress;
+    TestLog::Enable logEnabler;
+
+    ShmDriverTest()
+        : context()
+        , serverName(format("test%d", getpid()))
+        , serverLocator("basic+shm: name=" + serverName)
+        , server(NULL)
+        , client(NULL)
+        , serverTransport(NULL)
+        , clientTransport(NULL)
+        , serverAddress()
+        , logEnabler()
+    {
+        server = new ShmDriver(&context, &serverLocator);
+        client = new ShmDriver(&context);
+        serverTransport = new MockFastTransport(&context, server);
+        clientTransport = new MockFastTransport(&context, client);
+        serverAddress.construct(serverName);
+    }
+
+    ~ShmDriverTest()
+    {
+        // Note: deleting the transport deletes the driver implicitly.
+        delete clientTransport;
+        delete serverTransport;
+    }
+
+    void sendMessage(ShmDriver* driver, const Driver::Address* address,
+            const char* header, const char* payload) {
+        Buffer message;
+        message.appendExternal(payload, downCast<uint32_t>(strlen(payload)));
+        Buffer::Iterator iterator(&message);
+        driver->sendPacket(address, header, downCast<uint32_t>(strlen(header)),
+                           &iterator);
+    }
+
+    // Invoke the dispatcher's polling loop (once is enough: packets are
+    // placed directly in the receiver's ring) and return what arrived.
+    string receivePackets(MockFastTransport* transport) {
+        transport->packetData.clear();
+        context.dispatch->poll();
+        return transport->packetData;
+    }
+
+  private:
+    DISALLOW_COPY_AND_ASSIGN(ShmDriverTest);
+};
+
+TEST_F(ShmDriverTest, basics) {
+    // Send a packet from a client-style driver to a server-style driver.
+    sendMessage(client, serverAddress.get(), "header:",
+            "This is a sample message");
+    EXPECT_EQ("header:This is a sample message",
+            receivePackets(serverTransport));
+
+    // Send a response back in the other direction.
+    sendMessage(server, serverTransport->sender, "h:", "response");
+    EXPECT_EQ("h:response", receivePackets(clientTransport));
+    EXPECT_EQ(0U, server->slotsLoaned);
+}
+
+TEST_F(ShmDriverTest, constructor_badName) {
+    ServiceLocator locator("basic+shm: name=a/b");
+    string message("no exception");
+    try {
+        ShmDriver driver(&context, &locator);
+    } catch (DriverException& e) {
+        message = e.message;
+    }
+    EXPECT_EQ("ShmDriver name 'a/b' is invalid (it must have 1-48 "
+            "characters, none of them '/')", message);
+}
+
+TEST_F(ShmDriverTest, constructor_replaceStaleRegion) {
+    sendMessage(client, serverAddress.get(), "", "first");
+    EXPECT_EQ("first", receivePackets(serverTransport));
+
+    // A new driver takes over the server's name (as if the server had
+    // crashed and restarted); the client must find the new one.
+    ShmDriver* server2 = new ShmDriver(&context, &serverLocator);
+    MockFastTransport* serverTransport2 =
+            new MockFastTransport(&context, server2);
+    EXPECT_EQ(0U, server->ring.header->alive);
+    sendMessage(client, serverAddress.get(), "", "second");
+    context.dispatch->poll();
+    EXPECT_EQ("", serverTransport->packetData);
+    EXPECT_EQ("second", serverTransport2->packetData);
+
+    // Deleting the old driver must not remove the new one's region.
+    delete serverTransport;
+    serverTransport = serverTransport2;
+    server = server2;
+    sendMessage(client, serverAddress.get(), "", "third");
+    EXPECT_EQ("third", receivePackets(serverTransport));
+}
+
+TEST_F(ShmDriverTest, destructor_removesRegion) {
+    sendMessage(client, serverAddress.get(), "", "first");
+    delete serverTransport;
+    serverTransport = NULL;
+    TestLog::reset();
+    sendMessage(client, serverAddress.get(), "", "second");
+    EXPECT_EQ(format("getPeer: ShmDriver couldn't find driver %s on this "
+            "host; dropping packet", serverName.c_str()), TestLog::get());
+
+    // Keep the destructor of the test happy.
+    serverTransport = new MockFastTransport(&context,
+            new ShmDriver(&context, &serverLocator));
+}
+
+TEST_F(ShmDriverTest, release_copiedPacket) {
+    server->slotsLoaned = ShmDriver::NUM_SLOTS / 2;
+    sendMessage(client, serverAddress.get(), "", "copied");
+    EXPECT_EQ("copied", receivePackets(serverTransport));
+    EXPECT_EQ(ShmDriver::NUM_SLOTS / 2, server->slotsLoaned);
+    EXPECT_EQ(0, server->packetBufsUtilized);
+    server->slotsLoaned = 0;
+}
+
+TEST_F(ShmDriverTest, sendPacket_ringFull) {
+    for (uint32_t i = 0; i < ShmDriver::NUM_SLOTS; i++) {
+        sendMessage(client, serverAddress.get(), "", "x");
+    }
+    EXPECT_EQ("", TestLog::get());
+    sendMessage(client, serverAddress.get(), "", "y");
+    EXPECT_EQ(format("sendPacket: ShmDriver ring for %s is full; dropping "
+            "packet", serverName.c_str()), TestLog::get());
+
+    // Once the server catches up, there is room again.
+    for (uint32_t i = 0; i < ShmDriver::NUM_SLOTS / ShmDriver::MAX_RX_BURST;
+            i++) {
+        context.dispatch->poll();
+    }
+    sendMessage(client, serverAddress.get(), "", "z");
+    EXPECT_EQ("z", receivePackets(serverTransport));
+}
+
+TEST_F(ShmDriverTest, sendPacket_toSelf) {
+    sendMessage(server, serverAddress.get(), "", "loopback");
+    EXPECT_EQ("loopback", receivePackets(serverTransport));
+    EXPECT_EQ(0U, server->peers.size());
+}
+
+TEST_F(ShmDriverTest, newAddress) {
+    ServiceLocator local(server->getServiceLocator());
+    Driver::AddressPtr address(client->newAddress(&local));
+    EXPECT_EQ(serverName, address->toString());
+
+    ServiceLocator remote("basic+shm: host=some.other.host, name=foo");
+    string message("no exception");
+    try {
+        client->newAddress(&remote);
+    } catch (DriverException& e) {
+        message = e.message;
+    }
+    EXPECT_EQ(0U, message.find("ShmDriver can't reach "
+            "basic+shm: host=some.other.host, name=foo: it is on host "
+            "some.other.host")) << message;
+}
+
+TEST_F(ShmDriverTest, poll_badLength) {
+    sendMessage(client, serverAddress.get(), "", "bad");
+    server->ring.slots[0].length = ShmDriver::MAX_PAYLOAD_SIZE + 1;
+    EXPECT_EQ("", receivePackets(serverTransport));
+    EXPECT_EQ("poll: ShmDriver received packet with bad length 8129",
+            TestLog::get());
+    EXPECT_EQ(ShmDriver::NUM_SLOTS, server->ring.slots[0].sequence);
+}
+
+}  // namespace RAMCloud
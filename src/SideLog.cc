@@ -127,6 +127,30 @@ SideLog::commit()
     log->rollHeadOver();
 }
 
+/**
+ * Start replicating the entries appended to the SideLog's newest segment so
+ * far, without waiting for them to be replicated (full segments start
+ * replicating as soon as the next one is allocated). Callers that append
+ * a lot of data, such as recovery masters replaying their partitions, call
+ * this every so often, so that replication keeps up with their appends and
+ * commit() has little left to wait for.
+ */
+void
+SideLog::replicateAppended()
+{
+    SegmentCertificate certificate;
+    LogSegment* segment;
+    uint32_t appendedLength;
+    {
+        SpinLock::Guard _(appendLock);
+        if (segments.empty())
+            return;
+        segment = segments.back();
+        appendedLength = segment->getAppendedLength(&certificate);
+    }
+    segment->replicatedSegment->queueSync(appendedLength, &certificate);
+}
+
 /******************************************************************************
  * PRIVATE METHODS
  ******************************************************************************/
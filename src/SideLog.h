@@ -70,6 +70,7 @@ class SideLog : public AbstractLog {
     SideLog(Log* log, LogCleaner* cleaner);
     ~SideLog();
     void commit();
+    void replicateAppended();
 
   PRIVATE:
     LogSegment* allocNextSegment(bool mustNotFail);
@@ -151,6 +151,22 @@ TEST_F(SideLogTest, commit) {
     EXPECT_EQ(4lu, l.totalLiveBytes);
 }
 
+TEST_F(SideLogTest, replicateAppended) {
+    SideLog sl(&l);
+    TestLog::Enable _("queueSync");
+    sl.replicateAppended();
+    EXPECT_EQ("", TestLog::get());
+
+    EXPECT_TRUE(sl.append(LOG_ENTRY_TYPE_OBJ, "hi", 2));
+    LogSegment* segment = sl.segments.back();
+    sl.replicateAppended();
+    EXPECT_EQ(format("queueSync: queueing segment %lu to offset %u",
+            segment->id, segment->getAppendedLength()), TestLog::get());
+    EXPECT_EQ(segment->getAppendedLength(),
+            segment->replicatedSegment->queued.bytes);
+    EXPECT_FALSE(segment->replicatedSegment->queued.close);
+}
+
 static void
 freeSegmentSoon(SegmentManager* segmentManager, LogSegment* segment) {
     usleep(1000);
@@ -15,9 +15,11 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <sys/mman.h>
 
 #include "SingleFileStorage.h"
 #include "Buffer.h"
@@ -30,6 +32,11 @@
 #include "ShortMacros.h"
 #include "PerfStats.h"
 
+// Included last: it pulls in linux/fs.h, whose BLOCK_SIZE macro would
+// clash with SingleFileStorage::BLOCK_SIZE.
+#include <linux/aio_abi.h> // NOLINT
+#undef BLOCK_SIZE
+
 namespace RAMCloud {
 
 /**
@@ -52,6 +59,12 @@ enum { MAX_POOLED_BUFFERS = 128 };
  */
 enum { INIT_POOLED_BUFFERS = MAX_POOLED_BUFFERS };
 
+/**
+ * Default size of the pieces in which replicas are read from storage; see
+ * SingleFileStorage::aioChunkSize.
+ */
+enum { DEFAULT_AIO_CHUNK_SIZE = 1 << 20 };
+
 // --- SingleFileStorage::Frame ---
 
 bool SingleFileStorage::Frame::testingSkipRealIo = false;
@@ -72,6 +85,9 @@ SingleFileStorage::Frame::Frame(SingleFileStorage* storage, size_t frameIndex)
     , storage(storage)
     , frameIndex(frameIndex)
     , buffer(NULL, storage->bufferDeleter)
+    , mapping(NULL)
+    , mappingLength(0)
+    , mappedData(NULL)
     , isOpen(false)
     , isClosed(false)
     , sync(false)
@@ -99,6 +115,7 @@ SingleFileStorage::Frame::Frame(SingleFileStorage* storage, size_t frameIndex)
 SingleFileStorage::Frame::~Frame()
 {
     deschedule();
+    unmapReplica();
 }
 
 /**
@@ -216,11 +233,26 @@ SingleFileStorage::Frame::startLoading()
     if (loadRequested)
         return;
     loadRequested = true;
-    if (buffer)
+    if (buffer || mapping)
         return;
     schedule(lock, NORMAL);
 }
 
+/**
+ * Start loading the replica in this frame, as startLoading() does, but
+ * with HIGH priority, so that the load happens before any other loads
+ * that are still queued.
+ */
+void
+SingleFileStorage::Frame::startLoadingUrgently()
+{
+    Lock lock(storage->mutex);
+    loadRequested = true;
+    if (buffer || mapping)
+        return;
+    schedule(lock, HIGH);
+}
+
 /**
  * Returns true if calling load() would not block. Always returns false if
  * startLoading() or load() hasn't been called.
@@ -229,7 +261,7 @@ bool
 SingleFileStorage::Frame::isLoaded()
 {
     Lock _(storage->mutex);
-    return loadRequested && buffer;
+    return loadRequested && getLoadedData();
 }
 
 /**
@@ -248,7 +280,8 @@ SingleFileStorage::Frame::load()
     startLoading();
     while (true) {
         Lock lock(storage->mutex);
-        if (!buffer) {
+        void* data = getLoadedData();
+        if (!data) {
             testingHadToWaitForBufferOnLoad = true;
             continue;
         }
@@ -256,7 +289,7 @@ SingleFileStorage::Frame::load()
             testingHadToWaitForSyncOnLoad = true;
             continue;
         }
-        return buffer.get();
+        return data;
     }
 }
 
@@ -271,6 +304,7 @@ SingleFileStorage::Frame::unload()
     Lock lock(storage->mutex);
     assert(loadRequested);
     buffer.reset();
+    unmapReplica();
     loadRequested = false;
 }
 
@@ -419,7 +453,7 @@ SingleFileStorage::Frame::performTask()
     performingIo = true;
     if (!isSynced()) {
         performWrite(lock);
-    } else if (loadRequested && !buffer) {
+    } else if (loadRequested && !getLoadedData()) {
         performRead(lock);
     }
     performingIo = false;
@@ -470,6 +504,7 @@ SingleFileStorage::Frame::free()
             isWriteBuffer = false;
         }
     }
+    unmapReplica();
 
     storage->freeMap[frameIndex] = 1;
 }
@@ -482,6 +517,12 @@ SingleFileStorage::Frame::reopen(size_t length)
     load();
 
     Lock _(storage->mutex);
+    if (!buffer) {
+        // Loaded through a mapping; appends need a private copy.
+        buffer = storage->allocateBuffer();
+        memcpy(buffer.get(), mappedData, storage->segmentSize);
+        unmapReplica();
+    }
     appendedLength = length;
     committedLength = length;
     isOpen = true;
@@ -530,16 +571,144 @@ SingleFileStorage::Frame::open(bool sync)
     loadRequested = false;
 }
 
+namespace {
+// glibc doesn't provide wrappers for the native AIO system calls (libaio
+// does, but it would be one more dependency for a handful of syscalls).
+
+int
+ioSetup(unsigned maxEvents, uint64_t* context)
+{
+    return downCast<int>(syscall(__NR_io_setup, maxEvents, context));
+}
+
+int
+ioDestroy(uint64_t context)
+{
+    return downCast<int>(syscall(__NR_io_destroy, context));
+}
+
+int
+ioSubmit(uint64_t context, size_t count, struct iocb** requests)
+{
+    return downCast<int>(syscall(__NR_io_submit, context, count, requests));
+}
+
+int
+ioGetEvents(uint64_t context, size_t minCount, size_t maxCount,
+            struct io_event* events)
+{
+    return downCast<int>(syscall(__NR_io_getevents, context, minCount,
+                                 maxCount, events, NULL));
+}
+
+/// Return an AIO request for \a count bytes at \a offset in \a fd.
+struct iocb
+makeRequest(int fd, int opcode, void* buf, size_t count, off_t offset)
+{
+    struct iocb request;
+    memset(&request, 0, sizeof(request));
+    request.aio_fildes = downCast<uint32_t>(fd);
+    request.aio_lio_opcode = downCast<uint16_t>(opcode);
+    request.aio_buf = reinterpret_cast<uint64_t>(buf);
+    request.aio_nbytes = count;
+    request.aio_offset = offset;
+    return request;
+}
+}
+
+/**
+ * Issue a batch of reads or writes with Linux native AIO and wait for all
+ * of them to complete. All of the requests are handed to the kernel
+ * together (up to MAX_AIO_EVENTS at a time), so they are outstanding at
+ * the device concurrently rather than one after the other. DIEs on any
+ * problem. Note that for files not opened with O_DIRECT the kernel
+ * performs the IO synchronously during submission, which is still correct
+ * but gains nothing.
+ *
+ * \param requests
+ *      Requests to perform (see makeRequest()).
+ * \param allowShortReads
+ *      If true, reads that return fewer bytes than requested are not
+ *      considered a problem (see unlockedRead()).
+ */
+void
+SingleFileStorage::performAio(std::vector<struct iocb>& requests,
+                              bool allowShortReads) const
+{
+    struct iocb* batch[MAX_AIO_EVENTS];
+    struct io_event events[MAX_AIO_EVENTS];
+    size_t submitted = 0;
+    size_t completed = 0;
+    while (completed < requests.size()) {
+        size_t count = 0;
+        while ((submitted + count < requests.size()) &&
+                (submitted + count - completed < MAX_AIO_EVENTS)) {
+            batch[count] = &requests[submitted + count];
+            count++;
+        }
+        if (count > 0) {
+            int r = ioSubmit(aioContext, count, batch);
+            if (r < 0) {
+                DIE("Failed to submit IO for replica: %s", strerror(errno));
+            }
+            submitted += r;
+        }
+
+        int r = ioGetEvents(aioContext, 1, MAX_AIO_EVENTS, events);
+        if (r < 0) {
+            if (errno == EINTR)
+                continue;
+            DIE("Failed waiting for IO on replica: %s", strerror(errno));
+        }
+        for (int i = 0; i < r; i++) {
+            const struct iocb* request = reinterpret_cast<struct iocb*>(
+                    static_cast<uintptr_t>(events[i].obj));
+            bool isRead = request->aio_lio_opcode == IOCB_CMD_PREAD;
+            uint64_t offset = static_cast<uint64_t>(request->aio_offset);
+            uint64_t length = request->aio_nbytes;
+            int64_t result = events[i].res;
+            if (result < 0) {
+                DIE("Failed to %s replica: %s, "
+                    "starting offset in file %lu, length %lu",
+                    isRead ? "read" : "write to",
+                    strerror(downCast<int>(-result)), offset, length);
+            } else if (static_cast<uint64_t>(result) != length &&
+                    !(isRead && allowShortReads)) {
+                DIE("Unexpectedly short %s replica, starting offset in "
+                    "file %lu, length %lu, result %ld",
+                    isRead ? "read of" : "write to", offset, length, result);
+            }
+        }
+        completed += r;
+    }
+}
+
 /**
- * Wrapper for pread that releases \a lock during IO and DIEs on any problem.
+ * Read from storage, releasing \a lock during IO; DIEs on any problem.
  * If useDevNull is true, this method does not consider short reads to be a
- * "problem".
+ * "problem". When AIO is available the read is split into aioChunkSize
+ * pieces which are all outstanding at once.
  */
 void
 SingleFileStorage::unlockedRead(Frame::Lock& lock, void* buf, size_t count,
                                 off_t offset, bool usingDevNull) const
 {
     lock.unlock();
+    if (aioContext != 0) {
+        CycleCounter<RawMetric> _(&metrics->backup.storageReadTicks);
+        std::vector<struct iocb> requests;
+        for (size_t done = 0; done < count; done += aioChunkSize) {
+            requests.push_back(makeRequest(fd, IOCB_CMD_PREAD,
+                    static_cast<char*>(buf) + done,
+                    std::min(aioChunkSize, count - done),
+                    offset + downCast<off_t>(done)));
+        }
+        performAio(requests, usingDevNull);
+        PerfStats::threadStats.backupReadActiveCycles += _.stop();
+        lock.lock();
+        return;
+    }
+
     ssize_t r;
     {
         CycleCounter<RawMetric> _(&metrics->backup.storageReadTicks);
@@ -562,9 +731,11 @@ SingleFileStorage::unlockedRead(Frame::Lock& lock, void* buf, size_t count,
 }
 
 /**
- * Wrapper for pwrite that releases \a lock during IO and DIEs on any problem.
- * Performs two pwrites back-to-back: one for new data being appended and
- * another to write out the most recently appended metadata block.
+ * Write to storage, releasing \a lock during IO; DIEs on any problem.
+ * Performs two writes: one for new data being appended and another to
+ * write out the most recently appended metadata block. When AIO is
+ * available both are submitted together; otherwise they are done with
+ * back-to-back pwrites.
  */
 void
 SingleFileStorage::unlockedWrite(Frame::Lock& lock, void* buf, size_t count,
@@ -574,26 +745,36 @@ SingleFileStorage::unlockedWrite(Frame::Lock& lock, void* buf, size_t count,
 {
     CycleCounter<RawMetric> writeTicks(&metrics->backup.storageWriteTicks);
     lock.unlock();
-    ssize_t r = pwrite(fd, buf, count, offset);
-    if (r == -1) {
-        DIE("Failed to write to replica: %s, "
-            "starting offset in file %lu, length %lu",
-            strerror(errno), offset, count);
-    } else if (r != downCast<ssize_t>(count)) {
-        DIE("Unexpectedly short write to replica, starting offset in "
-            "file %lu, length %lu, result %lu",
-             offset, count, r);
-    }
-    r = pwrite(fd, metadataBuf, metadataCount, metadataOffset);
-    PerfStats::threadStats.backupWriteActiveCycles += writeTicks.stop();
-    if (r == -1) {
-        DIE("Failed to write metadata for replica: %s, "
-            "starting offset in file %lu, length %lu",
-            strerror(errno), metadataOffset, metadataCount);
-    } else if (r != downCast<ssize_t>(metadataCount)) {
-        DIE("Unexpectedly short write metadata for replica, starting offset "
-            "in file %lu, expected length %lu, actual write length %ld",
-            metadataOffset, metadataCount, r);
+    if (aioContext != 0) {
+        std::vector<struct iocb> requests;
+        requests.push_back(makeRequest(fd, IOCB_CMD_PWRITE, buf, count,
+                                       offset));
+        requests.push_back(makeRequest(fd, IOCB_CMD_PWRITE, metadataBuf,
+                                       metadataCount, metadataOffset));
+        performAio(requests, false);
+        PerfStats::threadStats.backupWriteActiveCycles += writeTicks.stop();
+    } else {
+        ssize_t r = pwrite(fd, buf, count, offset);
+        if (r == -1) {
+            DIE("Failed to write to replica: %s, "
+                "starting offset in file %lu, length %lu",
+                strerror(errno), offset, count);
+        } else if (r != downCast<ssize_t>(count)) {
+            DIE("Unexpectedly short write to replica, starting offset in "
+                "file %lu, length %lu, result %lu",
+                 offset, count, r);
+        }
+        r = pwrite(fd, metadataBuf, metadataCount, metadataOffset);
+        PerfStats::threadStats.backupWriteActiveCycles += writeTicks.stop();
+        if (r == -1) {
+            DIE("Failed to write metadata for replica: %s, "
+                "starting offset in file %lu, length %lu",
+                strerror(errno), metadataOffset, metadataCount);
+        } else if (r != downCast<ssize_t>(metadataCount)) {
+            DIE("Unexpectedly short write metadata for replica, starting "
+                "offset in file %lu, expected length %lu, actual write "
+                "length %ld", metadataOffset, metadataCount, r);
+        }
     }
     // Reduce our bandwidth (if so configured) by delaying this operation.
     CycleCounter<RawMetric> _(&metrics->backup.storageWriteTicks);
@@ -635,8 +816,13 @@ void
 SingleFileStorage::Frame::performRead(Lock& lock)
 {
     assert(loadRequested);
-    BufferPtr buffer = storage->allocateBuffer();
     const size_t frameStart = storage->offsetOfFrame(frameIndex);
+    if (storage->mapLoads && !testingSkipRealIo && !storage->usingDevNull &&
+            mapReplica(frameStart)) {
+        return;
+    }
+
+    BufferPtr buffer = storage->allocateBuffer();
 
     if (testingSkipRealIo) {
         TEST_LOG("count %lu offset %lu", storage->segmentSize, frameStart);
@@ -654,6 +840,72 @@ SingleFileStorage::Frame::performRead(Lock& lock)
     this->buffer = std::move(buffer);
 }
 
+/**
+ * Make the replica data available by mapping the frame's region of the
+ * file instead of reading it into a buffer; used by performRead() when
+ * SingleFileStorage::mapLoads is set. Readahead is started on the whole
+ * replica, but reads don't have to complete before load() returns: callers
+ * fault pages in as they walk the replica.
+ *
+ * \param frameStart
+ *      Offset of the frame's data in the file.
+ * \return
+ *      True if the replica was mapped; false if mapping failed, in which
+ *      case the caller should read the replica into a buffer instead.
+ */
+bool
+SingleFileStorage::Frame::mapReplica(size_t frameStart)
+{
+    assert(!mapping);
+    const size_t pageSize = sysconf(_SC_PAGESIZE);
+    const size_t mapStart = frameStart / pageSize * pageSize;
+    const size_t length = frameStart - mapStart + storage->segmentSize;
+    void* start = mmap(NULL, length, PROT_READ, MAP_SHARED, storage->fd,
+                       mapStart);
+    if (start == MAP_FAILED) {
+        RAMCLOUD_CLOG(WARNING, "Couldn't map replica in frame %lu, reading "
+            "it into a buffer instead: %s", frameIndex, strerror(errno));
+        return false;
+    }
+    madvise(start, length, MADV_SEQUENTIAL);
+    madvise(start, length, MADV_WILLNEED);
+
+    ++metrics->backup.storageReadCount;
+    metrics->backup.storageReadBytes += storage->segmentSize;
+    ++PerfStats::threadStats.backupReadOps;
+    PerfStats::threadStats.backupReadBytes += storage->segmentSize;
+
+    mapping = start;
+    mappingLength = length;
+    mappedData = static_cast<char*>(start) + (frameStart - mapStart);
+    return true;
+}
+
+/// Release the mapping created by mapReplica(), if there is one.
+void
+SingleFileStorage::Frame::unmapReplica()
+{
+    if (!mapping)
+        return;
+    if (munmap(mapping, mappingLength) != 0)
+        LOG(ERROR, "Couldn't unmap replica: %s", strerror(errno));
+    mapping = NULL;
+    mappingLength = 0;
+    mappedData = NULL;
+}
+
+/**
+ * Return a pointer to the replica data if it is in memory (either in
+ * #buffer or mapped), NULL otherwise.
+ */
+void*
+SingleFileStorage::Frame::getLoadedData()
+{
+    if (buffer)
+        return buffer.get();
+    return mappedData;
+}
+
 /**
  * Flush any appended data and the latest appended metadata to disk.
  * Requires #buffer to remain set for the duration of the operation, though
@@ -794,13 +1046,17 @@ SingleFileStorage::BufferDeleter::operator()(void* buffer)
  * \param openFlags
  *      Extra flags for use while opening filePath (default to 0, O_DIRECT may
  *      be used to disable the OS buffer cache.
+ * \param mapLoads
+ *      If true, load replicas for recovery by mapping them rather than
+ *      reading them into buffers; see #mapLoads.
  */
 SingleFileStorage::SingleFileStorage(size_t segmentSize,
                                      size_t frameCount,
                                      size_t writeRateLimit,
                                      size_t maxWriteBuffers,
                                      const char* filePath,
-                                     int openFlags)
+                                     int openFlags,
+                                     bool mapLoads)
     : BackupStorage(segmentSize, Type::DISK, writeRateLimit)
     , mutex()
     , ioQueue()
@@ -811,7 +1067,10 @@ SingleFileStorage::SingleFileStorage(size_t segmentSize,
     , freeMap(frameCount)
     , lastAllocatedFrame(FreeMap::npos)
     , openFlags(openFlags)
+    , mapLoads(mapLoads)
     , fd(-1)
+    , aioContext(0)
+    , aioChunkSize(DEFAULT_AIO_CHUNK_SIZE)
     , usingDevNull(filePath != NULL && string(filePath) == "/dev/null")
     , tempFilePath()
     , writeBuffersInUse(0)
@@ -848,6 +1107,12 @@ SingleFileStorage::SingleFileStorage(size_t segmentSize,
               format("Failed to open backup storage file %s", filePath), e);
     }
 
+    if (ioSetup(MAX_AIO_EVENTS, &aioContext) != 0) {
+        LOG(WARNING, "Native AIO unavailable (%s); replica IO will be "
+            "synchronous", strerror(errno));
+        aioContext = 0;
+    }
+
     // If its a regular file reserve space, otherwise
     // assume its a device and we don't need to bother.
     struct stat st;
@@ -888,6 +1153,9 @@ SingleFileStorage::~SingleFileStorage()
 {
     ioQueue.halt();
 
+    if (aioContext != 0)
+        ioDestroy(aioContext);
+
     int r = close(fd);
     if (r == -1)
         LOG(ERROR, "Couldn't close backup log");
@@ -976,6 +1244,18 @@ SingleFileStorage::open(bool sync)
     return {frame, BackupStorage::freeFrame};
 }
 
+/**
+ * Return the number of replicas whose data is buffered in memory while
+ * being written to storage (or waiting to be). This is a measure of how
+ * far storage is behind on writes; see StripedStorage::open().
+ */
+size_t
+SingleFileStorage::getWriteBuffersInUse()
+{
+    Lock lock(mutex);
+    return writeBuffersInUse;
+}
+
 /**
  * Same as BackupStorage::benchmark() except it resets the storage to reuse
  * the segment frames that may have been used during benchmarking.
@@ -985,7 +1265,11 @@ SingleFileStorage::open(bool sync)
 uint32_t
 SingleFileStorage::benchmark(BackupStrategy backupStrategy)
 {
+    // Measure real reads, not how long it takes to set up a mapping.
+    bool mapLoads = this->mapLoads;
+    this->mapLoads = false;
     uint32_t r = BackupStorage::benchmark(backupStrategy);
+    this->mapLoads = mapLoads;
     lastAllocatedFrame = FreeMap::npos;
     return r;
 }
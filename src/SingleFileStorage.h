@@ -22,6 +22,10 @@
 #include "BackupStorage.h"
 #include "PriorityTaskQueue.h"
 
+// Forward declaration, so we don't have to include kernel headers here
+// (linux/aio_abi.h defines a BLOCK_SIZE macro).
+struct iocb;
+
 namespace RAMCloud {
 
 /**
@@ -75,6 +79,7 @@ class SingleFileStorage : public BackupStorage {
         const void* getMetadata();
 
         void startLoading();
+        void startLoadingUrgently();
         bool isLoaded();
         bool currentlyOpen() { return isOpen;}
         void* load();
@@ -96,6 +101,9 @@ class SingleFileStorage : public BackupStorage {
         void open(bool sync);
 
         void performRead(Lock& lock);
+        bool mapReplica(size_t frameStart);
+        void unmapReplica();
+        void* getLoadedData();
         void performWrite(Lock& lock);
 
         bool isSynced() const;
@@ -119,6 +127,20 @@ class SingleFileStorage : public BackupStorage {
          */
         BufferPtr buffer;
 
+        /**
+         * If the replica was loaded by mapping its region of the file
+         * rather than reading it into #buffer (see
+         * SingleFileStorage::mapLoads) this is the start of the mapping;
+         * NULL otherwise. At most one of #buffer and #mapping is set.
+         */
+        void* mapping;
+
+        /// Bytes mapped starting at #mapping.
+        size_t mappingLength;
+
+        /// Where the replica data starts within #mapping.
+        char* mappedData;
+
         /**
          * Tracks whether a replica has been opened (either initially or
          * since the time of the last free). False if #isClosed.
@@ -226,7 +248,8 @@ class SingleFileStorage : public BackupStorage {
                       size_t writeRateLimit,
                       size_t maxNonVolatileBuffers,
                       const char* filePath,
-                      int openFlags = 0);
+                      int openFlags = 0,
+                      bool mapLoads = false);
     ~SingleFileStorage();
 
     FrameRef open(bool sync);
@@ -241,6 +264,7 @@ class SingleFileStorage : public BackupStorage {
     void fry();
 
     BufferPtr allocateBuffer();
+    size_t getWriteBuffersInUse();
 
     /**
      * Internal use only; block size of storage. Needed to deal
@@ -257,6 +281,12 @@ class SingleFileStorage : public BackupStorage {
      */
     enum { METADATA_SIZE = BLOCK_SIZE };
 
+    /**
+     * Maximum number of asynchronous IO requests outstanding at once; this
+     * is the queue depth offered to the device when reading a replica.
+     */
+    enum { MAX_AIO_EVENTS = 64 };
+
   PRIVATE:
     off_t offsetOfFrame(size_t frameIndex) const;
     off_t offsetOfMetadataFrame(size_t frameIndex) const;
@@ -266,6 +296,8 @@ class SingleFileStorage : public BackupStorage {
     void unlockedWrite(Frame::Lock& lock, void* buf, size_t count, off_t offset,
                        void* metadataBuf, size_t metadataCount,
                        off_t metadataOffset) const;
+    void performAio(std::vector<struct iocb>& requests,
+                    bool allowShortReads) const;
 
     void reserveSpace();
     Tub<Superblock> tryLoadSuperblock(uint32_t superblockFrame);
@@ -313,9 +345,36 @@ class SingleFileStorage : public BackupStorage {
     /// Extra flags for use while opening filePath (e.g. O_DIRECT | O_SYNC).
     int openFlags;
 
+    /**
+     * If true, replicas that must come from storage are loaded for recovery
+     * by mapping their region of the file rather than reading them into a
+     * pooled buffer. Pages are then faulted in (with readahead) as the
+     * recovery segment builder walks the replica, so memory for a replica
+     * is only committed for the parts actually touched and loaded replicas
+     * don't draw on the buffer pool. Disabled during benchmark(), which
+     * needs real reads to measure the device.
+     */
+    bool mapLoads;
+
     /// The file descriptor of the storage file.
     int fd;
 
+    /**
+     * Linux native AIO context (an aio_context_t) used by unlockedRead()
+     * and unlockedWrite() to keep several requests in flight at once. 0
+     * means the kernel doesn't support AIO, and they fall back to
+     * pread/pwrite. Only used from the #ioQueue thread.
+     */
+    uint64_t aioContext;
+
+    /**
+     * unlockedRead() splits reads into requests of at most this many bytes
+     * and issues them concurrently, so that the device can work on
+     * different parts of a replica in parallel. Must be a multiple of
+     * BLOCK_SIZE.
+     */
+    size_t aioChunkSize;
+
     /// Set to true if the filePath issued to the constructor was "/dev/null".
     /// We need to keep track of this since /dev/null will readily take any
     /// bytes written to it, but does not return anything, which breaks the
@@ -175,6 +175,40 @@ TEST_F(SingleFileStorageTest, Frame_loadDirty) {
     EXPECT_STREQ(test, replica);
 }
 
+TEST_F(SingleFileStorageTest, Frame_loadMapped) {
+    Frame::testingSkipRealIo = false;
+    storage->mapLoads = true;
+    writeReplica(1, 50, 99LU, 1000LU, true, true);
+    std::vector<BackupStorage::FrameRef> allFrames =
+            storage->loadAllMetadata();
+    Frame* frame = static_cast<Frame*>(allFrames[1].get());
+    char* replica = bytes(frame->load());
+    EXPECT_FALSE(frame->buffer);
+    EXPECT_TRUE(frame->mapping);
+    EXPECT_EQ(frame->mappedData, replica);
+    EXPECT_TRUE(frame->isLoaded());
+    EXPECT_EQ(0, memcmp("word 1, word 2, word 3, word 4, word 5; word 6, wo",
+                        replica, 50));
+
+    frame->unload();
+    EXPECT_FALSE(frame->mapping);
+    EXPECT_FALSE(frame->mappedData);
+    EXPECT_FALSE(frame->isLoaded());
+}
+
+TEST_F(SingleFileStorageTest, Frame_loadMappedFreed) {
+    Frame::testingSkipRealIo = false;
+    storage->mapLoads = true;
+    writeReplica(1, 50, 99LU, 1000LU, true, true);
+    std::vector<BackupStorage::FrameRef> allFrames =
+            storage->loadAllMetadata();
+    Frame* frame = static_cast<Frame*>(allFrames[1].get());
+    frame->load();
+    EXPECT_TRUE(frame->mapping);
+    frame->free();
+    EXPECT_FALSE(frame->mapping);
+}
+
 TEST_F(SingleFileStorageTest, Frame_append) {
     Frame::testingSkipRealIo = false;
     BackupStorage::FrameRef frameRef = storage->open(false);
@@ -388,6 +422,25 @@ TEST_F(SingleFileStorageTest, Frame_reopen) {
             static_cast<char*>(frame->buffer.get()));
 }
 
+TEST_F(SingleFileStorageTest, Frame_reopenMapped) {
+    Frame::testingSkipRealIo = false;
+    storage->mapLoads = true;
+    writeReplica(2, 50, 99LU, 1000LU, false, true);
+    std::vector<BackupStorage::FrameRef> allFrames =
+            storage->loadAllMetadata();
+    Frame* frame = static_cast<Frame*>(allFrames[2].get());
+    frame->reopen(50);
+
+    // Appends need a private copy, so the mapping is traded for a buffer.
+    EXPECT_FALSE(frame->mapping);
+    EXPECT_TRUE(frame->buffer);
+    Buffer source;
+    source.appendExternal("0123456789", 10);
+    frame->append(source, 4, 6, 50, NULL, 0);
+    EXPECT_STREQ("word 1, word 2, word 3, word 4, word 5; word 6, wo456789",
+            static_cast<char*>(frame->buffer.get()));
+}
+
 TEST_F(SingleFileStorageTest, Frame_open) {
     BackupStorage::FrameRef frameRef = storage->open(false);
     Frame* frame = static_cast<Frame*>(frameRef.get());
@@ -556,6 +609,69 @@ TEST_F(SingleFileStorageTest, Frame_performRead) {
     EXPECT_TRUE(frame->buffer);
 }
 
+TEST_F(SingleFileStorageTest, Frame_performRead_mapped) {
+    Frame::testingSkipRealIo = false;
+    storage->mapLoads = true;
+    BackupStorage::FrameRef frameRef = storage->open(false);
+    Frame* frame = static_cast<Frame*>(frameRef.get());
+    frame->close();
+    storage->ioQueue.halt();
+
+    EXPECT_FALSE(frame->buffer);
+    {
+        Frame::Lock lock(frame->storage->mutex);
+        frame->loadRequested = true;
+        frame->performRead(lock);
+    }
+    EXPECT_FALSE(frame->buffer);
+    EXPECT_TRUE(frame->mapping);
+    EXPECT_EQ(storage->offsetOfFrame(frame->frameIndex) %
+              sysconf(_SC_PAGESIZE),
+              frame->mappedData - static_cast<char*>(frame->mapping));
+}
+
+TEST_F(SingleFileStorageTest, unlockedReadWrite) {
+    // Split reads into one request per block, so several are in flight.
+    storage->aioChunkSize = BLOCK_SIZE;
+    Frame::Lock lock(storage->mutex);
+    SingleFileStorage::BufferPtr source = storage->allocateBuffer();
+    SingleFileStorage::BufferPtr dest = storage->allocateBuffer();
+    char* bytes = static_cast<char*>(source.get());
+    for (uint32_t i = 0; i < segmentSize + METADATA_SIZE; i++)
+        bytes[i] = static_cast<char>(i * 7);
+    memset(dest.get(), 0, segmentSize + METADATA_SIZE);
+
+    off_t frameStart = storage->offsetOfFrame(1);
+    off_t metadataStart = storage->offsetOfMetadataFrame(1);
+    storage->unlockedWrite(lock, bytes, segmentSize, frameStart,
+                           bytes + segmentSize, METADATA_SIZE, metadataStart);
+    storage->unlockedRead(lock, dest.get(), segmentSize, frameStart, false);
+    EXPECT_EQ(0, memcmp(bytes, dest.get(), segmentSize));
+    storage->unlockedRead(lock, dest.get(), METADATA_SIZE, metadataStart,
+                          false);
+    EXPECT_EQ(0, memcmp(bytes + segmentSize, dest.get(), METADATA_SIZE));
+}
+
+TEST_F(SingleFileStorageTest, unlockedReadWrite_withoutAio) {
+    uint64_t aioContext = storage->aioContext;
+    storage->aioContext = 0;
+    Frame::Lock lock(storage->mutex);
+    SingleFileStorage::BufferPtr source = storage->allocateBuffer();
+    SingleFileStorage::BufferPtr dest = storage->allocateBuffer();
+    char* bytes = static_cast<char*>(source.get());
+    for (uint32_t i = 0; i < segmentSize + METADATA_SIZE; i++)
+        bytes[i] = static_cast<char>(i * 3);
+    memset(dest.get(), 0, segmentSize + METADATA_SIZE);
+
+    off_t frameStart = storage->offsetOfFrame(2);
+    storage->unlockedWrite(lock, bytes, segmentSize, frameStart,
+                           bytes + segmentSize, METADATA_SIZE,
+                           storage->offsetOfMetadataFrame(2));
+    storage->unlockedRead(lock, dest.get(), segmentSize, frameStart, false);
+    EXPECT_EQ(0, memcmp(bytes, dest.get(), segmentSize));
+    storage->aioContext = aioContext;
+}
+
 TEST_F(SingleFileStorageTest, constructor) {
     struct stat s;
     stat(storage->tempFilePath, &s);
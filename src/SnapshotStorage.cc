@@ -0,0 +1,555 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <set>
+
+#include "Common.h"
+#include "CoordinatorSnapshot.pb.h"
+#include "Logger.h"
+#include "ShortMacros.h"
+#include "SnapshotStorage.h"
+
+namespace RAMCloud {
+
+const char* SnapshotStorage::SNAPSHOT_NODE = "coordinatorSnapshot";
+const char* SnapshotStorage::TAIL_NODE = "coordinatorSnapshotTail";
+
+/**
+ * Construct a SnapshotStorage object. Nothing is read from external
+ * storage until becomeLeader is invoked.
+ *
+ * \param storage
+ *      The storage system that actually holds the objects; its workspace
+ *      becomes ours. This object takes ownership of it.
+ * \param directories
+ *      Names of the directories (such as "tables") whose children are
+ *      kept in snapshots.
+ * \param standbyRefreshMs
+ *      How often to reread the snapshot while waiting to become leader,
+ *      in milliseconds; 0 means don't read it until we become leader.
+ */
+SnapshotStorage::SnapshotStorage(ExternalStorage* storage,
+        const vector<string>& directories, uint32_t standbyRefreshMs)
+    : mutex()
+    , storage(storage)
+    , directories(directories)
+    , standbyRefreshMs(standbyRefreshMs)
+    , objects()
+    , tail()
+    , version(0)
+    , appliedTailLength(0)
+    , leader(false)
+    , standbyThread()
+    , stopStandby(false)
+    , standbyStopped()
+    , maxTailLength(DEFAULT_MAX_TAIL_LENGTH)
+    , maxChunkBytes(DEFAULT_MAX_CHUNK_BYTES)
+{
+    ExternalStorage::setWorkspace(storage->getWorkspace());
+}
+
+/**
+ * Destructor for SnapshotStorage objects.
+ */
+SnapshotStorage::~SnapshotStorage()
+{
+    if (standbyThread) {
+        {
+            Lock lock(mutex);
+            stopStandby = true;
+            standbyStopped.notify_all();
+        }
+        standbyThread->join();
+    }
+    delete storage;
+}
+
+// See documentation for ExternalStorage::becomeLeader.
+void
+SnapshotStorage::becomeLeader(const char* name, const string& leaderInfo)
+{
+    // Keep our copy of the snapshot up to date while we wait, so there's
+    // little left to read once we take over.
+    if (standbyRefreshMs != 0) {
+        Lock lock(mutex);
+        stopStandby = false;
+        standbyThread.construct(&SnapshotStorage::standbyMain, this);
+    }
+    storage->becomeLeader(name, leaderInfo);
+    if (standbyThread) {
+        {
+            Lock lock(mutex);
+            stopStandby = true;
+            standbyStopped.notify_all();
+        }
+        standbyThread->join();
+        standbyThread.destroy();
+    }
+
+    // No one else can modify the objects now, so reading the whole tail
+    // brings our copy completely up to date.
+    Lock lock(mutex);
+    bool snapshotFound = loadSnapshot(lock);
+    if (snapshotFound) {
+        applyTail(lock, true);
+    } else {
+        loadDirectories(lock);
+    }
+    leader = true;
+    LOG(NOTICE, "Coordinator state loaded from %s: %lu objects",
+            snapshotFound ? format("snapshot version %lu plus %lu tail "
+            "entries", version, tail.size()).c_str() : "directories",
+            objects.size());
+    if (!snapshotFound) {
+        writeSnapshot(lock);
+    }
+}
+
+// See documentation for ExternalStorage::get.
+bool
+SnapshotStorage::get(const char* name, Buffer* value)
+{
+    Lock lock(mutex);
+    return storage->get(name, value);
+}
+
+// See documentation for ExternalStorage::getChildren.
+void
+SnapshotStorage::getChildren(const char* name, vector<Object>* children)
+{
+    Lock lock(mutex);
+    string absName(getFullName(name));
+    bool isDirectory = false;
+    foreach (const string& directory, directories) {
+        if (absName == getFullName(directory.c_str()))
+            isDirectory = true;
+    }
+    if (!leader || !isDirectory) {
+        storage->getChildren(name, children);
+        return;
+    }
+
+    // Only the direct children of the directory are returned.
+    children->clear();
+    string prefix = absName + "/";
+    for (std::map<string, string>::iterator it = objects.lower_bound(prefix);
+            it != objects.end(); it++) {
+        const string& childName = it->first;
+        if (childName.compare(0, prefix.size(), prefix) != 0)
+            break;
+        if (childName.find('/', prefix.size()) != string::npos)
+            continue;
+        children->emplace_back(childName.c_str(), it->second.data(),
+                downCast<int>(it->second.size()));
+    }
+}
+
+// See documentation for ExternalStorage::getLeaderInfo.
+bool
+SnapshotStorage::getLeaderInfo(const char* name, Buffer* value)
+{
+    Lock lock(mutex);
+    return storage->getLeaderInfo(name, value);
+}
+
+// See documentation for ExternalStorage::getMulti.
+void
+SnapshotStorage::getMulti(const vector<string>& names,
+        vector<Object>* objects)
+{
+    Lock lock(mutex);
+    storage->getMulti(names, objects);
+}
+
+// See documentation for ExternalStorage::remove.
+void
+SnapshotStorage::remove(const char* name)
+{
+    Lock lock(mutex);
+    string absName(getFullName(name));
+    if (!leader || !isTracked(lock, absName)) {
+        storage->remove(name);
+        return;
+    }
+
+    // The tail must be written first: if we crash before the object is
+    // removed, the next coordinator will find it still there.
+    vector<Write> writes;
+    recordTail(lock, {absName}, &writes);
+    storage->setMulti(writes);
+    storage->remove(name);
+    eraseTree(lock, absName);
+    if (tail.size() >= maxTailLength)
+        writeSnapshot(lock);
+}
+
+// See documentation for ExternalStorage::set.
+void
+SnapshotStorage::set(Hint flavor, const char* name, const char* value,
+        int valueLength)
+{
+    size_t length = (valueLength < 0) ? strlen(value)
+            : downCast<size_t>(valueLength);
+    setMulti({Write(flavor, name, string(value, length))});
+}
+
+// See documentation for ExternalStorage::setMulti.
+void
+SnapshotStorage::setMulti(const vector<Write>& writes)
+{
+    Lock lock(mutex);
+    vector<string> absNames;
+    if (leader) {
+        foreach (const Write& write, writes) {
+            string absName(getFullName(write.name.c_str()));
+            if (isTracked(lock, absName))
+                absNames.push_back(absName);
+        }
+    }
+    if (absNames.empty()) {
+        if (writes.size() == 1) {
+            const Write& write = writes[0];
+            storage->set(write.flavor, write.name.c_str(),
+                    write.value.data(), downCast<int>(write.value.size()));
+        } else {
+            storage->setMulti(writes);
+        }
+        return;
+    }
+
+    // The tail is recorded in the same setMulti as the objects, ahead
+    // of them, so it costs no extra round-trips.
+    vector<Write> allWrites;
+    recordTail(lock, absNames, &allWrites);
+    allWrites.insert(allWrites.end(), writes.begin(), writes.end());
+    storage->setMulti(allWrites);
+    foreach (const Write& write, writes) {
+        string absName(getFullName(write.name.c_str()));
+        if (isTracked(lock, absName))
+            objects[absName] = write.value;
+    }
+    if (tail.size() >= maxTailLength)
+        writeSnapshot(lock);
+}
+
+// See documentation for ExternalStorage::setWorkspace.
+void
+SnapshotStorage::setWorkspace(const char* pathPrefix)
+{
+    Lock lock(mutex);
+    ExternalStorage::setWorkspace(pathPrefix);
+    storage->setWorkspace(pathPrefix);
+}
+
+/**
+ * Read the objects named in the tail on external storage and update our
+ * copy of them.
+ *
+ * \param lock
+ *      Ensures that caller has acquired mutex; not actually used here.
+ * \param rereadAll
+ *      True means read every object named in the tail, and adopt the tail
+ *      as our own (we are becoming leader). False means only read the
+ *      objects that have been added to the tail since the last call; this
+ *      is enough for a standby, which may miss a write that happens just
+ *      as it reads the tail, but rereads everything when it takes over.
+ */
+void
+SnapshotStorage::applyTail(Lock& lock, bool rereadAll)
+{
+    ProtoBuf::CoordinatorSnapshotTail info;
+    if (!storage->getProtoBuf(TAIL_NODE, &info))
+        info.Clear();
+    size_t first = rereadAll ? 0 : appliedTailLength;
+    if (first > downCast<size_t>(info.name_size())) {
+        // The tail has been replaced since we last read it; the snapshot
+        // it belongs to will be read on the next refresh.
+        first = info.name_size();
+    }
+
+    vector<string> names;
+    std::set<string> seen;
+    for (size_t i = first; i < downCast<size_t>(info.name_size()); i++) {
+        const string& name = info.name(downCast<int>(i));
+        if (seen.insert(name).second)
+            names.push_back(name);
+    }
+    vector<Object> found;
+    if (!names.empty())
+        storage->getMulti(names, &found);
+
+    // Objects that no longer exist were removed after the snapshot.
+    foreach (const string& name, names) {
+        eraseTree(lock, name);
+    }
+    foreach (Object& object, found) {
+        objects[object.name] = (object.value == NULL) ? string()
+                : string(object.value, object.length);
+    }
+    appliedTailLength = info.name_size();
+    if (rereadAll)
+        tail.assign(info.name().begin(), info.name().end());
+}
+
+/**
+ * Remove an object, and all of the objects below it, from our copy.
+ *
+ * \param lock
+ *      Ensures that caller has acquired mutex; not actually used here.
+ * \param absName
+ *      Absolute name of the object.
+ */
+void
+SnapshotStorage::eraseTree(Lock& lock, const string& absName)
+{
+    objects.erase(absName);
+    string prefix = absName;
+    if (prefix.empty() || (prefix[prefix.size() - 1] != '/'))
+        prefix.append("/");
+    std::map<string, string>::iterator it = objects.lower_bound(prefix);
+    while ((it != objects.end())
+            && (it->first.compare(0, prefix.size(), prefix) == 0)) {
+        it = objects.erase(it);
+    }
+}
+
+/**
+ * Return true if an object belongs in snapshots: it is in one of the
+ * directories, or it is one of them (or contains one of them).
+ *
+ * \param lock
+ *      Ensures that caller has acquired mutex; not actually used here.
+ * \param absName
+ *      Absolute name of the object.
+ */
+bool
+SnapshotStorage::isTracked(Lock& lock, const string& absName)
+{
+    string parent = absName;
+    if (parent.empty() || (parent[parent.size() - 1] != '/'))
+        parent.append("/");
+    foreach (const string& directory, directories) {
+        string absDirectory(getFullName(directory.c_str()));
+        if ((absName == absDirectory)
+                || (absName.compare(0, absDirectory.size() + 1,
+                absDirectory + "/") == 0)
+                || (absDirectory.compare(0, parent.size(), parent) == 0)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Replace our copy of the objects by reading every object in each of the
+ * directories. This is only used when there is no snapshot.
+ *
+ * \param lock
+ *      Ensures that caller has acquired mutex; not actually used here.
+ */
+void
+SnapshotStorage::loadDirectories(Lock& lock)
+{
+    objects.clear();
+    foreach (const string& directory, directories) {
+        vector<Object> children;
+        storage->getChildren(directory.c_str(), &children);
+        foreach (Object& child, children) {
+            if (child.value == NULL)
+                continue;
+            objects[child.name] = string(child.value, child.length);
+        }
+    }
+    tail.clear();
+    appliedTailLength = 0;
+}
+
+/**
+ * Replace our copy of the objects with the current snapshot on external
+ * storage, unless we already have it.
+ *
+ * \param lock
+ *      Ensures that caller has acquired mutex; not actually used here.
+ *
+ * \return
+ *      True means objects now holds the current snapshot (but not the
+ *      tail). False means there is no usable snapshot; objects is
+ *      unchanged.
+ *
+ * \throws FormatError
+ *      The snapshot couldn't be parsed.
+ */
+bool
+SnapshotStorage::loadSnapshot(Lock& lock)
+{
+    ProtoBuf::CoordinatorSnapshot info;
+    if (!storage->getProtoBuf(SNAPSHOT_NODE, &info))
+        return false;
+    if (info.version() == version)
+        return true;
+
+    vector<Object> chunks;
+    storage->getChildren(format("%s/%lu", SNAPSHOT_NODE,
+            info.version()).c_str(), &chunks);
+    if (chunks.size() != info.chunk_count()) {
+        LOG(WARNING, "Coordinator snapshot version %lu has %lu chunks "
+                "rather than %u; ignoring it", info.version(), chunks.size(),
+                info.chunk_count());
+        return false;
+    }
+    std::map<string, string> loaded;
+    foreach (Object& chunk, chunks) {
+        ProtoBuf::CoordinatorSnapshotChunk chunkInfo;
+        string str;
+        if (chunk.value != NULL)
+            str.assign(chunk.value, chunk.length);
+        if (!chunkInfo.ParseFromString(str)) {
+            throw FormatError(HERE, format("couldn't parse '%s' object in "
+                    "external storage as %s", chunk.name,
+                    chunkInfo.GetTypeName().c_str()));
+        }
+        foreach (const ProtoBuf::CoordinatorSnapshotChunk::Entry& entry,
+                chunkInfo.entry()) {
+            loaded[entry.name()] = entry.value();
+        }
+    }
+    objects.swap(loaded);
+    version = info.version();
+    appliedTailLength = 0;
+    return true;
+}
+
+/**
+ * Append names to the tail and generate the write that records the new
+ * tail on external storage.
+ *
+ * \param lock
+ *      Ensures that caller has acquired mutex; not actually used here.
+ * \param absNames
+ *      Absolute names of the objects about to be written or removed.
+ * \param[out] writes
+ *      The write for the tail is appended here; it must be done before
+ *      the objects are modified.
+ */
+void
+SnapshotStorage::recordTail(Lock& lock, const vector<string>& absNames,
+        vector<Write>* writes)
+{
+    tail.insert(tail.end(), absNames.begin(), absNames.end());
+    ProtoBuf::CoordinatorSnapshotTail info;
+    foreach (const string& name, tail) {
+        info.add_name(name);
+    }
+    string str;
+    info.SerializeToString(&str);
+    writes->emplace_back(UPDATE, TAIL_NODE, str);
+}
+
+/**
+ * This method is the main program for standbyThread: it keeps our copy of
+ * the snapshot and tail up to date until becomeLeader stops it.
+ */
+void
+SnapshotStorage::standbyMain()
+{
+    Lock lock(mutex);
+    while (!stopStandby) {
+        try {
+            if (loadSnapshot(lock))
+                applyTail(lock, false);
+        } catch (Exception& e) {
+            LOG(WARNING, "Couldn't refresh coordinator snapshot: %s",
+                    e.what());
+        }
+        standbyStopped.wait_for(lock,
+                std::chrono::milliseconds(standbyRefreshMs));
+    }
+}
+
+/**
+ * Write our copy of the objects to external storage as a new snapshot,
+ * which replaces the current one and the tail. Writes go in the order
+ * chunks, snapshot node, tail, so that a crash at any point leaves either
+ * the old or the new snapshot complete, with a tail that covers it.
+ *
+ * \param lock
+ *      Ensures that caller has acquired mutex; not actually used here.
+ */
+void
+SnapshotStorage::writeSnapshot(Lock& lock)
+{
+    ProtoBuf::CoordinatorSnapshot info;
+    uint64_t oldVersion = 0;
+    if (storage->getProtoBuf(SNAPSHOT_NODE, &info))
+        oldVersion = info.version();
+    uint64_t newVersion = ((oldVersion > version) ? oldVersion : version) + 1;
+    string chunkDirectory = format("%s/%lu", SNAPSHOT_NODE, newVersion);
+
+    // Discard the remains of any earlier attempt to write this version.
+    storage->remove(chunkDirectory.c_str());
+
+    vector<Write> writes;
+    ProtoBuf::CoordinatorSnapshotChunk chunk;
+    size_t chunkBytes = 0;
+    uint32_t chunkCount = 0;
+    std::map<string, string>::iterator it = objects.begin();
+    while (true) {
+        bool done = (it == objects.end());
+        if (done || ((chunkBytes > 0) && (chunkBytes + it->first.size()
+                + it->second.size() > maxChunkBytes))) {
+            if (chunkBytes > 0) {
+                string str;
+                chunk.SerializeToString(&str);
+                writes.emplace_back(CREATE, format("%s/%u",
+                        chunkDirectory.c_str(), chunkCount), str);
+                chunk.Clear();
+                chunkBytes = 0;
+                chunkCount++;
+            }
+            if (done)
+                break;
+        }
+        ProtoBuf::CoordinatorSnapshotChunk::Entry* entry = chunk.add_entry();
+        entry->set_name(it->first);
+        entry->set_value(it->second);
+        chunkBytes += it->first.size() + it->second.size();
+        it++;
+    }
+    if (!writes.empty())
+        storage->setMulti(writes);
+
+    writes.clear();
+    info.set_version(newVersion);
+    info.set_chunk_count(chunkCount);
+    string str;
+    info.SerializeToString(&str);
+    writes.emplace_back(UPDATE, SNAPSHOT_NODE, str);
+    ProtoBuf::CoordinatorSnapshotTail tailInfo;
+    tailInfo.SerializeToString(&str);
+    writes.emplace_back(UPDATE, TAIL_NODE, str);
+    storage->setMulti(writes);
+
+    if (oldVersion != 0) {
+        storage->remove(format("%s/%lu", SNAPSHOT_NODE,
+                oldVersion).c_str());
+    }
+    LOG(NOTICE, "Wrote coordinator snapshot version %lu: %lu objects in "
+            "%u chunks", newVersion, objects.size(), chunkCount);
+    version = newVersion;
+    tail.clear();
+    appliedTailLength = 0;
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,154 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_SNAPSHOTSTORAGE_H
+#define RAMCLOUD_SNAPSHOTSTORAGE_H
+
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <map>
+
+#include "ExternalStorage.h"
+#include "Tub.h"
+
+namespace RAMCloud {
+
+/**
+ * This class layers compact snapshots over another ExternalStorage, so
+ * that a new coordinator can take over without reading every table and
+ * server object individually. It is used by the coordinator in place of
+ * the real storage system.
+ *
+ * Once this coordinator is leader, the class keeps an in-memory copy of
+ * all of the objects in a few directories (such as "tables" and
+ * "servers"); getChildren for those directories is then served from
+ * memory. Before each write to one of the directories, the object's name
+ * is appended to a "tail" on external storage (in the same setMulti as
+ * the write itself, when possible). Every maxTailLength writes, the copy
+ * is written to external storage as a snapshot: a few large chunk objects
+ * that replace the tail.
+ *
+ * While this coordinator waits to become leader (in becomeLeader), it acts
+ * as a hot standby: it rereads the snapshot and tail at regular intervals.
+ * When it finally becomes leader, it only has to reread the objects named
+ * in the tail, which is a few round-trips to the storage system no matter
+ * how many tables there are. If there is no snapshot (e.g. the previous
+ * coordinator didn't use this class), the directories are read in full.
+ *
+ * This class is thread-safe.
+ */
+class SnapshotStorage: public ExternalStorage {
+  PUBLIC:
+    SnapshotStorage(ExternalStorage* storage,
+            const vector<string>& directories, uint32_t standbyRefreshMs);
+    virtual ~SnapshotStorage();
+    virtual void becomeLeader(const char* name, const string& leaderInfo);
+    virtual bool get(const char* name, Buffer* value);
+    virtual void getChildren(const char* name, vector<Object>* children);
+    virtual bool getLeaderInfo(const char* name, Buffer* value);
+    virtual void getMulti(const vector<string>& names,
+            vector<Object>* objects);
+    virtual void remove(const char* name);
+    virtual void set(Hint flavor, const char* name, const char* value,
+            int valueLength = -1);
+    virtual void setMulti(const vector<Write>& writes);
+    virtual void setWorkspace(const char* pathPrefix);
+
+    /// Name of the object that describes the current snapshot, relative
+    /// to the workspace; chunks are stored underneath it.
+    static const char* SNAPSHOT_NODE;
+
+    /// Name of the object that holds the tail, relative to the workspace.
+    static const char* TAIL_NODE;
+
+    /// Default value for maxTailLength.
+    static const size_t DEFAULT_MAX_TAIL_LENGTH = 500;
+
+    /// Default value for maxChunkBytes.
+    static const size_t DEFAULT_MAX_CHUNK_BYTES = 256*1024;
+
+  PRIVATE:
+    /// Monitor-style lock: acquired by all externally visible methods
+    /// except becomeLeader (which mustn't hold it while waiting).
+    std::mutex mutex;
+    typedef std::unique_lock<std::mutex> Lock;
+
+    /// The storage system that actually holds the objects. Owned by this
+    /// object.
+    ExternalStorage* storage;
+
+    /// Directories whose children are kept in the snapshot (relative
+    /// names, such as "tables").
+    vector<string> directories;
+
+    /// How often the standby rereads the snapshot and tail, in
+    /// milliseconds; 0 means don't refresh until becoming leader.
+    uint32_t standbyRefreshMs;
+
+    /// Every object in directories, as of the last refresh (or, once we
+    /// are leader, as of the last write). Keys are absolute names.
+    std::map<string, string> objects;
+
+    /// Names appended to the tail since the last snapshot (only used when
+    /// we are leader).
+    vector<string> tail;
+
+    /// Version of the snapshot that objects was built from; 0 means no
+    /// snapshot has been read or written.
+    uint64_t version;
+
+    /// Number of entries at the start of the tail on external storage
+    /// that have already been applied to objects.
+    size_t appliedTailLength;
+
+    /// True means we are leader: objects is complete and authoritative,
+    /// and writes to directories are recorded in the tail.
+    bool leader;
+
+    /// Runs standbyMain while becomeLeader waits.
+    Tub<std::thread> standbyThread;
+
+    /// Set to tell standbyThread to exit; protected by mutex.
+    bool stopStandby;
+
+    /// Notified when stopStandby is set.
+    std::condition_variable standbyStopped;
+
+    /// A snapshot is written whenever this many names have been appended
+    /// to the tail. Changed by unit tests.
+    size_t maxTailLength;
+
+    /// Upper limit on the size of each chunk of a snapshot; it must be
+    /// well under the largest object the storage system allows. Changed
+    /// by unit tests.
+    size_t maxChunkBytes;
+
+    void applyTail(Lock& lock, bool rereadAll);
+    void eraseTree(Lock& lock, const string& absName);
+    bool isTracked(Lock& lock, const string& absName);
+    void loadDirectories(Lock& lock);
+    bool loadSnapshot(Lock& lock);
+    void recordTail(Lock& lock, const vector<string>& absNames,
+            vector<Write>* writes);
+    void standbyMain();
+    void writeSnapshot(Lock& lock);
+
+    DISALLOW_COPY_AND_ASSIGN(SnapshotStorage);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_SNAPSHOTSTORAGE_H
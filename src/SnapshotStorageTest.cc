@@ -0,0 +1,427 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "CoordinatorSnapshot.pb.h"
+#include "MockExternalStorage.h"
+#include "SnapshotStorage.h"
+
+namespace RAMCloud {
+
+class SnapshotStorageTest : public ::testing::Test {
+  public:
+    TestLog::Enable logEnabler;
+    MockExternalStorage* mock;
+    SnapshotStorage storage;
+
+    SnapshotStorageTest()
+        : logEnabler()
+        , mock(new MockExternalStorage(true))
+        , storage(mock, {"tables", "servers"}, 0)
+    {}
+
+    // Arrange for the next unclaimed get on the mock to return the
+    // serialized form of a protocol buffer.
+    void pushProtoBuf(const google::protobuf::Message& message)
+    {
+        string str;
+        message.SerializeToString(&str);
+        mock->getResults.push(str);
+    }
+
+    // Arrange for the mock's next getChildren to return a snapshot chunk.
+    void pushChunk(const char* name,
+            const ProtoBuf::CoordinatorSnapshotChunk& chunk)
+    {
+        string str;
+        chunk.SerializeToString(&str);
+        mock->getChildrenNames.push(name);
+        mock->getChildrenValues.push(str);
+    }
+
+    // Return a description of the storage's copy of the objects.
+    string objectsToString()
+    {
+        string result;
+        for (std::map<string, string>::iterator it = storage.objects.begin();
+                it != storage.objects.end(); it++) {
+            if (!result.empty())
+                result += ", ";
+            result += it->first + "=" + it->second;
+        }
+        return result;
+    }
+
+    // Return the storage's tail, as a single string.
+    string tailToString()
+    {
+        string result;
+        foreach (const string& name, storage.tail) {
+            if (!result.empty())
+                result += " ";
+            result += name;
+        }
+        return result;
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(SnapshotStorageTest);
+};
+
+TEST_F(SnapshotStorageTest, becomeLeader_noSnapshot) {
+    mock->getChildrenNames.push("/tables/t1");
+    mock->getChildrenValues.push("abc");
+    storage.becomeLeader("coordinator", "locator");
+    EXPECT_EQ("becomeLeader(coordinator, locator); get(coordinatorSnapshot); "
+            "getChildren(tables); getChildren(servers); "
+            "get(coordinatorSnapshot); remove(coordinatorSnapshot/1); "
+            "set(CREATE, coordinatorSnapshot/1/0); "
+            "set(UPDATE, coordinatorSnapshot); "
+            "set(UPDATE, coordinatorSnapshotTail)", mock->log);
+    EXPECT_TRUE(storage.leader);
+    EXPECT_EQ(1u, storage.version);
+    EXPECT_EQ("/tables/t1=abc", objectsToString());
+    EXPECT_TRUE(TestUtil::contains(TestLog::get(),
+            "becomeLeader: Coordinator state loaded from directories: "
+            "1 objects"));
+}
+TEST_F(SnapshotStorageTest, becomeLeader_fromSnapshot) {
+    ProtoBuf::CoordinatorSnapshot info;
+    info.set_version(2);
+    info.set_chunk_count(1);
+    pushProtoBuf(info);
+    ProtoBuf::CoordinatorSnapshotChunk chunk;
+    ProtoBuf::CoordinatorSnapshotChunk::Entry* entry = chunk.add_entry();
+    entry->set_name("/tables/t1");
+    entry->set_value("old");
+    entry = chunk.add_entry();
+    entry->set_name("/tables/t2");
+    entry->set_value("x");
+    pushChunk("/coordinatorSnapshot/2/0", chunk);
+    ProtoBuf::CoordinatorSnapshotTail tailInfo;
+    tailInfo.add_name("/tables/t1");
+    pushProtoBuf(tailInfo);
+    mock->getResults.push("new");
+
+    storage.becomeLeader("coordinator", "locator");
+    EXPECT_EQ("becomeLeader(coordinator, locator); get(coordinatorSnapshot); "
+            "getChildren(coordinatorSnapshot/2); "
+            "get(coordinatorSnapshotTail); get(/tables/t1)", mock->log);
+    EXPECT_TRUE(storage.leader);
+    EXPECT_EQ("/tables/t1=new, /tables/t2=x", objectsToString());
+    EXPECT_EQ("/tables/t1", tailToString());
+    EXPECT_TRUE(TestUtil::contains(TestLog::get(),
+            "snapshot version 2 plus 1 tail entries: 2 objects"));
+}
+
+TEST_F(SnapshotStorageTest, getChildren_fromCopy) {
+    storage.leader = true;
+    storage.objects["/servers/1"] = "s";
+    storage.objects["/tables/a"] = "1";
+    storage.objects["/tables/b"] = "2";
+    storage.objects["/tables/b/c"] = "3";
+    storage.objects["/tablesX/d"] = "4";
+    vector<ExternalStorage::Object> children;
+    storage.getChildren("tables", &children);
+    EXPECT_EQ("", mock->log);
+    ASSERT_EQ(2u, children.size());
+    EXPECT_STREQ("/tables/a", children[0].name);
+    EXPECT_EQ("1", string(children[0].value, children[0].length));
+    EXPECT_STREQ("/tables/b", children[1].name);
+}
+TEST_F(SnapshotStorageTest, getChildren_notLeader) {
+    storage.objects["/tables/a"] = "1";
+    vector<ExternalStorage::Object> children;
+    storage.getChildren("tables", &children);
+    EXPECT_EQ("getChildren(tables)", mock->log);
+    EXPECT_EQ(0u, children.size());
+}
+
+TEST_F(SnapshotStorageTest, remove_tracked) {
+    storage.leader = true;
+    storage.objects["/tables/a"] = "1";
+    storage.objects["/tables/a/b"] = "2";
+    storage.objects["/tables/ab"] = "3";
+    storage.remove("tables/a");
+    EXPECT_EQ("set(UPDATE, coordinatorSnapshotTail); remove(tables/a)",
+            mock->log);
+    EXPECT_EQ("/tables/ab=3", objectsToString());
+    EXPECT_EQ("/tables/a", tailToString());
+}
+TEST_F(SnapshotStorageTest, remove_notTracked) {
+    storage.leader = true;
+    storage.remove("other");
+    EXPECT_EQ("remove(other)", mock->log);
+    EXPECT_EQ("", tailToString());
+}
+
+TEST_F(SnapshotStorageTest, set_notLeader) {
+    storage.set(ExternalStorage::CREATE, "tables/t1", "abc");
+    EXPECT_EQ("set(CREATE, tables/t1)", mock->log);
+    EXPECT_EQ("abc", mock->setData);
+    EXPECT_EQ("", objectsToString());
+}
+TEST_F(SnapshotStorageTest, set_tracked) {
+    storage.leader = true;
+    storage.set(ExternalStorage::CREATE, "tables/t1", "abc", 2);
+    EXPECT_EQ("set(UPDATE, coordinatorSnapshotTail); set(CREATE, tables/t1)",
+            mock->log);
+    EXPECT_EQ("ab", mock->setData);
+    EXPECT_EQ("/tables/t1=ab", objectsToString());
+    EXPECT_EQ("/tables/t1", tailToString());
+}
+TEST_F(SnapshotStorageTest, set_notTracked) {
+    storage.leader = true;
+    storage.set(ExternalStorage::UPDATE, "coordinatorUpdateManager", "x");
+    EXPECT_EQ("set(UPDATE, coordinatorUpdateManager)", mock->log);
+    EXPECT_EQ("", objectsToString());
+    EXPECT_EQ("", tailToString());
+}
+
+TEST_F(SnapshotStorageTest, setMulti_someTracked) {
+    storage.leader = true;
+    vector<ExternalStorage::Write> writes;
+    writes.emplace_back(ExternalStorage::UPDATE, "tables/t1", "a");
+    writes.emplace_back(ExternalStorage::UPDATE, "other", "b");
+    writes.emplace_back(ExternalStorage::CREATE, "/servers/1", "c");
+    storage.setMulti(writes);
+    EXPECT_EQ("set(UPDATE, coordinatorSnapshotTail); set(UPDATE, tables/t1); "
+            "set(UPDATE, other); set(CREATE, /servers/1)", mock->log);
+    EXPECT_EQ("/servers/1=c, /tables/t1=a", objectsToString());
+    EXPECT_EQ("/tables/t1 /servers/1", tailToString());
+}
+TEST_F(SnapshotStorageTest, setMulti_writesSnapshot) {
+    storage.leader = true;
+    storage.maxTailLength = 2;
+    storage.set(ExternalStorage::UPDATE, "tables/t1", "a");
+    mock->log.clear();
+    storage.set(ExternalStorage::UPDATE, "tables/t2", "b");
+    EXPECT_EQ("set(UPDATE, coordinatorSnapshotTail); set(UPDATE, tables/t2); "
+            "get(coordinatorSnapshot); remove(coordinatorSnapshot/1); "
+            "set(CREATE, coordinatorSnapshot/1/0); "
+            "set(UPDATE, coordinatorSnapshot); "
+            "set(UPDATE, coordinatorSnapshotTail)", mock->log);
+    EXPECT_EQ("", tailToString());
+    EXPECT_EQ(1u, storage.version);
+}
+
+TEST_F(SnapshotStorageTest, setWorkspace) {
+    storage.setWorkspace("/a/b/");
+    EXPECT_STREQ("/a/b/", storage.getWorkspace());
+    EXPECT_STREQ("/a/b/", mock->getWorkspace());
+}
+
+TEST_F(SnapshotStorageTest, applyTail_basics) {
+    SnapshotStorage::Lock lock(storage.mutex);
+    storage.objects["/tables/a"] = "old";
+    storage.objects["/tables/gone"] = "x";
+    storage.objects["/tables/keep"] = "k";
+    ProtoBuf::CoordinatorSnapshotTail info;
+    info.add_name("/tables/a");
+    info.add_name("/tables/gone");
+    info.add_name("/tables/a");
+    pushProtoBuf(info);
+    mock->getResults.push("new");
+    storage.applyTail(lock, false);
+    EXPECT_EQ("get(coordinatorSnapshotTail); get(/tables/a); "
+            "get(/tables/gone)", mock->log);
+    EXPECT_EQ("/tables/a=new, /tables/keep=k", objectsToString());
+    EXPECT_EQ(3u, storage.appliedTailLength);
+    EXPECT_EQ("", tailToString());
+}
+TEST_F(SnapshotStorageTest, applyTail_onlyNewEntries) {
+    SnapshotStorage::Lock lock(storage.mutex);
+    storage.appliedTailLength = 1;
+    ProtoBuf::CoordinatorSnapshotTail info;
+    info.add_name("/tables/a");
+    info.add_name("/tables/b");
+    pushProtoBuf(info);
+    mock->getResults.push("2");
+    storage.applyTail(lock, false);
+    EXPECT_EQ("get(coordinatorSnapshotTail); get(/tables/b)", mock->log);
+    EXPECT_EQ("/tables/b=2", objectsToString());
+    EXPECT_EQ(2u, storage.appliedTailLength);
+}
+TEST_F(SnapshotStorageTest, applyTail_rereadAll) {
+    SnapshotStorage::Lock lock(storage.mutex);
+    storage.appliedTailLength = 1;
+    ProtoBuf::CoordinatorSnapshotTail info;
+    info.add_name("/tables/a");
+    pushProtoBuf(info);
+    mock->getResults.push("1");
+    storage.applyTail(lock, true);
+    EXPECT_EQ("get(coordinatorSnapshotTail); get(/tables/a)", mock->log);
+    EXPECT_EQ("/tables/a=1", objectsToString());
+    EXPECT_EQ("/tables/a", tailToString());
+}
+TEST_F(SnapshotStorageTest, applyTail_tailReplaced) {
+    SnapshotStorage::Lock lock(storage.mutex);
+    storage.appliedTailLength = 5;
+    ProtoBuf::CoordinatorSnapshotTail info;
+    info.add_name("/tables/a");
+    pushProtoBuf(info);
+    storage.applyTail(lock, false);
+    EXPECT_EQ("get(coordinatorSnapshotTail)", mock->log);
+    EXPECT_EQ(1u, storage.appliedTailLength);
+}
+
+TEST_F(SnapshotStorageTest, isTracked) {
+    SnapshotStorage::Lock lock(storage.mutex);
+    EXPECT_TRUE(storage.isTracked(lock, "/tables"));
+    EXPECT_TRUE(storage.isTracked(lock, "/tables/t1"));
+    EXPECT_TRUE(storage.isTracked(lock, "/servers/1/x"));
+    EXPECT_TRUE(storage.isTracked(lock, "/"));
+    EXPECT_FALSE(storage.isTracked(lock, "/tablesX"));
+    EXPECT_FALSE(storage.isTracked(lock, "/coordinatorSnapshot"));
+    storage.setWorkspace("/ws/");
+    EXPECT_TRUE(storage.isTracked(lock, "/ws/tables/t1"));
+    EXPECT_FALSE(storage.isTracked(lock, "/tables/t1"));
+}
+
+TEST_F(SnapshotStorageTest, loadSnapshot_noSnapshot) {
+    SnapshotStorage::Lock lock(storage.mutex);
+    EXPECT_FALSE(storage.loadSnapshot(lock));
+    EXPECT_EQ("get(coordinatorSnapshot)", mock->log);
+}
+TEST_F(SnapshotStorageTest, loadSnapshot_basics) {
+    SnapshotStorage::Lock lock(storage.mutex);
+    storage.objects["/tables/stale"] = "x";
+    storage.appliedTailLength = 4;
+    ProtoBuf::CoordinatorSnapshot info;
+    info.set_version(3);
+    info.set_chunk_count(2);
+    pushProtoBuf(info);
+    ProtoBuf::CoordinatorSnapshotChunk chunk;
+    ProtoBuf::CoordinatorSnapshotChunk::Entry* entry = chunk.add_entry();
+    entry->set_name("/tables/a");
+    entry->set_value("1");
+    pushChunk("/coordinatorSnapshot/3/0", chunk);
+    chunk.Clear();
+    entry = chunk.add_entry();
+    entry->set_name("/servers/2");
+    entry->set_value("2");
+    pushChunk("/coordinatorSnapshot/3/1", chunk);
+
+    EXPECT_TRUE(storage.loadSnapshot(lock));
+    EXPECT_EQ("get(coordinatorSnapshot); getChildren(coordinatorSnapshot/3)",
+            mock->log);
+    EXPECT_EQ("/servers/2=2, /tables/a=1", objectsToString());
+    EXPECT_EQ(3u, storage.version);
+    EXPECT_EQ(0u, storage.appliedTailLength);
+}
+TEST_F(SnapshotStorageTest, loadSnapshot_sameVersion) {
+    SnapshotStorage::Lock lock(storage.mutex);
+    storage.objects["/tables/a"] = "1";
+    storage.version = 3;
+    ProtoBuf::CoordinatorSnapshot info;
+    info.set_version(3);
+    info.set_chunk_count(1);
+    pushProtoBuf(info);
+    EXPECT_TRUE(storage.loadSnapshot(lock));
+    EXPECT_EQ("get(coordinatorSnapshot)", mock->log);
+    EXPECT_EQ("/tables/a=1", objectsToString());
+}
+TEST_F(SnapshotStorageTest, loadSnapshot_missingChunk) {
+    SnapshotStorage::Lock lock(storage.mutex);
+    ProtoBuf::CoordinatorSnapshot info;
+    info.set_version(3);
+    info.set_chunk_count(2);
+    pushProtoBuf(info);
+    ProtoBuf::CoordinatorSnapshotChunk chunk;
+    pushChunk("/coordinatorSnapshot/3/0", chunk);
+    EXPECT_FALSE(storage.loadSnapshot(lock));
+    EXPECT_EQ("loadSnapshot: Coordinator snapshot version 3 has 1 chunks "
+            "rather than 2; ignoring it", TestLog::get());
+    EXPECT_EQ(0u, storage.version);
+}
+TEST_F(SnapshotStorageTest, loadSnapshot_badChunk) {
+    SnapshotStorage::Lock lock(storage.mutex);
+    ProtoBuf::CoordinatorSnapshot info;
+    info.set_version(3);
+    info.set_chunk_count(1);
+    pushProtoBuf(info);
+    mock->getChildrenNames.push("/coordinatorSnapshot/3/0");
+    mock->getChildrenValues.push("abc");
+    string message("no exception");
+    try {
+        storage.loadSnapshot(lock);
+    } catch (ExternalStorage::FormatError& e) {
+        message = e.message;
+    }
+    EXPECT_EQ("couldn't parse '/coordinatorSnapshot/3/0' object in external "
+            "storage as RAMCloud.ProtoBuf.CoordinatorSnapshotChunk", message);
+}
+
+TEST_F(SnapshotStorageTest, standbyMain) {
+    ProtoBuf::CoordinatorSnapshot info;
+    info.set_version(2);
+    info.set_chunk_count(0);
+    pushProtoBuf(info);
+    storage.standbyRefreshMs = 1;
+    std::thread thread(&SnapshotStorage::standbyMain, &storage);
+    for (int i = 0; i < 1000; i++) {
+        {
+            SnapshotStorage::Lock lock(storage.mutex);
+            if (storage.version == 2)
+                break;
+        }
+        usleep(1000);
+    }
+    {
+        SnapshotStorage::Lock lock(storage.mutex);
+        storage.stopStandby = true;
+        storage.standbyStopped.notify_all();
+    }
+    thread.join();
+    EXPECT_EQ(2u, storage.version);
+    EXPECT_EQ(0u, mock->log.find("get(coordinatorSnapshot); "
+            "getChildren(coordinatorSnapshot/2); "
+            "get(coordinatorSnapshotTail)"));
+}
+
+TEST_F(SnapshotStorageTest, writeSnapshot_chunks) {
+    SnapshotStorage::Lock lock(storage.mutex);
+    storage.objects["/tables/a"] = "12345";
+    storage.objects["/tables/b"] = "12345";
+    storage.objects["/tables/c"] = "12345";
+    storage.tail.push_back("/tables/a");
+    storage.maxChunkBytes = 20;
+    ProtoBuf::CoordinatorSnapshot info;
+    info.set_version(4);
+    info.set_chunk_count(1);
+    pushProtoBuf(info);
+    storage.writeSnapshot(lock);
+    EXPECT_EQ("get(coordinatorSnapshot); remove(coordinatorSnapshot/5); "
+            "set(CREATE, coordinatorSnapshot/5/0); "
+            "set(CREATE, coordinatorSnapshot/5/1); "
+            "set(CREATE, coordinatorSnapshot/5/2); "
+            "set(UPDATE, coordinatorSnapshot); "
+            "set(UPDATE, coordinatorSnapshotTail); "
+            "remove(coordinatorSnapshot/4)", mock->log);
+    EXPECT_EQ("writeSnapshot: Wrote coordinator snapshot version 5: "
+            "3 objects in 3 chunks", TestLog::get());
+    EXPECT_EQ(5u, storage.version);
+    EXPECT_EQ("", tailToString());
+}
+TEST_F(SnapshotStorageTest, writeSnapshot_empty) {
+    SnapshotStorage::Lock lock(storage.mutex);
+    storage.version = 2;
+    storage.writeSnapshot(lock);
+    EXPECT_EQ("get(coordinatorSnapshot); remove(coordinatorSnapshot/3); "
+            "set(UPDATE, coordinatorSnapshot); "
+            "set(UPDATE, coordinatorSnapshotTail)", mock->log);
+    EXPECT_EQ(3u, storage.version);
+}
+
+}  // namespace RAMCloud
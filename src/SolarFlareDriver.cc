@@ -351,6 +351,7 @@ SolarFlareDriver::refillRxRing()
  * Destroys a SolareFlareDriver and frees all the resources.
  */
 SolarFlareDriver::~SolarFlareDriver() {
+    releaseDeferred();
     if (buffsNotReleased != 0) {
         LOG(WARNING, "%lu packets are not released",
             buffsNotReleased);
@@ -392,13 +393,27 @@ SolarFlareDriver::getMaxPacketSize()
 /// See docs in the ``Driver'' class.
 void
 SolarFlareDriver::release(char* payload)
+{
+    // Packets released in workers are returned in batches by the dispatch
+    // thread.
+    if (deferRelease(context->dispatch, payload)) {
+        return;
+    }
+    releaseBatch(&payload, 1);
+}
+
+/// See docs in the ``Driver'' class.
+void
+SolarFlareDriver::releaseBatch(char** payloads, uint32_t count)
 {
     Dispatch::Lock _(context->dispatch);
-    assert(buffsNotReleased > 0);
-    buffsNotReleased--;
-    PacketBuff* packetBuff = reinterpret_cast<PacketBuff*>(payload
-            - OFFSET_OF(PacketBuff, dmaBuffer));
-    rxCopyPool.destroy(packetBuff);
+    for (uint32_t i = 0; i < count; i++) {
+        assert(buffsNotReleased > 0);
+        buffsNotReleased--;
+        PacketBuff* packetBuff = reinterpret_cast<PacketBuff*>(payloads[i]
+                - OFFSET_OF(PacketBuff, dmaBuffer));
+        rxCopyPool.destroy(packetBuff);
+    }
 }
 
 /// See docs in the ``Driver'' class.
@@ -528,6 +543,7 @@ void
 SolarFlareDriver::Poller::poll()
 {
     assert(driver->context->dispatch->isDispatchThread());
+    driver->releaseDeferred();
 
     // To receive packets, descriptors each identifying a buffer,
     // are queued in the RX ring. The event queue is a channel
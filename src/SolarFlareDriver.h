@@ -52,6 +52,7 @@ class SolarFlareDriver : public Driver {
     virtual void disconnect();
     virtual uint32_t getMaxPacketSize();
     virtual void release(char* payload);
+    virtual void releaseBatch(char** payloads, uint32_t count);
     virtual void sendPacket(const Driver::Address* recipient,
                             const void* header,
                             const uint32_t headerLen,
@@ -13,8 +13,10 @@
  * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <execinfo.h>
 #include <mutex>
 #include <unordered_set>
+#include <algorithm>
 
 #include "Common.h"
 #include "Cycles.h"
@@ -50,6 +52,41 @@ namespace SpinLockTable {
     }
 } // namespace SpinLockTable
 
+uint32_t SpinLock::profileInterval = 0;
+
+/**
+ * Return a human-readable description of a call site recorded by
+ * SpinLock::profileAcquisition: the (demangled) function containing the
+ * return address, and the offset within it.
+ */
+static string
+describeCaller(const void* caller)
+{
+    if (caller == NULL)
+        return "(other sites)";
+    void* address = const_cast<void*>(caller);
+    char** symbols = backtrace_symbols(&address, 1);
+    if (symbols == NULL)
+        return format("%p", caller);
+
+    // The symbol has the form "binary(mangledName+offset) [address]".
+    string symbol(symbols[0]);
+    free(symbols);
+    size_t open = symbol.find('(');
+    size_t plus = symbol.find('+', open);
+    if ((open == string::npos) || (plus == string::npos) ||
+            (plus == open + 1))
+        return symbol;
+    size_t close = symbol.find(')', plus);
+    string name = symbol.substr(open + 1, plus - open - 1);
+    try {
+        name = demangle(name.c_str());
+    } catch (FatalError& e) {
+        // Not a C++ name; leave it as is.
+    }
+    return name + symbol.substr(plus, close - plus);
+}
+
 /**
  * Construct a new SpinLock and give it the provided name.
  */
@@ -60,6 +97,9 @@ SpinLock::SpinLock(string name)
     , contendedAcquisitions(0)
     , contendedTicks(0)
     , logWaits(false)
+    , profile(NULL)
+    , holdSite(NULL)
+    , holdStart(0)
 {
     std::lock_guard<std::mutex> lock(*SpinLockTable::lock());
     SpinLockTable::allLocks()->insert(this);
@@ -69,6 +109,7 @@ SpinLock::~SpinLock()
 {
     std::lock_guard<std::mutex> lock(*SpinLockTable::lock());
     SpinLockTable::allLocks()->erase(this);
+    delete profile;
 }
 
 /**
@@ -79,10 +120,12 @@ void
 SpinLock::lock()
 {
     uint64_t startOfContention = 0;
+    uint64_t startOfWait = 0;
 
     while (mutex.exchange(1) != 0) {
         if (startOfContention == 0) {
             startOfContention = Cycles::rdtsc();
+            startOfWait = startOfContention;
             if (logWaits) {
                 RAMCLOUD_TEST_LOG("Waiting on SpinLock");
             }
@@ -99,11 +142,24 @@ SpinLock::lock()
     }
     Fence::enter();
 
+    uint64_t waitTicks = 0;
     if (startOfContention != 0) {
-        contendedTicks += (Cycles::rdtsc() - startOfContention);
+        uint64_t now = Cycles::rdtsc();
+        contendedTicks += (now - startOfContention);
         contendedAcquisitions++;
+        waitTicks = now - startOfWait;
     }
     acquisitions++;
+
+    if (profileInterval != 0) {
+        bool sampled = (acquisitions % profileInterval) == 0;
+        if (sampled || (waitTicks != 0)) {
+            // The return address identifies the caller, since lock is
+            // normally invoked from an inlined std::lock_guard constructor.
+            profileAcquisition(__builtin_return_address(0), waitTicks,
+                    sampled);
+        }
+    }
 }
 
 /**
@@ -132,10 +188,78 @@ SpinLock::try_lock()
 void
 SpinLock::unlock()
 {
+    if (holdSite != NULL) {
+        holdSite->holdSamples++;
+        holdSite->holdTicks += Cycles::rdtsc() - holdStart;
+        holdSite = NULL;
+    }
     Fence::leave();
     mutex.store(0);
 }
 
+/**
+ * Charge an acquisition of the lock to its call site; invoked by lock (with
+ * the lock held) when profiling is on and there is something to record.
+ *
+ * \param caller
+ *      Identifies the call site.
+ * \param waitTicks
+ *      Processor ticks spent waiting for the lock, or 0 if it was free.
+ * \param sampled
+ *      True means measure how long the lock is held this time.
+ */
+void
+SpinLock::profileAcquisition(const void* caller, uint64_t waitTicks,
+        bool sampled)
+{
+    if (profile == NULL)
+        profile = new Profile();
+
+    Site* site = NULL;
+    for (int i = 0; i < profile->numSites; i++) {
+        if (profile->sites[i].caller == caller) {
+            site = &profile->sites[i];
+            break;
+        }
+    }
+    if (site == NULL) {
+        if (profile->numSites < MAX_SITES) {
+            site = &profile->sites[profile->numSites];
+            profile->numSites++;
+            site->caller = caller;
+        } else {
+            site = &profile->sites[MAX_SITES - 1];
+            site->caller = NULL;
+        }
+    }
+
+    if (waitTicks != 0) {
+        site->contendedAcquisitions++;
+        site->waitTicks += waitTicks;
+    }
+    if (sampled) {
+        holdSite = site;
+        holdStart = Cycles::rdtsc();
+    }
+}
+
+/**
+ * Turn call-site profiling of all SpinLocks on or off. While it is on,
+ * every acquisition that has to wait for a lock is charged to the code
+ * that called lock, along with the time it waited, and a sample of
+ * acquisitions also measure how long the lock is then held. The
+ * results appear in getStatistics.
+ *
+ * \param sampleInterval
+ *      Measure the hold time of one in this many acquisitions of each
+ *      lock; 0 turns profiling off (statistics gathered so far are kept).
+ */
+void
+SpinLock::setProfiling(uint32_t sampleInterval)
+{
+    profileInterval = sampleInterval;
+}
+
 /**
  * Change the name of the SpinLock. The name is intended to give some hint as
  * to the purpose of the lock, where it was declared, etc.
@@ -170,10 +294,71 @@ SpinLock::getStatistics(ProtoBuf::SpinLockStatistics* stats)
         lock->set_acquisitions(spin->acquisitions);
         lock->set_contended_acquisitions(spin->contendedAcquisitions);
         lock->set_contended_nsec(Cycles::toNanoseconds(spin->contendedTicks));
+
+        // Heaviest waiters first.
+        Profile* profile = spin->profile;
+        if (profile != NULL) {
+            std::vector<Site> sites(profile->sites,
+                    profile->sites + profile->numSites);
+            std::sort(sites.begin(), sites.end(),
+                    [](const Site& a, const Site& b) {
+                        return a.waitTicks > b.waitTicks;
+                    });
+            foreach (const Site& site, sites) {
+                ProtoBuf::SpinLockStatistics_Site* entry = lock->add_sites();
+                entry->set_location(describeCaller(site.caller));
+                entry->set_contended_acquisitions(site.contendedAcquisitions);
+                entry->set_wait_nsec(Cycles::toNanoseconds(site.waitTicks));
+                entry->set_sampled_holds(site.holdSamples);
+                entry->set_sampled_hold_nsec(
+                        Cycles::toNanoseconds(site.holdTicks));
+            }
+        }
         it++;
     }
 }
 
+/**
+ * Return a report of the call sites that have waited the longest for
+ * locks, from the output of getStatistics (for any number of servers).
+ *
+ * \param stats
+ *      Lock statistics, normally gathered with profiling on.
+ * \param maxSites
+ *      Report at most this many sites.
+ * \return
+ *      One line per site, in decreasing order of total wait time.
+ */
+string
+SpinLock::getProfile(const ProtoBuf::SpinLockStatistics& stats, int maxSites)
+{
+    typedef std::pair<const ProtoBuf::SpinLockStatistics_Lock*,
+            const ProtoBuf::SpinLockStatistics_Site*> Entry;
+    std::vector<Entry> entries;
+    foreach (const ProtoBuf::SpinLockStatistics_Lock& lock, stats.locks()) {
+        foreach (const ProtoBuf::SpinLockStatistics_Site& site, lock.sites())
+            entries.push_back(Entry(&lock, &site));
+    }
+    std::sort(entries.begin(), entries.end(),
+            [](const Entry& a, const Entry& b) {
+                return a.second->wait_nsec() > b.second->wait_nsec();
+            });
+
+    string result = format("%10s %10s %10s  %s\n", "Wait (ms)", "Waits",
+            "Hold (ns)", "Lock / call site");
+    for (int i = 0; i < downCast<int>(entries.size()) && i < maxSites; i++) {
+        const ProtoBuf::SpinLockStatistics_Site* site = entries[i].second;
+        uint64_t holds = site->sampled_holds();
+        result.append(format("%10.3f %10lu %10lu  %s / %s\n",
+                static_cast<double>(site->wait_nsec()) / 1e06,
+                site->contended_acquisitions(),
+                (holds == 0) ? 0 : site->sampled_hold_nsec() / holds,
+                entries[i].first->name().c_str(),
+                site->location().c_str()));
+    }
+    return result;
+}
+
 /**
  * Return the total of SpinLocks currently in existence; intended
  * primarily for testing.
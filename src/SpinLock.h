@@ -43,7 +43,10 @@ class SpinLock {
     void unlock();
     void setName(string name);
     static void getStatistics(ProtoBuf::SpinLockStatistics* stats);
+    static string getProfile(const ProtoBuf::SpinLockStatistics& stats,
+            int maxSites);
     static int numLocks();
+    static void setProfiling(uint32_t sampleInterval);
 
     /*
      * This class automatically acquires a SpinLock on construction and
@@ -52,6 +55,47 @@ class SpinLock {
     typedef std::lock_guard<SpinLock> Guard;
 
   PRIVATE:
+    /**
+     * Statistics about the acquisitions of one lock from one call site,
+     * kept when profiling is on (see setProfiling).
+     */
+    struct Site {
+        /// Return address of the lock call, or NULL for the site that
+        /// collects the acquisitions from all sites after the first
+        /// MAX_SITES - 1.
+        const void* caller;
+
+        /// Number of acquisitions that had to wait.
+        uint64_t contendedAcquisitions;
+
+        /// Total processor ticks spent waiting by those acquisitions.
+        uint64_t waitTicks;
+
+        /// Number of acquisitions whose hold time was measured.
+        uint64_t holdSamples;
+
+        /// Total processor ticks for which those acquisitions held the lock.
+        uint64_t holdTicks;
+    };
+
+    /// Number of call sites distinguished for each lock.
+    static const int MAX_SITES = 16;
+
+    /// Per-site statistics for one lock; allocated the first time the
+    /// lock has something to record.
+    struct Profile {
+        Profile()
+            : sites()
+            , numSites(0)
+        {}
+
+        Site sites[MAX_SITES];
+        int numSites;
+    };
+
+    void profileAcquisition(const void* caller, uint64_t waitTicks,
+            bool sampled);
+
     /// Implements the lock: 0 means free, anything else means locked.
     Atomic<int> mutex;
 
@@ -73,6 +117,24 @@ class SpinLock {
 
     /// True means log when waiting for the lock; intended for unit tests only.
     bool logWaits;
+
+    /// Call-site statistics, or NULL if there haven't been any yet.
+    Profile* profile;
+
+    /// If the current acquisition's hold time is being measured, the site
+    /// it is charged to; otherwise NULL.
+    Site* holdSite;
+
+    /// Cycles::rdtsc time when the current acquisition began, if holdSite
+    /// isn't NULL.
+    uint64_t holdStart;
+
+    /// One in this many acquisitions (of each lock) has its hold time
+    /// measured, and every acquisition that has to wait is charged to its
+    /// call site; 0 means profiling is off.
+    static uint32_t profileInterval;
+
+    DISALLOW_COPY_AND_ASSIGN(SpinLock);
 };
 
 /**
@@ -192,4 +192,99 @@ TEST(SpinLockTest, getStatistics) {
         stats.ShortDebugString()));
 }
 
+TEST(SpinLockTest, lock_profiling) {
+    SpinLock lock("profiled");
+    lock.lock();
+    lock.unlock();
+    EXPECT_TRUE(lock.profile == NULL);
+
+    SpinLock::setProfiling(2);
+    lock.lock();
+    EXPECT_TRUE(lock.holdSite != NULL);
+    lock.unlock();
+    EXPECT_TRUE(lock.holdSite == NULL);
+    lock.lock();
+    EXPECT_TRUE(lock.holdSite == NULL);
+    lock.unlock();
+    SpinLock::setProfiling(0);
+
+    ASSERT_TRUE(lock.profile != NULL);
+    EXPECT_EQ(1, lock.profile->numSites);
+    EXPECT_TRUE(lock.profile->sites[0].caller != NULL);
+    EXPECT_EQ(1U, lock.profile->sites[0].holdSamples);
+    EXPECT_EQ(0U, lock.profile->sites[0].contendedAcquisitions);
+}
+
+TEST(SpinLockTest, profileAcquisition) {
+    SpinLock lock("profiled");
+    int callers[SpinLock::MAX_SITES + 1];
+    lock.profileAcquisition(&callers[0], 100, false);
+    lock.profileAcquisition(&callers[0], 50, true);
+    EXPECT_EQ(&lock.profile->sites[0], lock.holdSite);
+    lock.holdSite = NULL;
+    EXPECT_EQ(1, lock.profile->numSites);
+    EXPECT_EQ(2U, lock.profile->sites[0].contendedAcquisitions);
+    EXPECT_EQ(150U, lock.profile->sites[0].waitTicks);
+
+    // Sites beyond the table's capacity share the last entry.
+    for (int i = 1; i <= SpinLock::MAX_SITES; i++)
+        lock.profileAcquisition(&callers[i], 10, false);
+    EXPECT_EQ(SpinLock::MAX_SITES, lock.profile->numSites);
+    SpinLock::Site* last = &lock.profile->sites[SpinLock::MAX_SITES - 1];
+    EXPECT_TRUE(last->caller == NULL);
+    EXPECT_EQ(2U, last->contendedAcquisitions);
+}
+
+TEST(SpinLockTest, getStatistics_sites) {
+    SpinLock lock("Led Zeppelin");
+    int callers[2];
+    lock.profileAcquisition(&callers[0], Cycles::fromNanoseconds(1000),
+            false);
+    lock.profileAcquisition(&callers[1], Cycles::fromNanoseconds(3000),
+            false);
+    lock.profile->sites[1].caller = NULL;
+
+    ProtoBuf::SpinLockStatistics stats;
+    SpinLock::getStatistics(&stats);
+    const ProtoBuf::SpinLockStatistics_Lock* entry = NULL;
+    foreach (const ProtoBuf::SpinLockStatistics_Lock& l, stats.locks()) {
+        if (l.name() == "Led Zeppelin")
+            entry = &l;
+    }
+    ASSERT_TRUE(entry != NULL);
+    ASSERT_EQ(2, entry->sites_size());
+    EXPECT_EQ("(other sites)", entry->sites(0).location());
+    EXPECT_EQ(3000U, entry->sites(0).wait_nsec());
+    EXPECT_EQ(1000U, entry->sites(1).wait_nsec());
+}
+
+TEST(SpinLockTest, getProfile) {
+    ProtoBuf::SpinLockStatistics stats;
+    ProtoBuf::SpinLockStatistics_Lock* lock = stats.add_locks();
+    lock->set_name("lock1");
+    lock->set_acquisitions(10);
+    lock->set_contended_acquisitions(3);
+    lock->set_contended_nsec(3000000);
+    ProtoBuf::SpinLockStatistics_Site* site = lock->add_sites();
+    site->set_location("f1+0x10");
+    site->set_contended_acquisitions(1);
+    site->set_wait_nsec(1000000);
+    site->set_sampled_holds(2);
+    site->set_sampled_hold_nsec(300);
+    site = lock->add_sites();
+    site->set_location("f2+0x20");
+    site->set_contended_acquisitions(2);
+    site->set_wait_nsec(2000000);
+    site->set_sampled_holds(0);
+    site->set_sampled_hold_nsec(0);
+
+    EXPECT_EQ(" Wait (ms)      Waits  Hold (ns)  Lock / call site\n"
+            "     2.000          2          0  lock1 / f2+0x20\n"
+            "     1.000          1        150  lock1 / f1+0x10\n",
+            SpinLock::getProfile(stats, 10));
+    EXPECT_EQ(" Wait (ms)      Waits  Hold (ns)  Lock / call site\n"
+            "     2.000          2          0  lock1 / f2+0x20\n",
+            SpinLock::getProfile(stats, 1));
+}
+
 }  // namespace RAMCloud
@@ -0,0 +1,235 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "StripedStorage.h"
+#include "ClientException.h"
+#include "ShortMacros.h"
+
+namespace RAMCloud {
+
+/**
+ * Create a StripedStorage.
+ *
+ * \param segmentSize
+ *      The size in bytes of the segments this storage will deal with.
+ * \param frameCount
+ *      The total number of segments this storage can store simultaneously;
+ *      divided evenly among the devices.
+ * \param writeRateLimit
+ *      When specified, writes to this storage instance should be limited
+ *      to at most the given rate (in megabytes per second), in aggregate
+ *      across all of the devices. The special value 0 turns off throttling.
+ * \param maxWriteBuffers
+ *      Limit on the number of segment replicas representing new data from
+ *      masters that can be stored in memory at any given time; divided
+ *      evenly among the devices.
+ * \param filePaths
+ *      Filesystem paths to the devices or files where segments will be
+ *      stored, one per device. Must not be empty.
+ * \param openFlags
+ *      Extra flags for use while opening the files (see SingleFileStorage).
+ * \param mapLoads
+ *      Whether replicas are mapped rather than read into buffers when they
+ *      are loaded (see SingleFileStorage).
+ */
+StripedStorage::StripedStorage(size_t segmentSize,
+                               size_t frameCount,
+                               size_t writeRateLimit,
+                               size_t maxWriteBuffers,
+                               const std::vector<string>& filePaths,
+                               int openFlags,
+                               bool mapLoads)
+    : BackupStorage(segmentSize, Type::DISK, writeRateLimit)
+    , mutex()
+    , devices()
+    , nextDevice(0)
+{
+    if (filePaths.empty()) {
+        throw BackupStorageException(HERE,
+              "No backup storage files given for striping");
+    }
+    size_t count = filePaths.size();
+    for (size_t i = 0; i < count; i++) {
+        // Give the first (frameCount % count) devices one extra frame, so
+        // that the total is exactly frameCount.
+        size_t deviceFrames = frameCount / count +
+                              ((i < frameCount % count) ? 1 : 0);
+        size_t deviceWriteRateLimit = 0;
+        if (writeRateLimit != 0)
+            deviceWriteRateLimit = std::max(writeRateLimit / count, 1LU);
+        size_t deviceWriteBuffers = std::max(
+                (maxWriteBuffers + count - 1) / count, 1LU);
+        devices.emplace_back(new SingleFileStorage(segmentSize,
+                                                   deviceFrames,
+                                                   deviceWriteRateLimit,
+                                                   deviceWriteBuffers,
+                                                   filePaths[i].c_str(),
+                                                   openFlags,
+                                                   mapLoads));
+    }
+    LOG(NOTICE, "Striping backup storage across %lu devices", count);
+}
+
+/**
+ * Allocate a frame on storage, resetting its state to accept appends for a
+ * new replica. The frame comes from the device with the fewest replicas
+ * waiting to be written; if that device can't accept a new replica, the
+ * others are tried in turn. See BackupStorage::open() for details.
+ *
+ * \throw BackupOpenRejectedException
+ *      None of the devices has a free frame and write buffer.
+ */
+StripedStorage::FrameRef
+StripedStorage::open(bool sync)
+{
+    size_t start;
+    {
+        Lock lock(mutex);
+        start = nextDevice;
+    }
+
+    // Order the devices by number of buffered writes, breaking ties in
+    // round-robin order starting at #start.
+    std::vector<std::pair<size_t, size_t>> candidates;
+    for (size_t i = 0; i < devices.size(); i++) {
+        size_t device = (start + i) % devices.size();
+        candidates.emplace_back(devices[device]->getWriteBuffersInUse(), i);
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    foreach (auto& candidate, candidates) {
+        size_t device = (start + candidate.second) % devices.size();
+        try {
+            FrameRef frame = devices[device]->open(sync);
+            Lock lock(mutex);
+            nextDevice = (device + 1) % devices.size();
+            return frame;
+        } catch (const BackupOpenRejectedException&) {
+            // Try the next device.
+        }
+    }
+    RAMCLOUD_CLOG(NOTICE, "Master tried to open a storage frame but no "
+        "device can accept one; rejecting");
+    throw BackupOpenRejectedException(HERE);
+}
+
+/**
+ * Benchmark each of the devices. Since the devices transfer data in
+ * parallel, the result is the sum of their individual speeds (except for
+ * EVEN_DISTRIBUTION, which doesn't depend on speed).
+ */
+uint32_t
+StripedStorage::benchmark(BackupStrategy backupStrategy)
+{
+    uint32_t total = 0;
+    foreach (auto& device, devices)
+        total += device->benchmark(backupStrategy);
+    if (backupStrategy == EVEN_DISTRIBUTION)
+        return total / downCast<uint32_t>(devices.size());
+    return total;
+}
+
+/**
+ * Returns the maximum number of bytes of metadata that can be stored
+ * which each append(). See BackupStorage::getMetadataSize().
+ */
+size_t
+StripedStorage::getMetadataSize()
+{
+    return devices[0]->getMetadataSize();
+}
+
+/**
+ * Return the total number of replicas buffered in memory waiting to be
+ * written across all of the devices. See
+ * BackupStorage::getWriteBuffersInUse().
+ */
+size_t
+StripedStorage::getWriteBuffersInUse()
+{
+    size_t total = 0;
+    foreach (auto& device, devices)
+        total += device->getWriteBuffersInUse();
+    return total;
+}
+
+/**
+ * Marks ALL storage frames on all devices as allocated and loads their
+ * metadata. See BackupStorage::loadAllMetadata().
+ */
+std::vector<BackupStorage::FrameRef>
+StripedStorage::loadAllMetadata()
+{
+    std::vector<FrameRef> ret;
+    foreach (auto& device, devices) {
+        std::vector<FrameRef> frames = device->loadAllMetadata();
+        ret.insert(ret.end(), frames.begin(), frames.end());
+    }
+    return ret;
+}
+
+/**
+ * Overwrite the superblock on every device. See
+ * BackupStorage::resetSuperblock().
+ */
+void
+StripedStorage::resetSuperblock(ServerId serverId,
+                                const string& clusterName,
+                                const uint32_t frameSkipMask)
+{
+    foreach (auto& device, devices)
+        device->resetSuperblock(serverId, clusterName, frameSkipMask);
+}
+
+/**
+ * Return the most up-to-date superblock found on any of the devices (they
+ * can differ if the backup crashed in the middle of resetSuperblock()).
+ * See BackupStorage::loadSuperblock().
+ */
+BackupStorage::Superblock
+StripedStorage::loadSuperblock()
+{
+    Superblock newest = devices[0]->loadSuperblock();
+    for (size_t i = 1; i < devices.size(); i++) {
+        Superblock superblock = devices[i]->loadSuperblock();
+        if (superblock.version > newest.version)
+            newest = superblock;
+    }
+    return newest;
+}
+
+/**
+ * Return only after all data appended to all Frames on all devices prior
+ * to this call has been flushed to storage.
+ */
+void
+StripedStorage::quiesce()
+{
+    foreach (auto& device, devices)
+        device->quiesce();
+}
+
+/**
+ * Scribble on the metadata blocks of all frames on all devices. See
+ * BackupStorage::fry().
+ */
+void
+StripedStorage::fry()
+{
+    foreach (auto& device, devices)
+        device->fry();
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,80 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_STRIPEDSTORAGE_H
+#define RAMCLOUD_STRIPEDSTORAGE_H
+
+#include <memory>
+
+#include "Common.h"
+#include "BackupStorage.h"
+#include "SingleFileStorage.h"
+
+namespace RAMCloud {
+
+/**
+ * A BackupStorage backend which spreads replicas across several files or
+ * disk devices. Each device is managed by its own SingleFileStorage, so
+ * each has an independent IO queue and thread, and the devices transfer
+ * data in parallel. Each replica lives entirely on one device; open()
+ * places new replicas on the device with the fewest buffered writes.
+ *
+ * Because replicas are spread over the devices as they are written,
+ * consecutive segments of a master's log generally land on different
+ * devices, so the replicas loaded by a BackupMasterRecovery are read
+ * from all of the devices concurrently.
+ */
+class StripedStorage : public BackupStorage {
+  public:
+    StripedStorage(size_t segmentSize,
+                   size_t frameCount,
+                   size_t writeRateLimit,
+                   size_t maxNonVolatileBuffers,
+                   const std::vector<string>& filePaths,
+                   int openFlags = 0,
+                   bool mapLoads = false);
+
+    FrameRef open(bool sync);
+    uint32_t benchmark(BackupStrategy backupStrategy);
+    size_t getMetadataSize();
+    size_t getWriteBuffersInUse();
+    std::vector<FrameRef> loadAllMetadata();
+    void resetSuperblock(ServerId serverId,
+                         const string& clusterName,
+                         uint32_t frameSkipMask = 0);
+    Superblock loadSuperblock();
+    void quiesce();
+    void fry();
+
+  PRIVATE:
+    /// Protects #nextDevice.
+    std::mutex mutex;
+    typedef std::unique_lock<std::mutex> Lock;
+
+    /// One entry for each file or device, in the order given to the
+    /// constructor.
+    std::vector<std::unique_ptr<SingleFileStorage>> devices;
+
+    /// Device open() considers first when several are equally loaded:
+    /// the one after the device most recently opened, so that equally
+    /// loaded devices are used in turn.
+    size_t nextDevice;
+
+    DISALLOW_COPY_AND_ASSIGN(StripedStorage);
+};
+
+} // namespace RAMCloud
+
+#endif
@@ -0,0 +1,123 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "ClientException.h"
+#include "StripedStorage.h"
+
+namespace RAMCloud {
+
+class StripedStorageTest : public ::testing::Test {
+  public:
+    typedef SingleFileStorage::Frame Frame;
+
+    uint32_t segmentSize;
+    std::vector<string> files;
+    Tub<StripedStorage> storage;
+
+    StripedStorageTest()
+        : segmentSize(SingleFileStorage::BLOCK_SIZE * 4)
+        , files()
+        , storage()
+    {
+        Logger::get().setLogLevels(SILENT_LOG_LEVEL);
+        // Empty paths make each device a temporary file.
+        files.push_back("");
+        files.push_back("");
+        storage.construct(segmentSize, 5, 0, 4, files, 0);
+        Frame::testingSkipRealIo = true;
+    }
+
+    ~StripedStorageTest()
+    {
+        Frame::testingSkipRealIo = false;
+    }
+
+    /// Return the index of the device holding \a frame.
+    size_t
+    deviceOf(const BackupStorage::FrameRef& frame)
+    {
+        SingleFileStorage* device =
+            static_cast<Frame*>(frame.get())->storage;
+        for (size_t i = 0; i < storage->devices.size(); i++) {
+            if (storage->devices[i].get() == device)
+                return i;
+        }
+        return ~0LU;
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(StripedStorageTest);
+};
+
+TEST_F(StripedStorageTest, constructor) {
+    ASSERT_EQ(2U, storage->devices.size());
+    EXPECT_EQ(3U, storage->devices[0]->frameCount);
+    EXPECT_EQ(2U, storage->devices[1]->frameCount);
+    EXPECT_EQ(2U, storage->devices[0]->maxWriteBuffers);
+    EXPECT_EQ(2U, storage->devices[1]->maxWriteBuffers);
+}
+
+TEST_F(StripedStorageTest, constructor_noFiles) {
+    std::vector<string> none;
+    EXPECT_THROW(StripedStorage(segmentSize, 5, 0, 4, none, 0),
+                 BackupStorageException);
+}
+
+TEST_F(StripedStorageTest, open_leastLoadedDevice) {
+    BackupStorage::FrameRef first = storage->open(false);
+    EXPECT_EQ(0U, deviceOf(first));
+
+    // Device 0 would be next in turn, but it already has a buffered
+    // replica.
+    storage->nextDevice = 0;
+    BackupStorage::FrameRef second = storage->open(false);
+    EXPECT_EQ(1U, deviceOf(second));
+
+    // Equally loaded: take turns.
+    BackupStorage::FrameRef third = storage->open(false);
+    EXPECT_EQ(0U, deviceOf(third));
+}
+
+TEST_F(StripedStorageTest, open_deviceFull) {
+    std::vector<string> twoFiles(2, "");
+    storage.construct(segmentSize, 2, 0, 4, twoFiles, 0);
+    BackupStorage::FrameRef first = storage->open(false);
+    EXPECT_EQ(0U, deviceOf(first));
+    first->close();
+    storage->quiesce();
+    EXPECT_EQ(0U, storage->devices[0]->getWriteBuffersInUse());
+
+    // Device 0 is first in line but has no free frames.
+    storage->nextDevice = 0;
+    BackupStorage::FrameRef second = storage->open(false);
+    EXPECT_EQ(1U, deviceOf(second));
+
+    EXPECT_THROW(storage->open(false), BackupOpenRejectedException);
+}
+
+TEST_F(StripedStorageTest, loadAllMetadata) {
+    EXPECT_EQ(5U, storage->loadAllMetadata().size());
+}
+
+TEST_F(StripedStorageTest, loadSuperblock) {
+    storage->resetSuperblock({99, 0}, "cluster");
+    storage->devices[1]->resetSuperblock({100, 0}, "cluster");
+    auto superblock = storage->loadSuperblock();
+    EXPECT_EQ(ServerId(100, 0), superblock.getServerId());
+    EXPECT_EQ(storage->devices[1]->loadSuperblock().version,
+              superblock.version);
+}
+
+}  // namespace RAMCloud
@@ -92,6 +92,11 @@ class Syscall {
                 value, NULL, NULL, 0));
     }
     VIRTUAL_FOR_TESTING
+    int futexWaitTimeout(int *addr, int value, const timespec* timeout) {
+        return static_cast<int>(::syscall(SYS_futex, addr, FUTEX_WAIT,
+                value, timeout, NULL, 0));
+    }
+    VIRTUAL_FOR_TESTING
     int futexWake(int *addr, int count) {
         return static_cast<int>(::syscall(SYS_futex, addr, FUTEX_WAKE,
                 count, NULL, NULL, 0));
@@ -130,6 +135,11 @@ class Syscall {
         return ::recvfrom(sockfd, buf, len, flags, from, fromLen);
     }
     VIRTUAL_FOR_TESTING
+    int recvmmsg(int sockfd, mmsghdr *msgvec, unsigned int vlen, int flags,
+                 timespec *timeout) {
+        return ::recvmmsg(sockfd, msgvec, vlen, flags, timeout);
+    }
+    VIRTUAL_FOR_TESTING
     int select(int nfds, fd_set *readfds, fd_set *writefds,
            fd_set *errorfds, struct timeval *timeout)
     {
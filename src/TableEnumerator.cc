@@ -31,19 +31,27 @@ namespace RAMCloud {
  *      and data. True means that the returned objects have
  *      been truncated so that the object data (normally the last
  *      field of the object) is omitted.
+ * \param filter
+ *      If non-NULL, only the objects that match this filter are returned,
+ *      with just the part of their values that it selects. The filter is
+ *      copied, so it needn't outlive this call.
  */
 TableEnumerator::TableEnumerator(RamCloud& ramcloud,
                                 uint64_t tableId,
-                                bool keysOnly)
+                                bool keysOnly,
+                                const ObjectFilter* filter)
     : ramcloud(ramcloud)
     , tableId(tableId)
     , keysOnly(keysOnly)
+    , filter()
     , tabletStartHash(0)
     , done(false)
     , state()
     , objects()
     , nextOffset(0)
 {
+    if (filter != NULL)
+        this->filter.construct(*filter);
 }
 
 /**
@@ -183,7 +191,8 @@ TableEnumerator::requestMoreObjects()
     nextOffset = 0;
     while (true) {
         tabletStartHash = ramcloud.enumerateTable(tableId, keysOnly,
-                                            tabletStartHash, state, objects);
+                                            tabletStartHash, state, objects,
+                                            filter.get());
         if (objects.size() > 0) {
             return;
         }
@@ -18,6 +18,8 @@
 
 #include "RamCloud.h"
 #include "Object.h"
+#include "ObjectFilter.h"
+#include "Tub.h"
 
 namespace RAMCloud {
 
@@ -28,7 +30,8 @@ namespace RAMCloud {
  */
 class TableEnumerator {
   public:
-    TableEnumerator(RamCloud& ramCloud, uint64_t tableId, bool keysOnly);
+    TableEnumerator(RamCloud& ramCloud, uint64_t tableId, bool keysOnly,
+            const ObjectFilter* filter = NULL);
     bool hasNext();
     void next(uint32_t* size, const void** object);
     void nextObjectBlob(Buffer** buffer);
@@ -49,6 +52,10 @@ class TableEnumerator {
     /// field of the object) is omitted.
     bool keysOnly;
 
+    /// If set, the masters return only the objects that match this
+    /// filter, with just the part of their values that it selects.
+    Tub<ObjectFilter> filter;
+
     /// The start hash of the tablet being enumerated.
     uint64_t tabletStartHash;
 
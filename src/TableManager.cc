@@ -13,6 +13,8 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <set>
+
 #include "CoordinatorServerList.h"
 #include "CoordinatorService.h"
 #include "IndexKey.h"
@@ -41,6 +43,7 @@ TableManager::TableManager(Context* context,
     , tabletMaster()
     , directory()
     , idMap()
+    , serverTablets()
     , backingTableMap()
 {
     context->tableManager = this;
@@ -115,6 +118,9 @@ TableManager::Index::~Index()
  *      is being split doesn't exist anymore.
  * \throw NoSuchTable
  *      If tableId does not specify an existing table.
+ * \throw InvalidParameterException
+ *      If the index isn't a B+ tree index, or newOwner already owns the
+ *      indexlet.
  */
 void
 TableManager::coordSplitAndMigrateIndexlet(
@@ -133,6 +139,14 @@ TableManager::coordSplitAndMigrateIndexlet(
         throw NoSuchIndexlet(HERE);
     Index* index = indexIter->second;
 
+    // Migration selects the B+ tree nodes that belong to each half of the
+    // split; there is no equivalent for the buckets of a hash index.
+    if (index->indexType != IndexKey::BTREE_INDEX) {
+        RAMCLOUD_LOG(NOTICE, "Can't split indexlets of index %u in table "
+                "'%lu': not a B+ tree index", indexId, tableId);
+        throw InvalidParameterException(HERE);
+    }
+
     TableManager::Indexlet* indexlet =
             findIndexlet(lock, index, splitKey, splitKeyLength);
 
@@ -143,6 +157,13 @@ TableManager::coordSplitAndMigrateIndexlet(
             indexlet->firstKey, indexlet->firstKeyLength) == 0)
         return;
 
+    if (indexlet->serverId == newOwner) {
+        RAMCLOUD_LOG(NOTICE, "Can't split indexlet of index %u in table "
+                "'%lu': %s already owns it", indexId, tableId,
+                newOwner.toString().c_str());
+        throw InvalidParameterException(HERE);
+    }
+
     // Save the firstNotOwnedKey from the original indexlet as we will
     // end up changing this information in the original indexlet.
     uint16_t firstNotOwnedKeyLength = indexlet->firstNotOwnedKeyLength;
@@ -196,23 +217,35 @@ TableManager::coordSplitAndMigrateIndexlet(
  * \param tableId
  *      Id of the table to which the index belongs.
  * \param indexId
- *      Id of the secondary key on which the index is being built.
+ *      Id of the key on which the index is being built: 1 or more for a
+ *      secondary key, or 0 for the primary key. An index on the primary key
+ *      keeps the table's primary keys in order, so that ranges of them can
+ *      be scanned with IndexLookup; it must be a B+ tree index.
  * \param indexType
- *      Type of the keys corresponding to this index.
- *      Currently only string keys are supported, so this parameter is not yet
- *      used (i.e., caller can provide any value).
+ *      How entries of the index will be stored: an IndexKey::IndexType.
+ *      Hash indexes only support equality lookups.
  * \param numIndexlets
  *      Number of indexlets to partition the index key space.
  *      This is only for performance testing, and value should always be 1 for
  *      real use.
+ *
+ * If the table already contains objects, the masters storing its tablets
+ * are asked to add entries for them to the new index; they do this in the
+ * background, after this method returns.
  */
 void
 TableManager::createIndex(uint64_t tableId, uint8_t indexId, uint8_t indexType,
         uint8_t numIndexlets)
 {
-    if (indexId == 0) {
-        RAMCLOUD_LOG(NOTICE, "Invalid index id %u. Secondary keys have "
-                             "index id greater than 0.", indexId);
+    if (indexId == 0 && indexType != IndexKey::BTREE_INDEX) {
+        RAMCLOUD_LOG(NOTICE, "Invalid index type %u for the primary key "
+                             "index; only B+ tree indexes can hold ranges "
+                             "of primary keys.", indexType);
+        throw InvalidParameterException(HERE);
+    }
+    if (indexType != IndexKey::BTREE_INDEX &&
+            indexType != IndexKey::HASH_INDEX) {
+        RAMCLOUD_LOG(NOTICE, "Invalid index type %u.", indexType);
         throw InvalidParameterException(HERE);
     }
 
@@ -295,7 +328,24 @@ TableManager::createIndex(uint64_t tableId, uint8_t indexId, uint8_t indexType,
 
     table->indexMap[indexId] = index;
     notifyCreateIndex(lock, index);
-    return;
+
+    // The masters will look up the new indexlets while building the index,
+    // which requires the lock.
+    std::set<ServerId> masters;
+    foreach (Tablet* tablet, table->tablets)
+        masters.insert(tablet->serverId);
+    lock.unlock();
+    foreach (ServerId serverId, masters) {
+        try {
+            MasterClient::buildIndex(context, serverId, tableId, indexId);
+        } catch (ServerNotUpException& e) {
+            // The master's tablets will be recovered elsewhere; objects
+            // there won't be indexed until they are rewritten.
+            LOG(NOTICE, "buildIndex skipped for master %s (table %lu, "
+                    "index %u) because server isn't running",
+                    serverId.toString().c_str(), tableId, indexId);
+        }
+    }
 }
 
 /**
@@ -489,6 +539,13 @@ TableManager::getIndexletInfoByBackingTableId(uint64_t backingTableId,
     indexlet.set_index_id(it->second->indexId);
     indexlet.set_backing_table_id(it->second->backingTableId);
     indexlet.set_server_id(it->second->serverId.getId());
+    IdMap::iterator table = idMap.find(it->second->tableId);
+    if (table != idMap.end()) {
+        IndexMap::iterator index =
+                table->second->indexMap.find(it->second->indexId);
+        if (index != table->second->indexMap.end())
+            indexlet.set_index_type(index->second->indexType);
+    }
     return true;
 }
 
@@ -585,15 +642,14 @@ TableManager::markAllTabletsRecovering(ServerId serverId)
 {
     Lock lock(mutex);
     vector<Tablet> results;
-    for (Directory::iterator it = directory.begin(); it != directory.end();
-            ++it) {
-        Table* table = it->second;
-        foreach (Tablet* tablet, table->tablets) {
-            if (tablet->serverId == serverId) {
-                tablet->status = Tablet::RECOVERING;
-                results.push_back(*tablet);
-            }
-        }
+    ServerTabletMap::iterator it = serverTablets.find(serverId.getId());
+    if (it == serverTablets.end())
+        return results;
+    for (OwnedTablets::iterator tit = it->second.begin();
+            tit != it->second.end(); ++tit) {
+        Tablet* tablet = tit->second;
+        tablet->status = Tablet::RECOVERING;
+        results.push_back(*tablet);
     }
     return results;
 }
@@ -649,7 +705,7 @@ TableManager::reassignTabletOwnership(
     LogPosition headOfLogAtCreation(ctimeSegmentId,
                                       ctimeSegmentOffset);
     tablet->ctime = headOfLogAtCreation;
-    tablet->serverId = newOwner;
+    setTabletOwner(lock, tablet, newOwner);
     tablet->status = Tablet::NORMAL;
 
     // Record information about the new assignment in external storage,
@@ -747,18 +803,60 @@ TableManager::recover(uint64_t lastCompletedUpdate)
 }
 
 /**
- * Fills in a protocol buffer with information describing which masters store
- * which pieces of data for a given table (including both tablets and indexes).
- * \param tableConfig
- *      Protocol buffer to which entries are added representing each of
- *      the tablets and indexes for a given table.
+ * Replace all of the tablet map with a new copy of the table metadata.
+ * This is used by coordinator read replicas (see
+ * CoordinatorReplicaService), which follow the table metadata that the
+ * leader keeps on external storage. Unlike recover, this method never
+ * contacts any masters, and it leaves any operations that were in progress
+ * for the leader to finish.
+ *
+ * \param tables
+ *      Metadata for each table, read from external storage; tables that
+ *      have been deleted are ignored.
+ */
+void
+TableManager::reload(vector<ProtoBuf::Table>* tables)
+{
+    Lock lock(mutex);
+    for (Directory::const_iterator it = directory.begin();
+            it != directory.end(); ++it) {
+        delete it->second;
+    }
+    directory.clear();
+    idMap.clear();
+    serverTablets.clear();
+    backingTableMap.clear();
+
+    foreach (ProtoBuf::Table& info, *tables) {
+        if (info.id() >= nextTableId)
+            nextTableId = info.id() + 1;
+        if (!info.has_deleted())
+            recreateTable(lock, &info, false);
+    }
+}
+
+/**
+ * Collects information describing which masters store which pieces of data
+ * for a given table (including both tablets and indexes), in the form
+ * returned by the GET_TABLE_CONFIG RPC.
+ * \param config
+ *      Entries are added to this object representing each of the tablets
+ *      and indexes for a given table.
  * \param tableId
  *      The id of the table whose configuration will be fetched. If
- *      the table doesn't exist, then the protocol buffer ends up empty.
+ *      the table doesn't exist, then nothing is added to config.
+ * \param startKeyHash
+ *      Only tablets that overlap the range from startKeyHash to
+ *      endKeyHash (inclusive) are included. Indexes are included only
+ *      if this range covers the entire key hash space; clients refreshing
+ *      a single stale tablet use a narrower range to avoid transferring
+ *      the configuration of the whole table.
+ * \param endKeyHash
+ *      See startKeyHash.
  */
 void
-TableManager::serializeTableConfig(ProtoBuf::TableConfig* tableConfig,
-        uint64_t tableId)
+TableManager::serializeTableConfig(FlatTableConfig::Builder* config,
+        uint64_t tableId, uint64_t startKeyHash, uint64_t endKeyHash)
 {
     Lock lock(mutex);
     IdMap::iterator it = idMap.find(tableId);
@@ -766,66 +864,90 @@ TableManager::serializeTableConfig(ProtoBuf::TableConfig* tableConfig,
         return;
     Table* table = it->second;
 
-    // filling tablets
-    foreach (Tablet* tablet, table->tablets) {
-        ProtoBuf::TableConfig::Tablet& entry(*tableConfig->add_tablet());
-        tablet->serialize((ProtoBuf::Tablets::Tablet&)entry);
+    // filling tablets: all of them in the usual order, or (for a narrower
+    // range) just the ones that overlap it.
+    vector<Tablet*> overlapping;
+    if (startKeyHash == 0 && endKeyHash == ~0lu) {
+        overlapping = table->tablets;
+    } else {
+        TabletIndex::iterator tit =
+                table->tabletIndex.upper_bound(startKeyHash);
+        if (tit != table->tabletIndex.begin())
+            --tit;
+        for (; tit != table->tabletIndex.end() &&
+                tit->second->startKeyHash <= endKeyHash; ++tit) {
+            if (tit->second->endKeyHash >= startKeyHash)
+                overlapping.push_back(tit->second);
+        }
+    }
+    foreach (Tablet* tablet, overlapping) {
+        string locator;
         try {
-            string locator = context->serverList->getLocator(
-                    tablet->serverId);
-            entry.set_service_locator(locator);
+            locator = context->serverList->getLocator(tablet->serverId);
         } catch (const ServerListException& e) {
             RAMCLOUD_CLOG(NOTICE, "Server id (%s) in tablet map no longer "
                     "in server list; omitting locator for entry",
                     tablet->serverId.toString().c_str());
         }
+        config->addTablet(*tablet, locator);
     }
 
     // filling indexes
+    if (startKeyHash != 0 || endKeyHash != ~0lu)
+        return;
     for (IndexMap::const_iterator iit = table->indexMap.begin();
             iit != table->indexMap.end(); ++iit) {
         Index* index = iit->second;
         if (index == NULL)
             continue;
-
-        ProtoBuf::TableConfig::Index& index_entry(*tableConfig->add_index());
-        index_entry.set_index_id(index->indexId);
-        index_entry.set_index_type(index->indexType);
+        config->addIndex(index->indexId, index->indexType);
 
         // filling indexlets
         foreach (Indexlet* indexlet, index->indexlets) {
-            ProtoBuf::TableConfig::Index::Indexlet&
-                   entry(*index_entry.add_indexlet());
-            if (indexlet->firstKey != NULL) {
-                entry.set_start_key(string(
-                        reinterpret_cast<char*>(indexlet->firstKey),
-                        indexlet->firstKeyLength));
-            } else {
-                entry.set_start_key("");
-            }
-
-            if (indexlet->firstNotOwnedKey != NULL) {
-                entry.set_end_key(string(
-                        reinterpret_cast<char*>(indexlet->firstNotOwnedKey),
-                        indexlet->firstNotOwnedKeyLength));
-            } else {
-                entry.set_end_key("");
-            }
-
-            entry.set_server_id(indexlet->serverId.getId());
+            string locator;
             try {
-                string locator = context->serverList->getLocator(
+                locator = context->serverList->getLocator(
                         indexlet->serverId);
-                entry.set_service_locator(locator);
             } catch (const ServerListException& e) {
                 RAMCLOUD_LOG(NOTICE, "Server id (%s) in index map no longer in "
                     "server list; omitting locator for entry",
                     indexlet->serverId.toString().c_str());
             }
+            config->addIndexlet(indexlet->firstKey, indexlet->firstKeyLength,
+                    indexlet->firstNotOwnedKey,
+                    indexlet->firstNotOwnedKeyLength, indexlet->serverId,
+                    locator);
         }
     }
 }
 
+/**
+ * Fills in a protocol buffer with the same information as the method
+ * above; mostly used for testing.
+ * \param tableConfig
+ *      Protocol buffer to which entries are added representing each of
+ *      the tablets and indexes for a given table. If the table doesn't
+ *      exist, then the protocol buffer ends up empty.
+ * \param tableId
+ *      The id of the table whose configuration will be fetched.
+ * \param startKeyHash
+ *      See the method above.
+ * \param endKeyHash
+ *      See the method above.
+ */
+void
+TableManager::serializeTableConfig(ProtoBuf::TableConfig* tableConfig,
+        uint64_t tableId, uint64_t startKeyHash, uint64_t endKeyHash)
+{
+    FlatTableConfig::Builder builder;
+    serializeTableConfig(&builder, tableId, startKeyHash, endKeyHash);
+    Buffer buffer;
+    uint32_t length = builder.serialize(&buffer);
+    FlatTableConfig config;
+    config.parse(&buffer, 0, length);
+    config.toProtoBuf(tableConfig);
+}
+
 /**
  * Split a tablet into two disjoint tablets at a specific key hash. Check
  * if the split already exists, in which case, just return. Also informs
@@ -848,36 +970,32 @@ TableManager::splitTablet(const char* name, uint64_t splitKeyHash)
     Directory::iterator it = directory.find(name);
     if (it == directory.end())
         throw NoSuchTable(HERE);
-    Table* table = it->second;
-    Tablet* tablet = findTablet(lock, table, splitKeyHash);
-    if (splitKeyHash == tablet->startKeyHash)
-        return;
-    if (tablet->status == Tablet::RECOVERING) {
-        // We can't process this request right now, because recovery may
-        // undo it. Try again when recovery is finished.
-        throw RetryException(HERE, 1000000, 2000000,
-                "can't split tablet now: recovery is underway");
-    }
-
-    // Perform the split on our in-memory structures.
-    table->tablets.push_back(new Tablet(tablet->tableId, splitKeyHash,
-            tablet->endKeyHash, tablet->serverId, tablet->status,
-            tablet->ctime));
-    tablet->endKeyHash = splitKeyHash - 1;
-
-    // Record information about the split in external storage, in case we
-    // crash.
-    ProtoBuf::Table externalInfo;
-    serializeTable(lock, table, &externalInfo);
-    externalInfo.set_sequence_number(updateManager->nextSequenceNumber());
-    ProtoBuf::Table::Split* split = externalInfo.mutable_split();
-    split->set_server_id(tablet->serverId.getId());
-    split->set_split_key_hash(splitKeyHash);
-    syncTable(lock, table, &externalInfo);
+    splitTablet(lock, it->second, splitKeyHash);
+}
 
-    // Finish up by notifying the relevant master.
-    notifySplitTablet(lock, &externalInfo);
-    updateManager->updateFinished(externalInfo.sequence_number());
+/**
+ * Same as splitTablet(const char*, uint64_t), except that the table is
+ * identified by its id; used by the coordinator itself (e.g. by the
+ * TabletBalancer), which deals in table ids rather than names.
+ *
+ * \param tableId
+ *      Id of the table that contains the tablet to be split.
+ * \param splitKeyHash
+ *      Key hash to used to partition the tablet into two. Keys less than
+ *      \a splitKeyHash belong to one tablet, keys greater than or equal to
+ *      \a splitKeyHash belong to the other.
+ *
+ * \throw NoSuchTable
+ *      If tableId does not specify an existing table.
+ */
+void
+TableManager::splitTablet(uint64_t tableId, uint64_t splitKeyHash)
+{
+    Lock lock(mutex);
+    IdMap::iterator it = idMap.find(tableId);
+    if (it == idMap.end())
+        throw NoSuchTable(HERE);
+    splitTablet(lock, it->second, splitKeyHash);
 }
 
 /**
@@ -910,9 +1028,11 @@ TableManager::splitRecoveringTablet(uint64_t tableId, uint64_t splitKeyHash)
     assert(tablet->status == Tablet::RECOVERING);
 
     // Perform the split on our in-memory structures.
-    table->tablets.push_back(new Tablet(tablet->tableId, splitKeyHash,
+    Tablet* upper = new Tablet(tablet->tableId, splitKeyHash,
             tablet->endKeyHash, tablet->serverId, tablet->status,
-            tablet->ctime));
+            tablet->ctime);
+    table->addTablet(upper);
+    addOwnedTablet(lock, upper);
     tablet->endKeyHash = splitKeyHash - 1;
 
     // No need to record anything in external storage right now. If
@@ -964,7 +1084,7 @@ TableManager::tabletRecovered(
     }
 
     // Update in-memory data structures.
-    tablet->serverId = serverId;
+    setTabletOwner(lock, tablet, serverId);
     tablet->status = Tablet::NORMAL;
     tablet->ctime = ctime;
 
@@ -978,6 +1098,21 @@ TableManager::tabletRecovered(
     syncTable(lock, table, &externalInfo);
 }
 
+/**
+ * Record a tablet in serverTablets, as owned by its current serverId.
+ *
+ * \param lock
+ *      Ensures that the caller holds the monitor lock; not actually used.
+ * \param tablet
+ *      A tablet of a table in the tablet map.
+ */
+void
+TableManager::addOwnedTablet(const Lock& lock, Tablet* tablet)
+{
+    serverTablets[tablet->serverId.getId()][
+            std::make_pair(tablet->tableId, tablet->startKeyHash)] = tablet;
+}
+
 /**
  * Create a table with the given name, if it doesn't already exist.
  *
@@ -1048,7 +1183,7 @@ TableManager::createTable(const Lock& lock, const char* name,
             // can't be any existing information for this table stored on the
             // master.
             LogPosition ctime(0, 0);
-            table->tablets.push_back(new Tablet(tableId, startKeyHash,
+            table->addTablet(new Tablet(tableId, startKeyHash,
                     endKeyHash, currentTabletMaster, Tablet::NORMAL, ctime));
         }
     }
@@ -1058,6 +1193,8 @@ TableManager::createTable(const Lock& lock, const char* name,
     }
     directory[name] = table;
     idMap[tableId] = table;
+    foreach (Tablet* tablet, table->tablets)
+        addOwnedTablet(lock, tablet);
 
     // Create a record in external storage.  If we crash, this will be used
     // by the next coordinator (a) so that it knows about the existence of
@@ -1180,6 +1317,8 @@ TableManager::dropTable(const Lock& lock, const char* name)
     // Delete the table and notify the masters storing its tablets.
     directory.erase(it);
     idMap.erase(table->id);
+    foreach (Tablet* tablet, table->tablets)
+        removeOwnedTablet(lock, tablet);
     delete table;
     notifyDropTable(lock, &externalInfo);
     updateManager->updateFinished(externalInfo.sequence_number());
@@ -1235,11 +1374,12 @@ TableManager::findIndexlet(const Lock& lock, Index* index,
 Tablet*
 TableManager::findTablet(const Lock& lock, Table* table, uint64_t keyHash)
 {
-    foreach (Tablet* tablet, table->tablets) {
-        if ((tablet->startKeyHash <= keyHash) &&
-                (tablet->endKeyHash >= keyHash)) {
-            return tablet;
-        }
+    // The candidate is the last tablet starting at or before keyHash.
+    TabletIndex::iterator it = table->tabletIndex.upper_bound(keyHash);
+    if (it != table->tabletIndex.begin()) {
+        --it;
+        if (it->second->endKeyHash >= keyHash)
+            return it->second;
     }
     // Shouldn't ever get here:  this means there is some key hash in
     // the table that is not covered by any tablet.
@@ -1302,7 +1442,8 @@ TableManager::notifyCreateIndex(const Lock& lock, Index* index)
             MasterClient::takeIndexletOwnership(context, indexlet->serverId,
                 index->tableId, index->indexId, indexlet->backingTableId,
                 indexlet->firstKey, indexlet->firstKeyLength,
-                indexlet->firstNotOwnedKey, indexlet->firstNotOwnedKeyLength);
+                indexlet->firstNotOwnedKey, indexlet->firstNotOwnedKeyLength,
+                index->indexType);
         } catch (ServerNotUpException& e) {
             LOG(NOTICE, "takeIndexletOwnership skipped for master %s "
                     "(table %lu, index %u) because server isn't running",
@@ -1422,6 +1563,14 @@ TableManager::notifyReassignIndexlet(const Lock& lock, ProtoBuf::Table* info)
     const ProtoBuf::Table::ReassignIndexlet& reassignIndexlet =
         info->reassign_indexlet();
     ServerId serverId(reassignIndexlet.server_id());
+    uint8_t indexType = IndexKey::BTREE_INDEX;
+    IdMap::iterator it = idMap.find(info->id());
+    if (it != idMap.end()) {
+        IndexMap::iterator iit = it->second->indexMap.find(
+                downCast<uint8_t>(reassignIndexlet.index_id()));
+        if (iit != it->second->indexMap.end())
+            indexType = iit->second->indexType;
+    }
     try {
         LOG(NOTICE, "Reassigning an indexlet of index id %u for table id %lu "
                 "having backing table id %lu to master %s",
@@ -1434,7 +1583,8 @@ TableManager::notifyReassignIndexlet(const Lock& lock, ProtoBuf::Table* info)
                 reassignIndexlet.first_key().c_str(),
                 (uint16_t)reassignIndexlet.first_key().length(),
                 reassignIndexlet.first_not_owned_key().c_str(),
-                (uint16_t)reassignIndexlet.first_not_owned_key().length());
+                (uint16_t)reassignIndexlet.first_not_owned_key().length(),
+                indexType);
     } catch (ServerNotUpException& e) {
         // The master has apparently crashed. This should be benign (we will
         // eventually recover the tablet as part of recovering the master),
@@ -1524,9 +1674,13 @@ TableManager::notifySplitTablet(const Lock& lock, ProtoBuf::Table* info)
  *      Ensures that the caller holds the monitor lock; not actually used.
  * \param info
  *      Describes one table.
+ * \param logTablets
+ *      False means don't log each tablet as it is recreated (this method is
+ *      invoked frequently on read replicas).
  */
 TableManager::Table*
-TableManager::recreateTable(const Lock& lock, ProtoBuf::Table* info)
+TableManager::recreateTable(const Lock& lock, ProtoBuf::Table* info,
+        bool logTablets)
 {
     const string& name(info->name());
     uint64_t id = info->id();
@@ -1563,7 +1717,10 @@ TableManager::recreateTable(const Lock& lock, ProtoBuf::Table* info)
                 status,
                 LogPosition(tabletInfo.ctime_log_head_id(),
                               tabletInfo.ctime_log_head_offset()));
-        table->tablets.push_back(tablet);
+        table->addTablet(tablet);
+        addOwnedTablet(lock, tablet);
+        if (!logTablets)
+            continue;
         LOG(NOTICE, "Recovered tablet 0x%lx-0x%lx for table '%s' (id %lu) "
                 "on server %s", tablet->startKeyHash, tablet->endKeyHash,
                 name.c_str(), tablet->tableId,
@@ -1574,6 +1731,28 @@ TableManager::recreateTable(const Lock& lock, ProtoBuf::Table* info)
     return table;
 }
 
+/**
+ * Remove a tablet from serverTablets (for example, because its table is
+ * being dropped, or it's about to change owners).
+ *
+ * \param lock
+ *      Ensures that the caller holds the monitor lock; not actually used.
+ * \param tablet
+ *      A tablet previously passed to addOwnedTablet; its serverId must
+ *      not have changed since.
+ */
+void
+TableManager::removeOwnedTablet(const Lock& lock, Tablet* tablet)
+{
+    ServerTabletMap::iterator it =
+            serverTablets.find(tablet->serverId.getId());
+    if (it == serverTablets.end())
+        return;
+    it->second.erase(std::make_pair(tablet->tableId, tablet->startKeyHash));
+    if (it->second.empty())
+        serverTablets.erase(it);
+}
+
 /**
  * This method is used when recording information on external storage;
  * it initializes a protocol buffer with the current state of a table.
@@ -1612,6 +1791,77 @@ TableManager::serializeTable(const Lock& lock, Table* table,
     }
 }
 
+/**
+ * Change the master that owns a tablet, keeping serverTablets up to date.
+ * Tablets in the tablet map must change owners only through this method.
+ *
+ * \param lock
+ *      Ensures that the caller holds the monitor lock; not actually used.
+ * \param tablet
+ *      A tablet of a table in the tablet map.
+ * \param owner
+ *      The tablet's new owner.
+ */
+void
+TableManager::setTabletOwner(const Lock& lock, Tablet* tablet,
+        ServerId owner)
+{
+    removeOwnedTablet(lock, tablet);
+    tablet->serverId = owner;
+    addOwnedTablet(lock, tablet);
+}
+
+/**
+ * Does most of the work of the public splitTablet methods: splits the
+ * tablet of \a table containing \a splitKeyHash, records the split on
+ * external storage, and notifies the tablet's master.
+ *
+ * \param lock
+ *      Ensures that the caller holds the monitor lock; not actually used.
+ * \param table
+ *      Table that contains the tablet to be split.
+ * \param splitKeyHash
+ *      Key hash to used to partition the tablet into two. Keys less than
+ *      \a splitKeyHash belong to one tablet, keys greater than or equal to
+ *      \a splitKeyHash belong to the other.
+ */
+void
+TableManager::splitTablet(const Lock& lock, Table* table,
+        uint64_t splitKeyHash)
+{
+    Tablet* tablet = findTablet(lock, table, splitKeyHash);
+    if (splitKeyHash == tablet->startKeyHash)
+        return;
+    if (tablet->status == Tablet::RECOVERING) {
+        // We can't process this request right now, because recovery may
+        // undo it. Try again when recovery is finished.
+        throw RetryException(HERE, 1000000, 2000000,
+                "can't split tablet now: recovery is underway");
+    }
+
+    // Perform the split on our in-memory structures.
+    Tablet* upper = new Tablet(tablet->tableId, splitKeyHash,
+            tablet->endKeyHash, tablet->serverId, tablet->status,
+            tablet->ctime);
+    table->addTablet(upper);
+    addOwnedTablet(lock, upper);
+    tablet->endKeyHash = splitKeyHash - 1;
+
+    // Record information about the split in external storage, in case we
+    // crash.
+    ProtoBuf::Table externalInfo;
+    serializeTable(lock, table, &externalInfo);
+    externalInfo.set_sequence_number(updateManager->nextSequenceNumber());
+    ProtoBuf::Table::Split* split = externalInfo.mutable_split();
+    split->set_server_id(tablet->serverId.getId());
+    split->set_split_key_hash(splitKeyHash);
+    syncTable(lock, table, &externalInfo);
+
+    // Finish up by notifying the relevant master.
+    notifySplitTablet(lock, &externalInfo);
+    updateManager->updateFinished(externalInfo.sequence_number());
+}
+
 /**
  * Update next_table_id on external storage.
  *
@@ -1671,7 +1921,9 @@ TableManager::testAddTablet(const Tablet& tablet)
     if (it == idMap.end())
         throw FatalError(HERE, "table doesn't exist");
     Table* table = it->second;
-    table->tablets.push_back(new Tablet(tablet));
+    Tablet* newTablet = new Tablet(tablet);
+    table->addTablet(newTablet);
+    addOwnedTablet(lock, newTablet);
 }
 
 /**
@@ -1716,14 +1968,14 @@ TableManager::testFindTablet(uint64_t tableId, uint64_t keyHash)
     IdMap::iterator it = idMap.find(tableId);
     if (it == idMap.end())
         return NULL;
-    Table* table = it->second;
-    foreach (Tablet* tablet, table->tablets) {
-        if ((tablet->startKeyHash <= keyHash) &&
-                (tablet->endKeyHash >= keyHash)) {
-            return tablet;
-        }
-    }
-    return NULL;
+    TabletIndex& index = it->second->tabletIndex;
+    TabletIndex::iterator tit = index.upper_bound(keyHash);
+    if (tit == index.begin())
+        return NULL;
+    --tit;
+    if (tit->second->endKeyHash < keyHash)
+        return NULL;
+    return tit->second;
 }
 
 } // namespace RAMCloud
@@ -17,9 +17,11 @@
 #define RAMCLOUD_TABLEMANAGER_H
 
 #include <mutex>
+#include <map>
 
 #include "Common.h"
 #include "CoordinatorUpdateManager.h"
+#include "FlatTableConfig.h"
 #include "ServerId.h"
 #include "Table.pb.h"
 #include "Tablet.h"
@@ -94,9 +96,15 @@ class TableManager {
             uint64_t startKeyHash, uint64_t endKeyHash,
             uint64_t ctimeSegmentId, uint64_t ctimeSegmentOffset);
     void recover(uint64_t lastCompletedUpdate);
+    void reload(vector<ProtoBuf::Table>* tables);
+    void serializeTableConfig(FlatTableConfig::Builder* config,
+            uint64_t tableId, uint64_t startKeyHash = 0,
+            uint64_t endKeyHash = ~0lu);
     void serializeTableConfig(ProtoBuf::TableConfig* tableConfig,
-            uint64_t tableId);
+            uint64_t tableId, uint64_t startKeyHash = 0,
+            uint64_t endKeyHash = ~0lu);
     void splitTablet(const char* name, uint64_t splitKeyHash);
+    void splitTablet(uint64_t tableId, uint64_t splitKeyHash);
     void splitRecoveringTablet(uint64_t tableId, uint64_t splitKeyHash);
     void tabletRecovered(uint64_t tableId, uint64_t startKeyHash,
             uint64_t endKeyHash, ServerId serverId, LogPosition ctime);
@@ -185,25 +193,49 @@ class TableManager {
     /// indexId for that table.
     typedef std::unordered_map<uint8_t, Index*> IndexMap;
 
+    /// Maps from the first key hash of each tablet in a table to the
+    /// tablet. A table's tablets never overlap, so this orders them by key
+    /// hash range, and the tablet containing a given key hash is found with
+    /// a single upper_bound (see findTablet).
+    typedef std::map<uint64_t, Tablet*> TabletIndex;
+
     struct Table {
         Table(const char* name, uint64_t id)
             : name(name)
             , id(id)
             , tablets()
+            , tabletIndex()
             , indexMap()
         {}
         ~Table();
 
+        /**
+         * Add a tablet to the table. The table takes ownership of it.
+         */
+        void
+        addTablet(Tablet* tablet)
+        {
+            tablets.push_back(tablet);
+            tabletIndex[tablet->startKeyHash] = tablet;
+        }
+
         /// Human-readable name for the table (unique among all tables).
         string name;
 
         /// Identifier used to refer to the table in RPCs.
         uint64_t id;
 
-        /// Information about each of the tablets in the table. The
-        /// entries are allocated and freed dynamically.
+        /// Information about each of the tablets in the table, in the
+        /// order they were created (which is the order in which they are
+        /// serialized). The entries are allocated and freed dynamically.
+        /// Tablets must be added with addTablet.
         vector<Tablet*> tablets;
 
+        /// The same tablets as #tablets, indexed by key hash. A tablet's
+        /// startKeyHash never changes (splitting a tablet only shortens it
+        /// and creates a new one for the upper part).
+        TabletIndex tabletIndex;
+
         /// Information about each of the indexes in the table. The
         /// entries are allocated and freed dynamically.
         IndexMap indexMap;
@@ -240,12 +272,24 @@ class TableManager {
     typedef std::unordered_map<uint64_t, Table*> IdMap;
     IdMap idMap;
 
+    /// The tablets owned by one master, ordered by table id and then by
+    /// startKeyHash.
+    typedef std::map<std::pair<uint64_t, uint64_t>, Tablet*> OwnedTablets;
+
+    /// Maps from the id of a master (ServerId::getId) to the tablets it
+    /// owns, so that finding a crashed master's tablets doesn't require
+    /// scanning every table. Kept up to date by addOwnedTablet,
+    /// removeOwnedTablet, and setTabletOwner.
+    typedef std::unordered_map<uint64_t, OwnedTablets> ServerTabletMap;
+    ServerTabletMap serverTablets;
+
     /// Maps from backingTable id to indexlet.
     /// This is a map since every backingTable can have at most one table
     /// containing indexlet.
     typedef std::unordered_map<uint64_t, Indexlet*> IndexletTableMap;
     IndexletTableMap backingTableMap;
 
+    void addOwnedTablet(const Lock& lock, Tablet* tablet);
     uint64_t createTable(const Lock& lock, const char* name,
             uint32_t serverSpan, ServerId serverId = ServerId());
     void dropIndex(const Lock& lock, uint64_t tableId, uint8_t indexId);
@@ -260,9 +304,13 @@ class TableManager {
     void notifySplitTablet(const Lock& lock, ProtoBuf::Table* info);
     void notifyReassignIndexlet(const Lock& lock, ProtoBuf::Table* info);
     void notifyReassignTablet(const Lock& lock, ProtoBuf::Table* info);
-    Table* recreateTable(const Lock& lock, ProtoBuf::Table* info);
+    Table* recreateTable(const Lock& lock, ProtoBuf::Table* info,
+            bool logTablets = true);
+    void removeOwnedTablet(const Lock& lock, Tablet* tablet);
     void serializeTable(const Lock& lock, Table* table,
             ProtoBuf::Table* externalInfo);
+    void setTabletOwner(const Lock& lock, Tablet* tablet, ServerId owner);
+    void splitTablet(const Lock& lock, Table* table, uint64_t splitKeyHash);
     void syncNextTableId(const Lock& lock);
     void syncTable(const Lock& lock, Table* table,
             ProtoBuf::Table* externalInfo);
@@ -130,7 +130,7 @@ TEST_F(TableManagerTest, createIndex) {
     EXPECT_EQ(0U, master1->indexletManager.getNumIndexlets());
     EXPECT_EQ(1U, master2->indexletManager.getNumIndexlets());
 
-    EXPECT_THROW(tableManager->createIndex(1, 0, 0, 1),
+    EXPECT_THROW(tableManager->createIndex(1, 0, IndexKey::HASH_INDEX, 1),
                  InvalidParameterException);
     EXPECT_EQ(0U, master1->indexletManager.getNumIndexlets());
     EXPECT_EQ(1U, master2->indexletManager.getNumIndexlets());
@@ -143,6 +143,38 @@ TEST_F(TableManagerTest, createIndex) {
     EXPECT_NO_THROW(tableManager->createIndex(1, 1, 0, 1));
 };
 
+TEST_F(TableManagerTest, createIndex_primaryKey) {
+    cluster.addServer(masterConfig);
+    updateManager->reset();
+    EXPECT_EQ(1U, tableManager->createTable("foo", 1));
+    EXPECT_NO_THROW(tableManager->createIndex(1, 0, IndexKey::BTREE_INDEX,
+            1));
+    ProtoBuf::TableConfig tableConfig;
+    tableManager->serializeTableConfig(&tableConfig, 1);
+    ASSERT_EQ(1, tableConfig.index_size());
+    EXPECT_EQ(0U, tableConfig.index(0).index_id());
+}
+
+TEST_F(TableManagerTest, createIndex_hashIndex) {
+    MasterService* master1 = cluster.addServer(masterConfig)->master.get();
+    updateManager->reset();
+    EXPECT_EQ(1U, tableManager->createTable("foo", 1));
+
+    EXPECT_THROW(tableManager->createIndex(1, 1, 7, 1),
+                 InvalidParameterException);
+    EXPECT_EQ(0U, master1->indexletManager.getNumIndexlets());
+
+    tableManager->createIndex(1, 1, IndexKey::HASH_INDEX, 1);
+    IndexletManager::Indexlet* indexlet =
+            master1->indexletManager.findIndexlet(1, 1, "a", 1);
+    ASSERT_TRUE(indexlet != NULL);
+    EXPECT_TRUE(indexlet->hashIndex != NULL);
+
+    // Hash indexlets can't be split.
+    EXPECT_THROW(tableManager->coordSplitAndMigrateIndexlet(
+            master1->serverId, 1, 1, "b", 1), InvalidParameterException);
+}
+
 TEST_F(TableManagerTest, dropIndex) {
     MasterService* master1 = cluster.addServer(masterConfig)->master.get();
     MasterService* master2 = cluster.addServer(masterConfig)->master.get();
@@ -433,6 +465,30 @@ TEST_F(TableManagerTest, markAllTabletsRecovering) {
             tableManager->debugString());
 }
 
+TEST_F(TableManagerTest, markAllTabletsRecovering_ownershipChanges) {
+    cluster.addServer(masterConfig);
+    cluster.addServer(masterConfig);
+    tableManager->createTable("table1", 2);
+    tableManager->createTable("table2", 1);
+
+    // Move everything to server 2, in all the ways tablets can get there.
+    tableManager->reassignTabletOwnership(ServerId(2), 1, 0,
+            0x7fffffffffffffff, 0, 0);
+    tableManager->splitTablet("table1", 0xc000000000000000);
+    tableManager->dropTable("table2");
+
+    vector<Tablet> tablets;
+    tablets = tableManager->markAllTabletsRecovering(ServerId(1));
+    EXPECT_EQ("", tabletsToString(tablets));
+    tablets = tableManager->markAllTabletsRecovering(ServerId(2));
+    EXPECT_EQ("{tableId 1, hashes 0x0-0x7fffffffffffffff, "
+            "server 2.0, ctime 0.0, recovering} "
+            "{tableId 1, hashes 0x8000000000000000-0xbfffffffffffffff, "
+            "server 2.0, ctime 0.0, recovering} "
+            "{tableId 1, hashes 0xc000000000000000-0xffffffffffffffff, "
+            "server 2.0, ctime 0.0, recovering}", tabletsToString(tablets));
+}
+
 TEST_F(TableManagerTest, reassignTabletOwnership_basics) {
     cluster.addServer(masterConfig);
     MasterService* master2 = cluster.addServer(masterConfig)->master.get();
@@ -742,6 +798,34 @@ TEST_F(TableManagerTest, serializeTabletConfig) {
             TestLog::get());
 }
 
+TEST_F(TableManagerTest, serializeTabletConfig_range) {
+    cluster.addServer(masterConfig);
+    tableManager->createTable("table1", 4);
+    tableManager->createIndex(1, 1, 0, 1);
+
+    ProtoBuf::TableConfig tableConfig;
+    tableManager->serializeTableConfig(&tableConfig, 1,
+            0x5000000000000000lu, 0x5000000000000000lu);
+    EXPECT_EQ("tablet { table_id: 1 start_key_hash: 4611686018427387904 "
+            "end_key_hash: 9223372036854775807 state: NORMAL "
+            "server_id: 1 service_locator: \"mock:host=server0\" "
+            "ctime_log_head_id: 0 ctime_log_head_offset: 0 }",
+            tableConfig.ShortDebugString());
+
+    // Range spanning two tablets.
+    tableConfig.Clear();
+    tableManager->serializeTableConfig(&tableConfig, 1,
+            0x3000000000000000lu, 0x4000000000000000lu);
+    EXPECT_EQ(2, tableConfig.tablet_size());
+    EXPECT_EQ(0, tableConfig.index_size());
+
+    // Indexes are included only for the whole key hash space.
+    tableConfig.Clear();
+    tableManager->serializeTableConfig(&tableConfig, 1);
+    EXPECT_EQ(4, tableConfig.tablet_size());
+    EXPECT_EQ(1, tableConfig.index_size());
+}
+
 TEST_F(TableManagerTest, serializeIndexConfig) {
     cluster.addServer(masterConfig);
     cluster.addServer(masterConfig);
@@ -877,6 +961,21 @@ TEST_F(TableManagerTest, splitAndMigrateIndexlet) {
             dataTableId, indexId, "tuvw", 4, 9213U));
 }
 
+TEST_F(TableManagerTest, splitAndMigrateIndexlet_sameOwner) {
+    MasterService* master1 = cluster.addServer(masterConfig)->master.get();
+    updateManager->reset();
+    EXPECT_EQ(1U, tableManager->createTable("foo", 1));
+    tableManager->createIndex(1, 1, 0, 1);
+
+    TestLog::Enable _("coordSplitAndMigrateIndexlet");
+    EXPECT_THROW(tableManager->coordSplitAndMigrateIndexlet(
+            master1->serverId, 1, 1, "b", 1), InvalidParameterException);
+    EXPECT_EQ("coordSplitAndMigrateIndexlet: Can't split indexlet of index "
+            "1 in table '1': 1.0 already owns it", TestLog::get());
+    EXPECT_EQ(1U, master1->indexletManager.getNumIndexlets());
+    EXPECT_EQ(1U, master1->tabletManager.getNumTablets());
+}
+
 TEST_F(TableManagerTest, splitTablet_basics) {
     MasterService* master1 = cluster.addServer(masterConfig)->master.get();
     MasterService* master2 = cluster.addServer(masterConfig)->master.get();
@@ -1021,13 +1120,13 @@ TEST_F(TableManagerTest, findIndexlet) {
 
 TEST_F(TableManagerTest, findTablet) {
     TableManager::Table table("test", 111);
-    table.tablets.push_back(new Tablet(111, 0, 0x100, ServerId(1, 0),
+    table.addTablet(new Tablet(111, 0, 0x100, ServerId(1, 0),
             Tablet::NORMAL, LogPosition(10, 20)));
-    table.tablets.push_back(new Tablet(111, 0x101, 0x200, ServerId(2, 0),
+    table.addTablet(new Tablet(111, 0x101, 0x200, ServerId(2, 0),
             Tablet::RECOVERING, LogPosition(30, 40)));
-    table.tablets.push_back(new Tablet(111, 0x201, 0x300, ServerId(3, 0),
+    table.addTablet(new Tablet(111, 0x201, 0x300, ServerId(3, 0),
             Tablet::NORMAL, LogPosition(50, 60)));
-    table.tablets.push_back(new Tablet(111, 0x600, 0x700, ServerId(4, 0),
+    table.addTablet(new Tablet(111, 0x600, 0x700, ServerId(4, 0),
             Tablet::NORMAL, LogPosition(70, 80)));
 
     Tablet* tablet;
@@ -1044,13 +1143,13 @@ TEST_F(TableManagerTest, notifyCreate) {
     MasterService* master1 = cluster.addServer(masterConfig)->master.get();
     MasterService* master2 = cluster.addServer(masterConfig)->master.get();
     TableManager::Table table("test", 111);
-    table.tablets.push_back(new Tablet(111, 0, 0x100, ServerId(1, 0),
+    table.addTablet(new Tablet(111, 0, 0x100, ServerId(1, 0),
             Tablet::NORMAL, LogPosition(10, 20)));
-    table.tablets.push_back(new Tablet(111, 0x200, 0x300, ServerId(2, 0),
+    table.addTablet(new Tablet(111, 0x200, 0x300, ServerId(2, 0),
             Tablet::RECOVERING, LogPosition(30, 40)));
-    table.tablets.push_back(new Tablet(111, 0x400, 0x500, ServerId(6, 2),
+    table.addTablet(new Tablet(111, 0x400, 0x500, ServerId(6, 2),
             Tablet::NORMAL, LogPosition(50, 60)));
-    table.tablets.push_back(new Tablet(111, 0x600, 0x700, ServerId(2, 0),
+    table.addTablet(new Tablet(111, 0x600, 0x700, ServerId(2, 0),
             Tablet::NORMAL, LogPosition(70, 80)));
 
     TestLog::Enable _("notifyCreate");
@@ -1306,13 +1405,13 @@ TEST_F(TableManagerTest, recreateTable_bogusState) {
 TEST_F(TableManagerTest, serializeTable) {
     // Create a table with 4 tablets.
     TableManager::Table table("test", 111);
-    table.tablets.push_back(new Tablet(111, 0, 0x100, ServerId(1, 0),
+    table.addTablet(new Tablet(111, 0, 0x100, ServerId(1, 0),
             Tablet::NORMAL, LogPosition(10, 20)));
-    table.tablets.push_back(new Tablet(111, 0x200, 0x300, ServerId(2, 0),
+    table.addTablet(new Tablet(111, 0x200, 0x300, ServerId(2, 0),
             Tablet::RECOVERING, LogPosition(30, 40)));
-    table.tablets.push_back(new Tablet(111, 0x400, 0x500, ServerId(6, 2),
+    table.addTablet(new Tablet(111, 0x400, 0x500, ServerId(6, 2),
             Tablet::NORMAL, LogPosition(50, 60)));
-    table.tablets.push_back(new Tablet(111, 0x600, 0x700, ServerId(2, 0),
+    table.addTablet(new Tablet(111, 0x600, 0x700, ServerId(2, 0),
             Tablet::NORMAL, LogPosition(70, 80)));
 
     ProtoBuf::Table info;
@@ -0,0 +1,213 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <cmath>
+
+#include "Cycles.h"
+#include "TableRateLimiter.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct a TableRateLimiter; initially no table is limited.
+ */
+TableRateLimiter::TableRateLimiter()
+    : mutex("TableRateLimiter::mutex")
+    , buckets()
+    , enabled(false)
+{
+}
+
+/**
+ * Decide whether a request for a table may execute now. If so, the
+ * request's operations are taken from the table's bucket.
+ *
+ * \param tableId
+ *      The table the request is for.
+ * \param ops
+ *      Number of operations the request performs (greater than 1 only for
+ *      multi-operations).
+ * \return
+ *      0 means the request may execute. Otherwise the table is over its
+ *      limit and the request should be rejected; the return value is how
+ *      long, in microseconds, the client should wait before retrying (at
+ *      most MAX_RETRY_DELAY_MICROS).
+ */
+uint32_t
+TableRateLimiter::admit(uint64_t tableId, uint32_t ops)
+{
+    SpinLock::Guard _(mutex);
+    auto it = buckets.find(tableId);
+    if (it == buckets.end()) {
+        return 0;
+    }
+    Bucket* bucket = &it->second;
+    refill(bucket);
+
+    // Time, in seconds, until each bucket has tokens again.
+    double wait = 0;
+    if ((bucket->opsPerSecond != 0) && (bucket->ops < 1)) {
+        wait = (1 - bucket->ops) / static_cast<double>(bucket->opsPerSecond);
+    }
+    if ((bucket->bytesPerSecond != 0) && (bucket->bytes < 0)) {
+        wait = std::max(wait, -bucket->bytes /
+                static_cast<double>(bucket->bytesPerSecond));
+    }
+    if (wait > 0) {
+        double micros = std::ceil(wait * 1e06);
+        if (micros >= MAX_RETRY_DELAY_MICROS) {
+            return MAX_RETRY_DELAY_MICROS;
+        }
+        return std::max(1u, static_cast<uint32_t>(micros));
+    }
+    if (bucket->opsPerSecond != 0) {
+        bucket->ops -= ops;
+    }
+    return 0;
+}
+
+/**
+ * Record the bytes transferred by a request that was admitted (see
+ * #admit), once its size is known.
+ *
+ * \param tableId
+ *      The table the request was for.
+ * \param bytes
+ *      Total size of the request and its response.
+ */
+void
+TableRateLimiter::chargeBytes(uint64_t tableId, uint64_t bytes)
+{
+    SpinLock::Guard _(mutex);
+    auto it = buckets.find(tableId);
+    if ((it == buckets.end()) || (it->second.bytesPerSecond == 0)) {
+        return;
+    }
+    it->second.bytes -= static_cast<double>(bytes);
+}
+
+/**
+ * Find the table that a master request is charged to.
+ *
+ * \param opcode
+ *      The request's opcode.
+ * \param request
+ *      The request message.
+ * \param[out] tableId
+ *      Set to the table the request is for.
+ * \param[out] ops
+ *      Set to the number of operations the request performs.
+ * \return
+ *      True means the request reads or writes objects in \a tableId and
+ *      is subject to its limits; false means it is never limited (it is
+ *      a control or recovery request, for example), or it is too short
+ *      to tell: its handler will reject it.
+ */
+bool
+TableRateLimiter::getTable(WireFormat::Opcode opcode, Buffer* request,
+        uint64_t* tableId, uint32_t* ops)
+{
+    uint32_t offset;
+    switch (opcode) {
+        case WireFormat::APPEND:
+        case WireFormat::CONDITIONAL_UPDATE:
+        case WireFormat::ENUMERATE:
+        case WireFormat::INCREMENT:
+        case WireFormat::READ:
+        case WireFormat::READ_FROM_REPLICA:
+        case WireFormat::READ_KEYS_AND_VALUE:
+        case WireFormat::REMOVE:
+        case WireFormat::WRITE:
+            // The table id immediately follows the common header in all
+            // of these requests.
+            offset = sizeof32(WireFormat::RequestCommon);
+            *ops = 1;
+            break;
+        case WireFormat::MULTI_OP:
+        {
+            // Every part starts with its table id; the whole request is
+            // charged to the first part's table.
+            const WireFormat::MultiOp::Request* reqHdr =
+                    request->getStart<WireFormat::MultiOp::Request>();
+            if ((reqHdr == NULL) || (reqHdr->count == 0)) {
+                return false;
+            }
+            offset = sizeof32(*reqHdr) + reqHdr->filterBytes;
+            *ops = reqHdr->count;
+            break;
+        }
+        default:
+            return false;
+    }
+    const uint64_t* id = request->getOffset<uint64_t>(offset);
+    if (id == NULL) {
+        return false;
+    }
+    *tableId = *id;
+    return true;
+}
+
+/**
+ * Set or remove the limits on a table. The table's bucket starts full.
+ *
+ * \param tableId
+ *      The table to limit.
+ * \param opsPerSecond
+ *      Operations the master may perform on the table per second; 0 means
+ *      there is no limit on operations.
+ * \param bytesPerSecond
+ *      Bytes of requests and responses the master may transfer for the
+ *      table per second; 0 means there is no limit on bytes. If both
+ *      limits are 0 the table is no longer limited.
+ */
+void
+TableRateLimiter::setLimit(uint64_t tableId, uint64_t opsPerSecond,
+        uint64_t bytesPerSecond)
+{
+    SpinLock::Guard _(mutex);
+    if ((opsPerSecond == 0) && (bytesPerSecond == 0)) {
+        buckets.erase(tableId);
+    } else {
+        Bucket* bucket = &buckets[tableId];
+        bucket->opsPerSecond = opsPerSecond;
+        bucket->bytesPerSecond = bytesPerSecond;
+        bucket->ops = static_cast<double>(opsPerSecond);
+        bucket->bytes = static_cast<double>(bytesPerSecond);
+        bucket->lastRefill = Cycles::rdtsc();
+    }
+    enabled.store(!buckets.empty(), std::memory_order_relaxed);
+}
+
+/**
+ * Add the tokens a bucket has earned since it was last refilled, up to
+ * one second's worth. The caller must hold mutex.
+ *
+ * \param bucket
+ *      The bucket to refill.
+ */
+void
+TableRateLimiter::refill(Bucket* bucket)
+{
+    uint64_t now = Cycles::rdtsc();
+    double seconds = Cycles::toSeconds(now - bucket->lastRefill);
+    bucket->lastRefill = now;
+    double opsPerSecond = static_cast<double>(bucket->opsPerSecond);
+    double bytesPerSecond = static_cast<double>(bucket->bytesPerSecond);
+    bucket->ops = std::min(opsPerSecond, bucket->ops + seconds * opsPerSecond);
+    bucket->bytes = std::min(bytesPerSecond,
+            bucket->bytes + seconds * bytesPerSecond);
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,109 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_TABLERATELIMITER_H
+#define RAMCLOUD_TABLERATELIMITER_H
+
+#include <atomic>
+#include <unordered_map>
+#include "Buffer.h"
+#include "SpinLock.h"
+#include "WireFormat.h"
+
+namespace RAMCloud {
+
+/**
+ * Limits the rate at which a master serves requests for individual tables,
+ * so that one heavy client (such as a batch job issuing huge multiReads)
+ * can't take all of the master's network bandwidth and CPU. Each limited
+ * table has a pair of token buckets, one counting operations and one
+ * counting bytes (request plus response); each holds at most one second's
+ * worth of tokens, so a table may burst to twice its rate briefly. A
+ * request is admitted only while both buckets are non-empty; requests that
+ * aren't admitted are rejected with STATUS_RETRY, and the client waits
+ * until the buckets should have refilled before trying again, so throttled
+ * clients cost the master little more than the rejection itself.
+ *
+ * Response sizes aren't known until a request has executed, so bytes are
+ * charged afterwards and may put a bucket into debt, which later requests
+ * must then wait out.
+ *
+ * Limits are per master and per table: a table spread over several masters
+ * may get its rate from each of them. This class is thread-safe.
+ */
+class TableRateLimiter {
+  PUBLIC:
+    /// The longest a rejected client is told to wait before trying again,
+    /// in microseconds, no matter how far over its limit its table is.
+    static const uint32_t MAX_RETRY_DELAY_MICROS = 1000000;
+
+    TableRateLimiter();
+    uint32_t admit(uint64_t tableId, uint32_t ops);
+    void chargeBytes(uint64_t tableId, uint64_t bytes);
+    static bool getTable(WireFormat::Opcode opcode, Buffer* request,
+            uint64_t* tableId, uint32_t* ops);
+    void setLimit(uint64_t tableId, uint64_t opsPerSecond,
+            uint64_t bytesPerSecond);
+
+    /**
+     * Return true if any table is limited, false otherwise; lets callers
+     * skip all other work when rate limiting isn't in use.
+     */
+    bool
+    isEnabled()
+    {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+  PRIVATE:
+    /**
+     * The limits of one table and its current tokens.
+     */
+    struct Bucket {
+        /// Operations the table may perform per second; 0 means unlimited.
+        uint64_t opsPerSecond;
+
+        /// Bytes the table may transfer per second; 0 means unlimited.
+        uint64_t bytesPerSecond;
+
+        /// Operations that may be performed before the bucket is empty;
+        /// negative when the table is in debt.
+        double ops;
+
+        /// Bytes that may be transferred before the bucket is empty;
+        /// negative when the table is in debt.
+        double bytes;
+
+        /// Cycles::rdtsc() value when tokens were last added.
+        uint64_t lastRefill;
+    };
+
+    void refill(Bucket* bucket);
+
+    /// Monitor-style lock for buckets.
+    SpinLock mutex;
+
+    /// Limited tables, indexed by table id.
+    std::unordered_map<uint64_t, Bucket> buckets;
+
+    /// True when buckets isn't empty; readable without mutex.
+    std::atomic<bool> enabled;
+
+    DISALLOW_COPY_AND_ASSIGN(TableRateLimiter);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_TABLERATELIMITER_H
@@ -0,0 +1,148 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "Cycles.h"
+#include "TableRateLimiter.h"
+
+namespace RAMCloud {
+
+class TableRateLimiterTest : public ::testing::Test {
+  public:
+    TableRateLimiter limiter;
+
+    TableRateLimiterTest()
+        : limiter()
+    {
+        Cycles::mockCyclesPerSec = 1e09;
+        Cycles::mockTscValue = 1000;
+    }
+
+    ~TableRateLimiterTest()
+    {
+        Cycles::mockTscValue = 0;
+        Cycles::mockCyclesPerSec = 0;
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(TableRateLimiterTest);
+};
+
+TEST_F(TableRateLimiterTest, admit_unlimitedTable) {
+    limiter.setLimit(1, 2, 0);
+    EXPECT_EQ(0U, limiter.admit(2, 1000));
+    EXPECT_EQ(0U, limiter.admit(2, 1000));
+}
+
+TEST_F(TableRateLimiterTest, admit_ops) {
+    limiter.setLimit(1, 2, 0);
+    EXPECT_EQ(0U, limiter.admit(1, 1));
+    EXPECT_EQ(0U, limiter.admit(1, 1));
+    EXPECT_EQ(500000U, limiter.admit(1, 1));
+
+    // A quarter of a second refills half of a token.
+    Cycles::mockTscValue += 250000000;
+    EXPECT_EQ(250000U, limiter.admit(1, 1));
+    Cycles::mockTscValue += 250000000;
+    EXPECT_EQ(0U, limiter.admit(1, 1));
+
+    // A multi-operation may overdraw the bucket.
+    Cycles::mockTscValue += 1000000000;
+    EXPECT_EQ(0U, limiter.admit(1, 6));
+    EXPECT_EQ(1000000U, limiter.admit(1, 1));
+    Cycles::mockTscValue += 3000000000;
+    EXPECT_EQ(0U, limiter.admit(1, 1));
+}
+
+TEST_F(TableRateLimiterTest, admit_bytes) {
+    limiter.setLimit(1, 0, 1000);
+    EXPECT_EQ(0U, limiter.admit(1, 1));
+    limiter.chargeBytes(1, 999);
+    EXPECT_EQ(0U, limiter.admit(1, 1));
+    limiter.chargeBytes(1, 101);
+    EXPECT_EQ(100000U, limiter.admit(1, 1));
+    Cycles::mockTscValue += 200000000;
+    EXPECT_EQ(0U, limiter.admit(1, 1));
+}
+
+TEST_F(TableRateLimiterTest, admit_bucketHoldsOneSecond) {
+    limiter.setLimit(1, 2, 0);
+    Cycles::mockTscValue += 10000000000;
+    EXPECT_EQ(0U, limiter.admit(1, 1));
+    EXPECT_EQ(0U, limiter.admit(1, 1));
+    EXPECT_NE(0U, limiter.admit(1, 1));
+}
+
+TEST_F(TableRateLimiterTest, getTable) {
+    uint64_t tableId = 0;
+    uint32_t ops = 0;
+    Buffer request;
+    WireFormat::Read::Request* reqHdr =
+            request.emplaceAppend<WireFormat::Read::Request>();
+    reqHdr->tableId = 17;
+    EXPECT_TRUE(TableRateLimiter::getTable(WireFormat::READ, &request,
+            &tableId, &ops));
+    EXPECT_EQ(17U, tableId);
+    EXPECT_EQ(1U, ops);
+
+    // Requests that aren't about objects are never limited.
+    EXPECT_FALSE(TableRateLimiter::getTable(WireFormat::GET_LOG_METRICS,
+            &request, &tableId, &ops));
+
+    // A request too short to hold a table id.
+    request.reset();
+    request.emplaceAppend<WireFormat::RequestCommon>();
+    EXPECT_FALSE(TableRateLimiter::getTable(WireFormat::WRITE, &request,
+            &tableId, &ops));
+}
+
+TEST_F(TableRateLimiterTest, getTable_multiOp) {
+    uint64_t tableId = 0;
+    uint32_t ops = 0;
+    Buffer request;
+    WireFormat::MultiOp::Request* reqHdr =
+            request.emplaceAppend<WireFormat::MultiOp::Request>();
+    reqHdr->count = 0;
+    reqHdr->type = WireFormat::MultiOp::READ;
+    reqHdr->filterBytes = 0;
+    EXPECT_FALSE(TableRateLimiter::getTable(WireFormat::MULTI_OP, &request,
+            &tableId, &ops));
+
+    reqHdr->count = 3;
+    reqHdr->filterBytes = 4;
+    request.emplaceAppend<uint32_t>(0);
+    RejectRules rules = {};
+    uint16_t keyLength = 0;
+    request.emplaceAppend<WireFormat::MultiOp::Request::ReadPart>(21,
+            keyLength, rules);
+    EXPECT_TRUE(TableRateLimiter::getTable(WireFormat::MULTI_OP, &request,
+            &tableId, &ops));
+    EXPECT_EQ(21U, tableId);
+    EXPECT_EQ(3U, ops);
+}
+
+TEST_F(TableRateLimiterTest, setLimit) {
+    EXPECT_FALSE(limiter.isEnabled());
+    limiter.setLimit(1, 1, 0);
+    limiter.setLimit(2, 0, 1);
+    EXPECT_TRUE(limiter.isEnabled());
+    EXPECT_EQ(2U, limiter.buckets.size());
+    limiter.setLimit(1, 0, 0);
+    EXPECT_TRUE(limiter.isEnabled());
+    limiter.setLimit(2, 0, 0);
+    EXPECT_FALSE(limiter.isEnabled());
+    EXPECT_EQ(0U, limiter.buckets.size());
+}
+
+}  // namespace RAMCloud
@@ -16,6 +16,7 @@
 #include "TableStats.h"
 #include "MasterTableMetadata.h"
 #include "ShortMacros.h"
+#include "ThreadId.h"
 
 namespace RAMCloud {
 
@@ -105,7 +106,8 @@ deleteKeyHashRange(MasterTableMetadata* mtm,
  * values provided.  If no stats information previously existed for the
  * referenced table, a new entry is added.  In this way, this method will always
  * succeed.  This method is invoked whenever new data related to a table is
- * written to the log.
+ * written to the log, so it doesn't take the stats lock: the counts go into
+ * this thread's shard of the block and are merged when they are read.
  *
  * \param mtm
  *      Pointer to MasterTableMetadata container that is storing the current
@@ -126,9 +128,10 @@ increment(MasterTableMetadata* mtm,
     MasterTableMetadata::Entry* entry;
     entry = mtm->findOrCreate(tableId);
 
-    SpinLock::Guard _(entry->stats.lock);
-    entry->stats.byteCount += byteCount;
-    entry->stats.recordCount += recordCount;
+    Block::Shard* shard =
+            &entry->stats.shards[ThreadId::get() % Block::NUM_SHARDS];
+    shard->byteCount.fetch_add(byteCount, std::memory_order_relaxed);
+    shard->recordCount.fetch_add(recordCount, std::memory_order_relaxed);
 }
 
 /**
@@ -158,9 +161,10 @@ decrement(MasterTableMetadata* mtm,
     entry = mtm->find(tableId);
 
     if (entry != NULL) {
-        SpinLock::Guard _(entry->stats.lock);
-        entry->stats.byteCount -= byteCount;
-        entry->stats.recordCount -= recordCount;
+        Block::Shard* shard =
+                &entry->stats.shards[ThreadId::get() % Block::NUM_SHARDS];
+        shard->byteCount.fetch_sub(byteCount, std::memory_order_relaxed);
+        shard->recordCount.fetch_sub(recordCount, std::memory_order_relaxed);
     }
 }
 
@@ -203,6 +207,7 @@ serialize(Buffer *buf, MasterTableMetadata *mtm)
         MasterTableMetadata::Entry* entry = sc.next();
         {
             SpinLock::Guard _(entry->stats.lock);
+            entry->stats.merge();
             double keyHashCount;
             if (entry->stats.totalOwnership) {
                 keyHashCount = double(entry->stats.keyHashCount - 1);
@@ -16,6 +16,7 @@
 #ifndef RAMCLOUD_TABLESTATS_H
 #define RAMCLOUD_TABLESTATS_H
 
+#include <atomic>
 #include <unordered_map>
 
 #include "Common.h"
@@ -53,15 +54,51 @@ namespace TableStats {
  * of the MasterTableMetadata container.  Thread-safe access to this block
  * should be maintained by "acquiring" the block's SpinLock before accessing
  * the block's members.
+ *
+ * The one exception is the byte and record counts, which change on every
+ * write and every cleaned record.  Rather than taking the lock and bouncing
+ * a shared cache line between cores on each update, writers add their deltas
+ * to a per-thread shard (see TableStats::increment); the shards are only
+ * folded into byteCount and recordCount when someone needs the totals (see
+ * #merge).
  */
 struct Block {
+    /**
+     * Holds the unmerged byte and record count deltas accumulated by the
+     * threads that map onto this shard.  Counts are unsigned and wrap, so a
+     * shard that has seen more decrements than increments still merges into
+     * the correct total.
+     */
+    struct Shard {
+        /// Bytes added (or, wrapping, removed) since the last merge.
+        std::atomic<uint64_t> byteCount;
+        /// Log records added (or, wrapping, removed) since the last merge.
+        std::atomic<uint64_t> recordCount;
+        /// Keeps the counters of neighboring shards on different cache lines.
+        char pad[CACHE_LINE_SIZE];
+
+        Shard()
+            : byteCount(0)
+            , recordCount(0)
+            , pad()
+        {}
+    };
+
+    /// Number of shards per block; threads are spread over these by
+    /// ThreadId, so this only needs to cover the number of threads that
+    /// write concurrently.
+    static const int NUM_SHARDS = 16;
+
     SpinLock lock;          /// Aquire this monitor lock before member access.
     uint64_t keyHashCount;  /// Number of key hashes that reside on this master.
                             /// If a master has total ownership this value is
                             /// assumed to be 2^64.
     bool totalOwnership;    /// True if this master completely owns this table.
-    uint64_t byteCount;     /// Number of bytes of data related to a table.
-    uint64_t recordCount;   /// Number of log records related to a table.
+    uint64_t byteCount;     /// Number of bytes of data related to a table, as
+                            /// of the last call to merge.
+    uint64_t recordCount;   /// Number of log records related to a table, as
+                            /// of the last call to merge.
+    Shard shards[NUM_SHARDS];   /// Updates not yet folded into the counts.
 
     Block()
         : lock("TableStats::lock")
@@ -69,7 +106,22 @@ struct Block {
         , totalOwnership(false)
         , byteCount(0)
         , recordCount(0)
+        , shards()
     {}
+
+    /**
+     * Fold the updates accumulated in the shards into byteCount and
+     * recordCount, so that they reflect every increment and decrement that
+     * completed before this call.  The caller must hold #lock.
+     */
+    void
+    merge()
+    {
+        for (int i = 0; i < NUM_SHARDS; i++) {
+            byteCount += shards[i].byteCount.exchange(0);
+            recordCount += shards[i].recordCount.exchange(0);
+        }
+    }
 };
 
 void addKeyHashRange(MasterTableMetadata* mtm,
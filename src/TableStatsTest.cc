@@ -13,6 +13,8 @@
  * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <thread>
+
 #include "TestUtil.h"
 #include "TableStats.h"
 #include "MasterTableMetadata.h"
@@ -138,6 +140,7 @@ TEST_F(TableStatsTest, increment) {
     EXPECT_FALSE(entry == NULL);
     {
         SpinLock::Guard _(entry->stats.lock);
+        entry->stats.merge();
         EXPECT_EQ(2u, entry->stats.byteCount);
         EXPECT_EQ(3u, entry->stats.recordCount);
     }
@@ -145,6 +148,7 @@ TEST_F(TableStatsTest, increment) {
     TableStats::increment(&mtm, 0, 4, 5);
     {
         SpinLock::Guard _(entry->stats.lock);
+        entry->stats.merge();
         EXPECT_EQ(6u, entry->stats.byteCount);
         EXPECT_EQ(8u, entry->stats.recordCount);
     }
@@ -162,6 +166,7 @@ TEST_F(TableStatsTest, decrement) {
     EXPECT_FALSE(entry == NULL);
     {
         SpinLock::Guard _(entry->stats.lock);
+        entry->stats.merge();
         EXPECT_EQ(10u, entry->stats.byteCount);
         EXPECT_EQ(10u, entry->stats.recordCount);
     }
@@ -170,11 +175,42 @@ TEST_F(TableStatsTest, decrement) {
     EXPECT_FALSE(entry == NULL);
     {
         SpinLock::Guard _(entry->stats.lock);
+        entry->stats.merge();
         EXPECT_EQ(8u, entry->stats.byteCount);
         EXPECT_EQ(7u, entry->stats.recordCount);
     }
 }
 
+static void
+incrementInThread(MasterTableMetadata* mtm)
+{
+    TableStats::increment(mtm, 2, 100, 1);
+    TableStats::decrement(mtm, 2, 1, 1);
+}
+
+TEST_F(TableStatsTest, merge) {
+    TableStats::increment(&mtm, 2, 10, 10);
+    std::thread thread(incrementInThread, &mtm);
+    thread.join();
+    TableStats::decrement(&mtm, 2, 8, 9);
+
+    MasterTableMetadata::Entry* entry = mtm.find(2);
+    SpinLock::Guard _(entry->stats.lock);
+    EXPECT_EQ(0u, entry->stats.byteCount);
+    entry->stats.merge();
+    EXPECT_EQ(101u, entry->stats.byteCount);
+    EXPECT_EQ(1u, entry->stats.recordCount);
+    for (int i = 0; i < TableStats::Block::NUM_SHARDS; i++) {
+        EXPECT_EQ(0u, entry->stats.shards[i].byteCount.load());
+        EXPECT_EQ(0u, entry->stats.shards[i].recordCount.load());
+    }
+
+    // Merging again shouldn't count anything twice.
+    entry->stats.merge();
+    EXPECT_EQ(101u, entry->stats.byteCount);
+    EXPECT_EQ(1u, entry->stats.recordCount);
+}
+
 TEST_F(TableStatsTest, serialize_basic) {
     // First Check an empty mtm.
     {
@@ -0,0 +1,412 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <algorithm>
+
+#include "TabletBalancer.h"
+#include "CoordinatorServerList.h"
+#include "Cycles.h"
+#include "ShortMacros.h"
+
+namespace RAMCloud {
+
+/**
+ * Constructor for TabletBalancer. The balancer doesn't do anything until
+ * start() is invoked.
+ *
+ * \param context
+ *      Overall information about the coordinator; supplies the server
+ *      list (and hence the masters' load reports).
+ * \param tableManager
+ *      The coordinator's tablet map.
+ * \param runtimeOptions
+ *      Supplies the balancer's configuration; it is read on each round, so
+ *      changes take effect without restarting the coordinator.
+ */
+TabletBalancer::TabletBalancer(Context* context, TableManager* tableManager,
+        RuntimeOptions* runtimeOptions)
+    : WorkerTimer(context->dispatch)
+    , context(context)
+    , tableManager(tableManager)
+    , runtimeOptions(runtimeOptions)
+    , migrations()
+    , indexletSplit()
+{
+}
+
+/**
+ * Destructor. Any migrations still in progress are left to finish on
+ * their own; the balancer just stops waiting for them. An indexlet split
+ * in progress is waited for, since its thread uses the tablet map.
+ */
+TabletBalancer::~TabletBalancer()
+{
+    // Make sure the handler isn't running while #migrations is destroyed.
+    stop();
+    if (indexletSplit)
+        indexletSplit->thread->join();
+}
+
+/**
+ * This method is invoked by the WorkerTimer mechanism; it runs one round
+ * of balancing (if balancing is enabled) and reschedules itself.
+ */
+void
+TabletBalancer::handleTimerEvent()
+{
+    uint32_t intervalMs = runtimeOptions->getTabletBalancerIntervalMs();
+    if (intervalMs != 0) {
+        balance();
+    } else {
+        intervalMs = IDLE_POLL_MS;
+    }
+    WorkerTimer::start(Cycles::rdtsc() +
+            Cycles::fromNanoseconds(intervalMs * 1000000lu));
+}
+
+/**
+ * Start running the balancer in the background.
+ */
+void
+TabletBalancer::start()
+{
+    WorkerTimer::start(0);
+}
+
+// - private -
+
+/**
+ * Carry out one round of balancing: reap finished migrations, split an
+ * indexlet if one has grown too hot or too big, then pair the busiest
+ * masters with the least loaded ones and start migrations between them,
+ * as long as the busiest master is far enough above the average and the
+ * limit on concurrent migrations hasn't been reached. Each master takes
+ * part in at most one migration at a time.
+ */
+void
+TabletBalancer::balance()
+{
+    std::set<ServerId> busy;
+    reapMigrations(&busy);
+
+    vector<MasterLoad> loads;
+    getLoads(&loads);
+    if (loads.size() < 2)
+        return;
+    splitHotIndexlet(loads, &busy);
+
+    uint64_t total = 0;
+    foreach (const MasterLoad& master, loads)
+        total += master.load;
+    uint64_t average = total / loads.size();
+    uint32_t imbalancePercent =
+            runtimeOptions->getTabletBalancerImbalancePercent();
+    uint32_t maxMigrations = runtimeOptions->getTabletBalancerMaxMigrations();
+
+    std::sort(loads.begin(), loads.end(),
+            [](const MasterLoad& a, const MasterLoad& b) {
+                return a.load > b.load;
+            });
+    size_t hot = 0;
+    size_t cold = loads.size() - 1;
+    while (migrations.size() < maxMigrations) {
+        while (hot < cold && busy.count(loads[hot].serverId))
+            hot++;
+        while (cold > hot && busy.count(loads[cold].serverId))
+            cold--;
+        if (hot >= cold)
+            break;
+        if (loads[hot].load * 100 <= average * (100 + imbalancePercent))
+            break;
+        moveLoad(loads[hot], loads[cold]);
+        hot++;
+        cold--;
+    }
+}
+
+/**
+ * Compute the current load of each master that is up, from the most
+ * recent reports in the coordinator's server list.
+ *
+ * \param loads
+ *      One entry is appended here for each master.
+ */
+void
+TabletBalancer::getLoads(vector<MasterLoad>* loads)
+{
+    CoordinatorServerList* serverList = context->coordinatorServerList;
+    ServerId id;
+    while (1) {
+        bool end;
+        id = serverList->nextServer(id,
+                ServiceMask({WireFormat::MASTER_SERVICE}), &end);
+        if (end)
+            break;
+        CoordinatorServerList::Entry entry;
+        try {
+            entry = (*serverList)[id];
+        } catch (const ServerListException& e) {
+            // The server went away since nextServer returned it.
+            continue;
+        }
+        loads->emplace_back(id);
+        MasterLoad& master = loads->back();
+        uint64_t hottestLoad = 0;
+        foreach (const ProtoBuf::MasterRecoveryInfo::TabletLoad& tablet,
+                entry.masterRecoveryInfo.tablet_load()) {
+            uint64_t load = tablet.read_count() + tablet.write_count();
+            master.load += load;
+            if (load > hottestLoad) {
+                hottestLoad = load;
+                master.hottest = tablet;
+            }
+        }
+        foreach (const ProtoBuf::MasterRecoveryInfo::IndexletLoad& indexlet,
+                entry.masterRecoveryInfo.indexlet_load()) {
+            master.indexletLoad += indexlet.lookup_count() +
+                    indexlet.write_count();
+            if (!indexlet.split_key().empty())
+                master.indexlets.push_back(indexlet);
+        }
+    }
+}
+
+/**
+ * Move load from one master to another by migrating the hottest tablet
+ * of the first (or the upper half of it) to the second. Nothing happens
+ * if the load report is out of date with respect to the tablet map, or if
+ * the move wouldn't reduce the imbalance between the two masters.
+ *
+ * \param hot
+ *      Master to move load off of.
+ * \param cold
+ *      Master to move the load to; must have less load than \a hot.
+ */
+void
+TabletBalancer::moveLoad(const MasterLoad& hot, const MasterLoad& cold)
+{
+    const ProtoBuf::MasterRecoveryInfo::TabletLoad& hottest = hot.hottest;
+    uint64_t tableId = hottest.table_id();
+    uint64_t firstKeyHash = hottest.start_key_hash();
+    uint64_t lastKeyHash = hottest.end_key_hash();
+    uint64_t tabletLoad = hottest.read_count() + hottest.write_count();
+    uint64_t gap = hot.load - cold.load;
+
+    // The report may predate splits, migrations, or recoveries; only act
+    // on it if the tablet still exists exactly as reported.
+    try {
+        Tablet tablet = tableManager->getTablet(tableId, firstKeyHash);
+        if (tablet.serverId != hot.serverId
+                || tablet.startKeyHash != firstKeyHash
+                || tablet.endKeyHash != lastKeyHash
+                || tablet.status != Tablet::NORMAL) {
+            return;
+        }
+    } catch (const TableManager::NoSuchTablet& e) {
+        return;
+    }
+
+    // Moving a tablet that carries load L changes the difference between
+    // the two masters from gap to |gap - 2L|. If the tablet carries more
+    // than two thirds of the gap, moving just half of it ends up closer to
+    // balance.
+    uint64_t movedLoad = tabletLoad;
+    uint64_t splitKeyHash = 0;
+    if (3 * tabletLoad > 2 * gap && lastKeyHash > firstKeyHash) {
+        splitKeyHash = firstKeyHash + (lastKeyHash - firstKeyHash) / 2 + 1;
+        movedLoad = tabletLoad / 2;
+    }
+    if (movedLoad == 0 || movedLoad >= gap) {
+        // Moving the tablet would only shift the imbalance elsewhere
+        // (e.g., all of the load is on a single key hash).
+        return;
+    }
+
+    if (splitKeyHash != 0) {
+        try {
+            tableManager->splitTablet(tableId, splitKeyHash);
+        } catch (const ClientException& e) {
+            LOG(NOTICE, "Couldn't split tablet [0x%lx,0x%lx] in table %lu "
+                    "at 0x%lx: %s", firstKeyHash, lastKeyHash, tableId,
+                    splitKeyHash, e.toString());
+            return;
+        } catch (const TableManager::NoSuchTable& e) {
+            return;
+        }
+        firstKeyHash = splitKeyHash;
+    }
+
+    LOG(NOTICE, "Migrating tablet [0x%lx,0x%lx] in table %lu from %s "
+            "(load %lu) to %s (load %lu)", firstKeyHash, lastKeyHash,
+            tableId, hot.serverId.toString().c_str(), hot.load,
+            cold.serverId.toString().c_str(), cold.load);
+    migrations.emplace_back(context, hot.serverId, cold.serverId, tableId,
+            firstKeyHash, lastKeyHash);
+}
+
+/**
+ * Clean up after migrations (and the indexlet split) that have finished,
+ * and report which masters shouldn't take part in new migrations during
+ * this round.
+ *
+ * \param busy
+ *      The source and target of every migration that was still in
+ *      progress at the end of the previous round are added here: either
+ *      they are still migrating, or their load reports may not reflect
+ *      the migration yet.
+ */
+void
+TabletBalancer::reapMigrations(std::set<ServerId>* busy)
+{
+    if (indexletSplit) {
+        busy->insert(indexletSplit->source);
+        busy->insert(indexletSplit->target);
+        if (indexletSplit->finished.load()) {
+            indexletSplit->thread->join();
+            indexletSplit.destroy();
+        }
+    }
+
+    std::list<Migration>::iterator it = migrations.begin();
+    while (it != migrations.end()) {
+        busy->insert(it->source);
+        busy->insert(it->target);
+        if (!it->rpc.isReady()) {
+            it++;
+            continue;
+        }
+        try {
+            it->rpc.wait();
+            LOG(NOTICE, "Finished migrating tablet [0x%lx,0x%lx] in table "
+                    "%lu from %s to %s", it->firstKeyHash, it->lastKeyHash,
+                    it->tableId, it->source.toString().c_str(),
+                    it->target.toString().c_str());
+        } catch (const ClientException& e) {
+            LOG(WARNING, "Migration of tablet [0x%lx,0x%lx] in table %lu "
+                    "from %s to %s failed: %s", it->firstKeyHash,
+                    it->lastKeyHash, it->tableId,
+                    it->source.toString().c_str(),
+                    it->target.toString().c_str(), e.toString());
+        }
+        it = migrations.erase(it);
+    }
+}
+
+/**
+ * If one of the masters has an indexlet that is over the load or size
+ * limit in RuntimeOptions, start splitting it at its middle key and moving
+ * the upper half to the least loaded master. Nothing happens if an
+ * indexlet split is already in progress.
+ *
+ * \param loads
+ *      The current load of each master, from getLoads.
+ * \param busy
+ *      Masters that shouldn't take part in a split or migration this
+ *      round. If a split is started, its source and target are added.
+ */
+void
+TabletBalancer::splitHotIndexlet(const vector<MasterLoad>& loads,
+        std::set<ServerId>* busy)
+{
+    if (indexletSplit)
+        return;
+    uint64_t maxOps = runtimeOptions->getIndexletSplitOps();
+    uint64_t maxBytes = uint64_t(runtimeOptions->getIndexletSplitMB()) << 20;
+    if (maxOps == 0 && maxBytes == 0)
+        return;
+
+    // Of the indexlets over either limit, split the one that is busiest.
+    const MasterLoad* source = NULL;
+    const ProtoBuf::MasterRecoveryInfo::IndexletLoad* hottest = NULL;
+    uint64_t hottestOps = 0;
+    foreach (const MasterLoad& master, loads) {
+        if (busy->count(master.serverId))
+            continue;
+        foreach (const ProtoBuf::MasterRecoveryInfo::IndexletLoad& indexlet,
+                master.indexlets) {
+            uint64_t ops = indexlet.lookup_count() + indexlet.write_count();
+            if (!(maxOps != 0 && ops > maxOps) &&
+                    !(maxBytes != 0 && indexlet.byte_count() > maxBytes))
+                continue;
+            if (hottest == NULL || ops > hottestOps) {
+                source = &master;
+                hottest = &indexlet;
+                hottestOps = ops;
+            }
+        }
+    }
+    if (hottest == NULL)
+        return;
+
+    const MasterLoad* target = NULL;
+    foreach (const MasterLoad& master, loads) {
+        if (&master == source || busy->count(master.serverId))
+            continue;
+        if (target == NULL || master.load + master.indexletLoad <
+                target->load + target->indexletLoad)
+            target = &master;
+    }
+    if (target == NULL)
+        return;
+
+    // The report may predate other splits; that's harmless, since the
+    // tablet map decides which indexlet the key falls in.
+    LOG(NOTICE, "Splitting indexlet of index %u in table %lu "
+            "(%lu lookups and writes, %lu bytes) and moving its upper half "
+            "from %s to %s", hottest->index_id(), hottest->table_id(),
+            hottestOps, hottest->byte_count(),
+            source->serverId.toString().c_str(),
+            target->serverId.toString().c_str());
+    busy->insert(source->serverId);
+    busy->insert(target->serverId);
+    indexletSplit.construct(source->serverId, target->serverId,
+            hottest->table_id(), downCast<uint8_t>(hottest->index_id()),
+            hottest->split_key());
+    indexletSplit->thread.construct(splitIndexlet, tableManager,
+            indexletSplit.get());
+}
+
+/**
+ * The main program for the thread that carries out an indexlet split.
+ *
+ * \param tableManager
+ *      The coordinator's tablet map.
+ * \param split
+ *      Describes the split; its finished flag is set on return.
+ */
+void
+TabletBalancer::splitIndexlet(TableManager* tableManager,
+        IndexletSplit* split)
+{
+    try {
+        tableManager->coordSplitAndMigrateIndexlet(split->target,
+                split->tableId, split->indexId, split->splitKey.data(),
+                downCast<KeyLength>(split->splitKey.size()));
+        LOG(NOTICE, "Finished splitting indexlet of index %u in table %lu",
+                split->indexId, split->tableId);
+    } catch (const ClientException& e) {
+        LOG(WARNING, "Split of indexlet of index %u in table %lu failed: %s",
+                split->indexId, split->tableId, e.toString());
+    } catch (const TableManager::NoSuchTable& e) {
+        LOG(NOTICE, "Didn't split indexlet of index %u in table %lu: "
+                "no such table", split->indexId, split->tableId);
+    } catch (const TableManager::NoSuchIndexlet& e) {
+        LOG(NOTICE, "Didn't split indexlet of index %u in table %lu: "
+                "no such indexlet", split->indexId, split->tableId);
+    }
+    split->finished.store(1);
+}
+
+} // namespace RAMCloud
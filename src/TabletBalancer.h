@@ -0,0 +1,205 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_TABLETBALANCER_H
+#define RAMCLOUD_TABLETBALANCER_H
+
+#include <thread>
+#include <list>
+#include <set>
+
+#include "Atomic.h"
+#include "Common.h"
+#include "MasterClient.h"
+#include "RuntimeOptions.h"
+#include "TableManager.h"
+#include "Tub.h"
+#include "WorkerTimer.h"
+
+namespace RAMCloud {
+
+/**
+ * Runs on the coordinator and moves load off of overloaded masters. Masters
+ * periodically report the read and write counts of each of their tablets
+ * (see MasterService::TabletLoadReporter); the coordinator keeps the latest
+ * report in each master's server list entry. At regular intervals the
+ * balancer compares the total load of each master, and if the busiest one
+ * is well above the average it takes that master's hottest tablet and
+ * migrates it to the least loaded master. When the tablet is so hot that
+ * moving it whole would just move the hot spot, the tablet is first split
+ * at its midpoint and only the upper half is migrated.
+ *
+ * Masters report the lookups and writes on their B+ tree indexlets too,
+ * along with the size of each one and its middle key. An indexlet that is
+ * too hot or too big is split at that key, and the upper half is moved to
+ * the least loaded master; clients find the new owner when the old one
+ * rejects their next request for the moved keys with
+ * STATUS_UNKNOWN_INDEXLET. Only one indexlet split runs at a time.
+ *
+ * Migrations run asynchronously; the number in progress at once is capped,
+ * and a master that took part in a migration is left alone until its next
+ * round, so that its load reports have a chance to catch up. All of the
+ * knobs live in RuntimeOptions, so balancing can be enabled, disabled, or
+ * tuned while the cluster is running.
+ */
+class TabletBalancer : public WorkerTimer {
+  PUBLIC:
+    TabletBalancer(Context* context, TableManager* tableManager,
+            RuntimeOptions* runtimeOptions);
+    ~TabletBalancer();
+    void handleTimerEvent();
+    void start();
+
+  PRIVATE:
+    /**
+     * Load information for one master, computed from its most recent
+     * report.
+     */
+    struct MasterLoad {
+        explicit MasterLoad(ServerId serverId)
+            : serverId(serverId)
+            , load(0)
+            , hottest()
+            , indexletLoad(0)
+            , indexlets()
+        {}
+
+        /// Identifies the master.
+        ServerId serverId;
+
+        /// Total reads and writes over all of the master's tablets.
+        uint64_t load;
+
+        /// The master's most heavily loaded tablet (all zeroes if the
+        /// master didn't report any load).
+        ProtoBuf::MasterRecoveryInfo::TabletLoad hottest;
+
+        /// Total lookups and writes over all of the master's indexlets.
+        uint64_t indexletLoad;
+
+        /// The master's indexlets that could be split (those whose report
+        /// included a split key).
+        vector<ProtoBuf::MasterRecoveryInfo::IndexletLoad> indexlets;
+    };
+
+    /**
+     * A migration started by the balancer that it hasn't reaped yet.
+     */
+    struct Migration {
+        Migration(Context* context, ServerId source, ServerId target,
+                uint64_t tableId, uint64_t firstKeyHash,
+                uint64_t lastKeyHash)
+            : source(source)
+            , target(target)
+            , tableId(tableId)
+            , firstKeyHash(firstKeyHash)
+            , lastKeyHash(lastKeyHash)
+            , rpc(context, source, tableId, firstKeyHash, lastKeyHash, target)
+        {}
+
+        /// Master the range is being moved off of.
+        ServerId source;
+
+        /// Master that will own the range afterwards.
+        ServerId target;
+
+        /// Identifies the range being moved.
+        uint64_t tableId;
+        uint64_t firstKeyHash;
+        uint64_t lastKeyHash;
+
+        /// Asks #source to carry out the migration.
+        MigrateMasterTabletRpc rpc;
+
+      PRIVATE:
+        DISALLOW_COPY_AND_ASSIGN(Migration);
+    };
+
+    /**
+     * An indexlet split started by the balancer that it hasn't reaped
+     * yet. Splitting an indexlet takes several synchronous RPCs, so it
+     * runs in its own thread rather than tying up the timer thread.
+     */
+    struct IndexletSplit {
+        IndexletSplit(ServerId source, ServerId target, uint64_t tableId,
+                uint8_t indexId, const string& splitKey)
+            : source(source)
+            , target(target)
+            , tableId(tableId)
+            , indexId(indexId)
+            , splitKey(splitKey)
+            , finished(0)
+            , thread()
+        {}
+
+        /// Master that owns the indexlet.
+        ServerId source;
+
+        /// Master that will own the upper half afterwards.
+        ServerId target;
+
+        /// Identifies the index.
+        uint64_t tableId;
+        uint8_t indexId;
+
+        /// Keys greater than or equal to this move to #target.
+        string splitKey;
+
+        /// Set to 1 by #thread once the split has completed or failed.
+        Atomic<int> finished;
+
+        /// Runs splitIndexlet.
+        Tub<std::thread> thread;
+
+      PRIVATE:
+        DISALLOW_COPY_AND_ASSIGN(IndexletSplit);
+    };
+
+    void balance();
+    void getLoads(vector<MasterLoad>* loads);
+    void moveLoad(const MasterLoad& hot, const MasterLoad& cold);
+    void reapMigrations(std::set<ServerId>* busy);
+    void splitHotIndexlet(const vector<MasterLoad>& loads,
+            std::set<ServerId>* busy);
+    static void splitIndexlet(TableManager* tableManager,
+            IndexletSplit* split);
+
+    /// Shared RAMCloud information.
+    Context* context;
+
+    /// Tablet map; used to check reported tablets against the current
+    /// configuration and to split tablets.
+    TableManager* tableManager;
+
+    /// Supplies the balancer's configuration (how often to run, how much
+    /// imbalance to tolerate, and how many migrations to run at once).
+    RuntimeOptions* runtimeOptions;
+
+    /// Migrations started by the balancer that it hasn't reaped yet.
+    std::list<Migration> migrations;
+
+    /// The indexlet split in progress, if any.
+    Tub<IndexletSplit> indexletSplit;
+
+    /// How often (in milliseconds) handleTimerEvent checks whether
+    /// balancing has been enabled while it is disabled.
+    static const uint32_t IDLE_POLL_MS = 1000;
+
+    DISALLOW_COPY_AND_ASSIGN(TabletBalancer);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_TABLETBALANCER_H
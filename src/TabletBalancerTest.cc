@@ -0,0 +1,339 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "MockCluster.h"
+#include "TabletBalancer.h"
+
+namespace RAMCloud {
+
+class TabletBalancerTest : public ::testing::Test {
+  public:
+    TestLog::Enable logEnabler;
+    Context context;
+    MockCluster cluster;
+    CoordinatorService* service;
+    CoordinatorServerList* serverList;
+    TableManager* tableManager;
+    RuntimeOptions runtimeOptions;
+    TabletBalancer balancer;
+    ServerConfig masterConfig;
+    ServerId master1;
+    ServerId master2;
+
+    TabletBalancerTest()
+        : logEnabler()
+        , context()
+        , cluster(&context)
+        , service(cluster.coordinator.get())
+        , serverList(service->context->coordinatorServerList)
+        , tableManager(&service->tableManager)
+        , runtimeOptions()
+        , balancer(service->context, tableManager, &runtimeOptions)
+        , masterConfig(ServerConfig::forTesting())
+        , master1()
+        , master2()
+    {
+        masterConfig.services = {WireFormat::MASTER_SERVICE,
+                                 WireFormat::PING_SERVICE,
+                                 WireFormat::MEMBERSHIP_SERVICE};
+        master1 = cluster.addServer(masterConfig)->serverId;
+        master2 = cluster.addServer(masterConfig)->serverId;
+        TestLog::reset();
+    }
+
+    /**
+     * Replace the load report for a master with a single tablet.
+     */
+    void
+    reportLoad(ServerId serverId, uint64_t tableId, uint64_t startKeyHash,
+            uint64_t endKeyHash, uint64_t readCount)
+    {
+        ProtoBuf::MasterRecoveryInfo info;
+        ProtoBuf::MasterRecoveryInfo::TabletLoad* load =
+                info.add_tablet_load();
+        load->set_table_id(tableId);
+        load->set_start_key_hash(startKeyHash);
+        load->set_end_key_hash(endKeyHash);
+        load->set_read_count(readCount);
+        serverList->setMasterRecoveryInfo(serverId, &info);
+    }
+
+    /**
+     * Replace the load report for a master with a single indexlet.
+     */
+    void
+    reportIndexletLoad(ServerId serverId, uint64_t tableId,
+            uint64_t lookupCount, uint64_t byteCount, const char* splitKey)
+    {
+        ProtoBuf::MasterRecoveryInfo info;
+        ProtoBuf::MasterRecoveryInfo::IndexletLoad* load =
+                info.add_indexlet_load();
+        load->set_table_id(tableId);
+        load->set_index_id(1);
+        load->set_lookup_count(lookupCount);
+        load->set_byte_count(byteCount);
+        load->set_split_key(splitKey);
+        serverList->setMasterRecoveryInfo(serverId, &info);
+    }
+
+    /**
+     * Wait for the balancer's indexlet split thread to finish; returns
+     * false if it doesn't finish within a second.
+     */
+    bool
+    waitForIndexletSplit()
+    {
+        for (int i = 0; i < 1000; i++) {
+            if (balancer.indexletSplit->finished.load())
+                return true;
+            usleep(1000);
+        }
+        return false;
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(TabletBalancerTest);
+};
+
+TEST_F(TabletBalancerTest, handleTimerEvent_disabled) {
+    tableManager->createTable("foo", 1);
+    reportLoad(master1, 1, 0, ~0lu, 1000);
+    TestLog::reset();
+    balancer.handleTimerEvent();
+    EXPECT_EQ("", TestLog::get());
+    EXPECT_TRUE(balancer.isRunning());
+    balancer.stop();
+}
+
+TEST_F(TabletBalancerTest, balance_splitAndMigrate) {
+    tableManager->createTable("foo", 1, master1);
+    reportLoad(master1, 1, 0, ~0lu, 1000);
+    TestLog::Enable _("moveLoad", "reapMigrations", NULL);
+    balancer.balance();
+    EXPECT_EQ("moveLoad: Migrating tablet "
+            "[0x8000000000000000,0xffffffffffffffff] in table 1 from 1.0 "
+            "(load 1000) to 2.0 (load 0)", TestLog::get());
+    EXPECT_EQ("{ foo(id 1): { 0x0-0x7fffffffffffffff on 1.0 } "
+            "{ 0x8000000000000000-0xffffffffffffffff on 2.0 } }",
+            tableManager->debugString(true));
+
+    // The next round reaps the migration; neither master is eligible
+    // again until the round after that.
+    TestLog::reset();
+    balancer.balance();
+    EXPECT_EQ("reapMigrations: Finished migrating tablet "
+            "[0x8000000000000000,0xffffffffffffffff] in table 1 "
+            "from 1.0 to 2.0", TestLog::get());
+    EXPECT_EQ(0u, balancer.migrations.size());
+}
+
+TEST_F(TabletBalancerTest, balance_withinThreshold) {
+    tableManager->createTable("foo", 2);
+    reportLoad(master1, 1, 0, 0x7fffffffffffffff, 1100);
+    reportLoad(master2, 1, 0x8000000000000000, ~0lu, 1000);
+    balancer.balance();
+    EXPECT_EQ(0u, balancer.migrations.size());
+
+    runtimeOptions.set("tabletBalancerImbalancePercent", "2");
+    TestLog::Enable _("moveLoad");
+    balancer.balance();
+    // Moving half of master1's tablet would overshoot, so nothing moves.
+    EXPECT_EQ("", TestLog::get());
+    EXPECT_EQ(0u, balancer.migrations.size());
+}
+
+TEST_F(TabletBalancerTest, balance_staleReport) {
+    tableManager->createTable("foo", 1, master1);
+    reportLoad(master1, 1, 0, 0x7fffffffffffffff, 1000);
+    balancer.balance();
+    EXPECT_EQ(0u, balancer.migrations.size());
+    EXPECT_EQ("{ foo(id 1): { 0x0-0xffffffffffffffff on 1.0 } }",
+            tableManager->debugString(true));
+}
+
+TEST_F(TabletBalancerTest, getLoads) {
+    ProtoBuf::MasterRecoveryInfo info;
+    for (uint64_t i = 1; i <= 3; i++) {
+        ProtoBuf::MasterRecoveryInfo::TabletLoad* load =
+                info.add_tablet_load();
+        load->set_table_id(i);
+        load->set_start_key_hash(0);
+        load->set_end_key_hash(~0lu);
+        load->set_read_count(10 * i);
+        load->set_write_count(i % 2);
+    }
+    serverList->setMasterRecoveryInfo(master1, &info);
+
+    vector<TabletBalancer::MasterLoad> loads;
+    balancer.getLoads(&loads);
+    ASSERT_EQ(2u, loads.size());
+    EXPECT_EQ(master1, loads[0].serverId);
+    EXPECT_EQ(62u, loads[0].load);
+    EXPECT_EQ(3u, loads[0].hottest.table_id());
+    EXPECT_EQ(master2, loads[1].serverId);
+    EXPECT_EQ(0u, loads[1].load);
+}
+
+TEST_F(TabletBalancerTest, getLoads_indexlets) {
+    ProtoBuf::MasterRecoveryInfo info;
+    ProtoBuf::MasterRecoveryInfo::IndexletLoad* load =
+            info.add_indexlet_load();
+    load->set_table_id(1);
+    load->set_index_id(1);
+    load->set_lookup_count(30);
+    load->set_write_count(4);
+    load->set_split_key("m");
+    load = info.add_indexlet_load();
+    load->set_table_id(2);
+    load->set_index_id(1);
+    load->set_lookup_count(5);
+    serverList->setMasterRecoveryInfo(master1, &info);
+
+    vector<TabletBalancer::MasterLoad> loads;
+    balancer.getLoads(&loads);
+    ASSERT_EQ(2u, loads.size());
+    EXPECT_EQ(0u, loads[0].load);
+    EXPECT_EQ(39u, loads[0].indexletLoad);
+    ASSERT_EQ(1u, loads[0].indexlets.size());
+    EXPECT_EQ(1u, loads[0].indexlets[0].table_id());
+}
+
+TEST_F(TabletBalancerTest, moveLoad_wholeTablet) {
+    tableManager->createTable("foo", 2);
+    tableManager->createTable("bar", 1, master1);
+    vector<TabletBalancer::MasterLoad> loads;
+    ProtoBuf::MasterRecoveryInfo info;
+    ProtoBuf::MasterRecoveryInfo::TabletLoad* load = info.add_tablet_load();
+    load->set_table_id(1);
+    load->set_start_key_hash(0);
+    load->set_end_key_hash(0x7fffffffffffffff);
+    load->set_read_count(300);
+    load = info.add_tablet_load();
+    load->set_table_id(2);
+    load->set_start_key_hash(0);
+    load->set_end_key_hash(~0lu);
+    load->set_read_count(700);
+    serverList->setMasterRecoveryInfo(master1, &info);
+    balancer.getLoads(&loads);
+
+    // The hottest tablet carries well under two thirds of the gap, so it
+    // moves without being split.
+    loads[0].load = 1500;
+    loads[1].load = 0;
+    TestLog::Enable _("moveLoad");
+    balancer.moveLoad(loads[0], loads[1]);
+    EXPECT_EQ("moveLoad: Migrating tablet [0x0,0xffffffffffffffff] in "
+            "table 2 from 1.0 (load 1500) to 2.0 (load 0)", TestLog::get());
+}
+
+TEST_F(TabletBalancerTest, reapMigrations_failed) {
+    balancer.migrations.emplace_back(service->context, master1, master2,
+            99, 0, ~0lu);
+    std::set<ServerId> busy;
+    TestLog::Enable _("reapMigrations");
+    balancer.reapMigrations(&busy);
+    EXPECT_TRUE(TestUtil::contains(TestLog::get(),
+            "reapMigrations: Migration of tablet [0x0,0xffffffffffffffff] "
+            "in table 99 from 1.0 to 2.0 failed"));
+    EXPECT_EQ(2u, busy.size());
+    EXPECT_EQ(0u, balancer.migrations.size());
+}
+
+TEST_F(TabletBalancerTest, splitHotIndexlet_basics) {
+    reportIndexletLoad(master1, 99, 1000, 0, "m");
+    runtimeOptions.set("indexletSplitOps", "500");
+    vector<TabletBalancer::MasterLoad> loads;
+    balancer.getLoads(&loads);
+    std::set<ServerId> busy;
+    TestLog::Enable _("splitHotIndexlet");
+    balancer.splitHotIndexlet(loads, &busy);
+    EXPECT_EQ("splitHotIndexlet: Splitting indexlet of index 1 in table 99 "
+            "(1000 lookups and writes, 0 bytes) and moving its upper half "
+            "from 1.0 to 2.0", TestLog::get());
+    EXPECT_EQ(2u, busy.size());
+    ASSERT_TRUE(balancer.indexletSplit);
+    EXPECT_EQ("m", balancer.indexletSplit->splitKey);
+    EXPECT_TRUE(waitForIndexletSplit());
+
+    // Only one split runs at a time.
+    busy.clear();
+    TestLog::reset();
+    balancer.splitHotIndexlet(loads, &busy);
+    EXPECT_EQ("", TestLog::get());
+
+    balancer.reapMigrations(&busy);
+    EXPECT_EQ(2u, busy.size());
+    EXPECT_FALSE(balancer.indexletSplit);
+}
+
+TEST_F(TabletBalancerTest, splitHotIndexlet_limits) {
+    reportIndexletLoad(master1, 99, 1000, 3 << 20, "m");
+    vector<TabletBalancer::MasterLoad> loads;
+    balancer.getLoads(&loads);
+    std::set<ServerId> busy;
+
+    // Both limits are disabled by default.
+    balancer.splitHotIndexlet(loads, &busy);
+    EXPECT_FALSE(balancer.indexletSplit);
+
+    runtimeOptions.set("indexletSplitOps", "1000");
+    runtimeOptions.set("indexletSplitMB", "3");
+    balancer.splitHotIndexlet(loads, &busy);
+    EXPECT_FALSE(balancer.indexletSplit);
+
+    // The owner is busy.
+    runtimeOptions.set("indexletSplitMB", "2");
+    busy.insert(master1);
+    balancer.splitHotIndexlet(loads, &busy);
+    EXPECT_FALSE(balancer.indexletSplit);
+
+    busy.clear();
+    TestLog::Enable _("splitIndexlet");
+    balancer.splitHotIndexlet(loads, &busy);
+    ASSERT_TRUE(balancer.indexletSplit);
+    EXPECT_TRUE(waitForIndexletSplit());
+    EXPECT_EQ("splitIndexlet: Didn't split indexlet of index 1 in table 99: "
+            "no such table", TestLog::get());
+}
+
+TEST_F(TabletBalancerTest, splitIndexlet) {
+    tableManager->createTable("foo", 1, master1);
+    tableManager->createIndex(1, 1, IndexKey::BTREE_INDEX, 1);
+    Server* ownerServer = cluster.servers[0];
+    Server* otherServer = cluster.servers[1];
+    if (ownerServer->master->indexletManager.getNumIndexlets() == 0)
+        std::swap(ownerServer, otherServer);
+    MasterService* owner = ownerServer->master.get();
+    MasterService* other = otherServer->master.get();
+    owner->indexletManager.insertEntry(1, 1, "abcd", 4, 2581U);
+    owner->indexletManager.insertEntry(1, 1, "tuvw", 4, 9213U);
+    owner->objectManager.log.sync();
+
+    // Run the split in this thread, rather than the balancer's.
+    TabletBalancer::IndexletSplit split(ownerServer->serverId,
+            otherServer->serverId, 1, 1, "m");
+    TestLog::Enable _("splitIndexlet");
+    TabletBalancer::splitIndexlet(tableManager, &split);
+    EXPECT_EQ("splitIndexlet: Finished splitting indexlet of index 1 in "
+            "table 1", TestLog::get());
+    EXPECT_EQ(1, split.finished.load());
+    EXPECT_EQ(1u, other->indexletManager.getNumIndexlets());
+    EXPECT_TRUE(other->indexletManager.existsIndexEntry(
+            1, 1, "tuvw", 4, 9213U));
+    EXPECT_FALSE(owner->indexletManager.existsIndexEntry(
+            1, 1, "tuvw", 4, 9213U));
+}
+
+}  // namespace RAMCloud
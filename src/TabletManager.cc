@@ -15,18 +15,27 @@
 #include <algorithm>
 
 #include "ClientException.h"
+#include "Fence.h"
 #include "TabletManager.h"
+#include "ThreadId.h"
 #include "TimeTrace.h"
 #include "Util.h"
 
 namespace RAMCloud {
 
 TabletManager::TabletManager()
-    : tabletMap()
+    : tablets(new TabletMap())
+    , readers()
     , lock("TabletManager::lock")
+    , hotKeys()
 {
 }
 
+TabletManager::~TabletManager()
+{
+    delete tablets.load();
+}
+
 /**
  * Add a new tablet to this TabletManager's list of tablets. If the tablet
  * already exists or overlaps with any other tablets, the call will fail.
@@ -51,15 +60,19 @@ TabletManager::addTablet(uint64_t tableId,
                          TabletState state)
 {
     SpinLock::Guard guard(lock);
+    TabletMap* current = tablets.load();
 
     // If an existing tablet overlaps this range at all, fail.
-    if (lookup(tableId, startKeyHash, guard) != tabletMap.end() ||
-      lookup(tableId, endKeyHash, guard) != tabletMap.end()) {
+    if (lookup(current, tableId, startKeyHash) != current->end() ||
+      lookup(current, tableId, endKeyHash) != current->end()) {
         return false;
     }
 
-    tabletMap.insert(std::make_pair(tableId,
-                     Tablet(tableId, startKeyHash, endKeyHash, state)));
+    TabletMap* updated = new TabletMap(*current);
+    updated->insert(std::make_pair(tableId, TabletEntry(
+            Tablet(tableId, startKeyHash, endKeyHash, state),
+            std::make_shared<TabletCounters>())));
+    publish(updated, guard);
     return true;
 }
 
@@ -71,24 +84,35 @@ TabletManager::addTablet(uint64_t tableId,
  *
  * \param key
  *      The Key whose tablet we're looking up.
+ * \param oldestSync
+ *      A READ_REPLICA tablet is also accepted if it held all of its
+ *      primary's data as of this Cycles::rdtsc() time or later (see
+ *      #setSyncTime). The default accepts only NORMAL tablets.
  * \return
  *      True if a tablet was found, otherwise false.
  */
 bool
-TabletManager::checkAndIncrementReadCount(Key& key) {
-    SpinLock::Guard guard(lock);
-    TabletMap::iterator it = lookup(key.getTableId(), key.getHash(), guard);
+TabletManager::checkAndIncrementReadCount(Key& key, uint64_t oldestSync) {
+    ReadGuard reader(*this);
+    TabletMap::iterator it = lookup(reader.tablets, key.getTableId(),
+                                    key.getHash());
 
-    if (it == tabletMap.end())
+    if (it == reader.tablets->end())
         return false;
-    if (it->second.state != NORMAL) {
-        if (it->second.state == TabletManager::LOCKED_FOR_MIGRATION)
+    TabletState state = it->second.tablet.state;
+    if (state == READ_REPLICA) {
+        uint64_t syncTime = it->second.counters->syncTime.load();
+        if (syncTime == 0 || syncTime < oldestSync)
+            return false;
+    } else if (state != NORMAL) {
+        if (state == TabletManager::LOCKED_FOR_MIGRATION)
             throw RetryException(HERE, 1000, 2000,
                     "Tablet is currently locked for migration!");
         return false;
     }
 
-    it->second.readCount++;
+    it->second.counters->shards[getShard()].readCount.add(1);
+    hotKeys.record(key.getTableId(), key.getHash());
     return true;
 }
 
@@ -131,14 +155,14 @@ TabletManager::getTablet(Key& key, Tablet* outTablet)
 bool
 TabletManager::getTablet(uint64_t tableId, uint64_t keyHash, Tablet* outTablet)
 {
-    SpinLock::Guard guard(lock);
+    ReadGuard reader(*this);
 
-    TabletMap::iterator it = lookup(tableId, keyHash, guard);
-    if (it == tabletMap.end())
+    TabletMap::iterator it = lookup(reader.tablets, tableId, keyHash);
+    if (it == reader.tablets->end())
         return false;
 
     if (outTablet != NULL)
-        *outTablet = it->second;
+        *outTablet = it->second.tablet;
     return true;
 }
 
@@ -167,13 +191,13 @@ TabletManager::getTablet(uint64_t tableId,
                          uint64_t endKeyHash,
                          Tablet* outTablet)
 {
-    SpinLock::Guard guard(lock);
+    ReadGuard reader(*this);
 
-    TabletMap::iterator it = lookup(tableId, startKeyHash, guard);
-    if (it == tabletMap.end())
+    TabletMap::iterator it = lookup(reader.tablets, tableId, startKeyHash);
+    if (it == reader.tablets->end())
         return false;
 
-    Tablet* t = &it->second;
+    Tablet* t = &it->second.tablet;
     if (t->startKeyHash != startKeyHash || t->endKeyHash != endKeyHash)
         return false;
 
@@ -192,11 +216,12 @@ TabletManager::getTablet(uint64_t tableId,
 void
 TabletManager::getTablets(vector<Tablet>* outTablets)
 {
-    SpinLock::Guard _(lock);
+    ReadGuard reader(*this);
 
-    TabletMap::iterator it = tabletMap.begin();
-    for (size_t i = 0; it != tabletMap.end(); i++) {
-        outTablets->push_back(it->second);
+    TabletMap::iterator it = reader.tablets->begin();
+    for (size_t i = 0; it != reader.tablets->end(); i++) {
+        outTablets->push_back(it->second.tablet);
+        sumCounts(&it->second, &outTablets->back());
         ++it;
     }
 }
@@ -224,16 +249,17 @@ TabletManager::deleteTablet(uint64_t tableId,
                             uint64_t endKeyHash)
 {
     SpinLock::Guard guard(lock);
+    std::unique_ptr<TabletMap> updated(new TabletMap(*tablets.load()));
 
-    TabletMap::iterator it = lookup(tableId, startKeyHash, guard);
-    if (it == tabletMap.end()) {
+    TabletMap::iterator it = lookup(updated.get(), tableId, startKeyHash);
+    if (it == updated->end()) {
         RAMCLOUD_LOG(DEBUG, "Could not find tablet in tableId %lu with "
                             "startKeyHash %lu and endKeyHash %lu",
                             tableId, startKeyHash, endKeyHash);
         return false;
     }
 
-    Tablet* t = &it->second;
+    Tablet* t = &it->second.tablet;
     if (t->startKeyHash != startKeyHash || t->endKeyHash != endKeyHash) {
         RAMCLOUD_LOG(ERROR, "Could not find tablet in tableId %lu with "
                             "startKeyHash %lu and endKeyHash %lu: "
@@ -242,7 +268,8 @@ TabletManager::deleteTablet(uint64_t tableId,
         throw InternalError(HERE, STATUS_INTERNAL_ERROR);
     }
 
-    tabletMap.erase(it);
+    updated->erase(it);
+    publish(updated.release(), guard);
     return true;
 }
 
@@ -268,26 +295,30 @@ TabletManager::splitTablet(uint64_t tableId,
                            uint64_t splitKeyHash)
 {
     SpinLock::Guard guard(lock);
+    std::unique_ptr<TabletMap> updated(new TabletMap(*tablets.load()));
 
-    TabletMap::iterator it = lookup(tableId, splitKeyHash, guard);
-    if (it == tabletMap.end())
+    TabletMap::iterator it = lookup(updated.get(), tableId, splitKeyHash);
+    if (it == updated->end())
         return false;
 
-    Tablet* t = &it->second;
+    Tablet* t = &it->second.tablet;
 
     // If a split already exists in the master's tablet map, lookup
     // will return the tablet whose startKeyHash matches splitKeyHash.
     // So to make it idempotent, check for this condition before you
     // decide to do the split
     if (splitKeyHash != t->startKeyHash) {
-        tabletMap.insert(std::make_pair(tableId, Tablet
-                         (tableId, splitKeyHash, t->endKeyHash, t->state)));
+        Tablet upperHalf(tableId, splitKeyHash, t->endKeyHash, t->state);
         t->endKeyHash = splitKeyHash - 1;
 
         // It's unclear what to do with the counts when splitting. The old
         // behavior was to simply zero them, so for the time being we'll
         // stick with that. At the very least it's what Christian expects.
-        t->readCount = t->writeCount = 0;
+        it->second.counters = std::make_shared<TabletCounters>();
+
+        updated->insert(std::make_pair(tableId, TabletEntry(upperHalf,
+                        std::make_shared<TabletCounters>())));
+        publish(updated.release(), guard);
     }
 
     return true;
@@ -322,12 +353,13 @@ TabletManager::changeState(uint64_t tableId,
                            TabletState newState)
 {
     SpinLock::Guard guard(lock);
+    std::unique_ptr<TabletMap> updated(new TabletMap(*tablets.load()));
 
-    TabletMap::iterator it = lookup(tableId, startKeyHash, guard);
-    if (it == tabletMap.end())
+    TabletMap::iterator it = lookup(updated.get(), tableId, startKeyHash);
+    if (it == updated->end())
         return false;
 
-    Tablet* t = &it->second;
+    Tablet* t = &it->second.tablet;
     if (t->startKeyHash != startKeyHash || t->endKeyHash != endKeyHash)
         return false;
 
@@ -335,6 +367,42 @@ TabletManager::changeState(uint64_t tableId,
         return false;
 
     t->state = newState;
+    publish(updated.release(), guard);
+    return true;
+}
+
+/**
+ * Record how up to date a READ_REPLICA tablet is, once its primary has
+ * sent it everything up to some point.
+ *
+ * \param tableId
+ *      Identifier of the table the tablet belongs to.
+ * \param startKeyHash
+ *      The first key hash value that the tablet owns.
+ * \param endKeyHash
+ *      The last key hash value that the tablet owns.
+ * \param syncTime
+ *      Cycles::rdtsc() time as of which the tablet holds all of its
+ *      primary's data.
+ * \return
+ *      True if the time was recorded; false if there is no READ_REPLICA
+ *      tablet with exactly this range.
+ */
+bool
+TabletManager::setSyncTime(uint64_t tableId,
+                           uint64_t startKeyHash,
+                           uint64_t endKeyHash,
+                           uint64_t syncTime)
+{
+    ReadGuard reader(*this);
+    TabletMap::iterator it = lookup(reader.tablets, tableId, startKeyHash);
+    if (it == reader.tablets->end())
+        return false;
+    Tablet* t = &it->second.tablet;
+    if (t->startKeyHash != startKeyHash || t->endKeyHash != endKeyHash ||
+            t->state != READ_REPLICA)
+        return false;
+    it->second.counters->syncTime.store(syncTime);
     return true;
 }
 
@@ -355,10 +423,12 @@ TabletManager::incrementReadCount(Key& key)
 void
 TabletManager::incrementReadCount(uint64_t tableId, KeyHash keyHash)
 {
-    SpinLock::Guard guard(lock);
-    TabletMap::iterator it = lookup(tableId, keyHash, guard);
-    if (it != tabletMap.end())
-        it->second.readCount++;
+    ReadGuard reader(*this);
+    TabletMap::iterator it = lookup(reader.tablets, tableId, keyHash);
+    if (it != reader.tablets->end()) {
+        it->second.counters->shards[getShard()].readCount.add(1);
+        hotKeys.record(tableId, keyHash);
+    }
 }
 
 /**
@@ -378,24 +448,43 @@ TabletManager::incrementWriteCount(Key& key)
 void
 TabletManager::incrementWriteCount(uint64_t tableId, KeyHash keyHash)
 {
-    SpinLock::Guard guard(lock);
-    TabletMap::iterator it = lookup(tableId, keyHash, guard);
-    if (it != tabletMap.end())
-        it->second.writeCount++;
+    ReadGuard reader(*this);
+    TabletMap::iterator it = lookup(reader.tablets, tableId, keyHash);
+    if (it != reader.tablets->end()) {
+        it->second.counters->shards[getShard()].writeCount.add(1);
+        hotKeys.record(tableId, keyHash);
+    }
+}
+
+/**
+ * Return the keys in our tablets that have been read and written most
+ * often recently (see HotKeyDetector). This is meant to guide decisions
+ * such as which tablets to split or which keys to cache.
+ *
+ * \param[out] hotKeys
+ *      The hot keys are appended here, most frequently accessed first.
+ */
+void
+TabletManager::getHotKeys(vector<HotKeyDetector::HotKey>* hotKeys)
+{
+    this->hotKeys.getHotKeys(hotKeys);
 }
 
 /**
  * Populate a ServerStatistics protocol buffer with read and write statistics
- * gathered for our tablets.
+ * gathered for our tablets, along with the hottest individual keys. This is
+ * where the per-thread counts are added up.
  */
 void
 TabletManager::getStatistics(ProtoBuf::ServerStatistics* serverStatistics)
 {
-    SpinLock::Guard _(lock);
+    ReadGuard reader(*this);
 
-    TabletMap::iterator it = tabletMap.begin();
-    while (it != tabletMap.end()) {
-        Tablet* t = &it->second;
+    TabletMap::iterator it = reader.tablets->begin();
+    while (it != reader.tablets->end()) {
+        Tablet tablet = it->second.tablet;
+        sumCounts(&it->second, &tablet);
+        Tablet* t = &tablet;
         ProtoBuf::ServerStatistics_TabletEntry* entry =
             serverStatistics->add_tabletentry();
         entry->set_table_id(t->tableId);
@@ -406,6 +495,7 @@ TabletManager::getStatistics(ProtoBuf::ServerStatistics* serverStatistics)
             entry->set_number_read_and_writes(totalOperations);
         ++it;
     }
+    hotKeys.getStatistics(serverStatistics);
 }
 
 /**
@@ -414,8 +504,8 @@ TabletManager::getStatistics(ProtoBuf::ServerStatistics* serverStatistics)
 size_t
 TabletManager::getNumTablets()
 {
-    SpinLock::Guard _(lock);
-    return tabletMap.size();
+    ReadGuard reader(*this);
+    return reader.tablets->size();
 }
 
 
@@ -459,26 +549,17 @@ compareTablet(const TabletManager::Tablet &a,
 string
 TabletManager::toString()
 {
-    SpinLock::Guard _(lock);
     string output;
+    vector<Tablet> tablets;
+    getTablets(&tablets);
 
 // Sort output on debug
 #if DEBUG_BUILD
-    TabletMap::iterator it;
-    vector<Tablet> tablets;
-
-    for (it = tabletMap.begin(); it != tabletMap.end(); ++it)
-        tablets.push_back(it->second);
     sort(tablets.begin(), tablets.end(), compareTablet);
+#endif
 
     for (size_t i = 0; i < tablets.size(); ++i)
         printTablet(&tablets[i], &output);
-#else
-    for (TabletMap::iterator it = tabletMap.begin();
-            it != tabletMap.end(); ++it) {
-       printTablet(&(it->second), &output);
-    }
-#endif
 
     return output;
 }
@@ -487,33 +568,116 @@ TabletManager::toString()
  * Helper for the public methods that need to look up a tablet. This method
  * iterates over all candidates in the multimap.
  *
+ * \param tablets
+ *      The map to search: either the one referenced by a ReadGuard, or a
+ *      private copy that is about to be published.
  * \param tableId
  *      Identifier of the table to look up.
  * \param keyHash
  *      Key hash value corresponding to the desired tablet.
- * \param lock
- *      Ensures that the caller holds the monitor lock; not actually used.
  * \return
  *      A TabletMap::iterator is returned. If no tablet was found, it will be
- *      equal to tabletMap.end(). Otherwise, it will refer to the desired
+ *      equal to tablets->end(). Otherwise, it will refer to the desired
  *      tablet.
  *
  *      An iterator, rather than a Tablet pointer is returned to facilitate
  *      efficient deletion.
  */
 TabletManager::TabletMap::iterator
-TabletManager::lookup(uint64_t tableId, uint64_t keyHash,
-                      const SpinLock::Guard& lock)
+TabletManager::lookup(TabletMap* tablets, uint64_t tableId, uint64_t keyHash)
 {
-    auto range = tabletMap.equal_range(tableId);
+    auto range = tablets->equal_range(tableId);
     TabletMap::iterator end = range.second;
     for (TabletMap::iterator it = range.first; it != end; it++) {
-        Tablet* t = &it->second;
+        Tablet* t = &it->second.tablet;
         if (keyHash >= t->startKeyHash && keyHash <= t->endKeyHash)
             return it;
     }
 
-    return tabletMap.end();
+    return tablets->end();
+}
+
+/**
+ * Replace the current tablet data with a new version, then free the old
+ * version once no reader can still be using it.
+ *
+ * \param newTablets
+ *      The new version of the tablet data. This object takes ownership of
+ *      it; it must not be modified after this call.
+ * \param lock
+ *      Ensures that the caller holds the monitor lock; not actually used.
+ */
+void
+TabletManager::publish(TabletMap* newTablets, const SpinLock::Guard& lock)
+{
+    Fence::sfence();
+    TabletMap* oldTablets = tablets.exchange(newTablets);
+    Fence::enter();
+
+    // Any reader that could have loaded oldTablets registered itself in its
+    // shard's count before doing so, and new readers will see newTablets.
+    // So once each count has been seen at zero, nobody is using oldTablets.
+    // Lookups are short and never block, so this doesn't take long.
+    for (int i = 0; i < NUM_SHARDS; i++) {
+        while (readers[i].count.load() != 0) {
+            // Wait for the readers in this shard to finish.
+        }
+    }
+    delete oldTablets;
+}
+
+/**
+ * Return the shard that the calling thread should use for reader and
+ * operation counts.
+ */
+inline int
+TabletManager::getShard()
+{
+    return ThreadId::get() & (NUM_SHARDS - 1);
+}
+
+/**
+ * Add up the per-thread read and write counts for a tablet.
+ *
+ * \param entry
+ *      The tablet whose counts are desired.
+ * \param[out] outTablet
+ *      The readCount and writeCount fields of this object are filled in
+ *      with the totals.
+ */
+void
+TabletManager::sumCounts(TabletEntry* entry, Tablet* outTablet)
+{
+    outTablet->readCount = 0;
+    outTablet->writeCount = 0;
+    for (int i = 0; i < NUM_SHARDS; i++) {
+        outTablet->readCount += entry->counters->shards[i].readCount.load();
+        outTablet->writeCount += entry->counters->shards[i].writeCount.load();
+    }
+}
+
+/**
+ * Construct a ReadGuard, which makes the current tablet data available
+ * through its #tablets member until it is destroyed.
+ *
+ * \param tabletManager
+ *      The TabletManager whose tablets are about to be looked up.
+ */
+TabletManager::ReadGuard::ReadGuard(TabletManager& tabletManager)
+    : tablets(NULL)
+    , readers(&tabletManager.readers[getShard()].count)
+{
+    // The increment is a locked instruction, so it is visible to publish()
+    // before we load the map below.
+    readers->add(1);
+    Fence::enter();
+    tablets = tabletManager.tablets.load();
+}
+
+TabletManager::ReadGuard::~ReadGuard()
+{
+    Fence::leave();
+    readers->add(-1);
 }
 
 } // namespace
@@ -16,11 +16,14 @@
 #ifndef RAMCLOUD_TABLETMANAGER_H
 #define RAMCLOUD_TABLETMANAGER_H
 
+#include <memory>
 #include <unordered_map>
 
+#include "Atomic.h"
 #include "Common.h"
 #include "Object.h"
 #include "HashTable.h"
+#include "HotKeyDetector.h"
 #include "ServerStatistics.pb.h"
 #include "SpinLock.h"
 #include "Tablets.pb.h"
@@ -35,13 +38,20 @@ namespace RAMCloud {
  * may exist in the hash table temporarily for tablets that are not yet owned.
  * This happens, for instance, during crash recovery and tablet migration.
  *
- * This class is thread-safe (a monitor lock is used to support concurrent
- * access). When looking up tablets (see the getTablet() methods) a snapshot of
- * the current tablet's data is returned to the caller. This copying avoids the
- * need for atomic operations or other synchronization each time a field is
- * read. The downside, of course, is that the caller needs to be aware that the
- * actual state may be permuted at any time and will not be reflected in the
- * cached copy obtained during the lookup.
+ * This class is thread-safe. When looking up tablets (see the getTablet()
+ * methods) a snapshot of the current tablet's data is returned to the caller.
+ * This copying avoids the need for atomic operations or other synchronization
+ * each time a field is read. The downside, of course, is that the caller needs
+ * to be aware that the actual state may be permuted at any time and will not
+ * be reflected in the cached copy obtained during the lookup.
+ *
+ * Lookups happen on every object operation, while tablets change rarely, so
+ * the tablets are kept in an immutable TabletMap that lookups read without
+ * taking any lock shared with other threads (see ReadGuard). Methods that
+ * change tablets build a modified copy of the map, publish it, and free the
+ * old map once no reader can still be using it. Per-tablet operation counts
+ * are likewise split across per-thread shards (see TabletCounters) and only
+ * summed when they are reported.
  */
 class TabletManager {
   PUBLIC:
@@ -60,6 +70,7 @@ class TabletManager {
         RECOVERING = ProtoBuf::Tablets_Tablet_State_RECOVERING,
         LOCKED_FOR_MIGRATION =
             ProtoBuf::Tablets_Tablet_State_LOCKED_FOR_MIGRATION,
+        READ_REPLICA = ProtoBuf::Tablets_Tablet_State_READ_REPLICA,
     };
 
     /**
@@ -109,18 +120,22 @@ class TabletManager {
         TabletState state;
 
         /// The number of read operations performed on objects in this tablet.
+        /// Only filled in by getTablets(); the getTablet() methods leave it
+        /// 0, since adding up the counts is relatively expensive.
         uint64_t readCount;
 
         /// The number of write operations performed on objects in this tablet.
+        /// Filled in the same way as #readCount.
         uint64_t writeCount;
     };
 
     TabletManager();
+    ~TabletManager();
     bool addTablet(uint64_t tableId,
                    uint64_t startKeyHash,
                    uint64_t endKeyHash,
                    TabletState state);
-    bool checkAndIncrementReadCount(Key& key);
+    bool checkAndIncrementReadCount(Key& key, uint64_t oldestSync = ~0UL);
     bool getTablet(Key& key,
                    Tablet* outTablet = NULL);
     bool getTablet(uint64_t tableId,
@@ -141,31 +156,146 @@ class TabletManager {
                      uint64_t endKeyHash,
                      TabletState oldState,
                      TabletState newState);
+    bool setSyncTime(uint64_t tableId,
+                     uint64_t startKeyHash,
+                     uint64_t endKeyHash,
+                     uint64_t syncTime);
     void incrementReadCount(Key& key);
     void incrementReadCount(uint64_t tableId,
                             KeyHash keyHash);
     void incrementWriteCount(Key& key);
     void incrementWriteCount(uint64_t tableId,
                              KeyHash keyHash);
+    void getHotKeys(vector<HotKeyDetector::HotKey>* hotKeys);
     void getStatistics(ProtoBuf::ServerStatistics* serverStatistics);
     size_t getNumTablets();
     string toString();
 
   PRIVATE:
+    /// Number of shards that reader counts and per-tablet operation counts
+    /// are split into. Threads are assigned to shards by ThreadId. Must be a
+    /// power of two.
+    static const int NUM_SHARDS = 16;
+
+    /**
+     * The read and write counts for one tablet. Each thread counts in the
+     * shard for its ThreadId, so that threads operating on the same tablet
+     * don't bounce a single cache line between them. The shards are only
+     * added up when statistics are requested.
+     */
+    struct TabletCounters {
+        TabletCounters()
+            : shards()
+            , syncTime(0)
+        {
+        }
+
+        /// This thread's share of the counts, padded out to a cache line.
+        struct Shard {
+            Shard()
+                : readCount(0)
+                , writeCount(0)
+                , pad()
+            {
+            }
+            Atomic<uint64_t> readCount;
+            Atomic<uint64_t> writeCount;
+            char pad[48];
+        };
+        static_assert(sizeof(Shard) == 64, "Shard isn't one cache line");
+
+        Shard shards[NUM_SHARDS];
+
+        /// Only used for READ_REPLICA tablets: the Cycles::rdtsc() time as
+        /// of which the tablet held all of its primary's data; 0 until the
+        /// replica is first synced. Kept here rather than in the Tablet so
+        /// that syncs needn't publish a new TabletMap.
+        Atomic<uint64_t> syncTime;
+
+        DISALLOW_COPY_AND_ASSIGN(TabletCounters);
+    };
+
+    /**
+     * An element of a TabletMap: a tablet (whose readCount and writeCount
+     * are unused) and its counters. The counters are shared by every version
+     * of the map that contains the tablet, so counts survive updates to
+     * other tablets.
+     */
+    struct TabletEntry {
+        TabletEntry(const Tablet& tablet,
+                    const std::shared_ptr<TabletCounters>& counters)
+            : tablet(tablet)
+            , counters(counters)
+        {
+        }
+        Tablet tablet;
+        std::shared_ptr<TabletCounters> counters;
+    };
+
     /// Tablets are stored in a multimap that is indexed by table identifier.
     /// The assumption is that we are likely to have many tablets, but
     /// relatively few for the same table.
-    typedef std::unordered_multimap<uint64_t, Tablet> TabletMap;
+    typedef std::unordered_multimap<uint64_t, TabletEntry> TabletMap;
 
-    TabletMap::iterator lookup(uint64_t tableId, uint64_t keyHash,
-                               const SpinLock::Guard& lock);
+    /**
+     * The number of threads in the middle of a lookup, for one shard of
+     * threads, padded out to a cache line.
+     */
+    struct ReaderCount {
+        ReaderCount()
+            : count(0)
+            , pad()
+        {
+        }
+        Atomic<uint64_t> count;
+        char pad[56];
+    };
 
-    /// This unordered_multimap is used to store and access all tablet data.
-    TabletMap tabletMap;
+    /**
+     * An instance of this class is held while looking up tablets. It gives
+     * access to the current TabletMap and keeps that map from being freed
+     * until the instance is destroyed. It only modifies the ReaderCount for
+     * the current thread's shard, so lookups in different threads don't
+     * contend.
+     */
+    class ReadGuard {
+      public:
+        explicit ReadGuard(TabletManager& tabletManager);
+        ~ReadGuard();
 
-    /// Monitor spinlock used to protect the tabletMap from concurrent access.
+        /// The tablets as of the start of the lookup. Never NULL.
+        TabletMap* tablets;
+
+      PRIVATE:
+        /// Count of readers in our shard; incremented by the constructor
+        /// and decremented by the destructor.
+        Atomic<uint64_t>* readers;
+
+        DISALLOW_COPY_AND_ASSIGN(ReadGuard);
+    };
+
+    static TabletMap::iterator lookup(TabletMap* tablets,
+                                      uint64_t tableId,
+                                      uint64_t keyHash);
+    void publish(TabletMap* newTablets, const SpinLock::Guard& lock);
+    static int getShard();
+    static void sumCounts(TabletEntry* entry, Tablet* outTablet);
+
+    /// The current version of all tablet data. Readers access it only
+    /// through a ReadGuard; it is replaced (never modified) by #publish().
+    Atomic<TabletMap*> tablets;
+
+    /// Counts of threads currently reading #tablets, one per shard. See
+    /// ReadGuard.
+    ReaderCount readers[NUM_SHARDS];
+
+    /// Serializes the methods that modify tablets.
     SpinLock lock;
 
+    /// Keeps track of the individual keys in our tablets that are read and
+    /// written most often.
+    HotKeyDetector hotKeys;
+
     DISALLOW_COPY_AND_ASSIGN(TabletManager);
 };
 
@@ -30,10 +30,10 @@ class TabletManagerTest : public ::testing::Test {
     string
     toString(TabletManager::TabletMap::iterator it)
     {
-        if (it == tm.tabletMap.end()) {
+        if (it == tm.tablets.load()->end()) {
             return "end";
         }
-        TabletManager::Tablet* tablet = &it->second;
+        TabletManager::Tablet* tablet = &it->second.tablet;
         return format("tableId: %lu, start: %lu, end: %lu",
                 tablet->tableId, tablet->startKeyHash, tablet->endKeyHash);
     }
@@ -41,7 +41,7 @@ class TabletManagerTest : public ::testing::Test {
 };
 
 TEST_F(TabletManagerTest, constructor) {
-    EXPECT_EQ(0U, tm.tabletMap.size());
+    EXPECT_EQ(0U, tm.tablets.load()->size());
 }
 
 TEST_F(TabletManagerTest, addTablet) {
@@ -51,9 +51,8 @@ TEST_F(TabletManagerTest, addTablet) {
     EXPECT_FALSE(tm.addTablet(0, 20, 30, TabletManager::NORMAL));
     EXPECT_FALSE(tm.addTablet(0, 0, 15, TabletManager::NORMAL));
 
-    SpinLock lock("TabletManagerTest");
-    SpinLock::Guard fakeGuard(lock);
-    TabletManager::Tablet* tablet = &tm.lookup(0, 10, fakeGuard)->second;
+    TabletManager::Tablet* tablet =
+            &tm.lookup(tm.tablets.load(), 0, 10)->second.tablet;
     EXPECT_EQ(0U, tablet->tableId);
     EXPECT_EQ(10U, tablet->startKeyHash);
     EXPECT_EQ(20U, tablet->endKeyHash);
@@ -80,6 +79,32 @@ TEST_F(TabletManagerTest, checkAndIncrementReadCount) {
             tm.toString());
 }
 
+TEST_F(TabletManagerTest, checkAndIncrementReadCount_readReplica) {
+    Key key(5, "1", 1);
+    tm.addTablet(5, 0, ~0UL, TabletManager::READ_REPLICA);
+
+    // Never synced: no reads at all.
+    EXPECT_FALSE(tm.checkAndIncrementReadCount(key, 1));
+
+    EXPECT_TRUE(tm.setSyncTime(5, 0, ~0UL, 100));
+    EXPECT_TRUE(tm.checkAndIncrementReadCount(key, 100));
+    EXPECT_FALSE(tm.checkAndIncrementReadCount(key, 101));
+
+    // Ordinary reads (which don't accept stale data) are refused.
+    EXPECT_FALSE(tm.checkAndIncrementReadCount(key));
+}
+
+TEST_F(TabletManagerTest, setSyncTime) {
+    EXPECT_FALSE(tm.setSyncTime(5, 0, 10, 100));
+    tm.addTablet(5, 0, 10, TabletManager::NORMAL);
+    tm.addTablet(5, 11, 20, TabletManager::READ_REPLICA);
+    EXPECT_FALSE(tm.setSyncTime(5, 0, 10, 100));
+    EXPECT_FALSE(tm.setSyncTime(5, 11, 19, 100));
+    EXPECT_TRUE(tm.setSyncTime(5, 11, 20, 100));
+    EXPECT_EQ(100U, tm.lookup(tm.tablets.load(), 5, 15)->
+            second.counters->syncTime.load());
+}
+
 TEST_F(TabletManagerTest, getTablet_byKey) {
     Key key(5, "hi", 2);
     EXPECT_FALSE(tm.getTablet(key));
@@ -223,6 +248,20 @@ TEST_F(TabletManagerTest, changeState) {
     EXPECT_EQ(TabletManager::NORMAL, tablet.state);
 }
 
+TEST_F(TabletManagerTest, changeState_keepsCounts) {
+    EXPECT_TRUE(tm.addTablet(0, 10, 20, TabletManager::NORMAL));
+    tm.incrementReadCount(0, 15);
+    tm.incrementWriteCount(0, 15);
+    TabletManager::TabletMap* before = tm.tablets.load();
+
+    EXPECT_TRUE(tm.changeState(0, 10, 20, TabletManager::NORMAL,
+                                          TabletManager::RECOVERING));
+    EXPECT_NE(before, tm.tablets.load());
+    EXPECT_EQ("{ tableId: 0 startKeyHash: 10 "
+                  "endKeyHash: 20 state: 1 reads: 1 writes: 1 }",
+              tm.toString());
+}
+
 TEST_F(TabletManagerTest, getStatistics) {
     {
         ProtoBuf::ServerStatistics stats;
@@ -285,9 +324,6 @@ TEST_F(TabletManagerTest, toString) {
 }
 
 TEST_F(TabletManagerTest, lookup) {
-    SpinLock lock("TabletManagerTest");
-    SpinLock::Guard fakeGuard(lock);
-
     EXPECT_TRUE(tm.addTablet(1000, 50, 99, TabletManager::NORMAL));
     EXPECT_TRUE(tm.addTablet(1000, 100, 199, TabletManager::NORMAL));
     EXPECT_TRUE(tm.addTablet(2000, 500, 599, TabletManager::NORMAL));
@@ -295,50 +331,89 @@ TEST_F(TabletManagerTest, lookup) {
     EXPECT_TRUE(tm.addTablet(3000, 2000, 2999, TabletManager::NORMAL));
     EXPECT_TRUE(tm.addTablet(3000, 5000, 5999, TabletManager::NORMAL));
 
-    EXPECT_EQ("end", toString(tm.lookup(1000, 49, fakeGuard)));
+    EXPECT_EQ("end", toString(tm.lookup(tm.tablets.load(), 1000, 49)));
     EXPECT_EQ("tableId: 1000, start: 50, end: 99",
-        toString(tm.lookup(1000, 50, fakeGuard)));
+        toString(tm.lookup(tm.tablets.load(), 1000, 50)));
     EXPECT_EQ("tableId: 1000, start: 50, end: 99",
-        toString(tm.lookup(1000, 99, fakeGuard)));
+        toString(tm.lookup(tm.tablets.load(), 1000, 99)));
     EXPECT_EQ("tableId: 1000, start: 100, end: 199",
-        toString(tm.lookup(1000, 100, fakeGuard)));
-    EXPECT_EQ("end", toString(tm.lookup(1000, 200, fakeGuard)));
-    EXPECT_EQ("end", toString(tm.lookup(1000, 550, fakeGuard)));
+        toString(tm.lookup(tm.tablets.load(), 1000, 100)));
+    EXPECT_EQ("end", toString(tm.lookup(tm.tablets.load(), 1000, 200)));
+    EXPECT_EQ("end", toString(tm.lookup(tm.tablets.load(), 1000, 550)));
 
-    EXPECT_EQ("end", toString(tm.lookup(2000, 60, fakeGuard)));
+    EXPECT_EQ("end", toString(tm.lookup(tm.tablets.load(), 2000, 60)));
     EXPECT_EQ("tableId: 2000, start: 500, end: 599",
-        toString(tm.lookup(2000, 500, fakeGuard)));
+        toString(tm.lookup(tm.tablets.load(), 2000, 500)));
     EXPECT_EQ("tableId: 2000, start: 500, end: 599",
-        toString(tm.lookup(2000, 599, fakeGuard)));
-    EXPECT_EQ("end", toString(tm.lookup(2000, 600, fakeGuard)));
-    EXPECT_EQ("end", toString(tm.lookup(2000, 999, fakeGuard)));
+        toString(tm.lookup(tm.tablets.load(), 2000, 599)));
+    EXPECT_EQ("end", toString(tm.lookup(tm.tablets.load(), 2000, 600)));
+    EXPECT_EQ("end", toString(tm.lookup(tm.tablets.load(), 2000, 999)));
     EXPECT_EQ("tableId: 2000, start: 1000, end: 2499",
-        toString(tm.lookup(2000, 1000, fakeGuard)));
+        toString(tm.lookup(tm.tablets.load(), 2000, 1000)));
     EXPECT_EQ("tableId: 2000, start: 1000, end: 2499",
-        toString(tm.lookup(2000, 2499, fakeGuard)));
-    EXPECT_EQ("end", toString(tm.lookup(2000, 2500, fakeGuard)));
+        toString(tm.lookup(tm.tablets.load(), 2000, 2499)));
+    EXPECT_EQ("end", toString(tm.lookup(tm.tablets.load(), 2000, 2500)));
 
-    EXPECT_EQ("end", toString(tm.lookup(3000, 60, fakeGuard)));
-    EXPECT_EQ("end", toString(tm.lookup(3000, 550, fakeGuard)));
-    EXPECT_EQ("end", toString(tm.lookup(3000, 1999, fakeGuard)));
+    EXPECT_EQ("end", toString(tm.lookup(tm.tablets.load(), 3000, 60)));
+    EXPECT_EQ("end", toString(tm.lookup(tm.tablets.load(), 3000, 550)));
+    EXPECT_EQ("end", toString(tm.lookup(tm.tablets.load(), 3000, 1999)));
     EXPECT_EQ("tableId: 3000, start: 2000, end: 2999",
-        toString(tm.lookup(3000, 2000, fakeGuard)));
+        toString(tm.lookup(tm.tablets.load(), 3000, 2000)));
     EXPECT_EQ("tableId: 3000, start: 2000, end: 2999",
-        toString(tm.lookup(3000, 2999, fakeGuard)));
-    EXPECT_EQ("end", toString(tm.lookup(3000, 3000, fakeGuard)));
-    EXPECT_EQ("end", toString(tm.lookup(3000, 4999, fakeGuard)));
+        toString(tm.lookup(tm.tablets.load(), 3000, 2999)));
+    EXPECT_EQ("end", toString(tm.lookup(tm.tablets.load(), 3000, 3000)));
+    EXPECT_EQ("end", toString(tm.lookup(tm.tablets.load(), 3000, 4999)));
     EXPECT_EQ("tableId: 3000, start: 5000, end: 5999",
-        toString(tm.lookup(3000, 5000, fakeGuard)));
+        toString(tm.lookup(tm.tablets.load(), 3000, 5000)));
     EXPECT_EQ("tableId: 3000, start: 5000, end: 5999",
-        toString(tm.lookup(3000, 5999, fakeGuard)));
-    EXPECT_EQ("end", toString(tm.lookup(3000, 6000, fakeGuard)));
-
-    EXPECT_EQ("end", toString(tm.lookup(999, 70, fakeGuard)));
-    EXPECT_EQ("end", toString(tm.lookup(1001, 70, fakeGuard)));
-    EXPECT_EQ("end", toString(tm.lookup(1999, 2200, fakeGuard)));
-    EXPECT_EQ("end", toString(tm.lookup(2001, 2200, fakeGuard)));
-    EXPECT_EQ("end", toString(tm.lookup(2999, 2200, fakeGuard)));
-    EXPECT_EQ("end", toString(tm.lookup(3001, 2200, fakeGuard)));
+        toString(tm.lookup(tm.tablets.load(), 3000, 5999)));
+    EXPECT_EQ("end", toString(tm.lookup(tm.tablets.load(), 3000, 6000)));
+
+    EXPECT_EQ("end", toString(tm.lookup(tm.tablets.load(), 999, 70)));
+    EXPECT_EQ("end", toString(tm.lookup(tm.tablets.load(), 1001, 70)));
+    EXPECT_EQ("end", toString(tm.lookup(tm.tablets.load(), 1999, 2200)));
+    EXPECT_EQ("end", toString(tm.lookup(tm.tablets.load(), 2001, 2200)));
+    EXPECT_EQ("end", toString(tm.lookup(tm.tablets.load(), 2999, 2200)));
+    EXPECT_EQ("end", toString(tm.lookup(tm.tablets.load(), 3001, 2200)));
+}
+
+TEST_F(TabletManagerTest, publish) {
+    EXPECT_TRUE(tm.addTablet(1, 0, 10, TabletManager::NORMAL));
+    TabletManager::TabletMap* before = tm.tablets.load();
+    std::shared_ptr<TabletManager::TabletCounters> counters =
+            before->begin()->second.counters;
+
+    EXPECT_TRUE(tm.addTablet(2, 0, 10, TabletManager::NORMAL));
+    TabletManager::TabletMap* after = tm.tablets.load();
+    EXPECT_NE(before, after);
+    EXPECT_EQ(2U, after->size());
+    EXPECT_EQ(counters, tm.lookup(after, 1, 5)->second.counters);
+    for (int i = 0; i < TabletManager::NUM_SHARDS; i++)
+        EXPECT_EQ(0U, tm.readers[i].count.load());
+
+    {
+        TabletManager::ReadGuard reader(tm);
+        EXPECT_EQ(after, reader.tablets);
+        EXPECT_EQ(1U, tm.readers[TabletManager::getShard()].count.load());
+    }
+    EXPECT_EQ(0U, tm.readers[TabletManager::getShard()].count.load());
+}
+
+TEST_F(TabletManagerTest, sumCounts) {
+    EXPECT_TRUE(tm.addTablet(1, 0, 10, TabletManager::NORMAL));
+    TabletManager::TabletEntry* entry = &tm.tablets.load()->begin()->second;
+    entry->counters->shards[0].readCount.add(2);
+    entry->counters->shards[3].readCount.add(5);
+    entry->counters->shards[TabletManager::NUM_SHARDS - 1].writeCount.add(7);
+
+    TabletManager::Tablet tablet = entry->tablet;
+    TabletManager::sumCounts(entry, &tablet);
+    EXPECT_EQ(7U, tablet.readCount);
+    EXPECT_EQ(7U, tablet.writeCount);
+
+    // The getTablet methods don't add up the counts.
+    EXPECT_TRUE(tm.getTablet(1, 5, &tablet));
+    EXPECT_EQ(0U, tablet.readCount);
 }
 
 }  // namespace RAMCloud
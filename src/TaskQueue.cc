@@ -13,12 +13,19 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include "PerfStats.h"
 #include "ShortMacros.h"
 #include "TaskQueue.h"
 #include "TestLog.h"
 
 namespace RAMCloud {
 
+/// The TaskQueue whose helper thread this is, or NULL if it isn't a helper.
+static __thread TaskQueue* currentQueue = NULL;
+
+/// If currentQueue isn't NULL, the index of this thread in its helpers.
+static __thread uint32_t currentHelper = 0;
+
 // --- Task ---
 
 /**
@@ -26,10 +33,16 @@ namespace RAMCloud {
  *
  * \param taskQueue
  *      TaskQueue which will execute performTask().
+ * \param threadSafe
+ *      True means performTask() may be executed by one of taskQueue's
+ *      helper threads, concurrently with other tasks and with the threads
+ *      that call taskQueue.performTask(). Thread-safe tasks mustn't delete
+ *      themselves or be deleted while they may be executing.
  */
-Task::Task(TaskQueue& taskQueue)
+Task::Task(TaskQueue& taskQueue, bool threadSafe)
     : taskQueue(taskQueue)
     , scheduled(false)
+    , threadSafe(threadSafe)
 {
 }
 
@@ -86,11 +99,19 @@ TaskQueue::TaskQueue()
     , taskAdded()
     , running(true)
     , tasks()
+    , helpers()
+    , helpersRunning(false)
+    , helperWork()
+    , helperTasks(0)
+    , nextHelper(0)
+    , executing()
+    , deferred()
 {
 }
 
 TaskQueue::~TaskQueue()
 {
+    stopHelpers();
 }
 
 /// Returns true if no tasks are waiting to run.
@@ -98,7 +119,7 @@ bool
 TaskQueue::isIdle()
 {
     Lock _(mutex);
-    return tasks.size() == 0;
+    return tasks.size() + helperTasks == 0;
 }
 
 /// Returns number of tasks waiting to run.
@@ -106,7 +127,7 @@ size_t
 TaskQueue::outstandingTasks()
 {
     Lock _(mutex);
-    return tasks.size();
+    return tasks.size() + helperTasks;
 }
 
 /**
@@ -182,6 +203,58 @@ TaskQueue::halt()
     taskAdded.notify_one();
 }
 
+/**
+ * Create threads that execute thread-safe tasks (see Task::Task) in
+ * parallel, until stopHelpers is called. Tasks that aren't thread-safe are
+ * still only executed by performTask() and performTasksUntilHalt(). Has no
+ * effect if there are helpers already.
+ *
+ * \param count
+ *      Number of helper threads to create.
+ */
+void
+TaskQueue::startHelpers(uint32_t count)
+{
+    Lock _(mutex);
+    if (!helpers.empty())
+        return;
+    helpersRunning = true;
+    for (uint32_t i = 0; i < count; i++)
+        helpers.emplace_back(new Helper);
+    for (uint32_t i = 0; i < count; i++)
+        helpers[i]->thread.construct(&TaskQueue::helperMain, this, i);
+}
+
+/**
+ * Stop the threads created by startHelpers, once they finish the tasks they
+ * are executing. Thread-safe tasks left in their queues are moved to the
+ * queue used by performTask(), so they still get executed. Must not be
+ * called by a helper.
+ */
+void
+TaskQueue::stopHelpers()
+{
+    Lock lock(mutex);
+    if (helpers.empty())
+        return;
+    helpersRunning = false;
+    helperWork.notify_all();
+    lock.unlock();
+    foreach (std::unique_ptr<Helper>& helper, helpers) {
+        if (helper->thread)
+            helper->thread->join();
+    }
+    lock.lock();
+    foreach (std::unique_ptr<Helper>& helper, helpers) {
+        foreach (Task* task, helper->tasks)
+            tasks.push(task);
+    }
+    helpers.clear();
+    helperTasks = 0;
+    nextHelper = 0;
+    taskAdded.notify_one();
+}
+
 // -- private --
 
 /**
@@ -201,6 +274,15 @@ TaskQueue::schedule(Task* task)
     if (task->scheduled)
         return;
     task->scheduled = true;
+    if (task->threadSafe && !helpers.empty()) {
+        if (executing.find(task) != executing.end()) {
+            // Wait until the task finishes before it runs again.
+            deferred.insert(task);
+        } else {
+            pushHelperTask(task);
+        }
+        return;
+    }
     tasks.push(task);
     taskAdded.notify_one();
     TEST_LOG("scheduled");
@@ -238,4 +320,95 @@ TaskQueue::getNextTask(bool sleepIfIdle)
     return task;
 }
 
+/**
+ * The main loop of each helper thread: executes thread-safe tasks from its
+ * own queue, or stolen from other helpers' queues, until stopHelpers is
+ * called.
+ *
+ * \param index
+ *      This helper's index in #helpers.
+ */
+void
+TaskQueue::helperMain(uint32_t index)
+{
+    PerfStats::registerStats(&PerfStats::threadStats);
+    currentQueue = this;
+    currentHelper = index;
+    Lock lock(mutex);
+    while (helpersRunning) {
+        Task* task = takeHelperTask(index);
+        if (task == NULL) {
+            helperWork.wait(lock);
+            continue;
+        }
+        executing.insert(task);
+        lock.unlock();
+        task->performTask();
+        lock.lock();
+        executing.erase(task);
+        if (deferred.erase(task) != 0)
+            pushHelperTask(task);
+    }
+    currentQueue = NULL;
+}
+
+/**
+ * Add a thread-safe task to the queue of a helper: the current thread's own
+ * queue if it is a helper, otherwise the next in round-robin order. The
+ * caller must hold #mutex, and #helpers must not be empty.
+ */
+void
+TaskQueue::pushHelperTask(Task* task)
+{
+    uint32_t index;
+    if (currentQueue == this) {
+        index = currentHelper;
+    } else {
+        index = nextHelper;
+        nextHelper = (nextHelper + 1) % downCast<uint32_t>(helpers.size());
+    }
+    helpers[index]->tasks.push_back(task);
+    helperTasks++;
+    helperWork.notify_one();
+}
+
+/**
+ * Remove the next task for a helper to execute: the oldest in its own
+ * queue or, if that is empty, the newest in the first other helper's queue
+ * that isn't. The caller must hold #mutex.
+ *
+ * \param index
+ *      The helper's index in #helpers.
+ * \return
+ *      The task to execute, or NULL if all of the helpers' queues are
+ *      empty.
+ */
+Task*
+TaskQueue::takeHelperTask(uint32_t index)
+{
+    if (helperTasks == 0)
+        return NULL;
+    Task* task;
+    std::deque<Task*>& own = helpers[index]->tasks;
+    if (!own.empty()) {
+        task = own.front();
+        own.pop_front();
+    } else {
+        task = NULL;
+        for (uint32_t i = 1; i < helpers.size(); i++) {
+            std::deque<Task*>& victim =
+                    helpers[(index + i) % helpers.size()]->tasks;
+            if (!victim.empty()) {
+                task = victim.back();
+                victim.pop_back();
+                break;
+            }
+        }
+    }
+    assert(task != NULL);
+    helperTasks--;
+    task->scheduled = false;
+    return task;
+}
+
 } // namespace RAMCloud
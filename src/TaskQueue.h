@@ -18,9 +18,15 @@
 
 #include <condition_variable>
 #include <mutex>
+#include <thread>
+#include <deque>
+#include <memory>
 #include <queue>
+#include <unordered_set>
+#include <vector>
 
 #include "Common.h"
+#include "Tub.h"
 
 namespace RAMCloud {
 
@@ -40,10 +46,15 @@ class TaskQueue;      // forward-declaration
  * Importantly, creators of tasks must take care to ensure that a task is not
  * scheduled when it is destroyed, otherwise the taskQueue will exhibit
  * undefined behavior when it attempts to execute this (destroyed) task.
+ *
+ * Tasks created as thread-safe may be executed by the TaskQueue's helper
+ * threads, if it has any (see TaskQueue::startHelpers), concurrently with
+ * other tasks and with whatever thread calls TaskQueue::performTask. A task
+ * is never executed by two threads at once, though.
  */
 class Task {
   PUBLIC:
-    explicit Task(TaskQueue& taskQueue);
+    explicit Task(TaskQueue& taskQueue, bool threadSafe = false);
     virtual ~Task();
 
     /**
@@ -64,6 +75,10 @@ class Task {
     /// True if performTask() will be run on the next taskQueue.performTask().
     bool scheduled;
 
+    /// True means performTask() may run on one of taskQueue's helper
+    /// threads (see TaskQueue::startHelpers).
+    const bool threadSafe;
+
     friend class TaskQueue;
 };
 
@@ -72,6 +87,16 @@ class Task {
  * quickly schedule asynchronous jobs which are periodically checked for
  * completeness out of a performance sensitive context.
  * See Task for details on how to create tasks and related gotchas.
+ *
+ * Normally all tasks are executed one at a time by whichever thread calls
+ * performTask (usually the dispatch thread), so that tasks needn't
+ * synchronize with each other or with that thread. When there are many
+ * tasks that can safely run in parallel, such as during a large recovery,
+ * startHelpers creates threads that execute the thread-safe ones. Each
+ * helper thread has its own queue, which gets the tasks it schedules; a
+ * helper with nothing to do takes the oldest task from another helper's
+ * queue (work stealing), so that helpers rarely contend for the same tasks
+ * and load evens out.
  */
 class TaskQueue {
   PUBLIC:
@@ -82,10 +107,15 @@ class TaskQueue {
     bool performTask();
     void performTasksUntilHalt();
     void halt();
+    void startHelpers(uint32_t count);
+    void stopHelpers();
 
   PRIVATE:
     void schedule(Task* task);
     Task* getNextTask(bool sleepIfIdle);
+    void helperMain(uint32_t index);
+    void pushHelperTask(Task* task);
+    Task* takeHelperTask(uint32_t index);
 
     /**
      * Protects all modifications to #tasks and #running; used to allow
@@ -113,6 +143,51 @@ class TaskQueue {
      */
     std::queue<Task*> tasks;
 
+    /// One of the threads created by startHelpers.
+    struct Helper {
+        Helper()
+            : tasks()
+            , thread()
+        {}
+
+        /// Thread-safe tasks scheduled on this helper, oldest first. The
+        /// helper executes them in order, so tasks that keep rescheduling
+        /// themselves don't starve the others; helpers with nothing to do
+        /// steal from the back.
+        std::deque<Task*> tasks;
+
+        /// Runs helperMain.
+        Tub<std::thread> thread;
+
+        DISALLOW_COPY_AND_ASSIGN(Helper);
+    };
+
+    /// The helper threads; empty unless startHelpers has been called.
+    /// Thread-safe tasks go to #tasks when this is empty.
+    std::vector<std::unique_ptr<Helper>> helpers;
+
+    /// Set to false by stopHelpers to tell the helpers to exit.
+    bool helpersRunning;
+
+    /// Waited on by helpers that have no tasks to execute. Notified when a
+    /// task is added to a helper's queue, and by stopHelpers.
+    std::condition_variable helperWork;
+
+    /// The total number of tasks in the queues of #helpers.
+    size_t helperTasks;
+
+    /// Tasks scheduled from threads other than helpers go to the helper
+    /// with this index in #helpers (round robin).
+    uint32_t nextHelper;
+
+    /// Tasks currently being executed by helpers.
+    std::unordered_set<Task*> executing;
+
+    /// Tasks in #executing that were scheduled again while they ran; each
+    /// is put back in a queue once it has finished, so that it is never
+    /// executed by two helpers at a time.
+    std::unordered_set<Task*> deferred;
+
     friend class Task;
 };
 
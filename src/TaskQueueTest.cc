@@ -24,8 +24,8 @@ namespace RAMCloud {
 
 struct TaskQueueTest : public ::testing::Test {
     struct MockTask : Task {
-        explicit MockTask(TaskQueue& taskQueue)
-            : Task(taskQueue)
+        explicit MockTask(TaskQueue& taskQueue, bool threadSafe = false)
+            : Task(taskQueue, threadSafe)
             , count(0)
         {
         }
@@ -142,6 +142,96 @@ TEST_F(TaskQueueTest, scheduleNested)
     EXPECT_EQ(2, task.count);
 }
 
+TEST_F(TaskQueueTest, startHelpers)
+{
+    MockTask safe(taskQueue, true);
+    taskQueue.startHelpers(3);
+    EXPECT_EQ(3U, taskQueue.helpers.size());
+    taskQueue.startHelpers(2);
+    EXPECT_EQ(3U, taskQueue.helpers.size());
+
+    // Thread-safe tasks run on the helpers; others wait for performTask.
+    safe.schedule();
+    task1.schedule();
+    for (int i = 0; i < 1000; ++i) {
+        if (safe.count == 1)
+            break;
+        usleep(1000);
+    }
+    EXPECT_EQ(1, safe.count);
+    EXPECT_EQ(0, task1.count);
+    EXPECT_EQ(1U, taskQueue.outstandingTasks());
+    EXPECT_TRUE(taskQueue.performTask());
+    EXPECT_EQ(1, task1.count);
+    taskQueue.stopHelpers();
+    EXPECT_EQ(0U, taskQueue.helpers.size());
+}
+
+TEST_F(TaskQueueTest, stopHelpers)
+{
+    // Tasks left in helpers' queues are performed by performTask instead.
+    MockTask safe(taskQueue, true);
+    taskQueue.helpers.emplace_back(new TaskQueue::Helper);
+    safe.schedule();
+    EXPECT_EQ(1U, taskQueue.helpers[0]->tasks.size());
+    EXPECT_EQ(1U, taskQueue.outstandingTasks());
+    taskQueue.stopHelpers();
+    EXPECT_EQ(0U, taskQueue.helpers.size());
+    EXPECT_EQ(1U, taskQueue.tasks.size());
+    EXPECT_TRUE(taskQueue.performTask());
+    EXPECT_EQ(1, safe.count);
+}
+
+TEST_F(TaskQueueTest, schedule_helperTasks)
+{
+    // Without threads, so the queues can be examined.
+    MockTask safe1(taskQueue, true);
+    MockTask safe2(taskQueue, true);
+    taskQueue.helpers.emplace_back(new TaskQueue::Helper);
+    taskQueue.helpers.emplace_back(new TaskQueue::Helper);
+    safe1.schedule();
+    safe2.schedule();
+    EXPECT_EQ(&safe1, taskQueue.helpers[0]->tasks.front());
+    EXPECT_EQ(&safe2, taskQueue.helpers[1]->tasks.front());
+    EXPECT_EQ(0U, taskQueue.tasks.size());
+
+    // A task that is executing is put back once it finishes.
+    EXPECT_EQ(&safe1, taskQueue.takeHelperTask(0));
+    taskQueue.executing.insert(&safe1);
+    safe1.schedule();
+    EXPECT_TRUE(safe1.isScheduled());
+    EXPECT_EQ(0U, taskQueue.helpers[0]->tasks.size());
+    EXPECT_EQ(1U, taskQueue.deferred.size());
+    taskQueue.executing.clear();
+    taskQueue.deferred.clear();
+    safe1.scheduled = false;
+    EXPECT_EQ(&safe2, taskQueue.takeHelperTask(1));
+    taskQueue.helpers.clear();
+}
+
+TEST_F(TaskQueueTest, takeHelperTask)
+{
+    MockTask safe1(taskQueue, true);
+    MockTask safe2(taskQueue, true);
+    MockTask safe3(taskQueue, true);
+    taskQueue.helpers.emplace_back(new TaskQueue::Helper);
+    taskQueue.helpers.emplace_back(new TaskQueue::Helper);
+    taskQueue.helpers.emplace_back(new TaskQueue::Helper);
+    EXPECT_EQ(static_cast<Task*>(NULL), taskQueue.takeHelperTask(0));
+    taskQueue.helpers[1]->tasks.push_back(&safe1);
+    taskQueue.helpers[1]->tasks.push_back(&safe2);
+    taskQueue.helpers[1]->tasks.push_back(&safe3);
+    taskQueue.helperTasks = 3;
+
+    // Helpers take the oldest of their own tasks, and steal the newest.
+    EXPECT_EQ(&safe1, taskQueue.takeHelperTask(1));
+    EXPECT_EQ(&safe3, taskQueue.takeHelperTask(0));
+    EXPECT_EQ(&safe2, taskQueue.takeHelperTask(2));
+    EXPECT_EQ(0U, taskQueue.helperTasks);
+    EXPECT_EQ(static_cast<Task*>(NULL), taskQueue.takeHelperTask(2));
+    taskQueue.helpers.clear();
+}
+
 TEST_F(TaskQueueTest, getNextTask)
 {
     EXPECT_EQ(static_cast<Task*>(NULL), taskQueue.getNextTask(false));
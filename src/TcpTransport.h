@@ -190,6 +190,7 @@ class TcpTransport : public Transport {
 
   PRIVATE:
     void closeSocket(int fd);
+    static void setBusyPoll(int fd, int micros);
     static ssize_t recvCarefully(int fd, void* buffer, size_t length);
     static int sendMessage
         (int fd, uint64_t nonce, Buffer* payload,
@@ -320,6 +321,12 @@ class TcpTransport : public Transport {
     /// Used to wait for listenSocket to become readable.
     Tub<AcceptHandler> acceptHandler;
 
+    /// If nonzero, the SO_BUSY_POLL value (in microseconds) applied to
+    /// every socket this transport opens or accepts, so that blocking
+    /// reads spin on the NIC receive queue instead of waiting for an
+    /// interrupt. Set with the "busyPoll" service locator option.
+    int busyPollMicros;
+
     /// Used to hold information about a file descriptor associated with
     /// a socket, on which RPC requests may arrive.
     class Socket {
@@ -289,6 +289,29 @@ TEST_F(TcpTransportTest, Socket_destructor_clearRpcsWaitingToReply) {
             "~TcpServerRpc: deleted", TestLog::get());
 }
 
+TEST_F(TcpTransportTest, constructor_busyPollOption) {
+    EXPECT_EQ(0, server.busyPollMicros);
+    ServiceLocator busyLocator("tcp+ip:host=localhost,port=11001,"
+            "busyPoll=50");
+    TcpTransport server2(&context, &busyLocator);
+    EXPECT_EQ(50, server2.busyPollMicros);
+}
+
+TEST_F(TcpTransportTest, setBusyPoll) {
+    int fd = socket(PF_INET, SOCK_STREAM, 0);
+    ASSERT_GE(fd, 0);
+
+    // Zero means don't touch the socket.
+    sys->setsockoptErrno = EPERM;
+    TcpTransport::setBusyPoll(fd, 0);
+    EXPECT_EQ("", TestLog::get());
+
+    TcpTransport::setBusyPoll(fd, 50);
+    EXPECT_EQ("setBusyPoll: TcpTransport couldn't set SO_BUSY_POLL to "
+            "50 us: Operation not permitted", TestLog::get());
+    close(fd);
+}
+
 TEST_F(TcpTransportTest, AcceptHandler_handleFileEvent_noConnection) {
     server.acceptHandler->handleFileEvent(Dispatch::FileEvent::READABLE);
     EXPECT_EQ(0U, server.sockets.size());
@@ -0,0 +1,375 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <algorithm>
+#include <sstream>
+
+#include "ShortMacros.h"
+#include "ThreadPlacement.h"
+
+namespace RAMCloud {
+
+cpu_set_t ThreadPlacement::roleCpus[ThreadPlacement::ROLE_COUNT];
+const char* ThreadPlacement::sysRoot = "/sys";
+
+namespace {
+
+// Names of the Roles, as used in placement policies.
+const char* roleNames[ThreadPlacement::ROLE_COUNT] =
+        {"dispatch", "workers", "cleaner"};
+
+/**
+ * Return the integer in a (sysfs) file, or \a defaultValue if the file
+ * can't be read or doesn't start with an integer.
+ */
+int
+readInt(const string& path, int defaultValue)
+{
+    FILE* f = fopen(path.c_str(), "r");
+    if (f == NULL)
+        return defaultValue;
+    int value;
+    if (fscanf(f, "%d", &value) != 1)
+        value = defaultValue;
+    fclose(f);
+    return value;
+}
+
+/**
+ * Return the first line of a (sysfs) file, or an empty string if the file
+ * can't be read.
+ */
+string
+readLine(const string& path)
+{
+    FILE* f = fopen(path.c_str(), "r");
+    if (f == NULL)
+        return "";
+    char buffer[1000];
+    string result;
+    if (fgets(buffer, sizeof(buffer), f) != NULL) {
+        result = buffer;
+        if (!result.empty() && result[result.size() - 1] == '\n')
+            result.resize(result.size() - 1);
+    }
+    fclose(f);
+    return result;
+}
+
+} // anonymous namespace
+
+/**
+ * Decide where each role's threads will run. This must be invoked before
+ * any of the threads to be placed are started, and must not be invoked
+ * while they are starting.
+ *
+ * \param policy
+ *      Empty means threads aren't placed. Otherwise a list of
+ *      space-separated items: "auto" chooses CPUs for all of the roles
+ *      from the machine's topology, and "auto:<device>" does so knowing
+ *      that the NIC is the network or InfiniBand device <device> (such as
+ *      eth0 or mlx4_0); "<role>=<cpus>" (where role is dispatch, workers
+ *      or cleaner, and cpus is a list such as "2-7,12") gives a role
+ *      exactly those CPUs, overriding "auto".
+ * \param workerCores
+ *      The number of physical cores "auto" should give workers. Zero means
+ *      all of the cores on the NIC's socket other than the dispatch
+ *      thread's.
+ * \throw Exception
+ *      The policy isn't valid.
+ */
+void
+ThreadPlacement::configure(const string& policy, uint32_t workerCores)
+{
+    reset();
+    bool automatic = false;
+    string nic;
+    cpu_set_t givenCpus[ROLE_COUNT];
+    bool given[ROLE_COUNT] = {false, false, false};
+
+    std::istringstream items(policy);
+    string item;
+    while (items >> item) {
+        if ((item == "auto") || (item.compare(0, 5, "auto:") == 0)) {
+            automatic = true;
+            nic = (item.size() > 5) ? item.substr(5) : "";
+            continue;
+        }
+        size_t equals = item.find('=');
+        int role = -1;
+        for (int i = 0; i < ROLE_COUNT; i++) {
+            if (item.compare(0, equals, roleNames[i]) == 0)
+                role = i;
+        }
+        if ((equals == string::npos) || (role < 0) ||
+                !parseCpuList(item.substr(equals + 1), &givenCpus[role])) {
+            throw Exception(HERE, format("Invalid item '%s' in thread "
+                    "placement '%s'", item.c_str(), policy.c_str()));
+        }
+        given[role] = true;
+    }
+
+    if (automatic) {
+        std::vector<Cpu> cpus = readTopology();
+        assign(cpus, findNicSocket(nic, cpus), workerCores, roleCpus);
+    }
+    for (int i = 0; i < ROLE_COUNT; i++) {
+        if (given[i])
+            roleCpus[i] = givenCpus[i];
+    }
+    if (automatic || given[DISPATCH] || given[WORKER] || given[CLEANER]) {
+        LOG(NOTICE, "Thread placement: dispatch on CPUs %s, workers on "
+                "CPUs %s, cleaner on CPUs %s",
+                cpuList(roleCpus[DISPATCH]).c_str(),
+                cpuList(roleCpus[WORKER]).c_str(),
+                cpuList(roleCpus[CLEANER]).c_str());
+    }
+}
+
+/**
+ * Restrict the calling thread to the CPUs chosen for its role by
+ * configure (if any were chosen).
+ *
+ * \param role
+ *      What the calling thread does.
+ */
+void
+ThreadPlacement::place(Role role)
+{
+    if (CPU_COUNT(&roleCpus[role]) == 0)
+        return;
+    if (sched_setaffinity(0, sizeof(roleCpus[role]), &roleCpus[role]) != 0) {
+        LOG(WARNING, "Couldn't place %s thread on CPUs %s: %s",
+                roleNames[role], cpuList(roleCpus[role]).c_str(),
+                strerror(errno));
+    }
+}
+
+/**
+ * Forget any placement chosen by configure: threads started afterwards
+ * aren't placed.
+ */
+void
+ThreadPlacement::reset()
+{
+    for (int i = 0; i < ROLE_COUNT; i++)
+        CPU_ZERO(&roleCpus[i]);
+}
+
+/**
+ * Choose CPUs for each role from the machine's topology (this is the
+ * "auto" policy described in the class documentation).
+ *
+ * \param cpus
+ *      The hardware threads the server may use.
+ * \param nicSocket
+ *      The socket the NIC is attached to, or -1 if unknown (in which case
+ *      the lowest-numbered socket is used).
+ * \param workerCores
+ *      See configure.
+ * \param[out] roleCpus
+ *      The CPUs for each role are stored here. If there is only one
+ *      physical core, only the dispatch thread is placed.
+ */
+void
+ThreadPlacement::assign(std::vector<Cpu> cpus, int nicSocket,
+        uint32_t workerCores, cpu_set_t roleCpus[ROLE_COUNT])
+{
+    for (int i = 0; i < ROLE_COUNT; i++)
+        CPU_ZERO(&roleCpus[i]);
+    if (cpus.empty())
+        return;
+    if (nicSocket < 0) {
+        nicSocket = cpus[0].socket;
+        foreach (const Cpu& cpu, cpus)
+            nicSocket = std::min(nicSocket, cpu.socket);
+    }
+
+    // Order the hardware threads by physical core, with the cores on the
+    // NIC's socket first, then group them by core.
+    std::sort(cpus.begin(), cpus.end(),
+            [nicSocket](const Cpu& a, const Cpu& b) {
+                if ((a.socket == nicSocket) != (b.socket == nicSocket))
+                    return a.socket == nicSocket;
+                if (a.socket != b.socket)
+                    return a.socket < b.socket;
+                if (a.core != b.core)
+                    return a.core < b.core;
+                return a.cpu < b.cpu;
+            });
+    std::vector<std::vector<int>> cores;
+    uint32_t nicSocketCores = 0;
+    for (size_t i = 0; i < cpus.size(); i++) {
+        if ((i == 0) || (cpus[i].socket != cpus[i-1].socket) ||
+                (cpus[i].core != cpus[i-1].core)) {
+            cores.emplace_back();
+            if (cpus[i].socket == nicSocket)
+                nicSocketCores++;
+        }
+        cores.back().push_back(cpus[i].cpu);
+    }
+
+    // The dispatch thread gets the first core to itself; its SMT siblings
+    // are left idle.
+    CPU_SET(cores[0][0], &roleCpus[DISPATCH]);
+    if (cores.size() == 1)
+        return;
+
+    // Each worker core contributes one hardware thread to the workers, and
+    // its siblings to the cleaner.
+    size_t workers = (workerCores != 0) ? workerCores
+            : std::max(nicSocketCores, 2U) - 1;
+    workers = std::min(workers, cores.size() - 1);
+    for (size_t i = 1; i <= workers; i++) {
+        CPU_SET(cores[i][0], &roleCpus[WORKER]);
+        for (size_t j = 1; j < cores[i].size(); j++)
+            CPU_SET(cores[i][j], &roleCpus[CLEANER]);
+    }
+
+    // Without SMT, the cleaner gets whatever cores are left over, which
+    // are on other sockets unless the workers need fewer cores than the
+    // NIC's socket has. Failing that, it shares the workers' cores.
+    if (CPU_COUNT(&roleCpus[CLEANER]) == 0) {
+        for (size_t i = workers + 1; i < cores.size(); i++) {
+            foreach (int cpu, cores[i])
+                CPU_SET(cpu, &roleCpus[CLEANER]);
+        }
+    }
+    if (CPU_COUNT(&roleCpus[CLEANER]) == 0)
+        roleCpus[CLEANER] = roleCpus[WORKER];
+}
+
+/**
+ * Return a set of CPUs in the form accepted by parseCpuList, such as
+ * "0-3,8", or "none" if the set is empty.
+ */
+string
+ThreadPlacement::cpuList(const cpu_set_t& set)
+{
+    string result;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &set))
+            continue;
+        int last = cpu;
+        while ((last + 1 < CPU_SETSIZE) && CPU_ISSET(last + 1, &set))
+            last++;
+        if (!result.empty())
+            result.append(",");
+        result.append((last == cpu) ? format("%d", cpu)
+                : format("%d-%d", cpu, last));
+        cpu = last;
+    }
+    return result.empty() ? "none" : result;
+}
+
+/**
+ * Parse a list of CPUs, such as "0-3,8" (this is the format Linux uses in
+ * sysfs).
+ *
+ * \param list
+ *      The list to parse.
+ * \param[out] set
+ *      The CPUs in the list are stored here.
+ * \return
+ *      True if the list was valid and not empty; false otherwise.
+ */
+bool
+ThreadPlacement::parseCpuList(const string& list, cpu_set_t* set)
+{
+    CPU_ZERO(set);
+    std::istringstream ranges(list);
+    string range;
+    while (std::getline(ranges, range, ',')) {
+        int first, last;
+        char extra;
+        int count = sscanf(range.c_str(), "%d-%d%c", // NOLINT
+                &first, &last, &extra);
+        if (count == 1) {
+            last = first;
+        } else if (count != 2) {
+            return false;
+        }
+        if ((first < 0) || (last < first) || (last >= CPU_SETSIZE))
+            return false;
+        for (int cpu = first; cpu <= last; cpu++)
+            CPU_SET(cpu, set);
+    }
+    return CPU_COUNT(set) != 0;
+}
+
+/**
+ * Find the socket a NIC is attached to.
+ *
+ * \param device
+ *      Name of the NIC as a network device (such as eth0) or an InfiniBand
+ *      device (such as mlx4_0); empty means unknown.
+ * \param cpus
+ *      The machine's hardware threads (see readTopology).
+ * \return
+ *      The NIC's socket, or -1 if it can't be determined.
+ */
+int
+ThreadPlacement::findNicSocket(const string& device,
+        const std::vector<Cpu>& cpus)
+{
+    if (device.empty())
+        return -1;
+    int node = readInt(format("%s/class/net/%s/device/numa_node",
+            sysRoot, device.c_str()), -1);
+    if (node < 0) {
+        node = readInt(format("%s/class/infiniband/%s/device/numa_node",
+                sysRoot, device.c_str()), -1);
+    }
+    cpu_set_t nodeCpus;
+    if ((node >= 0) && parseCpuList(readLine(format(
+            "%s/devices/system/node/node%d/cpulist", sysRoot, node)),
+            &nodeCpus)) {
+        foreach (const Cpu& cpu, cpus) {
+            if (CPU_ISSET(cpu.cpu, &nodeCpus))
+                return cpu.socket;
+        }
+    }
+    LOG(WARNING, "Couldn't find the socket that NIC %s is attached to",
+            device.c_str());
+    return -1;
+}
+
+/**
+ * Return the hardware threads the calling thread may run on, with the
+ * socket and physical core of each.
+ */
+std::vector<ThreadPlacement::Cpu>
+ThreadPlacement::readTopology()
+{
+    std::vector<Cpu> cpus;
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        LOG(WARNING, "Couldn't read CPU affinity: %s", strerror(errno));
+        return cpus;
+    }
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed))
+            continue;
+        string topology = format("%s/devices/system/cpu/cpu%d/topology/",
+                sysRoot, cpu);
+        cpus.emplace_back(cpu,
+                readInt(topology + "physical_package_id", 0),
+                readInt(topology + "core_id", cpu));
+    }
+    return cpus;
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,90 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_THREADPLACEMENT_H
+#define RAMCLOUD_THREADPLACEMENT_H
+
+#include <sched.h>
+#include <vector>
+
+#include "Common.h"
+
+namespace RAMCloud {
+
+/**
+ * Decides which CPUs a server's threads may run on, according to the role
+ * of each thread, and pins threads to them as they start. The policy is set
+ * once at startup (see ServerConfig::threadPlacement), before any of the
+ * threads are created; threads of a role with no CPUs assigned are left
+ * wherever the scheduler puts them.
+ *
+ * The "auto" policy uses the machine's topology (sockets, physical cores,
+ * and the SMT hardware threads of each core): the dispatch thread gets a
+ * physical core of its own on the socket the NIC is attached to, worker
+ * threads get one hardware thread on each of a set of other physical cores
+ * (on the NIC's socket first), so no two workers share a core, and cleaner
+ * threads get the SMT siblings of the worker cores or, without SMT, cores
+ * the workers aren't using (usually on another socket). The CPUs for any
+ * role can also be listed explicitly.
+ */
+class ThreadPlacement {
+  PUBLIC:
+    /// The kinds of threads that are placed.
+    enum Role {
+        DISPATCH = 0,
+        WORKER = 1,
+        CLEANER = 2,
+        ROLE_COUNT = 3
+    };
+
+    /// One hardware thread of the machine.
+    struct Cpu {
+        Cpu(int cpu, int socket, int core)
+            : cpu(cpu)
+            , socket(socket)
+            , core(core)
+        {}
+        int cpu;                       /// Linux CPU number.
+        int socket;                    /// Physical package it belongs to.
+        int core;                      /// Physical core within the socket;
+                                       /// SMT siblings have the same socket
+                                       /// and core.
+    };
+
+    static void configure(const string& policy, uint32_t workerCores);
+    static void place(Role role);
+    static void reset();
+
+  PRIVATE:
+    static void assign(std::vector<Cpu> cpus, int nicSocket,
+            uint32_t workerCores, cpu_set_t roleCpus[ROLE_COUNT]);
+    static string cpuList(const cpu_set_t& set);
+    static bool parseCpuList(const string& list, cpu_set_t* set);
+    static int findNicSocket(const string& device,
+            const std::vector<Cpu>& cpus);
+    static std::vector<Cpu> readTopology();
+
+    /// The CPUs each role may run on; an empty set means the role's
+    /// threads aren't placed.
+    static cpu_set_t roleCpus[ROLE_COUNT];
+
+    /// Root of the sysfs tree the topology is read from; changed only
+    /// during testing.
+    static const char* sysRoot;
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_THREADPLACEMENT_H
@@ -0,0 +1,221 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "TestUtil.h"
+#include "ThreadPlacement.h"
+
+namespace RAMCloud {
+
+typedef ThreadPlacement::Cpu Cpu;
+
+class ThreadPlacementTest : public ::testing::Test {
+  public:
+    TestLog::Enable logEnabler;
+    const char* savedSysRoot;
+    char sysRoot[100];
+    cpu_set_t roleCpus[ThreadPlacement::ROLE_COUNT];
+
+    ThreadPlacementTest()
+        : logEnabler("ThreadPlacement")
+        , savedSysRoot(ThreadPlacement::sysRoot)
+        , sysRoot()
+        , roleCpus()
+    {
+        strncpy(sysRoot, "/tmp/ramcloud-placement-test-delete-this-XXXXXX",
+                sizeof(sysRoot));
+        if (mkdtemp(sysRoot) == NULL)
+            ADD_FAILURE() << "couldn't create " << sysRoot;
+        ThreadPlacement::sysRoot = sysRoot;
+    }
+
+    ~ThreadPlacementTest()
+    {
+        ThreadPlacement::sysRoot = savedSysRoot;
+        ThreadPlacement::reset();
+        int r = system(format("rm -rf %s", sysRoot).c_str());
+        EXPECT_EQ(0, r);
+    }
+
+    // Create a file (and the directories leading to it) under sysRoot.
+    void
+    writeFile(const string& path, const string& contents)
+    {
+        string full = sysRoot;
+        size_t start = 1;
+        size_t slash;
+        while ((slash = path.find('/', start)) != string::npos) {
+            mkdir((full + path.substr(0, slash)).c_str(), 0700);
+            start = slash + 1;
+        }
+        FILE* f = fopen((full + path).c_str(), "w");
+        ASSERT_TRUE(f != NULL);
+        fputs(contents.c_str(), f);
+        fclose(f);
+    }
+
+    // Return the CPUs chosen for each role, as a string.
+    string
+    roles()
+    {
+        return format("dispatch %s, workers %s, cleaner %s",
+                ThreadPlacement::cpuList(roleCpus[0]).c_str(),
+                ThreadPlacement::cpuList(roleCpus[1]).c_str(),
+                ThreadPlacement::cpuList(roleCpus[2]).c_str());
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(ThreadPlacementTest);
+};
+
+TEST_F(ThreadPlacementTest, configure_explicit) {
+    ThreadPlacement::configure("dispatch=3 cleaner=8-9,12", 0);
+    EXPECT_EQ("3", ThreadPlacement::cpuList(
+            ThreadPlacement::roleCpus[ThreadPlacement::DISPATCH]));
+    EXPECT_EQ("none", ThreadPlacement::cpuList(
+            ThreadPlacement::roleCpus[ThreadPlacement::WORKER]));
+    EXPECT_EQ("8-9,12", ThreadPlacement::cpuList(
+            ThreadPlacement::roleCpus[ThreadPlacement::CLEANER]));
+    EXPECT_EQ("configure: Thread placement: dispatch on CPUs 3, workers on "
+            "CPUs none, cleaner on CPUs 8-9,12", TestLog::get());
+}
+
+TEST_F(ThreadPlacementTest, configure_empty) {
+    ThreadPlacement::configure("workers=1", 0);
+    ThreadPlacement::configure("", 0);
+    for (int i = 0; i < ThreadPlacement::ROLE_COUNT; i++)
+        EXPECT_EQ(0, CPU_COUNT(&ThreadPlacement::roleCpus[i]));
+}
+
+TEST_F(ThreadPlacementTest, configure_invalid) {
+    EXPECT_THROW(ThreadPlacement::configure("workers=", 0), Exception);
+    EXPECT_THROW(ThreadPlacement::configure("bogus=1", 0), Exception);
+    EXPECT_THROW(ThreadPlacement::configure("dispatch", 0), Exception);
+    EXPECT_THROW(ThreadPlacement::configure("auto cleaner=a", 0), Exception);
+}
+
+TEST_F(ThreadPlacementTest, place) {
+    cpu_set_t oldSet;
+    ASSERT_EQ(0, sched_getaffinity(0, sizeof(oldSet), &oldSet));
+    int cpu = 0;
+    while (!CPU_ISSET(cpu, &oldSet))
+        cpu++;
+
+    // No CPUs for the role: nothing changes.
+    ThreadPlacement::place(ThreadPlacement::WORKER);
+    cpu_set_t set;
+    ASSERT_EQ(0, sched_getaffinity(0, sizeof(set), &set));
+    EXPECT_TRUE(CPU_EQUAL(&oldSet, &set));
+
+    ThreadPlacement::configure(format("workers=%d", cpu), 0);
+    ThreadPlacement::place(ThreadPlacement::WORKER);
+    ASSERT_EQ(0, sched_getaffinity(0, sizeof(set), &set));
+    EXPECT_EQ(1, CPU_COUNT(&set));
+    EXPECT_TRUE(CPU_ISSET(cpu, &set));
+    sched_setaffinity(0, sizeof(oldSet), &oldSet);
+}
+
+TEST_F(ThreadPlacementTest, assign_smt) {
+    // Two sockets of 4 cores with 2 hardware threads each, numbered the
+    // way Linux usually numbers them.
+    std::vector<Cpu> cpus;
+    for (int thread = 0; thread < 2; thread++) {
+        for (int socket = 0; socket < 2; socket++) {
+            for (int core = 0; core < 4; core++)
+                cpus.emplace_back(8*thread + 4*socket + core, socket, core);
+        }
+    }
+    ThreadPlacement::assign(cpus, 1, 3, roleCpus);
+    EXPECT_EQ("dispatch 4, workers 5-7, cleaner 13-15", roles());
+    ThreadPlacement::assign(cpus, 1, 5, roleCpus);
+    EXPECT_EQ("dispatch 4, workers 0-1,5-7, cleaner 8-9,13-15", roles());
+}
+
+TEST_F(ThreadPlacementTest, assign_noSmt) {
+    std::vector<Cpu> cpus;
+    for (int cpu = 0; cpu < 8; cpu++)
+        cpus.emplace_back(cpu, cpu / 4, cpu % 4);
+
+    // Unknown NIC socket: the lowest-numbered one is used, and workers get
+    // the rest of its cores.
+    ThreadPlacement::assign(cpus, -1, 0, roleCpus);
+    EXPECT_EQ("dispatch 0, workers 1-3, cleaner 4-7", roles());
+    ThreadPlacement::assign(cpus, 1, 2, roleCpus);
+    EXPECT_EQ("dispatch 4, workers 5-6, cleaner 0-3,7", roles());
+}
+
+TEST_F(ThreadPlacementTest, assign_fewCores) {
+    std::vector<Cpu> cpus = {Cpu(0, 0, 0), Cpu(1, 0, 0)};
+    ThreadPlacement::assign(cpus, -1, 0, roleCpus);
+    EXPECT_EQ("dispatch 0, workers none, cleaner none", roles());
+
+    // Without spare cores the cleaner shares the workers'.
+    cpus = {Cpu(0, 0, 0), Cpu(1, 0, 1)};
+    ThreadPlacement::assign(cpus, -1, 4, roleCpus);
+    EXPECT_EQ("dispatch 0, workers 1, cleaner 1", roles());
+
+    cpus.clear();
+    ThreadPlacement::assign(cpus, -1, 4, roleCpus);
+    EXPECT_EQ("dispatch none, workers none, cleaner none", roles());
+}
+
+TEST_F(ThreadPlacementTest, parseCpuList) {
+    cpu_set_t set;
+    EXPECT_TRUE(ThreadPlacement::parseCpuList("0-3,8,10-11", &set));
+    EXPECT_EQ("0-3,8,10-11", ThreadPlacement::cpuList(set));
+    EXPECT_TRUE(ThreadPlacement::parseCpuList("5", &set));
+    EXPECT_EQ("5", ThreadPlacement::cpuList(set));
+    EXPECT_FALSE(ThreadPlacement::parseCpuList("", &set));
+    EXPECT_FALSE(ThreadPlacement::parseCpuList("3-1", &set));
+    EXPECT_FALSE(ThreadPlacement::parseCpuList("1-2x", &set));
+    EXPECT_FALSE(ThreadPlacement::parseCpuList("-1", &set));
+    EXPECT_FALSE(ThreadPlacement::parseCpuList("100000", &set));
+}
+
+TEST_F(ThreadPlacementTest, findNicSocket) {
+    std::vector<Cpu> cpus = {Cpu(0, 0, 0), Cpu(1, 0, 1), Cpu(2, 1, 0),
+            Cpu(3, 1, 1)};
+    writeFile("/class/infiniband/mlx4_0/device/numa_node", "1\n");
+    writeFile("/class/net/eth0/device/numa_node", "0\n");
+    writeFile("/devices/system/node/node0/cpulist", "0-1\n");
+    writeFile("/devices/system/node/node1/cpulist", "2-3\n");
+    EXPECT_EQ(1, ThreadPlacement::findNicSocket("mlx4_0", cpus));
+    EXPECT_EQ(0, ThreadPlacement::findNicSocket("eth0", cpus));
+    EXPECT_EQ(-1, ThreadPlacement::findNicSocket("", cpus));
+    EXPECT_EQ("", TestLog::get());
+    EXPECT_EQ(-1, ThreadPlacement::findNicSocket("eth9", cpus));
+    EXPECT_EQ("findNicSocket: Couldn't find the socket that NIC eth9 is "
+            "attached to", TestLog::get());
+}
+
+TEST_F(ThreadPlacementTest, readTopology) {
+    cpu_set_t allowed;
+    ASSERT_EQ(0, sched_getaffinity(0, sizeof(allowed), &allowed));
+    int cpu = 0;
+    while (!CPU_ISSET(cpu, &allowed))
+        cpu++;
+    writeFile(format("/devices/system/cpu/cpu%d/topology/"
+            "physical_package_id", cpu), "3\n");
+    writeFile(format("/devices/system/cpu/cpu%d/topology/core_id", cpu),
+            "7\n");
+    std::vector<Cpu> cpus = ThreadPlacement::readTopology();
+    ASSERT_EQ(downCast<size_t>(CPU_COUNT(&allowed)), cpus.size());
+    EXPECT_EQ(cpu, cpus[0].cpu);
+    EXPECT_EQ(3, cpus[0].socket);
+    EXPECT_EQ(7, cpus[0].core);
+}
+
+}  // namespace RAMCloud
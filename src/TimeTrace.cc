@@ -14,6 +14,7 @@
  */
 
 #include "TimeTrace.h"
+#include "TraceStreamer.h"
 
 namespace RAMCloud {
 TimeTrace* TimeTrace::globalTimeTrace;
@@ -40,6 +41,8 @@ TimeTrace::TimeTrace()
  */
 TimeTrace::~TimeTrace()
 {
+    if (globalTimeTrace == this)
+        globalTimeTrace = NULL;
 }
 
 /**
@@ -69,6 +72,8 @@ TimeTrace::~TimeTrace()
 void TimeTrace::record(uint64_t timestamp, const char* format,
         uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3)
 {
+    // Also export the event if continuous tracing is on.
+    TraceStreamer::record(timestamp, format, arg0, arg1, arg2, arg3);
     if (readerActive) {
         return;
     }
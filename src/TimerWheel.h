@@ -0,0 +1,368 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_TIMERWHEEL_H
+#define RAMCLOUD_TIMERWHEEL_H
+
+#include "Common.h"
+#include "BoostIntrusive.h"
+
+namespace RAMCloud {
+
+/**
+ * A hierarchical timing wheel: it keeps track of a collection of timers,
+ * each with a trigger time, so that starting and stopping a timer take
+ * constant time and finding the timers that have expired only touches
+ * those timers (plus a few bitmap words), no matter how many timers are
+ * waiting. This class is used by Dispatch and WorkerTimer; it does no
+ * locking of its own.
+ *
+ * The wheel has LEVELS levels of SLOTS slots each. A timer is placed
+ * according to the highest group of BITS bits in which its trigger time
+ * differs from #currentTime: level 0 holds timers that only differ in the
+ * lowest group (so every timer in a level 0 slot has the same trigger
+ * time), level 1 those that differ in the next group, and so on. As a
+ * result, every timer at one level triggers before every timer at the next
+ * level, and within a level the slots are in trigger order, so the earliest
+ * timers can be found with a find-first-set on each level's occupancy
+ * bitmap. When #currentTime advances into a slot above level 0 whose
+ * timers haven't all triggered, the remaining ones are moved down to lower
+ * levels; each timer moves at most LEVELS times over its lifetime.
+ *
+ * \tparam T
+ *      Type of the timers. T must have the following members, accessible
+ *      to this class: "uint64_t triggerTime" (the time in Cycles::rdtsc
+ *      units at which the timer fires), "int slot" (used by this class;
+ *      >= 0 if and only if the timer is in the wheel), and
+ *      "IntrusiveListHook links".
+ */
+template<typename T>
+class TimerWheel {
+  public:
+    TimerWheel()
+        : currentTime(0)
+        , occupied()
+        , lists()
+        , count(0)
+        , cachedEarliest(~0lu)
+        , earliestValid(true)
+    {}
+
+    /**
+     * Add a timer to the wheel, or move it if it is already there.
+     *
+     * \param timer
+     *      The timer.
+     * \param time
+     *      The timer's new trigger time; it is stored in the timer's
+     *      triggerTime. If this time has already passed (it is before the
+     *      time of the last call to #advance) the timer will expire during
+     *      the next call to #advance.
+     */
+    void
+    insert(T* timer, uint64_t time)
+    {
+        if (timer->slot >= 0) {
+            remove(timer);
+        }
+        timer->triggerTime = time;
+        int index;
+        if (time < currentTime) {
+            index = LATE;
+        } else {
+            int level = levelFor(time);
+            int slot = downCast<int>((time >> (level * BITS)) & (SLOTS - 1));
+            occupied[level] |= 1lu << slot;
+            index = level * SLOTS + slot;
+        }
+        lists[index].push_back(*timer);
+        timer->slot = index;
+        count++;
+        if (earliestValid && (time < cachedEarliest)) {
+            cachedEarliest = time;
+        }
+    }
+
+    /**
+     * Remove a timer from the wheel.
+     *
+     * \param timer
+     *      The timer; it must currently be in the wheel.
+     */
+    void
+    remove(T* timer)
+    {
+        int index = timer->slot;
+        erase(lists[index], *timer);
+        if ((index < LATE) && lists[index].empty()) {
+            occupied[index / SLOTS] &= ~(1lu << (index % SLOTS));
+        }
+        timer->slot = -1;
+        count--;
+        if (timer->triggerTime == cachedEarliest) {
+            earliestValid = false;
+        }
+    }
+
+    /**
+     * Find all of the timers whose trigger time is at or before a given
+     * time, and queue them for #popExpired. Timers inserted later with
+     * trigger times no later than this won't be returned by #popExpired
+     * until the next call to this method.
+     *
+     * \param now
+     *      Current time, in Cycles::rdtsc units. This is normally no less
+     *      than the value passed to the previous call; if it is less (e.g.
+     *      the clock was read on a different core) only timers inserted late
+     *      can expire.
+     */
+    void
+    advance(uint64_t now)
+    {
+        for (typename List::iterator it = lists[LATE].begin();
+                it != lists[LATE].end(); ) {
+            T* timer = &*it;
+            it++;
+            if (timer->triggerTime <= now) {
+                moveToExpired(timer);
+            }
+        }
+        uint64_t target = (now == ~0lu) ? now : now + 1;
+        if (target <= currentTime) {
+            return;
+        }
+        earliestValid = false;
+
+        // Timers from the one slot that straddles target; they must be
+        // reinserted once currentTime has been updated.
+        List straddlers;
+        bool finished = false;
+        for (int level = 0; (level < LEVELS) && !finished; level++) {
+            int shift = level * BITS;
+            uint64_t base = (shift + BITS >= 64) ? 0
+                    : currentTime & ~((1lu << (shift + BITS)) - 1);
+            while (occupied[level] != 0) {
+                int slot = __builtin_ctzl(occupied[level]);
+                uint64_t slotStart = base
+                        | (downCast<uint64_t>(slot) << shift);
+                if (slotStart > target) {
+                    // Every remaining timer triggers after target, and
+                    // stays at the same level once currentTime moves to
+                    // target. (A slot that starts exactly at target must
+                    // still be moved down a level.)
+                    finished = true;
+                    break;
+                }
+                occupied[level] &= ~(1lu << slot);
+                List& list = lists[level * SLOTS + slot];
+                uint64_t slotLast = slotStart + ((1lu << shift) - 1);
+                while (!list.empty()) {
+                    T* timer = &list.front();
+                    if (timer->triggerTime < target) {
+                        moveToExpired(timer);
+                    } else {
+                        list.pop_front();
+                        straddlers.push_back(*timer);
+                    }
+                }
+                if (slotLast >= target) {
+                    finished = true;
+                    break;
+                }
+            }
+        }
+        currentTime = target;
+        while (!straddlers.empty()) {
+            T* timer = &straddlers.front();
+            straddlers.pop_front();
+            timer->slot = -1;
+            count--;
+            insert(timer, timer->triggerTime);
+        }
+    }
+
+    /**
+     * Remove one of the timers found by the last call to #advance from the
+     * wheel and return it; they are returned in trigger order (roughly:
+     * timers whose trigger times are close together may come out in the
+     * order they were inserted).
+     *
+     * \return
+     *      The timer, or NULL if there are no expired timers left.
+     */
+    T*
+    popExpired()
+    {
+        if (lists[EXPIRED].empty()) {
+            return NULL;
+        }
+        T* timer = &lists[EXPIRED].front();
+        remove(timer);
+        return timer;
+    }
+
+    /**
+     * Return the earliest trigger time of any timer in the wheel, or ~0 if
+     * the wheel is empty. This is normally cheap: at worst it scans the
+     * timers in a single slot.
+     */
+    uint64_t
+    earliest()
+    {
+        if (earliestValid) {
+            return cachedEarliest;
+        }
+        uint64_t result = ~0lu;
+        if (!lists[LATE].empty() || !lists[EXPIRED].empty()) {
+            // These timers all trigger before any in the slots.
+            result = minimum(lists[LATE], result);
+            result = minimum(lists[EXPIRED], result);
+        } else {
+            for (int level = 0; level < LEVELS; level++) {
+                if (occupied[level] == 0) {
+                    continue;
+                }
+                int slot = __builtin_ctzl(occupied[level]);
+                if (level == 0) {
+                    result = (currentTime & ~(SLOTS - 1lu))
+                            | downCast<uint64_t>(slot);
+                } else {
+                    result = minimum(lists[level * SLOTS + slot], result);
+                }
+                break;
+            }
+        }
+        cachedEarliest = result;
+        earliestValid = true;
+        return result;
+    }
+
+    /**
+     * Return one of the timers in the wheel (not necessarily the earliest),
+     * or NULL if the wheel is empty. Intended for cleaning up.
+     */
+    T*
+    any()
+    {
+        if (!lists[LATE].empty()) {
+            return &lists[LATE].front();
+        }
+        if (!lists[EXPIRED].empty()) {
+            return &lists[EXPIRED].front();
+        }
+        for (int level = 0; level < LEVELS; level++) {
+            if (occupied[level] != 0) {
+                int slot = __builtin_ctzl(occupied[level]);
+                return &lists[level * SLOTS + slot].front();
+            }
+        }
+        return NULL;
+    }
+
+    /// Return the number of timers in the wheel.
+    size_t size() const { return count; }
+
+    /// Return true if there are no timers in the wheel.
+    bool empty() const { return count == 0; }
+
+  PRIVATE:
+    INTRUSIVE_LIST_TYPEDEF(T, links) List;
+
+    enum {
+        /// Number of trigger time bits handled by each level.
+        BITS = 6,
+
+        /// Number of slots in each level.
+        SLOTS = 1 << BITS,
+
+        /// Number of levels: enough to cover all 64 bits of a trigger time.
+        LEVELS = (64 + BITS - 1) / BITS,
+
+        /// Index in lists of the timers inserted with trigger times before
+        /// currentTime.
+        LATE = LEVELS * SLOTS,
+
+        /// Index in lists of the timers found by advance but not yet
+        /// returned by popExpired.
+        EXPIRED = LATE + 1
+    };
+
+    /**
+     * Return the level at which a timer with a given trigger time (no less
+     * than currentTime) belongs.
+     */
+    int
+    levelFor(uint64_t time)
+    {
+        uint64_t diff = time ^ currentTime;
+        if (diff == 0) {
+            return 0;
+        }
+        return (63 - __builtin_clzl(diff)) / BITS;
+    }
+
+    /**
+     * Move a timer (which must be in the wheel) to the list of expired
+     * timers.
+     */
+    void
+    moveToExpired(T* timer)
+    {
+        erase(lists[timer->slot], *timer);
+        lists[EXPIRED].push_back(*timer);
+        timer->slot = EXPIRED;
+    }
+
+    /**
+     * Return the smallest of initial and the trigger times of the timers
+     * in a list.
+     */
+    static uint64_t
+    minimum(List& list, uint64_t initial)
+    {
+        uint64_t result = initial;
+        for (typename List::iterator it = list.begin(); it != list.end();
+                it++) {
+            if (it->triggerTime < result) {
+                result = it->triggerTime;
+            }
+        }
+        return result;
+    }
+
+    /// Every timer in the slots triggers at or after this time; the slot of
+    /// each timer is determined by how its trigger time differs from this.
+    uint64_t currentTime;
+
+    /// Bit i of occupied[level] is set if slot i of that level has timers.
+    uint64_t occupied[LEVELS];
+
+    /// Holds the timers: one list for each slot of each level, followed by
+    /// the LATE and EXPIRED lists. A timer's slot field is its index here.
+    List lists[EXPIRED + 1];
+
+    /// Number of timers in the wheel.
+    size_t count;
+
+    /// If earliestValid is true, this is the value earliest will return.
+    uint64_t cachedEarliest;
+    bool earliestValid;
+
+    DISALLOW_COPY_AND_ASSIGN(TimerWheel);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_TIMERWHEEL_H
@@ -0,0 +1,276 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "TimerWheel.h"
+
+namespace RAMCloud {
+
+struct TestTimer {
+    TestTimer()
+        : triggerTime(0)
+        , slot(-1)
+        , links()
+    {}
+    uint64_t triggerTime;
+    int slot;
+    IntrusiveListHook links;
+    DISALLOW_COPY_AND_ASSIGN(TestTimer);
+};
+
+typedef TimerWheel<TestTimer> Wheel;
+
+// Pop all of the expired timers from a wheel, and return their trigger
+// times.
+static string
+popAll(Wheel* wheel)
+{
+    string result;
+    TestTimer* timer;
+    while ((timer = wheel->popExpired()) != NULL) {
+        if (!result.empty())
+            result.append(" ");
+        result.append(format("%lu", timer->triggerTime));
+    }
+    return result;
+}
+
+TEST(TimerWheelTest, insert_levels) {
+    TestTimer t1, t2, t3, t4, t5;
+    Wheel wheel;
+    wheel.insert(&t1, 0);
+    wheel.insert(&t2, 5);
+    wheel.insert(&t3, 64);
+    wheel.insert(&t4, 1lu << 20);
+    wheel.insert(&t5, ~0lu);
+    EXPECT_EQ(0, t1.slot);
+    EXPECT_EQ(5, t2.slot);
+    EXPECT_EQ(Wheel::SLOTS + 1, t3.slot);
+    EXPECT_EQ(3*Wheel::SLOTS + 4, t4.slot);
+    EXPECT_EQ(10*Wheel::SLOTS + 15, t5.slot);
+    EXPECT_EQ(0x21lu, wheel.occupied[0]);
+    EXPECT_EQ(0x2lu, wheel.occupied[1]);
+    EXPECT_EQ(5U, wheel.size());
+}
+
+TEST(TimerWheelTest, insert_late) {
+    TestTimer t1, t2;
+    Wheel wheel;
+    wheel.advance(100);
+    wheel.insert(&t1, 50);
+    wheel.insert(&t2, 101);
+    EXPECT_EQ(Wheel::LATE, t1.slot);
+    EXPECT_EQ(37, t2.slot);
+    EXPECT_EQ(50lu, wheel.earliest());
+}
+
+TEST(TimerWheelTest, insert_alreadyInWheel) {
+    TestTimer t1;
+    Wheel wheel;
+    wheel.insert(&t1, 10);
+    wheel.insert(&t1, 200);
+    EXPECT_EQ(1U, wheel.size());
+    EXPECT_EQ(0lu, wheel.occupied[0]);
+    EXPECT_EQ(Wheel::SLOTS + 3, t1.slot);
+    EXPECT_EQ(200lu, wheel.earliest());
+}
+
+TEST(TimerWheelTest, remove) {
+    TestTimer t1, t2, t3;
+    Wheel wheel;
+    wheel.insert(&t1, 70);
+    wheel.insert(&t2, 80);
+    wheel.insert(&t3, 90);
+    EXPECT_EQ(70lu, wheel.earliest());
+    wheel.remove(&t1);
+    EXPECT_EQ(-1, t1.slot);
+    EXPECT_EQ(2U, wheel.size());
+    EXPECT_EQ(0x2lu, wheel.occupied[1]);
+    EXPECT_EQ(80lu, wheel.earliest());
+    wheel.remove(&t3);
+    wheel.remove(&t2);
+    EXPECT_EQ(0lu, wheel.occupied[1]);
+    EXPECT_TRUE(wheel.empty());
+    EXPECT_EQ(~0lu, wheel.earliest());
+}
+
+TEST(TimerWheelTest, advance_straddlingSlot) {
+    TestTimer t1, t2, t3, t4;
+    Wheel wheel;
+    wheel.insert(&t1, 150);
+    wheel.insert(&t2, 160);
+    wheel.insert(&t3, 180);
+    wheel.insert(&t4, 170);
+    wheel.advance(175);
+    EXPECT_EQ(176lu, wheel.currentTime);
+    EXPECT_EQ("150 160 170", popAll(&wheel));
+
+    // t3 should have moved down to level 0.
+    EXPECT_EQ(52, t3.slot);
+    EXPECT_EQ(180lu, wheel.earliest());
+    EXPECT_EQ(1U, wheel.size());
+}
+
+TEST(TimerWheelTest, advance_slotStartsAtTarget) {
+    TestTimer t1;
+    Wheel wheel;
+    wheel.insert(&t1, 70);
+    EXPECT_EQ(Wheel::SLOTS + 1, t1.slot);
+    wheel.advance(63);
+    EXPECT_EQ("", popAll(&wheel));
+    EXPECT_EQ(6, t1.slot);
+    EXPECT_EQ(70lu, wheel.earliest());
+}
+
+TEST(TimerWheelTest, advance_severalLevels) {
+    TestTimer t1, t2, t3, t4, t5;
+    Wheel wheel;
+    wheel.insert(&t1, 3);
+    wheel.insert(&t2, 1000);
+    wheel.insert(&t3, 100000);
+    wheel.insert(&t4, 100000000);
+    wheel.insert(&t5, 50000);
+    wheel.advance(2);
+    EXPECT_EQ("", popAll(&wheel));
+    wheel.advance(99999);
+    EXPECT_EQ("3 1000 50000", popAll(&wheel));
+    EXPECT_EQ(100000lu, wheel.earliest());
+    wheel.advance(100000);
+    EXPECT_EQ("100000", popAll(&wheel));
+    wheel.advance(~0lu - 1);
+    EXPECT_EQ("100000000", popAll(&wheel));
+    EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimerWheelTest, advance_lateTimers) {
+    TestTimer t1, t2, t3;
+    Wheel wheel;
+    wheel.insert(&t1, 100);
+    wheel.advance(200);
+
+    // Timers inserted in the past don't expire until the next advance.
+    wheel.insert(&t2, 0);
+    EXPECT_EQ("100", popAll(&wheel));
+    wheel.insert(&t3, 150);
+    EXPECT_EQ(0lu, wheel.earliest());
+    wheel.advance(200);
+    EXPECT_EQ("0 150", popAll(&wheel));
+}
+
+TEST(TimerWheelTest, advance_clockGoesBackwards) {
+    TestTimer t1, t2;
+    Wheel wheel;
+    wheel.advance(1000);
+    wheel.insert(&t1, 500);
+    wheel.insert(&t2, 300);
+    wheel.advance(400);
+    EXPECT_EQ("300", popAll(&wheel));
+    EXPECT_EQ(500lu, wheel.earliest());
+    wheel.advance(600);
+    EXPECT_EQ("500", popAll(&wheel));
+}
+
+TEST(TimerWheelTest, popExpired_removeBeforePopped) {
+    TestTimer t1, t2, t3;
+    Wheel wheel;
+    wheel.insert(&t1, 10);
+    wheel.insert(&t2, 20);
+    wheel.insert(&t3, 30);
+    wheel.advance(25);
+    EXPECT_EQ(&t1, wheel.popExpired());
+    EXPECT_EQ(-1, t1.slot);
+    wheel.remove(&t2);
+    EXPECT_TRUE(wheel.popExpired() == NULL);
+    EXPECT_EQ(1U, wheel.size());
+}
+
+TEST(TimerWheelTest, earliest) {
+    TestTimer t1, t2, t3;
+    Wheel wheel;
+    EXPECT_EQ(~0lu, wheel.earliest());
+    wheel.insert(&t1, 5000);
+    EXPECT_EQ(5000lu, wheel.earliest());
+    wheel.insert(&t2, 4100);
+    wheel.insert(&t3, 4097);
+    EXPECT_EQ(4097lu, wheel.earliest());
+    wheel.remove(&t3);
+    EXPECT_EQ(4100lu, wheel.earliest());
+    wheel.advance(4096);
+    EXPECT_EQ(4100lu, wheel.earliest());
+}
+
+TEST(TimerWheelTest, any) {
+    TestTimer t1, t2;
+    Wheel wheel;
+    EXPECT_TRUE(wheel.any() == NULL);
+    wheel.insert(&t1, 5000);
+    EXPECT_EQ(&t1, wheel.any());
+    wheel.advance(100);
+    wheel.insert(&t2, 10);
+    EXPECT_EQ(&t2, wheel.any());
+}
+
+TEST(TimerWheelTest, randomized) {
+    // Compare the wheel against a simple scan of all the timers.
+    const int numTimers = 200;
+    std::vector<TestTimer*> timers;
+    for (int i = 0; i < numTimers; i++)
+        timers.push_back(new TestTimer);
+    Wheel wheel;
+    uint64_t now = 0;
+    for (int round = 0; round < 500; round++) {
+        for (int i = 0; i < 20; i++) {
+            TestTimer* timer = timers[generateRandom() % numTimers];
+            if (generateRandom() % 4 == 0) {
+                if (timer->slot >= 0)
+                    wheel.remove(timer);
+                continue;
+            }
+            wheel.insert(timer, now + (generateRandom() %
+                    (1lu << (generateRandom() % 40))));
+        }
+        uint64_t earliest = ~0lu;
+        uint64_t running = 0;
+        foreach (TestTimer* timer, timers) {
+            if (timer->slot >= 0) {
+                running++;
+                earliest = std::min(earliest, timer->triggerTime);
+            }
+        }
+        ASSERT_EQ(running, wheel.size());
+        ASSERT_EQ(earliest, wheel.earliest());
+
+        now += generateRandom() % (1lu << (generateRandom() % 30));
+        uint64_t expected = 0;
+        foreach (TestTimer* timer, timers) {
+            if ((timer->slot >= 0) && (timer->triggerTime <= now))
+                expected++;
+        }
+        wheel.advance(now);
+        TestTimer* timer;
+        while ((timer = wheel.popExpired()) != NULL) {
+            ASSERT_LE(timer->triggerTime, now);
+            expected--;
+        }
+        ASSERT_EQ(0U, expected);
+    }
+    foreach (TestTimer* timer, timers) {
+        if (timer->slot >= 0)
+            wheel.remove(timer);
+        delete timer;
+    }
+}
+
+}  // namespace RAMCloud
@@ -0,0 +1,300 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "IpAddress.h"
+#include "ServiceLocator.h"
+#include "ShortMacros.h"
+#include "ThreadId.h"
+#include "TraceStreamer.h"
+
+namespace RAMCloud {
+
+volatile int TraceStreamer::streaming = 0;
+__thread TraceStreamer::Ring* TraceStreamer::threadRing = NULL;
+SpinLock TraceStreamer::mutex("TraceStreamer::mutex");
+std::vector<TraceStreamer::Ring*> TraceStreamer::rings;
+int TraceStreamer::fd = -1;
+bool TraceStreamer::udp = false;
+std::vector<char> TraceStreamer::chunk;
+std::unordered_map<const char*, uint32_t> TraceStreamer::formatIds;
+volatile bool TraceStreamer::stopDrainer = false;
+Tub<std::thread> TraceStreamer::drainer;
+
+/**
+ * Start recording events and exporting them. If streaming is already on,
+ * the current output is finished first.
+ *
+ * \param destination
+ *      Where to send the events: either the name of a file, which is
+ *      replaced, or a service locator such as "udp:host=rc01,port=7000"
+ *      for a collector that receives datagrams (each of which can be
+ *      decoded on its own).
+ *
+ * \throw FatalError
+ *      The destination couldn't be opened.
+ */
+void
+TraceStreamer::start(const string& destination)
+{
+    stop();
+    if (destination.compare(0, 4, "udp:") == 0) {
+        ServiceLocator locator(destination);
+        IpAddress address(&locator);
+        fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (fd < 0) {
+            throw FatalError(HERE, format("couldn't create socket for "
+                    "trace collector: %s", strerror(errno)));
+        }
+        if (connect(fd, &address.address, sizeof(address.address)) != 0) {
+            int error = errno;
+            close(fd);
+            fd = -1;
+            throw FatalError(HERE, format("couldn't connect to trace "
+                    "collector %s: %s", destination.c_str(), strerror(error)));
+        }
+        udp = true;
+    } else {
+        fd = open(destination.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644);
+        if (fd < 0) {
+            throw FatalError(HERE, format("couldn't open trace file %s: %s",
+                    destination.c_str(), strerror(errno)));
+        }
+        udp = false;
+    }
+    LOG(NOTICE, "Streaming time trace to %s", destination.c_str());
+
+    // Events recorded before now (when streaming was last on) are stale.
+    {
+        std::lock_guard<SpinLock> lock(mutex);
+        foreach (Ring* ring, rings)
+            ring->tail = ring->head;
+    }
+    chunk.clear();
+    formatIds.clear();
+    startChunk();
+    stopDrainer = false;
+    streaming = 1;
+    drainer.construct(drainerMain);
+}
+
+/**
+ * Stop recording events, export those already recorded, and close the
+ * output. Does nothing if streaming is off.
+ */
+void
+TraceStreamer::stop()
+{
+    if (!drainer)
+        return;
+    streaming = 0;
+    stopDrainer = true;
+    drainer->join();
+    drainer.destroy();
+    drain();
+    close(fd);
+    fd = -1;
+}
+
+/**
+ * Add bytes to the output.
+ *
+ * \param data
+ *      The first byte to add.
+ * \param length
+ *      Number of bytes to add.
+ */
+void
+TraceStreamer::append(const void* data, size_t length)
+{
+    const char* bytes = static_cast<const char*>(data);
+    chunk.insert(chunk.end(), bytes, bytes + length);
+}
+
+/**
+ * Add one event to the output, preceded by a description of its format
+ * string if the output doesn't have one yet.
+ *
+ * \param ring
+ *      The ring that held the event.
+ * \param event
+ *      A copy of the event.
+ */
+void
+TraceStreamer::appendEvent(Ring* ring, const Event& event)
+{
+    auto it = formatIds.find(event.format);
+    size_t length = sizeof(EventRecord);
+    if (it == formatIds.end())
+        length += sizeof(FormatRecord) + strlen(event.format);
+    if (udp && (chunk.size() + length > UDP_CHUNK_BYTES)) {
+        flush();
+        it = formatIds.end();
+    }
+
+    uint32_t id;
+    if (it != formatIds.end()) {
+        id = it->second;
+    } else {
+        id = downCast<uint32_t>(formatIds.size());
+        formatIds[event.format] = id;
+        FormatRecord record;
+        record.type = FORMAT;
+        record.id = id;
+        record.length = downCast<uint32_t>(strlen(event.format));
+        append(&record, sizeof(record));
+        append(event.format, record.length);
+    }
+
+    EventRecord record;
+    record.type = EVENT;
+    record.threadId = ring->threadId;
+    record.timestamp = event.timestamp;
+    record.formatId = id;
+    record.args[0] = event.arg0;
+    record.args[1] = event.arg1;
+    record.args[2] = event.arg2;
+    record.args[3] = event.arg3;
+    append(&record, sizeof(record));
+}
+
+/**
+ * Export all of the events recorded since the last call, from every thread.
+ * Only one thread may call this at a time (normally the drainer).
+ */
+void
+TraceStreamer::drain()
+{
+    std::vector<Ring*> current;
+    {
+        std::lock_guard<SpinLock> lock(mutex);
+        current = rings;
+    }
+
+    foreach (Ring* ring, current) {
+        uint64_t lost = 0;
+        uint64_t tail = ring->tail;
+        while (tail < ring->head) {
+            // Skip the events that have been (or may be about to be)
+            // overwritten; the owner writes events[head] before it
+            // increments head.
+            uint64_t head = ring->head;
+            if (head - tail >= RING_SIZE) {
+                lost += head - tail - RING_SIZE + 1;
+                tail = head - RING_SIZE + 1;
+            }
+            Event event = ring->events[tail & (RING_SIZE - 1)];
+
+            // If the owner caught up with the slot while it was being
+            // copied, the copy may be garbage.
+            __asm__ __volatile__("" ::: "memory");
+            if (ring->head - tail >= RING_SIZE)
+                continue;
+            appendEvent(ring, event);
+            tail++;
+        }
+        ring->tail = tail;
+
+        if (lost != 0) {
+            if (udp && (chunk.size() + sizeof(LostRecord) > UDP_CHUNK_BYTES))
+                flush();
+            LostRecord record;
+            record.type = LOST;
+            record.threadId = ring->threadId;
+            record.count = lost;
+            append(&record, sizeof(record));
+        }
+    }
+    flush();
+}
+
+/**
+ * The main program for the drainer thread, which exports events every
+ * DRAIN_INTERVAL_MICROS until stop is called.
+ */
+void
+TraceStreamer::drainerMain()
+{
+    while (!stopDrainer) {
+        drain();
+        usleep(DRAIN_INTERVAL_MICROS);
+    }
+}
+
+/**
+ * Write the output accumulated in #chunk and start a new chunk.
+ */
+void
+TraceStreamer::flush()
+{
+    if (chunk.size() <= (udp ? sizeof(HeaderRecord) : 0))
+        return;
+    const char* data = chunk.data();
+    size_t length = chunk.size();
+    while (length > 0) {
+        ssize_t count = write(fd, data, length);
+        if (count < 0) {
+            if (errno == EINTR)
+                continue;
+            // A collector that isn't listening yet shouldn't stop tracing;
+            // this chunk is lost.
+            RAMCLOUD_CLOG(WARNING, "couldn't write time trace: %s",
+                    strerror(errno));
+            break;
+        }
+        data += count;
+        length -= static_cast<size_t>(count);
+    }
+    chunk.clear();
+    if (udp) {
+        formatIds.clear();
+        startChunk();
+    }
+}
+
+/**
+ * Create the ring for the calling thread, the first time it records an
+ * event.
+ *
+ * \return
+ *      The thread's new ring (also stored in threadRing).
+ */
+TraceStreamer::Ring*
+TraceStreamer::registerThread()
+{
+    Ring* ring = new Ring(ThreadId::get());
+    std::lock_guard<SpinLock> lock(mutex);
+    rings.push_back(ring);
+    threadRing = ring;
+    return ring;
+}
+
+/**
+ * Begin a new chunk of the output with a HeaderRecord.
+ */
+void
+TraceStreamer::startChunk()
+{
+    HeaderRecord record;
+    record.type = HEADER;
+    record.version = 1;
+    record.cyclesPerSecond = Cycles::perSecond();
+    append(&record, sizeof(record));
+}
+
+} // namespace RAMCloud
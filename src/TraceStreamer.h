@@ -0,0 +1,232 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_TRACESTREAMER_H
+#define RAMCLOUD_TRACESTREAMER_H
+
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "Common.h"
+#include "Cycles.h"
+#include "SpinLock.h"
+#include "Tub.h"
+
+namespace RAMCloud {
+
+/**
+ * This class exports time trace events continuously, so that tracing can be
+ * left on in production instead of being captured and dumped on demand
+ * (as with TimeTrace, which stops recording while it prints). Each thread
+ * records into its own ring buffer, with no locks or atomic read-modify-
+ * write operations; a background thread drains the rings every few
+ * milliseconds and writes the events, in a compact binary form, either to
+ * a file or to a UDP collector. If a thread records faster than the rings
+ * are drained, its oldest events are overwritten and the loss is noted in
+ * the output. scripts/timetrace2chrome.py converts the output to the
+ * Chrome trace format (for chrome://tracing).
+ *
+ * Recording costs nothing more than a test when streaming is off.
+ *
+ * This class provides only static methods and variables: it isn't
+ * possible to construct an instance from outside.
+ */
+class TraceStreamer {
+  public:
+    /**
+     * Record an event, if streaming is on.
+     *
+     * \param timestamp
+     *      Identifies the time at which the event occurred.
+     * \param format
+     *      A format string for printf describing the event, with up to
+     *      four %u conversions for arg0..arg3 (see TimeTrace::record). The
+     *      string must remain unchanged for the life of the process.
+     * \param arg0
+     *      Argument to use when printing a message about this event.
+     * \param arg1
+     *      Argument to use when printing a message about this event.
+     * \param arg2
+     *      Argument to use when printing a message about this event.
+     * \param arg3
+     *      Argument to use when printing a message about this event.
+     */
+    static inline void
+    record(uint64_t timestamp, const char* format, uint32_t arg0 = 0,
+            uint32_t arg1 = 0, uint32_t arg2 = 0, uint32_t arg3 = 0)
+    {
+        if (!streaming)
+            return;
+        Ring* ring = threadRing;
+        if (ring == NULL)
+            ring = registerThread();
+        uint64_t head = ring->head;
+        Event* event = &ring->events[head & (RING_SIZE - 1)];
+        event->timestamp = timestamp;
+        event->format = format;
+        event->arg0 = arg0;
+        event->arg1 = arg1;
+        event->arg2 = arg2;
+        event->arg3 = arg3;
+
+        // The event must be complete before the drainer can see it. x86
+        // doesn't reorder stores, so it's enough to stop the compiler from
+        // doing so (a real fence would double the cost of recording).
+        __asm__ __volatile__("" ::: "memory");
+        ring->head = head + 1;
+    }
+
+    static inline void
+    record(const char* format, uint32_t arg0 = 0, uint32_t arg1 = 0,
+            uint32_t arg2 = 0, uint32_t arg3 = 0)
+    {
+        if (streaming)
+            record(Cycles::rdtsc(), format, arg0, arg1, arg2, arg3);
+    }
+
+    static void start(const string& destination);
+    static void stop();
+
+    /// Values for the type field at the start of each record in the output.
+    enum RecordType {
+        // Starts the output, and each datagram sent to a UDP collector.
+        HEADER = 0x54544352,
+        // Assigns an id to a format string; followed by its characters.
+        FORMAT = 1,
+        // One event.
+        EVENT = 2,
+        // Some events were overwritten before they could be exported.
+        LOST = 3
+    };
+
+    struct HeaderRecord {
+        uint32_t type;              // HEADER.
+        uint32_t version;           // Version of the output format: 1.
+        double cyclesPerSecond;     // For converting event timestamps.
+    } __attribute__((packed));
+
+    struct FormatRecord {
+        uint32_t type;              // FORMAT.
+        uint32_t id;                // Used by EventRecords to refer to this.
+        uint32_t length;            // Number of characters that follow.
+    } __attribute__((packed));
+
+    struct EventRecord {
+        uint32_t type;              // EVENT.
+        uint32_t threadId;          // ThreadId of the recording thread.
+        uint64_t timestamp;         // Cycles::rdtsc time of the event.
+        uint32_t formatId;          // Refers to an earlier FormatRecord.
+        uint32_t args[4];           // Arguments for the format string.
+    } __attribute__((packed));
+
+    struct LostRecord {
+        uint32_t type;              // LOST.
+        uint32_t threadId;          // ThreadId of the recording thread.
+        uint64_t count;             // Number of events lost.
+    } __attribute__((packed));
+
+  PRIVATE:
+    /// One event as recorded (see record's arguments).
+    struct Event {
+        uint64_t timestamp;
+        const char* format;
+        uint32_t arg0;
+        uint32_t arg1;
+        uint32_t arg2;
+        uint32_t arg3;
+    };
+
+    /// Number of events that each thread's ring holds; a power of two.
+    static const uint64_t RING_SIZE = 1 << 14;
+
+    /// The events recorded by one thread. Only the owning thread writes
+    /// the events and #head; only the drainer writes #tail.
+    struct Ring {
+        explicit Ring(int threadId)
+            : head(0)
+            , tail(0)
+            , threadId(threadId)
+            , events()
+        {}
+
+        /// Number of events ever recorded in this ring; the next one goes
+        /// in events[head % RING_SIZE].
+        volatile uint64_t head;
+
+        /// Number of events that have been exported (or lost).
+        uint64_t tail;
+
+        /// ThreadId of the owning thread.
+        int threadId;
+
+        Event events[RING_SIZE];
+    };
+
+    /// The output is sent in chunks of at most this many bytes; this keeps
+    /// each chunk small enough for a single UDP datagram.
+    static const size_t UDP_CHUNK_BYTES = 8192;
+
+    /// How long the drainer sleeps between passes over the rings.
+    static const int DRAIN_INTERVAL_MICROS = 5000;
+
+    TraceStreamer();
+    static void append(const void* data, size_t length);
+    static void appendEvent(Ring* ring, const Event& event);
+    static void drain();
+    static void drainerMain();
+    static void flush();
+    static Ring* registerThread();
+    static void startChunk();
+
+    /// Nonzero means events are being recorded and exported.
+    static volatile int streaming;
+
+    /// The calling thread's ring; NULL until it records something.
+    static __thread Ring* threadRing;
+
+    /// Protects #rings.
+    static SpinLock mutex;
+
+    /// The rings of every thread that has recorded an event. They are never
+    /// freed, since the drainer may be reading them at any time.
+    static std::vector<Ring*> rings;
+
+    /// File descriptor for the output (a file, or a connected UDP socket);
+    /// -1 if not streaming.
+    static int fd;
+
+    /// True means #fd is a UDP socket, so each chunk of the output must be
+    /// self-contained.
+    static bool udp;
+
+    /// Output that hasn't been written to #fd yet.
+    static std::vector<char> chunk;
+
+    /// Ids of the format strings already described in the output (for UDP,
+    /// in the current chunk).
+    static std::unordered_map<const char*, uint32_t> formatIds;
+
+    /// Set by stop to make the drainer exit.
+    static volatile bool stopDrainer;
+
+    /// Background thread that runs drainerMain.
+    static Tub<std::thread> drainer;
+
+    DISALLOW_COPY_AND_ASSIGN(TraceStreamer);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_TRACESTREAMER_H
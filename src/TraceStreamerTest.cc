@@ -0,0 +1,221 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include "TestUtil.h"
+#include "TraceStreamer.h"
+
+namespace RAMCloud {
+
+class TraceStreamerTest : public ::testing::Test {
+  public:
+    char fileName[100];
+
+    TraceStreamerTest()
+        : fileName()
+    {
+        strncpy(fileName, "/tmp/ramcloud-trace-test-delete-this-XXXXXX",
+                sizeof(fileName));
+        close(mkstemp(fileName));
+    }
+
+    ~TraceStreamerTest()
+    {
+        TraceStreamer::stop();
+        unlink(fileName);
+    }
+
+    /// Set up the streamer to write to a given file descriptor without
+    /// starting the drainer, so that tests can call drain themselves.
+    void
+    startWithoutDrainer(int fd, bool udp)
+    {
+        if (TraceStreamer::threadRing != NULL)
+            TraceStreamer::threadRing->tail = TraceStreamer::threadRing->head;
+        TraceStreamer::fd = fd;
+        TraceStreamer::udp = udp;
+        TraceStreamer::chunk.clear();
+        TraceStreamer::formatIds.clear();
+        TraceStreamer::startChunk();
+        TraceStreamer::streaming = 1;
+    }
+
+    /// Undo startWithoutDrainer.
+    void
+    stopWithoutDrainer()
+    {
+        TraceStreamer::streaming = 0;
+        close(TraceStreamer::fd);
+        TraceStreamer::fd = -1;
+    }
+
+    /// Return a human-readable description of the records in a piece of
+    /// output (thread ids and timestamps are omitted).
+    string
+    decode(const string& data)
+    {
+        string s;
+        size_t offset = 0;
+        while (offset + sizeof(uint32_t) <= data.size()) {
+            if (s.size() > 0)
+                s.append(" | ");
+            const char* p = data.data() + offset;
+            uint32_t type = *reinterpret_cast<const uint32_t*>(p);
+            if (type == TraceStreamer::HEADER) {
+                s.append("HEADER");
+                offset += sizeof(TraceStreamer::HeaderRecord);
+            } else if (type == TraceStreamer::FORMAT) {
+                const TraceStreamer::FormatRecord* record =
+                        reinterpret_cast<const TraceStreamer::FormatRecord*>(p);
+                s.append(format("FORMAT %u '%.*s'", record->id,
+                        record->length, p + sizeof(*record)));
+                offset += sizeof(*record) + record->length;
+            } else if (type == TraceStreamer::EVENT) {
+                const TraceStreamer::EventRecord* record =
+                        reinterpret_cast<const TraceStreamer::EventRecord*>(p);
+                s.append(format("EVENT %u %u %u %u %u", record->formatId,
+                        record->args[0], record->args[1], record->args[2],
+                        record->args[3]));
+                offset += sizeof(*record);
+            } else if (type == TraceStreamer::LOST) {
+                const TraceStreamer::LostRecord* record =
+                        reinterpret_cast<const TraceStreamer::LostRecord*>(p);
+                s.append(format("LOST %lu", record->count));
+                offset += sizeof(*record);
+            } else {
+                s.append(format("bad record type %u", type));
+                break;
+            }
+        }
+        return s;
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(TraceStreamerTest);
+};
+
+static void
+recordOnOtherThread()
+{
+    TraceStreamer::record("other thread");
+}
+
+TEST_F(TraceStreamerTest, record_notStreaming) {
+    TraceStreamer::Ring* ring = TraceStreamer::threadRing;
+    uint64_t head = (ring == NULL) ? 0 : ring->head;
+    TraceStreamer::record("ignored %u", 1);
+    EXPECT_EQ(ring, TraceStreamer::threadRing);
+    if (ring != NULL) {
+        EXPECT_EQ(head, ring->head);
+    }
+}
+
+TEST_F(TraceStreamerTest, startAndStop_file) {
+    TraceStreamer::start(fileName);
+    TraceStreamer::record("event %u %u", 1, 2);
+    TraceStreamer::record("event %u %u", 3, 4);
+    std::thread thread(recordOnOtherThread);
+    thread.join();
+    TraceStreamer::stop();
+    EXPECT_EQ(-1, TraceStreamer::fd);
+    EXPECT_EQ("HEADER | FORMAT 0 'event %u %u' | EVENT 0 1 2 0 0 | "
+            "EVENT 0 3 4 0 0 | FORMAT 1 'other thread' | EVENT 1 0 0 0 0",
+            decode(TestUtil::readFile(fileName)));
+
+    // Stopping again is harmless, and nothing is recorded once stopped.
+    TraceStreamer::stop();
+    TraceStreamer::record("event %u %u", 5, 6);
+    EXPECT_EQ("HEADER | FORMAT 0 'event %u %u' | EVENT 0 1 2 0 0 | "
+            "EVENT 0 3 4 0 0 | FORMAT 1 'other thread' | EVENT 1 0 0 0 0",
+            decode(TestUtil::readFile(fileName)));
+}
+
+TEST_F(TraceStreamerTest, start_badFile) {
+    EXPECT_THROW(TraceStreamer::start("/nonexistent/directory/trace"),
+            FatalError);
+    EXPECT_FALSE(TraceStreamer::drainer);
+}
+
+TEST_F(TraceStreamerTest, start_udp) {
+    int collector = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(0, bind(collector, reinterpret_cast<sockaddr*>(&address),
+            sizeof(address)));
+    socklen_t length = sizeof(address);
+    getsockname(collector, reinterpret_cast<sockaddr*>(&address), &length);
+
+    TraceStreamer::start(format("udp:host=127.0.0.1,port=%d",
+            NTOHS(address.sin_port)));
+    TraceStreamer::record("udp %u", 7);
+    TraceStreamer::stop();
+
+    char buffer[TraceStreamer::UDP_CHUNK_BYTES];
+    ssize_t count = recv(collector, buffer, sizeof(buffer), MSG_DONTWAIT);
+    ASSERT_GT(count, 0);
+    EXPECT_EQ("HEADER | FORMAT 0 'udp %u' | EVENT 0 7 0 0 0",
+            decode(string(buffer, count)));
+    close(collector);
+}
+
+TEST_F(TraceStreamerTest, appendEvent_udpChunks) {
+    int fds[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_DGRAM, 0, fds));
+    startWithoutDrainer(fds[0], true);
+    int numEvents = 300;
+    for (int i = 0; i < numEvents; i++)
+        TraceStreamer::record("chunk %u", i);
+    TraceStreamer::drain();
+    stopWithoutDrainer();
+
+    // Each datagram can be decoded on its own.
+    char buffer[TraceStreamer::UDP_CHUNK_BYTES];
+    int events = 0;
+    int datagrams = 0;
+    while (1) {
+        ssize_t count = recv(fds[1], buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (count <= 0)
+            break;
+        datagrams++;
+        string s = decode(string(buffer, count));
+        EXPECT_EQ(0U, s.find("HEADER | FORMAT 0 'chunk %u' | EVENT 0 "));
+        events += downCast<int>(std::count(s.begin(), s.end(), '|')) - 1;
+    }
+    close(fds[1]);
+    EXPECT_EQ(2, datagrams);
+    EXPECT_EQ(numEvents, events);
+}
+
+TEST_F(TraceStreamerTest, drain_lost) {
+    startWithoutDrainer(open(fileName, O_WRONLY), false);
+    for (uint32_t i = 0; i < TraceStreamer::RING_SIZE + 3; i++)
+        TraceStreamer::record("lost %u", i);
+    TraceStreamer::drain();
+    stopWithoutDrainer();
+
+    // The oldest events were overwritten, and the one in the slot that the
+    // next event would use is skipped too.
+    string s = decode(TestUtil::readFile(fileName));
+    EXPECT_EQ(0U, s.find("HEADER | FORMAT 0 'lost %u' | EVENT 0 4 0 0 0 | "));
+    EXPECT_EQ(s.size() - strlen("LOST 4"), s.rfind("LOST 4"));
+}
+
+}  // namespace RAMCloud
@@ -26,6 +26,7 @@
 #include "Exception.h"
 
 namespace RAMCloud {
+class DispatchThread;
 class ServiceLocator;
 
 /**
@@ -74,6 +75,10 @@ class Transport {
             , replyPayload()
             , epoch(0)
             , activities(~0)
+            , arrivalTime(0)
+            , firstPacketTime(0)
+            , traceId(0)
+            , dispatchThread(NULL)
             , outstandingRpcListHook()
         {}
 
@@ -152,6 +157,33 @@ class Transport {
         static const int READ_ACTIVITY = 1;
         static const int APPEND_ACTIVITY = 2;
 
+        /**
+         * Cycles::rdtsc time when the WorkerManager received this RPC; used
+         * to measure its latency (see RpcLatency).
+         */
+        uint64_t arrivalTime;
+
+        /**
+         * Cycles::rdtsc time when the first packet of the request arrived at
+         * this machine (see Driver::Received::arrivalTime), or 0 if the
+         * transport or driver doesn't know.
+         */
+        uint64_t firstPacketTime;
+
+        /**
+         * Trace id of this RPC's request (see RpcTrace), or 0 if it
+         * isn't traced.
+         */
+        uint64_t traceId;
+
+        /**
+         * If the RPC arrived on a transport polled by one of the server's
+         * additional dispatch threads, that thread; its reply must be sent
+         * from there (see DispatchThread::sendReply). NULL means the RPC
+         * belongs to the main dispatch thread.
+         */
+        DispatchThread* dispatchThread;
+
         /**
          * Hook for the list of active server RPCs that the ServerRpcPool class
          * maintains. RPCs are added when ServerRpc-derived classes are
@@ -97,10 +97,15 @@ bench(RamCloud& client,
     cerr << "Latency: "
          << double(ns / 1000) / double(readCount)
          << " us/read"  << endl;
+    // Each read is one request packet and one response packet for objects
+    // that fit in a packet, so this is also the packet rate per direction.
+    double readsPerSecond = double(readCount) * 1e09 / double(ns);
+    cerr << "Rate: " << readsPerSecond / 1000 << " kreads/s" << endl;
 
     cerr << "METRICS: "
           << "{'ns': " << ns << ", 'count': " << count << ","
-          << " 'size': " << size << "}"
+          << " 'size': " << size << ", 'readsPerSecond': "
+          << readsPerSecond << "}"
           << endl;
 }
 
@@ -14,6 +14,8 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <algorithm>
+
 #include "BasicTransport.h"
 #include "CycleCounter.h"
 #include "ShortMacros.h"
@@ -24,6 +26,8 @@
 #include "FastTransport.h"
 #include "UdpDriver.h"
 #include "FailSession.h"
+#include "ProxySession.h"
+#include "ShmDriver.h"
 #include "WorkerManager.h"
 #include "WorkerSession.h"
 
@@ -40,6 +44,10 @@
 #include "DpdkDriver.h"
 #endif
 
+#ifdef XDP
+#include "XdpDriver.h"
+#endif
+
 namespace RAMCloud {
 
 static struct TcpTransportFactory : public TransportFactory {
@@ -72,6 +80,17 @@ static struct FastUdpTransportFactory : public TransportFactory {
     }
 } fastUdpTransportFactory;
 
+static struct BasicShmTransportFactory : public TransportFactory {
+    BasicShmTransportFactory()
+        : TransportFactory("basic+shm", "basic+shm") {}
+    Transport* createTransport(Context* context,
+            const ServiceLocator* localServiceLocator) {
+        return new BasicTransport(context, localServiceLocator,
+                new ShmDriver(context, localServiceLocator),
+                generateRandom());
+    }
+} basicShmTransportFactory;
+
 #ifdef ONLOAD
 static struct BasicSolarFlareTransportFactory : public TransportFactory {
     BasicSolarFlareTransportFactory()
@@ -160,6 +179,19 @@ static struct FastDpdkTransportFactory : public TransportFactory {
 } fastDpdkTransportFactory;
 #endif
 
+#ifdef XDP
+static struct BasicXdpTransportFactory : public TransportFactory {
+    BasicXdpTransportFactory()
+        : TransportFactory("basic+xdp", "basic+xdp") {}
+    Transport* createTransport(Context* context,
+            const ServiceLocator* localServiceLocator) {
+        return new BasicTransport(context, localServiceLocator,
+                new XdpDriver(context, localServiceLocator),
+                generateRandom());
+    }
+} basicXdpTransportFactory;
+#endif
+
 TransportManager::TransportManager(Context* context)
     : context(context)
     , isServer(false)
@@ -169,13 +201,16 @@ TransportManager::TransportManager(Context* context)
     , sessionCache()
     , registeredBases()
     , registeredSizes()
+    , peers()
     , mutex("TransportManager::mutex")
     , sessionTimeoutMs(0)
     , mockRegistrations(0)
+    , proxyLocator()
 {
     transportFactories.push_back(&tcpTransportFactory);
     transportFactories.push_back(&basicUdpTransportFactory);
     transportFactories.push_back(&fastUdpTransportFactory);
+    transportFactories.push_back(&basicShmTransportFactory);
 #ifdef ONLOAD
     transportFactories.push_back(&basicSolarFlareTransportFactory);
     transportFactories.push_back(&fastSolarFlareTransportFactory);
@@ -189,6 +224,9 @@ TransportManager::TransportManager(Context* context)
 #ifdef DPDK
     transportFactories.push_back(&basicDpdkTransportFactory);
     transportFactories.push_back(&fastDpdkTransportFactory);
+#endif
+#ifdef XDP
+    transportFactories.push_back(&basicXdpTransportFactory);
 #endif
     transports.resize(transportFactories.size(), NULL);
 }
@@ -208,6 +246,27 @@ TransportManager::~TransportManager()
         delete transport;
 }
 
+/**
+ * Arrange for all memory registered with this object (see #registerMemory),
+ * both before and after this call, to also be registered with another
+ * TransportManager. This is used when a server's listening transports are
+ * spread over several contexts, each with its own dispatch thread (see
+ * DispatchThread), so that all of them can transmit directly from the
+ * server's log memory.
+ *
+ * \param peer
+ *      TransportManager whose transports serve the same server. It must
+ *      remain valid until it is passed to #removePeer.
+ */
+void
+TransportManager::addPeer(TransportManager* peer)
+{
+    Dispatch::Lock lock(context->dispatch);
+    peers.push_back(peer);
+    for (uint32_t i = 0; i < registeredBases.size(); i++)
+        peer->registerMemory(registeredBases[i], registeredSizes[i]);
+}
+
 /**
  * This method is invoked only on servers; it creates transport(s) that will be
  * used to receive RPC requests.  These transports can also be used for outgoing
@@ -400,6 +459,13 @@ TransportManager::openSession(const string& serviceLocator)
 Transport::SessionRef
 TransportManager::openSessionInternal(const string& serviceLocator)
 {
+    if (!proxyLocator.empty() && (serviceLocator != proxyLocator)) {
+        // Each ProxySession has its own session to the proxy; these are
+        // cheap, since the proxy is normally on the same host.
+        return new ProxySession(openSessionInternal(proxyLocator),
+                serviceLocator);
+    }
+
     CycleCounter<RawMetric> _(&metrics->transport.sessionOpenTicks);
     // Collects error messages from all the transports that tried to
     // open a session from this locator.
@@ -409,6 +475,24 @@ TransportManager::openSessionInternal(const string& serviceLocator)
     // can handle its protocol.
     vector<ServiceLocator> locators =
             ServiceLocator::parseServiceLocators(serviceLocator);
+
+    // A server with several dispatch threads may listen on several
+    // locators with the same protocol (one per thread, see DispatchThread);
+    // start with a random one of them, so that clients spread themselves
+    // over the server's dispatch threads.
+    size_t sameProtocol = 1;
+    while ((sameProtocol < locators.size()) &&
+            (locators[sameProtocol].getProtocol() ==
+            locators[0].getProtocol())) {
+        sameProtocol++;
+    }
+    if (sameProtocol > 1) {
+        std::rotate(locators.begin(),
+                locators.begin() + downCast<int>(
+                generateRandom() % sameProtocol),
+                locators.begin() + downCast<int>(sameProtocol));
+    }
+
     foreach (ServiceLocator& locator, locators) {
         for (uint32_t i = 0; i < transportFactories.size(); i++) {
             TransportFactory* factory = transportFactories[i];
@@ -479,6 +563,21 @@ TransportManager::registerMemory(void* base, size_t bytes)
     }
     registeredBases.push_back(base);
     registeredSizes.push_back(bytes);
+    foreach (TransportManager* peer, peers)
+        peer->registerMemory(base, bytes);
+}
+
+/**
+ * Forget a TransportManager passed to an earlier call to #addPeer.
+ *
+ * \param peer
+ *      TransportManager to forget; nothing happens if it isn't a peer.
+ */
+void
+TransportManager::removePeer(TransportManager* peer)
+{
+    Dispatch::Lock lock(context->dispatch);
+    peers.erase(std::remove(peers.begin(), peers.end(), peer), peers.end());
 }
 
 /**
@@ -501,6 +600,48 @@ uint32_t TransportManager::getSessionTimeout() const
     return sessionTimeoutMs;
 }
 
+/**
+ * Prepare a client's TransportManager to be used by several threads, with a
+ * separate thread polling the dispatcher (see RamCloud::enableMultiThreading).
+ * From now on this object is locked, and the sessions it returns hand their
+ * requests to the dispatch thread. Sessions cached before the call are
+ * dropped, so callers should also flush any sessions they hold.
+ */
+void
+TransportManager::setMultiThreaded()
+{
+    std::lock_guard<SpinLock> lock(mutex);
+    isServer = true;
+    sessionCache.clear();
+}
+
+/**
+ * Send requests through a proxy from now on: the sessions returned later
+ * (except those to the proxy itself) are ProxySessions, which ask the
+ * proxy to forward each request to its server over the proxy's own
+ * sessions. This is meant for clients: when all of the client processes
+ * on a host use the same proxy, servers keep per-session state for the
+ * host rather than for each process. Sessions cached before the call are
+ * dropped, so callers should also flush any sessions they hold.
+ *
+ * \param locator
+ *      Service locator of the proxy: any RAMCloud server (normally one
+ *      running only the ping service, on the same host). An empty string
+ *      means send requests directly again.
+ */
+void
+TransportManager::setProxy(const string& locator)
+{
+    // If we're running on a server (i.e., multithreaded) must exclude
+    // other threads.
+    Tub<std::lock_guard<SpinLock>> lock;
+    if (isServer) {
+        lock.construct(mutex);
+    }
+    proxyLocator = locator;
+    sessionCache.clear();
+}
+
 /**
  * Calls dumpStats() on all existing transports.
  */
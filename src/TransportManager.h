@@ -46,16 +46,20 @@ class TransportManager {
   public:
     explicit TransportManager(Context* context);
     ~TransportManager();
+    void addPeer(TransportManager* peer);
     void initialize(const char* serviceLocator);
     void flushSession(const string& serviceLocator);
     Transport::SessionRef getSession(const string& serviceLocator);
     string getListeningLocatorsString();
     Transport::SessionRef openSession(const string& serviceLocator);
     void registerMemory(void* base, size_t bytes);
+    void removePeer(TransportManager* peer);
     void dumpStats();
     void dumpTransportFactories();
     void setSessionTimeout(uint32_t timeoutMs);
     uint32_t getSessionTimeout() const;
+    void setMultiThreaded();
+    void setProxy(const string& locator);
 
 #if TESTING
     /**
@@ -111,7 +115,10 @@ class TransportManager {
     Context* context;
 
     /**
-     * True means this is a server application, false means this is a client only.
+     * True means this is a server application (or a client that has called
+     * #setMultiThreaded), false means this is a single-threaded client.
+     * When true, this object is locked and sessions are wrapped in
+     * WorkerSessions so that they can be used from any thread.
      */
     bool isServer;
 
@@ -155,6 +162,13 @@ class TransportManager {
     std::vector<void*> registeredBases;
     std::vector<size_t> registeredSizes;
 
+    /**
+     * Other TransportManagers whose transports serve the same server (see
+     * addPeer); memory registered with this object is also registered
+     * with them.
+     */
+    std::vector<TransportManager*> peers;
+
     /**
      * Used for mutual exclusion in multi-threaded environments.
      */
@@ -173,6 +187,12 @@ class TransportManager {
      */
     uint32_t mockRegistrations;
 
+    /**
+     * Service locator of the proxy through which requests are sent (see
+     * setProxy), or empty if requests are sent directly.
+     */
+    string proxyLocator;
+
     DISALLOW_COPY_AND_ASSIGN(TransportManager);
 };
 
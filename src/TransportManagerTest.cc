@@ -14,12 +14,15 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <set>
+
 #include "TestUtil.h"
 #include "BindTransport.h"
 #include "FailSession.h"
 #include "MembershipService.h"
 #include "MockTransportFactory.h"
 #include "MockTransport.h"
+#include "ProxySession.h"
 #include "ServerList.h"
 #include "TransportManager.h"
 
@@ -167,6 +170,24 @@ TEST_F(TransportManagerTest, getSession_createWorkerSession) {
     EXPECT_EQ("WorkerSession: created", TestLog::get());
 }
 
+TEST_F(TransportManagerTest, openSessionInternal_spreadSameProtocol) {
+    manager.registerMock(NULL);
+    std::set<string> used;
+    for (int i = 0; (i < 1000) && (used.size() < 2); i++) {
+        Transport::SessionRef session =
+                manager.openSession("mock:host=a;mock:host=b");
+        used.insert(session->getServiceLocator());
+    }
+    EXPECT_EQ(2U, used.size());
+
+    // Locators with a different protocol are only fallbacks, as before.
+    for (int i = 0; i < 20; i++) {
+        Transport::SessionRef session =
+                manager.openSession("mock:host=a;foo:");
+        EXPECT_EQ("mock:host=a", session->getServiceLocator());
+    }
+}
+
 TEST_F(TransportManagerTest, getSession_openSessionFailure) {
     TestLog::Enable _;
     manager.registerMock(NULL);
@@ -233,6 +254,20 @@ TEST_F(TransportManagerTest, openSession_succeedAfterFailure) {
     EXPECT_EQ("m2:host=ok", session->getServiceLocator());
 }
 
+TEST_F(TransportManagerTest, openSession_proxy) {
+    manager.registerMock(NULL);
+    manager.setProxy("mock:host=proxy");
+    Transport::SessionRef session(manager.openSession("mock:host=server"));
+    ProxySession* proxySession = dynamic_cast<ProxySession*>(session.get());
+    ASSERT_TRUE(proxySession != NULL);
+    EXPECT_EQ("mock:host=server", proxySession->getServiceLocator());
+    EXPECT_EQ("mock:host=proxy", proxySession->proxy->getServiceLocator());
+
+    // Sessions to the proxy itself are direct.
+    Transport::SessionRef session2(manager.openSession("mock:host=proxy"));
+    EXPECT_TRUE(dynamic_cast<ProxySession*>(session2.get()) == NULL);
+}
+
 TEST_F(TransportManagerTest, registerMemory) {
     TestLog::Enable _;
     ServiceLocator s1("mock1:");
@@ -257,4 +292,17 @@ TEST_F(TransportManagerTest, registerMemory) {
               TestLog::get());
 }
 
+TEST_F(TransportManagerTest, setProxy) {
+    manager.registerMock(NULL);
+    Transport::SessionRef session(manager.getSession("mock:host=server"));
+    manager.setProxy("mock:host=proxy");
+    Transport::SessionRef session2(manager.getSession("mock:host=server"));
+    EXPECT_TRUE(session.get() != session2.get());
+    EXPECT_TRUE(dynamic_cast<ProxySession*>(session2.get()) != NULL);
+
+    manager.setProxy("");
+    Transport::SessionRef session3(manager.getSession("mock:host=server"));
+    EXPECT_TRUE(dynamic_cast<ProxySession*>(session3.get()) == NULL);
+}
+
 }  // namespace RAMCloud
@@ -275,7 +275,10 @@ void
 TxRecoveryManager::RecoveryTask::performTask()
 {
     if (state == State::REQUEST_ABORT) {
-        sendRequestAbortRpc();
+        while (nextParticipantEntry != participants.end()
+               && requestAbortRpcs.size() < MAX_OUTSTANDING_RPCS) {
+            sendRequestAbortRpc();
+        }
         try {
             processRequestAbortRpcResults();
         } catch (StaleRpcException& e) {
@@ -319,13 +322,16 @@ TxRecoveryManager::RecoveryTask::performTask()
         }
     }
     if (state == State::DECIDE) {
-        sendDecisionRpc();
+        while (nextParticipantEntry != participants.end()
+               && decisionRpcs.size() < MAX_OUTSTANDING_RPCS) {
+            sendDecisionRpc();
+        }
         processDecisionRpcResults();
         if (nextParticipantEntry == participants.end()
-            && requestAbortRpcs.empty())
+            && decisionRpcs.empty())
         {
-            // Done with the request abort phase.
-            // Change state to cause next phase to execute.
+            // Done with the decision phase; every participant has been
+            // informed of the decision.
             state = State::DONE;
         }
     }
@@ -366,7 +372,7 @@ void
 TxRecoveryManager::RecoveryTask::TxRecoveryRpcWrapper::send()
 {
     state = IN_PROGRESS;
-    session->sendRequest(&request, response, this);
+    sendRequest();
 }
 
 /**
@@ -516,10 +522,11 @@ TxRecoveryManager::RecoveryTask::processDecisionRpcResults()
 {
     // Process outstanding RPCs.
     std::list<DecisionRpc>::iterator it = decisionRpcs.begin();
-    for (; it != decisionRpcs.end(); it++) {
+    while (it != decisionRpcs.end()) {
         DecisionRpc* rpc = &(*it);
 
         if (!rpc->isReady()) {
+            it++;
             continue;
         }
 
@@ -669,10 +676,11 @@ TxRecoveryManager::RecoveryTask::processRequestAbortRpcResults()
 {
     // Process outstanding RPCs.
     std::list<RequestAbortRpc>::iterator it = requestAbortRpcs.begin();
-    for (; it != requestAbortRpcs.end(); it++) {
+    while (it != requestAbortRpcs.end()) {
         RequestAbortRpc* rpc = &(*it);
 
         if (!rpc->isReady()) {
+            it++;
             continue;
         }
 
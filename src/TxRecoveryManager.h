@@ -209,6 +209,14 @@ class TxRecoveryManager : public WorkerTimer {
         /// Iterator into the participant list used to keep track of how much
         /// process has been made.
         ParticipantList::iterator nextParticipantEntry;
+        /// The most rpcs of each kind (request abort or decision) that this
+        /// task keeps outstanding at once; participants on different masters
+        /// are contacted in parallel, up to this limit.
+#ifdef TESTING
+        static const uint32_t MAX_OUTSTANDING_RPCS = 2;
+#else
+        static const uint32_t MAX_OUTSTANDING_RPCS = 20;
+#endif
         /// List of outstanding decision rpcs.
         std::list<DecisionRpc> decisionRpcs;
         /// List of outstanding request abort rpcs.
@@ -205,21 +205,17 @@ TEST_F(TxRecoveryManagerTest, handleTimerEvent_basic) {
 
     EXPECT_EQ(2U, txRecoveryManager.recoveries.size());
 
+    // Each task sends all of its (at most 2) rpcs per phase at once, so
+    // both finish during the first pass.
     txRecoveryManager.handleTimerEvent();
     EXPECT_TRUE(txRecoveryManager.isRunning());
     txRecoveryManager.stop();
+    EXPECT_EQ(TxRecoveryManager::RecoveryTask::DONE,
+              txRecoveryManager.recoveries.front().state);
+    EXPECT_EQ(TxRecoveryManager::RecoveryTask::DONE,
+              txRecoveryManager.recoveries.back().state);
     EXPECT_EQ(2U, txRecoveryManager.recoveries.size());
 
-    txRecoveryManager.handleTimerEvent();
-    EXPECT_TRUE(txRecoveryManager.isRunning());
-    txRecoveryManager.stop();
-    EXPECT_EQ(1U, txRecoveryManager.recoveries.size());
-
-    txRecoveryManager.handleTimerEvent();
-    EXPECT_TRUE(txRecoveryManager.isRunning());
-    txRecoveryManager.stop();
-    EXPECT_EQ(1U, txRecoveryManager.recoveries.size());
-
     txRecoveryManager.handleTimerEvent();
     EXPECT_FALSE(txRecoveryManager.isRunning());
     EXPECT_EQ(0U, txRecoveryManager.recoveries.size());
@@ -398,20 +394,14 @@ TEST_F(TxRecoveryManagerTest, RecoveryTask_performTask_basic) {
     fillPList();
 
     EXPECT_EQ(TxRecoveryManager::RecoveryTask::REQUEST_ABORT, task->state);
-    task->performTask();        // RPC 1 Sent, RPC 1 Processed
-    EXPECT_EQ(TxRecoveryManager::RecoveryTask::REQUEST_ABORT, task->state);
-    task->performTask();        // RPC 2 Sent, RPC 2 Processed
+    task->performTask();        // RPC 1-2 Sent, RPC 1-2 Processed
     EXPECT_EQ(TxRecoveryManager::RecoveryTask::REQUEST_ABORT, task->state);
-    task->performTask();        // RPC 3 Sent, RPC 3 Processed
-    EXPECT_EQ(TxRecoveryManager::RecoveryTask::REQUEST_ABORT, task->state);
-    task->performTask();        // RPC 4 Sent, RPC 4 Processed
-                                // RPC 1 Sent, RPC 1 Processed
-    EXPECT_EQ(TxRecoveryManager::RecoveryTask::DECIDE, task->state);
-    task->performTask();        // RPC 2 Sent, RPC 2 Processed
-    EXPECT_EQ(TxRecoveryManager::RecoveryTask::DECIDE, task->state);
-    task->performTask();        // RPC 3 Sent, RPC 3 Processed
+    EXPECT_EQ(0U, task->requestAbortRpcs.size());
+    task->performTask();        // RPC 3-4 Sent, RPC 3-4 Processed
+                                // RPC 1-2 Sent, RPC 1-2 Processed
     EXPECT_EQ(TxRecoveryManager::RecoveryTask::DECIDE, task->state);
-    task->performTask();        // RPC 4 Sent, RPC 4 Processed
+    EXPECT_EQ(0U, task->decisionRpcs.size());
+    task->performTask();        // RPC 3-4 Sent, RPC 3-4 Processed
     EXPECT_EQ(TxRecoveryManager::RecoveryTask::DONE, task->state);
     task->performTask();
     EXPECT_EQ(TxRecoveryManager::RecoveryTask::DONE, task->state);
@@ -428,11 +418,9 @@ TEST_F(TxRecoveryManagerTest, RecoveryTask_performTask_abortEarly) {
     fillPList();
 
     EXPECT_EQ(TxRecoveryManager::RecoveryTask::REQUEST_ABORT, task->state);
-    task->performTask();        // RPC 1 Sent, RPC 1 Processed
-    EXPECT_EQ(TxRecoveryManager::RecoveryTask::REQUEST_ABORT, task->state);
-    task->performTask();        // RPC 2 Sent, RPC 2 Processed
+    task->performTask();        // RPC 1-2 Sent, RPC 1-2 Processed
     EXPECT_EQ(TxRecoveryManager::RecoveryTask::REQUEST_ABORT, task->state);
-    task->performTask();        // RPC 3 Sent, RPC 3 Rejected
+    task->performTask();        // RPC 3-4 Sent, RPC 3 Rejected
     EXPECT_EQ(TxRecoveryManager::RecoveryTask::DONE, task->state);
     task->performTask();
     EXPECT_EQ(TxRecoveryManager::RecoveryTask::DONE, task->state);
@@ -14,12 +14,16 @@
  */
 
 #include <errno.h>
+#include <time.h>
 #include <arpa/inet.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
 #include <netinet/in.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 
 #include "Common.h"
+#include "Cycles.h"
 #include "ShortMacros.h"
 #include "UdpDriver.h"
 #include "ServiceLocator.h"
@@ -82,6 +86,14 @@ UdpDriver::UdpDriver(Context* context,
         }
     }
 
+    // Ask the kernel to timestamp incoming packets, from the NIC's clock
+    // if the interface has hardware timestamping enabled (see
+    // getArrivalTime). Without timestamps packets just have no
+    // arrival time, so errors are ignored.
+    int flags = SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE
+            | SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+    sys->setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags));
+
     socketFd = fd;
 }
 
@@ -91,6 +103,7 @@ UdpDriver::UdpDriver(Context* context,
  */
 UdpDriver::~UdpDriver()
 {
+    releaseDeferred();
     if (packetBufsUtilized != 0)
         LOG(ERROR, "UdpDriver deleted with %d packets still in use",
             packetBufsUtilized);
@@ -128,6 +141,60 @@ UdpDriver::disconnect()
     this->incomingPacketHandler.reset();
 }
 
+/**
+ * Find out when a packet arrived at this machine from the timestamps the
+ * kernel attached to it.
+ *
+ * \param header
+ *      The packet's header, as returned by recvmmsg (including control
+ *      messages).
+ * \param now
+ *      The current time (CLOCK_REALTIME).
+ * \param nowCycles
+ *      Cycles::rdtsc() at the time of  now.
+ * 
+eturn
+ *      The Cycles::rdtsc() time when the packet arrived, or 0 if it has no
+ *      usable timestamp. The NIC's hardware timestamp is used if there is
+ *      one; it is only meaningful if the NIC's clock is synchronized with
+ *      the system clock (for example by phc2sys), so it is ignored if it
+ *      isn't in the last second. Otherwise the kernel's software timestamp,
+ *      taken when the packet came up from the device driver, is used.
+ */
+uint64_t
+UdpDriver::getArrivalTime(struct msghdr* header, const struct timespec* now,
+        uint64_t nowCycles)
+{
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(header); cmsg != NULL;
+            cmsg = CMSG_NXTHDR(header, cmsg)) {
+        if ((cmsg->cmsg_level != SOL_SOCKET) ||
+                (cmsg->cmsg_type != SCM_TIMESTAMPING)) {
+            continue;
+        }
+        const struct scm_timestamping* stamps =
+                reinterpret_cast<const struct scm_timestamping*>(
+                CMSG_DATA(cmsg));
+        int64_t nowNs = now->tv_sec * 1000000000L + now->tv_nsec;
+
+        // ts[2] holds the hardware timestamp and ts[0] the software one.
+        for (int i = 2; i >= 0; i -= 2) {
+            const struct timespec* ts = &stamps->ts[i];
+            int64_t ns = ts->tv_sec * 1000000000L + ts->tv_nsec;
+            if (ns == 0) {
+                continue;
+            }
+            int64_t delay = nowNs - ns;
+            if ((delay < 0) || (delay >= 1000000000L)) {
+                continue;
+            }
+            uint64_t cycles = Cycles::fromNanoseconds(
+                    static_cast<uint64_t>(delay));
+            return (cycles < nowCycles) ? nowCycles - cycles : 0;
+        }
+    }
+    return 0;
+}
+
 // See docs in Driver class.
 uint32_t
 UdpDriver::getMaxPacketSize()
@@ -138,17 +205,31 @@ UdpDriver::getMaxPacketSize()
 // See docs in Driver class.
 void
 UdpDriver::release(char *payload)
+{
+    // Packets released in workers are returned in batches by the dispatch
+    // thread.
+    if (deferRelease(context->dispatch, payload)) {
+        return;
+    }
+    releaseBatch(&payload, 1);
+}
+
+// See docs in Driver class.
+void
+UdpDriver::releaseBatch(char** payloads, uint32_t count)
 {
     // Must sync with the dispatch thread, since this method could potentially
     // be invoked in a worker.
     Dispatch::Lock _(context->dispatch);
 
-    // Note: the payload is actually contained in a PacketBuf structure,
+    // Note: each payload is actually contained in a PacketBuf structure,
     // which we return to a pool for reuse later.
-    packetBufsUtilized--;
-    assert(packetBufsUtilized >= 0);
-    packetBufPool.destroy(
-        reinterpret_cast<PacketBuf*>(payload - OFFSET_OF(PacketBuf, payload)));
+    for (uint32_t i = 0; i < count; i++) {
+        packetBufsUtilized--;
+        assert(packetBufsUtilized >= 0);
+        packetBufPool.destroy(reinterpret_cast<PacketBuf*>(
+                payloads[i] - OFFSET_OF(PacketBuf, payload)));
+    }
 }
 
 // See docs in Driver class.
@@ -208,33 +289,70 @@ UdpDriver::sendPacket(const Address *addr,
 void
 UdpDriver::ReadHandler::handleFileEvent(int events)
 {
-    PacketBuf* buffer;
-    // Each iteration through the following loop receives one
-    // incoming packet. Note: reading multiple packets in each call
-    // to this method improves throughput under load by 50%.
+    PacketBuf* buffers[MAX_RX_BURST];
+    struct mmsghdr messages[MAX_RX_BURST];
+    struct iovec iovecs[MAX_RX_BURST];
+    char controls[MAX_RX_BURST][CMSG_SPACE(sizeof(struct scm_timestamping))];
+
+    driver->releaseDeferred();
+
+    // Each iteration through the following loop receives a burst of up
+    // to MAX_RX_BURST incoming packets with a single recvmmsg call.
+    // Note: reading multiple packets in each call to this method improves
+    // throughput under load by 50%, and batching the system call amortizes
+    // the kernel crossing across the whole burst.
     while (1) {
-        buffer = driver->packetBufPool.construct();
-        socklen_t addrlen = sizeof(buffer->ipAddress.address);
-        ssize_t r = sys->recvfrom(driver->socketFd, buffer->payload,
-                                  MAX_PAYLOAD_SIZE,
-                                  MSG_DONTWAIT,
-                                  &buffer->ipAddress.address, &addrlen);
+        for (uint32_t i = 0; i < MAX_RX_BURST; i++) {
+            buffers[i] = driver->packetBufPool.construct();
+            iovecs[i].iov_base = buffers[i]->payload;
+            iovecs[i].iov_len = MAX_PAYLOAD_SIZE;
+            memset(&messages[i], 0, sizeof(messages[i]));
+            messages[i].msg_hdr.msg_iov = &iovecs[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+            messages[i].msg_hdr.msg_name = &buffers[i]->ipAddress.address;
+            messages[i].msg_hdr.msg_namelen =
+                    sizeof(buffers[i]->ipAddress.address);
+            messages[i].msg_hdr.msg_control = controls[i];
+            messages[i].msg_hdr.msg_controllen = sizeof(controls[i]);
+        }
+        int r = sys->recvmmsg(driver->socketFd, messages, MAX_RX_BURST,
+                              MSG_DONTWAIT, NULL);
+        uint32_t count = (r > 0) ? downCast<uint32_t>(r) : 0;
+
+        // Return any buffers that weren't filled before handing the
+        // received packets to the transport (the transport may close
+        // the driver from within handlePacket).
+        for (uint32_t i = count; i < MAX_RX_BURST; i++) {
+            driver->packetBufPool.destroy(buffers[i]);
+        }
         if (r == -1) {
-            driver->packetBufPool.destroy(buffer);
             if (errno == EAGAIN || errno == EWOULDBLOCK)
                 return;
             LOG(WARNING, "UdpDriver error receiving from socket: %s",
                     strerror(errno));
             return;
         }
-        Received received;
-        received.len = downCast<uint32_t>(r);
-
-        driver->packetBufsUtilized++;
-        received.payload = buffer->payload;
-        received.sender = &buffer->ipAddress;
-        received.driver = driver;
-        driver->incomingPacketHandler->handlePacket(&received);
+
+        struct timespec now = {0, 0};
+        uint64_t nowCycles = 0;
+        if (count > 0) {
+            clock_gettime(CLOCK_REALTIME, &now);
+            nowCycles = Cycles::rdtsc();
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            Received received;
+            received.len = messages[i].msg_len;
+            received.arrivalTime = getArrivalTime(&messages[i].msg_hdr,
+                    &now, nowCycles);
+
+            driver->packetBufsUtilized++;
+            received.payload = buffers[i]->payload;
+            received.sender = &buffers[i]->ipAddress;
+            received.driver = driver;
+            driver->incomingPacketHandler->handlePacket(&received);
+        }
+        if (count < MAX_RX_BURST)
+            return;
     }
 }
 
@@ -35,6 +35,10 @@ class UdpDriver : public Driver {
     /// The maximum number bytes we can stuff in a UDP packet payload.
     static const uint32_t MAX_PAYLOAD_SIZE = 1400;
 
+    /// The maximum number of packets read from the socket with a single
+    /// recvmmsg system call.
+    static const uint32_t MAX_RX_BURST = 16;
+
     explicit UdpDriver(Context* context,
                        const ServiceLocator* localServiceLocator = NULL);
     virtual ~UdpDriver();
@@ -43,11 +47,14 @@ class UdpDriver : public Driver {
     virtual void disconnect();
     virtual uint32_t getMaxPacketSize();
     virtual void release(char *payload);
+    virtual void releaseBatch(char** payloads, uint32_t count);
     virtual void sendPacket(const Address *addr,
                             const void *header,
                             uint32_t headerLen,
                             Buffer::Iterator *payload);
     virtual string getServiceLocator();
+    static uint64_t getArrivalTime(struct msghdr* header,
+            const struct timespec* now, uint64_t nowCycles);
 
     virtual Address* newAddress(const ServiceLocator* serviceLocator) {
         return new IpAddress(serviceLocator);
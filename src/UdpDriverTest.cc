@@ -13,7 +13,11 @@
  * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <thread>
+#include <linux/errqueue.h>
+
 #include "TestUtil.h"
+#include "Cycles.h"
 #include "MockFastTransport.h"
 #include "MockSyscall.h"
 #include "Tub.h"
@@ -182,6 +186,32 @@ TEST_F(UdpDriverTest, close_deleteReadHandler) {
     EXPECT_FALSE(server->readHandler);
 }
 
+static void
+releaseInThread(Driver* driver, char* payload)
+{
+    driver->release(payload);
+}
+
+TEST_F(UdpDriverTest, release_deferredInWorker) {
+    char* payloads[2];
+    for (int i = 0; i < 2; i++) {
+        payloads[i] = server->packetBufPool.construct()->payload;
+        server->packetBufsUtilized++;
+    }
+
+    // Packets released outside the dispatch thread wait for the next
+    // poll; those released in the dispatch thread are freed at once.
+    std::thread thread(releaseInThread, server, payloads[0]);
+    thread.join();
+    EXPECT_EQ(2, server->packetBufsUtilized);
+    server->release(payloads[1]);
+    EXPECT_EQ(1, server->packetBufsUtilized);
+    server->readHandler->handleFileEvent(
+            Dispatch::FileEvent::READABLE);
+    EXPECT_EQ(0, server->packetBufsUtilized);
+    EXPECT_EQ(0U, server->packetBufPool.outstandingObjects);
+}
+
 TEST_F(UdpDriverTest, sendPacket_alreadyClosed) {
     sys->sendmsgErrno = EPERM;
     Buffer message;
@@ -230,7 +260,7 @@ TEST_F(UdpDriverTest, sendPacket_errorInSend) {
 }
 
 TEST_F(UdpDriverTest, ReadHandler_errorInRecv) {
-    sys->recvfromErrno = EPERM;
+    sys->recvmmsgErrno = EPERM;
     Driver::Received received;
     server->readHandler->handleFileEvent(
             Dispatch::FileEvent::READABLE);
@@ -253,4 +283,58 @@ TEST_F(UdpDriverTest, ReadHandler_multiplePackets) {
     EXPECT_STREQ("no packet arrived", receivePacket(serverTransport));
 }
 
+TEST_F(UdpDriverTest, ReadHandler_arrivalTime) {
+    uint64_t before = Cycles::rdtsc();
+    sendMessage(client, serverAddress, "header:", "first");
+    EXPECT_STREQ("header:first", receivePacket(serverTransport));
+    EXPECT_LE(before, serverTransport->arrivalTime);
+    EXPECT_GE(Cycles::rdtsc(), serverTransport->arrivalTime);
+}
+
+TEST_F(UdpDriverTest, getArrivalTime) {
+    char control[CMSG_SPACE(sizeof(struct scm_timestamping))];
+    struct msghdr header;
+    memset(&header, 0, sizeof(header));
+    memset(control, 0, sizeof(control));
+    header.msg_control = control;
+    header.msg_controllen = sizeof(control);
+    struct timespec now = {1000, 500000000};
+    Cycles::mockCyclesPerSec = 1e09;
+
+    // No timestamps.
+    EXPECT_EQ(0U, UdpDriver::getArrivalTime(&header, &now, 10000000));
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&header);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_TIMESTAMPING;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(struct scm_timestamping));
+    struct scm_timestamping* stamps =
+            reinterpret_cast<struct scm_timestamping*>(CMSG_DATA(cmsg));
+
+    // Software timestamp only.
+    stamps->ts[0] = {1000, 499000000};
+    EXPECT_EQ(9000000U, UdpDriver::getArrivalTime(&header, &now, 10000000));
+
+    // The hardware timestamp is preferred.
+    stamps->ts[2] = {1000, 499990000};
+    EXPECT_EQ(9990000U, UdpDriver::getArrivalTime(&header, &now, 10000000));
+
+    // ... unless the NIC's clock is clearly not the system's.
+    stamps->ts[2] = {5, 0};
+    EXPECT_EQ(9000000U, UdpDriver::getArrivalTime(&header, &now, 10000000));
+    Cycles::mockCyclesPerSec = 0;
+}
+
+TEST_F(UdpDriverTest, ReadHandler_multipleBursts) {
+    for (uint32_t i = 0; i < UdpDriver::MAX_RX_BURST + 2; i++) {
+        sendMessage(client, serverAddress, "h:", format("%u", i).c_str());
+    }
+    server->readHandler->handleFileEvent(
+            Dispatch::FileEvent::READABLE);
+    EXPECT_EQ("h:0, h:1, h:2, h:3, h:4, h:5, h:6, h:7, h:8, h:9, h:10, "
+            "h:11, h:12, h:13, h:14, h:15, h:16, h:17",
+            serverTransport->packetData);
+    EXPECT_EQ(0U, server->packetBufPool.outstandingObjects);
+}
+
 }  // namespace RAMCloud
@@ -13,6 +13,8 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <algorithm>
+
 #include "UnackedRpcResults.h"
 #include "LeaseCommon.h"
 #include "MasterService.h"
@@ -165,7 +167,7 @@ UnackedRpcResults::UnackedRpcResults(Context* context,
                                      ClientLeaseValidator* leaseValidator)
     : clients(20)
     , mutex()
-    , default_rpclist_size(50)
+    , default_rpclist_size(8)
     , context(context)
     , leaseValidator(leaseValidator)
     , cleaner(this)
@@ -440,6 +442,15 @@ UnackedRpcResults::recoverRecord(uint64_t clientId,
     }
 }
 
+/**
+ * Forget an RPC that was started (by #checkDuplicate) but will not complete,
+ * so that a retry of it is processed from scratch.
+ *
+ * \param clientId
+ *      RPC sender's id.
+ * \param rpcId
+ *      Id of the RPC to forget.
+ */
 void
 UnackedRpcResults::resetRecord(uint64_t clientId, uint64_t rpcId)
 {
@@ -452,7 +463,10 @@ UnackedRpcResults::resetRecord(uint64_t clientId, uint64_t rpcId)
     } else {
         client = it->second;
     }
-    client->rpcs[rpcId % client->len].id = 0;
+    if (client->hasRecord(rpcId)) {
+        client->rpcs[rpcId % client->len].id = 0;
+        client->numRpcsInProgress--;
+    }
 }
 
 /**
@@ -516,6 +530,10 @@ UnackedRpcResults::cleanByTimeout()
                 victims.push_back(lease);
             }
         }
+
+        // Pick up where we left off next time, so that every client is
+        // eventually checked however many there are.
+        cleaner.nextClientToCheck = (it == clients.end()) ? 0 : it->first;
     }
 
     // Check with coordinator whether the lease is expired.
@@ -523,15 +541,18 @@ UnackedRpcResults::cleanByTimeout()
     ClusterTime maxClusterTime;
     for (uint32_t i = 0; i < victims.size(); ++i) {
         Lock lock(mutex);
-        if (clients[victims[i].leaseId]->numRpcsInProgress)
+        ClientMap::iterator it = clients.find(victims[i].leaseId);
+        if (it == clients.end() || it->second->numRpcsInProgress)
             continue;
 
         ClientLease lease = victims[i];
         if (leaseValidator->validate(lease, &lease)) {
-            clients[victims[i].leaseId]->leaseExpiration =
-                                            ClusterTime(lease.leaseExpiration);
+            it->second->leaseExpiration = ClusterTime(lease.leaseExpiration);
         } else {
-            clients.erase(victims[i].leaseId);
+            if (cleaner.nextClientToCheck == it->first)
+                cleaner.nextClientToCheck = 0;
+            delete it->second;
+            clients.erase(it);
         }
     }
 }
@@ -634,7 +655,9 @@ UnackedRpcResults::Client::recordNewRpc(uint64_t rpcId) {
 
 /**
  * Processes ack provided by the client. Frees log entries for RpcResult up to
- * ackId, and bumps maxAckId.
+ * ackId, and bumps maxAckId. This visits each slot of #rpcs at most once, so
+ * an ack that jumps far ahead (e.g. from a client that has been quiet for a
+ * while) costs no more than one that covers a full array.
  * \param ackId
  *      The ack number transmitted with the RPC whose id number is rpcId.
  * \param freer
@@ -644,15 +667,17 @@ UnackedRpcResults::Client::recordNewRpc(uint64_t rpcId) {
 void
 UnackedRpcResults::Client::processAck(uint64_t ackId,
                                       AbstractLog::ReferenceFreer* freer) {
-    for (uint64_t id = maxAckId + 1; id <= ackId; id++) {
-        if (rpcs[id % len].id == id) {
-            uint64_t resPtr = reinterpret_cast<uint64_t>(rpcs[id % len].result);
+    uint64_t slots = std::min(ackId - maxAckId, static_cast<uint64_t>(len));
+    for (uint64_t i = 1; i <= slots; i++) {
+        UnackedRpc* rpc = &rpcs[(maxAckId + i) % len];
+        if (rpc->id > maxAckId && rpc->id <= ackId) {
+            uint64_t resPtr = reinterpret_cast<uint64_t>(rpc->result);
             if (resPtr) {
                 Log::Reference reference(resPtr);
                 freer->freeLogEntry(reference);
             } else {
                 LOG(WARNING, "client acked unfinished RPC with "
-                             "rpcId <%" PRIu64 ">", id);
+                             "rpcId <%" PRIu64 ">", rpc->id);
             }
         }
     }
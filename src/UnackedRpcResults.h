@@ -216,6 +216,8 @@ class UnackedRpcResults {
 
     /**
      * This value is used as initial array size of each Client instance.
+     * It is small because most clients have few RPCs outstanding to any one
+     * master; the arrays of busier clients grow on demand.
      */
     int default_rpclist_size;
 
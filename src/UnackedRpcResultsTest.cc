@@ -218,13 +218,13 @@ TEST_F(UnackedRpcResultsTest, recordCompletion) {
 
     EXPECT_EQ(16UL, results.clients[1]->maxRpcId);
     //TODO(seojin): modify test after fixing RAM-716.
-    EXPECT_EQ(50, results.clients[1]->len);
+    EXPECT_EQ(results.default_rpclist_size, results.clients[1]->len);
 
     //Resized Client keeps the original data.
     results.checkDuplicate(clientLease, 17, 5, &result);
 
     //TODO(seojin): modify test after fixing RAM-716.
-    EXPECT_EQ(50, results.clients[1]->len);
+    EXPECT_EQ(results.default_rpclist_size, results.clients[1]->len);
     for (int i = 12; i <= 16; ++i) {
         EXPECT_TRUE(results.checkDuplicate(clientLease, i, 5, &result));
         EXPECT_EQ((uint64_t)(i + 1000), (uint64_t)result);
@@ -331,6 +331,7 @@ TEST_F(UnackedRpcResultsTest, cleanByTimeout) {
     results.recordCompletion(3, 10, &result);
     results.cleanByTimeout();
     EXPECT_EQ(1U, results.clients.size());
+    EXPECT_EQ(0U, results.cleaner.nextClientToCheck);
 
     EXPECT_EQ(ClusterTime(2U), service->clusterClock.getTime());
 
@@ -389,6 +390,38 @@ TEST_F(UnackedRpcResultsTest, recordNewRpc_jumResizeTest) {
     EXPECT_EQ(1010UL, (uint64_t)client->result(10));
 }
 
+TEST_F(UnackedRpcResultsTest, processAck_longJump) {
+    UnackedRpcResults::Client *client = results.clients[1];
+    uint64_t rpcId = 10 + 3 * client->len;
+    client->recordNewRpc(rpcId);
+    client->updateResult(rpcId, reinterpret_cast<void*>(1099));
+
+    // Acking far beyond the array visits each slot once.
+    TestLog::reset();
+    client->processAck(rpcId + 1000, &freer);
+    EXPECT_EQ("freeLogEntry: freed <1010> | freeLogEntry: freed <1099>",
+              TestLog::get());
+    EXPECT_EQ(rpcId + 1000, client->maxAckId);
+}
+
+TEST_F(UnackedRpcResultsTest, resetRecord) {
+    void* result;
+    ClientLease clientLease = {1, 1, 0};
+    UnackedRpcResults::Client *client = results.clients[1];
+    EXPECT_FALSE(results.checkDuplicate(clientLease, 11, 5, &result));
+    EXPECT_EQ(1, client->numRpcsInProgress);
+
+    results.resetRecord(1, 11);
+    EXPECT_FALSE(client->hasRecord(11));
+    EXPECT_EQ(0, client->numRpcsInProgress);
+
+    // Resetting again (or an unknown RPC) changes nothing.
+    results.resetRecord(1, 11);
+    results.resetRecord(1, 12);
+    results.resetRecord(99, 1);
+    EXPECT_EQ(0, client->numRpcsInProgress);
+}
+
 TEST_F(UnackedRpcResultsTest, updateResult) {
     UnackedRpcResults::Client *client = results.clients[1];
     EXPECT_EQ(1010UL, (uint64_t)client->result(10));
@@ -61,6 +61,8 @@ class UpdateReplicationEpochTask : public Task {
         , current()
         , sent()
         , requested()
+        , tabletLoad()
+        , tabletLoadChanged(false)
         , rpc()
     {}
 
@@ -98,6 +100,24 @@ class UpdateReplicationEpochTask : public Task {
         schedule();
     }
 
+    /**
+     * Send a new report of activity on this master's tablets to the
+     * coordinator along with the replication epoch (the coordinator keeps
+     * both in the master's MasterRecoveryInfo). Reports are best effort:
+     * if a newer report arrives before an older one has been sent only the
+     * newer one is sent.
+     *
+     * \param load
+     *      Its tablet_load and indexlet_load fields are sent; other fields
+     *      are ignored.
+     */
+    void updateTabletLoad(const ProtoBuf::MasterRecoveryInfo& load) {
+        tabletLoad.mutable_tablet_load()->CopyFrom(load.tablet_load());
+        tabletLoad.mutable_indexlet_load()->CopyFrom(load.indexlet_load());
+        tabletLoadChanged = true;
+        schedule();
+    }
+
     /**
      * Called by #taskQueue when it makes progress if this Task is scheduled.
      * That is, whenever a rpc needs to be sent or there is an outstanding rpc
@@ -111,16 +131,18 @@ class UpdateReplicationEpochTask : public Task {
         // present, then just skip the call.
         if (context->coordinatorSession->getLocation().empty()) {
             current = requested;
+            tabletLoadChanged = false;
             return;
         }
 #endif
         if (!rpc) {
-            if (current != requested) {
-                ProtoBuf::MasterRecoveryInfo recoveryInfo;
+            if (current != requested || tabletLoadChanged) {
+                ProtoBuf::MasterRecoveryInfo recoveryInfo(tabletLoad);
                 recoveryInfo.set_min_open_segment_id(requested.first);
                 recoveryInfo.set_min_open_segment_epoch(requested.second);
                 rpc.construct(context, *serverId, recoveryInfo);
                 sent = requested;
+                tabletLoadChanged = false;
             }
         } else {
             if (rpc->isReady()) {
@@ -132,7 +154,7 @@ class UpdateReplicationEpochTask : public Task {
                 rpc.destroy();
             }
         }
-        if (current != requested)
+        if (current != requested || tabletLoadChanged || rpc)
             schedule();
     }
 
@@ -173,6 +195,17 @@ class UpdateReplicationEpochTask : public Task {
      */
     ReplicationEpoch requested;
 
+    /**
+     * The most recent report of tablet and indexlet activity given to
+     * updateTabletLoad(); only its tablet_load and indexlet_load fields are
+     * used. Included in every rpc to the coordinator, since each one
+     * replaces the whole MasterRecoveryInfo.
+     */
+    ProtoBuf::MasterRecoveryInfo tabletLoad;
+
+    /// True if #tabletLoad has changed since it was last sent.
+    bool tabletLoadChanged;
+
     /**
      * Holds an ongoing rpc to the coordinator to update the replication epoch
      * for this #serverId, if any rpc is outstanding.
@@ -114,4 +114,46 @@ TEST_F(UpdateReplicationEpochTaskTest, updateToAtLeast) {
     EXPECT_FALSE(epoch->isScheduled());
 }
 
+TEST_F(UpdateReplicationEpochTaskTest, updateTabletLoad) {
+    epoch->updateToAtLeast(1, 1);
+    taskQueue.performTask(); // send rpc
+    taskQueue.performTask(); // reap rpc
+    EXPECT_FALSE(epoch->isScheduled());
+
+    ProtoBuf::MasterRecoveryInfo load;
+    ProtoBuf::MasterRecoveryInfo::TabletLoad& tablet = *load.add_tablet_load();
+    tablet.set_table_id(7);
+    tablet.set_start_key_hash(0);
+    tablet.set_end_key_hash(~0lu);
+    tablet.set_read_count(100);
+    tablet.set_write_count(10);
+    load.set_min_open_segment_id(99); // ignored
+    epoch->updateTabletLoad(load);
+    EXPECT_TRUE(epoch->isScheduled());
+    taskQueue.performTask(); // send rpc
+    EXPECT_TRUE(epoch->isScheduled());
+    taskQueue.performTask(); // reap rpc
+    EXPECT_FALSE(epoch->rpc);
+    EXPECT_FALSE(epoch->isScheduled());
+
+    // The report doesn't disturb the replication epoch.
+    CoordinatorServerList::Entry entry = (*serverList)[serverId];
+    auto coordRecoveryInfo = &entry.masterRecoveryInfo;
+    EXPECT_EQ(1lu, coordRecoveryInfo->min_open_segment_id());
+    EXPECT_EQ(1lu, coordRecoveryInfo->min_open_segment_epoch());
+    ASSERT_EQ(1, coordRecoveryInfo->tablet_load_size());
+    EXPECT_EQ(7lu, coordRecoveryInfo->tablet_load(0).table_id());
+    EXPECT_EQ(100lu, coordRecoveryInfo->tablet_load(0).read_count());
+    EXPECT_EQ(10lu, coordRecoveryInfo->tablet_load(0).write_count());
+
+    // Later epoch updates carry the latest report along.
+    epoch->updateToAtLeast(2, 0);
+    taskQueue.performTask(); // send rpc
+    taskQueue.performTask(); // reap rpc
+    entry = (*serverList)[serverId];
+    coordRecoveryInfo = &entry.masterRecoveryInfo;
+    EXPECT_EQ(2lu, coordRecoveryInfo->min_open_segment_id());
+    EXPECT_EQ(1, coordRecoveryInfo->tablet_load_size());
+}
+
 }  // namespace RAMCloud
@@ -0,0 +1,250 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "VersionHistory.h"
+#include "WireFormat.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct an empty VersionHistory.
+ */
+VersionHistory::VersionHistory()
+    : mutex("VersionHistory::mutex")
+    , chains()
+    , nextBucketToCollect(0)
+{
+}
+
+/**
+ * Drop the versions that no snapshot at or after a given time can read,
+ * from some of the objects. Successive calls work their way through all of
+ * the objects.
+ *
+ * \param watermark
+ *      No snapshot reads will be made at times before this.
+ * \param maxBuckets
+ *      The most buckets of the history's hash table to look at.
+ * \param[out] freed
+ *      The log references of the dropped versions are appended here; the
+ *      caller should free them.
+ * \param lock
+ *      Proves that the caller holds #mutex.
+ */
+void
+VersionHistory::collect(uint64_t watermark, size_t maxBuckets,
+        std::vector<uint64_t>* freed, const SpinLock::Guard& lock)
+{
+    std::vector<ObjectId> finished;
+    for (size_t i = 0; i < maxBuckets && !chains.empty(); i++) {
+        size_t bucket = nextBucketToCollect % chains.bucket_count();
+        nextBucketToCollect = bucket + 1;
+        for (auto it = chains.begin(bucket); it != chains.end(bucket); it++) {
+            // A version is needed by the snapshots after the time it was
+            // written, up to and including the time the next version was.
+            Chain& chain = it->second;
+            size_t keep = 1;
+            while (keep < chain.size() &&
+                    chain[keep - 1].writtenAt >= watermark)
+                keep++;
+            trim(&chain, keep, freed);
+
+            // Snapshots can only see the current version, as can reads
+            // of objects that have no history.
+            if (chain.front().writtenAt < watermark)
+                finished.push_back(it->first);
+        }
+    }
+    foreach (const ObjectId& id, finished)
+        chains.erase(id);
+}
+
+/**
+ * Find the version of an object that a snapshot read sees: the newest one
+ * written before the snapshot's time.
+ *
+ * \param key
+ *      The object's primary key.
+ * \param currentVersion
+ *      The version of the object in the hash table, or VERSION_NONEXISTENT
+ *      if there is none.
+ * \param time
+ *      The time of the snapshot.
+ * \param[out] older
+ *      If OLDER is returned, the version that the snapshot sees is returned
+ *      here; if its version is VERSION_NONEXISTENT, the object didn't exist
+ *      at that time.
+ * \param lock
+ *      Proves that the caller holds #mutex.
+ * \return
+ *      CURRENT if the snapshot sees the current version, which is also the
+ *      case for objects that haven't been written recently; OLDER if it sees
+ *      \a older; or TOO_OLD if the version it would see has been dropped.
+ */
+VersionHistory::Found
+VersionHistory::find(Key& key, uint64_t currentVersion, uint64_t time,
+        Version* older, const SpinLock::Guard& lock)
+{
+    auto it = chains.find(makeId(key));
+    if (it == chains.end())
+        return CURRENT;
+
+    // If the object changed without going through #record, its history
+    // isn't to be trusted.
+    Chain& chain = it->second;
+    if (chain.front().version != currentVersion)
+        return TOO_OLD;
+
+    for (size_t i = 0; i < chain.size(); i++) {
+        if (chain[i].writtenAt >= time)
+            continue;
+        if (i == 0)
+            return CURRENT;
+        *older = chain[i];
+        return OLDER;
+    }
+    return TOO_OLD;
+}
+
+/**
+ * Return whether a log entry holds one of the older versions that this
+ * history keeps; if so, the cleaner must relocate it.
+ *
+ * \param key
+ *      The primary key of the object in the log entry.
+ * \param reference
+ *      The log reference of the entry.
+ * \param lock
+ *      Proves that the caller holds #mutex.
+ */
+bool
+VersionHistory::isRetained(Key& key, uint64_t reference,
+        const SpinLock::Guard& lock)
+{
+    auto it = chains.find(makeId(key));
+    if (it == chains.end())
+        return false;
+    foreach (Version& version, it->second) {
+        if (version.reference == reference)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * Record that an object has been overwritten or removed. The history keeps
+ * the old version, which must not be freed by the caller (it will appear
+ * in \a freed, now or in a later call, once it's no longer needed).
+ *
+ * \param key
+ *      The object's primary key.
+ * \param oldVersion
+ *      The version that was replaced, or VERSION_NONEXISTENT if the object
+ *      has just been created.
+ * \param oldReference
+ *      The log reference of the replaced version (ignored if it doesn't
+ *      exist).
+ * \param newVersion
+ *      The object's new version, or VERSION_NONEXISTENT if the object was
+ *      removed.
+ * \param now
+ *      The current cluster time.
+ * \param maxVersions
+ *      The most older versions of the object to keep.
+ * \param[out] freed
+ *      The log references of any versions dropped from the history are
+ *      appended here; the caller should free them.
+ * \param lock
+ *      Proves that the caller holds #mutex.
+ */
+void
+VersionHistory::record(Key& key, uint64_t oldVersion, uint64_t oldReference,
+        uint64_t newVersion, uint64_t now, uint32_t maxVersions,
+        std::vector<uint64_t>* freed, const SpinLock::Guard& lock)
+{
+    Chain& chain = chains[makeId(key)];
+    if (chain.empty() || chain.front().version != oldVersion) {
+        // The object's history starts now. The old version has been current
+        // since before any snapshot can read, unless the object changed
+        // without going through this method; then we can't say since when.
+        uint64_t writtenAt = chain.empty() ? 0 : now;
+        trim(&chain, 0, freed);
+        chain.emplace_back(oldVersion, 0, writtenAt);
+    }
+    if (oldVersion != VERSION_NONEXISTENT)
+        chain.front().reference = oldReference;
+    chain.emplace_front(newVersion, 0, now);
+    trim(&chain, maxVersions + 1, freed);
+}
+
+/**
+ * Record that the cleaner has moved an older version of an object.
+ *
+ * \param key
+ *      The object's primary key.
+ * \param oldReference
+ *      Where the version was in the log (see #isRetained).
+ * \param newReference
+ *      Where the version is now.
+ * \param lock
+ *      Proves that the caller holds #mutex.
+ */
+void
+VersionHistory::relocate(Key& key, uint64_t oldReference,
+        uint64_t newReference, const SpinLock::Guard& lock)
+{
+    auto it = chains.find(makeId(key));
+    if (it == chains.end())
+        return;
+    foreach (Version& version, it->second) {
+        if (version.reference == oldReference)
+            version.reference = newReference;
+    }
+}
+
+/**
+ * Return the key under which an object's history is kept.
+ */
+VersionHistory::ObjectId
+VersionHistory::makeId(Key& key)
+{
+    uint64_t tableId = key.getTableId();
+    ObjectId id(reinterpret_cast<const char*>(&tableId), sizeof(tableId));
+    id.append(static_cast<const char*>(key.getStringKey()),
+              key.getStringKeyLength());
+    return id;
+}
+
+/**
+ * Drop the oldest versions of an object.
+ *
+ * \param chain
+ *      The object's versions.
+ * \param keep
+ *      How many of the newest versions to keep.
+ * \param[out] freed
+ *      The log references of the dropped versions are appended here.
+ */
+void
+VersionHistory::trim(Chain* chain, size_t keep, std::vector<uint64_t>* freed)
+{
+    while (chain->size() > keep) {
+        if (chain->back().reference != 0)
+            freed->push_back(chain->back().reference);
+        chain->pop_back();
+    }
+}
+
+} // namespace RAMCloud
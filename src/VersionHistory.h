@@ -0,0 +1,118 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_VERSIONHISTORY_H
+#define RAMCLOUD_VERSIONHISTORY_H
+
+#include <deque>
+#include <unordered_map>
+
+#include "Common.h"
+#include "Key.h"
+#include "SpinLock.h"
+
+namespace RAMCloud {
+
+/**
+ * Keeps the older versions of recently written objects on a master, so that
+ * objects can be read as they were at a given cluster time (a snapshot
+ * read). The hash table only refers to the current version of each object;
+ * this class remembers, for each object written while snapshots are
+ * enabled, when its current version was written and where in the log its
+ * last few versions are.
+ *
+ * Log entries for older versions are owned by this class: ObjectManager
+ * doesn't free them when they're overwritten, the cleaner relocates them
+ * as if they were live, and they're returned to ObjectManager to be freed
+ * once no snapshot can need them (because newer versions have pushed them
+ * out of the history, or because they were overwritten before the
+ * garbage-collection watermark, the oldest time a snapshot may read at).
+ *
+ * Times are encoded ClusterTimes (see ClusterTime::getEncoded). A snapshot
+ * at time T sees the versions written before T, so writes made once the
+ * master's clock has reached T don't change what it sees. The class
+ * doesn't lock anything itself: callers must hold #mutex (and pass a guard
+ * to prove it) for every operation.
+ */
+class VersionHistory {
+  public:
+    /// One version of an object.
+    struct Version {
+        Version(uint64_t version, uint64_t reference, uint64_t writtenAt)
+            : version(version)
+            , reference(reference)
+            , writtenAt(writtenAt)
+        {}
+
+        /// The object's version number, or VERSION_NONEXISTENT if the
+        /// object didn't exist (it had been removed, or not yet created).
+        uint64_t version;
+
+        /// Log::Reference of the object's log entry; 0 for the current
+        /// version (the hash table refers to it) and for versions that
+        /// don't exist.
+        uint64_t reference;
+
+        /// The cluster time at which this version became current; 0 for the
+        /// version that was current when the object's history began.
+        uint64_t writtenAt;
+    };
+
+    /// What #find returns.
+    enum Found {
+        CURRENT,    // The snapshot sees the current version of the object.
+        OLDER,      // The snapshot sees an older version.
+        TOO_OLD     // The versions the snapshot would see are gone.
+    };
+
+    VersionHistory();
+
+    void collect(uint64_t watermark, size_t maxBuckets,
+                std::vector<uint64_t>* freed, const SpinLock::Guard& lock);
+    Found find(Key& key, uint64_t currentVersion, uint64_t time,
+                Version* older, const SpinLock::Guard& lock);
+    bool isRetained(Key& key, uint64_t reference,
+                const SpinLock::Guard& lock);
+    void record(Key& key, uint64_t oldVersion, uint64_t oldReference,
+                uint64_t newVersion, uint64_t now, uint32_t maxVersions,
+                std::vector<uint64_t>* freed, const SpinLock::Guard& lock);
+    void relocate(Key& key, uint64_t oldReference, uint64_t newReference,
+                const SpinLock::Guard& lock);
+
+    /// Must be held while calling any of the methods above.
+    SpinLock mutex;
+
+  PRIVATE:
+    /// The versions of one object, newest (the current version) first.
+    typedef std::deque<Version> Chain;
+
+    /// Identifies an object: its table id followed by its primary key.
+    typedef string ObjectId;
+
+    static ObjectId makeId(Key& key);
+    static void trim(Chain* chain, size_t keep, std::vector<uint64_t>* freed);
+
+    /// The objects whose histories are kept.
+    std::unordered_map<ObjectId, Chain> chains;
+
+    /// The bucket of #chains that #collect should look at next.
+    size_t nextBucketToCollect;
+
+    DISALLOW_COPY_AND_ASSIGN(VersionHistory);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_VERSIONHISTORY_H
@@ -0,0 +1,156 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "VersionHistory.h"
+#include "WireFormat.h"
+
+namespace RAMCloud {
+
+class VersionHistoryTest : public ::testing::Test {
+  public:
+    VersionHistory history;
+    Key key;
+    std::vector<uint64_t> freed;
+
+    VersionHistoryTest()
+        : history()
+        , key(1, "key1", 4)
+        , freed()
+    {
+    }
+
+    /// Return the versions kept for #key, newest first, as
+    /// "version@writtenAt(reference)" separated by spaces.
+    string
+    chainToString()
+    {
+        string s;
+        foreach (VersionHistory::Version& version,
+                history.chains[VersionHistory::makeId(key)]) {
+            if (s.size() > 0)
+                s.append(" ");
+            s.append(format("%lu@%lu(%lu)", version.version,
+                    version.writtenAt, version.reference));
+        }
+        return s;
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(VersionHistoryTest);
+};
+
+TEST_F(VersionHistoryTest, collect) {
+    SpinLock::Guard guard(history.mutex);
+    history.record(key, 5, 1000, 6, 10, 5, &freed, guard);
+    history.record(key, 6, 2000, 7, 20, 5, &freed, guard);
+    history.record(key, 7, 3000, 8, 30, 5, &freed, guard);
+
+    EXPECT_EQ("8@30(0) 7@20(3000) 6@10(2000) 5@0(1000)", chainToString());
+
+    // Version 5 was replaced at 10, but snapshots at 20 still see 6.
+    history.collect(20, 1000, &freed, guard);
+    EXPECT_EQ("8@30(0) 7@20(3000) 6@10(2000)", chainToString());
+    ASSERT_EQ(1U, freed.size());
+    EXPECT_EQ(1000U, freed[0]);
+
+    history.collect(21, 1000, &freed, guard);
+    EXPECT_EQ("8@30(0) 7@20(3000)", chainToString());
+    ASSERT_EQ(2U, freed.size());
+    EXPECT_EQ(2000U, freed[1]);
+
+    // Once only the current version is visible, the history is dropped.
+    history.collect(31, 1000, &freed, guard);
+    EXPECT_EQ(0U, history.chains.size());
+    EXPECT_EQ(3U, freed.size());
+    EXPECT_EQ(3000U, freed[2]);
+}
+
+TEST_F(VersionHistoryTest, find) {
+    SpinLock::Guard guard(history.mutex);
+    VersionHistory::Version older(0, 0, 0);
+    EXPECT_EQ(VersionHistory::CURRENT, history.find(key, 5, 10, &older, guard));
+    EXPECT_EQ(0U, history.chains.size());
+
+    history.record(key, VERSION_NONEXISTENT, 0, 5, 10, 5, &freed, guard);
+    history.record(key, 5, 1000, 6, 20, 5, &freed, guard);
+
+    EXPECT_EQ(VersionHistory::CURRENT, history.find(key, 6, 21, &older, guard));
+    EXPECT_EQ(VersionHistory::OLDER, history.find(key, 6, 20, &older, guard));
+    EXPECT_EQ(5U, older.version);
+    EXPECT_EQ(1000U, older.reference);
+    EXPECT_EQ(VersionHistory::OLDER, history.find(key, 6, 10, &older, guard));
+    EXPECT_EQ(VERSION_NONEXISTENT, older.version);
+
+    // The object changed behind the history's back.
+    EXPECT_EQ(VersionHistory::TOO_OLD, history.find(key, 7, 21, &older, guard));
+}
+
+TEST_F(VersionHistoryTest, find_tooOld) {
+    SpinLock::Guard guard(history.mutex);
+    VersionHistory::Version older(0, 0, 0);
+    history.record(key, 5, 1000, 6, 20, 1, &freed, guard);
+    history.record(key, 6, 2000, 7, 30, 1, &freed, guard);
+    EXPECT_EQ(VersionHistory::OLDER, history.find(key, 7, 30, &older, guard));
+    EXPECT_EQ(6U, older.version);
+    EXPECT_EQ(VersionHistory::TOO_OLD, history.find(key, 7, 20, &older, guard));
+}
+
+TEST_F(VersionHistoryTest, isRetainedAndRelocate) {
+    SpinLock::Guard guard(history.mutex);
+    EXPECT_FALSE(history.isRetained(key, 1000, guard));
+    history.record(key, 5, 1000, 6, 10, 5, &freed, guard);
+    EXPECT_TRUE(history.isRetained(key, 1000, guard));
+
+    history.relocate(key, 1000, 4000, guard);
+    EXPECT_FALSE(history.isRetained(key, 1000, guard));
+    EXPECT_TRUE(history.isRetained(key, 4000, guard));
+    EXPECT_EQ("6@10(0) 5@0(4000)", chainToString());
+}
+
+TEST_F(VersionHistoryTest, record_basic) {
+    SpinLock::Guard guard(history.mutex);
+    history.record(key, VERSION_NONEXISTENT, 0, 5, 10, 5, &freed, guard);
+    EXPECT_EQ("5@10(0) 0@0(0)", chainToString());
+    history.record(key, 5, 1000, 6, 20, 5, &freed, guard);
+    EXPECT_EQ("6@20(0) 5@10(1000) 0@0(0)", chainToString());
+    history.record(key, 6, 2000, VERSION_NONEXISTENT, 30, 5, &freed, guard);
+    EXPECT_EQ("0@30(0) 6@20(2000) 5@10(1000) 0@0(0)", chainToString());
+    EXPECT_EQ(0U, freed.size());
+}
+
+TEST_F(VersionHistoryTest, record_trim) {
+    SpinLock::Guard guard(history.mutex);
+    history.record(key, 5, 1000, 6, 10, 2, &freed, guard);
+    history.record(key, 6, 2000, 7, 20, 2, &freed, guard);
+    EXPECT_EQ(0U, freed.size());
+    history.record(key, 7, 3000, 8, 30, 2, &freed, guard);
+    EXPECT_EQ("8@30(0) 7@20(3000) 6@10(2000)", chainToString());
+    ASSERT_EQ(1U, freed.size());
+    EXPECT_EQ(1000U, freed[0]);
+}
+
+TEST_F(VersionHistoryTest, record_outOfDate) {
+    SpinLock::Guard guard(history.mutex);
+    history.record(key, 5, 1000, 6, 10, 5, &freed, guard);
+
+    // Version 6 was replaced without telling the history, so it can't say
+    // what snapshots before now saw.
+    history.record(key, 7, 3000, 8, 30, 5, &freed, guard);
+    EXPECT_EQ("8@30(0) 7@30(3000)", chainToString());
+    ASSERT_EQ(1U, freed.size());
+    EXPECT_EQ(1000U, freed[0]);
+}
+
+}  // namespace RAMCloud
@@ -122,6 +122,20 @@ opcodeSymbol(uint32_t opcode)
         case TX_PREPARE:                   return "TX_PREPARE";
         case TX_REQUEST_ABORT:             return "TX_REQUEST_ABORT";
         case TX_HINT_FAILED:               return "TX_HINT_FAILED";
+        case BACKUP_RELAYED_WRITE:         return "BACKUP_RELAYED_WRITE";
+        case RELAYED_UPDATE_SERVER_LIST:   return "RELAYED_UPDATE_SERVER_LIST";
+        case MODIFY_INDEX_ENTRIES:         return "MODIFY_INDEX_ENTRIES";
+        case BUILD_INDEX:                  return "BUILD_INDEX";
+        case COUNT_INDEX_KEYS:             return "COUNT_INDEX_KEYS";
+        case CONDITIONAL_UPDATE:           return "CONDITIONAL_UPDATE";
+        case APPEND:                       return "APPEND";
+        case BULK_LOAD:                    return "BULK_LOAD";
+        case FORWARD:                      return "FORWARD";
+        case READ_FROM_REPLICA:            return "READ_FROM_REPLICA";
+        case READ_CHANGES:                 return "READ_CHANGES";
+        case ARE_REPLICAS_NEEDED:          return "ARE_REPLICAS_NEEDED";
+        case WRITE_FRAGMENT:               return "WRITE_FRAGMENT";
+        case COMMIT_WRITE:                 return "COMMIT_WRITE";
         case ILLEGAL_RPC_TYPE:             return "ILLEGAL_RPC_TYPE";
     }
 
@@ -174,6 +188,44 @@ opcodeSymbol(Buffer* buffer)
         return "null";
     return opcodeSymbol(header->opcode);
 }
+
+/**
+ * Given a buffer containing an RPC request, indicate whether the request
+ * is short and guaranteed not to block, so that a server may execute it
+ * directly in its dispatch thread instead of handing it to a worker
+ * thread. Requests in this category must finish in a few microseconds,
+ * must never wait for other RPCs, locks held across RPCs, or the
+ * dispatch thread itself, and must not rely on Service::Rpc::worker.
+ *
+ * \param request
+ *      Must contain an RPC request.
+ *
+ * \return
+ *      True if the request may run in the dispatch thread.
+ */
+bool
+isShortRpc(Buffer* request)
+{
+    // Largest MULTI_OP read that is considered short.
+    static const uint32_t MAX_SHORT_MULTI_READ = 4;
+
+    const RequestCommon* header = request->getStart<RequestCommon>();
+    if (header == NULL)
+        return false;
+    switch (header->opcode) {
+        case READ:
+        case READ_FROM_REPLICA:
+            return true;
+        case MULTI_OP: {
+            const MultiOp::Request* multiOp =
+                    request->getStart<MultiOp::Request>();
+            return (multiOp != NULL) && (multiOp->type == MultiOp::READ)
+                    && (multiOp->count <= MAX_SHORT_MULTI_READ);
+        }
+        default:
+            return false;
+    }
+}
 /**
  * Equality for RecoverRpc::Replica, useful for unit tests.
  */
@@ -23,6 +23,9 @@
 #ifndef RAMCLOUD_WIREFORMAT_H
 #define RAMCLOUD_WIREFORMAT_H
 
+#include <stddef.h>
+#include <type_traits>
+
 #include "RejectRules.h"
 #include "LogMetadata.h"
 #include "Status.h"
@@ -59,6 +62,8 @@ static_assert(INVALID_SERVICE < (sizeof(SerializedServiceMask) * 8),
  * change this table you must also reflect the changes in the following
  * locations:
  * - The method opcodeSymbol in WireFormat.cc.
+ * - The method isShortRpc in WireFormat.cc, if the new operation is
+ *   short and never blocks.
  * - WireFormatTest.cc's out-of-range test, if ILLEGAL_RPC_TYPE was changed.
  * - You may need to modify the "callees" table in scripts/genLevels.py,
  *   which keeps track of which RPCs invoke which other RPCs.
@@ -130,7 +135,21 @@ enum Opcode {
     TX_PREPARE                  = 77,
     TX_REQUEST_ABORT            = 78,
     TX_HINT_FAILED              = 79,
-    ILLEGAL_RPC_TYPE            = 80, // 1 + the highest legitimate Opcode
+    BACKUP_RELAYED_WRITE        = 80,
+    RELAYED_UPDATE_SERVER_LIST  = 81,
+    MODIFY_INDEX_ENTRIES        = 82,
+    BUILD_INDEX                 = 83,
+    COUNT_INDEX_KEYS            = 84,
+    CONDITIONAL_UPDATE          = 85,
+    APPEND                      = 86,
+    BULK_LOAD                   = 87,
+    FORWARD                     = 88,
+    READ_FROM_REPLICA           = 89,
+    READ_CHANGES                = 90,
+    ARE_REPLICAS_NEEDED         = 91,
+    WRITE_FRAGMENT              = 92,
+    COMMIT_WRITE                = 93,
+    ILLEGAL_RPC_TYPE            = 94, // 1 + the highest legitimate Opcode
 };
 
 /**
@@ -152,8 +171,92 @@ enum ControlOp {
     LOG_MESSAGE                 = 1010,
     RESET_METRICS               = 1011,
     QUIESCE                     = 1012,
+    GET_MEMORY_USAGE            = 1013,
+    SET_TABLE_TTL               = 1014,
+    SAVE_RESTART_SNAPSHOT       = 1015,
+    SET_TABLE_CACHE_QUOTA       = 1016,
+    SET_TABLE_DURABILITY        = 1017,
+    SET_WORKER_OPTION           = 1018,
+    SET_TABLE_RATE_LIMIT        = 1019,
+    SET_READ_REPLICA            = 1020,
+    GET_READ_REPLICA            = 1021,
+    SYNC_READ_REPLICA           = 1022,
 };
 
+/**
+ * The input for the SET_TABLE_TTL control op: objects in the given table
+ * expire this many seconds after they were last written (0 means they
+ * never expire).
+ */
+struct TableTtl {
+    uint64_t tableId;
+    uint32_t ttlSeconds;
+} __attribute__((packed));
+
+/**
+ * The input for the SET_TABLE_CACHE_QUOTA control op: the table is a cache
+ * that may hold this many bytes on each master (0 means it isn't a cache).
+ */
+struct TableCacheQuota {
+    uint64_t tableId;
+    uint64_t quotaBytes;
+} __attribute__((packed));
+
+/**
+ * The input for the SET_TABLE_DURABILITY control op: writes to the table are
+ * acknowledged once this many replicas of them are durable.
+ */
+struct TableDurability {
+    uint64_t tableId;
+    uint32_t ackReplicas;
+} __attribute__((packed));
+
+/**
+ * The input for the SET_TABLE_RATE_LIMIT control op: each master serves at
+ * most this many operations and bytes per second for the table (0 means
+ * no limit).
+ */
+struct TableRateLimit {
+    uint64_t tableId;
+    uint64_t opsPerSecond;
+    uint64_t bytesPerSecond;
+} __attribute__((packed));
+
+/**
+ * The input for the SET_READ_REPLICA control op: the tablet containing the
+ * op's object is copied to this master, which serves slightly stale reads
+ * of it (0 means the tablet no longer has a read replica).
+ */
+struct ReadReplicaServer {
+    uint64_t serverId;
+} __attribute__((packed));
+
+/**
+ * The output of the GET_READ_REPLICA control op: the tablet containing the
+ * op's object, followed by the service locator of its read replica (a
+ * string of locatorLength bytes, not null-terminated; empty if the tablet
+ * has no read replica).
+ */
+struct ReadReplicaLocator {
+    uint64_t firstKeyHash;
+    uint64_t lastKeyHash;
+    uint32_t locatorLength;
+} __attribute__((packed));
+
+/**
+ * The input for the SYNC_READ_REPLICA control op, which a master sends to
+ * its read replicas: the replica of the given tablet is created, if it
+ * doesn't already exist, and it held all of the master's data for the
+ * tablet ageMicros ago (NOT_SYNCED means the replica isn't up to date yet).
+ */
+struct ReadReplicaSync {
+    uint64_t tableId;
+    uint64_t firstKeyHash;
+    uint64_t lastKeyHash;
+    uint32_t ageMicros;
+    static const uint32_t NOT_SYNCED = ~0u;
+} __attribute__((packed));
+
 /**
  * Used in linearizable RPCs to check whether or not the RPC can be processed.
  */
@@ -171,7 +274,26 @@ struct ClientLease {
  */
 struct RequestCommon {
     uint16_t opcode;              /// Opcode of operation to be performed.
-    uint16_t service;             /// ServiceType to invoke for this rpc.
+    uint16_t service;             /// ServiceType to invoke for this rpc,
+                                  /// possibly or'ed with TRACED_REQUEST.
+} __attribute__((packed));
+
+/**
+ * If this bit is set in RequestCommon::service, the request is part of a
+ * traced operation (see RpcTrace), and a RequestTrace follows the rest of
+ * the request. Untraced requests are unchanged. The receiving server
+ * removes the trailer and clears the bit before the request is executed.
+ */
+static const uint16_t TRACED_REQUEST = 0x8000;
+
+/**
+ * Trailer at the end of a traced request.
+ */
+struct RequestTrace {
+    uint64_t traceId;             /// Identifies the operation (a client
+                                  /// request, and all of the RPCs made on
+                                  /// its behalf) that the request is part
+                                  /// of; never 0.
 } __attribute__((packed));
 
 /**
@@ -238,6 +360,54 @@ struct RetryResponse {
 
 // The RPCs below are in alphabetical order
 
+/**
+ * Used by a client to append bytes to the value of an object, atomically
+ * on the master that stores it. An object that doesn't exist is created
+ * (unless the reject rules say otherwise).
+ */
+struct Append {
+    static const Opcode opcode = APPEND;
+    static const ServiceType service = MASTER_SERVICE;
+    struct Request {
+        RequestCommon common;
+        uint64_t tableId;
+        ClientLease lease;
+        uint64_t rpcId;
+        uint64_t ackId;
+        uint16_t keyLength;           // Length of the key in bytes.
+        uint32_t length;              // Number of bytes to append.
+        RejectRules rejectRules;
+        // In buffer: the key, followed by the bytes to append.
+    } __attribute__((packed));
+    struct Response {
+        ResponseCommon common;
+        uint64_t version;
+        uint32_t newLength;           // Length of the object's value after
+                                      // the append.
+    } __attribute__((packed));
+};
+
+/**
+ * Used by a backup garbage collecting the replicas it found on storage
+ * when it started: a batched form of IsReplicaNeeded that asks a master
+ * about many of its segments at once.
+ */
+struct AreReplicasNeeded {
+    static const Opcode opcode = ARE_REPLICAS_NEEDED;
+    static const ServiceType service = MASTER_SERVICE;
+    struct Request {
+        RequestCommonWithId common;
+        uint64_t backupServerId;
+        uint32_t segmentIdCount;      // Number of uint64_t segment ids that
+                                      // follow in the buffer.
+    } __attribute__((packed));
+    struct Response {
+        ResponseCommon common;
+        // In buffer: one uint8_t for each segment id in the request, in the
+        // same order; nonzero means the backup must retain the replica.
+    } __attribute__((packed));
+};
+
 struct BackupFree {
     static const Opcode opcode = BACKUP_FREE;
     static const ServiceType service = BACKUP_SERVICE;
@@ -266,11 +436,13 @@ struct BackupGetRecoveryData {
         Response()
             : common()
             , certificate()
+            , entriesVerified(0)
         {}
         Response(const ResponseCommon& common,
                  const SegmentCertificate& certificate)
             : common(common)
             , certificate(certificate)
+            , entriesVerified(0)
         {}
         ResponseCommon common;
         SegmentCertificate certificate; ///< Certificate for the segment
@@ -278,6 +450,9 @@ struct BackupGetRecoveryData {
                                         ///< the response field. Used by
                                         ///< master to iterate over the
                                         ///< segment.
+        uint8_t entriesVerified;        ///< Nonzero if the backup checked
+                                        ///< the checksum of every entry in
+                                        ///< the segment.
     } __attribute__((packed));
 };
 
@@ -290,6 +465,18 @@ struct BackupRecoveryComplete {
     } __attribute__((packed));
     struct Response {
         ResponseCommon common;
+        // The remaining fields describe how long this backup took to
+        // prepare the crashed master's data (see RecoveryTimeline); they
+        // are all zero if the backup had no recovery state for it.
+        uint32_t primaryReplicas;     ///< Number of primary replicas the
+                                      ///< backup filtered.
+        uint64_t partitionWaitMicros; ///< From startReadingData until the
+                                      ///< partitions arrived.
+        uint64_t filterDoneMicros;    ///< From the arrival of the
+                                      ///< partitions until all primaries had
+                                      ///< been filtered (0 if they hadn't).
+        uint64_t filterMicros;        ///< Total time spent filtering
+                                      ///< replicas, summed over threads.
     } __attribute__((packed));
 };
 
@@ -394,6 +581,8 @@ struct BackupWrite {
             , primary()
             , certificateIncluded()
             , certificate()
+            , relayCount()
+            , compressedLength()
         {}
         Request(const RequestCommonWithId& common,
                 uint64_t masterId,
@@ -417,6 +606,8 @@ struct BackupWrite {
             , primary(primary)
             , certificateIncluded(certificateIncluded)
             , certificate(certificate)
+            , relayCount(0)
+            , compressedLength(0)
         {}
         RequestCommonWithId common;
         uint64_t masterId;        ///< Server from whom the request is coming.
@@ -440,10 +631,138 @@ struct BackupWrite {
                                         ///< written to storage
                                         ///< following the data included
                                         ///< in this rpc.
-        // Opaque byte string follows with data to write.
+        uint8_t relayCount;       ///< Number of backup server ids (each a
+                                  ///< uint64_t) following this header. The
+                                  ///< backup relays the write to each of
+                                  ///< them (as a BackupRelayedWrite).
+        uint32_t compressedLength; ///< If nonzero, the data is Lz4
+                                  ///< compressed into this many bytes, and
+                                  ///< decompresses to #length bytes.
+        // Relay list, then opaque byte string with data to write.
+    } __attribute__((packed));
+    struct Response {
+        ResponseCommon common;
+        uint32_t relayedMask;     ///< Bit i is set if the write was durably
+                                  ///< relayed to the i-th backup in the
+                                  ///< request's relay list.
+        uint32_t writeBuffersInUse; ///< Replicas the backup has buffered
+                                  ///< waiting to be written to storage;
+                                  ///< a measure of its load.
+    } __attribute__((packed));
+
+    /// Maximum value for Request::relayCount.
+    static const uint32_t MAX_RELAYS = 8;
+};
+
+/**
+ * A BackupWrite that a backup relays on behalf of a master (see
+ * BackupWrite::Request::relayCount). It has its own opcode only so that it
+ * is a leaf in the RPC level table: the receiving backup doesn't relay it
+ * any further.
+ */
+struct BackupRelayedWrite {
+    static const Opcode opcode = BACKUP_RELAYED_WRITE;
+    static const ServiceType service = BACKUP_SERVICE;
+    typedef BackupWrite::Request Request;
+    typedef BackupWrite::Response Response;
+};
+
+struct BuildIndex {
+    static const Opcode opcode = BUILD_INDEX;
+    static const ServiceType service = MASTER_SERVICE;
+    struct Request {
+        RequestCommonWithId common;
+        uint64_t tableId;           // Id of the table whose objects are to
+                                    // be indexed.
+        uint8_t indexId;            // Id of the (new) index.
+    } __attribute__((packed));
+    struct Response {
+        ResponseCommon common;
+    } __attribute__((packed));
+};
+
+/**
+ * Used by a client to compare a range of bytes in the value of an object
+ * with the bytes it expects and, if they match, replace them, atomically on
+ * the master that stores the object.
+ */
+/**
+ * Used by a client to add a segment of objects that it built itself to a
+ * table (see BulkLoader).
+ */
+struct BulkLoad {
+    static const Opcode opcode = BULK_LOAD;
+    static const ServiceType service = MASTER_SERVICE;
+    struct Request {
+        Request()
+            : common()
+            , tableId()
+            , segmentBytes()
+            , certificate()
+        {}
+        RequestCommon common;
+        uint64_t tableId;
+        uint32_t segmentBytes;          // Length of the segment following
+                                        // this header.
+        SegmentCertificate certificate; // Certificate for the segment.
+        // In buffer: the segment, which holds nothing but objects in
+        // table tableId.
+    } __attribute__((packed));
+    struct Response {
+        ResponseCommon common;
+        uint32_t objects;               // Number of objects loaded.
+    } __attribute__((packed));
+};
+
+struct CommitWrite {
+    static const Opcode opcode = COMMIT_WRITE;
+    static const ServiceType service = MASTER_SERVICE;
+    struct Request {
+        RequestCommon common;
+        uint64_t tableId;
+        ClientLease lease;
+        uint64_t rpcId;
+        uint64_t ackId;
+        uint64_t streamId;            // Identifies the fragments sent with
+                                      // WRITE_FRAGMENT that make up the
+                                      // value.
+        uint32_t valueLength;         // Total size of the value in bytes.
+        uint32_t checksum;            // Crc32C of the whole value.
+        RejectRules rejectRules;
+        uint16_t keyLength;           // Length of the key in bytes.
+        uint64_t keyHash;             // Key::getHash of the key.
+        // In buffer: the key.
+    } __attribute__((packed));
+    struct Response {
+        ResponseCommon common;
+        uint64_t version;
+    } __attribute__((packed));
+};
+
+struct ConditionalUpdate {
+    static const Opcode opcode = CONDITIONAL_UPDATE;
+    static const ServiceType service = MASTER_SERVICE;
+    struct Request {
+        RequestCommon common;
+        uint64_t tableId;
+        ClientLease lease;
+        uint64_t rpcId;
+        uint64_t ackId;
+        uint16_t keyLength;           // Length of the key in bytes.
+        uint32_t offset;              // Offset in the object's value of the
+                                      // bytes to compare and replace.
+        uint32_t length;              // Number of bytes to compare and
+                                      // replace.
+        RejectRules rejectRules;
+        // In buffer: the key, followed by the length bytes expected at
+        // offset, followed by the length bytes to replace them with.
     } __attribute__((packed));
     struct Response {
         ResponseCommon common;
+        uint64_t version;             // The object's new version if it was
+                                      // updated, else its current version.
+        uint8_t updated;              // Nonzero means the bytes matched and
+                                      // were replaced.
     } __attribute__((packed));
 };
 
@@ -500,6 +819,42 @@ struct DropTable {
     } __attribute__((packed));
 };
 
+/**
+ * Used by a client to ask an index server how many index entries have keys
+ * in the range [first key, last key], and what the smallest and largest of
+ * those keys are. Only the counts and keys are returned, never the hashes.
+ */
+struct CountIndexKeys {
+    static const Opcode opcode = COUNT_INDEX_KEYS;
+    static const ServiceType service = MASTER_SERVICE;
+
+    struct Request {
+        RequestCommon common;
+        uint64_t tableId;               // Id of the table for the count.
+        uint8_t indexId;                // Id of the index for the count.
+        uint16_t firstKeyLength;        // Length of first key in bytes.
+        uint64_t firstAllowedKeyHash;   // Smallest primary key hash value
+                                        // allowed for firstKey.
+        uint16_t lastKeyLength;         // Length of last key in bytes.
+        // In buffer: The actual first key and last key go here.
+    } __attribute__((packed));
+
+    struct Response {
+        ResponseCommon common;
+        uint64_t count;         // Number of entries counted by this server.
+        uint16_t minKeyLength;  // Length of the smallest key counted.
+        uint16_t maxKeyLength;  // Length of the largest key counted.
+        uint16_t nextKeyLength; // Length of next key to count, or 0 if the
+                                // whole range has been counted.
+        uint64_t nextKeyHash;   // Minimum allowed hash corresponding to
+                                // next key to be counted.
+        // In buffer: Actual bytes of the smallest and largest keys counted
+        // (only if count is nonzero), followed by the actual bytes of the
+        // next key for which the client should send another count request
+        // (if any).
+    } __attribute__((packed));
+};
+
 struct CreateIndex {
     static const Opcode opcode = CREATE_INDEX;
     static const ServiceType service = COORDINATOR_SERVICE;
@@ -579,6 +934,10 @@ struct EnlistServer {
         SerializedServiceMask serviceMask; ///< Which services are available
                                            ///< on the enlisting server.
         uint32_t readSpeed;                /// MB/s read speed if a BACKUP
+        /// Nonzero means the enlisting server is a master that was restarted
+        /// after saving a snapshot of the log of the server #replacesId
+        /// (see MasterSnapshot), so it is the best choice to recover it.
+        uint8_t fromSnapshot;
         /// Number of bytes in the serviceLocator, including terminating NULL
         /// character.  The bytes of the service locator follow immediately
         /// after this header.
@@ -608,6 +967,9 @@ struct Enumerate {
                                     // actual iterator follows
                                     // immediately after this header.
                                     // See EnumerationIterator.
+        uint32_t filterBytes;       // Size of the ObjectFilter that follows
+                                    // the iterator, or 0 to return all
+                                    // objects.
     } __attribute__((packed));
     struct Response {
         ResponseCommon common;
@@ -639,6 +1001,25 @@ struct FillWithTestData {
     } __attribute__((packed));
 };
 
+struct Forward {
+    static const Opcode opcode = FORWARD;
+    static const ServiceType service = PING_SERVICE;
+    struct Request {
+        RequestCommon common;
+        uint16_t locatorLength;       // Length of the service locator of the
+                                      // server to forward the request to.
+                                      // The locator follows immediately
+                                      // after this header, and the request
+                                      // to forward follows the locator.
+    } __attribute__((packed));
+    struct Response {
+        ResponseCommon common;        // If the status is STATUS_OK, the
+                                      // target's response follows this
+                                      // header; otherwise the request
+                                      // couldn't be delivered.
+    } __attribute__((packed));
+};
+
 struct GetBackupConfig {
     static const Opcode opcode = GET_BACKUP_CONFIG;
     static const ServiceType service = COORDINATOR_SERVICE;
@@ -824,13 +1205,18 @@ struct GetTableConfig {
     struct Request {
         RequestCommon common;
         uint64_t tableId;
+        uint64_t startKeyHash;     // Only tablets overlapping the range
+        uint64_t endKeyHash;       // startKeyHash..endKeyHash (inclusive)
+                                   // are returned; indexes are returned
+                                   // only if the range covers all key
+                                   // hashes.
     } __attribute__((packed));
     struct Response {
         ResponseCommon common;
         uint32_t tableConfigLength;  // Number of bytes in the tablet map.
                                    // The bytes of the tablet map follow
                                    // immediately after this header. See
-                                   // ProtoBuf::Tablets.
+                                   // FlatTableConfig.
     } __attribute__((packed));
 };
 
@@ -980,6 +1366,9 @@ struct LookupIndexKeys {
         uint16_t lastKeyLength;         // Length of last key in bytes.
         uint32_t maxNumHashes;          // Max number of primary key hashes
                                         // to be returned.
+        uint8_t fetchObjects;           // Nonzero means the server should
+                                        // also return the matching objects
+                                        // that it stores (see Response).
         // In buffer: The actual first key and last key go here.
     } __attribute__((packed));
 
@@ -989,9 +1378,16 @@ struct LookupIndexKeys {
         uint16_t nextKeyLength; // Length of next key to fetch.
         uint64_t nextKeyHash;   // Minimum allowed hash corresponding to
                                 // next key to be fetched.
+        uint32_t numObjectHashes;   // If fetchObjects was requested: the
+                                    // objects for this many of the returned
+                                    // hashes (always a prefix) are included
+                                    // below, so the client needn't read them.
+        uint32_t numObjects;        // Number of objects included below.
         // In buffer: Key hashes of primary keys for matching objects go here.
         // In buffer: Actual bytes for the next key for which
         // the client should send another lookup request (if any) goes here.
+        // In buffer: numObjects objects, in the same format as a ReadHashes
+        // response.
     } __attribute__((packed));
 };
 
@@ -1010,18 +1406,53 @@ struct MigrateTablet {
     } __attribute__((packed));
 };
 
+/**
+ * Used by a master to ask an index server to insert or remove a group of
+ * index entries, all in the same index, on behalf of the objects in a
+ * multi-object operation. The entries are applied all or nothing: if any
+ * of them doesn't belong to an indexlet on the server, none of them are
+ * applied and the response status is STATUS_UNKNOWN_INDEXLET.
+ */
+struct ModifyIndexEntries {
+    static const Opcode opcode = MODIFY_INDEX_ENTRIES;
+    static const ServiceType service = MASTER_SERVICE;
+    struct Request {
+        RequestCommon common;
+        uint64_t tableId;           // Id of the table containing the objects
+                                    // that the index entries point to.
+        uint8_t indexId;            // Id of the index containing all of
+                                    // the entries.
+        uint8_t remove;             // Nonzero means remove the entries;
+                                    // zero means insert them.
+        uint32_t count;             // Number of entries in the request.
+        // In buffer: count Entry structures, each followed by the bytes
+        // of its index key.
+    } __attribute__((packed));
+    struct Entry {
+        uint16_t indexKeyLength;    // Length of index key in bytes.
+        uint64_t primaryKeyHash;    // Hash of the primary key of the object
+                                    // that the index entry points to.
+    } __attribute__((packed));
+    struct Response {
+        ResponseCommon common;
+    } __attribute__((packed));
+};
+
 struct MultiOp {
     static const Opcode opcode = MULTI_OP;
     static const ServiceType service = MASTER_SERVICE;
 
     /// Type of Multi Operation
     /// Note: Make sure INVALID is always last.
-    enum OpType { INCREMENT, READ, REMOVE, WRITE, INVALID };
+    enum OpType { INCREMENT, READ, REMOVE, WRITE, UPDATE, INVALID };
 
     struct Request {
         RequestCommon common;
         uint32_t count; // Number of Part structures following this.
         OpType type;
+        uint32_t filterBytes;   // READ only: size of the ObjectFilter that
+                                // follows this header (before the Parts),
+                                // or 0 to return all of the objects.
 
         struct IncrementPart {
             uint64_t tableId;          // Table that contains the object to be
@@ -1082,6 +1513,34 @@ struct MultiOp {
             }
         } __attribute__((packed));
 
+        struct UpdatePart {
+            uint64_t tableId;
+            uint16_t keyLength;
+            uint8_t append;         // Nonzero means append length bytes to
+                                    // the value (see Append); zero means a
+                                    // conditional update (see
+                                    // ConditionalUpdate).
+            uint32_t offset;        // Conditional updates only: offset of
+                                    // the bytes to compare and replace.
+            uint32_t length;
+            RejectRules rejectRules;
+
+            // In buffer: the key, then (for conditional updates only) the
+            // length bytes expected at offset, and then the length bytes to
+            // store.
+            UpdatePart(uint64_t tableId, uint16_t keyLength, bool append,
+                       uint32_t offset, uint32_t length,
+                       RejectRules rejectRules)
+                : tableId(tableId)
+                , keyLength(keyLength)
+                , append(append)
+                , offset(offset)
+                , length(length)
+                , rejectRules(rejectRules)
+            {
+            }
+        } __attribute__((packed));
+
         struct WritePart {
             uint64_t tableId;
             uint32_t length;        // length of keysAndValue
@@ -1148,6 +1607,22 @@ struct MultiOp {
             uint64_t version;
         } __attribute__((packed));
 
+        struct UpdatePart {
+            /// Status of the update.
+            Status status;
+
+            /// The object's new version if it was updated, else its current
+            /// version.
+            uint64_t version;
+
+            /// Conditional updates: nonzero if the bytes matched and were
+            /// replaced. Appends: always nonzero on success.
+            uint8_t updated;
+
+            /// Length of the object's value after the operation.
+            uint32_t newLength;
+        } __attribute__((packed));
+
         struct WritePart {
             // Each Response::Part contains the Status for the newly written
             ///object returned and the version.
@@ -1237,10 +1712,91 @@ struct Read {
                                       // The actual key follows
                                       // immediately after this header.
         RejectRules rejectRules;
+        uint64_t snapshotTime;        // If nonzero, read the object as it
+                                      // was at this (encoded) ClusterTime.
+        uint64_t keyHash;             // Key::getHash of the key, as
+                                      // computed by the client to find
+                                      // the master, or 0 if unknown.
     } __attribute__((packed));
     struct Response {
         ResponseCommon common;
         uint64_t version;
+        uint64_t snapshotTime;        // Time of the snapshot that this
+                                      // read saw, or 0 if the master
+                                      // doesn't support snapshot reads.
+        uint32_t length;              // Length of the object's value in bytes.
+                                      // The actual bytes of the object follow
+                                      // immediately after this header.
+    } __attribute__((packed));
+};
+
+struct ReadChanges {
+    static const Opcode opcode = READ_CHANGES;
+    static const ServiceType service = MASTER_SERVICE;
+    struct Request {
+        RequestCommon common;
+        uint64_t tableId;
+        uint64_t firstKeyHash;        // The tablet whose changes are wanted.
+        uint64_t lastKeyHash;
+        uint64_t position;            // Where to start reading in the
+                                      // master's change stream: a
+                                      // nextPosition from an earlier
+                                      // response, or SUBSCRIBE to start
+                                      // streaming the table (no changes are
+                                      // returned, just the position from
+                                      // which they will be kept).
+        uint32_t maxBytes;            // Return at most about this many
+                                      // bytes of changes.
+        static const uint64_t SUBSCRIBE = ~0UL;
+    } __attribute__((packed));
+    struct Response {
+        ResponseCommon common;
+        uint64_t streamId;            // Identifies the master's stream;
+                                      // positions from different streams
+                                      // (or from before a master restarted)
+                                      // are unrelated.
+        uint64_t nextPosition;        // Where the next read should start.
+        uint32_t lagMicros;           // Age of the oldest change not yet
+                                      // read; 0 means the reader is caught
+                                      // up.
+        uint8_t positionLost;         // Nonzero means the changes at
+                                      // position were discarded before they
+                                      // were read; the reader must
+                                      // subscribe again and recopy the
+                                      // tablet.
+        uint32_t length;              // Bytes of changes that follow.
+        uint32_t compressedLength;    // If nonzero, the changes are Lz4
+                                      // compressed into this many bytes.
+    } __attribute__((packed));
+
+    /// The changes are a sequence of these, each followed by a log entry
+    /// of length bytes (an Object or ObjectTombstone), in the order the
+    /// master appended them to its log.
+    struct Change {
+        uint8_t type;                 // A LogEntryType.
+        uint32_t length;
+    } __attribute__((packed));
+};
+
+struct ReadFromReplica {
+    static const Opcode opcode = READ_FROM_REPLICA;
+    static const ServiceType service = MASTER_SERVICE;
+    struct Request {
+        RequestCommon common;
+        uint64_t tableId;
+        uint16_t keyLength;           // Length of the key in bytes.
+                                      // The actual key follows
+                                      // immediately after this header.
+        uint32_t maxStalenessMicros;  // The read may be served by a read
+                                      // replica that was up to date this
+                                      // long ago.
+    } __attribute__((packed));
+    struct Response {                 // Same as Read::Response, so that a
+                                      // ReadRpc may be hedged with this
+                                      // request (see RpcWrapper::hedge).
+        ResponseCommon common;
+        uint64_t version;
+        uint64_t snapshotTime;        // Always 0.
         uint32_t length;              // Length of the object's value in bytes.
                                       // The actual bytes of the object follow
                                       // immediately after this header.
@@ -1302,6 +1858,7 @@ struct ReceiveMigrationData {
             , keyLength()
             , segmentBytes()
             , certificate()
+            , clusterTime()
         {}
         RequestCommonWithId common;
         uint64_t tableId;       // Id of the table this data belongs to.
@@ -1321,6 +1878,8 @@ struct ReceiveMigrationData {
                                         // being migrated. Used by
                                         // master to iterate over the
                                         // segment.
+        uint64_t clusterTime;   // Sender's current (encoded) ClusterTime,
+                                // or 0 if unknown.
         // In buffer: The actual bytes for a key belonging to the indexlet
         // (used to determine which indexlet is being migrated);
         // followed by:
@@ -1328,6 +1887,7 @@ struct ReceiveMigrationData {
     } __attribute__((packed));
     struct Response {
         ResponseCommon common;
+        uint64_t clusterTime;   // Receiver's current (encoded) ClusterTime.
     } __attribute__((packed));
 };
 
@@ -1377,6 +1937,10 @@ struct RecoveryMasterFinished {
         uint64_t recoveryId;
         uint64_t recoveryMasterId; // Server Id from whom the request is coming.
         bool successful;           // Indicates whether the recovery succeeded.
+        bool partial;              // If true, only the tablets in the map
+                                   // have been recovered so far; the
+                                   // recovery master is still working on
+                                   // the rest of its partition.
         uint32_t tabletsLength;    // Number of bytes in the tablet map.
                                    // The bytes of the tablet map follow
                                    // immediately after this header. See
@@ -1401,6 +1965,9 @@ struct Remove {
                                       // The actual key follows
                                       // immediately after this header.
         RejectRules rejectRules;
+        uint64_t keyHash;             // Key::getHash of the key, as
+                                      // computed by the client to find
+                                      // the master, or 0 if unknown.
     } __attribute__((packed));
     struct Response {
         ResponseCommon common;
@@ -1635,6 +2202,8 @@ struct TakeIndexletOwnership {
                                          // objects for this indexlet.
         uint16_t firstKeyLength;         // Length of fistKey in bytes.
         uint16_t firstNotOwnedKeyLength; // Length of firstNotOwnedKey in bytes.
+        uint8_t indexType;               // How the indexlet's entries are
+                                         // stored (an IndexKey::IndexType).
         // In buffer: The actual bytes for firstKey and firstNotOwnedKey
         // go here. [firstKey, firstNotOwnedKey) defines the span of the
         // indexlet for which this server is taking ownership.
@@ -1860,10 +2429,17 @@ struct UpdateServerList {
     static const ServiceType service = MEMBERSHIP_SERVICE;
     struct Request {
         RequestCommonWithId common;
+        uint32_t relayCount;          // Number of other servers that the
+                                      // recipient should forward this
+                                      // update to, after applying it (see
+                                      // MembershipService::relayUpdate());
+                                      // at most MAX_RELAYS.
 
         // Immediately following this header are one or more groups,
         // where each group consists of a Part object (defined below)
-        // followed by a serialized ProtoBuf::ServerList.
+        // followed by a serialized ProtoBuf::ServerList. The request
+        // ends with relayCount ServerIds (uint64_t each) of the servers
+        // to forward the update to.
         struct Part {
             uint32_t serverListLength; // Number of bytes in the server list.
                                        // The bytes of the server list follow
@@ -1876,7 +2452,33 @@ struct UpdateServerList {
         uint64_t currentVersion;      // The server list version number of the
                                       // RPC recipient, after processing this
                                       // request.
+
+        // Immediately following this header is one RelayResult (defined
+        // below) for each server the request was forwarded to.
+        struct RelayResult {
+            uint64_t serverId;        // Server the update was forwarded to.
+            uint64_t currentVersion;  // The server list version number of
+                                      // that server after processing the
+                                      // update, or 0 if the update couldn't
+                                      // be delivered to it.
+        } __attribute__((packed));
     } __attribute__((packed));
+
+    /// Maximum value for Request::relayCount.
+    static const uint32_t MAX_RELAYS = 31;
+};
+
+/**
+ * An UpdateServerList that a server relays on behalf of the coordinator
+ * (see UpdateServerList::Request::relayCount). It has its own opcode only
+ * so that it is a leaf in the RPC level table: the receiving server doesn't
+ * relay it any further.
+ */
+struct RelayedUpdateServerList {
+    static const Opcode opcode = RELAYED_UPDATE_SERVER_LIST;
+    static const ServiceType service = MEMBERSHIP_SERVICE;
+    typedef UpdateServerList::Request Request;
+    typedef UpdateServerList::Response Response;
 };
 
 struct VerifyMembership {
@@ -1905,6 +2507,9 @@ struct Write {
                                       // follow immediately after this header
         RejectRules rejectRules;
         uint8_t async;
+        uint64_t keyHash;             // Key::getHash of the key, as
+                                      // computed by the client to find
+                                      // the master, or 0 if unknown.
     } __attribute__((packed));
     struct Response {
         ResponseCommon common;
@@ -1912,12 +2517,72 @@ struct Write {
     } __attribute__((packed));
 };
 
+struct WriteFragment {
+    static const Opcode opcode = WRITE_FRAGMENT;
+    static const ServiceType service = MASTER_SERVICE;
+    struct Request {
+        RequestCommon common;
+        uint64_t tableId;
+        uint64_t keyHash;             // Key::getHash of the object's key;
+                                      // used only to find the master.
+        uint64_t streamId;            // Chosen at random by the client; the
+                                      // same for all fragments of a value.
+        uint32_t offset;              // Offset of this fragment in the
+                                      // value.
+        uint32_t length;              // Bytes of value data following this
+                                      // header.
+    } __attribute__((packed));
+    struct Response {
+        ResponseCommon common;
+    } __attribute__((packed));
+};
+
 // DON'T DEFINE NEW RPC TYPES HERE!! Put them in alphabetical order above.
 
+/**
+ * Compile-time check of the layout of an RPC's headers: each header must be
+ * a plain struct starting with its common part (the RPC machinery reads
+ * RequestCommon and ResponseCommon out of every message), and must have the
+ * given size. The sizes pin down the wire format of the most frequent RPCs,
+ * so that a change to any of their headers (which costs bytes in every
+ * request) is deliberate: if you change one of these headers, change its
+ * size below too.
+ */
+template<typename Rpc, size_t requestSize, size_t responseSize>
+struct CheckLayout {
+    static_assert(std::is_standard_layout<typename Rpc::Request>::value &&
+            std::is_trivial<typename Rpc::Request>::value,
+            "RPC request headers must be plain structs");
+    static_assert(std::is_standard_layout<typename Rpc::Response>::value &&
+            std::is_trivial<typename Rpc::Response>::value,
+            "RPC response headers must be plain structs");
+    static_assert(offsetof(typename Rpc::Request, common) == 0,
+            "RPC request headers must start with the common header");
+    static_assert(offsetof(typename Rpc::Response, common) == 0,
+            "RPC response headers must start with the common header");
+    static_assert(sizeof(typename Rpc::Request) == requestSize,
+            "RPC request header changed size");
+    static_assert(sizeof(typename Rpc::Response) == responseSize,
+            "RPC response header changed size");
+    static const bool ok = true;
+};
+
+static_assert(sizeof(RequestCommon) == 4, "RequestCommon changed size");
+static_assert(sizeof(ResponseCommon) == 4, "ResponseCommon changed size");
+static_assert(sizeof(ClientLease) == 24, "ClientLease changed size");
+static_assert(CheckLayout<Increment, 82, 20>::ok, "");
+static_assert(CheckLayout<MultiOp, 16, 8>::ok, "");
+static_assert(CheckLayout<Read, 42, 24>::ok, "");
+static_assert(CheckLayout<ReadKeysAndValue, 26, 16>::ok, "");
+static_assert(CheckLayout<Remove, 74, 12>::ok, "");
+static_assert(CheckLayout<TxPrepare, 52, 8>::ok, "");
+static_assert(CheckLayout<Write, 77, 12>::ok, "");
+
 Status getStatus(Buffer* buffer);
 const char* serviceTypeSymbol(ServiceType type);
 const char* opcodeSymbol(uint32_t opcode);
 const char* opcodeSymbol(Buffer* buffer);
+bool isShortRpc(Buffer* request);
 
 // --- Magic numbers ---
 
@@ -59,7 +59,7 @@ TEST_F(WireFormatTest, opcodeSymbol_integer) {
             WireFormat::ILLEGAL_RPC_TYPE));
 
     // Test out-of-range values.
-    EXPECT_STREQ("unknown(81)", WireFormat::opcodeSymbol(
+    EXPECT_STREQ("unknown(95)", WireFormat::opcodeSymbol(
             WireFormat::ILLEGAL_RPC_TYPE+1));
 
     // Make sure the next-to-last value is defined (this will fail if
@@ -80,4 +80,30 @@ TEST_F(WireFormatTest, opcodeSymbol_buffer) {
     EXPECT_STREQ("PING", WireFormat::opcodeSymbol(&b));
 }
 
+TEST_F(WireFormatTest, isShortRpc) {
+    Buffer b;
+    EXPECT_FALSE(WireFormat::isShortRpc(&b));
+
+    WireFormat::RequestCommon* header =
+                b.emplaceAppend<WireFormat::RequestCommon>();
+    header->opcode = WireFormat::READ;
+    EXPECT_TRUE(WireFormat::isShortRpc(&b));
+    header->opcode = WireFormat::WRITE;
+    EXPECT_FALSE(WireFormat::isShortRpc(&b));
+
+    // Only small multi-reads are short.
+    b.reset();
+    WireFormat::MultiOp::Request* multiOp =
+                b.emplaceAppend<WireFormat::MultiOp::Request>();
+    multiOp->common.opcode = WireFormat::MULTI_OP;
+    multiOp->type = WireFormat::MultiOp::READ;
+    multiOp->count = 4;
+    EXPECT_TRUE(WireFormat::isShortRpc(&b));
+    multiOp->count = 5;
+    EXPECT_FALSE(WireFormat::isShortRpc(&b));
+    multiOp->count = 1;
+    multiOp->type = WireFormat::MultiOp::WRITE;
+    EXPECT_FALSE(WireFormat::isShortRpc(&b));
+}
+
 }  // namespace RAMCloud
@@ -14,17 +14,25 @@
  */
 
 #include <new>
+#include <algorithm>
+#include <sstream>
 #include "BitOps.h"
 #include "Cycles.h"
 #include "CycleCounter.h"
+#include "DispatchThread.h"
 #include "Fence.h"
 #include "Initialize.h"
 #include "LogProtector.h"
+#include "Object.h"
+#include "PerfEvents.h"
 #include "PerfStats.h"
 #include "RawMetrics.h"
+#include "RpcLatency.h"
 #include "RpcLevel.h"
+#include "RpcTrace.h"
 #include "ShortMacros.h"
 #include "ServerRpcPool.h"
+#include "ThreadPlacement.h"
 #include "TimeTrace.h"
 #include "TimeTraceUtil.h"
 #include "WireFormat.h"
@@ -63,10 +71,41 @@ Syscall* WorkerManager::sys = &defaultSyscall;
 // time it takes to wake up the thread once it has gone to sleep (as of
 // September 2011 this time appears to be as much as 50 microseconds).
 int WorkerManager::pollMicros = 10000;
+
+// See the documentation in WorkerManager.h. Cores are added quickly, since
+// waiting RPCs add directly to latency, but are only given back once they
+// would have gone to sleep anyway (see pollMicros).
+int WorkerManager::scaleUpMicros = 50;
+int WorkerManager::scaleDownMicros = 10000;
+
+__thread WorkerManager* WorkerManager::currentManager = NULL;
+__thread int WorkerManager::blockingDepth = 0;
+
 // The following constant is used to signal a worker thread that
 // it should exit.
 #define WORKER_EXIT reinterpret_cast<Transport::ServerRpc*>(1)
 
+static_assert(PerfStats::RPC_CLASSES == WorkerManager::RPC_CLASS_COUNT,
+        "PerfStats::RPC_CLASSES doesn't match WorkerManager::RpcClass");
+
+// Names of the RpcClasses, as used by setOption.
+static const char* rpcClassNames[WorkerManager::RPC_CLASS_COUNT] =
+        {"critical", "normal", "background"};
+
+/**
+ * Return the RpcClass with a given name (see rpcClassNames), or -1 if
+ * there is no such class.
+ */
+static int
+findRpcClass(const string& name)
+{
+    for (int c = 0; c < WorkerManager::RPC_CLASS_COUNT; c++) {
+        if (name == rpcClassNames[c])
+            return c;
+    }
+    return -1;
+}
+
 /**
  * Construct a WorkerManager.
  *
@@ -77,35 +116,111 @@ int WorkerManager::pollMicros = 10000;
  *      threads doesn't exceed this value. However, in order to prevent
  *      deadlocks, it may occasionally be necessary to go beyond this
  *      limit.
+ * \param numShards
+ *      If nonzero, the key hash space is split into this many equal ranges,
+ *      each served by its own dedicated worker thread (in addition to the
+ *      threads described by maxCores); single-object master requests are
+ *      executed by the worker for their key's range. Zero means all RPCs
+ *      are scheduled on the general worker threads.
+ * \param inlineShortRpcs
+ *      True means short requests (see WireFormat::isShortRpc) are executed
+ *      in the dispatch thread rather than by a worker.
+ * \param minCores
+ *      If nonzero and less than maxCores, the number of RPCs allowed to run
+ *      at once starts at this value and follows the load between it and
+ *      maxCores. Zero means maxCores RPCs are always allowed to run.
+ * \param maxBlocked
+ *      Up to this many general workers that are waiting in a BlockingWait
+ *      don't count towards the limits above, so other RPCs can run while
+ *      they wait; this many additional worker threads are created for
+ *      them. Zero means waiting workers count like any others.
  */
-WorkerManager::WorkerManager(Context* context, uint32_t maxCores)
+WorkerManager::WorkerManager(Context* context, uint32_t maxCores,
+                             uint32_t numShards, bool inlineShortRpcs,
+                             uint32_t minCores, uint32_t maxBlocked)
     : Dispatch::Poller(context->dispatch, "WorkerManager")
     , context(context)
     , levels()
     , busyThreads()
+    , completions(4 * (maxCores + maxBlocked + numShards +
+            RpcLevel::maxLevel()))
+    , completionsOverflowed(0)
+    , incomingRpcs(1024)
     , idleThreads()
     , maxCores(maxCores)
+    , coreLimit(((minCores == 0) || (minCores > maxCores))
+            ? maxCores : minCores)
+    , minCores(coreLimit)
+    , coreCeiling(maxCores)
+    , waitingSince(0)
+    , underusedSince(0)
     , rpcsWaiting(0)
+    , maxBlocked(maxBlocked)
+    , blockedWorkers(0)
+    , lastBlockedWorkers(0)
     , testingSaveRpcs(0)
     , testRpcs()
+    , shards()
+    , busyShardWorkers(0)
+    , inlineShortRpcs(inlineShortRpcs)
+    , opcodeClasses()
+    , tableClasses()
+    , classWeights()
+    , classCredits()
+    , reservedWorkers(0)
+    , waitingReads()
+    , coalescedReads()
+    , prefetcher(NULL)
 {
     levels.resize(RpcLevel::maxLevel() + 1);
 
+    // Client requests that a latency-sensitive client is waiting for are
+    // critical; bulk work that can be stretched out without anyone noticing
+    // is background.
+    for (int i = 0; i < WireFormat::ILLEGAL_RPC_TYPE; i++)
+        opcodeClasses[i] = NORMAL;
+    WireFormat::Opcode critical[] = {WireFormat::READ,
+            WireFormat::READ_KEYS_AND_VALUE, WireFormat::MULTI_OP,
+            WireFormat::WRITE, WireFormat::REMOVE, WireFormat::INCREMENT,
+            WireFormat::CONDITIONAL_UPDATE, WireFormat::APPEND,
+            WireFormat::BACKUP_WRITE};
+    foreach (WireFormat::Opcode opcode, critical)
+        opcodeClasses[opcode] = CRITICAL;
+    WireFormat::Opcode background[] = {WireFormat::RECEIVE_MIGRATION_DATA,
+            WireFormat::MIGRATE_TABLET, WireFormat::SPLIT_AND_MIGRATE_INDEXLET,
+            WireFormat::ENUMERATE, WireFormat::BUILD_INDEX,
+            WireFormat::MODIFY_INDEX_ENTRIES, WireFormat::BULK_LOAD,
+            WireFormat::READ_HASHES, WireFormat::RECOVER,
+            WireFormat::BACKUP_GETRECOVERYDATA};
+    foreach (WireFormat::Opcode opcode, background)
+        opcodeClasses[opcode] = BACKGROUND;
+    classWeights[CRITICAL] = 8;
+    classWeights[NORMAL] = 4;
+    classWeights[BACKGROUND] = 1;
+
     // Create all the worker threads. We create enough threads to
     // execute maxCores RPCs in parallel, *plus* one thread for each
     // RPC level not already in use. This is sufficient to prevent
-    // distributed deadlock over worker threads.
+    // distributed deadlock over worker threads. There are also maxBlocked
+    // threads to run RPCs in place of workers that are blocked.
     //
     // Note: we create threads here rather than waiting until the thread
     // is needed, because thread creation can be quite slow on Linux
     // (> 250ms sometimes, see RAM-343) and a long stall in actually
     // scheduling a thread can cause timeouts.
 
-    for (int i = maxCores + RpcLevel::maxLevel(); i > 0; i--) {
-        Worker* worker = new Worker(context);
-        worker->thread.construct(workerMain, worker);
+    for (int i = maxCores + maxBlocked + RpcLevel::maxLevel(); i > 0; i--) {
+        Worker* worker = new Worker(context, this);
+        worker->thread.construct(workerMain, this, worker);
         idleThreads.push_back(worker);
     }
+
+    for (uint32_t i = 0; i < numShards; i++) {
+        Worker* worker = new Worker(context, this);
+        worker->shard = downCast<int>(i);
+        worker->thread.construct(workerMain, this, worker);
+        shards.emplace_back(worker);
+    }
 }
 
 /**
@@ -123,6 +238,272 @@ WorkerManager::~WorkerManager()
         worker->exit();
         delete worker;
     }
+    foreach (Shard& shard, shards) {
+        shard.worker->exit();
+        delete shard.worker;
+    }
+}
+
+/**
+ * Determine which shard of the key hash space a request should be executed
+ * in, if any.
+ *
+ * \param request
+ *      Incoming request, which must contain at least a RequestCommon header.
+ * \return
+ *      The index in #shards of the shard responsible for the request's key,
+ *      or -1 if the key hash space isn't partitioned or the request should
+ *      be executed by a general worker (it is not a single-object master
+ *      request, or it is malformed, in which case the service will report
+ *      the error).
+ */
+int
+WorkerManager::getShard(Buffer* request)
+{
+    if (shards.empty())
+        return -1;
+
+    // Shards cover equal ranges of the key hash space, so that they line up
+    // with tablet boundaries from even tablet splits.
+    uint64_t keyHash;
+    if (!getKeyHash(request, &keyHash))
+        return -1;
+    return downCast<int>((keyHash >> 32) * shards.size() >> 32);
+}
+
+/**
+ * Find the hash of the key named by a single-object master request (a READ,
+ * WRITE, or REMOVE). This is the hash the client sent with the request, if
+ * any, so the dispatch thread needn't hash the key itself; it is only used
+ * to schedule the request, so a wrong one slows it down but does no harm.
+ *
+ * \param request
+ *      Incoming request, which must contain at least a RequestCommon header.
+ * \param[out] keyHash
+ *      Key::getHash value for the request's key; only set if the return
+ *      value is true.
+ * \return
+ *      True if the request names a single key; false if it is some other
+ *      kind of request, or it is malformed.
+ */
+bool
+WorkerManager::getKeyHash(Buffer* request, uint64_t* keyHash)
+{
+    const WireFormat::RequestCommon* header =
+            request->getStart<WireFormat::RequestCommon>();
+    if (header->service != WireFormat::MASTER_SERVICE)
+        return false;
+
+    uint64_t tableId;
+    const void* key;
+    KeyLength keyLength;
+    if (header->opcode == WireFormat::READ) {
+        const WireFormat::Read::Request* reqHdr =
+                request->getStart<WireFormat::Read::Request>();
+        if (reqHdr == NULL)
+            return false;
+        if (reqHdr->keyHash != 0) {
+            *keyHash = reqHdr->keyHash;
+            return true;
+        }
+        tableId = reqHdr->tableId;
+        keyLength = reqHdr->keyLength;
+        key = request->getRange(sizeof32(*reqHdr), keyLength);
+    } else if (header->opcode == WireFormat::REMOVE) {
+        const WireFormat::Remove::Request* reqHdr =
+                request->getStart<WireFormat::Remove::Request>();
+        if (reqHdr == NULL)
+            return false;
+        if (reqHdr->keyHash != 0) {
+            *keyHash = reqHdr->keyHash;
+            return true;
+        }
+        tableId = reqHdr->tableId;
+        keyLength = reqHdr->keyLength;
+        key = request->getRange(sizeof32(*reqHdr), keyLength);
+    } else if (header->opcode == WireFormat::WRITE) {
+        const WireFormat::Write::Request* reqHdr =
+                request->getStart<WireFormat::Write::Request>();
+        if (reqHdr == NULL)
+            return false;
+        if (reqHdr->keyHash != 0) {
+            *keyHash = reqHdr->keyHash;
+            return true;
+        }
+        tableId = reqHdr->tableId;
+        Object object(tableId, 0, 0, *request, sizeof32(*reqHdr),
+                      reqHdr->length);
+        key = object.getKey(0, &keyLength);
+    } else {
+        return false;
+    }
+    if (key == NULL)
+        return false;
+    *keyHash = Key::getHash(tableId, key, keyLength);
+    return true;
+}
+
+namespace {
+
+/**
+ * Return the table named in the header of a request of type Op, or
+ * ~0 if the request is too short to have one.
+ */
+template<typename Op>
+uint64_t
+getTableId(Buffer* request)
+{
+    const typename Op::Request* reqHdr =
+            request->getStart<typename Op::Request>();
+    return (reqHdr == NULL) ? ~0lu : reqHdr->tableId;
+}
+
+} // anonymous namespace
+
+/**
+ * Determine the priority class of a request: the class configured for its
+ * table, if it is a single-table request for a table that has one, or
+ * otherwise the class of its opcode.
+ *
+ * \param request
+ *      Incoming request, which must contain a RequestCommon header with a
+ *      valid opcode.
+ * \return
+ *      An RpcClass.
+ */
+int
+WorkerManager::getRpcClass(Buffer* request)
+{
+    const WireFormat::RequestCommon* header =
+            request->getStart<WireFormat::RequestCommon>();
+    if (!tableClasses.empty() &&
+            (header->service == WireFormat::MASTER_SERVICE)) {
+        uint64_t tableId;
+        switch (header->opcode) {
+            case WireFormat::READ:
+                tableId = getTableId<WireFormat::Read>(request);
+                break;
+            case WireFormat::READ_KEYS_AND_VALUE:
+                tableId = getTableId<WireFormat::ReadKeysAndValue>(request);
+                break;
+            case WireFormat::WRITE:
+                tableId = getTableId<WireFormat::Write>(request);
+                break;
+            case WireFormat::REMOVE:
+                tableId = getTableId<WireFormat::Remove>(request);
+                break;
+            case WireFormat::INCREMENT:
+                tableId = getTableId<WireFormat::Increment>(request);
+                break;
+            case WireFormat::ENUMERATE:
+                tableId = getTableId<WireFormat::Enumerate>(request);
+                break;
+            default:
+                tableId = ~0lu;
+                break;
+        }
+        std::unordered_map<uint64_t, int>::iterator it =
+                tableClasses.find(tableId);
+        if (it != tableClasses.end())
+            return it->second;
+    }
+    return opcodeClasses[header->opcode];
+}
+
+/**
+ * Return the number of general workers that may be running before an RPC
+ * of a given class has to wait (unless it must run to avoid deadlock).
+ * Workers beyond the limit for the other classes are held for CRITICAL
+ * RPCs.
+ */
+uint32_t
+WorkerManager::getCoreLimit(int rpcClass)
+{
+    if (rpcClass == CRITICAL)
+        return coreLimit;
+    if (reservedWorkers >= coreLimit) {
+        // Too few cores are in use at the moment to hold any back.
+        return coreLimit;
+    }
+    return coreLimit - reservedWorkers;
+}
+
+/**
+ * Choose which class of waiting RPC to start next at one level. The
+ * classes share workers according to #classWeights, interleaved as evenly
+ * as possible (smooth weighted round robin): an idle class doesn't build
+ * up credit, and a class that can't start because of #reservedWorkers
+ * isn't charged for it.
+ *
+ * \param level
+ *      The level whose waiting RPCs to choose from.
+ * \param anyClass
+ *      True means core limits don't apply (no RPC at this level or below
+ *      is running, so one must start to avoid deadlock).
+ * \param running
+ *      The number of general workers currently running RPCs.
+ * \return
+ *      The RpcClass whose oldest waiting RPC should start next, or -1 if
+ *      none of the waiting RPCs can start now.
+ */
+int
+WorkerManager::pickClass(Level* level, bool anyClass, uint32_t running)
+{
+    int result = -1;
+    int64_t totalWeight = 0;
+    for (int c = 0; c < RPC_CLASS_COUNT; c++) {
+        if (level->waitingRpcs.queues[c].empty())
+            continue;
+        if (!anyClass && (running >= getCoreLimit(c)))
+            continue;
+        classCredits[c] += classWeights[c];
+        totalWeight += classWeights[c];
+        if ((result < 0) || (classCredits[c] > classCredits[result]))
+            result = c;
+    }
+    if (result >= 0)
+        classCredits[result] -= totalWeight;
+    return result;
+}
+
+/**
+ * Called when a request has to wait for a worker: if it is for a single
+ * object, start loading the memory it will need (see Prefetcher), so that
+ * memory stalls for waiting requests overlap with each other and with the
+ * requests already executing.
+ *
+ * \param request
+ *      Incoming request, which must contain at least a RequestCommon header.
+ */
+void
+WorkerManager::prefetchRequest(Buffer* request)
+{
+    uint64_t keyHash;
+    if (prefetcher != NULL && getKeyHash(request, &keyHash))
+        prefetcher->prefetch(keyHash);
+}
+
+/**
+ * Record that an RPC is starting on a general worker, for the per-class
+ * statistics in PerfStats.
+ *
+ * \param rpc
+ *      The RPC that is starting.
+ * \param rpcClass
+ *      Its RpcClass.
+ * \param queued
+ *      True means it had to wait for a worker.
+ */
+void
+WorkerManager::countStart(Transport::ServerRpc* rpc, int rpcClass,
+        bool queued)
+{
+    PerfStats::threadStats.rpcClassRpcs[rpcClass]++;
+    if (queued) {
+        PerfStats::threadStats.rpcClassQueued[rpcClass]++;
+        PerfStats::threadStats.rpcClassQueueMicros[rpcClass] +=
+                Cycles::toMicroseconds(Cycles::rdtsc() - rpc->arrivalTime);
+    }
 }
 
 /**
@@ -138,6 +519,18 @@ WorkerManager::~WorkerManager()
 void
 WorkerManager::handleRpc(Transport::ServerRpc* rpc)
 {
+    // RPCs that arrive on the transports of the server's other dispatch
+    // threads are passed to our dispatch thread, which picks them up in
+    // poll and calls us again.
+    DispatchThread* dispatchThread = DispatchThread::getCurrent();
+    if (dispatchThread != NULL) {
+        dispatchThread->forwardRpc(this, rpc);
+        return;
+    }
+
+    rpc->arrivalTime = Cycles::rdtsc();
+    rpc->traceId = RpcTrace::receive(&rpc->requestPayload);
+
     // Find the service for this RPC.
     const WireFormat::RequestCommon* header;
     header = rpc->requestPayload.getStart<WireFormat::RequestCommon>();
@@ -160,9 +553,45 @@ WorkerManager::handleRpc(Transport::ServerRpc* rpc)
             Service::prepareErrorResponse(&rpc->replyPayload,
                     STATUS_UNIMPLEMENTED_REQUEST);
         }
-        rpc->sendReply();
+        DispatchThread::sendReply(rpc);
+        return;
+    }
+
+    // Time spent receiving the request: its packets' queueing in the NIC,
+    // kernel, and driver, and the wait for the rest of its packets.
+    if ((rpc->firstPacketTime != 0) &&
+            (rpc->firstPacketTime < rpc->arrivalTime)) {
+        RpcLatency::record(WireFormat::Opcode(header->opcode),
+                RpcLatency::RECEIVING,
+                rpc->arrivalTime - rpc->firstPacketTime);
+    }
+
+    // Requests for a shard of the key hash space go only to that shard's
+    // worker, in the order they arrived.
+    int shardIndex = getShard(&rpc->requestPayload);
+    if (shardIndex >= 0) {
+        Shard* shard = &shards[shardIndex];
+        if (shard->worker->busyIndex >= 0) {
+            prefetchRequest(&rpc->requestPayload);
+            shard->waitingRpcs.push(rpc);
+            return;
+        }
+        Worker* worker = shard->worker;
+        worker->opcode = WireFormat::Opcode(header->opcode);
+        worker->handoff(rpc);
+        worker->busyIndex = downCast<int>(busyThreads.size());
+        busyThreads.push_back(worker);
+        busyShardWorkers++;
         return;
     }
+
+    // Short requests take less time to execute than a round trip to a
+    // worker thread, so just run them here.
+    if (inlineShortRpcs && WireFormat::isShortRpc(&rpc->requestPayload)) {
+        runInline(rpc);
+        return;
+    }
+
     int level = RpcLevel::getLevel(WireFormat::Opcode(header->opcode));
 #ifdef LOG_RPCS
     LOG(NOTICE, "Received %s RPC at %lu with %u bytes",
@@ -172,49 +601,164 @@ WorkerManager::handleRpc(Transport::ServerRpc* rpc)
 #endif
 
     // See if we should start executing this request. Once we reach our
-    // desired concurrency limit, only start a new request if its level
-    // is lower than that of any other running request. This ensures that
-    // we will always have enough threads to execute one request at
+    // desired concurrency limit (which is lower for classes other than
+    // CRITICAL, if workers are reserved), only start a new request if its
+    // level is lower than that of any other running request. This ensures
+    // that we will always have enough threads to execute one request at
     // each level, and this prevents distributed deadlock (deadlock could
     // occur if all of the servers use up all of their threads on high-level
     // requests, then those requests invoke lower-level RPCs to other
     // servers, but none of the servers have threads to execute those
     // lower-level requests).
-    if (busyThreads.size() >= maxCores) {
+    int rpcClass = getRpcClass(&rpc->requestPayload);
+    if (runningWorkers() >= getCoreLimit(rpcClass)) {
         for (int i = level; i >= 0; i--) {
             if (levels[i].requestsRunning > 0) {
                 // Can't run this request right now.
-                levels[level].waitingRpcs.push(rpc);
+                if (coalesceRead(rpc))
+                    return;
+                prefetchRequest(&rpc->requestPayload);
+                levels[level].waitingRpcs.push(rpc, rpcClass);
                 rpcsWaiting++;
                 return;
             }
         }
     }
 
-    // Temporary code to test how much faster things would be without threads.
-#if 0
-    if ((header->opcode == WireFormat::READ) &&
-            (header->service == WireFormat::MASTER_SERVICE)) {
-        Service::Rpc serviceRpc(NULL, &rpc->requestPayload, &rpc->replyPayload);
-        services[WireFormat::MASTER_SERVICE]->service.handleRpc(&serviceRpc);
-        rpc->sendReply();
-        return;
-    }
-#endif
-
     levels[level].requestsRunning++;
+    countStart(rpc, rpcClass, false);
+    startOnIdleWorker(rpc, level);
+}
 
-    // Hand off the RPC to a worker thread.
+/**
+ * Hand off an RPC to an idle worker thread, which starts executing it.
+ *
+ * \param rpc
+ *      The RPC to execute; its level's requestsRunning must already
+ *      include it.
+ * \param level
+ *      The RPC's RpcLevel.
+ */
+void
+WorkerManager::startOnIdleWorker(Transport::ServerRpc* rpc, int level)
+{
     assert(!idleThreads.empty());
     Worker* worker = idleThreads.back();
     idleThreads.pop_back();
-    worker->opcode = WireFormat::Opcode(header->opcode);
+    worker->opcode = WireFormat::Opcode(rpc->requestPayload
+            .getStart<WireFormat::RequestCommon>()->opcode);
     worker->level = level;
     worker->handoff(rpc);
     worker->busyIndex = downCast<int>(busyThreads.size());
     busyThreads.push_back(worker);
 }
 
+/**
+ * This method is invoked by handleRpc for each request that has to wait for
+ * a worker. If the request is a READ identical to one that is already
+ * waiting, it is attached to that one (which will answer both) instead of
+ * being queued; reads that hot objects receive in bursts then cost a single
+ * hash table lookup and reply.
+ *
+ * Only requests that haven't started executing are coalesced, so every
+ * read still returns a value at least as new as the last write completed
+ * before the read arrived.
+ *
+ * \param rpc
+ *      A request that can't start executing yet.
+ * \return
+ *      True means \a rpc was attached to an identical READ and the caller
+ *      must not queue it; false means it should be queued as usual.
+ */
+bool
+WorkerManager::coalesceRead(Transport::ServerRpc* rpc)
+{
+    const WireFormat::RequestCommon* header =
+            rpc->requestPayload.getStart<WireFormat::RequestCommon>();
+    if (header->opcode != WireFormat::READ)
+        return false;
+    uint32_t length = rpc->requestPayload.size();
+    string request(static_cast<const char*>(
+            rpc->requestPayload.getRange(0, length)), length);
+    std::unordered_map<string, Transport::ServerRpc*>::iterator it =
+            waitingReads.find(request);
+    if (it == waitingReads.end()) {
+        waitingReads[request] = rpc;
+        return false;
+    }
+    coalescedReads[it->second].push_back(rpc);
+    return true;
+}
+
+/**
+ * This method is invoked by poll just before the reply to an RPC is sent;
+ * it sends copies of the reply to all of the READs that coalesceRead
+ * attached to the RPC. The reply is copied rather than shared, since
+ * \a rpc (and any log memory its reply refers to) may be freed as soon as
+ * its own reply has been sent.
+ *
+ * \param rpc
+ *      An RPC that has finished executing.
+ */
+void
+WorkerManager::replyToCoalescedReads(Transport::ServerRpc* rpc)
+{
+    std::unordered_map<Transport::ServerRpc*,
+            std::vector<Transport::ServerRpc*>>::iterator it =
+            coalescedReads.find(rpc);
+    if (it == coalescedReads.end())
+        return;
+    uint32_t length = rpc->replyPayload.size();
+    const void* reply = rpc->replyPayload.getRange(0, length);
+    foreach (Transport::ServerRpc* duplicate, it->second) {
+        duplicate->replyPayload.appendCopy(reply, length);
+        DispatchThread::sendReply(duplicate);
+        PerfStats::threadStats.readCount++;
+        PerfStats::threadStats.readsCoalesced++;
+    }
+    coalescedReads.erase(it);
+}
+
+/**
+ * Execute an RPC in the dispatch thread and send its reply, without
+ * involving a worker thread. This avoids the cache misses of handing
+ * the request to a worker and the reply back, which for short requests
+ * such as a READ cost more than executing the request itself. Only used
+ * for requests that WireFormat::isShortRpc accepts.
+ *
+ * \param rpc
+ *      The RPC to execute.
+ */
+void
+WorkerManager::runInline(Transport::ServerRpc* rpc)
+{
+    // The request may reference log memory, so it must be protected from
+    // the cleaner just as if a worker were executing it.
+    rpc->epoch = LogProtector::getCurrentEpoch();
+    WireFormat::Opcode opcode = WireFormat::Opcode(
+            rpc->requestPayload.getStart<WireFormat::RequestCommon>()->opcode);
+    uint64_t start = Cycles::rdtsc();
+    Service::Rpc serviceRpc(NULL, &rpc->requestPayload, &rpc->replyPayload);
+    PerfStats::HardwareCounts hardwareStart = {};
+    if (opcode == WireFormat::READ)
+        PerfEvents::start(&hardwareStart);
+    RpcTrace::startServerRpc(rpc->traceId, opcode);
+    Service::handleRpc(context, &serviceRpc);
+    RpcTrace::finishServerRpc(opcode);
+    PerfEvents::stop(hardwareStart, &PerfStats::threadStats.readHardware);
+    uint64_t stop = Cycles::rdtsc();
+    RpcLatency::record(opcode, RpcLatency::WAITING, start - rpc->arrivalTime);
+    RpcLatency::record(opcode, RpcLatency::EXECUTING, stop - start);
+
+    // The dispatch thread isn't executing an RPC on anyone's behalf once
+    // this one is done (this matters for RpcLevel::checkCall).
+    RpcLevel::setCurrentOpcode(RpcLevel::NO_RPC);
+    uint64_t arrivalTime = rpc->arrivalTime;
+    DispatchThread::sendReply(rpc);
+    RpcLatency::record(opcode, RpcLatency::TOTAL,
+            Cycles::rdtsc() - arrivalTime);
+}
+
 /**
  * Returns true if there are currently no RPCs being serviced, false
  * if at least one RPC is currently being executed by a worker.  If true
@@ -227,6 +771,28 @@ WorkerManager::idle()
     return busyThreads.empty();
 }
 
+/**
+ * Queue an RPC that arrived on a transport belonging to another dispatch
+ * thread (see DispatchThread); the RPC will be handled by #poll, in this
+ * WorkerManager's dispatch thread. May be invoked from any thread.
+ *
+ * \param rpc
+ *      RPC object containing a fully-formed request that is ready for
+ *      service. Its dispatchThread must be set, so that its reply will be
+ *      sent from there.
+ * \return
+ *      True means the RPC was queued; false means there was no room, and
+ *      the caller should try again later.
+ */
+bool
+WorkerManager::postRpc(Transport::ServerRpc* rpc)
+{
+    if (!incomingRpcs.push(rpc))
+        return false;
+    context->dispatch->wakeup();
+    return true;
+}
+
 /**
  * This method is invoked by Dispatch during its polling loop.  It checks
  * for completion of outstanding RPCs.
@@ -236,99 +802,442 @@ WorkerManager::poll()
 {
     int foundWork = 0;
 
-    // Each iteration of the following loop checks the status of one active
-    // worker. The order of iteration is crucial, since it allows us to
-    // remove a worker from busyThreads in the middle of the loop without
-    // interfering with the remaining iterations.
-    for (int i = downCast<int>(busyThreads.size()) - 1; i >= 0; i--) {
-        Worker* worker = busyThreads[i];
-        assert(worker->busyIndex == i);
-        int state = worker->state.load();
-        if (state == Worker::WORKING) {
-            continue;
-        }
+    // Start on the RPCs that arrived in other dispatch threads (see
+    // postRpc), but not so many that we neglect our own transports.
+    Transport::ServerRpc* rpc;
+    for (size_t i = incomingRpcs.capacity(); i > 0 && incomingRpcs.pop(&rpc);
+            i--) {
+        handleRpc(rpc);
         foundWork = 1;
-        Fence::enter();
-
-        // The worker is either post-processing or idle; in either case,
-        // there may be an RPC that we have to respond to. Save the RPC
-        // information for now.
-        Transport::ServerRpc* rpc = worker->rpc;
-        worker->rpc = NULL;
-
-        // Highest priority: if there are pending requests that are waiting
-        // for workers, hand off a new request to this worker ASAP.
-        bool startedNewRpc = false;
-        if (state != Worker::POSTPROCESSING) {
-            levels[worker->level].requestsRunning--;
-            if (rpcsWaiting) {
-                // Start an RPC with the lowest level (this is most efficient,
-                // since it's more likely that there are other servers with
-                // resources tied up waiting for this RPC).
-                //
-                // In addition, we must observe the core limits, which means
-                // we don't start another RPC unless we have spare cores, or
-                // unless the RPC we would start is at a level lower than any
-                // other running RPC.
-                for (int i = 0; ; i++) {
-                    Level* level = &levels[i];
-                    if ((level->requestsRunning != 0) &&
-                            // Note: we haven't yet removed the current
-                            // thread from busyThreads, so the number of
-                            // running workers is one less than
-                            // busyThreads.size().
-                            (busyThreads.size() > maxCores)) {
-                        // Can't start another RPC without exceeding core
-                        // limits.
-                        break;
-                    }
-                    if (level->waitingRpcs.empty()) {
-                        continue;
-                    }
-                    rpcsWaiting--;
-                    level->requestsRunning++;
-                    worker->level = i;
-                    worker->handoff(level->waitingRpcs.front());
-                    level->waitingRpcs.pop();
-                    startedNewRpc = true;
-                    break;
-                }
+    }
+
+    // Look only at the workers that have announced a change of state. The
+    // limit keeps a worker that finishes RPCs as fast as they are handed
+    // to it from keeping us here forever.
+    Worker* worker;
+    for (size_t i = completions.capacity(); i > 0 && completions.pop(&worker);
+            i--) {
+        foundWork |= checkWorker(worker);
+    }
+
+    // If some worker couldn't announce itself, check every busy worker. The
+    // order of iteration is crucial, since it allows us to remove a worker
+    // from busyThreads in the middle of the loop without interfering with
+    // the remaining iterations.
+    if (completionsOverflowed.load() && completionsOverflowed.exchange(0)) {
+        for (int i = downCast<int>(busyThreads.size()) - 1; i >= 0; i--)
+            foundWork |= checkWorker(busyThreads[i]);
+    }
+
+    if (minCores != coreCeiling)
+        foundWork |= adjustCoreLimit();
+
+    // If more workers have started waiting, waiting RPCs may be able to
+    // run in their place.
+    int blocked = blockedWorkers.load();
+    if (blocked != lastBlockedWorkers) {
+        if ((blocked > lastBlockedWorkers) && rpcsWaiting)
+            foundWork |= startWaitingRpcs();
+        lastBlockedWorkers = blocked;
+    }
+    return foundWork;
+}
+
+/**
+ * Deal with a worker that may have finished its RPC or sent its reply:
+ * send the reply if there is one, and either give the worker another
+ * RPC or make it idle. This method is invoked by poll.
+ *
+ * \param worker
+ *      Worker to check; it may be idle or still working, in which case
+ *      nothing happens.
+ * \return
+ *      1 if the worker needed attention, 0 otherwise.
+ */
+int
+WorkerManager::checkWorker(Worker* worker)
+{
+    if (worker->busyIndex < 0)
+        return 0;
+    assert(busyThreads[worker->busyIndex] == worker);
+    int state = worker->state.load();
+    if (state == Worker::WORKING)
+        return 0;
+    Fence::enter();
+
+    // The worker is either post-processing or idle; in either case,
+    // there may be an RPC that we have to respond to. Save the RPC
+    // information for now.
+    Transport::ServerRpc* rpc = worker->rpc;
+    worker->rpc = NULL;
+
+    // Highest priority: if there are pending requests that are waiting
+    // for workers, hand off a new request to this worker ASAP.
+    bool startedNewRpc = false;
+    if ((worker->shard >= 0) && (state != Worker::POSTPROCESSING)) {
+        // Shard workers only execute requests for their own shard.
+        Shard* shard = &shards[worker->shard];
+        if (!shard->waitingRpcs.empty()) {
+            Transport::ServerRpc* next = shard->waitingRpcs.front();
+            shard->waitingRpcs.pop();
+            worker->opcode = WireFormat::Opcode(next->requestPayload
+                    .getStart<WireFormat::RequestCommon>()->opcode);
+            worker->handoff(next);
+            startedNewRpc = true;
+        }
+    } else if (state != Worker::POSTPROCESSING) {
+        levels[worker->level].requestsRunning--;
+        if (rpcsWaiting) {
+            // Note: we haven't yet removed the current thread from
+            // busyThreads, so the number of running workers is one less
+            // than runningWorkers().
+            int level;
+            Transport::ServerRpc* next = dequeueRpc(
+                    runningWorkers() - 1, &level);
+            if (next != NULL) {
+                worker->level = level;
+                worker->handoff(next);
+                startedNewRpc = true;
             }
         }
+    }
 
-        // Now send the response, if any.
-        if (rpc != NULL) {
+    // Now send the response, if any.
+    if (rpc != NULL) {
 #ifdef LOG_RPCS
-            LOG(NOTICE, "Sending reply for %s at %lu with %u bytes",
-                    WireFormat::opcodeSymbol(&rpc->requestPayload),
-                    reinterpret_cast<uint64_t>(rpc),
-                    rpc->replyPayload.size());
+        LOG(NOTICE, "Sending reply for %s at %lu with %u bytes",
+                WireFormat::opcodeSymbol(&rpc->requestPayload),
+                reinterpret_cast<uint64_t>(rpc),
+                rpc->replyPayload.size());
 #endif
-            rpc->sendReply();
+        if (!coalescedReads.empty())
+            replyToCoalescedReads(rpc);
+        WireFormat::Opcode opcode = WireFormat::Opcode(rpc->requestPayload
+                .getStart<WireFormat::RequestCommon>()->opcode);
+        uint64_t arrivalTime = rpc->arrivalTime;
+        DispatchThread::sendReply(rpc);
+        RpcLatency::record(opcode, RpcLatency::TOTAL,
+                Cycles::rdtsc() - arrivalTime);
 #ifdef SMTT
-            context->timeTrace->record(
-                    TimeTraceUtil::statusMsg(worker->threadId,
-                    worker->opcode, TimeTraceUtil::RequestStatus::REPLY_SENT));
+        context->timeTrace->record(
+                TimeTraceUtil::statusMsg(worker->threadId,
+                worker->opcode, TimeTraceUtil::RequestStatus::REPLY_SENT));
 #endif
 
-        }
+    }
 
-        // If the worker is idle, remove it from busyThreads (fill its
-        // slot with the worker in the last slot).
-        if (!startedNewRpc && (state != Worker::POSTPROCESSING)) {
-            if (worker != busyThreads.back()) {
-                busyThreads[worker->busyIndex] = busyThreads.back();
-                busyThreads[worker->busyIndex]->busyIndex =
-                        worker->busyIndex;
-            }
-            busyThreads.pop_back();
-            worker->busyIndex = -1;
+    // If the worker is idle, remove it from busyThreads (fill its
+    // slot with the worker in the last slot).
+    if (!startedNewRpc && (state != Worker::POSTPROCESSING)) {
+        if (worker != busyThreads.back()) {
+            busyThreads[worker->busyIndex] = busyThreads.back();
+            busyThreads[worker->busyIndex]->busyIndex =
+                    worker->busyIndex;
+        }
+        busyThreads.pop_back();
+        worker->busyIndex = -1;
+        if (worker->shard >= 0) {
+            busyShardWorkers--;
+        } else {
             idleThreads.push_back(worker);
         }
     }
+    return 1;
+}
+
+/**
+ * Return the number of general workers that count against the core limits:
+ * those running RPCs, less those (up to maxBlocked) that are waiting in a
+ * BlockingWait.
+ */
+uint32_t
+WorkerManager::runningWorkers()
+{
+    uint32_t running = downCast<uint32_t>(busyThreads.size())
+            - busyShardWorkers;
+    uint32_t blocked = std::min(maxBlocked,
+            static_cast<uint32_t>(std::max(blockedWorkers.load(), 0)));
+
+    // Blocked workers are always busy, but the count of them may be
+    // slightly ahead of busyThreads.
+    return (blocked < running) ? running - blocked : 0;
+}
+
+/**
+ * Start as many waiting RPCs as the core limits allow on idle workers.
+ *
+ * \return
+ *      1 if any RPCs were started, 0 otherwise.
+ */
+int
+WorkerManager::startWaitingRpcs()
+{
+    uint32_t running = runningWorkers();
+    int foundWork = 0;
+    while (!idleThreads.empty()) {
+        int level;
+        Transport::ServerRpc* rpc = dequeueRpc(running, &level);
+        if (rpc == NULL)
+            break;
+        startOnIdleWorker(rpc, level);
+        running++;
+        foundWork = 1;
+    }
     return foundWork;
 }
 
+/**
+ * This method is invoked by poll when the number of cores follows the
+ * load. It allows one more RPC to run at once if RPCs have been waiting for
+ * workers for scaleUpMicros, and one fewer if fewer than #coreLimit RPCs
+ * have been running for scaleDownMicros.
+ *
+ * \return
+ *      1 if any RPCs were started, 0 otherwise.
+ */
+int
+WorkerManager::adjustCoreLimit()
+{
+    uint32_t running = runningWorkers();
+    uint64_t now = Cycles::rdtsc();
+    if (rpcsWaiting == 0) {
+        waitingSince = 0;
+    } else if (waitingSince == 0) {
+        waitingSince = now;
+    }
+    if (running >= coreLimit) {
+        underusedSince = 0;
+    } else if (underusedSince == 0) {
+        underusedSince = now;
+    }
+
+    if ((waitingSince != 0) && (coreLimit < coreCeiling) &&
+            (now - waitingSince >= Cycles::fromMicroseconds(scaleUpMicros))) {
+        coreLimit++;
+        waitingSince = now;
+        return startWaitingRpcs();
+    }
+    if ((underusedSince != 0) && (coreLimit > minCores) &&
+            (now - underusedSince >=
+            Cycles::fromMicroseconds(scaleDownMicros))) {
+        coreLimit--;
+        underusedSince = now;
+    }
+    return 0;
+}
+
+/**
+ * Remove the waiting RPC that should start next from its queue, if any RPC
+ * may start now. RPCs with the lowest level start first (this is most
+ * efficient, since it's more likely that there are other servers with
+ * resources tied up waiting for them); within a level, pickClass chooses
+ * between the priority classes.
+ *
+ * In addition, we must observe the core limits, which means we don't start
+ * another RPC unless we have spare cores (for its class), or unless the RPC
+ * we would start is at a level lower than any other running RPC.
+ *
+ * \param running
+ *      The number of general workers currently running RPCs.
+ * \param[out] level
+ *      The level of the RPC returned.
+ * \return
+ *      The RPC to start, which is counted in its level's requestsRunning,
+ *      or NULL if no waiting RPC may start now.
+ */
+Transport::ServerRpc*
+WorkerManager::dequeueRpc(uint32_t running, int* level)
+{
+    bool lowerRunning = false;
+    for (uint32_t i = 0; i < levels.size(); i++) {
+        Level* candidate = &levels[i];
+        if (candidate->requestsRunning != 0)
+            lowerRunning = true;
+        if (lowerRunning && (running >= coreLimit)) {
+            // Can't start another RPC without exceeding core limits.
+            break;
+        }
+        if (candidate->waitingRpcs.empty()) {
+            continue;
+        }
+        int rpcClass = pickClass(candidate, !lowerRunning, running);
+        if (rpcClass < 0) {
+            continue;
+        }
+        Transport::ServerRpc* rpc = candidate->waitingRpcs.pop(rpcClass);
+        rpcsWaiting--;
+        candidate->requestsRunning++;
+        *level = downCast<int>(i);
+        startWaitingRpc(rpc);
+        countStart(rpc, rpcClass, true);
+        return rpc;
+    }
+    return NULL;
+}
+
+/**
+ * Return the number of RPCs waiting for a worker. This may be invoked from
+ * any thread; outside the dispatch thread the result may be slightly out of
+ * date.
+ */
+int
+WorkerManager::getWaitingRpcCount()
+{
+    return *static_cast<volatile int*>(&rpcsWaiting);
+}
+
+/**
+ * Change how RPCs are divided between priority classes and how workers are
+ * shared between the classes. This may be invoked from any thread. The
+ * following options are recognized:
+ *
+ * - rpcClassWeights: one weight (a positive integer) for each class, in
+ *   the order critical, normal, background, such as "8 4 1".
+ * - reservedWorkers: how many of the maxCores workers to hold for critical
+ *   RPCs (at most maxCores - 1).
+ * - minWorkerCores, maxWorkerCores: the range within which the number of
+ *   RPCs allowed to run at once follows the load (at least 1, and at most
+ *   the maxCores given to the constructor). Setting them equal fixes the
+ *   number; a machine-wide core manager can lower maxWorkerCores to take
+ *   cores away from a busy server.
+ * - rpcOpcodeClasses: a list of opcode:class pairs to change, such as
+ *   "READ:critical ENUMERATE:background"; opcodes are named as in
+ *   WireFormat::opcodeSymbol.
+ * - rpcTableClasses: a list of tableId:class pairs, such as
+ *   "12:background", which replaces any earlier ones. Requests for these
+ *   tables have the given class regardless of their opcode.
+ *
+ * \param option
+ *      Name of the option to change.
+ * \param value
+ *      The option's new value.
+ * \return
+ *      True means the option was changed; false means the option or its
+ *      value wasn't recognized, and nothing was changed.
+ */
+bool
+WorkerManager::setOption(const char* option, const char* value)
+{
+    std::istringstream in(value);
+    string name(option);
+    string item;
+    if (name == "rpcClassWeights") {
+        int weights[RPC_CLASS_COUNT];
+        for (int c = 0; c < RPC_CLASS_COUNT; c++) {
+            if (!(in >> weights[c]) || (weights[c] < 1))
+                return false;
+        }
+        if (in >> item)
+            return false;
+        Dispatch::Lock lock(context->dispatch);
+        for (int c = 0; c < RPC_CLASS_COUNT; c++) {
+            classWeights[c] = weights[c];
+            classCredits[c] = 0;
+        }
+    } else if (name == "reservedWorkers") {
+        uint32_t reserved;
+        if (!(in >> reserved) || (reserved >= maxCores) || (in >> item))
+            return false;
+        Dispatch::Lock lock(context->dispatch);
+        reservedWorkers = reserved;
+    } else if ((name == "minWorkerCores") || (name == "maxWorkerCores")) {
+        uint32_t cores;
+        if (!(in >> cores) || (cores < 1) || (cores > maxCores) ||
+                (in >> item))
+            return false;
+        Dispatch::Lock lock(context->dispatch);
+        if (name == "minWorkerCores") {
+            minCores = cores;
+            coreCeiling = std::max(coreCeiling, cores);
+        } else {
+            coreCeiling = cores;
+            minCores = std::min(minCores, cores);
+        }
+        coreLimit = std::min(std::max(coreLimit, minCores), coreCeiling);
+        waitingSince = 0;
+        underusedSince = 0;
+    } else if (name == "rpcOpcodeClasses") {
+        std::vector<std::pair<int, int>> changes;
+        while (in >> item) {
+            size_t colon = item.find(':');
+            if (colon == string::npos)
+                return false;
+            string opcodeName = item.substr(0, colon);
+            int opcode = 0;
+            while ((opcode < WireFormat::ILLEGAL_RPC_TYPE) &&
+                    (opcodeName != WireFormat::opcodeSymbol(
+                    downCast<uint32_t>(opcode)))) {
+                opcode++;
+            }
+            int rpcClass = findRpcClass(item.substr(colon + 1));
+            if ((opcode == WireFormat::ILLEGAL_RPC_TYPE) || (rpcClass < 0))
+                return false;
+            changes.emplace_back(opcode, rpcClass);
+        }
+        Dispatch::Lock lock(context->dispatch);
+        foreach (auto& change, changes)
+            opcodeClasses[change.first] = downCast<uint8_t>(change.second);
+    } else if (name == "rpcTableClasses") {
+        std::unordered_map<uint64_t, int> classes;
+        while (in >> item) {
+            size_t colon = item.find(':');
+            if (colon == string::npos)
+                return false;
+            char* end;
+            uint64_t tableId = strtoul(item.c_str(), &end, 0);
+            int rpcClass = findRpcClass(item.substr(colon + 1));
+            if ((end != item.c_str() + colon) || (colon == 0) ||
+                    (rpcClass < 0))
+                return false;
+            classes[tableId] = rpcClass;
+        }
+        Dispatch::Lock lock(context->dispatch);
+        tableClasses.swap(classes);
+    } else {
+        return false;
+    }
+    LOG(NOTICE, "Set worker option %s to \"%s\"", option, value);
+    return true;
+}
+
+/**
+ * Provide something to start loading the memory needed by single-object
+ * requests while they wait for a worker (see Prefetcher). May be invoked
+ * in any thread.
+ *
+ * \param prefetcher
+ *      Invoked in the dispatch thread for each READ, WRITE, or REMOVE that
+ *      has to wait; NULL means no prefetching.
+ */
+void
+WorkerManager::setPrefetcher(Prefetcher* prefetcher)
+{
+    Dispatch::Lock lock(context->dispatch);
+    this->prefetcher = prefetcher;
+}
+
+/**
+ * This method is invoked by poll when a request that was waiting for a
+ * worker is about to start executing. From now on identical READs must
+ * not be coalesced with it, since they may have arrived after a write
+ * that it doesn't see.
+ *
+ * \param rpc
+ *      The request that is about to start.
+ */
+void
+WorkerManager::startWaitingRpc(Transport::ServerRpc* rpc)
+{
+    if (waitingReads.empty())
+        return;
+    if (rpc->requestPayload.getStart<WireFormat::RequestCommon>()->opcode
+            != WireFormat::READ)
+        return;
+    uint32_t length = rpc->requestPayload.size();
+    waitingReads.erase(string(static_cast<const char*>(
+            rpc->requestPayload.getRange(0, length)), length));
+}
+
 /**
  * Wait for an RPC request to appear in the testRpcs queue, but give up if
  * it takes too long.  This method is intended only for testing (it only
@@ -362,14 +1271,19 @@ WorkerManager::waitForRpc(double timeoutSeconds) {
  * an RPC to be assigned to it, then executes that RPC and communicates its
  * completion back to the dispatch thread.
  *
+ * \param manager
+ *      The WorkerManager the worker belongs to.
  * \param worker
  *      Pointer to information used to communicate between the worker thread
  *      and the dispatch thread.
  */
 void
-WorkerManager::workerMain(Worker* worker)
+WorkerManager::workerMain(WorkerManager* manager, Worker* worker)
 {
     PerfStats::registerStats(&PerfStats::threadStats);
+    ThreadPlacement::place(ThreadPlacement::WORKER);
+    if (worker->shard < 0)
+        currentManager = manager;
 
     // Cycles::rdtsc time that's updated continuously when this thread is idle.
     // Used to keep track of how much time this thread spends doing useful
@@ -428,9 +1342,24 @@ WorkerManager::workerMain(Worker* worker)
 #endif
 
             worker->rpc->epoch = LogProtector::getCurrentEpoch();
+            uint64_t start = Cycles::rdtsc();
+            RpcLatency::record(worker->opcode, RpcLatency::WAITING,
+                    start - worker->rpc->arrivalTime);
             Service::Rpc rpc(worker, &worker->rpc->requestPayload,
                     &worker->rpc->replyPayload);
+            PerfStats::HardwareCounts hardwareStart = {};
+            PerfEvents::start(&hardwareStart);
+            RpcTrace::startServerRpc(worker->rpc->traceId, worker->opcode);
             Service::handleRpc(worker->context, &rpc);
+            RpcTrace::finishServerRpc(worker->opcode);
+            PerfEvents::stop(hardwareStart,
+                    &PerfStats::threadStats.workerHardware);
+            if (worker->opcode == WireFormat::READ) {
+                PerfEvents::stop(hardwareStart,
+                        &PerfStats::threadStats.readHardware);
+            }
+            RpcLatency::record(worker->opcode, RpcLatency::EXECUTING,
+                    Cycles::rdtsc() - start);
 
             // Pass the RPC back to the dispatch thread for completion.
             Fence::leave();
@@ -441,6 +1370,8 @@ WorkerManager::workerMain(Worker* worker)
                     TimeTraceUtil::RequestStatus::WORKER_DONE));
 #endif
             worker->state.store(Worker::POLLING);
+            worker->notifyManager();
+            worker->context->dispatch->wakeup();
 
             // Update performance statistics.
             uint64_t current = Cycles::rdtsc();
@@ -457,6 +1388,31 @@ WorkerManager::workerMain(Worker* worker)
     }
 }
 
+/**
+ * Announce that the current thread is about to wait (see BlockingWait).
+ */
+WorkerManager::BlockingWait::BlockingWait()
+    : manager(NULL)
+{
+    if (blockingDepth++ != 0)
+        return;
+    manager = currentManager;
+    if (manager != NULL) {
+        manager->blockedWorkers.add(1);
+        manager->context->dispatch->wakeup();
+    }
+}
+
+/**
+ * Announce that the current thread's wait is over.
+ */
+WorkerManager::BlockingWait::~BlockingWait()
+{
+    blockingDepth--;
+    if (manager != NULL)
+        manager->blockedWorkers.add(-1);
+}
+
 /**
  * Force this worker's thread to exit (and don't return until it has exited).
  * This method is only used during testing and WorkerManager destruction.
@@ -527,6 +1483,27 @@ Worker::handoff(Transport::ServerRpc* newRpc)
     }
 }
 
+/**
+ * Take over responsibility for returning this worker's RPC to its client:
+ * the dispatch thread will not send the reply when the worker finishes, so
+ * the caller must eventually pass the returned RPC to
+ * DispatchThread::sendReply (in the dispatch thread). As far as the worker
+ * is concerned, the reply has been
+ * sent, just as if #sendReply had been invoked. This method should only be
+ * invoked in the worker thread, and not after #sendReply.
+ *
+ * \return
+ *      The RPC whose reply is now the caller's responsibility.
+ */
+Transport::ServerRpc*
+Worker::deferReply()
+{
+    Transport::ServerRpc* deferred = rpc;
+    rpc = NULL;
+    sendReply();
+    return deferred;
+}
+
 /**
  * Tell the dispatch thread that this worker has finished processing its RPC,
  * so it is safe to start sending the reply.  This method should only be
@@ -537,6 +1514,7 @@ Worker::sendReply()
 {
     Fence::leave();
     state.store(POSTPROCESSING);
+    notifyManager();
 #ifdef SMTTXX
     context->timeTrace->record(
             TimeTraceUtil::statusMsg(threadId,
@@ -545,6 +1523,20 @@ Worker::sendReply()
 }
 
 
+/**
+ * Tell the WorkerManager's poller that #state has just changed, so that it
+ * will check this worker. This method should only be invoked in the worker
+ * thread.
+ */
+void
+Worker::notifyManager()
+{
+    if (manager == NULL)
+        return;
+    if (!manager->completions.push(this))
+        manager->completionsOverflowed.store(1);
+}
+
 /**
  * Returns true if this worker has already sent a reply back to the client,
  * false otherwise.
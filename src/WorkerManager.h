@@ -17,8 +17,10 @@
 #define RAMCLOUD_WORKERMANAGER_H
 
 #include <queue>
+#include <unordered_map>
 
 #include "Dispatch.h"
+#include "MpscRing.h"
 #include "Service.h"
 #include "Transport.h"
 #include "WireFormat.h"
@@ -33,17 +35,115 @@ namespace RAMCloud {
  * RAMCloud services.  It also implements an asynchronous interface between
  * the dispatch thread (which manages all of the network connections for a
  * server and runs Transport code) and the worker threads.
+ *
+ * Optionally, the key hash space can be partitioned into shards, each with
+ * its own dedicated worker thread. In this mode single-object requests to
+ * the master service (reads, writes and removes) are always executed by the
+ * worker for the shard containing their key hash, so each shard's hash
+ * table buckets and objects stay in one core's cache and operations on a
+ * given shard never contend with each other. All other requests are
+ * scheduled on the general worker pool as usual.
+ *
+ * Each RPC for the general pool also belongs to a priority class (see
+ * RpcClass), chosen by its opcode or by the table it is for. RPCs that have
+ * to wait for a worker are queued separately by class, and when a worker
+ * becomes free the classes share it in proportion to their weights. Some of
+ * the maxCores workers can be reserved for the CRITICAL class, so that
+ * background work such as migration or enumeration can't occupy every core
+ * while reads wait. The classes, weights and reservation can be changed
+ * while the server is running (see setOption).
+ *
+ * The number of general workers allowed to run at once can also follow the
+ * load, between a minimum and maxCores (see the constructor): it grows by
+ * one whenever RPCs have been waiting for a worker for scaleUpMicros, and
+ * shrinks by one whenever a core has gone unused for scaleDownMicros.
+ * Unused workers go to sleep, so an idle server gives its cores back to
+ * other work on the machine. Something that manages cores for the whole
+ * machine can also lower the ceiling on a running server (see setOption).
+ *
+ * Some handlers spend much of their time waiting rather than computing,
+ * for example on log replication or on RPCs to other servers. Such waits
+ * are marked with a BlockingWait; while a general worker is inside one it
+ * doesn't count against the core limit, so another RPC can start in its
+ * place (up to the number of extra threads given to the constructor). This
+ * keeps the cores busy with runnable handlers instead of capping the
+ * server's concurrency at the number of threads that are allowed to run.
+ *
+ * While single-object requests wait for a worker (or for their shard's
+ * worker), the dispatch thread can ask a Prefetcher to start loading the
+ * memory they will need, so that the cache misses of queued requests
+ * overlap instead of each worker taking them one request at a time.
  */
 class WorkerManager : Dispatch::Poller {
   public:
-    explicit WorkerManager(Context* context, uint32_t maxCores = 3);
+    explicit WorkerManager(Context* context, uint32_t maxCores = 3,
+                           uint32_t numShards = 0,
+                           bool inlineShortRpcs = false,
+                           uint32_t minCores = 0,
+                           uint32_t maxBlocked = 0);
     ~WorkerManager();
 
+    /**
+     * Constructing one of these in a worker thread announces that the
+     * worker's RPC is about to wait for something other than the CPU (such
+     * as replication or a nested RPC), and destroying it announces that
+     * the wait is over. While a general worker is waiting, the
+     * WorkerManager may start another RPC in its place. Elsewhere (in the
+     * dispatch thread, shard workers, or other threads) this does nothing,
+     * as do BlockingWaits nested inside another one.
+     */
+    class BlockingWait {
+      public:
+        BlockingWait();
+        ~BlockingWait();
+
+      PRIVATE:
+        /// The WorkerManager told about this wait, or NULL if none was.
+        WorkerManager* manager;
+
+        DISALLOW_COPY_AND_ASSIGN(BlockingWait);
+    };
+
+    /**
+     * Something that can start loading the memory a request for a given key
+     * will touch (such as the key's hash table bucket), usually with
+     * prefetch instructions. See setPrefetcher.
+     */
+    class Prefetcher {
+      public:
+        virtual ~Prefetcher() {}
+
+        /**
+         * Invoked in the dispatch thread when a READ, WRITE, or REMOVE
+         * request has to wait for a worker. This must be fast, must not
+         * block, and must tolerate running concurrently with workers
+         * modifying the data involved.
+         *
+         * \param keyHash
+         *      Key::getHash value for the request's key.
+         */
+        virtual void prefetch(uint64_t keyHash) = 0;
+    };
+
+    /// Priority classes for RPCs executed by general workers.
+    enum RpcClass {
+        CRITICAL = 0,                  /// Latency-sensitive requests from
+                                       /// clients, such as reads and writes.
+        NORMAL = 1,                    /// Anything not in another class.
+        BACKGROUND = 2,                /// Bulk work that can wait, such as
+                                       /// migration and enumeration.
+        RPC_CLASS_COUNT = 3
+    };
+
     void exitWorker();
+    int getWaitingRpcCount();
     void handleRpc(Transport::ServerRpc* rpc);
     bool idle();
     static void init();
     int poll();
+    bool postRpc(Transport::ServerRpc* rpc);
+    bool setOption(const char* option, const char* value);
+    void setPrefetcher(Prefetcher* prefetcher);
     void setServerId(ServerId serverId);
     Transport::ServerRpc* waitForRpc(double timeoutSeconds);
 
@@ -57,6 +157,13 @@ class WorkerManager : Dispatch::Poller {
     /// testing.
     static int pollMicros;
 
+    /// When the number of cores follows the load, one more worker may run
+    /// once RPCs have been waiting this many microseconds, and one fewer
+    /// once a core has been unused for this many microseconds. The values
+    /// of these variables are typically not modified except during testing.
+    static int scaleUpMicros;
+    static int scaleDownMicros;
+
     /// Shared RAMCloud information.
     Context* context;
 
@@ -65,11 +172,37 @@ class WorkerManager : Dispatch::Poller {
     // for servicing RPCs, we queue RPCs according to their level.
     class Level {
       public:
+        // Requests that cannot execute until a thread becomes available,
+        // in a separate queue for each RpcClass.
+        class WaitingRpcs {
+          public:
+            WaitingRpcs()
+                : queues()
+                , count(0)
+            {}
+            bool empty() const { return count == 0; }
+            size_t size() const { return count; }
+            void
+            push(Transport::ServerRpc* rpc, int rpcClass)
+            {
+                queues[rpcClass].push(rpc);
+                count++;
+            }
+            Transport::ServerRpc*
+            pop(int rpcClass)
+            {
+                Transport::ServerRpc* rpc = queues[rpcClass].front();
+                queues[rpcClass].pop();
+                count--;
+                return rpc;
+            }
+            std::queue<Transport::ServerRpc*> queues[RPC_CLASS_COUNT];
+            size_t count;              /// Total size of #queues.
+        };
+
         int requestsRunning;           /// The number of RPCs at this level
                                        /// that are currently executing.
-        std::queue<Transport::ServerRpc*> waitingRpcs;
-                                       /// Requests that cannot execute until
-                                       /// a thread becomes available.
+        WaitingRpcs waitingRpcs;
         explicit Level()
             : requestsRunning(0)
             , waitingRpcs()
@@ -80,20 +213,69 @@ class WorkerManager : Dispatch::Poller {
     // Worker threads that are currently executing RPCs (no particular order).
     std::vector<Worker*> busyThreads;
 
+    // Workers push themselves here whenever they finish with an RPC (or
+    // send its reply early), so that poll only has to look at the workers
+    // that need attention rather than at all of busyThreads. A worker may
+    // appear more than once, or after it has already been dealt with;
+    // poll ignores such entries.
+    MpscRing<Worker*> completions;
+
+    // Set by a worker that couldn't push itself on #completions because it
+    // was full; poll then checks every busy worker.
+    Atomic<int> completionsOverflowed;
+
+    // RPCs that arrived on the transports of other dispatch threads (see
+    // postRpc) and haven't been looked at by poll yet.
+    MpscRing<Transport::ServerRpc*> incomingRpcs;
+
     // Worker threads that are available to execute incoming RPCs.  Threads
     // are push_back'ed and pop_back'ed (the thread with highest index was
     // the last one to go idle, so it's most likely to be POLLING and thus
     // offer a fast wakeup).
     std::vector<Worker*> idleThreads;
 
+    // The largest value #coreLimit can have; enough worker threads are
+    // created to run this many RPCs at once (plus those needed to avoid
+    // deadlock).
+    uint32_t maxCores;
+
     // Once the number of worker threads reaches this value, new RPCs will
     // only start executing if that is needed to provide a distributed
-    // deadlock; other RPCs will wait until some threads finish.
-    uint32_t maxCores;
+    // deadlock; other RPCs will wait until some threads finish. This stays
+    // between #minCores and #coreCeiling, and follows the load between them
+    // (see adjustCoreLimit).
+    uint32_t coreLimit;
+
+    // Smallest and largest values adjustCoreLimit may choose for
+    // #coreLimit; 1 <= minCores <= coreCeiling <= maxCores. They are equal
+    // if the number of cores doesn't follow the load.
+    uint32_t minCores;
+    uint32_t coreCeiling;
+
+    // Cycles::rdtsc time when RPCs started waiting for workers (or when
+    // #coreLimit last grew, if later), or 0 if no RPCs are waiting.
+    uint64_t waitingSince;
+
+    // Cycles::rdtsc time when fewer than #coreLimit workers started being
+    // busy (or when #coreLimit last shrank, if later), or 0 if all of them
+    // are busy.
+    uint64_t underusedSince;
 
     // Total number of RPCs (across all Levels) in waitingRpcs queues.
     int rpcsWaiting;
 
+    // At most this many general workers in a BlockingWait are left out
+    // when counting workers against #coreLimit; this many extra worker
+    // threads exist so that other RPCs can run in their place.
+    uint32_t maxBlocked;
+
+    // The number of general workers currently in a BlockingWait. Modified
+    // by worker threads.
+    Atomic<int> blockedWorkers;
+
+    // The value of #blockedWorkers when poll last looked at it.
+    int lastBlockedWorkers;
+
     // Nonzero means save incoming RPCs rather than executing them.
     // Intended for use in unit tests only.
     int testingSaveRpcs;
@@ -102,9 +284,102 @@ class WorkerManager : Dispatch::Poller {
     // queued here, not sent to workers.
     std::queue<Transport::ServerRpc*> testRpcs;
 
-    static void workerMain(Worker* worker);
+    // Information about one shard of the key hash space, when the key hash
+    // space is partitioned (see the constructor).
+    class Shard {
+      public:
+        Worker* worker;                /// The only worker that executes
+                                       /// requests for this shard.
+        std::queue<Transport::ServerRpc*> waitingRpcs;
+                                       /// Requests for this shard that
+                                       /// arrived while #worker was busy, in
+                                       /// the order they arrived.
+        explicit Shard(Worker* worker)
+            : worker(worker)
+            , waitingRpcs()
+        {}
+        Shard(const Shard&) = default;
+        Shard& operator=(const Shard&) = default;
+    };
+
+    // One entry for each shard of the key hash space; empty if the key hash
+    // space isn't partitioned. Shard i covers the i'th of shards.size()
+    // equal ranges of key hashes.
+    std::vector<Shard> shards;
+
+    // The number of shard workers currently in busyThreads. These workers
+    // don't count towards maxCores.
+    uint32_t busyShardWorkers;
+
+    // True means requests for which WireFormat::isShortRpc returns true
+    // are executed directly in the dispatch thread rather than being
+    // handed off to a worker (unless they belong to a shard).
+    bool inlineShortRpcs;
+
+    // The RpcClass of each opcode's requests, unless #tableClasses says
+    // otherwise.
+    uint8_t opcodeClasses[WireFormat::ILLEGAL_RPC_TYPE];
+
+    // RpcClass of requests for particular tables (which usually belong to
+    // particular tenants), for requests whose headers name a single table
+    // (see getRpcClass).
+    std::unordered_map<uint64_t, int> tableClasses;
+
+    // Relative share of free workers each RpcClass gets when requests of
+    // several classes are waiting; never less than 1.
+    int classWeights[RPC_CLASS_COUNT];
+
+    // Used by pickClass to share workers according to #classWeights: each
+    // time a class is passed over its credit grows by its weight, and the
+    // waiting class with the most credit goes next.
+    int64_t classCredits[RPC_CLASS_COUNT];
+
+    // This many of the maxCores workers are only used by CRITICAL RPCs
+    // (unless an RPC must run to avoid deadlock); always less than
+    // maxCores.
+    uint32_t reservedWorkers;
+
+    // READ requests currently in a Level's waitingRpcs, indexed by the
+    // contents of their request messages (see coalesceRead).
+    std::unordered_map<string, Transport::ServerRpc*> waitingReads;
+
+    // For each READ that is (or was) in waitingReads, the identical READs
+    // that arrived while it was waiting. They aren't executed; instead they
+    // get copies of its reply.
+    std::unordered_map<Transport::ServerRpc*,
+            std::vector<Transport::ServerRpc*>> coalescedReads;
+
+    // Invoked for single-object requests that have to wait for a worker;
+    // NULL if none has been set (see setPrefetcher).
+    Prefetcher* prefetcher;
+
+    int adjustCoreLimit();
+    int checkWorker(Worker* worker);
+    bool coalesceRead(Transport::ServerRpc* rpc);
+    void countStart(Transport::ServerRpc* rpc, int rpcClass, bool queued);
+    Transport::ServerRpc* dequeueRpc(uint32_t running, int* level);
+    uint32_t getCoreLimit(int rpcClass);
+    static bool getKeyHash(Buffer* request, uint64_t* keyHash);
+    int getRpcClass(Buffer* request);
+    int getShard(Buffer* request);
+    int pickClass(Level* level, bool anyClass, uint32_t running);
+    void prefetchRequest(Buffer* request);
+    uint32_t runningWorkers();
+    void replyToCoalescedReads(Transport::ServerRpc* rpc);
+    void runInline(Transport::ServerRpc* rpc);
+    void startWaitingRpc(Transport::ServerRpc* rpc);
+    void startOnIdleWorker(Transport::ServerRpc* rpc, int level);
+    int startWaitingRpcs();
+    static void workerMain(WorkerManager* manager, Worker* worker);
     static Syscall *sys;
 
+    // In a general worker thread, the WorkerManager it belongs to; NULL
+    // in all other threads.
+    static __thread WorkerManager* currentManager;
+
+    // The number of BlockingWaits currently in existence in this thread.
+    static __thread int blockingDepth;
+
     friend class Worker;
     DISALLOW_COPY_AND_ASSIGN(WorkerManager);
 };
@@ -122,11 +397,14 @@ class Worker {
   typedef RAMCloud::Perf::ReadThreadingCost_MetricSet
       ReadThreadingCost_MetricSet;
   public:
+    Transport::ServerRpc* deferReply();
     bool replySent();
     void sendReply();
 
   PRIVATE:
     Context* context;                  /// Shared RAMCloud information.
+    WorkerManager* manager;            /// The WorkerManager this worker
+                                       /// belongs to, or NULL (during tests).
     Tub<std::thread> thread;           /// Thread that executes this worker.
   public:
     int threadId;                      /// Identifier for this thread, assigned
@@ -142,6 +420,10 @@ class Worker {
     int busyIndex;                     /// Location of this worker in
                                        /// #busyThreads, or -1 if this worker
                                        /// is idle.
+    int shard;                         /// Index in WorkerManager::shards of
+                                       /// the shard this worker is dedicated
+                                       /// to, or -1 if it is a general
+                                       /// worker.
     Atomic<int> state;                 /// Shared variable used to pass RPCs
                                        /// between the dispatch thread and this
                                        /// worker.
@@ -179,20 +461,23 @@ class Worker {
     bool exited;                       /// True means the worker is no longer
                                        /// running.
 
-    explicit Worker(Context* context)
+    explicit Worker(Context* context, WorkerManager* manager = NULL)
             : context(context)
+            , manager(manager)
             , thread()
             , threadId(ThreadId::get())
             , opcode(WireFormat::Opcode::ILLEGAL_RPC_TYPE)
             , level(0)
             , rpc(NULL)
             , busyIndex(-1)
+            , shard(-1)
             , state(POLLING)
             , exited(false),
             threadWork(&ReadThreadingCost_MetricSet::threadWork, false)
         {}
     void exit();
     void handoff(Transport::ServerRpc* rpc);
+    void notifyManager();
 
   public:
     ReadThreadingCost_MetricSet::Interval threadWork;
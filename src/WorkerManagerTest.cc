@@ -18,6 +18,7 @@
 #include "MockService.h"
 #include "MockSyscall.h"
 #include "MockTransport.h"
+#include "Object.h"
 #include "RpcLevel.h"
 #include "Tub.h"
 #include "WorkerManager.h"
@@ -35,6 +36,8 @@ class WorkerManagerTest : public ::testing::Test {
     TestLog::Enable logEnabler;
     Syscall *savedSyscall;
     MockSyscall sys;
+    int savedScaleUpMicros;
+    int savedScaleDownMicros;
 
     WorkerManagerTest()
         : context()
@@ -44,6 +47,8 @@ class WorkerManagerTest : public ::testing::Test {
         , logEnabler()
         , savedSyscall(NULL)
         , sys()
+        , savedScaleUpMicros(WorkerManager::scaleUpMicros)
+        , savedScaleDownMicros(WorkerManager::scaleDownMicros)
     {
         static uint8_t levels[] = {0, 1, 2, 0, 1, 2};
         manager.construct(&context, 2);
@@ -62,6 +67,8 @@ class WorkerManagerTest : public ::testing::Test {
         // the worker thread is still using them.
         manager.destroy();
         WorkerManager::sys = savedSyscall;
+        WorkerManager::scaleUpMicros = savedScaleUpMicros;
+        WorkerManager::scaleDownMicros = savedScaleDownMicros;
         RpcLevel::savedMaxLevel = -1;
         RpcLevel::levelsPtr = RpcLevel::levels;
     }
@@ -81,12 +88,39 @@ class WorkerManagerTest : public ::testing::Test {
                 }
             }
             if (completed >= count) {
+                // Give the workers time to push themselves on completions
+                // (they do that just after changing their state).
+                usleep(1000);
                 return;
             }
             usleep(1000);
         }
         EXPECT_EQ(count, completed);
     }
+
+    // Fill in a READ request for the given object.
+    void
+    fillReadRequest(Buffer* request, uint64_t tableId, const char* key)
+    {
+        WireFormat::Read::Request* reqHdr =
+                request->emplaceAppend<WireFormat::Read::Request>();
+        reqHdr->common.opcode = WireFormat::READ;
+        reqHdr->common.service = WireFormat::MASTER_SERVICE;
+        reqHdr->tableId = tableId;
+        reqHdr->keyLength = downCast<uint16_t>(strlen(key));
+        reqHdr->rejectRules = {0, 0, 0, 0, 0};
+        request->appendCopy(key, reqHdr->keyLength);
+    }
+
+    // Return the shard that a key should map to with the given number of
+    // shards.
+    int
+    expectedShard(uint64_t tableId, const char* key, uint32_t numShards)
+    {
+        uint64_t keyHash = Key::getHash(tableId, key,
+                downCast<uint16_t>(strlen(key)));
+        return downCast<int>((keyHash >> 32) * numShards >> 32);
+    }
     DISALLOW_COPY_AND_ASSIGN(WorkerManagerTest);
 };
 
@@ -111,6 +145,49 @@ TEST_F(WorkerManagerTest, constructor) {
     EXPECT_EQ(4U, manager->levels.size());
     WorkerManager manager1(&context, 7);
     EXPECT_EQ(9U, manager1.idleThreads.size());
+    EXPECT_EQ(7U, manager1.coreLimit);
+    EXPECT_EQ(7U, manager1.minCores);
+}
+
+TEST_F(WorkerManagerTest, constructor_minCores) {
+    WorkerManager manager1(&context, 7, 0, false, 3);
+    EXPECT_EQ(9U, manager1.idleThreads.size());
+    EXPECT_EQ(3U, manager1.coreLimit);
+    EXPECT_EQ(3U, manager1.minCores);
+    EXPECT_EQ(7U, manager1.coreCeiling);
+    WorkerManager manager2(&context, 7, 0, false, 8);
+    EXPECT_EQ(7U, manager2.coreLimit);
+    EXPECT_EQ(7U, manager2.minCores);
+}
+
+TEST_F(WorkerManagerTest, constructor_maxBlocked) {
+    WorkerManager manager1(&context, 7, 0, false, 0, 4);
+    EXPECT_EQ(13U, manager1.idleThreads.size());
+    EXPECT_EQ(7U, manager1.coreLimit);
+}
+
+TEST_F(WorkerManagerTest, BlockingWait) {
+    {
+        // Not in a worker thread: nothing happens.
+        WorkerManager::BlockingWait blocking;
+        EXPECT_TRUE(blocking.manager == NULL);
+        EXPECT_EQ(0, manager->blockedWorkers.load());
+    }
+    WorkerManager::currentManager = manager.get();
+    {
+        WorkerManager::BlockingWait blocking;
+        EXPECT_EQ(manager.get(), blocking.manager);
+        EXPECT_EQ(1, manager->blockedWorkers.load());
+        {
+            WorkerManager::BlockingWait nested;
+            EXPECT_TRUE(nested.manager == NULL);
+            EXPECT_EQ(1, manager->blockedWorkers.load());
+        }
+        EXPECT_EQ(1, manager->blockedWorkers.load());
+    }
+    EXPECT_EQ(0, manager->blockedWorkers.load());
+    EXPECT_EQ(0, WorkerManager::blockingDepth);
+    WorkerManager::currentManager = NULL;
 }
 
 TEST_F(WorkerManagerTest, destructor_cleanupThreads) {
@@ -137,6 +214,123 @@ TEST_F(WorkerManagerTest, destructor_cleanupThreads) {
                 "workerMain: exiting", TestLog::get());
 }
 
+TEST_F(WorkerManagerTest, constructor_shards) {
+    WorkerManager manager1(&context, 2, 3);
+    EXPECT_EQ(5U, manager1.idleThreads.size());
+    EXPECT_EQ(3U, manager1.shards.size());
+    EXPECT_EQ(2, manager1.shards[2].worker->shard);
+    EXPECT_EQ(-1, manager1.idleThreads[0]->shard);
+}
+
+TEST_F(WorkerManagerTest, getShard) {
+    Buffer request;
+    fillReadRequest(&request, 1, "abc");
+    EXPECT_EQ(-1, manager->getShard(&request));
+
+    WorkerManager manager1(&context, 2, 4);
+    EXPECT_EQ(expectedShard(1, "abc", 4), manager1.getShard(&request));
+    request.reset();
+    fillReadRequest(&request, 7, "def");
+    EXPECT_EQ(expectedShard(7, "def", 4), manager1.getShard(&request));
+
+    // Key is missing from the request.
+    request.truncate(request.size() - 1);
+    EXPECT_EQ(-1, manager1.getShard(&request));
+
+    // Not a master request.
+    request.reset();
+    fillReadRequest(&request, 7, "def");
+    request.getStart<WireFormat::RequestCommon>()->service =
+            WireFormat::BACKUP_SERVICE;
+    EXPECT_EQ(-1, manager1.getShard(&request));
+
+    // Not a single-object request.
+    request.getStart<WireFormat::RequestCommon>()->service =
+            WireFormat::MASTER_SERVICE;
+    request.getStart<WireFormat::RequestCommon>()->opcode =
+            WireFormat::MULTI_OP;
+    EXPECT_EQ(-1, manager1.getShard(&request));
+
+    // Removes and writes.
+    request.reset();
+    WireFormat::Remove::Request* removeHdr =
+            request.emplaceAppend<WireFormat::Remove::Request>();
+    removeHdr->common.opcode = WireFormat::REMOVE;
+    removeHdr->common.service = WireFormat::MASTER_SERVICE;
+    removeHdr->tableId = 3;
+    removeHdr->keyLength = 5;
+    request.appendCopy("hello", 5);
+    EXPECT_EQ(expectedShard(3, "hello", 4), manager1.getShard(&request));
+
+    request.reset();
+    WireFormat::Write::Request* writeHdr =
+            request.emplaceAppend<WireFormat::Write::Request>();
+    writeHdr->common.opcode = WireFormat::WRITE;
+    writeHdr->common.service = WireFormat::MASTER_SERVICE;
+    writeHdr->tableId = 3;
+    Key key(3, "world", 5);
+    Object::appendKeysAndValueToBuffer(key, "value", 5, &request, true,
+                                       &writeHdr->length);
+    EXPECT_EQ(expectedShard(3, "world", 4), manager1.getShard(&request));
+
+    // The hash the client sent is used instead of hashing the key.
+    writeHdr->keyHash = 3UL << 62;
+    EXPECT_EQ(3, manager1.getShard(&request));
+}
+
+TEST_F(WorkerManagerTest, getRpcClass) {
+    Buffer request;
+    fillReadRequest(&request, 5, "abc");
+    EXPECT_EQ(WorkerManager::CRITICAL, manager->getRpcClass(&request));
+
+    // The table's class overrides the opcode's.
+    manager->tableClasses[5] = WorkerManager::BACKGROUND;
+    EXPECT_EQ(WorkerManager::BACKGROUND, manager->getRpcClass(&request));
+    request.reset();
+    fillReadRequest(&request, 6, "abc");
+    EXPECT_EQ(WorkerManager::CRITICAL, manager->getRpcClass(&request));
+
+    // Requests that don't name a table use their opcode's class.
+    request.reset();
+    WireFormat::Enumerate::Request* enumerateHdr =
+            request.emplaceAppend<WireFormat::Enumerate::Request>();
+    enumerateHdr->common.opcode = WireFormat::ENUMERATE;
+    enumerateHdr->common.service = WireFormat::MASTER_SERVICE;
+    enumerateHdr->tableId = 6;
+    EXPECT_EQ(WorkerManager::BACKGROUND, manager->getRpcClass(&request));
+    request.getStart<WireFormat::RequestCommon>()->opcode =
+            WireFormat::MULTI_OP;
+    EXPECT_EQ(WorkerManager::CRITICAL, manager->getRpcClass(&request));
+    request.getStart<WireFormat::RequestCommon>()->opcode =
+            WireFormat::PING;
+    EXPECT_EQ(WorkerManager::NORMAL, manager->getRpcClass(&request));
+}
+
+TEST_F(WorkerManagerTest, pickClass) {
+    WorkerManager::Level level;
+    Transport::ServerRpc* rpc = reinterpret_cast<Transport::ServerRpc*>(8);
+    EXPECT_EQ(-1, manager->pickClass(&level, true, 0));
+
+    // With weights 2, 1, 1 the critical class gets every other worker.
+    manager->classWeights[WorkerManager::CRITICAL] = 2;
+    manager->classWeights[WorkerManager::NORMAL] = 1;
+    for (int c = 0; c < WorkerManager::RPC_CLASS_COUNT; c++)
+        level.waitingRpcs.push(rpc, c);
+    EXPECT_EQ(3U, level.waitingRpcs.size());
+    string order;
+    for (int i = 0; i < 8; i++)
+        order.append(format("%d", manager->pickClass(&level, true, 0)));
+    EXPECT_EQ("01200120", order);
+
+    // Only the critical class may use reserved workers, but core limits
+    // don't apply if an RPC must start to avoid deadlock.
+    manager->reservedWorkers = 1;
+    level.waitingRpcs.pop(WorkerManager::CRITICAL);
+    EXPECT_EQ(-1, manager->pickClass(&level, false, 1));
+    EXPECT_EQ(WorkerManager::NORMAL, manager->pickClass(&level, false, 0));
+    EXPECT_EQ(WorkerManager::BACKGROUND, manager->pickClass(&level, true, 1));
+}
+
 TEST_F(WorkerManagerTest, handleRpc_noHeader) {
     TestLog::Enable _;
     MockTransport::MockServerRpc* rpc = new MockTransport::MockServerRpc(
@@ -188,6 +382,108 @@ TEST_F(WorkerManagerTest, handleRpc_deferRpc) {
     EXPECT_EQ(0, manager->levels[1].requestsRunning);
 }
 
+TEST_F(WorkerManagerTest, handleRpc_coalesceReads) {
+    static uint8_t readLevels[WireFormat::READ + 1] = {0};
+    RpcLevel::levelsPtr = readLevels;
+    context.services[WireFormat::MASTER_SERVICE] = &service;
+    uint64_t coalesced = PerfStats::threadStats.readsCoalesced;
+
+    // Keep both cores busy so that the reads have to wait.
+    service.gate = -1;
+    manager->handleRpc(new MockTransport::MockServerRpc(
+            &transport, "0x10000 1"));
+    manager->handleRpc(new MockTransport::MockServerRpc(
+            &transport, "0x10000 2"));
+    MockTransport::MockServerRpc* rpcs[3];
+    const char* keys[3] = {"abc", "abc", "xyz"};
+    for (int i = 0; i < 3; i++) {
+        rpcs[i] = new MockTransport::MockServerRpc(&transport, NULL);
+        fillReadRequest(&rpcs[i]->requestPayload, 1, keys[i]);
+        manager->handleRpc(rpcs[i]);
+    }
+    EXPECT_EQ(2U, manager->levels[0].waitingRpcs.size());
+    EXPECT_EQ(2U, manager->waitingReads.size());
+    ASSERT_EQ(1U, manager->coalescedReads.size());
+    EXPECT_EQ(rpcs[1], manager->coalescedReads[rpcs[0]][0]);
+
+    // Once the first read starts, reads of its key must wait again.
+    service.gate = 1;
+    waitUntilDone(1);
+    manager->poll();
+    EXPECT_EQ(1U, manager->waitingReads.size());
+    MockTransport::MockServerRpc* rpc4 =
+            new MockTransport::MockServerRpc(&transport, NULL);
+    fillReadRequest(&rpc4->requestPayload, 1, "abc");
+    manager->handleRpc(rpc4);
+    EXPECT_EQ(2U, manager->levels[0].waitingRpcs.size());
+    EXPECT_EQ(2U, manager->waitingReads.size());
+    EXPECT_EQ(1U, manager->coalescedReads.size());
+
+    // The duplicate isn't executed, but it gets a reply like the others.
+    transport.outputLog.clear();
+    service.gate = 0;
+    for (int i = 0; i < 1000 && !manager->busyThreads.empty(); i++) {
+        manager->poll();
+        usleep(1000);
+    }
+    EXPECT_EQ(0U, manager->coalescedReads.size());
+    EXPECT_EQ(0U, manager->waitingReads.size());
+    EXPECT_EQ(1U, PerfStats::threadStats.readsCoalesced - coalesced);
+    int executed = 0, replies = 0;
+    for (size_t i = 0; (i = service.log.find("rpc: ", i)) != string::npos;
+            i++)
+        executed++;
+    for (size_t i = 0; (i = transport.outputLog.find("serverReply:", i))
+            != string::npos; i++)
+        replies++;
+    EXPECT_EQ(5, executed);
+    EXPECT_EQ(5, replies);
+}
+
+// Records the key hashes it is asked to prefetch.
+class TestPrefetcher : public WorkerManager::Prefetcher {
+  public:
+    TestPrefetcher() : keyHashes() {}
+    void prefetch(uint64_t keyHash) { keyHashes.push_back(keyHash); }
+    std::vector<uint64_t> keyHashes;
+};
+
+TEST_F(WorkerManagerTest, handleRpc_prefetch) {
+    static uint8_t readLevels[WireFormat::READ + 1] = {0};
+    RpcLevel::levelsPtr = readLevels;
+    context.services[WireFormat::MASTER_SERVICE] = &service;
+    TestPrefetcher prefetcher;
+    manager->setPrefetcher(&prefetcher);
+
+    // Reads that start right away aren't prefetched.
+    service.gate = -1;
+    for (int i = 0; i < 2; i++) {
+        MockTransport::MockServerRpc* rpc =
+                new MockTransport::MockServerRpc(&transport, NULL);
+        fillReadRequest(&rpc->requestPayload, 1, "abc");
+        manager->handleRpc(rpc);
+    }
+    EXPECT_EQ(0U, prefetcher.keyHashes.size());
+
+    // Waiting requests are, if they are for single objects.
+    MockTransport::MockServerRpc* rpc =
+            new MockTransport::MockServerRpc(&transport, NULL);
+    fillReadRequest(&rpc->requestPayload, 7, "def");
+    manager->handleRpc(rpc);
+    manager->handleRpc(new MockTransport::MockServerRpc(
+            &transport, "0x10000 1"));
+    EXPECT_EQ(2U, manager->levels[0].waitingRpcs.size());
+    ASSERT_EQ(1U, prefetcher.keyHashes.size());
+    EXPECT_EQ(Key::getHash(7, "def", 3), prefetcher.keyHashes[0]);
+
+    service.gate = 0;
+    for (int i = 0; i < 1000 && !manager->busyThreads.empty(); i++) {
+        manager->poll();
+        usleep(1000);
+    }
+    manager->setPrefetcher(NULL);
+}
+
 TEST_F(WorkerManagerTest, handleRpc_handoffToWorker) {
     MockTransport::MockServerRpc* rpc1 = new MockTransport::MockServerRpc(
             &transport, "0x10000 1");
@@ -200,6 +496,88 @@ TEST_F(WorkerManagerTest, handleRpc_handoffToWorker) {
     EXPECT_EQ(5U, manager->idleThreads.size());
 }
 
+TEST_F(WorkerManagerTest, handleRpc_shard) {
+    manager.construct(&context, 2, 2);
+    context.services[WireFormat::MASTER_SERVICE] = &service;
+    service.gate = -1;
+    int shard = expectedShard(1, "abc", 2);
+
+    // The first request goes to the shard's worker, the second waits for
+    // it rather than using a general worker.
+    MockTransport::MockServerRpc* rpc1 = new MockTransport::MockServerRpc(
+            &transport, NULL);
+    fillReadRequest(&rpc1->requestPayload, 1, "abc");
+    MockTransport::MockServerRpc* rpc2 = new MockTransport::MockServerRpc(
+            &transport, NULL);
+    fillReadRequest(&rpc2->requestPayload, 1, "abc");
+    manager->handleRpc(rpc1);
+    manager->handleRpc(rpc2);
+    EXPECT_EQ(1U, manager->busyThreads.size());
+    EXPECT_EQ(manager->shards[shard].worker, manager->busyThreads[0]);
+    EXPECT_EQ(1U, manager->busyShardWorkers);
+    EXPECT_EQ(1U, manager->shards[shard].waitingRpcs.size());
+    EXPECT_EQ(5U, manager->idleThreads.size());
+    EXPECT_EQ(0, manager->levels[0].requestsRunning);
+
+    // Shard workers don't count towards maxCores.
+    MockTransport::MockServerRpc* rpc3 = new MockTransport::MockServerRpc(
+            &transport, "0x10002 3");
+    MockTransport::MockServerRpc* rpc4 = new MockTransport::MockServerRpc(
+            &transport, "0x10002 4");
+    manager->handleRpc(rpc3);
+    manager->handleRpc(rpc4);
+    EXPECT_EQ(3U, manager->busyThreads.size());
+    EXPECT_EQ(0U, manager->levels[2].waitingRpcs.size());
+
+    // When the shard worker finishes, it picks up the waiting request and
+    // then returns to its shard rather than to idleThreads.
+    service.gate = 0;
+    for (int i = 0; i < 1000; i++) {
+        manager->poll();
+        if (manager->busyThreads.empty())
+            break;
+        usleep(1000);
+    }
+    EXPECT_EQ(0U, manager->busyThreads.size());
+    EXPECT_EQ(0U, manager->busyShardWorkers);
+    EXPECT_EQ(0U, manager->shards[shard].waitingRpcs.size());
+    EXPECT_EQ(-1, manager->shards[shard].worker->busyIndex);
+    EXPECT_EQ(5U, manager->idleThreads.size());
+}
+
+TEST_F(WorkerManagerTest, handleRpc_inlineShortRpcs) {
+    manager.construct(&context, 2, 0, true);
+    context.services[WireFormat::MASTER_SERVICE] = &service;
+
+    // A READ executes in this thread and its reply goes out immediately.
+    MockTransport::MockServerRpc* rpc1 = new MockTransport::MockServerRpc(
+            &transport, NULL);
+    fillReadRequest(&rpc1->requestPayload, 1, "abc");
+    manager->handleRpc(rpc1);
+    EXPECT_EQ(0U, manager->busyThreads.size());
+    EXPECT_NE(string::npos, service.log.find("rpc: "));
+    EXPECT_NE(string::npos, transport.outputLog.find("serverReply:"));
+
+    // Other requests still go to a worker.
+    MockTransport::MockServerRpc* rpc2 = new MockTransport::MockServerRpc(
+            &transport, "0x10000 2");
+    manager->handleRpc(rpc2);
+    EXPECT_EQ(1U, manager->busyThreads.size());
+    waitUntilDone(1);
+    manager->poll();
+}
+
+TEST_F(WorkerManagerTest, handleRpc_inlineShortRpcsDisabled) {
+    context.services[WireFormat::MASTER_SERVICE] = &service;
+    MockTransport::MockServerRpc* rpc = new MockTransport::MockServerRpc(
+            &transport, NULL);
+    fillReadRequest(&rpc->requestPayload, 1, "abc");
+    manager->handleRpc(rpc);
+    EXPECT_EQ(1U, manager->busyThreads.size());
+    waitUntilDone(1);
+    manager->poll();
+}
+
 TEST_F(WorkerManagerTest, idle) {
     EXPECT_TRUE(manager->idle());
     // Start one RPC.
@@ -372,6 +750,152 @@ TEST_F(WorkerManagerTest, poll_coreLimit) {
     EXPECT_EQ(0, manager->poll());
 }
 
+TEST_F(WorkerManagerTest, poll_reservedWorkers) {
+    // Opcode 1 (level 1) is critical; opcode 2 (level 2) is normal. One of
+    // the 2 workers is held for critical RPCs.
+    manager->opcodeClasses[1] = WorkerManager::CRITICAL;
+    manager->reservedWorkers = 1;
+    uint64_t queued = PerfStats::threadStats.rpcClassQueued[
+            WorkerManager::NORMAL];
+    service.gate = -1;
+    MockTransport::MockServerRpc* rpc1 = new MockTransport::MockServerRpc(
+            &transport, "0x10001 1");
+    MockTransport::MockServerRpc* rpc2 = new MockTransport::MockServerRpc(
+            &transport, "0x10002 2");
+    MockTransport::MockServerRpc* rpc3 = new MockTransport::MockServerRpc(
+            &transport, "0x10001 3");
+    manager->handleRpc(rpc1);
+    manager->handleRpc(rpc2);
+    manager->handleRpc(rpc3);
+    EXPECT_EQ(2, manager->levels[1].requestsRunning);
+    EXPECT_EQ(1U, manager->levels[2].waitingRpcs.queues[
+            WorkerManager::NORMAL].size());
+
+    // Finish rpc1: rpc2 still can't use the reserved worker.
+    service.gate = 1;
+    waitUntilDone(1);
+    EXPECT_EQ(1, manager->poll());
+    EXPECT_EQ(1, manager->levels[1].requestsRunning);
+    EXPECT_EQ(0, manager->levels[2].requestsRunning);
+    EXPECT_EQ(1, manager->rpcsWaiting);
+
+    // Finish rpc3: now rpc2 can start.
+    service.gate = 3;
+    waitUntilDone(1);
+    EXPECT_EQ(1, manager->poll());
+    EXPECT_EQ(0, manager->levels[1].requestsRunning);
+    EXPECT_EQ(1, manager->levels[2].requestsRunning);
+    EXPECT_EQ(0, manager->rpcsWaiting);
+    EXPECT_EQ(1U, PerfStats::threadStats.rpcClassQueued[
+            WorkerManager::NORMAL] - queued);
+
+    // Allow the remaining request to complete.
+    service.gate = 0;
+    waitUntilDone(1);
+    EXPECT_EQ(1, manager->poll());
+    EXPECT_EQ(0, manager->poll());
+}
+
+TEST_F(WorkerManagerTest, poll_adjustCoreLimit) {
+    WorkerManager::scaleUpMicros = 0;
+    WorkerManager::scaleDownMicros = 0;
+    manager.destroy();
+    manager.construct(&context, 3, 0, false, 1);
+    service.gate = -1;
+    MockTransport::MockServerRpc* rpc1 = new MockTransport::MockServerRpc(
+            &transport, "0x10000 1");
+    MockTransport::MockServerRpc* rpc2 = new MockTransport::MockServerRpc(
+            &transport, "0x10000 2");
+    manager->handleRpc(rpc1);
+    manager->handleRpc(rpc2);
+    EXPECT_EQ(1, manager->levels[0].requestsRunning);
+    EXPECT_EQ(1, manager->rpcsWaiting);
+
+    // rpc2 has been waiting long enough: another worker may run.
+    EXPECT_EQ(1, manager->poll());
+    EXPECT_EQ(2U, manager->coreLimit);
+    EXPECT_EQ(2, manager->levels[0].requestsRunning);
+    EXPECT_EQ(0, manager->rpcsWaiting);
+
+    // Once the workers are idle, the limit drops back to the minimum.
+    service.gate = 0;
+    waitUntilDone(2);
+    EXPECT_EQ(1, manager->poll());
+    EXPECT_EQ(0U, manager->busyThreads.size());
+    manager->poll();
+    EXPECT_EQ(1U, manager->coreLimit);
+}
+
+TEST_F(WorkerManagerTest, poll_blockedWorkers) {
+    manager.destroy();
+    manager.construct(&context, 1, 0, false, 0, 1);
+    service.gate = -1;
+    MockTransport::MockServerRpc* rpc1 = new MockTransport::MockServerRpc(
+            &transport, "0x10000 1");
+    MockTransport::MockServerRpc* rpc2 = new MockTransport::MockServerRpc(
+            &transport, "0x10000 2");
+    MockTransport::MockServerRpc* rpc3 = new MockTransport::MockServerRpc(
+            &transport, "0x10000 3");
+    manager->handleRpc(rpc1);
+    manager->handleRpc(rpc2);
+    EXPECT_EQ(1, manager->levels[0].requestsRunning);
+    EXPECT_EQ(1, manager->rpcsWaiting);
+
+    // The running worker blocks, so rpc2 can take its place.
+    manager->blockedWorkers.add(1);
+    EXPECT_EQ(0U, manager->runningWorkers());
+    EXPECT_EQ(1, manager->poll());
+    EXPECT_EQ(2, manager->levels[0].requestsRunning);
+    EXPECT_EQ(0, manager->rpcsWaiting);
+    EXPECT_EQ(1U, manager->runningWorkers());
+
+    // Only maxBlocked waiting workers are left out of the count.
+    manager->handleRpc(rpc3);
+    EXPECT_EQ(1, manager->rpcsWaiting);
+    manager->blockedWorkers.add(1);
+    EXPECT_EQ(1U, manager->runningWorkers());
+    EXPECT_EQ(0, manager->poll());
+    EXPECT_EQ(1, manager->rpcsWaiting);
+    manager->blockedWorkers.add(-2);
+    EXPECT_EQ(2U, manager->runningWorkers());
+}
+
+TEST_F(WorkerManagerTest, poll_completions) {
+    manager->handleRpc(
+            new MockTransport::MockServerRpc(&transport, "0x10000 3 4"));
+    waitUntilDone(1);
+
+    // Poll only looks at workers that announced themselves.
+    Worker* worker;
+    EXPECT_TRUE(manager->completions.pop(&worker));
+    EXPECT_EQ(manager->busyThreads[0], worker);
+    EXPECT_EQ(0, manager->poll());
+    EXPECT_EQ("", transport.outputLog);
+
+    // Entries for workers that have already been dealt with are ignored.
+    EXPECT_TRUE(manager->completions.push(worker));
+    EXPECT_TRUE(manager->completions.push(worker));
+    EXPECT_EQ(1, manager->poll());
+    EXPECT_EQ("serverReply: 0x10001 4 5", transport.outputLog);
+    EXPECT_EQ(5U, manager->idleThreads.size());
+    EXPECT_FALSE(manager->completions.pop(&worker));
+}
+
+TEST_F(WorkerManagerTest, poll_completionsOverflowed) {
+    manager->handleRpc(
+            new MockTransport::MockServerRpc(&transport, "0x10000 3 4"));
+    waitUntilDone(1);
+    Worker* worker;
+    EXPECT_TRUE(manager->completions.pop(&worker));
+
+    // The worker couldn't announce itself, so every busy worker is checked.
+    manager->completionsOverflowed.store(1);
+    EXPECT_EQ(1, manager->poll());
+    EXPECT_EQ("serverReply: 0x10001 4 5", transport.outputLog);
+    EXPECT_EQ(0U, manager->busyThreads.size());
+    EXPECT_EQ(0, manager->completionsOverflowed.load());
+}
+
 TEST_F(WorkerManagerTest, poll_postprocessing) {
     // This test makes sure that the POSTPROCESSING state is handled
     // correctly (along with the subsequent POLLING state).
@@ -400,6 +924,57 @@ TEST_F(WorkerManagerTest, poll_postprocessing) {
     EXPECT_EQ(4U, manager->idleThreads.size());
 }
 
+TEST_F(WorkerManagerTest, setOption) {
+    EXPECT_TRUE(manager->setOption("rpcClassWeights", "5 3 2"));
+    EXPECT_EQ(5, manager->classWeights[WorkerManager::CRITICAL]);
+    EXPECT_EQ(3, manager->classWeights[WorkerManager::NORMAL]);
+    EXPECT_EQ(2, manager->classWeights[WorkerManager::BACKGROUND]);
+    EXPECT_FALSE(manager->setOption("rpcClassWeights", "5 3"));
+    EXPECT_FALSE(manager->setOption("rpcClassWeights", "5 0 2"));
+    EXPECT_FALSE(manager->setOption("rpcClassWeights", "5 3 2 1"));
+    EXPECT_EQ(3, manager->classWeights[WorkerManager::NORMAL]);
+
+    EXPECT_TRUE(manager->setOption("reservedWorkers", "1"));
+    EXPECT_EQ(1U, manager->reservedWorkers);
+    EXPECT_FALSE(manager->setOption("reservedWorkers", "2"));
+    EXPECT_EQ(1U, manager->reservedWorkers);
+
+    EXPECT_TRUE(manager->setOption("maxWorkerCores", "1"));
+    EXPECT_EQ(1U, manager->coreCeiling);
+    EXPECT_EQ(1U, manager->minCores);
+    EXPECT_EQ(1U, manager->coreLimit);
+    EXPECT_TRUE(manager->setOption("maxWorkerCores", "2"));
+    EXPECT_EQ(1U, manager->coreLimit);
+    EXPECT_TRUE(manager->setOption("minWorkerCores", "2"));
+    EXPECT_EQ(2U, manager->coreLimit);
+    EXPECT_FALSE(manager->setOption("minWorkerCores", "0"));
+    EXPECT_FALSE(manager->setOption("maxWorkerCores", "3"));
+
+    EXPECT_TRUE(manager->setOption("rpcOpcodeClasses",
+            "READ:background PING:critical"));
+    EXPECT_EQ(WorkerManager::BACKGROUND,
+            manager->opcodeClasses[WireFormat::READ]);
+    EXPECT_EQ(WorkerManager::CRITICAL,
+            manager->opcodeClasses[WireFormat::PING]);
+    EXPECT_FALSE(manager->setOption("rpcOpcodeClasses",
+            "WRITE:background NO_SUCH_OPCODE:critical"));
+    EXPECT_FALSE(manager->setOption("rpcOpcodeClasses", "WRITE:urgent"));
+    EXPECT_EQ(WorkerManager::CRITICAL,
+            manager->opcodeClasses[WireFormat::WRITE]);
+
+    EXPECT_TRUE(manager->setOption("rpcTableClasses",
+            "12:background 13:normal"));
+    EXPECT_EQ(2U, manager->tableClasses.size());
+    EXPECT_EQ(WorkerManager::NORMAL, manager->tableClasses[13]);
+    EXPECT_FALSE(manager->setOption("rpcTableClasses", "x12:normal"));
+    EXPECT_FALSE(manager->setOption("rpcTableClasses", ":normal"));
+    EXPECT_EQ(2U, manager->tableClasses.size());
+    EXPECT_TRUE(manager->setOption("rpcTableClasses", ""));
+    EXPECT_EQ(0U, manager->tableClasses.size());
+
+    EXPECT_FALSE(manager->setOption("noSuchOption", "1"));
+}
+
 // No tests for waitForRpc: this method is only used in tests.
 
 TEST_F(WorkerManagerTest, workerMain_goToSleep) {
@@ -521,6 +1096,21 @@ TEST_F(WorkerManagerTest, Worker_handoff_callFutex) {
     EXPECT_EQ("serverReply: 0x10001 100", transport.outputLog);
 }
 
+TEST_F(WorkerManagerTest, Worker_deferReply) {
+    Worker worker(&context);
+    MockTransport::MockServerRpc* rpc = new MockTransport::MockServerRpc(
+            &transport, "0x10000 3");
+    worker.rpc = rpc;
+    worker.state = Worker::WORKING;
+    EXPECT_EQ(rpc, worker.deferReply());
+    EXPECT_TRUE(worker.rpc == NULL);
+    EXPECT_TRUE(worker.replySent());
+    EXPECT_EQ("", transport.outputLog);
+    rpc->replyPayload.fillFromString("0x10001 4");
+    rpc->sendReply();
+    EXPECT_EQ("serverReply: 0x10001 4", transport.outputLog);
+}
+
 TEST_F(WorkerManagerTest, Worker_replySent) {
     Worker worker(&context);
     worker.state = Worker::WORKING;
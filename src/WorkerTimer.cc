@@ -39,6 +39,7 @@ WorkerTimer::WorkerTimer(Dispatch* dispatch)
     : manager(NULL)
     , triggerTime(0)
     , active(false)
+    , slot(-1)
     , handlerRunning(false)
     , handlerFinished()
     , destroyed(false)
@@ -99,10 +100,7 @@ WorkerTimer::start(uint64_t rdtscTime)
         // anything that could cause the handler to be invoked again.
         return;
     }
-    triggerTime = rdtscTime;
-    if (!active) {
-        manager->activeTimers.push_back(*this);
-    }
+    manager->activeTimers.insert(this, rdtscTime);
     if (triggerTime < manager->earliestTriggerTime) {
         manager->earliestTriggerTime = triggerTime;
         manager->start(manager->earliestTriggerTime);
@@ -149,7 +147,7 @@ void WorkerTimer::stopInternal(Lock& lock)
         }
     }
     if (active) {
-        erase(manager->activeTimers, *this);
+        manager->activeTimers.remove(this);
         active = false;
         if (manager->activeTimers.empty()) {
             manager->earliestTriggerTime = ~0lu;
@@ -283,35 +281,19 @@ WorkerTimer::findManager(Dispatch* dispatch, Lock& lock)
 void WorkerTimer::Manager::checkTimers(Lock& lock)
 {
     while (1) {
-        // Scan the list of active timers to (a) find a timer that's ready
-        // to run (if there is one) and (b) recompute earliestTriggerTime.
-        WorkerTimer* ready = NULL;
-        uint64_t newEarliest = ~0lu;
-        uint64_t now = Cycles::rdtsc();
-        for (Manager::TimerList::iterator
-                timerIterator(activeTimers.begin());
-                timerIterator != activeTimers.end();
-                timerIterator++) {
-            // Note: if multiple WorkerTimers are ready, run the one that
-            // has been on the queue the longest (this prevents starvation).)
-            if ((timerIterator->triggerTime <= now)
-                    && (ready == NULL)) {
-                ready = &(*timerIterator);
-            } else {
-                if (timerIterator->triggerTime < newEarliest) {
-                    newEarliest = timerIterator->triggerTime;
-                }
-            }
+        // Find a timer that's ready to run (if there is one). The timers
+        // that had already triggered the last time we looked all run
+        // before we look again, so a timer that keeps rescheduling itself
+        // in the past can't starve the others. popExpired removes the timer
+        // from activeTimers (it can reschedule itself if it wants).
+        WorkerTimer* ready = activeTimers.popExpired();
+        if (ready == NULL) {
+            activeTimers.advance(Cycles::rdtsc());
+            ready = activeTimers.popExpired();
         }
-        earliestTriggerTime = newEarliest;
-
         if (ready == NULL) {
             break;
         }
-
-        // Remove the timer from the list (it can reschedule itself if
-        // it wants).
-        erase(activeTimers, *ready);
         ready->active = false;
         ready->handlerRunning = true;
 
@@ -327,6 +309,7 @@ void WorkerTimer::Manager::checkTimers(Lock& lock)
         ready->handlerFinished.notify_one();
     }
 
+    earliestTriggerTime = activeTimers.earliest();
     if (!activeTimers.empty()) {
         start(earliestTriggerTime);
     }
@@ -22,6 +22,7 @@
 #include "BoostIntrusive.h"
 #include "Dispatch.h"
 #include "LogProtector.h"
+#include "TimerWheel.h"
 
 namespace RAMCloud {
 
@@ -67,6 +68,10 @@ class WorkerTimer {
     /// Indicates whether or not this timer is currently running.
     bool active;
 
+    /// Used by Manager::activeTimers (see TimerWheel) to find this timer;
+    /// >= 0 if and only if it is in activeTimers.
+    int slot;
+
     /// The following variables allow us to detect that the timer's
     /// handler is running; if so, we must wait for it to finish running
     /// when stopping or destroying the timer. handlerRunning indicates
@@ -84,6 +89,8 @@ class WorkerTimer {
     /// Used to link WorkerTimers together in Manager::activeTimers.
     IntrusiveListHook links;
 
+    friend class TimerWheel<WorkerTimer>;
+
     /**
      * The following class is used internally to manage WorkerTimers.
      * Each instance of this object corresponds to a particular Dispatch
@@ -122,9 +129,7 @@ class WorkerTimer {
 
         /// Keeps track of all of the timers that are currently running (i.e.
         /// start has been called, but the timer hasn't actually fired).
-        /// The most recently added timer is at the back of the list.
-        INTRUSIVE_LIST_TYPEDEF(WorkerTimer, links) TimerList;
-        TimerList activeTimers;
+        TimerWheel<WorkerTimer> activeTimers;
 
         /// Registers workerTimer to LogProtector to prevent any WorkerTimer's
         /// timerEventHandler dereference a pointer in log unsafely.
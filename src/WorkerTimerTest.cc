@@ -372,13 +372,13 @@ TEST_F(WorkerTimerTest, checkTimers_basics) {
     EXPECT_EQ(500lu, timer1.manager->earliestTriggerTime);
     EXPECT_TRUE(timer1.manager->isRunning());
 
-    // Second test: timer2 and timer4 have both triggered; timer2
-    // should run first.
+    // Second test: timer2 and timer4 have both triggered; they should
+    // run in trigger order.
     Cycles::mockTscValue = 700;
     timer1.manager->stop();
     timer1.manager->checkTimers(lock);
-    EXPECT_EQ("handleTimerEvent: WorkerTimer timer2 invoked | "
-            "handleTimerEvent: WorkerTimer timer4 invoked", TestLog::get());
+    EXPECT_EQ("handleTimerEvent: WorkerTimer timer4 invoked | "
+            "handleTimerEvent: WorkerTimer timer2 invoked", TestLog::get());
     EXPECT_EQ(2u, timer1.manager->activeTimers.size());
     EXPECT_EQ(1000lu, timer1.manager->earliestTriggerTime);
     EXPECT_FALSE(timer2.active);
@@ -0,0 +1,301 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "WriteStreamManager.h"
+#include "Crc32C.h"
+#include "Cycles.h"
+#include "ShortMacros.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct a Stream with no fragments.
+ *
+ * \param tableId
+ *      The table the object will be written to.
+ * \param keyHash
+ *      Key::getHash of the object's primary key.
+ */
+WriteStreamManager::Stream::Stream(uint64_t tableId, uint64_t keyHash)
+    : tableId(tableId)
+    , keyHash(keyHash)
+    , fragments()
+    , bytes(0)
+    , lastAccess(Cycles::rdtsc())
+{
+}
+
+WriteStreamManager::Stream::~Stream()
+{
+    for (std::map<uint32_t, Buffer*>::iterator it = fragments.begin();
+            it != fragments.end(); it++) {
+        delete it->second;
+    }
+}
+
+/**
+ * Append the stream's value to a buffer, without copying it.
+ *
+ * \param buffer
+ *      The fragments are appended here, in order. They remain valid as
+ *      long as this object exists.
+ */
+void
+WriteStreamManager::Stream::appendValue(Buffer* buffer)
+{
+    for (std::map<uint32_t, Buffer*>::iterator it = fragments.begin();
+            it != fragments.end(); it++) {
+        buffer->appendExternal(it->second);
+    }
+}
+
+/**
+ * Construct a WriteStreamManager with no streams.
+ *
+ * \param maxValueBytes
+ *      Largest value that a stream may carry; normally the server's
+ *      maxObjectDataSize.
+ * \param maxStagedBytes
+ *      Upper limit on the total number of value bytes held for all of the
+ *      streams in progress.
+ */
+WriteStreamManager::WriteStreamManager(uint32_t maxValueBytes,
+        uint64_t maxStagedBytes)
+    : mutex("WriteStreamManager::mutex")
+    , streams()
+    , maxValueBytes(maxValueBytes)
+    , maxStagedBytes(maxStagedBytes)
+    , stagedBytes(0)
+{
+}
+
+WriteStreamManager::~WriteStreamManager()
+{
+    for (std::unordered_map<uint64_t, Stream*>::iterator it = streams.begin();
+            it != streams.end(); it++) {
+        delete it->second;
+    }
+}
+
+/**
+ * Add one fragment to a stream, creating the stream if this is the first
+ * fragment to arrive for it.
+ *
+ * \param streamId
+ *      Identifies the stream (chosen by the client).
+ * \param tableId
+ *      The table the object will be written to.
+ * \param keyHash
+ *      Key::getHash of the object's primary key.
+ * \param offset
+ *      Offset in the value of the fragment's first byte.
+ * \param data
+ *      Holds the fragment; it is copied, so the caller may discard it on
+ *      return.
+ * \param dataOffset
+ *      Offset in \a data of the fragment's first byte.
+ * \param length
+ *      Number of bytes in the fragment.
+ *
+ * \return
+ *      STATUS_OK if the fragment was added (or had been already: this is
+ *      a retry), STATUS_REQUEST_TOO_LARGE if the fragment extends past the
+ *      largest allowed value, STATUS_RETRY if too many bytes are held
+ *      already, or STATUS_INVALID_PARAMETER if the stream was started for
+ *      a different object.
+ */
+Status
+WriteStreamManager::addFragment(uint64_t streamId, uint64_t tableId,
+        uint64_t keyHash, uint32_t offset, Buffer* data, uint32_t dataOffset,
+        uint32_t length)
+{
+    if (uint64_t(offset) + length > maxValueBytes)
+        return STATUS_REQUEST_TOO_LARGE;
+    if (length == 0)
+        return STATUS_OK;
+
+    // Copy the data before locking, so that other streams don't wait for
+    // the copy.
+    Buffer* fragment = new Buffer();
+    data->copy(dataOffset, length, fragment->alloc(length));
+
+    SpinLock::Guard lock(mutex);
+    removeExpired(lock);
+    Stream* stream;
+    std::unordered_map<uint64_t, Stream*>::iterator it =
+            streams.find(streamId);
+    if (it == streams.end()) {
+        stream = new Stream(tableId, keyHash);
+        streams[streamId] = stream;
+    } else {
+        stream = it->second;
+        if (stream->tableId != tableId || stream->keyHash != keyHash) {
+            delete fragment;
+            return STATUS_INVALID_PARAMETER;
+        }
+    }
+    stream->lastAccess = Cycles::rdtsc();
+    if (stream->fragments.find(offset) != stream->fragments.end()) {
+        // The client retried a fragment that had already arrived.
+        delete fragment;
+        return STATUS_OK;
+    }
+    if (stagedBytes + length > maxStagedBytes) {
+        delete fragment;
+        return STATUS_RETRY;
+    }
+    stream->fragments[offset] = fragment;
+    stream->bytes += length;
+    stagedBytes += length;
+    return STATUS_OK;
+}
+
+/**
+ * Remove a stream so that its value can be written, after checking that
+ * its fragments make up exactly the value the client sent. The stream is
+ * removed even if the check fails: the client has to start over.
+ *
+ * \param streamId
+ *      Identifies the stream.
+ * \param tableId
+ *      The table the object is being written to.
+ * \param valueLength
+ *      Total length of the value, according to the client.
+ * \param checksum
+ *      Crc32C of the value, according to the client.
+ * \param[out] stream
+ *      If STATUS_OK is returned, the stream is stored here; the caller
+ *      owns it.
+ *
+ * \return
+ *      STATUS_OK, or STATUS_INVALID_PARAMETER if there is no such stream,
+ *      or fragments are missing, or the value doesn't match \a checksum.
+ */
+Status
+WriteStreamManager::finish(uint64_t streamId, uint64_t tableId,
+        uint32_t valueLength, uint32_t checksum,
+        std::unique_ptr<Stream>* stream)
+{
+    std::unique_ptr<Stream> result;
+    {
+        SpinLock::Guard _(mutex);
+        std::unordered_map<uint64_t, Stream*>::iterator it =
+                streams.find(streamId);
+        if (it != streams.end()) {
+            result.reset(it->second);
+            streams.erase(it);
+            stagedBytes -= result->bytes;
+        }
+    }
+    if (!result) {
+        if (valueLength != 0) {
+            LOG(NOTICE, "No fragments for streaming write 0x%lx (it may "
+                    "have expired)", streamId);
+            return STATUS_INVALID_PARAMETER;
+        }
+        // An empty value needs no fragments.
+        result.reset(new Stream(tableId, 0));
+    }
+    if (result->tableId != tableId)
+        return STATUS_INVALID_PARAMETER;
+
+    Crc32C crc;
+    uint64_t expectedOffset = 0;
+    for (std::map<uint32_t, Buffer*>::iterator it = result->fragments.begin();
+            it != result->fragments.end(); it++) {
+        if (it->first != expectedOffset)
+            break;
+        crc.update(*it->second);
+        expectedOffset += it->second->size();
+    }
+    if (expectedOffset != valueLength || result->bytes != valueLength) {
+        LOG(NOTICE, "Streaming write 0x%lx is incomplete: expected %u bytes, "
+                "received %lu bytes of which %lu are contiguous", streamId,
+                valueLength, result->bytes, expectedOffset);
+        return STATUS_INVALID_PARAMETER;
+    }
+    if (crc.getResult() != checksum) {
+        LOG(NOTICE, "Checksum mismatch for streaming write 0x%lx",
+                streamId);
+        return STATUS_INVALID_PARAMETER;
+    }
+    stream->swap(result);
+    return STATUS_OK;
+}
+
+/**
+ * Return the total number of value bytes held for all of the streams in
+ * progress.
+ */
+uint64_t
+WriteStreamManager::getStagedBytes()
+{
+    SpinLock::Guard _(mutex);
+    return stagedBytes;
+}
+
+/**
+ * Put back a stream returned by finish, because its object couldn't be
+ * written yet (e.g. the write returned STATUS_RETRY) and the client will
+ * retry the commit.
+ *
+ * \param streamId
+ *      Identifies the stream.
+ * \param stream
+ *      The stream returned by finish; ownership returns to this object.
+ */
+void
+WriteStreamManager::restore(uint64_t streamId,
+        std::unique_ptr<Stream>* stream)
+{
+    SpinLock::Guard _(mutex);
+    Stream*& slot = streams[streamId];
+    if (slot != NULL) {
+        stagedBytes -= slot->bytes;
+        delete slot;
+    }
+    slot = stream->release();
+    slot->lastAccess = Cycles::rdtsc();
+    stagedBytes += slot->bytes;
+}
+
+/**
+ * Discard any streams that haven't received a fragment for
+ * STREAM_TIMEOUT_SECONDS.
+ *
+ * \param lock
+ *      Ensures that the caller holds the monitor lock; not used.
+ */
+void
+WriteStreamManager::removeExpired(SpinLock::Guard& lock)
+{
+    uint64_t now = Cycles::rdtsc();
+    uint64_t timeout = Cycles::fromSeconds(STREAM_TIMEOUT_SECONDS);
+    std::unordered_map<uint64_t, Stream*>::iterator it = streams.begin();
+    while (it != streams.end()) {
+        Stream* stream = it->second;
+        if (now - stream->lastAccess < timeout) {
+            it++;
+            continue;
+        }
+        LOG(NOTICE, "Discarding streaming write 0x%lx: no fragments for "
+                "%u seconds", it->first, STREAM_TIMEOUT_SECONDS);
+        stagedBytes -= stream->bytes;
+        delete stream;
+        it = streams.erase(it);
+    }
+}
+
+} // namespace RAMCloud
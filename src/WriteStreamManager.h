@@ -0,0 +1,121 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_WRITESTREAMMANAGER_H
+#define RAMCLOUD_WRITESTREAMMANAGER_H
+
+#include <map>
+#include <memory>
+#include <unordered_map>
+
+#include "Buffer.h"
+#include "Common.h"
+#include "SpinLock.h"
+#include "Status.h"
+
+namespace RAMCloud {
+
+/**
+ * Holds the values of streaming writes while a master receives them (see
+ * ObjectWriteStream). A client sends a large value as a series of
+ * WRITE_FRAGMENT requests, each carrying part of the value at a given
+ * offset, and then a COMMIT_WRITE request with the key and a checksum of
+ * the whole value. This class collects the fragments of each stream as
+ * they arrive (possibly out of order, since fragments are pipelined), and
+ * at commit time checks that they cover the value exactly and match the
+ * checksum; only then is the object appended to the log, all at once, so
+ * a reader never sees part of a streamed value.
+ *
+ * The total number of bytes held is limited, and streams that receive no
+ * fragments for STREAM_TIMEOUT_SECONDS are discarded (e.g., because the
+ * client crashed), so abandoned streams can't use up the master's memory.
+ *
+ * This class is thread-safe.
+ */
+class WriteStreamManager {
+  PUBLIC:
+    /// Default for the constructor's maxStagedBytes argument.
+    static const uint64_t DEFAULT_MAX_STAGED_BYTES = 256*1024*1024;
+
+    /// A stream that hasn't received a fragment for this long is
+    /// discarded.
+    static const uint32_t STREAM_TIMEOUT_SECONDS = 60;
+
+    /**
+     * The fragments received for a single streaming write.
+     */
+    class Stream {
+      PUBLIC:
+        Stream(uint64_t tableId, uint64_t keyHash);
+        ~Stream();
+        void appendValue(Buffer* buffer);
+
+        /// The table the object will be written to.
+        uint64_t tableId;
+
+        /// Key::getHash of the object's primary key, from the first
+        /// fragment.
+        uint64_t keyHash;
+
+        /// Fragment data received so far, indexed by the fragment's offset
+        /// in the value. The Buffers are owned by this object.
+        std::map<uint32_t, Buffer*> fragments;
+
+        /// Total bytes in #fragments.
+        uint64_t bytes;
+
+        /// Cycles::rdtsc time when a fragment was last received.
+        uint64_t lastAccess;
+
+        DISALLOW_COPY_AND_ASSIGN(Stream);
+    };
+
+    explicit WriteStreamManager(uint32_t maxValueBytes,
+            uint64_t maxStagedBytes = DEFAULT_MAX_STAGED_BYTES);
+    ~WriteStreamManager();
+    Status addFragment(uint64_t streamId, uint64_t tableId, uint64_t keyHash,
+            uint32_t offset, Buffer* data, uint32_t dataOffset,
+            uint32_t length);
+    Status finish(uint64_t streamId, uint64_t tableId, uint32_t valueLength,
+            uint32_t checksum, std::unique_ptr<Stream>* stream);
+    uint64_t getStagedBytes();
+    void restore(uint64_t streamId, std::unique_ptr<Stream>* stream);
+
+  PRIVATE:
+    void removeExpired(SpinLock::Guard& lock);
+
+    /// Protects all of the members below.
+    SpinLock mutex;
+
+    /// Streaming writes in progress, indexed by stream id.
+    std::unordered_map<uint64_t, Stream*> streams;
+
+    /// Largest value a stream may carry (a single object has to fit in a
+    /// log segment).
+    uint32_t maxValueBytes;
+
+    /// Upper limit on the total bytes in all of the streams; fragments
+    /// that would exceed it are refused with STATUS_RETRY.
+    uint64_t maxStagedBytes;
+
+    /// Total bytes in all of the streams.
+    uint64_t stagedBytes;
+
+    DISALLOW_COPY_AND_ASSIGN(WriteStreamManager);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_WRITESTREAMMANAGER_H
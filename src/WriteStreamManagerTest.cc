@@ -0,0 +1,187 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "Crc32C.h"
+#include "Cycles.h"
+#include "WriteStreamManager.h"
+
+namespace RAMCloud {
+
+class WriteStreamManagerTest : public ::testing::Test {
+  public:
+    TestLog::Enable logEnabler;
+    WriteStreamManager manager;
+
+    WriteStreamManagerTest()
+        : logEnabler()
+        , manager(100, 20)
+    {
+    }
+
+    /// Add a fragment containing a string to stream 1 of table 5.
+    Status
+    add(uint32_t offset, const char* data, uint64_t streamId = 1)
+    {
+        Buffer buffer;
+        buffer.appendExternal("header", 6);
+        buffer.appendExternal(data, downCast<uint32_t>(strlen(data)));
+        return manager.addFragment(streamId, 5, 99, offset, &buffer, 6,
+                downCast<uint32_t>(strlen(data)));
+    }
+
+    /// Return the Crc32C of a string.
+    static uint32_t
+    crc(const char* data)
+    {
+        Crc32C crc;
+        crc.update(data, downCast<uint32_t>(strlen(data)));
+        return crc.getResult();
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(WriteStreamManagerTest);
+};
+
+TEST_F(WriteStreamManagerTest, addFragment_outOfOrder) {
+    EXPECT_EQ(STATUS_OK, add(5, " world"));
+    EXPECT_EQ(STATUS_OK, add(0, "hello"));
+    EXPECT_EQ(11U, manager.getStagedBytes());
+
+    std::unique_ptr<WriteStreamManager::Stream> stream;
+    EXPECT_EQ(STATUS_OK, manager.finish(1, 5, 11, crc("hello world"),
+            &stream));
+    ASSERT_TRUE(stream != NULL);
+    Buffer value;
+    stream->appendValue(&value);
+    EXPECT_EQ("hello world", TestUtil::toString(&value));
+    EXPECT_EQ(0U, manager.getStagedBytes());
+}
+
+TEST_F(WriteStreamManagerTest, addFragment_tooLarge) {
+    Buffer buffer;
+    buffer.appendExternal("abc", 3);
+    EXPECT_EQ(STATUS_REQUEST_TOO_LARGE,
+            manager.addFragment(1, 5, 99, 98, &buffer, 0, 3));
+    EXPECT_EQ(STATUS_OK, manager.addFragment(1, 5, 99, 97, &buffer, 0, 3));
+}
+
+TEST_F(WriteStreamManagerTest, addFragment_wrongObject) {
+    Buffer buffer;
+    buffer.appendExternal("abc", 3);
+    EXPECT_EQ(STATUS_OK, manager.addFragment(1, 5, 99, 0, &buffer, 0, 3));
+    EXPECT_EQ(STATUS_INVALID_PARAMETER,
+            manager.addFragment(1, 5, 98, 3, &buffer, 0, 3));
+    EXPECT_EQ(STATUS_INVALID_PARAMETER,
+            manager.addFragment(1, 6, 99, 3, &buffer, 0, 3));
+    EXPECT_EQ(3U, manager.getStagedBytes());
+}
+
+TEST_F(WriteStreamManagerTest, addFragment_retried) {
+    EXPECT_EQ(STATUS_OK, add(0, "hello"));
+    EXPECT_EQ(STATUS_OK, add(0, "hello"));
+    EXPECT_EQ(5U, manager.getStagedBytes());
+}
+
+TEST_F(WriteStreamManagerTest, addFragment_stagingFull) {
+    EXPECT_EQ(STATUS_OK, add(0, "0123456789"));
+    EXPECT_EQ(STATUS_OK, add(0, "0123456789", 2));
+    EXPECT_EQ(STATUS_RETRY, add(10, "x"));
+    EXPECT_EQ(20U, manager.getStagedBytes());
+}
+
+TEST_F(WriteStreamManagerTest, finish_noStream) {
+    std::unique_ptr<WriteStreamManager::Stream> stream;
+    TestLog::Enable _("finish");
+    EXPECT_EQ(STATUS_INVALID_PARAMETER, manager.finish(1, 5, 3, 0, &stream));
+    EXPECT_EQ("finish: No fragments for streaming write 0x1 (it may have "
+            "expired)", TestLog::get());
+
+    // An empty value doesn't need any fragments.
+    EXPECT_EQ(STATUS_OK, manager.finish(1, 5, 0, crc(""), &stream));
+    ASSERT_TRUE(stream != NULL);
+    EXPECT_EQ(0U, stream->bytes);
+}
+
+TEST_F(WriteStreamManagerTest, finish_wrongTable) {
+    EXPECT_EQ(STATUS_OK, add(0, "hello"));
+    std::unique_ptr<WriteStreamManager::Stream> stream;
+    EXPECT_EQ(STATUS_INVALID_PARAMETER, manager.finish(1, 6, 5, crc("hello"),
+            &stream));
+    EXPECT_TRUE(stream == NULL);
+}
+
+TEST_F(WriteStreamManagerTest, finish_missingFragment) {
+    EXPECT_EQ(STATUS_OK, add(0, "hello"));
+    EXPECT_EQ(STATUS_OK, add(6, "world"));
+    std::unique_ptr<WriteStreamManager::Stream> stream;
+    TestLog::Enable _("finish");
+    EXPECT_EQ(STATUS_INVALID_PARAMETER, manager.finish(1, 5, 11,
+            crc("hello world"), &stream));
+    EXPECT_EQ("finish: Streaming write 0x1 is incomplete: expected 11 bytes, "
+            "received 10 bytes of which 5 are contiguous", TestLog::get());
+    EXPECT_TRUE(stream == NULL);
+
+    // The stream is gone, so the client has to start over.
+    EXPECT_EQ(0U, manager.getStagedBytes());
+    EXPECT_EQ(STATUS_INVALID_PARAMETER, manager.finish(1, 5, 11,
+            crc("hello world"), &stream));
+}
+
+TEST_F(WriteStreamManagerTest, finish_overlappingFragments) {
+    EXPECT_EQ(STATUS_OK, add(0, "hello"));
+    EXPECT_EQ(STATUS_OK, add(3, "lo"));
+    std::unique_ptr<WriteStreamManager::Stream> stream;
+    EXPECT_EQ(STATUS_INVALID_PARAMETER, manager.finish(1, 5, 5, crc("hello"),
+            &stream));
+}
+
+TEST_F(WriteStreamManagerTest, finish_badChecksum) {
+    EXPECT_EQ(STATUS_OK, add(0, "hello"));
+    std::unique_ptr<WriteStreamManager::Stream> stream;
+    TestLog::Enable _("finish");
+    EXPECT_EQ(STATUS_INVALID_PARAMETER, manager.finish(1, 5, 5, crc("hellp"),
+            &stream));
+    EXPECT_EQ("finish: Checksum mismatch for streaming write 0x1",
+            TestLog::get());
+    EXPECT_TRUE(stream == NULL);
+}
+
+TEST_F(WriteStreamManagerTest, restore) {
+    EXPECT_EQ(STATUS_OK, add(0, "hello"));
+    std::unique_ptr<WriteStreamManager::Stream> stream;
+    EXPECT_EQ(STATUS_OK, manager.finish(1, 5, 5, crc("hello"), &stream));
+    EXPECT_EQ(0U, manager.getStagedBytes());
+
+    manager.restore(1, &stream);
+    EXPECT_TRUE(stream == NULL);
+    EXPECT_EQ(5U, manager.getStagedBytes());
+    EXPECT_EQ(STATUS_OK, manager.finish(1, 5, 5, crc("hello"), &stream));
+}
+
+TEST_F(WriteStreamManagerTest, removeExpired) {
+    EXPECT_EQ(STATUS_OK, add(0, "hello"));
+    EXPECT_EQ(STATUS_OK, add(0, "world", 2));
+    manager.streams[1]->lastAccess -= Cycles::fromSeconds(
+            WriteStreamManager::STREAM_TIMEOUT_SECONDS + 1);
+
+    TestLog::Enable _("removeExpired");
+    EXPECT_EQ(STATUS_OK, add(0, "again", 3));
+    EXPECT_EQ("removeExpired: Discarding streaming write 0x1: no fragments "
+            "for 60 seconds", TestLog::get());
+    EXPECT_EQ(10U, manager.getStagedBytes());
+    EXPECT_EQ(0U, manager.streams.count(1));
+}
+
+}  // namespace RAMCloud
@@ -0,0 +1,572 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <errno.h>
+#include <net/if.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/bpf.h>
+#include <linux/if_xdp.h>
+
+#include "Common.h"
+#include "ShortMacros.h"
+#include "XdpDriver.h"
+#include "NetUtil.h"
+#include "PerfStats.h"
+#include "ServiceLocator.h"
+
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+namespace RAMCloud
+{
+
+/**
+ * Number of frames placed on the TX ring after which sendPacket kicks the
+ * kernel immediately, rather than leaving it for the next Poller::poll.
+ */
+static const uint32_t TX_KICK_THRESHOLD = 16;
+
+/**
+ * Construct an XdpDriver.
+ *
+ * \param context
+ *      Overall information about the RAMCloud server or client.
+ * \param localServiceLocator
+ *      "ifname" option (required) names the network interface to attach
+ *      to. "queue" option selects the NIC receive queue on that interface
+ *      whose traffic our XDP program redirects to us (default 0). "mac"
+ *      option overrides the MAC address; if it is omitted or all zeroes,
+ *      the interface's own address is used. "xskmap" option gives the
+ *      path of the pinned XSKMAP used by the XDP program (default
+ *      /sys/fs/bpf/xsks_map).
+ *
+ * \throw DriverException
+ *      The AF_XDP socket couldn't be created or attached.
+ */
+XdpDriver::XdpDriver(Context* context,
+                     const ServiceLocator* localServiceLocator)
+    : context(context)
+    , incomingPacketHandler()
+    , poller()
+    , packetBufPool()
+    , packetBufsUtilized(0)
+    , locatorString()
+    , ifName()
+    , queueId(0)
+    , localMac()
+    , fd(-1)
+    , umem(NULL)
+    , fillRing()
+    , completionRing()
+    , rxRing()
+    , txRing()
+    , txFreeFrames()
+    , txPending(0)
+    , loopbackPackets()
+    , loopbackLengths()
+{
+    if (localServiceLocator == NULL) {
+        throw DriverException(HERE,
+                "XdpDriver requires a service locator with an ifname option");
+    }
+    locatorString = localServiceLocator->getOriginalString();
+    string xskMapPath;
+    try {
+        ifName = localServiceLocator->getOption("ifname");
+        queueId = localServiceLocator->getOption<uint32_t>("queue", 0);
+        xskMapPath = localServiceLocator->getOption("xskmap",
+                "/sys/fs/bpf/xsks_map");
+        if (localServiceLocator->hasOption("mac")) {
+            localMac.construct(
+                    localServiceLocator->getOption<const char*>("mac"));
+        }
+    } catch (ServiceLocator::NoSuchKeyException& e) {
+        throw DriverException(HERE, format(
+                "XdpDriver service locator missing ifname option: %s",
+                locatorString.c_str()));
+    }
+    if (!localMac || localMac->isNull()) {
+        localMac.construct(NetUtil::getLocalMac(ifName.c_str()).c_str());
+    }
+    unsigned int ifIndex = if_nametoindex(ifName.c_str());
+    if (ifIndex == 0) {
+        throw DriverException(HERE, format("XdpDriver couldn't find "
+                "interface %s", ifName.c_str()), errno);
+    }
+
+    try {
+        fd = socket(AF_XDP, SOCK_RAW, 0);
+        if (fd < 0) {
+            throw DriverException(HERE, "XdpDriver couldn't create AF_XDP "
+                    "socket", errno);
+        }
+
+        // Allocate the UMEM region and register it with the kernel.
+        size_t umemBytes = size_t(NUM_FRAMES) * FRAME_SIZE;
+        void* area = mmap(NULL, umemBytes, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        if (area == MAP_FAILED) {
+            throw DriverException(HERE, "XdpDriver couldn't allocate UMEM",
+                    errno);
+        }
+        umem = static_cast<char*>(area);
+        struct xdp_umem_reg umemReg;
+        memset(&umemReg, 0, sizeof(umemReg));
+        umemReg.addr = reinterpret_cast<uint64_t>(umem);
+        umemReg.len = umemBytes;
+        umemReg.chunk_size = FRAME_SIZE;
+        umemReg.headroom = 0;
+        if (setsockopt(fd, SOL_XDP, XDP_UMEM_REG, &umemReg,
+                sizeof(umemReg)) != 0) {
+            throw DriverException(HERE, "XdpDriver couldn't register UMEM",
+                    errno);
+        }
+
+        // Size and map the four rings.
+        uint32_t ndesc = NDESC;
+        int ringOptions[] = {XDP_UMEM_FILL_RING, XDP_UMEM_COMPLETION_RING,
+                XDP_RX_RING, XDP_TX_RING};
+        foreach (int option, ringOptions) {
+            if (setsockopt(fd, SOL_XDP, option, &ndesc,
+                    sizeof(ndesc)) != 0) {
+                throw DriverException(HERE, format("XdpDriver couldn't "
+                        "size ring %d", option), errno);
+            }
+        }
+        struct xdp_mmap_offsets offsets;
+        socklen_t offsetsLength = sizeof(offsets);
+        if (getsockopt(fd, SOL_XDP, XDP_MMAP_OFFSETS, &offsets,
+                &offsetsLength) != 0) {
+            throw DriverException(HERE, "XdpDriver couldn't get ring offsets",
+                    errno);
+        }
+        mapRing(&fillRing, &offsets.fr, XDP_UMEM_PGOFF_FILL_RING,
+                sizeof(uint64_t), "fill");
+        mapRing(&completionRing, &offsets.cr, XDP_UMEM_PGOFF_COMPLETION_RING,
+                sizeof(uint64_t), "completion");
+        mapRing(&rxRing, &offsets.rx, XDP_PGOFF_RX_RING,
+                sizeof(struct xdp_desc), "rx");
+        mapRing(&txRing, &offsets.tx, XDP_PGOFF_TX_RING,
+                sizeof(struct xdp_desc), "tx");
+
+        // Hand the receive half of the UMEM to the kernel; keep the
+        // other half for transmission.
+        uint64_t* fillDescs = static_cast<uint64_t*>(fillRing.descs);
+        for (uint32_t i = 0; i < NDESC; i++) {
+            fillDescs[i] = uint64_t(i) * FRAME_SIZE;
+        }
+        __atomic_store_n(fillRing.producer, NDESC, __ATOMIC_RELEASE);
+        txFreeFrames.reserve(NUM_FRAMES - NDESC);
+        for (uint32_t i = NDESC; i < NUM_FRAMES; i++) {
+            txFreeFrames.push_back(uint64_t(i) * FRAME_SIZE);
+        }
+
+        struct sockaddr_xdp address;
+        memset(&address, 0, sizeof(address));
+        address.sxdp_family = AF_XDP;
+        address.sxdp_ifindex = ifIndex;
+        address.sxdp_queue_id = queueId;
+        if (bind(fd, reinterpret_cast<struct sockaddr*>(&address),
+                sizeof(address)) != 0) {
+            throw DriverException(HERE, format("XdpDriver couldn't bind to "
+                    "queue %u of %s", queueId, ifName.c_str()), errno);
+        }
+
+        registerWithXskMap(xskMapPath.c_str());
+    } catch (...) {
+        releaseResources();
+        throw;
+    }
+
+    locatorString = format("basic+xdp:ifname=%s,queue=%u,mac=%s",
+            ifName.c_str(), queueId, localMac->toString().c_str());
+    LOG(NOTICE, "XdpDriver locator: %s", locatorString.c_str());
+}
+
+/**
+ * Destroy the XdpDriver.
+ */
+XdpDriver::~XdpDriver()
+{
+    poller.destroy();
+    releaseDeferred();
+    while (!loopbackPackets.empty()) {
+        packetBufPool.destroy(loopbackPackets.back());
+        loopbackPackets.pop_back();
+    }
+    if (packetBufsUtilized != 0)
+        LOG(ERROR, "XdpDriver deleted with %d packets still in use",
+            packetBufsUtilized);
+    releaseResources();
+}
+
+/**
+ * Close the socket and unmap the rings and UMEM; used both by the
+ * destructor and to clean up after a failure in the constructor.
+ */
+void
+XdpDriver::releaseResources()
+{
+    Ring* rings[] = {&fillRing, &completionRing, &rxRing, &txRing};
+    foreach (Ring* ring, rings) {
+        if (ring->map != NULL) {
+            munmap(ring->map, ring->mapLength);
+            ring->map = NULL;
+        }
+    }
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    if (umem != NULL) {
+        munmap(umem, size_t(NUM_FRAMES) * FRAME_SIZE);
+        umem = NULL;
+    }
+}
+
+/**
+ * Map one of the socket's rings into our address space.
+ *
+ * \param ring
+ *      Filled in with pointers into the mapped region.
+ * \param offsets
+ *      Offsets of the ring's fields, as returned by XDP_MMAP_OFFSETS.
+ * \param pageOffset
+ *      The kernel's mmap offset identifying this ring.
+ * \param descSize
+ *      Size in bytes of each descriptor in the ring.
+ * \param name
+ *      Name of the ring, for error messages.
+ */
+void
+XdpDriver::mapRing(Ring* ring, const struct xdp_ring_offset* offsets,
+        uint64_t pageOffset, size_t descSize, const char* name)
+{
+    size_t length = offsets->desc + NDESC * descSize;
+    void* map = mmap(NULL, length, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, fd, static_cast<off_t>(pageOffset));
+    if (map == MAP_FAILED) {
+        throw DriverException(HERE, format("XdpDriver couldn't map %s ring",
+                name), errno);
+    }
+    char* base = static_cast<char*>(map);
+    ring->map = map;
+    ring->mapLength = length;
+    ring->producer = reinterpret_cast<uint32_t*>(base + offsets->producer);
+    ring->consumer = reinterpret_cast<uint32_t*>(base + offsets->consumer);
+    ring->descs = base + offsets->desc;
+    ring->mask = NDESC - 1;
+}
+
+/**
+ * Insert our socket into the XSKMAP used by the interface's XDP program,
+ * so that the program can start redirecting packets to us.
+ *
+ * \param path
+ *      Location of the pinned XSKMAP in the BPF filesystem.
+ */
+void
+XdpDriver::registerWithXskMap(const char* path)
+{
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.pathname = reinterpret_cast<uint64_t>(path);
+    int mapFd = static_cast<int>(syscall(__NR_bpf, BPF_OBJ_GET, &attr,
+            sizeof(attr)));
+    if (mapFd < 0) {
+        throw DriverException(HERE, format("XdpDriver couldn't open XSKMAP "
+                "%s (is the XDP program loaded?)", path), errno);
+    }
+
+    uint32_t key = queueId;
+    uint32_t value = downCast<uint32_t>(fd);
+    memset(&attr, 0, sizeof(attr));
+    attr.map_fd = downCast<uint32_t>(mapFd);
+    attr.key = reinterpret_cast<uint64_t>(&key);
+    attr.value = reinterpret_cast<uint64_t>(&value);
+    attr.flags = BPF_ANY;
+    int64_t r = syscall(__NR_bpf, BPF_MAP_UPDATE_ELEM, &attr, sizeof(attr));
+    int savedErrno = errno;
+    ::close(mapFd);
+    if (r != 0) {
+        throw DriverException(HERE, format("XdpDriver couldn't insert socket "
+                "into XSKMAP %s", path), savedErrno);
+    }
+}
+
+// See docs in Driver class.
+void
+XdpDriver::connect(IncomingPacketHandler* incomingPacketHandler)
+{
+    this->incomingPacketHandler.reset(incomingPacketHandler);
+    poller.construct(context, this);
+}
+
+// See docs in Driver class.
+void
+XdpDriver::disconnect()
+{
+    poller.destroy();
+    this->incomingPacketHandler.reset();
+}
+
+// See docs in Driver class.
+uint32_t
+XdpDriver::getMaxPacketSize()
+{
+    return MAX_PAYLOAD_SIZE - sizeof32(NetUtil::EthernetHeader);
+}
+
+// See docs in Driver class.
+void
+XdpDriver::release(char *payload)
+{
+    // Packets released in workers are returned in batches by the dispatch
+    // thread.
+    if (deferRelease(context->dispatch, payload)) {
+        return;
+    }
+    releaseBatch(&payload, 1);
+}
+
+// See docs in Driver class.
+void
+XdpDriver::releaseBatch(char** payloads, uint32_t count)
+{
+    // Must sync with the dispatch thread, since this method could potentially
+    // be invoked in a worker.
+    Dispatch::Lock _(context->dispatch);
+
+    // Note: each payload is actually contained in a PacketBuf structure,
+    // which we return to a pool for reuse later.
+    for (uint32_t i = 0; i < count; i++) {
+        packetBufsUtilized--;
+        assert(packetBufsUtilized >= 0);
+        packetBufPool.destroy(reinterpret_cast<PacketBuf*>(
+                payloads[i] - OFFSET_OF(PacketBuf, payload)));
+    }
+}
+
+/**
+ * Move frames whose transmission has completed from the completion ring
+ * back to #txFreeFrames, and kick the kernel if there are frames on the
+ * TX ring that it hasn't been told about yet.
+ */
+void
+XdpDriver::reclaimTxFrames()
+{
+    uint32_t consumer = *completionRing.consumer;
+    uint32_t producer = __atomic_load_n(completionRing.producer,
+            __ATOMIC_ACQUIRE);
+    if (producer != consumer) {
+        uint64_t* descs = static_cast<uint64_t*>(completionRing.descs);
+        for (uint32_t i = consumer; i != producer; i++) {
+            txFreeFrames.push_back(descs[i & completionRing.mask]);
+        }
+        __atomic_store_n(completionRing.consumer, producer,
+                __ATOMIC_RELEASE);
+    }
+    if (txPending > 0) {
+        // A zero-length sendto is how AF_XDP is told to process the
+        // TX ring. EAGAIN/EBUSY just mean the kernel is already busy
+        // with it; the frames will go out on a later kick.
+        sendto(fd, NULL, 0, MSG_DONTWAIT, NULL, 0);
+        txPending = 0;
+    }
+}
+
+// See docs in Driver class.
+void
+XdpDriver::sendPacket(const Address *addr,
+                      const void *header,
+                      uint32_t headerLen,
+                      Buffer::Iterator *payload)
+{
+    uint32_t totalLength = headerLen + (payload ? payload->size() : 0);
+    uint32_t frameLength = totalLength + sizeof32(NetUtil::EthernetHeader);
+    assert(totalLength <= MAX_PAYLOAD_SIZE);
+    const MacAddress* recipient = static_cast<const MacAddress*>(addr);
+
+    // Packets addressed to ourselves can't go through the NIC; copy them
+    // straight into a receive buffer instead.
+    if (memcmp(recipient->address, localMac->address, 6) == 0) {
+        PacketBuf* buffer = packetBufPool.construct();
+        buffer->macAddress.construct(*localMac);
+        char* p = buffer->payload;
+        memcpy(p, header, headerLen);
+        p += headerLen;
+        while (payload && !payload->isDone()) {
+            memcpy(p, payload->getData(), payload->getLength());
+            p += payload->getLength();
+            payload->next();
+        }
+        loopbackPackets.push_back(buffer);
+        loopbackLengths.push_back(totalLength);
+        return;
+    }
+
+    // There are exactly as many transmit frames as TX ring slots, so a
+    // free frame guarantees room on the ring.
+    if (txFreeFrames.empty()) {
+        reclaimTxFrames();
+        if (txFreeFrames.empty()) {
+            RAMCLOUD_CLOG(NOTICE,
+                    "No free XDP transmit frames; dropping packet");
+            return;
+        }
+    }
+    uint64_t frame = txFreeFrames.back();
+    txFreeFrames.pop_back();
+
+    char* p = umem + frame;
+    NetUtil::EthernetHeader* ethHdr =
+            reinterpret_cast<NetUtil::EthernetHeader*>(p);
+    memcpy(ethHdr->destAddress, recipient->address, 6);
+    memcpy(ethHdr->srcAddress, localMac->address, 6);
+    ethHdr->etherType = HTONS(NetUtil::EthPayloadType::FAST);
+    p += sizeof(*ethHdr);
+    memcpy(p, header, headerLen);
+    p += headerLen;
+    while (payload && !payload->isDone()) {
+        memcpy(p, payload->getData(), payload->getLength());
+        p += payload->getLength();
+        payload->next();
+    }
+
+    uint32_t producer = *txRing.producer;
+    struct xdp_desc* desc = static_cast<struct xdp_desc*>(txRing.descs) +
+            (producer & txRing.mask);
+    desc->addr = frame;
+    desc->len = frameLength;
+    desc->options = 0;
+    __atomic_store_n(txRing.producer, producer + 1, __ATOMIC_RELEASE);
+    PerfStats::threadStats.networkOutputBytes += frameLength;
+
+    // Transmissions issued during the same pass through the dispatch loop
+    // share a single kick from the poller; only kick here if a large
+    // batch has accumulated.
+    txPending++;
+    if (txPending >= TX_KICK_THRESHOLD) {
+        reclaimTxFrames();
+    }
+}
+
+/**
+ * Pass any packets that we sent to ourselves up to the transport.
+ */
+void
+XdpDriver::deliverLoopbackPackets()
+{
+    std::vector<PacketBuf*> packets;
+    std::vector<uint32_t> lengths;
+    packets.swap(loopbackPackets);
+    lengths.swap(loopbackLengths);
+    for (size_t i = 0; i < packets.size(); i++) {
+        packetBufsUtilized++;
+        Received received;
+        received.len = lengths[i];
+        received.sender = packets[i]->macAddress.get();
+        received.driver = this;
+        received.payload = packets[i]->payload;
+        incomingPacketHandler->handlePacket(&received);
+    }
+}
+
+/**
+ * Invoked by the dispatcher on every pass through the polling loop:
+ * returns completed transmit frames to the free list, flushes pending
+ * transmissions, and passes a burst of received packets to the transport.
+ *
+ * \return
+ *      1 if any packets were received, 0 otherwise.
+ */
+int
+XdpDriver::Poller::poll()
+{
+    driver->reclaimTxFrames();
+    driver->releaseDeferred();
+    int result = 0;
+    if (!driver->loopbackPackets.empty()) {
+        driver->deliverLoopbackPackets();
+        result = 1;
+    }
+
+    Ring& rx = driver->rxRing;
+    uint32_t consumer = *rx.consumer;
+    uint32_t count = __atomic_load_n(rx.producer, __ATOMIC_ACQUIRE) -
+            consumer;
+    if (count == 0) {
+        return result;
+    }
+    if (count > MAX_RX_BURST) {
+        count = MAX_RX_BURST;
+    }
+
+    // First copy each packet out of the UMEM and return its frame to the
+    // fill ring, so the rings are consistent before the transport runs
+    // (it may send packets or even disconnect us from handlePacket).
+    PacketBuf* buffers[MAX_RX_BURST];
+    uint32_t lengths[MAX_RX_BURST];
+    uint32_t received = 0;
+    Ring& fill = driver->fillRing;
+    uint32_t fillProducer = *fill.producer;
+    uint64_t* fillDescs = static_cast<uint64_t*>(fill.descs);
+    for (uint32_t i = 0; i < count; i++) {
+        struct xdp_desc* desc = static_cast<struct xdp_desc*>(rx.descs) +
+                ((consumer + i) & rx.mask);
+        const char* frame = driver->umem + desc->addr;
+        if (desc->len > sizeof(NetUtil::EthernetHeader) &&
+                desc->len <= MAX_PAYLOAD_SIZE +
+                sizeof(NetUtil::EthernetHeader)) {
+            const NetUtil::EthernetHeader* ethHdr =
+                    reinterpret_cast<const NetUtil::EthernetHeader*>(frame);
+            PacketBuf* buffer = driver->packetBufPool.construct();
+            buffer->macAddress.construct(ethHdr->srcAddress);
+            lengths[received] = desc->len - sizeof32(*ethHdr);
+            memcpy(buffer->payload, frame + sizeof(*ethHdr),
+                    lengths[received]);
+            buffers[received] = buffer;
+            received++;
+            PerfStats::threadStats.networkInputBytes += desc->len;
+        }
+        fillDescs[(fillProducer + i) & fill.mask] =
+                desc->addr & ~uint64_t(FRAME_SIZE - 1);
+    }
+    __atomic_store_n(fill.producer, fillProducer + count, __ATOMIC_RELEASE);
+    __atomic_store_n(rx.consumer, consumer + count, __ATOMIC_RELEASE);
+
+    for (uint32_t i = 0; i < received; i++) {
+        driver->packetBufsUtilized++;
+        Received packet;
+        packet.len = lengths[i];
+        packet.sender = buffers[i]->macAddress.get();
+        packet.driver = driver;
+        packet.payload = buffers[i]->payload;
+        driver->incomingPacketHandler->handlePacket(&packet);
+    }
+    return 1;
+}
+
+// See docs in Driver class.
+string
+XdpDriver::getServiceLocator()
+{
+    return locatorString;
+}
+
+} // namespace RAMCloud
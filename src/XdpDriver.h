@@ -0,0 +1,224 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_XDPDRIVER_H
+#define RAMCLOUD_XDPDRIVER_H
+
+#include <vector>
+
+#include "Dispatch.h"
+#include "Driver.h"
+#include "MacAddress.h"
+#include "ObjectPool.h"
+#include "NetUtil.h"
+#include "ServiceLocator.h"
+#include "Tub.h"
+
+// Forward declaration, so we don't have to include kernel headers here.
+struct xdp_ring_offset;
+
+namespace RAMCloud
+{
+
+/**
+ * A Driver for kernel-bypass Ethernet communication using AF_XDP sockets.
+ * Unlike DpdkDriver, the NIC stays under the control of the kernel: an
+ * XDP program attached to the interface redirects FAST frames on one
+ * receive queue into our socket (via an XSKMAP), and everything else
+ * continues up the kernel stack. Packet data moves through a UMEM region
+ * shared with the kernel, and the driver busy-polls its rings from the
+ * dispatch thread, so the kernel is only entered to kick transmission.
+ *
+ * The XDP program itself is not loaded by this class; it must be attached
+ * to the interface (e.g. with ip or xdp-loader) and its XSKMAP pinned in
+ * the BPF filesystem before the driver is constructed. The program should
+ * redirect frames whose ether type is NetUtil::EthPayloadType::FAST.
+ * See Driver.h for more detail on the driver interface.
+ */
+class XdpDriver : public Driver
+{
+  public:
+    static const uint32_t MAX_PAYLOAD_SIZE = 1400;
+
+    /// Number of descriptors in each of the four AF_XDP rings.
+    static const uint32_t NDESC = 2048;
+
+    /// Size of each packet frame in the UMEM region.
+    static const uint32_t FRAME_SIZE = 2048;
+
+    /// Total number of frames in the UMEM region. The first half is
+    /// dedicated to reception (it circulates between the fill and RX
+    /// rings); the rest is used for transmission.
+    static const uint32_t NUM_FRAMES = 2 * NDESC;
+
+    /// Maximum number of packets processed by a single call to
+    /// Poller::poll.
+    static const uint32_t MAX_RX_BURST = 32;
+
+    explicit XdpDriver(Context* context,
+                       const ServiceLocator* localServiceLocator = NULL);
+    virtual ~XdpDriver();
+    virtual void connect(IncomingPacketHandler* incomingPacketHandler);
+    virtual void disconnect();
+    virtual uint32_t getMaxPacketSize();
+    virtual void release(char *payload);
+    virtual void releaseBatch(char** payloads, uint32_t count);
+    virtual void sendPacket(const Address *addr,
+                            const void *header,
+                            uint32_t headerLen,
+                            Buffer::Iterator *payload);
+    virtual string getServiceLocator();
+
+    virtual Address* newAddress(const ServiceLocator* serviceLocator)
+    {
+        return new MacAddress(serviceLocator->getOption<const char*>("mac"));
+    }
+
+    /**
+     * Structure to hold an incoming packet.
+     */
+    struct PacketBuf
+    {
+        Tub<MacAddress> macAddress;            /// Address of sender (used to
+                                               /// send reply).
+        char payload[MAX_PAYLOAD_SIZE];        /// Packet data.
+        PacketBuf() : macAddress(), payload() { }
+    };
+
+  PRIVATE:
+    /**
+     * Describes one of the single-producer/single-consumer rings that
+     * an AF_XDP socket shares with the kernel. The producer and consumer
+     * indexes run freely and are reduced modulo the ring size (a power
+     * of two) when indexing descriptors.
+     */
+    struct Ring {
+        Ring()
+            : producer(NULL)
+            , consumer(NULL)
+            , descs(NULL)
+            , mask(0)
+            , map(NULL)
+            , mapLength(0)
+        {}
+
+        /// Index of the next descriptor the producer will fill in.
+        uint32_t* producer;
+
+        /// Index of the next descriptor the consumer will read.
+        uint32_t* consumer;
+
+        /// The descriptor array: uint64_t UMEM offsets for the fill and
+        /// completion rings, struct xdp_desc for the RX and TX rings.
+        void* descs;
+
+        /// Number of descriptors in the ring, minus one.
+        uint32_t mask;
+
+        /// Start and length of the mmapped region containing the ring;
+        /// NULL means the ring hasn't been mapped.
+        void* map;
+        size_t mapLength;
+    };
+
+    /**
+     * Polls the RX ring for incoming packets (and the completion ring for
+     * transmitted frames that can be reused).
+     */
+    class Poller : public Dispatch::Poller {
+      public:
+        explicit Poller(Context* context, XdpDriver* driver)
+            : Dispatch::Poller(context->dispatch, "XdpDriver::Poller")
+            , driver(driver)
+        {}
+        virtual int poll();
+      private:
+        /// Driver on whose behalf this poller operates.
+        XdpDriver* driver;
+        DISALLOW_COPY_AND_ASSIGN(Poller);
+    };
+
+    void deliverLoopbackPackets();
+    void mapRing(Ring* ring, const struct xdp_ring_offset* offsets,
+                 uint64_t pageOffset, size_t descSize, const char* name);
+    void reclaimTxFrames();
+    void registerWithXskMap(const char* path);
+    void releaseResources();
+
+    /// Shared RAMCloud information.
+    Context* context;
+
+    /// Handler to invoke whenever packets arrive.
+    std::unique_ptr<IncomingPacketHandler> incomingPacketHandler;
+
+    /// Polls for incoming packets while we are connected.
+    Tub<Poller> poller;
+
+    /// Holds packet buffers that are no longer in use, for use in future
+    /// requests; saves the overhead of calling malloc/free for each request.
+    ObjectPool<PacketBuf> packetBufPool;
+
+    /// Tracks number of outstanding allocated payloads.  For detecting leaks.
+    int packetBufsUtilized;
+
+    /// The original ServiceLocator string. May be empty if the constructor
+    /// argument was NULL. May also differ if the MAC address was filled in
+    /// from the interface.
+    string locatorString;
+
+    /// Name of the network interface (e.g. "eth0") we are attached to.
+    string ifName;
+
+    /// Index of the receive queue on #ifName that our XDP program
+    /// redirects into this socket.
+    uint32_t queueId;
+
+    /// The MAC address of the NIC (either native or overridden).
+    Tub<MacAddress> localMac;
+
+    /// The AF_XDP socket; -1 means not open.
+    int fd;
+
+    /// The UMEM region: NUM_FRAMES frames of FRAME_SIZE bytes, shared with
+    /// the kernel. NULL means it hasn't been allocated.
+    char* umem;
+
+    /// Rings shared with the kernel.
+    Ring fillRing;
+    Ring completionRing;
+    Ring rxRing;
+    Ring txRing;
+
+    /// UMEM offsets of transmit frames that are not currently in use.
+    std::vector<uint64_t> txFreeFrames;
+
+    /// Number of frames placed on the TX ring since the last time the kernel
+    /// was asked to transmit.
+    uint32_t txPending;
+
+    /// Packets addressed to ourselves; they never reach the NIC (the XDP
+    /// hook only sees incoming traffic), so they are queued here and
+    /// delivered by the poller.
+    std::vector<PacketBuf*> loopbackPackets;
+
+    /// Lengths of the packets in #loopbackPackets.
+    std::vector<uint32_t> loopbackLengths;
+
+    DISALLOW_COPY_AND_ASSIGN(XdpDriver);
+};
+
+} // end RAMCloud
+
+#endif  // RAMCLOUD_XDPDRIVER_H
@@ -87,7 +87,12 @@ ZooStorage::becomeLeader(const char* name, const string& leaderInfo)
         if (checkLeader(lock)) {
             return;
         }
+
+        // Let other threads (such as a standby refreshing its copy of the
+        // coordinator's state) use the connection while we wait.
+        lock.unlock();
         usleep(checkLeaderIntervalMs*1000);
+        lock.lock();
     }
 }
 
@@ -164,69 +169,34 @@ ZooStorage::getChildren(const char* name, vector<Object>* children)
                 zerror(status), fullName);
     }
 
-    // This buffer is used for retrieving object values. The initial size
-    // is just a guess; we may have to reallocate a larger buffer to
-    // accommodate large objects.
-    char* buffer;
-    uint32_t bufferSize = 1000;
-    buffer = new char[bufferSize];
-    try {
-        int length;
-        std::string childName(fullName);
-        childName.append("/");
-        size_t baseLength = childName.length();
-        struct Stat stat;
-
-        // Each iteration through the following loop retrieves the value
-        // for one object.
-        for (int i = 0; i < names.count; i++) {
-            // It may take a couple of attempts to read each child (e.g.
-            // if we lose the ZooKeeper connection, or if we have to
-            // grow the buffer). Each iteration through the following loop
-            // makes one attempt.
-            while (1) {
-                childName.resize(baseLength);
-                childName.append(names.data[i]);
-                length = bufferSize;
-                int status = zoo_get(zoo, childName.c_str(), 0,
-                        static_cast<char*>(buffer), &length, &stat);
-                if (testStatus2 != 0) {
-                    status = testStatus2;
-                    testStatus2 = 0;
-                }
-                if (status != ZOK) {
-                    if (status == ZNONODE) {
-                        // The object got deleted after we collected
-                        // all of the child names; just ignore it.
-                        break;
-                    }
-                    handleError(lock, status);
-                    RAMCLOUD_LOG(WARNING, "Retrying after %s error reading "
-                            "child %s", zerror(status), childName.c_str());
-                    continue;
-                }
-                // Warning: ZooKeeper returns -1 dataLength for empty nodes.
-                if ((length != stat.dataLength) && (stat.dataLength != 0)) {
-                    // We didn't allocate a large enough buffer; resize the
-                    // buffer and try again.
-                    bufferSize = stat.dataLength;
-                    delete buffer;
-                    buffer = new char[bufferSize];
-                    continue;
-                }
-                children->emplace_back(childName.c_str(), buffer,
-                        stat.dataLength);
-                break;
-            }
-        }
-    }
-    catch (...) {
-        deallocate_String_vector(&names);
-        delete buffer;
-        throw;
+    // Then read all of the children's values.
+    string childName(fullName);
+    childName.append("/");
+    vector<string> childNames;
+    childNames.reserve(names.count);
+    for (int i = 0; i < names.count; i++) {
+        childNames.emplace_back(childName + names.data[i]);
     }
     deallocate_String_vector(&names);
-    delete buffer;
+    readObjects(lock, childNames, children);
+}
+
+// See documentation for ExternalStorage::getMulti.
+void
+ZooStorage::getMulti(const vector<string>& names, vector<Object>* objects)
+{
+    Lock lock(mutex);
+    objects->clear();
+    if (lostLeadership) {
+        throw LostLeadershipException(HERE);
+    }
+
+    vector<string> absNames;
+    absNames.reserve(names.size());
+    foreach (const string& name, names) {
+        absNames.emplace_back(getFullName(name.c_str()));
+    }
+    readObjects(lock, absNames, objects);
 }
 
 // See documentation for ExternalStorage::remove.
@@ -315,6 +285,92 @@ ZooStorage::set(Hint flavor, const char* name, const char* value,
     setInternal(lock, flavor, getFullName(name), value, valueLength);
 }
 
+// See documentation for ExternalStorage::setMulti.
+void
+ZooStorage::setMulti(const vector<Write>& writes)
+{
+    Lock lock(mutex);
+    if (lostLeadership) {
+        throw LostLeadershipException(HERE);
+    }
+    size_t first = 0;
+    while (first < writes.size()) {
+        size_t count = 0;
+        size_t bytes = 0;
+        while (first + count < writes.size()) {
+            const Write& write = writes[first + count];
+            bytes += write.name.size() + write.value.size();
+            if ((count > 0) && (bytes > MAX_MULTI_BYTES))
+                break;
+            count++;
+        }
+        setMultiInternal(lock, &writes[first], count);
+        first += count;
+    }
+}
+
+/**
+ * This method does most of the work of the "setMulti" method: it writes
+ * a group of objects in a single ZooKeeper transaction.
+ *
+ * \param lock
+ *      Ensures that caller has acquired mutex; not actually used here.
+ * \param writes
+ *      The objects to write.
+ * \param count
+ *      Number of entries in writes.
+ */
+void
+ZooStorage::setMultiInternal(Lock& lock, const Write* writes, size_t count)
+{
+    vector<string> names;
+    vector<zoo_op_t> ops(count);
+    vector<zoo_op_result_t> results(count);
+    for (size_t i = 0; i < count; i++) {
+        names.emplace_back(getFullName(writes[i].name.c_str()));
+    }
+    for (size_t i = 0; i < count; i++) {
+        const Write& write = writes[i];
+        int valueLength = downCast<int>(write.value.size());
+        if (write.flavor == Hint::CREATE) {
+            zoo_create_op_init(&ops[i], names[i].c_str(), write.value.data(),
+                    valueLength, &ZOO_OPEN_ACL_UNSAFE, 0, NULL, 0);
+        } else {
+            zoo_set_op_init(&ops[i], names[i].c_str(), write.value.data(),
+                    valueLength, -1, NULL);
+        }
+    }
+
+    while (1) {
+        int status = zoo_multi(zoo, downCast<int>(count), &ops[0],
+                &results[0]);
+        if (testStatus1 != 0) {
+            status = testStatus1;
+            testStatus1 = 0;
+        }
+        if (status == ZOK) {
+            return;
+        }
+        if ((status == ZNONODE) || (status == ZNODEEXISTS)) {
+            // Either a hint was incorrect or a parent node doesn't exist.
+            // The transaction had no effect, so fall back to writing the
+            // objects one at a time; setInternal sorts out these problems.
+            RAMCLOUD_LOG(NOTICE, "Transaction writing %lu objects failed "
+                    "(%s); writing them individually", count,
+                    zerror(status));
+            for (size_t i = 0; i < count; i++) {
+                setInternal(lock, writes[i].flavor, names[i].c_str(),
+                        writes[i].value.data(),
+                        downCast<int>(writes[i].value.size()));
+            }
+            return;
+        }
+        handleError(lock, status);
+        RAMCLOUD_LOG(WARNING, "Retrying after %s error writing %lu objects",
+                zerror(status), count);
+    }
+}
+
 /**
  * This method does most of the work of the "set" method. It is separated
  * so that it can be invoked by both "set" and "createParent" (createParent
@@ -605,6 +661,157 @@ ZooStorage::open(Lock& lock)
     }
 }
 
+/**
+ * This method is invoked by ZooKeeper's completion thread when one of the
+ * asynchronous reads issued by readObjects finishes; it records the result
+ * and wakes up readObjects once the whole batch is done.
+ *
+ * \param status
+ *      ZooKeeper status for the read.
+ * \param value
+ *      The object's value, if status is ZOK.
+ * \param valueLength
+ *      Number of bytes at value.
+ * \param stat
+ *      The object's stat, if status is ZOK.
+ * \param data
+ *      The ReadBatch::Read in which to record the result.
+ */
+void
+ZooStorage::readCompleted(int status, const char* value, int valueLength,
+        const struct Stat* stat, const void* data)
+{
+    ReadBatch::Read* read = static_cast<ReadBatch::Read*>(
+            const_cast<void*>(data));
+    read->status = status;
+    if (status == ZOK) {
+        // Warning: ZooKeeper returns -1 dataLength for empty nodes.
+        read->length = stat->dataLength;
+        if (valueLength > 0) {
+            read->value.assign(value, valueLength);
+        }
+    }
+    ReadBatch* batch = read->batch;
+    std::lock_guard<std::mutex> _(batch->mutex);
+    batch->remaining--;
+    if (batch->remaining == 0) {
+        batch->done.notify_all();
+    }
+}
+
+/**
+ * Read one object synchronously. This is used by readObjects to retry
+ * reads that failed.
+ *
+ * \param lock
+ *      Ensures that caller has acquired mutex; not actually used here.
+ * \param absName
+ *      Absolute name of the object to read.
+ * \param read
+ *      The result is recorded here.
+ *
+ * \return
+ *      ZooKeeper status for the read (also recorded in read).
+ */
+int
+ZooStorage::readObject(Lock& lock, const char* absName, ReadBatch::Read* read)
+{
+    // Make an initial guess about how large the object is; if the guess
+    // is too small, use the stat data to figure out exactly how much
+    // space is needed, then try again.
+    int32_t bufferSize = 1000;
+    struct Stat stat;
+    while (1) {
+        read->value.resize(bufferSize);
+        int length = bufferSize;
+        read->status = zoo_get(zoo, absName, 0, &read->value[0], &length,
+                &stat);
+        if (read->status != ZOK) {
+            read->value.clear();
+            return read->status;
+        }
+        // Warning: ZooKeeper returns -1 dataLength for empty nodes.
+        if ((length != stat.dataLength) && (stat.dataLength > bufferSize)) {
+            bufferSize = stat.dataLength;
+            continue;
+        }
+        read->value.resize((length > 0) ? length : 0);
+        read->length = stat.dataLength;
+        return read->status;
+    }
+}
+
+/**
+ * Read the values of a collection of objects. Rather than waiting for
+ * one read to finish before issuing the next, this method issues up to
+ * MAX_PIPELINED_READS asynchronous reads at once, so that reading many
+ * objects (such as all of the children of a node during coordinator
+ * recovery) costs only a few round-trips to the server.
+ *
+ * \param lock
+ *      Ensures that caller has acquired mutex.
+ * \param absNames
+ *      Absolute names of the objects to read.
+ * \param objects
+ *      One entry is appended here for each object that exists, in the
+ *      same order as absNames.
+ */
+void
+ZooStorage::readObjects(Lock& lock, const vector<string>& absNames,
+        vector<Object>* objects)
+{
+    for (size_t first = 0; first < absNames.size();
+            first += MAX_PIPELINED_READS) {
+        size_t count = absNames.size() - first;
+        if (count > MAX_PIPELINED_READS) {
+            count = MAX_PIPELINED_READS;
+        }
+
+        // Issue all of the reads in this group, then wait for them all
+        // to complete.
+        ReadBatch batch(count);
+        for (size_t i = 0; i < count; i++) {
+            ReadBatch::Read* read = &batch.reads[i];
+            int status = zoo_aget(zoo, absNames[first + i].c_str(), 0,
+                    readCompleted, read);
+            if (status != ZOK) {
+                // The read was never issued, so the completion won't run.
+                read->status = status;
+                std::lock_guard<std::mutex> _(batch.mutex);
+                batch.remaining--;
+            }
+        }
+        batch.wait();
+
+        for (size_t i = 0; i < count; i++) {
+            ReadBatch::Read* read = &batch.reads[i];
+            const char* name = absNames[first + i].c_str();
+            if (testStatus2 != 0) {
+                read->status = testStatus2;
+                testStatus2 = 0;
+            }
+
+            // Reads that failed (e.g., because we lost the ZooKeeper
+            // connection) are retried synchronously; this should be rare.
+            while (read->status != ZOK) {
+                if (read->status == ZNONODE) {
+                    // The object got deleted (perhaps after we collected
+                    // the child names); just ignore it.
+                    break;
+                }
+                handleError(lock, read->status);
+                RAMCLOUD_LOG(WARNING, "Retrying after %s error reading "
+                        "child %s", zerror(read->status), name);
+                readObject(lock, name, read);
+            }
+            if (read->status == ZOK) {
+                objects->emplace_back(name, read->value.data(),
+                        read->length);
+            }
+        }
+    }
+}
+
 /**
  * This method is invoked by LeaseRenewer at regular intervals. Its job
  * is to rewrite the leader object with a new version, in order to
@@ -728,6 +935,35 @@ ZooStorage::stateString(int state)
     }
 }
 
+/**
+ * Constructor for ReadBatch.
+ *
+ * \param count
+ *      Number of reads in the batch.
+ */
+ZooStorage::ReadBatch::ReadBatch(size_t count)
+    : mutex()
+    , done()
+    , remaining(count)
+    , reads(count)
+{
+    foreach (Read& read, reads) {
+        read.batch = this;
+    }
+}
+
+/**
+ * Wait until all of the reads in the batch have completed.
+ */
+void
+ZooStorage::ReadBatch::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (remaining != 0) {
+        done.wait(lock);
+    }
+}
+
 /**
  * Constructor for LeaseRenewer.
  *
@@ -19,6 +19,7 @@
 #define RAMCLOUD_ZOOSTORAGE_H
 
 #include <zookeeper/zookeeper.h>
+#include <condition_variable>
 
 #include "ExternalStorage.h"
 #include "WorkerTimer.h"
@@ -37,9 +38,12 @@ class ZooStorage: public ExternalStorage {
     virtual void becomeLeader(const char* name, const string& leaderInfo);
     virtual bool get(const char* name, Buffer* value);
     virtual void getChildren(const char* name, vector<Object>* children);
+    virtual void getMulti(const vector<string>& names,
+            vector<Object>* objects);
     virtual void remove(const char* name);
     virtual void set(Hint flavor, const char* name, const char* value,
             int valueLength = -1);
+    virtual void setMulti(const vector<Write>& writes);
 
   PRIVATE:
     /**
@@ -60,6 +64,53 @@ class ZooStorage: public ExternalStorage {
     };
 
 
+    /**
+     * Collects the results of a group of reads that readObjects issues
+     * asynchronously; the reads complete on ZooKeeper's completion thread.
+     */
+    struct ReadBatch {
+        /// The result of one of the reads.
+        struct Read {
+            Read()
+                : batch(NULL)
+                , status(ZOK)
+                , value()
+                , length(-1)
+            {}
+
+            /// The batch this read belongs to.
+            ReadBatch* batch;
+
+            /// ZooKeeper status for the read.
+            int status;
+
+            /// The object's value, if status is ZOK.
+            string value;
+
+            /// The object's dataLength from its stat (-1 for pure nodes).
+            int length;
+
+            DISALLOW_COPY_AND_ASSIGN(Read);
+        };
+
+        explicit ReadBatch(size_t count);
+        void wait();
+
+        /// Protects remaining.
+        std::mutex mutex;
+
+        /// Notified when remaining drops to zero.
+        std::condition_variable done;
+
+        /// Number of entries in reads that haven't completed yet.
+        size_t remaining;
+
+        /// One entry for each read in the batch.
+        vector<Read> reads;
+
+        DISALLOW_COPY_AND_ASSIGN(ReadBatch);
+    };
+
     /// Monitor-style lock: acquired by all externally visible methods. It's
     /// not totally clear whether ZooKeeper itself is thread-safe, but even
     /// if it were, this class does things like reopening the server
@@ -126,15 +177,30 @@ class ZooStorage: public ExternalStorage {
     int testStatus1;
     int testStatus2;
 
+    /// ZooKeeper rejects requests larger than about 1 MB by default, so
+    /// setMulti splits its writes into transactions of at most this many
+    /// bytes of names and values.
+    static const size_t MAX_MULTI_BYTES = 512*1024;
+
+    /// readObjects keeps at most this many asynchronous reads outstanding
+    /// at once, which bounds the memory used for their results.
+    static const size_t MAX_PIPELINED_READS = 1000;
+
     bool checkLeader(Lock& lock);
     void close(Lock& lock);
     void createParent(Lock& lock, const char* childName);
     void handleError(Lock& lock, int status);
     void open(Lock& lock);
+    static void readCompleted(int status, const char* value, int valueLength,
+            const struct Stat* stat, const void* data);
+    int readObject(Lock& lock, const char* absName, ReadBatch::Read* read);
+    void readObjects(Lock& lock, const vector<string>& absNames,
+            vector<Object>* objects);
     void removeInternal(Lock& lock, const char* name);
     bool renewLease(Lock& lock);
     void setInternal(Lock& lock, Hint flavor, const char* name,
             const char* value, int valueLength);
+    void setMultiInternal(Lock& lock, const Write* writes, size_t count);
     const char* stateString(int state);
 
     DISALLOW_COPY_AND_ASSIGN(ZooStorage);
@@ -218,7 +218,7 @@ TEST_F(ZooStorageTest, getChildren_recoverableErrorReadingValues) {
     EXPECT_EQ("/test/var1: value1, /test/var2: value2",
             toString(&children));
     EXPECT_TRUE(TestUtil::contains(TestLog::get(),
-            "getChildren: Retrying after operation timeout error "
+            "readObjects: Retrying after operation timeout error "
             "reading child /test/var1"));
 }
 TEST_F(ZooStorageTest, getChildren_mustGrowBuffer) {
@@ -246,6 +246,39 @@ TEST_F(ZooStorageTest, getChildren_weirdNodes) {
             toString(&children));
 }
 
+TEST_F(ZooStorageTest, getMulti_basics) {
+    vector<ZooStorage::Object> objects;
+    objects.emplace_back("a", "b", 1);
+    zoo->set(ExternalStorage::Hint::CREATE, "/test/var1", "value1");
+    zoo->set(ExternalStorage::Hint::CREATE, "/test/var2", "value2");
+    zoo->set(ExternalStorage::Hint::CREATE, "/test/var3", "value3");
+    zoo->getMulti({"/test/var3", "/test/bogus", "/test/var1"}, &objects);
+    EXPECT_EQ("/test/var3: value3, /test/var1: value1",
+            toString(&objects));
+}
+TEST_F(ZooStorageTest, getMulti_lostLeadership) {
+    zoo->lostLeadership = true;
+    vector<ZooStorage::Object> objects;
+    EXPECT_THROW(zoo->getMulti({"/test/var1"}, &objects),
+                ExternalStorage::LostLeadershipException);
+}
+TEST_F(ZooStorageTest, getMulti_retryMustGrowBuffer) {
+    vector<ZooStorage::Object> objects;
+    Buffer big;
+    TestUtil::fillLargeBuffer(&big, 4000);
+    zoo->set(ExternalStorage::Hint::CREATE, "/test/v1",
+                static_cast<const char*>(big.getRange(0, 4000)), 4000);
+    zoo->testStatus2 = ZOPERATIONTIMEOUT;
+    zoo->getMulti({"/test/v1"}, &objects);
+    EXPECT_TRUE(TestUtil::contains(TestLog::get(),
+            "readObjects: Retrying after operation timeout error "
+            "reading child /test/v1"));
+    ASSERT_EQ(1u, objects.size());
+    Buffer result;
+    result.appendCopy(objects[0].value, objects[0].length);
+    EXPECT_EQ("ok", TestUtil::checkLargeBuffer(&result, 4000));
+}
+
 TEST_F(ZooStorageTest, remove_lostLeadership) {
     zoo->lostLeadership = true;
     EXPECT_THROW(zoo->remove("/test/var1"),
@@ -366,6 +399,65 @@ TEST_F(ZooStorageTest, setInternal_recoverableUpdateError) {
             "writing /test"));
 }
 
+TEST_F(ZooStorageTest, setMulti_lostLeadership) {
+    zoo->lostLeadership = true;
+    vector<ExternalStorage::Write> writes;
+    writes.emplace_back(ExternalStorage::Hint::CREATE, "/test", "value1");
+    EXPECT_THROW(zoo->setMulti(writes),
+                ExternalStorage::LostLeadershipException);
+}
+TEST_F(ZooStorageTest, setMulti_basics) {
+    Buffer value;
+    zoo->set(ExternalStorage::Hint::CREATE, "/test", "value0");
+    vector<ExternalStorage::Write> writes;
+    writes.emplace_back(ExternalStorage::Hint::UPDATE, "/test", "value1");
+    writes.emplace_back(ExternalStorage::Hint::CREATE, "/test/var1",
+            "value2");
+    writes.emplace_back(ExternalStorage::Hint::UPDATE, "/test/var1",
+            "value3");
+    zoo->setMulti(writes);
+    EXPECT_TRUE(zoo->get("/test", &value));
+    EXPECT_EQ("value1", TestUtil::toString(&value));
+    EXPECT_TRUE(zoo->get("/test/var1", &value));
+    EXPECT_EQ("value3", TestUtil::toString(&value));
+    EXPECT_EQ("", TestLog::get());
+}
+TEST_F(ZooStorageTest, setMulti_splitLargeBatches) {
+    Buffer value;
+    zoo->set(ExternalStorage::Hint::CREATE, "/test", "value0");
+    string big(ZooStorage::MAX_MULTI_BYTES / 2, 'x');
+    vector<ExternalStorage::Write> writes;
+    for (int i = 0; i < 3; i++) {
+        writes.emplace_back(ExternalStorage::Hint::CREATE,
+                format("/test/var%d", i), big);
+    }
+    TestLog::Enable _("setMultiInternal");
+    zoo->testStatus1 = ZOPERATIONTIMEOUT;
+    zoo->setMulti(writes);
+    for (int i = 0; i < 3; i++) {
+        EXPECT_TRUE(zoo->get(format("/test/var%d", i).c_str(), &value));
+        EXPECT_EQ(big.size(), value.size());
+    }
+    EXPECT_TRUE(TestUtil::contains(TestLog::get(),
+            "setMultiInternal: Retrying after operation timeout error "
+            "writing 1 objects"));
+}
+TEST_F(ZooStorageTest, setMultiInternal_fallBackToSet) {
+    Buffer value;
+    vector<ExternalStorage::Write> writes;
+    writes.emplace_back(ExternalStorage::Hint::CREATE, "/test/var1",
+            "value1");
+    writes.emplace_back(ExternalStorage::Hint::CREATE, "/test/var2",
+            "value2");
+    zoo->setMulti(writes);
+    EXPECT_TRUE(zoo->get("/test/var1", &value));
+    EXPECT_EQ("value1", TestUtil::toString(&value));
+    EXPECT_TRUE(zoo->get("/test/var2", &value));
+    EXPECT_EQ("value2", TestUtil::toString(&value));
+    EXPECT_EQ("setMultiInternal: Transaction writing 2 objects failed "
+            "(no node); writing them individually", TestLog::get());
+}
+
 TEST_F(ZooStorageTest, checkLeader_objectDoesntExist) {
     Buffer value;
     zoo->leaderObject = "/test";
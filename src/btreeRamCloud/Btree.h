@@ -29,6 +29,9 @@
 #define _BTREE_H_
 
 #include <assert.h>
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
 
 #include "Buffer.h"
 #include "Object.h"
@@ -377,6 +380,12 @@ PRIVATE:
         /// that entries [0, n) are valid in the node.
         uint16_t  slotuse;
 
+        /// Number of leading bytes shared by all the keys in the node that
+        /// were stored only once when the node was written to its RAMCloud
+        /// object (see IndexBtree::compressNode). This is always zero for
+        /// nodes in memory, whose keys are stored in full.
+        uint16_t prefixLength;
+
         /// The amount of space in the keyBuffer dedicated to secondary keys
         /// only.
         uint32_t keyStorageUsed;
@@ -404,6 +413,7 @@ PRIVATE:
           , keysBeginOffset(backingStorage->size())
           , level(level)
           , slotuse(0)
+          , prefixLength(0)
           , keyStorageUsed(0)
         {}
 
@@ -1523,6 +1533,46 @@ PRIVATE:
         }
     };
 
+    /**
+     * A node held in #nodeCache. The cache owns a private, contiguous copy
+     * of the node's object, so entries remain valid even if the log cleaner
+     * moves or frees the object itself.
+     */
+    struct CachedNode {
+        CachedNode()
+            : buffer(), node(NULL)
+        { }
+
+        /// Copy of the value of the node's RAMCloud object; the keys
+        /// referenced by #node live here.
+        Buffer buffer;
+
+        /// The node, as reconstructed from #buffer.
+        const Node* node;
+
+        DISALLOW_COPY_AND_ASSIGN(CachedNode);
+    };
+
+    /// Upper limit on the number of entries in #nodeCache. If the cache
+    /// fills up, it is emptied and refilled by subsequent lookups.
+    static const uint32_t MAX_CACHED_NODES = 1024;
+
+    /// Nodes that have been read by lookups since they were last modified,
+    /// indexed by NodeId. Lookups (find, lower_bound, iteration, ...) walk
+    /// the tree through this cache, so the upper levels of the tree and
+    /// recently scanned leaves are decoded once rather than being read from
+    /// the object manager on every traversal. The cache is write-through:
+    /// modifications still go to the object manager via writeNode() and
+    /// freeNode(), which simply drop the affected entries. Entries are
+    /// reference counted so that an iterator can hang onto its leaf even if
+    /// the cache is flushed underneath it.
+    mutable std::unordered_map<NodeId, std::shared_ptr<const CachedNode>>
+            nodeCache;
+
+    /// Serializes lookups' accesses to #nodeCache: IndexletManager lets
+    /// lookups on the same tree run in parallel. Modifications exclude
+    /// lookups (and each other), so they use the cache without this lock.
+    mutable SpinLock nodeCacheMutex;
 
 PUBLIC:
     // *** Constructors and Destructor
@@ -1539,7 +1589,8 @@ PUBLIC:
      */
     explicit inline IndexBtree(uint64_t tableId, ObjectManager *objMgr)
         : m_stats(), treeTableId(tableId), objMgr(objMgr), nextNodeId(ROOT_ID),
-          m_rootId(ROOT_ID), logBuffer(), numEntries(0), cache()
+          m_rootId(ROOT_ID), logBuffer(), numEntries(0), cache(),
+          nodeCache(), nodeCacheMutex("IndexBtree::nodeCache")
     { }
 
     /**
@@ -1562,7 +1613,8 @@ PUBLIC:
                           uint64_t nextNodeId)
     : m_stats(), treeTableId(tableId), objMgr(objMgr),
         nextNodeId(nextNodeId), m_rootId(ROOT_ID),  logBuffer(),
-        numEntries(0), cache()
+        numEntries(0), cache(), nodeCache(),
+        nodeCacheMutex("IndexBtree::nodeCache")
     { }
 
     inline ~IndexBtree() { }
@@ -1578,10 +1630,13 @@ PUBLIC:
 
     /// Sets the NodeId that will be assigned to the next new node written.
     /// This should be set carefully, as setting it to a value too low would
-    /// result in live nodes being overwritten.
+    /// result in live nodes being overwritten. This is invoked after nodes
+    /// have been written to the backing table behind the tree's back (e.g.
+    /// during migration), so it also discards any cached nodes.
     void
     setNextNodeId(NodeId newNodeId) {
         nextNodeId = newNodeId;
+        nodeCache.clear();
     }
 
     /**
@@ -1637,6 +1692,7 @@ PUBLIC:
             nextNodeId = ROOT_ID;
             m_stats = tree_stats();
             cache.clear();
+            nodeCache.clear();
         }
     }
 
@@ -1673,16 +1729,16 @@ PUBLIC:
         if (nextNodeId <= ROOT_ID)
             return iterator(this, INVALID_NODEID, 0);
 
-        Buffer nodeBuffer;
         NodeId currentId = m_rootId;
-        Node *n = readNode(currentId, &nodeBuffer);
+        std::shared_ptr<const CachedNode> cached = getCachedNode(currentId);
+        const Node *n = cached->node;
 
         while (!n->isLeaf()) {
             const InnerNode *inner = static_cast<const InnerNode*>(n);
 
             currentId = inner->getChildAt(0);
-            nodeBuffer.reset();
-            n = readNode(currentId, &nodeBuffer);
+            cached = getCachedNode(currentId);
+            n = cached->node;
         }
 
         return iterator(this, currentId, 0);
@@ -1719,6 +1775,32 @@ PUBLIC:
         return (nextNodeId == ROOT_ID);
     }
 
+    /**
+     * Find a key that divides the B+ tree's entries roughly in half, for
+     * splitting the indexlet it stores: the middle entry of the root node.
+     * Each entry of an inner root is the last entry of one of its subtrees,
+     * and the subtrees have similar sizes, so this is close to the median.
+     *
+     * \param[out] keyOutBuffer
+     *      The key is appended here.
+     *
+     * \return
+     *      False (and nothing is appended) if the root has fewer than two
+     *      entries, so the tree is too small to be worth splitting.
+     */
+    bool
+    getMiddleKey(Buffer *keyOutBuffer) const {
+        if (nextNodeId <= ROOT_ID)
+            return false;
+
+        std::shared_ptr<const CachedNode> cached = getCachedNode(m_rootId);
+        const Node *root = cached->node;
+        if (root->slotuse < 2)
+            return false;
+        root->getAt(uint16_t(root->slotuse / 2), keyOutBuffer);
+        return true;
+    }
+
     // *** Access Functions Querying the Tree by Descending to a Leaf
 
     /**
@@ -1755,16 +1837,17 @@ PUBLIC:
         if (nextNodeId <= ROOT_ID)
             return end();
 
-        Buffer lookupBuffer;
         NodeId currId = m_rootId;
-        Node *n = readNode(m_rootId, &lookupBuffer);
+        std::shared_ptr<const CachedNode> cached = getCachedNode(m_rootId);
+        const Node *n = cached->node;
 
         while(!n->isLeaf()) {
             const InnerNode *inner = static_cast<const InnerNode*>(n);
             uint16_t slot = findEntryGE(inner, key);
 
             currId = inner->getChildAt(slot);
-            n = readNode(currId, &lookupBuffer);
+            cached = getCachedNode(currId);
+            n = cached->node;
         }
 
         assert (currId >= ROOT_ID);
@@ -1789,14 +1872,15 @@ PUBLIC:
         if (nextNodeId <= ROOT_ID)
             return 0;
 
-        Buffer buffer;
         NodeId childId = m_rootId;
-        Node *n = readNode(m_rootId, &buffer);
+        std::shared_ptr<const CachedNode> cached = getCachedNode(m_rootId);
+        const Node *n = cached->node;
         while(!n->isLeaf()) {
             const InnerNode *inner = static_cast<const InnerNode*>(n);
             uint16_t slot = findEntryGE(inner, key);
             childId = inner->getChildAt(slot);
-            n = readNode(childId, &buffer);
+            cached = getCachedNode(childId);
+            n = cached->node;
         }
 
         const LeafNode *leaf = static_cast<const LeafNode*>(n);
@@ -1813,7 +1897,8 @@ PUBLIC:
                 if (currentLeafId == INVALID_NODEID)
                     break;
 
-                leaf = static_cast<LeafNode*>(readNode(currentLeafId, &buffer));
+                cached = getCachedNode(currentLeafId);
+                leaf = static_cast<const LeafNode*>(cached->node);
             }
         }
 
@@ -1840,14 +1925,15 @@ PUBLIC:
         if (nextNodeId <= ROOT_ID)
             return end();
 
-        Buffer buffer;
-        Node *n = readNode(m_rootId, &buffer);
+        std::shared_ptr<const CachedNode> cached = getCachedNode(m_rootId);
+        const Node *n = cached->node;
         NodeId childId = m_rootId;
         while(!n->isLeaf()) {
             const InnerNode *inner = static_cast<const InnerNode*>(n);
             uint16_t slot = findEntryGE(inner, key);
             childId = inner->getChildAt(slot);
-            n = readNode(childId, &buffer);
+            cached = getCachedNode(childId);
+            n = cached->node;
         }
 
         const LeafNode *leaf = static_cast<const LeafNode*>(n);
@@ -1882,14 +1968,15 @@ PUBLIC:
         if (nextNodeId <= ROOT_ID)
             return end();
 
-        Buffer nodeBuffer;
-        Node *n = readNode(m_rootId, &nodeBuffer);
+        std::shared_ptr<const CachedNode> cached = getCachedNode(m_rootId);
+        const Node *n = cached->node;
         NodeId childId = m_rootId;
         while(!n->isLeaf()) {
-            InnerNode *inner = static_cast<InnerNode*>(n);
+            const InnerNode *inner = static_cast<const InnerNode*>(n);
             uint16_t slot = findEntryGreater(inner, key);
             childId = inner->getChildAt(slot);
-            n = readNode(childId, &nodeBuffer);
+            cached = getCachedNode(childId);
+            n = cached->node;
         }
 
         const LeafNode *leaf = static_cast<const LeafNode*>(n);
@@ -2142,6 +2229,7 @@ PRIVATE:
         Status status = objMgr->writeTombstone(key, &logBuffer);
         assert(status == STATUS_OK);
         numEntries++;
+        nodeCache.erase(nodeId);
         if (nodeId == m_rootId)
             nextNodeId = ROOT_ID;
     }
@@ -2191,13 +2279,63 @@ PRIVATE:
             memmove(ptr, outBuffer->getRange(sizeBeforeRead, nodeSize), nodeSize);
         }
 
+        if (ptr->prefixLength != 0)
+            ptr = decompressNode(outBuffer, sizeBeforeRead, ptr, outBuffer);
+        else
+            ptr->reinitFromRead(outBuffer, sizeBeforeRead);
+
         RAMCLOUD_LOG(DEBUG, "Read object from log, nodeId = %lu, size = %d",
                      nodeId, ptr->serializedLength());
-
-        ptr->reinitFromRead(outBuffer, sizeBeforeRead);
         return ptr;
     }
 
+    /**
+     * Return the node corresponding to a given nodeId, reading it from the
+     * object manager only if it isn't already in #nodeCache. Nodes returned
+     * by this method are shared by all lookups and must not be modified;
+     * paths that modify the tree should use readNode() instead.
+     *
+     * \param nodeId
+     *      The primary key for the RAMCloud object corresponding
+     *      to the B+ tree node to be read.
+     *
+     * \return
+     *      The cached node, or NULL if the node couldn't be read. The node
+     *      remains valid as long as the returned reference is held, even if
+     *      the tree is modified in the meantime (but it may then no longer
+     *      reflect the contents of the tree).
+     */
+    std::shared_ptr<const CachedNode>
+    getCachedNode(NodeId nodeId) const {
+        {
+            SpinLock::Guard _(nodeCacheMutex);
+            auto it = nodeCache.find(nodeId);
+            if (it != nodeCache.end())
+                return it->second;
+        }
+
+        Buffer objectBuffer;
+        Key key(treeTableId, &nodeId, sizeof(NodeId));
+        Status status = objMgr->readObject(key, &objectBuffer, NULL, NULL,
+                true);
+        if (status != STATUS_OK) {
+            RAMCLOUD_LOG(DEBUG, "Cant read NodeId %lu", nodeId);
+            return std::shared_ptr<const CachedNode>();
+        }
+
+        // The object's value refers to log memory; make a private copy.
+        std::shared_ptr<CachedNode> entry = std::make_shared<CachedNode>();
+        uint32_t length = objectBuffer.size();
+        entry->buffer.appendCopy(objectBuffer.getRange(0, length), length);
+        entry->node = readNodeFromObjectValue(&entry->buffer);
+
+        SpinLock::Guard _(nodeCacheMutex);
+        if (nodeCache.size() >= MAX_CACHED_NODES)
+            nodeCache.clear();
+        nodeCache[nodeId] = entry;
+        return entry;
+    }
+
     /**
      * Given a buffer encapsulating the node (i.e., value of the RAMCloud
      * object corresponding to this node), return a pointer to a contiguous
@@ -2232,10 +2370,156 @@ PRIVATE:
                     nodeSize);
         }
 
+        if (ptr->prefixLength != 0)
+            return decompressNode(nodeObjectValue, 0, ptr, nodeObjectValue);
         ptr->reinitFromRead(nodeObjectValue, 0);
         return ptr;
     }
 
+    /**
+     * Returns the number of bytes used by the rightmost leaf key of a node,
+     * which is stored after the node's other keys; zero for leaves.
+     */
+    static uint32_t
+    rightMostLeafKeyLength(const Node* node) {
+        if (node->isLeaf())
+            return 0;
+        const InnerNode* inner = static_cast<const InnerNode*>(node);
+        return (inner->rightMostLeafKeyIsInfinite ? 0
+                : inner->rightMostLeafKey.keyLength);
+    }
+
+    /**
+     * Produce the form of a node that is stored in its RAMCloud object.
+     * The keys in a node are sorted, so they often share a long common
+     * prefix (e.g. keys that embed a date or a naming scheme); the object
+     * stores that prefix only once, followed by the remainder of each key.
+     * This shrinks the objects that are rewritten on every insert and
+     * erase, and hence the log and cleaner bandwidth consumed by indexes.
+     * If the keys share no prefix, the object holds an exact copy of the
+     * node.
+     *
+     * \param node
+     *      Contiguous copy of the node, as returned by
+     *      serializeAppendToBuffer().
+     *
+     * \param[out] outBuffer
+     *      The object's value is appended here, in contiguous memory.
+     *
+     * 
+eturn
+     *      The number of bytes appended to outBuffer.
+     */
+    static uint32_t
+    compressNode(const Node* node, Buffer* outBuffer) {
+        uint32_t metadataSize =
+                (node->isLeaf() ? sizeof32(LeafNode) : sizeof32(InnerNode));
+        const uint8_t* keyData =
+                reinterpret_cast<const uint8_t*>(node) + metadataSize;
+        uint32_t rightMostLength = rightMostLeafKeyLength(node);
+
+        uint16_t prefixLength = 0;
+        if (node->slotuse > 1) {
+            const uint8_t* first = keyData + node->keys[0].relOffset;
+            prefixLength = node->keys[0].keyLength;
+            for (uint16_t i = 1; i < node->slotuse && prefixLength > 0; i++) {
+                const uint8_t* key = keyData + node->keys[i].relOffset;
+                uint16_t limit = std::min(prefixLength,
+                                          node->keys[i].keyLength);
+                uint16_t common = 0;
+                while (common < limit && key[common] == first[common])
+                    common++;
+                prefixLength = common;
+            }
+        }
+
+        uint32_t keyBytes = node->keyStorageUsed;
+        if (prefixLength > 0) {
+            keyBytes = prefixLength;
+            for (uint16_t i = 0; i < node->slotuse; i++)
+                keyBytes += node->keys[i].keyLength - prefixLength;
+        }
+
+        uint32_t length = metadataSize + keyBytes + rightMostLength;
+        uint8_t* dst = static_cast<uint8_t*>(outBuffer->alloc(length));
+        memmove(dst, node, metadataSize);
+        if (prefixLength == 0) {
+            memcpy(dst + metadataSize, keyData,
+                   node->keyStorageUsed + rightMostLength);
+            return length;
+        }
+
+        reinterpret_cast<Node*>(dst)->prefixLength = prefixLength;
+        uint8_t* out = dst + metadataSize;
+        memcpy(out, keyData + node->keys[0].relOffset, prefixLength);
+        out += prefixLength;
+        for (uint16_t i = 0; i < node->slotuse; i++) {
+            uint32_t suffixLength = node->keys[i].keyLength - prefixLength;
+            memcpy(out, keyData + node->keys[i].relOffset + prefixLength,
+                   suffixLength);
+            out += suffixLength;
+        }
+        memcpy(out, keyData + node->keyStorageUsed, rightMostLength);
+        return length;
+    }
+
+    /**
+     * Rebuild a node whose object was written with a compressed key prefix
+     * (see compressNode) so that it can be used through the Node API.
+     *
+     * \param from
+     *      Buffer containing the object's value.
+     *
+     * \param offset
+     *      Offset of the object's value within \a from.
+     *
+     * \param compressed
+     *      The metadata of the node in \a from, in contiguous memory.
+     *
+     * \param to
+     *      Buffer to append the rebuilt node to; may be the same as
+     *      \a from. The caller must ensure the lifetime of this buffer.
+     *
+     * 
+eturn
+     *      A pointer to the rebuilt node.
+     */
+    static Node*
+    decompressNode(Buffer* from, uint32_t offset, const Node* compressed,
+                   Buffer* to) {
+        uint32_t metadataSize = (compressed->isLeaf() ? sizeof32(LeafNode)
+                                                      : sizeof32(InnerNode));
+        uint16_t prefixLength = compressed->prefixLength;
+        uint32_t rightMostLength = rightMostLeafKeyLength(compressed);
+        uint32_t keyBytes = prefixLength;
+        for (uint16_t i = 0; i < compressed->slotuse; i++)
+            keyBytes += compressed->keys[i].keyLength - prefixLength;
+        const uint8_t* in = static_cast<const uint8_t*>(from->getRange(
+                offset + metadataSize, keyBytes + rightMostLength));
+        assert(in != NULL);
+
+        uint32_t nodeOffset = to->size();
+        uint8_t* dst = static_cast<uint8_t*>(to->alloc(metadataSize +
+                compressed->keyStorageUsed + rightMostLength));
+        memmove(dst, compressed, metadataSize);
+        Node* node = reinterpret_cast<Node*>(dst);
+        node->prefixLength = 0;
+
+        uint8_t* keyData = dst + metadataSize;
+        const uint8_t* suffix = in + prefixLength;
+        for (uint16_t i = 0; i < node->slotuse; i++) {
+            uint32_t suffixLength = node->keys[i].keyLength - prefixLength;
+            memcpy(keyData + node->keys[i].relOffset, in, prefixLength);
+            memcpy(keyData + node->keys[i].relOffset + prefixLength, suffix,
+                   suffixLength);
+            suffix += suffixLength;
+        }
+        memcpy(keyData + node->keyStorageUsed, suffix, rightMostLength);
+
+        node->reinitFromRead(to, nodeOffset);
+        return node;
+    }
+
     /**
      * Write a B+ tree node as a RamCloud object. After the call returns,
      * it is safe to modify or destroy the tree node passed in.
@@ -2264,7 +2548,10 @@ PRIVATE:
 
       Node *serializedNode = node->serializeAppendToBuffer(&buffer);
       serializedNode->keyBuffer = NULL; // Helps catch errors in case a person reads a node back incorrectly.
-      Object object(key, serializedNode, node->serializedLength(), 1, 0, buffer);
+      Buffer objectBuffer;
+      uint32_t length = compressNode(serializedNode, &objectBuffer);
+      Object object(key, objectBuffer.getRange(0, length), length, 1, 0,
+                    objectBuffer);
 
       // here size is the size of the object's value. ObjectManager
       // will construct an object around this.
@@ -2274,6 +2561,7 @@ PRIVATE:
                                          &nodeOffset, &tombstoneAdded);
 
       cache[nodeId] = nodeOffset;
+      nodeCache.erase(nodeId);
 
       if (tombstoneAdded)
           numEntries+= 2;
@@ -2830,8 +3118,18 @@ PRIVATE:
                 newRoot = static_cast<Node*>(
                                 logBuffer.getRange(it->second, sizeof(Node)));
 
-                // Readjust buffer
-                newRoot->reinitFromRead(&logBuffer, it->second);
+                // Readjust buffer; a compressed node has to be rebuilt
+                // elsewhere so that the logBuffer isn't modified.
+                if (newRoot->prefixLength != 0) {
+                    uint32_t metadataSize = (newRoot->isLeaf()
+                            ? sizeof32(LeafNode) : sizeof32(InnerNode));
+                    const Node* compressed = static_cast<const Node*>(
+                            logBuffer.getRange(it->second, metadataSize));
+                    newRoot = decompressNode(&logBuffer, it->second,
+                                             compressed, &buffer);
+                } else {
+                    newRoot->reinitFromRead(&logBuffer, it->second);
+                }
             }
 
             writeNode(newRoot, m_rootId);
@@ -3203,10 +3501,11 @@ PUBLIC:
         /// Current key/data slot referenced within the node.
         uint16_t currslot;
 
-        /// Holds the contents of the currently referenced leaf
-        Buffer buffer;
+        /// Keeps the currently referenced leaf alive (see
+        /// IndexBtree::nodeCache).
+        std::shared_ptr<const CachedNode> cached;
 
-        /// Pointer to the currently referenced leaf node within the Buffer
+        /// Pointer to the currently referenced leaf node within #cached
         const LeafNode* currnode;
 
         /// A temporary entry to STL-correctly deliver operator* and operator->
@@ -3218,7 +3517,7 @@ PUBLIC:
          */
         inline iterator(IndexBtree* tree = NULL)
             : parentBtree(tree), currentNodeId(INVALID_NODEID), currslot(0),
-              buffer(), currnode(NULL), tempEntry()
+              cached(), currnode(NULL), tempEntry()
         { }
 
         /**
@@ -3234,25 +3533,25 @@ PUBLIC:
          */
         inline iterator(IndexBtree *tree, NodeId nodeId, uint16_t slot = 0)
             : parentBtree(tree), currentNodeId(nodeId), currslot(slot),
-              buffer(), currnode(NULL), tempEntry()
+              cached(), currnode(NULL), tempEntry()
         { }
 
         inline iterator(const iterator &it)
             : parentBtree(it.parentBtree),
               currentNodeId(it.currentNodeId),
               currslot(it.currslot),
-              buffer(), currnode(NULL), tempEntry()
+              cached(), currnode(NULL), tempEntry()
         { }
 
-        /// Implement the = operator to avoid invocation of the operator=
-        /// method on the Buffer class which does not exist
+        /// Implement the = operator so that the leaf is looked up again
+        /// rather than shared with the other iterator
         inline iterator&
         operator=(const iterator &it)
         {
             parentBtree = it.parentBtree;
             currentNodeId = it.currentNodeId;
             currslot = it.currslot;
-            buffer.reset();
+            cached.reset();
             currnode = NULL;
             return *this;
         }
@@ -3264,8 +3563,7 @@ PUBLIC:
         operator*()
         {
             if (!currnode)
-                  currnode = static_cast<const LeafNode *>(
-                        parentBtree->readNode(currentNodeId, &buffer));
+                loadLeaf();
 
             tempEntry = currnode->getAt(currslot);
             return tempEntry;
@@ -3276,8 +3574,7 @@ PUBLIC:
         operator->()
         {
             if (!currnode)
-                currnode = static_cast<const LeafNode *>(
-                        parentBtree->readNode(currentNodeId, &buffer));
+                loadLeaf();
 
             tempEntry = currnode->getAt(currslot);
             return &tempEntry;
@@ -3289,8 +3586,7 @@ PUBLIC:
         operator++()
         {
             if (!currnode)
-                currnode = static_cast<const LeafNode*>(
-                        parentBtree->readNode(currentNodeId, &buffer));
+                loadLeaf();
 
 
             if (currslot + 1 < currnode->slotuse) {
@@ -3299,12 +3595,12 @@ PUBLIC:
                 currentNodeId = currnode->nextleaf;
                 currslot = 0;
                 currnode = NULL;
-                buffer.reset();
+                cached.reset();
             } else {
                 // this is end()
                 currentNodeId = INVALID_NODEID;
                 currslot = 0;
-                buffer.reset();
+                cached.reset();
                 currnode = NULL;
             }
 
@@ -3319,21 +3615,20 @@ PUBLIC:
             iterator tmp = *this;   // copy ourselves
 
             if (!currnode)
-                currnode = static_cast<const LeafNode*>(
-                        parentBtree->readNode(currentNodeId, &buffer));
+                loadLeaf();
 
             if (currslot + 1 < currnode->slotuse) {
                 ++currslot;
             } else if (currnode->nextleaf != INVALID_NODEID) {
                 currentNodeId = currnode->nextleaf;
                 currslot = 0;
-                buffer.reset();
+                cached.reset();
                 currnode = NULL;
             } else {
                 // this is end()
                 currentNodeId = INVALID_NODEID;
                 currslot = 0;
-                buffer.reset();
+                cached.reset();
                 currnode = NULL;
             }
 
@@ -3346,20 +3641,19 @@ PUBLIC:
         operator--()
         {
             if (!currnode)
-                currnode = static_cast<const LeafNode*>(
-                        parentBtree->readNode(currentNodeId, &buffer));
+                loadLeaf();
 
             if (currslot > 0) {
                 --currslot;
             } else if (currnode->prevleaf != INVALID_NODEID) {
                 currentNodeId = currnode->prevleaf;
                 currslot = uint16_t(currnode->slotuse - 1);
-                buffer.reset();
+                cached.reset();
                 currnode = NULL;
             } else {
                 // this is begin()
                 currslot = 0;
-                buffer.reset();
+                cached.reset();
                 currnode = NULL;
             }
 
@@ -3375,20 +3669,19 @@ PUBLIC:
             iterator tmp = *this;   // copy ourselves
 
             if (!currnode)
-                currnode = static_cast<const LeafNode*>(
-                        parentBtree->readNode(currentNodeId, &buffer));
+                loadLeaf();
 
             if (currslot > 0) {
                 --currslot;
             } else if (currnode->prevleaf != INVALID_NODEID) {
                 currentNodeId = currnode->prevleaf;
                 currslot = uint16_t(currnode->slotuse - 1);
-                buffer.reset();
+                cached.reset();
                 currnode = NULL;
             } else {
                 // this is begin()
                 currslot = 0;
-                buffer.reset();
+                cached.reset();
                 currnode = NULL;
             }
 
@@ -3410,6 +3703,15 @@ PUBLIC:
         {
             return !operator==(x);
         }
+
+    PRIVATE:
+        /// Point #currnode at the leaf identified by #currentNodeId.
+        inline void
+        loadLeaf()
+        {
+            cached = parentBtree->getCachedNode(currentNodeId);
+            currnode = static_cast<const LeafNode*>(cached->node);
+        }
     };
 
 PRIVATE:
@@ -970,6 +970,59 @@ TEST_F(BtreeTest, writeReadFreeNode) {
   EXPECT_TRUE(NULL == bt.readNode(1000, &buffer_out));
 }
 
+TEST_F(BtreeTest, getCachedNode) {
+    IndexBtree bt(tableId, &objectManager);
+    Buffer buffer;
+    IndexBtree::LeafNode *n =
+            buffer.emplaceAppend<IndexBtree::LeafNode>(&buffer);
+    fillNodeSorted(n);
+    bt.writeNode(n, 1000);
+    bt.flush();
+
+    std::shared_ptr<const IndexBtree::CachedNode> cached =
+            bt.getCachedNode(1000);
+    ASSERT_TRUE(cached != NULL);
+    checkNodeEquals(n, static_cast<const IndexBtree::LeafNode*>(
+            cached->node));
+    EXPECT_EQ(1U, bt.nodeCache.size());
+    EXPECT_EQ(cached, bt.getCachedNode(1000));
+
+    // Writing the node drops it from the cache, but the old copy is still
+    // usable by whoever holds it.
+    n->pop_back();
+    bt.writeNode(n, 1000);
+    bt.flush();
+    EXPECT_EQ(0U, bt.nodeCache.size());
+    EXPECT_EQ(n->slotuse + 1, cached->node->slotuse);
+    EXPECT_EQ(n->slotuse, bt.getCachedNode(1000)->node->slotuse);
+
+    bt.freeNode(1000);
+    bt.flush();
+    EXPECT_EQ(0U, bt.nodeCache.size());
+    EXPECT_TRUE(NULL == bt.getCachedNode(1000));
+    EXPECT_EQ(0U, bt.nodeCache.size());
+}
+
+TEST_F(BtreeTest, getCachedNode_full) {
+    IndexBtree bt(tableId, &objectManager);
+    Buffer buffer;
+    IndexBtree::LeafNode *n =
+            buffer.emplaceAppend<IndexBtree::LeafNode>(&buffer);
+    fillNodeSorted(n);
+    uint64_t maxNodes = IndexBtree::MAX_CACHED_NODES;
+    for (NodeId id = 1000; id < 1000 + maxNodes; id++) {
+        bt.writeNode(n, id);
+        bt.flush();
+        bt.getCachedNode(id);
+    }
+    EXPECT_EQ(maxNodes, bt.nodeCache.size());
+
+    bt.writeNode(n, 999);
+    bt.flush();
+    bt.getCachedNode(999);
+    EXPECT_EQ(1U, bt.nodeCache.size());
+}
+
 TEST_F (BtreeTest, writeReadInnerNode) {
     BtreeEntry eTest = {"Testing", 123};
     BtreeEntry e0 = {"zero", 0};
@@ -1001,6 +1054,64 @@ TEST_F (BtreeTest, writeReadInnerNode) {
     EXPECT_EQ(e1, rn->getAt(1));
 }
 
+TEST_F(BtreeTest, compressNode_noCommonPrefix) {
+    Buffer nodeBuffer, serialized, object;
+    IndexBtree::LeafNode *n =
+            nodeBuffer.emplaceAppend<IndexBtree::LeafNode>(&nodeBuffer);
+    fillNodeSorted(n);
+
+    IndexBtree::Node *copy = n->serializeAppendToBuffer(&serialized);
+    uint32_t length = IndexBtree::compressNode(copy, &object);
+    EXPECT_EQ(n->serializedLength(), length);
+    EXPECT_EQ(0, memcmp(serialized.getRange(0, length),
+                        object.getRange(0, length), length));
+    EXPECT_EQ(0U, static_cast<IndexBtree::Node*>(
+            object.getRange(0, sizeof(IndexBtree::Node)))->prefixLength);
+}
+
+TEST_F(BtreeTest, compressNode_leaf) {
+    Buffer nodeBuffer, serialized, object;
+    IndexBtree::LeafNode *n =
+            nodeBuffer.emplaceAppend<IndexBtree::LeafNode>(&nodeBuffer);
+    n->setAt(0, {"user:1000:alice", 1});
+    n->setAt(1, {"user:1000:bob", 2});
+    n->setAt(2, {"user:1001", 3});
+
+    IndexBtree::Node *copy = n->serializeAppendToBuffer(&serialized);
+    uint32_t length = IndexBtree::compressNode(copy, &object);
+    EXPECT_EQ(n->serializedLength() - 2 * 8, length);
+
+    IndexBtree::LeafNode *rn = static_cast<IndexBtree::LeafNode*>(
+            IndexBtree::readNodeFromObjectValue(&object));
+    EXPECT_EQ(0U, rn->prefixLength);
+    checkNodeEquals(n, rn);
+}
+
+TEST_F(BtreeTest, compressNode_innerNode) {
+    IndexBtree bt(tableId, &objectManager);
+    Buffer buffer_in, buffer_out;
+    IndexBtree::InnerNode *n = buffer_in.emplaceAppend<IndexBtree::InnerNode>(
+                                                    &buffer_in, uint16_t(1));
+    BtreeEntry rightMost = {"prefix-zzz", 99};
+    n->setRightMostLeafKey(rightMost);
+    n->insertAt(0, {"prefix-aaa", 1}, 10, 11);
+    n->insertAt(1, {"prefix-bb", 2}, 11, 12);
+
+    bt.writeNode(n, 1000);
+    bt.flush();
+
+    IndexBtree::InnerNode *rn =
+            static_cast<IndexBtree::InnerNode*>(bt.readNode(1000, &buffer_out));
+    ASSERT_TRUE(rn != NULL);
+    EXPECT_EQ(0U, rn->prefixLength);
+    EXPECT_EQ(rightMost, rn->getRightMostLeafKey());
+    EXPECT_EQ(n->getAt(0), rn->getAt(0));
+    EXPECT_EQ(n->getAt(1), rn->getAt(1));
+    EXPECT_EQ(10U, rn->getChildAt(0));
+    EXPECT_EQ(11U, rn->getChildAt(1));
+    EXPECT_EQ(12U, rn->getChildAt(2));
+}
+
 static void testBalanceWithRight(uint16_t leftSize, uint16_t rightSize) {
     Buffer b1, b2;
     std::vector<BtreeEntry> entries;
@@ -1478,6 +1589,35 @@ TEST_F(BtreeTest, begin_end_size_exists_find_empty) {
     EXPECT_TRUE(bt.empty());
 }
 
+TEST_F(BtreeTest, getMiddleKey) {
+    std::vector<BtreeEntry> entries;
+    std::vector<std::string> entryKeys;
+    generateKeysInRange(0, 100, entryKeys, entries, 3);
+
+    IndexBtree bt(tableId, &objectManager);
+    Buffer key;
+    EXPECT_FALSE(bt.getMiddleKey(&key));
+    bt.insert(entries[0]);
+    EXPECT_FALSE(bt.getMiddleKey(&key));
+    EXPECT_EQ(0U, key.size());
+
+    bt.insert(entries[1]);
+    bt.insert(entries[2]);
+    EXPECT_TRUE(bt.getMiddleKey(&key));
+    EXPECT_EQ("001", string(static_cast<const char*>(
+            key.getRange(0, key.size())), key.size()));
+
+    // Once the root is an inner node, the key is one of its separators.
+    for (uint32_t i = 3; i < 100; i++)
+        bt.insert(entries[i]);
+    key.reset();
+    EXPECT_TRUE(bt.getMiddleKey(&key));
+    string middle(static_cast<const char*>(key.getRange(0, key.size())),
+            key.size());
+    EXPECT_LT("000", middle);
+    EXPECT_GT("099", middle);
+}
+
 TEST_F(BtreeTest, find_pkHashAgnostic) {
     uint32_t slots = IndexBtree::innerslotmax;
     uint32_t numEntries  = uint32_t(slots*slots + 1);
@@ -0,0 +1,345 @@
+#!/usr/bin/env python
+
+# Copyright (c) 2016 Stanford University
+#
+# Permission to use, copy, modify, and distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+# ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+# WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+# ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+# OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+"""Performance regression suite for a RAMCloud cluster. Should be run from
+the top-level directory of the RAMCloud source tree, on the same cluster
+(config.py/localconfig.py) as the other system tests.
+
+Each run brings up clusters with cluster.py and measures a fixed matrix of
+benchmarks, several times each: ClusterPerf workloads, crash recovery time
+(recovery.py), and log cleaner throughput (LogCleanerBenchmark). The
+samples for every metric are written to a JSON file. Given the JSON file of
+an earlier run with --baseline, each metric is compared with its baseline
+samples, and changes that are both statistically significant (a permutation
+test on the difference of the means) and larger than --threshold are
+reported; the exit status is 1 if any metric regressed.
+
+This isn't part of the suite run by run.py, because it takes much longer
+than the functional tests; run it directly:
+
+    systemtests/perfregression.py -o new.json --baseline old.json
+"""
+
+from __future__ import division, print_function
+
+import sys
+sys.path.append('scripts')
+
+from common import *
+import cluster
+import glob
+import json
+import os
+import random
+import re
+import recovery
+import time
+from optparse import OptionParser
+
+# Each object of the following class represents one benchmark in the
+# matrix; a benchmark may produce any number of metrics.
+class Benchmark:
+    def __init__(self,
+            name,                 # Symbolic name for the benchmark; metric
+                                  # names start with it.
+            function,             # Driver function: invoked with the
+                                  # command-line options, it runs the
+                                  # benchmark once and returns a dictionary
+                                  # mapping metric names to Sample objects.
+            args                  # Extra arguments for the driver function.
+            ):
+        self.name = name
+        self.function = function
+        self.args = args
+
+class Sample:
+    def __init__(self,
+            value,                # Measured value, in base units (seconds,
+                                  # bytes/second, operations/second, ...).
+            unit,                 # Name of the base unit.
+            higher_is_better      # True means a decrease is a regression.
+            ):
+        self.value = value
+        self.unit = unit
+        self.higher_is_better = higher_is_better
+
+# Units printed by ClusterPerf (see printTime, printBandwidth, printRate,
+# and printPercent in ClusterPerf.cc): scale to base units, base unit, and
+# whether higher values are better.
+clusterperf_units = {
+    'ns':   (1e-09, 's', False),
+    'us':   (1e-06, 's', False),
+    'ms':   (1e-03, 's', False),
+    's':    (1, 's', False),
+    'GB/s': (1024**3, 'B/s', True),
+    'MB/s': (1024**2, 'B/s', True),
+    'KB/s': (1024, 'B/s', True),
+    'B/s':  (1, 'B/s', True),
+    'G/s':  (1e09, '1/s', True),
+    'M/s':  (1e06, '1/s', True),
+    'K/s':  (1e03, '1/s', True),
+    '/s':   (1, '1/s', True),
+    '%':    (1, '%', True),
+}
+
+def read_client_log(log_subdir, index=1):
+    """
+    Return the contents of a client's log file from the given run of
+    cluster.run, without RAMCloud log messages.
+    """
+    files = glob.glob('%s/client%d.*.log' % (log_subdir, index))
+    if len(files) == 0:
+        raise Exception("couldn't find log file for client %d in %s" %
+                (index, log_subdir))
+    result = ''
+    for line in open(files[0], 'r'):
+        if not re.match('([0-9]+\.[0-9]+) ', line):
+            result += line
+    return result
+
+def clusterperf(options, test, master_args='', num_clients=1):
+    """
+    Run one ClusterPerf test and return each of the measurements it
+    printed (lines of the form "name value unit description").
+    """
+    log_subdir = cluster.run(
+            client='%s/ClusterPerf %s' % (obj_path, test),
+            num_servers=options.num_servers,
+            num_clients=num_clients,
+            replicas=options.replicas,
+            master_args=master_args,
+            share_hosts=True,
+            timeout=options.timeout,
+            transport=options.transport,
+            log_dir=options.log_dir,
+            verbose=options.verbose)
+    samples = {}
+    for line in read_client_log(log_subdir).splitlines():
+        match = re.match('(\S+)\s+([0-9.]+)\s+(\S+)\s', line)
+        if not match or match.group(3) not in clusterperf_units:
+            continue
+        scale, unit, higher_is_better = clusterperf_units[match.group(3)]
+        samples['clusterperf.%s' % match.group(1)] = Sample(
+                float(match.group(2)) * scale, unit, higher_is_better)
+    if len(samples) == 0:
+        raise Exception('ClusterPerf %s produced no measurements (see %s)' %
+                (test, log_subdir))
+    return samples
+
+def recovery_time(options, num_objects, object_size):
+    """
+    Crash a master holding num_objects objects of object_size bytes and
+    return how long the cluster took to recover it.
+    """
+    stats = recovery.insist(num_servers=options.num_servers,
+            backups_per_server=1,
+            object_size=object_size,
+            num_objects=num_objects,
+            num_overwrites=1,
+            replicas=options.replicas,
+            timeout=options.timeout,
+            transport=options.transport,
+            log_dir=options.log_dir,
+            verbose=options.verbose)
+    return {'recovery.%dB.time' % object_size:
+            Sample(stats['ns'] / 1e09, 's', False)}
+
+def cleaner_throughput(options, utilization, object_size):
+    """
+    Overwrite objects on one master until its disk write cost stabilizes
+    (see LogCleanerBenchmark) and return the rate at which new data was
+    written, which is limited by the cleaner.
+    """
+    log_subdir = cluster.run(
+            client='%s/LogCleanerBenchmark -u %d -s %d -m 60' %
+                    (obj_path, utilization, object_size),
+            num_servers=options.replicas + 1,
+            replicas=options.replicas,
+            master_args='-t 2000',
+            share_hosts=True,
+            timeout=max(options.timeout, 1200),
+            transport=options.transport,
+            log_dir=options.log_dir,
+            verbose=options.verbose)
+    log = read_client_log(log_subdir)
+    summary = log[log.find('===> BENCHMARK SUMMARY'):]
+    match = re.search('Object Value Bytes Written: +[0-9]+ +\(([0-9.]+) MB/sec',
+            summary)
+    if not match:
+        raise Exception('LogCleanerBenchmark produced no summary (see %s)' %
+                log_subdir)
+    return {'cleaner.%dB.u%d.throughput' % (object_size, utilization):
+            Sample(float(match.group(1)) * 1024**2, 'B/s', True)}
+
+# The fixed matrix of benchmarks. Add to the end of this list, and don't
+# change existing entries lightly: results are only comparable with
+# baselines measured by the same benchmarks.
+benchmarks = [
+    Benchmark('basic', clusterperf, {'test': 'basic',
+                                     'master_args': '-t 4000'}),
+    Benchmark('multiRead_oneMaster', clusterperf,
+              {'test': 'multiRead_oneMaster'}),
+    Benchmark('multiWrite_oneMaster', clusterperf,
+              {'test': 'multiWrite_oneMaster'}),
+    Benchmark('transaction_oneMaster', clusterperf,
+              {'test': 'transaction_oneMaster'}),
+    Benchmark('writeAsyncSync', clusterperf, {'test': 'writeAsyncSync'}),
+    Benchmark('recovery', recovery_time, {'num_objects': 592415,
+                                          'object_size': 1024}),
+    Benchmark('cleaner', cleaner_throughput, {'utilization': 80,
+                                              'object_size': 1000}),
+]
+
+def mean(values):
+    return sum(values) / len(values)
+
+def permutation_test(a, b, rounds=10000):
+    """
+    Return the probability that the means of samples a and b would be at
+    least as far apart as they are if both came from the same distribution
+    (a two-sided permutation test; it makes no assumptions about the shape
+    of the distributions, which suits the small number of trials here).
+    """
+    observed = abs(mean(a) - mean(b))
+    pooled = a + b
+    extreme = 0
+    rng = random.Random(0)
+    for i in range(rounds):
+        rng.shuffle(pooled)
+        if abs(mean(pooled[:len(a)]) - mean(pooled[len(a):])) >= observed:
+            extreme += 1
+    return (extreme + 1) / (rounds + 1)
+
+def compare(results, baseline, alpha, threshold, report_missing):
+    """
+    Compare results with baseline (both in the format written to the
+    JSON file) and print a line for every metric; if report_missing is
+    True, also list the baseline's metrics that results lack. Return the
+    names of the metrics that regressed.
+    """
+    regressions = []
+    for name in sorted(results.keys()):
+        new = results[name]
+        if name not in baseline:
+            print('%-45s %12.4g %-4s (no baseline)' %
+                    (name, mean(new['samples']), new['unit']))
+            continue
+        old = baseline[name]
+        change = (mean(new['samples']) - mean(old['samples'])) / \
+                mean(old['samples'])
+        p = permutation_test(new['samples'], old['samples'])
+        significant = p < alpha and abs(change) >= threshold
+        worse = (change < 0) == new['higher_is_better']
+        verdict = ''
+        if significant:
+            verdict = 'REGRESSION' if worse else 'improvement'
+            if worse:
+                regressions.append(name)
+        print('%-45s %12.4g %-4s %+7.1f%% (p=%.3f) %s' %
+                (name, mean(new['samples']), new['unit'], 100 * change, p,
+                 verdict))
+    if report_missing:
+        for name in sorted(set(baseline.keys()) - set(results.keys())):
+            print('%-45s missing (was in baseline)' % name)
+    return regressions
+
+if __name__ == '__main__':
+    parser = OptionParser(description=
+            'Run a fixed matrix of performance benchmarks on a RAMCloud '
+            'cluster, store the results as JSON, and compare them with a '
+            'baseline. Each benchmark argument names one benchmark to run '
+            '(default: all of them).',
+            usage='%prog [options] benchmark benchmark ...',
+            conflict_handler='resolve')
+    parser.add_option('--baseline', metavar='FILE',
+            help='JSON results of an earlier run to compare with')
+    parser.add_option('-o', '--output', metavar='FILE',
+            default='perfregression.json',
+            help='File in which to store the results as JSON')
+    parser.add_option('--trials', type=int, default=5,
+            help='Number of times to run each benchmark')
+    parser.add_option('--alpha', type=float, default=0.01,
+            help='Changes are significant if a permutation test gives a '
+                 'p-value below this')
+    parser.add_option('--threshold', type=float, default=0.05,
+            help='Ignore changes smaller than this fraction of the '
+                 'baseline, even if they are significant')
+    parser.add_option('-d', '--logDir', default='logs', metavar='DIR',
+            dest='log_dir',
+            help='Top level directory for log files; the files for '
+                 'each invocation will go in a subdirectory.')
+    parser.add_option('-r', '--replicas', type=int, default=3,
+            metavar='N',
+            help='Number of disk backup copies for each segment')
+    parser.add_option('--servers', type=int, default=4,
+            metavar='N', dest='num_servers',
+            help='Number of hosts on which to run servers')
+    parser.add_option('-t', '--timeout', type=int, default=250,
+            metavar='SECS',
+            help="Abort if a benchmark doesn't finish within SECS seconds")
+    parser.add_option('-T', '--transport', default='infrc',
+            help='Transport to use for communication with servers')
+    parser.add_option('-v', '--verbose', action='store_true', default=False,
+            help='Print progress messages')
+    (options, args) = parser.parse_args()
+
+    selected = benchmarks
+    if len(args) > 0:
+        names = [b.name for b in benchmarks]
+        for name in args:
+            if name not in names:
+                print("No benchmark named '%s'; choose from %s" %
+                        (name, ', '.join(names)), file=sys.stderr)
+                sys.exit(2)
+        selected = [b for b in benchmarks if b.name in args]
+
+    baseline = None
+    if options.baseline:
+        baseline = json.load(open(options.baseline))['results']
+
+    # Interleave the trials so that slow drifts in the cluster (other users,
+    # disk wear, ...) affect every benchmark alike.
+    results = {}
+    for trial in range(options.trials):
+        for benchmark in selected:
+            if options.verbose:
+                print('Trial %d of %s' % (trial + 1, benchmark.name))
+            samples = benchmark.function(options, **benchmark.args)
+            for name, sample in samples.items():
+                metric = results.setdefault(name, {
+                        'unit': sample.unit,
+                        'higher_is_better': sample.higher_is_better,
+                        'samples': []})
+                metric['samples'].append(sample.value)
+
+    output = {
+        'git_ref': captureSh('git rev-parse HEAD').strip(),
+        'time': time.strftime('%Y-%m-%d %H:%M:%S'),
+        'hosts': [host[0] for host in getHosts()],
+        'options': vars(options),
+        'results': results,
+    }
+    with open(options.output, 'w') as f:
+        json.dump(output, f, indent=4, sort_keys=True)
+    print('Results written to %s' % options.output)
+
+    if baseline is not None:
+        regressions = compare(results, baseline, options.alpha,
+                options.threshold, len(args) == 0)
+        if len(regressions) > 0:
+            print('%d metric(s) regressed: %s' %
+                    (len(regressions), ', '.join(regressions)))
+            sys.exit(1)